@@ -2,10 +2,12 @@
 
 #include <import/lru.h>
 #include <haproxy/api.h>
+#include <haproxy/applet.h>
 #include <haproxy/arg.h>
 #include <haproxy/buf-t.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/chunk.h>
+#include <haproxy/cli.h>
 #include <haproxy/errors.h>
 #include <haproxy/global.h>
 #include <haproxy/http_ana.h>
@@ -31,10 +33,15 @@ struct _51d_property_names {
 };
 
 #ifdef FIFTYONEDEGREES_H_PATTERN_INCLUDED
-static struct lru64_head *_51d_lru_tree = NULL;
+/* Each thread has its own results cache so that lookups never need locking */
+static THREAD_LOCAL struct lru64_head *_51d_lru_tree = NULL;
 static unsigned long long _51d_lru_seed;
 
-__decl_spinlock(_51d_lru_lock);
+/* per-thread counters of the results cache, reported on the CLI */
+static struct {
+	unsigned long long lookups;
+	unsigned long long hits;
+} THREAD_ALIGNED(64) _51d_cache_ctr[MAX_THREADS];
 #endif
 
 #ifdef FIFTYONE_DEGREES_HASH_INCLUDED
@@ -244,9 +251,7 @@ static void _51d_insert_cache_entry(struct sample *smp, struct lru64 *lru, void*
 	memcpy(cache_entry->area, smp->data.u.str.area, smp->data.u.str.data);
 	cache_entry->area[smp->data.u.str.data] = 0;
 	cache_entry->data = smp->data.u.str.data;
-	HA_SPIN_LOCK(OTHER_LOCK, &_51d_lru_lock);
 	lru64_commit(lru, cache_entry, domain, 0, _51d_lru_free);
-	HA_SPIN_UNLOCK(OTHER_LOCK, &_51d_lru_lock);
 }
 
 /* Retrieves the data from the cache and sets the sample data to this string.
@@ -691,20 +696,17 @@ static int _51d_fetch(const struct arg *args, struct sample *smp, const char *kw
 
 	/* Check the cache to see if there's results for these headers already. */
 	if (_51d_lru_tree) {
-		HA_SPIN_LOCK(OTHER_LOCK, &_51d_lru_lock);
-
+		_51d_cache_ctr[tid].lookups++;
 		lru = lru64_get(_51d_req_hash(args, ws),
 		                _51d_lru_tree, (void*)args, 0);
 
 		if (lru && lru->domain) {
+			_51d_cache_ctr[tid].hits++;
 			fiftyoneDegreesWorksetPoolRelease(global_51degrees.pool, ws);
 			_51d_retrieve_cache_entry(smp, lru);
-			HA_SPIN_UNLOCK(OTHER_LOCK, &_51d_lru_lock);
-
 			_51d_set_smp(smp);
 			return 1;
 		}
-		HA_SPIN_UNLOCK(OTHER_LOCK, &_51d_lru_lock);
 	}
 
 	fiftyoneDegreesMatchForHttpHeaders(ws);
@@ -777,15 +779,14 @@ static int _51d_conv(const struct arg *args, struct sample *smp, void *private)
 	if (_51d_lru_tree) {
 		unsigned long long seed = _51d_lru_seed ^ (long)args;
 
-		HA_SPIN_LOCK(OTHER_LOCK, &_51d_lru_lock);
+		_51d_cache_ctr[tid].lookups++;
 		lru = lru64_get(XXH3(smp->data.u.str.area, smp->data.u.str.data, seed),
 		                _51d_lru_tree, (void*)args, 0);
 		if (lru && lru->domain) {
+			_51d_cache_ctr[tid].hits++;
 			_51d_retrieve_cache_entry(smp, lru);
-			HA_SPIN_UNLOCK(OTHER_LOCK, &_51d_lru_lock);
 			return 1;
 		}
-		HA_SPIN_UNLOCK(OTHER_LOCK, &_51d_lru_lock);
 	}
 
 	/* Create workset. This will later contain detection results. */
@@ -982,10 +983,8 @@ static int init_51degrees(void)
 	free(_51d_property_list);
 
 #ifdef FIFTYONEDEGREES_H_PATTERN_INCLUDED
+	/* the per-thread caches are allocated by _51d_alloc_cache() */
 	_51d_lru_seed = ha_random();
-	if (global_51degrees.cache_size) {
-		_51d_lru_tree = lru64_new(global_51degrees.cache_size);
-	}
 #endif
 
 #elif defined(FIFTYONE_DEGREES_HASH_INCLUDED)
@@ -1073,11 +1072,66 @@ static void deinit_51degrees(void)
 		free(_51d_prop_name);
 	}
 
+}
+
 #ifdef FIFTYONEDEGREES_H_PATTERN_INCLUDED
-	while (lru64_destroy(_51d_lru_tree));
-#endif
+/* allocates the calling thread's results cache. Returns 0 on failure. */
+static int _51d_alloc_cache(void)
+{
+	if (!global_51degrees.data_file_path || !global_51degrees.cache_size)
+		return 1;
+
+	_51d_lru_tree = lru64_new(global_51degrees.cache_size);
+	return !!_51d_lru_tree;
 }
 
+/* releases the calling thread's results cache */
+static void _51d_free_cache(void)
+{
+	if (_51d_lru_tree)
+		while (lru64_destroy(_51d_lru_tree));
+	_51d_lru_tree = NULL;
+}
+
+/* dumps the results cache usage on the CLI, one line per thread followed by
+ * the totals. Returns 0 if the output buffer is full, otherwise 1.
+ */
+static int _51d_cli_io_show_cache(struct appctx *appctx)
+{
+	unsigned long long lookups = 0, hits = 0;
+	int thr;
+
+	chunk_reset(&trash);
+	if (!global_51degrees.cache_size) {
+		chunk_appendf(&trash, "51Degrees cache is disabled.\n");
+		goto end;
+	}
+
+	chunk_appendf(&trash, "# thread lookups hits hit_ratio (size %d per thread)\n",
+	              global_51degrees.cache_size);
+	for (thr = 0; thr < global.nbthread; thr++) {
+		lookups += _51d_cache_ctr[thr].lookups;
+		hits += _51d_cache_ctr[thr].hits;
+		chunk_appendf(&trash, "%d %llu %llu %llu%%\n", thr + 1,
+		              _51d_cache_ctr[thr].lookups, _51d_cache_ctr[thr].hits,
+		              _51d_cache_ctr[thr].lookups ? _51d_cache_ctr[thr].hits * 100 / _51d_cache_ctr[thr].lookups : 0);
+	}
+	chunk_appendf(&trash, "total %llu %llu %llu%%\n", lookups, hits,
+	              lookups ? hits * 100 / lookups : 0);
+ end:
+	if (applet_putchk(appctx, &trash) == -1)
+		return 0;
+	return 1;
+}
+
+static struct cli_kw_list _51d_cli_kws = {{ }, {
+	{ { "show", "51degrees", "cache", NULL }, "show 51degrees cache                    : show the 51Degrees results cache usage", NULL, _51d_cli_io_show_cache, NULL },
+	{ { NULL }, NULL, NULL, NULL }
+}};
+
+INITCALL1(STG_REGISTER, cli_register_kw, &_51d_cli_kws);
+#endif
+
 #ifdef FIFTYONE_DEGREES_HASH_INCLUDED
 static int init_51degrees_per_thread()
 {
@@ -1157,6 +1211,8 @@ REGISTER_POST_CHECK(init_51degrees);
 REGISTER_POST_DEINIT(deinit_51degrees);
 
 #if defined(FIFTYONEDEGREES_H_PATTERN_INCLUDED)
+	REGISTER_PER_THREAD_ALLOC(_51d_alloc_cache);
+	REGISTER_PER_THREAD_FREE(_51d_free_cache);
 #ifndef FIFTYONEDEGREES_DUMMY_LIB
 	REGISTER_BUILD_OPTS("Built with 51Degrees Pattern support.");
 #else
@@ -3,9 +3,12 @@
 #include <sys/mman.h>
 #include <errno.h>
 
+#include <import/lru.h>
 #include <haproxy/api.h>
+#include <haproxy/applet.h>
 #include <haproxy/arg.h>
 #include <haproxy/cfgparse.h>
+#include <haproxy/cli.h>
 #include <haproxy/errors.h>
 #include <haproxy/global.h>
 #include <haproxy/http.h>
@@ -15,6 +18,7 @@
 #include <haproxy/htx.h>
 #include <haproxy/sample.h>
 #include <haproxy/tools.h>
+#include <haproxy/xxhash.h>
 #include <dac.h>
 
 #define ATLASTOKSZ PATH_MAX
@@ -27,6 +31,7 @@ static struct {
 	char *cookiename;
 	size_t cookienamelen;
 	int atlasfd;
+	int cache_size;
 	da_atlas_t atlas;
 	da_evidence_id_t useragentid;
 	da_severity_t loglevel;
@@ -39,6 +44,7 @@ static struct {
 	.cookienamelen = 0,
 	.atlasmap = NULL,
 	.atlasfd = -1,
+	.cache_size = 0,
 	.useragentid = 0,
 	.daset = 0,
 	.separator = '|',
@@ -46,6 +52,20 @@ static struct {
 
 __decl_thread(HA_SPINLOCK_T dadwsch_lock);
 
+/* Each thread has its own results cache so that lookups never need locking.
+ * Entries are tagged with the generation of the atlas which produced them so
+ * that a data file update invalidates them.
+ */
+static THREAD_LOCAL struct lru64_head *da_lru_tree = NULL;
+static unsigned long long da_lru_seed;
+static unsigned int da_atlas_gen;
+
+/* per-thread counters of the results cache, reported on the CLI */
+static struct {
+	unsigned long long lookups;
+	unsigned long long hits;
+} THREAD_ALIGNED(64) da_cache_ctr[MAX_THREADS];
+
 static int da_json_file(char **args, int section_type, struct proxy *curpx,
                         const struct proxy *defpx, const char *file, int line,
                         char **err)
@@ -104,6 +124,23 @@ static int da_properties_cookie(char **args, int section_type, struct proxy *cur
 	return 0;
 }
 
+static int da_cache_size(char **args, int section_type, struct proxy *curpx,
+                         const struct proxy *defpx, const char *file, int line,
+                         char **err)
+{
+	if (*(args[1]) == 0) {
+		memprintf(err, "deviceatlas cache size : expects an integer argument.\n");
+		return -1;
+	}
+
+	global_deviceatlas.cache_size = atoi(args[1]);
+	if (global_deviceatlas.cache_size < 0) {
+		memprintf(err, "deviceatlas cache size : expects a positive integer, %s given.\n", args[1]);
+		return -1;
+	}
+	return 0;
+}
+
 static size_t da_haproxy_read(void *ctx, size_t len, char *buf)
 {
 	return fread(buf, 1, len, ctx);
@@ -185,6 +222,7 @@ static int init_deviceatlas(void)
 				fprintf(stdout, "Deviceatlas : scheduling support enabled.\n");
 			}
 		}
+		da_lru_seed = ha_random();
 		global_deviceatlas.daset = 1;
 
 		fprintf(stdout, "Deviceatlas module loaded.\n");
@@ -240,6 +278,7 @@ static void da_haproxy_checkinst(void)
 					free(global_deviceatlas.atlasimgptr);
 					global_deviceatlas.atlasimgptr = cnew;
 					global_deviceatlas.atlas = inst;
+					_HA_ATOMIC_INC(&da_atlas_gen);
 					memset(base, 0, ATLASTOKSZ);
 					jsond = da_getdatacreation(&global_deviceatlas.atlas);
 					ctime_r(&jsond, jsonbuf);
@@ -258,6 +297,73 @@ static void da_haproxy_checkinst(void)
 	}
 }
 
+static void da_lru_free(void *cache_entry)
+{
+	struct buffer *ptr = cache_entry;
+
+	if (!ptr)
+		return;
+
+	free(ptr->area);
+	free(ptr);
+}
+
+/* Looks up the results cache for <key> in the domain of the keyword's
+ * arguments <args>. On hit, the sample is set to the cached result and NULL is
+ * returned with <hit> set. Otherwise the entry to commit the result to once
+ * known is returned, or NULL if the cache is disabled or busy.
+ */
+static struct lru64 *da_cache_lookup(const struct arg *args, struct sample *smp,
+                                     unsigned long long key, int *hit)
+{
+	struct buffer *cache_entry;
+	struct lru64 *lru;
+
+	*hit = 0;
+	if (!da_lru_tree)
+		return NULL;
+
+	da_cache_ctr[tid].lookups++;
+	lru = lru64_get(key, da_lru_tree, (void *)args, HA_ATOMIC_LOAD(&da_atlas_gen));
+	if (lru && lru->domain) {
+		da_cache_ctr[tid].hits++;
+		cache_entry = lru->data;
+		smp->data.u.str.area = cache_entry->area;
+		smp->data.u.str.data = cache_entry->data;
+		smp->data.type = SMP_T_STR;
+		smp->flags |= SMP_F_CONST;
+		*hit = 1;
+		return NULL;
+	}
+	return lru;
+}
+
+/* Stores a copy of the result held in sample <smp> into the cache entry <lru>
+ * returned by da_cache_lookup(). Nothing is done if <lru> is NULL.
+ */
+static void da_cache_store(const struct arg *args, struct sample *smp, struct lru64 *lru)
+{
+	struct buffer *cache_entry;
+
+	if (!lru)
+		return;
+
+	cache_entry = malloc(sizeof(*cache_entry));
+	if (!cache_entry)
+		return;
+
+	cache_entry->area = malloc(smp->data.u.str.data + 1);
+	if (!cache_entry->area) {
+		free(cache_entry);
+		return;
+	}
+
+	memcpy(cache_entry->area, smp->data.u.str.area, smp->data.u.str.data);
+	cache_entry->area[smp->data.u.str.data] = 0;
+	cache_entry->data = smp->data.u.str.data;
+	lru64_commit(lru, cache_entry, (void *)args, HA_ATOMIC_LOAD(&da_atlas_gen), da_lru_free);
+}
+
 static int da_haproxy(const struct arg *args, struct sample *smp, da_deviceinfo_t *devinfo)
 {
 	struct buffer *tmp;
@@ -337,7 +443,8 @@ static int da_haproxy_conv(const struct arg *args, struct sample *smp, void *pri
 	da_status_t status;
 	const char *useragent;
 	char useragentbuf[1024] = { 0 };
-	int i;
+	struct lru64 *lru;
+	int i, hit;
 
 	if (global_deviceatlas.daset == 0 || smp->data.u.str.data == 0) {
 		return 1;
@@ -345,6 +452,11 @@ static int da_haproxy_conv(const struct arg *args, struct sample *smp, void *pri
 
 	da_haproxy_checkinst();
 
+	lru = da_cache_lookup(args, smp, XXH3(smp->data.u.str.area, smp->data.u.str.data,
+	                                      da_lru_seed ^ (long)args), &hit);
+	if (hit)
+		return 1;
+
 	i = smp->data.u.str.data > sizeof(useragentbuf) ? sizeof(useragentbuf) : smp->data.u.str.data;
 	memcpy(useragentbuf, smp->data.u.str.area, i - 1);
 	useragentbuf[i - 1] = 0;
@@ -354,7 +466,11 @@ static int da_haproxy_conv(const struct arg *args, struct sample *smp, void *pri
 	status = da_search(&global_deviceatlas.atlas, &devinfo,
 		global_deviceatlas.useragentid, useragent, 0);
 
-	return status != DA_OK ? 0 : da_haproxy(args, smp, &devinfo);
+	if (status != DA_OK || !da_haproxy(args, smp, &devinfo))
+		return 0;
+
+	da_cache_store(args, smp, lru);
+	return 1;
 }
 
 #define DA_MAX_HEADERS       24
@@ -368,7 +484,9 @@ static int da_haproxy_fetch(const struct arg *args, struct sample *smp, const ch
 	struct htx *htx;
 	struct htx_blk *blk;
 	char vbuf[DA_MAX_HEADERS][1024] = {{ 0 }};
-	int i, nbh = 0;
+	unsigned long long key;
+	struct lru64 *lru;
+	int i, hit, nbh = 0;
 
 	if (global_deviceatlas.daset == 0) {
 		return 0;
@@ -452,17 +570,87 @@ static int da_haproxy_fetch(const struct arg *args, struct sample *smp, const ch
 		++ nbh;
 	}
 
+	/* the evidences are collected in the message's order */
+	key = da_lru_seed ^ (long)args;
+	for (i = 0; i < nbh; i++)
+		key = XXH3(ev[i].value, strlen(ev[i].value), key + ev[i].key);
+
+	lru = da_cache_lookup(args, smp, key, &hit);
+	if (hit)
+		return 1;
+
 	status = da_searchv(&global_deviceatlas.atlas, &devinfo,
 			ev, nbh);
 
-	return status != DA_OK ? 0 : da_haproxy(args, smp, &devinfo);
+	if (status != DA_OK || !da_haproxy(args, smp, &devinfo))
+		return 0;
+
+	da_cache_store(args, smp, lru);
+	return 1;
+}
+
+/* allocates the calling thread's results cache. Returns 0 on failure. */
+static int da_alloc_cache(void)
+{
+	if (!global_deviceatlas.daset || !global_deviceatlas.cache_size)
+		return 1;
+
+	da_lru_tree = lru64_new(global_deviceatlas.cache_size);
+	return !!da_lru_tree;
 }
 
+/* releases the calling thread's results cache */
+static void da_free_cache(void)
+{
+	if (da_lru_tree)
+		while (lru64_destroy(da_lru_tree));
+	da_lru_tree = NULL;
+}
+
+/* dumps the results cache usage on the CLI, one line per thread followed by
+ * the totals. Returns 0 if the output buffer is full, otherwise 1.
+ */
+static int da_cli_io_show_cache(struct appctx *appctx)
+{
+	unsigned long long lookups = 0, hits = 0;
+	int thr;
+
+	chunk_reset(&trash);
+	if (!global_deviceatlas.cache_size) {
+		chunk_appendf(&trash, "DeviceAtlas cache is disabled.\n");
+		goto end;
+	}
+
+	chunk_appendf(&trash, "# thread lookups hits hit_ratio (size %d per thread)\n",
+	              global_deviceatlas.cache_size);
+	for (thr = 0; thr < global.nbthread; thr++) {
+		lookups += da_cache_ctr[thr].lookups;
+		hits += da_cache_ctr[thr].hits;
+		chunk_appendf(&trash, "%d %llu %llu %llu%%\n", thr + 1,
+		              da_cache_ctr[thr].lookups, da_cache_ctr[thr].hits,
+		              da_cache_ctr[thr].lookups ? da_cache_ctr[thr].hits * 100 / da_cache_ctr[thr].lookups : 0);
+	}
+	chunk_appendf(&trash, "total %llu %llu %llu%%\n", lookups, hits,
+	              lookups ? hits * 100 / lookups : 0);
+ end:
+	if (applet_putchk(appctx, &trash) == -1)
+		return 0;
+	return 1;
+}
+
+static struct cli_kw_list da_cli_kws = {{ }, {
+	{ { "show", "deviceatlas", "cache", NULL }, "show deviceatlas cache                  : show the DeviceAtlas results cache usage", NULL, da_cli_io_show_cache, NULL },
+	{ { NULL }, NULL, NULL, NULL }
+}};
+
+INITCALL1(STG_REGISTER, cli_register_kw, &da_cli_kws);
+
 static struct cfg_kw_list dacfg_kws = {{ }, {
 	{ CFG_GLOBAL, "deviceatlas-json-file",	  da_json_file },
 		{ CFG_GLOBAL, "deviceatlas-log-level",	  da_log_level },
 		{ CFG_GLOBAL, "deviceatlas-property-separator", da_property_separator },
 		{ CFG_GLOBAL, "deviceatlas-properties-cookie", da_properties_cookie },
+		{ CFG_GLOBAL, "deviceatlas-cache-size", da_cache_size },
 		{ 0, NULL, NULL },
 }};
 
@@ -498,4 +686,6 @@ INITCALL1(STG_REGISTER, sample_register_convs, &conv_kws);
 
 REGISTER_POST_CHECK(init_deviceatlas);
 REGISTER_POST_DEINIT(deinit_deviceatlas);
+REGISTER_PER_THREAD_ALLOC(da_alloc_cache);
+REGISTER_PER_THREAD_FREE(da_free_cache);
 INITCALL0(STG_REGISTER, da_haproxy_register_build_options);
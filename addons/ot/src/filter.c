@@ -27,6 +27,12 @@
  */
 const char *ot_flt_id = "the OpenTracing filter";
 
+/*
+ * Seed mixed with the stream's unique ID to decide whether a stream is traced
+ * or not.  See flt_ot_attach().
+ */
+static uint32_t flt_ot_sampling_seed = 0;
+
 
 /***
  * NAME
@@ -166,6 +172,9 @@ static int flt_ot_init(struct proxy *p, struct flt_conf *fconf)
 
 	flt_ot_cli_init();
 
+	if (flt_ot_sampling_seed == 0)
+		flt_ot_sampling_seed = ha_random32() | 1;
+
 	/*
 	 * Initialize the OpenTracing library.
 	 */
@@ -522,20 +531,31 @@ static void flt_ot_deinit_per_thread(struct proxy *p, struct flt_conf *fconf)
 static int flt_ot_attach(struct stream *s, struct filter *f)
 {
 	const struct flt_ot_conf *conf = FLT_OT_CONF(f);
+	uint32_t                  rate_limit;
 	char                     *err = NULL;
 
 	FLT_OT_FUNC("%p, %p", s, f);
 
+	rate_limit = _HA_ATOMIC_LOAD(&(conf->tracer->rate_limit));
+
 	if (conf->tracer->flag_disabled) {
 		FLT_OT_DBG(2, "filter '%s', type: %s (disabled)", conf->id, flt_ot_type(f));
 
 		FLT_OT_RETURN_INT(FLT_OT_RET_IGNORE);
 	}
-	else if (conf->tracer->rate_limit < FLT_OT_FLOAT_U32(FLT_OT_RATE_LIMIT_MAX, FLT_OT_RATE_LIMIT_MAX)) {
-		uint32_t rnd = ha_random32();
+	else if (rate_limit < FLT_OT_FLOAT_U32(FLT_OT_RATE_LIMIT_MAX, FLT_OT_RATE_LIMIT_MAX)) {
+		/*
+		 * The sampling decision is derived from the stream's unique
+		 * ID instead of a random value.  This way all the filters
+		 * attached to the same stream (those of the frontend and of
+		 * the backend) agree on it and an unsampled stream never
+		 * gets a partial trace, and no shared random generator
+		 * state has to be updated for each stream.
+		 */
+		uint32_t rnd = full_hash(s->uniq_id ^ flt_ot_sampling_seed);
 
-		if (conf->tracer->rate_limit <= rnd) {
-			FLT_OT_DBG(2, "filter '%s', type: %s (ignored: %u <= %u)", conf->id, flt_ot_type(f), conf->tracer->rate_limit, rnd);
+		if (rate_limit <= rnd) {
+			FLT_OT_DBG(2, "filter '%s', type: %s (ignored: %u <= %u)", conf->id, flt_ot_type(f), rate_limit, rnd);
 
 			FLT_OT_RETURN_INT(FLT_OT_RET_IGNORE);
 		}
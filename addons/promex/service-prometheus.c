@@ -14,6 +14,7 @@
  */
 
 #include <haproxy/action-t.h>
+#include <haproxy/activity.h>
 #include <haproxy/api.h>
 #include <haproxy/applet.h>
 #include <haproxy/backend.h>
@@ -57,6 +58,7 @@ enum {
 	PROMEX_DUMPER_LI,         /* dump metrics of listeners */
 	PROMEX_DUMPER_SRV,        /* dump metrics of servers */
 	PROMEX_DUMPER_STICKTABLE, /* dump metrics of stick tables */
+	PROMEX_DUMPER_PROFILING,  /* dump CPU time samples */
 	PROMEX_DUMPER_DONE,       /* finished */
 };
 
@@ -75,10 +77,13 @@ enum {
 #define PROMEX_FL_SCOPE_LI          0x00000800
 #define PROMEX_FL_SCOPE_STICKTABLE  0x00001000
 #define PROMEX_FL_NO_MAINT_SRV      0x00002000
+#define PROMEX_FL_PROFILING_METRIC  0x00004000
+#define PROMEX_FL_SCOPE_PROFILING   0x00008000
 
 #define PROMEX_FL_SCOPE_ALL (PROMEX_FL_SCOPE_GLOBAL | PROMEX_FL_SCOPE_FRONT | \
 			     PROMEX_FL_SCOPE_LI | PROMEX_FL_SCOPE_BACK | \
-			     PROMEX_FL_SCOPE_SERVER | PROMEX_FL_SCOPE_STICKTABLE)
+			     PROMEX_FL_SCOPE_SERVER | PROMEX_FL_SCOPE_STICKTABLE | \
+			     PROMEX_FL_SCOPE_PROFILING)
 
 /* the context of the applet */
 struct promex_ctx {
@@ -89,8 +94,50 @@ struct promex_ctx {
 	unsigned int flags;	   /* PROMEX_FL_* */
 	unsigned field_num;        /* current field number (ST_F_* etc) */
 	int obj_state;             /* current state among PROMEX_{FRONT|BACK|SRV|LI}_STATE_* */
+	char *metrics;             /* comma-separated list of requested metrics, or NULL for all */
+	struct promex_cache *cache; /* cache entry being filled by this dump, or NULL */
+	struct promex_snap *snap;  /* snapshot being filled (cache set) or sent (cache unset) */
+	unsigned int snap_ofs;     /* current offset in the sent snapshot */
+	struct prof_sample *samples; /* CPU time samples being dumped (index in obj_state), or NULL */
 };
 
+/* A snapshot of a complete dump, as sent in the payload. It is shared by all
+ * the applets sending it and by its cache entry, and released by the last
+ * one. All its fields are protected by the cache lock (promex_cache_lock).
+ */
+struct promex_snap {
+	unsigned int refcnt;       /* number of users of this snapshot */
+	unsigned int date;         /* date the dump finished (now_ms) */
+	size_t len;                /* length of the dump */
+	size_t size;               /* allocated size of <area> */
+	char *area;                /* the dump */
+};
+
+/* A cache entry: the last snapshot produced for a given set of scopes and
+ * metrics. Entries are never released before deinit, and there are at most
+ * PROMEX_MAX_CACHE_ENTRIES of them. All fields are protected by the cache
+ * lock.
+ */
+struct promex_cache {
+	struct list list;          /* element of promex_caches */
+	unsigned int flags;        /* PROMEX_FL_SCOPE_* and PROMEX_FL_NO_MAINT_SRV */
+	char *metrics;             /* the list of requested metrics, or NULL */
+	struct promex_snap *snap;  /* last complete snapshot, or NULL */
+	int filling;               /* non-zero while an applet fills a new snapshot */
+};
+
+/* Configuration of a prometheus-exporter rule (rule->arg.act.p[0]) */
+struct promex_conf {
+	unsigned int cache_ttl;    /* cache lifetime in ms, 0 = no cache */
+};
+
+/* The max number of distinct cache entries */
+#define PROMEX_MAX_CACHE_ENTRIES 16
+
+static struct list promex_caches = LIST_HEAD_INIT(promex_caches);
+static int promex_nb_caches = 0;
+__decl_spinlock(promex_cache_lock);
+
 /* Promtheus metric type (gauge or counter) */
 enum promex_mt_type {
 	PROMEX_MT_GAUGE   = 1,
@@ -302,6 +349,7 @@ const struct promex_metric promex_st_metrics[ST_F_TOTAL_FIELDS] = {
 	[ST_F_NEED_CONN_EST]        = { .n = IST("need_connections_current"),         .type = PROMEX_MT_GAUGE,    .flags = (                                                                       PROMEX_FL_SRV_METRIC) },
 	[ST_F_UWEIGHT]              = { .n = IST("uweight"),                          .type = PROMEX_MT_GAUGE,    .flags = (                                               PROMEX_FL_BACK_METRIC | PROMEX_FL_SRV_METRIC) },
 	[ST_F_AGG_SRV_CHECK_STATUS] = { .n = IST("agg_server_check_status"),	      .type = PROMEX_MT_GAUGE,    .flags = (                                               PROMEX_FL_BACK_METRIC                       ) },
+	[ST_F_HTX_DEFRAG]           = { .n = IST("http_htx_defrags_total"),           .type = PROMEX_MT_COUNTER,  .flags = (PROMEX_FL_FRONT_METRIC |                       PROMEX_FL_BACK_METRIC                       ) },
 };
 
 /* Description of overridden stats fields */
@@ -339,6 +387,22 @@ const struct ist promex_sticktable_metric_desc[STICKTABLE_TOTAL_FIELDS] = {
 	[STICKTABLE_USED] = IST("Number of entries used in this stick table."),
 };
 
+/* CPU time sampling fields */
+enum profiling_field {
+	PROFILING_CPU_SAMPLES = 0,
+	/* must always be the last one */
+	PROFILING_TOTAL_FIELDS
+};
+
+const struct promex_metric promex_profiling_metrics[PROFILING_TOTAL_FIELDS] = {
+	[PROFILING_CPU_SAMPLES] = { .n = IST("cpu_samples_total"), .type = PROMEX_MT_COUNTER, .flags = PROMEX_FL_PROFILING_METRIC },
+};
+
+/* CPU time sampling description */
+const struct ist promex_profiling_metric_desc[PROFILING_TOTAL_FIELDS] = {
+	[PROFILING_CPU_SAMPLES] = IST("Total number of CPU time samples taken in this call stack (folded, task handler first) since sampling was enabled."),
+};
+
 /* Specific labels for all ST_F_HRSP_* fields */
 const struct ist promex_hrsp_code[1 + ST_F_HRSP_OTHER - ST_F_HRSP_1XX] = {
 	[ST_F_HRSP_1XX - ST_F_HRSP_1XX]   = IST("1xx"),
@@ -463,6 +527,8 @@ static int promex_dump_metric_header(struct appctx *appctx, struct htx *htx,
 		desc = ist(info_fields[ctx->field_num].desc);
 	else if (metric->flags & PROMEX_FL_STICKTABLE_METRIC)
 		desc = promex_sticktable_metric_desc[ctx->field_num];
+	else if (metric->flags & PROMEX_FL_PROFILING_METRIC)
+		desc = promex_profiling_metric_desc[ctx->field_num];
 	else if (!isttest(promex_st_metric_desc[ctx->field_num]))
 		desc = ist(stat_fields[ctx->field_num].desc);
 	else
@@ -551,6 +617,192 @@ static int promex_dump_metric(struct appctx *appctx, struct htx *htx, struct ist
 }
 
 
+/* Returns non-zero if the metric <metric> with the prefix <prefix> must be
+ * dumped according to the "metric" parameters of the query-string. All
+ * metrics are dumped if there is none.
+ */
+static int promex_metric_wanted(const struct promex_ctx *ctx, const struct ist prefix,
+				const struct promex_metric *metric)
+{
+	const char *p = ctx->metrics;
+	const char *end;
+
+	if (!p)
+		return 1;
+
+	while (*p) {
+		end = strchr(p, ',');
+		if (!end)
+			end = p + strlen(p);
+		if (end - p == prefix.len + metric->n.len &&
+		    memcmp(p, istptr(prefix), prefix.len) == 0 &&
+		    memcmp(p + prefix.len, istptr(metric->n), metric->n.len) == 0)
+			return 1;
+		p = *end ? end + 1 : end;
+	}
+	return 0;
+}
+
+/* Releases the snapshot <snap> if it has no more user. Must be called with the
+ * cache lock held.
+ */
+static void promex_snap_release(struct promex_snap *snap)
+{
+	if (!snap || --snap->refcnt)
+		return;
+	ha_free(&snap->area);
+	free(snap);
+}
+
+/* Adds <out> to the payload in <htx>, and to the snapshot being filled if
+ * any. If the snapshot cannot be extended, it is abandoned, the dump being
+ * sent anyway. Returns 0 if the data cannot be added to <htx>, otherwise
+ * non-zero.
+ */
+static int promex_add_data(struct appctx *appctx, struct htx *htx, const struct ist out)
+{
+	struct promex_ctx *ctx = appctx->svcctx;
+	struct promex_snap *snap = ctx->snap;
+
+	if (!htx_add_data_atonce(htx, out))
+		return 0;
+
+	if (!ctx->cache)
+		return 1;
+
+	if (snap->len + out.len > snap->size) {
+		size_t size = snap->size ? snap->size : global.tune.bufsize;
+		char *area;
+
+		while (size < snap->len + out.len)
+			size *= 2;
+
+		area = realloc(snap->area, size);
+		if (!area) {
+			HA_SPIN_LOCK(OTHER_LOCK, &promex_cache_lock);
+			ctx->cache->filling = 0;
+			promex_snap_release(snap);
+			HA_SPIN_UNLOCK(OTHER_LOCK, &promex_cache_lock);
+			ctx->cache = NULL;
+			ctx->snap = NULL;
+			return 1;
+		}
+		snap->area = area;
+		snap->size = size;
+	}
+	memcpy(snap->area + snap->len, istptr(out), out.len);
+	snap->len += out.len;
+	return 1;
+}
+
+/* Looks up the cache entry matching the scopes and metrics requested in the
+ * context of <appctx>, and creates it if needed and possible. If it holds a
+ * snapshot younger than <ttl> milliseconds, or if another applet is already
+ * filling a new one, the current snapshot is attached to the applet to be
+ * sent instead of dumping the metrics. Otherwise, a new snapshot is attached
+ * to be filled by the dump. Nothing is done if no entry is available, or if
+ * no snapshot may be sent while another applet is filling the first one.
+ */
+static void promex_cache_attach(struct appctx *appctx, unsigned int ttl)
+{
+	struct promex_ctx *ctx = appctx->svcctx;
+	struct promex_cache *cache;
+	struct promex_snap *snap = NULL;
+	unsigned int flags = ctx->flags & (PROMEX_FL_SCOPE_ALL | PROMEX_FL_NO_MAINT_SRV);
+
+	HA_SPIN_LOCK(OTHER_LOCK, &promex_cache_lock);
+	list_for_each_entry(cache, &promex_caches, list) {
+		if (cache->flags == flags &&
+		    (cache->metrics == ctx->metrics ||
+		     (cache->metrics && ctx->metrics && strcmp(cache->metrics, ctx->metrics) == 0)))
+			goto found;
+	}
+
+	if (promex_nb_caches >= PROMEX_MAX_CACHE_ENTRIES)
+		goto end;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		goto end;
+	if (ctx->metrics) {
+		cache->metrics = strdup(ctx->metrics);
+		if (!cache->metrics) {
+			free(cache);
+			goto end;
+		}
+	}
+	cache->flags = flags;
+	LIST_APPEND(&promex_caches, &cache->list);
+	promex_nb_caches++;
+
+  found:
+	if (cache->snap &&
+	    (cache->filling || tick_is_lt(now_ms, tick_add(cache->snap->date, ttl)))) {
+		/* send the current snapshot */
+		cache->snap->refcnt++;
+		ctx->snap = cache->snap;
+		ctx->snap_ofs = 0;
+		goto end;
+	}
+
+	if (cache->filling)
+		goto end;
+
+	snap = calloc(1, sizeof(*snap));
+	if (!snap)
+		goto end;
+	snap->refcnt = 1;
+	cache->filling = 1;
+	ctx->cache = cache;
+	ctx->snap = snap;
+  end:
+	HA_SPIN_UNLOCK(OTHER_LOCK, &promex_cache_lock);
+}
+
+/* Publishes the snapshot filled by <appctx> in its cache entry, replacing the
+ * previous one.
+ */
+static void promex_cache_publish(struct appctx *appctx)
+{
+	struct promex_ctx *ctx = appctx->svcctx;
+
+	HA_SPIN_LOCK(OTHER_LOCK, &promex_cache_lock);
+	promex_snap_release(ctx->cache->snap);
+	ctx->snap->date = now_ms;
+	ctx->cache->snap = ctx->snap;
+	ctx->cache->filling = 0;
+	HA_SPIN_UNLOCK(OTHER_LOCK, &promex_cache_lock);
+	ctx->cache = NULL;
+	ctx->snap = NULL;
+}
+
+/* Sends the snapshot attached to <appctx>. It returns 1 on success and 0 if
+ * <htx> is full.
+ */
+static int promex_dump_snap(struct appctx *appctx, struct stconn *sc, struct htx *htx)
+{
+	struct promex_ctx *ctx = appctx->svcctx;
+	struct promex_snap *snap = ctx->snap;
+	struct channel *chn = sc_ic(sc);
+	size_t len;
+
+	while (ctx->snap_ofs < snap->len) {
+		len = htx_get_max_blksz(htx, channel_htx_recv_max(chn, htx));
+		if (!len)
+			goto full;
+		if (len > snap->len - ctx->snap_ofs)
+			len = snap->len - ctx->snap_ofs;
+		if (!htx_add_data_atonce(htx, ist2(snap->area + ctx->snap_ofs, len)))
+			goto full;
+		channel_add_input(chn, len);
+		ctx->snap_ofs += len;
+	}
+	return 1;
+  full:
+	sc_need_room(sc);
+	return 0;
+}
+
 /* Dump global metrics (prefixed by "haproxy_process_"). It returns 1 on success,
  * 0 if <htx> is full and -1 in case of any error. */
 static int promex_dump_global_metrics(struct appctx *appctx, struct htx *htx)
@@ -569,7 +821,8 @@ static int promex_dump_global_metrics(struct appctx *appctx, struct htx *htx)
 	for (; ctx->field_num < INF_TOTAL_FIELDS; ctx->field_num++) {
 		struct promex_label labels[PROMEX_MAX_LABELS-1] = {};
 
-		if (!(promex_global_metrics[ctx->field_num].flags & ctx->flags))
+		if (!(promex_global_metrics[ctx->field_num].flags & ctx->flags) ||
+		    !promex_metric_wanted(ctx, prefix, &promex_global_metrics[ctx->field_num]))
 			continue;
 
 		switch (ctx->field_num) {
@@ -592,7 +845,7 @@ static int promex_dump_global_metrics(struct appctx *appctx, struct htx *htx)
 
   end:
 	if (out.len) {
-		if (!htx_add_data_atonce(htx, out))
+		if (!promex_add_data(appctx, htx, out))
 			return -1; /* Unexpected and unrecoverable error */
 		channel_add_input(chn, out.len);
 	}
@@ -618,7 +871,8 @@ static int promex_dump_front_metrics(struct appctx *appctx, struct htx *htx)
 	enum promex_front_state state;
 
 	for (;ctx->field_num < ST_F_TOTAL_FIELDS; ctx->field_num++) {
-		if (!(promex_st_metrics[ctx->field_num].flags & ctx->flags))
+		if (!(promex_st_metrics[ctx->field_num].flags & ctx->flags) ||
+		    !promex_metric_wanted(ctx, prefix, &promex_st_metrics[ctx->field_num]))
 			continue;
 
 		while (ctx->px) {
@@ -654,6 +908,7 @@ static int promex_dump_front_metrics(struct appctx *appctx, struct htx *htx)
 				case ST_F_INTERCEPTED:
 				case ST_F_CACHE_LOOKUPS:
 				case ST_F_CACHE_HITS:
+				case ST_F_HTX_DEFRAG:
 				case ST_F_COMP_IN:
 				case ST_F_COMP_OUT:
 				case ST_F_COMP_BYP:
@@ -693,7 +948,7 @@ static int promex_dump_front_metrics(struct appctx *appctx, struct htx *htx)
 
   end:
 	if (out.len) {
-		if (!htx_add_data_atonce(htx, out))
+		if (!promex_add_data(appctx, htx, out))
 			return -1; /* Unexpected and unrecoverable error */
 		channel_add_input(chn, out.len);
 	}
@@ -720,7 +975,8 @@ static int promex_dump_listener_metrics(struct appctx *appctx, struct htx *htx)
 	enum li_status status;
 
 	for (;ctx->field_num < ST_F_TOTAL_FIELDS; ctx->field_num++) {
-		if (!(promex_st_metrics[ctx->field_num].flags & ctx->flags))
+		if (!(promex_st_metrics[ctx->field_num].flags & ctx->flags) ||
+		    !promex_metric_wanted(ctx, prefix, &promex_st_metrics[ctx->field_num]))
 			continue;
 
 		while (ctx->px) {
@@ -783,7 +1039,7 @@ static int promex_dump_listener_metrics(struct appctx *appctx, struct htx *htx)
 
   end:
 	if (out.len) {
-		if (!htx_add_data_atonce(htx, out))
+		if (!promex_add_data(appctx, htx, out))
 			return -1; /* Unexpected and unrecoverable error */
 		channel_add_input(chn, out.len);
 	}
@@ -813,7 +1069,8 @@ static int promex_dump_back_metrics(struct appctx *appctx, struct htx *htx)
 	enum promex_srv_state srv_state;
 
 	for (;ctx->field_num < ST_F_TOTAL_FIELDS; ctx->field_num++) {
-		if (!(promex_st_metrics[ctx->field_num].flags & ctx->flags))
+		if (!(promex_st_metrics[ctx->field_num].flags & ctx->flags) ||
+		    !promex_metric_wanted(ctx, prefix, &promex_st_metrics[ctx->field_num]))
 			continue;
 
 		while (ctx->px) {
@@ -899,6 +1156,7 @@ static int promex_dump_back_metrics(struct appctx *appctx, struct htx *htx)
 				case ST_F_REQ_TOT:
 				case ST_F_CACHE_LOOKUPS:
 				case ST_F_CACHE_HITS:
+				case ST_F_HTX_DEFRAG:
 				case ST_F_COMP_IN:
 				case ST_F_COMP_OUT:
 				case ST_F_COMP_BYP:
@@ -938,7 +1196,7 @@ static int promex_dump_back_metrics(struct appctx *appctx, struct htx *htx)
 
   end:
 	if (out.len) {
-		if (!htx_add_data_atonce(htx, out))
+		if (!promex_add_data(appctx, htx, out))
 			return -1; /* Unexpected and unrecoverable error */
 		channel_add_input(chn, out.len);
 	}
@@ -967,7 +1225,8 @@ static int promex_dump_srv_metrics(struct appctx *appctx, struct htx *htx)
 	const char *check_state;
 
 	for (;ctx->field_num < ST_F_TOTAL_FIELDS; ctx->field_num++) {
-		if (!(promex_st_metrics[ctx->field_num].flags & ctx->flags))
+		if (!(promex_st_metrics[ctx->field_num].flags & ctx->flags) ||
+		    !promex_metric_wanted(ctx, prefix, &promex_st_metrics[ctx->field_num]))
 			continue;
 
 		while (ctx->px) {
@@ -1110,7 +1369,7 @@ static int promex_dump_srv_metrics(struct appctx *appctx, struct htx *htx)
 
   end:
 	if (out.len) {
-		if (!htx_add_data_atonce(htx, out))
+		if (!promex_add_data(appctx, htx, out))
 			return -1; /* Unexpected and unrecoverable error */
 		channel_add_input(chn, out.len);
 	}
@@ -1134,7 +1393,8 @@ static int promex_dump_sticktable_metrics(struct appctx *appctx, struct htx *htx
 	struct stktable *t;
 
 	for (; ctx->field_num < STICKTABLE_TOTAL_FIELDS; ctx->field_num++) {
-		if (!(promex_sticktable_metrics[ctx->field_num].flags & ctx->flags))
+		if (!(promex_sticktable_metrics[ctx->field_num].flags & ctx->flags) ||
+		    !promex_metric_wanted(ctx, prefix, &promex_sticktable_metrics[ctx->field_num]))
 			continue;
 
 		while (ctx->st) {
@@ -1173,7 +1433,71 @@ static int promex_dump_sticktable_metrics(struct appctx *appctx, struct htx *htx
 
   end:
 	if (out.len) {
-		if (!htx_add_data_atonce(htx, out))
+		if (!promex_add_data(appctx, htx, out))
+			return -1; /* Unexpected and unrecoverable error */
+		channel_add_input(chn, out.len);
+	}
+	return ret;
+  full:
+	ret = 0;
+	goto end;
+}
+
+/* Dump the CPU time samples collected by "profiling.samples", one metric per
+ * call stack, limited to the PROF_SAMPLE_EXPORT_MAX most frequent ones. The
+ * samples are collected on the first call and released once dumped. It
+ * returns 1 on success, 0 if <htx> is full and -1 in case of any error.
+ */
+static int promex_dump_profiling_metrics(struct appctx *appctx, struct htx *htx)
+{
+	static struct ist prefix = IST("haproxy_profiling_");
+	struct promex_ctx *ctx = appctx->svcctx;
+	struct field val;
+	struct channel *chn = sc_ic(appctx_sc(appctx));
+	struct ist out = ist2(trash.area, 0);
+	size_t max = htx_get_max_blksz(htx, channel_htx_recv_max(chn, htx));
+	struct buffer *stack = get_trash_chunk();
+	struct prof_sample *sample;
+	uint64_t lost;
+	int ret = 1;
+
+	for (; ctx->field_num < PROFILING_TOTAL_FIELDS; ctx->field_num++) {
+		if (!(promex_profiling_metrics[ctx->field_num].flags & ctx->flags) ||
+		    !promex_metric_wanted(ctx, prefix, &promex_profiling_metrics[ctx->field_num]))
+			continue;
+
+		/* the collected array is always terminated by an empty entry */
+		if (!ctx->samples && !ctx->obj_state &&
+		    prof_samples_collect(&ctx->samples, &lost) < 0)
+			goto next_field;
+
+		for (; ctx->obj_state < PROF_SAMPLE_EXPORT_MAX; ctx->obj_state++) {
+			struct promex_label labels[PROMEX_MAX_LABELS - 1] = {};
+
+			sample = &ctx->samples[ctx->obj_state];
+			if (!sample->count)
+				break;
+
+			chunk_reset(stack);
+			prof_sample_fold(stack, sample);
+			labels[0].name  = ist("stack");
+			labels[0].value = ist2(b_orig(stack), b_data(stack));
+			val = mkf_u64(FN_COUNTER, sample->count);
+
+			if (!promex_dump_metric(appctx, htx, prefix,
+						&promex_profiling_metrics[ctx->field_num],
+						&val, labels, &out, max))
+				goto full;
+		}
+	  next_field:
+		ctx->flags |= PROMEX_FL_METRIC_HDR;
+		ha_free(&ctx->samples);
+		ctx->obj_state = 0;
+	}
+
+  end:
+	if (out.len) {
+		if (!promex_add_data(appctx, htx, out))
 			return -1; /* Unexpected and unrecoverable error */
 		channel_add_input(chn, out.len);
 	}
@@ -1325,6 +1649,23 @@ static int promex_dump_metrics(struct appctx *appctx, struct stconn *sc, struct
 			ctx->li = NULL;
 			ctx->sv = NULL;
 			ctx->flags &= ~(PROMEX_FL_METRIC_HDR|PROMEX_FL_STICKTABLE_METRIC);
+			ctx->flags |= (PROMEX_FL_METRIC_HDR|PROMEX_FL_PROFILING_METRIC);
+			ctx->obj_state = 0;
+			ctx->field_num = PROFILING_CPU_SAMPLES;
+			appctx->st1 = PROMEX_DUMPER_PROFILING;
+			__fallthrough;
+
+		case PROMEX_DUMPER_PROFILING:
+			if (ctx->flags & PROMEX_FL_SCOPE_PROFILING) {
+				ret = promex_dump_profiling_metrics(appctx, htx);
+				if (ret <= 0) {
+					if (ret == -1)
+						goto error;
+					goto full;
+				}
+			}
+
+			ctx->flags &= ~(PROMEX_FL_METRIC_HDR|PROMEX_FL_PROFILING_METRIC);
 			ctx->field_num = 0;
 			appctx->st1 = PROMEX_DUMPER_DONE;
 			__fallthrough;
@@ -1440,11 +1781,20 @@ static int promex_parse_uri(struct appctx *appctx, struct stconn *sc)
 				ctx->flags |= PROMEX_FL_SCOPE_LI;
 			else if (strcmp(value, "sticktable") == 0)
 				ctx->flags |= PROMEX_FL_SCOPE_STICKTABLE;
+			else if (strcmp(value, "profiling") == 0)
+				ctx->flags |= PROMEX_FL_SCOPE_PROFILING;
 			else
 				goto error;
 		}
 		else if (strcmp(key, "no-maint") == 0)
 			ctx->flags |= PROMEX_FL_NO_MAINT_SRV;
+		else if (strcmp(key, "metric") == 0) {
+			if (!value || *value == 0)
+				goto error;
+			if (!memprintf(&ctx->metrics, "%s%s%s", ctx->metrics ? ctx->metrics : "",
+				       ctx->metrics ? "," : "", value))
+				goto error;
+		}
 	}
 
   end:
@@ -1500,6 +1850,24 @@ static int promex_appctx_init(struct appctx *appctx)
 	return 0;
 }
 
+/* Callback to release the promex applet context. An unfinished snapshot is
+ * abandoned.
+ */
+static void promex_appctx_release(struct appctx *appctx)
+{
+	struct promex_ctx *ctx = appctx->svcctx;
+
+	if (ctx->snap) {
+		HA_SPIN_LOCK(OTHER_LOCK, &promex_cache_lock);
+		if (ctx->cache)
+			ctx->cache->filling = 0;
+		promex_snap_release(ctx->snap);
+		HA_SPIN_UNLOCK(OTHER_LOCK, &promex_cache_lock);
+	}
+	ha_free(&ctx->samples);
+	ha_free(&ctx->metrics);
+}
+
 /* The main I/O handler for the promex applet. */
 static void promex_appctx_handle_io(struct appctx *appctx)
 {
@@ -1507,6 +1875,8 @@ static void promex_appctx_handle_io(struct appctx *appctx)
 	struct stream *s = __sc_strm(sc);
 	struct channel *req = sc_oc(sc);
 	struct channel *res = sc_ic(sc);
+	struct promex_ctx *ctx = appctx->svcctx;
+	struct promex_conf *conf = appctx->rule->arg.act.p[0];
 	struct htx *req_htx, *res_htx;
 	int ret;
 
@@ -1536,15 +1906,22 @@ static void promex_appctx_handle_io(struct appctx *appctx)
 			if (!promex_send_headers(appctx, sc, res_htx))
 				goto out;
 			appctx->st0 = ((s->txn->meth == HTTP_METH_HEAD) ? PROMEX_ST_DONE : PROMEX_ST_DUMP);
+			if (appctx->st0 == PROMEX_ST_DUMP && conf && conf->cache_ttl)
+				promex_cache_attach(appctx, conf->cache_ttl);
 			__fallthrough;
 
 		case PROMEX_ST_DUMP:
-			ret = promex_dump_metrics(appctx, sc, res_htx);
+			if (ctx->snap && !ctx->cache)
+				ret = promex_dump_snap(appctx, sc, res_htx);
+			else
+				ret = promex_dump_metrics(appctx, sc, res_htx);
 			if (ret <= 0) {
 				if (ret == -1)
 					goto error;
 				goto out;
 			}
+			if (ctx->cache)
+				promex_cache_publish(appctx);
 			appctx->st0 = PROMEX_ST_DONE;
 			__fallthrough;
 
@@ -1596,8 +1973,15 @@ struct applet promex_applet = {
 	.name = "<PROMEX>", /* used for logging */
 	.init = promex_appctx_init,
 	.fct = promex_appctx_handle_io,
+	.release = promex_appctx_release,
 };
 
+/* Releases the "prometheus-exporter" rule configuration */
+static void release_promex_rule(struct act_rule *rule)
+{
+	ha_free(&rule->arg.act.p[0]);
+}
+
 static enum act_parse_ret service_parse_prometheus_exporter(const char **args, int *cur_arg, struct proxy *px,
 							    struct act_rule *rule, char **err)
 {
@@ -1607,11 +1991,66 @@ static enum act_parse_ret service_parse_prometheus_exporter(const char **args, i
 		return ACT_RET_PRS_ERR;
 	}
 
+	while (*args[*cur_arg]) {
+		struct promex_conf *conf = rule->arg.act.p[0];
+		const char *res;
+		unsigned int ttl;
+
+		if (strcmp(args[*cur_arg], "cache-ttl") != 0)
+			break;
+
+		if (!*args[*cur_arg + 1]) {
+			memprintf(err, "'%s' expects a time value", args[*cur_arg]);
+			return ACT_RET_PRS_ERR;
+		}
+
+		res = parse_time_err(args[*cur_arg + 1], &ttl, TIME_UNIT_MS);
+		if (res == PARSE_TIME_OVER) {
+			memprintf(err, "timer overflow in argument '%s' to '%s' (maximum value is 2147483647 ms or ~24.8 days)",
+				  args[*cur_arg + 1], args[*cur_arg]);
+			return ACT_RET_PRS_ERR;
+		}
+		else if (res == PARSE_TIME_UNDER) {
+			memprintf(err, "timer underflow in argument '%s' to '%s' (minimum non-null value is 1 ms)",
+				  args[*cur_arg + 1], args[*cur_arg]);
+			return ACT_RET_PRS_ERR;
+		}
+		else if (res) {
+			memprintf(err, "unexpected character '%c' in argument to '%s'", *res, args[*cur_arg]);
+			return ACT_RET_PRS_ERR;
+		}
+
+		if (!conf) {
+			conf = calloc(1, sizeof(*conf));
+			if (!conf) {
+				memprintf(err, "out of memory");
+				return ACT_RET_PRS_ERR;
+			}
+			rule->arg.act.p[0] = conf;
+			rule->release_ptr = release_promex_rule;
+		}
+		conf->cache_ttl = ttl;
+		*cur_arg += 2;
+	}
+
 	/* Add applet pointer in the rule. */
 	rule->applet = promex_applet;
 
 	return ACT_RET_PRS_OK;
 }
+
+/* Releases the cache entries and their snapshots */
+static void promex_deinit(void)
+{
+	struct promex_cache *cache, *back;
+
+	list_for_each_entry_safe(cache, back, &promex_caches, list) {
+		LIST_DELETE(&cache->list);
+		promex_snap_release(cache->snap);
+		free(cache->metrics);
+		free(cache);
+	}
+}
 static void promex_register_build_options(void)
 {
         char *ptr = NULL;
@@ -1628,3 +2067,4 @@ static struct action_kw_list service_actions = { ILH, {
 
 INITCALL1(STG_REGISTER, service_keywords_register, &service_actions);
 INITCALL0(STG_REGISTER, promex_register_build_options);
+REGISTER_POST_DEINIT(promex_deinit);
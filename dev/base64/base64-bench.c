@@ -0,0 +1,157 @@
+/*
+ * Base64 decoders validation and micro-benchmark.
+ *
+ * The decoders are first checked against trivial character-by-character
+ * implementations on random valid and corrupted strings, then the time needed
+ * to encode and decode a set of typical tokens is measured. The number of loops
+ * may optionally be passed in argv[1].
+ *
+ * Build like this from the top makefile :
+ *    make dev/base64/base64-bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/base64.c"
+
+/* character-by-character reference decoder for both alphabets, following the
+ * same rules as base64dec() and base64urldec(). Returns the output length, -1
+ * on invalid input or -2 if <olen> is too short.
+ */
+static int ref_dec(const char *in, size_t ilen, char *out, size_t olen, int url)
+{
+	const char *rev = url ? ubase64rev : base64rev;
+	int cmin = url ? UB64CMIN : B64CMIN;
+	unsigned char t[4];
+	signed char b;
+	int convlen = 0, i = 0, pad = 0, padlen = 0;
+
+	if (url) {
+		if (ilen % 4 == 1)
+			return -1;
+		padlen = pad = (4 - ilen % 4) % 4;
+		if (olen < (((ilen + pad) / 4 * 3) - pad))
+			return -2;
+	}
+	else {
+		if (ilen % 4)
+			return -1;
+		if (olen < ((ilen / 4 * 3)
+		            - (in[ilen-1] == '=' ? 1 : 0)
+		            - (in[ilen-2] == '=' ? 1 : 0)))
+			return -2;
+	}
+
+	while (ilen + (url ? pad : 0)) {
+		if (ilen) {
+			b = (signed char)*in - cmin;
+			if ((unsigned char)b > (B64CMAX - cmin))
+				return -1;
+			b = rev[b] - B64BASE - 1;
+			if (b < 0)
+				return -1;
+			in++;
+			ilen--;
+			if (!url) {
+				if (pad && b != B64PADV)
+					return -1;
+				if (pad && i < 2)
+					return -1;
+				if (b == B64PADV)
+					pad++;
+			}
+		}
+		else {
+			b = B64PADV;
+			pad--;
+		}
+
+		t[i++] = b;
+		if (i == 4) {
+			if (convlen < olen)
+				out[convlen]   = ((t[0] << 2) + (t[1] >> 4));
+			if (convlen+1 < olen)
+				out[convlen+1] = ((t[1] << 4) + (t[2] >> 2));
+			if (convlen+2 < olen)
+				out[convlen+2] = ((t[2] << 6) + (t[3] >> 0));
+			convlen += url ? 3 : 3 - pad;
+			i = 0;
+			if (!url)
+				pad = 0;
+		}
+	}
+	return convlen - padlen;
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	static const char noise[] = "=+/-_.A0\x80\xff \n";
+	static char raw[4096], enc[8192], out[4096], ref[4096];
+	int loops = argc > 1 ? atoi(argv[1]) : 200000;
+	int i, j, len, elen, olen, rlen, url, errors = 0;
+	size_t total = 0;
+	double t0, t1;
+
+	/* validation: random strings, encoded then possibly corrupted */
+	srandom(0);
+	for (i = 0; i < 1000000; i++) {
+		url = i & 1;
+		len = random() % 256;
+		for (j = 0; j < len; j++)
+			raw[j] = random();
+
+		elen = url ? a2base64url(raw, len, enc, sizeof(enc)) : a2base64(raw, len, enc, sizeof(enc));
+		if (elen < 0) {
+			printf("encoding failed on loop %d\n", i);
+			return 1;
+		}
+
+		if (elen && (i & 2))
+			enc[random() % elen] = noise[random() % (sizeof(noise) - 1)];
+		if (elen > 2 && (i & 4))
+			elen -= random() % 3;
+
+		olen = url ? base64urldec(enc, elen, out, sizeof(out)) : base64dec(enc, elen, out, sizeof(out));
+		rlen = ref_dec(enc, elen, ref, sizeof(ref), url);
+		if (olen != rlen || (olen > 0 && memcmp(out, ref, olen) != 0) ||
+		    (!(i & 6) && (olen != len || memcmp(out, raw, len) != 0))) {
+			printf("mismatch on loop %d (url=%d): len=%d olen=%d rlen=%d\n", i, url, len, olen, rlen);
+			errors++;
+		}
+	}
+	printf("validation: %d errors\n", errors);
+	if (errors)
+		return 1;
+
+	/* benchmark on a typical 1.5 kB token */
+	for (j = 0; j < 1536; j++)
+		raw[j] = random();
+	elen = a2base64url(raw, 1536, enc, sizeof(enc));
+
+	t0 = now_sec();
+	for (j = 0; j < loops; j++)
+		total += base64urldec(enc, elen, out, sizeof(out));
+	t1 = now_sec();
+	printf("decoded %zu bytes in %.3f s: %.2f ns/byte, %.1f MB/s\n",
+	       total, t1 - t0, (t1 - t0) * 1e9 / total, total / (t1 - t0) / 1e6);
+
+	total = 0;
+	t0 = now_sec();
+	for (j = 0; j < loops; j++)
+		total += a2base64url(raw, 1536, enc, sizeof(enc));
+	t1 = now_sec();
+	printf("encoded %zu bytes in %.3f s: %.2f ns/byte, %.1f MB/s\n",
+	       total, t1 - t0, (t1 - t0) * 1e9 / total, total / (t1 - t0) / 1e6);
+	return 0;
+}
@@ -0,0 +1,234 @@
+#!/bin/sh
+#
+# Runs a set of canned benchmark scenarios against a haproxy binary, using
+# hbench as both the origin server and the load generator. Each scenario
+# prints one line of JSON on stdout so that results can be stored and
+# compared between versions. Progress and errors go to stderr.
+#
+# Usage: bench.sh [-H haproxy] [-d secs] [-c conns] [-t threads] [-b size]
+#                 [-p baseport] [scenario...]
+#
+# Scenarios: tcp h1 h1-close h2 tls cache comp maps (default: all)
+
+DIR="$(cd "$(dirname "$0")" && pwd)"
+HAPROXY="$DIR/../../haproxy"
+HBENCH="$DIR/hbench"
+DURATION=10
+CONNS=100
+THREADS=1
+BODY=1024
+PORT=19300
+ALL="tcp h1 h1-close h2 tls cache comp maps"
+
+die() {
+	echo "$*" >&2
+	exit 1
+}
+
+usage() {
+	sed -n '9,12s/^# \{0,1\}//p' "$0" >&2
+	exit 1
+}
+
+while [ $# -gt 0 ]; do
+	case "$1" in
+		-H) HAPROXY="$2"; shift 2 ;;
+		-d) DURATION="$2"; shift 2 ;;
+		-c) CONNS="$2"; shift 2 ;;
+		-t) THREADS="$2"; shift 2 ;;
+		-b) BODY="$2"; shift 2 ;;
+		-p) PORT="$2"; shift 2 ;;
+		-h|--help) usage ;;
+		-*) usage ;;
+		*) break ;;
+	esac
+done
+
+[ $# -gt 0 ] || set -- $ALL
+[ -x "$HAPROXY" ] || die "haproxy binary not found at '$HAPROXY', use -H."
+[ -x "$HBENCH" ] || make -C "$DIR" hbench >&2 || die "failed to build hbench."
+
+SRV_PORT=$PORT                # hbench origin server
+FE_PORT=$((PORT + 1))         # haproxy under test
+HLP_PORT=$((PORT + 2))        # helper haproxy for h2/tls client side
+HZ=$(getconf CLK_TCK)
+TMP=$(mktemp -d /tmp/hbench.XXXXXX) || die "mktemp failed."
+SRVPID=""
+HAPIDS=""
+
+cleanup() {
+	kill $SRVPID $HAPIDS 2>/dev/null
+	wait 2>/dev/null
+	rm -rf "$TMP"
+}
+trap cleanup EXIT INT TERM
+
+# prints utime+stime in ticks for pid $1
+cpu_ticks() {
+	awk '{ print $14 + $15 }' "/proc/$1/stat"
+}
+
+# prints VmRSS in kB for pid $1
+rss_kb() {
+	awk '/^VmRSS:/ { print $2 }' "/proc/$1/status"
+}
+
+global_section() {
+	cat <<-EOF2
+	global
+	    nbthread $THREADS
+	defaults
+	    mode http
+	    timeout client 30s
+	    timeout server 30s
+	    timeout connect 5s
+	EOF2
+}
+
+gen_cert() {
+	[ -s "$TMP/cert.pem" ] && return 0
+	command -v openssl >/dev/null || return 1
+	openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 \
+	        -nodes -days 1 -subj /CN=localhost \
+	        -keyout "$TMP/key.pem" -out "$TMP/crt.pem" >/dev/null 2>&1 || return 1
+	cat "$TMP/crt.pem" "$TMP/key.pem" > "$TMP/cert.pem"
+}
+
+gen_map() {
+	[ -s "$TMP/paths.map" ] && return 0
+	awk 'BEGIN {
+		for (i = 0; i < 100000; i++) {
+			printf "/app%d/ be%d\n", i, i % 16 > "'"$TMP"'/paths.map"
+			printf "host%d.example.com be%d\n", i, i % 16 > "'"$TMP"'/hosts.map"
+			printf "10.%d.%d.0/24 net%d\n", i / 256 % 256, i % 256, i % 8 > "'"$TMP"'/nets.map"
+		}
+	}'
+}
+
+# writes the configuration of the instance under test for scenario $1.
+# Variables CLI_OPTS and HELPER are set for the client side.
+gen_config() {
+	CLI_OPTS=""
+	HELPER=""
+	global_section
+
+	case "$1" in
+	tcp)
+		printf 'listen fe\n    mode tcp\n    bind 127.0.0.1:%d\n' $FE_PORT
+		printf '    server s1 127.0.0.1:%d\n' $SRV_PORT
+		;;
+	h1|h1-close)
+		printf 'listen fe\n    bind 127.0.0.1:%d\n' $FE_PORT
+		printf '    http-reuse always\n    server s1 127.0.0.1:%d\n' $SRV_PORT
+		[ "$1" = "h1-close" ] && CLI_OPTS="-C"
+		;;
+	h2)
+		printf 'listen fe\n    bind 127.0.0.1:%d proto h2\n' $FE_PORT
+		printf '    http-reuse always\n    server s1 127.0.0.1:%d\n' $SRV_PORT
+		HELPER="server s1 127.0.0.1:$FE_PORT proto h2"
+		;;
+	tls)
+		gen_cert || return 1
+		printf 'listen fe\n    bind 127.0.0.1:%d ssl crt %s\n' $FE_PORT "$TMP/cert.pem"
+		printf '    http-reuse always\n    server s1 127.0.0.1:%d\n' $SRV_PORT
+		# one full handshake per request: no reuse, no resumption
+		HELPER="server s1 127.0.0.1:$FE_PORT ssl verify none no-ssl-reuse"
+		CLI_OPTS="-C"
+		;;
+	cache)
+		printf 'cache c\n    total-max-size 64\n    max-object-size %d\n' $((BODY + 4096))
+		printf 'listen fe\n    bind 127.0.0.1:%d\n' $FE_PORT
+		printf '    http-request cache-use c\n    http-response cache-store c\n'
+		printf '    server s1 127.0.0.1:%d\n' $SRV_PORT
+		;;
+	comp)
+		printf 'listen fe\n    bind 127.0.0.1:%d\n' $FE_PORT
+		printf '    compression algo gzip\n    compression type text/plain\n'
+		printf '    http-reuse always\n    server s1 127.0.0.1:%d\n' $SRV_PORT
+		CLI_OPTS="-H Accept-Encoding:gzip"
+		;;
+	maps)
+		gen_map
+		printf 'listen fe\n    bind 127.0.0.1:%d\n' $FE_PORT
+		printf '    http-request set-var(txn.be) path,map_beg(%s)\n' "$TMP/paths.map"
+		printf '    http-request set-var(txn.host) req.hdr(host),lower,map_str(%s,none)\n' "$TMP/hosts.map"
+		printf '    http-request set-var(txn.net) src,map_ip(%s,none)\n' "$TMP/nets.map"
+		printf '    acl blocked path_reg -i \\.(php|asp|cgi)$ /wp-admin/ /\\.git/\n'
+		printf '    acl known var(txn.be) -m found\n'
+		printf '    http-request deny if blocked\n'
+		printf '    http-request set-header x-be %%[var(txn.be)] if known\n'
+		printf '    http-reuse always\n    server s1 127.0.0.1:%d\n' $SRV_PORT
+		CLI_OPTS="-u /app99999/index.html"
+		;;
+	*)
+		return 1
+		;;
+	esac
+	return 0
+}
+
+# starts haproxy with config $1, stores its pid in $HAPID
+start_haproxy() {
+	"$HAPROXY" -f "$1" -D -p "$1.pid" >"$1.log" 2>&1 || { cat "$1.log" >&2; return 1; }
+	HAPID=$(cat "$1.pid")
+	HAPIDS="$HAPIDS $HAPID"
+}
+
+run_scenario() {
+	sc="$1"
+	rm -f "$TMP"/*.pid
+
+	if ! gen_config "$sc" > "$TMP/$sc.cfg"; then
+		echo "{\"scenario\":\"$sc\",\"skipped\":true}"
+		return
+	fi
+	start_haproxy "$TMP/$sc.cfg" || { echo "{\"scenario\":\"$sc\",\"failed\":true}"; return; }
+	PID=$HAPID
+	TARGET=$FE_PORT
+
+	if [ -n "$HELPER" ]; then
+		{
+			printf 'global\n    nbthread %d\n' $THREADS
+			printf 'defaults\n    mode http\n    timeout client 30s\n    timeout server 30s\n    timeout connect 5s\n'
+			printf 'listen hlp\n    bind 127.0.0.1:%d\n    http-reuse always\n    %s\n' $HLP_PORT "$HELPER"
+		} > "$TMP/helper.cfg"
+		start_haproxy "$TMP/helper.cfg" || { echo "{\"scenario\":\"$sc\",\"failed\":true}"; return; }
+		TARGET=$HLP_PORT
+	fi
+
+	# idle memory usage, then a short warm-up to fill caches and pools
+	rss0=$(rss_kb $PID)
+	"$HBENCH" $CLI_OPTS -c $CONNS -t $THREADS -d 1 127.0.0.1:$TARGET >/dev/null
+
+	cpu0=$(cpu_ticks $PID)
+	"$HBENCH" $CLI_OPTS -c $CONNS -t $THREADS -d $DURATION 127.0.0.1:$TARGET > "$TMP/result" &
+	cli=$!
+	sleep $(((DURATION + 1) / 2))
+	rss1=$(rss_kb $PID)
+	wait $cli
+	cpu1=$(cpu_ticks $PID)
+
+	res=$(cat "$TMP/result")
+	req=$(echo "$res" | sed -n 's/.*"requests":\([0-9]*\).*/\1/p')
+	awk -v sc="$sc" -v res="$res" -v req="${req:-0}" -v hz=$HZ \
+	    -v cpu=$((cpu1 - cpu0)) -v rss0=$rss0 -v rss1=$rss1 -v conns=$CONNS -v body=$BODY 'BEGIN {
+		cpu_us = req ? cpu * 1000000 / hz / req : 0
+		mem = (rss1 - rss0) * 1024 / conns
+		sub(/^\{/, "", res)
+		printf "{\"scenario\":\"%s\",\"body\":%d,\"cpu_us_per_req\":%.2f,\"rss_kb\":%d,\"mem_per_conn\":%d,%s\n",
+		       sc, body, cpu_us, rss1, mem, res
+	}'
+
+	kill $HAPIDS 2>/dev/null
+	while kill -0 $HAPIDS 2>/dev/null; do sleep 0.1; done
+	HAPIDS=""
+}
+
+"$HBENCH" -s -b $BODY -t $THREADS 127.0.0.1:$SRV_PORT &
+SRVPID=$!
+sleep 0.2
+
+for sc in "$@"; do
+	echo "running scenario '$sc' for ${DURATION}s..." >&2
+	run_scenario "$sc"
+done
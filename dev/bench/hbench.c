@@ -0,0 +1,681 @@
+/*
+ * Minimal HTTP/1.1 load generator and origin server for benchmarking
+ *
+ * Copyright (C) 2026 HAProxy Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* This tool is meant to be used by bench.sh but works standalone as well :
+ *
+ *   - in server mode (-s), it answers every request received on a keep-alive
+ *     connection with the same canned response, whose body is made of text
+ *     lines so that it remains compressible.
+ *
+ *   - in client mode, it maintains a fixed number of concurrent connections,
+ *     each sending one request at a time, for a given duration. It supports
+ *     content-length and chunked responses. At the end it prints a single
+ *     line of JSON with the request rate and latency percentiles.
+ *
+ * Both modes use one epoll loop per thread and only depend on libc/pthread.
+ */
+
+#define _GNU_SOURCE
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAXTHREADS   64
+#define BUFSZ        65536
+#define MAXEVENTS    256
+
+/* latency histogram: 16 sub-buckets per power of two of microseconds */
+#define HIST_SUB     16
+#define HIST_BITS    32
+#define HIST_SIZE    (HIST_BITS * HIST_SUB)
+
+/* response parser states (client side) */
+enum {
+	RS_HDRS = 0,    /* waiting for the end of headers */
+	RS_BODY,        /* <left> bytes of payload to skip */
+	RS_CHK_SIZE,    /* parsing a chunk size line */
+	RS_CHK_DATA,    /* <left> bytes of chunk data to skip */
+	RS_CHK_CRLF,    /* CRLF after chunk data */
+	RS_TRAILERS,    /* trailers after the last chunk */
+};
+
+struct conn {
+	int fd;
+	int state;              /* RS_* */
+	int connected;
+	unsigned long long left;
+	unsigned long long sent_us; /* date the request was sent */
+	unsigned int len;       /* bytes in buf */
+	char buf[BUFSZ];
+};
+
+struct srv_conn {
+	int fd;
+	unsigned int out_ofs;   /* offset in the current response */
+	unsigned int pending;   /* responses left to send */
+	unsigned int crlf;      /* matched chars of "\r\n\r\n" */
+};
+
+struct thr_ctx {
+	pthread_t thr;
+	int id;
+	int nbconn;
+	unsigned long long requests;
+	unsigned long long errors;
+	unsigned long long bytes;
+	unsigned long long hist[HIST_SIZE];
+};
+
+static struct sockaddr_storage addr;
+static socklen_t addrlen;
+static int server_mode;
+static int nbthreads = 1;
+static int nbconn = 100;
+static int duration = 10;
+static int keepalive = 1;
+static int body_size = 1024;
+static const char *uri = "/";
+static char extra_hdrs[4096];
+static char *request;
+static size_t request_len;
+static char *response;
+static size_t response_len;
+static volatile int stopping;
+static unsigned long long end_us;
+static struct thr_ctx thr_ctx[MAXTHREADS];
+
+
+/* display the message and exit with the code */
+__attribute__((noreturn)) void die(int code, const char *format, ...)
+{
+	va_list args;
+
+	if (format) {
+		va_start(args, format);
+		vfprintf(stderr, format, args);
+		va_end(args);
+	}
+	exit(code);
+}
+
+/* display the usage message and exit with the code */
+__attribute__((noreturn)) void usage(int code, const char *arg0)
+{
+	die(code,
+	    "Usage : %s [options]* [<ip>:]port\n"
+	    "\n"
+	    "options :\n"
+	    "  -s           : server mode: serve canned responses on [<ip>:]port\n"
+	    "  -b <size>    : server: response body size in bytes (default: 1024)\n"
+	    "  -t <threads> : number of threads (default: 1)\n"
+	    "  -c <conns>   : client: number of concurrent connections (default: 100)\n"
+	    "  -d <secs>    : client: test duration in seconds (default: 10)\n"
+	    "  -C           : client: close the connection after each response\n"
+	    "  -u <uri>     : client: request URI (default: '/')\n"
+	    "  -H <header>  : client: add this header to requests (may be repeated)\n"
+	    "\n"
+	    "In client mode, a single line of JSON is printed on exit.\n"
+	    "", arg0);
+}
+
+static inline unsigned long long now_us()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* returns the histogram bucket for <us> microseconds */
+static inline unsigned int hist_bucket(unsigned long long us)
+{
+	unsigned int bit;
+
+	if (us < HIST_SUB)
+		return us;
+	bit = 63 - __builtin_clzll(us);
+	if (bit >= HIST_BITS)
+		return HIST_SIZE - 1;
+	/* keep the 4 bits following the highest one */
+	return (bit - 3) * HIST_SUB + ((us >> (bit - 4)) & (HIST_SUB - 1));
+}
+
+/* returns the lowest value of bucket <b> in microseconds */
+static unsigned long long hist_value(unsigned int b)
+{
+	unsigned int bit;
+
+	if (b < HIST_SUB)
+		return b;
+	bit = b / HIST_SUB + 3;
+	return (1ULL << bit) + ((unsigned long long)(b % HIST_SUB) << (bit - 4));
+}
+
+/* parses [<ip>:]port into <addr> */
+static void parse_addr(const char *arg)
+{
+	struct sockaddr_in *sin = (struct sockaddr_in *)&addr;
+	char *str = strdup(arg);
+	char *port = strrchr(str, ':');
+
+	memset(&addr, 0, sizeof(addr));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (port) {
+		*port++ = 0;
+		if (*str && inet_pton(AF_INET, str, &sin->sin_addr) != 1)
+			die(1, "Invalid address '%s'\n", str);
+	}
+	else
+		port = str;
+	sin->sin_port = htons(atoi(port));
+	if (!sin->sin_port)
+		die(1, "Invalid port '%s'\n", port);
+	addrlen = sizeof(*sin);
+	free(str);
+}
+
+/* builds the canned response with a compressible body of <body_size> bytes */
+static void build_response()
+{
+	static const char line[] = "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod.\n";
+	char hdr[256];
+	size_t hlen, i;
+
+	hlen = snprintf(hdr, sizeof(hdr),
+	                "HTTP/1.1 200 OK\r\n"
+	                "Content-Type: text/plain\r\n"
+	                "Cache-Control: max-age=3600\r\n"
+	                "Content-Length: %d\r\n"
+	                "\r\n", body_size);
+	response_len = hlen + body_size;
+	response = malloc(response_len);
+	if (!response)
+		die(1, "Out of memory\n");
+	memcpy(response, hdr, hlen);
+	for (i = 0; i < (size_t)body_size; i++)
+		response[hlen + i] = line[i % (sizeof(line) - 1)];
+}
+
+/* builds the request sent by the client */
+static void build_request()
+{
+	char *host = "localhost";
+
+	request_len = asprintf(&request,
+	                       "GET %s HTTP/1.1\r\n"
+	                       "Host: %s\r\n"
+	                       "%s"
+	                       "%s"
+	                       "\r\n",
+	                       uri, host, extra_hdrs,
+	                       keepalive ? "" : "Connection: close\r\n");
+	if ((int)request_len < 0)
+		die(1, "Out of memory\n");
+}
+
+/***************************** server side *****************************/
+
+/* tries to send pending responses on <c>. Returns <0 if the connection must
+ * be closed, 0 if it is blocked, >0 once everything was sent.
+ */
+static int srv_send(struct srv_conn *c)
+{
+	while (c->pending) {
+		ssize_t ret = send(c->fd, response + c->out_ofs, response_len - c->out_ofs, MSG_NOSIGNAL);
+
+		if (ret < 0)
+			return (errno == EAGAIN) ? 0 : -1;
+		c->out_ofs += ret;
+		if (c->out_ofs == response_len) {
+			c->out_ofs = 0;
+			c->pending--;
+		}
+	}
+	return 1;
+}
+
+static void *srv_thread(void *arg)
+{
+	struct epoll_event ev, events[MAXEVENTS];
+	int lfd, epfd, one = 1;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0 ||
+	    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+	    setsockopt(lfd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0 ||
+	    bind(lfd, (struct sockaddr *)&addr, addrlen) < 0 ||
+	    listen(lfd, 1024) < 0)
+		die(1, "Failed to bind listener: %s\n", strerror(errno));
+	fcntl(lfd, F_SETFL, O_NONBLOCK);
+
+	epfd = epoll_create1(0);
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+
+	while (1) {
+		int n, i;
+
+		n = epoll_wait(epfd, events, MAXEVENTS, 1000);
+		for (i = 0; i < n; i++) {
+			struct srv_conn *c = events[i].data.ptr;
+			int ret;
+
+			if (!c) {
+				int fd;
+
+				while ((fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+					c = calloc(1, sizeof(*c));
+					if (!c) {
+						close(fd);
+						continue;
+					}
+					c->fd = fd;
+					setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+					ev.events = EPOLLIN | EPOLLRDHUP;
+					ev.data.ptr = c;
+					epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+				}
+				continue;
+			}
+
+			if (events[i].events & EPOLLIN) {
+				char buf[16384];
+				ssize_t len, j;
+
+				while ((len = recv(c->fd, buf, sizeof(buf), 0)) > 0) {
+					/* count the end of headers, requests have no body */
+					for (j = 0; j < len; j++) {
+						if (buf[j] == ((c->crlf & 1) ? '\n' : '\r'))
+							c->crlf++;
+						else
+							c->crlf = (buf[j] == '\r');
+						if (c->crlf == 4) {
+							c->pending++;
+							c->crlf = 0;
+						}
+					}
+				}
+				if (!len || (len < 0 && errno != EAGAIN))
+					goto close_conn;
+			}
+
+			ret = srv_send(c);
+			if (ret < 0)
+				goto close_conn;
+			ev.events = EPOLLIN | EPOLLRDHUP | (ret ? 0 : EPOLLOUT);
+			ev.data.ptr = c;
+			epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+			continue;
+
+		  close_conn:
+			close(c->fd);
+			free(c);
+		}
+	}
+	return NULL;
+}
+
+/***************************** client side *****************************/
+
+/* (re)connects <c> and sends its first request. Returns 0 on success. */
+static int cli_connect(struct thr_ctx *ctx, int epfd, struct conn *c)
+{
+	struct epoll_event ev;
+	int one = 1;
+
+	c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (c->fd < 0)
+		return -1;
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (connect(c->fd, (struct sockaddr *)&addr, addrlen) < 0 && errno != EINPROGRESS) {
+		close(c->fd);
+		c->fd = -1;
+		return -1;
+	}
+	c->connected = 0;
+	c->state = RS_HDRS;
+	c->len = 0;
+	c->sent_us = now_us();
+	ev.events = EPOLLOUT | EPOLLIN | EPOLLRDHUP;
+	ev.data.ptr = c;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+	return 0;
+}
+
+static void cli_close(int epfd, struct conn *c)
+{
+	epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+	c->fd = -1;
+}
+
+/* parses the response headers in c->buf. Returns the header length or 0 if
+ * incomplete, and sets the parser state for the body. Returns <0 on error.
+ */
+static int cli_parse_hdrs(struct conn *c)
+{
+	char *end, *p;
+	int hlen;
+
+	end = memmem(c->buf, c->len, "\r\n\r\n", 4);
+	if (!end)
+		return (c->len == BUFSZ) ? -1 : 0;
+	hlen = end + 4 - c->buf;
+	if (c->len < 12 || memcmp(c->buf, "HTTP/1.", 7) != 0)
+		return -1;
+
+	c->state = RS_BODY;
+	c->left = 0;
+	for (p = c->buf; p < end; p = memchr(p, '\n', end - p) + 1) {
+		if (strncasecmp(p, "content-length:", 15) == 0)
+			c->left = strtoull(p + 15, NULL, 10);
+		else if (strncasecmp(p, "transfer-encoding:", 18) == 0)
+			c->state = RS_CHK_SIZE;
+		if (!memchr(p, '\n', end - p))
+			break;
+	}
+	return hlen;
+}
+
+/* processes the data in c->buf. Returns 1 when a full response was received,
+ * 0 if more data are needed or <0 on error.
+ */
+static int cli_parse(struct thr_ctx *ctx, struct conn *c)
+{
+	unsigned int ofs = 0;
+	int ret = 0;
+
+	while (ofs < c->len) {
+		char *p = c->buf + ofs, *lf;
+		unsigned int avail = c->len - ofs;
+
+		switch (c->state) {
+		case RS_HDRS:
+			ret = cli_parse_hdrs(c);
+			if (ret <= 0)
+				goto out;
+			ofs += ret;
+			ret = 0;
+			if (c->state == RS_BODY && !c->left)
+				goto done;
+			break;
+
+		case RS_BODY:
+		case RS_CHK_DATA:
+			if (avail > c->left)
+				avail = c->left;
+			ofs += avail;
+			c->left -= avail;
+			if (c->left)
+				break;
+			if (c->state == RS_BODY)
+				goto done;
+			c->state = RS_CHK_CRLF;
+			break;
+
+		case RS_CHK_SIZE:
+		case RS_CHK_CRLF:
+		case RS_TRAILERS:
+			lf = memchr(p, '\n', avail);
+			if (!lf)
+				goto out;
+			ofs += lf + 1 - p;
+			if (c->state == RS_CHK_CRLF)
+				c->state = RS_CHK_SIZE;
+			else if (c->state == RS_TRAILERS) {
+				if (lf == p || (lf == p + 1 && *p == '\r'))
+					goto done;
+			}
+			else {
+				c->left = strtoull(p, NULL, 16);
+				c->state = c->left ? RS_CHK_DATA : RS_TRAILERS;
+			}
+			break;
+		}
+	}
+  out:
+	/* keep the unparsed part (only possible for headers and chunk lines) */
+	if (ret < 0)
+		return ret;
+	if (ofs) {
+		memmove(c->buf, c->buf + ofs, c->len - ofs);
+		c->len -= ofs;
+	}
+	return 0;
+
+  done:
+	if (ofs < c->len)
+		return -1; /* no pipelining, extra data is an error */
+	c->len = 0;
+	c->state = RS_HDRS;
+	return 1;
+}
+
+static void *cli_thread(void *arg)
+{
+	struct thr_ctx *ctx = arg;
+	struct epoll_event events[MAXEVENTS];
+	struct conn *conns;
+	int epfd, i;
+
+	conns = calloc(ctx->nbconn, sizeof(*conns));
+	if (!conns)
+		die(1, "Out of memory\n");
+
+	epfd = epoll_create1(0);
+	for (i = 0; i < ctx->nbconn; i++) {
+		if (cli_connect(ctx, epfd, &conns[i]) < 0)
+			ctx->errors++;
+	}
+
+	while (!stopping) {
+		int n;
+
+		n = epoll_wait(epfd, events, MAXEVENTS, 100);
+		if (now_us() >= end_us)
+			break;
+
+		for (i = 0; i < n; i++) {
+			struct conn *c = events[i].data.ptr;
+			struct epoll_event ev;
+			ssize_t ret;
+
+			if (!c->connected && (events[i].events & EPOLLOUT)) {
+				c->connected = 1;
+				if (send(c->fd, request, request_len, MSG_NOSIGNAL) != (ssize_t)request_len)
+					goto error;
+				ev.events = EPOLLIN | EPOLLRDHUP;
+				ev.data.ptr = c;
+				epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+			}
+
+			if (!(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+				continue;
+
+			while ((ret = recv(c->fd, c->buf + c->len, BUFSZ - c->len, 0)) > 0) {
+				c->len += ret;
+				ctx->bytes += ret;
+				ret = cli_parse(ctx, c);
+				if (ret < 0)
+					goto error;
+				if (ret > 0) {
+					ctx->requests++;
+					ctx->hist[hist_bucket(now_us() - c->sent_us)]++;
+					if (!keepalive)
+						goto reconnect;
+					c->sent_us = now_us();
+					if (send(c->fd, request, request_len, MSG_NOSIGNAL) != (ssize_t)request_len)
+						goto error;
+				}
+			}
+			if (ret == 0 || errno != EAGAIN)
+				goto error;
+			continue;
+
+		  error:
+			ctx->errors++;
+		  reconnect:
+			cli_close(epfd, c);
+			if (cli_connect(ctx, epfd, c) < 0)
+				ctx->errors++;
+		}
+	}
+
+	for (i = 0; i < ctx->nbconn; i++) {
+		if (conns[i].fd >= 0)
+			close(conns[i].fd);
+	}
+	free(conns);
+	close(epfd);
+	return NULL;
+}
+
+static void sig_handler(int sig)
+{
+	stopping = 1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long hist[HIST_SIZE] = { };
+	unsigned long long requests = 0, errors = 0, bytes = 0, total, cumul;
+	unsigned long long start, p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+	const char *arg0 = argv[0];
+	double secs;
+	int i, b;
+
+	while (argc > 2 && argv[1][0] == '-') {
+		char *opt = argv[1];
+
+		if (strcmp(opt, "-s") == 0)
+			server_mode = 1;
+		else if (strcmp(opt, "-C") == 0)
+			keepalive = 0;
+		else if (strcmp(opt, "-b") == 0 && argc > 3)
+			body_size = atoi(argv[2]), argc--, argv++;
+		else if (strcmp(opt, "-t") == 0 && argc > 3)
+			nbthreads = atoi(argv[2]), argc--, argv++;
+		else if (strcmp(opt, "-c") == 0 && argc > 3)
+			nbconn = atoi(argv[2]), argc--, argv++;
+		else if (strcmp(opt, "-d") == 0 && argc > 3)
+			duration = atoi(argv[2]), argc--, argv++;
+		else if (strcmp(opt, "-u") == 0 && argc > 3)
+			uri = argv[2], argc--, argv++;
+		else if (strcmp(opt, "-H") == 0 && argc > 3) {
+			size_t len = strlen(extra_hdrs);
+
+			snprintf(extra_hdrs + len, sizeof(extra_hdrs) - len, "%s\r\n", argv[2]);
+			argc--, argv++;
+		}
+		else
+			usage(1, arg0);
+		argc--, argv++;
+	}
+
+	if (argc != 2)
+		usage(1, arg0);
+
+	if (nbthreads < 1 || nbthreads > MAXTHREADS || nbconn < nbthreads || duration < 1 || body_size < 0)
+		die(1, "Invalid argument value\n");
+
+	parse_addr(argv[1]);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (server_mode) {
+		build_response();
+		for (i = 1; i < nbthreads; i++)
+			pthread_create(&thr_ctx[i].thr, NULL, srv_thread, NULL);
+		srv_thread(NULL);
+		return 0;
+	}
+
+	build_request();
+	signal(SIGINT, sig_handler);
+	signal(SIGTERM, sig_handler);
+
+	start = now_us();
+	end_us = start + (unsigned long long)duration * 1000000ULL;
+	for (i = 0; i < nbthreads; i++) {
+		thr_ctx[i].id = i;
+		thr_ctx[i].nbconn = nbconn / nbthreads + (i < nbconn % nbthreads);
+		pthread_create(&thr_ctx[i].thr, NULL, cli_thread, &thr_ctx[i]);
+	}
+
+	for (i = 0; i < nbthreads; i++) {
+		pthread_join(thr_ctx[i].thr, NULL);
+		requests += thr_ctx[i].requests;
+		errors   += thr_ctx[i].errors;
+		bytes    += thr_ctx[i].bytes;
+		for (b = 0; b < HIST_SIZE; b++)
+			hist[b] += thr_ctx[i].hist[b];
+	}
+	secs = (now_us() - start) / 1000000.0;
+
+	/* percentiles are reported as the lower bound of their bucket */
+	for (total = b = 0; b < HIST_SIZE; b++)
+		total += hist[b];
+	for (cumul = b = 0; b < HIST_SIZE; b++) {
+		if (!hist[b])
+			continue;
+		cumul += hist[b];
+		if (!p50 && cumul * 100 >= total * 50)
+			p50 = hist_value(b);
+		if (!p90 && cumul * 100 >= total * 90)
+			p90 = hist_value(b);
+		if (!p99 && cumul * 100 >= total * 99)
+			p99 = hist_value(b);
+		if (!p999 && cumul * 1000 >= total * 999)
+			p999 = hist_value(b);
+		max = hist_value(b);
+	}
+
+	printf("{\"requests\":%llu,\"errors\":%llu,\"bytes\":%llu,\"duration\":%.3f,"
+	       "\"rps\":%.1f,\"lat_p50_us\":%llu,\"lat_p90_us\":%llu,\"lat_p99_us\":%llu,"
+	       "\"lat_p999_us\":%llu,\"lat_max_us\":%llu,\"conns\":%d,\"threads\":%d}\n",
+	       requests, errors, bytes, secs, secs > 0 ? requests / secs : 0.0,
+	       p50, p90, p99, p999, max, nbconn, nbthreads);
+	return 0;
+}
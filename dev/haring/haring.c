@@ -30,6 +30,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <haproxy/api.h>
 #include <haproxy/buf.h>
@@ -37,6 +38,7 @@
 
 int force = 0; // force access to a different layout
 int lfremap = 0; // remap LF in traces
+long long since = 0; // only dump archive segments archived from this date
 
 
 /* display the message and exit with the code */
@@ -61,7 +63,12 @@ __attribute__((noreturn)) void usage(int code, const char *arg0)
 	    "options :\n"
 	    "  -f           : force accessing a non-matching layout for 'ring struct'\n"
 	    "  -l           : replace LF in contents with CR VT\n"
+	    "  -T <date>    : with a ring archive, start at the first segment archived\n"
+	    "                 at or after this date (in seconds since the epoch)\n"
 	    "\n"
+	    "A ring archive (compressed file produced by the \"archive\" ring directive)\n"
+	    "is detected and decompressed using \"gzip\", after looking up its index file\n"
+	    "(<file>.idx) to skip older segments.\n"
 	    "", arg0);
 }
 
@@ -205,10 +212,57 @@ int dump_ring(struct ring *ring, size_t ofs, int flags)
 	return 0;
 }
 
+/* Dumps the archive <name> which is already opened as <fd> starting at the
+ * first segment archived at or after <since>, based on its index file. The
+ * segments are standalone gzip members, so this simply seeks to the right one
+ * and lets gzip decompress the rest. Only returns on error.
+ */
+int dump_archive(const char *name, int fd)
+{
+	char idx[4096], line[256];
+	unsigned long long ofs, seg_ofs = ~0ULL;
+	long long seg_date;
+	FILE *f;
+
+	if (since) {
+		snprintf(idx, sizeof(idx), "%s.idx", name);
+		f = fopen(idx, "r");
+		if (!f) {
+			perror("fopen(index)");
+			return 1;
+		}
+
+		while (fgets(line, sizeof(line), f)) {
+			if (sscanf(line, "%lld %llu", &seg_date, &ofs) != 2)
+				continue;
+			if (seg_date >= since) {
+				seg_ofs = ofs;
+				break;
+			}
+		}
+		fclose(f);
+
+		if (seg_ofs == ~0ULL)
+			return 0; // nothing that recent
+	}
+	else
+		seg_ofs = 0;
+
+	if (lseek(fd, seg_ofs, SEEK_SET) < 0 || dup2(fd, 0) < 0) {
+		perror("lseek()");
+		return 1;
+	}
+	close(fd);
+	execlp("gzip", "gzip", "-dc", NULL);
+	perror("execlp(gzip)");
+	return 1;
+}
+
 int main(int argc, char **argv)
 {
 	struct ring *ring;
 	struct stat statbuf;
+	unsigned char magic[2];
 	const char *arg0;
 	int fd;
 
@@ -219,6 +273,10 @@ int main(int argc, char **argv)
 			force = 1;
 		else if (strcmp(argv[0], "-l") == 0)
 			lfremap = 1;
+		else if (strcmp(argv[0], "-T") == 0 && argc > 1) {
+			since = atoll(argv[1]);
+			argc--; argv++;
+		}
 		else if (strcmp(argv[0], "--") == 0)
 			break;
 		else
@@ -239,6 +297,11 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	/* a ring archive starts with the gzip magic, a ring practically never does */
+	if (statbuf.st_size >= 2 && pread(fd, magic, 2, 0) == 2 &&
+	    magic[0] == 0x1f && magic[1] == 0x8b)
+		return dump_archive(argv[1], fd);
+
 	ring = mmap(NULL, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
 	close(fd);
 
@@ -0,0 +1,68 @@
+/* Multi-symbol Huffman table generator for HPACK decoder
+ *
+ * huff_mst[4096] is indexed on bits 31..20 of the code being looked up. Each
+ * entry describes the one or two symbols whose codes are entirely contained
+ * in these 12 bits :
+ *   - bits 7..0   : first symbol
+ *   - bits 15..8  : second symbol
+ *   - bits 19..16 : length of the first code, 0 if longer than 12 bits
+ *   - bits 23..20 : length of the second code, 0 if there is no second symbol
+ *
+ * Build like this from the top makefile :
+ *    make dev/hpack/gen-mst
+ */
+
+#define HPACK_STANDALONE
+
+#include <inttypes.h>
+#include <stdio.h>
+
+/* reuse the RFC7541 Appendix B table (ht[]) */
+#include "../../src/hpack-huff.c"
+
+#define MST_BITS 12
+
+/* returns the symbol whose code of at most MST_BITS bits is the prefix of
+ * the MST_BITS-bit value <idx>, and sets <len> to its length. Returns -1 if
+ * no code is short enough.
+ */
+static int lookup(uint32_t idx, int *len)
+{
+	int s;
+
+	for (s = 0; s < 256; s++) {
+		if (ht[s].b > MST_BITS)
+			continue;
+		if ((idx >> (MST_BITS - ht[s].b)) == ht[s].c) {
+			*len = ht[s].b;
+			return s;
+		}
+	}
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t idx, entry;
+	int s1, s2, l1, l2;
+
+	printf("static const uint32_t huff_mst[%d] = {\n", 1 << MST_BITS);
+	for (idx = 0; idx < (1 << MST_BITS); idx++) {
+		entry = 0;
+		s1 = lookup(idx, &l1);
+		if (s1 >= 0) {
+			entry = s1 | (l1 << 16);
+			s2 = lookup((idx << l1) & ((1 << MST_BITS) - 1), &l2);
+			if (s2 >= 0 && l1 + l2 <= MST_BITS)
+				entry |= (s2 << 8) | (l2 << 20);
+		}
+
+		if (!(idx & 7))
+			printf("\t/* 0x%03x */", idx);
+		printf(" 0x%06x,", entry);
+		if ((idx & 7) == 7)
+			printf("\n");
+	}
+	printf("};\n");
+	return 0;
+}
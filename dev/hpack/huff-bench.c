@@ -0,0 +1,141 @@
+/*
+ * Huffman decoder validation and micro-benchmark.
+ *
+ * The decoder is first checked against a trivial bit-by-bit implementation on
+ * random strings, then the time needed to decode a set of typical header
+ * values is measured. The number of loops may optionally be passed in argv[1].
+ *
+ * Build like this from the top makefile :
+ *    make dev/hpack/huff-bench
+ */
+
+#define HPACK_STANDALONE
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/hpack-huff.c"
+
+static const char *samples[] = {
+	"www.example.com",
+	"/api/v1/users/12345/profile?fields=name,email,avatar",
+	"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/108.0.0.0 Safari/537.36",
+	"text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8",
+	"gzip, deflate, br",
+	"en-US,en;q=0.9",
+	"application/grpc",
+	"/helloworld.Greeter/SayHello",
+	"grpc-go/1.51.0",
+	"Wed, 21 Oct 2015 07:28:00 GMT",
+	"sessionid=38afes7a8; csrftoken=u32t4o3tb3gg43; _ga=GA1.2.1234567890.1234567890",
+	"max-age=31536000; includeSubDomains",
+	"\"33a64df551425fcc55e4d42a148795d9f25f89d4\"",
+};
+
+/* huffman-encodes the <len> bytes of <in> into <out> and returns the number
+ * of output bytes. The last byte is padded with the EOS prefix.
+ */
+static int enc(const uint8_t *in, int len, uint8_t *out)
+{
+	uint64_t acc = 0;
+	int bits = 0, olen = 0;
+
+	while (len--) {
+		acc = (acc << ht[*in].b) | ht[*in].c;
+		bits += ht[*in].b;
+		in++;
+		while (bits >= 8) {
+			bits -= 8;
+			out[olen++] = acc >> bits;
+		}
+	}
+	if (bits)
+		out[olen++] = (acc << (8 - bits)) | (0xff >> bits);
+	return olen;
+}
+
+/* bit-by-bit reference decoder, returns the output length or -1 on error */
+static int ref_dec(const uint8_t *in, int hlen, char *out)
+{
+	uint32_t code = 0;
+	int i, s, b = 0, olen = 0;
+
+	for (i = 0; i < hlen * 8; i++) {
+		code = (code << 1) | ((in[i / 8] >> (7 - i % 8)) & 1);
+		b++;
+		for (s = 0; s < 256; s++) {
+			if (ht[s].b == b && ht[s].c == code)
+				break;
+		}
+		if (s < 256) {
+			out[olen++] = s;
+			code = b = 0;
+		}
+		else if (b > 30)
+			return -1;
+	}
+	if (b > 7 || code != (1U << b) - 1)
+		return -1;
+	return olen;
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t raw[4096], huff[16384];
+	static char out[4096], ref[4096];
+	int loops = argc > 1 ? atoi(argv[1]) : 200000;
+	int i, j, len, hlen, olen, rlen, errors = 0;
+	int enc_len[sizeof(samples) / sizeof(*samples)];
+	uint8_t *enc_str[sizeof(samples) / sizeof(*samples)];
+	size_t total = 0;
+	double t0, t1;
+
+	/* validation: random strings over the whole alphabet, then over the
+	 * printable characters only.
+	 */
+	srandom(0);
+	for (i = 0; i < 200000; i++) {
+		len = random() % 64;
+		for (j = 0; j < len; j++)
+			raw[j] = (i & 1) ? 0x20 + random() % 95 : random() % 256;
+
+		hlen = enc(raw, len, huff);
+		olen = huff_dec(huff, hlen, out, sizeof(out));
+		rlen = ref_dec(huff, hlen, ref);
+		if (olen != rlen || olen != len || memcmp(out, ref, olen) != 0) {
+			printf("mismatch on loop %d: len=%d olen=%d rlen=%d\n", i, len, olen, rlen);
+			errors++;
+		}
+	}
+	printf("validation: %d errors\n", errors);
+	if (errors)
+		return 1;
+
+	/* benchmark */
+	for (i = 0; i < sizeof(samples) / sizeof(*samples); i++) {
+		enc_str[i] = malloc(strlen(samples[i]) * 4);
+		enc_len[i] = enc((const uint8_t *)samples[i], strlen(samples[i]), enc_str[i]);
+	}
+
+	t0 = now_sec();
+	for (j = 0; j < loops; j++) {
+		for (i = 0; i < sizeof(samples) / sizeof(*samples); i++)
+			total += huff_dec(enc_str[i], enc_len[i], out, sizeof(out));
+	}
+	t1 = now_sec();
+
+	printf("decoded %zu bytes in %.3f s: %.2f ns/byte, %.1f MB/s\n",
+	       total, t1 - t0, (t1 - t0) * 1e9 / total, total / (t1 - t0) / 1e6);
+	return 0;
+}
@@ -0,0 +1,448 @@
+/*
+ * Map compiler for haproxy: turns a map file into a compiled map which
+ * haproxy maps and searches without loading it (see include/haproxy/patmap-t.h).
+ *
+ * Usage: mapc [-t str|ip] <input> <output>
+ *
+ * The input uses the regular map file format: one key and one value per line,
+ * empty lines and lines starting with '#' being ignored. When a key appears
+ * multiple times, the first occurrence wins, as it does in haproxy. String
+ * maps may be used with "map_str" and "map_beg" converters, and IPv4 maps
+ * (keys as "a.b.c.d" or "a.b.c.d/n") with "map_ip". The output is written to
+ * a temporary file which is then renamed, so that an existing map is
+ * atomically replaced and "reload map" may be issued on haproxy's CLI.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <haproxy/patmap-t.h>
+
+/* one parsed input line */
+struct line {
+	const char *key;
+	const char *val;
+	uint32_t key_len;
+	uint32_t val_len;
+	uint32_t from, to;    /* IPv4 network, for IP maps */
+	uint32_t plen;        /* IPv4 prefix length, for IP maps */
+	uint64_t num;         /* line number, to keep the first duplicate */
+	uint64_t val_ofs;     /* offset of the value in the strings area */
+};
+
+static struct line *lines;
+static uint64_t nb_lines;
+
+/* display the message and exit with the code */
+__attribute__((noreturn)) static void die(int code, const char *format, ...)
+{
+	va_list args;
+
+	if (format) {
+		va_start(args, format);
+		vfprintf(stderr, format, args);
+		va_end(args);
+	}
+	exit(code);
+}
+
+/* display the usage message and exit with the code */
+__attribute__((noreturn)) static void usage(int code, const char *arg0)
+{
+	die(code,
+	    "Usage: %s [-t str|ip] <input> <output>\n"
+	    "Compiles map file <input> into <output> for use by haproxy.\n"
+	    "  -t str  keys are strings, for exact and prefix matches (default)\n"
+	    "  -t ip   keys are IPv4 addresses or networks, for IP matches\n"
+	    "", arg0);
+}
+
+/* reads the whole file <name> in memory and returns it, zero-terminated */
+static char *read_file(const char *name, size_t *len)
+{
+	struct stat st;
+	FILE *f;
+	char *buf;
+
+	f = fopen(name, "r");
+	if (!f || fstat(fileno(f), &st) < 0)
+		die(1, "cannot open '%s': %s\n", name, strerror(errno));
+
+	buf = malloc(st.st_size + 1);
+	if (!buf)
+		die(1, "out of memory\n");
+
+	if (fread(buf, 1, st.st_size, f) != st.st_size)
+		die(1, "cannot read '%s': %s\n", name, strerror(errno));
+
+	fclose(f);
+	buf[st.st_size] = 0;
+	*len = st.st_size;
+	return buf;
+}
+
+/* splits the map file in <buf> into lines using the same rules as haproxy's
+ * map loader. Keys and values are zero-terminated in place.
+ */
+static void parse_lines(char *buf, size_t len)
+{
+	uint64_t alloc = 0, num = 0;
+	char *c = buf, *end = buf + len;
+
+	while (c < end) {
+		char *eol = memchr(c, '\n', end - c);
+		char *key, *key_end, *val, *val_end;
+
+		if (!eol)
+			eol = end;
+		*eol = 0;
+		num++;
+
+		if (*c == '#')
+			goto next;
+
+		while (*c == ' ' || *c == '\t')
+			c++;
+
+		if (*c == '\0' || *c == '\r')
+			goto next;
+
+		key = c;
+		while (*c && *c != ' ' && *c != '\t' && *c != '\r')
+			c++;
+		key_end = c;
+
+		while (*c == ' ' || *c == '\t')
+			c++;
+
+		val = c;
+		while (*c && *c != '\r')
+			c++;
+		val_end = c;
+
+		while (val_end > val && (val_end[-1] == ' ' || val_end[-1] == '\t'))
+			val_end--;
+
+		*key_end = 0;
+		*val_end = 0;
+
+		if (nb_lines == alloc) {
+			alloc = alloc ? alloc * 2 : 1024;
+			lines = realloc(lines, alloc * sizeof(*lines));
+			if (!lines)
+				die(1, "out of memory\n");
+		}
+
+		memset(&lines[nb_lines], 0, sizeof(*lines));
+		lines[nb_lines].key     = key;
+		lines[nb_lines].key_len = key_end - key;
+		lines[nb_lines].val     = val;
+		lines[nb_lines].val_len = val_end - val;
+		lines[nb_lines].num     = num;
+		nb_lines++;
+	next:
+		c = eol + 1;
+	}
+}
+
+/* parses the IPv4 address or network of line <l> */
+static void parse_ip4(struct line *l)
+{
+	char addr[INET_ADDRSTRLEN];
+	const char *slash;
+	struct in_addr in;
+	uint32_t mask;
+	char *err;
+	size_t len;
+
+	slash = strchr(l->key, '/');
+	len = slash ? slash - l->key : l->key_len;
+	if (len >= sizeof(addr))
+		goto bad;
+
+	memcpy(addr, l->key, len);
+	addr[len] = 0;
+	if (inet_pton(AF_INET, addr, &in) != 1)
+		goto bad;
+
+	l->plen = 32;
+	if (slash) {
+		l->plen = strtoul(slash + 1, &err, 10);
+		if (err == slash + 1 || *err || l->plen > 32)
+			goto bad;
+	}
+
+	mask = l->plen ? ~0U << (32 - l->plen) : 0;
+	l->from = ntohl(in.s_addr) & mask;
+	l->to   = l->from | ~mask;
+	return;
+ bad:
+	die(1, "line %llu: invalid IPv4 address or network '%s'\n",
+	    (unsigned long long)l->num, l->key);
+}
+
+/* sorts string keys in memcmp() order, shorter first, then by line number */
+static int cmp_str(const void *a, const void *b)
+{
+	const struct line *l1 = a, *l2 = b;
+	int ret;
+
+	ret = memcmp(l1->key, l2->key, l1->key_len < l2->key_len ? l1->key_len : l2->key_len);
+	if (!ret)
+		ret = (l1->key_len > l2->key_len) - (l1->key_len < l2->key_len);
+	if (!ret)
+		ret = (l1->num > l2->num) - (l1->num < l2->num);
+	return ret;
+}
+
+/* sorts networks by start address, larger first, then by line number */
+static int cmp_ip4(const void *a, const void *b)
+{
+	const struct line *l1 = a, *l2 = b;
+
+	if (l1->from != l2->from)
+		return l1->from < l2->from ? -1 : 1;
+	if (l1->plen != l2->plen)
+		return l1->plen < l2->plen ? -1 : 1;
+	return (l1->num > l2->num) - (l1->num < l2->num);
+}
+
+/* strings area being built */
+static char *strings;
+static uint64_t strings_len, strings_size;
+
+/* appends string <str> of length <len> and its trailing zero to the strings
+ * area, and returns its offset there.
+ */
+static uint64_t add_string(const char *str, size_t len)
+{
+	uint64_t ofs = strings_len;
+
+	while (strings_len + len + 1 > strings_size) {
+		strings_size = strings_size ? strings_size * 2 : 65536;
+		strings = realloc(strings, strings_size);
+		if (!strings)
+			die(1, "out of memory\n");
+	}
+	memcpy(strings + strings_len, str, len);
+	strings[strings_len + len] = 0;
+	strings_len += len + 1;
+	return ofs;
+}
+
+/* entries being built */
+static void *entries;
+static uint64_t nb_entries, entries_size;
+
+/* allocates a new entry of <size> bytes at the end of the entries array */
+static void *add_entry(size_t size)
+{
+	if (nb_entries == entries_size) {
+		entries_size = entries_size ? entries_size * 2 : 1024;
+		entries = realloc(entries, entries_size * size);
+		if (!entries)
+			die(1, "out of memory\n");
+	}
+	return (char *)entries + nb_entries++ * size;
+}
+
+/* builds the entries of a string map */
+static void build_str(void)
+{
+	uint64_t *stack, sp = 0, i;
+
+	qsort(lines, nb_lines, sizeof(*lines), cmp_str);
+
+	/* the stack holds the chain of keys which are prefixes of the
+	 * previous key, the closest one being on top.
+	 */
+	stack = malloc((nb_lines + 1) * sizeof(*stack));
+	if (!stack)
+		die(1, "out of memory\n");
+
+	for (i = 0; i < nb_lines; i++) {
+		struct line *l = &lines[i];
+		struct patmap_str *ent;
+
+		if (nb_entries) {
+			ent = (struct patmap_str *)entries + nb_entries - 1;
+			if (ent->key_len == l->key_len && memcmp(strings + ent->key_ofs, l->key, l->key_len) == 0)
+				continue; // duplicate, keep the first one
+		}
+
+		while (sp) {
+			ent = (struct patmap_str *)entries + stack[sp - 1];
+			if (ent->key_len < l->key_len && memcmp(strings + ent->key_ofs, l->key, ent->key_len) == 0)
+				break;
+			sp--;
+		}
+
+		ent = add_entry(sizeof(*ent));
+		ent->key_ofs = add_string(l->key, l->key_len);
+		ent->val_ofs = add_string(l->val, l->val_len);
+		ent->key_len = l->key_len;
+		ent->val_len = l->val_len;
+		ent->parent  = sp ? stack[sp - 1] : PATMAP_NONE;
+		stack[sp++] = nb_entries - 1;
+	}
+	free(stack);
+}
+
+/* emits range <from>-<to> for the value of line <l>, merging it with the
+ * previous one when contiguous with the same value.
+ */
+static void emit_ip4(uint64_t from, uint64_t to, const struct line *l)
+{
+	struct patmap_ip4 *ent;
+
+	if (from > to)
+		return;
+
+	if (nb_entries) {
+		ent = (struct patmap_ip4 *)entries + nb_entries - 1;
+		if ((uint64_t)ent->to + 1 == from && ent->val_ofs == l->val_ofs) {
+			ent->to = to;
+			return;
+		}
+	}
+
+	ent = add_entry(sizeof(*ent));
+	ent->from    = from;
+	ent->to      = to;
+	ent->val_ofs = l->val_ofs;
+	ent->val_len = l->val_len;
+	ent->unused  = 0;
+}
+
+/* builds the entries of an IPv4 map. Networks are either disjoint or nested,
+ * so they are flattened by walking them in order with a stack of the
+ * networks enclosing the current one, each address range being assigned to
+ * the most specific network covering it.
+ */
+static void build_ip4(void)
+{
+	struct line *stack[33];
+	uint64_t cursor = 0, i;
+	int sp = 0;
+
+	for (i = 0; i < nb_lines; i++) {
+		parse_ip4(&lines[i]);
+		lines[i].val_ofs = add_string(lines[i].val, lines[i].val_len);
+	}
+
+	qsort(lines, nb_lines, sizeof(*lines), cmp_ip4);
+
+	for (i = 0; i < nb_lines; i++) {
+		struct line *l = &lines[i];
+
+		/* close the networks ending before this one */
+		while (sp && stack[sp - 1]->to < l->from) {
+			emit_ip4(cursor, stack[sp - 1]->to, stack[sp - 1]);
+			cursor = (uint64_t)stack[--sp]->to + 1;
+		}
+
+		if (sp && stack[sp - 1]->from == l->from && stack[sp - 1]->to == l->to)
+			continue; // duplicate, keep the first one
+
+		if (sp)
+			emit_ip4(cursor, (uint64_t)l->from - 1, stack[sp - 1]);
+		stack[sp++] = l;
+		cursor = l->from;
+	}
+
+	while (sp) {
+		emit_ip4(cursor, stack[sp - 1]->to, stack[sp - 1]);
+		cursor = (uint64_t)stack[--sp]->to + 1;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *arg0 = argv[0];
+	struct patmap_hdr hdr;
+	size_t ent_size, len;
+	char *tmp, *buf;
+	int type = PATMAP_T_STR;
+	FILE *f;
+
+	argv++; argc--;
+	while (argc > 0 && **argv == '-') {
+		if (strcmp(argv[0], "-t") == 0 && argc > 1) {
+			if (strcmp(argv[1], "str") == 0)
+				type = PATMAP_T_STR;
+			else if (strcmp(argv[1], "ip") == 0)
+				type = PATMAP_T_IPV4;
+			else
+				usage(1, arg0);
+			argv++; argc--;
+		}
+		else if (strcmp(argv[0], "-h") == 0)
+			usage(0, arg0);
+		else
+			usage(1, arg0);
+		argv++; argc--;
+	}
+
+	if (argc != 2)
+		usage(1, arg0);
+
+	buf = read_file(argv[0], &len);
+	parse_lines(buf, len);
+
+	if (type == PATMAP_T_STR) {
+		build_str();
+		ent_size = sizeof(struct patmap_str);
+	}
+	else {
+		build_ip4();
+		ent_size = sizeof(struct patmap_ip4);
+	}
+
+	/* the file must always end with a zero */
+	if (!strings_len)
+		add_string("", 0);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, PATMAP_MAGIC, sizeof(hdr.magic));
+	hdr.endian  = PATMAP_ENDIAN;
+	hdr.type    = type;
+	hdr.count   = nb_entries;
+	hdr.ent_ofs = sizeof(hdr);
+	hdr.str_ofs = hdr.ent_ofs + nb_entries * ent_size;
+	hdr.size    = hdr.str_ofs + strings_len;
+
+	tmp = malloc(strlen(argv[1]) + 5);
+	if (!tmp)
+		die(1, "out of memory\n");
+	sprintf(tmp, "%s.tmp", argv[1]);
+
+	f = fopen(tmp, "w");
+	if (!f)
+		die(1, "cannot create '%s': %s\n", tmp, strerror(errno));
+
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    (nb_entries && fwrite(entries, ent_size, nb_entries, f) != nb_entries) ||
+	    fwrite(strings, 1, strings_len, f) != strings_len ||
+	    fclose(f) != 0)
+		die(1, "cannot write '%s': %s\n", tmp, strerror(errno));
+
+	if (rename(tmp, argv[1]) < 0)
+		die(1, "cannot rename '%s' to '%s': %s\n", tmp, argv[1], strerror(errno));
+
+	fprintf(stderr, "%llu lines, %llu entries, %llu bytes\n",
+	        (unsigned long long)nb_lines, (unsigned long long)nb_entries,
+	        (unsigned long long)hdr.size);
+	return 0;
+}
@@ -137,6 +137,8 @@ void debug_hexdump(FILE *out, const char *pfx, const char *buf,
 int main(int argc, char **argv)
 {
 	struct http_hdr hdrs[MAX_HDR_NUM];
+	struct qpack_dec dec = { };
+	uint64_t ric;
 	int len, outlen, hdr_idx;
 
 	do {
@@ -147,7 +149,7 @@ int main(int argc, char **argv)
 			break;
 
 		outlen = qpack_decode_fs(bin, len, &buf, hdrs,
-		                         sizeof(hdrs) / sizeof(hdrs[0]));
+		                         sizeof(hdrs) / sizeof(hdrs[0]), &dec, &ric);
 		if (outlen < 0) {
 			fprintf(stderr, "QPACK decoding failed: %d\n", outlen);
 			continue;
@@ -33,6 +33,7 @@
 #define HA_PROF_TASKS_MASK  0x00000003     /* per-task CPU profiling mask */
 
 #define HA_PROF_MEMORY      0x00000004     /* memory profiling */
+#define HA_PROF_SAMPLES     0x00000008     /* CPU time sampling */
 
 
 #ifdef USE_MEMORY_PROFILING
@@ -105,6 +106,17 @@ struct activity {
 	unsigned int accq_full;    // accept queue connection not pushed because full
 	unsigned int pool_fail;    // failed a pool allocation
 	unsigned int buf_wait;     // waited on a buffer allocation
+	unsigned int steal_tasks;  // tasks stolen from other threads' steal lists
+	unsigned int steal_miss;   // steal attempts which found the steal lists emptied meanwhile
+	unsigned int pipe_new;     // pipes created
+	unsigned int pipe_shared;  // pipes taken from the shared pool (not the local cache)
+	unsigned int pipe_grow;    // pipes enlarged because full
+	unsigned int splice_calls; // calls to splice() into or out of a pipe
+	unsigned int ehdl_queued;  // events queued to async event handlers
+	unsigned int ehdl_wakeups; // async event handler wakeups (one per batch)
+	unsigned int ehdl_deferred;// async event handler runs which left events for later
+	unsigned int ovl_paused;   // listeners paused because the process was overloaded
+	unsigned int conn_migr;    // idle frontend connections migrated to this thread
 #if defined(DEBUG_DEV)
 	/* keep these ones at the end */
 	unsigned int ctr0;         // general purposee debug counter
@@ -132,6 +144,36 @@ struct sched_activity {
 	uint64_t lat_time;
 };
 
+/* Histograms of the CPU time and latency of the calls accounted in one entry
+ * of sched_activity[], each thread having its own set. Buckets are
+ * log-linear: values below 4ns have their own bucket, then each power of two
+ * is split into 4 buckets, so that a value is known within 25%. This covers
+ * the whole 32-bit nanosecond range in 124 buckets.
+ */
+#define SCHED_HIST_BUCKETS 128
+
+struct sched_hist {
+	uint32_t cpu[SCHED_HIST_BUCKETS];
+	uint32_t lat[SCHED_HIST_BUCKETS];
+};
+
+/* 1024 call stacks per thread for CPU time sampling; entry 0 counts the
+ * samples which found no room.
+ */
+#define PROF_SAMPLE_HASH_BITS 10
+#define PROF_SAMPLE_BUCKETS (1U << PROF_SAMPLE_HASH_BITS)
+
+/* One CPU time sample aggregate: the task or tasklet handler the thread was
+ * running (NULL if none), and its innermost callers, the first one being the
+ * interrupted function. Unused callers are NULL. Each thread only updates its
+ * own table from the SIGPROF handler.
+ */
+struct prof_sample {
+	const void *func;
+	const void *frames[PROF_SAMPLE_DEPTH];
+	uint64_t count;
+};
+
 #endif /* _HAPROXY_ACTIVITY_T_H */
 
 /*
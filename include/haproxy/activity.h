@@ -24,14 +24,56 @@
 
 #include <haproxy/activity-t.h>
 #include <haproxy/api.h>
+#include <haproxy/global.h>
+#include <haproxy/intops.h>
 
 extern unsigned int profiling;
+extern unsigned int overload_max_loop_us;
+extern unsigned int overload_max_runqueue;
+extern unsigned int overloaded_threads;
 extern struct activity activity[MAX_THREADS];
 extern struct sched_activity sched_activity[SCHED_ACT_HASH_BUCKETS];
+extern struct sched_activity conv_activity[SCHED_ACT_HASH_BUCKETS];
+extern struct sched_activity lua_activity[SCHED_ACT_HASH_BUCKETS];
+extern struct sched_hist *sched_hist[MAX_THREADS];
+extern struct prof_sample *prof_samples[MAX_THREADS];
 
 void report_stolen_time(uint64_t stolen);
 void activity_count_runtime(uint32_t run_time);
 struct sched_activity *sched_activity_entry(struct sched_activity *array, const void *func, const void *caller);
+void sched_hist_add(const struct sched_activity *entry, uint32_t cpu, uint32_t lat);
+int prof_samples_collect(struct prof_sample **out, uint64_t *lost);
+void prof_sample_fold(struct buffer *buf, const struct prof_sample *s);
+
+/* returns the index of the sched_hist bucket for value <v> */
+static inline uint sched_hist_bucket(uint32_t v)
+{
+	uint msb;
+
+	if (v < 4)
+		return v;
+	msb = my_flsl(v) - 1;
+	return (msb - 1) * 4 + ((v >> (msb - 2)) & 3);
+}
+
+/* returns the highest value which belongs to sched_hist bucket <idx> */
+static inline uint32_t sched_hist_value(uint idx)
+{
+	if (idx < 4)
+		return idx;
+	return ((uint64_t)(4 + (idx & 3) + 1) << (idx / 4 - 1)) - 1;
+}
+
+/* Returns non-zero if at least half of the threads are overloaded, as decided
+ * from "tune.overload.*" by activity_count_runtime(). It is meant to be cheap
+ * enough to be checked for each accepted connection or new stream.
+ */
+static inline int process_overloaded(void)
+{
+	uint nb = _HA_ATOMIC_LOAD(&overloaded_threads);
+
+	return nb && nb * 2 >= global.nbthread;
+}
 
 #ifdef USE_MEMORY_PROFILING
 struct memprof_stats *memprof_get_bin(const void *ra, enum memprof_method meth);
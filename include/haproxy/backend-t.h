@@ -27,7 +27,9 @@
 #include <haproxy/lb_fas-t.h>
 #include <haproxy/lb_fwlc-t.h>
 #include <haproxy/lb_fwrr-t.h>
+#include <haproxy/lb_maglev-t.h>
 #include <haproxy/lb_map-t.h>
+#include <haproxy/lb_rdv-t.h>
 #include <haproxy/server-t.h>
 #include <haproxy/thread-t.h>
 
@@ -58,6 +60,7 @@
 /* BE_LB_CB_* is used with BE_LB_KIND_CB */
 #define BE_LB_CB_LC     0x00000  /* least-connections */
 #define BE_LB_CB_FAS    0x00001  /* first available server (opposite of leastconn) */
+#define BE_LB_CB_EWMA   0x00002  /* lowest peak-EWMA response time times connections */
 
 #define BE_LB_PARM      0x000FF  /* mask to get/clear the LB param */
 
@@ -84,6 +87,7 @@
 #define BE_LB_ALGO_RND  (BE_LB_KIND_RR | BE_LB_NEED_NONE | BE_LB_RR_RANDOM) /* random value */
 #define BE_LB_ALGO_LC   (BE_LB_KIND_CB | BE_LB_NEED_NONE | BE_LB_CB_LC)    /* least connections */
 #define BE_LB_ALGO_FAS  (BE_LB_KIND_CB | BE_LB_NEED_NONE | BE_LB_CB_FAS)   /* first available server */
+#define BE_LB_ALGO_EWMA (BE_LB_KIND_CB | BE_LB_NEED_NONE | BE_LB_CB_EWMA)  /* peak-EWMA response time */
 #define BE_LB_ALGO_SRR  (BE_LB_KIND_RR | BE_LB_NEED_NONE | BE_LB_RR_STATIC) /* static round robin */
 #define BE_LB_ALGO_SH	(BE_LB_KIND_HI | BE_LB_NEED_ADDR | BE_LB_HASH_SRC) /* hash: source IP */
 #define BE_LB_ALGO_UH	(BE_LB_KIND_HI | BE_LB_NEED_HTTP | BE_LB_HASH_URI) /* hash: HTTP URI  */
@@ -103,6 +107,8 @@
 #define BE_LB_LKUP_LCTREE 0x30000  /* FWLC tree lookup */
 #define BE_LB_LKUP_CHTREE 0x40000  /* consistent hash  */
 #define BE_LB_LKUP_FSTREE 0x50000  /* FAS tree lookup */
+#define BE_LB_LKUP_RDVARR 0x60000  /* rendezvous hash arrays lookup */
+#define BE_LB_LKUP_MGTBL  0x70000  /* maglev hash table lookup */
 #define BE_LB_LKUP        0x70000  /* mask to get just the LKUP value */
 
 /* additional properties */
@@ -111,7 +117,9 @@
 /* hash types */
 #define BE_LB_HASH_MAP    0x000000 /* map-based hash (default) */
 #define BE_LB_HASH_CONS   0x100000 /* consistent hashbit to indicate a dynamic algorithm */
-#define BE_LB_HASH_TYPE   0x100000 /* get/clear hash types */
+#define BE_LB_HASH_RDV    0x1000000 /* rendezvous hashing, also dynamic */
+#define BE_LB_HASH_MAGLEV 0x1100000 /* maglev hashing, also dynamic */
+#define BE_LB_HASH_TYPE   0x1100000 /* get/clear hash types */
 
 /* additional modifier on top of the hash function (only avalanche right now) */
 #define BE_LB_HMOD_AVAL   0x200000  /* avalanche modifier */
@@ -145,6 +153,8 @@ struct lbprm {
 		struct lb_fwlc fwlc;
 		struct lb_chash chash;
 		struct lb_fas fas;
+		struct lb_rdv rdv;
+		struct lb_maglev maglev;
 	};
 	int algo;			/* load balancing algorithm and variants: BE_LB_* */
 	int tot_wact, tot_wbck;		/* total effective weights of active and backup servers */
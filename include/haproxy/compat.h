@@ -131,6 +131,11 @@ typedef struct { } empty_t;
 #define MSG_MORE	0
 #endif
 
+/* MSG_ZEROCOPY sends are only supported on Linux 4.14 and above */
+#if defined(__linux__) && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+#define HA_HAVE_MSG_ZEROCOPY
+#endif
+
 /* On Linux 2.4 and above, MSG_TRUNC can be used on TCP sockets to drop any
  * pending data. Let's rely on NETFILTER to detect if this is supported.
  */
@@ -153,6 +158,10 @@ typedef struct { } empty_t;
 #define F_SETPIPE_SZ (1024 + 7)
 #endif
 
+#ifndef F_GETPIPE_SZ
+#define F_GETPIPE_SZ (1024 + 8)
+#endif
+
 #if defined(USE_TPROXY) && defined(USE_NETFILTER)
 #include <linux/types.h>
 #include <linux/netfilter_ipv6.h>
@@ -227,6 +236,14 @@ typedef struct { } empty_t;
 #define HA_HAVE_CRYPT_R
 #endif
 
+/* recvmmsg() and sendmmsg() are available in glibc since 2.12 and 2.14
+ * respectively, and on FreeBSD since 11.0 (1100000).
+ */
+#if (defined(__linux__) && defined(__GNU_LIBRARY__) && (__GLIBC__ > 2 || __GLIBC__ == 2 && __GLIBC_MINOR__ >= 14)) \
+ || (defined(__FreeBSD__) && __FreeBSD_version >= 1100000)
+#define HA_HAVE_MMSG
+#endif
+
 /* some backtrace() implementations are broken or incomplete, in this case we
  * can replace them. We must not do it all the time as some are more accurate
  * than ours.
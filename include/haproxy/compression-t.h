@@ -32,12 +32,22 @@
 #include <zlib.h>
 #endif
 
+#if defined(USE_BROTLI)
+#include <brotli/encode.h>
+#endif
+
+#if defined(USE_ZSTD)
+#include <zstd.h>
+#endif
+
 #include <haproxy/buf-t.h>
 
 struct comp {
 	struct comp_algo *algos;
 	struct comp_type *types;
 	unsigned int offload;
+	unsigned int cache_size;              /* size of the compressed bodies cache in bytes, 0 if none */
+	struct shared_context *cache;         /* compressed bodies cache, NULL if none */
 };
 
 struct comp_ctx {
@@ -53,6 +63,12 @@ struct comp_ctx {
 	void *zlib_prev;
 	void *zlib_pending_buf;
 	void *zlib_head;
+#endif
+#if defined(USE_BROTLI)
+	BrotliEncoderState *brotli; /* brotli encoder, NULL if unused */
+#endif
+#if defined(USE_ZSTD)
+	ZSTD_CCtx *zstd;            /* zstd compression context, NULL if unused */
 #endif
 	int cur_lvl;
 };
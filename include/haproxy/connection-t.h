@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in_systm.h>
 #include <netinet/ip.h>
 #include <netinet/ip6.h>
@@ -85,9 +86,11 @@ enum {
 	CO_FL_IDLE_LIST     = 0x00000002,  /* 2 = in idle_list, 3 = invalid */
 	CO_FL_LIST_MASK     = 0x00000003,  /* Is the connection in any server-managed list ? */
 
-	/* unused : 0x00000004, 0x00000008 */
+	CO_FL_SSL_KTLS_TX   = 0x00000004,  /* SSL records are encrypted by the kernel, the socket accepts cleartext */
+
+	CO_FL_SESS_SLAB     = 0x00000008,  /* allocated together with its session in a sess_conn_slab */
+	CO_FL_MIGRATING     = 0x00000010,  /* idle frontend conn offered to another thread (see conn_offer_migration()) */
 
-	/* unused : 0x00000010 */
 	/* unused : 0x00000020 */
 	/* unused : 0x00000040, 0x00000080 */
 
@@ -170,13 +173,13 @@ static forceinline char *conn_show_flags(char *buf, size_t len, const char *deli
 	/* prologue */
 	_(0);
 	/* flags */
-	_(CO_FL_SAFE_LIST, _(CO_FL_IDLE_LIST, _(CO_FL_CTRL_READY, _(CO_FL_XPRT_READY,
+	_(CO_FL_SAFE_LIST, _(CO_FL_IDLE_LIST, _(CO_FL_SSL_KTLS_TX, _(CO_FL_SESS_SLAB, _(CO_FL_MIGRATING, _(CO_FL_CTRL_READY, _(CO_FL_XPRT_READY,
 	_(CO_FL_WANT_DRAIN, _(CO_FL_WAIT_ROOM, _(CO_FL_EARLY_SSL_HS, _(CO_FL_EARLY_DATA,
 	_(CO_FL_SOCKS4_SEND, _(CO_FL_SOCKS4_RECV, _(CO_FL_SOCK_RD_SH, _(CO_FL_SOCK_WR_SH,
 	_(CO_FL_ERROR, _(CO_FL_FDLESS, _(CO_FL_WAIT_L4_CONN, _(CO_FL_WAIT_L6_CONN,
 	_(CO_FL_SEND_PROXY, _(CO_FL_ACCEPT_PROXY, _(CO_FL_ACCEPT_CIP, _(CO_FL_SSL_WAIT_HS,
 	_(CO_FL_PRIVATE, _(CO_FL_RCVD_PROXY, _(CO_FL_SESS_IDLE, _(CO_FL_XPRT_TRACKED
-	))))))))))))))))))))))));
+	)))))))))))))))))))))))))));
 	/* epilogue */
 	_(~0U);
 	return buf;
@@ -277,6 +280,7 @@ enum {
 enum {
 	CO_SFL_MSG_MORE    = 0x0001,    /* More data to come afterwards */
 	CO_SFL_STREAMER    = 0x0002,    /* Producer is continuously streaming data */
+	CO_SFL_ZEROCOPY    = 0x0004,    /* Send with MSG_ZEROCOPY, see sock_zc_prepare() */
 };
 
 /* mux->shutr() modes */
@@ -307,6 +311,7 @@ enum {
 	MX_FL_HOL_RISK    = 0x00000002, /* set if the protocol is subject the to head-of-line blocking on server */
 	MX_FL_NO_UPG      = 0x00000004, /* set if mux does not support any upgrade */
 	MX_FL_FRAMED      = 0x00000008, /* mux working on top of a framed transport layer (QUIC) */
+	MX_FL_PIPELINE    = 0x00000010, /* set if requests may be pipelined on a busy connection, only idempotent ones may then reuse it */
 };
 
 /* PROTO token registration */
@@ -328,11 +333,20 @@ enum proto_proxy_side {
 enum mux_ctl_type {
 	MUX_STATUS, /* Expects an int as output, sets it to a combinaison of MUX_STATUS flags */
 	MUX_EXIT_STATUS, /* Expects an int as output, sets the mux exist/error/http status, if known or 0 */
+	MUX_BUF_INFO,    /* Expects a struct mux_buf_info as output, fills it with the connection's buffers usage */
 };
 
 /* response for ctl MUX_STATUS */
 #define MUX_STATUS_READY (1 << 0)
 
+/* response for ctl MUX_BUF_INFO */
+struct mux_buf_info {
+	unsigned int idle;      /* non-zero if the connection has no active stream */
+	unsigned int rxbufs;    /* number of allocated receive buffers */
+	unsigned int txbufs;    /* number of allocated send buffers */
+	size_t size;            /* total size of these buffers */
+};
+
 enum mux_exit_status {
 	MUX_ES_SUCCESS,      /* Success */
 	MUX_ES_INVALID_ERR,  /* invalid input */
@@ -381,8 +395,9 @@ union conn_handle {
 struct xprt_ops {
 	size_t (*rcv_buf)(struct connection *conn, void *xprt_ctx, struct buffer *buf, size_t count, int flags); /* recv callback */
 	size_t (*snd_buf)(struct connection *conn, void *xprt_ctx, const struct buffer *buf, size_t count, int flags); /* send callback */
+	size_t (*snd_iov)(struct connection *conn, void *xprt_ctx, const struct iovec *iov, int iovcnt, int flags); /* optional vectored send callback */
 	int  (*rcv_pipe)(struct connection *conn, void *xprt_ctx, struct pipe *pipe, unsigned int count); /* recv-to-pipe callback */
-	int  (*snd_pipe)(struct connection *conn, void *xprt_ctx, struct pipe *pipe); /* send-to-pipe callback */
+	int  (*snd_pipe)(struct connection *conn, void *xprt_ctx, struct pipe *pipe, unsigned int count); /* send-to-pipe callback */
 	void (*shutr)(struct connection *conn, void *xprt_ctx, int);    /* shutr function */
 	void (*shutw)(struct connection *conn, void *xprt_ctx, int);    /* shutw function */
 	void (*close)(struct connection *conn, void *xprt_ctx);         /* close the transport layer */
@@ -461,6 +476,8 @@ struct conn_src {
 	int iface_len;                       /* bind interface name length */
 	char *iface_name;                    /* bind interface name or NULL */
 	struct port_range *sport_range;      /* optional per-server TCP source ports */
+	struct port_range **sport_lanes;     /* <nb_sport_lanes> ranges selected by destination, [0] is sport_range */
+	int nb_sport_lanes;                  /* number of entries in sport_lanes, 0 if unused */
 	struct sockaddr_storage source_addr; /* the address to which we want to bind for connect() */
 #if defined(CONFIG_HAP_TRANSPARENT)
 	struct sockaddr_storage tproxy_addr; /* non-local address we want to bind to for connect() */
@@ -536,13 +553,16 @@ struct connection {
 	void (*destroy_cb)(struct connection *conn);  /* callback to notify of imminent death of the connection */
 	struct sockaddr_storage *src; /* source address (pool), when known, otherwise NULL */
 	struct sockaddr_storage *dst; /* destination address (pool), when known, otherwise NULL */
-	struct ist proxy_authority;   /* Value of the authority TLV received via PROXYv2 */
-	struct ist proxy_unique_id;   /* Value of the unique ID TLV received via PROXYv2 */
+	struct ist proxy_tlvs;        /* TLVs received via PROXYv2 when needed (see conn_alloc_proxy_tlvs()) */
+	struct ist proxy_authority;   /* Value of the authority TLV received via PROXYv2, in proxy_tlvs */
+	struct ist proxy_unique_id;   /* Value of the unique ID TLV received via PROXYv2, in proxy_tlvs */
 
 	/* used to identify a backend connection for http-reuse,
 	 * thus only present if conn.target is of type OBJ_TYPE_SERVER
 	 */
 	struct conn_hash_node *hash_node;
+
+	struct sock_zc *zc;           /* MSG_ZEROCOPY context (pool), NULL until first used */
 };
 
 /* node for backend connection in the idle trees for http-reuse
@@ -618,6 +638,9 @@ struct mux_proto_list {
 /* Max length of the authority TLV */
 #define PP2_AUTHORITY_MAX 255
 
+/* TLV areas of PROXYv2 headers up to this size are allocated from a pool */
+#define PP2_TLVS_POOL_SIZE 256
+
 #define TLV_HEADER_SIZE      3
 
 struct proxy_hdr_v2 {
@@ -667,6 +690,7 @@ struct tlv_ssl {
 struct idle_conns {
 	struct mt_list toremove_conns;
 	struct task *cleanup_task;
+	struct task *prewarm_task;              /* maintains the servers' "pool-min-conn" connections */
 	__decl_thread(HA_SPINLOCK_T idle_conns_lock);
 } THREAD_ALIGNED(64);
 
@@ -40,8 +40,8 @@
 extern struct pool_head *pool_head_connection;
 extern struct pool_head *pool_head_conn_hash_node;
 extern struct pool_head *pool_head_sockaddr;
-extern struct pool_head *pool_head_authority;
 extern struct pool_head *pool_head_uniqueid;
+extern int conn_pp2_keep_tlvs;
 extern struct xprt_ops *registered_xprt[XPRT_ENTRIES];
 extern struct mux_proto_list mux_proto_list;
 extern struct mux_stopping_data mux_stopping_data[MAX_THREADS];
@@ -50,6 +50,7 @@ extern struct mux_stopping_data mux_stopping_data[MAX_THREADS];
 
 /* receive a PROXY protocol header over a connection */
 int conn_recv_proxy(struct connection *conn, int flag);
+struct ist conn_get_proxy_tlv(const struct connection *conn, int type);
 int conn_send_proxy(struct connection *conn, unsigned int flag);
 int make_proxy_line(char *buf, int buf_len, struct server *srv, struct connection *remote, struct stream *strm);
 
@@ -73,6 +74,8 @@ int conn_recv_socks4_proxy_response(struct connection *conn);
 
 /* If we delayed the mux creation because we were waiting for the handshake, do it now */
 int conn_create_mux(struct connection *conn);
+int conn_offer_migration(struct connection *conn);
+int conn_cancel_migration(struct connection *conn);
 int conn_notify_mux(struct connection *conn, int old_flags, int forced_wake);
 int conn_upgrade_mux_fe(struct connection *conn, void *ctx, struct buffer *buf,
                         struct ist mux_proto, int mode);
@@ -684,6 +687,17 @@ static inline int conn_is_ssl(struct connection *conn)
 	return !!conn_get_ssl_sock_ctx(conn);
 }
 
+/* boolean, returns true if the transport layer of connection <conn> is able to
+ * send data from a pipe. Over SSL this is only possible once the kernel was
+ * given the records encryption (kTLS).
+ */
+static inline int conn_xprt_can_snd_pipe(struct connection *conn)
+{
+	if (!conn->xprt || !conn->xprt->snd_pipe)
+		return 0;
+	return !conn_is_ssl(conn) || (conn->flags & CO_FL_SSL_KTLS_TX);
+}
+
 #endif /* _HAPROXY_CONNECTION_H */
 
 /*
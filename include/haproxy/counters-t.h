@@ -23,18 +23,42 @@
 #ifndef _HAPROXY_COUNTERS_T_H
 #define _HAPROXY_COUNTERS_T_H
 
+#include <haproxy/compiler.h>
+#include <haproxy/defaults.h>
+#include <haproxy/list-t.h>
+
+/* Counters updated for each connection, request or transfer, for frontends,
+ * listeners, backends and servers. There are counters_nbshards copies of them
+ * for each fe_counters or be_counters, each in its own cache lines, and they
+ * must only be accessed using the functions from counters.h which update the
+ * current thread's copy and add them all on read.
+ */
+struct counters_shard {
+	long long cum_conn;                     /* cumulated number of received connections */
+	long long cum_sess;                     /* cumulated number of accepted connections */
+	long long bytes_in;                     /* number of bytes transferred from the client to the server */
+	long long bytes_out;                    /* number of bytes transferred from the server to the client */
+	long long cum_req;                      /* cumulated number of processed HTTP requests */
+	long long rsp[6];                       /* http response codes */
+	THREAD_PAD(128 - 11 * sizeof(long long));
+};
+
+/* The copies of the counters_shard of a fe_counters or be_counters. They are
+ * allocated once the number of threads is known, the counters created before
+ * are queued until then.
+ */
+struct counters_shards {
+	struct counters_shard *shard;           /* array of counters_nbshards copies */
+	struct list wait;                       /* entry in the list of counters waiting for their shards */
+};
+
 /* counters used by listeners and frontends */
 struct fe_counters {
 	unsigned int conn_max;                  /* max # of active sessions */
-	long long    cum_conn;                  /* cumulated number of received connections */
-	long long    cum_sess;                  /* cumulated number of accepted connections */
 
 	unsigned int cps_max;                   /* maximum of new connections received per second */
 	unsigned int sps_max;                   /* maximum of new connections accepted per second (sessions) */
 
-	long long bytes_in;                     /* number of bytes transferred from the client to the server */
-	long long bytes_out;                    /* number of bytes transferred from the server to the client */
-
 	long long comp_in;                      /* input bytes fed to the compressor */
 	long long comp_out;                     /* output bytes emitted by the compressor */
 	long long comp_byp;                     /* input bytes that bypassed the compressor (cpu/ram/bw limitation) */
@@ -53,21 +77,20 @@ struct fe_counters {
 
 	union {
 		struct {
-			long long cum_req;      /* cumulated number of processed HTTP requests */
 			long long comp_rsp;     /* number of compressed responses */
 			unsigned int rps_max;   /* maximum of new HTTP requests second observed */
-			long long rsp[6];       /* http response codes */
 			long long cache_lookups;/* cache lookups */
 			long long cache_hits;   /* cache hits */
+			long long htx_defrags;  /* HTX defragmentations caused by http rules */
 		} http;
 	} p;                                    /* protocol-specific stats */
+
+	struct counters_shards shards;          /* counters updated by the threads */
 };
 
 /* counters used by servers and backends */
 struct be_counters {
 	unsigned int conn_max;                  /* max # of active sessions */
-	long long    cum_conn;                  /* cumulated number of received connections */
-	long long    cum_sess;                  /* cumulated number of accepted connections */
 	long long  cum_lbconn;                  /* cumulated number of sessions processed by load balancing (BE only) */
 	unsigned long last_sess;                /* last session time */
 
@@ -76,9 +99,6 @@ struct be_counters {
 	unsigned int nbpend_max;                /* max number of pending connections with no server assigned yet */
 	unsigned int cur_sess_max;		/* max number of currently active sessions */
 
-	long long bytes_in;                     /* number of bytes transferred from the client to the server */
-	long long bytes_out;                    /* number of bytes transferred from the server to the client */
-
 	long long comp_in;                      /* input bytes fed to the compressor */
 	long long comp_out;                     /* output bytes emitted by the compressor */
 	long long comp_byp;                     /* input bytes that bypassed the compressor (cpu/ram/bw limitation) */
@@ -105,14 +125,15 @@ struct be_counters {
 
 	union {
 		struct {
-			long long cum_req;      /* cumulated number of processed HTTP requests */
 			long long comp_rsp;     /* number of compressed responses */
 			unsigned int rps_max;   /* maximum of new HTTP requests second observed */
-			long long rsp[6];       /* http response codes */
 			long long cache_lookups;/* cache lookups */
 			long long cache_hits;   /* cache hits */
+			long long htx_defrags;  /* HTX defragmentations caused by http rules */
 		} http;
 	} p;                                    /* protocol-specific stats */
+
+	struct counters_shards shards;          /* counters updated by the threads */
 };
 
 #endif /* _HAPROXY_COUNTERS_T_H */
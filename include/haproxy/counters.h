@@ -0,0 +1,78 @@
+/*
+ * include/haproxy/counters.h
+ * This file contains functions to access the sharded statistics counters.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HAPROXY_COUNTERS_H
+#define _HAPROXY_COUNTERS_H
+
+#include <haproxy/atomic.h>
+#include <haproxy/counters-t.h>
+#include <haproxy/tinfo.h>
+
+extern unsigned int counters_nbshards;
+
+int counters_shards_init(struct counters_shards *shards);
+void counters_shards_free(struct counters_shards *shards);
+int counters_shards_alloc_all(void);
+
+/* Returns the shard of fe_counters or be_counters <ctr> owned by the current
+ * thread.
+ */
+#define COUNTERS_SHARD(ctr)  (&(ctr)->shards.shard[tid & (counters_nbshards - 1)])
+
+/* Increments or adds <val> to the sharded counter <field> of <ctr> */
+#define COUNTERS_INC(ctr, field)       _HA_ATOMIC_INC(&COUNTERS_SHARD(ctr)->field)
+#define COUNTERS_ADD(ctr, field, val)  _HA_ATOMIC_ADD(&COUNTERS_SHARD(ctr)->field, (val))
+
+/* Returns the sum of all the shards of counter <field> of <ctr> */
+#define COUNTERS_GET(ctr, field) ({                                           \
+	typeof(ctr) __ctr = (ctr);                                            \
+	long long __ret = 0;                                                  \
+	unsigned int __shard;                                                 \
+	for (__shard = 0; __shard < counters_nbshards; __shard++)             \
+		__ret += HA_ATOMIC_LOAD(&__ctr->shards.shard[__shard].field); \
+	__ret;                                                                \
+})
+
+/* Returns non-zero if the sum of all the shards of counter <field> of <ctr>
+ * is above <val>. The current thread's shard is added first and the sum stops
+ * as soon as <val> is exceeded, so that the other threads' cache lines are
+ * rarely read once the counter is large enough.
+ */
+#define COUNTERS_ABOVE(ctr, field, val) ({                                          \
+	typeof(ctr) __ctr = (ctr);                                                  \
+	long long __sum = 0;                                                        \
+	unsigned int __shard;                                                       \
+	for (__shard = 0; __shard < counters_nbshards && __sum <= (val); __shard++) \
+		__sum += HA_ATOMIC_LOAD(&__ctr->shards.shard[(tid + __shard) & (counters_nbshards - 1)].field); \
+	__sum > (val);                                                              \
+})
+
+/* Resets all the counters of fe_counters or be_counters <ctr>, including its
+ * shards which are kept allocated.
+ */
+#define COUNTERS_CLEAR(ctr) do {                                                    \
+	typeof(ctr) __ctr = (ctr);                                                  \
+	struct counters_shards __shards = __ctr->shards;                            \
+	memset(__ctr, 0, sizeof(*__ctr));                                           \
+	__ctr->shards = __shards;                                                   \
+	if (__shards.shard)                                                         \
+		memset(__shards.shard, 0, counters_nbshards * sizeof(*__shards.shard)); \
+} while (0)
+
+#endif /* _HAPROXY_COUNTERS_H */
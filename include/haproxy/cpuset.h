@@ -23,6 +23,10 @@ int ha_cpuset_clr(struct hap_cpuset *set, int cpu);
  */
 void ha_cpuset_and(struct hap_cpuset *dst, struct hap_cpuset *src);
 
+/* Bitwise or equivalent operation between <src> and <dst> stored in <dst>.
+ */
+void ha_cpuset_or(struct hap_cpuset *dst, struct hap_cpuset *src);
+
 /* Returns the count of set index in <set>.
  */
 int ha_cpuset_count(const struct hap_cpuset *set);
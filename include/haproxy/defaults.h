@@ -56,6 +56,34 @@
 
 #endif // USE_THREAD
 
+/* COUNTERS_SHARDS is the maximum number of copies of the proxy, listener and
+ * server counters which are updated for each connection, request or transfer.
+ * The number of threads rounded up to the next power of two is used, up to
+ * this value. A thread only modifies the copy indexed by its thread ID modulo
+ * the number of copies, which limits the number of threads sharing a cache
+ * line for these updates. It must be a power of two, and each copy takes 128
+ * bytes per frontend, backend, listener and server.
+ */
+#ifndef COUNTERS_SHARDS
+#ifdef USE_THREAD
+#define COUNTERS_SHARDS 16
+#else
+#define COUNTERS_SHARDS 1
+#endif
+#endif
+
+/* DICT_SHARDS is the number of independent trees, each with its own lock, the
+ * entries of a dictionary (e.g. the server names used by stick-tables) are
+ * spread over based on a hash of their value. It must be a power of two.
+ */
+#ifndef DICT_SHARDS
+#ifdef USE_THREAD
+#define DICT_SHARDS 16
+#else
+#define DICT_SHARDS 1
+#endif
+#endif
+
 /*
  * BUFSIZE defines the size of a read and write buffer. It is the maximum
  * amount of bytes which can be stored by the proxy for each stream. However,
@@ -100,6 +128,11 @@
 #define MAX_SYSLOG_LEN          1024
 #endif
 
+/* maximum number of datagrams received at once by log-forward listeners */
+#ifndef LOG_RECV_BATCH
+#define LOG_RECV_BATCH          16
+#endif
+
 /* 64kB to archive startup-logs seems way more than enough
  * /!\ Careful when changing this size, it is used in a shm when exec() from
  * mworker to wait mode.
@@ -155,11 +188,74 @@
 #define STKTABLE_EXTRA_DATA_TYPES 0
 #endif
 
+// number of events kept per thread by the trace flight recorder
+#ifndef TRACE_FLIGHT_RECORDS
+#define TRACE_FLIGHT_RECORDS 1024
+#endif
+
+// max number of unused pipes kept in each thread's local cache
+#ifndef MAX_LOCAL_PIPES
+#define MAX_LOCAL_PIPES 32
+#endif
+
+// number of slow loops kept per thread by the watchdog, with their call trace
+// depth, and minimum interval between two records on a thread (milliseconds)
+#ifndef SLOW_LOOP_RECORDS
+#define SLOW_LOOP_RECORDS 16
+#endif
+
+#ifndef SLOW_LOOP_CALLERS
+#define SLOW_LOOP_CALLERS 20
+#endif
+
+#ifndef SLOW_LOOP_MIN_INTERVAL
+#define SLOW_LOOP_MIN_INTERVAL 100
+#endif
+
+// CPU time sampling ("profiling.samples"): number of innermost callers kept
+// per sample, sampling frequency per thread (Hz, slightly off a round value so
+// as not to run in lockstep with periodic activities), and max number of call
+// stacks exported by the Prometheus exporter.
+#ifndef PROF_SAMPLE_DEPTH
+#define PROF_SAMPLE_DEPTH 4
+#endif
+
+#ifndef PROF_SAMPLE_HZ
+#define PROF_SAMPLE_HZ 99
+#endif
+
+#ifndef PROF_SAMPLE_EXPORT_MAX
+#define PROF_SAMPLE_EXPORT_MAX 100
+#endif
+
 // max # of stick-table filter entries that can be used during dump
 #ifndef STKTABLE_FILTER_LEN
 #define STKTABLE_FILTER_LEN 4
 #endif
 
+// max # of expired stick-table entries visited under a shard's lock before
+// releasing it to let other threads access the shard
+#ifndef STKTABLE_EXPIRE_BATCH
+#define STKTABLE_EXPIRE_BATCH 64
+#endif
+
+// max # of expired stick-table entries visited per call to the expiration
+// task before it yields and gets back in the run queue
+#ifndef STKTABLE_EXPIRE_BUDGET
+#define STKTABLE_EXPIRE_BUDGET 1024
+#endif
+
+// max # of stick-table entries written per call to the snapshot task before
+// it yields and gets back in the run queue
+#ifndef STKTABLE_SNAPSHOT_BUDGET
+#define STKTABLE_SNAPSHOT_BUDGET 4096
+#endif
+
+// default delay between two snapshots of a stick-table, in milliseconds
+#ifndef STKTABLE_SNAPSHOT_PERIOD
+#define STKTABLE_SNAPSHOT_PERIOD 60000
+#endif
+
 // max # of loops we can perform around a read() which succeeds.
 // It's very frequent that the system returns a few TCP segments at a time.
 #ifndef MAX_READ_POLL_LOOPS
@@ -183,6 +279,21 @@
 
 // the max number of events returned in one call to poll/epoll. Too small a
 // value will cause lots of calls, and too high a value may cause high latency.
+/* Maximum number of entries the CLI dumps of maps, tables and streams visit in
+ * a single call before yielding. This bounds the time locks or thread isolation
+ * are held when many entries are skipped by a filter.
+ */
+#ifndef CLI_DUMP_BATCH
+#define CLI_DUMP_BATCH 256
+#endif
+
+/* max number of events delivered at once to a normal mode async event handler
+ * (tune.events.max-events-at-once).
+ */
+#ifndef EVENT_HDL_MAX_AT_ONCE
+#define EVENT_HDL_MAX_AT_ONCE 100
+#endif
+
 #ifndef MAX_POLL_EVENTS
 #define MAX_POLL_EVENTS 200
 #endif
@@ -447,6 +558,21 @@
 #define TIME_STATS_SAMPLES 512
 #endif
 
+/* Number of samples over which the response times are averaged for "balance
+ * ewma". It must be small so that the algorithm quickly reacts to a server
+ * which recovers, and a power of two. The average immediately jumps to any
+ * sample larger than it, so a server which slows down is noticed at once.
+ * The average is also halved every LB_EWMA_HALF_LIFE milliseconds without any
+ * sample, so that a server which is not selected anymore is retried later.
+ */
+#ifndef LB_EWMA_SAMPLES
+#define LB_EWMA_SAMPLES 16
+#endif
+
+#ifndef LB_EWMA_HALF_LIFE
+#define LB_EWMA_HALF_LIFE 1000
+#endif
+
 /* max ocsp cert id asn1 encoded length */
 #ifndef OCSP_MAX_CERTID_ASN1_LENGTH
 #define OCSP_MAX_CERTID_ASN1_LENGTH 128
@@ -456,6 +582,25 @@
 #define OCSP_MAX_RESPONSE_TIME_SKEW 300
 #endif
 
+/* default bounds of the delay between two automatic OCSP updates (seconds) */
+#ifndef OCSP_UPDATE_MIN_DELAY
+#define OCSP_UPDATE_MIN_DELAY 300
+#endif
+
+#ifndef OCSP_UPDATE_MAX_DELAY
+#define OCSP_UPDATE_MAX_DELAY 3600
+#endif
+
+/* max number of OCSP responses fetched in parallel by the automatic update */
+#ifndef OCSP_UPDATE_MAX_INFLIGHT
+#define OCSP_UPDATE_MAX_INFLIGHT 8
+#endif
+
+/* server timeout of an OCSP update request, in milliseconds */
+#ifndef OCSP_UPDATE_TIMEOUT
+#define OCSP_UPDATE_TIMEOUT 10000
+#endif
+
 /* Number of TLS tickets to check, used for rotation */
 #ifndef TLS_TICKETS_NO
 #define TLS_TICKETS_NO 3
@@ -471,6 +616,132 @@
 #define DEFAULT_PAT_LRU_SIZE 10000
 #endif
 
+/* Maximum length of a string sample which may be stored in a slot of the
+ * per-stream sample cache (tune.sample.cache-size). Longer ones are always
+ * evaluated again.
+ */
+#ifndef SMP_CACHE_DATA_LEN
+#define SMP_CACHE_DATA_LEN 128
+#endif
+
+/* Minimum number of IPv4 networks in a pattern expression for which the "ip"
+ * match method switches from the tree to a flat table. The table takes at
+ * least 256 kB, but its lookups do not depend on the number of networks.
+ */
+#ifndef PAT_IP4_TAB_MIN
+#define PAT_IP4_TAB_MIN 1024
+#endif
+
+/* Interval in milliseconds between two checks of the grace period of the
+ * pattern values replaced at run time, before they may be released.
+ */
+#ifndef PAT_RECLAIM_DELAY
+#define PAT_RECLAIM_DELAY 10
+#endif
+
+/* Minimum number of consecutive "use_backend" rules testing the same sample
+ * for exact string matches which are indexed into a single lookup tree. Below
+ * this, evaluating the rules one at a time is cheaper.
+ */
+#ifndef MIN_SWITCHING_RUN
+#define MIN_SWITCHING_RUN 4
+#endif
+
+/* Maximum number of chunks a stream subject to a shared bandwidth limitation
+ * may forward for a single access to the stick-table entry. The extra bytes
+ * are leased from the shared counter and consumed locally by the stream. Any
+ * unused credit is given back when the stream releases the entry.
+ */
+#ifndef BWLIM_MAX_LEASE
+#define BWLIM_MAX_LEASE 16
+#endif
+
+/* Maximum number of request cookies indexed per transaction for the cookie
+ * sample fetches. Requests carrying more cookies are parsed on each lookup.
+ */
+#ifndef HTTP_COOKIE_IDX_MAX
+#define HTTP_COOKIE_IDX_MAX 64
+#endif
+
+/* Maximum number of headers of an HTX message which may be indexed by name to
+ * speed up repeated header lookups. Messages with more headers are always
+ * scanned. It must not exceed 65535.
+ */
+#ifndef HTTP_HDR_IDX_MAX
+#define HTTP_HDR_IDX_MAX 128
+#endif
+
+/* Maximum number of datagrams a QUIC datagram handler dequeues at once. Their
+ * connection IDs are looked up together to overlap the cache misses before the
+ * datagrams are parsed one at a time.
+ */
+#ifndef QUIC_DGRAM_BATCH
+#define QUIC_DGRAM_BATCH 8
+#endif
+
+/* Maximum nesting level of JSON bodies inspected by the json-extract filter.
+ * Deeper bodies stop being inspected. It must not exceed 255.
+ */
+#ifndef JSON_EXTRACT_MAX_DEPTH
+#define JSON_EXTRACT_MAX_DEPTH 32
+#endif
+
+/* Time in milliseconds during which buffers still referenced by MSG_ZEROCOPY
+ * sends are kept after their socket was closed, since no completion will be
+ * reported for them anymore.
+ */
+#ifndef SOCK_ZC_ORPHAN_DELAY
+#define SOCK_ZC_ORPHAN_DELAY 120000
+#endif
+
+/* Number of entries of the per-thread cache of backends designated by name in
+ * dynamic "use_backend" rules. 0 disables the cache.
+ */
+#ifndef PROXY_BE_NAME_CACHE_SIZE
+#define PROXY_BE_NAME_CACHE_SIZE 1024
+#endif
+
+/* Number of fdtab entries initialized at once when a new FD range is used. It
+ * must be a power of two. 64 entries of 64 bytes fill one 4kB page.
+ */
+#ifndef FDTAB_INIT_CHUNK
+#define FDTAB_INIT_CHUNK 64
+#endif
+
+/* Maximum number of "stick store-request" and "stick store-response" entries
+ * a single stream may hold until the response is processed.
+ */
+#ifndef STREAM_MAX_STORE
+#define STREAM_MAX_STORE 8
+#endif
+
+/* Number of sockets of each address family kept ready in advance for each
+ * network namespace used by servers, so that connecting to them does not
+ * require to switch namespaces. 0 disables the feature.
+ */
+#ifndef NETNS_SOCK_POOL_SIZE
+#define NETNS_SOCK_POOL_SIZE 16
+#endif
+
+/* Maximum amount of uncompressed ring contents stored in a single compressed
+ * segment of a ring archive, and interval in milliseconds between two checks
+ * for new contents to archive.
+ */
+#ifndef RING_ARCHIVE_SEG_SIZE
+#define RING_ARCHIVE_SEG_SIZE 262144
+#endif
+
+#ifndef RING_ARCHIVE_INTERVAL
+#define RING_ARCHIVE_INTERVAL 1000
+#endif
+
+/* Maximum number of idle frontend connections per second a thread may offer
+ * to other threads when "tune.listener.rebalance" is set.
+ */
+#ifndef CONN_MIGR_MAX_RATE
+#define CONN_MIGR_MAX_RATE 100
+#endif
+
 /* maximum number of pollers that may be registered */
 #ifndef MAX_POLLERS
 #define MAX_POLLERS	10
@@ -37,10 +37,17 @@ struct dict_entry {
 	size_t len;
 };
 
-struct dict {
-	const char *name;
+/* The entries are spread over DICT_SHARDS trees depending on a hash of their
+ * value, so that threads looking up different values do not share a lock.
+ */
+struct dict_shard {
 	struct eb_root values;
 	__decl_thread(HA_RWLOCK_T rwlock);
+} THREAD_ALIGNED(64);
+
+struct dict {
+	const char *name;
+	struct dict_shard shards[DICT_SHARDS];
 };
 
 #endif /* _HAPROXY_DICT_T_H */
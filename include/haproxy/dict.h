@@ -30,6 +30,7 @@
 #include <haproxy/dict-t.h>
 
 struct dict *new_dict(const char *name);
+void dict_init(struct dict *d, const char *name);
 struct dict_entry *dict_insert(struct dict *d, char *str);
 void dict_entry_unref(struct dict *d, struct dict_entry *de);
 
@@ -36,8 +36,9 @@
 /* DNS header size */
 #define DNS_HEADER_SIZE  ((int)sizeof(struct dns_header))
 
-/* max pending requests per stream */
-#define DNS_STREAM_MAX_PIPELINED_REQ	4
+/* default and maximum values of max pending requests per stream */
+#define DNS_STREAM_DEF_PIPELINED_REQ	4
+#define DNS_STREAM_MAX_PIPELINED_REQ	1024
 
 #define DNS_TCP_MSG_MAX_SIZE 65535
 #define DNS_TCP_MSG_RING_MAX_SIZE (1 + 1 + 3 + DNS_TCP_MSG_MAX_SIZE) // varint_bytes(DNS_TCP_MSG_MAX_SIZE) == 3
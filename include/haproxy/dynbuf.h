@@ -35,6 +35,7 @@
 #include <haproxy/pool.h>
 
 extern struct pool_head *pool_head_buffer;
+extern struct pool_head *pool_head_small_buffer;
 
 int init_buffer(void);
 void buffer_dump(FILE *o, struct buffer *b, int from, int to);
@@ -80,11 +81,41 @@ static inline int buffer_almost_full(const struct buffer *buf)
 	_retbuf;							\
  })
 
+/* Returns non-zero if <buf> is an allocated small buffer */
+static inline int b_is_small(const struct buffer *buf)
+{
+	return unlikely(pool_head_small_buffer && buf->size == pool_head_small_buffer->size);
+}
+
+/* Ensures that <buf> is allocated, as a small buffer if they are enabled and
+ * one is available, otherwise as a regular one. Small buffers are meant to be
+ * used by the muxes for their input while they do not know yet if they will
+ * carry more than small messages, and must be upgraded using b_upgrade_small()
+ * before being full or passed to the upper layers. The allocated buffer is
+ * returned, or NULL in case no memory is available.
+ */
+#define b_alloc_small(_buf) \
+({						\
+	char *_sarea;				\
+	struct buffer *_sbuf = _buf;		\
+						\
+	if (!_sbuf->size && pool_head_small_buffer) {			\
+		_sarea = pool_alloc_flag(pool_head_small_buffer, POOL_F_NO_POISON); \
+		if (likely(_sarea)) {					\
+			_sbuf->area = _sarea;				\
+			_sbuf->size = pool_head_small_buffer->size;	\
+			_sbuf->data = _sbuf->head = 0;			\
+		}							\
+	}								\
+	b_alloc(_sbuf);							\
+ })
+
 /* Releases buffer <buf> (no check of emptiness). The buffer's head is marked
  * empty.
  */
 #define __b_free(_buf)							\
 	do {								\
+		struct pool_head *pool = b_is_small(_buf) ? pool_head_small_buffer : pool_head_buffer; \
 		char *area = (_buf)->area;				\
 									\
 		/* let's first clear the area to save an occasional "show sess all" \
@@ -92,7 +123,7 @@ static inline int buffer_almost_full(const struct buffer *buf)
 		 */							            \
 		*(_buf) = BUF_NULL;					\
 		__ha_barrier_store();					\
-		pool_free(pool_head_buffer, area);			\
+		pool_free(pool, area);					\
 	} while (0)							\
 
 /* Releases buffer <buf> if allocated, and marks it empty. */
@@ -102,6 +133,31 @@ static inline int buffer_almost_full(const struct buffer *buf)
 			__b_free((_buf));	\
 	} while (0)
 
+/* Replaces small buffer <buf> with a regular one holding the same data at the
+ * same offset. Returns non-zero on success or if <buf> is not a small buffer,
+ * or 0 if no regular buffer is available, in which case <buf> is left intact.
+ */
+static inline int b_upgrade_small(struct buffer *buf)
+{
+	struct buffer large = BUF_NULL;
+	size_t contig;
+
+	if (!b_is_small(buf))
+		return 1;
+
+	if (!b_alloc(&large))
+		return 0;
+
+	/* the small buffer's contents always fit without wrapping */
+	large.head = b_head_ofs(buf);
+	contig = b_contig_data(buf, 0);
+	__b_putblk(&large, b_head(buf), contig);
+	__b_putblk(&large, b_orig(buf), b_data(buf) - contig);
+	__b_free(buf);
+	*buf = large;
+	return 1;
+}
+
 /* Offer one or multiple buffer currently belonging to target <from> to whoever
  * needs one. Any pointer is valid for <from>, including NULL. Its purpose is
  * to avoid passing a buffer to oneself in case of failed allocations (e.g.
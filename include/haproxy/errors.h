@@ -128,6 +128,19 @@ void startup_logs_init();
 struct ring *startup_logs_dup(struct ring *src);
 void startup_logs_free(struct ring *r);
 
+/* startup profiling ("-dT"): measures taken at the beginning of a step */
+struct startup_prof {
+	uint64_t wall;               /* monotonic date in ns */
+	uint64_t cpu;                /* CPU time consumed by the process in ns */
+	long long mem;               /* bytes allocated via malloc(), if known */
+};
+
+extern unsigned int startup_prof_min_ms;
+
+void startup_prof_start(struct startup_prof *prof);
+void startup_prof_report(const struct startup_prof *prof, int always, const char *fmt, ...)
+	__attribute__ ((format(printf, 3, 4)));
+
 #endif /* _HAPROXY_ERRORS_H */
 
 /*
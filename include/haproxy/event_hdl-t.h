@@ -74,8 +74,16 @@ struct event_hdl_sub_type
 
 /* event_hdl_sub_list is an alias to mt_list (please use this for portability) */
 typedef struct mt_list event_hdl_sub_list;
-/* event_hdl_async_equeue is an alias to mt_list (please use this for portability) */
-typedef struct mt_list event_hdl_async_equeue;
+/* async event queue: a list of pending events and their count. The count is
+ * used to wake the consumer only once per batch of events, and may be checked
+ * by consumers which want to apply some backpressure. It may be transiently
+ * off by the number of concurrent producers.
+ */
+struct event_hdl_async_equeue {
+	struct mt_list head;
+	int size;
+};
+typedef struct event_hdl_async_equeue event_hdl_async_equeue;
 
 /* subscription mgmt from event */
 struct event_hdl_sub_mgmt
@@ -239,6 +247,12 @@ struct event_hdl_sub {
 #define EVENT_HDL_SUB_SERVER                            EVENT_HDL_SUB_FAMILY(1)
 #define EVENT_HDL_SUB_SERVER_ADD                        EVENT_HDL_SUB_TYPE(1,1)
 #define EVENT_HDL_SUB_SERVER_DEL                        EVENT_HDL_SUB_TYPE(1,2)
+#define EVENT_HDL_SUB_SERVER_UP                         EVENT_HDL_SUB_TYPE(1,3)
+#define EVENT_HDL_SUB_SERVER_DOWN                       EVENT_HDL_SUB_TYPE(1,4)
+#define EVENT_HDL_SUB_SERVER_WEIGHT                     EVENT_HDL_SUB_TYPE(1,5)
+#define EVENT_HDL_SUB_SERVER_MAXCONN                    EVENT_HDL_SUB_TYPE(1,6)
+#define EVENT_HDL_SUB_SERVER_QUEUE_HIGH                 EVENT_HDL_SUB_TYPE(1,7)
+#define EVENT_HDL_SUB_SERVER_QUEUE_LOW                  EVENT_HDL_SUB_TYPE(1,8)
 
 /*	---------------------------------------        */
 
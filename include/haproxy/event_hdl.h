@@ -408,13 +408,29 @@ void event_hdl_async_free_event(struct event_hdl_async_event *e);
 /* use this for advanced async mode to initialize event queue */
 static inline void event_hdl_async_equeue_init(event_hdl_async_equeue *queue)
 {
-	MT_LIST_INIT(queue);
+	MT_LIST_INIT(&queue->head);
+	queue->size = 0;
 }
 
 /* use this for advanced async mode to pop an event from event queue */
 static inline struct event_hdl_async_event *event_hdl_async_equeue_pop(event_hdl_async_equeue *queue)
 {
-	return MT_LIST_POP(queue, struct event_hdl_async_event *, mt_list);
+	struct event_hdl_async_event *event;
+
+	event = MT_LIST_POP(&queue->head, struct event_hdl_async_event *, mt_list);
+	if (event)
+		HA_ATOMIC_DEC(&queue->size);
+	return event;
+}
+
+/* returns the approximate number of events pending in the event queue, which
+ * may be used by a consumer to detect that it is falling behind.
+ */
+static inline int event_hdl_async_equeue_size(const event_hdl_async_equeue *queue)
+{
+	int size = HA_ATOMIC_LOAD(&queue->size);
+
+	return size > 0 ? size : 0;
 }
 
 /* use this to initialize an event subscription list
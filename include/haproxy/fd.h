@@ -52,6 +52,7 @@ extern THREAD_LOCAL int fd_nbupdt; // number of updates in the list
 extern int poller_wr_pipe[MAX_THREADS];
 
 extern volatile int ha_used_fds; // Number of FDs we're currently using
+extern volatile int fdtab_inited; // Number of leading fdtab entries initialized
 
 /* Deletes an FD from the fdsets.
  * The file descriptor is also closed.
@@ -121,6 +122,7 @@ int list_pollers(FILE *out);
  */
 void run_poller();
 
+void fd_init_entries(int fd);
 void fd_add_to_fd_list(volatile struct fdlist *list, int fd);
 void fd_rm_from_fd_list(volatile struct fdlist *list, int fd);
 void updt_fd_polling(const int fd);
@@ -438,6 +440,10 @@ static inline void fd_insert(int fd, void *owner, void (*iocb)(int fd), int tgid
 	 */
 	BUG_ON(fd < 0);
 	BUG_ON(fd >= global.maxsock);
+
+	if (unlikely(fd >= _HA_ATOMIC_LOAD(&fdtab_inited)))
+		fd_init_entries(fd);
+
 	BUG_ON(fdtab[fd].owner != NULL);
 	BUG_ON(fdtab[fd].state != 0);
 	BUG_ON(tgid < 1 || tgid > MAX_TGROUPS);
@@ -348,6 +348,26 @@ static inline unsigned int swrate_add_scaled(unsigned int *sum, unsigned int n,
 	return new_sum;
 }
 
+/* Adds sample value <v> to sliding window sum <sum> configured for <n> samples,
+ * except that if <v> is larger than the current average, the sum is reset so
+ * that the average becomes <v>. This is a peak-sensitive average which reacts
+ * immediately to increases and slowly to decreases. The sample is returned.
+ * Better if <n> is a power of two. This function is thread-safe.
+ */
+static inline unsigned int swrate_add_peak(unsigned int *sum, unsigned int n, unsigned int v)
+{
+	unsigned int new_sum, old_sum;
+
+	old_sum = *sum;
+	do {
+		if (v * n > old_sum)
+			new_sum = v * n;
+		else
+			new_sum = old_sum - (old_sum + n - 1) / n + v;
+	} while (!HA_ATOMIC_CAS(sum, &old_sum, new_sum) && __ha_cpu_relax());
+	return new_sum;
+}
+
 /* Returns the average sample value for the sum <sum> over a sliding window of
  * <n> samples. Better if <n> is a power of two. It must be the same <n> as the
  * one used above in all additions.
@@ -44,6 +44,7 @@
 #define	MODE_DUMP_KWD   0x4000  /* dump registered keywords (see kwd_dump for the list) */
 #define	MODE_DUMP_CFG   0x8000  /* dump the configuration file */
 #define	MODE_DUMP_NB_L  0x10000 /* dump line numbers when the configuration file is dump */
+#define	MODE_DUMP_TIMES 0x20000 /* report the time spent in each startup stage */
 
 /* list of last checks to perform, depending on config options */
 #define LSTCHK_CAP_BIND	0x00000001	/* check that we can bind to any port */
@@ -79,6 +80,19 @@
 #define GTUNE_DISABLE_ACTIVE_CLOSE (1<<22)
 #define GTUNE_QUICK_EXIT         (1<<23)
 #define GTUNE_QUIC_SOCK_PER_CONN (1<<24)
+#define GTUNE_USE_URING          (1<<25)
+#define GTUNE_QUIC_NO_PACING     (1<<26)
+#define GTUNE_QUIC_SOCK_STEERING (1<<27)
+#define GTUNE_SCHED_TIMER_WHEEL  (1<<28)
+#define GTUNE_SCHED_WORK_STEAL   (1<<29)
+#define GTUNE_SESS_CONN_SLAB     (1<<30)
+
+/* automatic CPU binding modes for "numa-cpu-mapping" */
+enum {
+	NUMA_CPU_MAP_NONE = 0,         /* no automatic binding */
+	NUMA_CPU_MAP_FIRST_NODE = 1,   /* bind to the first node with active CPUs */
+	NUMA_CPU_MAP_L3_GROUPS = 2,    /* one thread group per L3 cache domain */
+};
 
 /* SSL server verify mode */
 enum {
@@ -140,8 +154,12 @@ struct global {
 		int maxaccept;     /* max number of consecutive accept() */
 		int options;       /* various tuning options */
 		int runqueue_depth;/* max number of tasks to run at once */
+		int sched_heavy_share; /* max % of time for heavy tasklets when other work is pending, 0=no limit */
+		uint sched_max_loop_lat; /* target max loop duration (us) for the adaptive run queue budget, 0=off */
+		uint srv_queue_evt;    /* server queue length reporting SERVER_QUEUE_{HIGH,LOW} events, 0=off */
 		int recv_enough;   /* how many input bytes at once are "enough" */
 		int bufsize;       /* buffer size in bytes, defaults to BUFSIZE */
+		int bufsize_small; /* small buffers size in bytes, 0 if disabled */
 		int maxrewrite;    /* buffer max rewrite size in bytes, defaults to MAXREWRITE */
 		int reserved_bufs; /* how many buffers can only be allocated for response */
 		int buf_limit;     /* if not null, how many total buffers may only be allocated */
@@ -150,10 +168,13 @@ struct global {
 		int server_sndbuf; /* set server sndbuf to this value if not null */
 		int server_rcvbuf; /* set server rcvbuf to this value if not null */
 		int pipesize;      /* pipe size in bytes, system defaults if zero */
+		int pipesize_max;  /* size pipes may grow to when full, no growth if zero */
+		unsigned int zerocopy_threshold; /* min output size to send with MSG_ZEROCOPY, 0=disabled */
 		int max_http_hdr;  /* max number of HTTP headers, use MAX_HTTP_HDR if zero */
 		int requri_len;    /* max len of request URI, use REQURI_LEN if zero */
 		int cookie_len;    /* max length of cookie captures */
 		int pattern_cache; /* max number of entries in the pattern cache. */
+		int sample_cache;  /* number of slots of the per-stream sample cache, 0=disabled */
 		int sslcachesize;  /* SSL cache size in session, defaults to 20000 */
 		int comp_maxlevel;    /* max HTTP compression level */
 		int pool_low_ratio;   /* max ratio of FDs used before we stop using new idle connections */
@@ -161,11 +182,16 @@ struct global {
 		int pool_low_count;   /* max number of opened fd before we stop using new idle connections */
 		int pool_high_count;  /* max number of opened fd before we start killing idle connections when creating new connections */
 		unsigned short idle_timer; /* how long before an empty buffer is considered idle (ms) */
+		int log_batch;        /* max number of log datagrams batched per thread, 0=disabled */
 #ifdef USE_QUIC
 		unsigned int quic_backend_max_idle_timeout;
+		unsigned int quic_frontend_ack_threshold;
+		unsigned int quic_frontend_max_ack_delay;
 		unsigned int quic_frontend_max_idle_timeout;
 		unsigned int quic_frontend_max_streams_bidi;
+		unsigned int quic_qpack_max_table_capacity;
 		unsigned int quic_retry_threshold;
+		unsigned int quic_retry_rate;
 		unsigned int quic_streams_buf;
 #endif /* USE_QUIC */
 	} tune;
@@ -178,7 +204,7 @@ struct global {
 		} ux;
 	} unix_bind;
 	struct proxy *cli_fe;           /* the frontend holding the stats settings */
-	int numa_cpu_mapping;
+	int numa_cpu_mapping;           /* NUMA_CPU_MAP_* */
 	int cfg_curr_line;              /* line number currently being parsed */
 	const char *cfg_curr_file;      /* config file currently being parsed or NULL */
 	char *cfg_curr_section;         /* config section name currently being parsed or NULL */
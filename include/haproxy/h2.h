@@ -83,6 +83,9 @@ enum h2_ft {
 	H2_FT_ENTRIES /* must be last */
 } __attribute__((packed));
 
+/* extension frame types, not subject to the checks above */
+#define H2_FT_PRIORITY_UPDATE   0x10      // RFC9218 #7.1
+
 /* frame types, turned to bits or bit fields */
 enum {
 	/* one bit per frame type */
@@ -164,6 +167,7 @@ enum h2_err {
 #define H2_SETTINGS_MAX_FRAME_SIZE          0x0005
 #define H2_SETTINGS_MAX_HEADER_LIST_SIZE    0x0006
 #define H2_SETTINGS_ENABLE_CONNECT_PROTOCOL 0x0008
+#define H2_SETTINGS_NO_RFC7540_PRIORITIES   0x0009
 
 
 /* some protocol constants */
@@ -236,6 +240,7 @@ static inline const char *h2_ft_str(int type)
 	case H2_FT_PING          : return "PING";
 	case H2_FT_GOAWAY        : return "GOAWAY";
 	case H2_FT_WINDOW_UPDATE : return "WINDOW_UPDATE";
+	case H2_FT_PRIORITY_UPDATE : return "PRIORITY_UPDATE";
 	default                  : return "_UNKNOWN_";
 	}
 }
@@ -29,5 +29,10 @@ unsigned int hash_wt6(const void *input, int len);
 unsigned int hash_sdbm(const void *input, int len);
 unsigned int hash_crc32(const void *input, int len);
 uint32_t hash_crc32c(const void *input, int len);
+unsigned int hash_djb2_lower(const void *input, int len);
+unsigned int hash_wt6_lower(const void *input, int len);
+unsigned int hash_sdbm_lower(const void *input, int len);
+unsigned int hash_crc32_lower(const void *input, int len);
+uint32_t hash_crc32c_lower(const void *input, int len);
 
 #endif /* _HAPROXY_HASH_H_ */
@@ -110,6 +110,7 @@ struct hlua {
 	unsigned int run_time; /* Lua total execution time in ms. */
 	struct task *task; /* The task associated with the lua stack execution.
 	                      We must wake this task to continue the task execution */
+	const struct hlua_function *fcn; /* registered function being run, NULL if none (for profiling) */
 	struct list com; /* The list head of the signals attached to this task. */
 	struct list hc_list;  /* list of httpclient associated to this lua task */
 	struct ebpt_node node;
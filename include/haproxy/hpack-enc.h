@@ -34,8 +34,12 @@
 #include <haproxy/buf-t.h>
 #include <haproxy/http-t.h>
 
+struct hpack_dht;
+
 int hpack_encode_header(struct buffer *out, const struct ist n,
 			const struct ist v);
+int hpack_encode_header_dht(struct buffer *out, struct hpack_dht *dht,
+			    const struct ist n, const struct ist v);
 
 /* Returns the number of bytes required to encode the string length <len>. The
  * number of usable bits is an integral multiple of 7 plus 6 for the last byte.
@@ -79,6 +83,26 @@ static inline int hpack_encode_len(char *out, int pos, int len)
 	return pos;
 }
 
+/* Encodes integer <val> using an <n>-bit prefix (RFC7541#5.1) into <out>+<pos>
+ * and returns the new position. The <code> bits are merged into the first
+ * byte. The caller is responsible for checking that 6 bytes are available.
+ */
+static inline int hpack_encode_int(char *out, int pos, uint8_t code, int n, uint32_t val)
+{
+	uint32_t max = (1U << n) - 1;
+
+	if (val < max) {
+		out[pos++] = code | val;
+		return pos;
+	}
+
+	out[pos++] = code | max;
+	for (val -= max; val >= 128; val >>= 7)
+		out[pos++] = val | 128;
+	out[pos++] = val;
+	return pos;
+}
+
 /* Tries to encode header field index <idx> with short value <val> into the
  * aligned buffer <out>. Returns non-zero on success, 0 on failure (buffer
  * full). The caller is responsible for ensuring that the length of <val> is
@@ -133,6 +133,10 @@ enum http_etag_type {
 	ETAG_WEAK
 };
 
+/* RFC9218 extensible priorities: urgency ranges from 0 (highest) to 7 */
+#define HTTP_PRIO_URGENCY_DEF   3
+#define HTTP_PRIO_URGENCY_MAX   7
+
 /* Indicates what elements have been parsed in a HTTP URI. */
 enum http_uri_parser_state {
 	URI_PARSER_STATE_BEFORE = 0,
@@ -46,6 +46,9 @@ int http_header_match2(const char *hdr, const char *end,
                        const char *name, int len);
 char *http_find_hdr_value_end(char *s, const char *e);
 char *http_find_cookie_value_end(char *s, const char *e);
+char *http_extract_next_cookie(char *hdr, const char *hdr_end, int list,
+                               char **name, size_t *name_l,
+                               char **value, size_t *value_l);
 char *http_extract_cookie_value(char *hdr, const char *hdr_end,
                                 char *cookie_name, size_t cookie_name_l,
                                 int list, char **value, size_t *value_l);
@@ -66,6 +69,8 @@ int http_compare_etags(struct ist etag1, struct ist etag2);
 struct ist http_trim_leading_spht(struct ist value);
 struct ist http_trim_trailing_spht(struct ist value);
 
+void http_parse_priority(struct ist value, uint8_t *urgency, uint8_t *incremental);
+
 /*
  * Given a path string and its length, find the position of beginning of the
  * query string. Returns NULL if no query string is found in the path.
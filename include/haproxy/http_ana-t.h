@@ -76,6 +76,8 @@
 #define TX_L7_RETRY     0x000800000     /* The transaction may attempt L7 retries */
 #define TX_D_L7_RETRY   0x001000000     /* Disable L7 retries on this transaction, even if configured to do it */
 
+#define TX_CACHE_PENDING 0x02000000     /* the transaction owns a pending cache miss (collapsed forwarding) */
+
 /* This function is used to report flags in debugging tools. Please reflect
  * below any single-bit flag addition above in the same order via the
  * __APPEND_FLAG and __APPEND_ENUM macros. The new end of the buffer is
@@ -90,7 +92,7 @@ static forceinline char *txn_show_flags(char *buf, size_t len, const char *delim
 	/* flags & enums */
 	_(TX_SCK_PRESENT, _(TX_CACHEABLE, _(TX_CACHE_COOK, _(TX_CACHE_IGNORE,
 	_(TX_CON_WANT_TUN, _(TX_CACHE_HAS_SEC_KEY, _(TX_USE_PX_CONN,
-	_(TX_NOT_FIRST, _(TX_L7_RETRY, _(TX_D_L7_RETRY))))))))));
+	_(TX_NOT_FIRST, _(TX_L7_RETRY, _(TX_D_L7_RETRY, _(TX_CACHE_PENDING)))))))))));
 
 	_e(TX_SCK_MASK, TX_SCK_FOUND,     _e(TX_SCK_MASK, TX_SCK_DELETED,
 	_e(TX_SCK_MASK, TX_SCK_INSERTED,  _e(TX_SCK_MASK, TX_SCK_REPLACED,
@@ -157,6 +159,11 @@ static forceinline char *hmsg_show_flags(char *buf, size_t len, const char *deli
  * cache.c).*/
 #define HTTP_CACHE_SEC_KEY_LEN (sizeof(uint32_t)+sizeof(int))
 
+/* Maximum number of path prefixes of a request indexed by the cache for
+ * purges (see the "index-prefixes" cache keyword).
+ */
+#define HTTP_CACHE_MAX_PREFIXES 8
+
 
 /* Redirect flags */
 enum {
@@ -235,6 +242,21 @@ struct http_msg {
 /* This is an HTTP transaction. It contains both a request message and a
  * response message (which can be empty).
  */
+/* Index of the cookies found in a request's Cookie header, built by the first
+ * cookie sample fetch and shared by the next ones. It is only valid as long as
+ * the header is found at the same place with the same length and hash, so any
+ * modification of the header implicitly invalidates it.
+ */
+struct http_cookie_idx {
+	struct ist hdr;                 /* Cookie header value the index was built from */
+	uint64_t hash;                  /* XXH3 hash of this value */
+	int count;                      /* number of indexed cookies, -1 if too many */
+	struct {
+		struct ist name;
+		struct ist value;
+	} cookies[HTTP_COOKIE_IDX_MAX];
+};
+
 struct http_txn {
 	struct http_msg rsp;            /* HTTP response message */
 	struct http_msg req;            /* HTTP request message */
@@ -246,6 +268,8 @@ struct http_txn {
 	struct buffer l7_buffer;        /* To store the data, in case we have to retry */
 	char cache_hash[20];               /* Store the cache hash  */
 	char cache_secondary_hash[HTTP_CACHE_SEC_KEY_LEN]; /* Optional cache secondary key. */
+	unsigned int cache_prefix_cnt;     /* Number of entries in cache_prefix_hash */
+	uint64_t cache_prefix_hash[HTTP_CACHE_MAX_PREFIXES]; /* Purge keys of the path prefixes */
 	char *uri;                      /* first line if log needed, NULL otherwise */
 	char *cli_cookie;               /* cookie presented by the client, in capture mode */
 	char *srv_cookie;               /* cookie presented by the server, in capture mode */
@@ -253,6 +277,7 @@ struct http_txn {
 	int cookie_last_date;           /* if non-zero, last date the expirable cookie was set/seen */
 
 	struct http_auth_data auth;	/* HTTP auth data */
+	struct http_cookie_idx *cookie_idx; /* index of the request cookies, NULL if not built */
 };
 
 #endif /* _HAPROXY_PROTO_HTTP_T_H */
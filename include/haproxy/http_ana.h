@@ -31,6 +31,7 @@
 
 extern struct pool_head *pool_head_uniqueid;
 extern struct pool_head *pool_head_http_txn;
+extern struct pool_head *pool_head_http_cookie_idx;
 
 int http_wait_for_request(struct stream *s, struct channel *req, int an_bit);
 int http_process_req_common(struct stream *s, struct channel *req, int an_bit, struct proxy *px);
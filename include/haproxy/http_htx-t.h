@@ -38,6 +38,28 @@ struct http_hdr_ctx {
 	uint16_t       lws_after;
 };
 
+/* number of hash buckets of a header index, must be a power of two */
+#define HTTP_HDR_IDX_BUCKETS 64
+
+/* Index of the header names of an HTX message, used to look headers up by name
+ * without comparing all of them. Headers sharing the same bucket are chained
+ * in the order of their position in the message. It is only valid for the
+ * message <htx> as long as its generation number and first block are
+ * unchanged.
+ */
+struct http_hdr_idx {
+	const struct htx *htx;        /* indexed message, NULL if none */
+	uint32_t gen;                 /* htx->gen when the index was built */
+	int32_t first;                /* htx->first when the index was built */
+	int count;                    /* number of indexed headers, <0 if not built */
+	uint16_t head[HTTP_HDR_IDX_BUCKETS]; /* first entry of each bucket plus one, 0 if none */
+	struct {
+		int32_t pos;          /* header block position */
+		uint32_t hash;        /* hash of the lower case header name */
+		uint16_t next;        /* next entry in the same bucket plus one, 0 if none */
+	} ent[HTTP_HDR_IDX_MAX];
+};
+
 
 /* Structure used to build the header list of an HTTP reply */
 struct http_reply_hdr {
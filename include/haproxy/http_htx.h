@@ -68,6 +68,7 @@ struct http_reply *http_parse_http_reply(const char **args, int *orig_arg, struc
 					 int default_status, char **errmsg);
 
 int http_scheme_based_normalize(struct htx *htx);
+void http_get_priority(const struct htx *htx, uint8_t *urgency, uint8_t *incremental);
 
 void http_cookie_register(struct http_hdr *list, int idx, int *first, int *last);
 int http_cookie_merge(struct htx *htx, struct http_hdr *list, int first);
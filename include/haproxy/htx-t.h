@@ -253,8 +253,7 @@ struct htx {
 
 	uint64_t extra;  /* known bytes amount remaining to receive */
 	uint32_t flags;  /* HTX_FL_* */
-
-	/* XXX 4 bytes unused */
+	uint32_t gen;    /* changes each time blocks are added, removed, moved or renamed, see htx_touch() */
 
 	/* Blocks representing the HTTP message itself */
 	char blocks[VAR_ARRAY] __attribute__((aligned(8)));
@@ -31,6 +31,8 @@
 #include <haproxy/htx-t.h>
 
 extern struct htx htx_empty;
+extern THREAD_LOCAL unsigned int htx_defrag_cnt;
+extern THREAD_LOCAL uint32_t htx_last_gen;
 
 struct htx_blk *htx_defrag(struct htx *htx, struct htx_blk *blk, uint32_t info);
 struct htx_blk *htx_add_blk(struct htx *htx, enum htx_blk_type type, uint32_t blksz);
@@ -649,6 +651,17 @@ static inline int htx_almost_full(const struct htx *htx)
 	return 0;
 }
 
+/* Assigns a new generation number to the HTX message <htx>. It must be called
+ * each time blocks are added, removed, moved or have their name changed, so
+ * that indexes built on top of the message may detect they are outdated.
+ * Numbers are never reused by a thread before wrapping, so that a message
+ * reset or copied at the same address cannot be mistaken for a previous one.
+ */
+static inline void htx_touch(struct htx *htx)
+{
+	htx->gen = ++htx_last_gen;
+}
+
 /* Resets an HTX message */
 static inline void htx_reset(struct htx *htx)
 {
@@ -657,6 +670,7 @@ static inline void htx_reset(struct htx *htx)
 	htx->tail_addr = htx->head_addr = htx->end_addr = 0;
 	htx->extra = 0;
 	htx->flags = HTX_FL_NONE;
+	htx_touch(htx);
 }
 
 /* Returns the available room for raw data in buffer <buf> once HTX overhead is
@@ -762,6 +776,7 @@ static inline int htx_copy_msg(struct htx *htx, const struct buffer *msg)
 	/* The destination HTX message is allocated and empty, we can do a raw copy */
 	if (htx_is_empty(htx) && htx_free_space(htx)) {
 		memcpy(htx, msg->area, msg->size);
+		htx_touch(htx);
 		return 1;
 	}
 
@@ -69,6 +69,11 @@ struct jwt_cert_tree_entry {
 	char path[VAR_ARRAY];
 };
 
+/* default number of entries per thread in the verification cache */
+#ifndef JWT_CACHE_DEF_SIZE
+#define JWT_CACHE_DEF_SIZE 1024
+#endif
+
 enum jwt_vrfy_status {
 	JWT_VRFY_KO = 0,
 	JWT_VRFY_OK = 1,
@@ -80,6 +85,12 @@ enum jwt_vrfy_status {
 	JWT_VRFY_UNKNOWN_CERT  = -5
 };
 
+struct jwt_cache_entry {
+	unsigned char digest[SHA256_DIGEST_LENGTH]; /* SHA-256 of alg, key and token */
+	signed char status;                         /* JWT_VRFY_OK or JWT_VRFY_KO */
+	char used;                                  /* non-zero once filled */
+};
+
 #endif /* USE_OPENSSL */
 
 
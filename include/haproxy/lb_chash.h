@@ -30,6 +30,7 @@ struct server;
 int chash_init_server_tree(struct proxy *p);
 struct server *chash_get_next_server(struct proxy *p, struct server *srvtoavoid);
 struct server *chash_get_server_hash(struct proxy *p, unsigned int hash, const struct server *avoid);
+int chash_server_is_eligible(struct server *s);
 
 #endif /* _HAPROXY_LB_CHASH_H */
 
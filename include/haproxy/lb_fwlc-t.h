@@ -23,10 +23,12 @@
 #define _HAPROXY_LB_FWLC_T_H
 
 #include <import/ebtree-t.h>
+#include <haproxy/list-t.h>
 
 struct lb_fwlc {
 	struct eb_root act;	/* weighted least conns on the active servers */
 	struct eb_root bck;	/* weighted least conns on the backup servers */
+	struct mt_list pending;	/* servers waiting to be repositioned ("lazy" mode only) */
 };
 
 #endif /* _HAPROXY_LB_FWLC_T_H */
@@ -0,0 +1,49 @@
+/*
+ * include/haproxy/lb_maglev-t.h
+ * Types for the Maglev Hash LB algorithm.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HAPROXY_LB_MAGLEV_T_H
+#define _HAPROXY_LB_MAGLEV_T_H
+
+struct server;
+
+/* Per-server state used while populating the lookup table */
+struct maglev_srv {
+	struct server *srv;     /* the server */
+	unsigned int pos;       /* next position in this server's permutation */
+	unsigned int skip;      /* step between two positions of the permutation */
+	unsigned int weight;    /* server's effective weight */
+	unsigned int credit;    /* accumulated weight, one entry per max weight */
+};
+
+struct lb_maglev {
+	struct server **table;    /* lookup table of <size> entries */
+	unsigned int size;        /* size of the table, a prime number */
+	unsigned int nb_srv;      /* number of servers present in the table */
+	struct maglev_srv *work;  /* work area used to populate the table */
+	unsigned int nb_work;     /* number of servers the work area may hold */
+};
+
+#endif /* _HAPROXY_LB_MAGLEV_T_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ */
@@ -0,0 +1,49 @@
+/*
+ * include/haproxy/lb_rdv-t.h
+ * Types for the Rendezvous Hash LB algorithm.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HAPROXY_LB_RDV_T_H
+#define _HAPROXY_LB_RDV_T_H
+
+struct server;
+
+/* A group of usable servers (active or backup), stored as compact arrays so
+ * that the scores of all servers may be computed in a tight loop.
+ */
+struct rdv_grp {
+	unsigned int *seed;     /* per-server hash seed, derived from its ID */
+	float *inv_weight;      /* per-server inverted effective weight */
+	struct server **srv;    /* the servers themselves */
+	unsigned int nb;        /* number of servers in the group */
+};
+
+struct lb_rdv {
+	struct rdv_grp act;     /* usable active servers */
+	struct rdv_grp bck;     /* usable backup servers */
+	void *area;             /* storage area of both groups' arrays */
+	unsigned int size;      /* number of servers the area may hold per group */
+};
+
+#endif /* _HAPROXY_LB_RDV_T_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ */
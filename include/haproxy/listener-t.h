@@ -128,6 +128,7 @@ enum li_status {
 #define BC_SSL_O_NONE           0x0000
 #define BC_SSL_O_NO_TLS_TICKETS 0x0100	/* disable session resumption tickets */
 #define BC_SSL_O_PREF_CLIE_CIPH 0x0200  /* prefer client ciphers */
+#define BC_SSL_O_KTLS           0x0400  /* try to offload record encryption to the kernel */
 #endif
 
 struct tls_version_filter {
@@ -187,6 +188,9 @@ struct bind_conf {
 	char *ca_sign_pass;        /* CAKey passphrase */
 
 	struct ckch_data *ca_sign_ckch;	/* CA and possible certificate chain for ca generation */
+
+	char *early_data_table_name; /* name of the 0-RTT anti-replay stick-table */
+	struct stktable *early_data_table; /* 0-RTT anti-replay stick-table once resolved */
 #endif
 #ifdef USE_QUIC
 	struct quic_transport_params quic_params; /* QUIC transport parameters. */
@@ -128,6 +128,12 @@ void listener_accept(struct listener *l);
  */
 int listener_backlog(const struct listener *l);
 
+/* Returns the only CPU the threads of listener <l> are bound to according to
+ * the "cpu-map" directives, or -1 if they are bound to several CPUs or not
+ * bound at all.
+ */
+int listener_single_cpu(struct listener *l);
+
 /* Notify the listener that a connection initiated from it was released. This
  * is used to keep the connection count consistent and to possibly re-open
  * listening when it was limited.
@@ -46,6 +46,7 @@
 #define LOG_OPT_HTTP            0x00000020
 #define LOG_OPT_ESC             0x00000040
 #define LOG_OPT_MERGE_SPACES    0x00000080
+#define LOG_OPT_CBOR            0x00000100
 
 
 /* Fields that need to be extracted from the incoming connection or request for
@@ -82,6 +83,7 @@ enum log_fmt {
 	LOG_FORMAT_TIMED,
 	LOG_FORMAT_ISO,
 	LOG_FORMAT_RAW,
+	LOG_FORMAT_CBOR,
 	LOG_FORMATS           /* number of supported log formats, must always be last */
 };
 
@@ -197,8 +199,9 @@ struct logformat_node {
 	struct list list;
 	int type;      // LOG_FMT_*
 	int options;   // LOG_OPT_*
-	char *arg;     // text for LOG_FMT_TEXT, arg for others
+	char *arg;     // text for LOG_FMT_TEXT, encoded key with LOG_OPT_CBOR, arg for others
 	void *expr;    // for use with LOG_FMT_EXPR
+	size_t len;    // length of <arg> for LOG_FMT_TEXT or with LOG_OPT_CBOR
 };
 
 /* Range of indexes for log sampling. */
@@ -237,6 +240,14 @@ struct logsrv {
 	int minlvl;
 	int maxlen;
 	struct logsrv *ref;
+	struct {
+		unsigned int max;       /* max sampling ratio in adaptive mode, 0 if disabled */
+		unsigned int ratio;     /* current sampling ratio (1 = all logs are sent) */
+		unsigned int idx;       /* index of the next log to be sampled */
+		unsigned int fails;     /* number of failed sends or drops */
+		unsigned int last_fails; /* <fails> at the last ratio update */
+		unsigned int next;      /* date of the next ratio update (ticks) */
+	} adapt;
 	struct {
                 char *file;                     /* file where the logsrv appears */
                 int line;                       /* line where the logsrv appears */
@@ -43,6 +43,9 @@ extern char default_https_log_format[];
 extern char default_rfc5424_sd_log_format[];
 
 extern unsigned int dropped_logs;
+extern unsigned int log_batches;
+extern unsigned long long log_batched_dgrams;
+extern THREAD_LOCAL int log_pending_dgrams;
 
 /* lof forward proxy list */
 extern struct proxy *cfg_log_forward;
@@ -59,6 +62,7 @@ void syslog_fd_handler(int fd);
 /* Initialize/Deinitialize log buffers used for syslog messages */
 int init_log_buffers(void);
 void deinit_log_buffers(void);
+void __log_flush_dgrams(void);
 
 /* build a log line for the session and an optional stream */
 int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t maxsize, struct list *list_format);
@@ -162,6 +166,13 @@ static inline int in_smp_log_range(struct smp_log_range *rg, unsigned int idx)
        return 0;
 }
 
+/* Sends the log datagrams batched by the current thread, if any */
+static inline void log_flush_dgrams(void)
+{
+	if (unlikely(log_pending_dgrams))
+		__log_flush_dgrams();
+}
+
 /*
  * Builds a log line for the stream (must be valid).
  */
@@ -170,7 +181,8 @@ static inline int build_logline(struct stream *s, char *dst, size_t maxsize, str
 	return sess_build_logline(strm_sess(s), s, dst, maxsize, list_format);
 }
 
-struct ist *build_log_header(enum log_fmt format, int level, int facility, struct ist *metadata, size_t *nbelem);
+struct ist *build_log_header(enum log_fmt format, int level, int facility, struct ist *metadata,
+                             const struct ist *msg, size_t nmsg, size_t *nbelem);
 
 /*
  * lookup log forward proxy by name
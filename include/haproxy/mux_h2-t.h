@@ -61,6 +61,7 @@
 #define H2_CF_WINDOW_OPENED     0x00010000  // demux increased window already advertised
 #define H2_CF_RCVD_SHUT         0x00020000  // a recv() attempt already failed on a shutdown
 #define H2_CF_END_REACHED       0x00040000  // pending data too short with RCVD_SHUT present
+#define H2_CF_EDHT_RESET        0x00080000  // encoder dynamic table must be flushed on next block
 
 #define H2_CF_RCVD_RFC8441      0x00100000  // settings from RFC8441 has been received indicating support for Extended CONNECT
 #define H2_CF_SHTS_UPDATED      0x00200000  // SETTINGS_HEADER_TABLE_SIZE updated
@@ -69,6 +70,11 @@
 #define H2_CF_ERR_PENDING       0x00800000  // A write error was detected (block sends but not reads)
 #define H2_CF_ERROR             0x01000000  //A read error was detected (handled has an abort)
 
+/* receive window auto-tuning */
+#define H2_CF_BDP_PING          0x02000000  // a BDP estimation PING must be sent
+#define H2_CF_BDP_WAIT          0x04000000  // a BDP estimation PING was sent, waiting for its ACK
+#define H2_CF_RXWIN_UPDATE      0x08000000  // a SETTINGS frame advertising the new rx_win must be sent
+
 /* This function is used to report flags in debugging tools. Please reflect
  * below any single-bit flag addition above in the same order via the
  * __APPEND_FLAG macro. The new end of the buffer is returned.
@@ -85,8 +91,9 @@ static forceinline char *h2c_show_flags(char *buf, size_t len, const char *delim
 	_(H2_CF_DEM_SHORT_READ, _(H2_CF_DEM_IN_PROGRESS, _(H2_CF_GOAWAY_SENT,
 	_(H2_CF_GOAWAY_FAILED, _(H2_CF_WAIT_FOR_HS, _(H2_CF_IS_BACK,
 	_(H2_CF_WINDOW_OPENED, _(H2_CF_RCVD_SHUT, _(H2_CF_END_REACHED,
-	_(H2_CF_RCVD_RFC8441, _(H2_CF_SHTS_UPDATED, _(H2_CF_DTSU_EMITTED,
-	_(H2_CF_ERR_PENDING, _(H2_CF_ERROR))))))))))))))))))))));
+	_(H2_CF_EDHT_RESET, _(H2_CF_RCVD_RFC8441, _(H2_CF_SHTS_UPDATED,
+	_(H2_CF_DTSU_EMITTED, _(H2_CF_ERR_PENDING, _(H2_CF_ERROR,
+	_(H2_CF_BDP_PING, _(H2_CF_BDP_WAIT, _(H2_CF_RXWIN_UPDATE))))))))))))))))))))))))));
 	/* epilogue */
 	_(~0U);
 	return buf;
@@ -23,8 +23,30 @@
 #ifndef _HAPROXY_NAMESPACE_T_H
 #define _HAPROXY_NAMESPACE_T_H
 
+#ifdef USE_NS
+#include <pthread.h>
+#endif
+
 #include <import/ebtree-t.h>
 #include <haproxy/api-t.h>
+#include <haproxy/thread-t.h>
+
+#ifdef USE_NS
+/* Sockets created in advance in a namespace by a helper thread which lives in
+ * it, one array per address family (0=IPv4, 1=IPv6). <want> holds the bit of
+ * each family that was requested at least once and must be kept filled.
+ */
+struct netns_sock_pool {
+	__decl_thread(HA_SPINLOCK_T lock);
+	int fds[2][NETNS_SOCK_POOL_SIZE];
+	int count[2];
+	uint want;                  /* 1<<family index: families to refill */
+	uint state;                 /* 0=not started, 1=running, 2=failed */
+	uint wakeup;                /* non-zero when a refill is requested */
+	pthread_mutex_t mtx;        /* only used to sleep/wake the helper */
+	pthread_cond_t cond;
+};
+#endif
 
 /* the struct is just empty if namespaces are not supported */
 struct netns_entry
@@ -33,6 +55,7 @@ struct netns_entry
 	struct ebpt_node node;
 	size_t name_len;
 	int fd;
+	struct netns_sock_pool *pool; /* NULL if not used */
 #endif
 };
 
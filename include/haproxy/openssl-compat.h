@@ -91,6 +91,23 @@
 #define HAVE_SSL_KEYLOG
 #endif
 
+/* The private key operations may be offloaded to crypto threads from within
+ * OpenSSL's async jobs, through legacy RSA and EC_KEY methods.
+ */
+#if defined(SSL_MODE_ASYNC) && defined(USE_THREAD) && (HA_OPENSSL_VERSION_NUMBER >= 0x10100000L) && \
+    !defined(LIBRESSL_VERSION_NUMBER) && !defined(OPENSSL_IS_BORINGSSL) && !defined(OPENSSL_NO_EC)
+#define HAVE_SSL_OFFLOAD
+#endif
+
+/* Kernel TLS offload is available with OpenSSL 3.0 on Linux. Only the
+ * transmission side is supported, see ha_ssl_ctrl().
+ */
+#if (HA_OPENSSL_VERSION_NUMBER >= 0x3000000fL) && defined(SSL_OP_ENABLE_KTLS) && \
+    !defined(OPENSSL_NO_KTLS) && !defined(LIBRESSL_VERSION_NUMBER) && !defined(OPENSSL_IS_BORINGSSL) && \
+    defined(__linux__)
+#define HAVE_SSL_KTLS
+#endif
+
 
 #if (HA_OPENSSL_VERSION_NUMBER >= 0x3000000fL)
 #define HAVE_OSSL_PARAM
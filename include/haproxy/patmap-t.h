@@ -0,0 +1,93 @@
+/*
+ * include/haproxy/patmap-t.h
+ * This file provides structures and types for compiled map files.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HAPROXY_PATMAP_T_H
+#define _HAPROXY_PATMAP_T_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/* A compiled map is a file produced by dev/patmap/mapc, which is mapped
+ * read-only and directly searched. It starts with a struct patmap_hdr,
+ * followed by the array of entries, then by the strings area which holds
+ * all keys and values, each followed by a zero. All integers are stored in
+ * host byte order, so the file may only be used on the architecture it was
+ * built for, which is verified using the <endian> field. The last byte of
+ * the file is always zero so that a string may never be read past the end
+ * of the mapping.
+ */
+#define PATMAP_MAGIC     "HAPMAP1\n"
+#define PATMAP_ENDIAN    0x01020304U
+#define PATMAP_NONE      (~(uint64_t)0)
+
+/* type of compiled map, stored in the header */
+enum patmap_type {
+	PATMAP_T_STR  = 1,  /* string keys, usable with exact and prefix matches */
+	PATMAP_T_IPV4 = 2,  /* IPv4 ranges, usable with IP matches */
+};
+
+/* file header */
+struct patmap_hdr {
+	char     magic[8];  /* PATMAP_MAGIC */
+	uint32_t endian;    /* PATMAP_ENDIAN */
+	uint32_t type;      /* PATMAP_T_* */
+	uint64_t count;     /* number of entries */
+	uint64_t ent_ofs;   /* offset of the entries array in the file */
+	uint64_t str_ofs;   /* offset of the strings area in the file */
+	uint64_t size;      /* total file size */
+};
+
+/* An entry of a PATMAP_T_STR map. Entries are unique and sorted by key in
+ * memcmp() order, a key being placed before any longer key it is a prefix
+ * of. <parent> is the index of the longest other key which is a prefix of
+ * this one, or PATMAP_NONE, it is used for prefix matching. Offsets are
+ * relative to the strings area.
+ */
+struct patmap_str {
+	uint64_t key_ofs;
+	uint64_t val_ofs;
+	uint64_t parent;
+	uint32_t key_len;
+	uint32_t val_len;
+};
+
+/* An entry of a PATMAP_T_IPV4 map: the range of addresses <from> to <to>
+ * (inclusive, host byte order). Ranges are disjoint and sorted. Overlapping
+ * networks are flattened by the compiler so that the most specific one
+ * wins, which provides the same result as a longest prefix match.
+ */
+struct patmap_ip4 {
+	uint32_t from;
+	uint32_t to;
+	uint64_t val_ofs;
+	uint32_t val_len;
+	uint32_t unused;
+};
+
+/* a mapped compiled map */
+struct patmap {
+	void *area;                       /* start of the mapping */
+	size_t size;                      /* size of the mapping */
+	enum patmap_type type;            /* PATMAP_T_* */
+	uint64_t count;                   /* number of entries */
+	const void *ent;                  /* entries array */
+	const char *str;                  /* strings area */
+};
+
+#endif /* _HAPROXY_PATMAP_T_H */
@@ -0,0 +1,48 @@
+/*
+ * include/haproxy/patmap.h
+ * This file provides functions to use compiled map files.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HAPROXY_PATMAP_H
+#define _HAPROXY_PATMAP_H
+
+#include <haproxy/patmap-t.h>
+
+int patmap_is_compiled(const char *file);
+struct patmap *patmap_open(const char *file, char **err);
+void patmap_close(struct patmap *map);
+uint64_t patmap_lookup_str(const struct patmap *map, const char *key, size_t len);
+uint64_t patmap_lookup_beg(const struct patmap *map, const char *key, size_t len);
+uint64_t patmap_lookup_ip4(const struct patmap *map, uint32_t addr);
+
+/* returns the name of map type <type> */
+static inline const char *patmap_type_name(enum patmap_type type)
+{
+	return type == PATMAP_T_STR ? "str" : type == PATMAP_T_IPV4 ? "ip" : "unknown";
+}
+
+/* returns the zero-terminated value of entry <idx> of map <map>, which must
+ * be valid.
+ */
+static inline const char *patmap_value(const struct patmap *map, uint64_t idx)
+{
+	if (map->type == PATMAP_T_STR)
+		return map->str + ((const struct patmap_str *)map->ent)[idx].val_ofs;
+	return map->str + ((const struct patmap_ip4 *)map->ent)[idx].val_ofs;
+}
+
+#endif /* _HAPROXY_PATMAP_H */
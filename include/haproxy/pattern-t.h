@@ -95,6 +95,7 @@ enum {
 #define PAT_REF_MAP 0x1 /* Set if the reference is used by at least one map. */
 #define PAT_REF_ACL 0x2 /* Set if the reference is used by at least one acl. */
 #define PAT_REF_SMP 0x4 /* Flag used if the reference contains a sample. */
+#define PAT_REF_WATCH 0x8 /* Set if some users indexed the contents, see pat_ref_watch_gen. */
 
 /* This struct contain a list of reference strings for dunamically
  * updatable patterns.
@@ -111,6 +112,9 @@ struct pat_ref {
 	int unique_id; /* Each pattern reference have unique id. */
 	unsigned long long revision; /* updated for each update */
 	unsigned long long entry_cnt; /* the total number of entries */
+	struct patmap *mmap; /* compiled map if any, looked up without locking (see patmap-t.h) */
+	int cache_size; /* entries of the dedicated per-thread caches, 0 for none, -1 for the shared one */
+	struct lru64_head **lru; /* dedicated per-thread caches indexed by tid if cache_size > 0 */
 	__decl_thread(HA_SPINLOCK_T lock); /* Lock used to protect pat ref elements */
 };
 
@@ -183,6 +187,71 @@ struct pattern_list {
 	struct pattern pat;
 };
 
+/* Kinds of string automatons which may be attached to a pattern expression */
+enum pat_acm_kind {
+	PAT_ACM_SUB = 0,  /* Aho-Corasick automaton for "sub" */
+	PAT_ACM_END,      /* reversed trie for "end" */
+	PAT_ACM_KINDS     /* number of kinds */
+};
+
+/* Multi-pattern string matching automaton built from the list of patterns
+ * of an expression, so that the "sub" and "end" match methods do not need
+ * to test each pattern in turn. It is built from all patterns regardless of
+ * their generation, which is checked at match time. Nodes are designated by
+ * their index, node 0 being the root, which is never a child so that 0 also
+ * means "none". The edges and patterns of a node are contiguous, the edges
+ * being sorted by byte and the patterns by their rank in the list.
+ */
+struct pat_acm_node {
+	unsigned int edge;       /* index of this node's first edge */
+	unsigned int nb_edges;   /* number of edges leaving this node */
+	unsigned int fail;       /* longest proper suffix which is a node (sub only) */
+	unsigned int dict;       /* next node on the fail chain having patterns, or 0 */
+	unsigned int pat;        /* index of this node's first pattern */
+	unsigned int nb_pats;    /* number of patterns ending on this node */
+};
+
+struct pat_acm_edge {
+	unsigned int node;       /* destination node */
+	unsigned char c;         /* byte leading to this node (lower case if PAT_MF_IGNORE_CASE) */
+};
+
+struct pat_acm_pat {
+	struct pattern *pat;     /* pattern ending on this node */
+	unsigned int rank;       /* its rank in the expression's list */
+};
+
+struct pat_acm {
+	unsigned int root[256];  /* direct transitions from the root */
+	struct pat_acm_node *nodes;
+	struct pat_acm_edge *edges;
+	struct pat_acm_pat *pats;
+	unsigned int nb_nodes;
+};
+
+/* Flat longest prefix match table built from the IPv4 tree of an expression
+ * once it holds at least PAT_IP4_TAB_MIN networks, so that "ip" matches touch
+ * at most 3 cache lines instead of walking the tree (DIR-16-8-8). <tbl> starts
+ * with 65536 entries indexed by the upper 16 bits of the address, followed by
+ * chunks of 256 entries indexed by the next 8 bits, then the lowest 8 bits.
+ * An entry is either 0 (no match), the index + 1 of the matching network in
+ * <pats>, or PAT_IP4_CHUNK ORed with the offset of the next chunk in <tbl>.
+ * The generation of the network found is checked at match time. Networks
+ * added or deleted at run time only update the entries they cover.
+ */
+#define PAT_IP4_CHUNK 0x80000000U
+
+struct pat_ip4 {
+	uint32_t *tbl;                /* entries, see above */
+	struct pattern_tree **pats;   /* networks designated by the entries, NULL if unused */
+	uint32_t *free_idx;           /* unused indexes in <pats>, same size */
+	unsigned int nb_pats;         /* used part of <pats> */
+	unsigned int pats_alloc;      /* allocated size of <pats> and <free_idx> */
+	unsigned int nb_free;         /* number of indexes in <free_idx> */
+	unsigned int nb_ent;          /* number of entries in <tbl> */
+	unsigned int ent_alloc;       /* allocated size of <tbl> */
+};
+
 /* Description of a pattern expression.
  * It contains pointers to the parse and match functions, and a list or tree of
  * patterns to test against. The structure is organized so that the hot parts
@@ -200,6 +269,15 @@ struct pattern_expr {
 	struct eb_root pattern_tree;  /* may be used for lookup in large datasets */
 	struct eb_root pattern_tree_2;  /* may be used for different types */
 	int mflags;                     /* flags relative to the parsing or matching method. */
+	struct pat_acm *acm[PAT_ACM_KINDS]; /* automatons built from <patterns>, see pat_acm_get() */
+#ifdef USE_HYPERSCAN
+	struct pat_hs *hs;              /* regex database built from <patterns>, see pat_hs_get() */
+#endif
+	struct pat_ip4 *ip4;            /* table built from <pattern_tree> for "ip", see pat_ip4_get() */
+	unsigned int acm_busy;          /* non-zero while an automaton, database or table is being built */
+	unsigned long long cache_lookups;   /* pattern cache lookups, see pat_lru_get() */
+	unsigned long long cache_hits;      /* lookups which found a valid result */
+	unsigned long long cache_evictions; /* lookups which recycled another entry */
 	__decl_thread(HA_RWLOCK_T lock);               /* lock used to protect patterns */
 };
 
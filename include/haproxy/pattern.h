@@ -39,6 +39,7 @@ extern struct pattern *(*const pat_match_fcts[PAT_MATCH_NUM])(struct sample *, s
 
 /* This is the root of the list of all pattern_ref avalaibles. */
 extern struct list pattern_reference;
+extern unsigned int pat_ref_watch_gen;
 
 int pattern_finalize_config(void);
 
@@ -193,6 +194,8 @@ int pat_ref_delete_by_id(struct pat_ref *ref, struct pat_ref_elt *refelt);
 int pat_ref_prune(struct pat_ref *ref);
 int pat_ref_commit_elt(struct pat_ref *ref, struct pat_ref_elt *elt, char **err);
 int pat_ref_purge_range(struct pat_ref *ref, uint from, uint to, int budget);
+struct pattern *pat_ref_match_mmap(struct pat_ref *ref, struct pattern_head *head, struct sample *smp, int fill);
+int pat_ref_reload_mmap(struct pat_ref *ref, char **err);
 
 /* Create a new generation number for next pattern updates and returns it. This
  * must be used to atomically insert new patterns that will atomically replace
@@ -231,8 +234,11 @@ static inline void pat_ref_giveup(struct pat_ref *ref, unsigned int gen)
  */
 static inline int pat_ref_commit(struct pat_ref *ref, unsigned int gen)
 {
-	if ((int)(gen - ref->curr_gen) > 0)
+	if ((int)(gen - ref->curr_gen) > 0) {
 		ref->curr_gen = gen;
+		if (ref->flags & PAT_REF_WATCH)
+			HA_ATOMIC_INC(&pat_ref_watch_gen);
+	}
 	return gen - ref->curr_gen;
 }
 
@@ -51,6 +51,7 @@ struct shared_table {
 
 struct peer {
 	int local;                    /* proxy state */
+	int idx;                      /* position in the peers section, starting at 0 */
 	__decl_thread(HA_SPINLOCK_T lock); /* lock used to handle this peer section */
 	char *id;
 	struct {
@@ -66,6 +67,7 @@ struct peer {
 	unsigned int statuscode;      /* current/last session status code */
 	unsigned int reconnect;       /* next connect timer */
 	unsigned int heartbeat;       /* next heartbeat timer */
+	unsigned int next_push;       /* date when local updates may be pushed again, or TICK_ETERNITY */
 	unsigned int confirm;         /* confirm message counter */
 	unsigned int last_hdshk;      /* Date of the last handshake. */
 	uint32_t rx_hbt;              /* received heartbeats counter */
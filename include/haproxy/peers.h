@@ -36,7 +36,10 @@ extern struct peers *cfg_peers;
 int peers_init_sync(struct peers *peers);
 int peers_alloc_dcache(struct peers *peers);
 int peers_register_table(struct peers *, struct stktable *table);
+int peers_resync_done(const struct peers *peers);
 void peers_setup_frontend(struct proxy *fe);
+int intencode(uint64_t i, char **str);
+uint64_t intdecode(char **str, char *end);
 
 #if defined(USE_OPENSSL)
 static inline enum obj_type *peer_session_target(struct peer *p, struct stream *s)
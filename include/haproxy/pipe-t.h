@@ -30,6 +30,7 @@ struct pipe {
 	int data;	/* number of bytes present in the pipe  */
 	int prod;	/* FD the producer must write to ; -1 if none */
 	int cons;	/* FD the consumer must read from ; -1 if none */
+	int size;	/* pipe size in bytes, 0 if unknown */
 	struct pipe *next;
 };
 
@@ -44,6 +44,21 @@ void kill_pipe(struct pipe *p);
  */
 void put_pipe(struct pipe *p);
 
+/* doubles the size of pipe <p> within the limit of tune.pipesize.max. Returns
+ * non-zero if the pipe was grown.
+ */
+int pipe_grow(struct pipe *p);
+
+/* Returns the amount of data above which pipe <p> should be considered full.
+ * A pipe holds one page per slot, and each slot may only hold one TCP segment
+ * when splicing from a socket, so this is the number of slots multiplied by a
+ * typical segment size. Pipes of unknown size are assumed to have 16 slots.
+ */
+static inline int pipe_full_hint(const struct pipe *p)
+{
+	return (p->size ? p->size / 4096 : 16) * 1448;
+}
+
 #endif /* _HAPROXY_PIPE_H */
 
 /*
@@ -24,6 +24,7 @@
 
 #include <haproxy/api-t.h>
 #include <haproxy/list-t.h>
+#include <haproxy/thread-t.h>
 
 #define MEM_F_SHARED	0x1
 #define MEM_F_EXACT	0x2
@@ -35,6 +36,9 @@
 
 #define POOL_AVG_SAMPLES 1024
 
+/* size of the huge-page slabs objects may be carved from */
+#define POOL_SLAB_SIZE (2UL * 1024 * 1024)
+
 /* possible flags for __pool_alloc() */
 #define POOL_F_NO_POISON    0x00000001  // do not poison the area
 #define POOL_F_MUST_ZERO    0x00000002  // zero the returned area
@@ -50,6 +54,7 @@
 #define POOL_DBG_CALLER     0x00000040  // trace last caller's location
 #define POOL_DBG_TAG        0x00000080  // place a tag at the end of the area
 #define POOL_DBG_POISON     0x00000100  // poison memory area on pool_alloc()
+#define POOL_DBG_PROFILE    0x00000200  // sample allocations per call site
 
 
 /* This is the head of a thread-local cache */
@@ -99,6 +104,35 @@ struct pool_item {
 	struct pool_item *down; // link to other items of the same cluster
 };
 
+/* This is the shared free list of a pool for a thread group. Objects released
+ * by the threads of a group are only reused by the same group, which usually
+ * runs on the same NUMA node, unless another group runs out of objects.
+ */
+struct pool_shared {
+	struct pool_item *free_list; /* list of free shared objects */
+	unsigned int count;          /* number of objects in the free list */
+	unsigned int remote;         /* refills served by another group's list */
+} THREAD_ALIGNED(64);
+
+/* This is the header placed at the beginning of each huge-page slab */
+struct pool_slab {
+	struct pool_slab *next;      /* next slab of the same pool */
+};
+
+/* This describes the huge-page slabs a pool's objects are carved from, when
+ * enabled. The objects are never released to the OS, those released to the
+ * slabs are kept in <free_list> for later reuse.
+ */
+struct pool_slabs {
+	__decl_thread(HA_SPINLOCK_T lock);
+	struct pool_item *free_list; /* objects released to the slabs */
+	struct pool_slab *slabs;     /* list of mapped slabs */
+	char *cur;                   /* first unused byte in the last slab */
+	char *end;                   /* end of the last slab */
+	unsigned int nb_slabs;       /* number of mapped slabs */
+	unsigned int nb_huge;        /* number of slabs backed by explicit huge pages */
+};
+
 /* This describes a complete pool, with its status, usage statistics and the
  * thread-local caches if any. Even if pools are disabled, these descriptors
  * are valid and are used at least to get names and sizes. For small builds
@@ -106,7 +140,6 @@ struct pool_item {
  * alignment could be removed.
  */
 struct pool_head {
-	struct pool_item *free_list; /* list of free shared objects */
 	unsigned int used;	/* how many chunks are currently in use */
 	unsigned int needed_avg;/* floating indicator between used and allocated */
 	unsigned int allocated;	/* how many chunks have been allocated */
@@ -119,7 +152,9 @@ struct pool_head {
 	unsigned int alloc_sz;	/* allocated size (includes hidden fields) */
 	struct list list;	/* list of all known pools */
 	void *base_addr;        /* allocation address, for free() */
+	struct pool_slabs *slabs; /* huge-page slabs, or NULL if malloc() is used */
 	char name[12];		/* name of the pool */
+	struct pool_shared shared[MAX_TGROUPS]; /* per thread group shared free lists */
 	struct pool_cache_head cache[MAX_THREADS] THREAD_ALIGNED(64); /* pool caches */
 } __attribute__((aligned(64)));
 
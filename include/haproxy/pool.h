@@ -96,6 +96,12 @@
 		*(typeof(caller)*)(((char *)__i) + __p->alloc_sz - sizeof(void*)) = __c; \
 	} while (0)
 
+/* When pools profiling is enabled, the index of the profiling bin a sampled
+ * object was accounted in is stored after the area and the optional mark
+ * above, so that its release is accounted in the same bin.
+ */
+# define POOL_EXTRA_PROF (sizeof(void *))
+
 /* poison each newly allocated area with this byte if >= 0 */
 extern int mem_poison_byte;
 
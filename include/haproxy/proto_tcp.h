@@ -30,6 +30,7 @@
 
 extern struct protocol proto_tcp4;
 extern struct protocol proto_tcp6;
+extern unsigned int tcp_sport_exhausted;
 
 int tcp_bind_socket(int fd, int flags, struct sockaddr_storage *local, struct sockaddr_storage *remote);
 int tcp_connect_server(struct connection *conn, int flags);
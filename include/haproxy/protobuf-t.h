@@ -65,6 +65,11 @@ enum protobuf_type {
 };
 
 
+/* gRPC messages are prefixed by a compression flag and their length */
+#define GRPC_MSG_COMPRESS_FLAG_SZ 1 /* 1 byte */
+#define GRPC_MSG_LENGTH_SZ        4 /* 4 bytes */
+#define GRPC_MSG_HEADER_SZ        (GRPC_MSG_COMPRESS_FLAG_SZ + GRPC_MSG_LENGTH_SZ)
+
 struct pbuf_fid {
 	unsigned int *ids;
 	size_t sz;
@@ -32,20 +32,20 @@
 #define PBUF_VARINT_DATA_BITMASK            ~PBUF_VARINT_DONT_STOP_BITMASK
 
 /* .skip and .smp_store prototypes. */
-int protobuf_skip_varint(unsigned char **pos, size_t *len, size_t vlen);
-int protobuf_smp_store_varint(struct sample *smp, int type,
-                              unsigned char *pos, size_t len, size_t vlen);
-int protobuf_skip_64bit(unsigned char **pos, size_t *len, size_t vlen);
-int protobuf_smp_store_64bit(struct sample *smp, int type,
-                             unsigned char *pos, size_t len, size_t vlen);
-int protobuf_skip_vlen(unsigned char **pos, size_t *len, size_t vlen);
-int protobuf_smp_store_vlen(struct sample *smp, int type,
-                            unsigned char *pos, size_t len, size_t vlen);
-int protobuf_skip_32bit(unsigned char **pos, size_t *len, size_t vlen);
-int protobuf_smp_store_32bit(struct sample *smp, int type,
-                             unsigned char *pos, size_t len, size_t vlen);
-
-struct protobuf_parser_def protobuf_parser_defs [] = {
+static inline int protobuf_skip_varint(unsigned char **pos, size_t *len, size_t vlen);
+static inline int protobuf_smp_store_varint(struct sample *smp, int type,
+                                            unsigned char *pos, size_t len, size_t vlen);
+static inline int protobuf_skip_64bit(unsigned char **pos, size_t *len, size_t vlen);
+static inline int protobuf_smp_store_64bit(struct sample *smp, int type,
+                                           unsigned char *pos, size_t len, size_t vlen);
+static inline int protobuf_skip_vlen(unsigned char **pos, size_t *len, size_t vlen);
+static inline int protobuf_smp_store_vlen(struct sample *smp, int type,
+                                          unsigned char *pos, size_t len, size_t vlen);
+static inline int protobuf_skip_32bit(unsigned char **pos, size_t *len, size_t vlen);
+static inline int protobuf_smp_store_32bit(struct sample *smp, int type,
+                                           unsigned char *pos, size_t len, size_t vlen);
+
+static struct protobuf_parser_def protobuf_parser_defs [] = {
 	[PBUF_TYPE_VARINT          ] = {
 		.skip      = protobuf_skip_varint,
 		.smp_store = protobuf_smp_store_varint,
@@ -91,7 +91,7 @@ static inline uint64_t pbuf_le64toh(uint64_t v)
 /*
  * Return a protobuf type enum from <s> string if succedeed, -1 if not.
  */
-int protobuf_type(const char *s)
+static inline int protobuf_type(const char *s)
 {
 	/* varint types. */
 	if (strcmp(s, "int32") == 0)
@@ -207,7 +207,7 @@ protobuf_decode_varint(uint64_t *val, unsigned char **pos, size_t *len)
  * available byte. Decrease <*len> by the number of skipped bytes.
  * Returns 1 if succeeded, 0 if not.
  */
-int
+static inline int
 protobuf_skip_varint(unsigned char **pos, size_t *len, size_t vlen)
 {
 	unsigned int shift;
@@ -276,8 +276,8 @@ protobuf_varint_getlen(unsigned char *pos, size_t len)
  * depending on <type> the expected protocol buffer type of the field.
  * Return 1 if succeeded, 0 if not.
  */
-int protobuf_smp_store_varint(struct sample *smp, int type,
-                              unsigned char *pos, size_t len, size_t vlen)
+static inline int protobuf_smp_store_varint(struct sample *smp, int type,
+                                            unsigned char *pos, size_t len, size_t vlen)
 {
 	switch (type) {
 	case PBUF_T_BINARY:
@@ -331,7 +331,7 @@ int protobuf_smp_store_varint(struct sample *smp, int type,
 /*
  * Move forward <*pos> buffer by 8 bytes. Used to skip a 64bit field.
  */
-int protobuf_skip_64bit(unsigned char **pos, size_t *len, size_t vlen)
+static inline int protobuf_skip_64bit(unsigned char **pos, size_t *len, size_t vlen)
 {
 	if (*len < sizeof(uint64_t))
 	    return 0;
@@ -348,8 +348,8 @@ int protobuf_skip_64bit(unsigned char **pos, size_t *len, size_t vlen)
  * the expected protocol buffer type of the field.
  * Return 1 if succeeded, 0 if not.
  */
-int protobuf_smp_store_64bit(struct sample *smp, int type,
-                             unsigned char *pos, size_t len, size_t vlen)
+static inline int protobuf_smp_store_64bit(struct sample *smp, int type,
+                                           unsigned char *pos, size_t len, size_t vlen)
 {
 	if (len < sizeof(uint64_t))
 	    return 0;
@@ -386,7 +386,7 @@ int protobuf_smp_store_64bit(struct sample *smp, int type,
  * Move forward <*pos> buffer by <vlen> bytes. Use to skip a length-delimited
  * field.
  */
-int protobuf_skip_vlen(unsigned char **pos, size_t *len, size_t vlen)
+static inline int protobuf_skip_vlen(unsigned char **pos, size_t *len, size_t vlen)
 {
 	if (*len < vlen)
 		return 0;
@@ -402,8 +402,8 @@ int protobuf_skip_vlen(unsigned char **pos, size_t *len, size_t vlen)
  * buffer with <len> available bytes.
  * Return 1 if succeeded, 0 if not.
  */
-int protobuf_smp_store_vlen(struct sample *smp, int type,
-                            unsigned char *pos, size_t len, size_t vlen)
+static inline int protobuf_smp_store_vlen(struct sample *smp, int type,
+                                          unsigned char *pos, size_t len, size_t vlen)
 {
 	if (len < vlen)
 		return 0;
@@ -422,7 +422,7 @@ int protobuf_smp_store_vlen(struct sample *smp, int type,
 /*
  * Move forward <*pos> buffer by 4 bytes. Used to skip a 32bit field.
  */
-int protobuf_skip_32bit(unsigned char **pos, size_t *len, size_t vlen)
+static inline int protobuf_skip_32bit(unsigned char **pos, size_t *len, size_t vlen)
 {
 	if (*len < sizeof(uint32_t))
 	    return 0;
@@ -439,8 +439,8 @@ int protobuf_skip_32bit(unsigned char **pos, size_t *len, size_t vlen)
  * the expected protocol buffer type of the field.
  * Return 1 if succeeded, 0 if not.
  */
-int protobuf_smp_store_32bit(struct sample *smp, int type,
-                             unsigned char *pos, size_t len, size_t vlen)
+static inline int protobuf_smp_store_32bit(struct sample *smp, int type,
+                                           unsigned char *pos, size_t len, size_t vlen)
 {
 	if (len < sizeof(uint32_t))
 	    return 0;
@@ -100,7 +100,7 @@ enum PR_SRV_STATE_FILE {
 #define PR_O_TCP_CLI_KA 0x00040000      /* enable TCP keep-alive on client-side streams */
 #define PR_O_TCP_SRV_KA 0x00080000      /* enable TCP keep-alive on server-side streams */
 #define PR_O_USE_ALL_BK 0x00100000      /* load-balance between backup servers */
-/* unused: 0x00020000 */
+#define PR_O_SYSLOG_PASS 0x00200000     /* log-forward: forward unmodified messages when possible */
 #define PR_O_TCP_NOLING 0x00400000      /* disable lingering on client and server connections */
 #define PR_O_ABRT_CLOSE 0x00800000      /* immediately abort request when client closes */
 
@@ -149,7 +149,8 @@ enum PR_SRV_STATE_FILE {
 #define PR_O2_RSTRICT_REQ_HDR_NAMES_DEL  0x00800000 /* remove request header names containing chars outside of [0-9a-zA-Z-] charset */
 #define PR_O2_RSTRICT_REQ_HDR_NAMES_NOOP 0x01000000 /* preserve request header names containing chars outside of [0-9a-zA-Z-] charset */
 #define PR_O2_RSTRICT_REQ_HDR_NAMES_MASK 0x01c00000 /* mask for restrict-http-header-names option */
-/* unused : 0x0000000..0x80000000 */
+#define PR_O2_COALESCE  0x02000000      /* share multiplexed connections between servers of a same template */
+/* unused : 0x04000000..0x80000000 */
 
 /* server health checks */
 #define PR_O2_CHK_NONE  0x00000000      /* no L7 health checks configured (TCP by default) */
@@ -336,6 +337,7 @@ struct proxy {
 		int tarpit;                     /* tarpit timeout, defaults to connect if unspecified */
 		int queue;                      /* queue timeout, defaults to connect if unspecified */
 		int connect;                    /* connect timeout (in ticks) */
+		int connretry;                  /* connect timeout when retries are left (in ticks) */
 		int server;                     /* server I/O timeout (in ticks) */
 		int httpreq;                    /* maximum time for complete HTTP request */
 		int httpka;                     /* maximum time for a new HTTP request when using keep-alive */
@@ -475,6 +477,7 @@ struct proxy {
 struct switching_rule {
 	struct list list;			/* list linked to from the proxy */
 	struct acl_cond *cond;			/* acl condition to meet */
+	struct switching_run *run;		/* index of the run of rules starting here, or NULL */
 	int dynamic;				/* this is a dynamic rule using the logformat expression */
 	union {
 		struct proxy *backend;		/* target backend */
@@ -485,6 +488,26 @@ struct switching_rule {
 	int line;
 };
 
+/* A run of at least MIN_SWITCHING_RUN consecutive switching rules whose
+ * conditions are all a single exact string match ("-m str") on the same
+ * sample expression is indexed by pattern, so that the first matching rule
+ * is found with a single lookup. It is attached to the first rule of the run.
+ */
+struct switching_run {
+	struct eb_root keys;			/* switching_key indexed by pattern */
+	struct sample_expr *expr;		/* sample expression shared by all rules */
+	struct switching_rule *last;		/* last rule of the run */
+	int icase;				/* patterns are lower case and matched with "-i" */
+	unsigned int gen;			/* pat_ref_watch_gen when indexing */
+};
+
+/* one pattern of a switching_run */
+struct switching_key {
+	struct switching_rule *rule;		/* first rule of the run matching this pattern */
+	unsigned int rank;			/* rule's position in the run */
+	struct ebmb_node node;			/* node indexed by the pattern, must be last */
+};
+
 struct server_rule {
 	struct list list;			/* list linked to from the proxy */
 	struct acl_cond *cond;			/* acl condition to meet */
@@ -24,6 +24,7 @@
 
 #include <haproxy/api.h>
 #include <haproxy/applet-t.h>
+#include <haproxy/counters.h>
 #include <haproxy/freq_ctr.h>
 #include <haproxy/list.h>
 #include <haproxy/listener-t.h>
@@ -34,6 +35,9 @@
 extern struct proxy *proxies_list;
 extern struct eb_root used_proxy_id;	/* list of proxy IDs in use */
 extern unsigned int error_snapshot_id;  /* global ID assigned to each error then incremented */
+extern unsigned int soft_stop_date;     /* date (in seconds) of the beginning of the soft-stop, if any */
+extern unsigned int soft_stop_idle_closed; /* front connections closed or sent a GOAWAY because of the soft-stop */
+extern unsigned int soft_stop_kal_closed;  /* HTTP/1 transactions switched to close because of the soft-stop */
 extern struct eb_root proxy_by_name;    /* tree of proxies sorted by name */
 
 extern const struct cfg_opt cfg_opts[];
@@ -56,8 +60,11 @@ const char *proxy_find_best_option(const char *word, const char **extra);
 void proxy_store_name(struct proxy *px);
 struct proxy *proxy_find_by_id(int id, int cap, int table);
 struct proxy *proxy_find_by_name(const char *name, int cap, int table);
+struct proxy *proxy_be_by_name_cached(const char *name);
 struct proxy *proxy_find_best_match(int cap, const char *name, int id, int *diff);
 struct server *findserver(const struct proxy *px, const char *name);
+struct server *findserver_indexed(const struct proxy *px, const char *name);
+void proxy_fill_server_state(struct buffer *out, struct proxy *px, struct server *srv, uint32_t anon_key);
 int proxy_cfg_ensure_no_http(struct proxy *curproxy);
 void init_new_proxy(struct proxy *p);
 void proxy_preset_defaults(struct proxy *defproxy);
@@ -81,6 +88,10 @@ void proxy_capture_error(struct proxy *proxy, int is_back,
 			 const union error_snapshot_ctx *ctx,
 			 void (*show)(struct buffer *, const struct error_snapshot *));
 void proxy_adjust_all_maxconn(void);
+int proxy_index_switching_rules(struct proxy *px);
+int switching_run_match(struct switching_rule *first, struct proxy *px, struct session *sess,
+                        struct stream *s, struct switching_rule **match);
+void switching_run_free(struct switching_run *run);
 struct proxy *cli_find_frontend(struct appctx *appctx, const char *arg);
 struct proxy *cli_find_frontend(struct appctx *appctx, const char *arg);
 
@@ -116,6 +127,7 @@ static inline void proxy_reset_timeouts(struct proxy *proxy)
 	proxy->timeout.tarpit = TICK_ETERNITY;
 	proxy->timeout.queue = TICK_ETERNITY;
 	proxy->timeout.connect = TICK_ETERNITY;
+	proxy->timeout.connretry = TICK_ETERNITY;
 	proxy->timeout.server = TICK_ETERNITY;
 	proxy->timeout.httpreq = TICK_ETERNITY;
 	proxy->timeout.check = TICK_ETERNITY;
@@ -125,9 +137,9 @@ static inline void proxy_reset_timeouts(struct proxy *proxy)
 /* increase the number of cumulated connections received on the designated frontend */
 static inline void proxy_inc_fe_conn_ctr(struct listener *l, struct proxy *fe)
 {
-	_HA_ATOMIC_INC(&fe->fe_counters.cum_conn);
+	COUNTERS_INC(&fe->fe_counters, cum_conn);
 	if (l && l->counters)
-		_HA_ATOMIC_INC(&l->counters->cum_conn);
+		COUNTERS_INC(l->counters, cum_conn);
 	HA_ATOMIC_UPDATE_MAX(&fe->fe_counters.cps_max,
 			     update_freq_ctr(&fe->fe_conn_per_sec, 1));
 }
@@ -136,9 +148,9 @@ static inline void proxy_inc_fe_conn_ctr(struct listener *l, struct proxy *fe)
 static inline void proxy_inc_fe_sess_ctr(struct listener *l, struct proxy *fe)
 {
 
-	_HA_ATOMIC_INC(&fe->fe_counters.cum_sess);
+	COUNTERS_INC(&fe->fe_counters, cum_sess);
 	if (l && l->counters)
-		_HA_ATOMIC_INC(&l->counters->cum_sess);
+		COUNTERS_INC(l->counters, cum_sess);
 	HA_ATOMIC_UPDATE_MAX(&fe->fe_counters.sps_max,
 			     update_freq_ctr(&fe->fe_sess_per_sec, 1));
 }
@@ -146,7 +158,7 @@ static inline void proxy_inc_fe_sess_ctr(struct listener *l, struct proxy *fe)
 /* increase the number of cumulated connections on the designated backend */
 static inline void proxy_inc_be_ctr(struct proxy *be)
 {
-	_HA_ATOMIC_INC(&be->be_counters.cum_conn);
+	COUNTERS_INC(&be->be_counters, cum_conn);
 	HA_ATOMIC_UPDATE_MAX(&be->be_counters.sps_max,
 			     update_freq_ctr(&be->be_sess_per_sec, 1));
 }
@@ -154,9 +166,9 @@ static inline void proxy_inc_be_ctr(struct proxy *be)
 /* increase the number of cumulated requests on the designated frontend */
 static inline void proxy_inc_fe_req_ctr(struct listener *l, struct proxy *fe)
 {
-	_HA_ATOMIC_INC(&fe->fe_counters.p.http.cum_req);
+	COUNTERS_INC(&fe->fe_counters, cum_req);
 	if (l && l->counters)
-		_HA_ATOMIC_INC(&l->counters->p.http.cum_req);
+		COUNTERS_INC(l->counters, cum_req);
 	HA_ATOMIC_UPDATE_MAX(&fe->fe_counters.p.http.rps_max,
 			     update_freq_ctr(&fe->fe_req_per_sec, 1));
 }
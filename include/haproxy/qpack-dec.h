@@ -23,6 +23,7 @@
 
 struct buffer;
 struct http_hdr;
+struct qpack_dht;
 
 /* Internal QPACK processing errors.
  *Nothing to see with the RFC.
@@ -41,11 +42,18 @@ struct qpack_dec {
 	uint64_t ic;
 	/* Known received count */
 	uint64_t krc;
+	/* Maximum dynamic table capacity announced to the encoder */
+	uint64_t max_cap;
+	/* Dynamic table, NULL until the encoder sets a non-null capacity */
+	struct qpack_dht *dht;
 };
 
 int qpack_decode_fs(const unsigned char *buf, uint64_t len, struct buffer *tmp,
-                    struct http_hdr *list, int list_size);
-int qpack_decode_enc(struct buffer *buf, int fin, void *ctx);
+                    struct http_hdr *list, int list_size,
+                    struct qpack_dec *dec, uint64_t *ric);
+int qpack_decode_enc(struct buffer *buf, int fin, void *ctx, struct qpack_dec *dec);
 int qpack_decode_dec(struct buffer *buf, int fin, void *ctx);
+int qpack_dec_encode_ici(struct qpack_dec *dec, struct buffer *out);
+int qpack_dec_encode_sack(struct qpack_dec *dec, struct buffer *out, uint64_t id, uint64_t ric);
 
 #endif /* _HAPROXY_QPACK_DEC_H */
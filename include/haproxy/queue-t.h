@@ -35,16 +35,27 @@ struct pendconn {
 	unsigned int   queue_idx;  /* value of proxy/server queue_idx at time of enqueue */
 	struct stream *strm;
 	struct queue  *queue;      /* the queue the entry is queued into */
+	struct queue_tgrp *tgrp;   /* the queue's thread group part the entry is queued into */
 	struct server *target;     /* the server that was assigned, = srv except if srv==NULL */
 	struct eb32_node node;
 	__decl_thread(HA_SPINLOCK_T del_lock);  /* use before removal, always under queue's lock */
 };
 
+/* The part of a queue used by one thread group. Entries are always queued by
+ * a stream into its own thread group's part so that threads of different
+ * groups do not compete for the same lock while queuing.
+ */
+struct queue_tgrp {
+	struct eb_root head;                    /* queued pendconns */
+	__decl_thread(HA_SPINLOCK_T lock);      /* for manipulations in the tree */
+	THREAD_PAD(64 - sizeof(struct eb_root) - sizeof(HA_SPINLOCK_T));
+};
+
 struct queue {
-	struct eb_root head;                    /* queued pendconnds */
+	struct queue_tgrp tgrp[MAX_TGROUPS];    /* queued pendconns, per thread group */
 	struct proxy  *px;                      /* the proxy we're waiting for, never NULL in queue */
 	struct server *sv;                      /* the server we are waiting for, may be NULL if don't care */
-	__decl_thread(HA_SPINLOCK_T lock);      /* for manipulations in the tree */
+	__decl_thread(HA_SPINLOCK_T lock);      /* serializes the threads dequeuing entries */
 	unsigned int idx;			/* current queuing index */
 	unsigned int length;                    /* number of entries */
 };
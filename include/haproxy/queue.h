@@ -116,7 +116,12 @@ static inline int queue_limit_offset(int offset)
  */
 static inline void queue_init(struct queue *queue, struct proxy *px, struct server *sv)
 {
-	queue->head = EB_ROOT;
+	int grp;
+
+	for (grp = 0; grp < MAX_TGROUPS; grp++) {
+		queue->tgrp[grp].head = EB_ROOT;
+		HA_SPIN_INIT(&queue->tgrp[grp].lock);
+	}
 	queue->length = 0;
 	queue->idx = 0;
 	queue->px = px;
@@ -35,6 +35,7 @@
 
 extern struct quic_cc_algo quic_cc_algo_nr;
 extern struct quic_cc_algo quic_cc_algo_cubic;
+extern struct quic_cc_algo quic_cc_algo_bbr;
 extern struct quic_cc_algo *default_quic_cc_algo;
 
 extern unsigned long long last_ts;
@@ -61,9 +62,15 @@ struct quic_cc_event {
 		struct ack {
 			uint64_t acked;
 			unsigned int time_sent;
+			/* delivery rate sample: <delivered> bytes were
+			 * acknowledged over <interval> ms, 0 if unknown.
+			 */
+			uint64_t delivered;
+			unsigned int interval;
 		} ack;
 		struct loss {
 			unsigned int time_sent;
+			uint64_t lost; /* bytes declared lost */
 		} loss;
 	};
 };
@@ -71,13 +78,14 @@ struct quic_cc_event {
 enum quic_cc_algo_type {
 	QUIC_CC_ALGO_TP_NEWRENO,
 	QUIC_CC_ALGO_TP_CUBIC,
+	QUIC_CC_ALGO_TP_BBR,
 };
 
 struct quic_cc {
 	/* <conn> is there only for debugging purpose. */
 	struct quic_conn *qc;
 	struct quic_cc_algo *algo;
-	uint32_t priv[16];
+	uint32_t priv[24];
 };
 
 struct quic_cc_algo {
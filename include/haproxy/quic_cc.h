@@ -54,11 +54,13 @@ static inline void quic_cc_event_trace(struct buffer *buf, const struct quic_cc_
 	chunk_appendf(buf, " event type=");
 	switch (ev->type) {
 	case QUIC_CC_EVT_ACK:
-		chunk_appendf(buf, "ack acked=%llu time_sent:%u",
-		              (unsigned long long)ev->ack.acked, ev->ack.time_sent);
+		chunk_appendf(buf, "ack acked=%llu time_sent:%u delivered=%llu interval=%u",
+		              (unsigned long long)ev->ack.acked, ev->ack.time_sent,
+		              (unsigned long long)ev->ack.delivered, ev->ack.interval);
 		break;
 	case QUIC_CC_EVT_LOSS:
-		chunk_appendf(buf, "loss now_ms=%u time_sent=%u", now_ms, ev->loss.time_sent);
+		chunk_appendf(buf, "loss now_ms=%u time_sent=%u lost=%llu", now_ms,
+		              ev->loss.time_sent, (unsigned long long)ev->loss.lost);
 		break;
 	case QUIC_CC_EVT_ECN_CE:
 		chunk_appendf(buf, "ecn_ce");
@@ -36,6 +36,7 @@
 #include <haproxy/quic_cc-t.h>
 #include <haproxy/quic_frame-t.h>
 #include <haproxy/quic_loss-t.h>
+#include <haproxy/quic_pacing-t.h>
 #include <haproxy/quic_stats-t.h>
 #include <haproxy/quic_tls-t.h>
 #include <haproxy/quic_tp-t.h>
@@ -89,6 +90,8 @@ typedef unsigned long long ull;
 #define  QUIC_TOKEN_FMT_NEW  0xb7
 /* Salt length used to derive retry token secret */
 #define QUIC_RETRY_TOKEN_SALTLEN       16 /* bytes */
+/* Length of the keyed hash appended to retry tokens to cheaply filter forged ones */
+#define QUIC_RETRY_TOKEN_COOKIELEN      8 /* bytes */
 /* Retry token duration */
 #define QUIC_RETRY_DURATION_MS      10000
 /* Default Retry threshold */
@@ -386,10 +389,12 @@ struct quic_dgram {
 /* The QUIC packet numbers are 62-bits integers */
 #define QUIC_MAX_PACKET_NUM      ((1ULL << 62) - 1)
 
-/* Maximum number of ack-eliciting received packets since the last
- * ACK frame was sent
+/* Default maximum number of ack-eliciting received packets since the last
+ * ACK frame was sent (tune.quic.frontend.ack-threshold)
  */
 #define QUIC_MAX_RX_AEPKTS_SINCE_LAST_ACK       2
+/* Maximum number of released frames each connection keeps for reuse */
+#define QUIC_FRM_CACHE_SIZE                    64
 /* Flag a received packet as being an ack-eliciting packet. */
 #define QUIC_FL_RX_PACKET_ACK_ELICITING (1UL << 0)
 /* Packet is the first one in the containing datagram. */
@@ -475,6 +480,10 @@ struct quic_tx_packet {
 	struct list frms;
 	/* The time this packet was sent (ms). */
 	unsigned int time_sent;
+	/* Delivery rate sampling, the path's state when this packet was sent */
+	uint64_t delivered;
+	unsigned int delivered_time;
+	unsigned int first_sent_time;
 	/* Packet number spakce. */
 	struct quic_pktns *pktns;
 	/* Flags. */
@@ -580,6 +589,8 @@ struct quic_path {
 	uint64_t in_flight;
 	/* Number of in flight ack-eliciting packets. */
 	uint64_t ifae_pkts;
+	/* Pacing of the emissions */
+	struct quic_pacer pacer;
 };
 
 /* QUIC ring buffer */
@@ -716,8 +727,18 @@ struct quic_conn {
 	struct qcc *qcc;
 	struct task *timer_task;
 	unsigned int timer;
+	/* Expiration date of the delayed ACK of the 1-RTT packet number space */
+	unsigned int ack_timer;
+	/* Released frames kept for reuse, at most QUIC_FRM_CACHE_SIZE */
+	struct list frm_cache;
+	unsigned int frm_cache_cnt;
+	struct list el_th_ctx; /* list elem in ha_thread_ctx */
+	struct list back_refs; /* list head for back references from "show quic" */
+	unsigned int qc_epoch; /* delimits "show quic" output, see qc_epoch in quic_conn.c */
 	/* Idle timer task */
 	struct task *idle_timer_task;
+	/* Pacing task, wakes up the senders delayed by the pacing */
+	struct task *pacing_task;
 	unsigned int flags;
 
 	/* When in closing state, number of packet before sending CC */
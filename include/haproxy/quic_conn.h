@@ -43,6 +43,7 @@
 #include <haproxy/quic_enc.h>
 #include <haproxy/quic_frame.h>
 #include <haproxy/quic_loss.h>
+#include <haproxy/quic_pacing.h>
 #include <haproxy/mux_quic.h>
 
 #include <openssl/rand.h>
@@ -519,6 +520,53 @@ static inline void quic_tx_packet_refdec(struct quic_tx_packet *pkt)
 	}
 }
 
+/* Returns a zeroed frame for <qc>, taken from its cache of released frames
+ * when possible so that the pools are not involved in the TX/ACK hot path, or
+ * NULL if none could be allocated.
+ */
+static inline struct quic_frame *qc_frm_alloc(struct quic_conn *qc)
+{
+	struct quic_frame *frm;
+
+	if (qc->frm_cache_cnt) {
+		frm = LIST_NEXT(&qc->frm_cache, struct quic_frame *, list);
+		LIST_DELETE(&frm->list);
+		qc->frm_cache_cnt--;
+	}
+	else {
+		frm = pool_alloc(pool_head_quic_frame);
+		if (!frm)
+			return NULL;
+	}
+
+	memset(frm, 0, sizeof(*frm));
+	return frm;
+}
+
+/* Releases <frm> frame of <qc>, which must not be referenced anymore. It is
+ * kept in the connection's cache for reuse unless the cache is full.
+ */
+static inline void qc_frm_free(struct quic_conn *qc, struct quic_frame *frm)
+{
+	if (qc->frm_cache_cnt < QUIC_FRM_CACHE_SIZE) {
+		LIST_INSERT(&qc->frm_cache, &frm->list);
+		qc->frm_cache_cnt++;
+	}
+	else
+		pool_free(pool_head_quic_frame, frm);
+}
+
+/* Releases all the frames kept in the cache of <qc> */
+static inline void qc_frm_cache_purge(struct quic_conn *qc)
+{
+	struct quic_frame *frm, *frmbak;
+
+	list_for_each_entry_safe(frm, frmbak, &qc->frm_cache, list)
+		pool_free(pool_head_quic_frame, frm);
+	LIST_INIT(&qc->frm_cache);
+	qc->frm_cache_cnt = 0;
+}
+
 static inline void quic_pktns_tx_pkts_release(struct quic_pktns *pktns, struct quic_conn *qc)
 {
 	struct eb64_node *node;
@@ -535,7 +583,7 @@ static inline void quic_pktns_tx_pkts_release(struct quic_pktns *pktns, struct q
 		list_for_each_entry_safe(frm, frmbak, &pkt->frms, list) {
 			LIST_DELETE(&frm->list);
 			quic_tx_packet_refdec(frm->pkt);
-			pool_free(pool_head_quic_frame, frm);
+			qc_frm_free(qc, frm);
 		}
 		eb64_delete(&pkt->pn_node);
 		quic_tx_packet_refdec(pkt);
@@ -579,6 +627,7 @@ static inline void quic_path_init(struct quic_path *path, int ipv4,
 	path->prep_in_flight = 0;
 	path->in_flight = 0;
 	path->ifae_pkts = 0;
+	quic_pacing_init(&path->pacer);
 	quic_cc_init(&path->cc, algo, qc);
 }
 
@@ -54,6 +54,10 @@ struct quic_loss {
 	unsigned int rtt_min;
 	/* Number of NACKed sent PTO. */
 	unsigned int pto_count;
+	/* Delivery rate sampling, see quic_loss_pkt_sent() */
+	uint64_t delivered;           /* bytes acknowledged on the path */
+	unsigned int delivered_time;  /* last time <delivered> was updated (ms) */
+	unsigned int first_sent_time; /* send time of the newest acknowledged packet, or start of the flight (ms) */
 };
 
 #endif /* USE_QUIC */
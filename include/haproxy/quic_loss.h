@@ -38,6 +38,9 @@ static inline void quic_loss_init(struct quic_loss *ql)
 	ql->rtt_var = (QUIC_LOSS_INITIAL_RTT >> 1) << 2;
 	ql->rtt_min = 0;
 	ql->pto_count = 0;
+	ql->delivered = 0;
+	ql->delivered_time = 0;
+	ql->first_sent_time = 0;
 }
 
 /* Return 1 if a persistent congestion is observed for a list of
@@ -77,6 +80,11 @@ void quic_loss_srtt_update(struct quic_loss *ql,
 
 struct quic_pktns *quic_loss_pktns(struct quic_conn *qc);
 
+void quic_loss_pkt_sent(struct quic_loss *ql, struct quic_tx_packet *pkt,
+                        uint64_t in_flight);
+void quic_loss_pkt_acked(struct quic_loss *ql, struct quic_tx_packet *pkt,
+                         struct quic_cc_event *ev);
+
 struct quic_pktns *quic_pto_pktns(struct quic_conn *qc,
                                   int handshake_completed,
                                   unsigned int *pto);
@@ -0,0 +1,49 @@
+/*
+ * include/haproxy/quic_pacing-t.h
+ * This file contains definitions for QUIC packet pacing.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HAPROXY_QUIC_PACING_T_H
+#define _HAPROXY_QUIC_PACING_T_H
+#ifdef USE_QUIC
+#ifndef USE_OPENSSL
+#error "Must define USE_OPENSSL"
+#endif
+
+#include <inttypes.h>
+
+/* The pacing rate is the congestion window spread over the smoothed RTT,
+ * multiplied by this gain (in 1/256) so that the window may still be filled
+ * despite the timer granularity.
+ */
+#define QUIC_PACING_GAIN         320 /* 1.25 */
+
+/* Minimum number of datagrams which may always be emitted in a burst. The
+ * timers have a millisecond resolution, so the burst is the largest of this
+ * value and one millisecond worth of data.
+ */
+#define QUIC_PACING_MIN_BURST     10
+
+/* Per path pacing state: a token bucket refilled at the pacing rate */
+struct quic_pacer {
+	int64_t credit;     /* bytes which may be emitted now, negative if overdrawn */
+	uint64_t rate;      /* last computed pacing rate in bytes/ms, 0 if not paced */
+	unsigned int last;  /* date of the last <credit> refill (ms) */
+};
+
+#endif /* USE_QUIC */
+#endif /* _HAPROXY_QUIC_PACING_T_H */
@@ -0,0 +1,99 @@
+/*
+ * include/haproxy/quic_pacing.h
+ * This file provides interface definition for QUIC packet pacing.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HAPROXY_QUIC_PACING_H
+#define _HAPROXY_QUIC_PACING_H
+#ifdef USE_QUIC
+#ifndef USE_OPENSSL
+#error "Must define USE_OPENSSL"
+#endif
+
+#include <haproxy/api.h>
+#include <haproxy/quic_conn-t.h>
+#include <haproxy/quic_pacing-t.h>
+#include <haproxy/ticks.h>
+#include <haproxy/time.h>
+
+static inline void quic_pacing_init(struct quic_pacer *pacer)
+{
+	pacer->credit = 0;
+	pacer->rate = 0;
+	pacer->last = now_ms;
+}
+
+/* Returns the pacing rate of <path> in bytes/ms, or 0 if there is no RTT
+ * sample yet, in which case the emission is only limited by the congestion
+ * window.
+ */
+static inline uint64_t quic_pacing_rate(const struct quic_path *path)
+{
+	unsigned int srtt;
+
+	if (!path->loss.rtt_min)
+		return 0;
+
+	srtt = QUIC_MAX(path->loss.srtt >> 3, 1U);
+	return path->cwnd * QUIC_PACING_GAIN / 256 / srtt;
+}
+
+/* Refills the pacing credit of <path> for the time elapsed since the last
+ * call. Returns non-zero if a datagram may be emitted now, 0 if the emission
+ * must be delayed until quic_pacing_next().
+ */
+static inline int quic_pacing_may_send(struct quic_path *path)
+{
+	struct quic_pacer *pacer = &path->pacer;
+	unsigned int elapsed = now_ms - pacer->last;
+	int64_t burst;
+
+	pacer->rate = quic_pacing_rate(path);
+	if (!pacer->rate)
+		return 1;
+
+	burst = QUIC_MAX(pacer->rate, (uint64_t)(QUIC_PACING_MIN_BURST * path->mtu));
+	pacer->last = now_ms;
+
+	/* after an idle period the bucket is full, whatever the debt */
+	if (elapsed >= 1000 || pacer->credit + (int64_t)(pacer->rate * elapsed) >= burst)
+		pacer->credit = burst;
+	else
+		pacer->credit += pacer->rate * elapsed;
+
+	return pacer->credit > 0;
+}
+
+/* Accounts for <len> bytes emitted on <path> */
+static inline void quic_pacing_sent(struct quic_path *path, size_t len)
+{
+	if (path->pacer.rate)
+		path->pacer.credit -= len;
+}
+
+/* Returns the date at which the pacing of <path> will allow a new emission.
+ * Must only be called after quic_pacing_may_send() returned 0.
+ */
+static inline int quic_pacing_next(const struct quic_path *path)
+{
+	const struct quic_pacer *pacer = &path->pacer;
+
+	return tick_add(now_ms, 1 + (-pacer->credit) / pacer->rate);
+}
+
+#endif /* USE_QUIC */
+#endif /* _HAPROXY_QUIC_PACING_H */
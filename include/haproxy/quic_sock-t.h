@@ -2,6 +2,11 @@
 #define _HAPROXY_QUIC_SOCK_T_H
 #ifdef USE_QUIC
 
+/* Maximum number of datagrams received or sent at once by a single
+ * recvmmsg()/sendmmsg() syscall on QUIC sockets.
+ */
+#define QUIC_MAX_MMSG_DGRAMS 16
+
 /* QUIC connection accept queue. One per thread. */
 struct quic_accept_queue {
 	struct mt_list listeners; /* QUIC listeners with at least one connection ready to be accepted on this queue */
@@ -24,6 +24,11 @@ enum {
 	QUIC_ST_HALF_OPEN_CONN,
 	QUIC_ST_HDSHK_FAIL,
 	QUIC_ST_STATELESS_RESET_SENT,
+	QUIC_ST_RX_SYSCALLS,
+	QUIC_ST_RX_DGRAMS,
+	QUIC_ST_TX_SYSCALLS,
+	QUIC_ST_TX_DGRAMS,
+	QUIC_ST_TX_PACING_DELAYED,
 	/* Special events of interest */
 	QUIC_ST_CONN_MIGRATION_DONE,
 	/* Transport errors */
@@ -70,6 +75,11 @@ struct quic_counters {
 	long long half_open_conn;    /* total number of half open connections */
 	long long hdshk_fail;        /* total number of handshake failures */
 	long long stateless_reset_sent; /* total number of handshake failures */
+	long long rx_syscalls;       /* total number of syscalls used to receive datagrams */
+	long long rx_dgrams;         /* total number of datagrams received */
+	long long tx_syscalls;       /* total number of syscalls used to send datagrams */
+	long long tx_dgrams;         /* total number of datagrams sent */
+	long long tx_pacing_delayed; /* total number of emissions delayed by the pacing */
 	/* Special events of interest */
 	long long conn_migration_done; /* total number of connection migration handled */
 	/* Transport errors */
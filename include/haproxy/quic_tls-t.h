@@ -43,6 +43,8 @@
 #define QUIC_TLS_SECRET_LEN 64 /* bytes */
 /* The ciphersuites for AEAD QUIC-TLS have 16-bytes authentication tags */
 #define QUIC_TLS_TAG_LEN    16 /* bytes */
+#define QUIC_TLS_HP_SAMPLE_LEN 16 /* bytes */
+#define QUIC_TLS_HP_MASK_LEN    5 /* bytes */
 
 /* The TLS extensions for QUIC transport parameters */
 #define TLS_EXTENSION_QUIC_TRANSPORT_PARAMETERS       0x0039
@@ -108,6 +108,8 @@ int quic_tls_aes_decrypt(unsigned char *out,
 int quic_tls_aes_encrypt(unsigned char *out,
                          const unsigned char *in, size_t inlen,
                          EVP_CIPHER_CTX *ctx);
+int quic_tls_hp_mask(unsigned char *mask, const unsigned char *sample,
+                     EVP_CIPHER_CTX *ctx);
 
 static inline const EVP_CIPHER *tls_aead(const SSL_CIPHER *cipher)
 {
@@ -150,9 +152,9 @@ static inline const EVP_CIPHER *tls_hp(const SSL_CIPHER *cipher)
 		return EVP_chacha20();
 	case TLS1_3_CK_AES_128_CCM_SHA256:
 	case TLS1_3_CK_AES_128_GCM_SHA256:
-		return EVP_aes_128_ctr();
+		return EVP_aes_128_ecb();
 	case TLS1_3_CK_AES_256_GCM_SHA384:
-		return EVP_aes_256_ctr();
+		return EVP_aes_256_ecb();
 	default:
 		return NULL;
 	}
@@ -475,7 +477,7 @@ static inline int quic_initial_tls_ctx_init(struct quic_tls_ctx *ctx)
 {
 	ctx->rx.aead = ctx->tx.aead = EVP_aes_128_gcm();
 	ctx->rx.md   = ctx->tx.md   = EVP_sha256();
-	ctx->rx.hp   = ctx->tx.hp   = EVP_aes_128_ctr();
+	ctx->rx.hp   = ctx->tx.hp   = EVP_aes_128_ecb();
 
 	return quic_tls_ctx_keys_alloc(ctx);
 }
@@ -39,6 +39,10 @@
 #define RX_O_FOREIGN            0x00000001  /* receives on foreign addresses */
 #define RX_O_V4V6               0x00000002  /* binds to both IPv4 and IPv6 addresses if !V6ONLY */
 #define RX_O_V6ONLY             0x00000004  /* binds to IPv6 addresses only */
+#define RX_O_INCOMING_CPU       0x00000008  /* advertise the shard's CPU with SO_INCOMING_CPU */
+
+/* special value for rx_settings->shards: one shard per thread group */
+#define RX_SHARDS_BY_GROUP      (~0U)
 
 /* All the settings that are used to configure a receiver */
 struct rx_settings {
@@ -62,6 +66,7 @@ struct receiver {
 	void (*iocb)(int fd);            /* generic I/O handler (typically accept callback) */
 	unsigned long bind_thread;       /* bitmask of threads allowed on this receiver */
 	uint bind_tgroup;                /* thread group ID: 0=global IDs, non-zero=local IDs */
+	int incoming_cpu;                /* CPU set with SO_INCOMING_CPU if RX_O_INCOMING_CPU, <0 for none */
 	struct rx_settings *settings;    /* points to the settings used by this receiver */
 	struct list proto_list;          /* list in the protocol header */
 #ifdef USE_QUIC
@@ -56,6 +56,7 @@ struct my_regex {
 #elif defined(USE_PCRE2)
 	int(*mfn)(const pcre2_code *, PCRE2_SPTR, PCRE2_SIZE, PCRE2_SIZE, uint32_t, pcre2_match_data *, pcre2_match_context *);
 	pcre2_code *reg;
+	uint32_t nb_caps;		/* number of capture groups in the pattern */
 #else /* no PCRE */
 	regex_t regex;
 #endif
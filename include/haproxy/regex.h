@@ -30,6 +30,30 @@
 
 extern THREAD_LOCAL regmatch_t pmatch[MAX_MATCH];
 
+#ifdef USE_PCRE2
+/* per-thread match data block, large enough for MAX_MATCH pairs */
+extern THREAD_LOCAL pcre2_match_data *regex_match_data;
+
+/* Returns a match data block to match <preg>. It is the thread's preallocated
+ * one unless it is not allocated yet or too small for the pattern's captures,
+ * in which case a new one is allocated. It must always be released using
+ * regex_release_match_data().
+ */
+static inline pcre2_match_data *regex_get_match_data(const struct my_regex *preg)
+{
+	if (likely(regex_match_data && preg->nb_caps < MAX_MATCH))
+		return regex_match_data;
+	return pcre2_match_data_create_from_pattern(preg->reg, NULL);
+}
+
+/* releases the match data block <pm> returned by regex_get_match_data() */
+static inline void regex_release_match_data(pcre2_match_data *pm)
+{
+	if (pm != regex_match_data)
+		pcre2_match_data_free(pm);
+}
+#endif
+
 /* "str" is the string that contain the regex to compile.
  * "regex" is preallocated memory. After the execution of this function, this
  *         struct contain the compiled regex.
@@ -61,10 +85,10 @@ static inline int regex_exec(const struct my_regex *preg, char *subject)
 	pcre2_match_data *pm;
 	int ret;
 
-	pm = pcre2_match_data_create_from_pattern(preg->reg, NULL);
+	pm = regex_get_match_data(preg);
 	ret = preg->mfn(preg->reg, (PCRE2_SPTR)subject, (PCRE2_SIZE)strlen(subject),
 		0, 0, pm, NULL);
-	pcre2_match_data_free(pm);
+	regex_release_match_data(pm);
 	if (ret < 0)
 		return 0;
 	return 1;
@@ -93,10 +117,10 @@ static inline int regex_exec2(const struct my_regex *preg, char *subject, int le
 	pcre2_match_data *pm;
 	int ret;
 
-	pm = pcre2_match_data_create_from_pattern(preg->reg, NULL);
+	pm = regex_get_match_data(preg);
 	ret = preg->mfn(preg->reg, (PCRE2_SPTR)subject, (PCRE2_SIZE)length,
 		0, 0, pm, NULL);
-	pcre2_match_data_free(pm);
+	regex_release_match_data(pm);
 	if (ret < 0)
 		return 0;
 	return 1;
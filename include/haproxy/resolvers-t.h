@@ -136,6 +136,8 @@ struct resolvers {
 	unsigned int accepted_payload_size; /* maximum payload size we accept for responses */
 	int          nb_nameservers;        /* total number of active nameservers in a resolvers section */
 	int          resolve_retries;       /* number of retries before giving up */
+	int          resolve_jitter;        /* max percentage of the interval randomly added between two resolutions */
+	int          resolve_ttl;           /* if set, valid answers are refreshed according to their TTL */
 	struct {                            /* time to: */
 		int resolve;                /*     wait between 2 queries for the same resolution */
 		int retry;                  /*     wait for a response before retrying */
@@ -200,6 +202,7 @@ struct resolv_resolution {
 	unsigned int          last_resolution;     /* time of the last resolution */
 	unsigned int          last_query;          /* time of the last query sent */
 	unsigned int          last_valid;          /* time of the last valid response */
+	int                   refresh;             /* delay before the next resolution, 0 for <timeout.resolve> */
 	int                   query_id;            /* DNS query ID dedicated for this resolution */
 	struct eb32_node      qid;                 /* ebtree query id */
 	int                   prefered_query_type; /* preferred query type */
@@ -52,6 +52,14 @@
  * cannot fit due to insufficient room, the message is lost and the drop
  * counted must be incremented.
  *
+ * Multiple threads may want to write at the same time. Instead of waiting for
+ * the lock, each of them queues a ring_wait_cell describing its message, then
+ * tries to take the lock. The one which gets it becomes the leader: it writes
+ * all the queued messages in their arrival order and wakes the readers only
+ * once for the whole batch, while the other writers just wait for their cell
+ * to be marked as done. This way the lock is taken once per batch instead of
+ * once per message, and the buffer's contents keep the same format.
+ *
  * Like any buffer, this buffer naturally wraps at the end and continues at the
  * beginning. The creation process consists in immediately adding a null
  * readers count byte into the buffer. The write process consists in always
@@ -96,12 +104,25 @@
 #define RING_WF_WAIT_MODE  0x00000001   /* wait for new contents */
 #define RING_WF_SEEK_NEW   0x00000002   /* seek to new contents  */
 
+/* a message waiting to be written into a ring, allocated by the writer */
+struct ring_wait_cell {
+	struct ring_wait_cell *next; // next (older) cell in the queue
+	const struct ist *pfx;       // prefix parts
+	const struct ist *msg;       // message parts
+	size_t npfx;                 // number of prefix parts
+	size_t nmsg;                 // number of message parts
+	size_t maxlen;               // max message length
+	ssize_t sent;                // result, valid once <done> is set
+	uint done;                   // set by the leader once written
+};
+
 struct ring {
 	struct buffer buf;   // storage area
 	size_t ofs;          // absolute offset in history of the buffer's head
 	struct list waiters; // list of waiters, for now, CLI "show event"
 	__decl_thread(HA_RWLOCK_T lock);
 	int readers_count;
+	struct ring_wait_cell *queue; // most recent message waiting to be written
 };
 
 #endif /* _HAPROXY_RING_T_H */
@@ -290,6 +290,30 @@ struct sample_expr {
 	struct sample_fetch *fetch;               /* sample fetch method */
 	struct arg *arg_p;                        /* optional pointer to arguments to fetch function */
 	struct list conv_exprs;                   /* list of conversion expression to apply */
+	uint64_t cache_key;                       /* identical expressions' key, 0 if not cacheable */
+};
+
+/* A slot of the per-stream sample cache, holding the result of the last
+ * expression stored there, identified by its cache key and the options it was
+ * evaluated with. Strings are copied into <area>.
+ */
+struct smp_cache_slot {
+	uint64_t key;                             /* sample_expr's cache_key, 0 if unused */
+	unsigned int epoch;                       /* smp_cache's epoch when stored */
+	unsigned int opt;                         /* SMP_OPT_* used for the evaluation */
+	unsigned int flags;                       /* SMP_F_* of the result */
+	struct sample_data data;                  /* the result itself */
+	char area[SMP_CACHE_DATA_LEN];            /* storage for string results */
+};
+
+/* Per-stream cache of sample expression results, allocated on first use from
+ * pool_head_smp_cache. Slots are only valid for the epoch they were stored in,
+ * which is incremented each time something might change what they were
+ * computed from (new analyser call, execution of an action).
+ */
+struct smp_cache {
+	unsigned int epoch;                       /* current epoch, never 0 */
+	struct smp_cache_slot slot[VAR_ARRAY];    /* global.tune.sample_cache slots */
 };
 
 /* sample fetch keywords list */
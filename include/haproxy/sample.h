@@ -31,12 +31,17 @@
 extern sample_cast_fct sample_casts[SMP_TYPES][SMP_TYPES];
 extern const unsigned int fetch_cap[SMP_SRC_ENTRIES];
 extern const char *smp_to_type[SMP_TYPES];
+extern struct pool_head *pool_head_smp_cache;
 
 struct sample_expr *sample_parse_expr(char **str, int *idx, const char *file, int line, char **err, struct arg_list *al, char **endptr);
 struct sample_conv *find_sample_conv(const char *kw, int len);
 struct sample *sample_process(struct proxy *px, struct session *sess,
                               struct stream *strm, unsigned int opt,
                               struct sample_expr *expr, struct sample *p);
+struct sample *sample_process_cached(struct proxy *px, struct session *sess,
+                                     struct stream *strm, unsigned int opt,
+                                     struct sample_expr *expr, struct sample *p);
+void smp_expr_set_cache_key(struct sample_expr *expr, const struct arg_list *al);
 struct sample *sample_fetch_as_type(struct proxy *px, struct session *sess,
                                    struct stream *strm, unsigned int opt,
                                    struct sample_expr *expr, int smp_type);
@@ -134,6 +134,19 @@ enum srv_initaddr {
 #define SRV_STATE_FILE_MAX_FIELDS_VERSION_1 25
 #define SRV_STATE_LINE_MAXLEN 2000
 
+/* Binary server-state files start with this magic string, whose last character
+ * is the version of the binary layout. It is followed by the version of the
+ * fields and the number of states (both 32-bit), then by the index of the states
+ * sorted by key, and finally by the states themselves. Each index entry is made
+ * of the key (64-bit hash of "<be_name> <srv_name>"), the offset of the state in
+ * the file and its number of fields (both 32-bit). A state is made of its fields
+ * as consecutive zero-terminated strings, in the same order as in the text
+ * format. All integers are in network byte order.
+ */
+#define SRV_STATE_BIN_MAGIC "HASRVST1"
+#define SRV_STATE_BIN_HDR_LEN 16
+#define SRV_STATE_BIN_IDX_LEN 16
+
 /* server flags -- 32 bits */
 #define SRV_F_BACKUP       0x0001        /* this server is a backup server */
 #define SRV_F_MAPPORTS     0x0002        /* this server uses mapped ports */
@@ -180,6 +193,8 @@ enum srv_initaddr {
 #define SRV_SSL_O_NO_TLS_TICKETS 0x0100 /* disable session resumption tickets */
 #define SRV_SSL_O_NO_REUSE       0x200  /* disable session reuse */
 #define SRV_SSL_O_EARLY_DATA     0x400  /* Allow using early data */
+#define SRV_SSL_O_KTLS           0x800  /* try to offload record encryption to the kernel */
+#define SRV_SSL_O_SHARE_SESS     0x1000 /* share the last session between threads */
 
 /* log servers ring's protocols options */
 enum srv_log_proto {
@@ -212,6 +227,15 @@ struct srv_per_thread {
 	struct eb_root avail_conns;             /* Connections in use, but with still new streams available */
 };
 
+/* Group of servers which share their multiplexed connections to a same
+ * origin ("option http-coalesce"). Its address replaces the server's in these
+ * connections' hash, which always includes the destination address.
+ */
+struct srv_coalesce {
+	struct eb_root *avail_conns;            /* per-thread connections in use, but with still new streams available */
+	unsigned int refcount;                  /* number of servers in the group */
+};
+
 /* Each server will have one occurrence of this structure per thread group */
 struct srv_per_tgroup {
 	unsigned int next_takeover;             /* thread ID to try to steal connections from next time */
@@ -245,12 +269,15 @@ struct server {
 	unsigned maxconn, minconn;		/* max # of active sessions (0 = unlimited), min# for dynamic limit. */
 	struct srv_per_thread *per_thr;         /* array of per-thread stuff such as connections lists */
 	struct srv_per_tgroup *per_tgrp;        /* array of per-tgroup stuff such as idle conns */
+	struct srv_coalesce *coalesce;          /* group sharing available conns with this server, or NULL */
 	unsigned int *curr_idle_thr;            /* Current number of orphan idling connections per thread */
 
 	unsigned int pool_purge_delay;          /* Delay before starting to purge the idle conns pool */
 	unsigned int low_idle_conns;            /* min idle connection count to start picking from other threads */
 	unsigned int max_idle_conns;            /* Max number of connection allowed in the orphan connections list */
+	unsigned int pool_min_conn;             /* Number of idle connections to keep established per thread group */
 	int max_reuse;                          /* Max number of requests on a same connection */
+	int max_pipeline;                       /* Max number of outstanding HTTP/1 requests on a same connection, <= 1 to disable */
 	struct task *warmup;                    /* the task dedicated to the warmup when slowstart is set */
 
 	struct server *track;                   /* the server we're currently tracking, if any */
@@ -258,6 +285,8 @@ struct server {
 	struct server *tracknext;               /* next server tracking <track> in <track>'s trackers list */
 	char *trackit;				/* temporary variable to make assignment deferrable */
 	int consecutive_errors_limit;		/* number of consecutive errors that triggers an event */
+	unsigned int error_rate;		/* observed error ratio (percent) that triggers an event, 0=disabled */
+	unsigned int passive_inter;		/* max delay between active checks while traffic is healthy (ms), 0=disabled */
 	short observe, onerror;			/* observing mode: one of HANA_OBS_*; what to do on error: on of ANA_ONERR_* */
 	short onmarkeddown;			/* what to do when marked down: one of HANA_ONMARKEDDOWN_* */
 	short onmarkedup;			/* what to do when marked up: one of HANA_ONMARKEDUP_* */
@@ -298,6 +327,9 @@ struct server {
 	__decl_thread(HA_SPINLOCK_T lock);      /* may enclose the proxy's lock, must not be taken under */
 	unsigned npos, lpos;			/* next and last positions in the LB tree, protected by LB lock */
 	struct eb32_node lb_node;               /* node used for tree-based load balancing */
+	struct mt_list lb_pending;              /* element in the LB list of servers to reposition (leastconn lazy) */
+	unsigned int lb_ewma;                   /* sliding sum of the peak response times in ms (balance ewma) */
+	unsigned int lb_ewma_date;              /* date of the last lb_ewma sample, in ms */
 	struct server *next_full;               /* next server in the temporary full list */
 
 	/* usually atomically updated by any thread during parsing or on end of request */
@@ -305,6 +337,10 @@ struct server {
 	int cur_sess;				/* number of currently active sessions (including syn_sent) */
 	int served;				/* # of active sessions currently being served (ie not pending) */
 	int consecutive_errors;			/* current number of consecutive errors */
+	unsigned int last_obs_ok;		/* tick of the last successful observed response */
+	unsigned int next_active_chk;		/* tick before which active checks may be skipped */
+	struct freq_ctr obs_ok;			/* successful observed responses over the check interval */
+	struct freq_ctr obs_err;		/* failed observed responses over the check interval */
 	struct freq_ctr sess_per_sec;		/* sessions per second on this server */
 	struct be_counters counters;		/* statistics counters */
 
@@ -350,7 +386,9 @@ struct server {
 			int size;
 			int allocated_size;
 			char *sni; /* SNI used for the session */
+			__decl_thread(HA_RWLOCK_T sess_lock); /* only needed when other threads may pick it */
 		} * reused_sess;
+		unsigned int last_sess_tid;     /* tid+1 of the last thread which stored a session, 0 if none */
 
 		struct ckch_inst *inst; /* Instance of the ckch_store in which the certificate was loaded (might be null if server has no certificate) */
 		__decl_thread(HA_RWLOCK_T lock); /* lock the cache and SSL_CTX during commit operations */
@@ -420,6 +458,16 @@ struct server_state_line {
 	struct eb64_node node;
 };
 
+/* Binary server-state file mapped in memory. States are directly looked up
+ * from the index, without parsing the whole file.
+ */
+struct server_state_bin {
+	char *area;               /* mapped file, NULL if none */
+	size_t size;              /* size of the file */
+	int vsn;                  /* version of the fields */
+	unsigned int count;       /* number of states in the index */
+};
+
 
 /* Descriptor for a "server" keyword. The ->parse() function returns 0 in case of
  * success, or a combination of ERR_* flags if an error is encountered. The
@@ -455,6 +503,35 @@ struct srv_kw_list {
 #define SRV_PARSE_DYNAMIC         0x10    /* dynamic server created at runtime with cli */
 #define SRV_PARSE_INITIAL_RESOLVE 0x20    /* resolve immediately the fqdn to an ip address */
 
+/* data provided to EVENT_HDL_SUB_SERVER handlers through event_hdl facility */
+struct event_hdl_cb_data_server {
+	/* safe data can be safely used from both
+	 * sync and async handlers
+	 * data consistency is guaranteed
+	 */
+	struct {
+		char name[64];          /* server name/id */
+		char proxy_name[64];    /* id of proxy the server belongs to */
+		int puid;               /* proxy-unique server ID */
+		uint32_t proxy_uuid;    /* uuid of the proxy the server belongs to */
+		enum srv_state state;   /* SRV_ST_* */
+		enum srv_admin admin;   /* SRV_ADMF_* */
+		unsigned int eweight;   /* effective weight */
+		unsigned int uweight;   /* user-specified weight */
+		unsigned int maxconn;   /* max # of active sessions (0 = unlimited) */
+		unsigned int queue;     /* current queue length */
+	} safe;
+	/* unsafe data may only be used from sync handlers:
+	 * in async mode, data consistency cannot be guaranteed
+	 * and unsafe data may already be stale, thus using
+	 * it is highly discouraged because it
+	 * could lead to undefined behavior (UAF, null dereference...)
+	 */
+	struct {
+		struct server *ptr;     /* server live ptr */
+	} unsafe;
+};
+
 #endif /* _HAPROXY_SERVER_T_H */
 
 /*
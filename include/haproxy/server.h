@@ -26,6 +26,8 @@
 
 #include <haproxy/api.h>
 #include <haproxy/applet-t.h>
+#include <haproxy/counters.h>
+#include <haproxy/event_hdl-t.h>
 #include <haproxy/freq_ctr.h>
 #include <haproxy/proxy-t.h>
 #include <haproxy/resolvers-t.h>
@@ -63,6 +65,7 @@ struct server *new_server(struct proxy *proxy);
 void srv_take(struct server *srv);
 struct server *srv_drop(struct server *srv);
 int srv_init_per_thr(struct server *srv);
+int srv_init_coalesce(struct server *srv);
 void srv_set_ssl(struct server *s, int use_ssl);
 
 /* functions related to server name resolution */
@@ -76,6 +79,8 @@ int srvrq_resolution_error_cb(struct resolv_requester *requester, int error_code
 int snr_resolution_error_cb(struct resolv_requester *requester, int error_code);
 struct server *snr_check_ip_callback(struct server *srv, void *ip, unsigned char *ip_family);
 struct task *srv_cleanup_idle_conns(struct task *task, void *ctx, unsigned int state);
+struct task *srv_prewarm_idle_conns(struct task *task, void *ctx, unsigned int state);
+int srv_check_pool_min_conn(struct server *srv);
 void srv_release_conn(struct server *srv, struct connection *conn);
 struct connection *srv_lookup_conn(struct eb_root *tree, uint64_t hash);
 struct connection *srv_lookup_conn_next(struct connection *conn);
@@ -168,12 +173,13 @@ void srv_clr_admin_flag(struct server *s, enum srv_admin mode);
 void srv_set_dyncookie(struct server *s);
 
 int srv_check_reuse_ws(struct server *srv);
+void srv_event_hdl_publish(struct event_hdl_sub_type event, struct server *srv);
 const struct mux_ops *srv_get_ws_proto(struct server *srv);
 
 /* increase the number of cumulated connections on the designated server */
 static inline void srv_inc_sess_ctr(struct server *s)
 {
-	_HA_ATOMIC_INC(&s->counters.cum_sess);
+	COUNTERS_INC(&s->counters, cum_sess);
 	HA_ATOMIC_UPDATE_MAX(&s->counters.sps_max,
 			     update_freq_ctr(&s->sess_per_sec, 1));
 }
@@ -262,6 +268,17 @@ static inline enum srv_initaddr srv_get_next_initaddr(unsigned int *list)
 	return ret;
 }
 
+/* Returns the tree of the current thread where connections to server <srv>
+ * which still have streams available are stored. It is shared by all servers
+ * of a same group with "option http-coalesce".
+ */
+static inline struct eb_root *srv_avail_conns(struct server *srv)
+{
+	if (srv->coalesce)
+		return &srv->coalesce->avail_conns[tid];
+	return &srv->per_thr[tid].avail_conns;
+}
+
 static inline void srv_use_conn(struct server *srv, struct connection *conn)
 {
 	unsigned int curr, prev;
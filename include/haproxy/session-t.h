@@ -29,6 +29,7 @@
 #include <arpa/inet.h>
 
 #include <haproxy/api-t.h>
+#include <haproxy/connection-t.h>
 #include <haproxy/obj_type-t.h>
 #include <haproxy/stick_table-t.h>
 #include <haproxy/task-t.h>
@@ -39,6 +40,7 @@
 enum {
 	SESS_FL_NONE          = 0x00000000, /* nothing */
 	SESS_FL_PREFER_LAST   = 0x00000001, /* NTML authent, we should reuse last conn */
+	SESS_FL_CONN_SLAB     = 0x00000002, /* allocated together with its frontend connection */
 };
 
 /* max number of idle server connections kept attached to a session */
@@ -68,6 +70,16 @@ struct sess_srv_list {
 	struct list srv_list;           /* Next element of the server list */
 };
 
+/* A frontend connection and its session allocated at once when
+ * "tune.session.combined-alloc" is set. Both are always released together but
+ * in no particular order, so the slab is only freed once both were released.
+ */
+struct sess_conn_slab {
+	struct connection conn;         /* the frontend connection (CO_FL_SESS_SLAB) */
+	struct session sess;            /* its session, once created (SESS_FL_CONN_SLAB) */
+	unsigned int users;             /* number of parts not released yet, atomic */
+};
+
 #endif /* _HAPROXY_SESSION_T_H */
 
 /*
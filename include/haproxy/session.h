@@ -33,6 +33,7 @@
 
 extern struct pool_head *pool_head_session;
 extern struct pool_head *pool_head_sess_srv_list;
+extern struct pool_head *pool_head_sess_conn_slab;
 
 struct session *session_new(struct proxy *fe, struct listener *li, enum obj_type *origin);
 void session_free(struct session *sess);
@@ -40,6 +41,15 @@ int session_accept_fd(struct connection *cli_conn);
 int conn_complete_session(struct connection *conn);
 struct task *session_expire_embryonic(struct task *t, void *context, unsigned int state);
 
+/* Releases one of the two parts of <slab>, and frees it once both were
+ * released.
+ */
+static inline void sess_conn_slab_release(struct sess_conn_slab *slab)
+{
+	if (!HA_ATOMIC_SUB_FETCH(&slab->users, 1))
+		pool_free(pool_head_sess_conn_slab, slab);
+}
+
 /* Remove the refcount from the session to the tracked counters, and clear the
  * pointer to ensure this is only performed once. The caller is responsible for
  * ensuring that the pointer is valid first.
@@ -19,9 +19,10 @@
 #include <haproxy/shctx-t.h>
 #include <haproxy/thread.h>
 
+size_t shctx_area_size(int maxblocks, int blocksize, int extra);
 int shctx_init(struct shared_context **orig_shctx,
                int maxblocks, int blocksize, unsigned int maxobjsz,
-               int extra, int shared);
+               int extra, int shared, int fd);
 struct shared_block *shctx_row_reserve_hot(struct shared_context *shctx,
                                            struct shared_block *last, int data_len);
 void shctx_row_inc_hot(struct shared_context *shctx, struct shared_block *first);
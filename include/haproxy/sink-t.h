@@ -36,6 +36,24 @@ enum sink_type {
 	SINK_TYPE_BUFFER,   // events sent to a ring buffer
 };
 
+/* compressed on-disk copy of a ring's contents. Each segment is a standalone
+ * gzip member appended to <file>, and gets one line in <file>.idx made of the
+ * date it was archived, its offset in the file, the uncompressed size and the
+ * number of events it holds.
+ */
+struct sink_archive {
+	char *file;               // archive file name
+	char *idx;                // index file name
+	uint64_t max_size;        // rotate above this size, 0=never
+	uint64_t size;            // current archive size
+	uint64_t lost;            // number of gaps due to events overwritten before being archived
+	size_t ofs;               // absolute ring offset of the next event, ~0 initially
+	int fd, idx_fd;           // archive and index FDs, -1 if closed
+	char *raw;                // uncompressed segment (RING_ARCHIVE_SEG_SIZE)
+	char *out;                // compressed segment
+	struct task *task;        // periodic archiving task
+};
+
 struct sink_forward_target {
 	struct server *srv;    // used server
 	struct appctx *appctx; // appctx of current session
@@ -58,6 +76,7 @@ struct sink {
 	struct sink_forward_target *sft; // sink forward targets
 	struct task *forward_task; // task to handle forward targets conns
 	struct sig_handler *forward_sighandler; /* signal handler */
+	struct sink_archive *archive; // compressed archive, or NULL
 	struct {
 		struct ring *ring;    // used by ring buffer and STRM sender
 		unsigned int dropped; // dropped events since last one.
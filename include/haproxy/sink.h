@@ -32,6 +32,7 @@ extern struct proxy *sink_proxies_list;
 
 struct sink *sink_find(const char *name);
 struct sink *sink_new_fd(const char *name, const char *desc, enum log_fmt, int fd);
+struct sink *sink_new_buf(const char *name, const char *desc, enum log_fmt fmt, size_t size);
 ssize_t __sink_write(struct sink *sink, const struct ist msg[], size_t nmsg,
                      int level, int facility, struct ist * metadata);
 int sink_announce_dropped(struct sink *sink, int facility);
@@ -26,6 +26,30 @@
 #include <sys/types.h>
 
 #include <haproxy/api-t.h>
+#include <haproxy/list-t.h>
+
+/* sock_zc flags */
+#define SOCK_ZC_F_COPIED    0x00000001  /* the kernel reported copying instead of zero-copy */
+#define SOCK_ZC_F_DISABLED  0x00000002  /* SO_ZEROCOPY could not be enabled on the socket */
+
+/* A buffer area passed to a MSG_ZEROCOPY send, which must not be reused
+ * before the kernel reports the completion of send call <id>.
+ */
+struct sock_zc_area {
+	struct list list;        /* attach point in sock_zc->areas or the orphans list */
+	void *area;              /* buffer area, allocated from pool_head_buffer */
+	uint32_t id;             /* kernel's sequence number of the send call */
+	uint32_t exp;            /* expiration date once orphaned (ticks) */
+};
+
+/* MSG_ZEROCOPY context of a connection, allocated upon first use */
+struct sock_zc {
+	struct list areas;       /* sock_zc_area not yet completed, oldest first */
+	struct sock_zc_area *prep; /* spare area reserved by sock_zc_prepare() */
+	uint32_t next_id;        /* sequence number of the next zero-copy send */
+	uint32_t prep_id;        /* value of next_id in sock_zc_prepare() */
+	uint32_t flags;          /* SOCK_ZC_F_* */
+};
 
 #endif /* _HAPROXY_SOCK_T_H */
 
@@ -48,6 +48,10 @@ void sock_conn_iocb(int fd);
 int sock_conn_check(struct connection *conn);
 int sock_drain(struct connection *conn);
 int sock_check_events(struct connection *conn, int event_type);
+int sock_zc_prepare(struct connection *conn);
+void sock_zc_commit(struct connection *conn, struct buffer *buf, size_t sent);
+void sock_zc_drain(struct connection *conn);
+void sock_zc_release(struct connection *conn);
 void sock_ignore_events(struct connection *conn, int event_type);
 
 
@@ -290,6 +290,7 @@ struct spoe_agent {
 	unsigned int          eps_max;        /* Maximum # of errors per second */
 	unsigned int          max_frame_size; /* Maximum frame size for this agent, before any negotiation */
 	unsigned int          max_fpa;        /* Maximum # of frames handled per applet at once */
+	unsigned int          max_applets;    /* Maximum # of applets for all threads (0=unlimited) */
 
 	struct list events[SPOE_EV_EVENTS];   /* List of SPOE messages that will be sent
 					       * for each supported events */
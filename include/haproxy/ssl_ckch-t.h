@@ -69,6 +69,7 @@ struct ckch_store {
 	struct ckch_data *data;
 	struct list ckch_inst; /* list of ckch_inst which uses this ckch_node */
 	struct list crtlist_entry; /* list of entries which use this store */
+	unsigned int lazy:1;       /* files loaded by the first instance, released with the last one */
 	struct ebmb_node node;
 	char path[VAR_ARRAY];
 };
@@ -108,6 +109,8 @@ struct ckch_inst {
 	SSL_CTX *ctx; /* pointer to the SSL context used by this instance */
 	unsigned int is_default:1;      /* This instance is used as the default ctx for this bind_conf */
 	unsigned int is_server_instance:1; /* This instance is used by a backend server */
+	unsigned int lazy_failed:1;     /* placeholder of a lazy crt-list entry which failed to load */
+	unsigned int lazy_loaded:1;     /* built on demand, may be evicted by the LRU */
 	/* space for more flag there */
 	struct list sni_ctx; /* list of sni_ctx using this ckch_inst */
 	struct list by_ckchs; /* chained in ckch_store's list of ckch_inst */
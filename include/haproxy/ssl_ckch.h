@@ -38,6 +38,8 @@ int ssl_sock_load_issuer_file_into_ckch(const char *path, char *buf, struct ckch
 
 /* ckch_store functions */
 struct ckch_store *ckchs_load_cert_file(char *path, char **err);
+struct ckch_store *ckchs_new_lazy(char *path, char **err);
+int ckch_store_load_lazy(struct ckch_store *store, char **err);
 struct ckch_store *ckchs_lookup(char *path);
 struct ckch_store *ckchs_dup(const struct ckch_store *src);
 struct ckch_store *ckch_store_new(const char *filename);
@@ -49,6 +51,9 @@ void ckch_inst_free(struct ckch_inst *inst);
 struct ckch_inst *ckch_inst_new();
 int ckch_inst_new_load_store(const char *path, struct ckch_store *ckchs, struct bind_conf *bind_conf,
                              struct ssl_bind_conf *ssl_conf, char **sni_filter, int fcount, struct ckch_inst **ckchi, char **err);
+int ckch_inst_new_load_store_ctx(const char *path, struct ckch_store *ckchs, struct bind_conf *bind_conf,
+                                 struct ssl_bind_conf *ssl_conf, char **sni_filter, int fcount, SSL_CTX *ctx,
+                                 struct ckch_inst **ckchi, char **err);
 int ckch_inst_new_load_srv_store(const char *path, struct ckch_store *ckchs,
                                  struct ckch_inst **ckchi, char **err);
 int ckch_inst_rebuild(struct ckch_store *ckch_store, struct ckch_inst *ckchi,
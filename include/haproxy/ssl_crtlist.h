@@ -32,6 +32,7 @@ char **crtlist_dup_filters(char **args, int fcount);
 void crtlist_free_filters(char **args);
 void crtlist_entry_free(struct crtlist_entry *entry);
 struct crtlist_entry *crtlist_entry_new();
+int crtlist_entry_is_lazy(const struct crtlist_entry *entry);
 
 /* crt-list functions */
 void crtlist_free(struct crtlist *crtlist);
@@ -0,0 +1,36 @@
+/*
+ * include/haproxy/ssl_offload.h
+ * Offloading of the SSL private key operations to crypto threads.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HAPROXY_SSL_OFFLOAD_H
+#define _HAPROXY_SSL_OFFLOAD_H
+
+#ifdef USE_OPENSSL
+
+#include <haproxy/openssl-compat.h>
+
+#ifdef HAVE_SSL_OFFLOAD
+
+/* maximum number of operations a crypto thread dequeues at once */
+#define SSL_OFFLOAD_BATCH 16
+
+EVP_PKEY *ssl_offload_get_key(EVP_PKEY *pkey);
+
+#endif /* HAVE_SSL_OFFLOAD */
+#endif /* USE_OPENSSL */
+#endif /* _HAPROXY_SSL_OFFLOAD_H */
@@ -65,6 +65,9 @@
 #define SSL_SOCK_ST_TO_CAEDEPTH(s) ((s >> (7+8)) & 15)
 #define SSL_SOCK_ST_TO_CRTERROR(s) ((s >> (4+7+8)) & 127)
 
+/* max number of lazy crt-list entries loaded for a single ClientHello */
+#define SSL_LAZY_BATCH 8
+
 /* ssl_methods flags for ssl options */
 #define MC_SSL_O_ALL            0x0000
 #define MC_SSL_O_NO_SSLV3       0x0001	/* disable SSLv3 */
@@ -168,6 +171,9 @@ struct tls_keys_ref {
 	union tls_sess_key *tlskeys;
 	int tls_ticket_enc_index;
 	int key_size_bits;
+	char *table_name; /* stick-table the keys are shared through, or NULL */
+	struct stktable *table; /* resolved <table_name> */
+	struct task *task; /* task loading and rotating the keys of <table> */
 	__decl_thread(HA_RWLOCK_T lock); /* lock used to protect the ref */
 };
 
@@ -248,6 +254,7 @@ struct ssl_sock_ctx {
 	unsigned long error_code;     /* last error code of the error stack */
 	struct buffer early_buf;      /* buffer to store the early data received */
 	int sent_early_data;          /* Amount of early data we sent so far */
+	unsigned char ktls_rec_type;  /* kTLS: record type of the next control message, 0 if none */
 
 #ifdef USE_QUIC
 	struct quic_conn *qc;
@@ -261,6 +268,7 @@ struct global_ssl {
 	int  skip_self_issued_ca;
 
 	int  async;                 /* whether we use ssl async mode */
+	int offload_threads;        /* number of crypto threads for the private key operations */
 
 	char *listen_default_ciphers;
 	char *connect_default_ciphers;
@@ -278,10 +286,16 @@ struct global_ssl {
 
 	int private_cache; /* Force to use a private session cache even if nbproc > 1 */
 	unsigned int life_time;   /* SSL session lifetime in seconds */
+	unsigned int ticket_keys_rotation; /* TLS ticket keys rotation period in seconds */
+	int ocsp_update;          /* automatically fetch OCSP responses */
+	unsigned int ocsp_update_min_delay; /* min delay between two OCSP updates in seconds */
+	unsigned int ocsp_update_max_delay; /* max delay between two OCSP updates in seconds */
+	char *cache_table; /* name of the stick-table replicating the session cache */
 	unsigned int max_record; /* SSL max record size */
 	unsigned int hard_max_record; /* SSL max record size hard limit */
 	unsigned int default_dh_param; /* SSL maximum DH parameter size */
 	int ctx_cache; /* max number of entries in the ssl_ctx cache. */
+	int lazy_load; /* max number of crt-list contexts built on demand, 0 = disabled */
 	int capture_buffer_size; /* Size of the capture buffer. */
 	int keylog; /* activate keylog  */
 	int extra_files; /* which files not defined in the configuration file are we looking for */
@@ -121,6 +121,11 @@ SSL_CTX *ssl_sock_get_generated_cert(unsigned int key, struct bind_conf *bind_co
 int ssl_sock_set_generated_cert(SSL_CTX *ctx, unsigned int key, struct bind_conf *bind_conf);
 unsigned int ssl_sock_generated_cert_key(const void *data, size_t len);
 void ssl_sock_load_cert_sni(struct ckch_inst *ckch_inst, struct bind_conf *bind_conf);
+#ifdef HAVE_SSL_CLIENT_HELLO_CB
+void ssl_sock_lazy_load(struct bind_conf *bind_conf, const char *name, const char *wildp);
+void ssl_sock_lazy_touch(struct ckch_inst *inst);
+#endif
+void ssl_sock_lazy_forget(struct ckch_inst *inst);
 #ifdef SSL_MODE_ASYNC
 void ssl_async_fd_handler(int fd);
 void ssl_async_fd_free(int fd);
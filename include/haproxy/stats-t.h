@@ -343,6 +343,12 @@ enum info_field {
 	INF_POOL_USED_BYTES,
 	INF_START_TIME_SEC,
 	INF_TAINTED,
+	INF_LOG_BATCHES,
+	INF_LOG_BATCHED_DGRAMS,
+	INF_SRC_PORT_EXHAUSTED,
+	INF_SOFT_STOP_DURATION,
+	INF_SOFT_STOP_IDLE_CLOSED,
+	INF_SOFT_STOP_KAL_CLOSED,
 
 	/* must always be the last one */
 	INF_TOTAL_FIELDS
@@ -456,6 +462,7 @@ enum stat_field {
 	ST_F_NEED_CONN_EST,
 	ST_F_UWEIGHT,
 	ST_F_AGG_SRV_CHECK_STATUS,
+	ST_F_HTX_DEFRAG,
 
 	/* must always be the last one */
 	ST_F_TOTAL_FIELDS
@@ -542,6 +549,8 @@ struct show_stat_ctx {
 	int iid, type, sid;	/* proxy id, type and service id if bounding of stats is enabled */
 	int st_code;		/* the status code returned by an action */
 	enum stat_state state;  /* phase of output production */
+	unsigned short *fields; /* projected fields in output order, NULL for all */
+	int nb_fields;          /* number of fields in <fields> */
 };
 
 extern THREAD_LOCAL void *trash_counters;
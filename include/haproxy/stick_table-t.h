@@ -31,6 +31,19 @@
 
 #define STKTABLE_MAX_DT_ARRAY_SIZE 100
 
+/* maximum number of shards a stick-table's key and expiration
+ * trees may be split into (see "shards" table argument).
+ */
+#define STKTABLE_MAX_SHARDS 256
+
+/* number of rows of a stick-table's count-min sketch (see "sketch" table
+ * argument), i.e. number of counters updated per event.
+ */
+#define STKTABLE_SKETCH_DEPTH 4
+
+/* maximum number of counters per row of a stick-table's count-min sketch */
+#define STKTABLE_SKETCH_MAX_WIDTH (1U << 24)
+
 /* The types of extra data we can store in a stick table */
 enum {
 	STKTABLE_DT_SERVER_ID,    /* the server ID to use with this stream if > 0 */
@@ -58,6 +71,7 @@ enum {
 	STKTABLE_DT_GPT,           /* array of gpt */
 	STKTABLE_DT_GPC,           /* array of gpc */
 	STKTABLE_DT_GPC_RATE,      /* array of gpc_rate */
+	STKTABLE_DT_GCRA,          /* token bucket, stored as a GCRA theoretical arrival time */
 
 
 	STKTABLE_STATIC_DATA_TYPES,/* number of types above */
@@ -81,6 +95,7 @@ enum {
 	ARG_T_NONE = 0,           /* data type takes no argument (default) */
 	ARG_T_INT,                /* signed integer */
 	ARG_T_DELAY,              /* a delay which supports time units */
+	ARG_T_RATE,               /* a count followed by a delay which supports time units */
 };
 
 /* They types of keys that servers can be identified by */
@@ -127,6 +142,7 @@ struct stktable_data_type {
 	int arg_type;     /* type of optional argument, ARG_T_* */
 	uint is_array:1;  /* this is an array of gpc/gpt */
 	uint is_local:1;  /* this is local only and never learned */
+	uint is_counter:1; /* this is a cumulative counter which may be summed across peers */
 };
 
 /* stick table keyword type */
@@ -140,18 +156,70 @@ struct stktable_type {
  * Any additional data related to the stuck session is installed *before*
  * stksess (with negative offsets). This allows us to run variable-sized
  * keys and variable-sized data without making use of intermediate pointers.
+ * The nodes which are only used by the expiration task and the peers are
+ * placed even before the data (see stksess_exp() and stksess_upd()), so that
+ * what is accessed on each lookup (key node, key, counters, expire, ref_cnt)
+ * is contiguous. The update node only exists when the table is synchronized
+ * with peers. The resulting layout is :
+ *
+ *     [ exp | upd? | data... ][ stksess | key ]
+ *                             ^ ts
  */
 struct stksess {
 	unsigned int expire;      /* session expiration date */
 	unsigned int ref_cnt;     /* reference count, can only purge when zero */
 	__decl_thread(HA_RWLOCK_T lock); /* lock related to the table entry */
 	int shard;                /* shard */
-	struct eb32_node exp;     /* ebtree node used to hold the session in expiration tree */
-	struct eb32_node upd;     /* ebtree node used to hold the update sequence tree */
+	unsigned int tbl_shard;   /* index of the table shard holding this entry */
 	struct ebmb_node key;     /* ebtree node used to hold the session in table */
 	/* WARNING! do not put anything after <keys>, it's used by the key */
 };
 
+/* One shard of a stick-table. Keys are spread over the table's shards based
+ * on their hash so that lookups, insertions and expirations on distinct keys
+ * do not contend on the same lock.
+ */
+struct stktable_shard {
+	struct eb_root keys;      /* head of sticky session tree */
+	struct eb_root exps;      /* head of sticky session expiration tree */
+	__decl_thread(HA_RWLOCK_T lock); /* lock protecting <keys> and <exps> */
+	THREAD_PAD(64 - 2 * sizeof(struct eb_root) - sizeof(HA_RWLOCK_T));
+};
+
+/* Count-min sketch estimating the number of events per key over a sliding
+ * period, without storing the keys. It is made of two sets of
+ * STKTABLE_SKETCH_DEPTH rows of <width> counters each, one for the current
+ * period and one for the previous one, which are swapped at the end of each
+ * period. Counters are only updated using atomic operations.
+ */
+struct stktable_sketch {
+	unsigned int *cnt;        /* 2 * STKTABLE_SKETCH_DEPTH * width counters, NULL if disabled */
+	unsigned int width;       /* number of counters per row, a power of two */
+	unsigned int promote;     /* estimate from which a key is stored in the table */
+	unsigned int period;      /* duration of a period, in milliseconds */
+	unsigned int curr;        /* index of the current period's set of rows (0 or 1) */
+	unsigned int date;        /* date (in ticks) the current period started */
+	__decl_thread(HA_SPINLOCK_T lock); /* lock used when swapping periods */
+};
+
+/* Periodic snapshot of a table's entries to a file, reloaded on startup. The
+ * file is written by a task, a few entries at a time, to a temporary file
+ * which is renamed once complete. <pos> is the last entry written, on which a
+ * reference is held while the task yields.
+ */
+struct stktable_snapshot {
+	char *file;               /* snapshot file name, NULL if disabled */
+	char *tmp;                /* temporary file the snapshot is written to */
+	unsigned int period;      /* delay between two snapshots, in milliseconds */
+	struct task *task;        /* task writing the snapshots */
+	FILE *f;                  /* snapshot being written, NULL if none */
+	unsigned int shard;       /* shard being dumped */
+	struct stksess *pos;      /* last entry written, referenced, or NULL */
+	unsigned int count;       /* number of entries written so far */
+	unsigned int update;      /* value of the table's update counter when last started */
+	int done;                 /* at least one snapshot was completed */
+	__decl_thread(HA_SPINLOCK_T lock); /* serializes the task and the final snapshot */
+};
 
 /* stick table */
 struct stktable {
@@ -162,8 +230,8 @@ struct stktable {
 	                           * the same configuration section.
 	                           */
 	struct ebpt_node name;    /* Stick-table are lookup by name here. */
-	struct eb_root keys;      /* head of sticky session tree */
-	struct eb_root exps;      /* head of sticky session expiration tree */
+	struct stktable_shard *shards; /* <nb_shards> shards holding the keys and expiration trees */
+	unsigned int nb_shards;   /* number of shards, at least 1 once initialized */
 	struct eb_root updates;   /* head of sticky updates sequence tree */
 	struct pool_head *pool;   /* pool used to allocate sticky sessions */
 	struct task *exp_task;    /* expiration task */
@@ -186,22 +254,35 @@ struct stktable {
 	unsigned int size;        /* maximum number of sticky sessions in table */
 	unsigned int current;     /* number of sticky sessions currently in table */
 	int nopurge;              /* if non-zero, don't purge sticky sessions when full */
+	int sum_counters;         /* if non-zero, the counters are summed across the peers */
+	int sum_ofs;              /* negative offset of the peers' shares of the summed counters */
+	unsigned int sum_slots;   /* number of peers' shares per summed counter element, 0 if none */
+	unsigned int sum_idx[STKTABLE_DATA_TYPES]; /* index of the first summed element of each counter type */
 	int expire;               /* time to live for sticky sessions (milliseconds) */
 	int data_size;            /* the size of the data that is prepended *before* stksess */
+	int exp_ofs;              /* negative offset of the expiration node */
+	int upd_ofs;              /* negative offset of the update node, or 0 if absent */
+	unsigned int pfx_size;    /* size of the nodes and data placed before stksess */
 	int data_ofs[STKTABLE_DATA_TYPES]; /* negative offsets of present data types, or 0 if absent */
 	unsigned int data_nbelem[STKTABLE_DATA_TYPES]; /* to store nb_elem in case of array types */
 	union {
 		int i;
 		unsigned int u;
 		void *p;
+		struct {
+			unsigned int cnt;    /* number of events allowed over the period */
+			unsigned int period; /* period in milliseconds */
+		} rate;
 	} data_arg[STKTABLE_DATA_TYPES]; /* optional argument of each data type */
+	struct stktable_sketch sketch; /* count-min sketch filtering new keys, if configured */
+	struct stktable_snapshot snap; /* on-disk snapshots, if configured */
 	struct proxy *proxy;      /* The proxy this stick-table is attached to, if any.*/
 	struct proxy *proxies_list; /* The list of proxies which reference this stick-table. */
 	struct {
 		const char *file;     /* The file where the stick-table is declared. */
 		int line;             /* The line in this <file> the stick-table is declared. */
 	} conf;
-	__decl_thread(HA_RWLOCK_T lock); /* lock related to the table */
+	__decl_thread(HA_RWLOCK_T lock); /* lock protecting the updates tree and update counters */
 };
 
 extern struct stktable_data_type stktable_data_types[STKTABLE_DATA_TYPES];
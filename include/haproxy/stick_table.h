@@ -46,12 +46,23 @@ int stksess_kill(struct stktable *t, struct stksess *ts, int decrefcount);
 int stktable_get_key_shard(struct stktable *t, const void *key, size_t len);
 
 int stktable_init(struct stktable *t);
+void stktable_deinit(struct stktable *t);
 int stktable_parse_type(char **args, int *idx, unsigned long *type, size_t *key_size);
 int parse_stick_table(const char *file, int linenum, char **args,
                       struct stktable *t, char *id, char *nid, struct peers *peers);
 struct stksess *stktable_get_entry(struct stktable *table, struct stktable_key *key);
 struct stksess *stktable_set_entry(struct stktable *table, struct stksess *nts);
 void stktable_requeue_exp(struct stktable *t, const struct stksess *ts);
+unsigned int stktable_sketch_update(struct stktable *t, struct stktable_key *key, unsigned int inc);
+unsigned long long stktable_sum_local_share(struct stktable *t, struct stksess *ts,
+                                            int type, unsigned int idx, unsigned long long value);
+unsigned long long stktable_sum_update(struct stktable *t, struct stksess *ts, int type,
+                                       unsigned int idx, int slot, unsigned long long value,
+                                       unsigned long long share);
+unsigned int stktable_gcra_tokens(const struct stktable *t, void *ptr);
+int stktable_gcra_take(const struct stktable *t, void *ptr, unsigned int cost);
+void stktable_gcra_set(const struct stktable *t, void *ptr, unsigned int tokens);
+void stktable_gcra_merge(void *ptr, unsigned long long tat);
 void stktable_touch_with_exp(struct stktable *t, struct stksess *ts, int decrefcount, int expire, int decrefcnt);
 void stktable_touch_remote(struct stktable *t, struct stksess *ts, int decrefcnt);
 void stktable_touch_local(struct stktable *t, struct stksess *ts, int decrefccount);
@@ -139,6 +150,32 @@ static inline int stktable_type_size(int type)
 
 int stktable_alloc_data_type(struct stktable *t, int type, const char *sa, const char *sa2);
 
+/* returns the expiration node of entry <ts> of table <t> */
+static inline struct eb32_node *stksess_exp(const struct stktable *t, struct stksess *ts)
+{
+	return (struct eb32_node *)((void *)ts + t->exp_ofs);
+}
+
+/* returns the entry of table <t> holding expiration node <node> */
+static inline struct stksess *stksess_from_exp(const struct stktable *t, struct eb32_node *node)
+{
+	return (struct stksess *)((void *)node - t->exp_ofs);
+}
+
+/* returns the update node of entry <ts> of table <t>, which only exists when
+ * the table is synchronized with peers (t->upd_ofs != 0).
+ */
+static inline struct eb32_node *stksess_upd(const struct stktable *t, struct stksess *ts)
+{
+	return (struct eb32_node *)((void *)ts + t->upd_ofs);
+}
+
+/* returns the entry of table <t> holding update node <node> */
+static inline struct stksess *stksess_from_upd(const struct stktable *t, struct eb32_node *node)
+{
+	return (struct stksess *)((void *)node - t->upd_ofs);
+}
+
 /* return pointer for data type <type> in sticky session <ts> of table <t>, all
  * of which must exist (otherwise use stktable_data_ptr() if unsure).
  */
@@ -189,6 +226,20 @@ static inline void *stktable_data_ptr_idx(struct stktable *t, struct stksess *ts
 	return __stktable_data_ptr(t, ts, type) + idx*stktable_type_size(stktable_data_types[type].std_type);
 }
 
+/* returns non-zero if data type <type> of table <t> is a counter summed across
+ * the peers, in which case the peers exchange their own share of it.
+ */
+static inline int stktable_is_summed(const struct stktable *t, int type)
+{
+	return t->sum_slots && t->data_ofs[type] && stktable_data_types[type].is_counter;
+}
+
+/* returns the table shard holding entry <ts> of table <t> */
+static inline struct stktable_shard *stksess_shard(const struct stktable *t, const struct stksess *ts)
+{
+	return &t->shards[ts->tbl_shard];
+}
+
 /* kill an entry if it's expired and its ref_cnt is zero */
 static inline int __stksess_kill_if_expired(struct stktable *t, struct stksess *ts)
 {
@@ -202,20 +253,17 @@ static inline void stksess_kill_if_expired(struct stktable *t, struct stksess *t
 {
 
 	if (t->expire != TICK_ETERNITY && tick_is_expired(ts->expire, now_ms)) {
-		HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &t->lock);
+		struct stktable_shard *shard = stksess_shard(t, ts);
+
+		HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
 		if (decrefcnt)
-			ts->ref_cnt--;
+			HA_ATOMIC_DEC(&ts->ref_cnt);
 
 		__stksess_kill_if_expired(t, ts);
-		HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &t->lock);
-	}
-	else {
-		if (decrefcnt) {
-			HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &t->lock);
-			HA_ATOMIC_DEC(&ts->ref_cnt);
-			HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &t->lock);
-		}
+		HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
 	}
+	else if (decrefcnt)
+		HA_ATOMIC_DEC(&ts->ref_cnt);
 }
 
 /* sets the stick counter's entry pointer */
@@ -132,6 +132,7 @@ static forceinline char *strm_show_flags(char *buf, size_t len, const char *deli
 #define PCLI_F_PROMPT   0x10000
 #define PCLI_F_PAYLOAD  0x20000
 #define PCLI_F_RELOAD   0x40000 /* this is the "reload" stream, quits after displaying reload status */
+#define PCLI_F_FANOUT   0x80000 /* the current command is sent to every worker ("@*" prefix) */
 
 
 /* error types reported on the streams for more accurate reporting.
@@ -199,6 +200,14 @@ struct strm_logs {
 	long long bytes_out;            /* number of bytes transferred from the server to the client */
 };
 
+/* stickiness entry pending storage at the end of the response analysis. A
+ * stream holds at most STREAM_MAX_STORE of them, allocated together.
+ */
+struct stream_store {
+	struct stksess *ts;
+	struct stktable *table;
+};
+
 struct stream {
 	enum obj_type obj_type;         /* object type == OBJ_TYPE_STREAM */
 	enum sc_state prev_conn_state;  /* CS_ST*, copy of previous state of the server stream connector */
@@ -235,15 +244,18 @@ struct stream {
 
 	uint64_t lat_time;		/* total latency time experienced */
 	uint64_t cpu_time;              /* total CPU time consumed */
+	uint64_t req_ana_time;          /* CPU time spent in request analysers (profiled tasks only) */
+	uint64_t res_ana_time;          /* CPU time spent in response analysers (profiled tasks only) */
+	uint64_t flt_time;              /* CPU time spent in filters callbacks (profiled tasks only) */
+	uint64_t lua_time;              /* CPU time spent in Lua actions/fetches/converters (profiled tasks only) */
+	uint64_t bufwait_time;          /* total time spent waiting for a buffer */
+	uint32_t bufwait_date;          /* date the stream started to wait for a buffer, or 0 */
 	struct freq_ctr call_rate;      /* stream task call rate without making progress */
 
 	short store_count;
 	/* 2 unused bytes here */
 
-	struct {
-		struct stksess *ts;
-		struct stktable *table;
-	} store[8];                     /* tracked stickiness values to store */
+	struct stream_store *store;     /* tracked stickiness values to store, allocated on first use */
 
 	struct stkctr stkctr[MAX_SESS_STKCTR];  /* content-aware stick counters */
 
@@ -265,12 +277,15 @@ struct stream {
 
 	int pcli_next_pid;                      /* next target PID to use for the CLI proxy */
 	int pcli_flags;                         /* flags for CLI proxy */
+	int pcli_fanout_pos;                    /* rank of the worker the "@*" command is sent to */
+	struct ist pcli_fanout_cmd;             /* copy of the "@*" command to replay to each worker */
 
 	struct ist unique_id;                   /* custom unique ID */
 
 	/* These two pointers are used to resume the execution of the rule lists. */
 	struct list *current_rule_list;         /* this is used to store the current executed rule list. */
 	void *current_rule;                     /* this is used to store the current rule to be resumed. */
+	struct smp_cache *smp_cache;            /* results of cacheable sample expressions, or NULL */
 	int rules_exp;                          /* expiration date for current rules execution */
 	int tunnel_timeout;
 	const char *last_rule_file;             /* last evaluated final rule's file (def: NULL) */
@@ -24,6 +24,7 @@
 
 #include <haproxy/action-t.h>
 #include <haproxy/api.h>
+#include <haproxy/clock.h>
 #include <haproxy/fd.h>
 #include <haproxy/freq_ctr.h>
 #include <haproxy/obj_type.h>
@@ -34,6 +35,7 @@
 #include <haproxy/stick_table.h>
 #include <haproxy/stream-t.h>
 #include <haproxy/task-t.h>
+#include <haproxy/tinfo.h>
 #include <haproxy/trace-t.h>
 
 extern struct trace_source trace_strm;
@@ -105,6 +107,36 @@ static inline enum obj_type *strm_orig(const struct stream *strm)
 	return strm->sess->origin;
 }
 
+/* Invalidates the sample cache of stream <s>. This must be called whenever
+ * something may have changed the elements cached samples were computed from,
+ * such as the messages' headers.
+ */
+static inline void stream_smp_cache_flush(struct stream *s)
+{
+	if (s->smp_cache)
+		s->smp_cache->epoch++;
+}
+
+/* Returns the current date in nanoseconds, never zero, if the current task is
+ * being profiled (i.e. its CPU usage is measured, see "profiling.tasks"),
+ * otherwise zero. It is meant to be passed to stream_timing_stop() to measure
+ * the time spent in a given processing phase of a stream at no cost when
+ * profiling is disabled.
+ */
+static inline uint32_t stream_timing_start(void)
+{
+	if (likely(!th_ctx->sched_wake_date))
+		return 0;
+	return (uint32_t)now_mono_time() | 1;
+}
+
+/* Adds to <acc> the time elapsed since <start> if it is not zero */
+static inline void stream_timing_stop(uint64_t *acc, uint32_t start)
+{
+	if (unlikely(start))
+		*acc += (uint32_t)((uint32_t)now_mono_time() - start);
+}
+
 /* Remove the refcount from the stream to the tracked counters, and clear the
  * pointer to ensure this is only performed once. The caller is responsible for
  * ensuring that the pointer is valid first. We must be extremely careful not
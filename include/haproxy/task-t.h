@@ -152,6 +152,33 @@ struct task {
 	/* 16-bit hole here */
 };
 
+/* A thread's timers may be kept in a hierarchical timer wheel instead of its
+ * timers tree when "tune.sched.timer-wheel" is set. Level 0 has one slot per
+ * millisecond for the next 2^TW_L0_BITS ms, and each next level has 2^TW_LN_BITS
+ * slots, each of which covers a full turn of the previous level, so that the
+ * last one covers the whole 32-bit ticks range. When the clock reaches the
+ * start of an upper level slot, its tasks are redistributed into the lower
+ * levels, thus the date where a task is woken up remains exact. Queuing and
+ * unlinking a task take constant time. A task in the wheel is linked into its
+ * slot using the branches of its <wq> node, whose leaf_p is set to
+ * TASK_IN_WHEEL, and its <wq.key> still holds the date it was queued for.
+ */
+#define TW_L0_BITS     8
+#define TW_LN_BITS     6
+#define TW_LEVELS      5
+#define TW_L0_SLOTS    (1U << TW_L0_BITS)
+#define TW_LN_SLOTS    (1U << TW_LN_BITS)
+#define TW_SLOTS       (TW_L0_SLOTS + (TW_LEVELS - 1) * TW_LN_SLOTS)
+#define TASK_IN_WHEEL  ((eb_troot_t *)1)
+
+struct timer_wheel {
+	struct list slot[TW_SLOTS];        /* level 0 slots, followed by each next level's */
+	uint64_t map[TW_SLOTS / 64];       /* one bit per non-empty slot */
+	unsigned int clock;                /* next date to be processed */
+	unsigned int count;                /* number of tasks in the wheel */
+	int cascaded;                      /* upper levels were redistributed for <clock> */
+};
+
 /* lightweight tasks, without priority, mainly used for I/Os */
 struct tasklet {
 	TASK_COMMON;			/* must be at the beginning! */
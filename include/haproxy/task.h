@@ -127,6 +127,7 @@ int next_timer_expiry(void);
  * Delete every tasks before running the master polling loop
  */
 void mworker_cleantasks(void);
+void sched_update_budget(uint32_t run_time);
 
 /* returns the number of running tasks+tasklets on the whole process. Note
  * that this *is* racy since a task may move from the global to a local
@@ -170,13 +171,44 @@ static inline int task_in_wq(struct task *t)
 	return t->wq.node.leaf_p != NULL;
 }
 
+/* returns the list element linking task <t> into a timer wheel slot, which
+ * overlaps with the branches of its wq node (see struct timer_wheel).
+ */
+static inline struct list *task_wheel_link(struct task *t)
+{
+	return (struct list *)&t->wq.node.branches;
+}
+
+/* returns the task linked into a timer wheel slot by list element <link> */
+static inline struct task *task_from_wheel_link(struct list *link)
+{
+	return container_of((struct eb_root *)link, struct task, wq.node.branches);
+}
+
+/* Unlinks task <t> from timer wheel <tw>, where it must be queued. */
+static inline void __task_wheel_unlink(struct timer_wheel *tw, struct task *t)
+{
+	struct list *link = task_wheel_link(t);
+	unsigned int idx;
+
+	if (link->n == link->p) {
+		/* last task of its slot */
+		idx = link->n - tw->slot;
+		tw->map[idx / 64] &= ~(1ULL << (idx % 64));
+	}
+	LIST_DELETE(link);
+	t->wq.node.leaf_p = NULL;
+	tw->count--;
+}
+
 /* returns true if the current thread has some work to do */
 static inline int thread_has_tasks(void)
 {
 	return ((int)!eb_is_empty(&th_ctx->rqueue) |
 	        (int)!eb_is_empty(&th_ctx->rqueue_shared) |
 	        (int)!!th_ctx->tl_class_mask |
-		(int)!MT_LIST_ISEMPTY(&th_ctx->shared_tasklet_list));
+		(int)!MT_LIST_ISEMPTY(&th_ctx->shared_tasklet_list) |
+		(int)!MT_LIST_ISEMPTY(&th_ctx->steal_list));
 }
 
 /* puts the task <t> in run queue with reason flags <f>, and returns <t> */
@@ -250,7 +282,10 @@ static inline void _task_drop_running(struct task *t, unsigned int f, const stru
  */
 static inline struct task *__task_unlink_wq(struct task *t)
 {
-	eb32_delete(&t->wq);
+	if (t->wq.node.leaf_p == TASK_IN_WHEEL)
+		__task_wheel_unlink(ha_thread_ctx[t->tid].wheel, t);
+	else
+		eb32_delete(&t->wq);
 	return t;
 }
 
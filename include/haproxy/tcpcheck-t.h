@@ -136,6 +136,7 @@ struct tcpcheck_connect {
 struct tcpcheck_http_hdr {
 	struct ist  name;  /* the header name */
 	struct list value; /* the log-format string value */
+	struct ist  cst;   /* the value pre-rendered at boot if constant, otherwise IST_NULL */
 	struct list list;  /* header chained list */
 };
 
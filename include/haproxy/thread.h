@@ -404,9 +404,13 @@ enum lock_label {
 	CKCH_LOCK,
 	SNI_LOCK,
 	SSL_SERVER_LOCK,
+	SSL_LAZY_LOCK,
+	OCSP_LOCK,
 	SFT_LOCK, /* sink forward target */
 	IDLE_CONNS_LOCK,
 	QUIC_LOCK,
+	POOL_SLAB_LOCK,
+	NETNS_LOCK,
 	OTHER_LOCK,
 	/* WT: make sure never to use these ones outside of development,
 	 * we need them for lock profiling!
@@ -44,6 +44,8 @@ enum {
 #define TH_FL_TASK_PROFILING    0x00000002
 #define TH_FL_NOTIFIED          0x00000004  /* task was notified about the need to wake up */
 #define TH_FL_SLEEPING          0x00000008  /* thread won't check its task list before next wakeup */
+#define TH_FL_SLOW_LOOP         0x00000010  /* the watchdog asks the thread to record its slow loop */
+#define TH_FL_OVERLOADED        0x00000020  /* the thread's loop latency or run queue is above the overload limits */
 
 
 /* Thread group information. This defines a base and a count of global thread
@@ -106,6 +108,7 @@ struct thread_ctx {
 	struct eb_root timers;              /* tree constituting the per-thread wait queue */
 	struct eb_root rqueue;              /* tree constituting the per-thread run queue */
 	struct task *current;               /* current task (not tasklet) */
+	const void *current_fct;            /* ->process of <current>, which may be freed while running */
 	int current_queue;                  /* points to current tasklet list being run, -1 if none */
 	unsigned int nb_tasks;              /* number of tasks allocated on this thread */
 	uint8_t tl_class_mask;              /* bit mask of non-empty tasklets classes */
@@ -114,6 +117,8 @@ struct thread_ctx {
 	struct list pool_lru_head;          /* oldest objects in thread-local pool caches */
 	struct list buffer_wq;              /* buffer waiters */
 	struct list streams;                /* list of streams attached to this thread */
+	struct list quic_conns;             /* list of quic-conns attached to this thread */
+	struct timer_wheel *wheel;          /* per-thread timer wheel if enabled, otherwise NULL */
 
 	ALWAYS_ALIGN(2*sizeof(void*));
 	struct list tasklets[TL_CLASSES];   /* tasklets (and/or tasks) to run, by class */
@@ -121,10 +126,13 @@ struct thread_ctx {
 	// third cache line here on 64 bits: accessed mostly using atomic ops
 	ALWAYS_ALIGN(64);
 	struct mt_list shared_tasklet_list; /* Tasklet to be run, woken up by other threads */
+	struct mt_list steal_list;          /* unbound tasks to be run, which other threads may steal */
 	unsigned int rqueue_ticks;          /* Insertion counter for the run queue */
 	unsigned int rq_total;              /* total size of the run queue, prio_tree + tasklets */
 	int tasks_in_list;                  /* Number of tasks in the per-thread tasklets list */
 	uint idle_pct;                      /* idle to total ratio over last sample (percent) */
+	uint rq_budget;                     /* adaptive run queue budget, 0=tune.runqueue-depth */
+	uint poll_events;                   /* number of events reported by the last poll */
 	uint flags;                         /* thread flags, TH_FL_*, atomic! */
 	/* 32-bit hole here */
 
@@ -134,6 +142,7 @@ struct thread_ctx {
 
 	uint64_t prev_cpu_time;             /* previous per thread CPU time */
 	uint64_t prev_mono_time;            /* previous system wide monotonic time  */
+	uint64_t heavy_next;                /* date (ns) before which heavy tasklets wait for other work */
 
 	struct eb_root rqueue_shared;       /* run queue fed by other threads */
 	__decl_thread(HA_SPINLOCK_T rqsh_lock); /* lock protecting the shared runqueue */
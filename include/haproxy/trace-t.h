@@ -143,6 +143,36 @@ struct trace_event {
 	const char *desc;
 };
 
+/* number of message bytes kept in a trace record, sized so that a trace_rec
+ * is 128 bytes long on 64-bit platforms.
+ */
+#define TRACE_REC_MSG_LEN 54
+
+/* One event stored in a thread's flight recorder. Nothing is formatted when
+ * the event is recorded, only the raw values are stored, and they are only
+ * turned into text when dumped. The arguments are never dereferenced since
+ * the objects they designate may have vanished in the mean time.
+ */
+struct trace_rec {
+	ullong date;                    // wall-clock date in microseconds
+	const struct trace_source *src; // source which emitted the event
+	const char *where;              // end of the "file:line" location
+	const char *func;               // calling function's name or NULL
+	uint64_t mask;                  // events this trace is labelled with
+	const void *args[4];            // raw arguments passed to the trace
+	uchar level;                    // trace level, TRACE_LEVEL_*
+	uchar msg_len;                  // number of bytes in <msg>
+	char msg[TRACE_REC_MSG_LEN];    // beginning of the message
+};
+
+/* per-thread flight recorder: a ring of TRACE_FLIGHT_RECORDS records only
+ * written by its thread, allocated on first use.
+ */
+struct trace_flight {
+	struct trace_rec *recs;         // TRACE_FLIGHT_RECORDS records or NULL
+	ullong next;                    // number of events recorded so far
+};
+
 /* Regarding the verbosity, if <decoding> is not NULL, it must point to a NULL-
  * terminated array of name:description, which will define verbosity levels
  * implemented by the decoding callback. The verbosity value will default to
@@ -171,6 +201,7 @@ struct trace_source {
 	enum trace_level level;  // report traces up to this level of info
 	unsigned int verbosity;  // decoder's level of detail among <decoding> (0=no cb)
 	struct sink *sink;       // where to send the trace
+	unsigned int flight;     // non-zero to also record events in the flight recorder
 	/* trace state part below */
 	enum trace_state state;
 	const void *lockon_ptr;  // what to lockon when lockon is set
@@ -121,6 +121,7 @@
 
 extern struct list trace_sources;
 extern THREAD_LOCAL struct buffer trace_buf;
+extern struct trace_flight trace_flights[MAX_THREADS];
 
 void __trace(enum trace_level level, uint64_t mask, struct trace_source *src,
              const struct ist where, const char *func,
@@ -131,6 +132,7 @@ void __trace(enum trace_level level, uint64_t mask, struct trace_source *src,
              const struct ist msg);
 
 void trace_register_source(struct trace_source *source);
+void trace_flight_dump_to_fd(int fd);
 
 /* return a single char to describe a trace state */
 static inline char trace_state_char(enum trace_state st)
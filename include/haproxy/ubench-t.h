@@ -0,0 +1,56 @@
+/*
+ * include/haproxy/ubench-t.h
+ * Type definitions for the internal micro-benchmarks.
+ *
+ * Copyright (C) 2026 HAProxy Technologies
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HAPROXY_UBENCH_T_H
+#define _HAPROXY_UBENCH_T_H
+
+#include <haproxy/api-t.h>
+#include <haproxy/list-t.h>
+
+/* ubench flags */
+#define UBENCH_F_MT     0x00000001  /* run in parallel on all configured threads */
+
+/* A micro-benchmark. <run> performs one round of operations and returns the
+ * number of operations it performed. It is called repeatedly, so it must
+ * leave its state ready for the next round. <init> is optional and called
+ * once before the first round, it must return non-zero on success. <deinit>
+ * is optional and called once after the last round. For UBENCH_F_MT, <run>
+ * is called from all threads at once, each with its own <tid>, and the extra
+ * threads call the optional <thread_deinit> before exiting so that they may
+ * release their thread-local resources (e.g. pool caches).
+ */
+struct ubench {
+	const char *name;           /* short name used to select it */
+	const char *desc;           /* one-line description of an operation */
+	int (*init)(void);
+	uint64_t (*run)(void);
+	void (*deinit)(void);
+	unsigned int flags;         /* UBENCH_F_* */
+	void (*thread_deinit)(void);
+};
+
+/* a list of micro-benchmarks, registered at boot */
+struct ubench_list {
+	struct list list;
+	struct ubench ub[VAR_ARRAY];
+};
+
+#endif /* _HAPROXY_UBENCH_T_H */
@@ -0,0 +1,30 @@
+/*
+ * include/haproxy/ubench.h
+ * Functions to register and run the internal micro-benchmarks.
+ *
+ * Copyright (C) 2026 HAProxy Technologies
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HAPROXY_UBENCH_H
+#define _HAPROXY_UBENCH_H
+
+#include <haproxy/ubench-t.h>
+
+void ubench_register(struct ubench_list *ubl);
+int ubench_run(char *names);
+
+#endif /* _HAPROXY_UBENCH_H */
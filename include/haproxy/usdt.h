@@ -0,0 +1,43 @@
+/*
+ * include/haproxy/usdt.h
+ * Static user-space tracepoints (USDT) for external tracers.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HAPROXY_USDT_H
+#define _HAPROXY_USDT_H
+
+/* HA_USDT(name, args...) places a probe named <name> under the "haproxy"
+ * provider, with up to 12 arguments. When built with USE_USDT, each probe is
+ * a single nop instruction plus a note in the .note.stapsdt section, which
+ * tools like bpftrace, perf or systemtap patch at run time. Otherwise the
+ * probes and their arguments are not even evaluated. The list of probes and
+ * their arguments is documented in the management guide, section 12, and must
+ * be kept stable since external scripts rely on it.
+ */
+#ifdef USE_USDT
+
+#include <sys/sdt.h>
+
+#define HA_USDT(name, ...) STAP_PROBEV(haproxy, name, ##__VA_ARGS__)
+
+#else
+
+#define HA_USDT(name, ...) do { } while (0)
+
+#endif
+
+#endif /* _HAPROXY_USDT_H */
@@ -22,6 +22,8 @@
 #ifndef _HAPROXY_VARS_T_H
 #define _HAPROXY_VARS_T_H
 
+#include <import/eb64tree.h>
+
 #include <haproxy/sample_data-t.h>
 #include <haproxy/thread-t.h>
 
@@ -48,7 +50,7 @@ enum vars_scope {
 };
 
 struct vars {
-	struct list head;
+	struct eb_root name_root; /* variables indexed by their name's hash */
 	enum vars_scope scope;
 	unsigned int size;
 	__decl_thread(HA_RWLOCK_T rwlock);
@@ -61,8 +63,7 @@ struct var_desc {
 };
 
 struct var {
-	struct list l; /* Used for chaining vars. */
-	uint64_t name_hash;      /* XXH3() of the variable's name */
+	struct eb64_node node;   /* key is the XXH3() of the variable's name */
 	uint flags;       // VF_*
 	/* 32-bit hole here */
 	struct sample_data data; /* data storage. */
@@ -93,6 +93,8 @@ static forceinline void ebmb_delete(struct ebmb_node *ebmb)
  * in ebmbtree.c, which simply relies on their inline version.
  */
 struct ebmb_node *ebmb_lookup(struct eb_root *root, const void *x, unsigned int len);
+int ebmb_lookup_multi(struct eb_root *root, const void *const *keys, const unsigned int *lens,
+                      struct ebmb_node **nodes, int nb);
 struct ebmb_node *ebmb_insert(struct eb_root *root, struct ebmb_node *new, unsigned int len);
 struct ebmb_node *ebmb_lookup_longest(struct eb_root *root, const void *x);
 struct ebmb_node *ebmb_lookup_prefix(struct eb_root *root, const void *x, unsigned int pfx);
@@ -324,6 +324,9 @@ struct acl_expr *parse_acl_expr(const char **args, char **err, struct arg_list *
 		cur_type = smp_expr_output_type(smp);
 	}
 
+	/* identical fetches from the same proxy may share their results */
+	smp_expr_set_cache_key(smp, al);
+
 	expr = calloc(1, sizeof(*expr));
 	if (!expr) {
 		memprintf(err, "out of memory when parsing ACL expression");
@@ -1113,7 +1116,7 @@ enum acl_test_res acl_exec_cond(struct acl_cond *cond, struct proxy *px, struct
 				/* we need to reset context and flags */
 				memset(&smp, 0, sizeof(smp));
 			fetch_next:
-				if (!sample_process(px, sess, strm, opt, expr->smp, &smp)) {
+				if (!sample_process_cached(px, sess, strm, opt, expr->smp, &smp)) {
 					/* maybe we could not fetch because of missing data */
 					if (smp.flags & SMP_F_MAY_CHANGE && !(opt & SMP_OPT_FINAL))
 						acl_res |= ACL_TEST_MISS;
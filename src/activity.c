@@ -10,6 +10,10 @@
  *
  */
 
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
 #include <haproxy/activity-t.h>
 #include <haproxy/api.h>
 #include <haproxy/applet.h>
@@ -18,18 +22,31 @@
 #include <haproxy/channel.h>
 #include <haproxy/cli.h>
 #include <haproxy/freq_ctr.h>
+#include <haproxy/hlua-t.h>
 #include <haproxy/listener.h>
+#include <haproxy/sample-t.h>
 #include <haproxy/sc_strm.h>
 #include <haproxy/stconn.h>
+#include <haproxy/task.h>
+#include <haproxy/thread.h>
 #include <haproxy/tools.h>
 
+/* CPU time sampling relies on per-thread CPU time timers */
+#if defined(USE_RT) && defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) && defined(_POSIX_THREAD_CPUTIME)
+#define HA_HAVE_PROF_SAMPLES
+#endif
+
 /* CLI context for the "show profiling" command */
 struct show_prof_ctx {
-	int dump_step;  /* 0,1,2,4,5,6; see cli_iohandler_show_profiling() */
+	int dump_step;  /* 0-5 or 8-13; see cli_iohandler_show_profiling() */
 	int linenum;    /* next line to be dumped (starts at 0) */
 	int maxcnt;     /* max line count per step (0=not set)  */
 	int by_what;    /* 0=sort by usage, 1=sort by address, 2=sort by time */
 	int aggr;       /* 0=dump raw, 1=aggregate on callee    */
+	int hist;       /* 0=dump totals, 1=dump percentiles    */
+	struct prof_sample *samples; /* merged CPU time samples being dumped */
+	int nb_samples; /* number of entries in <samples>, -1 if not collected */
+	uint64_t lost_samples; /* samples which found no room in the tables */
 };
 
 /* CLI context for the "show activity" command */
@@ -55,6 +72,31 @@ struct activity activity[MAX_THREADS] __attribute__((aligned(64))) = { };
 /* One struct per function pointer hash entry (SCHED_ACT_HASH_BUCKETS values, 0=collision) */
 struct sched_activity sched_activity[SCHED_ACT_HASH_BUCKETS] __attribute__((aligned(64))) = { };
 
+/* Same for sample converters, indexed by their struct sample_conv, only the
+ * calls and cpu_time are used.
+ */
+struct sched_activity conv_activity[SCHED_ACT_HASH_BUCKETS] __attribute__((aligned(64))) = { };
+
+/* Same for Lua functions, indexed by their struct hlua_function */
+struct sched_activity lua_activity[SCHED_ACT_HASH_BUCKETS] __attribute__((aligned(64))) = { };
+
+/* per-thread histograms for each entry of sched_activity[], allocated on use */
+struct sched_hist *sched_hist[MAX_THREADS] = { };
+
+/* per-thread tables of CPU time samples, allocated when sampling is enabled */
+struct prof_sample *prof_samples[MAX_THREADS] = { };
+
+#ifdef HA_HAVE_PROF_SAMPLES
+static int prof_samples_switch(int on);
+#endif
+
+/* overload limits set by "tune.overload.*" (0=unset), and number of threads
+ * currently above them.
+ */
+unsigned int overload_max_loop_us __read_mostly = 0;
+unsigned int overload_max_runqueue __read_mostly = 0;
+unsigned int overloaded_threads = 0;
+
 
 #ifdef USE_MEMORY_PROFILING
 
@@ -328,6 +370,32 @@ void report_stolen_time(uint64_t stolen)
  * The <run_time> argument is the number of microseconds elapsed since the
  * last time poll() returned.
  */
+/* Updates the current thread's overload status from its average loop time
+ * <avg_loop_us> and from its run queue size, and the number of overloaded
+ * threads accordingly. A thread enters the overloaded state when either value
+ * reaches its configured limit, and leaves it once both are below 3/4 of their
+ * limit so that the state doesn't flap around the limits.
+ */
+static void activity_check_overload(uint32_t avg_loop_us)
+{
+	uint rq = th_ctx->rq_total;
+
+	if (!(_HA_ATOMIC_LOAD(&th_ctx->flags) & TH_FL_OVERLOADED)) {
+		if ((overload_max_loop_us && avg_loop_us >= overload_max_loop_us) ||
+		    (overload_max_runqueue && rq >= overload_max_runqueue)) {
+			_HA_ATOMIC_OR(&th_ctx->flags, TH_FL_OVERLOADED);
+			_HA_ATOMIC_INC(&overloaded_threads);
+		}
+	}
+	else {
+		if ((!overload_max_loop_us || avg_loop_us < overload_max_loop_us / 4 * 3) &&
+		    (!overload_max_runqueue || rq < overload_max_runqueue / 4 * 3)) {
+			_HA_ATOMIC_AND(&th_ctx->flags, ~TH_FL_OVERLOADED);
+			_HA_ATOMIC_DEC(&overloaded_threads);
+		}
+	}
+}
+
 void activity_count_runtime(uint32_t run_time)
 {
 	uint32_t up, down;
@@ -355,6 +423,9 @@ void activity_count_runtime(uint32_t run_time)
 		             swrate_avg(run_time, TIME_STATS_SAMPLES) <= down)))
 			_HA_ATOMIC_AND(&th_ctx->flags, ~TH_FL_TASK_PROFILING);
 	}
+
+	if (unlikely(overload_max_loop_us || overload_max_runqueue))
+		activity_check_overload(swrate_avg(run_time, TIME_STATS_SAMPLES));
 }
 
 #ifdef USE_MEMORY_PROFILING
@@ -399,6 +470,73 @@ static int cfg_parse_prof_tasks(char **args, int section_type, struct proxy *cur
 	return 0;
 }
 
+/* config parser for global "profiling.samples", accepts "on" or "off" */
+static int cfg_parse_prof_samples(char **args, int section_type, struct proxy *curpx,
+                                  const struct proxy *defpx, const char *file, int line,
+                                  char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0) {
+#ifdef HA_HAVE_PROF_SAMPLES
+		profiling |= HA_PROF_SAMPLES;
+#else
+		memprintf(err, "'%s' is not supported on this platform.", args[0]);
+		return -1;
+#endif
+	}
+	else if (strcmp(args[1], "off") == 0)
+		profiling &= ~HA_PROF_SAMPLES;
+	else {
+		memprintf(err, "'%s' expects either 'on' or 'off' but got '%s'.", args[0], args[1]);
+		return -1;
+	}
+	return 0;
+}
+
+/* config parser for global "tune.overload.max-loop-latency" and
+ * "tune.overload.max-runqueue".
+ */
+static int cfg_parse_overload(char **args, int section_type, struct proxy *curpx,
+                              const struct proxy *defpx, const char *file, int line,
+                              char **err)
+{
+	const char *res;
+	uint value;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (!*args[1]) {
+		memprintf(err, "'%s' expects an argument.", args[0]);
+		return -1;
+	}
+
+	if (strcmp(args[0], "tune.overload.max-loop-latency") == 0) {
+		res = parse_time_err(args[1], &value, TIME_UNIT_US);
+		if (res == PARSE_TIME_OVER || res == PARSE_TIME_UNDER) {
+			memprintf(err, "timer %s in argument to '%s'.",
+			          res == PARSE_TIME_OVER ? "overflow" : "underflow", args[0]);
+			return -1;
+		}
+		else if (res) {
+			memprintf(err, "unexpected character '%c' in argument to '%s'.", *res, args[0]);
+			return -1;
+		}
+		overload_max_loop_us = value;
+	}
+	else {
+		res = parse_size_err(args[1], &value);
+		if (res) {
+			memprintf(err, "unexpected character '%c' in argument to '%s'.", *res, args[0]);
+			return -1;
+		}
+		overload_max_runqueue = value;
+	}
+	return 0;
+}
+
 /* parse a "set profiling" command. It always returns 1. */
 static int cli_parse_set_profiling(char **args, char *payload, struct appctx *appctx, void *private)
 {
@@ -437,8 +575,24 @@ static int cli_parse_set_profiling(char **args, char *payload, struct appctx *ap
 #endif
 	}
 
+	if (strcmp(args[2], "samples") == 0) {
+#ifdef HA_HAVE_PROF_SAMPLES
+		if (strcmp(args[3], "on") == 0) {
+			if (prof_samples_switch(1) < 0)
+				return cli_err(appctx, "Failed to allocate the samples tables.\n");
+		}
+		else if (strcmp(args[3], "off") == 0)
+			prof_samples_switch(0);
+		else
+			return cli_err(appctx, "Expects either 'on' or 'off'.\n");
+		return 1;
+#else
+		return cli_err(appctx, "CPU time sampling not supported on this platform.\n");
+#endif
+	}
+
 	if (strcmp(args[2], "tasks") != 0)
-		return cli_err(appctx, "Expects either 'tasks' or 'memory'.\n");
+		return cli_err(appctx, "Expects either 'tasks', 'samples' or 'memory'.\n");
 
 	if (strcmp(args[3], "on") == 0) {
 		unsigned int old = profiling;
@@ -453,6 +607,16 @@ static int cli_parse_set_profiling(char **args, char *payload, struct appctx *ap
 			HA_ATOMIC_STORE(&sched_activity[i].lat_time, 0);
 			HA_ATOMIC_STORE(&sched_activity[i].func, NULL);
 			HA_ATOMIC_STORE(&sched_activity[i].caller, NULL);
+			HA_ATOMIC_STORE(&conv_activity[i].calls, 0);
+			HA_ATOMIC_STORE(&conv_activity[i].cpu_time, 0);
+			HA_ATOMIC_STORE(&conv_activity[i].func, NULL);
+			HA_ATOMIC_STORE(&lua_activity[i].calls, 0);
+			HA_ATOMIC_STORE(&lua_activity[i].cpu_time, 0);
+			HA_ATOMIC_STORE(&lua_activity[i].func, NULL);
+		}
+		for (i = 0; i < global.nbthread; i++) {
+			if (sched_hist[i])
+				memset(sched_hist[i], 0, SCHED_ACT_HASH_BUCKETS * sizeof(*sched_hist[i]));
 		}
 	}
 	else if (strcmp(args[3], "auto") == 0) {
@@ -593,13 +757,459 @@ struct sched_activity *sched_activity_entry(struct sched_activity *array, const
 	return array;
 }
 
+/* Accounts a call of CPU time <cpu> and latency <lat> (ns) for entry <entry>
+ * of sched_activity[] into the current thread's histograms. These are only
+ * allocated on first use since they are only needed while profiling.
+ */
+void sched_hist_add(const struct sched_activity *entry, uint32_t cpu, uint32_t lat)
+{
+	struct sched_hist *hist = sched_hist[tid];
+
+	if (unlikely(!hist)) {
+		hist = calloc(SCHED_ACT_HASH_BUCKETS, sizeof(*hist));
+		if (!hist)
+			return;
+		HA_ATOMIC_STORE(&sched_hist[tid], hist);
+	}
+
+	hist += entry - sched_activity;
+	hist->cpu[sched_hist_bucket(cpu)]++;
+	hist->lat[sched_hist_bucket(lat)]++;
+}
+
+/* Merges into <out> the histograms of all threads for the entries of
+ * sched_activity[] matching function <func>, and caller <caller> unless
+ * <aggr> is set.
+ */
+static void sched_hist_merge(struct sched_hist *out, const void *func, const void *caller, int aggr)
+{
+	const struct sched_hist *hist;
+	int thr, i, b;
+
+	memset(out, 0, sizeof(*out));
+	for (i = 0; i < SCHED_ACT_HASH_BUCKETS; i++) {
+		if (HA_ATOMIC_LOAD(&sched_activity[i].func) != func ||
+		    (!aggr && HA_ATOMIC_LOAD(&sched_activity[i].caller) != caller))
+			continue;
+
+		for (thr = 0; thr < global.nbthread; thr++) {
+			hist = HA_ATOMIC_LOAD(&sched_hist[thr]);
+			if (!hist)
+				continue;
+			hist += i;
+			for (b = 0; b < SCHED_HIST_BUCKETS; b++) {
+				out->cpu[b] += hist->cpu[b];
+				out->lat[b] += hist->lat[b];
+			}
+		}
+	}
+}
+
+/* Returns the value below which <pm> per mille of the values counted in
+ * histogram <hist> fall, or zero if it is empty.
+ */
+static uint32_t sched_hist_pct(const uint32_t *hist, uint pm)
+{
+	uint64_t total = 0, target;
+	int b;
+
+	for (b = 0; b < SCHED_HIST_BUCKETS; b++)
+		total += hist[b];
+
+	if (!total)
+		return 0;
+
+	target = (total * pm + 999) / 1000;
+	for (b = 0; b < SCHED_HIST_BUCKETS - 1; b++) {
+		if (hist[b] >= target)
+			break;
+		target -= hist[b];
+	}
+	return sched_hist_value(b);
+}
+
+/* releases all threads' scheduler histograms */
+static void sched_hist_deinit(void)
+{
+	int thr;
+
+	for (thr = 0; thr < MAX_THREADS; thr++)
+		ha_free(&sched_hist[thr]);
+}
+
+REGISTER_POST_DEINIT(sched_hist_deinit);
+
+#ifdef HA_HAVE_PROF_SAMPLES
+
+/* define a dummy value to designate "no timer". Use only 32 bits. */
+#ifndef TIMER_INVALID
+#define TIMER_INVALID ((timer_t)(unsigned long)(0xfffffffful))
+#endif
+
+static timer_t prof_sample_timer[MAX_THREADS];
+static int prof_sample_handler_set;
+
+/* Arms thread <thr>'s sampling timer for the next sample, or disarms it if
+ * <on> is zero. Timers based on the CPU time are not automatically re-armed,
+ * so this is done again after each sample.
+ */
+static void prof_sample_arm(int thr, int on)
+{
+	struct itimerspec its = { };
+
+	if (prof_sample_timer[thr] == TIMER_INVALID)
+		return;
+
+	if (on)
+		its.it_value.tv_nsec = 1000000000UL / PROF_SAMPLE_HZ;
+	timer_settime(prof_sample_timer[thr], 0, &its, NULL);
+}
+
+/* Accounts one sample of handler <func> with the <nptrs> callers in <callers>
+ * into the current thread's table. It is called from the SIGPROF handler on
+ * the sampled thread, so it must not take any lock nor allocate anything.
+ * Samples which find no room in a few slots are accounted in entry 0.
+ */
+static void prof_sample_record(const void *func, void * const *callers, int nptrs)
+{
+	struct prof_sample *tbl = prof_samples[tid];
+	const void *frames[PROF_SAMPLE_DEPTH] = { };
+	struct prof_sample *e;
+	uint64_t hash = (ulong)func;
+	uint i, idx;
+
+	if (nptrs > PROF_SAMPLE_DEPTH)
+		nptrs = PROF_SAMPLE_DEPTH;
+	for (i = 0; i < nptrs; i++) {
+		frames[i] = callers[i];
+		hash = (hash ^ (ulong)frames[i]) * 0x9E3779B97F4A7C15ULL;
+	}
+	hash >>= 64 - PROF_SAMPLE_HASH_BITS;
+
+	for (i = 0; i < 8; i++) {
+		idx = (hash + i) & (PROF_SAMPLE_BUCKETS - 1);
+		if (!idx)
+			continue;
+		e = &tbl[idx];
+		if (!e->count) {
+			e->func = func;
+			memcpy(e->frames, frames, sizeof(frames));
+			e->count = 1;
+			return;
+		}
+		if (e->func == func && memcmp(e->frames, frames, sizeof(frames)) == 0) {
+			e->count++;
+			return;
+		}
+	}
+	tbl[0].count++;
+}
+
+/* This is the SIGPROF signal handler. A thread's timer fired, the thread ID
+ * is in si_int, but the signal may be delivered to any thread, so it is
+ * bounced to the right one when needed since only the sampled thread can
+ * retrieve its own call stack. Threads waiting in the poller are not sampled.
+ */
+static void prof_sample_handler(int sig, siginfo_t *si, void *arg)
+{
+	void *callers[PROF_SAMPLE_DEPTH + 2];
+	const void *func;
+	int old_errno = errno;
+	int nptrs, thr;
+
+	switch (si->si_code) {
+	case SI_TIMER:
+		thr = si->si_value.sival_int;
+		if (thr < 0 || thr >= global.nbthread)
+			goto leave;
+#ifdef USE_THREAD
+		if (thr != tid) {
+			ha_tkill(thr, sig);
+			goto leave;
+		}
+#endif
+		break;
+#if defined(USE_THREAD) && defined(SI_TKILL) /* Linux uses this */
+	case SI_TKILL:
+		break;
+#elif defined(USE_THREAD) && defined(SI_LWP) /* FreeBSD uses this */
+	case SI_LWP:
+		break;
+#endif
+	default:
+		goto leave;
+	}
+
+	if (!(_HA_ATOMIC_LOAD(&profiling) & HA_PROF_SAMPLES))
+		goto leave;
+
+	if (prof_samples[tid] && !(_HA_ATOMIC_LOAD(&th_ctx->flags) & TH_FL_SLEEPING)) {
+		/* the task may have been freed while running, so its handler
+		 * is retrieved from the thread's context.
+		 */
+		func = th_ctx->current ? th_ctx->current_fct : NULL;
+
+		/* the first two callers are this handler and the signal
+		 * trampoline.
+		 */
+		nptrs = my_backtrace(callers, sizeof(callers) / sizeof(*callers));
+		if (nptrs > 2)
+			prof_sample_record(func, callers + 2, nptrs - 2);
+		else
+			prof_sample_record(func, callers, 0);
+	}
+	prof_sample_arm(tid, 1);
+ leave:
+	errno = old_errno;
+}
+
+/* Allocates the sample tables of all threads which do not have one yet, and
+ * resets the other ones, then installs the SIGPROF handler if not done yet.
+ * Returns 0 on success or -1 on allocation failure.
+ */
+static int prof_samples_prepare(void)
+{
+	struct prof_sample *tbl;
+	struct sigaction sa;
+	int thr;
+
+	for (thr = 0; thr < global.nbthread; thr++) {
+		tbl = HA_ATOMIC_LOAD(&prof_samples[thr]);
+		if (tbl) {
+			memset(tbl, 0, PROF_SAMPLE_BUCKETS * sizeof(*tbl));
+			continue;
+		}
+		tbl = calloc(PROF_SAMPLE_BUCKETS, sizeof(*tbl));
+		if (!tbl)
+			return -1;
+		HA_ATOMIC_STORE(&prof_samples[thr], tbl);
+	}
+
+	if (!prof_sample_handler_set) {
+		sa.sa_handler = NULL;
+		sa.sa_sigaction = prof_sample_handler;
+		sigemptyset(&sa.sa_mask);
+		sa.sa_flags = SA_SIGINFO | SA_RESTART;
+		sigaction(SIGPROF, &sa, NULL);
+		prof_sample_handler_set = 1;
+	}
+	return 0;
+}
+
+/* Enables or disables CPU time sampling at run time. Enabling it resets the
+ * samples collected so far. Returns 0 on success or -1 on allocation failure.
+ */
+static int prof_samples_switch(int on)
+{
+	unsigned int old = profiling;
+	int thr;
+
+	if (on && prof_samples_prepare() < 0)
+		return -1;
+
+	if (on) {
+		while (!_HA_ATOMIC_CAS(&profiling, &old, old | HA_PROF_SAMPLES))
+			;
+	}
+	else {
+		while (!_HA_ATOMIC_CAS(&profiling, &old, old & ~HA_PROF_SAMPLES))
+			;
+	}
+
+	for (thr = 0; thr < global.nbthread; thr++)
+		prof_sample_arm(thr, on);
+	return 0;
+}
+
+/* prepares the sample tables at boot when sampling is enabled */
+static int init_prof_samples()
+{
+	if (!(profiling & HA_PROF_SAMPLES))
+		return ERR_NONE;
+
+	if (prof_samples_prepare() < 0) {
+		ha_alert("Failed to allocate the CPU time samples tables.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+	return ERR_NONE;
+}
+
+/* creates the current thread's sampling timer, and arms it if enabled */
+static int init_prof_samples_per_thread()
+{
+	if (!clock_setup_signal_timer(&prof_sample_timer[tid], SIGPROF, tid)) {
+		prof_sample_timer[tid] = TIMER_INVALID;
+		if (profiling & HA_PROF_SAMPLES)
+			ha_warning("Failed to setup the CPU time sampling timer for thread %u.\n", tid);
+		return 1;
+	}
+
+	prof_sample_arm(tid, profiling & HA_PROF_SAMPLES);
+	return 1;
+}
+
+static void deinit_prof_samples_per_thread()
+{
+	if (prof_sample_timer[tid] != TIMER_INVALID)
+		timer_delete(prof_sample_timer[tid]);
+	prof_sample_timer[tid] = TIMER_INVALID;
+}
+
+REGISTER_POST_CHECK(init_prof_samples);
+REGISTER_PER_THREAD_INIT(init_prof_samples_per_thread);
+REGISTER_PER_THREAD_DEINIT(deinit_prof_samples_per_thread);
+
+#endif /* HA_HAVE_PROF_SAMPLES */
+
+/* releases all threads' sample tables */
+static void prof_samples_deinit(void)
+{
+	int thr;
+
+	for (thr = 0; thr < MAX_THREADS; thr++)
+		ha_free(&prof_samples[thr]);
+}
+
+REGISTER_POST_DEINIT(prof_samples_deinit);
+
+/* compares the handler and callers of two samples */
+static int cmp_prof_sample_key(const void *a, const void *b)
+{
+	const struct prof_sample *l = (const struct prof_sample *)a;
+	const struct prof_sample *r = (const struct prof_sample *)b;
+	int i;
+
+	if (l->func != r->func)
+		return l->func > r->func ? 1 : -1;
+	for (i = 0; i < PROF_SAMPLE_DEPTH; i++) {
+		if (l->frames[i] != r->frames[i])
+			return l->frames[i] > r->frames[i] ? 1 : -1;
+	}
+	return 0;
+}
+
+/* sorts samples by decreasing count */
+static int cmp_prof_sample_count(const void *a, const void *b)
+{
+	const struct prof_sample *l = (const struct prof_sample *)a;
+	const struct prof_sample *r = (const struct prof_sample *)b;
+
+	if (l->count > r->count)
+		return -1;
+	else if (l->count < r->count)
+		return 1;
+	return 0;
+}
+
+/* Sorts the <nb> samples of <tbl> by key and merges identical ones. Returns
+ * the new number of entries.
+ */
+static int prof_samples_merge(struct prof_sample *tbl, int nb)
+{
+	int i, j;
+
+	qsort(tbl, nb, sizeof(*tbl), cmp_prof_sample_key);
+	for (i = j = 0; i < nb; i++) {
+		if (j && cmp_prof_sample_key(&tbl[j - 1], &tbl[i]) == 0)
+			tbl[j - 1].count += tbl[i].count;
+		else
+			tbl[j++] = tbl[i];
+	}
+	return j;
+}
+
+/* Collects the CPU time samples of all threads into a newly allocated array
+ * returned in <out>, which the caller must free. Callers are reduced to the
+ * start of their function so that all samples taken in the same functions
+ * are merged, and the stack is cut at the task handler or the scheduler.
+ * Entries are sorted by decreasing count, and the array always ends with an
+ * empty entry. The number of samples which found no room in the tables is
+ * returned in <lost>. Returns the number of entries,
+ * or -1 on allocation failure. This may take a few milliseconds so it must
+ * not be called from the data path.
+ */
+int prof_samples_collect(struct prof_sample **out, uint64_t *lost)
+{
+	struct buffer *tmp = get_trash_chunk();
+	const struct prof_sample *tbl;
+	struct prof_sample *all;
+	const void *addr;
+	int thr, i, j, nb = 0;
+
+	*out = NULL;
+	*lost = 0;
+	all = calloc(global.nbthread * PROF_SAMPLE_BUCKETS, sizeof(*all));
+	if (!all)
+		return -1;
+
+	for (thr = 0; thr < global.nbthread; thr++) {
+		tbl = HA_ATOMIC_LOAD(&prof_samples[thr]);
+		if (!tbl)
+			continue;
+		*lost += tbl[0].count;
+		for (i = 1; i < PROF_SAMPLE_BUCKETS; i++) {
+			/* the entry may be updated while being copied, it's
+			 * only a statistical tool so we don't care.
+			 */
+			if (tbl[i].count)
+				all[nb++] = tbl[i];
+		}
+	}
+
+	/* first merge identical addresses so that each one is resolved once */
+	nb = prof_samples_merge(all, nb);
+
+	for (i = 0; i < nb; i++) {
+		for (j = 0; j < PROF_SAMPLE_DEPTH && all[i].frames[j]; j++) {
+			chunk_reset(tmp);
+			addr = resolve_sym_name(tmp, NULL, all[i].frames[j]);
+			if (addr && (addr == all[i].func || addr == run_tasks_from_lists ||
+			             addr == run_poll_loop || addr == main))
+				break;
+			if (addr)
+				all[i].frames[j] = addr;
+		}
+		for (; j < PROF_SAMPLE_DEPTH; j++)
+			all[i].frames[j] = NULL;
+	}
+
+	nb = prof_samples_merge(all, nb);
+	qsort(all, nb, sizeof(*all), cmp_prof_sample_count);
+	*out = all;
+	return nb;
+}
+
+/* Appends to <buf> the call stack of sample <s> in the "folded" format used
+ * by flame graph tools: the task handler first, then the callers from the
+ * outermost to the interrupted one, separated by semi-colons.
+ */
+void prof_sample_fold(struct buffer *buf, const struct prof_sample *s)
+{
+	int j;
+
+	if (s->func)
+		resolve_sym_name(buf, NULL, s->func);
+	else
+		chunk_appendf(buf, "[none]");
+
+	for (j = PROF_SAMPLE_DEPTH - 1; j >= 0; j--) {
+		if (!s->frames[j])
+			continue;
+		chunk_appendf(buf, ";");
+		resolve_sym_name(buf, NULL, s->frames[j]);
+	}
+}
+
 /* This function dumps all profiling settings. It returns 0 if the output
  * buffer is full and it needs to be called again, otherwise non-zero.
  * It dumps some parts depending on the following states from show_prof_ctx:
  *    dump_step:
- *       0, 4: dump status, then jump to 1 if 0
- *       1, 5: dump tasks, then jump to 2 if 1
- *       2, 6: dump memory, then stop
+ *       0,  8: dump status, then jump to 1 if 0
+ *       1,  9: dump tasks, then jump to 2 if 1
+ *       2, 10: dump converters, then jump to 3 if 2
+ *       3, 11: dump Lua functions, then jump to 4 if 3
+ *       4, 12: dump CPU time samples, then jump to 5 if 4
+ *       5, 13: dump memory, then stop
  *    linenum:
  *       restart line for each step (starts at zero)
  *    maxcnt:
@@ -612,6 +1222,7 @@ static int cli_io_handler_show_profiling(struct appctx *appctx)
 {
 	struct show_prof_ctx *ctx = appctx->svcctx;
 	struct sched_activity tmp_activity[SCHED_ACT_HASH_BUCKETS] __attribute__((aligned(64)));
+	struct sched_hist tmp_hist;
 #ifdef USE_MEMORY_PROFILING
 	struct memprof_stats tmp_memstats[MEMPROF_HASH_BUCKETS + 1];
 	unsigned long long tot_alloc_calls, tot_free_calls;
@@ -636,13 +1247,17 @@ static int cli_io_handler_show_profiling(struct appctx *appctx)
 	default:                 str="off"; break;
 	}
 
-	if ((ctx->dump_step & 3) != 0)
+	if ((ctx->dump_step & 7) != 0)
 		goto skip_status;
 
 	chunk_printf(&trash,
 	             "Per-task CPU profiling              : %-8s      # set profiling tasks {on|auto|off}\n"
-	             "Memory usage profiling              : %-8s      # set profiling memory {on|off}\n",
-	             str, (profiling & HA_PROF_MEMORY) ? "on" : "off");
+	             "Memory usage profiling              : %-8s      # set profiling memory {on|off}\n"
+	             "CPU time sampling                   : %-8s      # set profiling samples {on|off}\n"
+	             "Profiling clock source              : %-8s      # tune.clock.tsc {auto|off}\n",
+	             str, (profiling & HA_PROF_MEMORY) ? "on" : "off",
+	             (profiling & HA_PROF_SAMPLES) ? "on" : "off",
+	             clock_uses_tsc() ? "tsc" : "system");
 
 	if (applet_putchk(appctx, &trash) == -1) {
 		/* failed, try again */
@@ -650,11 +1265,11 @@ static int cli_io_handler_show_profiling(struct appctx *appctx)
 	}
 
 	ctx->linenum = 0; // reset first line to dump
-	if ((ctx->dump_step & 4) == 0)
+	if ((ctx->dump_step & 8) == 0)
 		ctx->dump_step++; // next step
 
  skip_status:
-	if ((ctx->dump_step & 3) != 1)
+	if ((ctx->dump_step & 7) != 1)
 		goto skip_tasks;
 
 	memcpy(tmp_activity, sched_activity, sizeof(tmp_activity));
@@ -679,7 +1294,10 @@ static int cli_io_handler_show_profiling(struct appctx *appctx)
 	else if (ctx->by_what == 2) // by cpu_tot
 		qsort(tmp_activity, SCHED_ACT_HASH_BUCKETS, sizeof(tmp_activity[0]), cmp_sched_activity_cpu);
 
-	if (!ctx->linenum)
+	if (!ctx->linenum && ctx->hist)
+		chunk_appendf(&trash, "Tasks activity:\n"
+		                      "  function                      calls   cpu_p50   cpu_p99  cpu_p999   lat_p50   lat_p99  lat_p999\n");
+	else if (!ctx->linenum)
 		chunk_appendf(&trash, "Tasks activity:\n"
 		                      "  function                      calls   cpu_tot   cpu_avg   lat_tot   lat_avg\n");
 
@@ -708,10 +1326,21 @@ static int cli_io_handler_show_profiling(struct appctx *appctx)
 			max = 1;
 		chunk_appendf(&trash, "  %s%*llu", name_buffer->area, max, (unsigned long long)tmp_activity[i].calls);
 
-		print_time_short(&trash, "   ", tmp_activity[i].cpu_time, "");
-		print_time_short(&trash, "   ", tmp_activity[i].cpu_time / tmp_activity[i].calls, "");
-		print_time_short(&trash, "   ", tmp_activity[i].lat_time, "");
-		print_time_short(&trash, "   ", tmp_activity[i].lat_time / tmp_activity[i].calls, "");
+		if (ctx->hist) {
+			sched_hist_merge(&tmp_hist, tmp_activity[i].func, caller, ctx->aggr);
+			print_time_short(&trash, "   ", sched_hist_pct(tmp_hist.cpu, 500), "");
+			print_time_short(&trash, "   ", sched_hist_pct(tmp_hist.cpu, 990), "");
+			print_time_short(&trash, "   ", sched_hist_pct(tmp_hist.cpu, 999), "");
+			print_time_short(&trash, "   ", sched_hist_pct(tmp_hist.lat, 500), "");
+			print_time_short(&trash, "   ", sched_hist_pct(tmp_hist.lat, 990), "");
+			print_time_short(&trash, "   ", sched_hist_pct(tmp_hist.lat, 999), "");
+		}
+		else {
+			print_time_short(&trash, "   ", tmp_activity[i].cpu_time, "");
+			print_time_short(&trash, "   ", tmp_activity[i].cpu_time / tmp_activity[i].calls, "");
+			print_time_short(&trash, "   ", tmp_activity[i].lat_time, "");
+			print_time_short(&trash, "   ", tmp_activity[i].lat_time / tmp_activity[i].calls, "");
+		}
 
 		if (caller && !ctx->aggr && caller->what <= WAKEUP_TYPE_APPCTX_WAKEUP)
 			chunk_appendf(&trash, " <- %s@%s:%d %s",
@@ -732,13 +1361,158 @@ static int cli_io_handler_show_profiling(struct appctx *appctx)
 	}
 
 	ctx->linenum = 0; // reset first line to dump
-	if ((ctx->dump_step & 4) == 0)
+	if ((ctx->dump_step & 8) == 0)
 		ctx->dump_step++; // next step
 
  skip_tasks:
+	if ((ctx->dump_step & 7) != 2)
+		goto skip_convs;
+
+	memcpy(tmp_activity, conv_activity, sizeof(tmp_activity));
+	if (ctx->by_what == 2) // by cpu_tot
+		qsort(tmp_activity, SCHED_ACT_HASH_BUCKETS, sizeof(tmp_activity[0]), cmp_sched_activity_cpu);
+	else
+		qsort(tmp_activity, SCHED_ACT_HASH_BUCKETS, sizeof(tmp_activity[0]), cmp_sched_activity_calls);
+
+	if (!ctx->linenum)
+		chunk_appendf(&trash, "Converters activity:\n"
+		                      "  converter                     calls   cpu_tot   cpu_avg\n");
+
+	max_lines = ctx->maxcnt;
+	if (!max_lines)
+		max_lines = SCHED_ACT_HASH_BUCKETS;
+
+	for (i = ctx->linenum; i < max_lines; i++) {
+		const struct sample_conv *conv = tmp_activity[i].func;
+
+		if (!tmp_activity[i].calls)
+			continue; // skip empty entries
+
+		ctx->linenum = i;
+		str = conv ? conv->kw : "other";
+		max = 35 - strlen(str);
+		if (max < 1)
+			max = 1;
+		chunk_appendf(&trash, "  %s%*llu", str, max, (unsigned long long)tmp_activity[i].calls);
+		print_time_short(&trash, "   ", tmp_activity[i].cpu_time, "");
+		print_time_short(&trash, "   ", tmp_activity[i].cpu_time / tmp_activity[i].calls, "");
+		b_putchr(&trash, '\n');
+
+		if (applet_putchk(appctx, &trash) == -1) {
+			/* failed, try again */
+			return 0;
+		}
+	}
+
+	if (applet_putchk(appctx, &trash) == -1) {
+		/* failed, try again */
+		return 0;
+	}
+
+	ctx->linenum = 0; // reset first line to dump
+	if ((ctx->dump_step & 8) == 0)
+		ctx->dump_step++; // next step
+
+ skip_convs:
+	if ((ctx->dump_step & 7) != 3)
+		goto skip_lua;
+
+#ifdef USE_LUA
+	memcpy(tmp_activity, lua_activity, sizeof(tmp_activity));
+	if (ctx->by_what == 2) // by cpu_tot
+		qsort(tmp_activity, SCHED_ACT_HASH_BUCKETS, sizeof(tmp_activity[0]), cmp_sched_activity_cpu);
+	else
+		qsort(tmp_activity, SCHED_ACT_HASH_BUCKETS, sizeof(tmp_activity[0]), cmp_sched_activity_calls);
+
+	if (!ctx->linenum)
+		chunk_appendf(&trash, "Lua functions activity:\n"
+		                      "  function                      calls   cpu_tot   cpu_avg\n");
+
+	max_lines = ctx->maxcnt;
+	if (!max_lines)
+		max_lines = SCHED_ACT_HASH_BUCKETS;
+
+	for (i = ctx->linenum; i < max_lines; i++) {
+		const struct hlua_function *fcn = tmp_activity[i].func;
+
+		if (!tmp_activity[i].calls)
+			continue; // skip empty entries
+
+		ctx->linenum = i;
+		str = fcn ? fcn->name : "other";
+		max = 35 - strlen(str);
+		if (max < 1)
+			max = 1;
+		chunk_appendf(&trash, "  %s%*llu", str, max, (unsigned long long)tmp_activity[i].calls);
+		print_time_short(&trash, "   ", tmp_activity[i].cpu_time, "");
+		print_time_short(&trash, "   ", tmp_activity[i].cpu_time / tmp_activity[i].calls, "");
+		b_putchr(&trash, '\n');
+
+		if (applet_putchk(appctx, &trash) == -1) {
+			/* failed, try again */
+			return 0;
+		}
+	}
+
+	if (applet_putchk(appctx, &trash) == -1) {
+		/* failed, try again */
+		return 0;
+	}
+#endif
+	ctx->linenum = 0; // reset first line to dump
+	if ((ctx->dump_step & 8) == 0)
+		ctx->dump_step++; // next step
+
+ skip_lua:
+	if ((ctx->dump_step & 7) != 4)
+		goto skip_samples;
+
+	if (ctx->nb_samples < 0) {
+		ctx->nb_samples = prof_samples_collect(&ctx->samples, &ctx->lost_samples);
+		if (ctx->nb_samples < 0)
+			ctx->nb_samples = 0;
+		if (ctx->by_what == 1) // sort by addr
+			qsort(ctx->samples, ctx->nb_samples, sizeof(*ctx->samples), cmp_prof_sample_key);
+	}
+
+	if (!ctx->linenum) {
+		uint64_t total = ctx->lost_samples;
+
+		for (i = 0; i < ctx->nb_samples; i++)
+			total += ctx->samples[i].count;
+		chunk_appendf(&trash, "CPU time samples (%llu at %d Hz per thread, %llu lost), folded stacks:\n",
+		              (unsigned long long)total, PROF_SAMPLE_HZ, (unsigned long long)ctx->lost_samples);
+	}
+
+	max_lines = ctx->nb_samples;
+	if (ctx->maxcnt && ctx->maxcnt < max_lines)
+		max_lines = ctx->maxcnt;
+
+	for (i = ctx->linenum; i < max_lines; i++) {
+		ctx->linenum = i;
+		prof_sample_fold(&trash, &ctx->samples[i]);
+		chunk_appendf(&trash, " %llu\n", (unsigned long long)ctx->samples[i].count);
+
+		if (applet_putchk(appctx, &trash) == -1) {
+			/* failed, try again */
+			return 0;
+		}
+	}
+
+	if (applet_putchk(appctx, &trash) == -1) {
+		/* failed, try again */
+		return 0;
+	}
+
+	ha_free(&ctx->samples);
+	ctx->linenum = 0; // reset first line to dump
+	if ((ctx->dump_step & 8) == 0)
+		ctx->dump_step++; // next step
+
+ skip_samples:
 
 #ifdef USE_MEMORY_PROFILING
-	if ((ctx->dump_step & 3) != 2)
+	if ((ctx->dump_step & 7) != 5)
 		goto skip_mem;
 
 	memcpy(tmp_memstats, memprof_stats, sizeof(tmp_memstats));
@@ -816,7 +1590,7 @@ static int cli_io_handler_show_profiling(struct appctx *appctx)
 		return 0;
 
 	ctx->linenum = 0; // reset first line to dump
-	if ((ctx->dump_step & 4) == 0)
+	if ((ctx->dump_step & 8) == 0)
 		ctx->dump_step++; // next step
 
  skip_mem:
@@ -825,8 +1599,16 @@ static int cli_io_handler_show_profiling(struct appctx *appctx)
 	return 1;
 }
 
+/* releases the CPU time samples collected by "show profiling" */
+static void cli_release_show_profiling(struct appctx *appctx)
+{
+	struct show_prof_ctx *ctx = appctx->svcctx;
+
+	ha_free(&ctx->samples);
+}
+
 /* parse a "show profiling" command. It returns 1 on failure, 0 if it starts to dump.
- *  - cli.i0 is set to the first state (0=all, 4=status, 5=tasks, 6=memory)
+ *  - cli.i0 is set to the first state (0=all, 8=status, 9=tasks, 10=converters, 11=lua, 12=samples, 13=memory)
  *  - cli.o1 is set to 1 if the output must be sorted by addr instead of usage
  *  - cli.o0 is set to the number of lines of output
  */
@@ -838,18 +1620,28 @@ static int cli_parse_show_profiling(char **args, char *payload, struct appctx *a
 	if (!cli_has_level(appctx, ACCESS_LVL_ADMIN))
 		return 1;
 
+	ctx->nb_samples = -1;
 	for (arg = 2; *args[arg]; arg++) {
 		if (strcmp(args[arg], "all") == 0) {
-			ctx->dump_step = 0; // will cycle through 0,1,2; default
+			ctx->dump_step = 0; // will cycle through 0,1,2,3,4; default
 		}
 		else if (strcmp(args[arg], "status") == 0) {
-			ctx->dump_step = 4; // will visit status only
+			ctx->dump_step = 8; // will visit status only
 		}
 		else if (strcmp(args[arg], "tasks") == 0) {
-			ctx->dump_step = 5; // will visit tasks only
+			ctx->dump_step = 9; // will visit tasks only
+		}
+		else if (strcmp(args[arg], "converters") == 0) {
+			ctx->dump_step = 10; // will visit converters only
+		}
+		else if (strcmp(args[arg], "lua") == 0) {
+			ctx->dump_step = 11; // will visit Lua functions only
+		}
+		else if (strcmp(args[arg], "samples") == 0) {
+			ctx->dump_step = 12; // will visit CPU time samples only
 		}
 		else if (strcmp(args[arg], "memory") == 0) {
-			ctx->dump_step = 6; // will visit memory only
+			ctx->dump_step = 13; // will visit memory only
 		}
 		else if (strcmp(args[arg], "byaddr") == 0) {
 			ctx->by_what = 1; // sort output by address instead of usage
@@ -860,11 +1652,14 @@ static int cli_parse_show_profiling(char **args, char *payload, struct appctx *a
 		else if (strcmp(args[arg], "aggr") == 0) {
 			ctx->aggr = 1;    // aggregate output by callee
 		}
+		else if (strcmp(args[arg], "hist") == 0) {
+			ctx->hist = 1;    // dump percentiles instead of totals
+		}
 		else if (isdigit((unsigned char)*args[arg])) {
 			ctx->maxcnt = atoi(args[arg]); // number of entries to dump
 		}
 		else
-			return cli_err(appctx, "Expects either 'all', 'status', 'tasks', 'memory', 'byaddr', 'bytime', 'aggr' or a max number of output lines.\n");
+			return cli_err(appctx, "Expects either 'all', 'status', 'tasks', 'converters', 'lua', 'samples', 'memory', 'byaddr', 'bytime', 'aggr', 'hist' or a max number of output lines.\n");
 	}
 	return 0;
 }
@@ -1103,16 +1898,28 @@ static int cli_io_handler_show_activity(struct appctx *appctx)
 	chunk_appendf(&trash, "stream_calls:"); SHOW_TOT(thr, activity[thr].stream_calls);
 	chunk_appendf(&trash, "pool_fail:");    SHOW_TOT(thr, activity[thr].pool_fail);
 	chunk_appendf(&trash, "buf_wait:");     SHOW_TOT(thr, activity[thr].buf_wait);
+	chunk_appendf(&trash, "steal_tasks:");  SHOW_TOT(thr, activity[thr].steal_tasks);
+	chunk_appendf(&trash, "steal_miss:");   SHOW_TOT(thr, activity[thr].steal_miss);
+	chunk_appendf(&trash, "pipe_new:");     SHOW_TOT(thr, activity[thr].pipe_new);
+	chunk_appendf(&trash, "pipe_shared:");  SHOW_TOT(thr, activity[thr].pipe_shared);
+	chunk_appendf(&trash, "pipe_grow:");    SHOW_TOT(thr, activity[thr].pipe_grow);
+	chunk_appendf(&trash, "splice_calls:"); SHOW_TOT(thr, activity[thr].splice_calls);
+	chunk_appendf(&trash, "ehdl_queued:");  SHOW_TOT(thr, activity[thr].ehdl_queued);
+	chunk_appendf(&trash, "ehdl_wakeups:"); SHOW_TOT(thr, activity[thr].ehdl_wakeups);
+	chunk_appendf(&trash, "ehdl_deferred:");SHOW_TOT(thr, activity[thr].ehdl_deferred);
 	chunk_appendf(&trash, "cpust_ms_tot:"); SHOW_TOT(thr, activity[thr].cpust_total / 2);
 	chunk_appendf(&trash, "cpust_ms_1s:");  SHOW_TOT(thr, read_freq_ctr(&activity[thr].cpust_1s) / 2);
 	chunk_appendf(&trash, "cpust_ms_15s:"); SHOW_TOT(thr, read_freq_ctr_period(&activity[thr].cpust_15s, 15000) / 2);
 	chunk_appendf(&trash, "avg_loop_us:");  SHOW_AVG(thr, swrate_avg(activity[thr].avg_loop_us, TIME_STATS_SAMPLES));
+	chunk_appendf(&trash, "rq_budget:");    SHOW_AVG(thr, ha_thread_ctx[thr].rq_budget ? ha_thread_ctx[thr].rq_budget : global.tune.runqueue_depth);
 	chunk_appendf(&trash, "accepted:");     SHOW_TOT(thr, activity[thr].accepted);
 	chunk_appendf(&trash, "accq_pushed:");  SHOW_TOT(thr, activity[thr].accq_pushed);
 	chunk_appendf(&trash, "accq_full:");    SHOW_TOT(thr, activity[thr].accq_full);
+	chunk_appendf(&trash, "ovl_paused:");   SHOW_TOT(thr, activity[thr].ovl_paused);
 #ifdef USE_THREAD
 	chunk_appendf(&trash, "accq_ring:");    SHOW_TOT(thr, (accept_queue_rings[thr].tail - accept_queue_rings[thr].head + ACCEPT_QUEUE_SIZE) % ACCEPT_QUEUE_SIZE);
 	chunk_appendf(&trash, "fd_takeover:");  SHOW_TOT(thr, activity[thr].fd_takeover);
+	chunk_appendf(&trash, "conn_migr:");    SHOW_TOT(thr, activity[thr].conn_migr);
 #endif
 
 #if defined(DEBUG_DEV)
@@ -1160,7 +1967,10 @@ static struct cfg_kw_list cfg_kws = {ILH, {
 #ifdef USE_MEMORY_PROFILING
 	{ CFG_GLOBAL, "profiling.memory",     cfg_parse_prof_memory     },
 #endif
+	{ CFG_GLOBAL, "profiling.samples",    cfg_parse_prof_samples    },
 	{ CFG_GLOBAL, "profiling.tasks",      cfg_parse_prof_tasks      },
+	{ CFG_GLOBAL, "tune.overload.max-loop-latency", cfg_parse_overload },
+	{ CFG_GLOBAL, "tune.overload.max-runqueue",     cfg_parse_overload },
 	{ 0, NULL, NULL }
 }};
 
@@ -1168,9 +1978,9 @@ INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
 
 /* register cli keywords */
 static struct cli_kw_list cli_kws = {{ },{
-	{ { "set",  "profiling", NULL }, "set profiling <what> {auto|on|off}      : enable/disable resource profiling (tasks,memory)", cli_parse_set_profiling,  NULL },
+	{ { "set",  "profiling", NULL }, "set profiling <what> {auto|on|off}      : enable/disable resource profiling (tasks,samples,memory)", cli_parse_set_profiling,  NULL },
 	{ { "show", "activity", NULL },  "show activity [-1|0|thread_num]         : show per-thread activity stats (for support/developers)", cli_parse_show_activity, cli_io_handler_show_activity, NULL },
-	{ { "show", "profiling", NULL }, "show profiling [<what>|<#lines>|<opts>]*: show profiling state (all,status,tasks,memory)",   cli_parse_show_profiling, cli_io_handler_show_profiling, NULL },
+	{ { "show", "profiling", NULL }, "show profiling [<what>|<#lines>|<opts>]*: show profiling state (all,status,tasks,converters,lua,samples,memory)",   cli_parse_show_profiling, cli_io_handler_show_profiling, cli_release_show_profiling },
 	{ { "show", "tasks", NULL },     "show tasks                              : show running tasks",                               NULL, cli_io_handler_show_tasks,     NULL },
 	{{},}
 }};
@@ -27,6 +27,7 @@
 #include <haproxy/backend.h>
 #include <haproxy/channel.h>
 #include <haproxy/check.h>
+#include <haproxy/freq_ctr.h>
 #include <haproxy/frontend.h>
 #include <haproxy/global.h>
 #include <haproxy/hash.h>
@@ -38,7 +39,9 @@
 #include <haproxy/lb_fas.h>
 #include <haproxy/lb_fwlc.h>
 #include <haproxy/lb_fwrr.h>
+#include <haproxy/lb_maglev.h>
 #include <haproxy/lb_map.h>
+#include <haproxy/lb_rdv.h>
 #include <haproxy/log.h>
 #include <haproxy/namespace.h>
 #include <haproxy/obj_type.h>
@@ -58,6 +61,7 @@
 #include <haproxy/ticks.h>
 #include <haproxy/time.h>
 #include <haproxy/trace.h>
+#include <haproxy/usdt.h>
 
 #define TRACE_SOURCE &trace_strm
 
@@ -158,6 +162,26 @@ void update_backend_weight(struct proxy *px)
 	}
 }
 
+/*
+ * This function returns the server of proxy <px> matching hash key <hash>
+ * using the lookup method configured by "hash-type". Server <avoid> is only
+ * avoided by the dynamic methods. NULL is returned if no
+ * valid server is found.
+ */
+static inline struct server *get_server_from_hash(struct proxy *px, unsigned int hash, const struct server *avoid)
+{
+	switch (px->lbprm.algo & BE_LB_LKUP) {
+	case BE_LB_LKUP_CHTREE:
+		return chash_get_server_hash(px, hash, avoid);
+	case BE_LB_LKUP_RDVARR:
+		return rdv_get_server_hash(px, hash, avoid);
+	case BE_LB_LKUP_MGTBL:
+		return maglev_get_server_hash(px, hash, avoid);
+	default:
+		return map_get_server_hash(px, hash);
+	}
+}
+
 /*
  * This function tries to find a running server for the proxy <px> following
  * the source hash method. Depending on the number of active/backup servers,
@@ -185,10 +209,7 @@ static struct server *get_server_sh(struct proxy *px, const char *addr, int len,
 	if ((px->lbprm.algo & BE_LB_HASH_MOD) == BE_LB_HMOD_AVAL)
 		h = full_hash(h);
  hash_done:
-	if ((px->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_CHTREE)
-		return chash_get_server_hash(px, h, avoid);
-	else
-		return map_get_server_hash(px, h);
+	return get_server_from_hash(px, h, avoid);
 }
 
 /*
@@ -240,10 +261,7 @@ static struct server *get_server_uh(struct proxy *px, char *uri, int uri_len, co
 	if ((px->lbprm.algo & BE_LB_HASH_MOD) == BE_LB_HMOD_AVAL)
 		hash = full_hash(hash);
  hash_done:
-	if ((px->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_CHTREE)
-		return chash_get_server_hash(px, hash, avoid);
-	else
-		return map_get_server_hash(px, hash);
+	return get_server_from_hash(px, hash, avoid);
 }
 
 /*
@@ -297,10 +315,7 @@ static struct server *get_server_ph(struct proxy *px, const char *uri, int uri_l
 				if ((px->lbprm.algo & BE_LB_HASH_MOD) == BE_LB_HMOD_AVAL)
 					hash = full_hash(hash);
 
-				if ((px->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_CHTREE)
-					return chash_get_server_hash(px, hash, avoid);
-				else
-					return map_get_server_hash(px, hash);
+				return get_server_from_hash(px, hash, avoid);
 			}
 		}
 		/* skip to next parameter */
@@ -377,10 +392,7 @@ static struct server *get_server_ph_post(struct stream *s, const struct server *
 				if ((px->lbprm.algo & BE_LB_HASH_MOD) == BE_LB_HMOD_AVAL)
 					hash = full_hash(hash);
 
-				if ((px->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_CHTREE)
-					return chash_get_server_hash(px, hash, avoid);
-				else
-					return map_get_server_hash(px, hash);
+				return get_server_from_hash(px, hash, avoid);
 			}
 		}
 		/* skip to next parameter */
@@ -472,10 +484,7 @@ static struct server *get_server_hh(struct stream *s, const struct server *avoid
 	if ((px->lbprm.algo & BE_LB_HASH_MOD) == BE_LB_HMOD_AVAL)
 		hash = full_hash(hash);
  hash_done:
-	if ((px->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_CHTREE)
-		return chash_get_server_hash(px, hash, avoid);
-	else
-		return map_get_server_hash(px, hash);
+	return get_server_from_hash(px, hash, avoid);
 }
 
 /* RDP Cookie HASH.  */
@@ -517,10 +526,7 @@ static struct server *get_server_rch(struct stream *s, const struct server *avoi
 	if ((px->lbprm.algo & BE_LB_HASH_MOD) == BE_LB_HMOD_AVAL)
 		hash = full_hash(hash);
  hash_done:
-	if ((px->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_CHTREE)
-		return chash_get_server_hash(px, hash, avoid);
-	else
-		return map_get_server_hash(px, hash);
+	return get_server_from_hash(px, hash, avoid);
 }
 
 /* sample expression HASH. Returns NULL if the sample is not found or if there
@@ -551,10 +557,22 @@ static struct server *get_server_expr(struct stream *s, const struct server *avo
 	if ((px->lbprm.algo & BE_LB_HASH_MOD) == BE_LB_HMOD_AVAL)
 		hash = full_hash(hash);
  hash_done:
-	if ((px->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_CHTREE)
-		return chash_get_server_hash(px, hash, avoid);
-	else
-		return map_get_server_hash(px, hash);
+	return get_server_from_hash(px, hash, avoid);
+}
+
+/* Returns the cost of server <srv> for "balance ewma", which is its average
+ * peak response time multiplied by its number of served requests plus the one
+ * to come. The average is halved for each LB_EWMA_HALF_LIFE period without
+ * any sample. One millisecond is added to the response time so that the number
+ * of connections still matters for very fast servers.
+ */
+static inline unsigned long long srv_ewma_cost(const struct server *srv)
+{
+	unsigned int avg = swrate_avg(HA_ATOMIC_LOAD(&srv->lb_ewma), LB_EWMA_SAMPLES);
+	unsigned int idle = (now_ms - HA_ATOMIC_LOAD(&srv->lb_ewma_date)) / LB_EWMA_HALF_LIFE;
+
+	avg = (idle < 32) ? avg >> idle : 0;
+	return (unsigned long long)(avg + 1) * (srv->served + 1);
 }
 
 /* random value  */
@@ -564,6 +582,7 @@ static struct server *get_server_rnd(struct stream *s, const struct server *avoi
 	struct proxy  *px = s->be;
 	struct server *prev, *curr;
 	int draws = px->lbprm.arg_opt1; // number of draws
+	int ewma = (px->lbprm.algo & BE_LB_KIND) == BE_LB_KIND_CB;
 
 	/* tot_weight appears to mean srv_count */
 	if (px->lbprm.tot_weight == 0)
@@ -573,16 +592,27 @@ static struct server *get_server_rnd(struct stream *s, const struct server *avoi
 	do {
 		prev = curr;
 		hash = statistical_prng();
-		curr = chash_get_server_hash(px, hash, avoid);
+
+		/* ewma compares distinct servers, otherwise a slow server
+		 * would still be picked each time it is drawn twice.
+		 */
+		curr = chash_get_server_hash(px, hash, (ewma && prev) ? prev : avoid);
 		if (!curr)
 			break;
 
 		/* compare the new server to the previous best choice and pick
-		 * the one with the least currently served requests.
+		 * the one with the least currently served requests, or with the
+		 * lowest response time times served requests for "ewma".
 		 */
-		if (prev && prev != curr &&
-		    curr->served * prev->cur_eweight > prev->served * curr->cur_eweight)
-			curr = prev;
+		if (prev && prev != curr) {
+			if (ewma) {
+				if (curr == avoid ||
+				    srv_ewma_cost(curr) * prev->cur_eweight > srv_ewma_cost(prev) * curr->cur_eweight)
+					curr = prev;
+			}
+			else if (curr->served * prev->cur_eweight > prev->served * curr->cur_eweight)
+				curr = prev;
+		}
 	} while (--draws > 0);
 
 	/* if the selected server is full, pretend we have none so that we reach
@@ -714,6 +744,8 @@ int assign_server(struct stream *s)
 			break;
 
 		case BE_LB_LKUP_CHTREE:
+		case BE_LB_LKUP_RDVARR:
+		case BE_LB_LKUP_MGTBL:
 		case BE_LB_LKUP_MAP:
 			if ((s->be->lbprm.algo & BE_LB_KIND) == BE_LB_KIND_RR) {
 				/* static-rr (map) or random (chash) */
@@ -723,6 +755,11 @@ int assign_server(struct stream *s)
 					srv = map_get_server_rr(s->be, prev_srv);
 				break;
 			}
+			else if ((s->be->lbprm.algo & BE_LB_KIND) == BE_LB_KIND_CB) {
+				/* ewma (chash) */
+				srv = get_server_rnd(s, prev_srv);
+				break;
+			}
 			else if ((s->be->lbprm.algo & BE_LB_KIND) != BE_LB_KIND_HI) {
 				/* unknown balancing algorithm */
 				err = SRV_STATUS_INTERNAL;
@@ -805,6 +842,10 @@ int assign_server(struct stream *s)
 			if (!srv) {
 				if ((s->be->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_CHTREE)
 					srv = chash_get_next_server(s->be, prev_srv);
+				else if ((s->be->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_RDVARR)
+					srv = rdv_get_next_server(s->be, prev_srv);
+				else if ((s->be->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_MGTBL)
+					srv = maglev_get_next_server(s->be, prev_srv);
 				else
 					srv = map_get_server_rr(s->be, prev_srv);
 			}
@@ -840,6 +881,7 @@ int assign_server(struct stream *s)
 	s->flags |= SF_ASSIGNED;
 	err = SRV_STATUS_OK;
  out:
+	HA_USDT(server_assigned, s, s->be, objt_server(s->target), prev_srv, err);
 
 	/* Either we take back our connection slot, or we offer it to someone
 	 * else if we don't need it anymore.
@@ -1146,6 +1188,41 @@ static int alloc_bind_address(struct sockaddr_storage **ss,
 	return SRV_STATUS_OK;
 }
 
+/* Tries to take over from thread <thr> an idle connection to server <srv>
+ * matching <hash>, from the safe list if <*is_safe> is set, otherwise from the
+ * idle list then from the safe one, in which case <*is_safe> is set. The idle
+ * conns lock of thread <thr> must be held. Returns the connection, already
+ * removed from its tree, or NULL if none could be taken over.
+ */
+static struct connection *conn_backend_takeover(struct server *srv, int thr, int *is_safe, int64_t hash)
+{
+	struct connection *conn;
+
+	conn = srv_lookup_conn(*is_safe ? &srv->per_thr[thr].safe_conns : &srv->per_thr[thr].idle_conns, hash);
+	while (conn) {
+		if (conn->mux->takeover && conn->mux->takeover(conn, thr) == 0)
+			goto found;
+		conn = srv_lookup_conn_next(conn);
+	}
+
+	if (!*is_safe && srv->curr_safe_nb > 0) {
+		conn = srv_lookup_conn(&srv->per_thr[thr].safe_conns, hash);
+		while (conn) {
+			if (conn->mux->takeover && conn->mux->takeover(conn, thr) == 0) {
+				*is_safe = 1;
+				goto found;
+			}
+			conn = srv_lookup_conn_next(conn);
+		}
+	}
+	return NULL;
+
+ found:
+	conn_delete_from_tree(&conn->hash_node->node);
+	_HA_ATOMIC_INC(&activity[tid].fd_takeover);
+	return conn;
+}
+
 /* Attempt to get a backend connection from the specified mt_list array
  * (safe or idle connections). The <is_safe> argument means what type of
  * connection the caller wants.
@@ -1155,7 +1232,7 @@ static struct connection *conn_backend_get(struct stream *s, struct server *srv,
 	struct connection *conn = NULL;
 	int i; // thread number
 	int found = 0;
-	int stop;
+	int stop, busy;
 
 	/* We need to lock even if this is our own list, because another
 	 * thread may be trying to migrate that connection, and we don't want
@@ -1207,41 +1284,36 @@ static struct connection *conn_backend_get(struct stream *s, struct server *srv,
 
 	stop += tg->base;
 	i = stop;
+	busy = -1;
 	do {
 		if (!srv->curr_idle_thr[i] || i == tid)
 			continue;
 
-		if (HA_SPIN_TRYLOCK(IDLE_CONNS_LOCK, &idle_conns[i].idle_conns_lock) != 0)
+		if (HA_SPIN_TRYLOCK(IDLE_CONNS_LOCK, &idle_conns[i].idle_conns_lock) != 0) {
+			/* remember the first contended thread, we'll wait for
+			 * it if nothing else is found.
+			 */
+			if (busy < 0)
+				busy = i;
 			continue;
-		conn = srv_lookup_conn(is_safe ? &srv->per_thr[i].safe_conns : &srv->per_thr[i].idle_conns, hash);
-		while (conn) {
-			if (conn->mux->takeover && conn->mux->takeover(conn, i) == 0) {
-				conn_delete_from_tree(&conn->hash_node->node);
-				_HA_ATOMIC_INC(&activity[tid].fd_takeover);
-				found = 1;
-				break;
-			}
-
-			conn = srv_lookup_conn_next(conn);
-		}
-
-		if (!found && !is_safe && srv->curr_safe_nb > 0) {
-			conn = srv_lookup_conn(&srv->per_thr[i].safe_conns, hash);
-			while (conn) {
-				if (conn->mux->takeover && conn->mux->takeover(conn, i) == 0) {
-					conn_delete_from_tree(&conn->hash_node->node);
-					_HA_ATOMIC_INC(&activity[tid].fd_takeover);
-					found = 1;
-					is_safe = 1;
-					break;
-				}
-
-				conn = srv_lookup_conn_next(conn);
-			}
 		}
+		conn = conn_backend_takeover(srv, i, &is_safe, hash);
 		HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[i].idle_conns_lock);
+		found = !!conn;
 	} while (!found && (i = (i + 1 == tg->base + tg->count) ? tg->base : i + 1) != stop);
 
+	/* With many threads, failed trylocks become frequent and would make
+	 * us create a new connection while an idle one was available. Better
+	 * wait for one contended thread, which is still much cheaper.
+	 */
+	if (!found && busy >= 0 && srv->curr_idle_thr[busy]) {
+		i = busy;
+		HA_SPIN_LOCK(IDLE_CONNS_LOCK, &idle_conns[i].idle_conns_lock);
+		conn = conn_backend_takeover(srv, i, &is_safe, hash);
+		HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[i].idle_conns_lock);
+		found = !!conn;
+	}
+
 	if (!found)
 		conn = NULL;
  done:
@@ -1256,6 +1328,10 @@ static struct connection *conn_backend_get(struct stream *s, struct server *srv,
 		conn->flags &= ~CO_FL_LIST_MASK;
 		__ha_barrier_atomic_store();
 
+		/* refill the pool of the thread we picked from */
+		if (srv->pool_min_conn)
+			task_wakeup(idle_conns[i].prewarm_task, TASK_WOKEN_OTHER);
+
 		if ((s->be->options & PR_O_REUSE_MASK) == PR_O_REUSE_SAFE &&
 		    conn->mux->flags & MX_FL_HOL_RISK) {
 			/* attach the connection to the session private list
@@ -1264,8 +1340,7 @@ static struct connection *conn_backend_get(struct stream *s, struct server *srv,
 			session_add_conn(s->sess, conn, conn->target);
 		}
 		else {
-			eb64_insert(&srv->per_thr[tid].avail_conns,
-			            &conn->hash_node->node);
+			eb64_insert(srv_avail_conns(srv), &conn->hash_node->node);
 		}
 	}
 	return conn;
@@ -1379,8 +1454,10 @@ static int connect_server(struct stream *s)
 	/* first, set unique connection parameters and then calculate hash */
 	memset(&hash_params, 0, sizeof(hash_params));
 
-	/* 1. target */
+	/* 1. target, or the group of servers sharing their connections */
 	hash_params.target = s->target;
+	if (srv && srv->coalesce)
+		hash_params.target = srv->coalesce;
 
 #ifdef USE_OPENSSL
 	/* 2. sni
@@ -1395,7 +1472,7 @@ static int connect_server(struct stream *s)
 #endif /* USE_OPENSSL */
 
 	/* 3. destination address */
-	if (srv && (!is_addr(&srv->addr) || srv->flags & SRV_F_MAPPORTS))
+	if (srv && (!is_addr(&srv->addr) || srv->flags & SRV_F_MAPPORTS || srv->coalesce))
 		hash_params.dst_addr = s->scb->dst;
 
 	/* 4. source address */
@@ -1438,8 +1515,15 @@ static int connect_server(struct stream *s)
 		 * Idle conns are necessarily looked up on the same thread so
 		 * that there is no concurrency issues.
 		 */
-		if (!eb_is_empty(&srv->per_thr[tid].avail_conns)) {
-			srv_conn = srv_lookup_conn(&srv->per_thr[tid].avail_conns, hash);
+		if (!eb_is_empty(srv_avail_conns(srv))) {
+			const int idempotent = s->txn && (s->txn->meth == HTTP_METH_GET || s->txn->meth == HTTP_METH_HEAD);
+
+			srv_conn = srv_lookup_conn(srv_avail_conns(srv), hash);
+
+			/* only idempotent requests may be pipelined after other ones */
+			while (srv_conn && srv_conn->mux && (srv_conn->mux->flags & MX_FL_PIPELINE) && !idempotent)
+				srv_conn = srv_lookup_conn_next(srv_conn);
+
 			if (srv_conn) {
 				DBG_TRACE_STATE("reuse connection from avail", STRM_EV_STRM_PROC|STRM_EV_CS_ST, s);
 				reuse = 1;
@@ -1481,6 +1565,30 @@ static int connect_server(struct stream *s)
 				reuse = 1;
 			}
 		}
+
+		/* still nothing, try the idle connections of the other servers
+		 * sharing theirs with us, the hash ensures they reach the same
+		 * destination with the same parameters.
+		 */
+		if (!srv_conn && srv->coalesce && reuse_mode >= PR_O_REUSE_AGGR) {
+			const int not_first_req = s->txn && s->txn->flags & TX_NOT_FIRST;
+			const int safe_only = !not_first_req && reuse_mode != PR_O_REUSE_ALWS;
+			struct server *other;
+
+			for (other = s->be->srv; other && !srv_conn; other = other->next) {
+				if (other == srv || other->coalesce != srv->coalesce ||
+				    !other->max_idle_conns || !other->curr_idle_conns)
+					continue;
+				if (safe_only && !other->curr_safe_nb)
+					continue;
+				srv_conn = conn_backend_get(s, other, safe_only, hash);
+			}
+
+			if (srv_conn) {
+				DBG_TRACE_STATE("reuse connection from coalesced idle/safe", STRM_EV_STRM_PROC|STRM_EV_CS_ST, s);
+				reuse = 1;
+			}
+		}
 	}
 
 
@@ -1777,7 +1885,7 @@ static int connect_server(struct stream *s)
 			if (srv && reuse_mode == PR_O_REUSE_ALWS &&
 			    !(srv_conn->flags & CO_FL_PRIVATE) &&
 			    srv_conn->mux->avail_streams(srv_conn) > 0) {
-				eb64_insert(&srv->per_thr[tid].avail_conns, &srv_conn->hash_node->node);
+				eb64_insert(srv_avail_conns(srv), &srv_conn->hash_node->node);
 			}
 			else if (srv_conn->flags & CO_FL_PRIVATE ||
 			         (reuse_mode == PR_O_REUSE_SAFE &&
@@ -1804,8 +1912,17 @@ static int connect_server(struct stream *s)
 		srv_conn->flags &= ~(CO_FL_SSL_WAIT_HS | CO_FL_WAIT_L6_CONN);
 #endif
 
-	/* set connect timeout */
+	/* set connect timeout. As long as another attempt remains possible, a
+	 * shorter one may be used so that a slow server or network path is
+	 * quickly abandoned in favor of a retry, possibly on another server.
+	 */
 	s->conn_exp = tick_add_ifset(now_ms, s->be->timeout.connect);
+	if (tick_isset(s->be->timeout.connretry) &&
+	    s->conn_retries < s->be->conn_retries &&
+	    (s->be->retry_type & PR_RE_CONN_FAILED) &&
+	    (!tick_isset(s->conn_exp) ||
+	     tick_is_lt(tick_add(now_ms, s->be->timeout.connretry), s->conn_exp)))
+		s->conn_exp = tick_add(now_ms, s->be->timeout.connretry);
 
 	if (srv) {
 		int count;
@@ -2603,6 +2720,8 @@ const char *backend_lb_algo_str(int algo) {
 		return "first";
 	else if (algo == BE_LB_ALGO_LC)
 		return "leastconn";
+	else if (algo == BE_LB_ALGO_EWMA)
+		return "ewma";
 	else if (algo == BE_LB_ALGO_SH)
 		return "source";
 	else if (algo == BE_LB_ALGO_UH)
@@ -2652,29 +2771,42 @@ int backend_parse_balance(const char **args, char **err, struct proxy *curproxy)
 	else if (strcmp(args[0], "leastconn") == 0) {
 		curproxy->lbprm.algo &= ~BE_LB_ALGO;
 		curproxy->lbprm.algo |= BE_LB_ALGO_LC;
+		curproxy->lbprm.arg_opt1 = 0; // "lazy"
+
+		if (*args[1]) {
+			if (strcmp(args[1], "lazy") != 0) {
+				memprintf(err, "%s only accepts 'lazy' as argument (got '%s').", args[0], args[1]);
+				return -1;
+			}
+			curproxy->lbprm.arg_opt1 = 1;
+		}
 	}
-	else if (!strncmp(args[0], "random", 6)) {
+	else if (!strncmp(args[0], "random", 6) || !strncmp(args[0], "ewma", 4)) {
+		/* both take an optional number of draws */
+		const char *name = (*args[0] == 'r') ? "random" : "ewma";
+		size_t len = strlen(name);
+
 		curproxy->lbprm.algo &= ~BE_LB_ALGO;
-		curproxy->lbprm.algo |= BE_LB_ALGO_RND;
+		curproxy->lbprm.algo |= (*args[0] == 'r') ? BE_LB_ALGO_RND : BE_LB_ALGO_EWMA;
 		curproxy->lbprm.arg_opt1 = 2;
 
-		if (*(args[0] + 6) == '(' && *(args[0] + 7) != ')') { /* number of draws */
+		if (*(args[0] + len) == '(' && *(args[0] + len + 1) != ')') { /* number of draws */
 			const char *beg;
 			char *end;
 
-			beg = args[0] + 7;
+			beg = args[0] + len + 1;
 			curproxy->lbprm.arg_opt1 = strtol(beg, &end, 0);
 
 			if (*end != ')') {
 				if (!*end)
-					memprintf(err, "random : missing closing parenthesis.");
+					memprintf(err, "%s : missing closing parenthesis.", name);
 				else
-					memprintf(err, "random : unexpected character '%c' after argument.", *end);
+					memprintf(err, "%s : unexpected character '%c' after argument.", name, *end);
 				return -1;
 			}
 
 			if (curproxy->lbprm.arg_opt1 < 1) {
-				memprintf(err, "random : number of draws must be at least 1.");
+				memprintf(err, "%s : number of draws must be at least 1.", name);
 				return -1;
 			}
 		}
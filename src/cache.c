@@ -10,7 +10,14 @@
  * 2 of the License, or (at your option) any later version.
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <import/eb32tree.h>
+#include <import/eb64tree.h>
 #include <import/sha1.h>
 
 #include <haproxy/action-t.h>
@@ -27,6 +34,7 @@
 #include <haproxy/http_htx.h>
 #include <haproxy/http_rules.h>
 #include <haproxy/htx.h>
+#include <haproxy/log.h>
 #include <haproxy/net_helper.h>
 #include <haproxy/proxy.h>
 #include <haproxy/sample.h>
@@ -35,10 +43,14 @@
 #include <haproxy/stconn.h>
 #include <haproxy/stream.h>
 #include <haproxy/tools.h>
+#include <haproxy/usdt.h>
+#include <haproxy/xxhash.h>
 
 #define CACHE_FLT_F_IMPLICIT_DECL  0x00000001 /* The cache filtre was implicitly declared (ie without
 					       * the filter keyword) */
 #define CACHE_FLT_INIT             0x00000002 /* Whether the cache name was freed. */
+#define CACHE_FLT_F_COMPRESSED     0x00000004 /* The compression filter is evaluated before the cache,
+					       * compressed responses are stored. */
 
 const char *cache_store_flt_id = "cache store filter";
 
@@ -46,7 +58,23 @@ extern struct applet http_cache_applet;
 
 struct flt_ops cache_ops;
 
+/* Header of a cache whose shctx is stored in a file. It is located at the
+ * beginning of the struct cache so that another process may check that it
+ * uses the same layout before importing the objects.
+ */
+struct cache_file_hdr {
+	unsigned int magic;       /* CACHE_FILE_MAGIC once the file is usable */
+	unsigned int version;     /* CACHE_FILE_VERSION */
+	unsigned int shctx_size;  /* sizeof(struct shared_context) */
+	unsigned int block_size;  /* sizeof(struct shared_block) */
+	unsigned int cache_size;  /* sizeof(struct cache) */
+	unsigned int entry_size;  /* sizeof(struct cache_entry) */
+	unsigned int maxblocks;   /* number of blocks in the shctx */
+	const void *base;         /* address of the shctx in the process owning the file */
+};
+
 struct cache {
+	struct cache_file_hdr hdr; /* only used when the cache is stored in a file */
 	struct list list;        /* cache linked list */
 	struct eb_root entries;  /* head of cache entries based on keys */
 	unsigned int maxage;     /* max-age */
@@ -54,9 +82,97 @@ struct cache {
 	unsigned int maxobjsz;   /* max-object-size (in bytes) */
 	unsigned int max_secondary_entries;  /* maximum number of secondary entries with the same primary hash */
 	uint8_t vary_processing_enabled;     /* boolean : manage Vary header (disabled by default) */
+	struct cache_storage *storage;       /* optional second tier storage, NULL if none */
+	char *file;              /* optional file storing the shctx, NULL if none */
+	unsigned int collapse_timeout;       /* max time to wait for a pending miss (ms), 0 = no collapsed forwarding */
+	struct eb_root pendings; /* pending misses, based on keys */
+	struct list pass_list;   /* pending misses in pass mode, from the oldest to the newest */
+	unsigned int nb_shards;  /* number of shards, 1 if not sharded */
+	unsigned int shard_id;   /* index of this shard in <shards> */
+	struct cache **shards;   /* all the shards of the cache, NULL if not sharded */
+	char *tag_hdr;           /* response header holding the purge tags, NULL if none */
+	unsigned int index_prefixes; /* number of path prefixes indexed for purges, 0 = none */
+	struct eb_root index;    /* purge keys of the objects (cache_index_key), dups allowed */
 	char id[33];             /* cache name */
 };
 
+/* Second tier storage of a cache. Objects evicted from the shared memory are
+ * demoted to a file mapped in memory, which is written as a circular log, and
+ * they are promoted back to the shared memory when they are requested again.
+ * The index and the file are only accessed under the cache's shctx lock.
+ */
+struct cache_storage {
+	char *path;               /* path to the storage file */
+	int fd;                   /* fd of the storage file, -1 if not opened */
+	unsigned char *area;      /* mapping of the storage file */
+	size_t size;              /* size of the storage file, in bytes */
+	size_t tail;              /* offset where the next object will be written */
+	struct eb_root entries;   /* index of the stored objects, based on keys */
+	struct list fifo;         /* stored objects, from the oldest to the newest */
+	struct cache_storage_entry *promoting; /* object being promoted, must not be overwritten */
+	unsigned int nb_entries;  /* number of stored objects */
+	size_t used;              /* number of bytes used by the stored objects */
+	unsigned long long demoted;  /* number of objects demoted from the shared memory */
+	unsigned long long promoted; /* number of objects promoted to the shared memory */
+};
+
+/* An object stored in the second tier. The object itself is a copy of the
+ * whole row of blocks, starting with its struct cache_entry.
+ */
+struct cache_storage_entry {
+	struct eb32_node eb;      /* ebtree node used to hold the object, same key as in the cache */
+	struct list list;         /* element of the storage's fifo list */
+	char hash[20];
+	char secondary_key[HTTP_CACHE_SEC_KEY_LEN];
+	unsigned int secondary_key_signature;
+	unsigned int expire;      /* expiration date */
+	size_t offset;            /* offset of the object in the storage file */
+	unsigned int len;         /* length of the object, struct cache_entry included */
+	struct cache_index *index; /* purge index of the object, NULL if none */
+};
+
+/* One of the keys an object is indexed with for purges */
+struct cache_index_key {
+	struct eb64_node node;    /* ebtree node in the cache's index */
+	struct cache_index *idx;  /* index this key belongs to */
+};
+
+/* The purge index of an object, which is either in the shared memory or in the
+ * second tier storage. It is only accessed under the cache's shctx lock.
+ */
+struct cache_index {
+	struct cache_entry *entry;       /* object in the shared memory, or NULL */
+	struct cache_storage_entry *se;  /* object in the storage, or NULL */
+	unsigned int count;              /* number of keys */
+	struct cache_index_key keys[VAR_ARRAY];
+};
+
+/* Something waiting for a pending miss: a stream waiting for the response to
+ * be stored, or a cache applet waiting for more data of the stored response.
+ */
+struct cache_waiter {
+	struct list list;         /* element of the pending miss's waiters list */
+	struct task *task;        /* task to wake up */
+};
+
+/* A cache miss being forwarded to the server. With collapsed forwarding, the
+ * next requests for the same object wait for its response instead of being
+ * forwarded too. Once the owner has decided not to store the response, the
+ * pending miss is kept in pass mode (no owner) for a while so that the next
+ * requests are directly forwarded. Pending misses are only accessed under the
+ * cache's shctx lock.
+ */
+struct cache_pending {
+	struct eb32_node eb;      /* ebtree node used to hold the pending miss, same key as in the cache */
+	struct list list;         /* element of the cache's pass_list in pass mode */
+	char hash[20];
+	struct stream *owner;     /* stream forwarding the request, NULL in pass mode */
+	struct cache_entry *entry; /* entry storing the response, NULL until the response is stored */
+	unsigned int len;         /* length of the entry's row which may already be delivered */
+	struct list waiters;      /* streams and applets to wake up (cache_waiter) */
+	unsigned int expire;      /* expiration date of the pass mode, in ticks */
+};
+
 /* the appctx context of a cache applet, stored in appctx->svcctx */
 struct cache_appctx {
 	struct cache_entry *entry;       /* Entry to be sent from cache. */
@@ -64,8 +180,15 @@ struct cache_appctx {
 	unsigned int offset;             /* start offset of remaining data relative to beginning of the next block */
 	unsigned int rem_data;           /* Remaining bytes for the last data block (HTX only, 0 means process next block) */
 	unsigned int send_notmodified:1; /* In case of conditional request, we might want to send a "304 Not Modified" response instead of the stored data. */
-	unsigned int unused:31;
+	unsigned int streaming:1;        /* The entry is still being stored, <avail> may grow. */
+	unsigned int range:1;            /* Only a byte range of the payload is sent in a "206 Partial Content" response. */
+	unsigned int unsatisfiable:1;    /* The range is out of the payload, a "416 Range Not Satisfiable" response is sent instead. */
+	unsigned int unused:28;
+	unsigned int avail;              /* Length of the entry's row which may be sent. */
+	unsigned int range_start;        /* Offset of the first byte of the range in the payload. */
+	unsigned int range_len;          /* Remaining number of bytes of the range to send. */
 	struct shared_block *next;       /* The next block of data to be sent for this cache entry. */
+	struct cache_waiter waiter;      /* To wait for more data of the entry in streaming mode. */
 };
 
 /* cache config for filters */
@@ -77,6 +200,12 @@ struct cache_flt_conf {
 	unsigned int flags;   /* CACHE_FLT_F_* */
 };
 
+/* types of purges of the "cache-purge" action */
+enum cache_purge_type {
+	CACHE_PURGE_TAG = 0,     /* objects with one of the tags */
+	CACHE_PURGE_PREFIX,      /* objects under a path prefix */
+};
+
 /* CLI context used during "show cache" */
 struct show_cache_ctx {
 	struct cache *cache;
@@ -148,10 +277,24 @@ const struct vary_hashing_information vary_information[] = {
  */
 struct cache_st {
 	struct shared_block *first_block;
+	struct cache_waiter waiter; /* to wait for a pending miss (collapsed forwarding) */
+	unsigned int wait_exp;      /* date after which the pending miss is not waited anymore */
+	unsigned int flags;         /* CACHE_ST_F_* */
+	int maxage;                 /* effective max age of the entry, until its headers are stored */
 };
 
+#define CACHE_ST_F_COMPRESSED  0x00000001 /* The response is compressed, its headers are stored
+					   * once updated by the compression filter */
+
 #define DEFAULT_MAX_SECONDARY_ENTRY 10
 
+/* Maximum number of purge keys of an object, path prefixes and tags included.
+ * The keys of tags and path prefixes are hashed with distinct seeds.
+ */
+#define CACHE_INDEX_MAX_KEYS     32
+#define CACHE_INDEX_TAG_SEED     0x54414753 /* "TAGS" */
+#define CACHE_INDEX_PREFIX_SEED  0x50524658 /* "PRFX" */
+
 struct cache_entry {
 	unsigned int complete;    /* An entry won't be valid until complete is not null. */
 	unsigned int latest_validation;     /* latest validation date */
@@ -170,6 +313,12 @@ struct cache_entry {
 	unsigned int etag_length; /* Length of the ETag value (if one was found in the response). */
 	unsigned int etag_offset; /* Offset of the ETag value in the data buffer. */
 
+	unsigned int body_len;    /* Length of the payload, only final once complete. */
+
+	struct cache_index *index;     /* purge index, NULL if none. Not valid in a copy. */
+	unsigned int nb_index_keys;    /* number of purge keys */
+	uint64_t index_keys[CACHE_INDEX_MAX_KEYS]; /* purge keys (path prefixes and tags) */
+
 	time_t last_modified; /* Origin server "Last-Modified" header value converted in
 			       * seconds since epoch. If no "Last-Modified"
 			       * header is found, use "Date" header value,
@@ -181,16 +330,26 @@ struct cache_entry {
 };
 
 #define CACHE_BLOCKSIZE 1024
+#define CACHE_MAX_SHARDS 64
 #define CACHE_ENTRY_MAX_AGE 2147483648U
 
+/* The version must be bumped on any change of the layout of the structures
+ * stored in a cache file. Changes of their sizes are detected anyway.
+ */
+#define CACHE_FILE_MAGIC   0x48434631 /* "HCF1" */
+#define CACHE_FILE_VERSION 3
+
 static struct list caches = LIST_HEAD_INIT(caches);
 static struct list caches_config = LIST_HEAD_INIT(caches_config); /* cache config to init */
 static struct cache *tmp_cache_config = NULL;
 
 DECLARE_STATIC_POOL(pool_head_cache_st, "cache_st", sizeof(struct cache_st));
+DECLARE_STATIC_POOL(pool_head_cache_storage_entry, "cache_storage_entry", sizeof(struct cache_storage_entry));
+DECLARE_STATIC_POOL(pool_head_cache_pending, "cache_pending", sizeof(struct cache_pending));
 
 static struct eb32_node *insert_entry(struct cache *cache, struct cache_entry *new_entry);
 static void delete_entry(struct cache_entry *del_entry);
+static int cache_store_headers(struct cache *cache, struct htx *htx, struct shared_block *first);
 
 struct cache_entry *entry_exist(struct cache *cache, char *hash)
 {
@@ -423,6 +582,18 @@ static void delete_entry(struct cache_entry *del_entry)
 }
 
 
+/* Returns the shard of <cache> in charge of the objects of primary key <hash>.
+ * Each shard is a complete cache with its own shctx, thus its own lock, block
+ * allocator and LRU list, so that the objects of distinct shards may be
+ * accessed in parallel.
+ */
+static inline struct cache *cache_shard(struct cache *cache, const char *hash)
+{
+	if (cache->nb_shards <= 1)
+		return cache;
+	return cache->shards[read_u32(hash + 16) % cache->nb_shards];
+}
+
 static inline struct shared_context *shctx_ptr(struct cache *cache)
 {
 	return (struct shared_context *)((unsigned char *)cache - ((struct shared_context *)NULL)->data);
@@ -434,6 +605,405 @@ static inline struct shared_block *block_ptr(struct cache_entry *entry)
 }
 
 
+/*
+ * Purge index functions. All of them must be called with the shctx lock held.
+ */
+
+/* Indexes in <cache> the object <entry> or <se> with the <count> purge keys
+ * <keys>, which must be unique. Returns the new index or NULL on memory
+ * allocation failure.
+ */
+static struct cache_index *cache_index_new(struct cache *cache, const uint64_t *keys, unsigned int count,
+                                           struct cache_entry *entry, struct cache_storage_entry *se)
+{
+	struct cache_index *idx;
+	unsigned int i;
+
+	idx = malloc(sizeof(*idx) + count * sizeof(*idx->keys));
+	if (!idx)
+		return NULL;
+
+	idx->entry = entry;
+	idx->se = se;
+	idx->count = count;
+	for (i = 0; i < count; i++) {
+		idx->keys[i].node.key = keys[i];
+		idx->keys[i].idx = idx;
+		eb64_insert(&cache->index, &idx->keys[i].node);
+	}
+	return idx;
+}
+
+/* Removes the keys of index <idx> from their cache and releases it */
+static void cache_index_free(struct cache_index *idx)
+{
+	unsigned int i;
+
+	for (i = 0; i < idx->count; i++)
+		eb64_delete(&idx->keys[i].node);
+	free(idx);
+}
+
+/* Indexes the object <entry> of <cache> with its purge keys, if any. Returns 0
+ * on success or -1 on memory allocation failure, in which case the object must
+ * not be delivered anymore since it could not be purged.
+ */
+static int cache_index_attach(struct cache *cache, struct cache_entry *entry)
+{
+	entry->index = NULL;
+	if (!entry->nb_index_keys)
+		return 0;
+
+	entry->index = cache_index_new(cache, entry->index_keys, entry->nb_index_keys, entry, NULL);
+	return entry->index ? 0 : -1;
+}
+
+/*
+ * Second tier storage functions. All of them must be called with the shctx
+ * lock held.
+ */
+
+/* Removes the object <se> from the storage <st> */
+static void cache_storage_evict(struct cache_storage *st, struct cache_storage_entry *se)
+{
+	eb32_delete(&se->eb);
+	LIST_DELETE(&se->list);
+	if (se->index)
+		cache_index_free(se->index);
+	st->nb_entries--;
+	st->used -= se->len;
+	pool_free(pool_head_cache_storage_entry, se);
+}
+
+/* Removes from the storage <st> the objects with the primary key <hash>. If
+ * <secondary_key> is not NULL, only the object with this exact secondary key
+ * is removed.
+ */
+static void cache_storage_remove(struct cache_storage *st, const char *hash, const char *secondary_key)
+{
+	struct eb32_node *node, *next;
+	struct cache_storage_entry *se;
+
+	for (node = eb32_lookup(&st->entries, read_u32(hash)); node; node = next) {
+		next = eb32_next_dup(node);
+		se = eb32_entry(node, struct cache_storage_entry, eb);
+		if (se == st->promoting || memcmp(se->hash, hash, sizeof(se->hash)) != 0)
+			continue;
+		if (secondary_key && memcmp(se->secondary_key, secondary_key, HTTP_CACHE_SEC_KEY_LEN) != 0)
+			continue;
+		cache_storage_evict(st, se);
+	}
+}
+
+/* Copies the object starting at block <first>, which is being evicted from the
+ * shared memory of <cache>, to the cache's storage. The blocks of the row are
+ * still intact at this stage and follow each other in the avail list. The
+ * oldest stored objects are overwritten when the storage is full. Nothing is
+ * done for incomplete or expired objects.
+ */
+static void cache_storage_demote(struct cache *cache, struct shared_block *first)
+{
+	struct cache_storage *st = cache->storage;
+	struct shared_context *shctx = shctx_ptr(cache);
+	struct cache_entry *object = (struct cache_entry *)first->data;
+	struct cache_storage_entry *se, *old;
+	struct shared_block *block;
+	unsigned char *ptr;
+	unsigned int len = first->len;
+	unsigned int rem, max;
+	size_t offset;
+
+	if (!object->complete || object->expire <= now.tv_sec || len > st->size)
+		return;
+
+	/* the oldest objects are at the beginning of the fifo list. When the
+	 * object does not fit at the end of the file, we restart from the
+	 * beginning so all the objects stored after the current position are
+	 * lost. Then all objects overlapping the new one are lost too.
+	 */
+	offset = st->tail;
+	if (offset + len > st->size) {
+		while (!LIST_ISEMPTY(&st->fifo)) {
+			old = LIST_NEXT(&st->fifo, struct cache_storage_entry *, list);
+			if (old->offset < offset)
+				break;
+			if (old == st->promoting)
+				return;
+			cache_storage_evict(st, old);
+		}
+		offset = 0;
+	}
+
+	while (!LIST_ISEMPTY(&st->fifo)) {
+		old = LIST_NEXT(&st->fifo, struct cache_storage_entry *, list);
+		if (old->offset < offset || old->offset >= offset + len)
+			break;
+		if (old == st->promoting)
+			return;
+		cache_storage_evict(st, old);
+	}
+
+	se = pool_alloc(pool_head_cache_storage_entry);
+	if (!se)
+		return;
+
+	/* a previous version of this object must not be promoted anymore */
+	cache_storage_remove(st, object->hash, object->secondary_key);
+
+	ptr = st->area + offset;
+	block = first;
+	rem = len;
+	while (1) {
+		max = MIN(rem, shctx->block_size);
+		memcpy(ptr, block->data, max);
+		ptr += max;
+		rem -= max;
+		if (!rem)
+			break;
+		block = LIST_NEXT(&block->list, struct shared_block *, list);
+	}
+
+	se->eb.key = object->eb.key;
+	memcpy(se->hash, object->hash, sizeof(se->hash));
+	memcpy(se->secondary_key, object->secondary_key, HTTP_CACHE_SEC_KEY_LEN);
+	se->secondary_key_signature = object->secondary_key_signature;
+	se->expire = object->expire;
+	se->offset = offset;
+	se->len = len;
+	se->index = NULL;
+	if (object->nb_index_keys) {
+		/* the stored object must remain purgeable */
+		se->index = cache_index_new(cache, object->index_keys, object->nb_index_keys, NULL, se);
+		if (!se->index) {
+			pool_free(pool_head_cache_storage_entry, se);
+			return;
+		}
+	}
+	eb32_insert(&st->entries, &se->eb);
+	LIST_APPEND(&st->fifo, &se->list);
+
+	st->tail = offset + ((len + sizeof(void *) - 1) & -sizeof(void *));
+	st->nb_entries++;
+	st->used += len;
+	st->demoted++;
+}
+
+/* Looks up in the storage of <cache> the object corresponding to the request
+ * of stream <s> and moves it back to the cache's shared memory. On success,
+ * the new cache entry is returned with its row in the hot list, exactly as if
+ * shctx_row_inc_hot() was called on it. NULL is returned otherwise. Unlike
+ * the functions above, this one takes the shctx lock itself.
+ */
+static struct cache_entry *cache_storage_promote(struct cache *cache, struct stream *s)
+{
+	struct cache_storage *st = cache->storage;
+	struct shared_context *shctx = shctx_ptr(cache);
+	struct http_txn *txn = s->txn;
+	struct cache_storage_entry *se = NULL;
+	struct cache_entry *object = NULL;
+	struct shared_block *first;
+	struct eb32_node *node, *next;
+	unsigned int signature = 0;
+
+	shctx_lock(shctx);
+	for (node = eb32_lookup(&st->entries, read_u32(txn->cache_hash)); node; node = next) {
+		next = eb32_next_dup(node);
+		se = eb32_entry(node, struct cache_storage_entry, eb);
+
+		if (memcmp(se->hash, txn->cache_hash, sizeof(se->hash)) != 0)
+			goto next;
+
+		if (se->expire <= now.tv_sec) {
+			cache_storage_evict(st, se);
+			goto next;
+		}
+
+		if (!se->secondary_key_signature)
+			break;
+
+		/* the secondary key of the request depends on the headers the
+		 * stored object varies on.
+		 */
+		if (se->secondary_key_signature != signature) {
+			signature = se->secondary_key_signature;
+			if (http_request_build_secondary_key(s, signature)) {
+				signature = 0;
+				goto next;
+			}
+		}
+
+		if (secondary_key_cmp(se->secondary_key, txn->cache_secondary_hash) == 0)
+			break;
+	  next:
+		se = NULL;
+	}
+
+	if (!se)
+		goto out;
+
+	/* reserving blocks may demote other objects, which must not overwrite
+	 * this one.
+	 */
+	st->promoting = se;
+	first = shctx_row_reserve_hot(shctx, NULL, se->len);
+	st->promoting = NULL;
+	if (!first)
+		goto out;
+
+	first->len = 0;
+	first->last_append = NULL;
+	if (shctx_row_data_append(shctx, first, NULL, st->area + se->offset, se->len) < 0) {
+		first->len = 0;
+		shctx_row_dec_hot(shctx, first);
+		goto out;
+	}
+
+	object = (struct cache_entry *)first->data;
+	object->index = NULL;
+	cache_storage_evict(st, se);
+	if (insert_entry(cache, object) != &object->eb ||
+	    cache_index_attach(cache, object) < 0) {
+		if (object->eb.key)
+			delete_entry(object);
+		first->len = 0;
+		object->eb.key = 0;
+		shctx_row_dec_hot(shctx, first);
+		object = NULL;
+		goto out;
+	}
+	st->promoted++;
+
+  out:
+	shctx_unlock(shctx);
+	return object;
+}
+
+/* Releases the pending miss <pending>. Must be called under the shctx lock. */
+static void cache_pending_free(struct cache_pending *pending)
+{
+	eb32_delete(&pending->eb);
+	LIST_DEL_INIT(&pending->list);
+	pool_free(pool_head_cache_pending, pending);
+}
+
+/* Looks up the pending miss of <cache> for the object of key <hash>. Pass mode
+ * pending misses are released once expired. Returns NULL if not found. Must be
+ * called under the shctx lock.
+ */
+static struct cache_pending *cache_pending_lookup(struct cache *cache, const char *hash)
+{
+	struct eb32_node *node;
+	struct cache_pending *pending;
+
+	node = eb32_lookup(&cache->pendings, read_u32(hash));
+	for (; node; node = eb32_next_dup(node)) {
+		pending = eb32_entry(node, struct cache_pending, eb);
+		if (memcmp(pending->hash, hash, sizeof(pending->hash)) != 0)
+			continue;
+		if (!pending->owner && tick_is_expired(pending->expire, now_ms)) {
+			cache_pending_free(pending);
+			return NULL;
+		}
+		return pending;
+	}
+	return NULL;
+}
+
+/* Creates a pending miss in <cache> for the object requested by stream <s>,
+ * which becomes its owner. Returns NULL on allocation failure. Must be called
+ * under the shctx lock.
+ */
+static struct cache_pending *cache_pending_new(struct cache *cache, struct stream *s)
+{
+	struct cache_pending *pending;
+
+	/* first purge the pass mode pending misses which expired */
+	while (!LIST_ISEMPTY(&cache->pass_list)) {
+		pending = LIST_NEXT(&cache->pass_list, struct cache_pending *, list);
+		if (!tick_is_expired(pending->expire, now_ms))
+			break;
+		cache_pending_free(pending);
+	}
+
+	pending = pool_alloc(pool_head_cache_pending);
+	if (!pending)
+		return NULL;
+
+	memcpy(pending->hash, s->txn->cache_hash, sizeof(pending->hash));
+	pending->eb.key = read_u32(pending->hash);
+	LIST_INIT(&pending->list);
+	LIST_INIT(&pending->waiters);
+	pending->owner = s;
+	pending->entry = NULL;
+	pending->len = 0;
+	pending->expire = TICK_ETERNITY;
+	eb32_insert(&cache->pendings, &pending->eb);
+	return pending;
+}
+
+/* Wakes up all the waiters of <pending>. They are removed from its list and
+ * must register again if they still need to wait. Must be called under the
+ * shctx lock.
+ */
+static void cache_pending_wakeup(struct cache_pending *pending)
+{
+	struct cache_waiter *waiter, *back;
+
+	list_for_each_entry_safe(waiter, back, &pending->waiters, list) {
+		LIST_DEL_INIT(&waiter->list);
+		task_wakeup(waiter->task, TASK_WOKEN_MSG);
+	}
+}
+
+/* Releases the pending miss of <cache> owned by stream <s>, if any, and wakes
+ * up its waiters. If the response is being stored, nothing is done unless
+ * <abort> is set, in which case the applets streaming it will abort. If the
+ * response was not stored, the pending miss is kept in pass mode when requests
+ * waited for it, so that the next ones do not wait in vain. Must be called
+ * under the shctx lock.
+ */
+static void cache_pending_release(struct cache *cache, struct stream *s, int abort)
+{
+	struct cache_pending *pending;
+
+	pending = cache_pending_lookup(cache, s->txn->cache_hash);
+	if (!pending || pending->owner != s || (pending->entry && !abort))
+		return;
+
+	if (!pending->entry && !LIST_ISEMPTY(&pending->waiters)) {
+		cache_pending_wakeup(pending);
+		pending->owner = NULL;
+		pending->expire = tick_add(now_ms, MS_TO_TICKS(MIN(cache->maxage, 86400U) * 1000));
+		LIST_APPEND(&cache->pass_list, &pending->list);
+		return;
+	}
+
+	cache_pending_wakeup(pending);
+	cache_pending_free(pending);
+}
+
+/* Publishes that the row of <first> currently stored by stream <s> for its
+ * pending miss in <cache> may be delivered, and wakes up the waiters. A pass
+ * mode pending miss for the same object is not needed anymore.
+ */
+static void cache_pending_publish(struct cache *cache, struct stream *s, struct shared_block *first)
+{
+	struct shared_context *shctx = shctx_ptr(cache);
+	struct cache_pending *pending;
+
+	shctx_lock(shctx);
+	pending = cache_pending_lookup(cache, s->txn->cache_hash);
+	if (pending && pending->owner == s) {
+		pending->entry = (struct cache_entry *)first->data;
+		pending->len = first->len;
+		cache_pending_wakeup(pending);
+	}
+	else if (pending && !pending->owner)
+		cache_pending_free(pending);
+	shctx_unlock(shctx);
+}
+
+
 
 static int
 cache_store_init(struct proxy *px, struct flt_conf *fconf)
@@ -484,11 +1054,18 @@ cache_store_check(struct proxy *px, struct flt_conf *fconf)
 	 * be explicitly declaired or not. */
 	list_for_each_entry(f, &px->filter_configs, list) {
 		if (f == fconf) {
-			/* The compression filter must be evaluated after the cache. */
+			/* The compression filter must be evaluated after the
+			 * cache, unless the compressed responses are stored,
+			 * which requires the Vary processing to tell the
+			 * encodings apart. */
 			if (comp) {
-				ha_alert("config: %s '%s': unable to enable the compression filter before "
-					 "the cache '%s'.\n", proxy_type_str(px), px->id, cache->id);
-				return 1;
+				if (!cache->vary_processing_enabled) {
+					ha_alert("config: %s '%s': unable to enable the compression filter before "
+						 "the cache '%s' without \"process-vary on\".\n",
+						 proxy_type_str(px), px->id, cache->id);
+					return 1;
+				}
+				cconf->flags |= CACHE_FLT_F_COMPRESSED;
 			}
 		}
 		else if (f->id == http_comp_flt_id)
@@ -518,6 +1095,10 @@ cache_store_strm_init(struct stream *s, struct filter *filter)
 		return -1;
 
 	st->first_block = NULL;
+	LIST_INIT(&st->waiter.list);
+	st->wait_exp    = TICK_ETERNITY;
+	st->flags       = 0;
+	st->maxage      = 0;
 	filter->ctx     = st;
 
 	/* Register post-analyzer on AN_RES_WAIT_HTTP */
@@ -531,7 +1112,11 @@ cache_store_strm_deinit(struct stream *s, struct filter *filter)
 	struct cache_st *st = filter->ctx;
 	struct cache_flt_conf *cconf = FLT_CONF(filter);
 	struct cache *cache = cconf->c.cache;
-	struct shared_context *shctx = shctx_ptr(cache);
+	struct shared_context *shctx;
+
+	if (s->txn)
+		cache = cache_shard(cache, s->txn->cache_hash);
+	shctx = shctx_ptr(cache);
 
 	/* Everything should be released in the http_end filter, but we need to do it
 	 * there too, in case of errors */
@@ -540,6 +1125,18 @@ cache_store_strm_deinit(struct stream *s, struct filter *filter)
 		shctx_row_dec_hot(shctx, st->first_block);
 		shctx_unlock(shctx);
 	}
+	/* Only this stream may register its waiter, which is unlinked under
+	 * the lock by the pending miss's owner when waking it up.
+	 */
+	if ((st && LIST_INLIST(&st->waiter.list)) ||
+	    (s->txn && (s->txn->flags & TX_CACHE_PENDING))) {
+		shctx_lock(shctx);
+		if (st)
+			LIST_DEL_INIT(&st->waiter.list);
+		if (s->txn && (s->txn->flags & TX_CACHE_PENDING))
+			cache_pending_release(cache, s, 1);
+		shctx_unlock(shctx);
+	}
 	if (st) {
 		pool_free(pool_head_cache_st, st);
 		filter->ctx = NULL;
@@ -553,41 +1150,35 @@ cache_store_post_analyze(struct stream *s, struct filter *filter, struct channel
 	struct http_txn *txn = s->txn;
 	struct http_msg *msg = &txn->rsp;
 	struct cache_st *st = filter->ctx;
+	struct cache_flt_conf *cconf = FLT_CONF(filter);
 
 	if (an_bit != AN_RES_WAIT_HTTP)
 		goto end;
 
 	/* Here we need to check if any compression filter precedes the cache
-	 * filter. This is only possible when the compression is configured in
-	 * the frontend while the cache filter is configured on the
-	 * backend. This case cannot be detected during HAProxy startup. So in
-	 * such cases, the cache is disabled.
+	 * filter. Unless it was explicitly declared before the cache to store
+	 * the compressed responses, this is only possible when the compression
+	 * is configured in the frontend while the cache filter is configured
+	 * on the backend. This case cannot be detected during HAProxy
+	 * startup. So in such cases, the cache is disabled.
 	 */
 	if (st && (msg->flags & HTTP_MSGF_COMPRESSING)) {
-		pool_free(pool_head_cache_st, st);
-		filter->ctx = NULL;
+		if (cconf->flags & CACHE_FLT_F_COMPRESSED)
+			st->flags |= CACHE_ST_F_COMPRESSED;
+		else {
+			pool_free(pool_head_cache_st, st);
+			filter->ctx = NULL;
+		}
 	}
 
   end:
 	return 1;
 }
 
-static int
-cache_store_http_headers(struct stream *s, struct filter *filter, struct http_msg *msg)
-{
-	struct cache_st *st = filter->ctx;
-
-	if (!(msg->chn->flags & CF_ISRESP) || !st)
-		return 1;
-
-	if (st->first_block)
-		register_data_filter(s, msg->chn, filter);
-	return 1;
-}
-
-static inline void disable_cache_entry(struct cache_st *st,
+static inline void disable_cache_entry(struct stream *s, struct cache_st *st,
                                        struct filter *filter, struct shared_context *shctx)
 {
+	struct cache_flt_conf *cconf = FLT_CONF(filter);
 	struct cache_entry *object;
 
 	object = (struct cache_entry *)st->first_block->data;
@@ -596,22 +1187,70 @@ static inline void disable_cache_entry(struct cache_st *st,
 	shctx_row_dec_hot(shctx, st->first_block);
 	eb32_delete(&object->eb);
 	object->eb.key = 0;
+	if (s->txn->flags & TX_CACHE_PENDING)
+		cache_pending_release(cache_shard(cconf->c.cache, s->txn->cache_hash), s, 1);
 	shctx_unlock(shctx);
 	pool_free(pool_head_cache_st, st);
 }
 
+static int
+cache_store_http_headers(struct stream *s, struct filter *filter, struct http_msg *msg)
+{
+	struct cache_st *st = filter->ctx;
+	struct cache_flt_conf *cconf = FLT_CONF(filter);
+	struct cache *cache = cache_shard(cconf->c.cache, s->txn->cache_hash);
+
+	if (!(msg->chn->flags & CF_ISRESP))
+		return 1;
+
+	/* The headers of a compressed response are stored now that they were
+	 * updated by the compression filter.
+	 */
+	if (st && st->first_block && (st->flags & CACHE_ST_F_COMPRESSED)) {
+		struct cache_entry *object = (struct cache_entry *)st->first_block->data;
+
+		if (cache_store_headers(cache, htxbuf(&msg->chn->buf), st->first_block) < 0) {
+			disable_cache_entry(s, st, filter, shctx_ptr(cache));
+			st = NULL;
+		}
+		else {
+			object->latest_validation = now.tv_sec;
+			object->expire = now.tv_sec + st->maxage;
+			if (cache->collapse_timeout)
+				cache_pending_publish(cache, s, st->first_block);
+		}
+	}
+
+	/* The response was not stored, the requests waiting for it must be
+	 * forwarded.
+	 */
+	if (s->txn->flags & TX_CACHE_PENDING) {
+		shctx_lock(shctx_ptr(cache));
+		cache_pending_release(cache, s, 0);
+		shctx_unlock(shctx_ptr(cache));
+	}
+
+	if (!st)
+		return 1;
+
+	if (st->first_block)
+		register_data_filter(s, msg->chn, filter);
+	return 1;
+}
+
 static int
 cache_store_http_payload(struct stream *s, struct filter *filter, struct http_msg *msg,
 			 unsigned int offset, unsigned int len)
 {
 	struct cache_flt_conf *cconf = FLT_CONF(filter);
-	struct shared_context *shctx = shctx_ptr(cconf->c.cache);
+	struct cache *cache = cache_shard(cconf->c.cache, s->txn->cache_hash);
+	struct shared_context *shctx = shctx_ptr(cache);
 	struct cache_st *st = filter->ctx;
 	struct htx *htx = htxbuf(&msg->chn->buf);
 	struct htx_blk *blk;
 	struct shared_block *fb;
 	struct htx_ret htxret;
-	unsigned int orig_len, to_forward;
+	unsigned int orig_len, to_forward, body_len;
 	int ret;
 
 	if (!len)
@@ -625,6 +1264,7 @@ cache_store_http_payload(struct stream *s, struct filter *filter, struct http_ms
 	chunk_reset(&trash);
 	orig_len = len;
 	to_forward = 0;
+	body_len = 0;
 
 	htxret = htx_find_offset(htx, offset);
 	blk = htxret.blk;
@@ -647,6 +1287,7 @@ cache_store_http_payload(struct stream *s, struct filter *filter, struct http_ms
 				chunk_memcat(&trash, (char *)&info, sizeof(info));
 				chunk_istcat(&trash, v);
 				to_forward += v.len;
+				body_len += v.len;
 				len -= v.len;
 				break;
 
@@ -682,10 +1323,15 @@ cache_store_http_payload(struct stream *s, struct filter *filter, struct http_ms
 	if (ret < 0)
 		goto no_cache;
 
+	((struct cache_entry *)st->first_block->data)->body_len += body_len;
+
+	if (s->txn->flags & TX_CACHE_PENDING)
+		cache_pending_publish(cache, s, st->first_block);
+
 	return to_forward;
 
   no_cache:
-	disable_cache_entry(st, filter, shctx);
+	disable_cache_entry(s, st, filter, shctx);
 	unregister_data_filter(s, msg->chn, filter);
 	return orig_len;
 }
@@ -696,7 +1342,7 @@ cache_store_http_end(struct stream *s, struct filter *filter,
 {
 	struct cache_st *st = filter->ctx;
 	struct cache_flt_conf *cconf = FLT_CONF(filter);
-	struct cache *cache = cconf->c.cache;
+	struct cache *cache = cache_shard(cconf->c.cache, s->txn->cache_hash);
 	struct shared_context *shctx = shctx_ptr(cache);
 	struct cache_entry *object;
 
@@ -710,6 +1356,8 @@ cache_store_http_end(struct stream *s, struct filter *filter,
 		shctx_lock(shctx);
 		/* The whole payload was cached, the entry can now be used. */
 		object->complete = 1;
+		if (s->txn->flags & TX_CACHE_PENDING)
+			cache_pending_release(cache, s, 1);
 		/* remove from the hotlist */
 		shctx_row_dec_hot(shctx, st->first_block);
 		shctx_unlock(shctx);
@@ -866,12 +1514,20 @@ int http_calc_maxage(struct stream *s, struct cache *cache, int *true_maxage)
 }
 
 
-static void cache_free_blocks(struct shared_block *first, struct shared_block *block)
+static void cache_free_blocks(struct shared_context *shctx, struct shared_block *first, struct shared_block *block)
 {
 	struct cache_entry *object = (struct cache_entry *)block->data;
+	struct cache *cache = (struct cache *)shctx->data;
 
-	if (first == block && object->eb.key)
+	if (first == block && object->eb.key) {
+		if (cache->storage)
+			cache_storage_demote(cache, first);
 		delete_entry(object);
+	}
+	if (first == block && object->index) {
+		cache_index_free(object->index);
+		object->index = NULL;
+	}
 	object->eb.key = 0;
 }
 
@@ -988,29 +1644,179 @@ static int set_secondary_key_encoding(struct htx *htx, char *secondary_key)
 
 
 /*
- * This function will store the headers of the response in a buffer and then
- * register a filter to store the data
+ * Stores the headers of the response in <htx> after the entry starting the row
+ * of <first>. Returns 0 on success, or -1 if the response must not be stored.
  */
-enum act_return http_action_store_cache(struct act_rule *rule, struct proxy *px,
-					struct session *sess, struct stream *s, int flags)
+static int cache_store_headers(struct cache *cache, struct htx *htx, struct shared_block *first)
 {
-	int effective_maxage = 0;
-	int true_maxage = 0;
-	struct http_txn *txn = s->txn;
-	struct http_msg *msg = &txn->rsp;
-	struct filter *filter;
-	struct shared_block *first = NULL;
-	struct cache_flt_conf *cconf = rule->arg.act.p[0];
-	struct cache *cache = cconf->c.cache;
 	struct shared_context *shctx = shctx_ptr(cache);
-	struct cache_st *cache_ctx = NULL;
-	struct cache_entry *object, *old;
+	struct cache_entry *object = (struct cache_entry *)first->data;
+	size_t hdrs_len = 0;
+	int32_t pos;
+
+	chunk_reset(&trash);
+	for (pos = htx_get_first(htx); pos != -1; pos = htx_get_next(htx, pos)) {
+		struct htx_blk *blk = htx_get_blk(htx, pos);
+		enum htx_blk_type type = htx_get_blk_type(blk);
+		uint32_t sz = htx_get_blksz(blk);
+
+		hdrs_len += sizeof(*blk) + sz;
+		chunk_memcat(&trash, (char *)&blk->info, sizeof(blk->info));
+		chunk_memcat(&trash, htx_get_blk_ptr(htx, blk), sz);
+
+		/* Look for optional ETag header.
+		 * We need to store the offset of the ETag value in order for
+		 * future conditional requests to be able to perform ETag
+		 * comparisons. */
+		if (type == HTX_BLK_HDR) {
+			struct ist header_name = htx_get_blk_name(htx, blk);
+			if (isteq(header_name, ist("etag"))) {
+				object->etag_length = sz - istlen(header_name);
+				object->etag_offset = sizeof(struct cache_entry) + b_data(&trash) - sz + istlen(header_name);
+			}
+		}
+		if (type == HTX_BLK_EOH)
+			break;
+	}
+
+	/* Do not cache objects if the headers are too big. */
+	if (hdrs_len > htx->size - global.tune.maxrewrite)
+		return -1;
+
+	/* If the response has a secondary_key, fill its key part related to
+	 * encodings with the actual encoding of the response. This way any
+	 * subsequent request having the same primary key will have its accepted
+	 * encodings tested upon the cached response's one.
+	 * We will not cache a response that has an unknown encoding (not
+	 * explicitly supported in parse_encoding_value function). */
+	if (cache->vary_processing_enabled && object->secondary_key_signature)
+		if (set_secondary_key_encoding(htx, object->secondary_key))
+			return -1;
+
+	shctx_lock(shctx);
+	if (!shctx_row_reserve_hot(shctx, first, trash.data)) {
+		shctx_unlock(shctx);
+		return -1;
+	}
+	shctx_unlock(shctx);
+
+	/* cache the headers in a http action because it allows to chose what
+	 * to cache, for example you might want to cache a response before
+	 * modifying some HTTP headers, or on the contrary after modifying
+	 * those headers.
+	 */
+	/* does not need to be locked because it's in the "hot" list,
+	 * copy the headers */
+	if (shctx_row_data_append(shctx, first, NULL, (unsigned char *)trash.area, trash.data) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* Returns the purge key of tag <tag> */
+static inline uint64_t cache_tag_key(const struct ist tag)
+{
+	return XXH64(istptr(tag), istlen(tag), CACHE_INDEX_TAG_SEED);
+}
+
+/* Calls <cb> with <arg> for each of the tags listed in <list>, which are
+ * separated by spaces or commas.
+ */
+static void cache_for_each_tag(struct ist list, void (*cb)(struct ist tag, void *arg), void *arg)
+{
+	size_t len;
+
+	while (1) {
+		while (istlen(list) && (HTTP_IS_LWS(*istptr(list)) || *istptr(list) == ','))
+			list = istnext(list);
+		if (!istlen(list))
+			break;
+
+		for (len = 0; len < istlen(list); len++) {
+			if (HTTP_IS_LWS(istptr(list)[len]) || istptr(list)[len] == ',')
+				break;
+		}
+		cb(ist2(istptr(list), len), arg);
+		list = istadv(list, len);
+	}
+}
+
+/* context of cache_index_add_tag() */
+struct cache_index_keys_ctx {
+	uint64_t *keys;
+	int count;                /* -1 once there are too many keys */
+};
+
+/* Adds the key of <tag> to the cache_index_keys_ctx <arg> unless it is already
+ * there.
+ */
+static void cache_index_add_tag(struct ist tag, void *arg)
+{
+	struct cache_index_keys_ctx *ctx = arg;
+	uint64_t key = cache_tag_key(tag);
+	int i;
+
+	if (ctx->count < 0)
+		return;
+
+	for (i = 0; i < ctx->count; i++) {
+		if (ctx->keys[i] == key)
+			return;
+	}
+
+	if (ctx->count == CACHE_INDEX_MAX_KEYS)
+		ctx->count = -1;
+	else
+		ctx->keys[ctx->count++] = key;
+}
+
+/* Fills <keys> with the purge keys of the response of stream <s> to be stored
+ * in <cache>: the path prefixes of the request, computed by sha1_hosturi(),
+ * followed by the tags found in the response headers of <htx>. Returns the
+ * number of keys, or -1 if there are more than CACHE_INDEX_MAX_KEYS.
+ */
+static int cache_index_keys(struct cache *cache, struct stream *s, struct htx *htx, uint64_t *keys)
+{
+	struct http_txn *txn = s->txn;
+	struct cache_index_keys_ctx ctx = { .keys = keys, .count = 0 };
+	struct http_hdr_ctx hdr = { .blk = NULL };
+
+	for (; ctx.count < txn->cache_prefix_cnt; ctx.count++)
+		keys[ctx.count] = txn->cache_prefix_hash[ctx.count];
+
+	if (!cache->tag_hdr)
+		return ctx.count;
+
+	while (ctx.count >= 0 && http_find_header(htx, ist(cache->tag_hdr), &hdr, 1))
+		cache_for_each_tag(hdr.value, cache_index_add_tag, &ctx);
+
+	return ctx.count;
+}
+
+/*
+ * This function will store the headers of the response in a buffer and then
+ * register a filter to store the data
+ */
+enum act_return http_action_store_cache(struct act_rule *rule, struct proxy *px,
+					struct session *sess, struct stream *s, int flags)
+{
+	int effective_maxage = 0;
+	int true_maxage = 0;
+	struct http_txn *txn = s->txn;
+	struct http_msg *msg = &txn->rsp;
+	struct filter *filter;
+	struct shared_block *first = NULL;
+	struct cache_flt_conf *cconf = rule->arg.act.p[0];
+	struct cache *cache = cache_shard(cconf->c.cache, txn->cache_hash);
+	struct shared_context *shctx = shctx_ptr(cache);
+	struct cache_st *cache_ctx = NULL;
+	struct cache_entry *object, *old;
 	unsigned int key = read_u32(txn->cache_hash);
 	struct htx *htx;
 	struct http_hdr_ctx ctx;
-	size_t hdrs_len = 0;
-	int32_t pos;
 	unsigned int vary_signature = 0;
+	uint64_t index_keys[CACHE_INDEX_MAX_KEYS];
+	int nb_index_keys;
 
 	/* Don't cache if the response came from a cache */
 	if ((obj_type(s->target) == OBJ_TYPE_APPLET) &&
@@ -1041,11 +1847,13 @@ enum act_return http_action_store_cache(struct act_rule *rule, struct proxy *px,
 				 * unsafe request (such as PUT, POST or DELETE). */
 				shctx_lock(shctx);
 
-				old = entry_exist(cconf->c.cache, txn->cache_hash);
+				old = entry_exist(cache, txn->cache_hash);
 				if (old) {
 					eb32_delete(&old->eb);
 					old->eb.key = 0;
 				}
+				if (cache->storage)
+					cache_storage_remove(cache->storage, txn->cache_hash, NULL);
 				shctx_unlock(shctx);
 			}
 		}
@@ -1087,6 +1895,11 @@ enum act_return http_action_store_cache(struct act_rule *rule, struct proxy *px,
 	if (cache->vary_processing_enabled) {
 		if (!http_check_vary_header(htx, &vary_signature))
 			goto out;
+		/* The compression filter evaluated before the cache varies on
+		 * the accepted encodings, even if it does not compress this
+		 * response. */
+		if (cconf->flags & CACHE_FLT_F_COMPRESSED)
+			vary_signature |= VARY_ACCEPT_ENCODING;
 		if (vary_signature) {
 			/* If something went wrong during the secondary key
 			 * building, do not store the response. */
@@ -1104,11 +1917,16 @@ enum act_return http_action_store_cache(struct act_rule *rule, struct proxy *px,
 	if (!(txn->flags & TX_CACHEABLE) || !(txn->flags & TX_CACHE_COOK) || (txn->flags & TX_CACHE_IGNORE))
 		goto out;
 
+	/* An object which could not be purged by all its tags is not stored */
+	nb_index_keys = cache_index_keys(cache, s, htx, index_keys);
+	if (nb_index_keys < 0)
+		goto out;
+
 	shctx_lock(shctx);
 	old = entry_exist(cache, txn->cache_hash);
 	if (old) {
 		if (vary_signature)
-			old = secondary_entry_exist(cconf->c.cache, old,
+			old = secondary_entry_exist(cache, old,
 						    txn->cache_secondary_hash);
 		if (old) {
 			if (!old->complete) {
@@ -1122,6 +1940,9 @@ enum act_return http_action_store_cache(struct act_rule *rule, struct proxy *px,
 			old->eb.key = 0;
 		}
 	}
+	/* The stored versions of this object are outdated by the new one */
+	if (cache->storage)
+		cache_storage_remove(cache->storage, txn->cache_hash, NULL);
 	first = shctx_row_reserve_hot(shctx, NULL, sizeof(struct cache_entry));
 	if (!first) {
 		shctx_unlock(shctx);
@@ -1143,13 +1964,22 @@ enum act_return http_action_store_cache(struct act_rule *rule, struct proxy *px,
 	memcpy(object->hash, txn->cache_hash, sizeof(object->hash));
 	if (vary_signature)
 		memcpy(object->secondary_key, txn->cache_secondary_hash, HTTP_CACHE_SEC_KEY_LEN);
+	object->nb_index_keys = nb_index_keys;
+	memcpy(object->index_keys, index_keys, nb_index_keys * sizeof(*index_keys));
 
-	/* Insert the entry in the tree even if the payload is not cached yet. */
+	/* Insert the entry in the tree even if the payload is not cached yet.
+	 * It is indexed at the same time so that it may be purged while being
+	 * stored.
+	 */
 	if (insert_entry(cache, object) != &object->eb) {
 		object->eb.key = 0;
 		shctx_unlock(shctx);
 		goto out;
 	}
+	if (cache_index_attach(cache, object) < 0) {
+		shctx_unlock(shctx);
+		goto out;
+	}
 	shctx_unlock(shctx);
 
 	/* reserve space for the cache_entry structure */
@@ -1159,7 +1989,7 @@ enum act_return http_action_store_cache(struct act_rule *rule, struct proxy *px,
 	/* Determine the entry's maximum age (taking into account the cache's
 	 * configuration) as well as the response's explicit max age (extracted
 	 * from cache-control directives or the expires header). */
-	effective_maxage = http_calc_maxage(s, cconf->c.cache, &true_maxage);
+	effective_maxage = http_calc_maxage(s, cache, &true_maxage);
 
 	ctx.blk = NULL;
 	if (http_find_header(htx, ist("Age"), &ctx, 0)) {
@@ -1182,60 +2012,16 @@ enum act_return http_action_store_cache(struct act_rule *rule, struct proxy *px,
 	 * compared to a future If-Modified-Since client header. */
 	object->last_modified = get_last_modified_time(htx);
 
-	chunk_reset(&trash);
-	for (pos = htx_get_first(htx); pos != -1; pos = htx_get_next(htx, pos)) {
-		struct htx_blk *blk = htx_get_blk(htx, pos);
-		enum htx_blk_type type = htx_get_blk_type(blk);
-		uint32_t sz = htx_get_blksz(blk);
-
-		hdrs_len += sizeof(*blk) + sz;
-		chunk_memcat(&trash, (char *)&blk->info, sizeof(blk->info));
-		chunk_memcat(&trash, htx_get_blk_ptr(htx, blk), sz);
-
-		/* Look for optional ETag header.
-		 * We need to store the offset of the ETag value in order for
-		 * future conditional requests to be able to perform ETag
-		 * comparisons. */
-		if (type == HTX_BLK_HDR) {
-			struct ist header_name = htx_get_blk_name(htx, blk);
-			if (isteq(header_name, ist("etag"))) {
-				object->etag_length = sz - istlen(header_name);
-				object->etag_offset = sizeof(struct cache_entry) + b_data(&trash) - sz + istlen(header_name);
-			}
-		}
-		if (type == HTX_BLK_EOH)
-			break;
-	}
-
-	/* Do not cache objects if the headers are too big. */
-	if (hdrs_len > htx->size - global.tune.maxrewrite)
-		goto out;
-
-	/* If the response has a secondary_key, fill its key part related to
-	 * encodings with the actual encoding of the response. This way any
-	 * subsequent request having the same primary key will have its accepted
-	 * encodings tested upon the cached response's one.
-	 * We will not cache a response that has an unknown encoding (not
-	 * explicitly supported in parse_encoding_value function). */
-	if (cache->vary_processing_enabled && vary_signature)
-		if (set_secondary_key_encoding(htx, object->secondary_key))
-		    goto out;
-
-	shctx_lock(shctx);
-	if (!shctx_row_reserve_hot(shctx, first, trash.data)) {
-		shctx_unlock(shctx);
-		goto out;
+	/* The response is compressed by a filter evaluated before the cache,
+	 * its headers are stored once updated, from the http_headers callback.
+	 */
+	if (cache_ctx && (cache_ctx->flags & CACHE_ST_F_COMPRESSED)) {
+		cache_ctx->first_block = first;
+		cache_ctx->maxage = effective_maxage;
+		return ACT_RET_CONT;
 	}
-	shctx_unlock(shctx);
 
-	/* cache the headers in a http action because it allows to chose what
-	 * to cache, for example you might want to cache a response before
-	 * modifying some HTTP headers, or on the contrary after modifying
-	 * those headers.
-	 */
-	/* does not need to be locked because it's in the "hot" list,
-	 * copy the headers */
-	if (shctx_row_data_append(shctx, first, NULL, (unsigned char *)trash.area, trash.data) < 0)
+	if (cache_store_headers(cache, htx, first) < 0)
 		goto out;
 
 	/* register the buffer in the filter ctx for filling it with data*/
@@ -1244,6 +2030,9 @@ enum act_return http_action_store_cache(struct act_rule *rule, struct proxy *px,
 		/* store latest value and expiration time */
 		object->latest_validation = now.tv_sec;
 		object->expire = now.tv_sec + effective_maxage;
+		/* the requests waiting for this response may now be served */
+		if (cache->collapse_timeout)
+			cache_pending_publish(cache, s, first);
 		return ACT_RET_CONT;
 	}
 
@@ -1255,6 +2044,11 @@ enum act_return http_action_store_cache(struct act_rule *rule, struct proxy *px,
 		if (object->eb.key)
 			delete_entry(object);
 		object->eb.key = 0;
+		if (object->index) {
+			/* the blocks are released without being notified */
+			cache_index_free(object->index);
+			object->index = NULL;
+		}
 		shctx_row_dec_hot(shctx, first);
 		shctx_unlock(shctx);
 	}
@@ -1273,14 +2067,54 @@ static void http_cache_applet_release(struct appctx *appctx)
 	struct cache_appctx *ctx = appctx->svcctx;
 	struct cache_flt_conf *cconf = appctx->rule->arg.act.p[0];
 	struct cache_entry *cache_ptr = ctx->entry;
-	struct cache *cache = cconf->c.cache;
+	struct cache *cache = cache_shard(cconf->c.cache, cache_ptr->hash);
 	struct shared_block *first = block_ptr(cache_ptr);
 
 	shctx_lock(shctx_ptr(cache));
+	LIST_DEL_INIT(&ctx->waiter.list);
 	shctx_row_dec_hot(shctx_ptr(cache), first);
 	shctx_unlock(shctx_ptr(cache));
 }
 
+/* Checks whether more data of the entry streamed by <appctx>, which is still
+ * being stored, may be sent. Returns 1 if so, after having updated the length
+ * of the available data and left the streaming mode if the entry is complete.
+ * Returns 0 if the applet must wait to be woken up by the stream storing the
+ * entry, or -1 if the entry was aborted.
+ */
+static int http_cache_wait_data(struct appctx *appctx)
+{
+	struct cache_appctx *ctx = appctx->svcctx;
+	struct cache_flt_conf *cconf = appctx->rule->arg.act.p[0];
+	struct cache_entry *entry = ctx->entry;
+	struct cache *cache = cache_shard(cconf->c.cache, entry->hash);
+	struct cache_pending *pending;
+	int ret = 0;
+
+	shctx_lock(shctx_ptr(cache));
+	if (entry->complete) {
+		ctx->avail = block_ptr(entry)->len;
+		ctx->streaming = 0;
+		ret = 1;
+		goto end;
+	}
+
+	pending = cache_pending_lookup(cache, entry->hash);
+	if (!pending || pending->entry != entry)
+		ret = -1;
+	else if (pending->len > ctx->avail) {
+		ctx->avail = pending->len;
+		ret = 1;
+	}
+	else if (!LIST_INLIST(&ctx->waiter.list)) {
+		ctx->waiter.task = appctx->t;
+		LIST_APPEND(&pending->waiters, &ctx->waiter.list);
+	}
+  end:
+	shctx_unlock(shctx_ptr(cache));
+	return ret;
+}
+
 
 static unsigned int htx_cache_dump_blk(struct appctx *appctx, struct htx *htx, enum htx_blk_type type,
 				       uint32_t info, struct shared_block *shblk, unsigned int offset)
@@ -1317,7 +2151,7 @@ static unsigned int htx_cache_dump_blk(struct appctx *appctx, struct htx *htx, e
 		blksz  -= max;
 		total  += max;
 		ptr    += max;
-		if (blksz || offset == shctx->block_size) {
+		if (blksz) {
 			shblk = LIST_NEXT(&shblk->list, typeof(shblk), list);
 			offset = 0;
 		}
@@ -1334,8 +2168,10 @@ static unsigned int htx_cache_dump_data_blk(struct appctx *appctx, struct htx *h
 	struct cache_appctx *ctx = appctx->svcctx;
 	struct cache_flt_conf *cconf = appctx->rule->arg.act.p[0];
 	struct shared_context *shctx = shctx_ptr(cconf->c.cache);
+	struct htx_ret htxret;
 	unsigned int max, total, rem_data;
-	uint32_t blksz;
+	uint32_t blksz, room, dpos;
+	char *dptr;
 
 	max = htx_get_max_blksz(htx,
 				channel_htx_recv_max(sc_ic(appctx_sc(appctx)), htx));
@@ -1351,27 +2187,53 @@ static unsigned int htx_cache_dump_data_blk(struct appctx *appctx, struct htx *h
 		blksz = (info & 0xfffffff);
 		total = 4;
 	}
+	if (ctx->range && blksz > ctx->range_len) {
+		rem_data = blksz - ctx->range_len;
+		blksz = ctx->range_len;
+	}
 	if (blksz > max) {
-		rem_data = blksz - max;
+		rem_data += blksz - max;
 		blksz = max;
 	}
 
-	while (blksz) {
-		size_t sz;
+	/* Reserve the largest possible DATA block once and copy the shctx
+	 * blocks directly into it, instead of appending them one at a time.
+	 */
+	htxret = htx_reserve_max_data(htx);
+	if (!htxret.blk) {
+		rem_data += blksz;
+		blksz = 0;
+		goto end;
+	}
+	dptr = htx_get_blk_ptr(htx, htxret.blk);
+	dpos = htxret.ret;
+	room = htx_get_blksz(htxret.blk) - dpos;
+	if (blksz > room) {
+		rem_data += blksz - room;
+		blksz = room;
+	}
 
+	while (blksz) {
 		max = MIN(blksz, shctx->block_size - offset);
-		sz  = htx_add_data(htx, ist2(shblk->data + offset, max));
-		offset += sz;
-		blksz  -= sz;
-		total  += sz;
-		if (sz < max)
-			break;
-		if (blksz || offset == shctx->block_size) {
+		memcpy(dptr + dpos, shblk->data + offset, max);
+		dpos   += max;
+		offset += max;
+		blksz  -= max;
+		total  += max;
+		if (ctx->range)
+			ctx->range_len -= max;
+		if (blksz) {
 			shblk = LIST_NEXT(&shblk->list, typeof(shblk), list);
 			offset = 0;
 		}
 	}
 
+	if (!dpos)
+		htx_remove_blk(htx, htxret.blk);
+	else
+		htx_change_blk_value_len(htx, htxret.blk, dpos);
+
+  end:
 	ctx->offset   = offset;
 	ctx->next     = shblk;
 	ctx->sent    += total;
@@ -1425,7 +2287,7 @@ static size_t htx_cache_dump_msg(struct appctx *appctx, struct htx *htx, unsigne
 		total += ret;
 		len   -= ret;
 
-		if (ctx->rem_data || type == mark)
+		if (ctx->rem_data || type == mark || (ctx->range && !ctx->range_len))
 			break;
 	}
 
@@ -1450,11 +2312,142 @@ static int htx_cache_add_age_hdr(struct appctx *appctx, struct htx *htx)
 	return 1;
 }
 
+/* Turns the headers of the entry sent by <appctx> into the ones of a "206
+ * Partial Content" response for the range to send. Returns 1 on success,
+ * otherwise 0.
+ */
+static int htx_cache_set_range_hdrs(struct appctx *appctx, struct htx *htx)
+{
+	struct cache_appctx *ctx = appctx->svcctx;
+	struct http_hdr_ctx hdr = { .blk = NULL };
+	struct htx_sl *sl;
+	char *end;
+
+	if (!http_replace_res_status(htx, ist("206"), ist("Partial Content")))
+		return 0;
+
+	while (http_find_header(htx, ist("content-length"), &hdr, 1))
+		http_remove_header(htx, &hdr);
+	hdr.blk = NULL;
+	while (http_find_header(htx, ist("transfer-encoding"), &hdr, 1))
+		http_remove_header(htx, &hdr);
+
+	sl = http_get_stline(htx);
+	sl->flags &= ~HTX_SL_F_CHNK;
+	sl->flags |= HTX_SL_F_XFER_LEN | HTX_SL_F_CLEN;
+
+	chunk_printf(&trash, "bytes %u-%u/%u", ctx->range_start,
+		     ctx->range_start + ctx->range_len - 1, ctx->entry->body_len);
+	if (!http_add_header(htx, ist("Content-Range"), ist2(b_head(&trash), b_data(&trash))))
+		return 0;
+
+	end = ultoa_o(ctx->range_len, b_head(&trash), b_size(&trash));
+	b_set_data(&trash, end - b_head(&trash));
+	if (!http_add_header(htx, ist("Content-Length"), ist2(b_head(&trash), b_data(&trash))))
+		return 0;
+	return 1;
+}
+
+/* Turns the headers of the entry sent by <appctx> into the ones of a bodyless
+ * "416 Range Not Satisfiable" response. Returns 1 on success, otherwise 0.
+ */
+static int htx_cache_set_unsatisfiable_hdrs(struct appctx *appctx, struct htx *htx)
+{
+	struct cache_appctx *ctx = appctx->svcctx;
+	struct http_hdr_ctx hdr = { .blk = NULL };
+	struct htx_sl *sl;
+
+	if (!http_replace_res_status(htx, ist("416"), ist("Range Not Satisfiable")))
+		return 0;
+
+	while (http_find_header(htx, ist("content-length"), &hdr, 1))
+		http_remove_header(htx, &hdr);
+	hdr.blk = NULL;
+	while (http_find_header(htx, ist("transfer-encoding"), &hdr, 1))
+		http_remove_header(htx, &hdr);
+
+	sl = http_get_stline(htx);
+	sl->flags &= ~HTX_SL_F_CHNK;
+	sl->flags |= HTX_SL_F_XFER_LEN | HTX_SL_F_CLEN | HTX_SL_F_BODYLESS;
+
+	chunk_printf(&trash, "bytes */%u", ctx->entry->body_len);
+	if (!http_add_header(htx, ist("Content-Range"), ist2(b_head(&trash), b_data(&trash))) ||
+	    !http_add_header(htx, ist("Content-Length"), ist("0")))
+		return 0;
+	return 1;
+}
+
+/* Moves the position of <appctx> in the entry's row, which must be right after
+ * the headers, to the first byte of the range to send. Only the HTX block
+ * descriptors met on the way are read, the shared blocks holding the skipped
+ * payload are only walked through. Returns 1 on success, or 0 if the range
+ * start could not be reached.
+ */
+static int htx_cache_skip_to_range(struct appctx *appctx)
+{
+	struct cache_appctx *ctx = appctx->svcctx;
+	struct cache_flt_conf *cconf = appctx->rule->arg.act.p[0];
+	struct shared_context *shctx = shctx_ptr(cconf->c.cache);
+	struct shared_block *shblk = ctx->next;
+	unsigned int offset = ctx->offset;
+	unsigned int skip = ctx->range_start;
+	unsigned int end = ctx->avail - sizeof(struct cache_entry);
+	unsigned int sz;
+	uint32_t info;
+
+	while (1) {
+		if (ctx->sent + 4 > end)
+			return 0;
+
+		/* Get info of the next HTX block. May be split on 2 shblk */
+		sz = MIN(4, shctx->block_size - offset);
+		memcpy((char *)&info, (const char *)shblk->data + offset, sz);
+		offset += sz;
+		if (sz < 4) {
+			shblk = LIST_NEXT(&shblk->list, typeof(shblk), list);
+			memcpy(((char *)&info)+sz, (const char *)shblk->data, 4 - sz);
+			offset = (4 - sz);
+		}
+		ctx->sent += 4;
+
+		if ((info >> 28) != HTX_BLK_DATA)
+			return 0;
+
+		sz = info & 0xfffffff;
+		if (sz > skip)
+			break;
+
+		/* skip the whole block */
+		if (ctx->sent + sz > end)
+			return 0;
+		offset += sz;
+		while (offset > shctx->block_size) {
+			shblk = LIST_NEXT(&shblk->list, typeof(shblk), list);
+			offset -= shctx->block_size;
+		}
+		ctx->sent += sz;
+		skip -= sz;
+	}
+
+	/* the range starts within this block, the remaining data are sent
+	 * as the end of a partially sent block.
+	 */
+	offset += skip;
+	while (offset > shctx->block_size) {
+		shblk = LIST_NEXT(&shblk->list, typeof(shblk), list);
+		offset -= shctx->block_size;
+	}
+	ctx->sent += skip;
+	ctx->rem_data = sz - skip;
+	ctx->offset = offset;
+	ctx->next = shblk;
+	return 1;
+}
+
 static void http_cache_io_handler(struct appctx *appctx)
 {
 	struct cache_appctx *ctx = appctx->svcctx;
 	struct cache_entry *cache_ptr = ctx->entry;
-	struct shared_block *first = block_ptr(cache_ptr);
 	struct stconn *sc = appctx_sc(appctx);
 	struct channel *req = sc_oc(sc);
 	struct channel *res = sc_ic(sc);
@@ -1462,6 +2455,7 @@ static void http_cache_io_handler(struct appctx *appctx)
 	struct buffer *errmsg;
 	unsigned int len;
 	size_t ret, total = 0;
+	int wait;
 
 	res_htx = htx_from_buf(&res->buf);
 	total = res_htx->data;
@@ -1488,7 +2482,7 @@ static void http_cache_io_handler(struct appctx *appctx)
 
 	if (appctx->st0 == HTX_CACHE_HEADER) {
 		/* Headers must be dump at once. Otherwise it is an error */
-		len = first->len - sizeof(*cache_ptr) - ctx->sent;
+		len = ctx->avail - sizeof(*cache_ptr) - ctx->sent;
 		ret = htx_cache_dump_msg(appctx, res_htx, len, HTX_BLK_EOH);
 		if (!ret || (htx_get_tail_type(res_htx) != HTX_BLK_EOH) ||
 		    !htx_cache_add_age_hdr(appctx, res_htx))
@@ -1507,18 +2501,60 @@ static void http_cache_io_handler(struct appctx *appctx)
 		 * Modified" response. */
 		if (__sc_strm(sc)->txn->meth == HTTP_METH_HEAD || ctx->send_notmodified)
 			appctx->st0 = HTX_CACHE_EOM;
+		else if (ctx->unsatisfiable) {
+			if (!htx_cache_set_unsatisfiable_hdrs(appctx, res_htx))
+				goto error;
+			appctx->st0 = HTX_CACHE_EOM;
+		}
+		else if (ctx->range) {
+			if (!htx_cache_set_range_hdrs(appctx, res_htx) ||
+			    !htx_cache_skip_to_range(appctx))
+				goto error;
+			appctx->st0 = HTX_CACHE_DATA;
+		}
 		else
 			appctx->st0 = HTX_CACHE_DATA;
 	}
 
+	if (appctx->st0 == HTX_CACHE_DATA && ctx->range) {
+		/* The entry is complete, only the range is sent */
+		len = ctx->avail - sizeof(*cache_ptr) - ctx->sent;
+		if (ctx->range_len && len)
+			htx_cache_dump_msg(appctx, res_htx, len, HTX_BLK_UNUSED);
+		if (ctx->range_len) {
+			if (!len) {
+				se_fl_set(appctx->sedesc, SE_FL_ERROR);
+				appctx->st0 = HTX_CACHE_END;
+				goto out;
+			}
+			sc_need_room(sc);
+			goto out;
+		}
+		appctx->st0 = HTX_CACHE_EOM;
+	}
+
 	if (appctx->st0 == HTX_CACHE_DATA) {
-		len = first->len - sizeof(*cache_ptr) - ctx->sent;
-		if (len) {
-			ret = htx_cache_dump_msg(appctx, res_htx, len, HTX_BLK_UNUSED);
-			if (ret < len) {
-				sc_need_room(sc);
+		while (1) {
+			len = ctx->avail - sizeof(*cache_ptr) - ctx->sent;
+			if (len) {
+				ret = htx_cache_dump_msg(appctx, res_htx, len, HTX_BLK_UNUSED);
+				if (ret < len) {
+					sc_need_room(sc);
+					goto out;
+				}
+			}
+			if (!ctx->streaming)
+				break;
+
+			/* the entry is still being stored */
+			wait = http_cache_wait_data(appctx);
+			if (wait < 0) {
+				se_fl_set(appctx->sedesc, SE_FL_ERROR);
+				appctx->st0 = HTX_CACHE_END;
 				goto out;
 			}
+			if (!wait)
+				goto out;
 		}
 		appctx->st0 = HTX_CACHE_EOM;
 	}
@@ -1632,10 +2668,91 @@ enum act_parse_ret parse_cache_store(const char **args, int *orig_arg, struct pr
 	return ACT_RET_PRS_OK;
 }
 
+/* Returns the length of the scheme and authority parts of the absolute URI
+ * <uri>, or 0 if there is none.
+ */
+static size_t cache_uri_auth_len(const struct ist uri)
+{
+	struct ist auth = istist(uri, ist("://"));
+
+	if (!isttest(auth))
+		return 0;
+	auth = istadv(auth, 3);
+	return istlen(uri) - istlen(istfind(auth, '/'));
+}
+
+/* Computes the purge keys of the first <depth> path prefixes of the absolute
+ * URI <uri> into the transaction <txn>. A prefix ends with a slash, so
+ * "https://www.example.com/a/b" has two prefixes, "https://www.example.com/"
+ * and "https://www.example.com/a/". The query string is ignored.
+ */
+static void cache_hash_prefixes(struct http_txn *txn, const struct ist uri, unsigned int depth)
+{
+	size_t pos = cache_uri_auth_len(uri);
+
+	if (!pos)
+		return;
+
+	for (; pos < istlen(uri) && txn->cache_prefix_cnt < depth; pos++) {
+		if (istptr(uri)[pos] == '?' || istptr(uri)[pos] == '#')
+			break;
+		if (istptr(uri)[pos] == '/')
+			txn->cache_prefix_hash[txn->cache_prefix_cnt++] =
+				XXH64(istptr(uri), pos + 1, CACHE_INDEX_PREFIX_SEED);
+	}
+}
+
+/* Computes the purge key of the URI path prefix <prefix> into <key>. It is
+ * either an absolute URI or a host followed by a path, and a trailing slash
+ * is implied. Returns the depth of the prefix in the path, which is the
+ * number of slashes, or 0 if it is invalid.
+ */
+static unsigned int cache_prefix_key(const struct ist prefix, uint64_t *key)
+{
+	struct buffer *buf;
+	unsigned int depth = 0;
+	size_t pos;
+
+	if (!istlen(prefix) || *istptr(prefix) == '/')
+		return 0;
+
+	buf = alloc_trash_chunk();
+	if (!buf)
+		return 0;
+
+	if (!isttest(istist(prefix, ist("://"))))
+		chunk_istcat(buf, ist("https://"));
+	if (!chunk_istcat(buf, prefix))
+		goto end;
+
+	for (pos = cache_uri_auth_len(ist2(buf->area, buf->data)); pos < buf->data; pos++) {
+		if (buf->area[pos] == '?' || buf->area[pos] == '#') {
+			depth = 0;
+			goto end;
+		}
+		if (buf->area[pos] == '/')
+			depth++;
+	}
+
+	if (!depth || buf->area[buf->data - 1] != '/') {
+		if (!chunk_memcat(buf, "/", 1)) {
+			depth = 0;
+			goto end;
+		}
+		depth++;
+	}
+	*key = XXH64(buf->area, buf->data, CACHE_INDEX_PREFIX_SEED);
+  end:
+	free_trash_chunk(buf);
+	return depth;
+}
+
 /* This produces a sha1 hash of the concatenation of the HTTP method,
  * the first occurrence of the Host header followed by the path component
- * if it begins with a slash ('/'). */
-int sha1_hosturi(struct stream *s)
+ * if it begins with a slash ('/'). The purge keys of the first <prefixes>
+ * path prefixes are computed at the same time.
+ */
+int sha1_hosturi(struct stream *s, unsigned int prefixes)
 {
 	struct http_txn *txn = s->txn;
 	struct htx *htx = htxbuf(&s->req.buf);
@@ -1679,9 +2796,111 @@ int sha1_hosturi(struct stream *s)
 	blk_SHA1_Update(&sha1_ctx, trash->area, trash->data);
 	blk_SHA1_Final((unsigned char *)txn->cache_hash, &sha1_ctx);
 
+	txn->cache_prefix_cnt = 0;
+	if (prefixes)
+		cache_hash_prefixes(txn, ist2(trash->area, trash->data), prefixes);
+
 	return 1;
 }
 
+/* Returns the running cache named <name>, or NULL if there is none. With
+ * shards, the first one is returned.
+ */
+static struct cache *cache_find(const char *name)
+{
+	struct cache *cache;
+
+	list_for_each_entry(cache, &caches, list) {
+		if (!cache->shard_id && strcmp(cache->id, name) == 0)
+			return cache;
+	}
+	return NULL;
+}
+
+/* Removes from all the shards of <cache> the objects indexed with the purge
+ * key <key>, from the shared memory as well as from the second tier storage.
+ * This only costs a lookup plus the removal of the matching objects. Returns
+ * the number of objects removed.
+ */
+static unsigned int cache_purge_key(struct cache *cache, uint64_t key)
+{
+	struct eb64_node *node, *next;
+	struct cache_index *idx;
+	struct cache *shard;
+	unsigned int purged = 0;
+	unsigned int i;
+
+	for (i = 0; i < cache->nb_shards; i++) {
+		shard = cache->shards ? cache->shards[i] : cache;
+
+		shctx_lock(shctx_ptr(shard));
+		for (node = eb64_lookup(&shard->index, key); node; node = next) {
+			/* the keys of an index are unique, so <next> belongs
+			 * to another object.
+			 */
+			next = eb64_next_dup(node);
+			idx = container_of(node, struct cache_index_key, node)->idx;
+
+			if (idx->se) {
+				if (idx->se == shard->storage->promoting)
+					continue;
+				cache_storage_evict(shard->storage, idx->se);
+				purged++;
+				continue;
+			}
+
+			/* the entry may be in use, it is only unlinked */
+			if (idx->entry->eb.key) {
+				delete_entry(idx->entry);
+				idx->entry->eb.key = 0;
+				purged++;
+			}
+			idx->entry->index = NULL;
+			cache_index_free(idx);
+		}
+		shctx_unlock(shctx_ptr(shard));
+	}
+	return purged;
+}
+
+/* context of cache_purge_tag() */
+struct cache_purge_ctx {
+	struct cache *cache;
+	unsigned int purged;
+};
+
+/* Purges the objects tagged with <tag> from the cache of the cache_purge_ctx
+ * <arg>.
+ */
+static void cache_purge_tag(struct ist tag, void *arg)
+{
+	struct cache_purge_ctx *ctx = arg;
+
+	ctx->purged += cache_purge_key(ctx->cache, cache_tag_key(tag));
+}
+
+/* Purges from <cache> the objects tagged with any of the tags of <list> if
+ * <type> is CACHE_PURGE_TAG, or the objects under the path prefix <list> if
+ * it is CACHE_PURGE_PREFIX. Returns the number of objects removed, or -1 if
+ * the prefix is invalid or deeper than the prefixes indexed by the cache.
+ */
+static int cache_purge(struct cache *cache, enum cache_purge_type type, const struct ist list)
+{
+	struct cache_purge_ctx ctx = { .cache = cache, .purged = 0 };
+	unsigned int depth;
+	uint64_t key;
+
+	if (type == CACHE_PURGE_TAG) {
+		cache_for_each_tag(list, cache_purge_tag, &ctx);
+		return ctx.purged;
+	}
+
+	depth = cache_prefix_key(list, &key);
+	if (!depth || depth > cache->index_prefixes)
+		return -1;
+	return cache_purge_key(cache, key);
+}
+
 /* Looks for "If-None-Match" headers in the request and compares their value
  * with the one that might have been stored in the cache_entry. If any of them
  * matches, a "304 Not Modified" response should be sent instead of the cached
@@ -1766,6 +2985,230 @@ static int should_send_notmodified_response(struct cache *cache, struct htx *htx
 	return retval;
 }
 
+/* Looks for a "Range" header in the request <htx> which may be served from the
+ * complete entry <entry> of cache <cache>. Only a single byte range is
+ * supported. It is ignored if it is invalid, or if an "If-Range" header does
+ * not exactly match the entry's strong ETag, in which case the whole entry is
+ * sent (see RFC9110#14.2). Returns 1 and fills <start> and <len> with the
+ * range's position in the payload if it must be served, -1 if it starts past
+ * the end of the payload and a "416 Range Not Satisfiable" response must be
+ * sent, otherwise 0.
+ */
+static int http_cache_get_range(struct cache *cache, struct htx *htx,
+                                struct cache_entry *entry,
+                                unsigned int *start, unsigned int *len)
+{
+	struct http_hdr_ctx ctx = { .blk = NULL };
+	struct buffer *etag_buffer;
+	unsigned long long first, last;
+	const char *p, *end, *digits;
+	struct ist range;
+	int suffix = 0, open_ended = 0, satisfiable = 1;
+
+	if (!entry->body_len || !http_find_header(htx, ist("range"), &ctx, 1))
+		return 0;
+	range = ctx.value;
+
+	/* several "Range" headers are not supported */
+	if (http_find_header(htx, ist("range"), &ctx, 1))
+		return 0;
+
+	if (!istmatchi(range, ist("bytes=")))
+		return 0;
+	p = istptr(range) + 6;
+	end = istend(range);
+	while (p < end && HTTP_IS_SPHT(*p))
+		p++;
+
+	digits = p;
+	first = read_uint64(&p, end);
+	if (p == digits) {
+		/* a suffix range may only be "-<length>" */
+		if (p == end || *p != '-')
+			return 0;
+		suffix = 1;
+	}
+	if (p == end || *p++ != '-')
+		return 0;
+	digits = p;
+	last = read_uint64(&p, end);
+	if (p == digits) {
+		if (suffix)
+			return 0;
+		open_ended = 1;
+	}
+	while (p < end && HTTP_IS_SPHT(*p))
+		p++;
+	if (p != end)
+		return 0; /* multiple ranges or garbage */
+
+	if (suffix) {
+		/* suffix range: the last <last> bytes */
+		if (!last)
+			satisfiable = 0;
+		else if (last > entry->body_len)
+			last = entry->body_len;
+		first = entry->body_len - last;
+		last = entry->body_len - 1;
+	}
+	else {
+		if (!open_ended && last < first)
+			return 0;
+		if (first >= entry->body_len)
+			satisfiable = 0;
+		else if (open_ended || last >= entry->body_len)
+			last = entry->body_len - 1;
+	}
+
+	/* The range is only valid if "If-Range" matches the stored ETag. A
+	 * date or a weak ETag never matches here.
+	 */
+	ctx.blk = NULL;
+	if (http_find_header(htx, ist("if-range"), &ctx, 1)) {
+		if (!entry->etag_length || istlen(ctx.value) != entry->etag_length ||
+		    istmatch(ctx.value, ist("W/")))
+			return 0;
+
+		etag_buffer = get_trash_chunk();
+		if (shctx_row_data_get(shctx_ptr(cache), block_ptr(entry),
+				       (unsigned char *)b_orig(etag_buffer),
+				       entry->etag_offset, entry->etag_length) != 0 ||
+		    memcmp(b_orig(etag_buffer), istptr(ctx.value), entry->etag_length) != 0)
+			return 0;
+	}
+
+	if (!satisfiable)
+		return -1;
+
+	*start = first;
+	*len = last - first + 1;
+	return 1;
+}
+
+/* Makes stream <s> deliver the cache entry <entry> of the cache used by rule
+ * <rule>. The entry's row must already be in the hot list, it is released in
+ * case of failure.
+ */
+static void http_cache_deliver_entry(struct act_rule *rule, struct proxy *px,
+                                     struct stream *s, struct cache_entry *entry,
+                                     unsigned int avail)
+{
+	struct cache_flt_conf *cconf = rule->arg.act.p[0];
+	struct cache *cache = cache_shard(cconf->c.cache, entry->hash);
+	struct appctx *appctx;
+
+	s->target = &http_cache_applet.obj_type;
+	if ((appctx = sc_applet_create(s->scb, objt_applet(s->target)))) {
+		struct cache_appctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+
+		appctx->st0 = HTX_CACHE_INIT;
+		appctx->rule = rule;
+		ctx->entry = entry;
+		ctx->next = NULL;
+		ctx->sent = 0;
+		ctx->streaming = !!avail;
+		ctx->avail = avail ? avail : block_ptr(entry)->len;
+		LIST_INIT(&ctx->waiter.list);
+		ctx->send_notmodified =
+                        should_send_notmodified_response(cache, htxbuf(&s->req.buf), entry);
+		ctx->range = ctx->unsatisfiable = 0;
+		if (!ctx->streaming && !ctx->send_notmodified && s->txn->meth == HTTP_METH_GET) {
+			int ret = http_cache_get_range(cache, htxbuf(&s->req.buf), entry,
+			                               &ctx->range_start, &ctx->range_len);
+
+			ctx->range = ret > 0;
+			ctx->unsatisfiable = ret < 0;
+		}
+
+		if (px == strm_fe(s))
+			_HA_ATOMIC_INC(&px->fe_counters.p.http.cache_hits);
+		else
+			_HA_ATOMIC_INC(&px->be_counters.p.http.cache_hits);
+		HA_USDT(cache_hit, s, cconf->c.cache, entry, !!avail);
+	} else {
+		s->target = NULL;
+		shctx_lock(shctx_ptr(cache));
+		shctx_row_dec_hot(shctx_ptr(cache), block_ptr(entry));
+		shctx_unlock(shctx_ptr(cache));
+	}
+}
+
+/* Collapsed forwarding of the misses of the cache used by <rule>: only the
+ * first request for an object is forwarded to the server, and the next ones
+ * wait for its response to be stored, for at most the cache's collapse
+ * timeout. Returns ACT_RET_YIELD if stream <s> must wait, otherwise
+ * ACT_RET_CONT. In this case, if the response is being stored, <*entry> is set
+ * to its entry, whose row is put in the hot list, and <*avail> to the length of
+ * its row which may already be delivered. Otherwise <*entry> is set to NULL and
+ * the request must be forwarded.
+ */
+static enum act_return http_cache_collapse(struct act_rule *rule, struct stream *s, int flags,
+                                           struct cache_entry **entry, unsigned int *avail)
+{
+	struct cache_flt_conf *cconf = rule->arg.act.p[0];
+	struct cache *cache = cache_shard(cconf->c.cache, s->txn->cache_hash);
+	struct shared_context *shctx = shctx_ptr(cache);
+	struct http_txn *txn = s->txn;
+	struct cache_pending *pending;
+	struct cache_st *st = NULL;
+	struct filter *filter;
+	enum act_return ret = ACT_RET_CONT;
+
+	*entry = NULL;
+
+	/* the filter context is needed to wait */
+	list_for_each_entry(filter, &s->strm_flt.filters, list) {
+		if (FLT_ID(filter) == cache_store_flt_id && FLT_CONF(filter) == cconf) {
+			st = filter->ctx;
+			break;
+		}
+	}
+	if (!st)
+		return ret;
+
+	shctx_lock(shctx);
+	LIST_DEL_INIT(&st->waiter.list);
+
+	pending = cache_pending_lookup(cache, txn->cache_hash);
+	if (!pending) {
+		if (txn->meth == HTTP_METH_GET && cache_pending_new(cache, s))
+			txn->flags |= TX_CACHE_PENDING;
+		goto out;
+	}
+
+	/* pass mode, or already owned by this stream */
+	if (!pending->owner || pending->owner == s)
+		goto out;
+
+	if (pending->entry) {
+		/* the response is being stored, it may be streamed unless
+		 * it varies.
+		 */
+		if (!pending->entry->secondary_key_signature) {
+			shctx_row_inc_hot(shctx, block_ptr(pending->entry));
+			*entry = pending->entry;
+			*avail = pending->len;
+		}
+		goto out;
+	}
+
+	if ((flags & ACT_OPT_FINAL) ||
+	    (tick_isset(st->wait_exp) && tick_is_expired(st->wait_exp, now_ms)))
+		goto out;
+
+	if (!tick_isset(st->wait_exp))
+		st->wait_exp = tick_add(now_ms, MS_TO_TICKS(cache->collapse_timeout));
+	st->waiter.task = s->task;
+	LIST_APPEND(&pending->waiters, &st->waiter.list);
+	s->req.analyse_exp = tick_first((tick_is_expired(s->req.analyse_exp, now_ms) ? 0 : s->req.analyse_exp),
+					st->wait_exp);
+	ret = ACT_RET_YIELD;
+
+  out:
+	shctx_unlock(shctx);
+	return ret;
+}
+
 enum act_return http_action_req_cache_use(struct act_rule *rule, struct proxy *px,
                                          struct session *sess, struct stream *s, int flags)
 {
@@ -1789,22 +3232,26 @@ enum act_return http_action_req_cache_use(struct act_rule *rule, struct proxy *p
 	 * or PUTs for instance because RFC7234 specifies that a successful
 	 * "unsafe" method on a stored resource must invalidate it
 	 * (see RFC7234#4.4). */
-	if (!sha1_hosturi(s))
+	if (!sha1_hosturi(s, cconf->c.cache->index_prefixes))
 		return ACT_RET_CONT;
 
 	if (s->txn->flags & TX_CACHE_IGNORE)
 		return ACT_RET_CONT;
 
-	if (px == strm_fe(s))
-		_HA_ATOMIC_INC(&px->fe_counters.p.http.cache_lookups);
-	else
-		_HA_ATOMIC_INC(&px->be_counters.p.http.cache_lookups);
+	cache = cache_shard(cache, txn->cache_hash);
+
+	/* the action is evaluated again when waiting for a pending miss */
+	if (flags & ACT_OPT_FIRST) {
+		if (px == strm_fe(s))
+			_HA_ATOMIC_INC(&px->fe_counters.p.http.cache_lookups);
+		else
+			_HA_ATOMIC_INC(&px->be_counters.p.http.cache_lookups);
+	}
 
 	shctx_lock(shctx_ptr(cache));
 	res = entry_exist(cache, s->txn->cache_hash);
 	/* We must not use an entry that is not complete. */
 	if (res && res->complete) {
-		struct appctx *appctx;
 		entry_block = block_ptr(res);
 		shctx_row_inc_hot(shctx_ptr(cache), entry_block);
 		shctx_unlock(shctx_ptr(cache));
@@ -1831,40 +3278,42 @@ enum act_return http_action_req_cache_use(struct act_rule *rule, struct proxy *p
 		}
 
 		/* We looked for a valid secondary entry and could not find one,
-		 * the request must be forwarded to the server. */
+		 * the request must be forwarded to the server unless the
+		 * second tier holds it. */
 		if (!res) {
 			shctx_lock(shctx_ptr(cache));
 			shctx_row_dec_hot(shctx_ptr(cache), entry_block);
 			shctx_unlock(shctx_ptr(cache));
+
+			if (cache->storage && (res = cache_storage_promote(cache, s)))
+				http_cache_deliver_entry(rule, px, s, res, 0);
+			else
+				HA_USDT(cache_miss, s, cconf->c.cache, (const char *)txn->cache_hash);
 			return ACT_RET_CONT;
 		}
 
-		s->target = &http_cache_applet.obj_type;
-		if ((appctx = sc_applet_create(s->scb, objt_applet(s->target)))) {
-			struct cache_appctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+		http_cache_deliver_entry(rule, px, s, res, 0);
+		return ACT_RET_CONT;
+	}
+	shctx_unlock(shctx_ptr(cache));
 
-			appctx->st0 = HTX_CACHE_INIT;
-			appctx->rule = rule;
-			ctx->entry = res;
-			ctx->next = NULL;
-			ctx->sent = 0;
-			ctx->send_notmodified =
-                                should_send_notmodified_response(cache, htxbuf(&s->req.buf), res);
+	/* The object might have been demoted to the second tier */
+	if (!res && cache->storage && (res = cache_storage_promote(cache, s))) {
+		http_cache_deliver_entry(rule, px, s, res, 0);
+		return ACT_RET_CONT;
+	}
 
-			if (px == strm_fe(s))
-				_HA_ATOMIC_INC(&px->fe_counters.p.http.cache_hits);
-			else
-				_HA_ATOMIC_INC(&px->be_counters.p.http.cache_hits);
-			return ACT_RET_CONT;
-		} else {
-			s->target = NULL;
-			shctx_lock(shctx_ptr(cache));
-			shctx_row_dec_hot(shctx_ptr(cache), entry_block);
-			shctx_unlock(shctx_ptr(cache));
+	/* The same object might already be requested to the server */
+	if (cache->collapse_timeout) {
+		unsigned int avail;
+
+		if (http_cache_collapse(rule, s, flags, &res, &avail) == ACT_RET_YIELD)
+			return ACT_RET_YIELD;
+		if (res) {
+			http_cache_deliver_entry(rule, px, s, res, avail);
 			return ACT_RET_CONT;
 		}
 	}
-	shctx_unlock(shctx_ptr(cache));
 
 	/* Shared context does not need to be locked while we calculate the
 	 * secondary hash. */
@@ -1873,20 +3322,104 @@ enum act_return http_action_req_cache_use(struct act_rule *rule, struct proxy *p
 		 * tells us which fields should be kept (if any). */
 		http_request_prebuild_full_secondary_key(s);
 	}
-	return ACT_RET_CONT;
-}
+	HA_USDT(cache_miss, s, cconf->c.cache, (const char *)txn->cache_hash);
+	return ACT_RET_CONT;
+}
+
+
+enum act_parse_ret parse_cache_use(const char **args, int *orig_arg, struct proxy *proxy,
+                                          struct act_rule *rule, char **err)
+{
+	rule->action       = ACT_CUSTOM;
+	rule->action_ptr   = http_action_req_cache_use;
+
+	if (!parse_cache_rule(proxy, args[*orig_arg], rule, err))
+		return ACT_RET_PRS_ERR;
+
+	(*orig_arg)++;
+	return ACT_RET_PRS_OK;
+}
+
+/* Purges from the cache named by rule->arg.act.p[0] the objects designated by
+ * the sample expression rule->arg.act.p[1], which are either tags or a path
+ * prefix depending on rule->action.
+ */
+static enum act_return http_action_req_cache_purge(struct act_rule *rule, struct proxy *px,
+                                                   struct session *sess, struct stream *s, int flags)
+{
+	struct cache *cache;
+	struct sample *smp;
+
+	cache = cache_find(rule->arg.act.p[0]);
+	if (!cache)
+		return ACT_RET_CONT;
+
+	smp = sample_fetch_as_type(px, sess, s, SMP_OPT_DIR_REQ|SMP_OPT_FINAL, rule->arg.act.p[1], SMP_T_STR);
+	if (smp)
+		cache_purge(cache, rule->action, ist2(smp->data.u.str.area, smp->data.u.str.data));
+	return ACT_RET_CONT;
+}
+
+/* Checks that the cache of a "cache-purge" action exists */
+static int check_cache_purge(struct act_rule *rule, struct proxy *px, char **err)
+{
+	struct cache *cache;
+
+	list_for_each_entry(cache, &caches_config, list) {
+		if (strcmp(cache->id, rule->arg.act.p[0]) == 0)
+			return 1;
+	}
+
+	memprintf(err, "unable to find cache '%s' referenced by cache-purge rule", (char *)rule->arg.act.p[0]);
+	return 0;
+}
+
+static void release_cache_purge(struct act_rule *rule)
+{
+	free(rule->arg.act.p[0]);
+	release_sample_expr(rule->arg.act.p[1]);
+}
+
+/* Parses the "cache-purge <cache> {tag|prefix} <expr>" action */
+enum act_parse_ret parse_cache_purge(const char **args, int *orig_arg, struct proxy *proxy,
+                                     struct act_rule *rule, char **err)
+{
+	struct sample_expr *expr;
+	int cur_arg = *orig_arg;
+
+	if (!*args[cur_arg] || !*args[cur_arg + 1] ||
+	    (strcmp(args[cur_arg + 1], "tag") != 0 && strcmp(args[cur_arg + 1], "prefix") != 0)) {
+		memprintf(err, "expects <cache> followed by 'tag' or 'prefix' and a sample expression");
+		return ACT_RET_PRS_ERR;
+	}
 
+	rule->action = (strcmp(args[cur_arg + 1], "tag") == 0) ? CACHE_PURGE_TAG : CACHE_PURGE_PREFIX;
+	cur_arg += 2;
 
-enum act_parse_ret parse_cache_use(const char **args, int *orig_arg, struct proxy *proxy,
-                                          struct act_rule *rule, char **err)
-{
-	rule->action       = ACT_CUSTOM;
-	rule->action_ptr   = http_action_req_cache_use;
+	expr = sample_parse_expr((char **)args, &cur_arg, proxy->conf.args.file, proxy->conf.args.line,
+	                         err, &proxy->conf.args, NULL);
+	if (!expr)
+		return ACT_RET_PRS_ERR;
 
-	if (!parse_cache_rule(proxy, args[*orig_arg], rule, err))
+	if (!(expr->fetch->val & ((proxy->cap & PR_CAP_FE) ? SMP_VAL_FE_HRQ_HDR : SMP_VAL_BE_HRQ_HDR))) {
+		memprintf(err, "fetch method '%s' extracts information from '%s', none of which is available here",
+		          args[cur_arg - 1], sample_src_names(expr->fetch->use));
+		release_sample_expr(expr);
+		return ACT_RET_PRS_ERR;
+	}
+
+	rule->arg.act.p[0] = strdup(args[*orig_arg]);
+	if (!rule->arg.act.p[0]) {
+		memprintf(err, "out of memory");
+		release_sample_expr(expr);
 		return ACT_RET_PRS_ERR;
+	}
+	rule->arg.act.p[1] = expr;
+	rule->action_ptr   = http_action_req_cache_purge;
+	rule->check_ptr    = check_cache_purge;
+	rule->release_ptr  = release_cache_purge;
 
-	(*orig_arg)++;
+	*orig_arg = cur_arg;
 	return ACT_RET_PRS_OK;
 }
 
@@ -1938,6 +3471,7 @@ int cfg_parse_cache(const char *file, int linenum, char **args, int kwm)
 			tmp_cache_config->maxblocks = 0;
 			tmp_cache_config->maxobjsz = 0;
 			tmp_cache_config->max_secondary_entries = DEFAULT_MAX_SECONDARY_ENTRY;
+			tmp_cache_config->nb_shards = 1;
 		}
 	} else if (strcmp(args[0], "total-max-size") == 0) {
 		unsigned long int maxsize;
@@ -2045,6 +3579,152 @@ int cfg_parse_cache(const char *file, int linenum, char **args, int kwm)
 			goto out;
 		}
 		tmp_cache_config->max_secondary_entries = max_sec_entries;
+	} else if (strcmp(args[0], "collapsed-forwarding") == 0) {
+		const char *res;
+		unsigned int timeout;
+
+		if (alertif_too_many_args(1, file, linenum, args, &err_code)) {
+			err_code |= ERR_ABORT;
+			goto out;
+		}
+
+		if (!*args[1]) {
+			ha_alert("parsing [%s:%d]: '%s' expects a <max-wait> delay.\n",
+				 file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+
+		res = parse_time_err(args[1], &timeout, TIME_UNIT_MS);
+		if (res) {
+			ha_alert("parsing [%s:%d]: %s wrong value '%s'\n",
+			         file, linenum, args[0], args[1]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+		tmp_cache_config->collapse_timeout = timeout;
+	} else if (strcmp(args[0], "shards") == 0) {
+		unsigned int shards;
+		char *err;
+
+		if (alertif_too_many_args(1, file, linenum, args, &err_code)) {
+			err_code |= ERR_ABORT;
+			goto out;
+		}
+
+		shards = strtoul(args[1], &err, 10);
+		if (!*args[1] || err == args[1] || *err != '\0' || !shards || shards > CACHE_MAX_SHARDS) {
+			ha_alert("parsing [%s:%d]: '%s' expects a number of shards between 1 and %d.\n",
+				 file, linenum, args[0], CACHE_MAX_SHARDS);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+		tmp_cache_config->nb_shards = shards;
+	} else if (strcmp(args[0], "tag-header") == 0) {
+		if (alertif_too_many_args(1, file, linenum, args, &err_code)) {
+			err_code |= ERR_ABORT;
+			goto out;
+		}
+
+		if (!*args[1]) {
+			ha_alert("parsing [%s:%d]: '%s' expects a header <name>.\n",
+				 file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+
+		free(tmp_cache_config->tag_hdr);
+		tmp_cache_config->tag_hdr = strdup(args[1]);
+		if (!tmp_cache_config->tag_hdr) {
+			ha_alert("parsing [%s:%d]: out of memory.\n", file, linenum);
+			err_code |= ERR_ALERT | ERR_ABORT;
+			goto out;
+		}
+	} else if (strcmp(args[0], "index-prefixes") == 0) {
+		unsigned int depth;
+		char *err;
+
+		if (alertif_too_many_args(1, file, linenum, args, &err_code)) {
+			err_code |= ERR_ABORT;
+			goto out;
+		}
+
+		depth = strtoul(args[1], &err, 10);
+		if (!*args[1] || err == args[1] || *err != '\0' || depth > HTTP_CACHE_MAX_PREFIXES) {
+			ha_alert("parsing [%s:%d]: '%s' expects a depth between 0 and %d.\n",
+				 file, linenum, args[0], HTTP_CACHE_MAX_PREFIXES);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+		tmp_cache_config->index_prefixes = depth;
+	} else if (strcmp(args[0], "persistent-file") == 0) {
+		if (alertif_too_many_args(1, file, linenum, args, &err_code)) {
+			err_code |= ERR_ABORT;
+			goto out;
+		}
+
+		if (!*args[1]) {
+			ha_alert("parsing [%s:%d]: '%s' expects a <path>.\n",
+				 file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+
+		free(tmp_cache_config->file);
+		tmp_cache_config->file = strdup(args[1]);
+		if (!tmp_cache_config->file) {
+			ha_alert("parsing [%s:%d]: out of memory.\n", file, linenum);
+			err_code |= ERR_ALERT | ERR_ABORT;
+			goto out;
+		}
+	} else if (strcmp(args[0], "secondary-storage") == 0) {
+		unsigned long long size;
+		char *err;
+
+		if (alertif_too_many_args(2, file, linenum, args, &err_code)) {
+			err_code |= ERR_ABORT;
+			goto out;
+		}
+
+		if (!*args[1] || !*args[2]) {
+			ha_alert("parsing [%s:%d]: '%s' expects a <path> and a <megabytes> size.\n",
+				 file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+
+		size = strtoull(args[2], &err, 10);
+		if (err == args[2] || *err != '\0' || !size || size > (SIZE_MAX >> 20)) {
+			ha_alert("parsing [%s:%d]: %s wrong size '%s'\n",
+			         file, linenum, args[0], args[2]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+
+		if (tmp_cache_config->storage) {
+			ha_warning("parsing [%s:%d]: '%s' already specified, only the last one will be used.\n",
+				   file, linenum, args[0]);
+			err_code |= ERR_WARN;
+			free(tmp_cache_config->storage->path);
+		}
+		else {
+			tmp_cache_config->storage = calloc(1, sizeof(*tmp_cache_config->storage));
+			if (!tmp_cache_config->storage) {
+				ha_alert("parsing [%s:%d]: out of memory.\n", file, linenum);
+				err_code |= ERR_ALERT | ERR_ABORT;
+				goto out;
+			}
+			tmp_cache_config->storage->fd = -1;
+		}
+
+		/* size in megabytes */
+		tmp_cache_config->storage->size = size << 20;
+		tmp_cache_config->storage->path = strdup(args[1]);
+		if (!tmp_cache_config->storage->path) {
+			ha_alert("parsing [%s:%d]: out of memory.\n", file, linenum);
+			err_code |= ERR_ALERT | ERR_ABORT;
+			goto out;
+		}
 	}
 	else if (*args[0] != 0) {
 		ha_alert("parsing [%s:%d] : unknown keyword '%s' in 'cache' section\n", file, linenum, args[0]);
@@ -2074,6 +3754,22 @@ int cfg_post_parse_section_cache()
 			tmp_cache_config->maxobjsz =
 				(tmp_cache_config->maxblocks * CACHE_BLOCKSIZE) >> 8;
 		}
+
+		if (tmp_cache_config->nb_shards > 1) {
+			if (tmp_cache_config->file) {
+				ha_alert("\"persistent-file\" is not supported with several \"shards\" for cache '%s'\n", tmp_cache_config->id);
+				err_code |= ERR_FATAL | ERR_ALERT;
+				goto out;
+			}
+
+			/* the total size is split between the shards */
+			tmp_cache_config->maxblocks /= tmp_cache_config->nb_shards;
+			if (tmp_cache_config->maxblocks * CACHE_BLOCKSIZE / 2 < tmp_cache_config->maxobjsz) {
+				ha_alert("\"max-object-size\" is limited to an half of \"total-max-size\" divided by the number of \"shards\" => %u\n", tmp_cache_config->maxblocks * CACHE_BLOCKSIZE / 2);
+				err_code |= ERR_FATAL | ERR_ALERT;
+				goto out;
+			}
+		}
 		else if (tmp_cache_config->maxobjsz > tmp_cache_config->maxblocks * CACHE_BLOCKSIZE / 2) {
 			ha_alert("\"max-object-size\" is limited to an half of \"total-max-size\" => %u\n", tmp_cache_config->maxblocks * CACHE_BLOCKSIZE / 2);
 			err_code |= ERR_FATAL | ERR_ALERT;
@@ -2088,11 +3784,308 @@ int cfg_post_parse_section_cache()
 		return err_code;
 	}
 out:
+	if (tmp_cache_config && tmp_cache_config->storage) {
+		free(tmp_cache_config->storage->path);
+		free(tmp_cache_config->storage);
+	}
+	if (tmp_cache_config) {
+		free(tmp_cache_config->file);
+		free(tmp_cache_config->tag_hdr);
+	}
 	ha_free(&tmp_cache_config);
 	return err_code;
 
 }
 
+/* Creates the file and the mapping of the second tier storage of <cache>. Any
+ * previous file is removed first, so that an old process still using it after
+ * a reload keeps its own copy. Returns 0 on success, otherwise non-zero after
+ * having emitted an alert.
+ */
+static int cache_storage_init(struct cache *cache)
+{
+	struct cache_storage *st = cache->storage;
+
+	if (unlink(st->path) < 0 && errno != ENOENT) {
+		ha_alert("Unable to remove the previous secondary storage file '%s' of cache '%s' (%s).\n",
+		         st->path, cache->id, strerror(errno));
+		return 1;
+	}
+
+	st->fd = open(st->path, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (st->fd < 0) {
+		ha_alert("Unable to create the secondary storage file '%s' of cache '%s' (%s).\n",
+		         st->path, cache->id, strerror(errno));
+		return 1;
+	}
+
+	/* each shard uses its own slice of the file, see cache_storage_init_shard() */
+	if (ftruncate(st->fd, (off_t)st->size * cache->nb_shards) < 0) {
+		ha_alert("Unable to resize the secondary storage file '%s' of cache '%s' (%s).\n",
+		         st->path, cache->id, strerror(errno));
+		return 1;
+	}
+
+	st->area = mmap(NULL, st->size, PROT_READ | PROT_WRITE, MAP_SHARED, st->fd, 0);
+	if (st->area == MAP_FAILED) {
+		st->area = NULL;
+		ha_alert("Unable to map the secondary storage file '%s' of cache '%s' (%s).\n",
+		         st->path, cache->id, strerror(errno));
+		return 1;
+	}
+
+	st->entries = EB_ROOT;
+	LIST_INIT(&st->fifo);
+	return 0;
+}
+
+/* Gives to the shard <shard> its own second tier storage, which is the slice of
+ * the storage file <ref> of the first shard located at the shard's rank. The
+ * file must already have been created by cache_storage_init(). Returns 0 on
+ * success, otherwise non-zero after having emitted an alert.
+ */
+static int cache_storage_init_shard(struct cache *shard, const struct cache_storage *ref)
+{
+	struct cache_storage *st;
+
+	st = shard->storage = calloc(1, sizeof(*st));
+	if (!st || !(st->path = strdup(ref->path))) {
+		ha_alert("Unable to allocate the secondary storage of cache '%s'.\n", shard->id);
+		return 1;
+	}
+
+	st->size = ref->size;
+	st->fd = dup(ref->fd);
+	if (st->fd < 0) {
+		ha_alert("Unable to duplicate the secondary storage file '%s' of cache '%s' (%s).\n",
+		         st->path, shard->id, strerror(errno));
+		return 1;
+	}
+
+	st->area = mmap(NULL, st->size, PROT_READ | PROT_WRITE, MAP_SHARED, st->fd,
+	                (off_t)st->size * shard->shard_id);
+	if (st->area == MAP_FAILED) {
+		st->area = NULL;
+		ha_alert("Unable to map the secondary storage file '%s' of cache '%s' (%s).\n",
+		         st->path, shard->id, strerror(errno));
+		return 1;
+	}
+
+	st->entries = EB_ROOT;
+	LIST_INIT(&st->fifo);
+	return 0;
+}
+
+/* Creates the shards of <cache> after the first one, which is <cache> itself.
+ * Each of them is a copy of <cache> stored in its own shctx. Returns 0 on
+ * success, otherwise non-zero after having emitted an alert.
+ */
+static int cache_init_shards(struct cache *cache)
+{
+	struct shared_context *shctx;
+	struct cache *shard;
+	unsigned int i;
+
+	cache->shards = calloc(cache->nb_shards, sizeof(*cache->shards));
+	if (!cache->shards) {
+		ha_alert("Unable to allocate the shards of cache '%s'.\n", cache->id);
+		return 1;
+	}
+	cache->shards[0] = cache;
+
+	for (i = 1; i < cache->nb_shards; i++) {
+		if (shctx_init(&shctx, cache->maxblocks, CACHE_BLOCKSIZE,
+		               cache->maxobjsz, sizeof(struct cache), 1, -1) <= 0) {
+			ha_alert("Unable to allocate the shards of cache '%s'.\n", cache->id);
+			return 1;
+		}
+		shctx->free_block = cache_free_blocks;
+		shard = (struct cache *)shctx->data;
+		memcpy(shard, cache, sizeof(*shard));
+		shard->shard_id = i;
+		shard->entries = EB_ROOT;
+		shard->pendings = EB_ROOT;
+		shard->index = EB_ROOT;
+		LIST_INIT(&shard->pass_list);
+		LIST_APPEND(&caches, &shard->list);
+		cache->shards[i] = shard;
+
+		if (cache->storage && cache_storage_init_shard(shard, cache->storage))
+			return 1;
+	}
+	return 0;
+}
+
+/* Opens the cache file <path> left by a previous process and maps its <size>
+ * bytes if it contains a shctx compatible with the cache <cache>. The file is
+ * then unlinked so that the previous process keeps using it while a new one
+ * is created at the same place. Returns the previous process' shctx or NULL if
+ * there is none or if its layout does not match, in which case its contents
+ * are discarded.
+ */
+static struct shared_context *cache_file_attach(struct cache *cache, size_t size)
+{
+	struct shared_context *old = NULL;
+	struct cache_file_hdr *hdr;
+	struct stat st;
+	int fd;
+
+	fd = open(cache->file, O_RDWR);
+	if (fd < 0)
+		goto out;
+
+	if (fstat(fd, &st) < 0 || st.st_size != size)
+		goto mismatch;
+
+	old = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (old == MAP_FAILED) {
+		old = NULL;
+		goto mismatch;
+	}
+
+	hdr = &((struct cache *)old->data)->hdr;
+	if (hdr->magic != CACHE_FILE_MAGIC ||
+	    hdr->version != CACHE_FILE_VERSION ||
+	    hdr->shctx_size != sizeof(struct shared_context) ||
+	    hdr->block_size != sizeof(struct shared_block) ||
+	    hdr->cache_size != sizeof(struct cache) ||
+	    hdr->entry_size != sizeof(struct cache_entry) ||
+	    hdr->maxblocks != cache->maxblocks ||
+	    old->block_size != CACHE_BLOCKSIZE) {
+		munmap(old, size);
+		old = NULL;
+		goto mismatch;
+	}
+	goto out;
+
+  mismatch:
+	ha_warning("Discarding the contents of the file '%s' of cache '%s' which was created with another layout.\n",
+		   cache->file, cache->id);
+  out:
+	if (fd >= 0)
+		close(fd);
+	unlink(cache->file);
+	return old;
+}
+
+/* Returns the address in the current mapping of <old> of the pointer <ptr>
+ * which is valid in the process owning the <size> bytes shctx <old>, or NULL
+ * if it is out of the shctx area.
+ */
+static inline void *cache_file_ptr(struct shared_context *old, size_t size, const void *ptr)
+{
+	const char *base = ((struct cache *)old->data)->hdr.base;
+
+	if ((const char *)ptr < base || (const char *)ptr >= base + size)
+		return NULL;
+	return (char *)old + ((const char *)ptr - base);
+}
+
+/* Imports into <cache> the valid objects of the row list <head> of the <size>
+ * bytes shctx <old> of a previous process. The old shctx must be locked. The
+ * rows are walked in the list order, so that the least recently used objects
+ * are evicted first if the cache is smaller. Returns the number of imported
+ * objects, or -1 if the list is corrupted.
+ */
+static int cache_file_import_list(struct cache *cache, struct shared_context *old,
+                                  size_t size, struct list *head)
+{
+	struct shared_context *shctx = shctx_ptr(cache);
+	struct shared_block *first, *block, *new, *dst = NULL;
+	struct cache_entry *object;
+	struct list *elem;
+	unsigned int steps = cache->maxblocks;
+	unsigned int rem, max, count;
+	int imported = 0;
+
+	elem = cache_file_ptr(old, size, head->n);
+	while (elem && elem != head) {
+		first = LIST_ELEM(elem, struct shared_block *, list);
+		object = (struct cache_entry *)first->data;
+		if (!first->block_count || first->block_count > steps)
+			return -1;
+		steps -= first->block_count;
+
+		new = NULL;
+		if (first->len >= sizeof(*object) &&
+		    first->len <= first->block_count * old->block_size &&
+		    object->complete && object->eb.key && object->expire > now.tv_sec) {
+			new = shctx_row_reserve_hot(shctx, NULL, first->len);
+			if (new) {
+				new->len = 0;
+				new->last_append = NULL;
+				dst = new;
+			}
+		}
+
+		/* copy the row block by block while moving to the next one */
+		rem = first->len;
+		block = first;
+		for (count = 0; count < first->block_count; count++) {
+			if (new && rem) {
+				max = MIN(rem, old->block_size);
+				shctx_row_data_append(shctx, new, dst, block->data, max);
+				dst = LIST_NEXT(&dst->list, struct shared_block *, list);
+				rem -= max;
+			}
+			elem = cache_file_ptr(old, size, block->list.n);
+			if (!elem)
+				return -1;
+			if (elem == head && count + 1 < first->block_count)
+				return -1;
+			block = LIST_ELEM(elem, struct shared_block *, list);
+		}
+
+		if (!new)
+			continue;
+
+		object = (struct cache_entry *)new->data;
+		object->index = NULL;
+		if (insert_entry(cache, object) != &object->eb ||
+		    cache_index_attach(cache, object) < 0) {
+			if (object->eb.key)
+				delete_entry(object);
+			new->len = 0;
+			object->eb.key = 0;
+		}
+		else
+			imported++;
+		shctx_row_dec_hot(shctx, new);
+	}
+	return elem ? imported : -1;
+}
+
+/* Imports into <cache> the valid objects of the <size> bytes shctx <old> of
+ * a previous process. The old shctx is locked during the operation so that
+ * the previous process cannot modify it, which is only possible because the
+ * lock is stored in the shared area.
+ */
+static void cache_file_import(struct cache *cache, struct shared_context *old, size_t size)
+{
+	int tries, ret, imported = 0;
+
+	for (tries = 0; HA_SPIN_TRYLOCK(SHCTX_LOCK, &old->lock) != 0; tries++) {
+		if (tries >= 1000) {
+			ha_warning("Unable to lock the file '%s' of cache '%s', its contents are discarded.\n",
+				   cache->file, cache->id);
+			return;
+		}
+		usleep(1000);
+	}
+
+	ret = cache_file_import_list(cache, old, size, &old->avail);
+	if (ret >= 0) {
+		imported += ret;
+		ret = cache_file_import_list(cache, old, size, &old->hot);
+		imported += ret;
+	}
+	HA_SPIN_UNLOCK(SHCTX_LOCK, &old->lock);
+
+	if (ret < 0)
+		ha_warning("The file '%s' of cache '%s' is corrupted, %d objects could be imported.\n",
+			   cache->file, cache->id, imported);
+}
+
 int post_check_cache()
 {
 	struct proxy *px;
@@ -2102,9 +4095,28 @@ int post_check_cache()
 	int err_code = ERR_NONE;
 
 	list_for_each_entry_safe(cache_config, back, &caches_config, list) {
+		struct shared_context *old = NULL;
+		size_t size = 0;
+		int fd = -1;
+
+		if (cache_config->file) {
+			size = shctx_area_size(cache_config->maxblocks, CACHE_BLOCKSIZE, sizeof(struct cache));
+			old = cache_file_attach(cache_config, size);
+			fd = open(cache_config->file, O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (fd < 0) {
+				ha_alert("Unable to create the file '%s' of cache '%s' (%s).\n",
+				         cache_config->file, cache_config->id, strerror(errno));
+				if (old)
+					munmap(old, size);
+				err_code |= ERR_FATAL | ERR_ALERT;
+				goto out;
+			}
+		}
 
 		ret_shctx = shctx_init(&shctx, cache_config->maxblocks, CACHE_BLOCKSIZE,
-		                       cache_config->maxobjsz, sizeof(struct cache), 1);
+		                       cache_config->maxobjsz, sizeof(struct cache), 1, fd);
+		if (fd >= 0)
+			close(fd);
 
 		if (ret_shctx <= 0) {
 			if (ret_shctx == SHCTX_E_INIT_LOCK)
@@ -2112,6 +4124,8 @@ int post_check_cache()
 			else
 				ha_alert("Unable to allocate cache.\n");
 
+			if (old)
+				munmap(old, size);
 			err_code |= ERR_FATAL | ERR_ALERT;
 			goto out;
 		}
@@ -2122,10 +4136,56 @@ int post_check_cache()
 		memcpy(shctx->data, cache_config, sizeof(struct cache));
 		cache = (struct cache *)shctx->data;
 		cache->entries = EB_ROOT;
+		cache->pendings = EB_ROOT;
+		cache->index = EB_ROOT;
+		LIST_INIT(&cache->pass_list);
 		LIST_APPEND(&caches, &cache->list);
 		LIST_DELETE(&cache_config->list);
 		free(cache_config);
 
+		if (cache->storage && cache->nb_shards > 1) {
+			/* the storage is split between the shards, each slice
+			 * must be mapped on its own.
+			 */
+			cache->storage->size /= cache->nb_shards;
+			cache->storage->size &= ~(size_t)(sysconf(_SC_PAGESIZE) - 1);
+			if (!cache->storage->size) {
+				ha_alert("The secondary storage of cache '%s' is too small for %u shards.\n",
+				         cache->id, cache->nb_shards);
+				err_code |= ERR_FATAL | ERR_ALERT;
+				goto out;
+			}
+		}
+
+		if (cache->storage && cache_storage_init(cache)) {
+			if (old)
+				munmap(old, size);
+			err_code |= ERR_FATAL | ERR_ALERT;
+			goto out;
+		}
+
+		if (cache->nb_shards > 1 && cache_init_shards(cache)) {
+			err_code |= ERR_FATAL | ERR_ALERT;
+			goto out;
+		}
+
+		if (old) {
+			cache_file_import(cache, old, size);
+			munmap(old, size);
+		}
+
+		if (cache->file) {
+			/* the file may be imported by the next process */
+			cache->hdr.version    = CACHE_FILE_VERSION;
+			cache->hdr.shctx_size = sizeof(struct shared_context);
+			cache->hdr.block_size = sizeof(struct shared_block);
+			cache->hdr.cache_size = sizeof(struct cache);
+			cache->hdr.entry_size = sizeof(struct cache_entry);
+			cache->hdr.maxblocks  = cache->maxblocks;
+			cache->hdr.base       = shctx;
+			cache->hdr.magic      = CACHE_FILE_MAGIC;
+		}
+
 		/* Find all references for this cache in the existing filters
 		 * (over all proxies) and reference it in matching filters.
 		 */
@@ -2153,6 +4213,37 @@ int post_check_cache()
 
 }
 
+/* Releases the file names and the second tier storage of all caches */
+static void deinit_caches()
+{
+	struct cache_storage_entry *se, *back;
+	struct cache *cache;
+
+	list_for_each_entry(cache, &caches, list) {
+		struct cache_storage *st = cache->storage;
+
+		ha_free(&cache->file);
+		if (!cache->shard_id) {
+			ha_free(&cache->shards);
+			ha_free(&cache->tag_hdr);
+		}
+		if (!st)
+			continue;
+
+		if (st->area) {
+			list_for_each_entry_safe(se, back, &st->fifo, list) {
+				free(se->index);
+				pool_free(pool_head_cache_storage_entry, se);
+			}
+			munmap(st->area, st->size);
+		}
+		if (st->fd >= 0)
+			close(st->fd);
+		free(st->path);
+		ha_free(&cache->storage);
+	}
+}
+
 struct flt_ops cache_ops = {
 	.init   = cache_store_init,
 	.check  = cache_store_check,
@@ -2583,6 +4674,40 @@ parse_cache_flt(char **args, int *cur_arg, struct proxy *px,
 	return -1;
 }
 
+/* Parses "purge cache <name> {tag <tags>|prefix <uri>}" and purges the
+ * matching objects.
+ */
+static int cli_parse_purge_cache(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	enum cache_purge_type type;
+	struct cache *cache;
+	char *msg = NULL;
+	int purged;
+
+	if (!cli_has_level(appctx, ACCESS_LVL_ADMIN))
+		return 1;
+
+	if (!*args[2] || !*args[4])
+		return cli_err(appctx, "Usage: purge cache <name> {tag <tags>|prefix <uri>}\n");
+
+	if (strcmp(args[3], "tag") == 0)
+		type = CACHE_PURGE_TAG;
+	else if (strcmp(args[3], "prefix") == 0)
+		type = CACHE_PURGE_PREFIX;
+	else
+		return cli_err(appctx, "Expects 'tag' or 'prefix'.\n");
+
+	cache = cache_find(args[2]);
+	if (!cache)
+		return cli_err(appctx, "No such cache.\n");
+
+	purged = cache_purge(cache, type, ist(args[4]));
+	if (purged < 0)
+		return cli_dynerr(appctx, memprintf(&msg, "Invalid prefix, or deeper than the %u indexed by this cache.\n",
+		                                    cache->index_prefixes));
+	return cli_dynmsg(appctx, LOG_INFO, memprintf(&msg, "%d objects purged.\n", purged));
+}
+
 /* It reserves a struct show_cache_ctx for the local variables */
 static int cli_parse_show_cache(char **args, char *payload, struct appctx *appctx, void *private)
 {
@@ -2609,7 +4734,19 @@ static int cli_io_handler_show_cache(struct appctx *appctx)
 
 		next_key = ctx->next_key;
 		if (!next_key) {
-			chunk_printf(&trash, "%p: %s (shctx:%p, available blocks:%d)\n", cache, cache->id, shctx_ptr(cache), shctx_ptr(cache)->nbav);
+			chunk_printf(&trash, "%p: %s (shctx:%p, available blocks:%d", cache, cache->id, shctx_ptr(cache), shctx_ptr(cache)->nbav);
+			if (cache->nb_shards > 1)
+				chunk_appendf(&trash, ", shard:%u/%u", cache->shard_id + 1, cache->nb_shards);
+			chunk_appendf(&trash, ")\n");
+			if (cache->storage) {
+				struct cache_storage *st = cache->storage;
+
+				shctx_lock(shctx_ptr(cache));
+				chunk_appendf(&trash, "  secondary storage: %s (size:%llu, used:%llu, objects:%u, demoted:%llu, promoted:%llu)\n",
+				              st->path, (ullong)st->size, (ullong)st->used, st->nb_entries,
+				              st->demoted, st->promoted);
+				shctx_unlock(shctx_ptr(cache));
+			}
 			if (applet_putchk(appctx, &trash) == -1)
 				return 0;
 		}
@@ -2713,6 +4850,7 @@ static struct flt_kw_list filter_kws = { "CACHE", { }, {
 INITCALL1(STG_REGISTER, flt_register_keywords, &filter_kws);
 
 static struct cli_kw_list cli_kws = {{},{
+	{ { "purge", "cache", NULL }, "purge cache <name> tag|prefix <val>     : remove the objects with these tags or under this prefix", cli_parse_purge_cache, NULL, NULL, NULL },
 	{ { "show", "cache", NULL }, "show cache                              : show cache status", cli_parse_show_cache, cli_io_handler_show_cache, NULL, NULL },
 	{{},}
 }};
@@ -2731,6 +4869,7 @@ INITCALL1(STG_REGISTER, http_res_keywords_register, &http_res_actions);
 static struct action_kw_list http_req_actions = {
 	.kw = {
 		{ "cache-use", parse_cache_use },
+		{ "cache-purge", parse_cache_purge },
 		{ NULL, NULL }
 	}
 };
@@ -2747,6 +4886,7 @@ struct applet http_cache_applet = {
 /* config parsers for this section */
 REGISTER_CONFIG_SECTION("cache", cfg_parse_cache, cfg_post_parse_section_cache);
 REGISTER_POST_CHECK(post_check_cache);
+REGISTER_POST_DEINIT(deinit_caches);
 
 
 /* Note: must not be declared <const> as its list will be overwritten */
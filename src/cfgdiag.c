@@ -2,11 +2,14 @@
 #include <stdlib.h>
 
 #include <import/ebistree.h>
+#include <import/ebmbtree.h>
 
 #include <haproxy/cfgdiag.h>
+#include <haproxy/check.h>
 #include <haproxy/log.h>
 #include <haproxy/proxy.h>
 #include <haproxy/server.h>
+#include <haproxy/tools.h>
 
 /* Use this function to emit diagnostic.
  * This can be used as a shortcut to set value pointed by <ret> to 1 at the
@@ -82,6 +85,69 @@ static void check_server_cookies(int *ret)
 	}
 }
 
+/* Checks that health checks are not performed more than once on the same
+ * address and port from different servers. This commonly happens when the
+ * same server appears in multiple backends, in which case only one of them
+ * should run the check and the other ones should use "track" to share its
+ * result. Agent checks and servers without a fixed address are ignored.
+ */
+static void check_server_checks(int *ret)
+{
+	struct check_entry {
+		struct server *srv;
+		struct ebmb_node node;
+		struct sockaddr_storage key; /* storage for node.key */
+	};
+
+	struct proxy  *px;
+	struct server *srv;
+
+	struct eb_root checks_tree = EB_ROOT_UNIQUE;
+	struct check_entry *check_entry;
+	struct ebmb_node *node;
+	struct sockaddr_storage addr;
+
+	for (px = proxies_list; px; px = px->next) {
+		if (px->flags & PR_FL_DISABLED)
+			continue;
+
+		for (srv = px->srv; srv; srv = srv->next) {
+			if (!(srv->check.state & CHK_ST_CONFIGURED) || srv->track)
+				continue;
+
+			memset(&addr, 0, sizeof(addr));
+			if (is_inet_addr(&srv->check.addr))
+				ipcpy(&srv->check.addr, &addr);
+			else if (is_inet_addr(&srv->addr))
+				ipcpy(&srv->addr, &addr);
+			else
+				continue;
+			set_host_port(&addr, srv->check.port ? srv->check.port : srv->svc_port);
+
+			node = ebmb_lookup(&checks_tree, &addr, sizeof(addr));
+			if (node) {
+				check_entry = ebmb_entry(node, struct check_entry, node);
+				diag_warning(ret, "parsing [%s:%d] : 'server %s/%s' : same address and port are already checked by server '%s/%s', consider using 'track' to share its health check result\n",
+				             srv->conf.file, srv->conf.line, px->id, srv->id,
+				             check_entry->srv->proxy->id, check_entry->srv->id);
+				continue;
+			}
+
+			check_entry = diag_alloc(sizeof(*check_entry));
+			check_entry->srv = srv;
+			memcpy(check_entry->node.key, &addr, sizeof(addr));
+			ebmb_insert(&checks_tree, &check_entry->node, sizeof(addr));
+		}
+	}
+
+	/* clear the tree and free its entries */
+	while ((node = ebmb_first(&checks_tree))) {
+		check_entry = ebmb_entry(node, struct check_entry, node);
+		ebmb_delete(node);
+		free(check_entry);
+	}
+}
+
 /* Placeholder to execute various diagnostic checks after the configuration file
  * has been fully parsed. It will output a warning for each diagnostic found.
  *
@@ -92,6 +158,7 @@ int cfg_run_diagnostics()
 	int ret = 0;
 
 	check_server_cookies(&ret);
+	check_server_checks(&ret);
 
 	return ret;
 }
@@ -27,16 +27,18 @@
  */
 static const char *common_kw_list[] = {
 	"global", "daemon", "master-worker", "noepoll", "nokqueue",
-	"noevports", "nopoll", "busy-polling", "set-dumpable",
+	"noevports", "nopoll", "nouring", "busy-polling", "set-dumpable",
 	"insecure-fork-wanted", "insecure-setuid-wanted", "nosplice",
 	"nogetaddrinfo", "noreuseport", "quiet", "zero-warning",
 	"tune.runqueue-depth", "tune.maxpollevents", "tune.maxaccept",
 	"tune.recv_enough", "tune.buffers.limit",
-	"tune.buffers.reserve", "tune.bufsize", "tune.maxrewrite",
+	"tune.buffers.reserve", "tune.bufsize", "tune.bufsize.small", "tune.maxrewrite",
 	"tune.idletimer", "tune.rcvbuf.client", "tune.rcvbuf.server",
-	"tune.sndbuf.client", "tune.sndbuf.server", "tune.pipesize",
+	"tune.sndbuf.client", "tune.sndbuf.server", "tune.pipesize", "tune.pipesize.max",
+	"tune.zerocopy-send-threshold",
 	"tune.http.cookielen", "tune.http.logurilen", "tune.http.maxhdr",
-	"tune.comp.maxlevel", "tune.pattern.cache-size", "uid", "gid",
+	"tune.comp.maxlevel", "tune.pattern.cache-size",
+	"tune.sample.cache-size", "uid", "gid",
 	"external-check", "user", "group", "nbproc", "maxconn",
 	"ssl-server-verify", "maxconnrate", "maxsessrate", "maxsslrate",
 	"maxcomprate", "maxpipes", "maxzlibmem", "maxcompcpuusage", "ulimit-n",
@@ -111,6 +113,11 @@ int cfg_parse_global(const char *file, int linenum, char **args, int kwm)
 			goto out;
 		global.tune.options &= ~GTUNE_USE_POLL;
 	}
+	else if (strcmp(args[0], "nouring") == 0) {
+		if (alertif_too_many_args(0, file, linenum, args, &err_code))
+			goto out;
+		global.tune.options &= ~GTUNE_USE_URING;
+	}
 	else if (strcmp(args[0], "busy-polling") == 0) { /* "no busy-polling" or "busy-polling" */
 		if (alertif_too_many_args(0, file, linenum, args, &err_code))
 			goto out;
@@ -292,6 +299,23 @@ int cfg_parse_global(const char *file, int linenum, char **args, int kwm)
 			goto out;
 		}
 	}
+	else if (strcmp(args[0], "tune.bufsize.small") == 0) {
+		if (alertif_too_many_args(1, file, linenum, args, &err_code))
+			goto out;
+		if (*(args[1]) == 0) {
+			ha_alert("parsing [%s:%d] : '%s' expects an integer argument.\n", file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+		global.tune.bufsize_small = atol(args[1]);
+		/* round it up to support a two-pointer alignment at the end */
+		global.tune.bufsize_small = (global.tune.bufsize_small + 2 * sizeof(void *) - 1) & -(2 * sizeof(void *));
+		if (global.tune.bufsize_small < 1024) {
+			ha_alert("parsing [%s:%d] : '%s' expects a size of at least 1024 bytes.\n", file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+	}
 	else if (strcmp(args[0], "tune.maxrewrite") == 0) {
 		if (alertif_too_many_args(1, file, linenum, args, &err_code))
 			goto out;
@@ -416,6 +440,31 @@ int cfg_parse_global(const char *file, int linenum, char **args, int kwm)
 		}
 		global.tune.pipesize = atol(args[1]);
 	}
+	else if (strcmp(args[0], "tune.pipesize.max") == 0) {
+		if (alertif_too_many_args(1, file, linenum, args, &err_code))
+			goto out;
+		if (*(args[1]) == 0) {
+			ha_alert("parsing [%s:%d] : '%s' expects an integer argument.\n", file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+		global.tune.pipesize_max = atol(args[1]);
+	}
+	else if (strcmp(args[0], "tune.zerocopy-send-threshold") == 0) {
+		if (alertif_too_many_args(1, file, linenum, args, &err_code))
+			goto out;
+		if (*(args[1]) == 0) {
+			ha_alert("parsing [%s:%d] : '%s' expects an integer argument.\n", file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+#ifdef HA_HAVE_MSG_ZEROCOPY
+		global.tune.zerocopy_threshold = atol(args[1]);
+#else
+		ha_warning("parsing [%s:%d] : '%s' is not supported on this platform, ignored.\n", file, linenum, args[0]);
+		err_code |= ERR_WARN;
+#endif
+	}
 	else if (strcmp(args[0], "tune.http.cookielen") == 0) {
 		if (alertif_too_many_args(1, file, linenum, args, &err_code))
 			goto out;
@@ -486,6 +535,16 @@ int cfg_parse_global(const char *file, int linenum, char **args, int kwm)
 			goto out;
 		}
 	}
+	else if (strcmp(args[0], "tune.sample.cache-size") == 0) {
+		if (alertif_too_many_args(1, file, linenum, args, &err_code))
+			goto out;
+		if (*(args[1]) == 0 || (global.tune.sample_cache = atoi(args[1])) < 0) {
+			ha_alert("parsing [%s:%d] : '%s' expects a positive numeric value\n",
+				 file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+	}
 	else if (strcmp(args[0], "cluster-secret") == 0) {
 		if (alertif_too_many_args(1, file, linenum, args, &err_code))
 			goto out;
@@ -1267,7 +1326,20 @@ int cfg_parse_global(const char *file, int linenum, char **args, int kwm)
 		setenv("HAPROXY_LOCALPEER", localpeer, 1);
 	}
 	else if (strcmp(args[0], "numa-cpu-mapping") == 0) {
-		global.numa_cpu_mapping = (kwm == KWM_NO) ? 0 : 1;
+		if (alertif_too_many_args(1, file, linenum, args, &err_code))
+			goto out;
+		if (kwm == KWM_NO)
+			global.numa_cpu_mapping = NUMA_CPU_MAP_NONE;
+		else if (!*args[1] || strcmp(args[1], "first-node") == 0)
+			global.numa_cpu_mapping = NUMA_CPU_MAP_FIRST_NODE;
+		else if (strcmp(args[1], "l3-groups") == 0)
+			global.numa_cpu_mapping = NUMA_CPU_MAP_L3_GROUPS;
+		else {
+			ha_alert("parsing [%s:%d] : '%s' only supports 'first-node' and 'l3-groups' (got '%s').\n",
+				 file, linenum, args[0], args[1]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
 	}
 	else if (strcmp(args[0], "anonkey") == 0) {
 		long long tmp = 0;
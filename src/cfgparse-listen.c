@@ -2618,9 +2618,10 @@ int cfg_parse_listen(const char *file, int linenum, char **args, int kwm)
 	else if (strcmp(args[0], "hash-type") == 0) { /* set hashing method */
 		/**
 		 * The syntax for hash-type config element is
-		 * hash-type {map-based|consistent} [[<algo>] avalanche]
+		 * hash-type {map-based|consistent|rendezvous|maglev} [[<algo>] avalanche]
 		 *
-		 * The default hash function is sdbm for map-based and sdbm+avalanche for consistent.
+		 * The default hash function is sdbm for map-based and sdbm+avalanche for
+		 * the other ones.
 		 */
 		curproxy->lbprm.algo &= ~(BE_LB_HASH_TYPE | BE_LB_HASH_FUNC | BE_LB_HASH_MOD);
 
@@ -2630,6 +2631,12 @@ int cfg_parse_listen(const char *file, int linenum, char **args, int kwm)
 		if (strcmp(args[1], "consistent") == 0) {	/* use consistent hashing */
 			curproxy->lbprm.algo |= BE_LB_HASH_CONS;
 		}
+		else if (strcmp(args[1], "rendezvous") == 0) {	/* use rendezvous hashing */
+			curproxy->lbprm.algo |= BE_LB_HASH_RDV;
+		}
+		else if (strcmp(args[1], "maglev") == 0) {	/* use maglev hashing */
+			curproxy->lbprm.algo |= BE_LB_HASH_MAGLEV;
+		}
 		else if (strcmp(args[1], "map-based") == 0) {	/* use map-based hashing */
 			curproxy->lbprm.algo |= BE_LB_HASH_MAP;
 		}
@@ -2639,7 +2646,7 @@ int cfg_parse_listen(const char *file, int linenum, char **args, int kwm)
 			goto out;
 		}
 		else {
-			ha_alert("parsing [%s:%d] : '%s' only supports 'consistent' and 'map-based'.\n", file, linenum, args[0]);
+			ha_alert("parsing [%s:%d] : '%s' only supports 'consistent', 'rendezvous', 'maglev' and 'map-based'.\n", file, linenum, args[0]);
 			err_code |= ERR_ALERT | ERR_FATAL;
 			goto out;
 		}
@@ -2649,8 +2656,8 @@ int cfg_parse_listen(const char *file, int linenum, char **args, int kwm)
 			/* the default algo is sdbm */
 			curproxy->lbprm.algo |= BE_LB_HFCN_SDBM;
 
-			/* if consistent with no argument, then avalanche modifier is also applied */
-			if ((curproxy->lbprm.algo & BE_LB_HASH_TYPE) == BE_LB_HASH_CONS)
+			/* if not map-based with no argument, then avalanche modifier is also applied */
+			if ((curproxy->lbprm.algo & BE_LB_HASH_TYPE) != BE_LB_HASH_MAP)
 				curproxy->lbprm.algo |= BE_LB_HMOD_AVAL;
 		} else {
 			/* set the hash function */
@@ -7,6 +7,7 @@
 #include <haproxy/listener.h>
 #include <haproxy/proxy-t.h>
 #include <haproxy/quic_cc-t.h>
+#include <haproxy/quic_tp-t.h>
 #include <haproxy/tools.h>
 
 static int bind_parse_quic_force_retry(char **args, int cur_arg, struct proxy *px, struct bind_conf *conf, char **err)
@@ -30,6 +31,8 @@ static int bind_parse_quic_cc_algo(char **args, int cur_arg, struct proxy *px,
 	    cc_algo = &quic_cc_algo_nr;
 	else if (strcmp(args[cur_arg + 1], "cubic") == 0)
 	    cc_algo = &quic_cc_algo_cubic;
+	else if (strcmp(args[cur_arg + 1], "bbr") == 0)
+	    cc_algo = &quic_cc_algo_bbr;
 	else {
 		memprintf(err, "'%s' : unknown control congestion algorithm", args[cur_arg]);
 		return ERR_ALERT | ERR_FATAL;
@@ -70,6 +73,52 @@ static int cfg_parse_quic_tune_socket_owner(char **args, int section_type,
 	return 0;
 }
 
+/* parse "tune.quic.pacing", accepts "on" or "off" */
+static int cfg_parse_quic_tune_pacing(char **args, int section_type,
+                                      struct proxy *curpx,
+                                      const struct proxy *defpx,
+                                      const char *file, int line, char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0) {
+		global.tune.options &= ~GTUNE_QUIC_NO_PACING;
+	}
+	else if (strcmp(args[1], "off") == 0) {
+		global.tune.options |= GTUNE_QUIC_NO_PACING;
+	}
+	else {
+		memprintf(err, "'%s' expects either 'on' or 'off' but got '%s'.", args[0], args[1]);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* parse "tune.quic.socket-steering", accepts "on" or "off" */
+static int cfg_parse_quic_tune_sock_steering(char **args, int section_type,
+                                             struct proxy *curpx,
+                                             const struct proxy *defpx,
+                                             const char *file, int line, char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0) {
+		global.tune.options |= GTUNE_QUIC_SOCK_STEERING;
+	}
+	else if (strcmp(args[1], "off") == 0) {
+		global.tune.options &= ~GTUNE_QUIC_SOCK_STEERING;
+	}
+	else {
+		memprintf(err, "'%s' expects either 'on' or 'off' but got '%s'.", args[0], args[1]);
+		return -1;
+	}
+
+	return 0;
+}
+
 /* Must be used to parse tune.quic.* setting which requires a time
  * as value.
  * Return -1 on alert, or 0 if succeeded.
@@ -106,6 +155,14 @@ static int cfg_parse_quic_time(char **args, int section_type,
 
 	if (strcmp(name + prefix_len, "frontend.max-idle-timeout") == 0)
 		global.tune.quic_frontend_max_idle_timeout = time;
+	else if (strcmp(name + prefix_len, "frontend.max-ack-delay") == 0) {
+		if (time >= QUIC_TP_MAX_ACK_DELAY_LIMIT) {
+			memprintf(err, "'%s' expects a value lower than %lu ms.",
+			          name, QUIC_TP_MAX_ACK_DELAY_LIMIT);
+			return -1;
+		}
+		global.tune.quic_frontend_max_ack_delay = time;
+	}
 	else if (strcmp(name + prefix_len, "backend.max-idle-timeout") == 0)
 		global.tune.quic_backend_max_idle_timeout = time;
 	else {
@@ -116,6 +173,30 @@ static int cfg_parse_quic_time(char **args, int section_type,
 	return 0;
 }
 
+/* Parse "tune.quic.qpack-max-table-capacity" which accepts 0 to disable the
+ * QPACK dynamic table. Return -1 on alert, or 0 if succeeded.
+ */
+static int cfg_parse_quic_tune_qpack_cap(char **args, int section_type,
+                                         struct proxy *curpx,
+                                         const struct proxy *defpx,
+                                         const char *file, int line, char **err)
+{
+	char *end;
+	long arg;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	arg = strtol(args[1], &end, 10);
+	if (!*args[1] || *end || arg < 0 || arg > 65536) {
+		memprintf(err, "'%s' expects an integer between 0 and 65536.", args[0]);
+		return -1;
+	}
+
+	global.tune.quic_qpack_max_table_capacity = arg;
+	return 0;
+}
+
 /* Parse any tune.quic.* setting with strictly positive integer values.
  * Return -1 on alert, or 0 if succeeded.
  */
@@ -140,12 +221,16 @@ static int cfg_parse_quic_tune_setting(char **args, int section_type,
 	}
 
 	suffix = args[0] + prefix_len;
-	if (strcmp(suffix, "frontend.conn-tx-buffers.limit") == 0)
+	if (strcmp(suffix, "frontend.ack-threshold") == 0)
+		global.tune.quic_frontend_ack_threshold = arg;
+	else if (strcmp(suffix, "frontend.conn-tx-buffers.limit") == 0)
 		global.tune.quic_streams_buf = arg;
 	else if (strcmp(suffix, "frontend.max-streams-bidi") == 0)
 		global.tune.quic_frontend_max_streams_bidi = arg;
 	else if (strcmp(suffix, "retry-threshold") == 0)
 		global.tune.quic_retry_threshold = arg;
+	else if (strcmp(suffix, "retry-rate") == 0)
+		global.tune.quic_retry_rate = arg;
 	else {
 		memprintf(err, "'%s' keyword not unhandled (please report this bug).", args[0]);
 		return -1;
@@ -157,10 +242,16 @@ static int cfg_parse_quic_tune_setting(char **args, int section_type,
 static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "tune.quic.socket-owner", cfg_parse_quic_tune_socket_owner },
 	{ CFG_GLOBAL, "tune.quic.backend.max-idle-timeou", cfg_parse_quic_time },
+	{ CFG_GLOBAL, "tune.quic.frontend.ack-threshold", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.frontend.conn-tx-buffers.limit", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.frontend.max-streams-bidi", cfg_parse_quic_tune_setting },
+	{ CFG_GLOBAL, "tune.quic.frontend.max-ack-delay", cfg_parse_quic_time },
 	{ CFG_GLOBAL, "tune.quic.frontend.max-idle-timeout", cfg_parse_quic_time },
+	{ CFG_GLOBAL, "tune.quic.pacing", cfg_parse_quic_tune_pacing },
+	{ CFG_GLOBAL, "tune.quic.qpack-max-table-capacity", cfg_parse_quic_tune_qpack_cap },
+	{ CFG_GLOBAL, "tune.quic.retry-rate", cfg_parse_quic_tune_setting },
 	{ CFG_GLOBAL, "tune.quic.retry-threshold", cfg_parse_quic_tune_setting },
+	{ CFG_GLOBAL, "tune.quic.socket-steering", cfg_parse_quic_tune_sock_steering },
 	{ 0, NULL, NULL }
 }};
 
@@ -137,6 +137,38 @@ static int ssl_parse_global_ssl_async(char **args, int section_type, struct prox
 #endif
 }
 
+/* parse the "tune.ssl.offload-threads" keyword in global section.
+ * Returns <0 on alert, >0 on warning, 0 on success.
+ */
+static int ssl_parse_global_offload_threads(char **args, int section_type, struct proxy *curpx,
+                                            const struct proxy *defpx, const char *file, int line,
+                                            char **err)
+{
+#ifdef HAVE_SSL_OFFLOAD
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (*(args[1]) == 0) {
+		memprintf(err, "'%s' expects a number of threads as argument.", args[0]);
+		return -1;
+	}
+
+	global_ssl.offload_threads = atoi(args[1]);
+	if (global_ssl.offload_threads < 0 || global_ssl.offload_threads > MAX_THREADS) {
+		memprintf(err, "'%s' expects a number of threads between 0 and %d.", args[0], MAX_THREADS);
+		return -1;
+	}
+
+	/* the operations are offloaded from within async jobs */
+	if (global_ssl.offload_threads)
+		global_ssl.async = 1;
+	return 0;
+#else
+	memprintf(err, "'%s': not supported with this openssl library or without threads support", args[0]);
+	return -1;
+#endif
+}
+
 #if defined(USE_ENGINE) && !defined(OPENSSL_NO_ENGINE)
 /* parse the "ssl-engine" keyword in global section.
  * Returns <0 on alert, >0 on warning, 0 on success.
@@ -332,6 +364,13 @@ static int ssl_parse_global_int(char **args, int section_type, struct proxy *cur
 		target = (int *)&global_ssl.hard_max_record;
 	else if (strcmp(args[0], "tune.ssl.ssl-ctx-cache-size") == 0)
 		target = &global_ssl.ctx_cache;
+	else if (strcmp(args[0], "tune.ssl.lazy-load") == 0) {
+#ifndef HAVE_SSL_CLIENT_HELLO_CB
+		memprintf(err, "'%s' is not supported by your SSL library (ClientHello callback required).", args[0]);
+		return -1;
+#endif
+		target = &global_ssl.lazy_load;
+	}
 	else if (strcmp(args[0], "maxsslconn") == 0)
 		target = &global.maxsslconn;
 	else if (strcmp(args[0], "tune.ssl.capture-buffer-size") == 0)
@@ -445,6 +484,31 @@ static int ssl_parse_global_private_cache(char **args, int section_type, struct
 	return 0;
 }
 
+/* parse "tune.ssl.cache-table".
+ * Returns <0 on alert, >0 on warning, 0 on success.
+ */
+static int ssl_parse_global_cache_table(char **args, int section_type, struct proxy *curpx,
+                                        const struct proxy *defpx, const char *file, int line,
+                                        char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (*(args[1]) == 0) {
+		memprintf(err, "'%s' expects a stick-table name as argument.", args[0]);
+		return -1;
+	}
+
+	/* the table is resolved by ssl_sess_table_init() */
+	ha_free(&global_ssl.cache_table);
+	global_ssl.cache_table = strdup(args[1]);
+	if (!global_ssl.cache_table) {
+		memprintf(err, "Out of memory error.");
+		return -1;
+	}
+	return 0;
+}
+
 /* parse "ssl.lifetime".
  * Returns <0 on alert, >0 on warning, 0 on success.
  */
@@ -452,17 +516,25 @@ static int ssl_parse_global_lifetime(char **args, int section_type, struct proxy
                                      const struct proxy *defpx, const char *file, int line,
                                      char **err)
 {
+	unsigned int *target = &global_ssl.life_time;
 	const char *res;
 
 	if (too_many_args(1, args, err, NULL))
 		return -1;
 
+	if (strcmp(args[0], "tune.ssl.ticket-keys-rotation") == 0)
+		target = &global_ssl.ticket_keys_rotation;
+	else if (strcmp(args[0], "tune.ssl.ocsp-update.mindelay") == 0)
+		target = &global_ssl.ocsp_update_min_delay;
+	else if (strcmp(args[0], "tune.ssl.ocsp-update.maxdelay") == 0)
+		target = &global_ssl.ocsp_update_max_delay;
+
 	if (*(args[1]) == 0) {
-		memprintf(err, "'%s' expects ssl sessions <lifetime> in seconds as argument.", args[0]);
+		memprintf(err, "'%s' expects a time in seconds as argument.", args[0]);
 		return -1;
 	}
 
-	res = parse_time_err(args[1], &global_ssl.life_time, TIME_UNIT_S);
+	res = parse_time_err(args[1], target, TIME_UNIT_S);
 	if (res == PARSE_TIME_OVER) {
 		memprintf(err, "timer overflow in argument '%s' to <%s> (maximum value is 2147483647 s or ~68 years).",
 			  args[1], args[0]);
@@ -603,6 +675,25 @@ static int ssl_parse_global_extra_noext(char **args, int section_type, struct pr
 	return 0;
 }
 
+/* parse 'ocsp-update.mode' */
+static int ssl_parse_global_ocsp_update(char **args, int section_type, struct proxy *curpx,
+                                        const struct proxy *defpx, const char *file, int line,
+                                        char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0)
+		global_ssl.ocsp_update = 1;
+	else if (strcmp(args[1], "off") == 0)
+		global_ssl.ocsp_update = 0;
+	else {
+		memprintf(err, "'%s' expects 'on' or 'off' as argument.", args[0]);
+		return -1;
+	}
+	return 0;
+}
+
 /***************************** Bind keyword Parsing ********************************************/
 
 /* for ca-file and ca-verify-file */
@@ -995,6 +1086,23 @@ static int bind_parse_allow_0rtt(char **args, int cur_arg, struct proxy *px, str
 	return 0;
 }
 
+/* parse the "0rtt-anti-replay" bind keyword */
+static int bind_parse_0rtt_anti_replay(char **args, int cur_arg, struct proxy *px, struct bind_conf *conf, char **err)
+{
+	if (!*args[cur_arg + 1]) {
+		memprintf(err, "'%s' : missing stick-table name", args[cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	free(conf->early_data_table_name);
+	conf->early_data_table_name = strdup(args[cur_arg + 1]);
+	if (!conf->early_data_table_name) {
+		memprintf(err, "'%s' : out of memory", args[cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+	return 0;
+}
+
 /* parse the "npn" bind keyword */
 static int ssl_bind_parse_npn(char **args, int cur_arg, struct proxy *px, struct ssl_bind_conf *conf, int from_cli, char **err)
 {
@@ -1200,6 +1308,11 @@ static int bind_parse_tls_ticket_keys(char **args, int cur_arg, struct proxy *px
 		goto fail;
 	}
 
+	if (conf->keys_ref && conf->keys_ref->table_name) {
+		memprintf(err, "'%s' : cannot be combined with 'tls-ticket-keys-table'", args[cur_arg]);
+		goto fail;
+	}
+
 	keys_ref = tlskeys_ref_lookup(args[cur_arg + 1]);
 	if (keys_ref) {
 		keys_ref->refcount++;
@@ -1297,6 +1410,79 @@ static int bind_parse_tls_ticket_keys(char **args, int cur_arg, struct proxy *px
 #endif /* SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB */
 }
 
+/* parse the "tls-ticket-keys-table" bind keyword */
+static int bind_parse_tls_ticket_keys_table(char **args, int cur_arg, struct proxy *px, struct bind_conf *conf, char **err)
+{
+#if (defined SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB && TLS_TICKETS_NO > 0)
+	struct tls_keys_ref *keys_ref = NULL;
+	char *name = NULL;
+
+	if (!*args[cur_arg + 1]) {
+		memprintf(err, "'%s' : missing stick-table name", args[cur_arg]);
+		goto fail;
+	}
+
+	if (conf->keys_ref) {
+		memprintf(err, "'%s' : TLS ticket keys were already set on this line", args[cur_arg]);
+		goto fail;
+	}
+
+	/* the reference is named after the table for the CLI */
+	memprintf(&name, "table:%s", args[cur_arg + 1]);
+	if (!name) {
+		memprintf(err, "'%s' : allocation error", args[cur_arg+1]);
+		goto fail;
+	}
+
+	keys_ref = tlskeys_ref_lookup(name);
+	if (keys_ref) {
+		free(name);
+		keys_ref->refcount++;
+		conf->keys_ref = keys_ref;
+		return 0;
+	}
+
+	keys_ref = calloc(1, sizeof(*keys_ref));
+	if (!keys_ref) {
+		memprintf(err, "'%s' : allocation error", args[cur_arg+1]);
+		goto fail;
+	}
+
+	keys_ref->filename = name;
+	name = NULL;
+	keys_ref->tlskeys = calloc(TLS_TICKETS_NO, sizeof(union tls_sess_key));
+	keys_ref->table_name = strdup(args[cur_arg + 1]);
+	if (!keys_ref->tlskeys || !keys_ref->table_name) {
+		memprintf(err, "'%s' : allocation error", args[cur_arg+1]);
+		goto fail;
+	}
+
+	/* the table and the keys are resolved by tlskeys_finalize_config() */
+	keys_ref->unique_id = -1;
+	keys_ref->refcount = 1;
+	HA_RWLOCK_INIT(&keys_ref->lock);
+	conf->keys_ref = keys_ref;
+
+	LIST_INSERT(&tlskeys_reference, &keys_ref->list);
+
+	return 0;
+
+  fail:
+	free(name);
+	if (keys_ref) {
+		free(keys_ref->filename);
+		free(keys_ref->table_name);
+		free(keys_ref->tlskeys);
+		free(keys_ref);
+	}
+	return ERR_ALERT | ERR_FATAL;
+
+#else
+	memprintf(err, "'%s' : TLS ticket callback extension not supported", args[cur_arg]);
+	return ERR_ALERT | ERR_FATAL;
+#endif /* SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB */
+}
+
 /* parse the "verify" bind keyword */
 static int ssl_bind_parse_verify(char **args, int cur_arg, struct proxy *px, struct ssl_bind_conf *conf, int from_cli, char **err)
 {
@@ -1324,6 +1510,15 @@ static int bind_parse_verify(char **args, int cur_arg, struct proxy *px, struct
 	return ssl_bind_parse_verify(args, cur_arg, px, &conf->ssl_conf, 0, err);
 }
 
+#ifdef HAVE_SSL_KTLS
+/* parse the "ktls" bind keyword */
+static int bind_parse_ktls(char **args, int cur_arg, struct proxy *px, struct bind_conf *conf, char **err)
+{
+	conf->ssl_options |= BC_SSL_O_KTLS;
+	return 0;
+}
+#endif
+
 /* parse the "no-ca-names" bind keyword */
 static int ssl_bind_parse_no_ca_names(char **args, int cur_arg, struct proxy *px, struct ssl_bind_conf *conf, int from_cli, char **err)
 {
@@ -1644,6 +1839,22 @@ static int srv_parse_allow_0rtt(char **args, int *cur_arg, struct proxy *px, str
 	return 0;
 }
 
+#ifdef HAVE_SSL_KTLS
+/* parse the "ktls" server keyword */
+static int srv_parse_ktls(char **args, int *cur_arg, struct proxy *px, struct server *newsrv, char **err)
+{
+	newsrv->ssl_ctx.options |= SRV_SSL_O_KTLS;
+	return 0;
+}
+
+/* parse the "no-ktls" server keyword */
+static int srv_parse_no_ktls(char **args, int *cur_arg, struct proxy *px, struct server *newsrv, char **err)
+{
+	newsrv->ssl_ctx.options &= ~SRV_SSL_O_KTLS;
+	return 0;
+}
+#endif
+
 /* parse the "no-ssl-reuse" server keyword */
 static int srv_parse_no_ssl_reuse(char **args, int *cur_arg, struct proxy *px, struct server *newsrv, char **err)
 {
@@ -1651,6 +1862,13 @@ static int srv_parse_no_ssl_reuse(char **args, int *cur_arg, struct proxy *px, s
 	return 0;
 }
 
+/* parse the "no-ssl-sess-share" server keyword */
+static int srv_parse_no_ssl_sess_share(char **args, int *cur_arg, struct proxy *px, struct server *newsrv, char **err)
+{
+	newsrv->ssl_ctx.options &= ~SRV_SSL_O_SHARE_SESS;
+	return 0;
+}
+
 /* parse the "no-tls-tickets" server keyword */
 static int srv_parse_no_tls_tickets(char **args, int *cur_arg, struct proxy *px, struct server *newsrv, char **err)
 {
@@ -1719,6 +1937,13 @@ static int srv_parse_ssl_reuse(char **args, int *cur_arg, struct proxy *px, stru
 	return 0;
 }
 
+/* parse the "ssl-sess-share" server keyword */
+static int srv_parse_ssl_sess_share(char **args, int *cur_arg, struct proxy *px, struct server *newsrv, char **err)
+{
+	newsrv->ssl_ctx.options |= SRV_SSL_O_SHARE_SESS;
+	return 0;
+}
+
 /* parse the "tls-tickets" server keyword */
 static int srv_parse_tls_tickets(char **args, int *cur_arg, struct proxy *px, struct server *newsrv, char **err)
 {
@@ -1906,6 +2131,7 @@ struct ssl_bind_kw ssl_bind_kws[] = {
 /* no initcall for ssl_bind_kws, these ones are parsed in the parser loop */
 
 static struct bind_kw_list bind_kws = { "SSL", { }, {
+	{ "0rtt-anti-replay",      bind_parse_0rtt_anti_replay,   1 }, /* reject replayed 0RTT using a stick-table */
 	{ "allow-0rtt",            bind_parse_allow_0rtt,         0 }, /* Allow 0RTT */
 	{ "alpn",                  bind_parse_alpn,               1 }, /* set ALPN supported protocols */
 	{ "ca-file",               bind_parse_ca_file,            1 }, /* set CAfile to process ca-names and verify on client cert */
@@ -1929,6 +2155,11 @@ static struct bind_kw_list bind_kws = { "SSL", { }, {
 	{ "force-tlsv12",          bind_parse_tls_method_options, 0 }, /* force TLSv12 */
 	{ "force-tlsv13",          bind_parse_tls_method_options, 0 }, /* force TLSv13 */
 	{ "generate-certificates", bind_parse_generate_certs,     0 }, /* enable the server certificates generation */
+#ifdef HAVE_SSL_KTLS
+	{ "ktls",                  bind_parse_ktls,               0 }, /* offload records encryption to the kernel */
+#else
+	{ "ktls",                  NULL,                          0 }, /* offload records encryption to the kernel */
+#endif
 	{ "no-ca-names",           bind_parse_no_ca_names,        0 }, /* do not send ca names to clients (ca_file related) */
 	{ "no-sslv3",              bind_parse_tls_method_options, 0 }, /* disable SSLv3 */
 	{ "no-tlsv10",             bind_parse_tls_method_options, 0 }, /* disable TLSv10 */
@@ -1941,6 +2172,7 @@ static struct bind_kw_list bind_kws = { "SSL", { }, {
 	{ "ssl-max-ver",           bind_parse_tls_method_minmax,  1 }, /* maximum version */
 	{ "strict-sni",            bind_parse_strict_sni,         0 }, /* refuse negotiation if sni doesn't match a certificate */
 	{ "tls-ticket-keys",       bind_parse_tls_ticket_keys,    1 }, /* set file to load TLS ticket keys from */
+	{ "tls-ticket-keys-table", bind_parse_tls_ticket_keys_table, 1 }, /* share TLS ticket keys through a stick-table */
 	{ "verify",                bind_parse_verify,             1 }, /* set SSL verify method */
 	{ "npn",                   bind_parse_npn,                1 }, /* set NPN supported protocols */
 	{ "prefer-client-ciphers", bind_parse_pcc,                0 }, /* prefer client ciphers */
@@ -1974,11 +2206,22 @@ static struct srv_kw_list srv_kws = { "SSL", { }, {
 	{ "force-tlsv11",            srv_parse_tls_method_options, 0, 1, 1 }, /* force TLSv11 */
 	{ "force-tlsv12",            srv_parse_tls_method_options, 0, 1, 1 }, /* force TLSv12 */
 	{ "force-tlsv13",            srv_parse_tls_method_options, 0, 1, 1 }, /* force TLSv13 */
+#ifdef HAVE_SSL_KTLS
+	{ "ktls",                    srv_parse_ktls,               0, 1, 1 }, /* offload records encryption to the kernel */
+#else
+	{ "ktls",                    NULL,                         0, 1, 1 }, /* offload records encryption to the kernel */
+#endif
 	{ "no-check-ssl",            srv_parse_no_check_ssl,       0, 1, 0 }, /* disable SSL for health checks */
+#ifdef HAVE_SSL_KTLS
+	{ "no-ktls",                 srv_parse_no_ktls,            0, 1, 0 }, /* disable kernel TLS offload */
+#else
+	{ "no-ktls",                 NULL,                         0, 1, 0 }, /* disable kernel TLS offload */
+#endif
 	{ "no-send-proxy-v2-ssl",    srv_parse_no_send_proxy_ssl,  0, 1, 0 }, /* do not send PROXY protocol header v2 with SSL info */
 	{ "no-send-proxy-v2-ssl-cn", srv_parse_no_send_proxy_cn,   0, 1, 0 }, /* do not send PROXY protocol header v2 with CN */
 	{ "no-ssl",                  srv_parse_no_ssl,             0, 1, 0 }, /* disable SSL processing */
 	{ "no-ssl-reuse",            srv_parse_no_ssl_reuse,       0, 1, 1 }, /* disable session reuse */
+	{ "no-ssl-sess-share",       srv_parse_no_ssl_sess_share,  0, 1, 1 }, /* disable session sharing between threads */
 	{ "no-sslv3",                srv_parse_tls_method_options, 0, 0, 1 }, /* disable SSLv3 */
 	{ "no-tlsv10",               srv_parse_tls_method_options, 0, 0, 1 }, /* disable TLSv10 */
 	{ "no-tlsv11",               srv_parse_tls_method_options, 0, 0, 1 }, /* disable TLSv11 */
@@ -1993,6 +2236,7 @@ static struct srv_kw_list srv_kws = { "SSL", { }, {
 	{ "ssl-min-ver",             srv_parse_tls_method_minmax,  1, 1, 1 }, /* minimum version */
 	{ "ssl-max-ver",             srv_parse_tls_method_minmax,  1, 1, 1 }, /* maximum version */
 	{ "ssl-reuse",               srv_parse_ssl_reuse,          0, 1, 0 }, /* enable session reuse */
+	{ "ssl-sess-share",          srv_parse_ssl_sess_share,     0, 1, 1 }, /* share sessions between threads */
 	{ "tls-tickets",             srv_parse_tls_tickets,        0, 1, 1 }, /* enable session resumption tickets */
 	{ "verify",                  srv_parse_verify,             1, 1, 1 }, /* set SSL verify method */
 	{ "verifyhost",              srv_parse_verifyhost,         1, 1, 1 }, /* require that SSL cert verifies for hostname */
@@ -2022,17 +2266,24 @@ static struct cfg_kw_list cfg_kws = {ILH, {
 #endif
 	{ CFG_GLOBAL, "ssl-skip-self-issued-ca", ssl_parse_skip_self_issued_ca },
 	{ CFG_GLOBAL, "tune.ssl.cachesize", ssl_parse_global_int },
+	{ CFG_GLOBAL, "tune.ssl.cache-table", ssl_parse_global_cache_table },
 #ifndef OPENSSL_NO_DH
 	{ CFG_GLOBAL, "tune.ssl.default-dh-param", ssl_parse_global_default_dh },
 #endif
 	{ CFG_GLOBAL, "tune.ssl.force-private-cache",  ssl_parse_global_private_cache },
 	{ CFG_GLOBAL, "tune.ssl.lifetime", ssl_parse_global_lifetime },
 	{ CFG_GLOBAL, "tune.ssl.maxrecord", ssl_parse_global_int },
+	{ CFG_GLOBAL, "tune.ssl.offload-threads", ssl_parse_global_offload_threads },
 	{ CFG_GLOBAL, "tune.ssl.hard-maxrecord", ssl_parse_global_int },
 	{ CFG_GLOBAL, "tune.ssl.ssl-ctx-cache-size", ssl_parse_global_int },
+	{ CFG_GLOBAL, "tune.ssl.lazy-load", ssl_parse_global_int },
 	{ CFG_GLOBAL, "tune.ssl.capture-cipherlist-size", ssl_parse_global_capture_buffer },
 	{ CFG_GLOBAL, "tune.ssl.capture-buffer-size", ssl_parse_global_capture_buffer },
 	{ CFG_GLOBAL, "tune.ssl.keylog", ssl_parse_global_keylog },
+	{ CFG_GLOBAL, "tune.ssl.ticket-keys-rotation", ssl_parse_global_lifetime },
+	{ CFG_GLOBAL, "tune.ssl.ocsp-update.mindelay", ssl_parse_global_lifetime },
+	{ CFG_GLOBAL, "tune.ssl.ocsp-update.maxdelay", ssl_parse_global_lifetime },
+	{ CFG_GLOBAL, "ocsp-update.mode", ssl_parse_global_ocsp_update },
 	{ CFG_GLOBAL, "ssl-default-bind-ciphers", ssl_parse_global_ciphers },
 	{ CFG_GLOBAL, "ssl-default-server-ciphers", ssl_parse_global_ciphers },
 #if defined(SSL_CTX_set1_curves_list)
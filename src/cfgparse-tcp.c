@@ -51,6 +51,15 @@ static int bind_parse_v6only(char **args, int cur_arg, struct proxy *px, struct
 }
 #endif
 
+#ifdef SO_INCOMING_CPU
+/* parse the "incoming-cpu" bind keyword */
+static int bind_parse_incoming_cpu(char **args, int cur_arg, struct proxy *px, struct bind_conf *conf, char **err)
+{
+	conf->settings.options |= RX_O_INCOMING_CPU;
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_HAP_TRANSPARENT
 /* parse the "transparent" bind keyword */
 static int bind_parse_transparent(char **args, int cur_arg, struct proxy *px, struct bind_conf *conf, char **err)
@@ -245,6 +254,9 @@ static struct bind_kw_list bind_kws = { "TCP", { }, {
 #if defined(TCP_DEFER_ACCEPT) || defined(SO_ACCEPTFILTER)
 	{ "defer-accept",  bind_parse_defer_accept, 0 }, /* wait for some data for 1 second max before doing accept */
 #endif
+#ifdef SO_INCOMING_CPU
+	{ "incoming-cpu",  bind_parse_incoming_cpu, 0 }, /* advertise the shard's CPU to the system */
+#endif
 #ifdef SO_BINDTODEVICE
 	{ "interface",     bind_parse_interface,    1 }, /* specifically bind to this interface */
 #endif
@@ -269,6 +281,7 @@ static struct bind_kw_list bind_kws = { "TCP", { }, {
 #endif
 	/* the versions with the NULL parse function*/
 	{ "defer-accept",  NULL,  0 },
+	{ "incoming-cpu",  NULL,  0 },
 	{ "interface",     NULL,  1 },
 	{ "mss",           NULL,  1 },
 	{ "transparent",   NULL,  0 },
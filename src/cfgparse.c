@@ -63,7 +63,9 @@
 #include <haproxy/lb_fas.h>
 #include <haproxy/lb_fwlc.h>
 #include <haproxy/lb_fwrr.h>
+#include <haproxy/lb_maglev.h>
 #include <haproxy/lb_map.h>
+#include <haproxy/lb_rdv.h>
 #include <haproxy/listener.h>
 #include <haproxy/log.h>
 #include <haproxy/sink.h>
@@ -105,6 +107,7 @@ int cfg_maxpconn = 0;                   /* # of simultaneous connections per pro
 int cfg_maxconn = 0;			/* # of simultaneous connections, (-n) */
 char *cfg_scope = NULL;                 /* the current scope during the configuration parsing */
 int non_global_section_parsed = 0;
+static int auto_l3_groups = 0;          /* thread groups were created per L3 cache domain */
 
 /* how to handle default paths */
 static enum default_path_mode {
@@ -653,7 +656,7 @@ static struct peer *cfg_peers_add_peer(struct peers *peers,
 	}
 
 	/* the peers are linked backwards first */
-	peers->count++;
+	p->idx = peers->count++;
 	p->peers = peers;
 	p->next = peers->remote;
 	peers->remote = p;
@@ -1732,6 +1735,8 @@ int readcfgfile(const char *file)
 	FILE *f = NULL;
 	int linenum = 0;
 	int err_code = 0;
+	struct startup_prof sect_prof;
+	char *sect_desc = NULL;
 	struct cfg_section *cs = NULL, *pcs = NULL;
 	struct cfg_section *ics;
 	int readbytes = 0;
@@ -2448,6 +2453,12 @@ int readcfgfile(const char *file)
 		/* detect section start */
 		list_for_each_entry(ics, &sections, list) {
 			if (strcmp(args[0], ics->section_name) == 0) {
+				if (global.mode & MODE_DUMP_TIMES) {
+					if (sect_desc)
+						startup_prof_report(&sect_prof, 0, "section %s", sect_desc);
+					memprintf(&sect_desc, "%s '%s' at [%s:%d]", args[0], args[1], file, linenum);
+					startup_prof_start(&sect_prof);
+				}
 				cursection = ics->section_name;
 				pcs = cs;
 				cs = ics;
@@ -2498,6 +2509,9 @@ int readcfgfile(const char *file)
 	if (cs && cs->post_section_parser)
 		err_code |= cs->post_section_parser();
 
+	if (sect_desc)
+		startup_prof_report(&sect_prof, 0, "section %s", sect_desc);
+
 	if (nested_cond_lvl) {
 		ha_alert("parsing [%s:%d]: non-terminated '.if' block.\n", file, linenum);
 		err_code |= ERR_ALERT | ERR_FATAL | ERR_ABORT;
@@ -2509,6 +2523,7 @@ int readcfgfile(const char *file)
 	}
 
 err:
+	ha_free(&sect_desc);
 	ha_free(&cfg_scope);
 	cursection = NULL;
 	free(thisline);
@@ -2685,6 +2700,189 @@ static int numa_detect_topology()
 	return ha_cpuset_count(&node_cpu_set);
 }
 
+/* Reads into <set> the map of CPUs sharing the L3 cache with CPU <cpu>.
+ * Returns 0 on success, otherwise non-zero.
+ */
+static int read_cpu_l3_map(int cpu, struct hap_cpuset *set)
+{
+	char path[PATH_MAX];
+	int idx;
+
+	for (idx = 0; idx < 16; idx++) {
+		snprintf(path, PATH_MAX, "%s/cpu/cpu%d/cache/index%d/level",
+		         NUMA_DETECT_SYSTEM_SYSFS_PATH, cpu, idx);
+		if (read_file_to_trash(path))
+			break;
+
+		if (atoi(trash.area) != 3)
+			continue;
+
+		snprintf(path, PATH_MAX, "%s/cpu/cpu%d/cache/index%d/shared_cpu_map",
+		         NUMA_DETECT_SYSTEM_SYSFS_PATH, cpu, idx);
+		if (read_file_to_trash(path))
+			break;
+
+		parse_cpumap(trash.area, set);
+		return 0;
+	}
+	return 1;
+}
+
+/* Moves at most <count> of the lowest CPUs of <src> to <dst>, which is reset
+ * first. Returns the number of CPUs moved.
+ */
+static int cpuset_move_lowest(struct hap_cpuset *dst, struct hap_cpuset *src, int count)
+{
+	int cpu, moved = 0;
+
+	ha_cpuset_zero(dst);
+	while (moved < count && (cpu = ha_cpuset_ffs(src))) {
+		ha_cpuset_clr(src, cpu - 1);
+		ha_cpuset_set(dst, cpu - 1);
+		moved++;
+	}
+	return moved;
+}
+
+/* Returns non-zero if a "cpu-map" directive was found in the configuration */
+static int cpu_map_configured()
+{
+	int g, t;
+
+	for (g = 0; g < MAX_TGROUPS; g++) {
+		if (ha_cpuset_count(&cpu_map[g].proc) || ha_cpuset_count(&cpu_map[g].proc_t1))
+			return 1;
+		for (t = 0; t < MAX_THREADS_PER_GROUP; t++) {
+			if (ha_cpuset_count(&cpu_map[g].thread[t]))
+				return 1;
+		}
+	}
+	return 0;
+}
+
+/* Inspect the cache topology of the machine on startup and create one thread
+ * group per set of CPUs sharing the same L3 cache, on all nodes. Each thread is
+ * bound to its own CPU, so that threads sharing their data through the thread
+ * group structures also share the same L3 cache. Adjacent domains are merged
+ * if there are more of them than MAX_TGROUPS, and CPUs beyond MAX_THREADS are
+ * ignored. This is only called for "numa-cpu-mapping l3-groups" if none of
+ * "nbthread", "thread-groups", "thread-group" or "cpu-map" is set and if the
+ * process affinity is not restricted.
+ *
+ * Returns the count of threads created. If the topology is unknown, an error
+ * occurred, or a single L3 domain was found, 0 is returned and nothing is
+ * changed.
+ */
+static int numa_detect_l3_groups()
+{
+	struct hap_cpuset active_cpus, todo, l3_map, tmp;
+	struct hap_cpuset *domains;
+	const char *parse_cpu_set_args[2];
+	char *err = NULL;
+	int nbdom = 0, nbcpu = 0;
+	int cpu, g, t, i;
+
+	/* read and parse the list of currently online cpu */
+	if (read_file_to_trash(NUMA_DETECT_SYSTEM_SYSFS_PATH"/cpu/online")) {
+		ha_notice("Cannot read online CPUs list, will not try to create thread groups per L3 cache\n");
+		return 0;
+	}
+
+	parse_cpu_set_args[0] = trash.area;
+	parse_cpu_set_args[1] = "\0";
+	if (parse_cpu_set(parse_cpu_set_args, &active_cpus, 1, &err)) {
+		ha_notice("Cannot read online CPUs list: '%s'. Will not try to create thread groups per L3 cache\n", err);
+		free(err);
+		return 0;
+	}
+
+	domains = calloc(MAX_THREADS, sizeof(*domains));
+	if (!domains)
+		return 0;
+
+	/* collect the L3 domains in ascending CPU order, split the ones
+	 * larger than a thread group and stop at MAX_THREADS CPUs.
+	 */
+	ha_cpuset_assign(&todo, &active_cpus);
+	while (nbcpu < MAX_THREADS && (cpu = ha_cpuset_ffs(&todo))) {
+		cpu--;
+		if (read_cpu_l3_map(cpu, &l3_map)) {
+			ha_notice("Cannot read the L3 cache topology of CPU %d, will not try to create thread groups per L3 cache\n", cpu);
+			nbdom = 0;
+			goto end;
+		}
+
+		ha_cpuset_and(&l3_map, &todo);
+		ha_cpuset_set(&l3_map, cpu);
+
+		/* these CPUs are now assigned to a domain */
+		ha_cpuset_assign(&tmp, &l3_map);
+		while ((i = ha_cpuset_ffs(&tmp))) {
+			ha_cpuset_clr(&tmp, i - 1);
+			ha_cpuset_clr(&todo, i - 1);
+		}
+
+		while (nbcpu < MAX_THREADS && ha_cpuset_count(&l3_map))
+			nbcpu += cpuset_move_lowest(&domains[nbdom++], &l3_map,
+			                            MIN(MAX_THREADS_PER_GROUP, MAX_THREADS - nbcpu));
+	}
+
+	if (nbdom <= 1) {
+		nbdom = 0;
+		goto end;
+	}
+
+	/* merge the smallest adjacent domains until they fit in the groups */
+	while (nbdom > MAX_TGROUPS) {
+		int best = -1, best_cnt = MAX_THREADS_PER_GROUP + 1;
+
+		for (i = 0; i < nbdom - 1; i++) {
+			int cnt = ha_cpuset_count(&domains[i]) + ha_cpuset_count(&domains[i + 1]);
+
+			if (cnt < best_cnt) {
+				best = i;
+				best_cnt = cnt;
+			}
+		}
+
+		if (best < 0) {
+			ha_notice("Too many L3 cache domains to fit in %d thread groups, will not try to create thread groups per L3 cache\n", MAX_TGROUPS);
+			nbdom = 0;
+			goto end;
+		}
+
+		ha_cpuset_or(&domains[best], &domains[best + 1]);
+		for (i = best + 1; i < nbdom - 1; i++)
+			ha_cpuset_assign(&domains[i], &domains[i + 1]);
+		nbdom--;
+	}
+
+	/* assign one thread per CPU and one group per domain */
+	for (g = t = 0; g < nbdom; g++) {
+		struct hap_cpuset one;
+
+		ha_tgroup_info[g].base = t;
+		ha_tgroup_info[g].count = 0;
+		ha_diag_warning("Automatically binding thread group %d to the %d CPUs sharing the L3 cache of CPU %d\n",
+		                g + 1, ha_cpuset_count(&domains[g]), ha_cpuset_ffs(&domains[g]) - 1);
+
+		while (cpuset_move_lowest(&one, &domains[g], 1)) {
+			ha_cpuset_assign(&cpu_map[g].thread[ha_tgroup_info[g].count], &one);
+			ha_tgroup_info[g].count++;
+			ha_thread_info[t].tgid = g + 1;
+			ha_thread_info[t].tg = &ha_tgroup_info[g];
+			ha_thread_info[t].tg_ctx = &ha_tgroup_ctx[g];
+			t++;
+		}
+	}
+	global.nbtgroups = nbdom;
+	nbcpu = t;
+
+ end:
+	free(domains);
+	return nbdom ? nbcpu : 0;
+}
+
 #elif defined(__FreeBSD__)
 static int numa_detect_topology()
 {
@@ -2762,6 +2960,7 @@ int check_config_validity()
 	struct resolvers *curr_resolvers = NULL;
 	int i;
 	int diag_no_cluster_secret = 0;
+	int need_prewarm = 0;
 
 	bind_conf = NULL;
 	/*
@@ -2792,8 +2991,17 @@ int check_config_validity()
 		{
 			int numa_cores = 0;
 #if defined(USE_CPU_AFFINITY)
-			if (global.numa_cpu_mapping && !thread_cpu_mask_forced())
-				numa_cores = numa_detect_topology();
+			if (global.numa_cpu_mapping && !thread_cpu_mask_forced()) {
+#if defined(__linux__)
+				if (global.numa_cpu_mapping == NUMA_CPU_MAP_L3_GROUPS &&
+				    !global.nbtgroups && !ha_tgroup_info[0].count && !cpu_map_configured()) {
+					numa_cores = numa_detect_l3_groups();
+					auto_l3_groups = !!numa_cores;
+				}
+#endif
+				if (!numa_cores)
+					numa_cores = numa_detect_topology();
+			}
 #endif
 			global.nbthread = numa_cores ? numa_cores :
 			                               thread_cpus_enabled_at_boot;
@@ -2813,6 +3021,11 @@ int check_config_validity()
 
 	pool_head_capture = create_pool("capture", global.tune.cookie_len, MEM_F_SHARED);
 
+	if (global.tune.sample_cache)
+		pool_head_smp_cache = create_pool("smp_cache", sizeof(struct smp_cache) +
+		                                  global.tune.sample_cache * sizeof(struct smp_cache_slot),
+		                                  MEM_F_SHARED);
+
 	/* Post initialisation of the users and groups lists. */
 	err_code = userlist_postinit();
 	if (err_code != ERR_NONE)
@@ -2918,6 +3131,7 @@ int check_config_validity()
 		list_for_each_entry(bind_conf, &curproxy->conf.bind, by_fe) {
 			unsigned long mask;
 			struct listener *li;
+			int by_group = 0;
 
 			/* HTTP frontends with "h2" as ALPN/NPN will work in
 			 * HTTP/2 and absolutely require buffers 16kB or larger.
@@ -2943,6 +3157,18 @@ int check_config_validity()
 			} /* HTTP && bufsize < 16384 */
 #endif
 
+			/* "shards by-group" on a line without "thread" spans all
+			 * groups: it starts on the first one and the listeners for
+			 * the other groups are created below. This is implicit
+			 * when the groups were automatically created per L3 cache.
+			 */
+			if ((bind_conf->settings.shards == RX_SHARDS_BY_GROUP ||
+			     (auto_l3_groups && bind_conf->settings.shards <= 1)) &&
+			    !bind_conf->bind_tgroup && !bind_conf->bind_thread && global.nbtgroups > 1) {
+				bind_conf->bind_tgroup = 1;
+				by_group = 1;
+			}
+
 			/* detect and address thread affinity inconsistencies */
 			err = NULL;
 			if (thread_resolve_group_mask(bind_conf->bind_tgroup, bind_conf->bind_thread,
@@ -2968,7 +3194,8 @@ int check_config_validity()
 
 			/* apply thread masks and groups to all receivers */
 			list_for_each_entry(li, &bind_conf->listeners, by_bind) {
-				if (bind_conf->settings.shards <= 1) {
+				if (bind_conf->settings.shards <= 1 ||
+				    bind_conf->settings.shards == RX_SHARDS_BY_GROUP) {
 					li->rx.bind_thread = bind_conf->bind_thread;
 					li->rx.bind_tgroup = bind_conf->bind_tgroup;
 				} else {
@@ -3017,6 +3244,42 @@ int check_config_validity()
 					}
 				}
 			}
+
+			/* one more listener per extra thread group for "shards by-group" */
+			if (by_group) {
+				list_for_each_entry(li, &bind_conf->listeners, by_bind) {
+					struct listener *new_li;
+					uint grp;
+
+					for (grp = 2; grp <= global.nbtgroups; grp++) {
+						new_li = clone_listener(li);
+						if (!new_li) {
+							ha_alert("Out of memory while trying to allocate extra listener for thread group %u in %s %s\n",
+								 grp, proxy_type_str(curproxy), curproxy->id);
+							cfgerr++;
+							err_code |= ERR_FATAL | ERR_ALERT;
+							goto out;
+						}
+						new_li->rx.bind_tgroup = grp;
+						new_li->rx.bind_thread = nbits(ha_tgroup_info[grp - 1].count);
+					}
+				}
+			}
+
+			/* find the CPU each listener's threads are bound to for "incoming-cpu" */
+			if (bind_conf->settings.options & RX_O_INCOMING_CPU) {
+				int warned = 0;
+
+				list_for_each_entry(li, &bind_conf->listeners, by_bind) {
+					li->rx.incoming_cpu = listener_single_cpu(li);
+					if (li->rx.incoming_cpu < 0 && !warned) {
+						ha_warning("Proxy '%s': 'incoming-cpu' on 'bind %s' at [%s:%d] is ignored for the shards whose threads are not bound to a single CPU (see 'cpu-map').\n",
+							   curproxy->id, bind_conf->arg, bind_conf->file, bind_conf->line);
+						err_code |= ERR_WARN;
+						warned = 1;
+					}
+				}
+			}
 		}
 
 		switch (curproxy->mode) {
@@ -3271,6 +3534,12 @@ int check_config_validity()
 			err_code |= warnif_tcp_http_cond(curproxy, rule->cond);
 		}
 
+		if (!proxy_index_switching_rules(curproxy)) {
+			ha_alert("Proxy '%s': out of memory while indexing 'use_backend' rules.\n",
+				 curproxy->id);
+			cfgerr++;
+		}
+
 		/* find the target server for 'use_server' rules */
 		list_for_each_entry(srule, &curproxy->server_rules, list) {
 			struct server *target;
@@ -3879,6 +4148,11 @@ int check_config_validity()
 			if ((curproxy->lbprm.algo & BE_LB_PARM) == BE_LB_CB_LC) {
 				curproxy->lbprm.algo |= BE_LB_LKUP_LCTREE | BE_LB_PROP_DYN;
 				fwlc_init_server_tree(curproxy);
+			} else if ((curproxy->lbprm.algo & BE_LB_PARM) == BE_LB_CB_EWMA) {
+				curproxy->lbprm.algo |= BE_LB_LKUP_CHTREE | BE_LB_PROP_DYN;
+				if (chash_init_server_tree(curproxy) < 0) {
+					cfgerr++;
+				}
 			} else {
 				curproxy->lbprm.algo |= BE_LB_LKUP_FSTREE | BE_LB_PROP_DYN;
 				fas_init_server_tree(curproxy);
@@ -3891,6 +4165,16 @@ int check_config_validity()
 				if (chash_init_server_tree(curproxy) < 0) {
 					cfgerr++;
 				}
+			} else if ((curproxy->lbprm.algo & BE_LB_HASH_TYPE) == BE_LB_HASH_RDV) {
+				curproxy->lbprm.algo |= BE_LB_LKUP_RDVARR | BE_LB_PROP_DYN;
+				if (rdv_init_server_tree(curproxy) < 0) {
+					cfgerr++;
+				}
+			} else if ((curproxy->lbprm.algo & BE_LB_HASH_TYPE) == BE_LB_HASH_MAGLEV) {
+				curproxy->lbprm.algo |= BE_LB_LKUP_MGTBL | BE_LB_PROP_DYN;
+				if (maglev_init_server_tree(curproxy) < 0) {
+					cfgerr++;
+				}
 			} else {
 				curproxy->lbprm.algo |= BE_LB_LKUP_MAP;
 				init_server_map(curproxy);
@@ -4241,6 +4525,17 @@ int check_config_validity()
 			}
 
 		}
+
+		if (srv_init_coalesce(newsrv) == -1) {
+			ha_alert("parsing [%s:%d] : failed to allocate the connection sharing group for server '%s'.\n",
+			         newsrv->conf.file, newsrv->conf.line, newsrv->id);
+			cfgerr++;
+			continue;
+		}
+
+		err_code |= srv_check_pool_min_conn(newsrv);
+		if (newsrv->pool_min_conn)
+			need_prewarm = 1;
 	}
 
 	idle_conn_task = task_new_anywhere();
@@ -4264,6 +4559,20 @@ int check_config_validity()
 			idle_conns[i].cleanup_task->context = NULL;
 			HA_SPIN_INIT(&idle_conns[i].idle_conns_lock);
 			MT_LIST_INIT(&idle_conns[i].toremove_conns);
+
+			if (!need_prewarm)
+				continue;
+
+			idle_conns[i].prewarm_task = task_new_on(i);
+			if (!idle_conns[i].prewarm_task) {
+				ha_alert("parsing : failed to allocate idle connection tasks for thread '%d'.\n", i);
+				cfgerr++;
+				break;
+			}
+
+			idle_conns[i].prewarm_task->process = srv_prewarm_idle_conns;
+			idle_conns[i].prewarm_task->context = NULL;
+			task_wakeup(idle_conns[i].prewarm_task, TASK_WOKEN_INIT);
 		}
 	}
 
@@ -4303,6 +4612,8 @@ int check_config_validity()
 			/* enable separate counters */
 			if (curproxy->options2 & PR_O2_SOCKSTAT) {
 				listener->counters = calloc(1, sizeof(*listener->counters));
+				if (listener->counters)
+					counters_shards_init(&listener->counters->shards);
 				if (!listener->name)
 					memprintf(&listener->name, "sock-%d", listener->luid);
 			}
@@ -4338,10 +4649,14 @@ int check_config_validity()
 			if (!LIST_ISEMPTY(&curproxy->tcp_req.l5_rules))
 				listener->options |= LI_O_TCP_L5_RULES;
 
-			/* smart accept mode is automatic in HTTP mode */
-			if ((curproxy->options2 & PR_O2_SMARTACC) ||
-			    ((curproxy->mode == PR_MODE_HTTP || (listener->bind_conf->options & BC_O_USE_SSL)) &&
-			     !(curproxy->no_options2 & PR_O2_SMARTACC)))
+			/* smart accept mode is automatic in HTTP mode. It only
+			 * makes sense on TCP, other sockets would only waste a
+			 * failing TCP_QUICKACK setsockopt() per request.
+			 */
+			if (listener->rx.proto->sock_prot == IPPROTO_TCP &&
+			    ((curproxy->options2 & PR_O2_SMARTACC) ||
+			     ((curproxy->mode == PR_MODE_HTTP || (listener->bind_conf->options & BC_O_USE_SSL)) &&
+			      !(curproxy->no_options2 & PR_O2_SMARTACC))))
 				listener->options |= LI_O_NOQUICKACK;
 		}
 
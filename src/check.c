@@ -38,6 +38,7 @@
 #include <haproxy/dynbuf.h>
 #include <haproxy/extcheck.h>
 #include <haproxy/fd.h>
+#include <haproxy/freq_ctr.h>
 #include <haproxy/global.h>
 #include <haproxy/h1.h>
 #include <haproxy/http.h>
@@ -633,6 +634,8 @@ void check_notify_stopping(struct check *check)
  */
 void __health_adjust(struct server *s, short status)
 {
+	uint period = MS_TO_TICKS(s->check.inter);
+	uint nb_ok, nb_err;
 	int failed;
 	int expire;
 
@@ -658,16 +661,37 @@ void __health_adjust(struct server *s, short status)
 	if (!failed) {
 		/* good: clear consecutive_errors */
 		s->consecutive_errors = 0;
+		if (s->error_rate)
+			update_freq_ctr_period(&s->obs_ok, period, 1);
+		if (s->passive_inter)
+			HA_ATOMIC_STORE(&s->last_obs_ok, tick_add(now_ms, 0));
 		return;
 	}
 
 	_HA_ATOMIC_INC(&s->consecutive_errors);
 
-	if (s->consecutive_errors < s->consecutive_errors_limit)
-		return;
+	if (s->consecutive_errors >= s->consecutive_errors_limit) {
+		chunk_printf(&trash, "Detected %d consecutive errors, last one was: %s",
+		             s->consecutive_errors, get_analyze_status(status));
+	}
+	else if (s->error_rate) {
+		/* the error ratio is only considered over the last check
+		 * interval and once at least error-limit responses were seen,
+		 * so that a few errors on an idle server do not eject it.
+		 */
+		nb_err = update_freq_ctr_period(&s->obs_err, period, 1);
+		nb_ok  = read_freq_ctr_period(&s->obs_ok, period);
 
-	chunk_printf(&trash, "Detected %d consecutive errors, last one was: %s",
-	             s->consecutive_errors, get_analyze_status(status));
+		if (nb_ok + nb_err < s->consecutive_errors_limit ||
+		    (ullong)nb_err * 100 < (ullong)s->error_rate * (nb_ok + nb_err))
+			return;
+
+		chunk_printf(&trash, "Detected %u%% errors over the last %u responses, last one was: %s",
+		             (uint)((ullong)nb_err * 100 / (nb_ok + nb_err)), nb_ok + nb_err,
+		             get_analyze_status(status));
+	}
+	else
+		return;
 
 	if (s->check.fastinter)
 		expire = tick_add(now_ms, MS_TO_TICKS(s->check.fastinter));
@@ -711,6 +735,14 @@ void __health_adjust(struct server *s, short status)
 	HA_SPIN_UNLOCK(SERVER_LOCK, &s->lock);
 
 	s->consecutive_errors = 0;
+	if (s->error_rate) {
+		/* start a new observation window */
+		HA_ATOMIC_STORE(&s->obs_ok.curr_ctr, 0);
+		HA_ATOMIC_STORE(&s->obs_ok.prev_ctr, 0);
+		HA_ATOMIC_STORE(&s->obs_err.curr_ctr, 0);
+		HA_ATOMIC_STORE(&s->obs_err.prev_ctr, 0);
+	}
+	HA_ATOMIC_STORE(&s->last_obs_ok, TICK_ETERNITY);
 	_HA_ATOMIC_INC(&s->counters.failed_hana);
 
 	if (tick_isset(expire) && tick_is_lt(expire, s->check.task->expire)) {
@@ -1157,6 +1189,28 @@ struct task *process_chk_conn(struct task *t, void *context, unsigned int state)
 			goto reschedule;
 		}
 
+		/* when the server is fully up and live traffic was seen
+		 * successfully handled during the last interval, the active
+		 * check is not needed, unless passive-inter has elapsed since
+		 * the last one.
+		 */
+		if (check->server && check == &check->server->check && check->server->passive_inter &&
+		    check->health == check->rise + check->fall - 1 &&
+		    !check->server->consecutive_errors &&
+		    tick_isset(check->server->next_active_chk) &&
+		    !tick_is_expired(check->server->next_active_chk, now_ms)) {
+			unsigned int last_ok = HA_ATOMIC_LOAD(&check->server->last_obs_ok);
+
+			if (tick_isset(last_ok) && !tick_is_expired(tick_add(last_ok, MS_TO_TICKS(check->inter)), now_ms)) {
+				TRACE_STATE("health-check skipped thanks to healthy traffic", CHK_EV_TASK_WAKE, check);
+				check->state |= CHK_ST_SLEEPING;
+				goto reschedule;
+			}
+		}
+
+		if (check->server && check == &check->server->check && check->server->passive_inter)
+			check->server->next_active_chk = tick_add(now_ms, MS_TO_TICKS(check->server->passive_inter));
+
 		/* we'll initiate a new check */
 		set_server_check_status(check, HCHK_STATUS_START, NULL);
 
@@ -1426,11 +1480,15 @@ int start_check_task(struct check *check, int mininter,
 {
 	struct task *t;
 
-	/* task for the check. Process-based checks exclusively run on thread 1. */
+	/* task for the check. Process-based checks exclusively run on thread 1.
+	 * Other ones are initially bound round-robin to all threads so that a
+	 * large farm does not start all of its checks on the same thread; they
+	 * may later migrate to a less loaded thread while sleeping.
+	 */
 	if (check->type == PR_O2_EXT_CHK)
 		t = task_new_on(0);
 	else
-		t = task_new_anywhere();
+		t = task_new_on(srvpos % global.nbthread);
 
 	if (!t)
 		goto fail_alloc_task;
@@ -1448,7 +1506,15 @@ int start_check_task(struct check *check, int mininter,
 	/* check this every ms */
 	t->expire = tick_add(now_ms, MS_TO_TICKS(mininter * srvpos / nbcheck));
 	check->start = now;
-	task_queue(t);
+
+	/* a task bound to another thread may not be queued from here, so it
+	 * is woken up instead and will requeue itself on its own thread as it
+	 * is too early to run the check.
+	 */
+	if (t->tid == tid)
+		task_queue(t);
+	else
+		task_wakeup(t, TASK_WOKEN_INIT);
 
 	return 1;
 
@@ -98,6 +98,30 @@ struct show_fd_ctx {
 	int show_one;    /* stop after showing one FD */
 };
 
+/* per-mux counters accumulated by the "show mux-buffers" command */
+struct show_mux_buf_stats {
+	const struct mux_ops *mux;      /* mux these counters apply to, NULL if unused */
+	unsigned long long conns;       /* connections using this mux */
+	unsigned long long idle;        /* connections without any active stream */
+	unsigned long long idle_bufs;   /* idle connections holding at least one buffer */
+	unsigned long long rxbufs;      /* allocated receive buffers */
+	unsigned long long txbufs;      /* allocated send buffers */
+	unsigned long long size;        /* total size of the allocated buffers */
+	unsigned long long idle_size;   /* size of the buffers held by idle connections */
+};
+
+/* number of distinct muxes reported by "show mux-buffers" */
+#define SHOW_MUX_BUF_MAX 8
+
+/* number of FDs scanned per thread isolation by "show mux-buffers" */
+#define SHOW_MUX_BUF_BATCH 16384
+
+/* CLI context for the "show mux-buffers" command */
+struct show_mux_buf_ctx {
+	int fd;                                  /* next FD to scan */
+	struct show_mux_buf_stats *stats;        /* SHOW_MUX_BUF_MAX entries */
+};
+
 /* CLI context for the "show cli sockets" command */
 struct show_sock_ctx {
 	struct bind_conf *bind_conf;
@@ -1277,7 +1301,7 @@ static int cli_io_handler_show_fd(struct appctx *appctx)
 	/* we have two inner loops here, one for the proxy, the other one for
 	 * the buffer.
 	 */
-	while (fd >= 0 && fd < global.maxsock) {
+	while (fd >= 0 && fd < fdtab_inited) {
 		struct fdtab fdt;
 		const struct listener *li = NULL;
 		const struct server *sv = NULL;
@@ -1582,6 +1606,105 @@ static int cli_parse_show_fd(char **args, char *payload, struct appctx *appctx,
 	return 0;
 }
 
+/* parse a "show mux-buffers" CLI request. Returns 0 if it needs to continue,
+ * 1 if it wants to stop here. The counters are allocated here and released by
+ * cli_release_show_mux_buf().
+ */
+static int cli_parse_show_mux_buf(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	struct show_mux_buf_ctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+
+	if (!cli_has_level(appctx, ACCESS_LVL_OPER))
+		return 1;
+
+	ctx->stats = calloc(SHOW_MUX_BUF_MAX, sizeof(*ctx->stats));
+	if (!ctx->stats)
+		return cli_err(appctx, "Out of memory.\n");
+	return 0;
+}
+
+/* Scans the connections attached to FDs and sums up the buffers their mux
+ * holds, separating those held by idle connections (i.e. waiting for a new
+ * request). Threads are isolated for at most SHOW_MUX_BUF_BATCH FDs at once so
+ * that very large numbers of connections do not stall the traffic. Returns 0
+ * if it needs to be called again, otherwise non-zero.
+ */
+static int cli_io_handler_show_mux_buf(struct appctx *appctx)
+{
+	struct show_mux_buf_ctx *ctx = appctx->svcctx;
+	struct show_mux_buf_stats *st;
+	struct mux_buf_info info;
+	const struct connection *conn;
+	int end, i;
+
+	end = ctx->fd + SHOW_MUX_BUF_BATCH;
+
+	thread_isolate();
+	for (; ctx->fd < end && ctx->fd < fdtab_inited; ctx->fd++) {
+		if (!fdtab[ctx->fd].owner || fdtab[ctx->fd].iocb != sock_conn_iocb)
+			continue;
+
+		conn = fdtab[ctx->fd].owner;
+		if (conn->handle.fd != ctx->fd || !conn->mux || !conn->ctx)
+			continue;
+
+		/* muxes registered several times share the same name */
+		for (i = 0; i < SHOW_MUX_BUF_MAX - 1; i++)
+			if (!ctx->stats[i].mux || ctx->stats[i].mux == conn->mux ||
+			    strcmp(ctx->stats[i].mux->name, conn->mux->name) == 0)
+				break;
+
+		/* the last entry collects unexpected extra muxes */
+		st = &ctx->stats[i];
+		if (!st->mux)
+			st->mux = conn->mux;
+		st->conns++;
+
+		if (!conn->mux->ctl ||
+		    conn->mux->ctl((struct connection *)conn, MUX_BUF_INFO, &info) < 0)
+			continue;
+
+		st->rxbufs += info.rxbufs;
+		st->txbufs += info.txbufs;
+		st->size   += info.size;
+		if (info.idle) {
+			st->idle++;
+			st->idle_size += info.size;
+			if (info.rxbufs || info.txbufs)
+				st->idle_bufs++;
+		}
+	}
+	thread_release();
+
+	if (ctx->fd < fdtab_inited) {
+		/* let's come back later */
+		applet_have_more_data(appctx);
+		return 0;
+	}
+
+	chunk_reset(&trash);
+	chunk_appendf(&trash, "# mux conns idle idle_with_bufs rxbufs txbufs bytes idle_bytes\n");
+	for (i = 0; i < SHOW_MUX_BUF_MAX && ctx->stats[i].mux; i++) {
+		st = &ctx->stats[i];
+		chunk_appendf(&trash, "%s %llu %llu %llu %llu %llu %llu %llu\n",
+			      *st->mux->name ? st->mux->name : "-",
+			      st->conns, st->idle, st->idle_bufs,
+			      st->rxbufs, st->txbufs, st->size, st->idle_size);
+	}
+
+	if (applet_putchk(appctx, &trash) == -1)
+		return 0;
+	return 1;
+}
+
+/* releases the counters of the "show mux-buffers" command */
+static void cli_release_show_mux_buf(struct appctx *appctx)
+{
+	struct show_mux_buf_ctx *ctx = appctx->svcctx;
+
+	ha_free(&ctx->stats);
+}
+
 /* parse a "set timeout" CLI request. It always returns 1. */
 static int cli_parse_set_timeout(char **args, char *payload, struct appctx *appctx, void *private)
 {
@@ -1998,7 +2121,7 @@ static int _getsocks(char **args, char *payload, struct appctx *appctx, void *pr
 	 * First, calculates the total number of FD, so that we can let
 	 * the caller know how much it should expect.
 	 */
-	for (cur_fd = 0;cur_fd < global.maxsock; cur_fd++)
+	for (cur_fd = 0;cur_fd < fdtab_inited; cur_fd++)
 		tot_fd_nb += !!(fdtab[cur_fd].state & FD_EXPORTED);
 
 	if (tot_fd_nb == 0) {
@@ -2045,7 +2168,7 @@ static int _getsocks(char **args, char *payload, struct appctx *appctx, void *pr
 
 	nb_queued = 0;
 	iov.iov_base = tmpbuf;
-	for (cur_fd = 0; cur_fd < global.maxsock; cur_fd++) {
+	for (cur_fd = 0; cur_fd < fdtab_inited; cur_fd++) {
 		if (!(fdtab[cur_fd].state & FD_EXPORTED))
 			continue;
 
@@ -2217,6 +2340,38 @@ static enum obj_type *pcli_pid_to_server(int proc_pid)
 	return NULL;
 }
 
+/* Returns the PID of the worker of rank <pos> in the process list, ignoring
+ * the other processes, or -1 if there is no such worker. This is used to walk
+ * over the workers for the "@*" prefix.
+ */
+static int pcli_fanout_pid(int pos)
+{
+	struct mworker_proc *child;
+
+	list_for_each_entry(child, &proc_list, list) {
+		if (!(child->options & PROC_O_TYPE_WORKER))
+			continue;
+		if (!pos--)
+			return child->pid;
+	}
+	return -1;
+}
+
+/* Moves the "@*" command of stream <s> to the next worker. Returns non-zero
+ * if there is one, otherwise the command is finished and released.
+ */
+static int pcli_fanout_next(struct stream *s)
+{
+	if (pcli_fanout_pid(++s->pcli_fanout_pos) > 0)
+		return 1;
+
+	s->pcli_flags &= ~PCLI_F_FANOUT;
+	s->pcli_fanout_pos = 0;
+	ha_free(&s->pcli_fanout_cmd.ptr);
+	s->pcli_fanout_cmd = IST_NULL;
+	return 0;
+}
+
 /* Take a CLI prefix in argument (eg: @!1234 @master @1)
  *  Return:
  *     0: master
@@ -2294,7 +2449,22 @@ int pcli_find_and_exec_kw(struct stream *s, char **args, int argl, char **errmsg
 		return 0;
 
 	/* there is a prefix */
-	if (args[0][0] == '@') {
+	if (strcmp(args[0], "@*") == 0) {
+		/* send the command to every worker, one after the other */
+		if (argl == 1) {
+			memprintf(errmsg, "The '@*' prefix must be followed by a command\n");
+			return -1;
+		}
+
+		*next_pid = pcli_fanout_pid(0);
+		if (*next_pid < 0) {
+			memprintf(errmsg, "No worker to send the command to\n");
+			return -1;
+		}
+		s->pcli_flags |= PCLI_F_FANOUT;
+		s->pcli_fanout_pos = 0;
+		return 1;
+	} else if (args[0][0] == '@') {
 		int target_pid = pcli_prefix_to_pid(args[0]);
 
 		if (target_pid == -1) {
@@ -2494,6 +2664,12 @@ int pcli_parse_request(struct stream *s, struct channel *req, char **errmsg, int
 
 	*(end-1) = '\n';
 
+	if ((s->pcli_flags & (PCLI_F_FANOUT|PCLI_F_PAYLOAD)) == (PCLI_F_FANOUT|PCLI_F_PAYLOAD)) {
+		s->pcli_flags &= ~(PCLI_F_FANOUT|PCLI_F_PAYLOAD);
+		memprintf(errmsg, "The '@*' prefix does not support commands with a payload\n");
+		return -1;
+	}
+
 	if (wtrim > 0) {
 		trim = &args[wtrim][0];
 		if (trim == NULL) /* if this was the last word in the table */
@@ -2537,6 +2713,18 @@ int pcli_parse_request(struct stream *s, struct channel *req, char **errmsg, int
 		}
 	}
 end:
+	if ((s->pcli_flags & PCLI_F_FANOUT) && !isttest(s->pcli_fanout_cmd)) {
+		/* keep the command with its prefixes to replay it to the
+		 * other workers.
+		 */
+		s->pcli_fanout_cmd = ist2(malloc(ret), ret);
+		if (!isttest(s->pcli_fanout_cmd)) {
+			s->pcli_flags &= ~PCLI_F_FANOUT;
+			memprintf(errmsg, "Out of memory\n");
+			return -1;
+		}
+		memcpy(s->pcli_fanout_cmd.ptr, ci_head(req), ret);
+	}
 
 	return ret;
 }
@@ -2575,6 +2763,28 @@ int pcli_wait_for_request(struct stream *s, struct channel *req, int an_bit)
 
 	req->flags |= CF_READ_DONTWAIT;
 
+	if (isttest(s->pcli_fanout_cmd)) {
+		/* replay the "@*" command to the next worker, before any
+		 * other pending command.
+		 */
+		next_pid = pcli_fanout_pid(s->pcli_fanout_pos);
+		if (next_pid < 0) {
+			/* the remaining workers have left meanwhile */
+			pcli_fanout_next(s);
+			pcli_write_prompt(s);
+			goto read_again;
+		}
+		/* the buffer may have been released after the previous response */
+		if (!b_alloc(&req->buf) ||
+		    !b_insert_blk(&req->buf, co_data(req), istptr(s->pcli_fanout_cmd), istlen(s->pcli_fanout_cmd))) {
+			pcli_reply_and_close(s, "Not enough room to send the command to the next worker!\n");
+			s->req.analysers &= ~AN_REQ_WAIT_CLI;
+			return 0;
+		}
+		to_forward = istlen(s->pcli_fanout_cmd);
+		goto forward;
+	}
+
 	/* need more data */
 	if (!ci_data(req))
 		goto missing_data;
@@ -2584,6 +2794,7 @@ int pcli_wait_for_request(struct stream *s, struct channel *req, int an_bit)
 		s->logs.t_idle = tv_ms_elapsed(&s->logs.tv_accept, &now) - s->logs.t_handshake;
 
 	to_forward = pcli_parse_request(s, req, &errmsg, &next_pid);
+ forward:
 	if (to_forward > 0) {
 		int target_pid;
 		/* enough data */
@@ -2612,6 +2823,14 @@ int pcli_wait_for_request(struct stream *s, struct channel *req, int an_bit)
 			if (!s->target)
 				goto server_disconnect;
 
+			if (s->pcli_flags & PCLI_F_FANOUT) {
+				/* tell which worker the following response comes from */
+				struct buffer *msg = get_trash_chunk();
+
+				chunk_printf(msg, "### @!%d ###\n", target_pid);
+				co_inject(&s->res, msg->area, msg->data);
+			}
+
 			s->flags |= (SF_DIRECT | SF_ASSIGNED);
 			channel_auto_connect(req);
 		}
@@ -2697,7 +2916,11 @@ int pcli_wait_for_response(struct stream *s, struct channel *rep, int an_bit)
 	if ((rep->flags & (CF_SHUTR|CF_READ_NULL))) {
 		/* stream cleanup */
 
-		pcli_write_prompt(s);
+		/* the prompt is only displayed once all the workers responded
+		 * to a "@*" command.
+		 */
+		if (!(s->pcli_flags & PCLI_F_FANOUT) || !pcli_fanout_next(s))
+			pcli_write_prompt(s);
 
 		s->scb->flags |= SC_FL_NOLINGER | SC_FL_NOHALF;
 		sc_shutr(s->scb);
@@ -3167,6 +3390,7 @@ static struct cli_kw_list cli_kws = {{ },{
 	{ { "show", "cli", "sockets",  NULL },   "show cli sockets                        : dump list of cli sockets",                                cli_parse_default, cli_io_handler_show_cli_sock, NULL, NULL, ACCESS_MASTER },
 	{ { "show", "cli", "level", NULL },      "show cli level                          : display the level of the current CLI session",            cli_parse_show_lvl, NULL, NULL, NULL, ACCESS_MASTER},
 	{ { "show", "fd", NULL },                "show fd [num]                           : dump list of file descriptors in use or a specific one",  cli_parse_show_fd, cli_io_handler_show_fd, NULL },
+	{ { "show", "mux-buffers", NULL },       "show mux-buffers                        : report the buffers held by connections, idle ones included", cli_parse_show_mux_buf, cli_io_handler_show_mux_buf, cli_release_show_mux_buf },
 	{ { "show", "version", NULL },           "show version                            : show version of the current process",                     cli_parse_show_version, NULL, NULL, NULL, ACCESS_MASTER },
 	{ { "operator", NULL },                  "operator                                : lower the level of the current CLI session to operator",  cli_parse_set_lvl, NULL, NULL, NULL, ACCESS_MASTER},
 	{ { "user", NULL },                      "user                                    : lower the level of the current CLI session to user",      cli_parse_set_lvl, NULL, NULL, NULL, ACCESS_MASTER},
@@ -11,17 +11,28 @@
  */
 
 #include <sys/time.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #ifdef USE_THREAD
 #include <pthread.h>
 #endif
 
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
 #include <haproxy/api.h>
 #include <haproxy/activity.h>
+#include <haproxy/cfgparse.h>
 #include <haproxy/clock.h>
+#include <haproxy/errors.h>
+#include <haproxy/init.h>
 #include <haproxy/signal-t.h>
+#include <haproxy/task.h>
 #include <haproxy/time.h>
 #include <haproxy/tinfo-t.h>
 #include <haproxy/tools.h>
@@ -47,8 +58,22 @@ static THREAD_LOCAL char         iso_time_str[34]; /* ISO time representation of
 static clockid_t per_thread_clock_id[MAX_THREADS];
 #endif
 
+/* The monotonic time used for profiling and latency measurements may be
+ * derived from the CPU's time stamp counter when it is known to be invariant
+ * and trusted by the kernel, which is much cheaper than clock_gettime(). The
+ * TSC is calibrated against the system's monotonic clock between the early
+ * process init and the post-check stage. Once <tsc_mult> is set, the TSC is
+ * used, otherwise clock_gettime() is.
+ */
+static int      tsc_disabled;            /* "tune.clock.tsc off" */
+static uint64_t tsc_calib_tsc;           /* TSC at calibration start */
+static uint64_t tsc_calib_ns;            /* system monotonic time at calibration start */
+static uint64_t tsc_base  __read_mostly; /* TSC at calibration end */
+static uint64_t tsc_ns    __read_mostly; /* system monotonic time at calibration end */
+static uint64_t tsc_mult  __read_mostly; /* ns per TSC tick in 32.32 fixed point, 0=unused */
+
 /* returns the system's monotonic time in nanoseconds if supported, otherwise zero */
-uint64_t now_mono_time(void)
+static uint64_t now_sys_mono_time(void)
 {
 	uint64_t ret = 0;
 #if defined(_POSIX_TIMERS) && defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) && defined(_POSIX_MONOTONIC_CLOCK)
@@ -59,6 +84,129 @@ uint64_t now_mono_time(void)
 	return ret;
 }
 
+#if defined(__x86_64__)
+/* returns non-zero if the TSC may be used as a monotonic clock source: it
+ * must be invariant (constant rate and running in all C-states), and the
+ * kernel must have selected it as its clock source, which implies that it
+ * verified that all CPUs' TSC are synchronized and stable.
+ */
+static int tsc_is_usable(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	char src[16];
+	ssize_t len;
+	int fd;
+
+	if (__get_cpuid_max(0x80000000, NULL) < 0x80000007)
+		return 0;
+
+	__cpuid(0x80000007, eax, ebx, ecx, edx);
+	if (!(edx & (1U << 8)))
+		return 0;
+
+	fd = open("/sys/devices/system/clocksource/clocksource0/current_clocksource", O_RDONLY);
+	if (fd < 0)
+		return 0;
+	len = read(fd, src, sizeof(src) - 1);
+	close(fd);
+	if (len < 3)
+		return 0;
+	return strncmp(src, "tsc", 3) == 0 && (len == 3 || src[3] == '\n');
+}
+#endif
+
+/* returns the system's monotonic time in nanoseconds if supported, otherwise zero */
+uint64_t now_mono_time(void)
+{
+#if defined(__x86_64__)
+	if (likely(tsc_mult))
+		return tsc_ns + (uint64_t)(((__uint128_t)(rdtsc() - tsc_base) * tsc_mult) >> 32);
+#endif
+	return now_sys_mono_time();
+}
+
+/* returns non-zero if now_mono_time() relies on the TSC */
+int clock_uses_tsc(void)
+{
+	return tsc_mult != 0;
+}
+
+/* starts the TSC calibration if the TSC is usable. Called once at boot. */
+static void clock_start_tsc_calibration(void)
+{
+#if defined(__x86_64__)
+	if (!tsc_is_usable())
+		return;
+
+	tsc_calib_ns = now_sys_mono_time();
+	tsc_calib_tsc = rdtsc();
+#endif
+}
+
+/* finishes the TSC calibration started at boot, waiting for at least 10ms to
+ * have elapsed since it started so that the rate is precise enough, then
+ * switches now_mono_time() to the TSC. The result is continuous with the
+ * system's monotonic clock at the switch.
+ */
+static int clock_finish_tsc_calibration(void)
+{
+#if defined(__x86_64__)
+	uint64_t ns, tsc, mult;
+
+	if (!tsc_calib_ns || tsc_disabled)
+		return ERR_NONE;
+
+	ns = now_sys_mono_time();
+	if (ns - tsc_calib_ns < 10000000ULL) {
+		usleep((10000000ULL - (ns - tsc_calib_ns)) / 1000 + 1);
+		ns = now_sys_mono_time();
+	}
+	tsc = rdtsc();
+
+	if (tsc <= tsc_calib_tsc)
+		return ERR_NONE;
+
+	mult = ((__uint128_t)(ns - tsc_calib_ns) << 32) / (tsc - tsc_calib_tsc);
+
+	/* only accept TSC rates between 10 MHz and 100 GHz */
+	if (mult < (1ULL << 32) / 100 || mult > (100ULL << 32))
+		return ERR_NONE;
+
+	tsc_ns = ns;
+	tsc_base = tsc;
+	tsc_mult = mult;
+#endif
+	return ERR_NONE;
+}
+
+REGISTER_POST_CHECK(clock_finish_tsc_calibration);
+
+/* config parser for global "tune.clock.tsc", accepts "auto" or "off" */
+static int cfg_parse_clock_tsc(char **args, int section_type, struct proxy *curpx,
+                               const struct proxy *defpx, const char *file, int line,
+                               char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "auto") == 0)
+		tsc_disabled = 0;
+	else if (strcmp(args[1], "off") == 0)
+		tsc_disabled = 1;
+	else {
+		memprintf(err, "'%s' expects either 'auto' or 'off' but got '%s'.", args[0], args[1]);
+		return -1;
+	}
+	return 0;
+}
+
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.clock.tsc", cfg_parse_clock_tsc },
+	{ 0, NULL, NULL }
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
+
 /* returns the current thread's cumulated CPU time in nanoseconds if supported, otherwise zero */
 uint64_t now_cpu_time(void)
 {
@@ -268,6 +416,7 @@ void clock_init_process_date(void)
 	global_now_ms = now.tv_sec * 1000 + now.tv_usec / 1000;
 	th_ctx->idle_pct = 100;
 	clock_update_date(0, 1);
+	clock_start_tsc_calibration();
 }
 
 /* must be called once per thread to initialize their thread-local variables.
@@ -382,6 +531,7 @@ void clock_entering_poll(void)
 
 	/* update the average runtime */
 	activity_count_runtime(run_time);
+	sched_update_budget(run_time);
 }
 
 /* returns the current date as returned by gettimeofday() in ISO+microsecond
@@ -24,6 +24,12 @@
 #undef free_func
 #endif /* USE_ZLIB */
 
+#if defined(USE_ZSTD)
+/* needed for the custom allocator */
+#define ZSTD_STATIC_LINKING_ONLY
+#include <zstd.h>
+#endif /* USE_ZSTD */
+
 #include <haproxy/api.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/compression-t.h>
@@ -37,7 +43,7 @@
 #include <haproxy/tools.h>
 
 
-#if defined(USE_ZLIB)
+#if defined(USE_ZLIB) || defined(USE_BROTLI) || defined(USE_ZSTD)
 __decl_spinlock(comp_pool_lock);
 #endif
 
@@ -60,6 +66,49 @@ static int global_tune_zlibwindowsize = MAX_WBITS;  /* zlib window size */
 
 #endif
 
+#if defined(USE_BROTLI) || defined(USE_ZSTD)
+
+/* brotli and zstd allocate a few areas whose sizes depend on the compression
+ * level, so pools are created on the fly for each distinct size, and areas
+ * of other sizes are allocated using malloc() once all pools are created.
+ */
+#define COMP_MAX_POOLS 16
+
+struct comp_pools {
+	char *name;                             /* name of the pools */
+	struct pool_head *pool[COMP_MAX_POOLS]; /* pools, the first NULL one is unused */
+	size_t size[COMP_MAX_POOLS];            /* size of the areas allocated from each pool */
+};
+
+/* each area starts with the pool it was allocated from, or NULL if it was
+ * allocated using malloc(). The header is large enough to keep the area
+ * suitably aligned for any use.
+ */
+#define COMP_AREA_HDR 16
+
+static void *comp_pools_alloc(struct comp_pools *pools, size_t size);
+static void comp_pools_free(void *ptr);
+
+#endif
+
+#if defined(USE_BROTLI)
+
+/* brotli window (log2) */
+#define BROTLI_WINDOW_BITS 18
+
+static struct comp_pools brotli_pools = { .name = "brotli" };
+
+#endif
+
+#if defined(USE_ZSTD)
+
+/* zstd window (log2) */
+#define ZSTD_WINDOW_BITS 18
+
+static struct comp_pools zstd_pools = { .name = "zstd" };
+
+#endif
+
 unsigned int compress_min_idle = 0;
 
 static int identity_init(struct comp_ctx **comp_ctx, int level);
@@ -90,6 +139,26 @@ static int deflate_end(struct comp_ctx **comp_ctx);
 
 #endif /* USE_ZLIB */
 
+#if defined(USE_BROTLI)
+
+static int brotli_init(struct comp_ctx **comp_ctx, int level);
+static int brotli_add_data(struct comp_ctx *comp_ctx, const char *in_data, int in_len, struct buffer *out);
+static int brotli_flush(struct comp_ctx *comp_ctx, struct buffer *out);
+static int brotli_finish(struct comp_ctx *comp_ctx, struct buffer *out);
+static int brotli_end(struct comp_ctx **comp_ctx);
+
+#endif /* USE_BROTLI */
+
+#if defined(USE_ZSTD)
+
+static int zstd_init(struct comp_ctx **comp_ctx, int level);
+static int zstd_add_data(struct comp_ctx *comp_ctx, const char *in_data, int in_len, struct buffer *out);
+static int zstd_flush(struct comp_ctx *comp_ctx, struct buffer *out);
+static int zstd_finish(struct comp_ctx *comp_ctx, struct buffer *out);
+static int zstd_end(struct comp_ctx **comp_ctx);
+
+#endif /* USE_ZSTD */
+
 
 const struct comp_algo comp_algos[] =
 {
@@ -103,6 +172,12 @@ const struct comp_algo comp_algos[] =
 	{ "raw-deflate", 11, "deflate",  7, raw_def_init,  deflate_add_data,  deflate_flush,  deflate_finish,  deflate_end },
 	{ "gzip",         4, "gzip",     4, gzip_init,     deflate_add_data,  deflate_flush,  deflate_finish,  deflate_end },
 #endif /* USE_ZLIB */
+#if defined(USE_BROTLI)
+	{ "br",           2, "br",       2, brotli_init,   brotli_add_data,   brotli_flush,   brotli_finish,   brotli_end },
+#endif /* USE_BROTLI */
+#if defined(USE_ZSTD)
+	{ "zstd",         4, "zstd",     4, zstd_init,     zstd_add_data,     zstd_flush,     zstd_finish,     zstd_end },
+#endif /* USE_ZSTD */
 	{ NULL,       0, NULL,          0, NULL ,         NULL,              NULL,           NULL,           NULL }
 };
 
@@ -148,7 +223,7 @@ int comp_append_algo(struct comp *comp, const char *algo)
 	return -1;
 }
 
-#if defined(USE_ZLIB) || defined(USE_SLZ)
+#if defined(USE_ZLIB) || defined(USE_SLZ) || defined(USE_BROTLI) || defined(USE_ZSTD)
 DECLARE_STATIC_POOL(pool_comp_ctx, "comp_ctx", sizeof(struct comp_ctx));
 
 /*
@@ -178,6 +253,12 @@ static inline int init_comp_ctx(struct comp_ctx **comp_ctx)
 	strm->zalloc = alloc_zlib;
 	strm->zfree = free_zlib;
 	strm->opaque = *comp_ctx;
+#endif
+#if defined(USE_BROTLI)
+	(*comp_ctx)->brotli = NULL;
+#endif
+#if defined(USE_ZSTD)
+	(*comp_ctx)->zstd = NULL;
 #endif
 	return 0;
 }
@@ -701,6 +782,281 @@ static int zlib_parse_global_windowsize(char **args, int section_type, struct pr
 
 #endif /* USE_ZLIB */
 
+#if defined(USE_BROTLI) || defined(USE_ZSTD)
+
+/* Allocates an area of <size> bytes from the pool of <pools> matching this
+ * size, which is created on the first use. Returns NULL on failure.
+ */
+static void *comp_pools_alloc(struct comp_pools *pools, size_t size)
+{
+	struct pool_head *pool = NULL;
+	void *area;
+	int i;
+
+	size += COMP_AREA_HDR;
+	for (i = 0; i < COMP_MAX_POOLS && pools->pool[i]; i++) {
+		if (pools->size[i] == size) {
+			pool = pools->pool[i];
+			break;
+		}
+	}
+
+	if (!pool && i < COMP_MAX_POOLS) {
+		HA_SPIN_LOCK(COMP_POOL_LOCK, &comp_pool_lock);
+		/* another thread may have created it in the mean time */
+		for (i = 0; i < COMP_MAX_POOLS && pools->pool[i]; i++) {
+			if (pools->size[i] == size)
+				break;
+		}
+		if (i < COMP_MAX_POOLS && !pools->pool[i]) {
+			pools->size[i] = size;
+			__ha_barrier_store();
+			pools->pool[i] = create_pool(pools->name, size, MEM_F_SHARED);
+		}
+		if (i < COMP_MAX_POOLS)
+			pool = pools->pool[i];
+		HA_SPIN_UNLOCK(COMP_POOL_LOCK, &comp_pool_lock);
+	}
+
+	area = pool ? pool_alloc(pool) : malloc(size);
+	if (!area)
+		return NULL;
+
+	*(struct pool_head **)area = pool;
+	return (char *)area + COMP_AREA_HDR;
+}
+
+/* Releases an area allocated using comp_pools_alloc(). */
+static void comp_pools_free(void *ptr)
+{
+	struct pool_head *pool;
+
+	if (!ptr)
+		return;
+
+	ptr = (char *)ptr - COMP_AREA_HDR;
+	pool = *(struct pool_head **)ptr;
+	if (pool)
+		pool_free(pool, ptr);
+	else
+		free(ptr);
+}
+
+#endif /* USE_BROTLI || USE_ZSTD */
+
+#if defined(USE_BROTLI)
+
+/**************************
+****  brotli algorithm ****
+***************************/
+
+static void *alloc_brotli(void *opaque, size_t size)
+{
+	return comp_pools_alloc(&brotli_pools, size);
+}
+
+static void free_brotli(void *opaque, void *ptr)
+{
+	comp_pools_free(ptr);
+}
+
+/* The quality cannot be changed once the compression has started, so the
+ * level is only set here. Returns < 0 on error.
+ */
+static int brotli_init(struct comp_ctx **comp_ctx, int level)
+{
+	BrotliEncoderState *state;
+
+	if (init_comp_ctx(comp_ctx) < 0)
+		return -1;
+
+	state = BrotliEncoderCreateInstance(alloc_brotli, free_brotli, NULL);
+	if (!state ||
+	    !BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, level) ||
+	    !BrotliEncoderSetParameter(state, BROTLI_PARAM_LGWIN, BROTLI_WINDOW_BITS)) {
+		if (state)
+			BrotliEncoderDestroyInstance(state);
+		deinit_comp_ctx(comp_ctx);
+		return -1;
+	}
+
+	(*comp_ctx)->brotli = state;
+	(*comp_ctx)->cur_lvl = level;
+	return 0;
+}
+
+/* Runs the brotli encoder on <in_len> bytes at <in_data> with operation <op>,
+ * and appends the output to <out>. Returns the size of consumed data or -1.
+ */
+static int brotli_process(struct comp_ctx *comp_ctx, BrotliEncoderOperation op,
+                          const char *in_data, int in_len, struct buffer *out)
+{
+	const uint8_t *next_in = (const uint8_t *)in_data;
+	uint8_t *next_out = (uint8_t *)b_tail(out);
+	size_t avail_in = in_len;
+	size_t avail_out = b_room(out);
+
+	if (!avail_out)
+		return -1;
+
+	if (!BrotliEncoderCompressStream(comp_ctx->brotli, op, &avail_in, &next_in,
+	                                 &avail_out, &next_out, NULL))
+		return -1;
+
+	b_add(out, b_room(out) - avail_out);
+	return in_len - avail_in;
+}
+
+/* Return the size of consumed data or -1 */
+static int brotli_add_data(struct comp_ctx *comp_ctx, const char *in_data, int in_len, struct buffer *out)
+{
+	if (in_len <= 0)
+		return 0;
+
+	return brotli_process(comp_ctx, BROTLI_OPERATION_PROCESS, in_data, in_len, out);
+}
+
+static int brotli_flush(struct comp_ctx *comp_ctx, struct buffer *out)
+{
+	size_t out_len = b_data(out);
+
+	if (brotli_process(comp_ctx, BROTLI_OPERATION_FLUSH, NULL, 0, out) < 0)
+		return -1;
+
+	return b_data(out) - out_len;
+}
+
+static int brotli_finish(struct comp_ctx *comp_ctx, struct buffer *out)
+{
+	size_t out_len = b_data(out);
+
+	if (brotli_process(comp_ctx, BROTLI_OPERATION_FINISH, NULL, 0, out) < 0 ||
+	    !BrotliEncoderIsFinished(comp_ctx->brotli))
+		return -1;
+
+	return b_data(out) - out_len;
+}
+
+static int brotli_end(struct comp_ctx **comp_ctx)
+{
+	BrotliEncoderDestroyInstance((*comp_ctx)->brotli);
+	deinit_comp_ctx(comp_ctx);
+	return 0;
+}
+
+#endif /* USE_BROTLI */
+
+#if defined(USE_ZSTD)
+
+/**************************
+****   zstd algorithm  ****
+***************************/
+
+static void *alloc_zstd(void *opaque, size_t size)
+{
+	return comp_pools_alloc(&zstd_pools, size);
+}
+
+static void free_zstd(void *opaque, void *ptr)
+{
+	comp_pools_free(ptr);
+}
+
+/* The level is only set here, as it is not applied to a frame being
+ * compressed. Level 0 is zstd's default level, so it is not used. Returns
+ * < 0 on error.
+ */
+static int zstd_init(struct comp_ctx **comp_ctx, int level)
+{
+	static const ZSTD_customMem mem = { alloc_zstd, free_zstd, NULL };
+	ZSTD_CCtx *cctx;
+
+	if (init_comp_ctx(comp_ctx) < 0)
+		return -1;
+
+	if (!level)
+		level = 1;
+
+	cctx = ZSTD_createCCtx_advanced(mem);
+	if (!cctx ||
+	    ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level)) ||
+	    ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, ZSTD_WINDOW_BITS))) {
+		ZSTD_freeCCtx(cctx);
+		deinit_comp_ctx(comp_ctx);
+		return -1;
+	}
+
+	(*comp_ctx)->zstd = cctx;
+	(*comp_ctx)->cur_lvl = level;
+	return 0;
+}
+
+/* Runs the zstd compressor on <in_len> bytes at <in_data> with directive
+ * <mode>, and appends the output to <out>. Returns the size of consumed data
+ * or -1. <*remain> is set to the number of bytes remaining to be flushed.
+ */
+static int zstd_process(struct comp_ctx *comp_ctx, ZSTD_EndDirective mode,
+                        const char *in_data, int in_len, struct buffer *out, size_t *remain)
+{
+	ZSTD_inBuffer in = { in_data, in_len, 0 };
+	ZSTD_outBuffer ob = { b_tail(out), b_room(out), 0 };
+	size_t ret;
+
+	if (!ob.size)
+		return -1;
+
+	ret = ZSTD_compressStream2(comp_ctx->zstd, &ob, &in, mode);
+	if (ZSTD_isError(ret))
+		return -1;
+
+	b_add(out, ob.pos);
+	*remain = ret;
+	return in.pos;
+}
+
+/* Return the size of consumed data or -1 */
+static int zstd_add_data(struct comp_ctx *comp_ctx, const char *in_data, int in_len, struct buffer *out)
+{
+	size_t remain;
+
+	if (in_len <= 0)
+		return 0;
+
+	return zstd_process(comp_ctx, ZSTD_e_continue, in_data, in_len, out, &remain);
+}
+
+/* Data remaining to be flushed are emitted on the next call */
+static int zstd_flush(struct comp_ctx *comp_ctx, struct buffer *out)
+{
+	size_t out_len = b_data(out);
+	size_t remain;
+
+	if (zstd_process(comp_ctx, ZSTD_e_flush, NULL, 0, out, &remain) < 0)
+		return -1;
+
+	return b_data(out) - out_len;
+}
+
+static int zstd_finish(struct comp_ctx *comp_ctx, struct buffer *out)
+{
+	size_t out_len = b_data(out);
+	size_t remain;
+
+	if (zstd_process(comp_ctx, ZSTD_e_end, NULL, 0, out, &remain) < 0 || remain)
+		return -1;
+
+	return b_data(out) - out_len;
+}
+
+static int zstd_end(struct comp_ctx **comp_ctx)
+{
+	ZSTD_freeCCtx((*comp_ctx)->zstd);
+	deinit_comp_ctx(comp_ctx);
+	return 0;
+}
+
+#endif /* USE_ZSTD */
+
 
 /* config keyword parsers */
 static struct cfg_kw_list cfg_kws = {ILH, {
@@ -725,6 +1081,14 @@ static void comp_register_build_opts(void)
 	memprintf(&ptr, "Built with libslz for stateless compression.");
 #else
 	memprintf(&ptr, "Built without compression support (neither USE_ZLIB nor USE_SLZ are set).");
+#endif
+#if defined(USE_BROTLI)
+	memprintf(&ptr, "%s\nRunning on brotli version : %u.%u.%u", ptr,
+		  BrotliEncoderVersion() >> 24, (BrotliEncoderVersion() >> 12) & 0xfff, BrotliEncoderVersion() & 0xfff);
+#endif
+#if defined(USE_ZSTD)
+	memprintf(&ptr, "%s\nBuilt with zstd version : " ZSTD_VERSION_STRING, ptr);
+	memprintf(&ptr, "%s\nRunning on zstd version : %s", ptr, ZSTD_versionString());
 #endif
 	memprintf(&ptr, "%s\nCompression algorithms supported :", ptr);
 
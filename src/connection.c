@@ -14,13 +14,17 @@
 
 #include <import/ebmbtree.h>
 
+#include <haproxy/activity.h>
 #include <haproxy/api.h>
+#include <haproxy/arg.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/connection.h>
 #include <haproxy/fd.h>
+#include <haproxy/freq_ctr.h>
 #include <haproxy/frontend.h>
 #include <haproxy/hash.h>
 #include <haproxy/list.h>
+#include <haproxy/listener.h>
 #include <haproxy/log-t.h>
 #include <haproxy/namespace.h>
 #include <haproxy/net_helper.h>
@@ -28,6 +32,7 @@
 #include <haproxy/sample.h>
 #include <haproxy/sc_strm.h>
 #include <haproxy/session.h>
+#include <haproxy/sock.h>
 #include <haproxy/ssl_sock.h>
 #include <haproxy/stconn.h>
 #include <haproxy/tools.h>
@@ -37,7 +42,10 @@
 DECLARE_POOL(pool_head_connection,     "connection",     sizeof(struct connection));
 DECLARE_POOL(pool_head_conn_hash_node, "conn_hash_node", sizeof(struct conn_hash_node));
 DECLARE_POOL(pool_head_sockaddr,       "sockaddr",       sizeof(struct sockaddr_storage));
-DECLARE_POOL(pool_head_authority,      "authority",      PP2_AUTHORITY_MAX);
+DECLARE_STATIC_POOL(pool_head_pp_tlvs, "pp_tlvs",        PP2_TLVS_POOL_SIZE);
+
+/* set when some sample fetch functions need all received PROXYv2 TLVs */
+int conn_pp2_keep_tlvs = 0;
 
 struct idle_conns idle_conns[MAX_THREADS] = { };
 struct xprt_ops *registered_xprt[XPRT_ENTRIES] = { NULL, };
@@ -52,6 +60,19 @@ struct mux_stopping_data mux_stopping_data[MAX_THREADS];
 /* disables sending of proxy-protocol-v2's LOCAL command */
 static int pp2_never_send_local;
 
+/* minimum idle ratio difference (in percent) between two threads of the same
+ * group for idle frontend connections to be moved to the least loaded one.
+ * 0 disables migrations.
+ */
+static uint conn_rebalance_gap;
+
+/* per-thread queue of idle frontend connections offered to this thread, and
+ * the tasklet taking them over.
+ */
+static struct mt_list conn_migr_queue[MAX_THREADS];
+static struct tasklet *conn_migr_tasklet[MAX_THREADS];
+static THREAD_LOCAL struct freq_ctr conn_migr_rate;
+
 void conn_delete_from_tree(struct eb64_node *node)
 {
 	eb64_delete(node);
@@ -83,7 +104,7 @@ int conn_create_mux(struct connection *conn)
 		 */
 		if (srv && ((srv->proxy->options & PR_O_REUSE_MASK) == PR_O_REUSE_ALWS) &&
 		    !(conn->flags & CO_FL_PRIVATE) && conn->mux->avail_streams(conn) > 0)
-			eb64_insert(&srv->per_thr[tid].avail_conns, &conn->hash_node->node);
+			eb64_insert(srv_avail_conns(srv), &conn->hash_node->node);
 		else if (conn->flags & CO_FL_PRIVATE) {
 			/* If it fail now, the same will be done in mux->detach() callback */
 			session_add_conn(sess, conn, conn->target);
@@ -431,20 +452,35 @@ void conn_init(struct connection *conn, void *target)
 	conn->subs = NULL;
 	conn->src = NULL;
 	conn->dst = NULL;
+	conn->proxy_tlvs = IST_NULL;
 	conn->proxy_authority = IST_NULL;
 	conn->proxy_unique_id = IST_NULL;
 	conn->hash_node = NULL;
 	conn->xprt = NULL;
+	conn->zc = NULL;
 }
 
 /* Tries to allocate a new connection and initialized its main fields. The
  * connection is returned on success, NULL on failure. The connection must
- * be released using pool_free() or conn_free().
+ * be released using conn_free(). When "tune.session.combined-alloc" is set,
+ * frontend connections are allocated with room for their session.
  */
 struct connection *conn_new(void *target)
 {
 	struct connection *conn;
 	struct conn_hash_node *hash_node;
+	struct sess_conn_slab *slab;
+
+	if ((global.tune.options & GTUNE_SESS_CONN_SLAB) && obj_type(target) == OBJ_TYPE_LISTENER) {
+		slab = pool_alloc(pool_head_sess_conn_slab);
+		if (unlikely(!slab))
+			return NULL;
+		slab->users = 1;
+		conn = &slab->conn;
+		conn_init(conn, target);
+		conn->flags |= CO_FL_SESS_SLAB;
+		return conn;
+	}
 
 	conn = pool_alloc(pool_head_connection);
 	if (unlikely(!conn))
@@ -492,17 +528,27 @@ void conn_free(struct connection *conn)
 	sockaddr_free(&conn->src);
 	sockaddr_free(&conn->dst);
 
-	pool_free(pool_head_authority, istptr(conn->proxy_authority));
+	if (isttest(conn->proxy_tlvs)) {
+		if (istlen(conn->proxy_tlvs) <= PP2_TLVS_POOL_SIZE)
+			pool_free(pool_head_pp_tlvs, istptr(conn->proxy_tlvs));
+		else
+			ha_free(&conn->proxy_tlvs.ptr);
+		conn->proxy_tlvs = IST_NULL;
+	}
 	conn->proxy_authority = IST_NULL;
-
-	pool_free(pool_head_uniqueid, istptr(conn->proxy_unique_id));
 	conn->proxy_unique_id = IST_NULL;
 
 	pool_free(pool_head_conn_hash_node, conn->hash_node);
 	conn->hash_node = NULL;
 
+	if (unlikely(conn->zc))
+		sock_zc_release(conn);
+
 	conn_force_unsubscribe(conn);
-	pool_free(pool_head_connection, conn);
+	if (conn->flags & CO_FL_SESS_SLAB)
+		sess_conn_slab_release(container_of(conn, struct sess_conn_slab, conn));
+	else
+		pool_free(pool_head_connection, conn);
 }
 
 struct conn_hash_node *conn_alloc_hash_node(struct connection *conn)
@@ -765,6 +811,45 @@ static inline size_t get_tlv_length(const struct tlv *src)
 	return (src->length_hi << 8) | src->length_lo;
 }
 
+/* Stores a copy of the PROXYv2 TLVs <tlvs> into <conn>. Small areas are
+ * allocated from the pp_tlvs pool, larger ones using malloc(). Returns
+ * non-zero on success, zero on allocation failure.
+ */
+static int conn_alloc_proxy_tlvs(struct connection *conn, const struct ist tlvs)
+{
+	char *area;
+
+	if (istlen(tlvs) <= PP2_TLVS_POOL_SIZE)
+		area = pool_alloc(pool_head_pp_tlvs);
+	else
+		area = malloc(istlen(tlvs));
+
+	if (!area)
+		return 0;
+
+	memcpy(area, istptr(tlvs), istlen(tlvs));
+	conn->proxy_tlvs = ist2(area, istlen(tlvs));
+	return 1;
+}
+
+/* Looks up the first TLV of type <type> among those received in the PROXYv2
+ * header of <conn> and kept. They were already validated when received.
+ * Returns its value, or IST_NULL if not found.
+ */
+struct ist conn_get_proxy_tlv(const struct connection *conn, int type)
+{
+	const struct tlv *tlv_packet;
+	size_t ofs = 0;
+
+	while (ofs + TLV_HEADER_SIZE <= istlen(conn->proxy_tlvs)) {
+		tlv_packet = (const struct tlv *)(istptr(conn->proxy_tlvs) + ofs);
+		if (tlv_packet->type == type)
+			return ist2((const char *)tlv_packet->value, get_tlv_length(tlv_packet));
+		ofs += TLV_HEADER_SIZE + get_tlv_length(tlv_packet);
+	}
+	return IST_NULL;
+}
+
 /* This handshake handler waits a PROXY protocol header at the beginning of the
  * raw data stream. The header looks like this :
  *
@@ -794,8 +879,10 @@ int conn_recv_proxy(struct connection *conn, int flag)
 	char *line, *end;
 	struct proxy_hdr_v2 *hdr_v2;
 	const char v2sig[] = PP2_SIGNATURE;
+	struct ist authority = IST_NULL, unique_id = IST_NULL;
 	size_t total_v2_len;
 	size_t tlv_offset = 0;
+	size_t tlv_start;
 	int ret;
 
 	if (!conn_ctrl_ready(conn))
@@ -1014,7 +1101,10 @@ int conn_recv_proxy(struct connection *conn, int flag)
 			break;
 		}
 
-		/* TLV parsing */
+		/* TLV parsing. The TLVs are only validated here, they are
+		 * copied at once below if any of them has to be kept.
+		 */
+		tlv_start = tlv_offset;
 		while (tlv_offset < total_v2_len) {
 			struct tlv *tlv_packet;
 			struct ist tlv;
@@ -1044,6 +1134,7 @@ int conn_recv_proxy(struct connection *conn, int flag)
 
 				if (hash_crc32c(trash.area, total_v2_len) != n_crc32c)
 					goto bad_header;
+				write_n32(istptr(tlv), n_crc32c);
 				break;
 			}
 #ifdef USE_NS
@@ -1059,27 +1150,13 @@ int conn_recv_proxy(struct connection *conn, int flag)
 			case PP2_TYPE_AUTHORITY: {
 				if (istlen(tlv) > PP2_AUTHORITY_MAX)
 					goto bad_header;
-				conn->proxy_authority = ist2(pool_alloc(pool_head_authority), 0);
-				if (!isttest(conn->proxy_authority))
-					goto fail;
-				if (istcpy(&conn->proxy_authority, tlv, PP2_AUTHORITY_MAX) < 0) {
-					/* This is impossible, because we verified that the TLV value fits. */
-					my_unreachable();
-					goto fail;
-				}
+				authority = tlv;
 				break;
 			}
 			case PP2_TYPE_UNIQUE_ID: {
 				if (istlen(tlv) > UNIQUEID_LEN)
 					goto bad_header;
-				conn->proxy_unique_id = ist2(pool_alloc(pool_head_uniqueid), 0);
-				if (!isttest(conn->proxy_unique_id))
-					goto fail;
-				if (istcpy(&conn->proxy_unique_id, tlv, UNIQUEID_LEN) < 0) {
-					/* This is impossible, because we verified that the TLV value fits. */
-					my_unreachable();
-					goto fail;
-				}
+				unique_id = tlv;
 				break;
 			}
 			default:
@@ -1094,6 +1171,21 @@ int conn_recv_proxy(struct connection *conn, int flag)
 		 */
 		BUG_ON(tlv_offset != total_v2_len);
 
+		/* Keep the TLVs in a single allocation if some are needed.
+		 * The authority and unique ID point inside.
+		 */
+		if (isttest(authority) || isttest(unique_id) ||
+		    (conn_pp2_keep_tlvs && tlv_start < total_v2_len)) {
+			if (!conn_alloc_proxy_tlvs(conn, ist2(trash.area + tlv_start, total_v2_len - tlv_start)))
+				goto fail;
+			if (isttest(authority))
+				conn->proxy_authority = ist2(istptr(conn->proxy_tlvs) + (istptr(authority) - (trash.area + tlv_start)),
+				                             istlen(authority));
+			if (isttest(unique_id))
+				conn->proxy_unique_id = ist2(istptr(conn->proxy_tlvs) + (istptr(unique_id) - (trash.area + tlv_start)),
+				                             istlen(unique_id));
+		}
+
 		/* unsupported protocol, keep local connection address */
 		break;
 	case 0x00: /* LOCAL command */
@@ -1696,7 +1788,7 @@ void list_mux_proto(FILE *out)
 		done = 0;
 
 		/* note: the block below could be simplied using macros but for only
-		 * 4 flags it's not worth it.
+		 * 5 flags it's not worth it.
 		 */
 		if (item->mux->flags & MX_FL_HTX)
 			done |= fprintf(out, "%sHTX", done ? "|" : "");
@@ -1710,6 +1802,9 @@ void list_mux_proto(FILE *out)
 		if (item->mux->flags & MX_FL_FRAMED)
 			done |= fprintf(out, "%sFRAMED", done ? "|" : "");
 
+		if (item->mux->flags & MX_FL_PIPELINE)
+			done |= fprintf(out, "%sPIPELINE", done ? "|" : "");
+
 		fprintf(out, "\n");
 	}
 }
@@ -2053,6 +2148,25 @@ static int cfg_parse_pp2_never_send_local(char **args, int section_type, struct
 	return 0;
 }
 
+/* config parser for global "tune.listener.rebalance" */
+static int cfg_parse_listener_rebalance(char **args, int section_type, struct proxy *curpx,
+                                        const struct proxy *defpx, const char *file, int line,
+                                        char **err)
+{
+	int gap;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	gap = atoi(args[1]);
+	if (!*args[1] || gap < 0 || gap > 100) {
+		memprintf(err, "'%s' expects a percentage between 0 and 100.", args[0]);
+		return -1;
+	}
+	conn_rebalance_gap = gap;
+	return 0;
+}
+
 /* extracts some info from the connection and appends them to buffer <buf>. The
  * connection's pointer, its direction, target (fe/be/srv), xprt/ctrl, source
  * when set, destination when set, are printed in a compact human-readable format
@@ -2203,6 +2317,61 @@ int smp_fetch_fc_pp_unique_id(const struct arg *args, struct sample *smp, const
 	return 1;
 }
 
+/* fetch an arbitrary TLV from a PROXY protocol header */
+int smp_fetch_fc_pp_tlv(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	struct connection *conn;
+	struct ist tlv;
+
+	conn = objt_conn(smp->sess->origin);
+	if (!conn)
+		return 0;
+
+	if (conn->flags & CO_FL_WAIT_XPRT) {
+		smp->flags |= SMP_F_MAY_CHANGE;
+		return 0;
+	}
+
+	tlv = conn_get_proxy_tlv(conn, args[0].data.sint);
+	if (!isttest(tlv))
+		return 0;
+
+	smp->flags = SMP_F_CONST;
+	smp->data.type = SMP_T_STR;
+	smp->data.u.str.area = (char *)istptr(tlv);
+	smp->data.u.str.data = istlen(tlv);
+
+	return 1;
+}
+
+/* Verifies the TLV type passed to fc_pp_tlv(), which may be given in decimal
+ * or in hexadecimal (0x prefix), converts it to an integer and makes sure the
+ * TLVs will be kept when received. Returns 0 and fills <err_msg> on error.
+ */
+int val_fc_pp_tlv(struct arg *arg, char **err_msg)
+{
+	const char *str = arg[0].data.str.area;
+	char *end;
+	long type;
+
+	if (!arg[0].data.str.data) {
+		memprintf(err_msg, "missing TLV type");
+		return 0;
+	}
+
+	type = strtol(str, &end, 0);
+	if (*end || type < 0 || type > 255) {
+		memprintf(err_msg, "invalid TLV type '%s', must be between 0 and 255 (or 0x00 and 0xff)", str);
+		return 0;
+	}
+
+	chunk_destroy(&arg[0].data.str);
+	arg[0].type = ARGT_SINT;
+	arg[0].data.sint = type;
+	conn_pp2_keep_tlvs = 1;
+	return 1;
+}
+
 /* fetch the error code of a connection */
 int smp_fetch_fc_err(const struct arg *args, struct sample *smp, const char *kw, void *private)
 {
@@ -2277,6 +2446,7 @@ static struct sample_fetch_kw_list sample_fetch_keywords = {ILH, {
 	{ "fc_rcvd_proxy", smp_fetch_fc_rcvd_proxy, 0, NULL, SMP_T_BOOL, SMP_USE_L4CLI },
 	{ "fc_pp_authority", smp_fetch_fc_pp_authority, 0, NULL, SMP_T_STR, SMP_USE_L4CLI },
 	{ "fc_pp_unique_id", smp_fetch_fc_pp_unique_id, 0, NULL, SMP_T_STR, SMP_USE_L4CLI },
+	{ "fc_pp_tlv", smp_fetch_fc_pp_tlv, ARG1(1,STR), val_fc_pp_tlv, SMP_T_STR, SMP_USE_L4CLI },
 	{ /* END */ },
 }};
 
@@ -2284,6 +2454,7 @@ INITCALL1(STG_REGISTER, sample_register_fetches, &sample_fetch_keywords);
 
 static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "pp2-never-send-local", cfg_parse_pp2_never_send_local },
+	{ CFG_GLOBAL, "tune.listener.rebalance", cfg_parse_listener_rebalance },
 	{ /* END */ },
 }};
 
@@ -2419,6 +2590,146 @@ static struct task *mux_stopping_process(struct task *t, void *ctx, unsigned int
 	return t;
 }
 
+/* Offers idle frontend connection <conn> to a less loaded thread of the same
+ * group, if any, as configured by "tune.listener.rebalance". The caller must
+ * be the mux, only when the connection is idle between two requests, with no
+ * pending data in either direction, and with its I/O tasklet flagged with
+ * TASK_F_USR1. On success, the connection is queued for the target thread
+ * which will take it over using the mux's takeover() callback, and 1 is
+ * returned. From this point the caller must not touch the connection anymore,
+ * and its I/O and timeout handlers must first call conn_cancel_migration()
+ * under the current thread's idle_conns lock. Otherwise 0 is returned and
+ * nothing changes.
+ */
+int conn_offer_migration(struct connection *conn)
+{
+#ifdef USE_THREAD
+	struct session *sess = conn->owner;
+	struct listener *l;
+	uint idle, best_idle;
+	ulong mask;
+	int thr, best = -1;
+
+	if (!conn_rebalance_gap || stopping || tg->count < 2)
+		return 0;
+
+	if (!sess || !(l = sess->listener) || !conn->mux->takeover || !conn_ctrl_ready(conn) ||
+	    (conn->flags & (CO_FL_FDLESS | CO_FL_ERROR | CO_FL_SOCK_RD_SH | CO_FL_SOCK_WR_SH | CO_FL_WAIT_L4L6)))
+		return 0;
+
+	/* migrations are only evaluated based on the idle ratio which is
+	 * updated twice a second, so let's limit them to avoid overshooting.
+	 */
+	if (read_freq_ctr(&conn_migr_rate) >= CONN_MIGR_MAX_RATE)
+		return 0;
+
+	idle = HA_ATOMIC_LOAD(&th_ctx->idle_pct);
+	if (idle + conn_rebalance_gap > 100)
+		return 0;
+
+	/* only consider the threads this listener is bound to */
+	best_idle = idle + conn_rebalance_gap - 1;
+	mask = l->rx.bind_thread & tg->threads_enabled & ~ti->ltid_bit;
+	while (mask) {
+		thr = tg->base + my_ffsl(mask) - 1;
+		mask &= mask - 1;
+		idle = HA_ATOMIC_LOAD(&ha_thread_ctx[thr].idle_pct);
+		if (idle > best_idle) {
+			best_idle = idle;
+			best = thr;
+		}
+	}
+
+	if (best < 0)
+		return 0;
+
+	HA_SPIN_LOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
+	conn->flags |= CO_FL_MIGRATING;
+	LIST_DEL_INIT(&conn->stopping_list);
+	MT_LIST_APPEND(&conn_migr_queue[best], &conn->toremove_list);
+	HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
+
+	update_freq_ctr(&conn_migr_rate, 1);
+	tasklet_wakeup_on(conn_migr_tasklet[best], best);
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/* Must be called with the current thread's idle_conns lock held by the I/O
+ * and timeout handlers of a mux which offered connection <conn> for migration,
+ * before touching it. If the connection is still queued, the offer is
+ * withdrawn and 1 is returned, so that the caller may use it as usual. If the
+ * target thread has already picked it, 0 is returned and the caller must leave
+ * it alone: the target thread will take it over and release the caller's
+ * tasklet and task. Returns 1 if the connection was not offered.
+ */
+int conn_cancel_migration(struct connection *conn)
+{
+	if (likely(!(conn->flags & CO_FL_MIGRATING)))
+		return 1;
+
+	if (!MT_LIST_DELETE(&conn->toremove_list))
+		return 0;
+
+	conn->flags &= ~CO_FL_MIGRATING;
+	LIST_APPEND(&mux_stopping_data[tid].list, &conn->stopping_list);
+	return 1;
+}
+
+/* Takes over the idle frontend connections offered to the current thread. A
+ * connection keeps its CO_FL_MIGRATING flag until the mux's takeover()
+ * succeeds, so that the original thread may still withdraw the offer while
+ * it is queued.
+ */
+static struct task *conn_migr_process(struct task *t, void *ctx, unsigned int state)
+{
+	struct connection *conn;
+	struct session *sess;
+	int orig, ret;
+
+	while ((conn = MT_LIST_POP(&conn_migr_queue[tid], struct connection *, toremove_list))) {
+		/* nobody may withdraw the offer while we hold it, the FD still
+		 * belongs to the original thread.
+		 */
+		orig = tg->base + my_ffsl(_HA_ATOMIC_LOAD(&fdtab[conn->handle.fd].thread_mask)) - 1;
+
+		HA_SPIN_LOCK(IDLE_CONNS_LOCK, &idle_conns[orig].idle_conns_lock);
+		ret = conn->mux->takeover(conn, orig);
+		if (ret != 0 && !(conn->flags & CO_FL_ERROR)) {
+			/* the connection was left untouched, most likely
+			 * because the original thread's poller is processing
+			 * its FD. Let's offer it again and retry a bit later.
+			 */
+			MT_LIST_APPEND(&conn_migr_queue[tid], &conn->toremove_list);
+			HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[orig].idle_conns_lock);
+			tasklet_wakeup((struct tasklet *)t);
+			break;
+		}
+		conn->flags &= ~CO_FL_MIGRATING;
+		HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[orig].idle_conns_lock);
+
+		/* the xprt could not be taken over, the original thread was
+		 * woken up to release the connection.
+		 */
+		if (ret != 0)
+			continue;
+
+		sess = conn->owner;
+		_HA_ATOMIC_DEC(&sess->listener->thr_conn[orig]);
+		_HA_ATOMIC_INC(&sess->listener->thr_conn[tid]);
+
+		LIST_APPEND(&mux_stopping_data[tid].list, &conn->stopping_list);
+		_HA_ATOMIC_INC(&activity[tid].conn_migr);
+
+		/* we may have missed the soft-stop notification */
+		if (stopping && conn->mux->wake)
+			conn->mux->wake(conn);
+	}
+	return t;
+}
+
 static int allocate_mux_cleanup(void)
 {
 	/* allocates the thread bound mux_stopping_data task */
@@ -2431,6 +2742,14 @@ static int allocate_mux_cleanup(void)
 	mux_stopping_data[tid].task->process = mux_stopping_process;
 	LIST_INIT(&mux_stopping_data[tid].list);
 
+	MT_LIST_INIT(&conn_migr_queue[tid]);
+	conn_migr_tasklet[tid] = tasklet_new();
+	if (!conn_migr_tasklet[tid]) {
+		ha_alert("Failed to allocate the connection migration tasklet on thread %d.\n", tid);
+		return 0;
+	}
+	conn_migr_tasklet[tid]->process = conn_migr_process;
+
 	return 1;
 }
 REGISTER_PER_THREAD_ALLOC(allocate_mux_cleanup);
@@ -2438,6 +2757,7 @@ REGISTER_PER_THREAD_ALLOC(allocate_mux_cleanup);
 static int deallocate_mux_cleanup(void)
 {
 	task_destroy(mux_stopping_data[tid].task);
+	tasklet_free(conn_migr_tasklet[tid]);
 	return 1;
 }
 REGISTER_PER_THREAD_FREE(deallocate_mux_cleanup);
@@ -2449,6 +2769,8 @@ static void deinit_idle_conns(void)
 	for (i = 0; i < global.nbthread; i++) {
 		if (idle_conns[i].cleanup_task)
 			task_destroy(idle_conns[i].cleanup_task);
+		if (idle_conns[i].prewarm_task)
+			task_destroy(idle_conns[i].prewarm_task);
 	}
 }
 REGISTER_POST_DEINIT(deinit_idle_conns);
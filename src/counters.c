@@ -0,0 +1,76 @@
+/*
+ * Sharded statistics counters management functions.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <stdlib.h>
+
+#include <haproxy/api.h>
+#include <haproxy/counters.h>
+#include <haproxy/global.h>
+#include <haproxy/list.h>
+#include <haproxy/tools.h>
+
+/* number of copies of each counters_shard, zero until the number of threads
+ * is known. It is a power of two.
+ */
+unsigned int counters_nbshards __read_mostly = 0;
+
+/* counters created before the number of threads is known */
+static struct list counters_shards_wait = LIST_HEAD_INIT(counters_shards_wait);
+
+/* Initializes the shards of a fe_counters or be_counters. They are allocated
+ * immediately if the number of threads is known, otherwise they are queued
+ * and will be allocated by counters_shards_alloc_all(). Returns 0 on memory
+ * allocation failure, otherwise non-zero.
+ */
+int counters_shards_init(struct counters_shards *shards)
+{
+	LIST_INIT(&shards->wait);
+	if (!counters_nbshards) {
+		LIST_APPEND(&counters_shards_wait, &shards->wait);
+		return 1;
+	}
+	shards->shard = calloc(counters_nbshards, sizeof(*shards->shard));
+	return shards->shard != NULL;
+}
+
+/* Releases the shards of a fe_counters or be_counters, or removes them from
+ * the wait list if they were not allocated yet. Counters which were never
+ * initialized are ignored.
+ */
+void counters_shards_free(struct counters_shards *shards)
+{
+	if (shards->wait.n)
+		LIST_DEL_INIT(&shards->wait);
+	ha_free(&shards->shard);
+}
+
+/* Sets the number of shards from the number of threads, rounded up to the
+ * next power of two and limited to COUNTERS_SHARDS, then allocates the shards
+ * of all the counters created so far. It must be called once the number of
+ * threads is known and before any counter is updated. Returns 0 on memory
+ * allocation failure, otherwise non-zero.
+ */
+int counters_shards_alloc_all(void)
+{
+	struct counters_shards *shards, *back;
+	unsigned int nb = 1;
+
+	while (nb < global.nbthread && nb < COUNTERS_SHARDS)
+		nb <<= 1;
+	counters_nbshards = nb;
+
+	list_for_each_entry_safe(shards, back, &counters_shards_wait, wait) {
+		LIST_DEL_INIT(&shards->wait);
+		shards->shard = calloc(nb, sizeof(*shards->shard));
+		if (!shards->shard)
+			return 0;
+	}
+	return 1;
+}
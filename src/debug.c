@@ -29,6 +29,7 @@
 #include <haproxy/api.h>
 #include <haproxy/applet.h>
 #include <haproxy/buf.h>
+#include <haproxy/cfgparse.h>
 #include <haproxy/cli.h>
 #include <haproxy/clock.h>
 #include <haproxy/debug.h>
@@ -44,6 +45,7 @@
 #include <haproxy/thread.h>
 #include <haproxy/time.h>
 #include <haproxy/tools.h>
+#include <haproxy/trace.h>
 #include <import/ist.h>
 
 
@@ -70,6 +72,40 @@ volatile unsigned int thread_dump_state = 0;
 unsigned int panic_started = 0;
 unsigned int debug_commands_issued = 0;
 
+/* Slow loops recorded by the watchdog: when a thread's loop runs for longer
+ * than <slow_loop_threshold> milliseconds of CPU time, the watchdog makes the
+ * thread record what it is doing, at most once per loop and once every
+ * SLOW_LOOP_MIN_INTERVAL milliseconds. Records are written from the signal
+ * handler so they only contain raw values, which are only resolved when
+ * dumped by "show threads history".
+ */
+struct slow_loop_rec {
+	ullong date;                       /* monotonic date of the record (ns) */
+	ullong loop_ns;                    /* CPU time spent in the loop so far */
+	const void *task;                  /* task or tasklet running, or NULL */
+	const void *fct;                   /* its handler */
+	const void *ctx;                   /* its context */
+	uint calls;                        /* its number of calls */
+	int nptrs;                         /* number of callers */
+	void *callers[SLOW_LOOP_CALLERS];  /* call trace from the signal handler */
+};
+
+struct slow_loop_hist {
+	struct slow_loop_rec recs[SLOW_LOOP_RECORDS];
+	uint next;                         /* number of records ever written */
+	ullong last_loop;                  /* loop start (CPU time) of the last record */
+};
+
+unsigned int slow_loop_threshold = 0;        /* ms, 0 = disabled */
+static struct slow_loop_hist *slow_loops = NULL; /* one per thread */
+
+/* CLI context for "show threads history" */
+struct show_slow_loops_ctx {
+	int thr;                           /* thread being dumped */
+	uint pos;                          /* next record to dump */
+	int started;                       /* non-zero once <pos> is set for <thr> */
+};
+
 /* dumps a backtrace of the current thread that is appended to buffer <buf>.
  * Lines are prefixed with the string <prefix> which may be empty (used for
  * indenting). It is recommended to use this at a function's tail so that
@@ -188,7 +224,8 @@ void ha_thread_dump(struct buffer *buf, int thr, int calling_tid)
 		      ha_get_pthread_id(thr),
 		      thread_has_tasks(),
 	              !eb_is_empty(&ha_thread_ctx[thr].rqueue_shared),
-	              !eb_is_empty(&ha_thread_ctx[thr].timers),
+	              !eb_is_empty(&ha_thread_ctx[thr].timers) ||
+	              (ha_thread_ctx[thr].wheel && ha_thread_ctx[thr].wheel->count),
 	              !eb_is_empty(&ha_thread_ctx[thr].rqueue),
 	              !(LIST_ISEMPTY(&ha_thread_ctx[thr].tasklets[TL_URGENT]) &&
 			LIST_ISEMPTY(&ha_thread_ctx[thr].tasklets[TL_NORMAL]) &&
@@ -332,6 +369,181 @@ static int cli_io_handler_show_threads(struct appctx *appctx)
 	return 1;
 }
 
+/* Records the current thread's slow loop. It is called by the watchdog from
+ * the signal handler, on the thread to be recorded, so it must not take any
+ * lock nor allocate anything. If the previous record was for the same loop,
+ * only its duration is updated so that the first call trace is preserved.
+ */
+void ha_record_slow_loop(void)
+{
+	struct slow_loop_hist *hist;
+	struct slow_loop_rec *rec;
+	const struct task *t = th_ctx->current;
+	ullong loop = th_ctx->prev_cpu_time;
+	ullong date;
+
+	if (!slow_loops)
+		return;
+
+	hist = &slow_loops[tid];
+	if (hist->next && hist->last_loop == loop) {
+		rec = &hist->recs[(hist->next - 1) % SLOW_LOOP_RECORDS];
+		rec->loop_ns = now_cpu_time() - loop;
+		return;
+	}
+
+	date = now_mono_time();
+	if (hist->next &&
+	    date - hist->recs[(hist->next - 1) % SLOW_LOOP_RECORDS].date < SLOW_LOOP_MIN_INTERVAL * 1000000ULL)
+		return;
+
+	rec = &hist->recs[hist->next % SLOW_LOOP_RECORDS];
+	rec->date    = date;
+	rec->loop_ns = now_cpu_time() - loop;
+	rec->task    = t;
+	rec->fct     = t ? t->process : NULL;
+	rec->ctx     = t ? t->context : NULL;
+	rec->calls   = t ? t->calls : 0;
+	rec->nptrs   = my_backtrace(rec->callers, SLOW_LOOP_CALLERS);
+	hist->last_loop = loop;
+	HA_ATOMIC_STORE(&hist->next, hist->next + 1);
+}
+
+/* parse a "show threads history" command. Returns 1 if a message is returned,
+ * otherwise zero.
+ */
+static int cli_parse_show_slow_loops(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	struct show_slow_loops_ctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+
+	if (!cli_has_level(appctx, ACCESS_LVL_OPER))
+		return 1;
+
+	if (!slow_loops)
+		return cli_msg(appctx, LOG_INFO, "Slow loops are not recorded (see tune.watchdog.slow-loop).\n");
+
+	ctx->thr = 0;
+	ctx->started = 0;
+	return 0;
+}
+
+/* dumps the slow loops recorded by each thread, oldest first. Returns 0 if the
+ * output buffer is full and it needs to be called again, otherwise non-zero.
+ */
+static int cli_io_handler_show_slow_loops(struct appctx *appctx)
+{
+	struct show_slow_loops_ctx *ctx = appctx->svcctx;
+	struct slow_loop_hist *hist;
+	struct slow_loop_rec rec;
+	ullong now_ns = now_mono_time();
+	uint next;
+	int j;
+
+	for (; ctx->thr < global.nbthread; ctx->thr++, ctx->started = 0) {
+		hist = &slow_loops[ctx->thr];
+		next = HA_ATOMIC_LOAD(&hist->next);
+
+		if (!ctx->started) {
+			chunk_reset(&trash);
+			chunk_appendf(&trash, "Thread %d: %u slow loops over %u ms\n",
+			              ctx->thr + 1, next, slow_loop_threshold);
+			if (applet_putchk(appctx, &trash) == -1)
+				return 0;
+			ctx->pos = (next > SLOW_LOOP_RECORDS) ? next - SLOW_LOOP_RECORDS : 0;
+			ctx->started = 1;
+		}
+
+		for (; ctx->pos < next; ctx->pos++) {
+			/* the record may be overwritten while being copied,
+			 * it's only a debugging aid so we don't care.
+			 */
+			rec = hist->recs[ctx->pos % SLOW_LOOP_RECORDS];
+			chunk_reset(&trash);
+			chunk_appendf(&trash, "  #%u: %llu ms ago, loop>=%llu.%03llu ms, task=%p calls=%u fct=%p(",
+			              ctx->pos, (now_ns - rec.date) / 1000000,
+			              rec.loop_ns / 1000000, rec.loop_ns / 1000 % 1000,
+			              rec.task, rec.calls, rec.fct);
+			if (rec.fct)
+				resolve_sym_name(&trash, NULL, rec.fct);
+			chunk_appendf(&trash, ") ctx=%p\n", rec.ctx);
+
+			/* the trace starts in the signal handler and stops
+			 * before the polling loop.
+			 */
+			for (j = 0; j < rec.nptrs; j++) {
+				struct buffer bak = trash;
+				const void *addr;
+
+				chunk_appendf(&trash, "     | %p: ", rec.callers[j]);
+				addr = resolve_sym_name(&trash, NULL, rec.callers[j]);
+				if (addr == ha_record_slow_loop) {
+					trash = bak;
+					continue;
+				}
+				if (addr == run_poll_loop || addr == main) {
+					trash = bak;
+					break;
+				}
+				chunk_appendf(&trash, "\n");
+			}
+			if (applet_putchk(appctx, &trash) == -1)
+				return 0;
+		}
+	}
+	return 1;
+}
+
+/* allocates the slow loop history of all threads if enabled */
+static int init_slow_loops()
+{
+	if (!slow_loop_threshold)
+		return ERR_NONE;
+
+	slow_loops = calloc(global.nbthread, sizeof(*slow_loops));
+	if (!slow_loops) {
+		ha_alert("Failed to allocate the slow loops history.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+	return ERR_NONE;
+}
+
+static void deinit_slow_loops()
+{
+	ha_free(&slow_loops);
+}
+
+REGISTER_POST_CHECK(init_slow_loops);
+REGISTER_POST_DEINIT(deinit_slow_loops);
+
+/* config parser for global "tune.watchdog.slow-loop" */
+static int cfg_parse_slow_loop(char **args, int section_type, struct proxy *curpx,
+                               const struct proxy *defpx, const char *file, int line,
+                               char **err)
+{
+	const char *res;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	res = parse_time_err(args[1], &slow_loop_threshold, TIME_UNIT_MS);
+	if (res == PARSE_TIME_OVER || res == PARSE_TIME_UNDER) {
+		memprintf(err, "'%s' expects a delay between 1 and 2147483647 ms, or 0 to disable.", args[0]);
+		return -1;
+	}
+	else if (res) {
+		memprintf(err, "unexpected character '%c' in argument to '%s'.", *res, args[0]);
+		return -1;
+	}
+	return 0;
+}
+
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.watchdog.slow-loop", cfg_parse_slow_loop },
+	{ /* END */ },
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
+
 #if defined(HA_HAVE_DUMP_LIBS)
 /* parse a "show libs" command. It returns 1 if it emits anything otherwise zero. */
 static int debug_parse_cli_show_libs(char **args, char *payload, struct appctx *appctx, void *private)
@@ -362,6 +574,7 @@ void ha_panic()
 	chunk_appendf(&trash, "Thread %u is about to kill the process.\n", tid + 1);
 	ha_thread_dump_all_to_trash();
 	DISGUISE(write(2, trash.area, trash.data));
+	trace_flight_dump_to_fd(2);
 	for (;;)
 		abort();
 }
@@ -1694,6 +1907,7 @@ static struct cli_kw_list cli_kws = {{ },{
 #if defined(HA_HAVE_DUMP_LIBS)
 	{{ "show", "libs", NULL, NULL },       "show libs                               : show loaded object files and libraries", debug_parse_cli_show_libs, NULL, NULL },
 #endif
+	{{ "show", "threads", "history", NULL }, "show threads history                    : show the slow loops recorded by the watchdog", cli_parse_show_slow_loops, cli_io_handler_show_slow_loops, NULL },
 	{{ "show", "threads", NULL, NULL },    "show threads                            : show some threads debugging information", NULL, cli_io_handler_show_threads, NULL },
 	{{},}
 }};
@@ -4,6 +4,21 @@
 #include <import/ebistree.h>
 #include <haproxy/dict.h>
 #include <haproxy/thread.h>
+#include <haproxy/xxhash.h>
+
+/* Initializes the dictionary <d> named <name>. It is used for statically
+ * allocated dictionaries.
+ */
+void dict_init(struct dict *d, const char *name)
+{
+	int i;
+
+	d->name = name;
+	for (i = 0; i < DICT_SHARDS; i++) {
+		d->shards[i].values = EB_ROOT_UNIQUE;
+		HA_RWLOCK_INIT(&d->shards[i].rwlock);
+	}
+}
 
 struct dict *new_dict(const char *name)
 {
@@ -13,13 +28,18 @@ struct dict *new_dict(const char *name)
 	if (!dict)
 		return NULL;
 
-	dict->name     = name;
-	dict->values   = EB_ROOT_UNIQUE;
-	HA_RWLOCK_INIT(&dict->rwlock);
-
+	dict_init(dict, name);
 	return dict;
 }
 
+/* Returns the shard of dictionary <d> where value <s> of length <len> is
+ * stored.
+ */
+static inline struct dict_shard *dict_shard(struct dict *d, const char *s, size_t len)
+{
+	return &d->shards[XXH32(s, len, 0) & (DICT_SHARDS - 1)];
+}
+
 /*
  * Allocate a new dictionary entry with <s> as string value which is strdup()'ed.
  * Returns the new allocated entry if succeeded, NULL if not.
@@ -59,48 +79,79 @@ static void free_dict_entry(struct dict_entry *de)
 }
 
 /*
- * Simple function to lookup dictionary entries with <s> as value.
+ * Simple function to lookup dictionary entries with <s> as value in shard <ds>.
  */
-static struct dict_entry *__dict_lookup(struct dict *d, const char *s)
+static struct dict_entry *__dict_lookup(struct dict_shard *ds, const char *s)
 {
 	struct dict_entry *de;
 	struct ebpt_node *node;
 
 	de = NULL;
-	node = ebis_lookup(&d->values, s);
+	node = ebis_lookup(&ds->values, s);
 	if (node)
 		de = container_of(node, struct dict_entry, value);
 
 	return de;
 }
 
+/* Takes a reference on entry <de> unless its last reference was already
+ * released, in which case it is about to be removed from the dictionary and
+ * must not be used anymore. Returns non-zero on success.
+ */
+static inline int dict_entry_tryref(struct dict_entry *de)
+{
+	unsigned int refcount = HA_ATOMIC_LOAD(&de->refcount);
+
+	do {
+		if (!refcount)
+			return 0;
+	} while (!HA_ATOMIC_CAS(&de->refcount, &refcount, refcount + 1));
+	return 1;
+}
+
 /*
  * Insert an entry in <d> dictionary with <s> as value. *
  */
 struct dict_entry *dict_insert(struct dict *d, char *s)
 {
-	struct dict_entry *de;
+	struct dict_shard *ds = dict_shard(d, s, strlen(s));
+	struct dict_entry *de, *old;
 	struct ebpt_node *n;
 
-	HA_RWLOCK_RDLOCK(DICT_LOCK, &d->rwlock);
-	de = __dict_lookup(d, s);
-	HA_RWLOCK_RDUNLOCK(DICT_LOCK, &d->rwlock);
-	if (de) {
-		HA_ATOMIC_INC(&de->refcount);
+	/* The reference must be taken under the lock so that the entry cannot
+	 * be released in the mean time.
+	 */
+	HA_RWLOCK_RDLOCK(DICT_LOCK, &ds->rwlock);
+	de = __dict_lookup(ds, s);
+	if (de && !dict_entry_tryref(de))
+		de = NULL;
+	HA_RWLOCK_RDUNLOCK(DICT_LOCK, &ds->rwlock);
+	if (de)
 		return de;
-	}
 
 	de = new_dict_entry(s);
 	if (!de)
 		return NULL;
 
-	HA_RWLOCK_WRLOCK(DICT_LOCK, &d->rwlock);
-	n = ebis_insert(&d->values, &de->value);
-	HA_RWLOCK_WRUNLOCK(DICT_LOCK, &d->rwlock);
+	HA_RWLOCK_WRLOCK(DICT_LOCK, &ds->rwlock);
+	n = ebis_insert(&ds->values, &de->value);
 	if (n != &de->value) {
-		free_dict_entry(de);
-		de = container_of(n, struct dict_entry, value);
+		old = container_of(n, struct dict_entry, value);
+		if (dict_entry_tryref(old)) {
+			free_dict_entry(de);
+			de = old;
+		}
+		else {
+			/* <old> lost its last reference and is waiting for
+			 * the lock to be removed. It is removed now so that
+			 * the new entry can take its place. Its owner will
+			 * only have to free it.
+			 */
+			ebpt_delete(&old->value);
+			ebis_insert(&ds->values, &de->value);
+		}
 	}
+	HA_RWLOCK_WRUNLOCK(DICT_LOCK, &ds->rwlock);
 
 	return de;
 }
@@ -113,15 +164,23 @@ struct dict_entry *dict_insert(struct dict *d, char *s)
  */
 void dict_entry_unref(struct dict *d, struct dict_entry *de)
 {
+	struct dict_shard *ds;
+
 	if (!de)
 		return;
 
 	if (HA_ATOMIC_SUB_FETCH(&de->refcount, 1) != 0)
 		return;
 
-	HA_RWLOCK_WRLOCK(DICT_LOCK, &d->rwlock);
+	/* No reference may be taken anymore on this entry, but it may still
+	 * be visited by a lookup, or it may already have been replaced by a
+	 * new one. In this case it is not in the tree anymore and deleting it
+	 * again has no effect.
+	 */
+	ds = dict_shard(d, de->value.key, de->len);
+	HA_RWLOCK_WRLOCK(DICT_LOCK, &ds->rwlock);
 	ebpt_delete(&de->value);
-	HA_RWLOCK_WRUNLOCK(DICT_LOCK, &d->rwlock);
+	HA_RWLOCK_WRUNLOCK(DICT_LOCK, &ds->rwlock);
 
 	free_dict_entry(de);
 }
@@ -37,6 +37,7 @@
 #include <haproxy/tools.h>
 
 static THREAD_LOCAL char *dns_msg_trash;
+static int dns_max_pipelined_req = DNS_STREAM_DEF_PIPELINED_REQ; /* max pending requests per stream */
 
 DECLARE_STATIC_POOL(dns_session_pool, "dns_session", sizeof(struct dns_session));
 DECLARE_STATIC_POOL(dns_query_pool, "dns_query", sizeof(struct dns_query));
@@ -931,7 +932,7 @@ static void dns_session_release(struct appctx *appctx)
 		return;
 	}
 
-	if (ds->nb_queries < DNS_STREAM_MAX_PIPELINED_REQ)
+	if (ds->nb_queries < dns_max_pipelined_req)
 		LIST_INSERT(&ds->dss->free_sess, &ds->list);
 
 	HA_SPIN_UNLOCK(DNS_LOCK, &dss->lock);
@@ -1172,7 +1173,7 @@ static struct task *dns_process_req(struct task *t, void *context, unsigned int
 
 			if (ring_write(&ds->ring, DNS_TCP_MSG_MAX_SIZE, NULL, 0, &myist, 1) > 0) {
 				ds->nb_queries++;
-				if (ds->nb_queries >= DNS_STREAM_MAX_PIPELINED_REQ)
+				if (ds->nb_queries >= dns_max_pipelined_req)
 					LIST_DEL_INIT(&ds->list);
 				ads = ds;
 			}
@@ -1346,5 +1347,36 @@ void deinit_dns_buffers()
 	ha_free(&dns_msg_trash);
 }
 
+/* config parser for global "tune.dns.max-pipelined-queries" */
+static int cfg_parse_dns_max_pipelined(char **args, int section_type, struct proxy *curpx,
+                                       const struct proxy *defpx, const char *file, int line,
+                                       char **err)
+{
+	int arg = -1;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (*(args[1]) != 0)
+		arg = atoi(args[1]);
+
+	if (arg < 1 || arg > DNS_STREAM_MAX_PIPELINED_REQ) {
+		memprintf(err, "'%s' expects an integer argument between 1 and %d.",
+		          args[0], DNS_STREAM_MAX_PIPELINED_REQ);
+		return -1;
+	}
+
+	dns_max_pipelined_req = arg;
+	return 0;
+}
+
+/* config keyword parsers */
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.dns.max-pipelined-queries", cfg_parse_dns_max_pipelined },
+	{ 0, NULL, NULL }
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
+
 REGISTER_PER_THREAD_ALLOC(init_dns_buffers);
 REGISTER_PER_THREAD_FREE(deinit_dns_buffers);
@@ -16,11 +16,13 @@
 
 #include <haproxy/api.h>
 #include <haproxy/dynbuf.h>
+#include <haproxy/errors.h>
 #include <haproxy/global.h>
 #include <haproxy/list.h>
 #include <haproxy/pool.h>
 
 struct pool_head *pool_head_buffer __read_mostly;
+struct pool_head *pool_head_small_buffer __read_mostly = NULL;
 
 /* perform minimal intializations, report 0 in case of error, 1 if OK. */
 int init_buffer()
@@ -36,6 +38,20 @@ int init_buffer()
 	for (thr = 0; thr < MAX_THREADS; thr++)
 		LIST_INIT(&ha_thread_ctx[thr].buffer_wq);
 
+	if (global.tune.bufsize_small) {
+		if (global.tune.bufsize_small >= global.tune.bufsize) {
+			ha_warning("'tune.bufsize.small' (%d) is not smaller than 'tune.bufsize' (%d), "
+			           "small buffers are disabled.\n", global.tune.bufsize_small, global.tune.bufsize);
+			global.tune.bufsize_small = 0;
+		}
+		else {
+			pool_head_small_buffer = create_pool("buffer_small", global.tune.bufsize_small,
+			                                     MEM_F_SHARED|MEM_F_EXACT);
+			if (!pool_head_small_buffer)
+				return 0;
+		}
+	}
+
 
 	/* The reserved buffer is what we leave behind us. Thus we always need
 	 * at least one extra buffer in minavail otherwise we'll end up waking
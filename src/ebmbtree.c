@@ -31,6 +31,125 @@ ebmb_lookup(struct eb_root *root, const void *x, unsigned int len)
 	return __ebmb_lookup(root, x, len);
 }
 
+/* Number of lookups interleaved by ebmb_lookup_multi() at once */
+#define EBMB_MULTI_LOOKUPS 8
+
+/* Looks up <nb> keys at once in the tree <root>. Key <i> is <keys[i]> and is
+ * <lens[i]> bytes long. The first occurrence of each key, or NULL if none is
+ * found, is stored into <nodes[i]>, exactly as ebmb_lookup() would return it.
+ * The lookups are performed in groups of EBMB_MULTI_LOOKUPS which progress by
+ * one node at a time in turn, and the next node of each lookup is prefetched
+ * before moving to the next one, so that the memory accesses of independent
+ * lookups overlap instead of being serialized. This is only worth it when the
+ * tree is too large to be hot in the caches. Returns the number of keys that
+ * were found.
+ */
+int ebmb_lookup_multi(struct eb_root *root, const void *const *keys, const unsigned int *lens,
+                      struct ebmb_node **nodes, int nb)
+{
+	eb_troot_t *troot[EBMB_MULTI_LOOKUPS];
+	const unsigned char *x[EBMB_MULTI_LOOKUPS];
+	unsigned int len[EBMB_MULTI_LOOKUPS];
+	int pos[EBMB_MULTI_LOOKUPS];
+	unsigned char walk[EBMB_MULTI_LOOKUPS];
+	struct ebmb_node *node;
+	int base, cnt, left, found;
+	int node_bit, side, i;
+
+	found = 0;
+	for (base = 0; base < nb; base += cnt) {
+		cnt = nb - base;
+		if (cnt > EBMB_MULTI_LOOKUPS)
+			cnt = EBMB_MULTI_LOOKUPS;
+
+		left = 0;
+		for (i = 0; i < cnt; i++) {
+			nodes[base + i] = NULL;
+			troot[i] = root->b[EB_LEFT];
+			if (unlikely(troot[i] == NULL))
+				continue;
+			x[i] = keys[base + i];
+			len[i] = lens[base + i];
+			pos[i] = 0;
+			walk[i] = (len[i] == 0);
+			__builtin_prefetch(eb_clrtag(troot[i]));
+			left++;
+		}
+
+		while (left) {
+			for (i = 0; i < cnt; i++) {
+				if (!troot[i])
+					continue;
+
+				if (walk[i]) {
+					/* the key matched, we're looking for the leftmost leaf */
+					if (eb_gettag(troot[i]) != EB_LEAF) {
+						troot[i] = (eb_untag(troot[i], EB_NODE))->b[EB_LEFT];
+						__builtin_prefetch(eb_clrtag(troot[i]));
+						continue;
+					}
+					nodes[base + i] = container_of(eb_untag(troot[i], EB_LEAF),
+					                               struct ebmb_node, node.branches);
+					found++;
+					goto done;
+				}
+
+				if (eb_gettag(troot[i]) == EB_LEAF) {
+					node = container_of(eb_untag(troot[i], EB_LEAF),
+					                    struct ebmb_node, node.branches);
+					if (eb_memcmp(node->key + pos[i], x[i], len[i]) == 0) {
+						nodes[base + i] = node;
+						found++;
+					}
+					goto done;
+				}
+
+				node = container_of(eb_untag(troot[i], EB_NODE),
+				                    struct ebmb_node, node.branches);
+
+				node_bit = node->node.bit;
+				if (node_bit < 0) {
+					/* dup tree: all keys are the same */
+					if (eb_memcmp(node->key + pos[i], x[i], len[i]) != 0)
+						goto done;
+					goto walk_left;
+				}
+
+				/* same bit-walk as __ebmb_lookup() */
+				node_bit = ~node_bit + (pos[i] << 3) + 8;
+				if (node_bit < 0) {
+					while (1) {
+						if (node->key[pos[i]++] ^ *x[i]++)
+							goto done;
+						if (--len[i] == 0)
+							goto walk_left;
+						node_bit += 8;
+						if (node_bit >= 0)
+							break;
+					}
+				}
+
+				side = *x[i] >> node_bit;
+				if (((node->key[pos[i]] >> node_bit) ^ side) > 1)
+					goto done;
+				side &= 1;
+				troot[i] = node->node.branches.b[side];
+				__builtin_prefetch(eb_clrtag(troot[i]));
+				continue;
+			walk_left:
+				troot[i] = node->node.branches.b[EB_LEFT];
+				walk[i] = 1;
+				__builtin_prefetch(eb_clrtag(troot[i]));
+				continue;
+			done:
+				troot[i] = NULL;
+				left--;
+			}
+		}
+	}
+	return found;
+}
+
 /* Insert ebmb_node <new> into subtree starting at node root <root>.
  * Only new->key needs be set with the key. The ebmb_node is returned.
  * If root->b[EB_RGHT]==1, the tree may only contain unique keys. The
@@ -10,6 +10,7 @@
 #include <haproxy/applet-t.h>
 #include <haproxy/buf.h>
 #include <haproxy/cli.h>
+#include <haproxy/clock.h>
 #include <haproxy/errors.h>
 #include <haproxy/global.h>
 #include <haproxy/obj_type.h>
@@ -517,6 +518,80 @@ void ha_notice(const char *fmt, ...)
 	}
 }
 
+/* steps of the startup shorter than this are not reported by "-dT" */
+unsigned int startup_prof_min_ms = 1;
+
+/* returns the number of bytes currently allocated via malloc(), or -1 if the
+ * allocator cannot tell.
+ */
+static long long startup_prof_mem(void)
+{
+#if defined(HA_HAVE_MALLINFO2)
+	struct mallinfo2 mi = mallinfo2();
+
+	return (long long)mi.uordblks + (long long)mi.hblkhd;
+#elif defined(HA_HAVE_MALLOC_TRIM)
+	struct mallinfo mi = mallinfo();
+
+	return (long long)(unsigned int)mi.uordblks + (long long)(unsigned int)mi.hblkhd;
+#else
+	return -1;
+#endif
+}
+
+/* Records in <prof> the current date, CPU time and memory usage, when the
+ * startup profiling is enabled ("-dT") and the process is still starting.
+ */
+void startup_prof_start(struct startup_prof *prof)
+{
+	if ((global.mode & (MODE_DUMP_TIMES|MODE_STARTING)) != (MODE_DUMP_TIMES|MODE_STARTING))
+		return;
+
+	prof->wall = now_mono_time();
+	prof->cpu  = now_cpu_time();
+	prof->mem  = startup_prof_mem();
+}
+
+/* Reports the wall clock time, CPU time and memory growth since <prof> was
+ * started, for the step described by <fmt>, when the startup profiling is
+ * enabled. Unless <always> is set, steps shorter than startup_prof_min_ms are
+ * not reported. The report is emitted on stderr as well as into the startup
+ * logs, so that it may be consulted later with "show startup-logs".
+ */
+void startup_prof_report(const struct startup_prof *prof, int always, const char *fmt, ...)
+{
+	uint64_t wall, cpu;
+	long long mem;
+	char *what = NULL;
+	char memstr[32];
+	va_list argp;
+
+	if ((global.mode & (MODE_DUMP_TIMES|MODE_STARTING)) != (MODE_DUMP_TIMES|MODE_STARTING))
+		return;
+
+	wall = now_mono_time() - prof->wall;
+	cpu  = now_cpu_time() - prof->cpu;
+	if (!always && wall < (uint64_t)startup_prof_min_ms * 1000000)
+		return;
+
+	mem = startup_prof_mem();
+	if (mem >= 0 && prof->mem >= 0)
+		snprintf(memstr, sizeof(memstr), "%+lldkB", (mem - prof->mem) / 1024);
+	else
+		snprintf(memstr, sizeof(memstr), "n/a");
+
+	va_start(argp, fmt);
+	memvprintf(&what, fmt, argp);
+	va_end(argp);
+
+	print_message_args(0, "STARTUP", "%s : wall=%llu.%03llums cpu=%llu.%03llums mem=%s\n",
+	                   what ? what : "",
+	                   (ullong)wall / 1000000, (ullong)(wall / 1000) % 1000,
+	                   (ullong)cpu / 1000000, (ullong)(cpu / 1000) % 1000,
+	                   memstr);
+	free(what);
+}
+
 /*
  * Displays the message on <out> only if quiet mode is not set.
  */
@@ -0,0 +1,772 @@
+/*
+ * FD polling functions for Linux io_uring
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ *
+ * This poller uses io_uring in readiness mode only: file descriptors are
+ * watched using IORING_OP_POLL_ADD requests and the I/O are still performed
+ * by the regular handlers. The benefit over epoll is that all polling changes
+ * are queued into the submission ring and passed to the kernel with the same
+ * syscall which waits for events, so that no syscall is needed anymore for
+ * each polling update.
+ *
+ * Each FD watched by a thread has at most one pending poll request in this
+ * thread's ring. FDs supporting edge-triggered polling are registered only
+ * once using a multishot request for both directions, exactly like epoll does
+ * with EPOLLET. Other FDs use one-shot requests which are re-armed each time
+ * they fire, and which are updated in place when the list of desired events
+ * grows. A request is never removed when events are not desired anymore: once
+ * it fires, it is simply not re-armed, as with other one-shot pollers.
+ *
+ * A poll request holds a reference to the file, so requests must be explicitly
+ * cancelled when an FD is closed, otherwise the socket would not be released.
+ * The user_data of each request carries the FD number and a per-FD generation
+ * number which is incremented on close, so that completions of requests
+ * related to an FD which was since closed are ignored.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include <linux/io_uring.h>
+
+#include <haproxy/activity.h>
+#include <haproxy/api.h>
+#include <haproxy/clock.h>
+#include <haproxy/fd.h>
+#include <haproxy/global.h>
+#include <haproxy/signal.h>
+#include <haproxy/thread.h>
+#include <haproxy/ticks.h>
+#include <haproxy/task.h>
+#include <haproxy/tools.h>
+
+#ifndef POLLRDHUP
+/* POLLRDHUP was defined late in libc, and it appeared in kernel 2.6.17 */
+#define POLLRDHUP 0x2000
+#endif
+
+/* number of submission entries per ring, and completion to submission ratio */
+#define URING_SQ_ENTRIES     1024
+#define URING_CQ_RATIO       8
+
+/* user_data layout: FD on the 32 lower bits, FD generation on the next 30
+ * bits. Bit 63 marks control requests whose completion is ignored.
+ */
+#define URING_UD_GEN_MASK    0x3fffffffU
+#define URING_UD_CTRL        (1ULL << 63)
+
+/* A thread's ring. The pointers reference the areas shared with the kernel. */
+struct uring {
+	int fd;                       /* ring's fd, -1 if not created */
+	uint32_t sq_tail;             /* local copy of the submission tail */
+	uint32_t sq_mask;
+	uint32_t sq_entries;
+	uint32_t cq_mask;
+	uint32_t *sq_khead;
+	uint32_t *sq_ktail;
+	uint32_t *cq_khead;
+	uint32_t *cq_ktail;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ring;
+	void *cq_ring;
+	size_t sq_ring_sz;
+	size_t cq_ring_sz;
+	size_t sqes_sz;
+};
+
+/* Poll requests which must be cancelled by a thread on behalf of another one,
+ * because an FD was closed by a thread which doesn't own the ring.
+ */
+struct uring_remote_cancel {
+	__decl_thread(HA_SPINLOCK_T lock);
+	uint64_t *ud;                 /* user_data of requests to cancel */
+	uint count;                   /* number of entries in ud[] */
+	uint size;                    /* allocated entries in ud[] */
+};
+
+/* private data */
+static struct uring uring[MAX_THREADS] __read_mostly; // per-thread ring
+static struct uring_remote_cancel uring_rcancel[MAX_THREADS];
+static uint32_t *uring_gen = NULL; // per-FD generation number
+
+static inline int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                                     unsigned flags, const void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+/* returns the user_data of poll requests for <fd> */
+static inline uint64_t uring_fd_ud(int fd)
+{
+	return (uint64_t)(uint)fd | ((uint64_t)(_HA_ATOMIC_LOAD(&uring_gen[fd]) & URING_UD_GEN_MASK) << 32);
+}
+
+/* Unmaps the areas of ring <r> and closes it */
+static void uring_release(struct uring *r)
+{
+	if (r->sqes)
+		munmap(r->sqes, r->sqes_sz);
+	if (r->cq_ring && r->cq_ring != r->sq_ring)
+		munmap(r->cq_ring, r->cq_ring_sz);
+	if (r->sq_ring)
+		munmap(r->sq_ring, r->sq_ring_sz);
+	if (r->fd >= 0)
+		close(r->fd);
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+}
+
+/* Creates ring <r> and maps its areas. The features required by this poller
+ * are checked. Returns 1 on success, 0 on failure with the ring released.
+ */
+static int uring_create(struct uring *r)
+{
+	struct io_uring_params p;
+	uint32_t *sq_array;
+	uint i;
+
+	memset(r, 0, sizeof(*r));
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+	p.cq_entries = URING_SQ_ENTRIES * URING_CQ_RATIO;
+	r->fd = sys_io_uring_setup(URING_SQ_ENTRIES, &p);
+	if (r->fd < 0 && errno == EINVAL) {
+		/* COOP_TASKRUN appeared in 5.19 */
+		p.flags &= ~IORING_SETUP_COOP_TASKRUN;
+		r->fd = sys_io_uring_setup(URING_SQ_ENTRIES, &p);
+	}
+
+	if (r->fd < 0)
+		goto fail;
+
+	/* we need to wait with a timeout and not to lose completions */
+	if ((p.features & (IORING_FEAT_SINGLE_MMAP|IORING_FEAT_NODROP|IORING_FEAT_EXT_ARG)) !=
+	    (IORING_FEAT_SINGLE_MMAP|IORING_FEAT_NODROP|IORING_FEAT_EXT_ARG))
+		goto fail;
+
+	r->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	r->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (r->cq_ring_sz > r->sq_ring_sz)
+		r->sq_ring_sz = r->cq_ring_sz;
+	r->cq_ring_sz = r->sq_ring_sz;
+
+	r->sq_ring = mmap(NULL, r->sq_ring_sz, PROT_READ | PROT_WRITE,
+	                  MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->sq_ring == MAP_FAILED) {
+		r->sq_ring = NULL;
+		goto fail;
+	}
+	r->cq_ring = r->sq_ring;
+
+	r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+	               MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) {
+		r->sqes = NULL;
+		goto fail;
+	}
+
+	r->sq_khead   = r->sq_ring + p.sq_off.head;
+	r->sq_ktail   = r->sq_ring + p.sq_off.tail;
+	r->sq_mask    = *(uint32_t *)(r->sq_ring + p.sq_off.ring_mask);
+	r->sq_entries = p.sq_entries;
+	r->cq_khead   = r->cq_ring + p.cq_off.head;
+	r->cq_ktail   = r->cq_ring + p.cq_off.tail;
+	r->cq_mask    = *(uint32_t *)(r->cq_ring + p.cq_off.ring_mask);
+	r->cqes       = r->cq_ring + p.cq_off.cqes;
+	r->sq_tail    = *r->sq_ktail;
+
+	/* SQEs are always used in order, the indirection array is static */
+	sq_array = r->sq_ring + p.sq_off.array;
+	for (i = 0; i < p.sq_entries; i++)
+		sq_array[i] = i;
+
+	return 1;
+ fail:
+	uring_release(r);
+	return 0;
+}
+
+/* Passes all queued SQEs of ring <r> to the kernel without waiting. Returns
+ * the io_uring_enter() result.
+ */
+static int uring_flush(struct uring *r)
+{
+	uint32_t pending;
+	int ret;
+
+	__atomic_store_n(r->sq_ktail, r->sq_tail, __ATOMIC_RELEASE);
+	pending = r->sq_tail - __atomic_load_n(r->sq_khead, __ATOMIC_ACQUIRE);
+	if (!pending)
+		return 0;
+
+	do {
+		ret = sys_io_uring_enter(r->fd, pending, 0, 0, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+	return ret;
+}
+
+/* Returns a cleared SQE from ring <r>, flushing the ring first if it is full.
+ * The SQE is only passed to the kernel on the next io_uring_enter().
+ */
+static struct io_uring_sqe *uring_get_sqe(struct uring *r)
+{
+	struct io_uring_sqe *sqe;
+	int retries = 100;
+
+	while (r->sq_tail - __atomic_load_n(r->sq_khead, __ATOMIC_ACQUIRE) >= r->sq_entries) {
+		/* the kernel may temporarily refuse new SQEs while the CQ
+		 * ring is overflowing, let's give it a chance to progress.
+		 */
+		if (uring_flush(r) < 0 && ((errno != EBUSY && errno != EAGAIN) || !--retries))
+			break;
+	}
+
+	sqe = &r->sqes[r->sq_tail & r->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	r->sq_tail++;
+	return sqe;
+}
+
+/* the 32-bit poll events are word-reversed on big endian machines */
+static inline uint32_t uring_poll32(uint32_t events)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	events = (events << 16) | (events >> 16);
+#endif
+	return events;
+}
+
+/* queues a poll request for events <events> on <fd> into ring <r> */
+static void uring_poll_add(struct uring *r, int fd, uint events, int multishot)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe(r);
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = uring_poll32(events);
+	sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+	sqe->user_data = uring_fd_ud(fd);
+}
+
+/* queues an update of the events of the pending poll request of <fd> */
+static void uring_poll_update(struct uring *r, int fd, uint events)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe(r);
+
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = uring_fd_ud(fd);
+	sqe->poll32_events = uring_poll32(events);
+	sqe->len = IORING_POLL_UPDATE_EVENTS;
+	sqe->user_data = URING_UD_CTRL;
+}
+
+/* queues the cancellation of all requests with user_data <ud> */
+static void uring_cancel(struct uring *r, uint64_t ud)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe(r);
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = ud;
+	sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+	sqe->user_data = URING_UD_CTRL;
+}
+
+/* converts fd state <en> to poll events */
+static inline uint uring_state_to_events(uint en)
+{
+	return ((en & FD_EV_ACTIVE_R) ? POLLIN | POLLRDHUP : 0) |
+	       ((en & FD_EV_ACTIVE_W) ? POLLOUT : 0);
+}
+
+/*
+ * Cancel the poll requests of this file descriptor upon close, since they
+ * hold a reference to the file. Requests registered by other threads are
+ * passed to them.
+ */
+static void __fd_clo(int fd)
+{
+	unsigned long m = _HA_ATOMIC_LOAD(&polled_mask[fd].poll_recv) | _HA_ATOMIC_LOAD(&polled_mask[fd].poll_send);
+	int tgrp = fd_tgid(fd);
+	uint64_t ud = uring_fd_ud(fd);
+	int i;
+
+	/* all requests registered from now on belong to the next user */
+	_HA_ATOMIC_INC(&uring_gen[fd]);
+
+	if (!m)
+		return;
+
+	for (i = ha_tgroup_info[tgrp-1].base; i < ha_tgroup_info[tgrp-1].base + ha_tgroup_info[tgrp-1].count; i++) {
+		struct uring_remote_cancel *rc = &uring_rcancel[i];
+
+		if (!(m & ha_thread_info[i].ltid_bit))
+			continue;
+
+		if (i == tid && uring[i].fd >= 0) {
+			uring_cancel(&uring[i], ud);
+			continue;
+		}
+
+		HA_SPIN_LOCK(OTHER_LOCK, &rc->lock);
+		if (rc->count == rc->size) {
+			uint64_t *new_ud = realloc(rc->ud, (rc->size + 64) * sizeof(*new_ud));
+
+			if (new_ud) {
+				rc->ud = new_ud;
+				rc->size += 64;
+			}
+		}
+		if (rc->count < rc->size)
+			rc->ud[rc->count++] = ud;
+		HA_SPIN_UNLOCK(OTHER_LOCK, &rc->lock);
+		wake_thread(i);
+	}
+}
+
+/* queues the cancellations requested by other threads for the current one */
+static void uring_process_remote_cancel(void)
+{
+	struct uring_remote_cancel *rc = &uring_rcancel[tid];
+	uint i;
+
+	if (!_HA_ATOMIC_LOAD(&rc->count))
+		return;
+
+	HA_SPIN_LOCK(OTHER_LOCK, &rc->lock);
+	for (i = 0; i < rc->count; i++)
+		uring_cancel(&uring[tid], rc->ud[i]);
+	rc->count = 0;
+	HA_SPIN_UNLOCK(OTHER_LOCK, &rc->lock);
+}
+
+static void _update_fd(int fd)
+{
+	struct uring *r = &uring[tid];
+	uint en, events, armed;
+	ulong pr, ps;
+
+	en = fdtab[fd].state;
+	pr = _HA_ATOMIC_LOAD(&polled_mask[fd].poll_recv);
+	ps = _HA_ATOMIC_LOAD(&polled_mask[fd].poll_send);
+
+	if (!(fdtab[fd].thread_mask & ti->ltid_bit)) {
+		/* the FD is not ours anymore, stop watching it */
+		if ((pr | ps) & ti->ltid_bit) {
+			uring_cancel(r, uring_fd_ud(fd));
+			_HA_ATOMIC_AND(&polled_mask[fd].poll_recv, ~ti->ltid_bit);
+			_HA_ATOMIC_AND(&polled_mask[fd].poll_send, ~ti->ltid_bit);
+		}
+		return;
+	}
+
+	/* Use a multishot request for both directions on FDs supporting
+	 * edge-triggered polling.
+	 */
+	if (fdtab[fd].state & FD_ET_POSSIBLE) {
+		/* already done ? */
+		if (pr & ps & ti->ltid_bit)
+			return;
+
+		_HA_ATOMIC_OR(&polled_mask[fd].poll_recv, ti->ltid_bit);
+		_HA_ATOMIC_OR(&polled_mask[fd].poll_send, ti->ltid_bit);
+		uring_poll_add(r, fd, POLLIN | POLLRDHUP | POLLOUT, 1);
+		return;
+	}
+
+	/* A poll request which is not desired anymore is left armed: it will
+	 * not be re-armed once it fires.
+	 */
+	if (!(en & FD_EV_ACTIVE_RW))
+		return;
+
+	events = uring_state_to_events(en);
+	armed = (((pr & ti->ltid_bit) ? FD_EV_ACTIVE_R : 0) |
+	         ((ps & ti->ltid_bit) ? FD_EV_ACTIVE_W : 0));
+
+	if ((en & FD_EV_ACTIVE_RW) == armed)
+		return;
+
+	if (en & FD_EV_ACTIVE_R)
+		_HA_ATOMIC_OR(&polled_mask[fd].poll_recv, ti->ltid_bit);
+	else
+		_HA_ATOMIC_AND(&polled_mask[fd].poll_recv, ~ti->ltid_bit);
+
+	if (en & FD_EV_ACTIVE_W)
+		_HA_ATOMIC_OR(&polled_mask[fd].poll_send, ti->ltid_bit);
+	else
+		_HA_ATOMIC_AND(&polled_mask[fd].poll_send, ~ti->ltid_bit);
+
+	if (armed) {
+		/* If the request already fired, this update fails and the
+		 * pending completion will re-arm the FD.
+		 */
+		uring_poll_update(r, fd, events);
+	}
+	else
+		uring_poll_add(r, fd, events, 0);
+}
+
+/*
+ * Linux io_uring poller
+ */
+static void _do_poll(struct poller *p, int exp, int wake)
+{
+	struct uring *r = &uring[tid];
+	int status;
+	int fd;
+	int count;
+	int updt_idx;
+	int wait_time;
+	int old_fd;
+	uint32_t head;
+
+	/* first, scan the update list to find polling changes */
+	for (updt_idx = 0; updt_idx < fd_nbupdt; updt_idx++) {
+		fd = fd_updt[updt_idx];
+
+		if (!fd_grab_tgid(fd, tgid)) {
+			/* was reassigned */
+			activity[tid].poll_drop_fd++;
+			continue;
+		}
+
+		_HA_ATOMIC_AND(&fdtab[fd].update_mask, ~ti->ltid_bit);
+
+		if (fdtab[fd].owner)
+			_update_fd(fd);
+		else
+			activity[tid].poll_drop_fd++;
+
+		fd_drop_tgid(fd);
+	}
+	fd_nbupdt = 0;
+
+	/* Scan the shared update list */
+	for (old_fd = fd = update_list[tgid - 1].first; fd != -1; fd = fdtab[fd].update.next) {
+		if (fd == -2) {
+			fd = old_fd;
+			continue;
+		}
+		else if (fd <= -3)
+			fd = -fd -4;
+		if (fd == -1)
+			break;
+
+		if (!fd_grab_tgid(fd, tgid)) {
+			/* was reassigned */
+			activity[tid].poll_drop_fd++;
+			continue;
+		}
+
+		if (!(fdtab[fd].update_mask & ti->ltid_bit)) {
+			fd_drop_tgid(fd);
+			continue;
+		}
+
+		done_update_polling(fd);
+
+		if (fdtab[fd].owner)
+			_update_fd(fd);
+		else
+			activity[tid].poll_drop_fd++;
+
+		fd_drop_tgid(fd);
+	}
+
+	uring_process_remote_cancel();
+
+	thread_idle_now();
+	thread_harmless_now();
+
+	/* Now let's wait for polled events. The pending SQEs are submitted
+	 * by the same syscall.
+	 */
+	wait_time = wake ? 0 : compute_poll_timeout(exp);
+	clock_entering_poll();
+
+	do {
+		int timeout = (global.tune.options & GTUNE_BUSY_POLLING) ? 0 : wait_time;
+		struct __kernel_timespec ts = { .tv_sec = timeout / 1000, .tv_nsec = (timeout % 1000) * 1000000 };
+		struct io_uring_getevents_arg arg = { .sigmask_sz = _NSIG / 8, .ts = (uint64_t)(uintptr_t)&ts };
+		uint32_t to_submit;
+
+		__atomic_store_n(r->sq_ktail, r->sq_tail, __ATOMIC_RELEASE);
+		to_submit = r->sq_tail - __atomic_load_n(r->sq_khead, __ATOMIC_ACQUIRE);
+
+		status = __atomic_load_n(r->cq_ktail, __ATOMIC_ACQUIRE) - *r->cq_khead;
+		if (status || !timeout) {
+			/* no need to wait */
+			if (to_submit)
+				sys_io_uring_enter(r->fd, to_submit, 0, 0, NULL, 0);
+			status = __atomic_load_n(r->cq_ktail, __ATOMIC_ACQUIRE) - *r->cq_khead;
+		}
+		else {
+			sys_io_uring_enter(r->fd, to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+			status = __atomic_load_n(r->cq_ktail, __ATOMIC_ACQUIRE) - *r->cq_khead;
+		}
+
+		if (status > global.tune.maxpollevents)
+			status = global.tune.maxpollevents;
+
+		clock_update_local_date(timeout, status);
+
+		if (status) {
+			activity[tid].poll_io++;
+			break;
+		}
+		if (timeout || !wait_time)
+			break;
+		if (tick_isset(exp) && tick_is_expired(exp, now_ms))
+			break;
+	} while (1);
+
+	clock_update_global_date();
+	fd_leaving_poll(wait_time, status);
+
+	/* process polled events */
+
+	head = *r->cq_khead;
+	for (count = 0; count < status; count++, head++) {
+		struct io_uring_cqe *cqe = &r->cqes[head & r->cq_mask];
+		uint64_t ud = cqe->user_data;
+		unsigned int n, e;
+
+		if (ud & URING_UD_CTRL)
+			continue;
+
+		fd = (uint)ud;
+		if (fd >= global.maxsock ||
+		    (uint)(ud >> 32) != (_HA_ATOMIC_LOAD(&uring_gen[fd]) & URING_UD_GEN_MASK)) {
+			/* the FD was closed since */
+			continue;
+		}
+
+		if (!(cqe->flags & IORING_CQE_F_MORE)) {
+			/* the request is terminated and must be re-armed if
+			 * still desired.
+			 */
+			_HA_ATOMIC_AND(&polled_mask[fd].poll_recv, ~ti->ltid_bit);
+			_HA_ATOMIC_AND(&polled_mask[fd].poll_send, ~ti->ltid_bit);
+			if (!HA_ATOMIC_BTS(&fdtab[fd].update_mask, ti->ltid))
+				fd_updt[fd_nbupdt++] = fd;
+		}
+
+		if (cqe->res == -ECANCELED)
+			continue;
+
+		if (cqe->res < 0)
+			e = POLLERR;
+		else
+			e = cqe->res;
+
+		if ((e & POLLRDHUP) && !(cur_poller.flags & HAP_POLL_F_RDHUP))
+			_HA_ATOMIC_OR(&cur_poller.flags, HAP_POLL_F_RDHUP);
+
+#ifdef DEBUG_FD
+		_HA_ATOMIC_INC(&fdtab[fd].event_count);
+#endif
+		n = ((e & POLLIN)    ? FD_EV_READY_R : 0) |
+		    ((e & POLLOUT)   ? FD_EV_READY_W : 0) |
+		    ((e & POLLRDHUP) ? FD_EV_SHUT_R  : 0) |
+		    ((e & POLLHUP)   ? FD_EV_SHUT_RW : 0) |
+		    ((e & POLLERR)   ? FD_EV_ERR_RW  : 0);
+
+		fd_update_events(fd, n);
+	}
+	__atomic_store_n(r->cq_khead, head, __ATOMIC_RELEASE);
+	/* the caller will take care of cached events */
+}
+
+static int init_uring_per_thread()
+{
+	if (MAX_THREADS > 1 && tid) {
+		if (!uring_create(&uring[tid]))
+			return 0;
+	}
+
+	/* we may have to unregister some events initially registered on the
+	 * original ring when it was alone, and/or to register events on the
+	 * new ring for this thread. Let's just mark them as updated, the
+	 * poller will do the rest.
+	 */
+	fd_reregister_all(tgid, ti->ltid_bit);
+
+	return 1;
+}
+
+static void deinit_uring_per_thread()
+{
+	if (MAX_THREADS > 1 && tid)
+		uring_release(&uring[tid]);
+
+	ha_free(&uring_rcancel[tid].ud);
+	uring_rcancel[tid].count = uring_rcancel[tid].size = 0;
+}
+
+/*
+ * Initialization of the io_uring poller.
+ * Returns 0 in case of failure, non-zero in case of success. If it fails, it
+ * disables the poller by setting its pref to 0.
+ */
+static int _do_init(struct poller *p)
+{
+	p->private = NULL;
+
+	uring_gen = calloc(global.maxsock, sizeof(*uring_gen));
+	if (!uring_gen)
+		goto fail_gen;
+
+	if (!uring_create(&uring[tid]))
+		goto fail_ring;
+
+	hap_register_per_thread_init(init_uring_per_thread);
+	hap_register_per_thread_deinit(deinit_uring_per_thread);
+
+	return 1;
+
+ fail_ring:
+	ha_free(&uring_gen);
+ fail_gen:
+	p->pref = 0;
+	return 0;
+}
+
+/*
+ * Termination of the io_uring poller.
+ * Memory is released and the poller is marked as unselectable.
+ */
+static void _do_term(struct poller *p)
+{
+	if (uring[tid].fd >= 0)
+		uring_release(&uring[tid]);
+
+	ha_free(&uring_gen);
+	p->private = NULL;
+	p->pref = 0;
+}
+
+/*
+ * Check that the poller works: the ring must be created with the required
+ * features and the kernel must support updating poll requests and cancelling
+ * all requests matching a user_data (Linux 5.19 and above). Both operations
+ * are tried on a non-existing request.
+ * Returns 1 if OK, otherwise 0.
+ */
+static int _do_test(struct poller *p)
+{
+	struct uring r;
+	struct io_uring_sqe *sqe;
+	int i, ret = 0;
+
+	if (!uring_create(&r))
+		return 0;
+
+	sqe = uring_get_sqe(&r);
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = 1;
+	sqe->poll32_events = uring_poll32(POLLIN);
+	sqe->len = IORING_POLL_UPDATE_EVENTS;
+	sqe->user_data = 1;
+
+	sqe = uring_get_sqe(&r);
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = 1;
+	sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+	sqe->user_data = 2;
+
+	__atomic_store_n(r.sq_ktail, r.sq_tail, __ATOMIC_RELEASE);
+	if (sys_io_uring_enter(r.fd, 2, 2, IORING_ENTER_GETEVENTS, NULL, 0) != 2)
+		goto end;
+
+	if (__atomic_load_n(r.cq_ktail, __ATOMIC_ACQUIRE) - *r.cq_khead != 2)
+		goto end;
+
+	for (i = 0; i < 2; i++) {
+		struct io_uring_cqe *cqe = &r.cqes[(*r.cq_khead + i) & r.cq_mask];
+
+		/* the update fails with ENOENT, the cancellation reports the
+		 * number of cancelled requests (none) or ENOENT, depending
+		 * on the version. Unsupported flags are reported as EINVAL.
+		 */
+		if (cqe->res != -ENOENT && (cqe->user_data == 1 || cqe->res < 0))
+			goto end;
+	}
+	ret = 1;
+ end:
+	uring_release(&r);
+	return ret;
+}
+
+/*
+ * Recreate the ring after a fork(). Returns 1 if OK, otherwise 0. It will
+ * ensure that all processes will not share their rings.
+ */
+static int _do_fork(struct poller *p)
+{
+	if (uring[tid].fd >= 0)
+		uring_release(&uring[tid]);
+	return uring_create(&uring[tid]);
+}
+
+/*
+ * Registers the poller.
+ */
+static void _do_register(void)
+{
+	struct poller *p;
+	int i;
+
+	if (nbpollers >= MAX_POLLERS)
+		return;
+
+	for (i = 0; i < MAX_THREADS; i++) {
+		uring[i].fd = -1;
+		HA_SPIN_INIT(&uring_rcancel[i].lock);
+	}
+
+	p = &pollers[nbpollers++];
+
+	p->name = "io_uring";
+	p->pref = 350;
+	p->flags = HAP_POLL_F_ERRHUP; // note: RDHUP might be dynamically added
+	p->private = NULL;
+
+	p->clo  = __fd_clo;
+	p->test = _do_test;
+	p->init = _do_init;
+	p->term = _do_term;
+	p->poll = _do_poll;
+	p->fork = _do_fork;
+}
+
+INITCALL0(STG_REGISTER, _do_register);
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ */
@@ -11,6 +11,8 @@
  */
 
 #include <string.h>
+#include <haproxy/activity.h>
+#include <haproxy/cfgparse.h>
 #include <haproxy/event_hdl.h>
 #include <haproxy/compiler.h>
 #include <haproxy/task.h>
@@ -26,6 +28,12 @@ static struct event_hdl_sub_type_map event_hdl_sub_type_map[] = {
 	{"SERVER",              EVENT_HDL_SUB_SERVER},
 	{"SERVER_ADD",          EVENT_HDL_SUB_SERVER_ADD},
 	{"SERVER_DEL",          EVENT_HDL_SUB_SERVER_DEL},
+	{"SERVER_UP",           EVENT_HDL_SUB_SERVER_UP},
+	{"SERVER_DOWN",         EVENT_HDL_SUB_SERVER_DOWN},
+	{"SERVER_WEIGHT",       EVENT_HDL_SUB_SERVER_WEIGHT},
+	{"SERVER_MAXCONN",      EVENT_HDL_SUB_SERVER_MAXCONN},
+	{"SERVER_QUEUE_HIGH",   EVENT_HDL_SUB_SERVER_QUEUE_HIGH},
+	{"SERVER_QUEUE_LOW",    EVENT_HDL_SUB_SERVER_QUEUE_LOW},
 };
 
 /* internal types (only used in this file) */
@@ -44,10 +52,10 @@ DECLARE_STATIC_POOL(pool_head_sub_taskctx, "ehdl_sub_tctx", sizeof(struct event_
 /* global subscription list (implicit where NULL is used as sublist argument) */
 static struct mt_list global_event_hdl_sub_list = MT_LIST_HEAD_INIT(global_event_hdl_sub_list);
 
-/* TODO: will become a config tunable
- * ie: tune.events.max-async-notif-at-once
+/* max number of events delivered to a normal mode async handler per run
+ * (tune.events.max-events-at-once)
  */
-static int event_hdl_async_max_notif_at_once = 10;
+static int event_hdl_async_max_notif_at_once = EVENT_HDL_MAX_AT_ONCE;
 
 /* general purpose hashing function when you want to compute
  * an ID based on <scope> x <name>
@@ -160,6 +168,23 @@ void event_hdl_async_free_event(struct event_hdl_async_event *e)
 	pool_free(pool_head_sub_event, e);
 }
 
+/* Appends event <e> to async event queue <queue> and wakes <task> up if the
+ * queue was empty. Events published while the consumer has not run yet are
+ * thus all delivered in the same run, with a single wakeup. The event is
+ * appended before the size is increased so that a consumer never misses an
+ * event: whoever turns the size from 0 to 1 performs the wakeup.
+ */
+static inline void event_hdl_async_equeue_push(event_hdl_async_equeue *queue, struct tasklet *task,
+                                               struct event_hdl_async_event *e)
+{
+	MT_LIST_APPEND(&queue->head, &e->mt_list);
+	activity[tid].ehdl_queued++;
+	if (HA_ATOMIC_ADD_FETCH(&queue->size, 1) == 1) {
+		activity[tid].ehdl_wakeups++;
+		tasklet_wakeup(task);
+	}
+}
+
 /* task handler used for normal async subscription mode
  * if you use advanced async subscription mode, you can use this
  * as an example to implement your own task wrapper
@@ -210,6 +235,16 @@ static struct task *event_hdl_async_task_default(struct task *task, void *ctx, u
 		tasklet_free(tl);
 		return NULL;
 	}
+
+	if (max_notif_at_once_it >= event_hdl_async_max_notif_at_once &&
+	    !MT_LIST_ISEMPTY(&task_ctx->e_queue.head)) {
+		/* batch limit reached: let other tasks run and come back for
+		 * the remaining events, as no producer will wake us up while
+		 * the queue is not empty.
+		 */
+		activity[tid].ehdl_deferred++;
+		tasklet_wakeup(tl);
+	}
 	return task;
 }
 
@@ -267,7 +302,8 @@ static inline void _event_hdl_unsubscribe(struct event_hdl_sub *del_sub)
 		 * consumed the END event before the wakeup, and some tasks
 		 * kill themselves (ie: normal async mode) when they receive such event
 		 */
-		lock = MT_LIST_APPEND_LOCKED(del_sub->hdl.async_equeue, &del_sub->async_end->mt_list);
+		lock = MT_LIST_APPEND_LOCKED(&del_sub->hdl.async_equeue->head, &del_sub->async_end->mt_list);
+		HA_ATOMIC_INC(&del_sub->hdl.async_equeue->size);
 
 		/* wake up the task */
 		tasklet_wakeup(del_sub->hdl.async_task);
@@ -429,7 +465,7 @@ struct event_hdl_sub *event_hdl_subscribe_ptr(event_hdl_sub_list *sub_list,
 				/* memory error */
 				goto new_sub_memory_error_task_ctx;
 			}
-			MT_LIST_INIT(&task_ctx->e_queue);
+			event_hdl_async_equeue_init(&task_ctx->e_queue);
 			task_ctx->func = new_sub->hdl.async_ptr;
 
 			new_sub->hdl.async_equeue = &task_ctx->e_queue;
@@ -694,12 +730,11 @@ static int _event_hdl_publish(event_hdl_sub_list *sub_list, struct event_hdl_sub
 				} else
 					new_event->data = NULL;
 
-				/* appending new event to event hdl queue */
+				/* appending new event to event hdl queue, this wakes
+				 * up the task if it has no other event pending.
+				 */
 				MT_LIST_INIT(&new_event->mt_list);
-				MT_LIST_APPEND(cur_sub->hdl.async_equeue, &new_event->mt_list);
-
-				/* wake up the task */
-				tasklet_wakeup(cur_sub->hdl.async_task);
+				event_hdl_async_equeue_push(cur_sub->hdl.async_equeue, cur_sub->hdl.async_task, new_event);
 			} /* end async mode */
 		} /* end hdl should be notified */
 	} /* end mt_list */
@@ -756,3 +791,31 @@ void event_hdl_sub_list_destroy(event_hdl_sub_list *sub_list)
 		_event_hdl_unsubscribe(cur_sub);
 	}
 }
+
+/* config parser for global "tune.events.max-events-at-once" */
+static int event_hdl_parse_max_events_at_once(char **args, int section_type, struct proxy *curpx,
+                                              const struct proxy *defpx, const char *file, int line,
+                                              char **err)
+{
+	int arg;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	arg = atoi(args[1]);
+	if (*(args[1]) == 0 || arg < 1 || arg > 10000) {
+		memprintf(err, "'%s' expects an integer argument between 1 and 10000.", args[0]);
+		return -1;
+	}
+
+	event_hdl_async_max_notif_at_once = arg;
+	return 0;
+}
+
+/* config keyword parsers */
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.events.max-events-at-once", event_hdl_parse_max_events_at_once },
+	{ 0, NULL, NULL }
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
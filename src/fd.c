@@ -116,8 +116,39 @@ THREAD_LOCAL int poller_rd_pipe = -1; // Pipe to wake the thread
 int poller_wr_pipe[MAX_THREADS] __read_mostly; // Pipe to wake the threads
 
 volatile int ha_used_fds = 0; // Number of FD we're currently using
+volatile int fdtab_inited = 0; // Number of leading fdtab entries initialized, see fd_init_entries()
+__decl_thread(static HA_SPINLOCK_T fdtab_init_lock);
 static struct fdtab *fdtab_addr;  /* address of the allocated area containing fdtab */
 
+/* Initializes the fdtab entries up to and including the chunk holding <fd>.
+ * The fdtab is allocated for global.maxsock entries but the pages of its
+ * entries are only touched once they are about to be used, so that the memory
+ * really used by a process configured for millions of FDs scales with the
+ * highest FD it uses. The kernel always assigns the lowest available FD, which
+ * makes the used entries dense. Entries from <fdtab_inited> and above were
+ * never used, which also allows loops over all FDs to stop there.
+ */
+void fd_init_entries(int fd)
+{
+	int p, end;
+
+	HA_SPIN_LOCK(OTHER_LOCK, &fdtab_init_lock);
+	end = (fd + FDTAB_INIT_CHUNK) & -FDTAB_INIT_CHUNK;
+	if (end > global.maxsock)
+		end = global.maxsock;
+
+	for (p = fdtab_inited; p < end; p++) {
+		/* Mark the fd as out of the fd cache */
+		fdtab[p].update.next = -3;
+	}
+
+	if (end > fdtab_inited) {
+		__ha_barrier_store();
+		HA_ATOMIC_STORE(&fdtab_inited, end);
+	}
+	HA_SPIN_UNLOCK(OTHER_LOCK, &fdtab_init_lock);
+}
+
 /* adds fd <fd> to fd list <list> if it was not yet in it */
 void fd_add_to_fd_list(volatile struct fdlist *list, int fd)
 {
@@ -702,7 +733,7 @@ void fd_reregister_all(int tgrp, ulong mask)
 {
 	int fd;
 
-	for (fd = 0; fd < global.maxsock; fd++) {
+	for (fd = 0; fd < fdtab_inited; fd++) {
 		if (!fdtab[fd].owner)
 			continue;
 
@@ -943,6 +974,7 @@ int compute_poll_timeout(int next)
 void fd_leaving_poll(int wait_time, int status)
 {
 	clock_leaving_poll(wait_time, status);
+	th_ctx->poll_events = status > 0 ? status : 0;
 
 	thread_harmless_end();
 	thread_idle_end();
@@ -1045,10 +1077,8 @@ int init_pollers()
 	for (p = 0; p < MAX_TGROUPS; p++)
 		update_list[p].first = update_list[p].last = -1;
 
-	for (p = 0; p < global.maxsock; p++) {
-		/* Mark the fd as out of the fd cache */
-		fdtab[p].update.next = -3;
-	}
+	/* entries are initialized on first use by fd_insert() */
+	fdtab_inited = 0;
 
 	do {
 		bp = NULL;
@@ -1159,7 +1189,7 @@ int list_pollers(FILE *out)
 int fork_poller()
 {
 	int fd;
-	for (fd = 0; fd < global.maxsock; fd++) {
+	for (fd = 0; fd < fdtab_inited; fd++) {
 		if (fdtab[fd].owner) {
 			HA_ATOMIC_OR(&fdtab[fd].state, FD_CLONED);
 		}
@@ -76,6 +76,18 @@ static int handle_analyzer_result(struct stream *s, struct channel *chn, unsigne
 		goto label;						\
 	} while (0)
 
+/* Evaluates <cb>, a call to a filter callback returning an int on behalf of
+ * stream <strm>, and returns its result. The time spent in the callback is
+ * accounted to the stream's filters timings when the stream is profiled.
+ */
+#define FLT_TIMED_CB(strm, cb)						\
+	({								\
+		uint32_t __start = stream_timing_start();		\
+		int __ret = (cb);					\
+		stream_timing_stop(&(strm)->flt_time, __start);		\
+		__ret;							\
+	})
+
 
 /* List head of all known filter keywords */
 static struct flt_kw_list flt_keywords = {
@@ -591,7 +603,7 @@ flt_http_end(struct stream *s, struct http_msg *msg)
 
 		if (FLT_OPS(filter)->http_end) {
 			DBG_TRACE_DEVEL(FLT_ID(filter), STRM_EV_HTTP_ANA|STRM_EV_FLT_ANA, s);
-			ret = FLT_OPS(filter)->http_end(s, filter, msg);
+			ret = FLT_TIMED_CB(s, FLT_OPS(filter)->http_end(s, filter, msg));
 			if (ret <= 0)
 				BREAK_EXECUTION(s, msg->chn, end);
 		}
@@ -678,7 +690,7 @@ flt_http_payload(struct stream *s, struct http_msg *msg, unsigned int len)
 
 		if (FLT_OPS(filter)->http_payload) {
 			DBG_TRACE_DEVEL(FLT_ID(filter), STRM_EV_HTTP_ANA|STRM_EV_FLT_ANA, s);
-			ret = FLT_OPS(filter)->http_payload(s, filter, msg, out + offset, data - offset);
+			ret = FLT_TIMED_CB(s, FLT_OPS(filter)->http_payload(s, filter, msg, out + offset, data - offset));
 			if (ret < 0)
 				goto end;
 			data = ret + *flt_off - *strm_off;
@@ -745,7 +757,7 @@ flt_start_analyze(struct stream *s, struct channel *chn, unsigned int an_bit)
 		FLT_OFF(filter, chn) = 0;
 		if (FLT_OPS(filter)->channel_start_analyze) {
 			DBG_TRACE_DEVEL(FLT_ID(filter), STRM_EV_FLT_ANA, s);
-			ret = FLT_OPS(filter)->channel_start_analyze(s, filter, chn);
+			ret = FLT_TIMED_CB(s, FLT_OPS(filter)->channel_start_analyze(s, filter, chn));
 			if (ret <= 0)
 				BREAK_EXECUTION(s, chn, end);
 		}
@@ -777,7 +789,7 @@ flt_pre_analyze(struct stream *s, struct channel *chn, unsigned int an_bit)
 	RESUME_FILTER_LOOP(s, chn) {
 		if (FLT_OPS(filter)->channel_pre_analyze && (filter->pre_analyzers & an_bit)) {
 			DBG_TRACE_DEVEL(FLT_ID(filter), STRM_EV_FLT_ANA, s);
-			ret = FLT_OPS(filter)->channel_pre_analyze(s, filter, chn, an_bit);
+			ret = FLT_TIMED_CB(s, FLT_OPS(filter)->channel_pre_analyze(s, filter, chn, an_bit));
 			if (ret <= 0)
 				BREAK_EXECUTION(s, chn, check_result);
 			filter->pre_analyzers &= ~an_bit;
@@ -810,7 +822,7 @@ flt_post_analyze(struct stream *s, struct channel *chn, unsigned int an_bit)
 	list_for_each_entry(filter, &strm_flt(s)->filters, list) {
 		if (FLT_OPS(filter)->channel_post_analyze &&  (filter->post_analyzers & an_bit)) {
 			DBG_TRACE_DEVEL(FLT_ID(filter), STRM_EV_FLT_ANA, s);
-			ret = FLT_OPS(filter)->channel_post_analyze(s, filter, chn, an_bit);
+			ret = FLT_TIMED_CB(s, FLT_OPS(filter)->channel_post_analyze(s, filter, chn, an_bit));
 			if (ret < 0)
 				break;
 			filter->post_analyzers &= ~an_bit;
@@ -838,7 +850,7 @@ flt_analyze_http_headers(struct stream *s, struct channel *chn, unsigned int an_
 	RESUME_FILTER_LOOP(s, chn) {
 		if (FLT_OPS(filter)->http_headers) {
 			DBG_TRACE_DEVEL(FLT_ID(filter), STRM_EV_HTTP_ANA|STRM_EV_FLT_ANA, s);
-			ret = FLT_OPS(filter)->http_headers(s, filter, msg);
+			ret = FLT_TIMED_CB(s, FLT_OPS(filter)->http_headers(s, filter, msg));
 			if (ret <= 0)
 				BREAK_EXECUTION(s, chn, check_result);
 		}
@@ -883,7 +895,7 @@ flt_end_analyze(struct stream *s, struct channel *chn, unsigned int an_bit)
 
 		if (FLT_OPS(filter)->channel_end_analyze) {
 			DBG_TRACE_DEVEL(FLT_ID(filter), STRM_EV_FLT_ANA, s);
-			ret = FLT_OPS(filter)->channel_end_analyze(s, filter, chn);
+			ret = FLT_TIMED_CB(s, FLT_OPS(filter)->channel_end_analyze(s, filter, chn));
 			if (ret <= 0)
 				BREAK_EXECUTION(s, chn, end);
 		}
@@ -961,7 +973,7 @@ flt_tcp_payload(struct stream *s, struct channel *chn, unsigned int len)
 		if (FLT_OPS(filter)->tcp_payload) {
 
 			DBG_TRACE_DEVEL(FLT_ID(filter), STRM_EV_TCP_ANA|STRM_EV_FLT_ANA, s);
-			ret = FLT_OPS(filter)->tcp_payload(s, filter, chn, out + offset, data - offset);
+			ret = FLT_TIMED_CB(s, FLT_OPS(filter)->tcp_payload(s, filter, chn, out + offset, data - offset));
 			if (ret < 0)
 				goto end;
 			data = ret + *flt_off - *strm_off;
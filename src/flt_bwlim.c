@@ -56,6 +56,7 @@ struct bwlim_state {
 	unsigned int limit;
 	unsigned int period;
 	unsigned int exp;
+	unsigned int credit;    /* bytes leased from the shared counter, not forwarded yet */
 };
 
 
@@ -63,6 +64,31 @@ struct bwlim_state {
 DECLARE_STATIC_POOL(pool_head_bwlim_state, "bwlim_state", sizeof(struct bwlim_state));
 
 
+/* Gives back to the shared counter of the stick-table entry the credit leased
+ * by the stream but not consumed. It is only an approximation if the period
+ * changed in the mean time, but it remains bounded by the size of a lease.
+ */
+static void bwlim_release_credit(struct bwlim_config *conf, struct bwlim_state *st)
+{
+	struct freq_ctr *bytes_rate;
+	unsigned int type = ((conf->flags & BWLIM_FL_IN) ? STKTABLE_DT_BYTES_IN_RATE : STKTABLE_DT_BYTES_OUT_RATE);
+	void *ptr;
+
+	if (!st->credit || !st->ts)
+		goto end;
+
+	ptr = stktable_data_ptr(conf->table.t, st->ts, type);
+	if (!ptr)
+		goto end;
+
+	HA_RWLOCK_WRLOCK(STK_SESS_LOCK, &st->ts->lock);
+	bytes_rate = &stktable_data_cast(ptr, std_t_frqp);
+	bytes_rate->curr_ctr -= MIN(bytes_rate->curr_ctr, st->credit);
+	HA_RWLOCK_WRUNLOCK(STK_SESS_LOCK, &st->ts->lock);
+  end:
+	st->credit = 0;
+}
+
 /* Apply the bandwidth limitation of the filter <filter>. <len> is the maximum
  * amount of data that the filter can forward. This function applies the
  * limitation and returns what the stream is authorized to forward. Several
@@ -74,7 +100,7 @@ static int bwlim_apply_limit(struct filter *filter, struct channel *chn, unsigne
 	struct bwlim_state *st = filter->ctx;
 	struct freq_ctr *bytes_rate;
 	unsigned int period, limit, remain, tokens, users;
-	unsigned int wait = 0;
+	unsigned int wait = 0, credit = 0;
 	int overshoot, ret = 0;
 
 	/* Don't forward anything if there is nothing to forward or the waiting
@@ -89,13 +115,30 @@ static int bwlim_apply_limit(struct filter *filter, struct channel *chn, unsigne
 		void *ptr;
 		unsigned int type = ((conf->flags & BWLIM_FL_IN) ? STKTABLE_DT_BYTES_IN_RATE : STKTABLE_DT_BYTES_OUT_RATE);
 
+		/* In shared mode, the bytes already leased from the shared
+		 * counter are consumed first, without locking the stick-table
+		 * entry. They were accounted in the counter when leased. If
+		 * the credit is not large enough, the remaining is requested
+		 * to the shared counter.
+		 */
+		if (len <= st->credit) {
+			st->credit -= len;
+			goto end;
+		}
+		credit = st->credit;
+		st->credit = 0;
+		len -= credit;
+		ret = len;
+
 		/* In shared mode, get a pointer on the stick table entry. it
 		 * will be used to get the freq-counter. It is also used to get
 		 * The number of users.
 		 */
 		ptr = stktable_data_ptr(conf->table.t, st->ts, type);
-		if (!ptr)
+		if (!ptr) {
+			ret += credit;
 			goto end;
+		}
 
 		HA_RWLOCK_WRLOCK(STK_SESS_LOCK, &st->ts->lock);
 		bytes_rate = &stktable_data_cast(ptr, std_t_frqp);
@@ -130,7 +173,7 @@ static int bwlim_apply_limit(struct filter *filter, struct channel *chn, unsigne
 		wait = div64_32((uint64_t)(conf->min_size + overshoot) * period * users,
 				limit);
 		st->exp = tick_add(now_ms, (wait ? wait : 1));
-		ret = 0;
+		ret = credit;
 		goto end;
 	}
 
@@ -156,11 +199,22 @@ static int bwlim_apply_limit(struct filter *filter, struct channel *chn, unsigne
 				ret = (limit < ret) ? remain : 0;
 		}
 	}
+	else if (conf->flags & BWLIM_FL_SHARED) {
+		/* The stream is not limited. In shared mode, it leases some
+		 * extra bytes from its quota to be able to forward the next
+		 * chunks without locking the stick-table entry. The lease is
+		 * accounted right now in the shared counter, so the limit is
+		 * never exceeded over a period. But the lease is limited to
+		 * the quota of the stream to not be unfair with other streams
+		 * and to keep the bytes rate as smooth as possible.
+		 */
+		st->credit = MIN(tokens - len, len * (BWLIM_MAX_LEASE - 1));
+	}
 
 	/* At the end, update the freq-counter and compute the waiting time if
 	 * the stream is limited
 	 */
-	update_freq_ctr_period(bytes_rate, period, ret);
+	update_freq_ctr_period(bytes_rate, period, ret + st->credit);
 	if (ret < len) {
 		wait += next_event_delay_period(bytes_rate, period, limit, MIN(len - ret, conf->min_size * users));
 		st->exp = tick_add(now_ms, (wait ? wait : 1));
@@ -168,6 +222,7 @@ static int bwlim_apply_limit(struct filter *filter, struct channel *chn, unsigne
 
 	if (conf->flags & BWLIM_FL_SHARED)
 		HA_RWLOCK_WRUNLOCK(STK_SESS_LOCK, &st->ts->lock);
+	ret += credit;
 
   end:
 	chn->analyse_exp = tick_first((tick_is_expired(chn->analyse_exp, now_ms) ? TICK_ETERNITY : chn->analyse_exp),
@@ -275,8 +330,10 @@ static void bwlim_detach(struct stream *s, struct filter *filter)
 	if (!st)
 		return;
 
-	if (st->ts)
+	if (st->ts) {
+		bwlim_release_credit(conf, st);
 		stktable_touch_local(t, st->ts, 1);
+	}
 
 	/* release any possible compression context */
 	pool_free(pool_head_bwlim_state, st);
@@ -376,6 +433,7 @@ static enum act_return bwlim_set_limit(struct act_rule *rule, struct proxy *px,
 		if (!ts)
 			goto end;
 
+		bwlim_release_credit(conf, st);
 		st->ts = ts;
 		st->rule = rule;
 	}
@@ -0,0 +1,401 @@
+/*
+ * gRPC messages inspection filter.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <haproxy/api.h>
+#include <haproxy/chunk.h>
+#include <haproxy/filters.h>
+#include <haproxy/htx.h>
+#include <haproxy/http_ana-t.h>
+#include <haproxy/http_htx.h>
+#include <haproxy/net_helper.h>
+#include <haproxy/pool.h>
+#include <haproxy/protobuf.h>
+#include <haproxy/proxy.h>
+#include <haproxy/sample.h>
+#include <haproxy/stream.h>
+#include <haproxy/tools.h>
+#include <haproxy/vars.h>
+
+const char *grpc_flt_id = "gRPC filter";
+
+struct flt_ops grpc_ops;
+
+/* A protobuf field to extract from each request message */
+struct grpc_field {
+	struct list list;
+	struct arg args[2];     /* field id and type, as for the protobuf converter */
+	struct arg var;         /* variable to set, resolved by vars_check_arg() */
+};
+
+struct grpc_config {
+	struct proxy *proxy;
+	struct list fields;     /* list of grpc_field */
+};
+
+/* Parsing state of the messages of one direction */
+struct grpc_msg_state {
+	unsigned long long cnt; /* number of complete messages */
+	struct buffer *msg;     /* copy of the current message, or NULL */
+	uint32_t left;          /* bytes of the current message not seen yet */
+	unsigned char hdr[GRPC_MSG_HEADER_SZ];
+	unsigned char hdr_len;  /* bytes of the message header already seen */
+	unsigned char copy;     /* the current message is being copied */
+};
+
+struct grpc_state {
+	struct grpc_msg_state req;
+	struct grpc_msg_state res;
+	unsigned int grpc;      /* non-zero if the request is a gRPC one */
+};
+
+DECLARE_STATIC_POOL(pool_head_grpc_state, "grpc_state", sizeof(struct grpc_state));
+
+
+/* Extracts the configured fields from the request message <msg> of <len>
+ * bytes, and stores them into their variable. Fields which are not present
+ * leave their variable untouched, so that the last value seen is kept.
+ */
+static void grpc_extract_fields(struct stream *s, const struct grpc_config *conf,
+                                unsigned char *msg, size_t len)
+{
+	struct grpc_field *field;
+	struct sample smp;
+	unsigned char *pos;
+	size_t left;
+
+	list_for_each_entry(field, &conf->fields, list) {
+		memset(&smp, 0, sizeof(smp));
+		smp_set_owner(&smp, s->be, s->sess, s, SMP_OPT_FINAL);
+		pos = msg;
+		left = len;
+		if (protobuf_field_lookup(field->args, &smp, &pos, &left))
+			vars_set_by_desc(&field->var.data.var, &smp);
+	}
+}
+
+/* Parses the <len> bytes at <ptr> which follow the gRPC messages already seen
+ * in one direction. Messages are counted once complete. If <conf> is not NULL,
+ * uncompressed messages which fit in a buffer are copied to extract the
+ * configured fields once complete.
+ */
+static void grpc_parse(struct stream *s, const struct grpc_config *conf, struct grpc_msg_state *st,
+                       const char *ptr, size_t len)
+{
+	size_t n;
+
+	while (len) {
+		if (st->hdr_len < GRPC_MSG_HEADER_SZ) {
+			n = MIN(len, GRPC_MSG_HEADER_SZ - st->hdr_len);
+			memcpy(st->hdr + st->hdr_len, ptr, n);
+			st->hdr_len += n;
+			ptr += n;
+			len -= n;
+			if (st->hdr_len < GRPC_MSG_HEADER_SZ)
+				break;
+
+			st->left = read_n32(st->hdr + GRPC_MSG_COMPRESS_FLAG_SZ);
+			st->copy = 0;
+			if (conf && !st->hdr[0]) {
+				if (!st->msg)
+					st->msg = alloc_trash_chunk();
+				if (st->msg && st->left <= b_size(st->msg)) {
+					b_reset(st->msg);
+					st->copy = 1;
+				}
+			}
+		}
+
+		n = MIN(len, st->left);
+		if (st->copy)
+			chunk_memcat(st->msg, ptr, n);
+		st->left -= n;
+		ptr += n;
+		len -= n;
+
+		if (!st->left) {
+			/* this message is complete */
+			st->cnt++;
+			st->hdr_len = 0;
+			if (st->copy)
+				grpc_extract_fields(s, conf, (unsigned char *)b_orig(st->msg), b_data(st->msg));
+		}
+	}
+}
+
+/* Returns the state of the first gRPC filter attached to stream <s>, or NULL
+ * if there is none.
+ */
+static struct grpc_state *grpc_get_state(struct stream *s)
+{
+	struct filter *filter;
+
+	if (!s || !HAS_FILTERS(s))
+		return NULL;
+
+	list_for_each_entry(filter, &strm_flt(s)->filters, list) {
+		if (FLT_ID(filter) == grpc_flt_id)
+			return filter->ctx;
+	}
+	return NULL;
+}
+
+/***************************************************************************
+ * Hooks that manage the filter lifecycle (init/check/deinit)
+ **************************************************************************/
+static int grpc_init(struct proxy *px, struct flt_conf *fconf)
+{
+	fconf->flags |= FLT_CFG_FL_HTX;
+	return 0;
+}
+
+static void grpc_deinit(struct proxy *px, struct flt_conf *fconf)
+{
+	struct grpc_config *conf = fconf->conf;
+	struct grpc_field *field, *back;
+
+	if (!conf)
+		return;
+
+	list_for_each_entry_safe(field, back, &conf->fields, list) {
+		LIST_DELETE(&field->list);
+		free(field->args[0].data.fid.ids);
+		if (field->var.type == ARGT_STR)
+			chunk_destroy(&field->var.data.str);
+		free(field);
+	}
+	free(conf);
+	fconf->conf = NULL;
+}
+
+static int grpc_check(struct proxy *px, struct flt_conf *fconf)
+{
+	if (px->mode != PR_MODE_HTTP) {
+		ha_warning("Proxy '%s': gRPC filter is only usable in HTTP mode and will be ignored.\n",
+			   px->id);
+	}
+	return 0;
+}
+
+/**************************************************************************
+ * Hooks to handle start/stop of streams
+ *************************************************************************/
+static int grpc_attach(struct stream *s, struct filter *filter)
+{
+	struct grpc_state *st;
+
+	st = pool_zalloc(pool_head_grpc_state);
+	if (!st)
+		return -1;
+	filter->ctx = st;
+	return 1;
+}
+
+static void grpc_detach(struct stream *s, struct filter *filter)
+{
+	struct grpc_state *st = filter->ctx;
+
+	if (!st)
+		return;
+
+	free_trash_chunk(st->req.msg);
+	free_trash_chunk(st->res.msg);
+	pool_free(pool_head_grpc_state, st);
+	filter->ctx = NULL;
+}
+
+/**************************************************************************
+ * Hooks to filter HTTP messages
+ *************************************************************************/
+static int grpc_http_headers(struct stream *s, struct filter *filter, struct http_msg *msg)
+{
+	struct grpc_state *st = filter->ctx;
+	struct htx *htx = htxbuf(&msg->chn->buf);
+	struct http_hdr_ctx ctx;
+
+	if (!(msg->chn->flags & CF_ISRESP)) {
+		ctx.blk = NULL;
+		st->grpc = (http_find_header(htx, ist("content-type"), &ctx, 0) &&
+			    istmatchi(ctx.value, ist("application/grpc")));
+		free_trash_chunk(st->req.msg);
+		free_trash_chunk(st->res.msg);
+		memset(&st->req, 0, sizeof(st->req));
+		memset(&st->res, 0, sizeof(st->res));
+	}
+
+	if (st->grpc && !(msg->flags & HTTP_MSGF_BODYLESS))
+		register_data_filter(s, msg->chn, filter);
+	return 1;
+}
+
+static int grpc_http_payload(struct stream *s, struct filter *filter, struct http_msg *msg,
+			     unsigned int offset, unsigned int len)
+{
+	struct grpc_config *conf = FLT_CONF(filter);
+	struct grpc_state *st = filter->ctx;
+	struct htx *htx = htxbuf(&msg->chn->buf);
+	struct htx_blk *blk;
+	struct htx_ret htxret;
+	unsigned int left = len;
+	struct ist v;
+
+	htxret = htx_find_offset(htx, offset);
+	for (blk = htxret.blk; blk && left; blk = htx_get_next_blk(htx, blk)) {
+		enum htx_blk_type type = htx_get_blk_type(blk);
+
+		if (type == HTX_BLK_UNUSED)
+			continue;
+		if (type != HTX_BLK_DATA)
+			break;
+
+		v = htx_get_blk_value(htx, blk);
+		v = istadv(v, htxret.ret);
+		htxret.ret = 0;
+		if (v.len > left)
+			v.len = left;
+		left -= v.len;
+
+		if (msg->chn->flags & CF_ISRESP)
+			grpc_parse(s, NULL, &st->res, v.ptr, v.len);
+		else
+			grpc_parse(s, LIST_ISEMPTY(&conf->fields) ? NULL : conf, &st->req, v.ptr, v.len);
+	}
+	return len;
+}
+
+struct flt_ops grpc_ops = {
+	/* Manage gRPC filter, called for each filter declaration */
+	.init              = grpc_init,
+	.deinit            = grpc_deinit,
+	.check             = grpc_check,
+
+	/* Handle start/stop of streams */
+	.attach            = grpc_attach,
+	.detach            = grpc_detach,
+
+	/* Filter HTTP requests and responses */
+	.http_headers      = grpc_http_headers,
+	.http_payload      = grpc_http_payload,
+};
+
+/* Parses the "grpc" filter keyword. Returns -1 on error, else 0. */
+static int parse_grpc_flt(char **args, int *cur_arg, struct proxy *px, struct flt_conf *fconf,
+			  char **err, void *private)
+{
+	struct grpc_config *conf;
+	struct grpc_field *field;
+	int pos = *cur_arg + 1;
+	char *name;
+
+	conf = calloc(1, sizeof(*conf));
+	if (!conf) {
+		memprintf(err, "%s: out of memory", args[*cur_arg]);
+		return -1;
+	}
+	conf->proxy = px;
+	LIST_INIT(&conf->fields);
+	fconf->conf = conf;
+
+	while (strcmp(args[pos], "extract") == 0) {
+		if (!*args[pos + 1] || !*args[pos + 2]) {
+			memprintf(err, "'%s' : '%s' expects a field number and a variable name",
+				  args[*cur_arg], args[pos]);
+			goto error;
+		}
+
+		field = calloc(1, sizeof(*field));
+		if (!field) {
+			memprintf(err, "%s: out of memory", args[*cur_arg]);
+			goto error;
+		}
+		LIST_APPEND(&conf->fields, &field->list);
+
+		if (!parse_dotted_uints(args[pos + 1], &field->args[0].data.fid.ids, &field->args[0].data.fid.sz)) {
+			memprintf(err, "'%s' : invalid protocol buffers field number '%s'",
+				  args[*cur_arg], args[pos + 1]);
+			goto error;
+		}
+		field->args[0].type = ARGT_PBUF_FNUM;
+		field->args[1].type = ARGT_SINT;
+		field->args[1].data.sint = PBUF_T_BINARY;
+
+		name = strdup(args[pos + 2]);
+		if (!name) {
+			memprintf(err, "%s: out of memory", args[*cur_arg]);
+			goto error;
+		}
+		chunk_initlen(&field->var.data.str, name, strlen(name) + 1, strlen(name));
+		field->var.type = ARGT_STR;
+		if (!vars_check_arg(&field->var, err)) {
+			memprintf(err, "'%s' : %s", args[*cur_arg], *err);
+			goto error;
+		}
+		pos += 3;
+
+		/* optional protobuf type */
+		if (*args[pos] && strcmp(args[pos], "extract") != 0) {
+			int type = protobuf_type(args[pos]);
+
+			if (type == -1) {
+				memprintf(err, "'%s' : wrong protocol buffers type '%s'",
+					  args[*cur_arg], args[pos]);
+				goto error;
+			}
+			field->args[1].data.sint = type;
+			pos++;
+		}
+	}
+
+	*cur_arg = pos;
+	fconf->id   = grpc_flt_id;
+	fconf->ops  = &grpc_ops;
+	return 0;
+
+ error:
+	grpc_deinit(px, fconf);
+	return -1;
+}
+
+/************************************************************************/
+/*           All supported sample fetch functions must be declared here */
+/************************************************************************/
+
+/* Returns the number of complete gRPC messages seen so far on the request or
+ * the response of the stream, depending on the keyword. It requires a "grpc"
+ * filter.
+ */
+static int smp_fetch_grpc_msg_cnt(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	struct grpc_state *st = grpc_get_state(smp->strm);
+
+	if (!st || !st->grpc)
+		return 0;
+
+	smp->data.type = SMP_T_SINT;
+	smp->data.u.sint = (kw[2] == 'q') ? st->req.cnt : st->res.cnt;
+	smp->flags = SMP_F_VOL_TEST;
+	return 1;
+}
+
+static struct sample_fetch_kw_list sample_fetch_keywords = {ILH, {
+	{ "req.grpc_msg_cnt", smp_fetch_grpc_msg_cnt, 0, NULL, SMP_T_SINT, SMP_USE_INTRN },
+	{ "res.grpc_msg_cnt", smp_fetch_grpc_msg_cnt, 0, NULL, SMP_T_SINT, SMP_USE_INTRN },
+	{ /* END */ },
+}};
+
+INITCALL1(STG_REGISTER, sample_register_fetches, &sample_fetch_keywords);
+
+/* Declare the filter parser for "grpc" keyword */
+static struct flt_kw_list flt_kws = { "GRPC", { }, {
+		{ "grpc", parse_grpc_flt, NULL },
+		{ NULL, NULL, NULL },
+	}
+};
+
+INITCALL1(STG_REGISTER, flt_register_keywords, &flt_kws);
@@ -10,6 +10,8 @@
  *
  */
 
+#include <import/eb64tree.h>
+
 #include <haproxy/api.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/compression.h>
@@ -22,10 +24,28 @@
 #include <haproxy/list.h>
 #include <haproxy/proxy.h>
 #include <haproxy/sample.h>
+#include <haproxy/shctx.h>
 #include <haproxy/stream.h>
 #include <haproxy/tools.h>
+#include <haproxy/xxhash.h>
 
 #define COMP_STATE_PROCESSING 0x01
+#define COMP_STATE_CACHE_DONE 0x02  /* the compressed bodies cache was already looked up */
+
+#define COMP_CACHE_BLOCKSIZE  1024
+
+/* A compressed body stored in the compressed bodies cache. It is stored at
+ * the beginning of the first block of its row, and is followed by the
+ * compressed data. The entries are indexed on a hash of the uncompressed
+ * body, the algorithm and the compression level, and a second hash is kept
+ * to rule out collisions.
+ */
+struct comp_cache_entry {
+	struct eb64_node node;  /* key: first half of the hash */
+	uint64_t check;         /* second half of the hash */
+	unsigned int in_len;    /* length of the uncompressed body */
+	unsigned int out_len;   /* length of the compressed body */
+};
 
 const char *http_comp_flt_id = "compression filter";
 
@@ -59,10 +79,45 @@ static int htx_compression_buffer_add_data(struct comp_state *st, const char *da
 static int htx_compression_buffer_end(struct comp_state *st, struct buffer *out, int end);
 
 /***********************************************************************/
+/* Called by the shared context when the blocks of a row are reclaimed. The
+ * entry is removed from the tree when its first block is released.
+ */
+static void
+comp_cache_free_blocks(struct shared_context *shctx, struct shared_block *first, struct shared_block *block)
+{
+	struct comp_cache_entry *entry = (struct comp_cache_entry *)block->data;
+
+	if (first == block && first->len > 0)
+		eb64_delete(&entry->node);
+}
+
 static int
 comp_flt_init(struct proxy *px, struct flt_conf *fconf)
 {
+	struct shared_context *shctx;
+	struct eb_root *root;
+
 	fconf->flags |= FLT_CFG_FL_HTX;
+
+	if (!px->comp || !px->comp->cache_size || px->comp->cache)
+		return 0;
+
+	if (px->comp->cache_size < global.tune.bufsize) {
+		ha_alert("config: %s '%s': the compression cache size must be at least as large as tune.bufsize (%d).\n",
+			 proxy_type_str(px), px->id, global.tune.bufsize);
+		return -1;
+	}
+
+	if (shctx_init(&shctx, px->comp->cache_size / COMP_CACHE_BLOCKSIZE, COMP_CACHE_BLOCKSIZE,
+		       global.tune.bufsize, sizeof(*root), (global.nbthread > 1), -1) <= 0) {
+		ha_alert("config: %s '%s': unable to allocate the compression cache.\n",
+			 proxy_type_str(px), px->id);
+		return -1;
+	}
+	shctx->free_block = comp_cache_free_blocks;
+	root = (struct eb_root *)shctx->data;
+	*root = EB_ROOT_UNIQUE;
+	px->comp->cache = shctx;
 	return 0;
 }
 
@@ -167,6 +222,122 @@ comp_http_post_analyze(struct stream *s, struct filter *filter,
 	return 1;
 }
 
+/* Returns the compressed bodies cache to use for stream <s>, if any. As for
+ * the algorithms, the backend has the priority over the frontend.
+ */
+static inline struct shared_context *
+comp_get_cache(struct stream *s)
+{
+	if (s->be->comp && s->be->comp->algos)
+		return s->be->comp->cache;
+	if (strm_fe(s)->comp)
+		return strm_fe(s)->comp->cache;
+	return NULL;
+}
+
+/* Compresses the whole response body using the compressed bodies cache
+ * <cache>. The body starts at block <blk> in <htx> and is <len> bytes long.
+ * This only works when the whole body is already present in the buffer with
+ * no trailers, otherwise 0 is returned and the caller must compress the
+ * payload as usual. The body is hashed and if a compressed version of it is
+ * found in the cache for the same algorithm and level, it is used as-is,
+ * otherwise the body is compressed at once and stored into the cache. The
+ * data blocks are then replaced by the compressed body. The length of the
+ * compressed body is returned on success, or -1 on error.
+ */
+static int
+comp_cache_process(struct comp_state *st, struct shared_context *cache,
+		   struct htx *htx, struct htx_blk *blk, unsigned int len)
+{
+	struct eb_root *root = (struct eb_root *)cache->data;
+	struct comp_cache_entry *entry;
+	struct shared_block *first;
+	struct eb64_node *node;
+	struct htx_blk *b;
+	XXH3_state_t state;
+	XXH128_hash_t hash;
+	struct ist v;
+	uint32_t sz;
+
+	if (!(htx->flags & HTX_FL_EOM) || len > cache->max_obj_size)
+		return 0;
+
+	XXH3_128bits_reset_withSeed(&state, XXH3_64bits_withSeed(st->comp_algo->cfg_name,
+								 st->comp_algo->cfg_name_len,
+								 st->comp_ctx->cur_lvl));
+	for (sz = 0, b = blk; b; b = htx_get_next_blk(htx, b)) {
+		enum htx_blk_type type = htx_get_blk_type(b);
+
+		if (type == HTX_BLK_UNUSED)
+			continue;
+		if (type == HTX_BLK_EOT && !htx_get_next_blk(htx, b))
+			break;
+		if (type != HTX_BLK_DATA)
+			return 0;
+		v = htx_get_blk_value(htx, b);
+		XXH3_128bits_update(&state, v.ptr, v.len);
+		sz += v.len;
+	}
+	if (!sz || sz != len)
+		return 0;
+	hash = XXH3_128bits_digest(&state);
+
+	b_reset(&trash);
+	shctx_lock(cache);
+	node = eb64_lookup(root, hash.low64);
+	entry = node ? eb64_entry(node, struct comp_cache_entry, node) : NULL;
+	if (entry && entry->check == hash.high64 && entry->in_len == len && entry->out_len <= b_size(&trash)) {
+		first = (struct shared_block *)((unsigned char *)entry - offsetof(struct shared_block, data));
+		shctx_row_data_get(cache, first, (unsigned char *)b_orig(&trash), sizeof(*entry), entry->out_len);
+		b_set_data(&trash, entry->out_len);
+		/* refresh the entry */
+		shctx_row_inc_hot(cache, first);
+		shctx_row_dec_hot(cache, first);
+	}
+	shctx_unlock(cache);
+
+	if (!b_data(&trash)) {
+		/* not found, compress the whole body at once */
+		for (b = blk; b; b = htx_get_next_blk(htx, b)) {
+			if (htx_get_blk_type(b) != HTX_BLK_DATA)
+				continue;
+			v = htx_get_blk_value(htx, b);
+			if (st->comp_algo->add_data(st->comp_ctx, v.ptr, v.len, &trash) < 0)
+				return -1;
+		}
+		if (st->comp_algo->finish(st->comp_ctx, &trash) < 0)
+			return -1;
+
+		shctx_lock(cache);
+		first = shctx_row_reserve_hot(cache, NULL, sizeof(*entry) + b_data(&trash));
+		if (first) {
+			entry = (struct comp_cache_entry *)first->data;
+			entry->node.key = hash.low64;
+			entry->check = hash.high64;
+			entry->in_len = len;
+			entry->out_len = b_data(&trash);
+			first->len = sizeof(*entry);
+			if (eb64_insert(root, &entry->node) != &entry->node) {
+				/* already stored by another stream */
+				first->len = 0;
+			}
+			else if (shctx_row_data_append(cache, first, NULL, (unsigned char *)b_orig(&trash), b_data(&trash)) < 0) {
+				eb64_delete(&entry->node);
+				first->len = 0;
+			}
+			shctx_row_dec_hot(cache, first);
+		}
+		shctx_unlock(cache);
+	}
+
+	/* now replace the uncompressed body with the compressed one */
+	for (b = htx_get_next_blk(htx, blk); b && htx_get_blk_type(b) != HTX_BLK_EOT;)
+		b = htx_remove_blk(htx, b);
+	if (!htx_replace_blk_value(htx, blk, htx_get_blk_value(htx, blk), ist2(b_orig(&trash), b_data(&trash))))
+		return -1;
+	return b_data(&trash);
+}
+
 static int
 comp_http_payload(struct stream *s, struct filter *filter, struct http_msg *msg,
 		  unsigned int offset, unsigned int len)
@@ -174,11 +345,36 @@ comp_http_payload(struct stream *s, struct filter *filter, struct http_msg *msg,
 	struct comp_state *st = filter->ctx;
 	struct htx *htx = htxbuf(&msg->chn->buf);
 	struct htx_ret htxret = htx_find_offset(htx, offset);
+	struct shared_context *cache;
 	struct htx_blk *blk, *next;
 	int ret, consumed = 0, to_forward = 0, last = 0;
 
 	blk = htxret.blk;
 	offset = htxret.ret;
+
+	/* the compressed bodies cache may only be used for a body that was
+	 * not compressed at all yet.
+	 */
+	if ((st->flags & (COMP_STATE_PROCESSING|COMP_STATE_CACHE_DONE)) == COMP_STATE_PROCESSING && blk && len) {
+		cache = comp_get_cache(s);
+		if (cache && !offset && st->comp_ctx->cur_lvl > 0) {
+			if (htx_compression_buffer_init(htx, &trash) < 0) {
+				msg->chn->flags |= CF_WAKE_WRITE;
+				goto end;
+			}
+			ret = comp_cache_process(st, cache, htx, blk, len);
+			if (ret < 0)
+				goto error;
+			if (ret > 0) {
+				consumed = len;
+				to_forward = ret;
+				st->flags &= ~COMP_STATE_PROCESSING;
+				goto end;
+			}
+		}
+		st->flags |= COMP_STATE_CACHE_DONE;
+	}
+
 	for (next = NULL; blk && len; blk = next) {
 		enum htx_blk_type type = htx_get_blk_type(blk);
 		uint32_t sz = htx_get_blksz(blk);
@@ -395,12 +591,14 @@ select_compression_request_header(struct comp_state *st, struct stream *s, struc
 	if ((s->be->comp && (comp_algo_back = s->be->comp->algos)) ||
 	    (strm_fe(s)->comp && (comp_algo_back = strm_fe(s)->comp->algos))) {
 		int best_q = 0;
+		int best_rank = -1;
 
 		ctx.blk = NULL;
 		while (http_find_header(htx, ist("Accept-Encoding"), &ctx, 0)) {
 			const char *qval;
 			int q;
 			int toklen;
+			int rank;
 
 			/* try to isolate the token from the optional q-value */
 			toklen = 0;
@@ -435,15 +633,22 @@ select_compression_request_header(struct comp_state *st, struct stream *s, struc
 			/* here we have qval pointing to the first "q=" attribute or NULL if not found */
 			q = qval ? http_parse_qvalue(qval + 2, NULL) : 1000;
 
-			if (q <= best_q)
+			if (!q || q < best_q)
 				continue;
 
-			for (comp_algo = comp_algo_back; comp_algo; comp_algo = comp_algo->next) {
+			/* The algorithms are listed in the reverse order of the
+			 * configuration. For a same q-value, the first configured
+			 * one is preferred.
+			 */
+			rank = 0;
+			for (comp_algo = comp_algo_back; comp_algo; comp_algo = comp_algo->next, rank++) {
 				if (*(ctx.value.ptr) == '*' ||
 				    word_match(ctx.value.ptr, toklen, comp_algo->ua_name, comp_algo->ua_name_len)) {
-					st->comp_algo = comp_algo;
-					best_q = q;
-					break;
+					if (q > best_q || rank > best_rank) {
+						st->comp_algo = comp_algo;
+						best_q = q;
+						best_rank = rank;
+					}
 				}
 			}
 		}
@@ -710,8 +915,26 @@ parse_compression_options(char **args, int section, struct proxy *proxy,
 			continue;
 		}
 	}
+	else if (strcmp(args[1], "cache") == 0) {
+		const char *res;
+		unsigned int size;
+
+		if (!*args[2]) {
+			memprintf(err, "'%s %s' expects <size>.", args[0], args[1]);
+			ret = -1;
+			goto end;
+		}
+		res = parse_size_err(args[2], &size);
+		if (res != NULL) {
+			memprintf(err, "'%s %s' : unexpected '%s' after size passed in argument '%s'.",
+				  args[0], args[1], res, args[2]);
+			ret = -1;
+			goto end;
+		}
+		comp->cache_size = size;
+	}
 	else {
-		memprintf(err, "'%s' expects 'algo', 'type' or 'offload'",
+		memprintf(err, "'%s' expects 'algo', 'type', 'offload' or 'cache'",
 			  args[0]);
 		ret = -1;
 		goto end;
@@ -757,16 +980,7 @@ check_implicit_http_comp_flt(struct proxy *proxy)
 		list_for_each_entry(fconf, &proxy->filter_configs, list) {
 			if (fconf->id == http_comp_flt_id)
 				comp = 1;
-			else if (fconf->id == cache_store_flt_id) {
-				if (comp) {
-					ha_alert("config: %s '%s': unable to enable the compression filter "
-						 "before any cache filter.\n",
-						 proxy_type_str(proxy), proxy->id);
-					err++;
-					goto end;
-				}
-			}
-			else if (fconf->id == fcgi_flt_id)
+			else if (fconf->id == cache_store_flt_id || fconf->id == fcgi_flt_id)
 				continue;
 			else
 				explicit = 1;
@@ -0,0 +1,914 @@
+/*
+ * Streaming JSON extraction filter.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include <haproxy/api.h>
+#include <haproxy/chunk.h>
+#include <haproxy/filters.h>
+#include <haproxy/htx.h>
+#include <haproxy/http_ana-t.h>
+#include <haproxy/intops.h>
+#include <haproxy/pool.h>
+#include <haproxy/proxy.h>
+#include <haproxy/sample.h>
+#include <haproxy/stream.h>
+#include <haproxy/tools.h>
+#include <haproxy/vars.h>
+
+/* The paths are tracked using bit fields */
+#define JSON_EXTRACT_MAX_PATHS 32
+
+const char *json_flt_id = "JSON extraction filter";
+
+struct flt_ops json_ops;
+
+/* One component of a JSON path: either an object member or an array element */
+struct json_seg {
+	char *key;              /* member name, NULL for an array element */
+	int len;                /* length of <key>, or the array index */
+};
+
+struct json_path {
+	char *str;              /* path as configured, for error messages */
+	struct json_seg *segs;
+	int nb_segs;
+	struct arg var;         /* variable to set, resolved by vars_check_arg() */
+};
+
+struct json_config {
+	struct proxy *proxy;
+	struct json_path paths[JSON_EXTRACT_MAX_PATHS];
+	int nb_paths;
+	unsigned int max_len;   /* max number of body bytes to inspect, 0 = no limit */
+	uint32_t all;           /* mask of all paths */
+	/* masks of paths per segment position, to match members and elements */
+	uint32_t ends_at[JSON_EXTRACT_MAX_DEPTH + 1];  /* paths with exactly this number of segments */
+	uint32_t key_at[JSON_EXTRACT_MAX_DEPTH];       /* paths expecting a member at this position */
+	uint32_t idx_at[JSON_EXTRACT_MAX_DEPTH];       /* paths expecting an element at this position */
+};
+
+/* lexer states */
+enum json_st {
+	JSON_ST_VALUE = 0,      /* expecting a value */
+	JSON_ST_FIRST_KEY,      /* after '{', expecting a member or '}' */
+	JSON_ST_KEY_START,      /* after ',' in an object, expecting a member */
+	JSON_ST_KEY,            /* in a member name */
+	JSON_ST_KEY_ESC,        /* after a '\' in a member name */
+	JSON_ST_KEY_UCS,        /* in a \uXXXX sequence in a member name */
+	JSON_ST_COLON,          /* after a member name, expecting ':' */
+	JSON_ST_FIRST_ELEM,     /* after '[', expecting a value or ']' */
+	JSON_ST_STR,            /* in a string value */
+	JSON_ST_STR_ESC,        /* after a '\' in a string value */
+	JSON_ST_STR_UCS,        /* in a \uXXXX sequence in a string value */
+	JSON_ST_SCALAR,         /* in a number or a literal */
+	JSON_ST_NEXT,           /* after a value in a container, expecting ',' or the end */
+	JSON_ST_END,            /* nothing more to do, either done or invalid */
+};
+
+/* An object or an array being parsed. Its members or elements match the
+ * segment of the paths at the same position as the frame in the stack.
+ */
+struct json_frame {
+	uint32_t live;          /* paths whose previous segments all matched */
+	uint32_t idx;           /* index of the current element for arrays */
+	uint32_t obj;           /* non-zero for an object */
+};
+
+struct json_state {
+	struct buffer *capt[JSON_EXTRACT_MAX_PATHS];  /* raw values being captured */
+	unsigned char capt_depth[JSON_EXTRACT_MAX_PATHS];
+	unsigned long long len; /* number of body bytes inspected */
+	uint32_t done;          /* paths found or abandoned */
+	uint32_t capturing;     /* paths whose value is being captured */
+	uint32_t next;          /* paths matching the next value */
+	uint32_t keym;          /* paths matching the member name being parsed */
+	int keypos;             /* position in the member name being parsed */
+	int depth;              /* number of opened containers */
+	enum json_st st;
+	int hex;                /* remaining hex digits in a \uXXXX sequence */
+	unsigned int ucs;       /* code point of a \uXXXX sequence in a member name */
+	struct json_frame stack[JSON_EXTRACT_MAX_DEPTH];
+};
+
+DECLARE_STATIC_POOL(pool_head_json_state, "json_state", sizeof(struct json_state));
+
+
+/* Returns the mask of the paths among <live> which expect element <idx> of an
+ * array at segment position <pos>.
+ */
+static uint32_t json_match_idx(const struct json_config *conf, uint32_t live, int pos, uint32_t idx)
+{
+	uint32_t ret = 0;
+	int p;
+
+	live &= conf->idx_at[pos];
+	while (live) {
+		p = my_ffsl(live) - 1;
+		live &= live - 1;
+		if (conf->paths[p].segs[pos].len == idx)
+			ret |= 1U << p;
+	}
+	return ret;
+}
+
+/* Feeds byte <c> of a member name to the candidates being matched */
+static void json_match_key(const struct json_config *conf, struct json_state *st, unsigned char c)
+{
+	uint32_t m = st->keym;
+	const struct json_seg *seg;
+	int pos = st->depth - 1;
+	int p;
+
+	while (m) {
+		p = my_ffsl(m) - 1;
+		m &= m - 1;
+		seg = &conf->paths[p].segs[pos];
+		if (st->keypos >= seg->len || (unsigned char)seg->key[st->keypos] != c)
+			st->keym &= ~(1U << p);
+	}
+	st->keypos++;
+}
+
+/* Appends <len> bytes at <ptr> to all the values being captured. A value which
+ * does not fit in its chunk is abandoned.
+ */
+static void json_capture(struct json_state *st, const char *ptr, size_t len)
+{
+	uint32_t m = st->capturing;
+	int p;
+
+	while (m) {
+		p = my_ffsl(m) - 1;
+		m &= m - 1;
+		/* always keep room for the trailing zero */
+		if (b_data(st->capt[p]) + len >= b_size(st->capt[p])) {
+			free_trash_chunk(st->capt[p]);
+			st->capt[p] = NULL;
+			st->capturing &= ~(1U << p);
+			continue;
+		}
+		chunk_memcat(st->capt[p], ptr, len);
+	}
+}
+
+/* Unescapes the <len> bytes of the JSON string at <p>, quotes excluded, into
+ * <out>. The string was already validated by the lexer. The characters of
+ * "\uXXXX" sequences are encoded in UTF-8 the same way as when matching member
+ * names. Returns 0 if the result does not fit in <out>, otherwise non-zero.
+ */
+static int json_unescape(const char *p, size_t len, struct buffer *out)
+{
+	const char *end = p + len;
+	unsigned int ucs;
+	char utf8[3];
+	int i, n;
+
+	b_reset(out);
+	for (; p < end; p++) {
+		utf8[0] = *p;
+		n = 1;
+		if (*p == '\\' && p + 1 < end) {
+			switch (*++p) {
+			case 'b': utf8[0] = '\b'; break;
+			case 'f': utf8[0] = '\f'; break;
+			case 'n': utf8[0] = '\n'; break;
+			case 'r': utf8[0] = '\r'; break;
+			case 't': utf8[0] = '\t'; break;
+			case 'u':
+				if (end - p < 5)
+					return 0;
+				for (ucs = 0, i = 1; i <= 4; i++)
+					ucs = (ucs << 4) + hex2i(p[i]);
+				p += 4;
+				if (ucs < 0x80)
+					utf8[0] = ucs;
+				else if (ucs < 0x800) {
+					utf8[0] = 0xc0 | (ucs >> 6);
+					utf8[1] = 0x80 | (ucs & 0x3f);
+					n = 2;
+				}
+				else {
+					utf8[0] = 0xe0 | (ucs >> 12);
+					utf8[1] = 0x80 | ((ucs >> 6) & 0x3f);
+					utf8[2] = 0x80 | (ucs & 0x3f);
+					n = 3;
+				}
+				break;
+			default: /* '"', '\\' and '/' */
+				utf8[0] = *p;
+				break;
+			}
+		}
+		/* always keep room for the trailing zero */
+		if (b_data(out) + n >= b_size(out))
+			return 0;
+		chunk_memcat(out, utf8, n);
+	}
+	out->area[out->data] = 0;
+	return 1;
+}
+
+/* Converts the raw JSON value <raw> captured for <path> to a sample and stores
+ * it in the path's variable. Strings are unescaped, integers become integers,
+ * other numbers are converted to strings the same way as the json_query
+ * converter does, booleans become booleans and objects and arrays are stored
+ * as-is as strings. Nothing is stored for null.
+ */
+static void json_set_var(struct stream *s, const struct json_path *path, struct buffer *raw)
+{
+	struct buffer *trash = get_trash_chunk();
+	const char *p = b_orig(raw);
+	size_t len = b_data(raw);
+	struct sample smp;
+	long long sint;
+	double dbl;
+	char *end;
+
+	if (!len)
+		return;
+	raw->area[len] = 0;
+
+	memset(&smp, 0, sizeof(smp));
+	smp_set_owner(&smp, s->be, s->sess, s, SMP_OPT_FINAL);
+
+	switch (*p) {
+	case '"':
+		if (len < 2 || !json_unescape(p + 1, len - 2, trash))
+			return;
+		smp.data.type = SMP_T_STR;
+		smp.data.u.str = *trash;
+		break;
+	case '{':
+	case '[':
+		smp.data.type = SMP_T_STR;
+		smp.data.u.str = *raw;
+		break;
+	case 't':
+	case 'f':
+		if (strcmp(p, "true") != 0 && strcmp(p, "false") != 0)
+			return;
+		smp.data.type = SMP_T_BOOL;
+		smp.data.u.sint = (*p == 't');
+		break;
+	default:
+		errno = 0;
+		sint = strtoll(p, &end, 10);
+		if (end != p && !*end && !errno) {
+			smp.data.type = SMP_T_SINT;
+			smp.data.u.sint = sint;
+			break;
+		}
+		dbl = strtod(p, &end);
+		if (end == p || *end)
+			return;
+		trash->data = snprintf(trash->area, trash->size, "%g", dbl);
+		smp.data.type = SMP_T_STR;
+		smp.data.u.str = *trash;
+		break;
+	}
+	vars_set_by_desc(&path->var.data.var, &smp);
+}
+
+/* Starts capturing the value beginning at the current position for paths
+ * <mask>. These paths will not be looked for anymore.
+ */
+static void json_start_capture(struct json_state *st, uint32_t mask)
+{
+	int p;
+
+	while (mask) {
+		p = my_ffsl(mask) - 1;
+		mask &= mask - 1;
+		st->done |= 1U << p;
+		st->capt[p] = alloc_trash_chunk();
+		if (!st->capt[p])
+			continue;
+		st->capt_depth[p] = st->depth;
+		st->capturing |= 1U << p;
+	}
+}
+
+/* Called at the end of a value at the current depth, once its last byte was
+ * captured. The captures which started at this depth are complete and their
+ * variable is set. The next state is set.
+ */
+static void json_value_end(struct stream *s, const struct json_config *conf, struct json_state *st)
+{
+	uint32_t m = st->capturing;
+	int p;
+
+	while (m) {
+		p = my_ffsl(m) - 1;
+		m &= m - 1;
+		if (st->capt_depth[p] != st->depth)
+			continue;
+		json_set_var(s, &conf->paths[p], st->capt[p]);
+		free_trash_chunk(st->capt[p]);
+		st->capt[p] = NULL;
+		st->capturing &= ~(1U << p);
+	}
+
+	if (!st->depth || (st->done == conf->all && !st->capturing))
+		st->st = JSON_ST_END;
+	else
+		st->st = JSON_ST_NEXT;
+}
+
+/* Releases the values still being captured */
+static void json_release_captures(struct json_state *st)
+{
+	int p;
+
+	while (st->capturing) {
+		p = my_ffsl(st->capturing) - 1;
+		st->capturing &= st->capturing - 1;
+		free_trash_chunk(st->capt[p]);
+		st->capt[p] = NULL;
+	}
+}
+
+/* Parses the <len> bytes at <ptr> which follow the body bytes already parsed.
+ * The matching values are stored into their variables as soon as they are
+ * complete. Returns non-zero if more data is needed, or zero if there is no
+ * need to look at the body anymore, either because all paths were found, the
+ * body is not valid JSON or it is too deep.
+ */
+static int json_parse(struct stream *s, const struct json_config *conf, struct json_state *st,
+                      const char *ptr, size_t len)
+{
+	const char *end = ptr + len;
+	const char *mark = ptr;     /* first byte not captured yet */
+	struct json_frame *f;
+	unsigned char c;
+	uint32_t m;
+
+	for (; ptr < end; ptr++) {
+		c = *ptr;
+	  again:
+		switch (st->st) {
+		case JSON_ST_STR:
+			/* fast path: skip the string's contents */
+			while (c != '"' && c != '\\') {
+				if (++ptr == end)
+					goto out;
+				c = *ptr;
+			}
+			if (c == '\\') {
+				st->st = JSON_ST_STR_ESC;
+				break;
+			}
+			if (st->capturing) {
+				json_capture(st, mark, ptr + 1 - mark);
+				mark = ptr + 1;
+			}
+			json_value_end(s, conf, st);
+			break;
+
+		case JSON_ST_STR_ESC:
+			st->st = JSON_ST_STR;
+			switch (c) {
+			case '"': case '\\': case '/':
+			case 'b': case 'f': case 'n': case 'r': case 't':
+				break;
+			case 'u':
+				st->hex = 4;
+				st->st = JSON_ST_STR_UCS;
+				break;
+			default:
+				goto invalid;
+			}
+			break;
+
+		case JSON_ST_STR_UCS:
+			if (!ishex(c))
+				goto invalid;
+			if (!--st->hex)
+				st->st = JSON_ST_STR;
+			break;
+
+		case JSON_ST_SCALAR:
+			if (isalnum(c) || c == '+' || c == '-' || c == '.')
+				break;
+			if (st->capturing) {
+				json_capture(st, mark, ptr - mark);
+				mark = ptr;
+			}
+			json_value_end(s, conf, st);
+			if (st->st == JSON_ST_END)
+				goto out;
+			goto again;
+
+		case JSON_ST_VALUE:
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+				break;
+
+			m = st->next & ~st->done;
+			if (m & conf->ends_at[st->depth]) {
+				if (st->capturing)
+					json_capture(st, mark, ptr - mark);
+				mark = ptr;
+				json_start_capture(st, m & conf->ends_at[st->depth]);
+				m &= ~conf->ends_at[st->depth];
+			}
+
+			if (c == '{' || c == '[') {
+				if (st->depth >= JSON_EXTRACT_MAX_DEPTH)
+					goto invalid;
+				f = &st->stack[st->depth++];
+				f->live = m;
+				f->idx = 0;
+				f->obj = (c == '{');
+				st->st = f->obj ? JSON_ST_FIRST_KEY : JSON_ST_FIRST_ELEM;
+			}
+			else if (c == '"')
+				st->st = JSON_ST_STR;
+			else if (c == '-' || isalnum(c))
+				st->st = JSON_ST_SCALAR;
+			else
+				goto invalid;
+			break;
+
+		case JSON_ST_FIRST_ELEM:
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+				break;
+			if (c == ']')
+				goto close;
+			f = &st->stack[st->depth - 1];
+			st->next = json_match_idx(conf, f->live, st->depth - 1, 0);
+			st->st = JSON_ST_VALUE;
+			goto again;
+
+		case JSON_ST_FIRST_KEY:
+		case JSON_ST_KEY_START:
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+				break;
+			if (c == '}' && st->st == JSON_ST_FIRST_KEY)
+				goto close;
+			if (c != '"')
+				goto invalid;
+			f = &st->stack[st->depth - 1];
+			st->keym = f->live & conf->key_at[st->depth - 1] & ~st->done;
+			st->keypos = 0;
+			st->st = JSON_ST_KEY;
+			break;
+
+		case JSON_ST_KEY:
+			if (c == '"') {
+				/* only keep the names of the same length */
+				m = st->keym;
+				while (m) {
+					int p = my_ffsl(m) - 1;
+
+					m &= m - 1;
+					if (conf->paths[p].segs[st->depth - 1].len != st->keypos)
+						st->keym &= ~(1U << p);
+				}
+				st->st = JSON_ST_COLON;
+			}
+			else if (c == '\\')
+				st->st = JSON_ST_KEY_ESC;
+			else if (c < 0x20)
+				goto invalid;
+			else if (st->keym)
+				json_match_key(conf, st, c);
+			break;
+
+		case JSON_ST_KEY_ESC:
+			st->st = JSON_ST_KEY;
+			switch (c) {
+			case '"': case '\\': case '/': break;
+			case 'b': c = '\b'; break;
+			case 'f': c = '\f'; break;
+			case 'n': c = '\n'; break;
+			case 'r': c = '\r'; break;
+			case 't': c = '\t'; break;
+			case 'u':
+				st->hex = 4;
+				st->ucs = 0;
+				st->st = JSON_ST_KEY_UCS;
+				continue;
+			default:
+				goto invalid;
+			}
+			if (st->keym)
+				json_match_key(conf, st, c);
+			break;
+
+		case JSON_ST_KEY_UCS:
+			if (!ishex(c))
+				goto invalid;
+			st->ucs = (st->ucs << 4) + hex2i(c);
+			if (--st->hex)
+				break;
+			st->st = JSON_ST_KEY;
+			if (!st->keym)
+				break;
+			/* match the UTF-8 encoding of the character */
+			if (st->ucs < 0x80)
+				json_match_key(conf, st, st->ucs);
+			else if (st->ucs < 0x800) {
+				json_match_key(conf, st, 0xc0 | (st->ucs >> 6));
+				json_match_key(conf, st, 0x80 | (st->ucs & 0x3f));
+			}
+			else {
+				json_match_key(conf, st, 0xe0 | (st->ucs >> 12));
+				json_match_key(conf, st, 0x80 | ((st->ucs >> 6) & 0x3f));
+				json_match_key(conf, st, 0x80 | (st->ucs & 0x3f));
+			}
+			break;
+
+		case JSON_ST_COLON:
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+				break;
+			if (c != ':')
+				goto invalid;
+			st->next = st->keym;
+			st->st = JSON_ST_VALUE;
+			break;
+
+		case JSON_ST_NEXT:
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+				break;
+			f = &st->stack[st->depth - 1];
+			if (c == ',') {
+				if (f->obj)
+					st->st = JSON_ST_KEY_START;
+				else {
+					st->next = json_match_idx(conf, f->live, st->depth - 1, ++f->idx);
+					st->st = JSON_ST_VALUE;
+				}
+				break;
+			}
+			if (c != (f->obj ? '}' : ']'))
+				goto invalid;
+		  close:
+			st->depth--;
+			if (st->capturing) {
+				json_capture(st, mark, ptr + 1 - mark);
+				mark = ptr + 1;
+			}
+			json_value_end(s, conf, st);
+			break;
+
+		case JSON_ST_END:
+			goto out;
+		}
+
+		if (st->st == JSON_ST_END)
+			goto out;
+	}
+
+  out:
+	if (st->capturing && ptr > mark)
+		json_capture(st, mark, ptr - mark);
+	if (st->st == JSON_ST_END)
+		json_release_captures(st);
+	return st->st != JSON_ST_END;
+
+  invalid:
+	st->st = JSON_ST_END;
+	json_release_captures(st);
+	return 0;
+}
+
+/***************************************************************************
+ * Hooks that manage the filter lifecycle (init/check/deinit)
+ **************************************************************************/
+static int json_init(struct proxy *px, struct flt_conf *fconf)
+{
+	fconf->flags |= FLT_CFG_FL_HTX;
+	return 0;
+}
+
+static void json_deinit(struct proxy *px, struct flt_conf *fconf)
+{
+	struct json_config *conf = fconf->conf;
+	int i;
+
+	if (!conf)
+		return;
+
+	for (i = 0; i < conf->nb_paths; i++) {
+		struct json_path *path = &conf->paths[i];
+
+		while (path->nb_segs--)
+			free(path->segs[path->nb_segs].key);
+		free(path->segs);
+		free(path->str);
+		if (path->var.type == ARGT_STR)
+			chunk_destroy(&path->var.data.str);
+	}
+	free(conf);
+	fconf->conf = NULL;
+}
+
+static int json_check(struct proxy *px, struct flt_conf *fconf)
+{
+	if (px->mode != PR_MODE_HTTP) {
+		ha_warning("Proxy '%s': JSON extraction filter is only usable in HTTP mode and will be ignored.\n",
+			   px->id);
+	}
+	return 0;
+}
+
+/**************************************************************************
+ * Hooks to handle start/stop of streams
+ *************************************************************************/
+static int json_attach(struct stream *s, struct filter *filter)
+{
+	filter->ctx = NULL;
+	return 1;
+}
+
+static void json_detach(struct stream *s, struct filter *filter)
+{
+	struct json_state *st = filter->ctx;
+
+	if (!st)
+		return;
+
+	json_release_captures(st);
+	pool_free(pool_head_json_state, st);
+	filter->ctx = NULL;
+}
+
+/**************************************************************************
+ * Hooks to filter HTTP messages
+ *************************************************************************/
+static int json_http_headers(struct stream *s, struct filter *filter, struct http_msg *msg)
+{
+	struct json_state *st;
+
+	if (msg->chn->flags & CF_ISRESP)
+		goto end;
+
+	if (!(msg->flags & HTTP_MSGF_XFER_LEN) || (msg->flags & HTTP_MSGF_BODYLESS))
+		goto end;
+
+	st = filter->ctx;
+	if (!st) {
+		st = pool_alloc(pool_head_json_state);
+		if (!st)
+			goto end;
+		filter->ctx = st;
+	}
+	memset(st, 0, sizeof(*st));
+	st->next = ((struct json_config *)FLT_CONF(filter))->all;
+	register_data_filter(s, msg->chn, filter);
+  end:
+	return 1;
+}
+
+static int json_http_payload(struct stream *s, struct filter *filter, struct http_msg *msg,
+			     unsigned int offset, unsigned int len)
+{
+	struct json_config *conf = FLT_CONF(filter);
+	struct json_state *st = filter->ctx;
+	struct htx *htx = htxbuf(&msg->chn->buf);
+	struct htx_blk *blk;
+	struct htx_ret htxret;
+	unsigned int left = len;
+	struct ist v;
+
+	htxret = htx_find_offset(htx, offset);
+	for (blk = htxret.blk; blk && left; blk = htx_get_next_blk(htx, blk)) {
+		enum htx_blk_type type = htx_get_blk_type(blk);
+
+		if (type == HTX_BLK_UNUSED)
+			continue;
+		if (type != HTX_BLK_DATA)
+			break;
+
+		v = htx_get_blk_value(htx, blk);
+		v = istadv(v, htxret.ret);
+		htxret.ret = 0;
+		if (v.len > left)
+			v.len = left;
+		left -= v.len;
+
+		if (conf->max_len && st->len + v.len > conf->max_len)
+			v.len = conf->max_len - st->len;
+		st->len += v.len;
+
+		if (!json_parse(s, conf, st, v.ptr, v.len) ||
+		    (conf->max_len && st->len >= conf->max_len)) {
+			/* no need to look at the rest of the body */
+			json_release_captures(st);
+			st->st = JSON_ST_END;
+			unregister_data_filter(s, msg->chn, filter);
+			break;
+		}
+	}
+	return len;
+}
+
+static int json_http_end(struct stream *s, struct filter *filter, struct http_msg *msg)
+{
+	struct json_state *st = filter->ctx;
+
+	/* a number or a literal at the top level ends with the body */
+	if (st && IS_DATA_FILTER(filter, msg->chn) && st->st == JSON_ST_SCALAR && !st->depth)
+		json_value_end(s, FLT_CONF(filter), st);
+	return 1;
+}
+
+struct flt_ops json_ops = {
+	/* Manage JSON filter, called for each filter declaration */
+	.init              = json_init,
+	.deinit            = json_deinit,
+	.check             = json_check,
+
+	/* Handle start/stop of streams */
+	.attach            = json_attach,
+	.detach            = json_detach,
+
+	/* Filter HTTP requests */
+	.http_headers      = json_http_headers,
+	.http_payload      = json_http_payload,
+	.http_end          = json_http_end,
+};
+
+/* Parses JSON path <str> into <path>. Only members ("$.a.b") and array
+ * elements ("$.a[2]") are supported. Returns 0 on success, or -1 on error with
+ * <err> filled.
+ */
+static int json_parse_path(const char *str, struct json_path *path, char **err)
+{
+	const char *p = str;
+	const char *beg;
+	struct json_seg *segs;
+	char *idx_end;
+
+	if (*p++ != '$') {
+		memprintf(err, "JSON path '%s' must start with '$'", str);
+		return -1;
+	}
+
+	while (*p) {
+		if (path->nb_segs >= JSON_EXTRACT_MAX_DEPTH) {
+			memprintf(err, "JSON path '%s' is too deep (max %d levels)", str, JSON_EXTRACT_MAX_DEPTH);
+			return -1;
+		}
+
+		segs = realloc(path->segs, (path->nb_segs + 1) * sizeof(*segs));
+		if (!segs)
+			goto oom;
+		path->segs = segs;
+		segs = &path->segs[path->nb_segs];
+
+		if (*p == '.') {
+			beg = ++p;
+			while (*p && *p != '.' && *p != '[')
+				p++;
+			if (p == beg) {
+				memprintf(err, "empty member name in JSON path '%s'", str);
+				return -1;
+			}
+			segs->key = my_strndup(beg, p - beg);
+			if (!segs->key)
+				goto oom;
+			segs->len = p - beg;
+		}
+		else if (*p == '[') {
+			p++;
+			segs->key = NULL;
+			segs->len = strtol(p, &idx_end, 10);
+			if (idx_end == p || *idx_end != ']' || segs->len < 0) {
+				memprintf(err, "invalid array index in JSON path '%s'", str);
+				return -1;
+			}
+			p = idx_end + 1;
+		}
+		else {
+			memprintf(err, "unexpected character '%c' in JSON path '%s'", *p, str);
+			return -1;
+		}
+		path->nb_segs++;
+	}
+	return 0;
+ oom:
+	memprintf(err, "out of memory");
+	return -1;
+}
+
+/* Parses the "json-extract" filter keyword. Returns -1 on error, else 0. */
+static int parse_json_flt(char **args, int *cur_arg, struct proxy *px, struct flt_conf *fconf,
+			  char **err, void *private)
+{
+	struct json_config *conf;
+	struct json_path *path;
+	int pos = *cur_arg + 1;
+	char *name;
+	int i, j;
+
+	conf = calloc(1, sizeof(*conf));
+	if (!conf) {
+		memprintf(err, "%s: out of memory", args[*cur_arg]);
+		return -1;
+	}
+	conf->proxy = px;
+	fconf->conf = conf;
+
+	while (*args[pos]) {
+		if (strcmp(args[pos], "max-length") == 0) {
+			const char *res;
+
+			if (!*args[pos + 1]) {
+				memprintf(err, "'%s' : the value is missing for '%s' option",
+					  args[*cur_arg], args[pos]);
+				goto error;
+			}
+			res = parse_size_err(args[pos + 1], &conf->max_len);
+			if (res) {
+				memprintf(err, "'%s' : unexpected character '%c' in value of '%s' option",
+					  args[*cur_arg], *res, args[pos]);
+				goto error;
+			}
+			pos += 2;
+		}
+		else if (*args[pos] == '$') {
+			if (conf->nb_paths >= JSON_EXTRACT_MAX_PATHS) {
+				memprintf(err, "'%s' : too many JSON paths (max %d)",
+					  args[*cur_arg], JSON_EXTRACT_MAX_PATHS);
+				goto error;
+			}
+			if (!*args[pos + 1]) {
+				memprintf(err, "'%s' : a variable name is expected after JSON path '%s'",
+					  args[*cur_arg], args[pos]);
+				goto error;
+			}
+
+			path = &conf->paths[conf->nb_paths++];
+			path->str = strdup(args[pos]);
+			if (!path->str) {
+				memprintf(err, "%s: out of memory", args[*cur_arg]);
+				goto error;
+			}
+			if (json_parse_path(args[pos], path, err) < 0) {
+				memprintf(err, "'%s' : %s", args[*cur_arg], *err);
+				goto error;
+			}
+
+			name = strdup(args[pos + 1]);
+			if (!name) {
+				memprintf(err, "%s: out of memory", args[*cur_arg]);
+				goto error;
+			}
+			chunk_initlen(&path->var.data.str, name, strlen(name) + 1, strlen(name));
+			path->var.type = ARGT_STR;
+			if (!vars_check_arg(&path->var, err)) {
+				memprintf(err, "'%s' : %s", args[*cur_arg], *err);
+				goto error;
+			}
+			pos += 2;
+		}
+		else
+			break;
+	}
+
+	if (!conf->nb_paths) {
+		memprintf(err, "'%s' : at least one JSON path and variable name are expected",
+			  args[*cur_arg]);
+		goto error;
+	}
+
+	for (i = 0; i < conf->nb_paths; i++) {
+		path = &conf->paths[i];
+		conf->all |= 1U << i;
+		conf->ends_at[path->nb_segs] |= 1U << i;
+		for (j = 0; j < path->nb_segs; j++) {
+			if (path->segs[j].key)
+				conf->key_at[j] |= 1U << i;
+			else
+				conf->idx_at[j] |= 1U << i;
+		}
+	}
+
+	*cur_arg = pos;
+	fconf->id   = json_flt_id;
+	fconf->ops  = &json_ops;
+	return 0;
+
+ error:
+	json_deinit(px, fconf);
+	return -1;
+}
+
+/* Declare the filter parser for "json-extract" keyword */
+static struct flt_kw_list flt_kws = { "JSON", { }, {
+		{ "json-extract", parse_json_flt, NULL },
+		{ NULL, NULL, NULL },
+	}
+};
+
+INITCALL1(STG_REGISTER, flt_register_keywords, &flt_kws);
@@ -2114,6 +2114,18 @@ spoe_queue_context(struct spoe_context *ctx)
 		goto end;
 	}
 
+	/* Do not try to create a new applet if we have reached the maximum
+	 * number of applets, unless the current thread has none. The stream
+	 * will be processed by one of the existing applets. */
+	if (agent->max_applets > 0 && !LIST_ISEMPTY(&agent->rt[tid].applets) &&
+	    HA_ATOMIC_LOAD(&agent->counters.applets) >= agent->max_applets) {
+		SPOE_PRINTF(stderr, "%d.%06d [SPOE/%-15s] %s: stream=%p"
+			    " - cannot create SPOE appctx: max applets reached\n",
+			    (int)now.tv_sec, (int)now.tv_usec, agent->id,
+			    __FUNCTION__, ctx->strm);
+		goto end;
+	}
+
 	/* Do not try to create a new applet if we have reached the maximum of
 	 * connection per seconds */
 	if (agent->cps_max > 0) {
@@ -3075,6 +3087,8 @@ spoe_deinit(struct proxy *px, struct flt_conf *fconf)
 		struct spoe_agent *agent = conf->agent;
 
 		spoe_release_agent(agent);
+		counters_shards_free(&conf->agent_fe.fe_counters.shards);
+		counters_shards_free(&conf->agent_fe.be_counters.shards);
 		free(conf->id);
 		free(conf);
 	}
@@ -3450,6 +3464,7 @@ cfg_parse_spoe_agent(const char *file, int linenum, char **args, int kwm)
 		curagent->eps_max        = 0;
 		curagent->max_frame_size = MAX_FRAME_SIZE;
 		curagent->max_fpa        = 20;
+		curagent->max_applets    = 0;
 
 		for (i = 0; i < SPOE_EV_EVENTS; ++i)
 			LIST_INIT(&curagent->events[i]);
@@ -3756,6 +3771,17 @@ cfg_parse_spoe_agent(const char *file, int linenum, char **args, int kwm)
 			goto out;
 		curagent->eps_max = atol(args[1]);
 	}
+	else if (strcmp(args[0], "maxconn") == 0) {
+		if (!*args[1]) {
+			ha_alert("parsing [%s:%d] : '%s' expects an integer argument.\n",
+				 file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+		if (alertif_too_many_args(1, file, linenum, args, &err_code))
+			goto out;
+		curagent->max_applets = atol(args[1]);
+	}
 	else if (strcmp(args[0], "max-frame-size") == 0) {
 		if (!*args[1]) {
 			ha_alert("parsing [%s:%d] : '%s' expects an integer argument.\n",
@@ -4542,6 +4568,10 @@ parse_spoe_flt(char **args, int *cur_arg, struct proxy *px,
 		LIST_DELETE(&logsrv->list);
 		free(logsrv);
 	}
+	if (conf) {
+		counters_shards_free(&conf->agent_fe.fe_counters.shards);
+		counters_shards_free(&conf->agent_fe.be_counters.shards);
+	}
 	free(conf);
 	return -1;
 }
@@ -12,6 +12,12 @@
 
 #include <ctype.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include <import/sha1.h>
 
 #include <haproxy/api.h>
@@ -550,6 +556,31 @@ int h1_headers_to_hdr_list(char *start, const char *stop,
 
 	case H1_MSG_RQURI:
 	http_msg_rquri:
+#if defined(__SSE2__)
+		/* speedup: skip packs of 16 bytes between 0x21 and 0x7e inclusive.
+		 * The comparisons are signed so that bytes 0x80 and above appear
+		 * lower than 0x21 and stop the loop as well.
+		 */
+		while (ptr <= end - 16) {
+			__m128i v = _mm_loadu_si128((const __m128i *)ptr);
+			int m = _mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(0x21)),
+			                                       _mm_cmpgt_epi8(v, _mm_set1_epi8(0x7e))));
+			if (m) {
+				ptr += __builtin_ctz(m);
+				goto http_msg_rquri2;
+			}
+			ptr += 16;
+		}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+		/* speedup: skip packs of 16 bytes between 0x21 and 0x7e inclusive */
+		while (ptr <= end - 16) {
+			uint8x16_t v = vld1q_u8((const uint8_t *)ptr);
+
+			if (vmaxvq_u8(vorrq_u8(vcltq_u8(v, vdupq_n_u8(0x21)), vcgtq_u8(v, vdupq_n_u8(0x7e)))))
+				break;
+			ptr += 16;
+		}
+#endif
 #ifdef HA_UNALIGNED_LE
 		/* speedup: skip bytes not between 0x21 and 0x7e inclusive */
 		while (ptr <= end - sizeof(int)) {
@@ -894,7 +925,29 @@ int h1_headers_to_hdr_list(char *start, const char *stop,
 		 * and lower. In fact since most of the time is spent in the loop, we
 		 * also remove the sign bit test so that bytes 0x8e..0x0d break the
 		 * loop, but we don't care since they're very rare in header values.
+		 * When available, SIMD instructions are used to process 16 bytes at
+		 * once, and the remaining ones are processed by words.
 		 */
+#if defined(__SSE2__)
+		while (ptr <= end - 16) {
+			__m128i v = _mm_loadu_si128((const __m128i *)ptr);
+			int m = _mm_movemask_epi8(_mm_cmplt_epi8(v, _mm_set1_epi8(0x0e)));
+
+			if (m) {
+				ptr += __builtin_ctz(m);
+				goto http_msg_hdr_val2;
+			}
+			ptr += 16;
+		}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+		while (ptr <= end - 16) {
+			uint8x16_t v = vld1q_u8((const uint8_t *)ptr);
+
+			if (vmaxvq_u8(vcltq_u8(v, vdupq_n_u8(0x0e))))
+				goto http_msg_hdr_val2;
+			ptr += 16;
+		}
+#endif
 #ifdef HA_UNALIGNED_LE64
 		while (ptr <= end - sizeof(long)) {
 			if ((*(long *)ptr - 0x0e0e0e0e0e0e0e0eULL) & 0x8080808080808080ULL)
@@ -427,7 +427,8 @@ static size_t h1_copy_msg_data(struct htx **dsthtx, struct buffer *srcbuf, size_
 	 *      the target buffer instead
 	 */
 	if (unlikely(htx_is_empty(tmp_htx) && count == b_data(srcbuf) &&
-		     !ofs && b_head_ofs(srcbuf) == sizeof(struct htx))) {
+		     !ofs && b_head_ofs(srcbuf) == sizeof(struct htx) &&
+		     b_size(srcbuf) == b_size(htxbuf))) {
 		void *raw_area = srcbuf->area;
 		void *htx_area = htxbuf->area;
 		struct htx_blk *blk;
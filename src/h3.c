@@ -35,6 +35,7 @@
 #include <haproxy/pool.h>
 #include <haproxy/qpack-dec.h>
 #include <haproxy/qpack-enc.h>
+#include <haproxy/qpack-tbl.h>
 #include <haproxy/quic_conn-t.h>
 #include <haproxy/quic_enc.h>
 #include <haproxy/stats-t.h>
@@ -112,14 +113,18 @@ INITCALL1(STG_REGISTER, trace_register_source, TRACE_SOURCE);
 #define H3_CF_UNI_QPACK_DEC_SET 0x00000008  /* Remote QPACK decoder stream opened */
 #define H3_CF_UNI_QPACK_ENC_SET 0x00000010  /* Remote QPACK encoder stream opened */
 
-/* Default settings */
-static uint64_t h3_settings_qpack_max_table_capacity = 0;
-static uint64_t h3_settings_qpack_blocked_streams = 4096;
+/* Default settings. The QPACK dynamic table capacity is set by
+ * "tune.quic.qpack-max-table-capacity". Blocked streams are not supported,
+ * the encoder may only reference the entries it knows were received.
+ */
+static uint64_t h3_settings_qpack_blocked_streams = 0;
 static uint64_t h3_settings_max_field_section_size = QUIC_VARINT_8_BYTE_MAX; /* Unlimited */
 
 struct h3c {
 	struct qcc *qcc;
 	struct qcs *ctrl_strm; /* Control stream */
+	struct qcs *qpack_dec_strm; /* QPACK decoder stream, NULL if not opened */
+	struct qpack_dec qpack_dec; /* QPACK decoder context and dynamic table */
 	enum h3_err err;
 	uint32_t flags;
 
@@ -226,6 +231,68 @@ static ssize_t h3_init_uni_stream(struct h3c *h3c, struct qcs *qcs,
 	return len;
 }
 
+static struct buffer *mux_get_buf(struct qcs *qcs);
+
+/* Returns the TX buffer of the QPACK decoder stream of <h3c> with at least
+ * <room> bytes available, or NULL if the stream is not opened or the buffer
+ * is full.
+ */
+static struct buffer *h3_qpack_dec_buf(struct h3c *h3c, size_t room)
+{
+	struct buffer *res;
+
+	if (!h3c->qpack_dec_strm)
+		return NULL;
+
+	res = mux_get_buf(h3c->qpack_dec_strm);
+	if (!b_size(res) || b_room(res) < room)
+		return NULL;
+
+	return res;
+}
+
+/* Acknowledges to the encoder the entries inserted into the QPACK dynamic
+ * table of <h3c> using an Insert Count Increment instruction. The encoder may
+ * only reference them once they are acknowledged. Nothing is done if the
+ * decoder stream is not opened yet, the instruction will be emitted once it
+ * is.
+ */
+static void h3_qpack_send_ici(struct h3c *h3c)
+{
+	struct buffer *res;
+
+	if (h3c->qpack_dec.ic == h3c->qpack_dec.krc)
+		return;
+
+	res = h3_qpack_dec_buf(h3c, QUIC_VARINT_MAX_SIZE + 2);
+	if (!res || !qpack_dec_encode_ici(&h3c->qpack_dec, res)) {
+		TRACE_DEVEL("cannot emit QPACK Insert Count Increment", H3_EV_RX_FRAME, h3c->qcc->conn);
+		return;
+	}
+
+	tasklet_wakeup(h3c->qcc->wait_event.tasklet);
+}
+
+/* Acknowledges to the encoder the field section decoded on <qcs> which had a
+ * Required Insert Count of <ric>, so that it may evict the entries it
+ * references.
+ */
+static void h3_qpack_send_sack(struct h3c *h3c, struct qcs *qcs, uint64_t ric)
+{
+	struct buffer *res;
+
+	if (!ric)
+		return;
+
+	res = h3_qpack_dec_buf(h3c, QUIC_VARINT_MAX_SIZE + 2);
+	if (!res || !qpack_dec_encode_sack(&h3c->qpack_dec, res, qcs->id, ric)) {
+		TRACE_DEVEL("cannot emit QPACK Section Acknowledgment", H3_EV_RX_FRAME, h3c->qcc->conn, qcs);
+		return;
+	}
+
+	tasklet_wakeup(h3c->qcc->wait_event.tasklet);
+}
+
 /* Parse a buffer <b> for a <qcs> uni-stream which does not contains H3 frames.
  * This may be used for QPACK encoder/decoder streams for example. <fin> is set
  * if this is the last frame of the stream.
@@ -239,14 +306,16 @@ static ssize_t h3_parse_uni_stream_no_h3(struct qcs *qcs, struct buffer *b, int
 	BUG_ON_HOT(!quic_stream_is_uni(qcs->id) ||
 	           !(h3s->flags & H3_SF_UNI_NO_H3));
 
+	ssize_t ret;
+
 	switch (h3s->type) {
 	case H3S_T_QPACK_DEC:
-		if (qpack_decode_dec(b, fin, qcs))
-			return -1;
+		ret = qpack_decode_dec(b, fin, qcs);
 		break;
 	case H3S_T_QPACK_ENC:
-		if (qpack_decode_enc(b, fin, qcs))
-			return -1;
+		ret = qpack_decode_enc(b, fin, qcs, &h3s->h3c->qpack_dec);
+		if (ret > 0)
+			h3_qpack_send_ici(h3s->h3c);
 		break;
 	case H3S_T_UNKNOWN:
 	default:
@@ -254,8 +323,7 @@ static ssize_t h3_parse_uni_stream_no_h3(struct qcs *qcs, struct buffer *b, int
 		ABORT_NOW();
 	}
 
-	/* TODO adjust return code */
-	return 0;
+	return ret;
 }
 
 /* Decode a H3 frame header from <rxbuf> buffer. The frame type is stored in
@@ -351,6 +419,7 @@ static ssize_t h3_headers_to_htx(struct qcs *qcs, const struct buffer *buf,
 	struct ist meth = IST_NULL, path = IST_NULL;
 	//struct ist scheme = IST_NULL, authority = IST_NULL;
 	struct ist authority = IST_NULL;
+	uint64_t ric;
 	int hdr_idx, ret;
 	int cookie = -1, last_cookie = -1;
 
@@ -361,13 +430,16 @@ static ssize_t h3_headers_to_htx(struct qcs *qcs, const struct buffer *buf,
 	/* TODO support buffer wrapping */
 	BUG_ON(b_head(buf) + len >= b_wrap(buf));
 	ret = qpack_decode_fs((const unsigned char *)b_head(buf), len, tmp,
-	                    list, sizeof(list) / sizeof(list[0]));
+	                    list, sizeof(list) / sizeof(list[0]),
+	                    &h3c->qpack_dec, &ric);
 	if (ret < 0) {
 		TRACE_ERROR("QPACK decoding error", H3_EV_RX_FRAME|H3_EV_RX_HDR, qcs->qcc->conn, qcs);
 		h3c->err = -ret;
 		return -1;
 	}
 
+	h3_qpack_send_sack(h3c, qcs, ric);
+
 	qc_get_buf(qcs, &htx_buf);
 	BUG_ON(!b_size(&htx_buf));
 	htx = htx_from_buf(&htx_buf);
@@ -440,6 +512,9 @@ static ssize_t h3_headers_to_htx(struct qcs *qcs, const struct buffer *buf,
 	if (fin)
 		htx->flags |= HTX_FL_EOM;
 
+	/* RFC9218 priority used to schedule the response */
+	http_get_priority(htx, &qcs->urgency, &qcs->incremental);
+
 	if (!qc_attach_sc(qcs, &htx_buf)) {
 		h3c->err = H3_INTERNAL_ERROR;
 		return -1;
@@ -485,15 +560,46 @@ static ssize_t h3_data_to_htx(struct qcs *qcs, const struct buffer *buf,
 
 	TRACE_ENTER(H3_EV_RX_FRAME|H3_EV_RX_DATA, qcs->qcc->conn, qcs);
 
-	appbuf = qc_get_buf(qcs, &qcs->rx.app_buf);
-	BUG_ON(!appbuf);
-	htx = htx_from_buf(appbuf);
-
 	if (len > b_data(buf)) {
 		len = b_data(buf);
 		fin = 0;
 	}
 
+	/* with large uploads we'll often face the following situation :
+	 *   - the application buffer is empty
+	 *   - the Rx buffer only contains payload, which starts where the HTX
+	 *     data would start, as placed by the MUX, and does not wrap
+	 *   - this payload fills at least half of the buffer, so that a
+	 *     buffer is not wasted for a few bytes
+	 *   => we can take the Rx buffer from the MUX and place an htx header
+	 *      before the payload instead of copying it.
+	 */
+	if (!b_data(&qcs->rx.app_buf) && len == b_data(buf) &&
+	    b_head_ofs(buf) == sizeof(struct htx) &&
+	    len <= b_size(buf) - sizeof(struct htx) - sizeof(struct htx_blk) &&
+	    len >= b_size(buf) / 2 &&
+	    qcs_xfer_rxbuf(qcs, &qcs->rx.app_buf)) {
+		struct htx_blk *blk;
+
+		appbuf = &qcs->rx.app_buf;
+		htx = (struct htx *)appbuf->area;
+		htx->size = b_size(appbuf) - sizeof(*htx);
+		htx_reset(htx);
+		b_set_data(appbuf, b_size(appbuf));
+
+		blk = htx_add_blk(htx, HTX_BLK_DATA, len);
+		blk->info += len;
+		htx_sent = len;
+		if (fin)
+			htx->flags |= HTX_FL_EOM;
+		TRACE_DATA("move some data to app buffer (zero-copy)", H3_EV_RX_FRAME|H3_EV_RX_DATA, qcs->qcc->conn, qcs);
+		goto out;
+	}
+
+	appbuf = qc_get_buf(qcs, &qcs->rx.app_buf);
+	BUG_ON(!appbuf);
+	htx = htx_from_buf(appbuf);
+
 	head = b_head(buf);
  retry:
 	htx_space = htx_free_data_space(htx);
@@ -795,7 +901,7 @@ static int h3_control_send(struct qcs *qcs, void *ctx)
 	pos = b_make((char *)data, sizeof(data), 0, 0);
 
 	frm_len = quic_int_getsize(H3_SETTINGS_QPACK_MAX_TABLE_CAPACITY) +
-		quic_int_getsize(h3_settings_qpack_max_table_capacity) +
+		quic_int_getsize(h3c->qpack_dec.max_cap) +
 		quic_int_getsize(H3_SETTINGS_QPACK_BLOCKED_STREAMS) +
 		quic_int_getsize(h3_settings_qpack_blocked_streams);
 	if (h3_settings_max_field_section_size) {
@@ -808,7 +914,7 @@ static int h3_control_send(struct qcs *qcs, void *ctx)
 	b_quic_enc_int(&pos, H3_FT_SETTINGS);
 	b_quic_enc_int(&pos, frm_len);
 	b_quic_enc_int(&pos, H3_SETTINGS_QPACK_MAX_TABLE_CAPACITY);
-	b_quic_enc_int(&pos, h3_settings_qpack_max_table_capacity);
+	b_quic_enc_int(&pos, h3c->qpack_dec.max_cap);
 	b_quic_enc_int(&pos, H3_SETTINGS_QPACK_BLOCKED_STREAMS);
 	b_quic_enc_int(&pos, h3_settings_qpack_blocked_streams);
 	if (h3_settings_max_field_section_size) {
@@ -1128,6 +1234,27 @@ static int h3_finalize(void *ctx)
 	h3_control_send(qcs, h3c);
 	h3c->ctrl_strm = qcs;
 
+	/* The QPACK decoder stream is only needed to acknowledge the dynamic
+	 * table insertions.
+	 */
+	if (h3c->qpack_dec.max_cap) {
+		struct buffer *res;
+
+		qcs = qcc_init_stream_local(h3c->qcc, 0);
+		if (!qcs)
+			return 0;
+
+		res = mux_get_buf(qcs);
+		if (!b_size(res))
+			return 0;
+
+		b_putchr(res, H3_UNI_S_T_QPACK_DEC);
+		h3c->qpack_dec_strm = qcs;
+
+		/* entries may have been inserted before */
+		h3_qpack_send_ici(h3c);
+	}
+
 	return 1;
 }
 
@@ -1176,6 +1303,10 @@ static int h3_init(struct qcc *qcc)
 
 	h3c->qcc = qcc;
 	h3c->ctrl_strm = NULL;
+	h3c->qpack_dec_strm = NULL;
+	h3c->qpack_dec.ic = h3c->qpack_dec.krc = 0;
+	h3c->qpack_dec.max_cap = global.tune.quic_qpack_max_table_capacity;
+	h3c->qpack_dec.dht = NULL;
 	h3c->err = H3_NO_ERROR;
 	h3c->flags = 0;
 	h3c->id_goaway = 0;
@@ -1219,6 +1350,9 @@ static void h3_shutdown(void *ctx)
 static void h3_release(void *ctx)
 {
 	struct h3c *h3c = ctx;
+
+	if (h3c->qpack_dec.dht)
+		qpack_dht_free(h3c->qpack_dec.dht);
 	pool_free(pool_head_h3c, h3c);
 }
 
@@ -1265,3 +1399,22 @@ const struct qcc_app_ops h3_ops = {
 	.inc_err_cnt = h3_stats_inc_err_cnt,
 	.release     = h3_release,
 };
+
+/* Allocates the QPACK dynamic tables pool once the configuration is parsed.
+ * Returns zero on success, non-zero on error.
+ */
+static int init_h3()
+{
+	if (!global.tune.quic_qpack_max_table_capacity)
+		return ERR_NONE;
+
+	pool_head_qpack_tbl = create_pool("qpack_tbl", global.tune.quic_qpack_max_table_capacity,
+	                                  MEM_F_SHARED|MEM_F_EXACT);
+	if (!pool_head_qpack_tbl) {
+		ha_alert("failed to allocate qpack_tbl memory pool\n");
+		return (ERR_ALERT | ERR_FATAL);
+	}
+	return ERR_NONE;
+}
+
+REGISTER_POST_CHECK(init_h3);
@@ -97,6 +97,7 @@
 #include <haproxy/cli.h>
 #include <haproxy/clock.h>
 #include <haproxy/connection.h>
+#include <haproxy/counters.h>
 #ifdef USE_CPU_AFFINITY
 #include <haproxy/cpuset.h>
 #endif
@@ -137,6 +138,7 @@
 #include <haproxy/thread.h>
 #include <haproxy/time.h>
 #include <haproxy/tools.h>
+#include <haproxy/ubench.h>
 #include <haproxy/uri_auth-t.h>
 #include <haproxy/vars.h>
 #include <haproxy/version.h>
@@ -172,7 +174,7 @@ struct global global = {
 	.hard_stop_after = TICK_ETERNITY,
 	.close_spread_time = TICK_ETERNITY,
 	.close_spread_end = TICK_ETERNITY,
-	.numa_cpu_mapping = 1,
+	.numa_cpu_mapping = NUMA_CPU_MAP_FIRST_NODE,
 	.nbthread = 0,
 	.req_count = 0,
 	.logsrvs = LIST_HEAD_INIT(global.logsrvs),
@@ -206,6 +208,7 @@ struct global global = {
 #endif
 #ifdef USE_QUIC
 		.quic_backend_max_idle_timeout = QUIC_TP_DFLT_BACK_MAX_IDLE_TIMEOUT,
+		.quic_frontend_ack_threshold = QUIC_MAX_RX_AEPKTS_SINCE_LAST_ACK,
 		.quic_frontend_max_idle_timeout = QUIC_TP_DFLT_FRONT_MAX_IDLE_TIMEOUT,
 		.quic_frontend_max_streams_bidi = QUIC_TP_DFLT_FRONT_MAX_STREAMS_BIDI,
 		.quic_retry_threshold = QUIC_DFLT_RETRY_THRESHOLD,
@@ -253,6 +256,7 @@ const struct linger nolinger = { .l_onoff = 1, .l_linger = 0 };
 char hostname[MAX_HOSTNAME_LEN];
 char *localpeer = NULL;
 static char *kwd_dump = NULL; // list of keyword dumps to produce
+static char *ubench_names = NULL; // list of micro-benchmarks to run
 
 static char **old_argv = NULL; /* previous argv but cleaned up */
 
@@ -600,6 +604,9 @@ static void usage(char *name)
 #if defined(USE_EVPORTS)
 		"        -dv disables event ports usage even when available\n"
 #endif
+#if defined(USE_URING)
+		"        -du disables io_uring usage even when available\n"
+#endif
 #if defined(USE_POLL)
 		"        -dp disables poll() usage even when available\n"
 #endif
@@ -616,6 +623,8 @@ static void usage(char *name)
 		"        -dL dumps loaded object files after config checks\n"
 #endif
 		"        -dK{class[,...]} dump registered keywords (use 'help' for list)\n"
+		"        -dB{name[,...]} run micro-benchmarks and exit (use 'help' for list)\n"
+		"        -dT[<ms>] reports the startup steps taking at least <ms> (default 1) ms\n"
 		"        -dr ignores server address resolution failures\n"
 		"        -dV disables SSL verify on servers side\n"
 		"        -dW fails if any warning is emitted\n"
@@ -933,7 +942,7 @@ static void sig_dump_state(struct sig_handler *sh)
 			             "SIGHUP: Server %s/%s is %s. Conn: %d act, %d pend, %lld tot.",
 			             p->id, s->id,
 			             (s->cur_state != SRV_ST_STOPPED) ? "UP" : "DOWN",
-			             s->cur_sess, s->queue.length, s->counters.cum_sess);
+			             s->cur_sess, s->queue.length, COUNTERS_GET(&s->counters, cum_sess));
 			ha_warning("%s\n", trash.area);
 			send_log(p, LOG_NOTICE, "%s\n", trash.area);
 			s = s->next;
@@ -944,19 +953,19 @@ static void sig_dump_state(struct sig_handler *sh)
 			chunk_printf(&trash,
 			             "SIGHUP: Proxy %s has no servers. Conn: act(FE+BE): %d+%d, %d pend (%d unass), tot(FE+BE): %lld+%lld.",
 			             p->id,
-			             p->feconn, p->beconn, p->totpend, p->queue.length, p->fe_counters.cum_conn, p->be_counters.cum_conn);
+			             p->feconn, p->beconn, p->totpend, p->queue.length, COUNTERS_GET(&p->fe_counters, cum_conn), COUNTERS_GET(&p->be_counters, cum_conn));
 		} else if (p->srv_act == 0) {
 			chunk_printf(&trash,
 			             "SIGHUP: Proxy %s %s ! Conn: act(FE+BE): %d+%d, %d pend (%d unass), tot(FE+BE): %lld+%lld.",
 			             p->id,
 			             (p->srv_bck) ? "is running on backup servers" : "has no server available",
-			             p->feconn, p->beconn, p->totpend, p->queue.length, p->fe_counters.cum_conn, p->be_counters.cum_conn);
+			             p->feconn, p->beconn, p->totpend, p->queue.length, COUNTERS_GET(&p->fe_counters, cum_conn), COUNTERS_GET(&p->be_counters, cum_conn));
 		} else {
 			chunk_printf(&trash,
 			             "SIGHUP: Proxy %s has %d active servers and %d backup servers available."
 			             " Conn: act(FE+BE): %d+%d, %d pend (%d unass), tot(FE+BE): %lld+%lld.",
 			             p->id, p->srv_act, p->srv_bck,
-			             p->feconn, p->beconn, p->totpend, p->queue.length, p->fe_counters.cum_conn, p->be_counters.cum_conn);
+			             p->feconn, p->beconn, p->totpend, p->queue.length, COUNTERS_GET(&p->fe_counters, cum_conn), COUNTERS_GET(&p->be_counters, cum_conn));
 		}
 		ha_warning("%s\n", trash.area);
 		send_log(p, LOG_NOTICE, "%s\n", trash.area);
@@ -1566,6 +1575,9 @@ static void init_args(int argc, char **argv)
 #if defined(USE_EVPORTS)
 	global.tune.options |= GTUNE_USE_EVPORTS;
 #endif
+#if defined(USE_URING)
+	global.tune.options |= GTUNE_USE_URING;
+#endif
 #if defined(USE_LINUX_SPLICE)
 	global.tune.options |= GTUNE_USE_SPLICE;
 #endif
@@ -1621,6 +1633,10 @@ static void init_args(int argc, char **argv)
 			else if (*flag == 'd' && flag[1] == 'v')
 				global.tune.options &= ~GTUNE_USE_EVPORTS;
 #endif
+#if defined(USE_URING)
+			else if (*flag == 'd' && flag[1] == 'u')
+				global.tune.options &= ~GTUNE_USE_URING;
+#endif
 #if defined(USE_LINUX_SPLICE)
 			else if (*flag == 'd' && flag[1] == 'S')
 				global.tune.options &= ~GTUNE_USE_SPLICE;
@@ -1685,6 +1701,13 @@ static void init_args(int argc, char **argv)
 				arg_mode |= MODE_DUMP_KWD;
 				kwd_dump = flag + 2;
 			}
+			else if (*flag == 'd' && flag[1] == 'B')
+				ubench_names = flag + 2;
+			else if (*flag == 'd' && flag[1] == 'T') {
+				arg_mode |= MODE_DUMP_TIMES;
+				if (flag[2])
+					startup_prof_min_ms = atoi(flag + 2);
+			}
 			else if (*flag == 'd')
 				arg_mode |= MODE_DEBUG;
 			else if (*flag == 'c' && flag[1] == 'c') {
@@ -1918,6 +1941,34 @@ static void generate_random_cluster_secret()
 	global.cluster_secret[7] = '\0';
 }
 
+/* With "-dT", reports the resources used since the previous call as being
+ * spent in startup stage <stage>. The first call only sets the origin.
+ */
+static void startup_stage_done(const char *stage)
+{
+	static struct startup_prof prof;
+
+	if (stage)
+		startup_prof_report(&prof, 1, "stage '%s'", stage);
+	startup_prof_start(&prof);
+}
+
+/* Calls post-check function <fct> and reports its cost with "-dT" */
+static int startup_call_check(int (*fct)())
+{
+	struct startup_prof prof;
+	int ret;
+
+	startup_prof_start(&prof);
+	ret = fct();
+	if (global.mode & MODE_DUMP_TIMES) {
+		chunk_reset(&trash);
+		resolve_sym_name(&trash, NULL, fct);
+		startup_prof_report(&prof, 0, "callback '%s'", trash.area);
+	}
+	return ret;
+}
+
 /*
  * This function initializes all the necessary variables. It only returns
  * if everything is OK. If something fails, it exits.
@@ -1962,7 +2013,7 @@ static void init(int argc, char **argv)
 	global.mode |= (arg_mode & (MODE_DAEMON | MODE_MWORKER | MODE_FOREGROUND | MODE_VERBOSE
 				    | MODE_QUIET | MODE_CHECK | MODE_DEBUG | MODE_ZERO_WARNING
 				    | MODE_DIAG | MODE_CHECK_CONDITION | MODE_DUMP_LIBS | MODE_DUMP_KWD
-				    | MODE_DUMP_CFG | MODE_DUMP_NB_L));
+				    | MODE_DUMP_CFG | MODE_DUMP_NB_L | MODE_DUMP_TIMES));
 
 	if (getenv("HAPROXY_MWORKER_WAIT_ONLY")) {
 		unsetenv("HAPROXY_MWORKER_WAIT_ONLY");
@@ -2044,6 +2095,8 @@ static void init(int argc, char **argv)
 		exit(result ? 0 : 1);
 	}
 
+	startup_stage_done(NULL);
+
 	/* in wait mode, we don't try to read the configuration files */
 	if (!(global.mode & MODE_MWORKER_WAIT)) {
 		char *env_cfgfiles = NULL;
@@ -2057,6 +2110,7 @@ static void init(int argc, char **argv)
 
 
 		list_for_each_entry(wl, &cfg_cfgfiles, list) {
+			struct startup_prof prof;
 			int ret;
 
 			if (env_err == 0) {
@@ -2066,7 +2120,9 @@ static void init(int argc, char **argv)
 					env_err = 1;
 			}
 
+			startup_prof_start(&prof);
 			ret = readcfgfile(wl->s);
+			startup_prof_report(&prof, 1, "config file '%s'", wl->s);
 			if (ret == -1) {
 				ha_alert("Could not open configuration file %s : %s\n",
 					 wl->s, strerror(errno));
@@ -2200,14 +2256,18 @@ static void init(int argc, char **argv)
 	proxy_destroy_all_unref_defaults();
 
 	list_for_each_entry(prcf, &pre_check_list, list)
-		err_code |= prcf->fct();
+		err_code |= startup_call_check(prcf->fct);
 
 	if (err_code & (ERR_ABORT|ERR_FATAL)) {
 		ha_alert("Fatal errors found in configuration.\n");
 		exit(1);
 	}
 
+	startup_stage_done("config parsing");
+
 	err_code |= check_config_validity();
+	startup_stage_done("config validity");
+
 	for (px = proxies_list; px; px = px->next) {
 		struct server *srv;
 		struct post_proxy_check_fct *ppcf;
@@ -2228,11 +2288,14 @@ static void init(int argc, char **argv)
 		exit(1);
 	}
 
+	startup_stage_done("post proxy/server checks");
+
 	err_code |= pattern_finalize_config();
 	if (err_code & (ERR_ABORT|ERR_FATAL)) {
 		ha_alert("Failed to finalize pattern config.\n");
 		exit(1);
 	}
+	startup_stage_done("pattern finalization");
 
 	if (global.rlimit_memmax_all)
 		global.rlimit_memmax = global.rlimit_memmax_all;
@@ -2251,12 +2314,15 @@ static void init(int argc, char **argv)
 	for (px = proxies_list; px; px = px->next)
 		srv_compute_all_admin_states(px);
 
+	startup_stage_done("server states");
+
 	/* Apply servers' configured address */
 	err_code |= srv_init_addr();
 	if (err_code & (ERR_ABORT|ERR_FATAL)) {
 		ha_alert("Failed to initialize server(s) addr.\n");
 		exit(1);
 	}
+	startup_stage_done("server addresses");
 
 	if (warned & WARN_ANY && global.mode & MODE_ZERO_WARNING) {
 		ha_alert("Some warnings were found and 'zero-warning' is set. Aborting.\n");
@@ -2329,11 +2395,25 @@ static void init(int argc, char **argv)
 	/* now we know the buffer size, we can initialize the channels and buffers */
 	init_buffer();
 
+	startup_stage_done("misc init");
+
 	list_for_each_entry(pcf, &post_check_list, list) {
-		err_code |= pcf->fct();
+		err_code |= startup_call_check(pcf->fct);
 		if (err_code & (ERR_ABORT|ERR_FATAL))
 			exit(1);
 	}
+	startup_stage_done("post-check callbacks");
+
+	/* all the proxies known at boot were created and the number of threads
+	 * is known, the counters' shards may now be allocated.
+	 */
+	if (!counters_shards_alloc_all()) {
+		ha_alert("failed to allocate the counters.\n");
+		exit(1);
+	}
+
+	if (ubench_names)
+		exit(ubench_run(ubench_names) ? EXIT_FAILURE : 0);
 
 	/* set the default maxconn in the master, but let it be rewritable with -n */
 	if (global.mode & MODE_MWORKER_WAIT)
@@ -2606,6 +2686,9 @@ static void init(int argc, char **argv)
 	if (!(global.tune.options & GTUNE_USE_EVPORTS))
 		disable_poller("evports");
 
+	if (!(global.tune.options & GTUNE_USE_URING))
+		disable_poller("io_uring");
+
 	if (!(global.tune.options & GTUNE_USE_EPOLL))
 		disable_poller("epoll");
 
@@ -2697,7 +2780,7 @@ void deinit(void)
 	 */
 	protocol_unbind_all();
 
-	for (cur_fd = 0; cur_fd < global.maxsock; cur_fd++) {
+	for (cur_fd = 0; cur_fd < fdtab_inited; cur_fd++) {
 		if (!fdtab || !fdtab[cur_fd].owner)
 			continue;
 
@@ -2894,6 +2977,9 @@ void run_poll_loop()
 		/* Process a few tasks */
 		process_runnable_tasks();
 
+		/* send the log datagrams these tasks batched */
+		log_flush_dgrams();
+
 		/* also stop  if we failed to cleanly stop all tasks */
 		if (killed > 1)
 			break;
@@ -188,3 +188,88 @@ uint32_t hash_crc32c(const void *input, int len)
 	}
 	return (crc ^ 0xffffffff);
 }
+
+/* The functions below return the same hash as their equivalent above, as if
+ * the input had been turned to lower case first. This avoids copying it when
+ * a hash is applied to the lower case form of a string (e.g. "lower,crc32").
+ */
+static inline unsigned int hash_lc(unsigned char c)
+{
+	return (c >= 'A' && c <= 'Z') ? c + 'a' - 'A' : c;
+}
+
+unsigned int hash_wt6_lower(const void *input, int len)
+{
+	const unsigned char *key = input;
+	unsigned h0 = 0xa53c965aUL;
+	unsigned h1 = 0x5ca6953aUL;
+	unsigned step0 = 6;
+	unsigned step1 = 18;
+
+	for (; len > 0; len--) {
+		unsigned int t;
+
+		t = hash_lc(*key);
+		key++;
+
+		h0 = ~(h0 ^ t);
+		h1 = ~(h1 + t);
+
+		t  = (h1 << step0) | (h1 >> (32-step0));
+		h1 = (h0 << step1) | (h0 >> (32-step1));
+		h0 = t;
+
+		t = ((h0 >> 16) ^ h1) & 0xffff;
+		step0 = t & 0x1F;
+		step1 = t >> 11;
+	}
+	return h0 ^ h1;
+}
+
+unsigned int hash_djb2_lower(const void *input, int len)
+{
+	const unsigned char *key = input;
+	unsigned int hash = 5381;
+
+	while (len--)
+		hash = ((hash << 5) + hash) + hash_lc(*key++);
+	return hash;
+}
+
+unsigned int hash_sdbm_lower(const void *input, int len)
+{
+	const unsigned char *key = input;
+	unsigned int hash = 0;
+	int c;
+
+	while (len--) {
+		c = hash_lc(*key++);
+		hash = c + (hash << 6) + (hash << 16) - hash;
+	}
+	return hash;
+}
+
+unsigned int hash_crc32_lower(const void *input, int len)
+{
+	const unsigned char *key = input;
+	unsigned int hash;
+	int bit;
+
+	hash = ~0;
+	while (len--) {
+		hash ^= hash_lc(*key++);
+		for (bit = 0; bit < 8; bit++)
+			hash = (hash >> 1) ^ ((hash & 1) ? 0xedb88320 : 0);
+	}
+	return ~hash;
+}
+
+uint32_t hash_crc32c_lower(const void *input, int len)
+{
+	const unsigned char *buf = input;
+	uint32_t crc = 0xffffffff;
+
+	while (len-- > 0)
+		crc = (crc >> 8) ^ crctable[(crc ^ hash_lc(*buf++)) & 0xff];
+	return (crc ^ 0xffffffff);
+}
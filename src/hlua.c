@@ -19,12 +19,15 @@
 #include <lua.h>
 #include <lualib.h>
 
-#if !defined(LUA_VERSION_NUM) || LUA_VERSION_NUM < 503
+#if defined(LUAJIT_VERSION)
+#error "LuaJIT is not supported: it lacks the continuation-based yields (lua_yieldk/lua_callk/lua_pcallk) and the native integers of Lua 5.3."
+#elif !defined(LUA_VERSION_NUM) || LUA_VERSION_NUM < 503
 #error "Requires Lua 5.3 or later."
 #endif
 
 #include <import/ebpttree.h>
 
+#include <haproxy/activity.h>
 #include <haproxy/api.h>
 #include <haproxy/applet.h>
 #include <haproxy/arg.h>
@@ -147,6 +150,12 @@ static int hlua_state_id;
 /* This is a NULL-terminated list of lua file which are referenced to load per thread */
 static char ***per_thread_load = NULL;
 
+/* Compiled chunks of the files above, in the same order. They are produced
+ * when loading the file in the first thread's state so that the other states
+ * do not have to parse and compile the same files again.
+ */
+static struct buffer *per_thread_chunk = NULL;
+
 lua_State *hlua_init_state(int thread_id);
 
 /* This function takes the Lua global lock. Keep this function's visibility
@@ -327,6 +336,17 @@ static unsigned int hlua_timeout_session = 4000; /* session timeout. */
 static unsigned int hlua_timeout_task = TICK_ETERNITY; /* task timeout. */
 static unsigned int hlua_timeout_applet = 4000; /* applet timeout. */
 
+/* Default nice value of the tasks created by core.register_task(). A positive
+ * value lets the streams' request-path Lua actions run before these background
+ * tasks when both are runnable.
+ */
+static int hlua_task_nice = 0;
+
+/* Pseudo-function used to account for the Lua executions not attached to a
+ * registered function (tasks and filters) in "show profiling lua".
+ */
+static struct hlua_function hlua_anon_fcn = { .name = "<anonymous>" };
+
 /* Interrupts the Lua processing each "hlua_nb_instruction" instructions.
  * it is used for preventing infinite loops.
  *
@@ -1247,6 +1267,7 @@ int hlua_ctx_init(struct hlua *lua, int state_id, struct task *task, int already
 	lua->gc_count = 0;
 	lua->wake_time = TICK_ETERNITY;
 	lua->state_id = state_id;
+	lua->fcn = NULL;
 	LIST_INIT(&lua->com);
 	LIST_INIT(&lua->hc_list);
 	if (!already_safe) {
@@ -1443,6 +1464,10 @@ static enum hlua_exec hlua_ctx_resume(struct hlua *lua, int yield_allowed)
 	int ret;
 	const char *msg;
 	const char *trace;
+	uint64_t prof_start = 0;
+
+	if (unlikely(th_ctx->flags & TH_FL_TASK_PROFILING))
+		prof_start = now_mono_time();
 
 	/* Initialise run time counter. */
 	if (!HLUA_IS_RUNNING(lua))
@@ -1602,6 +1627,31 @@ static enum hlua_exec hlua_ctx_resume(struct hlua *lua, int yield_allowed)
 	if (lua->state_id == 0)
 		lua_drop_global_lock();
 
+	/* account the CPU time of each resume, but the call only once the
+	 * execution is over.
+	 */
+	if (unlikely(prof_start)) {
+		struct sched_activity *act;
+
+		act = sched_activity_entry(lua_activity, lua->fcn ? lua->fcn : &hlua_anon_fcn, NULL);
+		if (ret != HLUA_E_AGAIN)
+			HA_ATOMIC_INC(&act->calls);
+		HA_ATOMIC_ADD(&act->cpu_time, now_mono_time() - prof_start);
+	}
+
+	return ret;
+}
+
+/* Same as hlua_ctx_resume() for a Lua context running on behalf of stream
+ * <s>, whose Lua timings are updated when the stream is profiled.
+ */
+static enum hlua_exec hlua_strm_ctx_resume(struct stream *s, struct hlua *lua, int yield_allowed)
+{
+	uint32_t start = stream_timing_start();
+	enum hlua_exec ret;
+
+	ret = hlua_ctx_resume(lua, yield_allowed);
+	stream_timing_stop(&s->lua_time, start);
 	return ret;
 }
 
@@ -4130,7 +4180,8 @@ __LJMP static int hlua_run_sample_fetch(lua_State *L)
 {
 	struct hlua_smp *hsmp;
 	struct sample_fetch *f;
-	struct arg args[ARGM_NBARGS + 1] = {{0}};
+	struct arg args[ARGM_NBARGS + 1];
+	struct arg *argp = args;
 	int i;
 	struct sample smp;
 
@@ -4148,7 +4199,16 @@ __LJMP static int hlua_run_sample_fetch(lua_State *L)
 		WILL_LJMP(lua_error(L));
 	}
 
+	/* Most fetches are called without argument and do not expect any,
+	 * in which case there is nothing to convert nor to check.
+	 */
+	if (lua_gettop(L) == 1 && !f->arg_mask && !f->val_args) {
+		argp = empty_arg_list;
+		goto run;
+	}
+
 	/* Get extra arguments. */
+	memset(args, 0, sizeof(args));
 	for (i = 0; i < lua_gettop(L) - 1; i++) {
 		if (i >= ARGM_NBARGS)
 			break;
@@ -4166,12 +4226,13 @@ __LJMP static int hlua_run_sample_fetch(lua_State *L)
 		goto error;
 	}
 
+  run:
 	/* Initialise the sample. */
 	memset(&smp, 0, sizeof(smp));
 
 	/* Run the sample fetch process. */
 	smp_set_owner(&smp, hsmp->p, hsmp->s->sess, hsmp->s, hsmp->dir & SMP_OPT_DIR);
-	if (!f->process(args, &smp, f->kw, f->private)) {
+	if (!f->process(argp, &smp, f->kw, f->private)) {
 		if (hsmp->flags & HLUA_F_AS_STRING)
 			lua_pushstring(L, "");
 		else
@@ -4186,11 +4247,13 @@ __LJMP static int hlua_run_sample_fetch(lua_State *L)
 		hlua_smp2lua(L, &smp);
 
   end:
-	free_args(args);
+	if (argp == args)
+		free_args(args);
 	return 1;
 
   error:
-	free_args(args);
+	if (argp == args)
+		free_args(args);
 	WILL_LJMP(lua_error(L));
 	return 0; /* Never reached */
 }
@@ -4252,7 +4315,8 @@ __LJMP static int hlua_run_sample_conv(lua_State *L)
 {
 	struct hlua_smp *hsmp;
 	struct sample_conv *conv;
-	struct arg args[ARGM_NBARGS + 1] = {{0}};
+	struct arg args[ARGM_NBARGS + 1];
+	struct arg *argp = args;
 	int i;
 	struct sample smp;
 
@@ -4262,7 +4326,16 @@ __LJMP static int hlua_run_sample_conv(lua_State *L)
 	/* Get traditional arguments. */
 	hsmp = MAY_LJMP(hlua_checkconverters(L, 1));
 
+	/* Converters called without argument and not expecting any have
+	 * nothing to convert nor to check.
+	 */
+	if (lua_gettop(L) <= 2 && !conv->arg_mask && !conv->val_args) {
+		argp = empty_arg_list;
+		goto run;
+	}
+
 	/* Get extra arguments. */
+	memset(args, 0, sizeof(args));
 	for (i = 0; i < lua_gettop(L) - 2; i++) {
 		if (i >= ARGM_NBARGS)
 			break;
@@ -4280,6 +4353,7 @@ __LJMP static int hlua_run_sample_conv(lua_State *L)
 		goto error;
 	}
 
+  run:
 	/* Initialise the sample. */
 	memset(&smp, 0, sizeof(smp));
 	if (!hlua_lua2smp(L, 2, &smp)) {
@@ -4302,7 +4376,7 @@ __LJMP static int hlua_run_sample_conv(lua_State *L)
 	}
 
 	/* Run the sample conversion process. */
-	if (!conv->process(args, &smp, conv->private)) {
+	if (!conv->process(argp, &smp, conv->private)) {
 		if (hsmp->flags & HLUA_F_AS_STRING)
 			lua_pushstring(L, "");
 		else
@@ -4316,11 +4390,13 @@ __LJMP static int hlua_run_sample_conv(lua_State *L)
 	else
 		hlua_smp2lua(L, &smp);
   end:
-	free_args(args);
+	if (argp == args)
+		free_args(args);
 	return 1;
 
   error:
-	free_args(args);
+	if (argp == args)
+		free_args(args);
 	WILL_LJMP(lua_error(L));
 	return 0; /* Never reached */
 }
@@ -8627,6 +8703,7 @@ static int hlua_register_task(lua_State *L)
 
 	task->context = hlua;
 	task->process = hlua_process_task;
+	task->nice = hlua_task_nice;
 
 	if (!hlua_ctx_init(hlua, state_id, task, 1))
 		goto alloc_error;
@@ -8701,6 +8778,8 @@ static int hlua_sample_conv_wrapper(const struct arg *arg_p, struct sample *smp,
 			return 0;
 		}
 
+		stream->hlua->fcn = fcn;
+
 		/* Restore the function in the stack. */
 		lua_rawgeti(stream->hlua->T, LUA_REGISTRYINDEX, fcn->function_ref[stream->hlua->state_id]);
 
@@ -8734,7 +8813,7 @@ static int hlua_sample_conv_wrapper(const struct arg *arg_p, struct sample *smp,
 	}
 
 	/* Execute the function. */
-	switch (hlua_ctx_resume(stream->hlua, 0)) {
+	switch (hlua_strm_ctx_resume(stream, stream->hlua, 0)) {
 	/* finished. */
 	case HLUA_E_OK:
 		/* If the stack is empty, the function fails. */
@@ -8838,6 +8917,8 @@ static int hlua_sample_fetch_wrapper(const struct arg *arg_p, struct sample *smp
 			return 0;
 		}
 
+		stream->hlua->fcn = fcn;
+
 		/* Restore the function in the stack. */
 		lua_rawgeti(stream->hlua->T, LUA_REGISTRYINDEX, fcn->function_ref[stream->hlua->state_id]);
 
@@ -8869,7 +8950,7 @@ static int hlua_sample_fetch_wrapper(const struct arg *arg_p, struct sample *smp
 	}
 
 	/* Execute the function. */
-	switch (hlua_ctx_resume(stream->hlua, 0)) {
+	switch (hlua_strm_ctx_resume(stream, stream->hlua, 0)) {
 	/* finished. */
 	case HLUA_E_OK:
 		/* If the stack is empty, the function fails. */
@@ -9169,6 +9250,8 @@ static enum act_return hlua_action(struct act_rule *rule, struct proxy *px,
 			goto end;
 		}
 
+		s->hlua->fcn = rule->arg.hlua_rule->fcn;
+
 		/* Restore the function in the stack. */
 		lua_rawgeti(s->hlua->T, LUA_REGISTRYINDEX, rule->arg.hlua_rule->fcn->function_ref[s->hlua->state_id]);
 
@@ -9201,7 +9284,7 @@ static enum act_return hlua_action(struct act_rule *rule, struct proxy *px,
 	}
 
 	/* Execute the function. */
-	switch (hlua_ctx_resume(s->hlua, !(flags & ACT_OPT_FINAL))) {
+	switch (hlua_strm_ctx_resume(s, s->hlua, !(flags & ACT_OPT_FINAL))) {
 	/* finished. */
 	case HLUA_E_OK:
 		/* Catch the return value */
@@ -9355,6 +9438,8 @@ static int hlua_applet_tcp_init(struct appctx *ctx)
 		return -1;
 	}
 
+	hlua->fcn = ctx->rule->arg.hlua_rule->fcn;
+
 	/* Restore the function in the stack. */
 	lua_rawgeti(hlua->T, LUA_REGISTRYINDEX, ctx->rule->arg.hlua_rule->fcn->function_ref[hlua->state_id]);
 
@@ -9552,6 +9637,8 @@ static int hlua_applet_http_init(struct appctx *ctx)
 		return -1;
 	}
 
+	hlua->fcn = ctx->rule->arg.hlua_rule->fcn;
+
 	/* Restore the function in the stack. */
 	lua_rawgeti(hlua->T, LUA_REGISTRYINDEX, ctx->rule->arg.hlua_rule->fcn->function_ref[hlua->state_id]);
 
@@ -10176,6 +10263,8 @@ static int hlua_cli_parse_fct(char **args, char *payload, struct appctx *appctx,
 		goto error;
 	}
 
+	hlua->fcn = fcn;
+
 	/* Restore the function in the stack. */
 	lua_rawgeti(hlua->T, LUA_REGISTRYINDEX, fcn->function_ref[hlua->state_id]);
 
@@ -11252,6 +11341,23 @@ static int hlua_forced_yield(char **args, int section_type, struct proxy *curpx,
 	return 0;
 }
 
+static int hlua_parse_task_nice(char **args, int section_type, struct proxy *curpx,
+                                const struct proxy *defpx, const char *file, int line,
+                                char **err)
+{
+	char *error;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	hlua_task_nice = strtol(args[1], &error, 10);
+	if (!*args[1] || *error != '\0' || hlua_task_nice < -1024 || hlua_task_nice > 1024) {
+		memprintf(err, "'%s' expects a nice value between -1024 and 1024", args[0]);
+		return -1;
+	}
+	return 0;
+}
+
 static int hlua_parse_maxmem(char **args, int section_type, struct proxy *curpx,
                              const struct proxy *defpx, const char *file, int line,
                              char **err)
@@ -11270,11 +11376,37 @@ static int hlua_parse_maxmem(char **args, int section_type, struct proxy *curpx,
 	return 0;
 }
 
+/* lua_Writer callback used to dump a compiled chunk into the growing buffer
+ * <ud>. Returns 0 on success or non-zero on allocation failure.
+ */
+static int hlua_chunk_writer(lua_State *L, const void *p, size_t sz, void *ud)
+{
+	struct buffer *buf = ud;
+	size_t size;
+	char *area;
+
+	if (buf->data + sz > buf->size) {
+		for (size = buf->size ? buf->size : 4096; size < buf->data + sz; size *= 2)
+			;
+		area = realloc(buf->area, size);
+		if (!area)
+			return 1;
+		buf->area = area;
+		buf->size = size;
+	}
+	memcpy(buf->area + buf->data, p, sz);
+	buf->data += sz;
+	return 0;
+}
 
 /* This function is called by the main configuration key "lua-load". It loads and
  * execute an lua file during the parsing of the HAProxy configuration file. It is
  * the main lua entry point.
  *
+ * If <chunk> is not NULL and already contains a compiled chunk, this one is
+ * loaded instead of the file. If it is empty, the compiled file is dumped into
+ * it so that it may be loaded into other states later.
+ *
  * This function runs with the HAProxy keywords API. It returns -1 if an error
  * occurs, otherwise it returns 0.
  *
@@ -11285,13 +11417,26 @@ static int hlua_parse_maxmem(char **args, int section_type, struct proxy *curpx,
  * We are in the configuration parsing process of HAProxy, this abort() is
  * tolerated.
  */
-static int hlua_load_state(char **args, lua_State *L, char **err)
+static int hlua_load_state(char **args, lua_State *L, struct buffer *chunk, char **err)
 {
 	int error;
 	int nargs;
 
-	/* Just load and compile the file. */
-	error = luaL_loadfile(L, args[0]);
+	if (chunk && b_data(chunk)) {
+		/* already compiled in another state */
+		chunk_printf(&trash, "@%s", args[0]);
+		error = luaL_loadbufferx(L, b_orig(chunk), b_data(chunk), trash.area, "b");
+	}
+	else {
+		/* Just load and compile the file. */
+		error = luaL_loadfile(L, args[0]);
+		if (!error && chunk && lua_dump(L, hlua_chunk_writer, chunk, 0) != 0) {
+			/* not fatal, other states will compile the file again */
+			ha_free(&chunk->area);
+			*chunk = BUF_NULL;
+		}
+	}
+
 	if (error) {
 		memprintf(err, "error in Lua file '%s': %s", args[0], lua_tostring(L, -1));
 		lua_pop(L, 1);
@@ -11352,7 +11497,7 @@ static int hlua_load(char **args, int section_type, struct proxy *curpx,
 	/* loading for global state */
 	hlua_state_id = 0;
 	ha_set_thread(NULL);
-	return hlua_load_state(&args[1], hlua_states[0], err);
+	return hlua_load_state(&args[1], hlua_states[0], NULL, err);
 }
 
 static int hlua_load_per_thread(char **args, int section_type, struct proxy *curpx,
@@ -11387,6 +11532,13 @@ static int hlua_load_per_thread(char **args, int section_type, struct proxy *cur
 	}
 	per_thread_load[len + 1] = NULL;
 
+	per_thread_chunk = realloc(per_thread_chunk, (len + 1) * sizeof(*per_thread_chunk));
+	if (per_thread_chunk == NULL) {
+		memprintf(err, "out of memory error");
+		return -1;
+	}
+	per_thread_chunk[len] = BUF_NULL;
+
 	/* count args excepting the first, allocate array and copy args */
 	for (i = 0; *(args[i + 1]) != 0; i++);
 	per_thread_load[len] = calloc(i + 1, sizeof(*per_thread_load[len]));
@@ -11410,7 +11562,7 @@ static int hlua_load_per_thread(char **args, int section_type, struct proxy *cur
 	/* loading for thread 1 only */
 	hlua_state_id = 1;
 	ha_set_thread(NULL);
-	return hlua_load_state(per_thread_load[len], hlua_states[1], err);
+	return hlua_load_state(per_thread_load[len], hlua_states[1], &per_thread_chunk[len], err);
 }
 
 /* Prepend the given <path> followed by a semicolon to the `package.<type>` variable
@@ -11517,6 +11669,7 @@ static struct cfg_kw_list cfg_kws = {{ },{
 	{ CFG_GLOBAL, "tune.lua.task-timeout",    hlua_task_timeout },
 	{ CFG_GLOBAL, "tune.lua.service-timeout", hlua_applet_timeout },
 	{ CFG_GLOBAL, "tune.lua.forced-yield",    hlua_forced_yield },
+	{ CFG_GLOBAL, "tune.lua.task-nice",       hlua_parse_task_nice },
 	{ CFG_GLOBAL, "tune.lua.maxmem",          hlua_parse_maxmem },
 	{ 0, NULL, NULL },
 }};
@@ -11850,7 +12003,7 @@ int hlua_post_init()
 
 		/* Load lua files */
 		for (i = 0; per_thread_load && per_thread_load[i]; i++) {
-			ret = hlua_load_state(per_thread_load[i], hlua_states[hlua_state_id], &err);
+			ret = hlua_load_state(per_thread_load[i], hlua_states[hlua_state_id], &per_thread_chunk[i], &err);
 			if (ret != 0) {
 				ha_alert("Lua init: %s\n", err);
 				return 0;
@@ -11858,6 +12011,11 @@ int hlua_post_init()
 		}
 	}
 
+	/* the compiled chunks are not needed anymore */
+	for (i = 0; per_thread_load && per_thread_load[i]; i++)
+		ha_free(&per_thread_chunk[i].area);
+	ha_free(&per_thread_chunk);
+
 	/* Reset thread context */
 	ha_set_thread(NULL);
 
@@ -557,6 +557,8 @@ int hlua_stktable_info(lua_State *L)
 
 		if (stktable_data_types[dt].arg_type == ARG_T_DELAY)
 			lua_pushinteger(L, tbl->data_arg[dt].u);
+		else if (stktable_data_types[dt].arg_type == ARG_T_RATE)
+			lua_pushinteger(L, tbl->data_arg[dt].rate.period);
 		else
 			lua_pushinteger(L, -1);
 
@@ -590,7 +592,10 @@ static void hlua_stktable_entry(lua_State *L, struct stktable *t, struct stksess
 			hlua_fcn_pushunsigned(L, stktable_data_cast(ptr, std_t_uint));
 			break;
 		case STD_T_ULL:
-			hlua_fcn_pushunsigned_ll(L, stktable_data_cast(ptr, std_t_ull));
+			if (dt == STKTABLE_DT_GCRA)
+				hlua_fcn_pushunsigned(L, stktable_gcra_tokens(t, ptr));
+			else
+				hlua_fcn_pushunsigned_ll(L, stktable_data_cast(ptr, std_t_ull));
 			break;
 		case STD_T_FRQP:
 			lua_pushinteger(L, read_freq_ctr_period(&stktable_data_cast(ptr, std_t_frqp),
@@ -649,9 +654,7 @@ int hlua_stktable_lookup(lua_State *L)
 	lua_settable(L, -3);
 
 	hlua_stktable_entry(L, t, ts);
-	HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &t->lock);
-	ts->ref_cnt--;
-	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &t->lock);
+	HA_ATOMIC_DEC(&ts->ref_cnt);
 
 	return 1;
 }
@@ -689,9 +692,11 @@ static int hlua_error(lua_State *L, const char *fmt, ...)  {
 int hlua_stktable_dump(lua_State *L)
 {
 	struct stktable *t;
+	struct stktable_shard *shard;
 	struct ebmb_node *eb;
 	struct ebmb_node *n;
 	struct stksess *ts;
+	unsigned int shard_num;
 	int type;
 	int op;
 	int dt;
@@ -761,83 +766,87 @@ int hlua_stktable_dump(lua_State *L)
 
 	lua_newtable(L);
 
-	HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &t->lock);
-	eb = ebmb_first(&t->keys);
-	for (n = eb; n; n = ebmb_next(n)) {
-		ts = ebmb_entry(n, struct stksess, key);
-		if (!ts) {
-			HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &t->lock);
-			return 1;
-		}
-		ts->ref_cnt++;
-		HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &t->lock);
+	for (shard_num = 0; shard_num < t->nb_shards; shard_num++) {
+		shard = &t->shards[shard_num];
+		HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
+		eb = ebmb_first(&shard->keys);
+		for (n = eb; n; n = ebmb_next(n)) {
+			ts = ebmb_entry(n, struct stksess, key);
+			if (!ts) {
+				HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
+				return 1;
+			}
+			HA_ATOMIC_INC(&ts->ref_cnt);
+			HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
 
-		/* multi condition/value filter */
-		skip_entry = 0;
-		for (i = 0; i < filter_count; i++) {
-			if (t->data_ofs[filter[i].type] == 0)
-				continue;
+			/* multi condition/value filter */
+			skip_entry = 0;
+			for (i = 0; i < filter_count; i++) {
+				if (t->data_ofs[filter[i].type] == 0)
+					continue;
 
-			ptr = stktable_data_ptr(t, ts, filter[i].type);
+				ptr = stktable_data_ptr(t, ts, filter[i].type);
 
-			switch (stktable_data_types[filter[i].type].std_type) {
-			case STD_T_SINT:
-				val = stktable_data_cast(ptr, std_t_sint);
-				break;
-			case STD_T_UINT:
-				val = stktable_data_cast(ptr, std_t_uint);
-				break;
-			case STD_T_ULL:
-				val = stktable_data_cast(ptr, std_t_ull);
-				break;
-			case STD_T_FRQP:
-				val = read_freq_ctr_period(&stktable_data_cast(ptr, std_t_frqp),
-						           t->data_arg[filter[i].type].u);
-				break;
-			default:
-				continue;
-				break;
-			}
+				switch (stktable_data_types[filter[i].type].std_type) {
+				case STD_T_SINT:
+					val = stktable_data_cast(ptr, std_t_sint);
+					break;
+				case STD_T_UINT:
+					val = stktable_data_cast(ptr, std_t_uint);
+					break;
+				case STD_T_ULL:
+					val = stktable_data_cast(ptr, std_t_ull);
+					break;
+				case STD_T_FRQP:
+					val = read_freq_ctr_period(&stktable_data_cast(ptr, std_t_frqp),
+							           t->data_arg[filter[i].type].u);
+					break;
+				default:
+					continue;
+					break;
+				}
 
-			op = filter[i].op;
+				op = filter[i].op;
 
-			if ((val < filter[i].val && (op == STD_OP_EQ || op == STD_OP_GT || op == STD_OP_GE)) ||
-			    (val == filter[i].val && (op == STD_OP_NE || op == STD_OP_GT || op == STD_OP_LT)) ||
-			    (val > filter[i].val && (op == STD_OP_EQ || op == STD_OP_LT || op == STD_OP_LE))) {
-				skip_entry = 1;
-				break;
+				if ((val < filter[i].val && (op == STD_OP_EQ || op == STD_OP_GT || op == STD_OP_GE)) ||
+				    (val == filter[i].val && (op == STD_OP_NE || op == STD_OP_GT || op == STD_OP_LT)) ||
+				    (val > filter[i].val && (op == STD_OP_EQ || op == STD_OP_LT || op == STD_OP_LE))) {
+					skip_entry = 1;
+					break;
+				}
 			}
-		}
 
-		if (skip_entry) {
-			HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &t->lock);
-			ts->ref_cnt--;
-			continue;
-		}
+			if (skip_entry) {
+				HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
+				HA_ATOMIC_DEC(&ts->ref_cnt);
+				continue;
+			}
 
-		if (t->type == SMP_T_IPV4) {
-			char addr[INET_ADDRSTRLEN];
-			inet_ntop(AF_INET, (const void *)&ts->key.key, addr, sizeof(addr));
-			lua_pushstring(L, addr);
-		} else if (t->type == SMP_T_IPV6) {
-			char addr[INET6_ADDRSTRLEN];
-			inet_ntop(AF_INET6, (const void *)&ts->key.key, addr, sizeof(addr));
-			lua_pushstring(L, addr);
-		} else if (t->type == SMP_T_SINT) {
-			lua_pushinteger(L, *ts->key.key);
-		} else if (t->type == SMP_T_STR) {
-			lua_pushstring(L, (const char *)ts->key.key);
-		} else {
-			return hlua_error(L, "Unsupported stick table key type");
-		}
+			if (t->type == SMP_T_IPV4) {
+				char addr[INET_ADDRSTRLEN];
+				inet_ntop(AF_INET, (const void *)&ts->key.key, addr, sizeof(addr));
+				lua_pushstring(L, addr);
+			} else if (t->type == SMP_T_IPV6) {
+				char addr[INET6_ADDRSTRLEN];
+				inet_ntop(AF_INET6, (const void *)&ts->key.key, addr, sizeof(addr));
+				lua_pushstring(L, addr);
+			} else if (t->type == SMP_T_SINT) {
+				lua_pushinteger(L, *ts->key.key);
+			} else if (t->type == SMP_T_STR) {
+				lua_pushstring(L, (const char *)ts->key.key);
+			} else {
+				HA_ATOMIC_DEC(&ts->ref_cnt);
+				return hlua_error(L, "Unsupported stick table key type");
+			}
 
-		lua_newtable(L);
-		hlua_stktable_entry(L, t, ts);
-		lua_settable(L, -3);
-		HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &t->lock);
-		ts->ref_cnt--;
+			lua_newtable(L);
+			hlua_stktable_entry(L, t, ts);
+			lua_settable(L, -3);
+			HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
+			HA_ATOMIC_DEC(&ts->ref_cnt);
+		}
+		HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
 	}
-	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &t->lock);
 
 	return 1;
 }
@@ -32,6 +32,7 @@
 
 #include <import/ist.h>
 #include <haproxy/hpack-enc.h>
+#include <haproxy/hpack-tbl.h>
 #include <haproxy/http-hdr-t.h>
 
 /*
@@ -138,6 +139,58 @@ const signed short hpack_pos_len[32] = {
          /*   24: */   -1,  609,   -1,  636,   -1,   -1,   -1,   -1,
 };
 
+/* Returns the index of the first entry of the static table whose name is <n>,
+ * or 0 if not found.
+ */
+static inline int hpack_find_static_name(const struct ist n)
+{
+	int pos;
+
+	if (n.len >= sizeof(hpack_pos_len) / sizeof(hpack_pos_len[0]))
+		return 0;
+
+	pos = hpack_pos_len[n.len];
+	if (pos < 0)
+		return 0;
+
+	/* At least one header field of this length exist */
+	do {
+		unsigned char idx;
+
+		pos++;
+		idx = hpack_enc_stream[pos++];
+		pos += n.len;
+		if (isteq(ist2(&hpack_enc_stream[pos - n.len], n.len), n))
+			return idx;
+	} while ((unsigned char)hpack_enc_stream[pos] == n.len);
+	return 0;
+}
+
+/* Returns non-zero if header field <n> is worth being indexed in the dynamic
+ * table. Header fields whose values almost always differ between two
+ * responses would only evict more useful entries.
+ */
+static inline int hpack_may_index(const struct ist n)
+{
+	switch (n.len) {
+	case 3:
+		return !isteq(n, ist("age"));
+	case 4:
+		return !isteq(n, ist("date")) && !isteq(n, ist("etag"));
+	case 7:
+		return !isteq(n, ist("expires"));
+	case 8:
+		return !isteq(n, ist("location"));
+	case 10:
+		return !isteq(n, ist("set-cookie"));
+	case 13:
+		return !isteq(n, ist("last-modified")) && !isteq(n, ist("content-range"));
+	case 14:
+		return !isteq(n, ist("content-length"));
+	}
+	return 1;
+}
+
 /* Tries to encode header whose name is <n> and value <v> into the chunk <out>.
  * Returns non-zero on success, 0 on failure (buffer full).
  */
@@ -146,35 +199,21 @@ int hpack_encode_header(struct buffer *out, const struct ist n,
 {
 	int len = out->data;
 	int size = out->size;
-	int pos;
+	int idx;
 
 	if (len >= size)
 		return 0;
 
 	/* look for the header field <n> in the static table */
-	if (n.len >= sizeof(hpack_pos_len) / sizeof(hpack_pos_len[0]))
-		goto make_literal;
-
-	pos = hpack_pos_len[n.len];
-	if (pos >= 0) {
-		/* At least one header field of this length exist */
-		do {
-			char idx;
-
-			pos++;
-			idx = hpack_enc_stream[pos++];
-			pos += n.len;
-			if (isteq(ist2(&hpack_enc_stream[pos - n.len], n.len), n)) {
-				/* emit literal with indexing (7541#6.2.1) :
-				 * [ 0 | 1 | Index (6+) ]
-				 */
-				out->area[len++] = idx | 0x40;
-				goto emit_value;
-			}
-		} while ((unsigned char)hpack_enc_stream[pos] == n.len);
+	idx = hpack_find_static_name(n);
+	if (idx) {
+		/* emit literal with indexing (7541#6.2.1) :
+		 * [ 0 | 1 | Index (6+) ]
+		 */
+		out->area[len++] = idx | 0x40;
+		goto emit_value;
 	}
 
- make_literal:
 	if (likely(n.len < 127 && len + 2 + n.len <= size)) {
 		out->area[len++] = 0x00;      /* literal without indexing -- new name */
 		out->area[len++] = n.len;     /* single-byte length encoding */
@@ -208,3 +247,98 @@ int hpack_encode_header(struct buffer *out, const struct ist n,
 	out->data = len;
 	return 1;
 }
+
+/* Tries to encode header whose name is <n> and value <v> into the chunk <out>,
+ * using and updating the encoder's dynamic headers table <dht>, which must
+ * exactly reflect the peer's decoding table. Fields fully present in one of
+ * the tables are emitted as an index. Other ones are emitted as literals,
+ * reusing an indexed name when possible, and are inserted into the dynamic
+ * table unless they're not worth it. Returns 1 on success, 0 if the buffer is
+ * full, in which case the table is left untouched, or -1 if the table could
+ * not be updated. In this last case nothing was emitted but the table may
+ * have lost some entries, so it is not usable anymore until the peer is told
+ * to flush its own table.
+ */
+int hpack_encode_header_dht(struct buffer *out, struct hpack_dht *dht,
+			    const struct ist n, const struct ist v)
+{
+	const struct hpack_dte *dte;
+	int len = out->data;
+	int size = out->size;
+	uint32_t idx, nidx;
+	unsigned int slot;
+	int i, indexing;
+
+	/* look for a full match in the static table, then in the dynamic
+	 * one, and note the first matching name on the way.
+	 */
+	nidx = hpack_find_static_name(n);
+	for (idx = nidx; idx && idx < HPACK_SHT_SIZE && isteq(hpack_sht[idx].n, n); idx++) {
+		if (isteq(hpack_sht[idx].v, v))
+			goto emit_indexed;
+	}
+
+	/* the entries are visited from the most recent one (index 62) */
+	for (i = 1, slot = dht->head; i <= dht->used; i++, slot = (slot ? slot : dht->wrap) - 1) {
+		dte = &dht->dte[slot];
+		if (dte->nlen != n.len || !isteq(hpack_get_name(dht, dte), n))
+			continue;
+
+		idx = HPACK_SHT_SIZE - 1 + i;
+		if (dte->vlen == v.len && isteq(hpack_get_value(dht, dte), v))
+			goto emit_indexed;
+		if (!nidx)
+			nidx = idx;
+	}
+
+	if (!hpack_len_to_bytes(n.len) || !hpack_len_to_bytes(v.len))
+		return 0;
+
+	/* the index takes at most 3 bytes since the table cannot be larger
+	 * than 64kB, hence cannot hold more than 2048 entries.
+	 */
+	if (len + 3 + (nidx ? 0 : hpack_len_to_bytes(n.len) + n.len) +
+	    hpack_len_to_bytes(v.len) + v.len > size)
+		return 0;
+
+	/* The field is only inserted if it doesn't empty the table */
+	indexing = n.len + v.len + 32 <= dht->size && hpack_may_index(n);
+	if (indexing && hpack_dht_insert(dht, n, v) < 0)
+		return -1;
+
+	if (indexing || (!dht->used && n.len + v.len + 32 > dht->size)) {
+		/* literal with incremental indexing (7541#6.2.1), which is
+		 * also used when the table is empty and the field does not
+		 * fit since nothing changes then and the index is shorter :
+		 * [ 0 | 1 | Index (6+) ]
+		 */
+		len = hpack_encode_int(out->area, len, 0x40, 6, nidx);
+	}
+	else {
+		/* literal without indexing (7541#6.2.2) :
+		 * [ 0 | 0 | 0 | 0 | Index (4+) ]
+		 */
+		len = hpack_encode_int(out->area, len, 0x00, 4, nidx);
+	}
+
+	if (!nidx) {
+		len = hpack_encode_len(out->area, len, n.len);
+		ist2bin(out->area + len, n);
+		len += n.len;
+	}
+
+	len = hpack_encode_len(out->area, len, v.len);
+	memcpy(out->area + len, v.ptr, v.len);
+	len += v.len;
+
+	out->data = len;
+	return 1;
+
+ emit_indexed:
+	/* indexed header field (7541#6.1) : [ 1 | Index (7+) ] */
+	if (len + 3 > size)
+		return 0;
+
+	out->data = hpack_encode_int(out->area, len, 0x80, 7, idx);
+	return 1;
+}
@@ -628,7 +628,7 @@ uint8_t rht_bit15_11_11_4[256] = {
 	/* 0x1f */ 0xac,
 
 	/* part used for bits 11-4 for 0xf600 (0x60-0xff) */
-	/* 0x60 */ 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7,
+	[0x60] = 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7,
 	/* 0x68 */ 0xcf, 0xcf, 0xcf, 0xcf, 0xcf, 0xcf, 0xcf, 0xcf,
 	/* 0x70 */ 0xea, 0xea, 0xea, 0xea, 0xea, 0xea, 0xea, 0xea,
 	/* 0x78 */ 0xeb, 0xeb, 0xeb, 0xeb, 0xeb, 0xeb, 0xeb, 0xeb,
@@ -699,6 +699,530 @@ uint8_t rht_bit15_11_11_4[256] = {
 	/* Note, for [0xff], l==30 and bits 2..3 give 00:0x0a, 01:0x0d, 10:0x16, 11:EOS */
 };
 
+/* Multi-symbol decoding table, generated by dev/hpack/gen-mst.c. It is indexed
+ * on bits 31..20 of the code being looked up, and each entry describes the one
+ * or two symbols whose codes entirely fit in these 12 bits, which covers all
+ * the printable characters commonly found in header names and values :
+ *   - bits 7..0   : first symbol
+ *   - bits 15..8  : second symbol
+ *   - bits 19..16 : length of the first code, 0 if longer than 12 bits
+ *   - bits 23..20 : length of the second code, 0 if there is no second symbol
+ */
+static const uint32_t huff_mst[4096] = {
+	/* 0x000 */ 0x553030, 0x553030, 0x553030, 0x553030, 0x553130, 0x553130, 0x553130, 0x553130,
+	/* 0x008 */ 0x553230, 0x553230, 0x553230, 0x553230, 0x556130, 0x556130, 0x556130, 0x556130,
+	/* 0x010 */ 0x556330, 0x556330, 0x556330, 0x556330, 0x556530, 0x556530, 0x556530, 0x556530,
+	/* 0x018 */ 0x556930, 0x556930, 0x556930, 0x556930, 0x556f30, 0x556f30, 0x556f30, 0x556f30,
+	/* 0x020 */ 0x557330, 0x557330, 0x557330, 0x557330, 0x557430, 0x557430, 0x557430, 0x557430,
+	/* 0x028 */ 0x652030, 0x652030, 0x652530, 0x652530, 0x652d30, 0x652d30, 0x652e30, 0x652e30,
+	/* 0x030 */ 0x652f30, 0x652f30, 0x653330, 0x653330, 0x653430, 0x653430, 0x653530, 0x653530,
+	/* 0x038 */ 0x653630, 0x653630, 0x653730, 0x653730, 0x653830, 0x653830, 0x653930, 0x653930,
+	/* 0x040 */ 0x653d30, 0x653d30, 0x654130, 0x654130, 0x655f30, 0x655f30, 0x656230, 0x656230,
+	/* 0x048 */ 0x656430, 0x656430, 0x656630, 0x656630, 0x656730, 0x656730, 0x656830, 0x656830,
+	/* 0x050 */ 0x656c30, 0x656c30, 0x656d30, 0x656d30, 0x656e30, 0x656e30, 0x657030, 0x657030,
+	/* 0x058 */ 0x657230, 0x657230, 0x657530, 0x657530, 0x753a30, 0x754230, 0x754330, 0x754430,
+	/* 0x060 */ 0x754530, 0x754630, 0x754730, 0x754830, 0x754930, 0x754a30, 0x754b30, 0x754c30,
+	/* 0x068 */ 0x754d30, 0x754e30, 0x754f30, 0x755030, 0x755130, 0x755230, 0x755330, 0x755430,
+	/* 0x070 */ 0x755530, 0x755630, 0x755730, 0x755930, 0x756a30, 0x756b30, 0x757130, 0x757630,
+	/* 0x078 */ 0x757730, 0x757830, 0x757930, 0x757a30, 0x050030, 0x050030, 0x050030, 0x050030,
+	/* 0x080 */ 0x553031, 0x553031, 0x553031, 0x553031, 0x553131, 0x553131, 0x553131, 0x553131,
+	/* 0x088 */ 0x553231, 0x553231, 0x553231, 0x553231, 0x556131, 0x556131, 0x556131, 0x556131,
+	/* 0x090 */ 0x556331, 0x556331, 0x556331, 0x556331, 0x556531, 0x556531, 0x556531, 0x556531,
+	/* 0x098 */ 0x556931, 0x556931, 0x556931, 0x556931, 0x556f31, 0x556f31, 0x556f31, 0x556f31,
+	/* 0x0a0 */ 0x557331, 0x557331, 0x557331, 0x557331, 0x557431, 0x557431, 0x557431, 0x557431,
+	/* 0x0a8 */ 0x652031, 0x652031, 0x652531, 0x652531, 0x652d31, 0x652d31, 0x652e31, 0x652e31,
+	/* 0x0b0 */ 0x652f31, 0x652f31, 0x653331, 0x653331, 0x653431, 0x653431, 0x653531, 0x653531,
+	/* 0x0b8 */ 0x653631, 0x653631, 0x653731, 0x653731, 0x653831, 0x653831, 0x653931, 0x653931,
+	/* 0x0c0 */ 0x653d31, 0x653d31, 0x654131, 0x654131, 0x655f31, 0x655f31, 0x656231, 0x656231,
+	/* 0x0c8 */ 0x656431, 0x656431, 0x656631, 0x656631, 0x656731, 0x656731, 0x656831, 0x656831,
+	/* 0x0d0 */ 0x656c31, 0x656c31, 0x656d31, 0x656d31, 0x656e31, 0x656e31, 0x657031, 0x657031,
+	/* 0x0d8 */ 0x657231, 0x657231, 0x657531, 0x657531, 0x753a31, 0x754231, 0x754331, 0x754431,
+	/* 0x0e0 */ 0x754531, 0x754631, 0x754731, 0x754831, 0x754931, 0x754a31, 0x754b31, 0x754c31,
+	/* 0x0e8 */ 0x754d31, 0x754e31, 0x754f31, 0x755031, 0x755131, 0x755231, 0x755331, 0x755431,
+	/* 0x0f0 */ 0x755531, 0x755631, 0x755731, 0x755931, 0x756a31, 0x756b31, 0x757131, 0x757631,
+	/* 0x0f8 */ 0x757731, 0x757831, 0x757931, 0x757a31, 0x050031, 0x050031, 0x050031, 0x050031,
+	/* 0x100 */ 0x553032, 0x553032, 0x553032, 0x553032, 0x553132, 0x553132, 0x553132, 0x553132,
+	/* 0x108 */ 0x553232, 0x553232, 0x553232, 0x553232, 0x556132, 0x556132, 0x556132, 0x556132,
+	/* 0x110 */ 0x556332, 0x556332, 0x556332, 0x556332, 0x556532, 0x556532, 0x556532, 0x556532,
+	/* 0x118 */ 0x556932, 0x556932, 0x556932, 0x556932, 0x556f32, 0x556f32, 0x556f32, 0x556f32,
+	/* 0x120 */ 0x557332, 0x557332, 0x557332, 0x557332, 0x557432, 0x557432, 0x557432, 0x557432,
+	/* 0x128 */ 0x652032, 0x652032, 0x652532, 0x652532, 0x652d32, 0x652d32, 0x652e32, 0x652e32,
+	/* 0x130 */ 0x652f32, 0x652f32, 0x653332, 0x653332, 0x653432, 0x653432, 0x653532, 0x653532,
+	/* 0x138 */ 0x653632, 0x653632, 0x653732, 0x653732, 0x653832, 0x653832, 0x653932, 0x653932,
+	/* 0x140 */ 0x653d32, 0x653d32, 0x654132, 0x654132, 0x655f32, 0x655f32, 0x656232, 0x656232,
+	/* 0x148 */ 0x656432, 0x656432, 0x656632, 0x656632, 0x656732, 0x656732, 0x656832, 0x656832,
+	/* 0x150 */ 0x656c32, 0x656c32, 0x656d32, 0x656d32, 0x656e32, 0x656e32, 0x657032, 0x657032,
+	/* 0x158 */ 0x657232, 0x657232, 0x657532, 0x657532, 0x753a32, 0x754232, 0x754332, 0x754432,
+	/* 0x160 */ 0x754532, 0x754632, 0x754732, 0x754832, 0x754932, 0x754a32, 0x754b32, 0x754c32,
+	/* 0x168 */ 0x754d32, 0x754e32, 0x754f32, 0x755032, 0x755132, 0x755232, 0x755332, 0x755432,
+	/* 0x170 */ 0x755532, 0x755632, 0x755732, 0x755932, 0x756a32, 0x756b32, 0x757132, 0x757632,
+	/* 0x178 */ 0x757732, 0x757832, 0x757932, 0x757a32, 0x050032, 0x050032, 0x050032, 0x050032,
+	/* 0x180 */ 0x553061, 0x553061, 0x553061, 0x553061, 0x553161, 0x553161, 0x553161, 0x553161,
+	/* 0x188 */ 0x553261, 0x553261, 0x553261, 0x553261, 0x556161, 0x556161, 0x556161, 0x556161,
+	/* 0x190 */ 0x556361, 0x556361, 0x556361, 0x556361, 0x556561, 0x556561, 0x556561, 0x556561,
+	/* 0x198 */ 0x556961, 0x556961, 0x556961, 0x556961, 0x556f61, 0x556f61, 0x556f61, 0x556f61,
+	/* 0x1a0 */ 0x557361, 0x557361, 0x557361, 0x557361, 0x557461, 0x557461, 0x557461, 0x557461,
+	/* 0x1a8 */ 0x652061, 0x652061, 0x652561, 0x652561, 0x652d61, 0x652d61, 0x652e61, 0x652e61,
+	/* 0x1b0 */ 0x652f61, 0x652f61, 0x653361, 0x653361, 0x653461, 0x653461, 0x653561, 0x653561,
+	/* 0x1b8 */ 0x653661, 0x653661, 0x653761, 0x653761, 0x653861, 0x653861, 0x653961, 0x653961,
+	/* 0x1c0 */ 0x653d61, 0x653d61, 0x654161, 0x654161, 0x655f61, 0x655f61, 0x656261, 0x656261,
+	/* 0x1c8 */ 0x656461, 0x656461, 0x656661, 0x656661, 0x656761, 0x656761, 0x656861, 0x656861,
+	/* 0x1d0 */ 0x656c61, 0x656c61, 0x656d61, 0x656d61, 0x656e61, 0x656e61, 0x657061, 0x657061,
+	/* 0x1d8 */ 0x657261, 0x657261, 0x657561, 0x657561, 0x753a61, 0x754261, 0x754361, 0x754461,
+	/* 0x1e0 */ 0x754561, 0x754661, 0x754761, 0x754861, 0x754961, 0x754a61, 0x754b61, 0x754c61,
+	/* 0x1e8 */ 0x754d61, 0x754e61, 0x754f61, 0x755061, 0x755161, 0x755261, 0x755361, 0x755461,
+	/* 0x1f0 */ 0x755561, 0x755661, 0x755761, 0x755961, 0x756a61, 0x756b61, 0x757161, 0x757661,
+	/* 0x1f8 */ 0x757761, 0x757861, 0x757961, 0x757a61, 0x050061, 0x050061, 0x050061, 0x050061,
+	/* 0x200 */ 0x553063, 0x553063, 0x553063, 0x553063, 0x553163, 0x553163, 0x553163, 0x553163,
+	/* 0x208 */ 0x553263, 0x553263, 0x553263, 0x553263, 0x556163, 0x556163, 0x556163, 0x556163,
+	/* 0x210 */ 0x556363, 0x556363, 0x556363, 0x556363, 0x556563, 0x556563, 0x556563, 0x556563,
+	/* 0x218 */ 0x556963, 0x556963, 0x556963, 0x556963, 0x556f63, 0x556f63, 0x556f63, 0x556f63,
+	/* 0x220 */ 0x557363, 0x557363, 0x557363, 0x557363, 0x557463, 0x557463, 0x557463, 0x557463,
+	/* 0x228 */ 0x652063, 0x652063, 0x652563, 0x652563, 0x652d63, 0x652d63, 0x652e63, 0x652e63,
+	/* 0x230 */ 0x652f63, 0x652f63, 0x653363, 0x653363, 0x653463, 0x653463, 0x653563, 0x653563,
+	/* 0x238 */ 0x653663, 0x653663, 0x653763, 0x653763, 0x653863, 0x653863, 0x653963, 0x653963,
+	/* 0x240 */ 0x653d63, 0x653d63, 0x654163, 0x654163, 0x655f63, 0x655f63, 0x656263, 0x656263,
+	/* 0x248 */ 0x656463, 0x656463, 0x656663, 0x656663, 0x656763, 0x656763, 0x656863, 0x656863,
+	/* 0x250 */ 0x656c63, 0x656c63, 0x656d63, 0x656d63, 0x656e63, 0x656e63, 0x657063, 0x657063,
+	/* 0x258 */ 0x657263, 0x657263, 0x657563, 0x657563, 0x753a63, 0x754263, 0x754363, 0x754463,
+	/* 0x260 */ 0x754563, 0x754663, 0x754763, 0x754863, 0x754963, 0x754a63, 0x754b63, 0x754c63,
+	/* 0x268 */ 0x754d63, 0x754e63, 0x754f63, 0x755063, 0x755163, 0x755263, 0x755363, 0x755463,
+	/* 0x270 */ 0x755563, 0x755663, 0x755763, 0x755963, 0x756a63, 0x756b63, 0x757163, 0x757663,
+	/* 0x278 */ 0x757763, 0x757863, 0x757963, 0x757a63, 0x050063, 0x050063, 0x050063, 0x050063,
+	/* 0x280 */ 0x553065, 0x553065, 0x553065, 0x553065, 0x553165, 0x553165, 0x553165, 0x553165,
+	/* 0x288 */ 0x553265, 0x553265, 0x553265, 0x553265, 0x556165, 0x556165, 0x556165, 0x556165,
+	/* 0x290 */ 0x556365, 0x556365, 0x556365, 0x556365, 0x556565, 0x556565, 0x556565, 0x556565,
+	/* 0x298 */ 0x556965, 0x556965, 0x556965, 0x556965, 0x556f65, 0x556f65, 0x556f65, 0x556f65,
+	/* 0x2a0 */ 0x557365, 0x557365, 0x557365, 0x557365, 0x557465, 0x557465, 0x557465, 0x557465,
+	/* 0x2a8 */ 0x652065, 0x652065, 0x652565, 0x652565, 0x652d65, 0x652d65, 0x652e65, 0x652e65,
+	/* 0x2b0 */ 0x652f65, 0x652f65, 0x653365, 0x653365, 0x653465, 0x653465, 0x653565, 0x653565,
+	/* 0x2b8 */ 0x653665, 0x653665, 0x653765, 0x653765, 0x653865, 0x653865, 0x653965, 0x653965,
+	/* 0x2c0 */ 0x653d65, 0x653d65, 0x654165, 0x654165, 0x655f65, 0x655f65, 0x656265, 0x656265,
+	/* 0x2c8 */ 0x656465, 0x656465, 0x656665, 0x656665, 0x656765, 0x656765, 0x656865, 0x656865,
+	/* 0x2d0 */ 0x656c65, 0x656c65, 0x656d65, 0x656d65, 0x656e65, 0x656e65, 0x657065, 0x657065,
+	/* 0x2d8 */ 0x657265, 0x657265, 0x657565, 0x657565, 0x753a65, 0x754265, 0x754365, 0x754465,
+	/* 0x2e0 */ 0x754565, 0x754665, 0x754765, 0x754865, 0x754965, 0x754a65, 0x754b65, 0x754c65,
+	/* 0x2e8 */ 0x754d65, 0x754e65, 0x754f65, 0x755065, 0x755165, 0x755265, 0x755365, 0x755465,
+	/* 0x2f0 */ 0x755565, 0x755665, 0x755765, 0x755965, 0x756a65, 0x756b65, 0x757165, 0x757665,
+	/* 0x2f8 */ 0x757765, 0x757865, 0x757965, 0x757a65, 0x050065, 0x050065, 0x050065, 0x050065,
+	/* 0x300 */ 0x553069, 0x553069, 0x553069, 0x553069, 0x553169, 0x553169, 0x553169, 0x553169,
+	/* 0x308 */ 0x553269, 0x553269, 0x553269, 0x553269, 0x556169, 0x556169, 0x556169, 0x556169,
+	/* 0x310 */ 0x556369, 0x556369, 0x556369, 0x556369, 0x556569, 0x556569, 0x556569, 0x556569,
+	/* 0x318 */ 0x556969, 0x556969, 0x556969, 0x556969, 0x556f69, 0x556f69, 0x556f69, 0x556f69,
+	/* 0x320 */ 0x557369, 0x557369, 0x557369, 0x557369, 0x557469, 0x557469, 0x557469, 0x557469,
+	/* 0x328 */ 0x652069, 0x652069, 0x652569, 0x652569, 0x652d69, 0x652d69, 0x652e69, 0x652e69,
+	/* 0x330 */ 0x652f69, 0x652f69, 0x653369, 0x653369, 0x653469, 0x653469, 0x653569, 0x653569,
+	/* 0x338 */ 0x653669, 0x653669, 0x653769, 0x653769, 0x653869, 0x653869, 0x653969, 0x653969,
+	/* 0x340 */ 0x653d69, 0x653d69, 0x654169, 0x654169, 0x655f69, 0x655f69, 0x656269, 0x656269,
+	/* 0x348 */ 0x656469, 0x656469, 0x656669, 0x656669, 0x656769, 0x656769, 0x656869, 0x656869,
+	/* 0x350 */ 0x656c69, 0x656c69, 0x656d69, 0x656d69, 0x656e69, 0x656e69, 0x657069, 0x657069,
+	/* 0x358 */ 0x657269, 0x657269, 0x657569, 0x657569, 0x753a69, 0x754269, 0x754369, 0x754469,
+	/* 0x360 */ 0x754569, 0x754669, 0x754769, 0x754869, 0x754969, 0x754a69, 0x754b69, 0x754c69,
+	/* 0x368 */ 0x754d69, 0x754e69, 0x754f69, 0x755069, 0x755169, 0x755269, 0x755369, 0x755469,
+	/* 0x370 */ 0x755569, 0x755669, 0x755769, 0x755969, 0x756a69, 0x756b69, 0x757169, 0x757669,
+	/* 0x378 */ 0x757769, 0x757869, 0x757969, 0x757a69, 0x050069, 0x050069, 0x050069, 0x050069,
+	/* 0x380 */ 0x55306f, 0x55306f, 0x55306f, 0x55306f, 0x55316f, 0x55316f, 0x55316f, 0x55316f,
+	/* 0x388 */ 0x55326f, 0x55326f, 0x55326f, 0x55326f, 0x55616f, 0x55616f, 0x55616f, 0x55616f,
+	/* 0x390 */ 0x55636f, 0x55636f, 0x55636f, 0x55636f, 0x55656f, 0x55656f, 0x55656f, 0x55656f,
+	/* 0x398 */ 0x55696f, 0x55696f, 0x55696f, 0x55696f, 0x556f6f, 0x556f6f, 0x556f6f, 0x556f6f,
+	/* 0x3a0 */ 0x55736f, 0x55736f, 0x55736f, 0x55736f, 0x55746f, 0x55746f, 0x55746f, 0x55746f,
+	/* 0x3a8 */ 0x65206f, 0x65206f, 0x65256f, 0x65256f, 0x652d6f, 0x652d6f, 0x652e6f, 0x652e6f,
+	/* 0x3b0 */ 0x652f6f, 0x652f6f, 0x65336f, 0x65336f, 0x65346f, 0x65346f, 0x65356f, 0x65356f,
+	/* 0x3b8 */ 0x65366f, 0x65366f, 0x65376f, 0x65376f, 0x65386f, 0x65386f, 0x65396f, 0x65396f,
+	/* 0x3c0 */ 0x653d6f, 0x653d6f, 0x65416f, 0x65416f, 0x655f6f, 0x655f6f, 0x65626f, 0x65626f,
+	/* 0x3c8 */ 0x65646f, 0x65646f, 0x65666f, 0x65666f, 0x65676f, 0x65676f, 0x65686f, 0x65686f,
+	/* 0x3d0 */ 0x656c6f, 0x656c6f, 0x656d6f, 0x656d6f, 0x656e6f, 0x656e6f, 0x65706f, 0x65706f,
+	/* 0x3d8 */ 0x65726f, 0x65726f, 0x65756f, 0x65756f, 0x753a6f, 0x75426f, 0x75436f, 0x75446f,
+	/* 0x3e0 */ 0x75456f, 0x75466f, 0x75476f, 0x75486f, 0x75496f, 0x754a6f, 0x754b6f, 0x754c6f,
+	/* 0x3e8 */ 0x754d6f, 0x754e6f, 0x754f6f, 0x75506f, 0x75516f, 0x75526f, 0x75536f, 0x75546f,
+	/* 0x3f0 */ 0x75556f, 0x75566f, 0x75576f, 0x75596f, 0x756a6f, 0x756b6f, 0x75716f, 0x75766f,
+	/* 0x3f8 */ 0x75776f, 0x75786f, 0x75796f, 0x757a6f, 0x05006f, 0x05006f, 0x05006f, 0x05006f,
+	/* 0x400 */ 0x553073, 0x553073, 0x553073, 0x553073, 0x553173, 0x553173, 0x553173, 0x553173,
+	/* 0x408 */ 0x553273, 0x553273, 0x553273, 0x553273, 0x556173, 0x556173, 0x556173, 0x556173,
+	/* 0x410 */ 0x556373, 0x556373, 0x556373, 0x556373, 0x556573, 0x556573, 0x556573, 0x556573,
+	/* 0x418 */ 0x556973, 0x556973, 0x556973, 0x556973, 0x556f73, 0x556f73, 0x556f73, 0x556f73,
+	/* 0x420 */ 0x557373, 0x557373, 0x557373, 0x557373, 0x557473, 0x557473, 0x557473, 0x557473,
+	/* 0x428 */ 0x652073, 0x652073, 0x652573, 0x652573, 0x652d73, 0x652d73, 0x652e73, 0x652e73,
+	/* 0x430 */ 0x652f73, 0x652f73, 0x653373, 0x653373, 0x653473, 0x653473, 0x653573, 0x653573,
+	/* 0x438 */ 0x653673, 0x653673, 0x653773, 0x653773, 0x653873, 0x653873, 0x653973, 0x653973,
+	/* 0x440 */ 0x653d73, 0x653d73, 0x654173, 0x654173, 0x655f73, 0x655f73, 0x656273, 0x656273,
+	/* 0x448 */ 0x656473, 0x656473, 0x656673, 0x656673, 0x656773, 0x656773, 0x656873, 0x656873,
+	/* 0x450 */ 0x656c73, 0x656c73, 0x656d73, 0x656d73, 0x656e73, 0x656e73, 0x657073, 0x657073,
+	/* 0x458 */ 0x657273, 0x657273, 0x657573, 0x657573, 0x753a73, 0x754273, 0x754373, 0x754473,
+	/* 0x460 */ 0x754573, 0x754673, 0x754773, 0x754873, 0x754973, 0x754a73, 0x754b73, 0x754c73,
+	/* 0x468 */ 0x754d73, 0x754e73, 0x754f73, 0x755073, 0x755173, 0x755273, 0x755373, 0x755473,
+	/* 0x470 */ 0x755573, 0x755673, 0x755773, 0x755973, 0x756a73, 0x756b73, 0x757173, 0x757673,
+	/* 0x478 */ 0x757773, 0x757873, 0x757973, 0x757a73, 0x050073, 0x050073, 0x050073, 0x050073,
+	/* 0x480 */ 0x553074, 0x553074, 0x553074, 0x553074, 0x553174, 0x553174, 0x553174, 0x553174,
+	/* 0x488 */ 0x553274, 0x553274, 0x553274, 0x553274, 0x556174, 0x556174, 0x556174, 0x556174,
+	/* 0x490 */ 0x556374, 0x556374, 0x556374, 0x556374, 0x556574, 0x556574, 0x556574, 0x556574,
+	/* 0x498 */ 0x556974, 0x556974, 0x556974, 0x556974, 0x556f74, 0x556f74, 0x556f74, 0x556f74,
+	/* 0x4a0 */ 0x557374, 0x557374, 0x557374, 0x557374, 0x557474, 0x557474, 0x557474, 0x557474,
+	/* 0x4a8 */ 0x652074, 0x652074, 0x652574, 0x652574, 0x652d74, 0x652d74, 0x652e74, 0x652e74,
+	/* 0x4b0 */ 0x652f74, 0x652f74, 0x653374, 0x653374, 0x653474, 0x653474, 0x653574, 0x653574,
+	/* 0x4b8 */ 0x653674, 0x653674, 0x653774, 0x653774, 0x653874, 0x653874, 0x653974, 0x653974,
+	/* 0x4c0 */ 0x653d74, 0x653d74, 0x654174, 0x654174, 0x655f74, 0x655f74, 0x656274, 0x656274,
+	/* 0x4c8 */ 0x656474, 0x656474, 0x656674, 0x656674, 0x656774, 0x656774, 0x656874, 0x656874,
+	/* 0x4d0 */ 0x656c74, 0x656c74, 0x656d74, 0x656d74, 0x656e74, 0x656e74, 0x657074, 0x657074,
+	/* 0x4d8 */ 0x657274, 0x657274, 0x657574, 0x657574, 0x753a74, 0x754274, 0x754374, 0x754474,
+	/* 0x4e0 */ 0x754574, 0x754674, 0x754774, 0x754874, 0x754974, 0x754a74, 0x754b74, 0x754c74,
+	/* 0x4e8 */ 0x754d74, 0x754e74, 0x754f74, 0x755074, 0x755174, 0x755274, 0x755374, 0x755474,
+	/* 0x4f0 */ 0x755574, 0x755674, 0x755774, 0x755974, 0x756a74, 0x756b74, 0x757174, 0x757674,
+	/* 0x4f8 */ 0x757774, 0x757874, 0x757974, 0x757a74, 0x050074, 0x050074, 0x050074, 0x050074,
+	/* 0x500 */ 0x563020, 0x563020, 0x563120, 0x563120, 0x563220, 0x563220, 0x566120, 0x566120,
+	/* 0x508 */ 0x566320, 0x566320, 0x566520, 0x566520, 0x566920, 0x566920, 0x566f20, 0x566f20,
+	/* 0x510 */ 0x567320, 0x567320, 0x567420, 0x567420, 0x662020, 0x662520, 0x662d20, 0x662e20,
+	/* 0x518 */ 0x662f20, 0x663320, 0x663420, 0x663520, 0x663620, 0x663720, 0x663820, 0x663920,
+	/* 0x520 */ 0x663d20, 0x664120, 0x665f20, 0x666220, 0x666420, 0x666620, 0x666720, 0x666820,
+	/* 0x528 */ 0x666c20, 0x666d20, 0x666e20, 0x667020, 0x667220, 0x667520, 0x060020, 0x060020,
+	/* 0x530 */ 0x060020, 0x060020, 0x060020, 0x060020, 0x060020, 0x060020, 0x060020, 0x060020,
+	/* 0x538 */ 0x060020, 0x060020, 0x060020, 0x060020, 0x060020, 0x060020, 0x060020, 0x060020,
+	/* 0x540 */ 0x563025, 0x563025, 0x563125, 0x563125, 0x563225, 0x563225, 0x566125, 0x566125,
+	/* 0x548 */ 0x566325, 0x566325, 0x566525, 0x566525, 0x566925, 0x566925, 0x566f25, 0x566f25,
+	/* 0x550 */ 0x567325, 0x567325, 0x567425, 0x567425, 0x662025, 0x662525, 0x662d25, 0x662e25,
+	/* 0x558 */ 0x662f25, 0x663325, 0x663425, 0x663525, 0x663625, 0x663725, 0x663825, 0x663925,
+	/* 0x560 */ 0x663d25, 0x664125, 0x665f25, 0x666225, 0x666425, 0x666625, 0x666725, 0x666825,
+	/* 0x568 */ 0x666c25, 0x666d25, 0x666e25, 0x667025, 0x667225, 0x667525, 0x060025, 0x060025,
+	/* 0x570 */ 0x060025, 0x060025, 0x060025, 0x060025, 0x060025, 0x060025, 0x060025, 0x060025,
+	/* 0x578 */ 0x060025, 0x060025, 0x060025, 0x060025, 0x060025, 0x060025, 0x060025, 0x060025,
+	/* 0x580 */ 0x56302d, 0x56302d, 0x56312d, 0x56312d, 0x56322d, 0x56322d, 0x56612d, 0x56612d,
+	/* 0x588 */ 0x56632d, 0x56632d, 0x56652d, 0x56652d, 0x56692d, 0x56692d, 0x566f2d, 0x566f2d,
+	/* 0x590 */ 0x56732d, 0x56732d, 0x56742d, 0x56742d, 0x66202d, 0x66252d, 0x662d2d, 0x662e2d,
+	/* 0x598 */ 0x662f2d, 0x66332d, 0x66342d, 0x66352d, 0x66362d, 0x66372d, 0x66382d, 0x66392d,
+	/* 0x5a0 */ 0x663d2d, 0x66412d, 0x665f2d, 0x66622d, 0x66642d, 0x66662d, 0x66672d, 0x66682d,
+	/* 0x5a8 */ 0x666c2d, 0x666d2d, 0x666e2d, 0x66702d, 0x66722d, 0x66752d, 0x06002d, 0x06002d,
+	/* 0x5b0 */ 0x06002d, 0x06002d, 0x06002d, 0x06002d, 0x06002d, 0x06002d, 0x06002d, 0x06002d,
+	/* 0x5b8 */ 0x06002d, 0x06002d, 0x06002d, 0x06002d, 0x06002d, 0x06002d, 0x06002d, 0x06002d,
+	/* 0x5c0 */ 0x56302e, 0x56302e, 0x56312e, 0x56312e, 0x56322e, 0x56322e, 0x56612e, 0x56612e,
+	/* 0x5c8 */ 0x56632e, 0x56632e, 0x56652e, 0x56652e, 0x56692e, 0x56692e, 0x566f2e, 0x566f2e,
+	/* 0x5d0 */ 0x56732e, 0x56732e, 0x56742e, 0x56742e, 0x66202e, 0x66252e, 0x662d2e, 0x662e2e,
+	/* 0x5d8 */ 0x662f2e, 0x66332e, 0x66342e, 0x66352e, 0x66362e, 0x66372e, 0x66382e, 0x66392e,
+	/* 0x5e0 */ 0x663d2e, 0x66412e, 0x665f2e, 0x66622e, 0x66642e, 0x66662e, 0x66672e, 0x66682e,
+	/* 0x5e8 */ 0x666c2e, 0x666d2e, 0x666e2e, 0x66702e, 0x66722e, 0x66752e, 0x06002e, 0x06002e,
+	/* 0x5f0 */ 0x06002e, 0x06002e, 0x06002e, 0x06002e, 0x06002e, 0x06002e, 0x06002e, 0x06002e,
+	/* 0x5f8 */ 0x06002e, 0x06002e, 0x06002e, 0x06002e, 0x06002e, 0x06002e, 0x06002e, 0x06002e,
+	/* 0x600 */ 0x56302f, 0x56302f, 0x56312f, 0x56312f, 0x56322f, 0x56322f, 0x56612f, 0x56612f,
+	/* 0x608 */ 0x56632f, 0x56632f, 0x56652f, 0x56652f, 0x56692f, 0x56692f, 0x566f2f, 0x566f2f,
+	/* 0x610 */ 0x56732f, 0x56732f, 0x56742f, 0x56742f, 0x66202f, 0x66252f, 0x662d2f, 0x662e2f,
+	/* 0x618 */ 0x662f2f, 0x66332f, 0x66342f, 0x66352f, 0x66362f, 0x66372f, 0x66382f, 0x66392f,
+	/* 0x620 */ 0x663d2f, 0x66412f, 0x665f2f, 0x66622f, 0x66642f, 0x66662f, 0x66672f, 0x66682f,
+	/* 0x628 */ 0x666c2f, 0x666d2f, 0x666e2f, 0x66702f, 0x66722f, 0x66752f, 0x06002f, 0x06002f,
+	/* 0x630 */ 0x06002f, 0x06002f, 0x06002f, 0x06002f, 0x06002f, 0x06002f, 0x06002f, 0x06002f,
+	/* 0x638 */ 0x06002f, 0x06002f, 0x06002f, 0x06002f, 0x06002f, 0x06002f, 0x06002f, 0x06002f,
+	/* 0x640 */ 0x563033, 0x563033, 0x563133, 0x563133, 0x563233, 0x563233, 0x566133, 0x566133,
+	/* 0x648 */ 0x566333, 0x566333, 0x566533, 0x566533, 0x566933, 0x566933, 0x566f33, 0x566f33,
+	/* 0x650 */ 0x567333, 0x567333, 0x567433, 0x567433, 0x662033, 0x662533, 0x662d33, 0x662e33,
+	/* 0x658 */ 0x662f33, 0x663333, 0x663433, 0x663533, 0x663633, 0x663733, 0x663833, 0x663933,
+	/* 0x660 */ 0x663d33, 0x664133, 0x665f33, 0x666233, 0x666433, 0x666633, 0x666733, 0x666833,
+	/* 0x668 */ 0x666c33, 0x666d33, 0x666e33, 0x667033, 0x667233, 0x667533, 0x060033, 0x060033,
+	/* 0x670 */ 0x060033, 0x060033, 0x060033, 0x060033, 0x060033, 0x060033, 0x060033, 0x060033,
+	/* 0x678 */ 0x060033, 0x060033, 0x060033, 0x060033, 0x060033, 0x060033, 0x060033, 0x060033,
+	/* 0x680 */ 0x563034, 0x563034, 0x563134, 0x563134, 0x563234, 0x563234, 0x566134, 0x566134,
+	/* 0x688 */ 0x566334, 0x566334, 0x566534, 0x566534, 0x566934, 0x566934, 0x566f34, 0x566f34,
+	/* 0x690 */ 0x567334, 0x567334, 0x567434, 0x567434, 0x662034, 0x662534, 0x662d34, 0x662e34,
+	/* 0x698 */ 0x662f34, 0x663334, 0x663434, 0x663534, 0x663634, 0x663734, 0x663834, 0x663934,
+	/* 0x6a0 */ 0x663d34, 0x664134, 0x665f34, 0x666234, 0x666434, 0x666634, 0x666734, 0x666834,
+	/* 0x6a8 */ 0x666c34, 0x666d34, 0x666e34, 0x667034, 0x667234, 0x667534, 0x060034, 0x060034,
+	/* 0x6b0 */ 0x060034, 0x060034, 0x060034, 0x060034, 0x060034, 0x060034, 0x060034, 0x060034,
+	/* 0x6b8 */ 0x060034, 0x060034, 0x060034, 0x060034, 0x060034, 0x060034, 0x060034, 0x060034,
+	/* 0x6c0 */ 0x563035, 0x563035, 0x563135, 0x563135, 0x563235, 0x563235, 0x566135, 0x566135,
+	/* 0x6c8 */ 0x566335, 0x566335, 0x566535, 0x566535, 0x566935, 0x566935, 0x566f35, 0x566f35,
+	/* 0x6d0 */ 0x567335, 0x567335, 0x567435, 0x567435, 0x662035, 0x662535, 0x662d35, 0x662e35,
+	/* 0x6d8 */ 0x662f35, 0x663335, 0x663435, 0x663535, 0x663635, 0x663735, 0x663835, 0x663935,
+	/* 0x6e0 */ 0x663d35, 0x664135, 0x665f35, 0x666235, 0x666435, 0x666635, 0x666735, 0x666835,
+	/* 0x6e8 */ 0x666c35, 0x666d35, 0x666e35, 0x667035, 0x667235, 0x667535, 0x060035, 0x060035,
+	/* 0x6f0 */ 0x060035, 0x060035, 0x060035, 0x060035, 0x060035, 0x060035, 0x060035, 0x060035,
+	/* 0x6f8 */ 0x060035, 0x060035, 0x060035, 0x060035, 0x060035, 0x060035, 0x060035, 0x060035,
+	/* 0x700 */ 0x563036, 0x563036, 0x563136, 0x563136, 0x563236, 0x563236, 0x566136, 0x566136,
+	/* 0x708 */ 0x566336, 0x566336, 0x566536, 0x566536, 0x566936, 0x566936, 0x566f36, 0x566f36,
+	/* 0x710 */ 0x567336, 0x567336, 0x567436, 0x567436, 0x662036, 0x662536, 0x662d36, 0x662e36,
+	/* 0x718 */ 0x662f36, 0x663336, 0x663436, 0x663536, 0x663636, 0x663736, 0x663836, 0x663936,
+	/* 0x720 */ 0x663d36, 0x664136, 0x665f36, 0x666236, 0x666436, 0x666636, 0x666736, 0x666836,
+	/* 0x728 */ 0x666c36, 0x666d36, 0x666e36, 0x667036, 0x667236, 0x667536, 0x060036, 0x060036,
+	/* 0x730 */ 0x060036, 0x060036, 0x060036, 0x060036, 0x060036, 0x060036, 0x060036, 0x060036,
+	/* 0x738 */ 0x060036, 0x060036, 0x060036, 0x060036, 0x060036, 0x060036, 0x060036, 0x060036,
+	/* 0x740 */ 0x563037, 0x563037, 0x563137, 0x563137, 0x563237, 0x563237, 0x566137, 0x566137,
+	/* 0x748 */ 0x566337, 0x566337, 0x566537, 0x566537, 0x566937, 0x566937, 0x566f37, 0x566f37,
+	/* 0x750 */ 0x567337, 0x567337, 0x567437, 0x567437, 0x662037, 0x662537, 0x662d37, 0x662e37,
+	/* 0x758 */ 0x662f37, 0x663337, 0x663437, 0x663537, 0x663637, 0x663737, 0x663837, 0x663937,
+	/* 0x760 */ 0x663d37, 0x664137, 0x665f37, 0x666237, 0x666437, 0x666637, 0x666737, 0x666837,
+	/* 0x768 */ 0x666c37, 0x666d37, 0x666e37, 0x667037, 0x667237, 0x667537, 0x060037, 0x060037,
+	/* 0x770 */ 0x060037, 0x060037, 0x060037, 0x060037, 0x060037, 0x060037, 0x060037, 0x060037,
+	/* 0x778 */ 0x060037, 0x060037, 0x060037, 0x060037, 0x060037, 0x060037, 0x060037, 0x060037,
+	/* 0x780 */ 0x563038, 0x563038, 0x563138, 0x563138, 0x563238, 0x563238, 0x566138, 0x566138,
+	/* 0x788 */ 0x566338, 0x566338, 0x566538, 0x566538, 0x566938, 0x566938, 0x566f38, 0x566f38,
+	/* 0x790 */ 0x567338, 0x567338, 0x567438, 0x567438, 0x662038, 0x662538, 0x662d38, 0x662e38,
+	/* 0x798 */ 0x662f38, 0x663338, 0x663438, 0x663538, 0x663638, 0x663738, 0x663838, 0x663938,
+	/* 0x7a0 */ 0x663d38, 0x664138, 0x665f38, 0x666238, 0x666438, 0x666638, 0x666738, 0x666838,
+	/* 0x7a8 */ 0x666c38, 0x666d38, 0x666e38, 0x667038, 0x667238, 0x667538, 0x060038, 0x060038,
+	/* 0x7b0 */ 0x060038, 0x060038, 0x060038, 0x060038, 0x060038, 0x060038, 0x060038, 0x060038,
+	/* 0x7b8 */ 0x060038, 0x060038, 0x060038, 0x060038, 0x060038, 0x060038, 0x060038, 0x060038,
+	/* 0x7c0 */ 0x563039, 0x563039, 0x563139, 0x563139, 0x563239, 0x563239, 0x566139, 0x566139,
+	/* 0x7c8 */ 0x566339, 0x566339, 0x566539, 0x566539, 0x566939, 0x566939, 0x566f39, 0x566f39,
+	/* 0x7d0 */ 0x567339, 0x567339, 0x567439, 0x567439, 0x662039, 0x662539, 0x662d39, 0x662e39,
+	/* 0x7d8 */ 0x662f39, 0x663339, 0x663439, 0x663539, 0x663639, 0x663739, 0x663839, 0x663939,
+	/* 0x7e0 */ 0x663d39, 0x664139, 0x665f39, 0x666239, 0x666439, 0x666639, 0x666739, 0x666839,
+	/* 0x7e8 */ 0x666c39, 0x666d39, 0x666e39, 0x667039, 0x667239, 0x667539, 0x060039, 0x060039,
+	/* 0x7f0 */ 0x060039, 0x060039, 0x060039, 0x060039, 0x060039, 0x060039, 0x060039, 0x060039,
+	/* 0x7f8 */ 0x060039, 0x060039, 0x060039, 0x060039, 0x060039, 0x060039, 0x060039, 0x060039,
+	/* 0x800 */ 0x56303d, 0x56303d, 0x56313d, 0x56313d, 0x56323d, 0x56323d, 0x56613d, 0x56613d,
+	/* 0x808 */ 0x56633d, 0x56633d, 0x56653d, 0x56653d, 0x56693d, 0x56693d, 0x566f3d, 0x566f3d,
+	/* 0x810 */ 0x56733d, 0x56733d, 0x56743d, 0x56743d, 0x66203d, 0x66253d, 0x662d3d, 0x662e3d,
+	/* 0x818 */ 0x662f3d, 0x66333d, 0x66343d, 0x66353d, 0x66363d, 0x66373d, 0x66383d, 0x66393d,
+	/* 0x820 */ 0x663d3d, 0x66413d, 0x665f3d, 0x66623d, 0x66643d, 0x66663d, 0x66673d, 0x66683d,
+	/* 0x828 */ 0x666c3d, 0x666d3d, 0x666e3d, 0x66703d, 0x66723d, 0x66753d, 0x06003d, 0x06003d,
+	/* 0x830 */ 0x06003d, 0x06003d, 0x06003d, 0x06003d, 0x06003d, 0x06003d, 0x06003d, 0x06003d,
+	/* 0x838 */ 0x06003d, 0x06003d, 0x06003d, 0x06003d, 0x06003d, 0x06003d, 0x06003d, 0x06003d,
+	/* 0x840 */ 0x563041, 0x563041, 0x563141, 0x563141, 0x563241, 0x563241, 0x566141, 0x566141,
+	/* 0x848 */ 0x566341, 0x566341, 0x566541, 0x566541, 0x566941, 0x566941, 0x566f41, 0x566f41,
+	/* 0x850 */ 0x567341, 0x567341, 0x567441, 0x567441, 0x662041, 0x662541, 0x662d41, 0x662e41,
+	/* 0x858 */ 0x662f41, 0x663341, 0x663441, 0x663541, 0x663641, 0x663741, 0x663841, 0x663941,
+	/* 0x860 */ 0x663d41, 0x664141, 0x665f41, 0x666241, 0x666441, 0x666641, 0x666741, 0x666841,
+	/* 0x868 */ 0x666c41, 0x666d41, 0x666e41, 0x667041, 0x667241, 0x667541, 0x060041, 0x060041,
+	/* 0x870 */ 0x060041, 0x060041, 0x060041, 0x060041, 0x060041, 0x060041, 0x060041, 0x060041,
+	/* 0x878 */ 0x060041, 0x060041, 0x060041, 0x060041, 0x060041, 0x060041, 0x060041, 0x060041,
+	/* 0x880 */ 0x56305f, 0x56305f, 0x56315f, 0x56315f, 0x56325f, 0x56325f, 0x56615f, 0x56615f,
+	/* 0x888 */ 0x56635f, 0x56635f, 0x56655f, 0x56655f, 0x56695f, 0x56695f, 0x566f5f, 0x566f5f,
+	/* 0x890 */ 0x56735f, 0x56735f, 0x56745f, 0x56745f, 0x66205f, 0x66255f, 0x662d5f, 0x662e5f,
+	/* 0x898 */ 0x662f5f, 0x66335f, 0x66345f, 0x66355f, 0x66365f, 0x66375f, 0x66385f, 0x66395f,
+	/* 0x8a0 */ 0x663d5f, 0x66415f, 0x665f5f, 0x66625f, 0x66645f, 0x66665f, 0x66675f, 0x66685f,
+	/* 0x8a8 */ 0x666c5f, 0x666d5f, 0x666e5f, 0x66705f, 0x66725f, 0x66755f, 0x06005f, 0x06005f,
+	/* 0x8b0 */ 0x06005f, 0x06005f, 0x06005f, 0x06005f, 0x06005f, 0x06005f, 0x06005f, 0x06005f,
+	/* 0x8b8 */ 0x06005f, 0x06005f, 0x06005f, 0x06005f, 0x06005f, 0x06005f, 0x06005f, 0x06005f,
+	/* 0x8c0 */ 0x563062, 0x563062, 0x563162, 0x563162, 0x563262, 0x563262, 0x566162, 0x566162,
+	/* 0x8c8 */ 0x566362, 0x566362, 0x566562, 0x566562, 0x566962, 0x566962, 0x566f62, 0x566f62,
+	/* 0x8d0 */ 0x567362, 0x567362, 0x567462, 0x567462, 0x662062, 0x662562, 0x662d62, 0x662e62,
+	/* 0x8d8 */ 0x662f62, 0x663362, 0x663462, 0x663562, 0x663662, 0x663762, 0x663862, 0x663962,
+	/* 0x8e0 */ 0x663d62, 0x664162, 0x665f62, 0x666262, 0x666462, 0x666662, 0x666762, 0x666862,
+	/* 0x8e8 */ 0x666c62, 0x666d62, 0x666e62, 0x667062, 0x667262, 0x667562, 0x060062, 0x060062,
+	/* 0x8f0 */ 0x060062, 0x060062, 0x060062, 0x060062, 0x060062, 0x060062, 0x060062, 0x060062,
+	/* 0x8f8 */ 0x060062, 0x060062, 0x060062, 0x060062, 0x060062, 0x060062, 0x060062, 0x060062,
+	/* 0x900 */ 0x563064, 0x563064, 0x563164, 0x563164, 0x563264, 0x563264, 0x566164, 0x566164,
+	/* 0x908 */ 0x566364, 0x566364, 0x566564, 0x566564, 0x566964, 0x566964, 0x566f64, 0x566f64,
+	/* 0x910 */ 0x567364, 0x567364, 0x567464, 0x567464, 0x662064, 0x662564, 0x662d64, 0x662e64,
+	/* 0x918 */ 0x662f64, 0x663364, 0x663464, 0x663564, 0x663664, 0x663764, 0x663864, 0x663964,
+	/* 0x920 */ 0x663d64, 0x664164, 0x665f64, 0x666264, 0x666464, 0x666664, 0x666764, 0x666864,
+	/* 0x928 */ 0x666c64, 0x666d64, 0x666e64, 0x667064, 0x667264, 0x667564, 0x060064, 0x060064,
+	/* 0x930 */ 0x060064, 0x060064, 0x060064, 0x060064, 0x060064, 0x060064, 0x060064, 0x060064,
+	/* 0x938 */ 0x060064, 0x060064, 0x060064, 0x060064, 0x060064, 0x060064, 0x060064, 0x060064,
+	/* 0x940 */ 0x563066, 0x563066, 0x563166, 0x563166, 0x563266, 0x563266, 0x566166, 0x566166,
+	/* 0x948 */ 0x566366, 0x566366, 0x566566, 0x566566, 0x566966, 0x566966, 0x566f66, 0x566f66,
+	/* 0x950 */ 0x567366, 0x567366, 0x567466, 0x567466, 0x662066, 0x662566, 0x662d66, 0x662e66,
+	/* 0x958 */ 0x662f66, 0x663366, 0x663466, 0x663566, 0x663666, 0x663766, 0x663866, 0x663966,
+	/* 0x960 */ 0x663d66, 0x664166, 0x665f66, 0x666266, 0x666466, 0x666666, 0x666766, 0x666866,
+	/* 0x968 */ 0x666c66, 0x666d66, 0x666e66, 0x667066, 0x667266, 0x667566, 0x060066, 0x060066,
+	/* 0x970 */ 0x060066, 0x060066, 0x060066, 0x060066, 0x060066, 0x060066, 0x060066, 0x060066,
+	/* 0x978 */ 0x060066, 0x060066, 0x060066, 0x060066, 0x060066, 0x060066, 0x060066, 0x060066,
+	/* 0x980 */ 0x563067, 0x563067, 0x563167, 0x563167, 0x563267, 0x563267, 0x566167, 0x566167,
+	/* 0x988 */ 0x566367, 0x566367, 0x566567, 0x566567, 0x566967, 0x566967, 0x566f67, 0x566f67,
+	/* 0x990 */ 0x567367, 0x567367, 0x567467, 0x567467, 0x662067, 0x662567, 0x662d67, 0x662e67,
+	/* 0x998 */ 0x662f67, 0x663367, 0x663467, 0x663567, 0x663667, 0x663767, 0x663867, 0x663967,
+	/* 0x9a0 */ 0x663d67, 0x664167, 0x665f67, 0x666267, 0x666467, 0x666667, 0x666767, 0x666867,
+	/* 0x9a8 */ 0x666c67, 0x666d67, 0x666e67, 0x667067, 0x667267, 0x667567, 0x060067, 0x060067,
+	/* 0x9b0 */ 0x060067, 0x060067, 0x060067, 0x060067, 0x060067, 0x060067, 0x060067, 0x060067,
+	/* 0x9b8 */ 0x060067, 0x060067, 0x060067, 0x060067, 0x060067, 0x060067, 0x060067, 0x060067,
+	/* 0x9c0 */ 0x563068, 0x563068, 0x563168, 0x563168, 0x563268, 0x563268, 0x566168, 0x566168,
+	/* 0x9c8 */ 0x566368, 0x566368, 0x566568, 0x566568, 0x566968, 0x566968, 0x566f68, 0x566f68,
+	/* 0x9d0 */ 0x567368, 0x567368, 0x567468, 0x567468, 0x662068, 0x662568, 0x662d68, 0x662e68,
+	/* 0x9d8 */ 0x662f68, 0x663368, 0x663468, 0x663568, 0x663668, 0x663768, 0x663868, 0x663968,
+	/* 0x9e0 */ 0x663d68, 0x664168, 0x665f68, 0x666268, 0x666468, 0x666668, 0x666768, 0x666868,
+	/* 0x9e8 */ 0x666c68, 0x666d68, 0x666e68, 0x667068, 0x667268, 0x667568, 0x060068, 0x060068,
+	/* 0x9f0 */ 0x060068, 0x060068, 0x060068, 0x060068, 0x060068, 0x060068, 0x060068, 0x060068,
+	/* 0x9f8 */ 0x060068, 0x060068, 0x060068, 0x060068, 0x060068, 0x060068, 0x060068, 0x060068,
+	/* 0xa00 */ 0x56306c, 0x56306c, 0x56316c, 0x56316c, 0x56326c, 0x56326c, 0x56616c, 0x56616c,
+	/* 0xa08 */ 0x56636c, 0x56636c, 0x56656c, 0x56656c, 0x56696c, 0x56696c, 0x566f6c, 0x566f6c,
+	/* 0xa10 */ 0x56736c, 0x56736c, 0x56746c, 0x56746c, 0x66206c, 0x66256c, 0x662d6c, 0x662e6c,
+	/* 0xa18 */ 0x662f6c, 0x66336c, 0x66346c, 0x66356c, 0x66366c, 0x66376c, 0x66386c, 0x66396c,
+	/* 0xa20 */ 0x663d6c, 0x66416c, 0x665f6c, 0x66626c, 0x66646c, 0x66666c, 0x66676c, 0x66686c,
+	/* 0xa28 */ 0x666c6c, 0x666d6c, 0x666e6c, 0x66706c, 0x66726c, 0x66756c, 0x06006c, 0x06006c,
+	/* 0xa30 */ 0x06006c, 0x06006c, 0x06006c, 0x06006c, 0x06006c, 0x06006c, 0x06006c, 0x06006c,
+	/* 0xa38 */ 0x06006c, 0x06006c, 0x06006c, 0x06006c, 0x06006c, 0x06006c, 0x06006c, 0x06006c,
+	/* 0xa40 */ 0x56306d, 0x56306d, 0x56316d, 0x56316d, 0x56326d, 0x56326d, 0x56616d, 0x56616d,
+	/* 0xa48 */ 0x56636d, 0x56636d, 0x56656d, 0x56656d, 0x56696d, 0x56696d, 0x566f6d, 0x566f6d,
+	/* 0xa50 */ 0x56736d, 0x56736d, 0x56746d, 0x56746d, 0x66206d, 0x66256d, 0x662d6d, 0x662e6d,
+	/* 0xa58 */ 0x662f6d, 0x66336d, 0x66346d, 0x66356d, 0x66366d, 0x66376d, 0x66386d, 0x66396d,
+	/* 0xa60 */ 0x663d6d, 0x66416d, 0x665f6d, 0x66626d, 0x66646d, 0x66666d, 0x66676d, 0x66686d,
+	/* 0xa68 */ 0x666c6d, 0x666d6d, 0x666e6d, 0x66706d, 0x66726d, 0x66756d, 0x06006d, 0x06006d,
+	/* 0xa70 */ 0x06006d, 0x06006d, 0x06006d, 0x06006d, 0x06006d, 0x06006d, 0x06006d, 0x06006d,
+	/* 0xa78 */ 0x06006d, 0x06006d, 0x06006d, 0x06006d, 0x06006d, 0x06006d, 0x06006d, 0x06006d,
+	/* 0xa80 */ 0x56306e, 0x56306e, 0x56316e, 0x56316e, 0x56326e, 0x56326e, 0x56616e, 0x56616e,
+	/* 0xa88 */ 0x56636e, 0x56636e, 0x56656e, 0x56656e, 0x56696e, 0x56696e, 0x566f6e, 0x566f6e,
+	/* 0xa90 */ 0x56736e, 0x56736e, 0x56746e, 0x56746e, 0x66206e, 0x66256e, 0x662d6e, 0x662e6e,
+	/* 0xa98 */ 0x662f6e, 0x66336e, 0x66346e, 0x66356e, 0x66366e, 0x66376e, 0x66386e, 0x66396e,
+	/* 0xaa0 */ 0x663d6e, 0x66416e, 0x665f6e, 0x66626e, 0x66646e, 0x66666e, 0x66676e, 0x66686e,
+	/* 0xaa8 */ 0x666c6e, 0x666d6e, 0x666e6e, 0x66706e, 0x66726e, 0x66756e, 0x06006e, 0x06006e,
+	/* 0xab0 */ 0x06006e, 0x06006e, 0x06006e, 0x06006e, 0x06006e, 0x06006e, 0x06006e, 0x06006e,
+	/* 0xab8 */ 0x06006e, 0x06006e, 0x06006e, 0x06006e, 0x06006e, 0x06006e, 0x06006e, 0x06006e,
+	/* 0xac0 */ 0x563070, 0x563070, 0x563170, 0x563170, 0x563270, 0x563270, 0x566170, 0x566170,
+	/* 0xac8 */ 0x566370, 0x566370, 0x566570, 0x566570, 0x566970, 0x566970, 0x566f70, 0x566f70,
+	/* 0xad0 */ 0x567370, 0x567370, 0x567470, 0x567470, 0x662070, 0x662570, 0x662d70, 0x662e70,
+	/* 0xad8 */ 0x662f70, 0x663370, 0x663470, 0x663570, 0x663670, 0x663770, 0x663870, 0x663970,
+	/* 0xae0 */ 0x663d70, 0x664170, 0x665f70, 0x666270, 0x666470, 0x666670, 0x666770, 0x666870,
+	/* 0xae8 */ 0x666c70, 0x666d70, 0x666e70, 0x667070, 0x667270, 0x667570, 0x060070, 0x060070,
+	/* 0xaf0 */ 0x060070, 0x060070, 0x060070, 0x060070, 0x060070, 0x060070, 0x060070, 0x060070,
+	/* 0xaf8 */ 0x060070, 0x060070, 0x060070, 0x060070, 0x060070, 0x060070, 0x060070, 0x060070,
+	/* 0xb00 */ 0x563072, 0x563072, 0x563172, 0x563172, 0x563272, 0x563272, 0x566172, 0x566172,
+	/* 0xb08 */ 0x566372, 0x566372, 0x566572, 0x566572, 0x566972, 0x566972, 0x566f72, 0x566f72,
+	/* 0xb10 */ 0x567372, 0x567372, 0x567472, 0x567472, 0x662072, 0x662572, 0x662d72, 0x662e72,
+	/* 0xb18 */ 0x662f72, 0x663372, 0x663472, 0x663572, 0x663672, 0x663772, 0x663872, 0x663972,
+	/* 0xb20 */ 0x663d72, 0x664172, 0x665f72, 0x666272, 0x666472, 0x666672, 0x666772, 0x666872,
+	/* 0xb28 */ 0x666c72, 0x666d72, 0x666e72, 0x667072, 0x667272, 0x667572, 0x060072, 0x060072,
+	/* 0xb30 */ 0x060072, 0x060072, 0x060072, 0x060072, 0x060072, 0x060072, 0x060072, 0x060072,
+	/* 0xb38 */ 0x060072, 0x060072, 0x060072, 0x060072, 0x060072, 0x060072, 0x060072, 0x060072,
+	/* 0xb40 */ 0x563075, 0x563075, 0x563175, 0x563175, 0x563275, 0x563275, 0x566175, 0x566175,
+	/* 0xb48 */ 0x566375, 0x566375, 0x566575, 0x566575, 0x566975, 0x566975, 0x566f75, 0x566f75,
+	/* 0xb50 */ 0x567375, 0x567375, 0x567475, 0x567475, 0x662075, 0x662575, 0x662d75, 0x662e75,
+	/* 0xb58 */ 0x662f75, 0x663375, 0x663475, 0x663575, 0x663675, 0x663775, 0x663875, 0x663975,
+	/* 0xb60 */ 0x663d75, 0x664175, 0x665f75, 0x666275, 0x666475, 0x666675, 0x666775, 0x666875,
+	/* 0xb68 */ 0x666c75, 0x666d75, 0x666e75, 0x667075, 0x667275, 0x667575, 0x060075, 0x060075,
+	/* 0xb70 */ 0x060075, 0x060075, 0x060075, 0x060075, 0x060075, 0x060075, 0x060075, 0x060075,
+	/* 0xb78 */ 0x060075, 0x060075, 0x060075, 0x060075, 0x060075, 0x060075, 0x060075, 0x060075,
+	/* 0xb80 */ 0x57303a, 0x57313a, 0x57323a, 0x57613a, 0x57633a, 0x57653a, 0x57693a, 0x576f3a,
+	/* 0xb88 */ 0x57733a, 0x57743a, 0x07003a, 0x07003a, 0x07003a, 0x07003a, 0x07003a, 0x07003a,
+	/* 0xb90 */ 0x07003a, 0x07003a, 0x07003a, 0x07003a, 0x07003a, 0x07003a, 0x07003a, 0x07003a,
+	/* 0xb98 */ 0x07003a, 0x07003a, 0x07003a, 0x07003a, 0x07003a, 0x07003a, 0x07003a, 0x07003a,
+	/* 0xba0 */ 0x573042, 0x573142, 0x573242, 0x576142, 0x576342, 0x576542, 0x576942, 0x576f42,
+	/* 0xba8 */ 0x577342, 0x577442, 0x070042, 0x070042, 0x070042, 0x070042, 0x070042, 0x070042,
+	/* 0xbb0 */ 0x070042, 0x070042, 0x070042, 0x070042, 0x070042, 0x070042, 0x070042, 0x070042,
+	/* 0xbb8 */ 0x070042, 0x070042, 0x070042, 0x070042, 0x070042, 0x070042, 0x070042, 0x070042,
+	/* 0xbc0 */ 0x573043, 0x573143, 0x573243, 0x576143, 0x576343, 0x576543, 0x576943, 0x576f43,
+	/* 0xbc8 */ 0x577343, 0x577443, 0x070043, 0x070043, 0x070043, 0x070043, 0x070043, 0x070043,
+	/* 0xbd0 */ 0x070043, 0x070043, 0x070043, 0x070043, 0x070043, 0x070043, 0x070043, 0x070043,
+	/* 0xbd8 */ 0x070043, 0x070043, 0x070043, 0x070043, 0x070043, 0x070043, 0x070043, 0x070043,
+	/* 0xbe0 */ 0x573044, 0x573144, 0x573244, 0x576144, 0x576344, 0x576544, 0x576944, 0x576f44,
+	/* 0xbe8 */ 0x577344, 0x577444, 0x070044, 0x070044, 0x070044, 0x070044, 0x070044, 0x070044,
+	/* 0xbf0 */ 0x070044, 0x070044, 0x070044, 0x070044, 0x070044, 0x070044, 0x070044, 0x070044,
+	/* 0xbf8 */ 0x070044, 0x070044, 0x070044, 0x070044, 0x070044, 0x070044, 0x070044, 0x070044,
+	/* 0xc00 */ 0x573045, 0x573145, 0x573245, 0x576145, 0x576345, 0x576545, 0x576945, 0x576f45,
+	/* 0xc08 */ 0x577345, 0x577445, 0x070045, 0x070045, 0x070045, 0x070045, 0x070045, 0x070045,
+	/* 0xc10 */ 0x070045, 0x070045, 0x070045, 0x070045, 0x070045, 0x070045, 0x070045, 0x070045,
+	/* 0xc18 */ 0x070045, 0x070045, 0x070045, 0x070045, 0x070045, 0x070045, 0x070045, 0x070045,
+	/* 0xc20 */ 0x573046, 0x573146, 0x573246, 0x576146, 0x576346, 0x576546, 0x576946, 0x576f46,
+	/* 0xc28 */ 0x577346, 0x577446, 0x070046, 0x070046, 0x070046, 0x070046, 0x070046, 0x070046,
+	/* 0xc30 */ 0x070046, 0x070046, 0x070046, 0x070046, 0x070046, 0x070046, 0x070046, 0x070046,
+	/* 0xc38 */ 0x070046, 0x070046, 0x070046, 0x070046, 0x070046, 0x070046, 0x070046, 0x070046,
+	/* 0xc40 */ 0x573047, 0x573147, 0x573247, 0x576147, 0x576347, 0x576547, 0x576947, 0x576f47,
+	/* 0xc48 */ 0x577347, 0x577447, 0x070047, 0x070047, 0x070047, 0x070047, 0x070047, 0x070047,
+	/* 0xc50 */ 0x070047, 0x070047, 0x070047, 0x070047, 0x070047, 0x070047, 0x070047, 0x070047,
+	/* 0xc58 */ 0x070047, 0x070047, 0x070047, 0x070047, 0x070047, 0x070047, 0x070047, 0x070047,
+	/* 0xc60 */ 0x573048, 0x573148, 0x573248, 0x576148, 0x576348, 0x576548, 0x576948, 0x576f48,
+	/* 0xc68 */ 0x577348, 0x577448, 0x070048, 0x070048, 0x070048, 0x070048, 0x070048, 0x070048,
+	/* 0xc70 */ 0x070048, 0x070048, 0x070048, 0x070048, 0x070048, 0x070048, 0x070048, 0x070048,
+	/* 0xc78 */ 0x070048, 0x070048, 0x070048, 0x070048, 0x070048, 0x070048, 0x070048, 0x070048,
+	/* 0xc80 */ 0x573049, 0x573149, 0x573249, 0x576149, 0x576349, 0x576549, 0x576949, 0x576f49,
+	/* 0xc88 */ 0x577349, 0x577449, 0x070049, 0x070049, 0x070049, 0x070049, 0x070049, 0x070049,
+	/* 0xc90 */ 0x070049, 0x070049, 0x070049, 0x070049, 0x070049, 0x070049, 0x070049, 0x070049,
+	/* 0xc98 */ 0x070049, 0x070049, 0x070049, 0x070049, 0x070049, 0x070049, 0x070049, 0x070049,
+	/* 0xca0 */ 0x57304a, 0x57314a, 0x57324a, 0x57614a, 0x57634a, 0x57654a, 0x57694a, 0x576f4a,
+	/* 0xca8 */ 0x57734a, 0x57744a, 0x07004a, 0x07004a, 0x07004a, 0x07004a, 0x07004a, 0x07004a,
+	/* 0xcb0 */ 0x07004a, 0x07004a, 0x07004a, 0x07004a, 0x07004a, 0x07004a, 0x07004a, 0x07004a,
+	/* 0xcb8 */ 0x07004a, 0x07004a, 0x07004a, 0x07004a, 0x07004a, 0x07004a, 0x07004a, 0x07004a,
+	/* 0xcc0 */ 0x57304b, 0x57314b, 0x57324b, 0x57614b, 0x57634b, 0x57654b, 0x57694b, 0x576f4b,
+	/* 0xcc8 */ 0x57734b, 0x57744b, 0x07004b, 0x07004b, 0x07004b, 0x07004b, 0x07004b, 0x07004b,
+	/* 0xcd0 */ 0x07004b, 0x07004b, 0x07004b, 0x07004b, 0x07004b, 0x07004b, 0x07004b, 0x07004b,
+	/* 0xcd8 */ 0x07004b, 0x07004b, 0x07004b, 0x07004b, 0x07004b, 0x07004b, 0x07004b, 0x07004b,
+	/* 0xce0 */ 0x57304c, 0x57314c, 0x57324c, 0x57614c, 0x57634c, 0x57654c, 0x57694c, 0x576f4c,
+	/* 0xce8 */ 0x57734c, 0x57744c, 0x07004c, 0x07004c, 0x07004c, 0x07004c, 0x07004c, 0x07004c,
+	/* 0xcf0 */ 0x07004c, 0x07004c, 0x07004c, 0x07004c, 0x07004c, 0x07004c, 0x07004c, 0x07004c,
+	/* 0xcf8 */ 0x07004c, 0x07004c, 0x07004c, 0x07004c, 0x07004c, 0x07004c, 0x07004c, 0x07004c,
+	/* 0xd00 */ 0x57304d, 0x57314d, 0x57324d, 0x57614d, 0x57634d, 0x57654d, 0x57694d, 0x576f4d,
+	/* 0xd08 */ 0x57734d, 0x57744d, 0x07004d, 0x07004d, 0x07004d, 0x07004d, 0x07004d, 0x07004d,
+	/* 0xd10 */ 0x07004d, 0x07004d, 0x07004d, 0x07004d, 0x07004d, 0x07004d, 0x07004d, 0x07004d,
+	/* 0xd18 */ 0x07004d, 0x07004d, 0x07004d, 0x07004d, 0x07004d, 0x07004d, 0x07004d, 0x07004d,
+	/* 0xd20 */ 0x57304e, 0x57314e, 0x57324e, 0x57614e, 0x57634e, 0x57654e, 0x57694e, 0x576f4e,
+	/* 0xd28 */ 0x57734e, 0x57744e, 0x07004e, 0x07004e, 0x07004e, 0x07004e, 0x07004e, 0x07004e,
+	/* 0xd30 */ 0x07004e, 0x07004e, 0x07004e, 0x07004e, 0x07004e, 0x07004e, 0x07004e, 0x07004e,
+	/* 0xd38 */ 0x07004e, 0x07004e, 0x07004e, 0x07004e, 0x07004e, 0x07004e, 0x07004e, 0x07004e,
+	/* 0xd40 */ 0x57304f, 0x57314f, 0x57324f, 0x57614f, 0x57634f, 0x57654f, 0x57694f, 0x576f4f,
+	/* 0xd48 */ 0x57734f, 0x57744f, 0x07004f, 0x07004f, 0x07004f, 0x07004f, 0x07004f, 0x07004f,
+	/* 0xd50 */ 0x07004f, 0x07004f, 0x07004f, 0x07004f, 0x07004f, 0x07004f, 0x07004f, 0x07004f,
+	/* 0xd58 */ 0x07004f, 0x07004f, 0x07004f, 0x07004f, 0x07004f, 0x07004f, 0x07004f, 0x07004f,
+	/* 0xd60 */ 0x573050, 0x573150, 0x573250, 0x576150, 0x576350, 0x576550, 0x576950, 0x576f50,
+	/* 0xd68 */ 0x577350, 0x577450, 0x070050, 0x070050, 0x070050, 0x070050, 0x070050, 0x070050,
+	/* 0xd70 */ 0x070050, 0x070050, 0x070050, 0x070050, 0x070050, 0x070050, 0x070050, 0x070050,
+	/* 0xd78 */ 0x070050, 0x070050, 0x070050, 0x070050, 0x070050, 0x070050, 0x070050, 0x070050,
+	/* 0xd80 */ 0x573051, 0x573151, 0x573251, 0x576151, 0x576351, 0x576551, 0x576951, 0x576f51,
+	/* 0xd88 */ 0x577351, 0x577451, 0x070051, 0x070051, 0x070051, 0x070051, 0x070051, 0x070051,
+	/* 0xd90 */ 0x070051, 0x070051, 0x070051, 0x070051, 0x070051, 0x070051, 0x070051, 0x070051,
+	/* 0xd98 */ 0x070051, 0x070051, 0x070051, 0x070051, 0x070051, 0x070051, 0x070051, 0x070051,
+	/* 0xda0 */ 0x573052, 0x573152, 0x573252, 0x576152, 0x576352, 0x576552, 0x576952, 0x576f52,
+	/* 0xda8 */ 0x577352, 0x577452, 0x070052, 0x070052, 0x070052, 0x070052, 0x070052, 0x070052,
+	/* 0xdb0 */ 0x070052, 0x070052, 0x070052, 0x070052, 0x070052, 0x070052, 0x070052, 0x070052,
+	/* 0xdb8 */ 0x070052, 0x070052, 0x070052, 0x070052, 0x070052, 0x070052, 0x070052, 0x070052,
+	/* 0xdc0 */ 0x573053, 0x573153, 0x573253, 0x576153, 0x576353, 0x576553, 0x576953, 0x576f53,
+	/* 0xdc8 */ 0x577353, 0x577453, 0x070053, 0x070053, 0x070053, 0x070053, 0x070053, 0x070053,
+	/* 0xdd0 */ 0x070053, 0x070053, 0x070053, 0x070053, 0x070053, 0x070053, 0x070053, 0x070053,
+	/* 0xdd8 */ 0x070053, 0x070053, 0x070053, 0x070053, 0x070053, 0x070053, 0x070053, 0x070053,
+	/* 0xde0 */ 0x573054, 0x573154, 0x573254, 0x576154, 0x576354, 0x576554, 0x576954, 0x576f54,
+	/* 0xde8 */ 0x577354, 0x577454, 0x070054, 0x070054, 0x070054, 0x070054, 0x070054, 0x070054,
+	/* 0xdf0 */ 0x070054, 0x070054, 0x070054, 0x070054, 0x070054, 0x070054, 0x070054, 0x070054,
+	/* 0xdf8 */ 0x070054, 0x070054, 0x070054, 0x070054, 0x070054, 0x070054, 0x070054, 0x070054,
+	/* 0xe00 */ 0x573055, 0x573155, 0x573255, 0x576155, 0x576355, 0x576555, 0x576955, 0x576f55,
+	/* 0xe08 */ 0x577355, 0x577455, 0x070055, 0x070055, 0x070055, 0x070055, 0x070055, 0x070055,
+	/* 0xe10 */ 0x070055, 0x070055, 0x070055, 0x070055, 0x070055, 0x070055, 0x070055, 0x070055,
+	/* 0xe18 */ 0x070055, 0x070055, 0x070055, 0x070055, 0x070055, 0x070055, 0x070055, 0x070055,
+	/* 0xe20 */ 0x573056, 0x573156, 0x573256, 0x576156, 0x576356, 0x576556, 0x576956, 0x576f56,
+	/* 0xe28 */ 0x577356, 0x577456, 0x070056, 0x070056, 0x070056, 0x070056, 0x070056, 0x070056,
+	/* 0xe30 */ 0x070056, 0x070056, 0x070056, 0x070056, 0x070056, 0x070056, 0x070056, 0x070056,
+	/* 0xe38 */ 0x070056, 0x070056, 0x070056, 0x070056, 0x070056, 0x070056, 0x070056, 0x070056,
+	/* 0xe40 */ 0x573057, 0x573157, 0x573257, 0x576157, 0x576357, 0x576557, 0x576957, 0x576f57,
+	/* 0xe48 */ 0x577357, 0x577457, 0x070057, 0x070057, 0x070057, 0x070057, 0x070057, 0x070057,
+	/* 0xe50 */ 0x070057, 0x070057, 0x070057, 0x070057, 0x070057, 0x070057, 0x070057, 0x070057,
+	/* 0xe58 */ 0x070057, 0x070057, 0x070057, 0x070057, 0x070057, 0x070057, 0x070057, 0x070057,
+	/* 0xe60 */ 0x573059, 0x573159, 0x573259, 0x576159, 0x576359, 0x576559, 0x576959, 0x576f59,
+	/* 0xe68 */ 0x577359, 0x577459, 0x070059, 0x070059, 0x070059, 0x070059, 0x070059, 0x070059,
+	/* 0xe70 */ 0x070059, 0x070059, 0x070059, 0x070059, 0x070059, 0x070059, 0x070059, 0x070059,
+	/* 0xe78 */ 0x070059, 0x070059, 0x070059, 0x070059, 0x070059, 0x070059, 0x070059, 0x070059,
+	/* 0xe80 */ 0x57306a, 0x57316a, 0x57326a, 0x57616a, 0x57636a, 0x57656a, 0x57696a, 0x576f6a,
+	/* 0xe88 */ 0x57736a, 0x57746a, 0x07006a, 0x07006a, 0x07006a, 0x07006a, 0x07006a, 0x07006a,
+	/* 0xe90 */ 0x07006a, 0x07006a, 0x07006a, 0x07006a, 0x07006a, 0x07006a, 0x07006a, 0x07006a,
+	/* 0xe98 */ 0x07006a, 0x07006a, 0x07006a, 0x07006a, 0x07006a, 0x07006a, 0x07006a, 0x07006a,
+	/* 0xea0 */ 0x57306b, 0x57316b, 0x57326b, 0x57616b, 0x57636b, 0x57656b, 0x57696b, 0x576f6b,
+	/* 0xea8 */ 0x57736b, 0x57746b, 0x07006b, 0x07006b, 0x07006b, 0x07006b, 0x07006b, 0x07006b,
+	/* 0xeb0 */ 0x07006b, 0x07006b, 0x07006b, 0x07006b, 0x07006b, 0x07006b, 0x07006b, 0x07006b,
+	/* 0xeb8 */ 0x07006b, 0x07006b, 0x07006b, 0x07006b, 0x07006b, 0x07006b, 0x07006b, 0x07006b,
+	/* 0xec0 */ 0x573071, 0x573171, 0x573271, 0x576171, 0x576371, 0x576571, 0x576971, 0x576f71,
+	/* 0xec8 */ 0x577371, 0x577471, 0x070071, 0x070071, 0x070071, 0x070071, 0x070071, 0x070071,
+	/* 0xed0 */ 0x070071, 0x070071, 0x070071, 0x070071, 0x070071, 0x070071, 0x070071, 0x070071,
+	/* 0xed8 */ 0x070071, 0x070071, 0x070071, 0x070071, 0x070071, 0x070071, 0x070071, 0x070071,
+	/* 0xee0 */ 0x573076, 0x573176, 0x573276, 0x576176, 0x576376, 0x576576, 0x576976, 0x576f76,
+	/* 0xee8 */ 0x577376, 0x577476, 0x070076, 0x070076, 0x070076, 0x070076, 0x070076, 0x070076,
+	/* 0xef0 */ 0x070076, 0x070076, 0x070076, 0x070076, 0x070076, 0x070076, 0x070076, 0x070076,
+	/* 0xef8 */ 0x070076, 0x070076, 0x070076, 0x070076, 0x070076, 0x070076, 0x070076, 0x070076,
+	/* 0xf00 */ 0x573077, 0x573177, 0x573277, 0x576177, 0x576377, 0x576577, 0x576977, 0x576f77,
+	/* 0xf08 */ 0x577377, 0x577477, 0x070077, 0x070077, 0x070077, 0x070077, 0x070077, 0x070077,
+	/* 0xf10 */ 0x070077, 0x070077, 0x070077, 0x070077, 0x070077, 0x070077, 0x070077, 0x070077,
+	/* 0xf18 */ 0x070077, 0x070077, 0x070077, 0x070077, 0x070077, 0x070077, 0x070077, 0x070077,
+	/* 0xf20 */ 0x573078, 0x573178, 0x573278, 0x576178, 0x576378, 0x576578, 0x576978, 0x576f78,
+	/* 0xf28 */ 0x577378, 0x577478, 0x070078, 0x070078, 0x070078, 0x070078, 0x070078, 0x070078,
+	/* 0xf30 */ 0x070078, 0x070078, 0x070078, 0x070078, 0x070078, 0x070078, 0x070078, 0x070078,
+	/* 0xf38 */ 0x070078, 0x070078, 0x070078, 0x070078, 0x070078, 0x070078, 0x070078, 0x070078,
+	/* 0xf40 */ 0x573079, 0x573179, 0x573279, 0x576179, 0x576379, 0x576579, 0x576979, 0x576f79,
+	/* 0xf48 */ 0x577379, 0x577479, 0x070079, 0x070079, 0x070079, 0x070079, 0x070079, 0x070079,
+	/* 0xf50 */ 0x070079, 0x070079, 0x070079, 0x070079, 0x070079, 0x070079, 0x070079, 0x070079,
+	/* 0xf58 */ 0x070079, 0x070079, 0x070079, 0x070079, 0x070079, 0x070079, 0x070079, 0x070079,
+	/* 0xf60 */ 0x57307a, 0x57317a, 0x57327a, 0x57617a, 0x57637a, 0x57657a, 0x57697a, 0x576f7a,
+	/* 0xf68 */ 0x57737a, 0x57747a, 0x07007a, 0x07007a, 0x07007a, 0x07007a, 0x07007a, 0x07007a,
+	/* 0xf70 */ 0x07007a, 0x07007a, 0x07007a, 0x07007a, 0x07007a, 0x07007a, 0x07007a, 0x07007a,
+	/* 0xf78 */ 0x07007a, 0x07007a, 0x07007a, 0x07007a, 0x07007a, 0x07007a, 0x07007a, 0x07007a,
+	/* 0xf80 */ 0x080026, 0x080026, 0x080026, 0x080026, 0x080026, 0x080026, 0x080026, 0x080026,
+	/* 0xf88 */ 0x080026, 0x080026, 0x080026, 0x080026, 0x080026, 0x080026, 0x080026, 0x080026,
+	/* 0xf90 */ 0x08002a, 0x08002a, 0x08002a, 0x08002a, 0x08002a, 0x08002a, 0x08002a, 0x08002a,
+	/* 0xf98 */ 0x08002a, 0x08002a, 0x08002a, 0x08002a, 0x08002a, 0x08002a, 0x08002a, 0x08002a,
+	/* 0xfa0 */ 0x08002c, 0x08002c, 0x08002c, 0x08002c, 0x08002c, 0x08002c, 0x08002c, 0x08002c,
+	/* 0xfa8 */ 0x08002c, 0x08002c, 0x08002c, 0x08002c, 0x08002c, 0x08002c, 0x08002c, 0x08002c,
+	/* 0xfb0 */ 0x08003b, 0x08003b, 0x08003b, 0x08003b, 0x08003b, 0x08003b, 0x08003b, 0x08003b,
+	/* 0xfb8 */ 0x08003b, 0x08003b, 0x08003b, 0x08003b, 0x08003b, 0x08003b, 0x08003b, 0x08003b,
+	/* 0xfc0 */ 0x080058, 0x080058, 0x080058, 0x080058, 0x080058, 0x080058, 0x080058, 0x080058,
+	/* 0xfc8 */ 0x080058, 0x080058, 0x080058, 0x080058, 0x080058, 0x080058, 0x080058, 0x080058,
+	/* 0xfd0 */ 0x08005a, 0x08005a, 0x08005a, 0x08005a, 0x08005a, 0x08005a, 0x08005a, 0x08005a,
+	/* 0xfd8 */ 0x08005a, 0x08005a, 0x08005a, 0x08005a, 0x08005a, 0x08005a, 0x08005a, 0x08005a,
+	/* 0xfe0 */ 0x0a0021, 0x0a0021, 0x0a0021, 0x0a0021, 0x0a0022, 0x0a0022, 0x0a0022, 0x0a0022,
+	/* 0xfe8 */ 0x0a0028, 0x0a0028, 0x0a0028, 0x0a0028, 0x0a0029, 0x0a0029, 0x0a0029, 0x0a0029,
+	/* 0xff0 */ 0x0a003f, 0x0a003f, 0x0a003f, 0x0a003f, 0x0b0027, 0x0b0027, 0x0b002b, 0x0b002b,
+	/* 0xff8 */ 0x0b007c, 0x0b007c, 0x0c0023, 0x0c003e, 0x000000, 0x000000, 0x000000, 0x000000,
+};
+
 /* huffman-encode string <s> into the huff_tmp buffer and returns the amount
  * of output bytes. The caller must ensure the output is large enough (ie at
  * least 4 times as long as s).
@@ -731,6 +1255,10 @@ int huff_enc(const char *s, char *out)
  * with new bytes. Shift operations are cheap when done a single time like this.
  * On 64-bit platforms it is possible to further improve this by storing both
  * of them in a single word.
+ *
+ * The 12 upper bits of the code are first looked up in the multi-symbol table,
+ * which directly provides one or two symbols when their codes are short enough.
+ * The reverse-huffman tables are only used for the longer codes.
  */
 int huff_dec(const uint8_t *huff, int hlen, char *out, int olen)
 {
@@ -741,9 +1269,10 @@ int huff_dec(const uint8_t *huff, int hlen, char *out, int olen)
 	uint32_t next = 0;
 	uint32_t shift;
 	uint32_t code; /* The 30-bit code being looked up, MSB-aligned */
+	uint32_t mst;
 	uint8_t sym;
 	int bleft; /* bits left */
-	int l;
+	int l, l2;
 
 	code = 0;
 	shift = 64; // start with an empty buffer
@@ -780,16 +1309,26 @@ int huff_dec(const uint8_t *huff, int hlen, char *out, int olen)
 			code = (code << shift) + (next >> (32 - shift));
 
 		/* now we necessarily have 32 bits available */
-		if (code < 0xfe000000) {
-			/* single byte */
-			sym = code >> 24;
-			l = sym < 0xb8 ?
-				sym < 0x50 ? 5 : 6 :
-				sym < 0xf8 ? 7 : 8;
-			sym = rht_bit31_24[code >> 24];
+		mst = huff_mst[code >> 20];
+		l = (mst >> 16) & 0xf;
+		if (l) {
+			/* up to 12 bits, one or two symbols */
+			l2 = mst >> 20;
+			if (l2 && l + l2 <= bleft && out + 1 < out_end) {
+				out[0] = mst;
+				out[1] = mst >> 8;
+				out += 2;
+				l += l2;
+				bleft -= l;
+				shift += l;
+				continue;
+			}
+			sym = mst;
 		}
 		else if (code < 0xfffe0000) {
-			/* two bytes, 0xfe + 2 bits or 0xff + 2..7 bits */
+			/* two bytes, 0xfe + 2 bits or 0xff + 2..7 bits, with
+			 * more than 12 bits.
+			 */
 			sym = code >> 17;
 			l = sym < 0xe0 ?
 				sym < 0xa0 ? 10 : sym < 0xd0 ? 11 : 12 :
@@ -822,11 +1361,11 @@ int huff_dec(const uint8_t *huff, int hlen, char *out, int olen)
 				sym < 0xe2 ? 27 : sym < 0xff ? 28 : 30;
 			if (sym < 0xff)
 				sym = rht_bit15_11_11_4[(code >> 4) & 0xff];
-			else if ((code & 0xff) == 0xf0)
+			else if ((code & 0xfc) == 0xf0)
 				sym = 10;
-			else if ((code & 0xff) == 0xf4)
+			else if ((code & 0xfc) == 0xf4)
 				sym = 13;
-			else if ((code & 0xff) == 0xf8)
+			else if ((code & 0xfc) == 0xf8)
 				sym = 22;
 			else { // 0xfc : EOS
 				break;
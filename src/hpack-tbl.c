@@ -169,6 +169,8 @@ static struct hpack_dht *hpack_dht_defrag(struct hpack_dht *dht)
 	if (!alt_dht)
 		return NULL;
 
+	/* the table may be smaller than the pool's objects */
+	alt_dht->size = dht->size;
 	alt_dht->total = dht->total;
 	alt_dht->used = dht->used;
 	alt_dht->wrap = dht->used;
@@ -350,7 +352,8 @@ int hpack_dht_insert(struct hpack_dht *dht, struct ist name, struct ist value)
 	}
 	else {
 		/* need to defragment the table before inserting upfront */
-		dht = hpack_dht_defrag(dht);
+		if (!hpack_dht_defrag(dht))
+			return -1;
 		wrap = dht->wrap + 1;
 		head = dht->head + 1;
 		dht->dte[head].addr = dht->dte[dht->front].addr - (name.len + value.len);
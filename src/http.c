@@ -770,21 +770,20 @@ char *http_find_cookie_value_end(char *s, const char *e)
 	return s;
 }
 
-/* Try to find the next occurrence of a cookie name in a cookie header value.
- * To match on any cookie name, <cookie_name_l> must be set to 0.
- * The lookup begins at <hdr>. The pointer and size of the next occurrence of
- * the cookie value is returned into *value and *value_l, and the function
- * returns a pointer to the next pointer to search from if the value was found.
- * Otherwise if the cookie was not found, NULL is returned and neither value
- * nor value_l are touched. The input <hdr> string should first point to the
- * header's value, and the <hdr_end> pointer must point to the first character
- * not part of the value. <list> must be non-zero if value may represent a list
- * of values (cookie headers). This makes it faster to abort parsing when no
- * list is expected.
+/* Extracts the next cookie from a cookie header value, starting at <hdr>. The
+ * pointer and size of the cookie name are returned into *name and *name_l, and
+ * those of its value into *value and *value_l. Attributes beginning with '$'
+ * and cookies without an equal sign are skipped. The function returns a
+ * pointer to the next position to search from if a cookie was found,
+ * otherwise NULL and none of the output arguments are touched. The input <hdr>
+ * string should first point to the header's value, and the <hdr_end> pointer
+ * must point to the first character not part of the value. <list> must be
+ * non-zero if value may represent a list of values (cookie headers), in which
+ * case commas also delimit cookies.
  */
-char *http_extract_cookie_value(char *hdr, const char *hdr_end,
-                                char *cookie_name, size_t cookie_name_l,
-                                int list, char **value, size_t *value_l)
+char *http_extract_next_cookie(char *hdr, const char *hdr_end, int list,
+                               char **name, size_t *name_l,
+                               char **value, size_t *value_l)
 {
 	char *equal, *att_end, *att_beg, *val_beg, *val_end;
 	char *next;
@@ -793,7 +792,7 @@ char *http_extract_cookie_value(char *hdr, const char *hdr_end,
 	 * generally something like this :
 	 * Cookie:    NAME1  =  VALUE 1  ; NAME2 = VALUE2 ; NAME3 = VALUE3\r\n
 	 */
-	for (att_beg = hdr; att_beg + cookie_name_l + 1 < hdr_end; att_beg = next + 1) {
+	for (att_beg = hdr; att_beg + 1 < hdr_end; att_beg = next + 1) {
 		/* Iterate through all cookies on this line */
 
 		while (att_beg < hdr_end && HTTP_IS_SPHT(*att_beg))
@@ -848,13 +847,42 @@ char *http_extract_cookie_value(char *hdr, const char *hdr_end,
 		/* Now we have the cookie name between att_beg and att_end, and
 		 * its value between val_beg and val_end.
 		 */
+		*name = att_beg;
+		*name_l = att_end - att_beg;
+		*value = val_beg;
+		*value_l = val_end - val_beg;
+		return next + 1;
+	}
+
+	return NULL;
+}
+
+/* Try to find the next occurrence of a cookie name in a cookie header value.
+ * To match on any cookie name, <cookie_name_l> must be set to 0.
+ * The lookup begins at <hdr>. The pointer and size of the next occurrence of
+ * the cookie value is returned into *value and *value_l, and the function
+ * returns a pointer to the next pointer to search from if the value was found.
+ * Otherwise if the cookie was not found, NULL is returned and neither value
+ * nor value_l are touched. The input <hdr> string should first point to the
+ * header's value, and the <hdr_end> pointer must point to the first character
+ * not part of the value. <list> must be non-zero if value may represent a list
+ * of values (cookie headers). This makes it faster to abort parsing when no
+ * list is expected.
+ */
+char *http_extract_cookie_value(char *hdr, const char *hdr_end,
+                                char *cookie_name, size_t cookie_name_l,
+                                int list, char **value, size_t *value_l)
+{
+	char *att, *val;
+	size_t att_l, val_l;
 
-		if (cookie_name_l == 0 || (att_end - att_beg == cookie_name_l &&
-		    memcmp(att_beg, cookie_name, cookie_name_l) == 0)) {
+	while ((hdr = http_extract_next_cookie(hdr, hdr_end, list, &att, &att_l, &val, &val_l)) != NULL) {
+		if (cookie_name_l == 0 || (att_l == cookie_name_l &&
+		    memcmp(att, cookie_name, cookie_name_l) == 0)) {
 			/* let's return this value and indicate where to go on from */
-			*value = val_beg;
-			*value_l = val_end - val_beg;
-			return next + 1;
+			*value = val;
+			*value_l = val_l;
+			return hdr;
 		}
 
 		/* Set-Cookie headers only have the name in the first attr=value part */
@@ -1225,3 +1253,40 @@ struct ist http_trim_trailing_spht(struct ist value)
 
 	return ret;
 }
+
+/* Parses <value>, the value of an RFC9218 "priority" header field or of a
+ * PRIORITY_UPDATE frame, and updates <urgency> and <incremental> with the
+ * "u" and "i" members it contains. Unknown members, parameters and invalid
+ * values are ignored as mandated by RFC9218#4, leaving the corresponding
+ * output untouched.
+ */
+void http_parse_priority(struct ist value, uint8_t *urgency, uint8_t *incremental)
+{
+	while (istlen(value)) {
+		struct ist member = istsplit(&value, ',');
+		struct ist key;
+
+		/* drop parameters and surrounding spaces */
+		member = iststop(member, ';');
+		while (istlen(member) && HTTP_IS_SPHT(*istptr(member)))
+			member = istnext(member);
+		while (istlen(member) && HTTP_IS_SPHT(istptr(member)[istlen(member) - 1]))
+			member.len--;
+
+		key = iststop(member, '=');
+		member = istadv(member, istlen(key) + 1);
+
+		if (isteq(key, ist("u"))) {
+			if (istlen(member) == 1 && *istptr(member) >= '0' &&
+			    *istptr(member) <= '0' + HTTP_PRIO_URGENCY_MAX)
+				*urgency = *istptr(member) - '0';
+		}
+		else if (isteq(key, ist("i"))) {
+			/* a bare key is a boolean true */
+			if (!istlen(member) || isteq(member, ist("?1")))
+				*incremental = 1;
+			else if (isteq(member, ist("?0")))
+				*incremental = 0;
+		}
+	}
+}
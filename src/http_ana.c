@@ -19,6 +19,7 @@
 #include <haproxy/capture-t.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/channel.h>
+#include <haproxy/counters.h>
 #include <haproxy/check.h>
 #include <haproxy/connection.h>
 #include <haproxy/errors.h>
@@ -1589,8 +1590,8 @@ int http_wait_for_response(struct stream *s, struct channel *rep, int an_bit)
 		stream_inc_http_fail_ctr(s);
 
 	if (objt_server(s->target)) {
-		_HA_ATOMIC_INC(&__objt_server(s->target)->counters.p.http.rsp[n]);
-		_HA_ATOMIC_INC(&__objt_server(s->target)->counters.p.http.cum_req);
+		COUNTERS_INC(&__objt_server(s->target)->counters, rsp[n]);
+		COUNTERS_INC(&__objt_server(s->target)->counters, cum_req);
 	}
 
 	/* Adjust server's health based on status code. Note: status codes 501
@@ -2775,6 +2776,17 @@ int http_res_set_status(unsigned int status, struct ist reason, struct stream *s
 	return 0;
 }
 
+/* Accounts <count> HTX defragmentations caused by the rules of proxy <px>,
+ * for each side of the proxy.
+ */
+static void http_count_htx_defrags(struct proxy *px, unsigned int count)
+{
+	if (px->cap & PR_CAP_FE)
+		_HA_ATOMIC_ADD(&px->fe_counters.p.http.htx_defrags, count);
+	if (px->cap & PR_CAP_BE)
+		_HA_ATOMIC_ADD(&px->be_counters.p.http.htx_defrags, count);
+}
+
 /* Executes the http-request rules <rules> for stream <s>, proxy <px> and
  * transaction <txn>. Returns the verdict of the first rule that prevents
  * further processing of the request (auth, deny, ...), and defaults to
@@ -2791,6 +2803,7 @@ static enum rule_result http_req_get_intercept_rule(struct proxy *px, struct lis
 	struct http_txn *txn = s->txn;
 	struct act_rule *rule;
 	enum rule_result rule_ret = HTTP_RULE_RES_CONT;
+	unsigned int defrags = htx_defrag_cnt;
 	int act_opts = 0;
 
 	/* If "the current_rule_list" match the executed rule list, we are in
@@ -2827,6 +2840,9 @@ static enum rule_result http_req_get_intercept_rule(struct proxy *px, struct lis
 
 		act_opts |= ACT_OPT_FIRST;
   resume_execution:
+		/* the action may change what cached samples rely on */
+		stream_smp_cache_flush(s);
+
 		if (rule->kw->flags & KWF_EXPERIMENTAL)
 			mark_tainted(TAINTED_ACTION_EXP_EXECUTED);
 
@@ -2933,6 +2949,9 @@ static enum rule_result http_req_get_intercept_rule(struct proxy *px, struct lis
 	if (rule_ret != HTTP_RULE_RES_YIELD)
 		txn->req.flags &= ~HTTP_MSGF_SOFT_RW;
 
+	if (unlikely(htx_defrag_cnt != defrags))
+		http_count_htx_defrags(px, htx_defrag_cnt - defrags);
+
 	/* we reached the end of the rules, nothing to report */
 	return rule_ret;
 }
@@ -2953,6 +2972,7 @@ static enum rule_result http_res_get_intercept_rule(struct proxy *px, struct lis
 	struct http_txn *txn = s->txn;
 	struct act_rule *rule;
 	enum rule_result rule_ret = HTTP_RULE_RES_CONT;
+	unsigned int defrags = htx_defrag_cnt;
 	int act_opts = 0;
 
 	/* If "the current_rule_list" match the executed rule list, we are in
@@ -2990,6 +3010,9 @@ static enum rule_result http_res_get_intercept_rule(struct proxy *px, struct lis
 
 		act_opts |= ACT_OPT_FIRST;
 resume_execution:
+		/* the action may change what cached samples rely on */
+		stream_smp_cache_flush(s);
+
 		if (rule->kw->flags & KWF_EXPERIMENTAL)
 			mark_tainted(TAINTED_ACTION_EXP_EXECUTED);
 
@@ -3086,6 +3109,9 @@ static enum rule_result http_res_get_intercept_rule(struct proxy *px, struct lis
 	if (rule_ret != HTTP_RULE_RES_YIELD)
 		txn->rsp.flags &= ~HTTP_MSGF_SOFT_RW;
 
+	if (unlikely(htx_defrag_cnt != defrags))
+		http_count_htx_defrags(px, htx_defrag_cnt - defrags);
+
 	/* we reached the end of the rules, nothing to report */
 	return rule_ret;
 }
@@ -3107,7 +3133,7 @@ int http_eval_after_res_rules(struct stream *s)
 
 	/* prune the request variables if not already done and swap to the response variables. */
 	if (s->vars_reqres.scope != SCOPE_RES) {
-		if (!LIST_ISEMPTY(&s->vars_reqres.head))
+		if (!eb_is_empty(&s->vars_reqres.name_root))
 			vars_prune(&s->vars_reqres, s->sess, s);
 		vars_init_head(&s->vars_reqres, SCOPE_RES);
 	}
@@ -5197,6 +5223,7 @@ struct http_txn *http_create_txn(struct stream *s)
 	txn->http_reply = NULL;
 	txn->l7_buffer = BUF_NULL;
 	write_u32(txn->cache_hash, 0);
+	txn->cache_prefix_cnt = 0;
 
 	txn->cookie_first_date = 0;
 	txn->cookie_last_date = 0;
@@ -5212,6 +5239,7 @@ struct http_txn *http_create_txn(struct stream *s)
 	txn->rsp.chn = &s->res;
 
 	txn->auth.method = HTTP_AUTH_UNKNOWN;
+	txn->cookie_idx = NULL;
 
 	/* here we don't want to re-initialize s->vars_txn and s->vars_reqres
 	 * variable lists, because they were already initialized upon stream
@@ -5231,15 +5259,17 @@ void http_destroy_txn(struct stream *s)
 	pool_free(pool_head_capture, txn->cli_cookie);
 	pool_free(pool_head_capture, txn->srv_cookie);
 	pool_free(pool_head_uniqueid, s->unique_id.ptr);
+	pool_free(pool_head_http_cookie_idx, txn->cookie_idx);
 
 	s->unique_id = IST_NULL;
 	txn->uri = NULL;
 	txn->srv_cookie = NULL;
 	txn->cli_cookie = NULL;
+	txn->cookie_idx = NULL;
 
-	if (!LIST_ISEMPTY(&s->vars_txn.head))
+	if (!eb_is_empty(&s->vars_txn.name_root))
 		vars_prune(&s->vars_txn, s->sess, s);
-	if (!LIST_ISEMPTY(&s->vars_reqres.head))
+	if (!eb_is_empty(&s->vars_reqres.name_root))
 		vars_prune(&s->vars_reqres, s->sess, s);
 
 	b_free(&txn->l7_buffer);
@@ -5250,6 +5280,7 @@ void http_destroy_txn(struct stream *s)
 
 
 DECLARE_POOL(pool_head_http_txn, "http_txn", sizeof(struct http_txn));
+DECLARE_POOL(pool_head_http_cookie_idx, "http_cookie_idx", sizeof(struct http_cookie_idx));
 
 /*
  * Local variables:
@@ -52,6 +52,7 @@ static struct applet httpclient_applet;
 
 /* if the httpclient is not configured, error are ignored and features are limited */
 static int hard_error_resolvers = 0;
+static int httpclient_maxconn = 0; /* per-server connection limit, 0=none */
 static char *resolvers_id = NULL;
 static char *resolvers_prefer = NULL;
 
@@ -259,9 +260,45 @@ static void hc_cli_release(struct appctx *appctx)
 	return;
 }
 
+/* Dumps one line per server of the default httpclient proxy, reporting the
+ * concurrency, the connection reuse and the average timings, so that the
+ * behaviour of the internal HTTP client may be observed. Always returns 1.
+ */
+static int hc_cli_io_handler_show(struct appctx *appctx)
+{
+	struct server *srv;
+	unsigned int window;
+	long long samples;
+
+	if (!httpclient_proxy)
+		return 1;
+
+	chunk_reset(&trash);
+	for (srv = httpclient_proxy->srv; srv; srv = srv->next) {
+		samples = COUNTERS_GET(&srv->counters, cum_req);
+		window = (samples > 0 && samples < TIME_STATS_SAMPLES) ? samples : TIME_STATS_SAMPLES;
+
+		chunk_appendf(&trash,
+		              "%s: cur=%u max=%u limit=%d queued=%u req=%lld conn=%lld reuse=%lld"
+		              " fail_conn=%lld fail_resp=%lld qtime=%u ctime=%u rtime=%u ttime=%u\n",
+		              srv->id, srv->cur_sess, srv->counters.cur_sess_max, srv->maxconn,
+		              srv->queue.length, samples, srv->counters.connect, srv->counters.reuse,
+		              srv->counters.failed_conns, srv->counters.failed_resp,
+		              swrate_avg(srv->counters.q_time, window),
+		              swrate_avg(srv->counters.c_time, window),
+		              swrate_avg(srv->counters.d_time, window),
+		              swrate_avg(srv->counters.t_time, window));
+	}
+
+	if (applet_putchk(appctx, &trash) == -1)
+		return 0;
+	return 1;
+}
+
 /* register cli keywords */
 static struct cli_kw_list cli_kws = {{ },{
 	{ { "httpclient", NULL }, "httpclient <method> <URI>               : launch an HTTP request", hc_cli_parse, hc_cli_io_handler, hc_cli_release,  NULL, ACCESS_EXPERT},
+	{ { "show", "httpclient", NULL }, "show httpclient                         : show the HTTP client servers usage and timings", NULL, hc_cli_io_handler_show, NULL },
 	{ { NULL }, NULL, NULL, NULL }
 }};
 
@@ -1236,6 +1273,7 @@ struct proxy *httpclient_create_proxy(const char *id)
 	srv_raw->uweight = 0;
 	srv_raw->xprt = xprt_get(XPRT_RAW);
 	srv_raw->flags |= SRV_F_MAPPORTS;  /* needed to apply the port change with resolving */
+	srv_raw->maxconn = srv_raw->minconn = httpclient_maxconn;
 	srv_raw->id = strdup("<HTTPCLIENT>");
 	if (!srv_raw->id) {
 		memprintf(&errmsg, "out of memory.");
@@ -1257,6 +1295,7 @@ struct proxy *httpclient_create_proxy(const char *id)
 	srv_ssl->xprt = xprt_get(XPRT_SSL);
 	srv_ssl->use_ssl = 1;
 	srv_ssl->flags |= SRV_F_MAPPORTS;  /* needed to apply the port change with resolving */
+	srv_ssl->maxconn = srv_ssl->minconn = httpclient_maxconn;
 	srv_ssl->id = strdup("<HTTPSCLIENT>");
 	if (!srv_ssl->id) {
 		memprintf(&errmsg, "out of memory.");
@@ -1469,6 +1508,24 @@ static int httpclient_parse_global_prefer(char **args, int section_type, struct
 }
 
 
+static int httpclient_parse_global_maxconn(char **args, int section_type, struct proxy *curpx,
+                                           const struct proxy *defpx, const char *file, int line,
+                                           char **err)
+{
+	char *stop;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	httpclient_maxconn = strtol(args[1], &stop, 10);
+	if (!*args[1] || *stop || httpclient_maxconn < 0) {
+		memprintf(err, "'%s' expects a positive integer or zero as argument.", args[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
 #ifdef USE_OPENSSL
 static int httpclient_parse_global_ca_file(char **args, int section_type, struct proxy *curpx,
                                         const struct proxy *defpx, const char *file, int line,
@@ -1512,6 +1569,7 @@ static int httpclient_parse_global_verify(char **args, int section_type, struct
 static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "httpclient.resolvers.id", httpclient_parse_global_resolvers },
 	{ CFG_GLOBAL, "httpclient.resolvers.prefer", httpclient_parse_global_prefer },
+	{ CFG_GLOBAL, "httpclient.maxconn", httpclient_parse_global_maxconn },
 #ifdef USE_OPENSSL
 	{ CFG_GLOBAL, "httpclient.ssl.verify", httpclient_parse_global_verify },
 	{ CFG_GLOBAL, "httpclient.ssl.ca-file", httpclient_parse_global_ca_file },
@@ -38,6 +38,7 @@
 #include <haproxy/stream.h>
 #include <haproxy/tools.h>
 #include <haproxy/version.h>
+#include <haproxy/xxhash.h>
 
 
 /* this struct is used between calls to smp_fetch_hdr() or smp_fetch_cookie() */
@@ -1633,6 +1634,104 @@ static int smp_fetch_capture_res_ver(const struct arg *args, struct sample *smp,
 
 }
 
+/* Returns the index of the cookies of the request being processed by stream <s>
+ * whose HTX message is <htx>. The index is built on the first call and reused
+ * as long as the Cookie header was not modified. NULL is returned if there is
+ * no transaction, if the request has more than one Cookie header or more than
+ * HTTP_COOKIE_IDX_MAX cookies, or if the index cannot be allocated. In this
+ * case the caller must parse the headers itself.
+ */
+static struct http_cookie_idx *http_get_cookie_idx(struct stream *s, struct htx *htx)
+{
+	struct http_txn *txn = s ? s->txn : NULL;
+	struct http_cookie_idx *idx;
+	struct http_hdr_ctx ctx;
+	struct ist hdr = IST_NULL;
+	char *beg, *end, *name, *value;
+	size_t name_l, value_l;
+	uint64_t hash;
+
+	if (!txn)
+		return NULL;
+
+	ctx.blk = NULL;
+	if (http_find_header(htx, ist("Cookie"), &ctx, 1)) {
+		hdr = ctx.value;
+		if (http_find_header(htx, ist("Cookie"), &ctx, 1))
+			return NULL;
+	}
+
+	hash = XXH3(istptr(hdr), istlen(hdr), 0);
+	idx = txn->cookie_idx;
+	if (idx && istptr(idx->hdr) == istptr(hdr) && istlen(idx->hdr) == istlen(hdr) && idx->hash == hash)
+		goto end;
+
+	if (!idx) {
+		idx = pool_alloc(pool_head_http_cookie_idx);
+		if (!idx)
+			return NULL;
+		txn->cookie_idx = idx;
+	}
+
+	idx->hdr = hdr;
+	idx->hash = hash;
+	idx->count = 0;
+
+	/* the header is parsed value by value the same way as the fetches
+	 * below do it.
+	 */
+	ctx.blk = NULL;
+	while (http_find_header(htx, ist("Cookie"), &ctx, 0)) {
+		beg = ctx.value.ptr;
+		end = beg + ctx.value.len;
+		while ((beg = http_extract_next_cookie(beg, end, 1, &name, &name_l, &value, &value_l))) {
+			if (idx->count == HTTP_COOKIE_IDX_MAX) {
+				idx->count = -1;
+				goto end;
+			}
+			idx->cookies[idx->count].name  = ist2(name, name_l);
+			idx->cookies[idx->count].value = ist2(value, value_l);
+			idx->count++;
+		}
+	}
+  end:
+	return idx->count >= 0 ? idx : NULL;
+}
+
+/* Looks up cookie <cook> of length <cook_l> in cookie index <idx> for
+ * smp_fetch_cookie(), with the same semantics. The position of the next
+ * cookie to check when iterating is stored in smp->ctx.a[0].
+ */
+static int smp_fetch_cookie_idx(const struct http_cookie_idx *idx, const char *cook, size_t cook_l, struct sample *smp)
+{
+	long pos = (smp->flags & SMP_F_NOT_LAST) ? (long)smp->ctx.a[0] : 0;
+	int found = 0;
+
+	for (; pos < idx->count; pos++) {
+		if (cook_l && !isteq(idx->cookies[pos].name, ist2(cook, cook_l)))
+			continue;
+
+		smp->data.type = SMP_T_STR;
+		smp->flags |= SMP_F_CONST;
+		smp->data.u.str.area = istptr(idx->cookies[pos].value);
+		smp->data.u.str.data = istlen(idx->cookies[pos].value);
+		found = 1;
+		if (smp->opt & SMP_OPT_ITERATE) {
+			/* iterate on cookie value */
+			smp->ctx.a[0] = (void *)(pos + 1);
+			smp->flags |= SMP_F_NOT_LAST;
+			return 1;
+		}
+		if (!cook_l) {
+			/* No cookie name, first occurrence returned */
+			break;
+		}
+	}
+
+	smp->flags &= ~SMP_F_NOT_LAST;
+	return found;
+}
+
 /* Iterate over all cookies present in a message. The context is stored in
  * smp->ctx.a[0] for the in-header position, smp->ctx.a[1] for the
  * end-of-header-value, and smp->ctx.a[2] for the hdr_ctx. Depending on
@@ -1641,7 +1740,9 @@ static int smp_fetch_capture_res_ver(const struct arg *args, struct sample *smp,
  * the input options indicate that no iterating is desired, then only last
  * value is fetched if any. If no cookie name is provided, the first cookie
  * value found is fetched. The returned sample is of type CSTR.  Can be used
- * to parse cookies in other files.
+ * to parse cookies in other files. Request cookies are looked up in the
+ * transaction's cookie index when possible, in which case smp->ctx.a[2] points
+ * to the index instead.
  */
 static int smp_fetch_cookie(const struct arg *args, struct sample *smp, const char *kw, void *private)
 {
@@ -1650,6 +1751,7 @@ static int smp_fetch_cookie(const struct arg *args, struct sample *smp, const ch
 	struct check *check = ((kw[0] == 's' || kw[2] == 's') ? objt_check(smp->sess->origin) : NULL);
 	struct htx *htx = smp_prefetch_htx(smp, chn, check, 1);
 	struct http_hdr_ctx *ctx = smp->ctx.a[2];
+	struct http_cookie_idx *idx = NULL;
 	struct ist hdr;
 	char *cook = NULL;
 	size_t cook_l = 0;
@@ -1660,6 +1762,13 @@ static int smp_fetch_cookie(const struct arg *args, struct sample *smp, const ch
 		cook_l = args->data.str.data;
 	}
 
+	if (ctx && ctx != &static_http_hdr_ctx) {
+		/* iterating over the cookie index */
+		if (smp->flags & SMP_F_NOT_LAST)
+			return smp_fetch_cookie_idx((struct http_cookie_idx *)ctx, cook, cook_l, smp);
+		ctx = NULL;
+	}
+
 	if (!ctx) {
 		/* first call */
 		ctx = &static_http_hdr_ctx;
@@ -1672,6 +1781,16 @@ static int smp_fetch_cookie(const struct arg *args, struct sample *smp, const ch
 
 	hdr = (!(check || (chn && chn->flags & CF_ISRESP)) ? ist("Cookie") : ist("Set-Cookie"));
 
+	if (!(check || (chn && chn->flags & CF_ISRESP)) && (smp->opt & SMP_OPT_DIR) == SMP_OPT_DIR_REQ)
+		idx = http_get_cookie_idx(smp->strm, htx);
+
+	if (idx) {
+		smp->flags |= SMP_F_VOL_HDR;
+		smp->flags &= ~SMP_F_NOT_LAST;
+		smp->ctx.a[2] = idx;
+		return smp_fetch_cookie_idx(idx, cook, cook_l, smp);
+	}
+
 	/* OK so basically here, either we want only one value or we want to
 	 * iterate over all of them and we fetch the next one. In this last case
 	 * SMP_OPT_ITERATE option is set.
@@ -1750,6 +1869,7 @@ static int smp_fetch_cookie_cnt(const struct arg *args, struct sample *smp, cons
 	struct channel *chn = ((kw[0] == 'c' || kw[2] == 'q') ? SMP_REQ_CHN(smp) : SMP_RES_CHN(smp));
 	struct check *check = ((kw[0] == 's' || kw[2] == 's') ? objt_check(smp->sess->origin) : NULL);
 	struct htx *htx = smp_prefetch_htx(smp, chn, check, 1);
+	struct http_cookie_idx *idx = NULL;
 	struct http_hdr_ctx ctx;
 	struct ist hdr;
 	char *val_beg, *val_end;
@@ -1767,9 +1887,23 @@ static int smp_fetch_cookie_cnt(const struct arg *args, struct sample *smp, cons
 
 	hdr = (!(check || (chn && chn->flags & CF_ISRESP)) ? ist("Cookie") : ist("Set-Cookie"));
 
+	if (!(check || (chn && chn->flags & CF_ISRESP)) && (smp->opt & SMP_OPT_DIR) == SMP_OPT_DIR_REQ)
+		idx = http_get_cookie_idx(smp->strm, htx);
+
 	val_end = val_beg = NULL;
 	ctx.blk = NULL;
 	cnt = 0;
+
+	if (idx) {
+		int pos;
+
+		for (pos = 0; pos < idx->count; pos++) {
+			if (!cook_l || isteq(idx->cookies[pos].name, ist2(cook, cook_l)))
+				cnt++;
+		}
+		goto end;
+	}
+
 	while (1) {
 		/* Note: val_beg == NULL every time we need to fetch a new header */
 		if (!val_beg) {
@@ -1794,6 +1928,7 @@ static int smp_fetch_cookie_cnt(const struct arg *args, struct sample *smp, cons
 		}
 	}
 
+  end:
 	smp->data.type = SMP_T_SINT;
 	smp->data.u.sint = cnt;
 	smp->flags |= SMP_F_VOL_HDR;
@@ -126,12 +126,179 @@ size_t http_get_hdrs_size(struct htx *htx)
 #define HTTP_FIND_FL_MATCH_TYPE 0x000F
 #define HTTP_FIND_FL_FULL 0x0010
 
+/* The last two HTX messages looked up by name on this thread may be indexed.
+ * <http_hdr_idx_next> designates the least recently used slot.
+ */
+static THREAD_LOCAL struct http_hdr_idx http_hdr_idx[2];
+static THREAD_LOCAL int http_hdr_idx_next;
+
+/* Returns the case-insensitive hash of header name <name> used by the index. */
+static inline uint32_t http_hdr_idx_hash(const struct ist name)
+{
+	uint32_t hash = 0;
+	size_t i;
+
+	for (i = 0; i < istlen(name); i++)
+		hash = hash * 31 + (istptr(name)[i] | 0x20);
+	return hash;
+}
+
+/* Returns the header index of HTX message <htx> or NULL if it is not indexed.
+ * The index is only built when the message is looked up for the second time
+ * without being modified in between, since building it costs about as much as
+ * a single lookup. Messages with more than HTTP_HDR_IDX_MAX headers are not
+ * indexed.
+ */
+static const struct http_hdr_idx *http_get_hdr_idx(const struct htx *htx)
+{
+	uint16_t last[HTTP_HDR_IDX_BUCKETS];
+	struct http_hdr_idx *idx;
+	struct htx_blk *blk;
+	enum htx_blk_type type;
+	uint32_t hash;
+	int slot;
+
+	slot = http_hdr_idx_next;
+	if (http_hdr_idx[!slot].htx == htx)
+		slot = !slot;
+	idx = &http_hdr_idx[slot];
+	http_hdr_idx_next = !slot;
+
+	if (idx->htx != htx || idx->gen != htx->gen || idx->first != htx->first) {
+		/* first lookup since the last change */
+		idx->htx = htx;
+		idx->gen = htx->gen;
+		idx->first = htx->first;
+		idx->count = -1;
+		return NULL;
+	}
+
+	if (idx->count >= 0)
+		return idx;
+
+	if (idx->count < -1)
+		return NULL;
+
+	memset(idx->head, 0, sizeof(idx->head));
+	memset(last, 0, sizeof(last));
+	idx->count = 0;
+	for (blk = htx_get_first_blk(htx); blk; blk = htx_get_next_blk(htx, blk)) {
+		type = htx_get_blk_type(blk);
+		if (type == HTX_BLK_EOH)
+			break;
+		if (type != HTX_BLK_HDR)
+			continue;
+
+		if (idx->count == HTTP_HDR_IDX_MAX) {
+			idx->count = -2;
+			return NULL;
+		}
+
+		hash = http_hdr_idx_hash(htx_get_blk_name(htx, blk));
+		idx->ent[idx->count].pos  = htx_get_blk_pos(htx, blk);
+		idx->ent[idx->count].hash = hash;
+		idx->ent[idx->count].next = 0;
+		idx->count++;
+
+		hash &= HTTP_HDR_IDX_BUCKETS - 1;
+		if (last[hash])
+			idx->ent[last[hash] - 1].next = idx->count;
+		else
+			idx->head[hash] = idx->count;
+		last[hash] = idx->count;
+	}
+	return idx;
+}
+
+/* Fills <ctx> with the header value <v> of block <blk>, trimmed of its leading
+ * and trailing spaces, and limited to the first value of a comma-separated
+ * list unless HTTP_FIND_FL_FULL is set in <flags>. Always returns 1.
+ */
+static inline int http_set_hdr_ctx(struct http_hdr_ctx *ctx, struct htx_blk *blk, struct ist v, int flags)
+{
+	ctx->lws_before = 0;
+	ctx->lws_after = 0;
+	while (v.len && HTTP_IS_LWS(*v.ptr)) {
+		v = istnext(v);
+		ctx->lws_before++;
+	}
+	if (!(flags & HTTP_FIND_FL_FULL))
+		v.len = http_find_hdr_value_end(v.ptr, istend(v)) - v.ptr;
+
+	while (v.len && HTTP_IS_LWS(*(istend(v) - 1))) {
+		v.len--;
+		ctx->lws_after++;
+	}
+	ctx->blk   = blk;
+	ctx->value = v;
+	return 1;
+}
+
+/* Same as __http_find_header() for an exact match on header name <name>, using
+ * the header index <idx> of the message <htx>.
+ */
+static int http_find_indexed_header(const struct htx *htx, const struct http_hdr_idx *idx,
+                                    const struct ist name, struct http_hdr_ctx *ctx, int flags)
+{
+	struct htx_blk *blk = ctx->blk;
+	int32_t pos = -1;
+	uint32_t hash;
+	struct ist v;
+	int e;
+
+	if (blk) {
+		pos = htx_get_blk_pos(htx, blk);
+		if (!isttest(ctx->value)) {
+			/* rescan the current block */
+			pos--;
+		}
+		else if (!(flags & HTTP_FIND_FL_FULL)) {
+			/* look for the next value in the current block */
+			char *p;
+
+			v = htx_get_blk_value(htx, blk);
+			p = istend(ctx->value) + ctx->lws_after;
+			v.len -= (p - v.ptr);
+			v.ptr  = p;
+			if (v.len) {
+				/* Skip comma */
+				if (*(v.ptr) == ',')
+					v = istnext(v);
+				return http_set_hdr_ctx(ctx, blk, v, flags);
+			}
+		}
+	}
+
+	hash = http_hdr_idx_hash(name);
+	for (e = idx->head[hash & (HTTP_HDR_IDX_BUCKETS - 1)]; e; e = idx->ent[e - 1].next) {
+		if (idx->ent[e - 1].pos <= pos || idx->ent[e - 1].hash != hash)
+			continue;
+
+		blk = htx_get_blk(htx, idx->ent[e - 1].pos);
+		if (!isteqi(htx_get_blk_name(htx, blk), name))
+			continue;
+
+		return http_set_hdr_ctx(ctx, blk, htx_get_blk_value(htx, blk), flags);
+	}
+
+	ctx->blk   = NULL;
+	ctx->value = ist("");
+	ctx->lws_before = ctx->lws_after = 0;
+	return 0;
+}
+
 static int __http_find_header(const struct htx *htx, const void *pattern, struct http_hdr_ctx *ctx, int flags)
 {
 	struct htx_blk *blk = ctx->blk;
+	const struct http_hdr_idx *idx;
 	struct ist n, v;
 	enum htx_blk_type type;
 
+	if ((flags & HTTP_FIND_FL_MATCH_TYPE) == HTTP_FIND_FL_MATCH_STR &&
+	    istlen(*(const struct ist *)pattern) && !htx_is_empty(htx) &&
+	    (idx = http_get_hdr_idx(htx)) != NULL)
+		return http_find_indexed_header(htx, idx, *(const struct ist *)pattern, ctx, flags);
+
 	if (blk) {
 		char *p;
 
@@ -214,22 +381,7 @@ static int __http_find_header(const struct htx *htx, const void *pattern, struct
 		v = htx_get_blk_value(htx, blk);
 
 	  return_hdr:
-		ctx->lws_before = 0;
-		ctx->lws_after = 0;
-		while (v.len && HTTP_IS_LWS(*v.ptr)) {
-			v = istnext(v);
-			ctx->lws_before++;
-		}
-		if (!(flags & HTTP_FIND_FL_FULL))
-			v.len = http_find_hdr_value_end(v.ptr, istend(v)) - v.ptr;
-
-		while (v.len && HTTP_IS_LWS(*(istend(v) - 1))) {
-			v.len--;
-			ctx->lws_after++;
-		}
-		ctx->blk   = blk;
-		ctx->value = v;
-		return 1;
+		return http_set_hdr_ctx(ctx, blk, v, flags);
 
 	  next_blk:
 		;
@@ -1805,6 +1957,20 @@ int http_scheme_based_normalize(struct htx *htx)
 	return 1;
 }
 
+/* Retrieves the RFC9218 priority of the request in <htx> from its "priority"
+ * header fields, if any, into <urgency> and <incremental>. Both are set to
+ * their default values first.
+ */
+void http_get_priority(const struct htx *htx, uint8_t *urgency, uint8_t *incremental)
+{
+	struct http_hdr_ctx ctx = { .blk = NULL };
+
+	*urgency = HTTP_PRIO_URGENCY_DEF;
+	*incremental = 0;
+	while (http_find_header(htx, ist("priority"), &ctx, 0))
+		http_parse_priority(ctx.value, urgency, incremental);
+}
+
 /* First step function to merge multiple cookie headers in a single entry.
  *
  * Use it for each cookie header at <idx> index over HTTP headers in <list>.
@@ -15,6 +15,14 @@
 
 struct htx htx_empty = { .size = 0, .data = 0, .head  = -1, .tail = -1, .first = -1 };
 
+/* number of full defragmentations performed by the current thread, used to
+ * attribute them to the rules causing them.
+ */
+THREAD_LOCAL unsigned int htx_defrag_cnt = 0;
+
+/* last generation number assigned by the current thread to an HTX message */
+THREAD_LOCAL uint32_t htx_last_gen = 0;
+
 /* Defragments an HTX message. It removes unused blocks and unwraps the payloads
  * part. A temporary buffer is used to do so. This function never fails. Most of
  * time, we need keep a ref on a specific HTX block. Thus is <blk> is set, the
@@ -80,7 +88,17 @@ struct htx_blk *htx_defrag(struct htx *htx, struct htx_blk *blk, uint32_t blkinf
 	htx->head_addr = htx->end_addr = 0;
 	htx->tail_addr = addr;
 	htx->flags &= ~HTX_FL_FRAGMENTED;
-	memcpy((void *)htx->blocks, (void *)tmp->blocks, htx->size);
+	htx_touch(htx);
+
+	/* only copy back the payloads and the blocks table, the area between
+	 * them is free and copying it would dominate the cost for the small
+	 * messages being rewritten.
+	 */
+	memcpy((void *)htx->blocks, (void *)tmp->blocks, addr);
+	memcpy((void *)htx->blocks + htx_pos_to_addr(htx, new - 1),
+	       (void *)tmp->blocks + htx_pos_to_addr(tmp, new - 1),
+	       new * sizeof(struct htx_blk));
+	htx_defrag_cnt++;
 
 	return ((blkpos == -1) ? NULL : htx_get_blk(htx, blkpos));
 }
@@ -115,6 +133,7 @@ static void htx_defrag_blks(struct htx *htx)
 	BUG_ON(!new);
 	htx->head = 0;
 	htx->tail = new - 1;
+	htx_touch(htx);
 }
 
 /* Reserves a new block in the HTX message <htx> with a content of <blksz>
@@ -131,6 +150,7 @@ static struct htx_blk *htx_reserve_nxblk(struct htx *htx, uint32_t blksz)
 	if (blksz > htx_free_data_space(htx))
 		return NULL; /* full */
 
+	htx_touch(htx);
 	if (htx->head == -1) {
 		/* Empty message */
 		htx->head = htx->tail = htx->first = 0;
@@ -338,6 +358,7 @@ struct htx_blk *htx_remove_blk(struct htx *htx, struct htx_blk *blk)
 
 	BUG_ON(!blk || htx->head == -1);
 
+	htx_touch(htx);
 	/* This is the last block in use */
 	if (htx->head == htx->tail) {
 		uint32_t flags = (htx->flags & ~HTX_FL_FRAGMENTED); /* Preserve flags except FRAGMENTED */
@@ -805,6 +826,7 @@ struct htx_blk *htx_replace_header(struct htx *htx, struct htx_blk *blk,
 	}
 
 	/* Finally, copy data. */
+	htx_touch(htx);
 	ptr = htx_get_blk_ptr(htx, blk);
 	ist2bin_lc(ptr, name);
 	memcpy(ptr + name.len, value.ptr, value.len);
@@ -1039,6 +1061,7 @@ void htx_move_blk_before(struct htx *htx, struct htx_blk **blk, struct htx_blk *
 {
 	struct htx_blk *cblk, *pblk;
 
+	htx_touch(htx);
 	cblk = *blk;
 	for (pblk = htx_get_prev_blk(htx, cblk); pblk; pblk = htx_get_prev_blk(htx, pblk)) {
 		/* Swap .addr and .info fields */
@@ -14,16 +14,34 @@
 #include <import/ebsttree.h>
 
 #include <haproxy/api.h>
+#include <haproxy/applet.h>
+#include <haproxy/cfgparse.h>
+#include <haproxy/cli.h>
 #include <haproxy/tools.h>
 #include <haproxy/openssl-compat.h>
 #include <haproxy/base64.h>
 #include <haproxy/jwt.h>
+#include <haproxy/log.h>
+#include <haproxy/net_helper.h>
 
 
 #ifdef USE_OPENSSL
 /* Tree into which the public certificates used to validate JWTs will be stored. */
 static struct eb_root jwt_cert_tree = EB_ROOT_UNIQUE;
 
+/* Per-thread cache of RSA/ECDSA signature verification results, indexed by
+ * the SHA-256 of the algorithm, key and token. The result of such a
+ * verification never changes for a given token and key while being expensive
+ * to compute, and the same tokens are usually presented many times.
+ */
+static unsigned int jwt_cache_size = JWT_CACHE_DEF_SIZE;
+static THREAD_LOCAL struct jwt_cache_entry *jwt_cache = NULL;
+static THREAD_LOCAL EVP_MD_CTX *jwt_cache_md_ctx = NULL;
+static struct {
+	unsigned long long hits;
+	unsigned long long misses;
+} jwt_cache_stats[MAX_THREADS];
+
 /*
  * The possible algorithm strings that can be found in a JWS's JOSE header are
  * defined in section 3.1 of RFC7518.
@@ -273,6 +291,61 @@ jwt_jwsverify_rsa_ecdsa(const struct jwt_ctx *ctx, const struct buffer *decoded_
 	return retval;
 }
 
+/*
+ * Computes into <digest> the key of the verification cache entry for <token>
+ * verified with algorithm <alg> and key <key>, and looks it up. Returns the
+ * entry if it matches (in which case its result may be used), otherwise NULL.
+ * <digest> is left empty if the cache is disabled or the digest could not be
+ * computed.
+ */
+static struct jwt_cache_entry *jwt_cache_lookup(enum jwt_alg alg, const struct buffer *token,
+                                                const struct buffer *key, unsigned char *digest)
+{
+	struct jwt_cache_entry *entry;
+
+	memset(digest, 0, SHA256_DIGEST_LENGTH);
+	if (!jwt_cache)
+		return NULL;
+
+	if (EVP_DigestInit_ex(jwt_cache_md_ctx, EVP_sha256(), NULL) != 1 ||
+	    EVP_DigestUpdate(jwt_cache_md_ctx, &alg, sizeof(alg)) != 1 ||
+	    EVP_DigestUpdate(jwt_cache_md_ctx, &key->data, sizeof(key->data)) != 1 ||
+	    EVP_DigestUpdate(jwt_cache_md_ctx, key->area, key->data) != 1 ||
+	    EVP_DigestUpdate(jwt_cache_md_ctx, token->area, token->data) != 1 ||
+	    EVP_DigestFinal_ex(jwt_cache_md_ctx, digest, NULL) != 1) {
+		memset(digest, 0, SHA256_DIGEST_LENGTH);
+		return NULL;
+	}
+
+	entry = &jwt_cache[read_u32(digest) & (jwt_cache_size - 1)];
+	if (entry->used && memcmp(entry->digest, digest, SHA256_DIGEST_LENGTH) == 0) {
+		jwt_cache_stats[tid].hits++;
+		return entry;
+	}
+
+	jwt_cache_stats[tid].misses++;
+	return NULL;
+}
+
+/* Stores verification result <status> for <digest> into the cache, replacing
+ * any previous entry at the same place. Only definitive results are stored.
+ */
+static void jwt_cache_store(const unsigned char *digest, enum jwt_vrfy_status status)
+{
+	struct jwt_cache_entry *entry;
+
+	if (!jwt_cache || (status != JWT_VRFY_OK && status != JWT_VRFY_KO))
+		return;
+
+	if (!read_u32(digest) && !memcmp(digest, digest + 4, SHA256_DIGEST_LENGTH - 4))
+		return; /* no digest */
+
+	entry = &jwt_cache[read_u32(digest) & (jwt_cache_size - 1)];
+	memcpy(entry->digest, digest, SHA256_DIGEST_LENGTH);
+	entry->status = status;
+	entry->used = 1;
+}
+
 /*
  * Check that the <token> that was signed via algorithm <alg> using the <key>
  * (either an HMAC secret or the path to a public certificate) has a valid
@@ -287,6 +360,8 @@ enum jwt_vrfy_status jwt_verify(const struct buffer *token, const struct buffer
 	struct buffer *decoded_sig = NULL;
 	struct jwt_ctx ctx = {};
 	enum jwt_vrfy_status retval = JWT_VRFY_KO;
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+	struct jwt_cache_entry *entry;
 	int ret;
 
 	ctx.alg = jwt_parse_alg(alg->area, alg->data);
@@ -313,6 +388,14 @@ enum jwt_vrfy_status jwt_verify(const struct buffer *token, const struct buffer
 	if (ctx.signature.length == 0)
 		return JWT_VRFY_INVALID_TOKEN;
 
+	/* HMAC signatures are cheaper to compute than a cache key */
+	memset(digest, 0, sizeof(digest));
+	if (ctx.alg >= JWS_ALG_RS256 && ctx.alg <= JWS_ALG_ES512) {
+		entry = jwt_cache_lookup(ctx.alg, token, key, digest);
+		if (entry)
+			return entry->status;
+	}
+
 	decoded_sig = alloc_trash_chunk();
 	if (!decoded_sig)
 		return JWT_VRFY_OUT_OF_MEMORY;
@@ -347,6 +430,7 @@ enum jwt_vrfy_status jwt_verify(const struct buffer *token, const struct buffer
 		/* RSASSA-PKCS1-v1_5 + SHA-XXX */
 		/* ECDSA using P-XXX and SHA-XXX */
 		retval = jwt_jwsverify_rsa_ecdsa(&ctx, decoded_sig);
+		jwt_cache_store(digest, retval);
 		break;
 	case JWS_ALG_PS256:
 	case JWS_ALG_PS384:
@@ -381,5 +465,81 @@ static void jwt_deinit(void)
 }
 REGISTER_POST_DEINIT(jwt_deinit);
 
+/* Allocates the current thread's verification cache */
+static int jwt_alloc_cache_per_thread(void)
+{
+	if (!jwt_cache_size)
+		return 1;
+
+	jwt_cache = calloc(jwt_cache_size, sizeof(*jwt_cache));
+	jwt_cache_md_ctx = EVP_MD_CTX_new();
+	if (!jwt_cache || !jwt_cache_md_ctx) {
+		ha_alert("Failed to allocate the JWT verification cache.\n");
+		return 0;
+	}
+	return 1;
+}
+REGISTER_PER_THREAD_ALLOC(jwt_alloc_cache_per_thread);
+
+static void jwt_free_cache_per_thread(void)
+{
+	ha_free(&jwt_cache);
+	EVP_MD_CTX_free(jwt_cache_md_ctx);
+	jwt_cache_md_ctx = NULL;
+}
+REGISTER_PER_THREAD_FREE(jwt_free_cache_per_thread);
+
+/* config parser for global "tune.jwt.cache-size" */
+static int cfg_parse_jwt_cache_size(char **args, int section_type, struct proxy *curpx,
+                                    const struct proxy *defpx, const char *file, int line,
+                                    char **err)
+{
+	char *stop;
+	long size;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	size = strtol(args[1], &stop, 10);
+	if (!*args[1] || *stop || size < 0 || size > (1 << 24)) {
+		memprintf(err, "'%s' expects a number of entries between 0 and %d.", args[0], 1 << 24);
+		return -1;
+	}
+
+	/* round up to the next power of two */
+	jwt_cache_size = size ? 1U << my_flsl(size - 1) : 0;
+	return 0;
+}
+
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.jwt.cache-size", cfg_parse_jwt_cache_size },
+	{ 0, NULL, NULL }
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
+
+/* parses "show jwt cache" and reports the verification cache statistics */
+static int cli_parse_show_jwt_cache(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	unsigned long long hits = 0, misses = 0;
+	int thr;
+
+	for (thr = 0; thr < global.nbthread; thr++) {
+		hits   += jwt_cache_stats[thr].hits;
+		misses += jwt_cache_stats[thr].misses;
+	}
+
+	chunk_printf(&trash, "size: %u entries per thread\nhits: %llu\nmisses: %llu\n",
+	             jwt_cache_size, hits, misses);
+	return cli_msg(appctx, LOG_INFO, trash.area);
+}
+
+static struct cli_kw_list cli_kws = {{ },{
+	{ { "show", "jwt", "cache", NULL }, "show jwt cache                          : report JWT verification cache statistics", cli_parse_show_jwt_cache, NULL, NULL },
+	{{},}
+}};
+
+INITCALL1(STG_REGISTER, cli_register_kw, &cli_kws);
+
 
 #endif /* USE_OPENSSL */
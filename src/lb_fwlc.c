@@ -63,16 +63,57 @@ static inline void fwlc_queue_srv(struct server *s, unsigned int eweight)
 	eb32_insert(s->lb_tree, &s->lb_node);
 }
 
+/* Re-position the server in the FWLC tree according to its current number of
+ * connections. Note that it is possible that the server has been moved out of
+ * the tree due to failed health-checks, in which case nothing is done.
+ *
+ * The lbprm's lock must be held.
+ */
+static inline void __fwlc_srv_reposition(struct server *s)
+{
+	unsigned int inflight, eweight, new_key;
+
+	if (!s->lb_tree)
+		return;
+
+	inflight = _HA_ATOMIC_LOAD(&s->served) + _HA_ATOMIC_LOAD(&s->queue.length);
+	eweight = _HA_ATOMIC_LOAD(&s->cur_eweight);
+	new_key = inflight ? (inflight + 1) * SRV_EWGHT_MAX / (eweight ? eweight : 1) : 0;
+	if (!s->lb_node.node.leaf_p || s->lb_node.key != new_key) {
+		eb32_delete(&s->lb_node);
+		s->lb_node.key = new_key;
+		eb32_insert(s->lb_tree, &s->lb_node);
+	}
+}
+
+/* Re-position all the servers of proxy <p> whose repositioning was deferred
+ * because the lbprm's lock was not available ("lazy" mode). Each server
+ * appears at most once in the list, so all the connections it took or
+ * released in the mean time are accounted for at once.
+ *
+ * The lbprm's lock must be held.
+ */
+static inline void fwlc_reposition_pending(struct proxy *p)
+{
+	struct server *s;
+
+	while ((s = MT_LIST_POP(&p->lbprm.fwlc.pending, struct server *, lb_pending)))
+		__fwlc_srv_reposition(s);
+}
+
 /* Re-position the server in the FWLC tree after it has been assigned one
- * connection or after it has released one. Note that it is possible that
- * the server has been moved out of the tree due to failed health-checks.
- * The lbprm's lock will be used.
+ * connection or after it has released one. In "lazy" mode, if the lbprm's
+ * lock is already held, the server is only appended to the list of servers
+ * to reposition, and the next thread getting the lock will do it. Otherwise
+ * the lbprm's lock will be used.
  */
 static void fwlc_srv_reposition(struct server *s)
 {
+	struct proxy *p = s->proxy;
 	unsigned int inflight = _HA_ATOMIC_LOAD(&s->served) + _HA_ATOMIC_LOAD(&s->queue.length);
 	unsigned int eweight = _HA_ATOMIC_LOAD(&s->cur_eweight);
 	unsigned int new_key = inflight ? (inflight + 1) * SRV_EWGHT_MAX / (eweight ? eweight : 1) : 0;
+	int lazy = p->lbprm.arg_opt1 & 1;
 
 	/* some calls will be made for no change (e.g connect_server() after
 	 * assign_server(). Let's check that first.
@@ -80,23 +121,24 @@ static void fwlc_srv_reposition(struct server *s)
 	if (s->lb_node.node.leaf_p && eweight && s->lb_node.key == new_key)
 		return;
 
-	HA_RWLOCK_WRLOCK(LBPRM_LOCK, &s->proxy->lbprm.lock);
-	if (s->lb_tree) {
-		/* we might have been waiting for a while on the lock above
-		 * so it's worth testing again because other threads are very
-		 * likely to have released a connection or taken one leading
-		 * to our target value (50% of the case in measurements).
-		 */
-		inflight = _HA_ATOMIC_LOAD(&s->served) + _HA_ATOMIC_LOAD(&s->queue.length);
-		eweight = _HA_ATOMIC_LOAD(&s->cur_eweight);
-		new_key = inflight ? (inflight + 1) * SRV_EWGHT_MAX / (eweight ? eweight : 1) : 0;
-		if (!s->lb_node.node.leaf_p || s->lb_node.key != new_key) {
-			eb32_delete(&s->lb_node);
-			s->lb_node.key = new_key;
-			eb32_insert(s->lb_tree, &s->lb_node);
+	if (lazy) {
+		if (HA_RWLOCK_TRYWRLOCK(LBPRM_LOCK, &p->lbprm.lock) != 0) {
+			MT_LIST_TRY_APPEND(&p->lbprm.fwlc.pending, &s->lb_pending);
+			return;
 		}
 	}
-	HA_RWLOCK_WRUNLOCK(LBPRM_LOCK, &s->proxy->lbprm.lock);
+	else
+		HA_RWLOCK_WRLOCK(LBPRM_LOCK, &p->lbprm.lock);
+
+	/* we might have been waiting for a while on the lock above so it's
+	 * worth testing again because other threads are very likely to have
+	 * released a connection or taken one leading to our target value (50%
+	 * of the case in measurements).
+	 */
+	__fwlc_srv_reposition(s);
+	if (lazy)
+		fwlc_reposition_pending(p);
+	HA_RWLOCK_WRUNLOCK(LBPRM_LOCK, &p->lbprm.lock);
 }
 
 /* This function updates the server trees according to server <srv>'s new
@@ -304,6 +346,7 @@ void fwlc_init_server_tree(struct proxy *p)
 
 	p->lbprm.fwlc.act = init_head;
 	p->lbprm.fwlc.bck = init_head;
+	MT_LIST_INIT(&p->lbprm.fwlc.pending);
 
 	/* queue active and backup servers in two distinct groups */
 	for (srv = p->srv; srv; srv = srv->next) {
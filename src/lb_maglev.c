@@ -0,0 +1,320 @@
+/*
+ * Maglev Hash implementation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ *
+ * The servers are spread over a lookup table whose size is a prime number
+ * about 100 times larger than the number of servers, and a hash key is simply
+ * mapped to the table entry of index (key % size). Each server has its own
+ * permutation of the table's entries, derived from its ID, and the servers
+ * take turns at claiming the next free entry of their permutation until the
+ * table is full. Servers with a higher weight take more turns. This results
+ * in a very even distribution and since the permutations do not depend on
+ * the other servers, a server going up or down mostly moves its own entries.
+ *
+ * The table is rebuilt under the lbprm's lock on each state or weight change,
+ * while the lookups only read one entry.
+ */
+
+#include <haproxy/api.h>
+#include <haproxy/backend.h>
+#include <haproxy/errors.h>
+#include <haproxy/lb_chash.h>
+#include <haproxy/lb_maglev.h>
+#include <haproxy/queue.h>
+#include <haproxy/server-t.h>
+#include <haproxy/tools.h>
+
+/* table sizes, prime numbers, the smallest one larger than 100 times the
+ * number of servers is used.
+ */
+static const unsigned int maglev_sizes[] = {
+	1021, 2039, 4093, 8191, 16381, 32749, 65521,
+	131071, 262139, 524287, 1048573, 2097143, 4194301,
+};
+
+/* Returns non-zero if server <s> may be selected. It must not be <avoid>, it
+ * must have some room left if <bounded> is set ("hash-balance-factor"), and
+ * it must not be saturated if <skip_full> is set.
+ */
+static inline int maglev_server_is_acceptable(struct server *s, const struct server *avoid,
+                                              int bounded, int skip_full)
+{
+	if (s == avoid)
+		return 0;
+	if (bounded && !chash_server_is_eligible(s))
+		return 0;
+	if (skip_full && s->maxconn &&
+	    (s->queue.length || s->served >= srv_dynamic_maxconn(s)))
+		return 0;
+	return 1;
+}
+
+/* Returns the server of the table of proxy <p> for hash key <hash>. If this
+ * server is not acceptable (see maglev_server_is_acceptable()), the following
+ * entries are checked, up to twice the number of servers present in the
+ * table, and the first acceptable one is returned. If none is found, the
+ * first choice is returned. NULL is only returned if the table is empty.
+ */
+static struct server *maglev_lookup(const struct lb_maglev *mg, unsigned int hash,
+                                    const struct server *avoid, int bounded, int skip_full)
+{
+	unsigned int idx, tries;
+	struct server *srv;
+
+	if (!mg->nb_srv)
+		return NULL;
+
+	idx = hash % mg->size;
+	if (maglev_server_is_acceptable(mg->table[idx], avoid, bounded, skip_full))
+		return mg->table[idx];
+
+	srv = mg->table[idx];
+	for (tries = 2 * mg->nb_srv; tries; tries--) {
+		if (++idx >= mg->size)
+			idx = 0;
+		if (maglev_server_is_acceptable(mg->table[idx], avoid, bounded, skip_full))
+			return mg->table[idx];
+	}
+	return srv;
+}
+
+/* Makes sure the table and the work area of proxy <p> are large enough for
+ * <count> servers. The table only grows, which means that its content is
+ * entirely redistributed, when servers are added beyond the size the table
+ * was designed for. Returns 0 on success or -1 on allocation failure, in
+ * which case the previous table and work area are preserved.
+ *
+ * The lbprm's lock must be held.
+ */
+static int maglev_alloc(struct proxy *p, unsigned int count)
+{
+	struct lb_maglev *mg = &p->lbprm.maglev;
+	struct server **table = NULL;
+	struct maglev_srv *work = NULL;
+	unsigned int size, i;
+
+	for (i = 0; i < sizeof(maglev_sizes) / sizeof(*maglev_sizes) - 1; i++) {
+		if (maglev_sizes[i] / 100 >= count)
+			break;
+	}
+	size = maglev_sizes[i];
+
+	if (size > mg->size) {
+		table = calloc(size, sizeof(*table));
+		if (!table)
+			goto fail;
+	}
+
+	if (count > mg->nb_work) {
+		work = calloc(count, sizeof(*work));
+		if (!work)
+			goto fail;
+	}
+
+	if (table) {
+		free(mg->table);
+		mg->table = table;
+		mg->size = size;
+		mg->nb_srv = 0;
+	}
+
+	if (work) {
+		free(mg->work);
+		mg->work = work;
+		mg->nb_work = count;
+	}
+	return 0;
+
+ fail:
+	free(table);
+	free(work);
+	return -1;
+}
+
+/* Repopulates the lookup table of proxy <p> from the servers' next state and
+ * weight. It contains the usable active servers if any, otherwise the usable
+ * backup servers if the first backup server is not the only one to be used.
+ * It is designed to be called before the servers' status commit, after the
+ * servers were recounted. Returns 0 on success or -1 if the table could not
+ * be grown, in which case it is left unchanged.
+ *
+ * The lbprm's lock must be held.
+ */
+static int maglev_rebuild(struct proxy *p)
+{
+	struct lb_maglev *mg = &p->lbprm.maglev;
+	struct maglev_srv *ms;
+	struct server *srv;
+	unsigned int count = 0, nb = 0, max_weight = 0, filled = 0;
+	unsigned int backup, i;
+
+	for (srv = p->srv; srv; srv = srv->next)
+		count++;
+
+	if (maglev_alloc(p, count ? count : 1) < 0)
+		return -1;
+
+	mg->nb_srv = 0;
+	if (!p->srv_act && (p->lbprm.fbck || !p->srv_bck))
+		return 0;
+
+	backup = p->srv_act ? 0 : SRV_F_BACKUP;
+	for (srv = p->srv; srv; srv = srv->next) {
+		unsigned int h;
+
+		if (!srv_willbe_usable(srv) || (srv->flags & SRV_F_BACKUP) != backup)
+			continue;
+
+		h = full_hash(srv->puid);
+		ms = &mg->work[nb++];
+		ms->srv    = srv;
+		ms->pos    = h % mg->size;
+		ms->skip   = full_hash(h) % (mg->size - 1) + 1;
+		ms->weight = srv->next_eweight;
+		ms->credit = 0;
+		if (ms->weight > max_weight)
+			max_weight = ms->weight;
+	}
+
+	if (!nb)
+		return 0;
+
+	memset(mg->table, 0, mg->size * sizeof(*mg->table));
+
+	/* Each round, every server accumulates its weight, and claims one
+	 * entry per max weight it holds. The heaviest servers thus claim one
+	 * entry per round, guaranteeing the progress. Since the size is
+	 * prime, each permutation covers the whole table, so a free entry is
+	 * always found.
+	 */
+	while (filled < mg->size) {
+		for (i = 0; i < nb && filled < mg->size; i++) {
+			ms = &mg->work[i];
+			ms->credit += ms->weight;
+			while (ms->credit >= max_weight && filled < mg->size) {
+				while (mg->table[ms->pos]) {
+					ms->pos += ms->skip;
+					if (ms->pos >= mg->size)
+						ms->pos -= mg->size;
+				}
+				mg->table[ms->pos] = ms->srv;
+				ms->credit -= max_weight;
+				filled++;
+			}
+		}
+	}
+
+	mg->nb_srv = nb;
+	return 0;
+}
+
+/* This function updates the lookup table according to server <srv>'s new
+ * state or weight. It is used for state changes to up or down as well as for
+ * weight changes, since the table is entirely repopulated in any case.
+ *
+ * The server's lock must be held. The lbprm lock will be used.
+ */
+static void maglev_update_server(struct server *srv)
+{
+	struct proxy *p = srv->proxy;
+
+	if (!srv_lb_status_changed(srv))
+		return;
+
+	HA_RWLOCK_WRLOCK(LBPRM_LOCK, &p->lbprm.lock);
+
+	/* check/update the servers counts and weights, then the table */
+	recount_servers(p);
+	update_backend_weight(p);
+	maglev_rebuild(p);
+	srv_lb_commit_status(srv);
+
+	HA_RWLOCK_WRUNLOCK(LBPRM_LOCK, &p->lbprm.lock);
+}
+
+/* This function returns the running server from the lookup table of proxy
+ * <p> matching <hash>. It will skip server <avoid>, and the servers having no
+ * room left if "hash-balance-factor" is set. If no valid server is found, NULL
+ * is returned.
+ *
+ * The lbprm's lock will be used in R/O mode. The server's lock is not used.
+ */
+struct server *maglev_get_server_hash(struct proxy *p, unsigned int hash, const struct server *avoid)
+{
+	struct server *srv;
+
+	HA_RWLOCK_RDLOCK(LBPRM_LOCK, &p->lbprm.lock);
+
+	if (!p->srv_act && p->lbprm.fbck)
+		srv = p->lbprm.fbck;
+	else
+		srv = maglev_lookup(&p->lbprm.maglev, hash, avoid, p->lbprm.hash_balance_factor, 0);
+
+	HA_RWLOCK_RDUNLOCK(LBPRM_LOCK, &p->lbprm.lock);
+	return srv;
+}
+
+/* Return the next server from the lookup table of proxy <p>, which is used when
+ * no hash key is available. A random key is used so that the servers are
+ * picked according to their weights. Saturated servers are skipped. If no
+ * server is available, NULL is returned.
+ *
+ * The lbprm's lock will be used in R/O mode. The server's lock is not used.
+ */
+struct server *maglev_get_next_server(struct proxy *p, struct server *srvtoavoid)
+{
+	unsigned int hash = statistical_prng();
+	struct server *srv;
+
+	HA_RWLOCK_RDLOCK(LBPRM_LOCK, &p->lbprm.lock);
+
+	if (!p->srv_act && p->lbprm.fbck)
+		srv = p->lbprm.fbck;
+	else
+		srv = maglev_lookup(&p->lbprm.maglev, hash, srvtoavoid, 0, 1);
+
+	HA_RWLOCK_RDUNLOCK(LBPRM_LOCK, &p->lbprm.lock);
+	return srv;
+}
+
+/* This function is responsible for building the lookup table for Maglev
+ * hashing. It also sets p->lbprm.wdiv to the eweight to uweight ratio.
+ * Return 0 in case of success, -1 in case of allocation failure.
+ */
+int maglev_init_server_tree(struct proxy *p)
+{
+	struct server *srv;
+
+	p->lbprm.set_server_status_up   = maglev_update_server;
+	p->lbprm.set_server_status_down = maglev_update_server;
+	p->lbprm.update_server_eweight  = maglev_update_server;
+	p->lbprm.server_take_conn = NULL;
+	p->lbprm.server_drop_conn = NULL;
+
+	p->lbprm.wdiv = BE_WEIGHT_SCALE;
+	for (srv = p->srv; srv; srv = srv->next) {
+		srv->next_eweight = (srv->uweight * p->lbprm.wdiv + p->lbprm.wmult - 1) / p->lbprm.wmult;
+		srv_lb_commit_status(srv);
+	}
+
+	recount_servers(p);
+	update_backend_weight(p);
+
+	memset(&p->lbprm.maglev, 0, sizeof(p->lbprm.maglev));
+	if (maglev_rebuild(p) < 0) {
+		ha_alert("failed to allocate the maglev hash table for backend %s.\n", p->id);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ */
@@ -0,0 +1,301 @@
+/*
+ * Rendezvous (Highest Random Weight) Hash implementation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ *
+ * Each server gets a score for the hash key, which is computed from the key
+ * mixed with a seed derived from the server's ID, and from the server's
+ * weight. The server with the best score is selected. When a server goes up
+ * or down, only the keys it wins are moved, and the probability for a server
+ * to win a key is exactly proportional to its weight. The score is computed
+ * as -ln(u)/weight, with u a uniform value within ]0;1[ derived from the key
+ * and the seed, the lowest score winning. This value follows an exponential
+ * distribution of rate <weight>, and the probability for one of them to be the
+ * lowest is the ratio of its rate to the sum of all rates.
+ *
+ * There is neither a tree nor a ring: the usable servers are stored in compact
+ * arrays which are rebuilt under the lbprm's lock on each state or weight
+ * change, and the lookups only scan these arrays.
+ */
+
+#include <haproxy/api.h>
+#include <haproxy/backend.h>
+#include <haproxy/errors.h>
+#include <haproxy/intops.h>
+#include <haproxy/lb_chash.h>
+#include <haproxy/lb_rdv.h>
+#include <haproxy/queue.h>
+#include <haproxy/server-t.h>
+#include <haproxy/tools.h>
+
+/* Returns the score of the server of seed <seed> and inverted weight
+ * <inv_weight> for hash key <hash>. The lower, the better. The logarithm is
+ * approximated with a polynomial on the mantissa, which is accurate to about
+ * 2e-4 and does not depend on the libm, so that the loop computing the scores
+ * of all servers remains short and branchless.
+ */
+static inline float rdv_score(unsigned int hash, unsigned int seed, float inv_weight)
+{
+	union { float f; unsigned int i; } u;
+	float m, l;
+	int e;
+
+	/* map the mixed key to a value within ]0;1[ */
+	u.f = ((__full_hash(hash ^ seed) >> 8) + 0.5f) * (1.0f / 16777216.0f);
+
+	/* log2(u) = exponent + log2(mantissa), with the mantissa within [1;2[ */
+	e = (int)((u.i >> 23) & 0xff) - 127;
+	u.i = (u.i & 0x007fffff) | 0x3f800000;
+	m = u.f;
+	l = e + ((((-0.079153817f * m + 0.62884138f) * m - 2.0811285f) * m + 4.0284505f) * m - 2.4968058f);
+	return -l * inv_weight;
+}
+
+/* Returns non-zero if server <s> may be selected. It must not be <avoid>, it
+ * must have some room left if <bounded> is set ("hash-balance-factor"), and
+ * it must not be saturated if <skip_full> is set.
+ */
+static inline int rdv_server_is_acceptable(struct server *s, const struct server *avoid,
+                                           int bounded, int skip_full)
+{
+	if (s == avoid)
+		return 0;
+	if (bounded && !chash_server_is_eligible(s))
+		return 0;
+	if (skip_full && s->maxconn &&
+	    (s->queue.length || s->served >= srv_dynamic_maxconn(s)))
+		return 0;
+	return 1;
+}
+
+/* Returns the server of group <grp> with the best score for hash key <hash>.
+ * If this server is not acceptable (see rdv_server_is_acceptable()), the
+ * acceptable one with the best score is returned instead, if any. This is
+ * equivalent to walking over the servers by decreasing scores until an
+ * acceptable one is found. NULL is only returned if the group is empty.
+ */
+static struct server *rdv_pick(const struct rdv_grp *grp, unsigned int hash,
+                               const struct server *avoid, int bounded, int skip_full)
+{
+	float score, best_score, alt_score = 0;
+	int i, best, alt;
+
+	if (!grp->nb)
+		return NULL;
+
+	best = 0;
+	best_score = rdv_score(hash, grp->seed[0], grp->inv_weight[0]);
+	for (i = 1; i < grp->nb; i++) {
+		score = rdv_score(hash, grp->seed[i], grp->inv_weight[i]);
+		if (score < best_score) {
+			best_score = score;
+			best = i;
+		}
+	}
+
+	if (rdv_server_is_acceptable(grp->srv[best], avoid, bounded, skip_full))
+		return grp->srv[best];
+
+	/* the first choice was disqualified, let's find the next acceptable
+	 * one. If there is none, we stick to the first choice.
+	 */
+	alt = -1;
+	for (i = 0; i < grp->nb; i++) {
+		if (i == best)
+			continue;
+		if (!rdv_server_is_acceptable(grp->srv[i], avoid, bounded, skip_full))
+			continue;
+		score = rdv_score(hash, grp->seed[i], grp->inv_weight[i]);
+		if (alt < 0 || score < alt_score) {
+			alt_score = score;
+			alt = i;
+		}
+	}
+	return grp->srv[alt >= 0 ? alt : best];
+}
+
+/* Allocates the arrays of both groups of proxy <p> for <size> servers each.
+ * The previous arrays are released, their content is lost. Returns 0 on
+ * success or -1 on allocation failure, in which case the previous arrays are
+ * preserved.
+ *
+ * The lbprm's lock must be held.
+ */
+static int rdv_alloc(struct proxy *p, unsigned int size)
+{
+	struct lb_rdv *rdv = &p->lbprm.rdv;
+	void *area;
+
+	area = calloc(2 * size, sizeof(*rdv->act.srv) + sizeof(*rdv->act.seed) + sizeof(*rdv->act.inv_weight));
+	if (!area)
+		return -1;
+
+	free(rdv->area);
+	rdv->area = area;
+	rdv->size = size;
+
+	/* pointers first, then 32-bit values, to respect alignments */
+	rdv->act.srv        = area;
+	rdv->bck.srv        = rdv->act.srv + size;
+	rdv->act.seed       = (unsigned int *)(rdv->bck.srv + size);
+	rdv->bck.seed       = rdv->act.seed + size;
+	rdv->act.inv_weight = (float *)(rdv->bck.seed + size);
+	rdv->bck.inv_weight = rdv->act.inv_weight + size;
+	rdv->act.nb = rdv->bck.nb = 0;
+	return 0;
+}
+
+/* Rebuilds the groups of servers of proxy <p> from the servers' next state
+ * and weight. It is designed to be called before the servers' status commit.
+ * Returns 0 on success or -1 if the arrays could not be grown, in which case
+ * they are left unchanged.
+ *
+ * The lbprm's lock must be held.
+ */
+static int rdv_rebuild(struct proxy *p)
+{
+	struct lb_rdv *rdv = &p->lbprm.rdv;
+	struct server *srv;
+	unsigned int count = 0;
+
+	for (srv = p->srv; srv; srv = srv->next)
+		count++;
+
+	if ((count > rdv->size || !rdv->area) && rdv_alloc(p, count ? count : 1) < 0)
+		return -1;
+
+	rdv->act.nb = rdv->bck.nb = 0;
+	for (srv = p->srv; srv; srv = srv->next) {
+		struct rdv_grp *grp;
+
+		if (!srv_willbe_usable(srv))
+			continue;
+
+		grp = (srv->flags & SRV_F_BACKUP) ? &rdv->bck : &rdv->act;
+		grp->srv[grp->nb]        = srv;
+		grp->seed[grp->nb]       = full_hash(srv->puid);
+		grp->inv_weight[grp->nb] = 1.0f / srv->next_eweight;
+		grp->nb++;
+	}
+	return 0;
+}
+
+/* This function updates the servers groups according to server <srv>'s new
+ * state or weight. It is used for state changes to up or down as well as for
+ * weight changes, since the groups are entirely rebuilt in any case.
+ *
+ * The server's lock must be held. The lbprm lock will be used.
+ */
+static void rdv_update_server(struct server *srv)
+{
+	struct proxy *p = srv->proxy;
+
+	if (!srv_lb_status_changed(srv))
+		return;
+
+	HA_RWLOCK_WRLOCK(LBPRM_LOCK, &p->lbprm.lock);
+
+	/* check/update the servers counts and weights, then the groups */
+	recount_servers(p);
+	update_backend_weight(p);
+	rdv_rebuild(p);
+	srv_lb_commit_status(srv);
+
+	HA_RWLOCK_WRUNLOCK(LBPRM_LOCK, &p->lbprm.lock);
+}
+
+/* This function returns the running server from the groups of proxy <p>
+ * having the best score for <hash>. It will skip server <avoid>, and the
+ * servers having no room left if "hash-balance-factor" is set. If no valid
+ * server is found, NULL is returned.
+ *
+ * The lbprm's lock will be used in R/O mode. The server's lock is not used.
+ */
+struct server *rdv_get_server_hash(struct proxy *p, unsigned int hash, const struct server *avoid)
+{
+	struct server *srv;
+
+	HA_RWLOCK_RDLOCK(LBPRM_LOCK, &p->lbprm.lock);
+
+	if (p->srv_act)
+		srv = rdv_pick(&p->lbprm.rdv.act, hash, avoid, p->lbprm.hash_balance_factor, 0);
+	else if (p->lbprm.fbck)
+		srv = p->lbprm.fbck;
+	else if (p->srv_bck)
+		srv = rdv_pick(&p->lbprm.rdv.bck, hash, avoid, p->lbprm.hash_balance_factor, 0);
+	else
+		srv = NULL;
+
+	HA_RWLOCK_RDUNLOCK(LBPRM_LOCK, &p->lbprm.lock);
+	return srv;
+}
+
+/* Return the next server from the groups of proxy <p>, which is used when no
+ * hash key is available. A random key is used so that the servers are picked
+ * according to their weights. Saturated servers are skipped. If no server is
+ * available, NULL is returned.
+ *
+ * The lbprm's lock will be used in R/O mode. The server's lock is not used.
+ */
+struct server *rdv_get_next_server(struct proxy *p, struct server *srvtoavoid)
+{
+	unsigned int hash = statistical_prng();
+	struct server *srv;
+
+	HA_RWLOCK_RDLOCK(LBPRM_LOCK, &p->lbprm.lock);
+
+	if (p->srv_act)
+		srv = rdv_pick(&p->lbprm.rdv.act, hash, srvtoavoid, 0, 1);
+	else if (p->lbprm.fbck)
+		srv = p->lbprm.fbck;
+	else if (p->srv_bck)
+		srv = rdv_pick(&p->lbprm.rdv.bck, hash, srvtoavoid, 0, 1);
+	else
+		srv = NULL;
+
+	HA_RWLOCK_RDUNLOCK(LBPRM_LOCK, &p->lbprm.lock);
+	return srv;
+}
+
+/* This function is responsible for building the active and backup groups of
+ * servers for rendezvous hashing. It also sets p->lbprm.wdiv to the eweight
+ * to uweight ratio.
+ * Return 0 in case of success, -1 in case of allocation failure.
+ */
+int rdv_init_server_tree(struct proxy *p)
+{
+	struct server *srv;
+
+	p->lbprm.set_server_status_up   = rdv_update_server;
+	p->lbprm.set_server_status_down = rdv_update_server;
+	p->lbprm.update_server_eweight  = rdv_update_server;
+	p->lbprm.server_take_conn = NULL;
+	p->lbprm.server_drop_conn = NULL;
+
+	p->lbprm.wdiv = BE_WEIGHT_SCALE;
+	for (srv = p->srv; srv; srv = srv->next) {
+		srv->next_eweight = (srv->uweight * p->lbprm.wdiv + p->lbprm.wmult - 1) / p->lbprm.wmult;
+		srv_lb_commit_status(srv);
+	}
+
+	recount_servers(p);
+	update_backend_weight(p);
+
+	p->lbprm.rdv.area = NULL;
+	p->lbprm.rdv.size = 0;
+	if (rdv_rebuild(p) < 0) {
+		ha_alert("failed to allocate the rendezvous hash groups for backend %s.\n", p->id);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ */
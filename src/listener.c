@@ -22,6 +22,9 @@
 #include <haproxy/cfgparse.h>
 #include <haproxy/cli-t.h>
 #include <haproxy/connection.h>
+#ifdef USE_CPU_AFFINITY
+#include <haproxy/cpuset.h>
+#endif
 #include <haproxy/errors.h>
 #include <haproxy/fd.h>
 #include <haproxy/freq_ctr.h>
@@ -821,6 +824,36 @@ int listener_backlog(const struct listener *l)
 	return 1024;
 }
 
+/* Returns the only CPU the threads of listener <l> are bound to according to
+ * the "cpu-map" directives, or -1 if they are bound to several CPUs or not
+ * bound at all. A thread without its own CPU map uses its group's one. The
+ * listener's thread group must already be resolved.
+ */
+int listener_single_cpu(struct listener *l)
+{
+#ifdef USE_CPU_AFFINITY
+	struct cpu_map *map;
+	struct hap_cpuset cpus;
+	ulong mask = l->rx.bind_thread;
+	uint thr;
+
+	if (!l->rx.bind_tgroup)
+		return -1;
+
+	map = &cpu_map[l->rx.bind_tgroup - 1];
+	ha_cpuset_zero(&cpus);
+	while (mask) {
+		thr = my_ffsl(mask) - 1;
+		mask &= mask - 1;
+		ha_cpuset_or(&cpus, ha_cpuset_count(&map->thread[thr]) ? &map->thread[thr] : &map->proc);
+	}
+
+	if (ha_cpuset_count(&cpus) == 1)
+		return ha_cpuset_ffs(&cpus) - 1;
+#endif
+	return -1;
+}
+
 /* This function is called on a read event from a listening socket, corresponding
  * to an accept. It tries to accept as many connections as possible, and for each
  * calls the listener's accept handler (generally the frontend's accept handler).
@@ -843,6 +876,16 @@ void listener_accept(struct listener *l)
 	 */
 	max_accept = l->maxaccept ? l->maxaccept : 1;
 
+	if (!(l->options & LI_O_UNLIMITED) && unlikely(process_overloaded())) {
+		/* most threads are late on their work, let's stop accepting
+		 * new connections (and TLS handshakes) for a while so that
+		 * the established ones are still served in time.
+		 */
+		activity[tid].ovl_paused++;
+		expire = tick_add(now_ms, 100); /* try again in 100 ms */
+		goto limit_global;
+	}
+
 	if (!(l->options & LI_O_UNLIMITED) && global.sps_lim) {
 		int max = freq_ctr_remain(&global.sess_per_sec, global.sps_lim, 0);
 
@@ -1787,7 +1830,7 @@ static int bind_parse_proto(char **args, int cur_arg, struct proxy *px, struct b
 	return 0;
 }
 
-/* parse the "shards" bind keyword. Takes an integer or "by-thread" */
+/* parse the "shards" bind keyword. Takes an integer, "by-thread" or "by-group" */
 static int bind_parse_shards(char **args, int cur_arg, struct proxy *px, struct bind_conf *conf, char **err)
 {
 	int val;
@@ -1799,10 +1842,12 @@ static int bind_parse_shards(char **args, int cur_arg, struct proxy *px, struct
 
 	if (strcmp(args[cur_arg + 1], "by-thread") == 0) {
 		val = MAX_THREADS; /* will be trimmed later anyway */
+	} else if (strcmp(args[cur_arg + 1], "by-group") == 0) {
+		val = RX_SHARDS_BY_GROUP; /* resolved once the thread groups are known */
 	} else {
 		val = atol(args[cur_arg + 1]);
 		if (val < 1 || val > MAX_THREADS) {
-			memprintf(err, "'%s' : invalid value %d, allowed range is %d..%d or 'by-thread'", args[cur_arg], val, 1, MAX_THREADS);
+			memprintf(err, "'%s' : invalid value %d, allowed range is %d..%d, 'by-thread' or 'by-group'", args[cur_arg], val, 1, MAX_THREADS);
 			return ERR_ALERT | ERR_FATAL;
 		}
 	}
@@ -10,6 +10,7 @@
  *
  */
 
+#define _GNU_SOURCE /* required for sendmmsg() */
 #include <ctype.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -79,6 +80,9 @@ static const struct log_fmt_st log_formats[LOG_FORMATS] = {
 	[LOG_FORMAT_RAW] = {
 		.name = "raw",
 	},
+	[LOG_FORMAT_CBOR] = {
+		.name = "cbor",
+	},
 };
 
 /*
@@ -208,6 +212,39 @@ char default_rfc5424_sd_log_format[] = "- ";
 /* total number of dropped logs */
 unsigned int dropped_logs = 0;
 
+/* number of sendmmsg() calls used to send batched log datagrams, and the
+ * total number of datagrams they sent.
+ */
+unsigned int log_batches = 0;
+unsigned long long log_batched_dgrams = 0;
+
+/* number of log datagrams waiting in the current thread's batches */
+THREAD_LOCAL int log_pending_dgrams = 0;
+
+#ifdef HA_HAVE_MMSG
+/* Per-thread batches of log datagrams, enabled with "tune.log.batch", one for
+ * the AF_INET socket and one for the AF_UNIX socket. Datagrams are copied into
+ * slots of global.max_syslog_len + 1 bytes of <area> and are all sent over the
+ * same socket <fd>.
+ */
+static THREAD_LOCAL struct log_dgram_batch {
+	int fd;
+	int count;
+	struct mmsghdr *msgs;
+	struct iovec *iov;
+	char *area;
+} log_batch[2];
+
+/* Per-thread batch of datagrams received at once by the log forwarders'
+ * "dgram-bind" listeners, in LOG_RECV_BATCH slots of tune.bufsize bytes.
+ */
+static THREAD_LOCAL struct log_recv_batch {
+	struct mmsghdr *msgs;
+	struct iovec *iov;
+	char *area;
+} log_recv_batch;
+#endif
+
 /* This is a global syslog message buffer, common to all outgoing
  * messages. It contains only the data part.
  */
@@ -229,6 +266,7 @@ struct logformat_var_args var_args_list[] = {
 	{ "Q", LOG_OPT_QUOTE },
 	{ "X", LOG_OPT_HEXA },
 	{ "E", LOG_OPT_ESC },
+	{ "cbor", LOG_OPT_CBOR },
 	{  0,  0 }
 };
 
@@ -383,6 +421,7 @@ int add_to_logformat_list(char *start, char *end, int type, struct list *list_fo
 		strncpy(str, start, end - start);
 		str[end - start] = '\0';
 		node->arg = str;
+		node->len = end - start;
 		node->type = LOG_FMT_TEXT; // type string
 		LIST_APPEND(list_format, &node->list);
 	} else if (type == LF_SEPARATOR) {
@@ -438,6 +477,17 @@ int add_sample_to_logformat_list(char *text, char *arg, int arg_len, struct prox
 		if (!parse_logformat_var_args(node->arg, node, err))
 			goto error_free;
 	}
+
+	/* the args are not needed anymore, the expression's text is kept
+	 * instead as it names the field in CBOR-encoded log-formats.
+	 */
+	free(node->arg);
+	node->arg = my_strndup(text, endptr ? *endptr - text : strlen(text));
+	if (!node->arg) {
+		memprintf(err, "out of memory error");
+		goto error_free;
+	}
+
 	if (expr->fetch->val & cap & SMP_VAL_REQUEST)
 		node->options |= LOG_OPT_REQ_CAP; /* fetch method is request-compatible */
 
@@ -478,6 +528,156 @@ int add_sample_to_logformat_list(char *text, char *arg, int arg_len, struct prox
 	return 0;
 }
 
+/*
+ * Simplifies the nodes of <list_format> without changing the output. Since
+ * a separator following a text always emits one space, "text sep+ text" is
+ * merged into a single text node, and since a separator at the beginning or
+ * after another separator never emits anything, such separators are removed.
+ * This leaves fewer nodes to walk and copy when building the log lines.
+ * Returns 0 on memory allocation error with <err> filled, otherwise 1.
+ */
+static int lf_compact_nodes(struct list *list_format, char **err)
+{
+	struct logformat_node *node, *back, *prev, *text;
+	char *str;
+
+	list_for_each_entry_safe(node, back, list_format, list) {
+		prev = NULL;
+		if (node->list.p != list_format)
+			prev = LIST_PREV(&node->list, struct logformat_node *, list);
+
+		if (node->type == LOG_FMT_SEPARATOR && (!prev || prev->type == LOG_FMT_SEPARATOR)) {
+			LIST_DELETE(&node->list);
+			free(node);
+			continue;
+		}
+
+		if (node->type != LOG_FMT_TEXT || !prev)
+			continue;
+
+		/* find the text to append to, if any */
+		text = prev;
+		if (prev->type == LOG_FMT_SEPARATOR && prev->list.p != list_format)
+			text = LIST_PREV(&prev->list, struct logformat_node *, list);
+		if (text->type != LOG_FMT_TEXT)
+			continue;
+
+		str = realloc(text->arg, text->len + 1 + node->len + 1);
+		if (!str) {
+			memprintf(err, "out of memory error");
+			return 0;
+		}
+		text->arg = str;
+		if (prev != text) {
+			/* one space for the separator */
+			str[text->len++] = ' ';
+			LIST_DELETE(&prev->list);
+			free(prev);
+		}
+		memcpy(str + text->len, node->arg, node->len + 1);
+		text->len += node->len;
+		LIST_DELETE(&node->list);
+		free(node->arg);
+		free(node);
+	}
+	return 1;
+}
+
+/* Encodes at <out> the head of a CBOR data item of major type <major> with
+ * argument <arg> (value, length or count), not going beyond <end>. Returns the
+ * pointer past the head, or NULL if it does not fit.
+ */
+static char *lf_cbor_head(char *out, const char *end, uint8_t major, uint64_t arg)
+{
+	int bytes;
+
+	major <<= 5;
+	if (arg < 24)
+		bytes = 0;
+	else if (arg <= 0xff)
+		bytes = 1, major |= 24;
+	else if (arg <= 0xffff)
+		bytes = 2, major |= 25;
+	else if (arg <= 0xffffffff)
+		bytes = 4, major |= 26;
+	else
+		bytes = 8, major |= 27;
+
+	if (end - out < 1 + bytes)
+		return NULL;
+
+	*out++ = major | (bytes ? 0 : arg);
+	while (bytes--)
+		*out++ = arg >> (bytes * 8);
+	return out;
+}
+
+/* Encodes the signed integer <v> at <out> as a CBOR item, not going beyond
+ * <end>. Returns the pointer past the item, or NULL if it does not fit.
+ */
+static inline char *lf_cbor_int(char *out, const char *end, long long v)
+{
+	if (v < 0)
+		return lf_cbor_head(out, end, 1, -(v + 1));
+	return lf_cbor_head(out, end, 0, v);
+}
+
+/* Prepares a log-format list for the CBOR encoding if any of its nodes was
+ * configured with the "+cbor" option, which then applies to the whole list:
+ * literal texts and separators are removed, the quoting, escaping and
+ * hexadecimal options are turned off, and the encoded key of each field is
+ * precomputed into its <arg>. The key is the name of the format variable or
+ * the text of the sample expression. Returns 0 on memory allocation error
+ * with <err> filled, otherwise 1.
+ */
+static int lf_cbor_nodes(struct list *list_format, char **err)
+{
+	struct logformat_node *node, *back;
+	const char *name;
+	char *key, *end;
+	size_t len;
+	int j;
+
+	list_for_each_entry(node, list_format, list) {
+		if (node->options & LOG_OPT_CBOR)
+			break;
+	}
+	if (&node->list == list_format)
+		return 1;
+
+	list_for_each_entry_safe(node, back, list_format, list) {
+		if (node->type == LOG_FMT_TEXT || node->type == LOG_FMT_SEPARATOR) {
+			LIST_DELETE(&node->list);
+			free(node->arg);
+			free(node);
+			continue;
+		}
+
+		name = node->arg;
+		if (node->type != LOG_FMT_EXPR) {
+			for (j = 0; logformat_keywords[j].name; j++)
+				if (logformat_keywords[j].type == node->type)
+					break;
+			name = logformat_keywords[j].name;
+		}
+
+		len = strlen(name);
+		key = malloc(len + 9);
+		if (!key) {
+			memprintf(err, "out of memory error");
+			return 0;
+		}
+		end = lf_cbor_head(key, key + 9, 3, len);
+		memcpy(end, name, len);
+		free(node->arg);
+		node->arg = key;
+		node->len = end + len - key;
+		node->options |= LOG_OPT_CBOR | LOG_OPT_MANDATORY;
+		node->options &= ~(LOG_OPT_QUOTE | LOG_OPT_ESC | LOG_OPT_HEXA);
+	}
+	return 1;
+}
+
 /*
  * Parse the log_format string and fill a linked list.
  * Variable name are preceded by % and composed by characters [a-zA-Z0-9]* : %varname
@@ -652,6 +852,10 @@ int parse_logformat_string(const char *fmt, struct proxy *curproxy, struct list
 		memprintf(err, "truncated line after '%s'", var ? var : arg ? arg : "%");
 		goto fail;
 	}
+
+	if (!lf_compact_nodes(list_format, err) || !lf_cbor_nodes(list_format, err))
+		goto fail;
+
 	free(backfmt);
 
 	return 1;
@@ -943,6 +1147,24 @@ int parse_logsrv(char **args, struct list *logsrvs, int do_del, const char *file
 
 		cur_arg += 2;
 	}
+
+	/* in adaptive mode, the sampling ratio automatically grows up to
+	 * <max> when the logs cannot be sent fast enough.
+	 */
+	if (strcmp(args[cur_arg], "adaptive") == 0) {
+		char *end;
+		unsigned long max;
+
+		max = strtoul(args[cur_arg+1], &end, 10);
+		if (!*args[cur_arg+1] || *end || max < 2 || max > 65536) {
+			memprintf(err, "'adaptive' expects a maximum sampling ratio between 2 and 65536, got '%s'",
+			          args[cur_arg+1]);
+			goto error;
+		}
+		logsrv->adapt.max = max;
+		cur_arg += 2;
+	}
+	logsrv->adapt.ratio = 1;
 	HA_SPIN_INIT(&logsrv->lock);
 	/* parse the facility */
 	logsrv->facility = get_log_facility(args[cur_arg]);
@@ -1167,6 +1389,101 @@ static char *lf_encode_chunk(char *start, char *stop,
 	return start;
 }
 
+/* Returns non-zero if the log-format variable of type <type> always reports a
+ * number, which is then encoded as an integer into CBOR-encoded logs.
+ */
+static int lf_cbor_is_int(int type)
+{
+	switch (type) {
+	case LOG_FMT_CLIENTPORT: case LOG_FMT_BACKENDPORT: case LOG_FMT_FRONTENDPORT:
+	case LOG_FMT_SERVERPORT: case LOG_FMT_COUNTER: case LOG_FMT_LOGCNT:
+	case LOG_FMT_PID: case LOG_FMT_TS: case LOG_FMT_MS:
+	case LOG_FMT_BYTES: case LOG_FMT_BYTES_UP:
+	case LOG_FMT_Ta: case LOG_FMT_Th: case LOG_FMT_Ti: case LOG_FMT_TQ:
+	case LOG_FMT_TW: case LOG_FMT_TC: case LOG_FMT_Tr: case LOG_FMT_TR:
+	case LOG_FMT_TD: case LOG_FMT_TT: case LOG_FMT_TU: case LOG_FMT_STATUS:
+	case LOG_FMT_ACTCONN: case LOG_FMT_FECONN: case LOG_FMT_BECONN:
+	case LOG_FMT_SRVCONN: case LOG_FMT_RETRIES: case LOG_FMT_SRVQUEUE:
+	case LOG_FMT_BCKQUEUE:
+		return 1;
+	}
+	return 0;
+}
+
+/* Turns the text emitted by the variable <node> between <val> + 5 and <end>
+ * into a CBOR item placed at <val>. Numeric variables become integers (the
+ * '+' prefix of "option logasap" is ignored), a lone '-' reporting a missing
+ * value becomes null, and anything else becomes a text string. The item never
+ * takes more room than the text plus the 5 bytes reserved for its head.
+ * Returns the pointer past the item.
+ */
+static char *lf_cbor_text(char *val, char *end, const struct logformat_node *node)
+{
+	char *txt = val + 5;
+	size_t len = end - txt;
+	long long v = 0;
+	char *p = txt;
+	int neg = 0;
+
+	if (lf_cbor_is_int(node->type) && len && len <= 18) {
+		if (*p == '+' || *p == '-')
+			neg = (*p++ == '-');
+		while (p < end && isdigit((unsigned char)*p))
+			v = v * 10 + *p++ - '0';
+		if (p == end && p > txt + neg)
+			return lf_cbor_int(val, end, neg ? -v : v);
+	}
+
+	if (len == 1 && *txt == '-') {
+		*val = 0xf6; /* null */
+		return val + 1;
+	}
+
+	val = lf_cbor_head(val, txt, 3, len);
+	memmove(val, txt, len);
+	return val + len;
+}
+
+/* Encodes sample <smp> as a CBOR item at <out>, not going beyond <end>:
+ * booleans, integers and binary samples keep their type, any other sample is
+ * turned into a text string, and a missing one into null. Returns the pointer
+ * past the item, or NULL if it does not fit.
+ */
+static char *lf_cbor_sample(char *out, const char *end, struct sample *smp)
+{
+	uint8_t major = 3;
+
+	if (smp && smp->data.type == SMP_T_BOOL) {
+		if (out >= end)
+			return NULL;
+		*out++ = smp->data.u.sint ? 0xf5 : 0xf4;
+		return out;
+	}
+
+	if (smp && smp->data.type == SMP_T_SINT)
+		return lf_cbor_int(out, end, smp->data.u.sint);
+
+	if (smp && smp->data.type == SMP_T_BIN)
+		major = 2;
+	else if (smp && smp->data.type != SMP_T_STR &&
+	         (!sample_casts[smp->data.type][SMP_T_STR] ||
+	          !sample_casts[smp->data.type][SMP_T_STR](smp)))
+		smp = NULL;
+
+	if (!smp) {
+		if (out >= end)
+			return NULL;
+		*out++ = 0xf6; /* null */
+		return out;
+	}
+
+	out = lf_cbor_head(out, end, major, smp->data.u.str.data);
+	if (!out || (size_t)(end - out) < smp->data.u.str.data)
+		return NULL;
+	memcpy(out, smp->data.u.str.area, smp->data.u.str.data);
+	return out + smp->data.u.str.data;
+}
+
 /*
  * Write a string in the log string
  * Take cares of quote and escape options
@@ -1310,6 +1627,86 @@ void send_log(struct proxy *p, int level, const char *format, ...)
 	__send_log((p ? &p->logsrvs : NULL), (p ? &p->log_tag : NULL), level,
 		   logline, data_len, default_rfc5424_sd_log_format, 2);
 }
+/* Builds the header of a CBOR-encoded log message. The whole message is a map
+ * of 8 pairs whose keys are always "pri", "time", "host", "tag", "pid",
+ * "msgid", "sd" and "msg" in this order. Missing metadata are encoded as null
+ * and the current date is used when no time is provided. The header ends with
+ * the head of the "msg" text string made of the <nmsg> parts of <msg>, unless
+ * the message is already a CBOR map (as produced by "+cbor" log-formats), in
+ * which case it is embedded as-is. Returns the ist array of elements of the
+ * header, whose number is set into <nbelem>.
+ */
+static struct ist *build_log_cbor_header(int level, int facility, struct ist *metadata,
+                                         const struct ist *msg, size_t nmsg, size_t *nbelem)
+{
+	static THREAD_LOCAL struct {
+		struct ist ist_vector[NB_LOG_HDR_MAX_ELEMENTS];
+		char buf[128];
+	} hdr_ctx;
+	static const struct {
+		struct ist key;
+		int meta;
+	} fields[] = {
+		{ IST("\x64time"),  LOG_META_TIME   },
+		{ IST("\x64host"),  LOG_META_HOST   },
+		{ IST("\x63tag"),   LOG_META_TAG    },
+		{ IST("\x63pid"),   LOG_META_PID    },
+		{ IST("\x65msgid"), LOG_META_MSGID  },
+		{ IST("\x62sd"),    LOG_META_STDATA },
+	};
+	char *end = hdr_ctx.buf + sizeof(hdr_ctx.buf);
+	char *chunk = hdr_ctx.buf;
+	char *p = hdr_ctx.buf;
+	struct ist v;
+	size_t len = 0;
+	int first = -1, last = -1;
+	int i;
+
+	*nbelem = 0;
+
+	*p++ = 0xa8; /* map of 8 pairs */
+	memcpy(p, "\x63pri", 4);
+	p += 4;
+	p = lf_cbor_head(p, end, 0, (facility << 3) + level);
+
+	for (i = 0; i < sizeof(fields) / sizeof(*fields); i++) {
+		memcpy(p, istptr(fields[i].key), istlen(fields[i].key));
+		p += istlen(fields[i].key);
+		v = metadata ? metadata[fields[i].meta] : IST_NULL;
+		if (fields[i].meta == LOG_META_TIME && (!v.len || isteq(v, ist("-"))))
+			v = ist2(timeofday_as_iso_us(0), LOG_ISOTIME_MAXLEN);
+
+		/* the rfc5424 fields may come with their trailing space */
+		while (v.len && v.ptr[v.len - 1] == ' ')
+			v.len--;
+
+		if (!v.len || isteq(v, ist("-"))) {
+			*p++ = 0xf6; /* null */
+			continue;
+		}
+		p = lf_cbor_head(p, end, 3, v.len);
+		hdr_ctx.ist_vector[(*nbelem)++] = ist2(chunk, p - chunk);
+		hdr_ctx.ist_vector[(*nbelem)++] = v;
+		chunk = p;
+	}
+
+	for (i = 0; i < nmsg; i++) {
+		if (!msg[i].len)
+			continue;
+		if (first < 0)
+			first = i;
+		last = i;
+		len += msg[i].len;
+	}
+
+	memcpy(p, "\x63msg", 4);
+	p += 4;
+	if (first < 0 || (uchar)*msg[first].ptr != 0xbf || (uchar)msg[last].ptr[msg[last].len - 1] != 0xff)
+		p = lf_cbor_head(p, end, 3, len);
+	hdr_ctx.ist_vector[(*nbelem)++] = ist2(chunk, p - chunk);
+	return hdr_ctx.ist_vector;
+}
+
 /*
  * This function builds a log header of given format using given
  * metadata, if format is set to LOF_FORMAT_UNSPEC, it tries
@@ -1321,8 +1718,8 @@ void send_log(struct proxy *p, int level, const char *format, ...)
  * This function returns currently a maximum of NB_LOG_HDR_IST_ELEMENTS
  * elements.
  */
-struct ist *build_log_header(enum log_fmt format, int level, int facility,
-                             struct ist *metadata, size_t *nbelem)
+struct ist *build_log_header(enum log_fmt format, int level, int facility, struct ist *metadata,
+                             const struct ist *msg, size_t nmsg, size_t *nbelem)
 {
 	static THREAD_LOCAL struct {
 		struct ist ist_vector[NB_LOG_HDR_MAX_ELEMENTS];
@@ -1338,6 +1735,8 @@ struct ist *build_log_header(enum log_fmt format, int level, int facility,
 
 	*nbelem = 0;
 
+	if (format == LOG_FORMAT_CBOR)
+		return build_log_cbor_header(level, facility, metadata, msg, nmsg, nbelem);
 
 	if (format == LOG_FORMAT_UNSPEC) {
 		format = LOG_FORMAT_RAW;
@@ -1400,6 +1799,7 @@ struct ist *build_log_header(enum log_fmt format, int level, int facility,
 		case LOG_FORMAT_RAW:
 			break;
 		case LOG_FORMAT_UNSPEC:
+		case LOG_FORMAT_CBOR:
 		case LOG_FORMATS:
 			ABORT_NOW();
 	}
@@ -1537,6 +1937,7 @@ struct ist *build_log_header(enum log_fmt format, int level, int facility,
 		case LOG_FORMAT_RAW:
 			break;
 		case LOG_FORMAT_UNSPEC:
+		case LOG_FORMAT_CBOR:
 		case LOG_FORMATS:
 			ABORT_NOW();
 	}
@@ -1606,6 +2007,7 @@ struct ist *build_log_header(enum log_fmt format, int level, int facility,
 		case LOG_FORMAT_RAW:
 			break;
 		case LOG_FORMAT_UNSPEC:
+		case LOG_FORMAT_CBOR:
 		case LOG_FORMATS:
 			ABORT_NOW();
 	}
@@ -1613,19 +2015,148 @@ struct ist *build_log_header(enum log_fmt format, int level, int facility,
 	return hdr_ctx.ist_vector;
 }
 
+#ifdef HA_HAVE_MMSG
+/* Sends the datagrams of batch <batch> with as few sendmmsg() calls as
+ * possible. On EAGAIN, the remaining ones are counted as dropped. On other
+ * errors, the datagram which failed is skipped.
+ */
+static void log_batch_send(struct log_dgram_batch *batch)
+{
+	int sent = 0;
+	int ret;
+
+	while (sent < batch->count) {
+		ret = sendmmsg(batch->fd, batch->msgs + sent, batch->count - sent,
+		               MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (ret > 0) {
+			_HA_ATOMIC_INC(&log_batches);
+			_HA_ATOMIC_ADD(&log_batched_dgrams, ret);
+			sent += ret;
+			continue;
+		}
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			_HA_ATOMIC_ADD(&dropped_logs, batch->count - sent);
+			for (; sent < batch->count; sent++) {
+				struct logsrv *logsrv;
+
+				logsrv = container_of(batch->msgs[sent].msg_hdr.msg_name, struct logsrv, addr);
+				_HA_ATOMIC_INC(&logsrv->adapt.fails);
+			}
+			break;
+		}
+		else {
+			static char once;
+
+			if (!once) {
+				once = 1; /* note: no need for atomic ops here */
+				ha_alert("sendmmsg() failed in logger: %s (errno=%d)\n",
+				         strerror(errno), errno);
+			}
+			sent++;
+		}
+	}
+
+	log_pending_dgrams -= batch->count;
+	batch->count = 0;
+}
+
+/* Appends to the current thread's batch <batch> the datagram made of the
+ * <nbiov> elements of <iov>, to be sent over <fd> to <addr> which must remain
+ * valid until the batch is sent. The batch is sent first if it was meant for
+ * another socket, and once it is full.
+ */
+static void log_batch_dgram(struct log_dgram_batch *batch, int fd, struct sockaddr_storage *addr,
+                            const struct iovec *iov, int nbiov)
+{
+	struct mmsghdr *msg;
+	size_t room = global.max_syslog_len + 1;
+	size_t len = 0;
+	char *slot;
+	int i;
+
+	if (batch->count && fd != batch->fd)
+		log_batch_send(batch);
+
+	batch->fd = fd;
+	msg = &batch->msgs[batch->count];
+	slot = batch->iov[batch->count].iov_base;
+	for (i = 0; i < nbiov && len < room; i++) {
+		size_t copy = MIN(iov[i].iov_len, room - len);
+
+		memcpy(slot + len, iov[i].iov_base, copy);
+		len += copy;
+	}
+
+	batch->iov[batch->count].iov_len = len;
+	msg->msg_hdr.msg_name = (struct sockaddr *)addr;
+	msg->msg_hdr.msg_namelen = get_addr_len(addr);
+	log_pending_dgrams++;
+
+	if (++batch->count >= global.tune.log_batch)
+		log_batch_send(batch);
+}
+#endif
+
+/* Sends the log datagrams batched by the current thread */
+void __log_flush_dgrams(void)
+{
+#ifdef HA_HAVE_MMSG
+	int b;
+
+	for (b = 0; b < 2; b++)
+		if (log_batch[b].count)
+			log_batch_send(&log_batch[b]);
+#endif
+	log_pending_dgrams = 0;
+}
+
+/* Splits the message <message> of <size> bytes into <msg> to annotate it with
+ * the adaptive sampling <rate> when it is greater than 1: a CBOR map gets a
+ * "rate" entry before its final break byte, and any other message is prefixed
+ * with '[sampling rate="<rate>"] '. The message is then made of 2 parts, the
+ * annotation using a thread-local buffer. Returns the number of parts in <msg>.
+ */
+static int log_annotate_rate(struct ist *msg, char *message, size_t size, unsigned int rate)
+{
+	static THREAD_LOCAL char annot[32];
+	char *p;
+
+	msg[0] = ist2(message, size);
+	if (rate <= 1)
+		return 1;
+
+	if (size >= 2 && (uchar)message[0] == 0xbf && (uchar)message[size - 1] == 0xff) {
+		memcpy(annot, "\x64rate", 5);
+		p = lf_cbor_head(annot + 5, annot + sizeof(annot) - 1, 0, rate);
+		*p++ = 0xff;
+		msg[0].len--;
+		msg[1] = ist2(annot, p - annot);
+	}
+	else {
+		msg[1] = msg[0];
+		msg[0] = ist2(annot, snprintf(annot, sizeof(annot), "[sampling rate=\"%u\"] ", rate));
+	}
+	return 2;
+}
+
 /*
  * This function sends a syslog message to <logsrv>.
  * The argument <metadata> MUST be an array of size
  * LOG_META_FIELDS*sizeof(struct ist) containing data to build the header.
  * It overrides the last byte of the message vector with an LF character.
- * Does not return any error,
+ * A <rate> greater than 1 is the adaptive sampling rate the message is
+ * annotated with. Does not return any error,
  */
-static inline void __do_send_log(struct logsrv *logsrv, int nblogger, int level, int facility, struct ist *metadata, char *message, size_t size)
+static inline void __do_send_log(struct logsrv *logsrv, int nblogger, int format, int level, int facility, struct ist *metadata, char *message, size_t size, unsigned int rate)
 {
-	static THREAD_LOCAL struct iovec iovec[NB_LOG_HDR_MAX_ELEMENTS+1+1] = { }; /* header elements + message + LF */
+	static THREAD_LOCAL struct iovec iovec[NB_LOG_HDR_MAX_ELEMENTS+2+1] = { }; /* header elements + message parts + LF */
 	static THREAD_LOCAL struct msghdr msghdr = {
 		//.msg_iov = iovec,
-		.msg_iovlen = NB_LOG_HDR_MAX_ELEMENTS+2
+		.msg_iovlen = NB_LOG_HDR_MAX_ELEMENTS+3
 	};
 	static THREAD_LOCAL int logfdunix = -1;	/* syslog to AF_UNIX socket */
 	static THREAD_LOCAL int logfdinet = -1;	/* syslog to AF_INET socket */
@@ -1633,6 +2164,9 @@ static inline void __do_send_log(struct logsrv *logsrv, int nblogger, int level,
 	int sent;
 	size_t nbelem;
 	struct ist *msg_header = NULL;
+	struct ist msg[2];
+	size_t left;
+	int nmsg, m;
 
 	msghdr.msg_iov = iovec;
 
@@ -1642,6 +2176,8 @@ static inline void __do_send_log(struct logsrv *logsrv, int nblogger, int level,
 	while (size && (message[size-1] == '\n' || (message[size-1] == 0)))
 		size--;
 
+	nmsg = log_annotate_rate(msg, message, size, rate);
+
 	if (logsrv->type == LOG_TARGET_BUFFER) {
 		plogfd = NULL;
 		goto send;
@@ -1676,23 +2212,25 @@ static inline void __do_send_log(struct logsrv *logsrv, int nblogger, int level,
 		}
 	}
 
-	msg_header = build_log_header(logsrv->format, level, facility, metadata, &nbelem);
+	msg_header = build_log_header(format, level, facility, metadata, msg, nmsg, &nbelem);
  send:
-	if (logsrv->type == LOG_TARGET_BUFFER) {
-		struct ist msg;
-
-		msg = ist2(message, size);
-		msg = isttrim(msg, logsrv->maxlen);
+	if (logsrv->type != LOG_TARGET_DGRAM) {
+		left = logsrv->maxlen;
+		for (m = 0; m < nmsg; m++) {
+			msg[m] = isttrim(msg[m], left);
+			left -= istlen(msg[m]);
+		}
+	}
 
-		sent = sink_write(logsrv->sink, &msg, 1, level, facility, metadata);
+	if (logsrv->type == LOG_TARGET_BUFFER) {
+		sent = sink_write(logsrv->sink, msg, nmsg, level, facility, metadata);
+		if (sent <= 0)
+			_HA_ATOMIC_INC(&logsrv->adapt.fails);
 	}
 	else if (logsrv->addr.ss_family == AF_CUST_EXISTING_FD) {
-		struct ist msg;
-
-		msg = ist2(message, size);
-		msg = isttrim(msg, logsrv->maxlen);
-
-		sent = fd_write_frag_line(*plogfd, logsrv->maxlen, msg_header, nbelem, &msg, 1, 1);
+		/* CBOR records are self-delimited, no LF is added after them */
+		sent = fd_write_frag_line(*plogfd, logsrv->maxlen, msg_header, nbelem, msg, nmsg,
+		                          format != LOG_FORMAT_CBOR);
 	}
 	else {
 		int i = 0;
@@ -1708,16 +2246,26 @@ static inline void __do_send_log(struct logsrv *logsrv, int nblogger, int level,
 			}
 			totlen -= iovec[i].iov_len;
 		}
-		if (totlen) {
-			iovec[i].iov_base = message;
-			iovec[i].iov_len  = size;
+		for (m = 0; totlen && m < nmsg; m++) {
+			iovec[i].iov_base = istptr(msg[m]);
+			iovec[i].iov_len  = istlen(msg[m]);
 			if (totlen <= iovec[i].iov_len)
 				iovec[i].iov_len = totlen;
+			totlen -= iovec[i].iov_len;
 			i++;
 		}
-		iovec[i].iov_base = "\n"; /* insert a \n at the end of the message */
-		iovec[i].iov_len = 1;
-		i++;
+		if (format != LOG_FORMAT_CBOR) {
+			iovec[i].iov_base = "\n"; /* insert a \n at the end of the message */
+			iovec[i].iov_len = 1;
+			i++;
+		}
+
+#ifdef HA_HAVE_MMSG
+		if (log_batch[0].area) {
+			log_batch_dgram(&log_batch[plogfd == &logfdunix], *plogfd, &logsrv->addr, iovec, i);
+			return;
+		}
+#endif
 
 		msghdr.msg_iovlen = i;
 		msghdr.msg_name = (struct sockaddr *)&logsrv->addr;
@@ -1729,8 +2277,10 @@ static inline void __do_send_log(struct logsrv *logsrv, int nblogger, int level,
 	if (sent < 0) {
 		static char once;
 
-		if (errno == EAGAIN || errno == EWOULDBLOCK)
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
 			_HA_ATOMIC_INC(&dropped_logs);
+			_HA_ATOMIC_INC(&logsrv->adapt.fails);
+		}
 		else if (!once) {
 			once = 1; /* note: no need for atomic ops here */
 			ha_alert("sendmsg()/writev() failed in logger #%d: %s (errno=%d)\n",
@@ -1739,15 +2289,48 @@ static inline void __do_send_log(struct logsrv *logsrv, int nblogger, int level,
 	}
 }
 
-/*
- * This function sends a syslog message.
- * It doesn't care about errors nor does it report them.
- * The argument <metadata> MUST be an array of size
- * LOG_META_FIELDS*sizeof(struct ist)  containing
- * data to build the header.
+/* Updates the sampling ratio of the adaptive logger <logsrv>: it is doubled
+ * up to the configured maximum every 100ms as long as some sends fail, and is
+ * halved down to 1 after each second without failure. Returns the ratio to
+ * apply to the current log.
  */
-void process_send_log(struct list *logsrvs, int level, int facility,
-	                struct ist *metadata, char *message, size_t size)
+static unsigned int log_adapt_ratio(struct logsrv *logsrv)
+{
+	unsigned int fails, next;
+
+	next = HA_ATOMIC_LOAD(&logsrv->adapt.next);
+	if (tick_isset(next) && !tick_is_expired(next, now_ms))
+		return HA_ATOMIC_LOAD(&logsrv->adapt.ratio);
+
+	HA_SPIN_LOCK(LOGSRV_LOCK, &logsrv->lock);
+	next = logsrv->adapt.next;
+	if (!tick_isset(next) || tick_is_expired(next, now_ms)) {
+		fails = HA_ATOMIC_LOAD(&logsrv->adapt.fails);
+		if (fails != logsrv->adapt.last_fails) {
+			logsrv->adapt.ratio = MIN(logsrv->adapt.ratio * 2, logsrv->adapt.max);
+			next = tick_add(now_ms, MS_TO_TICKS(100));
+		}
+		else if (logsrv->adapt.ratio > 1) {
+			logsrv->adapt.ratio /= 2;
+			next = tick_add(now_ms, MS_TO_TICKS(1000));
+		}
+		else
+			next = tick_add(now_ms, MS_TO_TICKS(100));
+		logsrv->adapt.last_fails = fails;
+		HA_ATOMIC_STORE(&logsrv->adapt.next, next);
+	}
+	HA_SPIN_UNLOCK(LOGSRV_LOCK, &logsrv->lock);
+	return HA_ATOMIC_LOAD(&logsrv->adapt.ratio);
+}
+
+/* Sends the message to all loggers of <logsrvs> accepting level <level>. When
+ * <pass> is set, <message> is a complete syslog message that is sent as-is
+ * without any header, and <metadata> is not used. Otherwise see
+ * process_send_log().
+ */
+static void __process_send_log(struct list *logsrvs, int level, int facility,
+                               struct ist *metadata, char *message, size_t size,
+                               int pass)
 {
 	struct logsrv *logsrv;
 	int nblogger;
@@ -1755,6 +2338,7 @@ void process_send_log(struct list *logsrvs, int level, int facility,
 	/* Send log messages to syslog server. */
 	nblogger = 0;
 	list_for_each_entry(logsrv, logsrvs, list) {
+		unsigned int rate = 1;
 		int in_range = 1;
 
 		/* we can filter the level of the messages that are sent to each logger */
@@ -1778,13 +2362,34 @@ void process_send_log(struct list *logsrvs, int level, int facility,
 			logsrv->lb.curr_idx = (logsrv->lb.curr_idx + 1) % logsrv->lb.smp_sz;
 			HA_SPIN_UNLOCK(LOGSRV_LOCK, &logsrv->lock);
 		}
+
+		if (in_range && logsrv->adapt.max) {
+			rate = log_adapt_ratio(logsrv);
+			if (rate > 1)
+				in_range = _HA_ATOMIC_FETCH_ADD(&logsrv->adapt.idx, 1) % rate == 0;
+		}
+
 		if (in_range)
-			__do_send_log(logsrv, ++nblogger,  MAX(level, logsrv->minlvl),
+			__do_send_log(logsrv, ++nblogger, pass ? LOG_FORMAT_RAW : logsrv->format,
+			              MAX(level, logsrv->minlvl),
 			              (facility == -1) ? logsrv->facility : facility,
-			              metadata, message, size);
+			              metadata, message, size, rate);
 	}
 }
 
+/*
+ * This function sends a syslog message.
+ * It doesn't care about errors nor does it report them.
+ * The argument <metadata> MUST be an array of size
+ * LOG_META_FIELDS*sizeof(struct ist)  containing
+ * data to build the header.
+ */
+void process_send_log(struct list *logsrvs, int level, int facility,
+	                struct ist *metadata, char *message, size_t size)
+{
+	__process_send_log(logsrvs, level, facility, metadata, message, size, 0);
+}
+
 /*
  * This function sends a syslog message.
  * It doesn't care about errors nor does it report them.
@@ -1947,6 +2552,85 @@ void deinit_log_buffers()
 	logline_rfc5424   = NULL;
 }
 
+#ifdef HA_HAVE_MMSG
+/* Allocates the current thread's batch of log datagrams when enabled. It is
+ * only done on running threads so that no datagram can remain in a batch
+ * inherited across a fork().
+ */
+static int alloc_log_batch()
+{
+	size_t room = global.max_syslog_len + 1;
+	struct log_dgram_batch *batch;
+	int b, i;
+
+	if (!global.tune.log_batch)
+		return 1;
+
+	for (b = 0; b < 2; b++) {
+		batch = &log_batch[b];
+		batch->msgs = calloc(global.tune.log_batch, sizeof(*batch->msgs));
+		batch->iov  = calloc(global.tune.log_batch, sizeof(*batch->iov));
+		batch->area = malloc(global.tune.log_batch * room);
+		if (!batch->msgs || !batch->iov || !batch->area) {
+			ha_alert("failed to allocate the batches of log datagrams.\n");
+			return 0;
+		}
+
+		for (i = 0; i < global.tune.log_batch; i++) {
+			batch->iov[i].iov_base = batch->area + i * room;
+			batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+			batch->msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+	}
+	return 1;
+}
+
+/* Sends the remaining batched log datagrams and releases the batches */
+static void free_log_batch()
+{
+	int b;
+
+	log_flush_dgrams();
+	for (b = 0; b < 2; b++) {
+		ha_free(&log_batch[b].msgs);
+		ha_free(&log_batch[b].iov);
+		ha_free(&log_batch[b].area);
+	}
+}
+
+/* Allocates the current thread's receive batch when log forwarders exist */
+static int alloc_log_recv_batch()
+{
+	int i;
+
+	if (!cfg_log_forward)
+		return 1;
+
+	log_recv_batch.msgs = calloc(LOG_RECV_BATCH, sizeof(*log_recv_batch.msgs));
+	log_recv_batch.iov  = calloc(LOG_RECV_BATCH, sizeof(*log_recv_batch.iov));
+	log_recv_batch.area = malloc((size_t)LOG_RECV_BATCH * global.tune.bufsize);
+	if (!log_recv_batch.msgs || !log_recv_batch.iov || !log_recv_batch.area) {
+		ha_alert("failed to allocate the batch of received log datagrams.\n");
+		return 0;
+	}
+
+	for (i = 0; i < LOG_RECV_BATCH; i++) {
+		log_recv_batch.iov[i].iov_base = log_recv_batch.area + (size_t)i * global.tune.bufsize;
+		log_recv_batch.msgs[i].msg_hdr.msg_iov = &log_recv_batch.iov[i];
+		log_recv_batch.msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	return 1;
+}
+
+/* Releases the current thread's receive batch */
+static void free_log_recv_batch()
+{
+	ha_free(&log_recv_batch.msgs);
+	ha_free(&log_recv_batch.iov);
+	ha_free(&log_recv_batch.area);
+}
+#endif
+
 /* Builds a log line in <dst> based on <list_format>, and stops before reaching
  * <maxsize> characters. Returns the size of the output string in characters,
  * not counting the trailing zero which is always added if the resulting size
@@ -1973,9 +2657,11 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 	int last_isspace = 1;
 	int nspaces = 0;
 	char *tmplog;
+	char *cbor_item = NULL;
 	char *ret;
 	int iret;
 	int status;
+	int cbor;
 	struct logformat_node *tmp;
 	struct timeval tv;
 	struct strm_logs tmp_strm_log;
@@ -2066,6 +2752,19 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 	if (LIST_ISEMPTY(list_format))
 		return 0;
 
+	/* a CBOR-encoded log line is an indefinite-length map of the fields,
+	 * whose final break byte is always kept room for. <cbor_item> marks
+	 * the end of the last complete field.
+	 */
+	cbor = LIST_NEXT(list_format, struct logformat_node *, list)->options & LOG_OPT_CBOR;
+	if (cbor) {
+		if (maxsize < 3)
+			return 0;
+		maxsize--;
+		*tmplog++ = 0xbf;
+		cbor_item = tmplog;
+	}
+
 	list_for_each_entry(tmp, list_format, list) {
 #ifdef USE_OPENSSL
 		struct connection *conn;
@@ -2074,6 +2773,17 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 		const char *src = NULL;
 		struct sample *key;
 		const struct buffer empty = { };
+		int smp_type;
+
+		if (cbor) {
+			/* the key, then room for the largest head of the value
+			 * which is emitted as text and encoded afterwards.
+			 */
+			if ((size_t)(dst + maxsize - tmplog) <= tmp->len + 5)
+				goto out;
+			memcpy(tmplog, tmp->arg, tmp->len);
+			tmplog += tmp->len + 5;
+		}
 
 		switch (tmp->type) {
 			case LOG_FMT_SEPARATOR:
@@ -2084,26 +2794,33 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 			case LOG_FMT_TEXT: // text
-				src = tmp->arg;
-				iret = strlcpy2(tmplog, src, dst + maxsize - tmplog);
-				if (iret == 0)
+				/* same as strlcpy2() but with the precomputed length */
+				iret = dst + maxsize - tmplog - 1;
+				if (iret > 0 && tmp->len < (size_t)iret)
+					iret = tmp->len;
+				if (iret <= 0)
 					goto out;
+				memcpy(tmplog, tmp->arg, iret);
 				tmplog += iret;
 				last_isspace = 0;
 				break;
 
 			case LOG_FMT_EXPR: // sample expression, may be request or response
+				/* CBOR keeps the sample's type */
+				smp_type = cbor ? SMP_T_ANY : SMP_T_STR;
 				key = NULL;
 				if (tmp->options & LOG_OPT_REQ_CAP)
-					key = sample_fetch_as_type(be, sess, s, SMP_OPT_DIR_REQ|SMP_OPT_FINAL, tmp->expr, SMP_T_STR);
+					key = sample_fetch_as_type(be, sess, s, SMP_OPT_DIR_REQ|SMP_OPT_FINAL, tmp->expr, smp_type);
 
 				if (!key && (tmp->options & LOG_OPT_RES_CAP))
-					key = sample_fetch_as_type(be, sess, s, SMP_OPT_DIR_RES|SMP_OPT_FINAL, tmp->expr, SMP_T_STR);
+					key = sample_fetch_as_type(be, sess, s, SMP_OPT_DIR_RES|SMP_OPT_FINAL, tmp->expr, smp_type);
 
 				if (!key && !(tmp->options & (LOG_OPT_REQ_CAP|LOG_OPT_RES_CAP))) // cfg, cli
-					key = sample_fetch_as_type(be, sess, s, SMP_OPT_FINAL, tmp->expr, SMP_T_STR);
+					key = sample_fetch_as_type(be, sess, s, SMP_OPT_FINAL, tmp->expr, smp_type);
 
-				if (tmp->options & LOG_OPT_HTTP)
+				if (cbor)
+					ret = lf_cbor_sample(tmplog - 5, dst + maxsize - 1, key);
+				else if (tmp->options & LOG_OPT_HTTP)
 					ret = lf_encode_chunk(tmplog, dst + maxsize,
 					                      '%', http_encode_map, key ? &key->data.u.str : &empty, tmp);
 				else
@@ -3057,9 +3774,21 @@ int sess_build_logline(struct session *sess, struct stream *s, char *dst, size_t
 				break;
 
 		}
+
+		if (cbor) {
+			if (tmp->type != LOG_FMT_EXPR)
+				tmplog = lf_cbor_text(cbor_item + tmp->len, tmplog, tmp);
+			cbor_item = tmplog;
+		}
 	}
 
 out:
+	if (cbor) {
+		/* drop any truncated field and close the map */
+		tmplog = cbor_item;
+		*tmplog++ = 0xff;
+	}
+
 	/* *tmplog is a unused character */
 	*tmplog = '\0';
 	return tmplog - dst;
@@ -3502,18 +4231,134 @@ void parse_log_message(char *buf, size_t buflen, int *level, int *facility,
 	return;
 }
 
-/*
- * UDP syslog fd handler
+/* Returns the syslog format of message <buf> of <len> bytes as detected from
+ * its header, and fills <level> and <facility> from its priority. Only
+ * LOG_FORMAT_RFC5424 and LOG_FORMAT_RFC3164 are reported, LOG_FORMAT_UNSPEC
+ * is returned when the message does not start with a valid priority.
  */
-void syslog_fd_handler(int fd)
+static int syslog_pass_format(const char *buf, size_t len, int *level, int *facility)
+{
+	const char *p = buf + 1, *end = buf + len;
+	int fac_level = 0;
+
+	if (len < 3 || *buf != '<')
+		return LOG_FORMAT_UNSPEC;
+
+	while (p < end && *p != '>') {
+		if ((unsigned char)(*p - '0') > 9 || p - buf > 3)
+			return LOG_FORMAT_UNSPEC;
+		fac_level = 10 * fac_level + (*p - '0');
+		p++;
+	}
+
+	if (p == end || p == buf + 1 || fac_level > 191)
+		return LOG_FORMAT_UNSPEC;
+
+	*facility = fac_level >> 3;
+	*level = fac_level & 0x7;
+	p++;
+
+	/* for rfc5424, prio is always followed by '1' and ' ' */
+	if (end - p > 2 && p[0] == '1' && p[1] == ' ')
+		return LOG_FORMAT_RFC5424;
+	return LOG_FORMAT_RFC3164;
+}
+
+/* Returns non-zero if a message of format <format> and level <level> may be
+ * sent unmodified to all the loggers of <logsrvs> which will receive it. This
+ * excludes rings which need the parsed header, loggers forcing another format
+ * or raising the level, and adaptive loggers which annotate the messages.
+ */
+static int syslog_can_pass(struct list *logsrvs, int format, int level)
+{
+	struct logsrv *logsrv;
+
+	list_for_each_entry(logsrv, logsrvs, list) {
+		if (level > logsrv->level)
+			continue;
+
+		if (logsrv->type == LOG_TARGET_BUFFER || logsrv->adapt.max ||
+		    level < logsrv->minlvl ||
+		    (logsrv->format != LOG_FORMAT_UNSPEC && logsrv->format != format))
+			return 0;
+	}
+	return 1;
+}
+
+/* Forwards syslog message <buf> of <len> bytes received by log forwarder
+ * <frontend> to its loggers. With "passthrough", the message is sent as-is
+ * without being parsed whenever all the loggers accept it.
+ */
+static void syslog_forward(struct proxy *frontend, char *buf, size_t len)
 {
 	static THREAD_LOCAL struct ist metadata[LOG_META_FIELDS];
-	ssize_t ret = 0;
-	struct buffer *buf = get_trash_chunk();
 	size_t size;
 	char *message;
 	int level;
 	int facility;
+	int format;
+
+	if (frontend->options & PR_O_SYSLOG_PASS) {
+		format = syslog_pass_format(buf, len, &level, &facility);
+		if (format != LOG_FORMAT_UNSPEC &&
+		    syslog_can_pass(&frontend->logsrvs, format, level)) {
+			__process_send_log(&frontend->logsrvs, level, facility, NULL, buf, len, 1);
+			return;
+		}
+	}
+
+	parse_log_message(buf, len, &level, &facility, metadata, &message, &size);
+
+	process_send_log(&frontend->logsrvs, level, facility, metadata, message, size);
+}
+
+#ifdef HA_HAVE_MMSG
+/* Receives up to <max> datagrams at once from syslog listener <l> on <fd>
+ * into the current thread's receive batch and forwards them. Returns the
+ * number of datagrams received, or <0 if the socket was drained or failed.
+ */
+static int syslog_recv_batch(struct listener *l, int fd, int max)
+{
+	int ret, i;
+
+	if (max > LOG_RECV_BATCH)
+		max = LOG_RECV_BATCH;
+
+	for (i = 0; i < max; i++)
+		log_recv_batch.msgs[i].msg_hdr.msg_iov[0].iov_len = global.tune.bufsize;
+
+	ret = recvmmsg(fd, log_recv_batch.msgs, max, MSG_DONTWAIT, NULL);
+	if (ret <= 0) {
+		if (ret == 0 || errno == EAGAIN || errno == EWOULDBLOCK)
+			fd_cant_recv(fd);
+		return -1;
+	}
+
+	/* update counters */
+	_HA_ATOMIC_ADD(&cum_log_messages, ret);
+
+	for (i = 0; i < ret; i++) {
+		proxy_inc_fe_req_ctr(l, l->bind_conf->frontend);
+		syslog_forward(l->bind_conf->frontend, log_recv_batch.msgs[i].msg_hdr.msg_iov[0].iov_base,
+		               log_recv_batch.msgs[i].msg_len);
+	}
+
+	/* a short batch indicates the socket is empty */
+	if (ret < max) {
+		fd_cant_recv(fd);
+		return -1;
+	}
+	return ret;
+}
+#endif
+
+/*
+ * UDP syslog fd handler
+ */
+void syslog_fd_handler(int fd)
+{
+	ssize_t ret = 0;
+	struct buffer *buf = get_trash_chunk();
 	struct listener *l = objt_listener(fdtab[fd].owner);
 	int max_accept;
 
@@ -3526,6 +4371,18 @@ void syslog_fd_handler(int fd)
 
 		max_accept = l->maxaccept ? l->maxaccept : 1;
 
+#ifdef HA_HAVE_MMSG
+		if (log_recv_batch.msgs) {
+			while (max_accept > 0) {
+				ret = syslog_recv_batch(l, fd, max_accept);
+				if (ret < 0)
+					break;
+				max_accept -= ret;
+			}
+			goto out;
+		}
+#endif
+
 		do {
 			/* Source address */
 			struct sockaddr_storage saddr = {0};
@@ -3547,9 +4404,7 @@ void syslog_fd_handler(int fd)
 			_HA_ATOMIC_INC(&cum_log_messages);
 			proxy_inc_fe_req_ctr(l, l->bind_conf->frontend);
 
-			parse_log_message(buf->area, buf->data, &level, &facility, metadata, &message, &size);
-
-			process_send_log(&l->bind_conf->frontend->logsrvs, level, facility, metadata, message, size);
+			syslog_forward(l->bind_conf->frontend, buf->area, buf->data);
 
 		} while (--max_accept);
 	}
@@ -3563,7 +4418,6 @@ void syslog_fd_handler(int fd)
  */
 static void syslog_io_handler(struct appctx *appctx)
 {
-	static THREAD_LOCAL struct ist metadata[LOG_META_FIELDS];
 	struct stconn *sc = appctx_sc(appctx);
 	struct stream *s = __sc_strm(sc);
 	struct proxy *frontend = strm_fe(s);
@@ -3571,10 +4425,6 @@ static void syslog_io_handler(struct appctx *appctx)
 	struct buffer *buf = get_trash_chunk();
 	int max_accept;
 	int to_skip;
-	int facility;
-	int level;
-	char *message;
-	size_t size;
 
 	max_accept = l->maxaccept ? l->maxaccept : 1;
 	while (co_data(sc_oc(sc))) {
@@ -3654,9 +4504,7 @@ static void syslog_io_handler(struct appctx *appctx)
 		_HA_ATOMIC_INC(&cum_log_messages);
 		proxy_inc_fe_req_ctr(l, frontend);
 
-		parse_log_message(buf->area, buf->data, &level, &facility, metadata, &message, &size);
-
-		process_send_log(&frontend->logsrvs, level, facility, metadata, message, size);
+		syslog_forward(frontend, buf->area, buf->data);
 
 	}
 
@@ -3837,6 +4685,11 @@ int cfg_parse_log_forward(const char *file, int linenum, char **args, int kwm)
 			goto out;
 		}
 	}
+	else if (strcmp(args[0], "passthrough") == 0) {
+		if (alertif_too_many_args(0, file, linenum, args, &err_code))
+			goto out;
+		cfg_log_forward->options |= PR_O_SYSLOG_PASS;
+	}
 	else if (strcmp(args[0], "dgram-bind") == 0) {
 		int cur_arg;
 		struct bind_conf *bind_conf;
@@ -3957,8 +4810,42 @@ int cfg_parse_log_forward(const char *file, int linenum, char **args, int kwm)
 /* config parsers for this section */
 REGISTER_CONFIG_SECTION("log-forward", cfg_parse_log_forward, NULL);
 
+/* config parser for global "tune.log.batch" */
+static int cfg_parse_log_batch(char **args, int section_type, struct proxy *curpx,
+                               const struct proxy *defpx, const char *file, int line,
+                               char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+#ifdef HA_HAVE_MMSG
+	global.tune.log_batch = atoi(args[1]);
+	if (global.tune.log_batch < 0 || global.tune.log_batch > 1024) {
+		memprintf(err, "'%s' expects a numeric value between 0 and 1024.", args[0]);
+		return -1;
+	}
+	return 0;
+#else
+	memprintf(err, "'%s' is not supported on this platform (sendmmsg() is required).", args[0]);
+	return -1;
+#endif
+}
+
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.log.batch", cfg_parse_log_batch },
+	{ 0, NULL, NULL }
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
+
 REGISTER_PER_THREAD_ALLOC(init_log_buffers);
 REGISTER_PER_THREAD_FREE(deinit_log_buffers);
+#ifdef HA_HAVE_MMSG
+REGISTER_PER_THREAD_ALLOC(alloc_log_batch);
+REGISTER_PER_THREAD_FREE(free_log_batch);
+REGISTER_PER_THREAD_ALLOC(alloc_log_recv_batch);
+REGISTER_PER_THREAD_FREE(free_log_recv_batch);
+#endif
 
 /*
  * Local variables:
@@ -18,6 +18,7 @@
 #include <haproxy/arg.h>
 #include <haproxy/cli.h>
 #include <haproxy/map.h>
+#include <haproxy/patmap.h>
 #include <haproxy/pattern.h>
 #include <haproxy/regex.h>
 #include <haproxy/sample.h>
@@ -328,7 +329,10 @@ struct pattern_expr *pat_expr_get_next(struct pattern_expr *getnext, struct list
  */
 struct show_map_ctx {
 	struct pat_ref *ref;
-	struct bref bref;	/* back-reference from the pat_ref_elt being dumped */
+	union {
+		struct bref bref;	/* back-reference from the pat_ref_elt being dumped */
+		uint64_t idx;           /* next entry to dump from a compiled map */
+	};
 	struct pattern_expr *expr;
 	struct buffer chunk;
 	unsigned int display_flags;
@@ -341,12 +345,55 @@ struct show_map_ctx {
 	} state;                /* state of the dump */
 };
 
+/* appends to <out> the IPv4 range <from>-<to> (host byte order) */
+static void map_append_ip4_range(struct buffer *out, uint32_t from, uint32_t to)
+{
+	struct in_addr addr;
+	char str[INET_ADDRSTRLEN];
+
+	addr.s_addr = htonl(from);
+	chunk_appendf(out, "%s-", inet_ntop(AF_INET, &addr, str, sizeof(str)));
+	addr.s_addr = htonl(to);
+	chunk_appendf(out, "%s", inet_ntop(AF_INET, &addr, str, sizeof(str)));
+}
+
+/* dumps the entries of a compiled map, starting at ctx->idx. Entries are
+ * designated by their index since they are not allocated. The map may be
+ * replaced between two calls, in which case the dump simply continues at
+ * the same index in the new one.
+ */
+static int cli_io_handler_mmap_list(struct appctx *appctx)
+{
+	struct show_map_ctx *ctx = appctx->svcctx;
+	const struct patmap *map = HA_ATOMIC_LOAD(&ctx->ref->mmap);
+
+	for (; ctx->idx < map->count; ctx->idx++) {
+		chunk_printf(&trash, "#%llu ", (ullong)ctx->idx);
+		if (map->type == PATMAP_T_STR) {
+			const struct patmap_str *ent = (const struct patmap_str *)map->ent + ctx->idx;
+
+			chunk_appendf(&trash, "%.*s", (int)ent->key_len, map->str + ent->key_ofs);
+		}
+		else {
+			const struct patmap_ip4 *ent = (const struct patmap_ip4 *)map->ent + ctx->idx;
+
+			map_append_ip4_range(&trash, ent->from, ent->to);
+		}
+		chunk_appendf(&trash, " %s\n", patmap_value(map, ctx->idx));
+
+		if (applet_putchk(appctx, &trash) == -1)
+			return 0;
+	}
+	return 1;
+}
+
 /* expects the current generation ID in ctx->curr_gen */
 static int cli_io_handler_pat_list(struct appctx *appctx)
 {
 	struct show_map_ctx *ctx = appctx->svcctx;
 	struct stconn *sc = appctx_sc(appctx);
 	struct pat_ref_elt *elt;
+	int budget = CLI_DUMP_BATCH;
 
 	if (unlikely(sc_ic(sc)->flags & (CF_WRITE_ERROR|CF_SHUTW))) {
 		/* If we're forced to shut down, we might have to remove our
@@ -380,6 +427,16 @@ static int cli_io_handler_pat_list(struct appctx *appctx)
 
 			elt = LIST_ELEM(ctx->bref.ref, struct pat_ref_elt *, list);
 
+			if (budget-- <= 0) {
+				/* release the lock and let other tasks run,
+				 * we'll continue from this element.
+				 */
+				LIST_APPEND(&elt->back_refs, &ctx->bref.users);
+				HA_SPIN_UNLOCK(PATREF_LOCK, &ctx->ref->lock);
+				applet_have_more_data(appctx);
+				return 0;
+			}
+
 			if (elt->gen_id != ctx->curr_gen)
 				goto skip;
 
@@ -441,16 +498,33 @@ static int cli_io_handler_pats_list(struct appctx *appctx)
 
 	case STATE_LIST:
 		while (ctx->ref) {
+			unsigned long long lookups = 0, hits = 0, evictions = 0;
+			struct pattern_expr *expr;
+
 			chunk_reset(&trash);
 
+			/* the cache statistics are those of all the reference's expressions */
+			list_for_each_entry(expr, &ctx->ref->pat, list) {
+				lookups   += HA_ATOMIC_LOAD(&expr->cache_lookups);
+				hits      += HA_ATOMIC_LOAD(&expr->cache_hits);
+				evictions += HA_ATOMIC_LOAD(&expr->cache_evictions);
+			}
+
 			/* Build messages. If the reference is used by another category than
 			 * the listed categories, display the information in the message.
 			 */
-			chunk_appendf(&trash, "%d (%s) %s. curr_ver=%u next_ver=%u entry_cnt=%llu\n", ctx->ref->unique_id,
+			chunk_appendf(&trash, "%d (%s) %s. curr_ver=%u next_ver=%u entry_cnt=%llu", ctx->ref->unique_id,
 			              ctx->ref->reference ? ctx->ref->reference : "",
 			              ctx->ref->display, ctx->ref->curr_gen, ctx->ref->next_gen,
 			              ctx->ref->entry_cnt);
 
+			if (ctx->ref->cache_size < 0)
+				chunk_appendf(&trash, " cache=shared");
+			else
+				chunk_appendf(&trash, " cache=%d", ctx->ref->cache_size);
+			chunk_appendf(&trash, " cache_lookups=%llu cache_hits=%llu cache_evictions=%llu\n",
+			              lookups, hits, evictions);
+
 			if (applet_putchk(appctx, &trash) == -1) {
 				/* let's try again later from this stream. We add ourselves into
 				 * this stream's users so that it can remove us upon termination.
@@ -500,11 +574,13 @@ static int cli_io_handler_map_lookup(struct appctx *appctx)
 			sample.data.u.str.data = ctx->chunk.data;
 			sample.data.u.str.area = ctx->chunk.area;
 
-			if (ctx->expr->pat_head->match &&
-			    sample_convert(&sample, ctx->expr->pat_head->expect_type))
-				pat = ctx->expr->pat_head->match(&sample, ctx->expr, 1);
-			else
+			if (!ctx->expr->pat_head->match ||
+			    !sample_convert(&sample, ctx->expr->pat_head->expect_type))
 				pat = NULL;
+			else if (ctx->ref->mmap)
+				pat = pat_ref_match_mmap(ctx->ref, ctx->expr->pat_head, &sample, 1);
+			else
+				pat = ctx->expr->pat_head->match(&sample, ctx->expr, 1);
 
 			/* build return message: set type of match */
 			for (match_method=0; match_method<PAT_MATCH_NUM; match_method++)
@@ -538,13 +614,34 @@ static int cli_io_handler_map_lookup(struct appctx *appctx)
 					chunk_appendf(&trash, ", match=yes");
 
 				/* display index mode */
-				if (pat->sflags & PAT_SF_TREE)
+				if (ctx->ref->mmap)
+					chunk_appendf(&trash, ", idx=compiled");
+				else if (pat->sflags & PAT_SF_TREE)
 					chunk_appendf(&trash, ", idx=tree");
 				else
 					chunk_appendf(&trash, ", idx=list");
 
 				/* display pattern */
-				if (ctx->display_flags == PAT_REF_MAP) {
+				if (ctx->ref->mmap) {
+					struct sample value = { .flags = SMP_F_CONST };
+
+					chunk_appendf(&trash, ", key=\"");
+					if (pat->type == SMP_T_STR)
+						chunk_appendf(&trash, "%.*s", pat->len, pat->ptr.str);
+					else
+						map_append_ip4_range(&trash, pat->val.range.min, pat->val.range.max);
+					chunk_appendf(&trash, "\"");
+
+					if (pat->data)
+						value.data = *pat->data;
+					if (pat->data && sample_convert(&value, SMP_T_STR))
+						chunk_appendf(&trash, ", value=\"%.*s\", type=\"%s\"",
+						              (int)value.data.u.str.data, value.data.u.str.area,
+						              smp_to_type[pat->data->type]);
+					else
+						chunk_appendf(&trash, ", value=none");
+				}
+				else if (ctx->display_flags == PAT_REF_MAP) {
 					if (pat->ref && pat->ref->pattern)
 						chunk_appendf(&trash, ", key=\"%s\"", pat->ref->pattern);
 					else
@@ -558,7 +655,7 @@ static int cli_io_handler_map_lookup(struct appctx *appctx)
 				}
 
 				/* display return value */
-				if (ctx->display_flags == PAT_REF_MAP) {
+				if (!ctx->ref->mmap && ctx->display_flags == PAT_REF_MAP) {
 					if (pat->data && pat->ref && pat->ref->sample)
 						chunk_appendf(&trash, ", value=\"%s\", type=\"%s\"", pat->ref->sample,
 						              smp_to_type[pat->data->type]);
@@ -666,6 +763,10 @@ static int cli_parse_prepare_map(char **args, char *payload, struct appctx *appc
 			else
 				return cli_err(appctx, "Unknown ACL identifier. Please use #<id> or <file>.\n");
 		}
+
+		if (ctx->ref->mmap)
+			return cli_err(appctx, "Compiled maps are read-only, please use 'reload map'.\n");
+
 		next_gen = pat_ref_newgen(ctx->ref);
 		return cli_dynmsg(appctx, LOG_INFO, memprintf(&msg, "New version created: %u\n", next_gen));
 	}
@@ -723,6 +824,12 @@ static int cli_parse_show_map(char **args, char *payload, struct appctx *appctx,
 				return cli_err(appctx, "Unknown ACL identifier. Please use #<id> or <file>.\n");
 		}
 
+		/* compiled maps have no generation and are dumped by index */
+		if (ctx->ref->mmap) {
+			appctx->io_handler = cli_io_handler_mmap_list;
+			return 0;
+		}
+
 		/* set the desired generation id in curr_gen */
 		if (gen)
 			ctx->curr_gen = str2uic(gen);
@@ -757,6 +864,9 @@ static int cli_parse_set_map(char **args, char *payload, struct appctx *appctx,
 		if (!ctx->ref)
 			return cli_err(appctx, "Unknown map identifier. Please use #<id> or <file>.\n");
 
+		if (ctx->ref->mmap)
+			return cli_err(appctx, "Compiled maps are read-only, please use 'reload map'.\n");
+
 		/* If the entry identifier start with a '#', it is considered as
 		 * pointer id
 		 */
@@ -860,6 +970,9 @@ static int cli_parse_add_map(char **args, char *payload, struct appctx *appctx,
 				return cli_err(appctx, "Unknown ACL identifier. Please use #<id> or <file>.\n");
 		}
 
+		if (ctx->ref->mmap)
+			return cli_err(appctx, "Compiled maps are read-only, please use 'reload map'.\n");
+
 		if (gen) {
 			genid = str2uic(gen);
 			if ((int)(genid - ctx->ref->next_gen) > 0) {
@@ -963,6 +1076,9 @@ static int cli_parse_del_map(char **args, char *payload, struct appctx *appctx,
 	    !(ctx->ref->flags & ctx->display_flags))
 		return cli_err(appctx, "Unknown map identifier. Please use #<id> or <file>.\n");
 
+	if (ctx->ref->mmap)
+		return cli_err(appctx, "Compiled maps are read-only, please use 'reload map'.\n");
+
 	/* If the entry identifier start with a '#', it is considered as
 	 * pointer id
 	 */
@@ -1073,6 +1189,9 @@ static int cli_parse_clear_map(char **args, char *payload, struct appctx *appctx
 				return cli_err(appctx, "Unknown ACL identifier. Please use #<id> or <file>.\n");
 		}
 
+		if (ctx->ref->mmap)
+			return cli_err(appctx, "Compiled maps are read-only, please use 'reload map'.\n");
+
 		/* set the desired generation id in curr_gen/prev_gen */
 		if (gen)
 			ctx->prev_gen = ctx->curr_gen = str2uic(gen);
@@ -1134,6 +1253,9 @@ static int cli_parse_commit_map(char **args, char *payload, struct appctx *appct
 				return cli_err(appctx, "Unknown ACL identifier. Please use #<id> or <file>.\n");
 		}
 
+		if (ctx->ref->mmap)
+			return cli_err(appctx, "Compiled maps are read-only, please use 'reload map'.\n");
+
 		HA_SPIN_LOCK(PATREF_LOCK, &ctx->ref->lock);
 		if (genid - (ctx->ref->curr_gen + 1) <
 		    ctx->ref->next_gen - ctx->ref->curr_gen)
@@ -1151,6 +1273,29 @@ static int cli_parse_commit_map(char **args, char *payload, struct appctx *appct
 	return 1;
 }
 
+/* replaces a compiled map with the current contents of its file */
+static int cli_parse_reload_map(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	struct pat_ref *ref;
+	char *err = NULL, *msg = NULL;
+
+	if (!*args[2])
+		return cli_err(appctx, "Missing map identifier.\n");
+
+	ref = pat_ref_lookup_ref(args[2]);
+	if (!ref || !(ref->flags & PAT_REF_MAP))
+		return cli_err(appctx, "Unknown map identifier. Please use #<id> or <file>.\n");
+
+	if (!ref->mmap)
+		return cli_err(appctx, "Only compiled maps may be reloaded.\n");
+
+	if (!pat_ref_reload_mmap(ref, &err))
+		return cli_dynerr(appctx, memprintf(&err, "%s.\n", err));
+
+	return cli_dynmsg(appctx, LOG_INFO, memprintf(&msg, "Map reloaded: %llu entries.\n",
+	                                              (ullong)ref->mmap->count));
+}
+
 /* register cli keywords */
 
 static struct cli_kw_list cli_kws = {{ },{
@@ -1167,6 +1312,7 @@ static struct cli_kw_list cli_kws = {{ },{
 	{ { "del",   "map", NULL }, "del map <map> [<key>|#<ref>]            : delete map entries matching <key>",                      cli_parse_del_map, NULL },
 	{ { "get",   "map", NULL }, "get map <acl> <value>                   : report the keys and values matching a sample for a map", cli_parse_get_map, cli_io_handler_map_lookup, cli_release_mlook },
 	{ { "prepare","map",NULL }, "prepare map <acl>                       : prepare a new version for atomic map replacement",       cli_parse_prepare_map, NULL },
+	{ { "reload","map", NULL }, "reload map <map>                        : atomically replace a compiled map with its file's contents", cli_parse_reload_map, NULL },
 	{ { "set",   "map", NULL }, "set map <map> [<key>|#<ref>] <value>    : modify a map entry",                                     cli_parse_set_map, NULL },
 	{ { "show",  "map", NULL }, "show map [@ver] [map]                   : report available maps or dump a map's contents",         cli_parse_show_map, NULL },
 	{ { NULL }, NULL, NULL, NULL }
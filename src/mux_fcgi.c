@@ -3050,9 +3050,14 @@ static int fcgi_process(struct fcgi_conn *fconn)
 		}
 	}
 
+	/* Note: an idle connection kept alive must not be released here just
+	 * because it has no more streams. It commonly happens when the
+	 * END_REQUEST record is received after the stream was detached, and
+	 * it would otherwise prevent the connection from being reused.
+	 */
 	if ((fconn->flags & FCGI_CF_ERROR) || fcgi_conn_read0_pending(fconn) ||
 	    fconn->state == FCGI_CS_CLOSED || (fconn->flags & FCGI_CF_ABRTS_FAILED) ||
-	    eb_is_empty(&fconn->streams_by_id)) {
+	    (eb_is_empty(&fconn->streams_by_id) && !(fconn->flags & FCGI_CF_KEEP_CONN))) {
 		fcgi_wake_some_streams(fconn, 0);
 
 		if (eb_is_empty(&fconn->streams_by_id)) {
@@ -3093,7 +3098,10 @@ static int fcgi_wake(struct connection *conn)
 
 static int fcgi_ctl(struct connection *conn, enum mux_ctl_type mux_ctl, void *output)
 {
+	struct fcgi_conn *fconn = conn->ctx;
 	int ret = 0;
+	int i;
+
 	switch (mux_ctl) {
 	case MUX_STATUS:
 		if (!(conn->flags & CO_FL_WAIT_XPRT))
@@ -3101,6 +3109,26 @@ static int fcgi_ctl(struct connection *conn, enum mux_ctl_type mux_ctl, void *ou
 		return ret;
 	case MUX_EXIT_STATUS:
 		return MUX_ES_UNKNOWN;
+	case MUX_BUF_INFO: {
+		struct mux_buf_info *info = output;
+
+		info->idle   = !fconn->nb_streams;
+		info->rxbufs = !!b_size(&fconn->dbuf);
+		info->txbufs = 0;
+		info->size   = b_size(&fconn->dbuf);
+		/* walk the mbuf ring from head to tail, its root is not a buffer */
+		for (i = br_head_idx(fconn->mbuf); ; ) {
+			if (b_size(&fconn->mbuf[i])) {
+				info->txbufs++;
+				info->size += b_size(&fconn->mbuf[i]);
+			}
+			if (i == br_tail_idx(fconn->mbuf))
+				break;
+			if (++i >= br_size(fconn->mbuf))
+				i = 1;
+		}
+		return 0;
+	}
 	default:
 		return -1;
 	}
@@ -3608,7 +3636,7 @@ static void fcgi_detach(struct sedesc *sd)
 			else if (!fconn->conn->hash_node->node.node.leaf_p &&
 				 fcgi_avail_streams(fconn->conn) > 0 && objt_server(fconn->conn->target) &&
 				 !LIST_INLIST(&fconn->conn->session_list)) {
-				eb64_insert(&__objt_server(fconn->conn->target)->per_thr[tid].avail_conns,
+				eb64_insert(srv_avail_conns(__objt_server(fconn->conn->target)),
 				            &fconn->conn->hash_node->node);
 			}
 		}
@@ -15,6 +15,7 @@
 #include <haproxy/api.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/connection.h>
+#include <haproxy/counters.h>
 #include <haproxy/dynbuf.h>
 #include <haproxy/h1.h>
 #include <haproxy/h1_htx.h>
@@ -26,7 +27,9 @@
 #include <haproxy/mux_h1-t.h>
 #include <haproxy/pipe-t.h>
 #include <haproxy/proxy.h>
+#include <haproxy/server.h>
 #include <haproxy/session-t.h>
+#include <haproxy/sock.h>
 #include <haproxy/stats.h>
 #include <haproxy/stconn.h>
 #include <haproxy/stream.h>
@@ -36,6 +39,8 @@
 struct h1c {
 	struct connection *conn;
 	struct h1s *h1s;                 /* H1 stream descriptor */
+	struct list pipeline;            /* H1 streams pipelined after <h1s>, waiting for their response (backend only) */
+	unsigned int nb_pipelined;       /* Number of H1 streams in <pipeline> */
 	struct task *task;               /* timeout management task */
 
 	uint32_t flags;                  /* Connection flags: H1C_F_* */
@@ -64,6 +69,7 @@ struct h1s {
 	uint32_t flags;                /* Connection flags: H1S_F_* */
 
 	struct wait_event *subs;      /* Address of the wait_event the stream connector associated is waiting on */
+	struct list list;             /* To be attached to the h1c pipeline list */
 
 	struct session *sess;         /* Associated session */
 	struct buffer rxbuf;          /* receive buffer, always valid (buf_empty or real buffer) */
@@ -213,6 +219,7 @@ enum {
 	H1_ST_OPEN_STREAM,
 	H1_ST_TOTAL_CONN,
 	H1_ST_TOTAL_STREAM,
+	H1_ST_PIPELINED_STREAM,
 
 	H1_ST_BYTES_IN,
 	H1_ST_BYTES_OUT,
@@ -233,6 +240,8 @@ static struct name_desc h1_stats[] = {
 	                                 .desc = "Total number of connections" },
 	[H1_ST_TOTAL_STREAM]         = { .name = "h1_total_streams",
 	                                 .desc = "Total number of streams" },
+	[H1_ST_PIPELINED_STREAM]     = { .name = "h1_pipelined_streams",
+	                                 .desc = "Total number of streams pipelined on a busy connection" },
 
 	[H1_ST_BYTES_IN]             = { .name = "h1_bytes_in",
 	                                 .desc = "Total number of bytes received" },
@@ -252,6 +261,7 @@ static struct h1_counters {
 	long long open_streams;       /* count of currently open streams */
 	long long total_conns;        /* total number of connections */
 	long long total_streams;      /* total number of streams */
+	long long pipelined_streams;  /* total number of streams pipelined on a busy connection */
 
 	long long bytes_in;           /* number of bytes received */
 	long long bytes_out;          /* number of bytes sent */
@@ -269,6 +279,7 @@ static void h1_fill_stats(void *data, struct field *stats)
 	stats[H1_ST_OPEN_STREAM]      = mkf_u64(FN_GAUGE,   counters->open_streams);
 	stats[H1_ST_TOTAL_CONN]       = mkf_u64(FN_COUNTER, counters->total_conns);
 	stats[H1_ST_TOTAL_STREAM]     = mkf_u64(FN_COUNTER, counters->total_streams);
+	stats[H1_ST_PIPELINED_STREAM] = mkf_u64(FN_COUNTER, counters->pipelined_streams);
 
 	stats[H1_ST_BYTES_IN]          = mkf_u64(FN_COUNTER, counters->bytes_in);
 	stats[H1_ST_BYTES_OUT]         = mkf_u64(FN_COUNTER, counters->bytes_out);
@@ -305,6 +316,7 @@ struct task *h1_timeout_task(struct task *t, void *context, unsigned int state);
 static void h1_shutw_conn(struct connection *conn);
 static void h1_wake_stream_for_recv(struct h1s *h1s);
 static void h1_wake_stream_for_send(struct h1s *h1s);
+static void h1_alert(struct h1s *h1s);
 
 /* returns the stconn associated to the H1 stream */
 static forceinline struct stconn *h1s_sc(const struct h1s *h1s)
@@ -312,6 +324,17 @@ static forceinline struct stconn *h1s_sc(const struct h1s *h1s)
 	return h1s->sd->sc;
 }
 
+/* Returns the last H1 stream attached to the connection. This is the one
+ * allowed to emit data. It is the last pipelined stream if any, otherwise the
+ * one waiting for its response.
+ */
+static inline struct h1s *h1c_last_stream(const struct h1c *h1c)
+{
+	if (h1c->nb_pipelined)
+		return LIST_PREV(&h1c->pipeline, struct h1s *, list);
+	return h1c->h1s;
+}
+
 /* the H1 traces always expect that arg1, if non-null, is of type connection
  * (from which we can derive h1c), that arg2, if non-null, is of type h1s, and
  * that arg3, if non-null, is a htx for rx/tx headers.
@@ -471,10 +494,10 @@ static int h1_buf_available(void *target)
 	}
 
 	if ((h1c->flags & H1C_F_OUT_ALLOC) && b_alloc(&h1c->obuf)) {
-		TRACE_STATE("unblocking h1s, obuf allocated", H1_EV_TX_DATA|H1_EV_H1S_BLK|H1_EV_STRM_WAKE, h1c->conn, h1c->h1s);
+		TRACE_STATE("unblocking h1s, obuf allocated", H1_EV_TX_DATA|H1_EV_H1S_BLK|H1_EV_STRM_WAKE, h1c->conn, h1c_last_stream(h1c));
 		h1c->flags &= ~H1C_F_OUT_ALLOC;
 		if (h1c->h1s)
-			h1_wake_stream_for_send(h1c->h1s);
+			h1_wake_stream_for_send(h1c_last_stream(h1c));
 		return 1;
 	}
 
@@ -504,6 +527,27 @@ static inline struct buffer *h1_get_buf(struct h1c *h1c, struct buffer *bptr)
 	return buf;
 }
 
+/*
+ * Get the input buffer of the connection <h1c>. A small buffer is preferred as
+ * long as the current message's headers are not fully received, since most
+ * messages are entirely made of small headers. If no buffer is available, the
+ * connection is put in the buffer wait list.
+ */
+static inline struct buffer *h1_get_ibuf(struct h1c *h1c)
+{
+	const struct h1m *h1m;
+
+	if (!pool_head_small_buffer || !h1c->h1s)
+		h1m = NULL;
+	else
+		h1m = (h1c->flags & H1C_F_IS_BACK) ? &h1c->h1s->res : &h1c->h1s->req;
+
+	if (pool_head_small_buffer && (!h1m || h1m->state < H1_MSG_CHUNK_SIZE) &&
+	    likely(!LIST_INLIST(&h1c->buf_wait.list)) && b_alloc_small(&h1c->ibuf))
+		return &h1c->ibuf;
+	return h1_get_buf(h1c, &h1c->ibuf);
+}
+
 /*
  * Release a buffer, if any, and try to wake up entities waiting in the buffer
  * wait queue.
@@ -542,13 +586,91 @@ static int h1_used_streams(struct connection *conn)
 {
 	struct h1c *h1c = conn->ctx;
 
-	return ((h1c->state == H1_CS_IDLE) ? 0 : 1);
+	return ((h1c->state == H1_CS_IDLE) ? 0 : 1 + h1c->nb_pipelined);
+}
+
+/* Returns 1 if a new request may be pipelined on the backend connection
+ * <h1c>. Otherwise 0 is returned. It must be enabled on the server, the
+ * connection must be shareable ("http-reuse always") and all previous
+ * requests must be fully sent, idempotent and in keep-alive mode.
+ */
+static int h1c_may_pipeline(const struct h1c *h1c)
+{
+	const struct server *srv = objt_server(h1c->conn->target);
+	const struct h1s *h1s = h1c_last_stream(h1c);
+
+	if (!srv || srv->max_pipeline <= 1 || h1c->nb_pipelined + 1 >= srv->max_pipeline)
+		return 0;
+
+	if ((h1c->px->options & PR_O_REUSE_MASK) != PR_O_REUSE_ALWS || (h1c->conn->flags & CO_FL_PRIVATE))
+		return 0;
+
+	if (h1c->state != H1_CS_RUNNING ||
+	    (h1c->flags & (H1C_F_EOS|H1C_F_ERR_PENDING|H1C_F_ERROR|H1C_F_ABRT_PENDING|H1C_F_ABRTED)))
+		return 0;
+
+	if (!h1s || h1s->req.state != H1_MSG_DONE || (h1s->req.flags & H1_MF_CONN_UPG) ||
+	    (h1s->meth != HTTP_METH_GET && h1s->meth != HTTP_METH_HEAD))
+		return 0;
+
+	/* The response being received must not announce the connection closure */
+	if (!(h1s->flags & H1S_F_WANT_KAL) || !(h1c->h1s->flags & H1S_F_WANT_KAL))
+		return 0;
+
+	return 1;
 }
 
 /* returns the number of streams still available on a connection */
 static int h1_avail_streams(struct connection *conn)
 {
-	return 1 - h1_used_streams(conn);
+	struct h1c *h1c = conn->ctx;
+
+	if (h1c->state == H1_CS_IDLE)
+		return 1;
+	if (!h1c_may_pipeline(h1c))
+		return 0;
+	return __objt_server(conn->target)->max_pipeline - h1_used_streams(conn);
+}
+
+/* Inserts the backend connection <h1c> in the server's available connections
+ * tree if a new request may be pipelined on it. Nothing is done if it is
+ * already there.
+ */
+static void h1c_make_available(struct h1c *h1c)
+{
+	struct connection *conn = h1c->conn;
+
+	if (!conn->hash_node || conn->hash_node->node.node.leaf_p ||
+	    LIST_INLIST(&conn->session_list) || !h1c_may_pipeline(h1c))
+		return;
+
+	HA_SPIN_LOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
+	eb64_insert(srv_avail_conns(__objt_server(conn->target)), &conn->hash_node->node);
+	HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
+	TRACE_STATE("backend connection available for pipelining", H1_EV_H1C_WAKE, conn, h1c->h1s);
+}
+
+/* Reports a read0 to the H1 stream <h1s> pipelined on a connection that will
+ * not deliver its response. Input processing is blocked to not parse any
+ * remaining data. It is reported as an empty response, so it may be retried.
+ */
+static void h1s_fail_pipelined(struct h1s *h1s)
+{
+	h1s->flags |= H1S_F_RX_BLK;
+	se_fl_set(h1s->sd, SE_FL_EOS);
+	TRACE_STATE("report EOS to pipelined SE", H1_EV_H1S_ERR, h1s->h1c->conn, h1s);
+	h1_alert(h1s);
+}
+
+/* Reports a read0 to all H1 streams pipelined after the first one on the
+ * connection <h1c>. Their response will never be received.
+ */
+static void h1c_fail_pipeline(struct h1c *h1c)
+{
+	struct h1s *h1s, *back;
+
+	list_for_each_entry_safe(h1s, back, &h1c->pipeline, list)
+		h1s_fail_pipelined(h1s);
 }
 
 /* Refresh the h1c task timeout if necessary */
@@ -668,6 +790,20 @@ static inline size_t h1s_data_pending(const struct h1s *h1s)
 	return ((h1m->state == H1_MSG_DONE) ? 0 : b_data(&h1s->h1c->ibuf));
 }
 
+/* Appends to the output buffer the CRLF ending the last chunk whose payload was
+ * spliced, if it was not already emitted. The output buffer must be allocated.
+ * Returns 0 if there is not enough room in the output buffer, otherwise 1.
+ */
+static inline int h1_put_spliced_chunk_crlf(struct h1s *h1s)
+{
+	if (!(h1s->flags & H1S_F_CHNK_CRLF))
+		return 1;
+	if (b_putblk(&h1s->h1c->obuf, "\r\n", 2) != 2)
+		return 0;
+	h1s->flags &= ~H1S_F_CHNK_CRLF;
+	return 1;
+}
+
 /* Creates a new stream connector and the associate stream. <input> is used as input
  * buffer for the stream. On success, it is transferred to the stream and the
  * mux is no longer responsible of it. On error, <input> is unchanged, thus the
@@ -730,7 +866,6 @@ static struct h1s *h1s_new(struct h1c *h1c)
 		goto fail;
 	}
 	h1s->h1c = h1c;
-	h1c->h1s = h1s;
 	h1s->sess = NULL;
 	h1s->sd = NULL;
 	h1s->flags = H1S_F_WANT_KAL;
@@ -747,6 +882,20 @@ static struct h1s *h1s_new(struct h1c *h1c)
 	h1s->status = 0;
 	h1s->meth   = HTTP_METH_OTHER;
 
+	if (h1c->h1s) {
+		/* A stream is still waiting for its response, this one is
+		 * pipelined after it. Only possible on backend connections.
+		 */
+		BUG_ON(!(h1c->flags & H1C_F_IS_BACK));
+		LIST_APPEND(&h1c->pipeline, &h1s->list);
+		h1c->nb_pipelined++;
+		h1s->flags |= H1S_F_NOT_FIRST;
+		TRACE_LEAVE(H1_EV_H1S_NEW, h1c->conn, h1s);
+		return h1s;
+	}
+
+	LIST_INIT(&h1s->list);
+	h1c->h1s = h1s;
 	if (h1c->flags & H1C_F_WAIT_NEXT_REQ)
 		h1s->flags |= H1S_F_NOT_FIRST;
 	h1s->h1c->state = H1_CS_EMBRYONIC;
@@ -826,12 +975,18 @@ static struct h1s *h1c_bck_stream_new(struct h1c *h1c, struct stconn *sc, struct
 
 	HA_ATOMIC_INC(&h1c->px_counters->open_streams);
 	HA_ATOMIC_INC(&h1c->px_counters->total_streams);
+	if (LIST_INLIST(&h1s->list))
+		HA_ATOMIC_INC(&h1c->px_counters->pipelined_streams);
 
 	TRACE_LEAVE(H1_EV_H1S_NEW, h1c->conn, h1s);
 	return h1s;
 
   fail:
 	TRACE_DEVEL("leaving on error", H1_EV_STRM_NEW|H1_EV_STRM_ERR, h1c->conn);
+	if (h1s && LIST_INLIST(&h1s->list)) {
+		LIST_DELETE(&h1s->list);
+		h1c->nb_pipelined--;
+	}
 	pool_free(pool_head_h1s, h1s);
 	return NULL;
 }
@@ -842,30 +997,66 @@ static void h1s_destroy(struct h1s *h1s)
 		struct h1c *h1c = h1s->h1c;
 
 		TRACE_POINT(H1_EV_H1S_END, h1c->conn, h1s);
-		h1c->h1s = NULL;
 
 		if (h1s->subs)
 			h1s->subs->events = 0;
 
 		h1_release_buf(h1c, &h1s->rxbuf);
 
-		h1c->flags &= ~(H1C_F_WANT_SPLICE|
-				H1C_F_OUT_FULL|H1C_F_OUT_ALLOC|H1C_F_IN_SALLOC|
-				H1C_F_CO_MSG_MORE|H1C_F_CO_STREAMER);
+		if (h1s != h1c->h1s) {
+			/* A pipelined stream aborted before its response was
+			 * received. Responses could no longer be matched to
+			 * their requests, so the connection will be closed
+			 * once the current response is received.
+			 */
+			LIST_DELETE(&h1s->list);
+			h1c->nb_pipelined--;
+			h1c->h1s->flags = (h1c->h1s->flags & ~H1S_F_WANT_MSK) | H1S_F_WANT_CLO;
+			TRACE_STATE("pipelined stream aborted, close h1c after the current response", H1_EV_H1S_END, h1c->conn, h1s);
+			goto end;
+		}
+
+		h1c->h1s = NULL;
+		h1c->flags &= ~(H1C_F_WANT_SPLICE|H1C_F_IN_SALLOC);
+		if (!h1c->nb_pipelined)
+			h1c->flags &= ~(H1C_F_OUT_FULL|H1C_F_OUT_ALLOC|H1C_F_CO_MSG_MORE|H1C_F_CO_STREAMER);
 
 		if (!(h1c->flags & (H1C_F_EOS|H1C_F_ERR_PENDING|H1C_F_ERROR|H1C_F_ABRT_PENDING|H1C_F_ABRTED)) &&  /* No error/read0/abort */
 		    h1_is_alive(h1c) &&                                                      /* still alive */
 		    (h1s->flags & H1S_F_WANT_KAL) &&                                         /* K/A possible */
 		    h1s->req.state == H1_MSG_DONE && h1s->res.state == H1_MSG_DONE) {        /* req/res in DONE state */
-			h1c->state = H1_CS_IDLE;
-			h1c->flags |= H1C_F_WAIT_NEXT_REQ;
-			TRACE_STATE("set idle mode on h1c, waiting for the next request", H1_EV_H1C_ERR, h1c->conn, h1s);
+			if (h1c->nb_pipelined) {
+				/* The next pipelined stream now waits for its response */
+				h1c->h1s = LIST_NEXT(&h1c->pipeline, struct h1s *, list);
+				LIST_DEL_INIT(&h1c->h1s->list);
+				h1c->nb_pipelined--;
+				TRACE_STATE("next pipelined stream waiting for its response", H1_EV_H1S_END, h1c->conn, h1c->h1s);
+				h1_wake_stream_for_recv(h1c->h1s);
+			}
+			else {
+				h1c->state = H1_CS_IDLE;
+				h1c->flags |= H1C_F_WAIT_NEXT_REQ;
+				TRACE_STATE("set idle mode on h1c, waiting for the next request", H1_EV_H1C_ERR, h1c->conn, h1s);
+			}
 		}
 		else {
+			if (h1c->nb_pipelined) {
+				/* Pipelined streams will never get their response.
+				 * The first one is kept as the current stream to
+				 * keep the connection alive till all are detached.
+				 */
+				h1c->h1s = LIST_NEXT(&h1c->pipeline, struct h1s *, list);
+				LIST_DEL_INIT(&h1c->h1s->list);
+				h1c->nb_pipelined--;
+				h1s_fail_pipelined(h1c->h1s);
+				h1c_fail_pipeline(h1c);
+			}
 			h1_close(h1c);
 			TRACE_STATE("close h1c", H1_EV_H1S_END, h1c->conn, h1s);
 		}
 
+	  end:
+
 		HA_ATOMIC_DEC(&h1c->px_counters->open_streams);
 		BUG_ON(h1s->sd && !se_fl_test(h1s->sd, SE_FL_ORPHAN));
 		sedesc_free(h1s->sd);
@@ -904,6 +1095,8 @@ static int h1_init(struct connection *conn, struct proxy *proxy, struct session
 	h1c->ibuf  = *input;
 	h1c->obuf  = BUF_NULL;
 	h1c->h1s   = NULL;
+	LIST_INIT(&h1c->pipeline);
+	h1c->nb_pipelined = 0;
 	h1c->task  = NULL;
 
 	LIST_INIT(&h1c->buf_wait.list);
@@ -950,8 +1143,10 @@ static int h1_init(struct connection *conn, struct proxy *proxy, struct session
 
 	conn->ctx = h1c;
 
-	if (h1c->flags & H1C_F_IS_BACK) {
-		/* Create a new H1S now for backend connection only */
+	if ((h1c->flags & H1C_F_IS_BACK) && conn_ctx) {
+		/* Create a new H1S now for backend connection only, unless
+		 * it is established in advance to be kept idle.
+		 */
 		if (!h1c_bck_stream_new(h1c, conn_ctx, sess))
 			goto fail;
 	}
@@ -965,6 +1160,16 @@ static int h1_init(struct connection *conn, struct proxy *proxy, struct session
 		TRACE_DEVEL("Inherit the SC from TCP connection to perform an upgrade",
 			    H1_EV_H1C_NEW|H1_EV_STRM_NEW, h1c->conn, h1c->h1s);
 	}
+	else if (h1c->flags & H1C_F_IS_BACK) {
+		/* Backend connection established in advance to be kept idle:
+		 * prepare it as h1_detach() does when the last stream leaves,
+		 * and always watch for a close, even while connecting.
+		 */
+		h1c->flags |= H1C_F_SILENT_SHUT;
+		HA_ATOMIC_OR(&h1c->wait_event.tasklet->state, TASK_F_USR1);
+		xprt_set_idle(conn, conn->xprt, conn->xprt_ctx);
+		conn->xprt->subscribe(conn, conn->xprt_ctx, SUB_RETRY_RECV, &h1c->wait_event);
+	}
 
 	if (t) {
 		h1_set_idle_expiration(h1c);
@@ -1017,7 +1222,9 @@ static void h1_release(struct h1c *h1c)
 		if (h1c->wait_event.events)
 			conn->xprt->unsubscribe(conn, conn->xprt_ctx,
 						h1c->wait_event.events, &h1c->wait_event);
-		if (conn_upgrade_mux_fe(conn, NULL, &h1c->ibuf, ist("h2"), PROTO_MODE_HTTP) != -1) {
+		/* the H2 mux needs a regular buffer to hold full frames */
+		if (b_upgrade_small(&h1c->ibuf) &&
+		    conn_upgrade_mux_fe(conn, NULL, &h1c->ibuf, ist("h2"), PROTO_MODE_HTTP) != -1) {
 			/* connection successfully upgraded to H2, this
 			 * mux was already released */
 			return;
@@ -1174,6 +1381,7 @@ static void h1_set_cli_conn_mode(struct h1s *h1s, struct h1m *h1m)
 
 		if (want_clo) {
 			h1s->flags = (h1s->flags & ~H1S_F_WANT_MSK) | H1S_F_WANT_CLO;
+			_HA_ATOMIC_INC(&soft_stop_kal_closed);
 			TRACE_STATE("stopping, set close mode", H1_EV_RX_DATA|H1_EV_RX_HDRS|H1_EV_TX_DATA|H1_EV_TX_HDRS, h1s->h1c->conn, h1s);
 		}
 	}
@@ -1856,8 +2064,12 @@ static size_t h1_process_demux(struct h1c *h1c, struct buffer *buf, size_t count
 		}
 	}
 
-	/* Here h1s_sc(h1s) is always defined */
-	if (!(h1m->flags & H1_MF_CHNK) && (h1m->state == H1_MSG_DATA || (h1m->state == H1_MSG_TUNNEL))) {
+	/* Here h1s_sc(h1s) is always defined. For chunked messages, splicing is
+	 * only possible for the payload of large enough chunks, the chunks
+	 * framing is always parsed from the input buffer.
+	 */
+	if ((h1m->state == H1_MSG_DATA && (!(h1m->flags & H1_MF_CHNK) || h1m->curr_len >= MIN_SPLICE_FORWARD)) ||
+	    h1m->state == H1_MSG_TUNNEL) {
 		TRACE_STATE("notify the mux can use splicing", H1_EV_RX_DATA|H1_EV_RX_BODY, h1c->conn, h1s);
 		se_fl_set(h1s->sd, SE_FL_MAY_SPLICE);
 	}
@@ -1925,13 +2137,12 @@ static size_t h1_process_demux(struct h1c *h1c, struct buffer *buf, size_t count
 }
 
 /*
- * Process outgoing data. It parses data and transfer them from the channel buffer into
- * h1c->obuf. It returns the number of bytes parsed and transferred if > 0, or
+ * Process outgoing data of the H1 stream <h1s>. It parses data and transfer them from
+ * the channel buffer into h1c->obuf. It returns the number of bytes parsed and transferred if > 0, or
  * 0 if it couldn't proceed.
  */
-static size_t h1_process_mux(struct h1c *h1c, struct buffer *buf, size_t count)
+static size_t h1_process_mux(struct h1c *h1c, struct h1s *h1s, struct buffer *buf, size_t count)
 {
-	struct h1s *h1s = h1c->h1s;
 	struct h1m *h1m;
 	struct htx *chn_htx = NULL;
 	struct htx_blk *blk;
@@ -1954,6 +2165,12 @@ static size_t h1_process_mux(struct h1c *h1c, struct buffer *buf, size_t count)
 		goto end;
 	}
 
+	if (!h1_put_spliced_chunk_crlf(h1s)) {
+		h1c->flags |= H1C_F_OUT_FULL;
+		TRACE_STATE("h1c obuf full", H1_EV_TX_DATA|H1_EV_H1S_BLK, h1c->conn, h1s);
+		goto end;
+	}
+
 	h1m = (!(h1c->flags & H1C_F_IS_BACK) ? &h1s->res : &h1s->req);
 
 	/* the htx is non-empty thus has at least one block */
@@ -2651,7 +2868,7 @@ static int h1_handle_internal_err(struct h1c *h1c)
 
 	session_inc_http_req_ctr(sess);
 	proxy_inc_fe_req_ctr(sess->listener, sess->fe);
-	_HA_ATOMIC_INC(&sess->fe->fe_counters.p.http.rsp[5]);
+	COUNTERS_INC(&sess->fe->fe_counters, rsp[5]);
 	_HA_ATOMIC_INC(&sess->fe->fe_counters.internal_errors);
 	if (sess->listener && sess->listener->counters)
 		_HA_ATOMIC_INC(&sess->listener->counters->internal_errors);
@@ -2681,7 +2898,7 @@ static int h1_handle_parsing_error(struct h1c *h1c)
 	session_inc_http_req_ctr(sess);
 	session_inc_http_err_ctr(sess);
 	proxy_inc_fe_req_ctr(sess->listener, sess->fe);
-	_HA_ATOMIC_INC(&sess->fe->fe_counters.p.http.rsp[4]);
+	COUNTERS_INC(&sess->fe->fe_counters, rsp[4]);
 	_HA_ATOMIC_INC(&sess->fe->fe_counters.failed_req);
 	if (sess->listener && sess->listener->counters)
 		_HA_ATOMIC_INC(&sess->listener->counters->failed_req);
@@ -2713,7 +2930,7 @@ static int h1_handle_not_impl_err(struct h1c *h1c)
 
 	session_inc_http_req_ctr(sess);
 	proxy_inc_fe_req_ctr(sess->listener, sess->fe);
-	_HA_ATOMIC_INC(&sess->fe->fe_counters.p.http.rsp[4]);
+	COUNTERS_INC(&sess->fe->fe_counters, rsp[4]);
 	_HA_ATOMIC_INC(&sess->fe->fe_counters.failed_req);
 	if (sess->listener && sess->listener->counters)
 		_HA_ATOMIC_INC(&sess->listener->counters->failed_req);
@@ -2743,7 +2960,7 @@ static int h1_handle_req_tout(struct h1c *h1c)
 
 	session_inc_http_req_ctr(sess);
 	proxy_inc_fe_req_ctr(sess->listener, sess->fe);
-	_HA_ATOMIC_INC(&sess->fe->fe_counters.p.http.rsp[4]);
+	COUNTERS_INC(&sess->fe->fe_counters, rsp[4]);
 	_HA_ATOMIC_INC(&sess->fe->fe_counters.failed_req);
 	if (sess->listener && sess->listener->counters)
 		_HA_ATOMIC_INC(&sess->listener->counters->failed_req);
@@ -2779,7 +2996,7 @@ static int h1_recv(struct h1c *h1c)
 		return 1;
 	}
 
-	if (!h1_get_buf(h1c, &h1c->ibuf)) {
+	if (!h1_get_ibuf(h1c)) {
 		h1c->flags |= H1C_F_IN_ALLOC;
 		TRACE_STATE("waiting for h1c ibuf allocation", H1_EV_H1C_RECV|H1_EV_H1C_BLK, h1c->conn);
 		return 0;
@@ -2836,8 +3053,17 @@ static int h1_recv(struct h1c *h1c)
 	if (!b_data(&h1c->ibuf))
 		h1_release_buf(h1c, &h1c->ibuf);
 	else if (!buf_room_for_htx_data(&h1c->ibuf)) {
-		h1c->flags |= H1C_F_IN_FULL;
-		TRACE_STATE("h1c ibuf full", H1_EV_H1C_RECV|H1_EV_H1C_BLK);
+		/* a full small buffer is replaced with a regular one before
+		 * being parsed, more data will be read on next call.
+		 */
+		if (b_is_small(&h1c->ibuf) && b_upgrade_small(&h1c->ibuf)) {
+			TRACE_STATE("h1c small ibuf full, upgraded", H1_EV_H1C_RECV, h1c->conn);
+			tasklet_wakeup(h1c->wait_event.tasklet);
+		}
+		else {
+			h1c->flags |= H1C_F_IN_FULL;
+			TRACE_STATE("h1c ibuf full", H1_EV_H1C_RECV|H1_EV_H1C_BLK);
+		}
 	}
 
 	TRACE_LEAVE(H1_EV_H1C_RECV, h1c->conn);
@@ -2854,6 +3080,7 @@ static int h1_send(struct h1c *h1c)
 	unsigned int flags = 0;
 	size_t ret;
 	int sent = 0;
+	int zc = 0;
 
 	TRACE_ENTER(H1_EV_H1C_SEND, h1c->conn);
 
@@ -2873,7 +3100,19 @@ static int h1_send(struct h1c *h1c)
 	if (h1c->flags & H1C_F_CO_STREAMER)
 		flags |= CO_SFL_STREAMER;
 
+	/* large outputs on raw sockets may be sent with MSG_ZEROCOPY */
+	if (global.tune.zerocopy_threshold &&
+	    b_data(&h1c->obuf) >= global.tune.zerocopy_threshold &&
+	    conn->xprt == xprt_get(XPRT_RAW) && sock_zc_prepare(conn)) {
+		flags |= CO_SFL_ZEROCOPY;
+		zc = 1;
+	}
+
 	ret = conn->xprt->snd_buf(conn, conn->xprt_ctx, &h1c->obuf, b_data(&h1c->obuf), flags);
+	if (zc) {
+		/* consumes the data, possibly replacing the buffer's area */
+		sock_zc_commit(conn, &h1c->obuf, ret);
+	}
 	if (ret > 0) {
 		TRACE_DATA("data sent", H1_EV_H1C_SEND, h1c->conn, 0, 0, (size_t[]){ret});
 		if (h1c->flags & H1C_F_OUT_FULL) {
@@ -2881,7 +3120,8 @@ static int h1_send(struct h1c *h1c)
 			TRACE_STATE("h1c obuf not full anymore", H1_EV_STRM_SEND|H1_EV_H1S_BLK, h1c->conn);
 		}
 		HA_ATOMIC_ADD(&h1c->px_counters->bytes_out, ret);
-		b_del(&h1c->obuf, ret);
+		if (!zc)
+			b_del(&h1c->obuf, ret);
 		sent = 1;
 	}
 
@@ -2903,7 +3143,7 @@ static int h1_send(struct h1c *h1c)
 
   end:
 	if (!(h1c->flags & (H1C_F_OUT_FULL|H1C_F_OUT_ALLOC)))
-		h1_wake_stream_for_send(h1c->h1s);
+		h1_wake_stream_for_send(h1c_last_stream(h1c));
 
 	/* We're done, no more to send */
 	if (!b_data(&h1c->obuf)) {
@@ -3055,6 +3295,7 @@ static int h1_process(struct h1c * h1c)
 			}
 			TRACE_POINT(H1_EV_STRM_WAKE, h1c->conn, h1s);
 			h1_alert(h1s);
+			h1c_fail_pipeline(h1c);
 		}
 	}
 
@@ -3085,8 +3326,10 @@ static int h1_process(struct h1c * h1c)
 				}
 				else if (global.tune.options & GTUNE_DISABLE_ACTIVE_CLOSE)
 					send_close = 0; /* let the client close his connection himself */
-				if (send_close)
+				if (send_close) {
+					_HA_ATOMIC_INC(&soft_stop_idle_closed);
 					goto release;
+				}
 			}
 		}
 	}
@@ -3152,6 +3395,16 @@ struct task *h1_io_cb(struct task *t, void *ctx, unsigned int state)
 		conn = h1c->conn;
 		TRACE_POINT(H1_EV_H1C_WAKE, conn);
 
+		/* an idle frontend connection offered to another thread may
+		 * already be in transit, in which case it is not ours anymore.
+		 */
+		if (!conn_cancel_migration(conn)) {
+			HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
+			return t;
+		}
+		if (!(h1c->flags & H1C_F_IS_BACK))
+			HA_ATOMIC_AND(&tl->state, ~TASK_F_USR1);
+
 		/* Remove the connection from the list, to be sure nobody attempts
 		 * to use it while we handle the I/O events
 		 */
@@ -3236,6 +3489,16 @@ struct task *h1_timeout_task(struct task *t, void *context, unsigned int state)
 			goto do_leave;
 		}
 
+		/* The connection is being moved to another thread, which will
+		 * kill this task.
+		 */
+		if (!conn_cancel_migration(h1c->conn)) {
+			HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
+			t->expire = TICK_ETERNITY;
+			TRACE_DEVEL("leaving (migrating)", H1_EV_H1C_WAKE);
+			return t;
+		}
+
 		if (!expired) {
 			HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
 			TRACE_DEVEL("leaving (not expired)", H1_EV_H1C_WAKE, h1c->conn, h1c->h1s);
@@ -3362,6 +3625,25 @@ static void h1_destroy(void *ctx)
 		h1_release(h1c);
 }
 
+/* Offers the idle frontend connection <h1c> to a less loaded thread if it is
+ * fully idle between two requests. Once offered, the connection must not be
+ * touched anymore.
+ */
+static void h1_offer_migration(struct h1c *h1c)
+{
+	if ((h1c->flags & (H1C_F_IS_BACK|H1C_F_ERROR|H1C_F_ERR_PENDING|H1C_F_ABRT_PENDING|H1C_F_EOS)) ||
+	    h1c->h1s || b_data(&h1c->ibuf) || b_data(&h1c->obuf) ||
+	    LIST_INLIST(&h1c->buf_wait.list) || (h1c->wait_event.events & SUB_RETRY_SEND))
+		return;
+
+	/* the handlers must check the tasklet's context under the lock */
+	HA_ATOMIC_OR(&h1c->wait_event.tasklet->state, TASK_F_USR1);
+	if (!conn_offer_migration(h1c->conn))
+		HA_ATOMIC_AND(&h1c->wait_event.tasklet->state, ~TASK_F_USR1);
+	else
+		TRACE_STATE("idle connection offered to another thread", H1_EV_STRM_END, h1c->conn);
+}
+
 /*
  * Detach the stream from the connection and possibly release the connection.
  */
@@ -3390,6 +3672,21 @@ static void h1_detach(struct sedesc *sd)
 	is_not_first = h1s->flags & H1S_F_NOT_FIRST;
 	h1s_destroy(h1s);
 
+	if (h1c->h1s) {
+		/* Pipelined streams are still attached to the connection, it
+		 * cannot be released now.
+		 */
+		if (h1c->conn->owner == sess)
+			h1c->conn->owner = NULL;
+		if (h1c->state == H1_CS_RUNNING)
+			h1c_make_available(h1c);
+		else
+			tasklet_wakeup(h1c->wait_event.tasklet);
+		h1_refresh_timeout(h1c);
+		TRACE_DEVEL("H1 streams still attached", H1_EV_STRM_END, h1c->conn, h1c->h1s);
+		goto end;
+	}
+
 	if (h1c->state == H1_CS_IDLE && (h1c->flags & H1C_F_IS_BACK)) {
 		/* this connection may be killed at any moment, we want it to
 		 * die "cleanly" (i.e. only an RST).
@@ -3471,6 +3768,8 @@ static void h1_detach(struct sedesc *sd)
 		}
 		h1_set_idle_expiration(h1c);
 		h1_refresh_timeout(h1c);
+		if (h1c->state == H1_CS_IDLE)
+			h1_offer_migration(h1c);
 	}
   end:
 	TRACE_LEAVE(H1_EV_STRM_END);
@@ -3642,6 +3941,12 @@ static size_t h1_rcv_buf(struct stconn *sc, struct buffer *buf, size_t count, in
 		goto end;
 	}
 
+	/* A pipelined stream must wait for the previous responses */
+	if (h1s != h1c->h1s) {
+		TRACE_DEVEL("pipelined h1s waiting for its turn", H1_EV_STRM_RECV|H1_EV_H1S_BLK, h1c->conn, h1s);
+		goto end;
+	}
+
 	if (!(h1c->flags & H1C_F_IN_ALLOC))
 		ret = h1_process_demux(h1c, buf, count);
 	else
@@ -3701,7 +4006,7 @@ static size_t h1_snd_buf(struct stconn *sc, struct buffer *buf, size_t count, in
 		size_t ret = 0;
 
 		if (!(h1c->flags & (H1C_F_OUT_FULL|H1C_F_OUT_ALLOC)))
-			ret = h1_process_mux(h1c, buf, count);
+			ret = h1_process_mux(h1c, h1s, buf, count);
 		else
 			TRACE_DEVEL("h1c obuf not allocated", H1_EV_STRM_SEND|H1_EV_H1S_BLK, h1c->conn, h1s);
 
@@ -3727,6 +4032,10 @@ static size_t h1_snd_buf(struct stconn *sc, struct buffer *buf, size_t count, in
 		se_fl_set_error(h1s->sd);
 		TRACE_ERROR("reporting error to the app-layer stream", H1_EV_STRM_SEND|H1_EV_H1S_ERR|H1_EV_STRM_ERR, h1c->conn, h1s);
 	}
+	else if ((h1c->flags & H1C_F_IS_BACK) && h1s->req.state == H1_MSG_DONE) {
+		/* the request was fully sent, another one may be pipelined */
+		h1c_make_available(h1c);
+	}
 
 	h1_refresh_timeout(h1c);
 	TRACE_LEAVE(H1_EV_STRM_SEND, h1c->conn, h1s, 0, (size_t[]){total});
@@ -3744,12 +4053,18 @@ static int h1_rcv_pipe(struct stconn *sc, struct pipe *pipe, unsigned int count)
 
 	TRACE_ENTER(H1_EV_STRM_RECV, h1c->conn, h1s, 0, (size_t[]){count});
 
-	if ((h1m->flags & H1_MF_CHNK) || (h1m->state != H1_MSG_DATA && h1m->state != H1_MSG_TUNNEL)) {
+	if (h1m->state != H1_MSG_DATA && h1m->state != H1_MSG_TUNNEL) {
 		h1c->flags &= ~H1C_F_WANT_SPLICE;
 		TRACE_STATE("Allow xprt rcv_buf on !(msg_data|msg_tunnel)", H1_EV_STRM_RECV, h1c->conn, h1s);
 		goto end;
 	}
 
+	if (h1m->state == H1_MSG_DATA && (h1m->flags & H1_MF_CHNK) && !h1m->curr_len) {
+		h1c->flags &= ~H1C_F_WANT_SPLICE;
+		TRACE_STATE("Allow xprt rcv_buf to parse the next chunk size", H1_EV_STRM_RECV, h1c->conn, h1s);
+		goto end;
+	}
+
 	h1c->flags |= H1C_F_WANT_SPLICE;
 	if (h1s_data_pending(h1s)) {
 		TRACE_STATE("flush input buffer before splicing", H1_EV_STRM_RECV, h1c->conn, h1s);
@@ -3761,11 +4076,11 @@ static int h1_rcv_pipe(struct stconn *sc, struct pipe *pipe, unsigned int count)
 		goto end;
 	}
 
-	if (h1m->state == H1_MSG_DATA && (h1m->flags & H1_MF_CLEN) && count > h1m->curr_len)
+	if (h1m->state == H1_MSG_DATA && (h1m->flags & (H1_MF_CLEN|H1_MF_CHNK)) && count > h1m->curr_len)
 		count = h1m->curr_len;
 	ret = h1c->conn->xprt->rcv_pipe(h1c->conn, h1c->conn->xprt_ctx, pipe, count);
 	if (ret >= 0) {
-		if (h1m->state == H1_MSG_DATA && (h1m->flags & H1_MF_CLEN)) {
+		if (h1m->state == H1_MSG_DATA && (h1m->flags & (H1_MF_CLEN|H1_MF_CHNK))) {
 			if (ret > h1m->curr_len) {
 				h1s->flags |= H1S_F_PARSING_ERROR;
 				se_fl_set(h1s->sd, SE_FL_ERROR);
@@ -3774,7 +4089,15 @@ static int h1_rcv_pipe(struct stconn *sc, struct pipe *pipe, unsigned int count)
 				goto end;
 			}
 			h1m->curr_len -= ret;
-			if (!h1m->curr_len) {
+			if (!h1m->curr_len && (h1m->flags & H1_MF_CHNK)) {
+				/* the CRLF and the next chunk size will be
+				 * parsed from the input buffer.
+				 */
+				h1m->state = H1_MSG_CHUNK_CRLF;
+				h1c->flags &= ~H1C_F_WANT_SPLICE;
+				TRACE_STATE("chunk payload fully received", H1_EV_STRM_RECV, h1c->conn, h1s);
+			}
+			else if (!h1m->curr_len) {
 				h1m->state = H1_MSG_DONE;
 				h1c->flags &= ~H1C_F_WANT_SPLICE;
 				TRACE_STATE("payload fully received", H1_EV_STRM_RECV, h1c->conn, h1s);
@@ -3826,7 +4149,59 @@ static int h1_snd_pipe(struct stconn *sc, struct pipe *pipe)
 		goto end;
 	}
 
-	ret = h1c->conn->xprt->snd_pipe(h1c->conn, h1c->conn->xprt_ctx, pipe);
+	if (h1m->state == H1_MSG_DATA && (h1m->flags & H1_MF_CHNK)) {
+		/* The pipe contents are emitted as chunks. A new chunk covering
+		 * all the data already in the pipe is started when the
+		 * previous one was fully sent, and its remaining size is
+		 * stored into curr_len, which is not used otherwise for
+		 * outgoing chunked messages. Data added to the pipe meanwhile
+		 * will go in the next chunk.
+		 */
+		if (!h1m->curr_len) {
+			char tmp[10], *beg = tmp + sizeof(tmp);
+			unsigned int chksz = pipe->data;
+
+			if (!chksz)
+				goto end;
+
+			if (!h1_get_buf(h1c, &h1c->obuf)) {
+				h1c->flags |= H1C_F_OUT_ALLOC;
+				TRACE_STATE("waiting for h1c obuf allocation", H1_EV_STRM_SEND|H1_EV_H1S_BLK, h1c->conn, h1s);
+				goto end;
+			}
+
+			h1_put_spliced_chunk_crlf(h1s);
+			*--beg = '\n';
+			*--beg = '\r';
+			do {
+				*--beg = hextab[chksz & 0xF];
+			} while (chksz >>= 4);
+			b_putblk(&h1c->obuf, beg, tmp + sizeof(tmp) - beg);
+			h1m->curr_len = pipe->data;
+
+			h1_send(h1c);
+			if (b_data(&h1c->obuf)) {
+				if (!(h1c->wait_event.events & SUB_RETRY_SEND)) {
+					TRACE_STATE("more data to send, subscribing", H1_EV_STRM_SEND, h1c->conn, h1s);
+					h1c->conn->xprt->subscribe(h1c->conn, h1c->conn->xprt_ctx, SUB_RETRY_SEND, &h1c->wait_event);
+				}
+				goto end;
+			}
+		}
+
+		ret = h1c->conn->xprt->snd_pipe(h1c->conn, h1c->conn->xprt_ctx, pipe, h1m->curr_len);
+		h1m->curr_len -= ret;
+		if (!h1m->curr_len) {
+			/* the CRLF will be emitted with the next chunk size
+			 * or the next outgoing data.
+			 */
+			h1s->flags |= H1S_F_CHNK_CRLF;
+			TRACE_STATE("chunk payload fully xferred", H1_EV_TX_DATA|H1_EV_TX_BODY, h1c->conn, h1s);
+		}
+	}
+	else
+		ret = h1c->conn->xprt->snd_pipe(h1c->conn, h1c->conn->xprt_ctx, pipe, pipe->data);
+
 	if (h1m->state == H1_MSG_DATA && (h1m->flags & H1_MF_CLEN)) {
 		if (ret > h1m->curr_len) {
 			h1s->flags |= H1S_F_PROCESSING_ERROR;
@@ -3884,6 +4259,20 @@ static int h1_ctl(struct connection *conn, enum mux_ctl_type mux_ctl, void *outp
 			 ((h1c->errcode >= 400 && h1c->errcode <= 499) ? MUX_ES_INVALID_ERR :
 			  MUX_ES_SUCCESS))));
 		return ret;
+	case MUX_BUF_INFO: {
+		struct mux_buf_info *info = output;
+
+		/* a connection waiting for a new request has no stream attached */
+		info->idle   = (h1c->state == H1_CS_IDLE || h1c->state == H1_CS_EMBRYONIC);
+		info->rxbufs = !!b_size(&h1c->ibuf);
+		info->txbufs = !!b_size(&h1c->obuf);
+		info->size   = b_size(&h1c->ibuf) + b_size(&h1c->obuf);
+		if (h1c->h1s && b_size(&h1c->h1s->rxbuf)) {
+			info->rxbufs++;
+			info->size += b_size(&h1c->h1s->rxbuf);
+		}
+		return 0;
+	}
 	default:
 		return -1;
 	}
@@ -3908,6 +4297,9 @@ static int h1_dump_h1c_info(struct buffer *msg, struct h1c *h1c, const char *pfx
 		      (unsigned int)b_data(&h1c->obuf), b_orig(&h1c->obuf),
 		      (unsigned int)b_head_ofs(&h1c->obuf), (unsigned int)b_size(&h1c->obuf));
 
+	if (h1c->nb_pipelined)
+		chunk_appendf(msg, " .pipelined=%u", h1c->nb_pipelined);
+
 	chunk_appendf(msg, " .task=%p", h1c->task);
 	if (h1c->task) {
 		chunk_appendf(msg, " .exp=%s",
@@ -4055,11 +4447,25 @@ static int add_hdr_case_adjust(const char *from, const char *to, char **err)
 static int h1_takeover(struct connection *conn, int orig_tid)
 {
 	struct h1c *h1c = conn->ctx;
-	struct task *task;
+	struct tasklet *tl;
+	struct task *task = NULL;
 
-	if (fd_takeover(conn->handle.fd, conn) != 0)
+	/* allocate everything first so that a failure leaves the connection
+	 * untouched on the original thread.
+	 */
+	tl = tasklet_new();
+	if (!tl)
 		return -1;
 
+	if (h1c->task) {
+		task = task_new_here();
+		if (!task)
+			goto fail;
+	}
+
+	if (fd_takeover(conn->handle.fd, conn) != 0)
+		goto fail;
+
 	if (conn->xprt->takeover && conn->xprt->takeover(conn, conn->xprt_ctx, orig_tid) != 0) {
 		/* We failed to takeover the xprt, even if the connection may
 		 * still be valid, flag it as error'd, as we have already
@@ -4068,7 +4474,7 @@ static int h1_takeover(struct connection *conn, int orig_tid)
 		 */
 		conn->flags |= CO_FL_ERROR;
 		tasklet_wakeup_on(h1c->wait_event.tasklet, orig_tid);
-		return -1;
+		goto fail;
 	}
 
 	if (h1c->wait_event.events)
@@ -4080,32 +4486,32 @@ static int h1_takeover(struct connection *conn, int orig_tid)
 	h1c->wait_event.tasklet->context = NULL;
 	tasklet_wakeup_on(h1c->wait_event.tasklet, orig_tid);
 
-	task = h1c->task;
-	if (task) {
-		task->context = NULL;
-		h1c->task = NULL;
+	if (h1c->task) {
+		h1c->task->context = NULL;
 		__ha_barrier_store();
-		task_kill(task);
+		task_kill(h1c->task);
 
-		h1c->task = task_new_here();
-		if (!h1c->task) {
-			h1_release(h1c);
-			return -1;
-		}
+		h1c->task = task;
 		h1c->task->process = h1_timeout_task;
 		h1c->task->context = h1c;
 	}
-	h1c->wait_event.tasklet = tasklet_new();
-	if (!h1c->wait_event.tasklet) {
-		h1_release(h1c);
-		return -1;
-	}
+	h1c->wait_event.tasklet = tl;
 	h1c->wait_event.tasklet->process = h1_io_cb;
 	h1c->wait_event.tasklet->context = h1c;
 	h1c->conn->xprt->subscribe(h1c->conn, h1c->conn->xprt_ctx,
 		                   SUB_RETRY_RECV, &h1c->wait_event);
 
+	/* migrated frontend connections keep their idle timeout */
+	if (!(h1c->flags & H1C_F_IS_BACK))
+		h1_refresh_timeout(h1c);
+
 	return 0;
+
+ fail:
+	if (task)
+		task_destroy(task);
+	tasklet_free(tl);
+	return -1;
 }
 
 
@@ -4292,7 +4698,7 @@ static const struct mux_ops mux_http_ops = {
 	.show_sd     = h1_show_sd,
 	.ctl         = h1_ctl,
 	.takeover    = h1_takeover,
-	.flags       = MX_FL_HTX,
+	.flags       = MX_FL_HTX|MX_FL_PIPELINE,
 	.name        = "H1",
 };
 
@@ -4319,7 +4725,7 @@ static const struct mux_ops mux_h1_ops = {
 	.show_sd     = h1_show_sd,
 	.ctl         = h1_ctl,
 	.takeover    = h1_takeover,
-	.flags       = MX_FL_HTX|MX_FL_NO_UPG,
+	.flags       = MX_FL_HTX|MX_FL_NO_UPG|MX_FL_PIPELINE,
 	.name        = "H1",
 };
 
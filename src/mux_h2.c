@@ -20,12 +20,14 @@
 #include <haproxy/hpack-dec.h>
 #include <haproxy/hpack-enc.h>
 #include <haproxy/hpack-tbl.h>
+#include <haproxy/http.h>
 #include <haproxy/http_htx.h>
 #include <haproxy/htx.h>
 #include <haproxy/istbuf.h>
 #include <haproxy/log.h>
 #include <haproxy/mux_h2-t.h>
 #include <haproxy/net_helper.h>
+#include <haproxy/proxy.h>
 #include <haproxy/session-t.h>
 #include <haproxy/stats.h>
 #include <haproxy/stconn.h>
@@ -53,6 +55,8 @@ struct h2c {
 	int32_t max_id; /* highest ID known on this connection, <0 before preface */
 	uint32_t rcvd_c; /* newly received data to ACK for the connection */
 	uint32_t rcvd_s; /* newly received data to ACK for the current stream (dsi) or zero */
+	int32_t rx_win;     /* initial stream window we advertise, grown by BDP auto-tuning */
+	uint32_t bdp_bytes; /* DATA bytes received since the BDP PING was sent */
 
 	/* states for the demux direction */
 	struct hpack_dht *ddht; /* demux dynamic header table */
@@ -68,6 +72,7 @@ struct h2c {
 
 	/* states for the mux direction */
 	struct buffer mbuf[H2C_MBUF_CNT];   /* mux buffers (ring) */
+	struct hpack_dht *edht; /* mux dynamic header table for responses, or NULL */
 	int32_t miw; /* mux initial window size for all new streams */
 	int32_t mws; /* mux window size. Can be negative. */
 	int32_t mfs; /* mux's max frame size */
@@ -106,6 +111,8 @@ struct h2s {
 	enum h2_err errcode; /* H2 err code (H2_ERR_*) */
 	enum h2_ss st;
 	uint16_t status;     /* HTTP response status */
+	uint8_t urgency;     /* RFC9218 urgency, 0 (highest) to 7 */
+	uint8_t incremental; /* RFC9218 incremental flag */
 	unsigned long long body_len; /* remaining body length according to content-length if H2_SF_DATA_CLEN */
 	struct buffer rxbuf; /* receive buffer, always valid (buf_empty or real buffer) */
 	struct wait_event *subs;  /* recv wait_event the stream connector associated is waiting on (via h2_subscribe) */
@@ -397,14 +404,21 @@ DECLARE_STATIC_POOL(pool_head_h2s, "h2s", sizeof(struct h2s));
  */
 #define H2_INITIAL_WINDOW_INCREMENT ((1U<<31)-1 - 65535)
 
+/* opaque payload of the PING frames we send to estimate the BDP, it is used
+ * to recognize their ACKs among those of the peer's own PINGs.
+ */
+#define H2_BDP_PING_PAYLOAD "HAP-BDP."
+
 /* maximum amount of data we're OK with re-aligning for buffer optimizations */
 #define MAX_DATA_REALIGN 1024
 
 /* a few settings from the global section */
 static int h2_settings_header_table_size      =  4096; /* initial value */
 static int h2_settings_initial_window_size    = 65536; /* initial value */
+static int h2_settings_max_window_size        =     0; /* 0 = no auto-tuning */
 static unsigned int h2_settings_max_concurrent_streams = 100;
 static int h2_settings_max_frame_size         = 0;     /* unset */
+static unsigned int h2_settings_encoder_table_size = 0; /* disabled */
 
 /* a dummy closed endpoint */
 static const struct sedesc closed_ep = {
@@ -916,6 +930,23 @@ static int h2_init(struct connection *conn, struct proxy *prx, struct session *s
 	if (!h2c->ddht)
 		goto fail;
 
+	/* the pool may be larger than the advertised decoder's table */
+	hpack_dht_init(h2c->ddht, h2_settings_header_table_size);
+
+	/* The encoder table is optional and only used for responses. It is
+	 * limited to the peer's initial decoder table size, and since it may
+	 * differ from it, the size must be announced on the first block.
+	 */
+	h2c->edht = NULL;
+	if (!(h2c->flags & H2_CF_IS_BACK) && h2_settings_encoder_table_size) {
+		h2c->edht = hpack_dht_alloc();
+		if (h2c->edht) {
+			hpack_dht_init(h2c->edht, MIN(h2_settings_encoder_table_size, 4096));
+			if (h2c->edht->size != 4096)
+				h2c->flags |= H2_CF_EDHT_RESET;
+		}
+	}
+
 	/* Initialise the context. */
 	h2c->st0 = H2_CS_PREFACE;
 	h2c->conn = conn;
@@ -924,6 +955,8 @@ static int h2_init(struct connection *conn, struct proxy *prx, struct session *s
 	h2c->errcode = H2_ERR_NO_ERROR;
 	h2c->rcvd_c = 0;
 	h2c->rcvd_s = 0;
+	h2c->rx_win = h2_settings_initial_window_size;
+	h2c->bdp_bytes = 0;
 	h2c->nb_streams = 0;
 	h2c->nb_sc = 0;
 	h2c->nb_reserved = 0;
@@ -951,11 +984,13 @@ static int h2_init(struct connection *conn, struct proxy *prx, struct session *s
 	if (t)
 		task_queue(t);
 
-	if (h2c->flags & H2_CF_IS_BACK) {
+	if ((h2c->flags & H2_CF_IS_BACK) && conn_ctx) {
 		/* FIXME: this is temporary, for outgoing connections we need
 		 * to immediately allocate a stream until the code is modified
 		 * so that the caller calls ->attach(). For now the outgoing sc
 		 * is stored as conn->ctx by the caller and saved in conn_ctx.
+		 * There is none for connections established in advance to be
+		 * kept idle.
 		 */
 		struct h2s *h2s;
 
@@ -963,6 +998,13 @@ static int h2_init(struct connection *conn, struct proxy *prx, struct session *s
 		if (!h2s)
 			goto fail_stream;
 	}
+	else if (h2c->flags & H2_CF_IS_BACK) {
+		/* connection established in advance to be kept idle, the
+		 * tasklet must be ready to find it in an idle list.
+		 */
+		HA_ATOMIC_OR(&h2c->wait_event.tasklet->state, TASK_F_USR1);
+		xprt_set_idle(conn, conn->xprt, conn->xprt_ctx);
+	}
 
 	HA_ATOMIC_INC(&h2c->px_counters->open_conns);
 	HA_ATOMIC_INC(&h2c->px_counters->total_conns);
@@ -972,6 +1014,7 @@ static int h2_init(struct connection *conn, struct proxy *prx, struct session *s
 	TRACE_LEAVE(H2_EV_H2C_NEW, conn);
 	return 0;
   fail_stream:
+	hpack_dht_free(h2c->edht);
 	hpack_dht_free(h2c->ddht);
   fail:
 	task_destroy(t);
@@ -1026,6 +1069,7 @@ static void h2_release(struct h2c *h2c)
 	TRACE_ENTER(H2_EV_H2C_END);
 
 	hpack_dht_free(h2c->ddht);
+	hpack_dht_free(h2c->edht);
 
 	if (LIST_INLIST(&h2c->buf_wait.list))
 		LIST_DEL_INIT(&h2c->buf_wait.list);
@@ -1097,6 +1141,55 @@ static inline int h2s_mws(const struct h2s *h2s)
 	return h2s->sws + h2s->h2c->miw;
 }
 
+/* returns the stream's sending priority, the lower the more urgent. It is
+ * made of the RFC9218 urgency, and non-incremental streams go first among
+ * streams of the same urgency.
+ */
+static inline uint h2s_prio(const struct h2s *h2s)
+{
+	return (h2s->urgency << 1) | h2s->incremental;
+}
+
+/* queues <h2s> into <head> which must be one of its connection's send_list or
+ * fctl_list. These lists are sorted by priority: the stream is placed after
+ * all those with the same or a more urgent priority, so that the most urgent
+ * streams are woken up first and streams of equal priority are served in a
+ * round-robin fashion.
+ */
+static inline void h2s_queue_send(struct h2s *h2s, struct list *head)
+{
+	struct h2s *prev;
+
+	list_for_each_entry_rev(prev, head, list) {
+		if (h2s_prio(prev) <= h2s_prio(h2s))
+			break;
+	}
+	/* <prev> is the list head's container if all are less urgent */
+	LIST_INSERT(&prev->list, &h2s->list);
+}
+
+/* returns non-zero if streams at least as urgent as <h2s> are already waiting
+ * to send on its connection. Since the lists are sorted, only their first
+ * element needs to be checked.
+ */
+static inline int h2s_others_waiting(const struct h2s *h2s)
+{
+	const struct h2c *h2c = h2s->h2c;
+	const struct h2s *first;
+
+	if (!LIST_ISEMPTY(&h2c->fctl_list)) {
+		first = LIST_ELEM(h2c->fctl_list.n, struct h2s *, list);
+		if (h2s_prio(first) <= h2s_prio(h2s))
+			return 1;
+	}
+	if (!LIST_ISEMPTY(&h2c->send_list)) {
+		first = LIST_ELEM(h2c->send_list.n, struct h2s *, list);
+		if (h2s_prio(first) <= h2s_prio(h2s))
+			return 1;
+	}
+	return 0;
+}
+
 /* marks an error on the connection. Before settings are sent, we must not send
  * a GOAWAY frame, and the error state will prevent h2c_send_goaway_error()
  * from verifying this so we set H2_CF_GOAWAY_FAILED to make sure it will not
@@ -1406,6 +1499,8 @@ static struct h2s *h2s_new(struct h2c *h2c, int id)
 	h2s->errcode   = H2_ERR_NO_ERROR;
 	h2s->st        = H2_SS_IDLE;
 	h2s->status    = 0;
+	h2s->urgency   = HTTP_PRIO_URGENCY_DEF;
+	h2s->incremental = 0;
 	h2s->body_len  = 0;
 	h2s->rxbuf     = BUF_NULL;
 	memset(h2s->upgrade_protocol, 0, sizeof(h2s->upgrade_protocol));
@@ -1579,6 +1674,12 @@ static int h2c_send_settings(struct h2c *h2c)
 	if (!(global.tune.options & GTUNE_DISABLE_H2_WEBSOCKET))
 		chunk_memcat(&buf, "\x00\x08\x00\x00\x00\x01", 6);
 
+	/* rfc 9218 #2.1 SETTINGS_NO_RFC7540_PRIORITIES=1: we rely on the
+	 * extensible priorities instead.
+	 */
+	if (!(h2c->flags & H2_CF_IS_BACK))
+		chunk_memcat(&buf, "\x00\x09\x00\x00\x00\x01", 6);
+
 	if (h2_settings_header_table_size != 4096) {
 		char str[6] = "\x00\x01"; /* header_table_size */
 
@@ -1586,10 +1687,10 @@ static int h2c_send_settings(struct h2c *h2c)
 		chunk_memcat(&buf, str, 6);
 	}
 
-	if (h2_settings_initial_window_size != 65535) {
+	if (h2c->rx_win != 65535) {
 		char str[6] = "\x00\x04"; /* initial_window_size */
 
-		write_n32(str + 2, h2_settings_initial_window_size);
+		write_n32(str + 2, h2c->rx_win);
 		chunk_memcat(&buf, str, 6);
 	}
 
@@ -2082,7 +2183,7 @@ static void h2c_unblock_sfctl(struct h2c *h2c)
 			LIST_DEL_INIT(&h2s->list);
 			if ((h2s->subs && h2s->subs->events & SUB_RETRY_SEND) ||
 			    h2s->flags & (H2_SF_WANT_SHUTR|H2_SF_WANT_SHUTW))
-				LIST_APPEND(&h2c->send_list, &h2s->list);
+				h2s_queue_send(h2s, &h2c->send_list);
 		}
 		node = eb32_next(node);
 	}
@@ -2143,6 +2244,13 @@ static int h2c_handle_settings(struct h2c *h2c)
 			break;
 		case H2_SETTINGS_HEADER_TABLE_SIZE:
 			h2c->flags |= H2_CF_SHTS_UPDATED;
+			if (h2c->edht) {
+				/* the encoder table must never be larger than
+				 * the peer's one, let's restart from scratch.
+				 */
+				hpack_dht_init(h2c->edht, MIN((uint32_t)arg, h2_settings_encoder_table_size));
+				h2c->flags |= H2_CF_EDHT_RESET;
+			}
 			break;
 		case H2_SETTINGS_ENABLE_PUSH:
 			if (arg < 0 || arg > 1) { // RFC7540#6.5.2
@@ -2230,9 +2338,48 @@ static int h2c_ack_settings(struct h2c *h2c)
  */
 static int h2c_handle_ping(struct h2c *h2c)
 {
+	char payload[8];
+
 	/* schedule a response */
-	if (!(h2c->dff & H2_F_PING_ACK))
+	if (!(h2c->dff & H2_F_PING_ACK)) {
 		h2c->st0 = H2_CS_FRAME_A;
+		return 1;
+	}
+
+	if (!(h2c->flags & H2_CF_BDP_WAIT))
+		return 1;
+
+	if (b_data(&h2c->dbuf) < 8)
+		return 0;
+
+	h2_get_buf_bytes(payload, 8, &h2c->dbuf, 0);
+	if (memcmp(payload, H2_BDP_PING_PAYLOAD, 8) != 0)
+		return 1;
+
+	/* This is the ACK of our BDP PING: bdp_bytes were received during
+	 * one round trip. If they filled most of the advertised window, the
+	 * window was the limiting factor, so it is doubled (up to the
+	 * configured limit) and advertised to the peer via a SETTINGS frame,
+	 * which also extends the window of all open streams. This is not done
+	 * if the demux was blocked by the streams' buffers, since a larger
+	 * window would only queue more data in the socket buffers.
+	 */
+	h2c->flags &= ~H2_CF_BDP_WAIT;
+	TRACE_STATE("BDP sample", H2_EV_RX_FRAME|H2_EV_RX_PING, h2c->conn, 0, 0, (void *)(long)h2c->bdp_bytes);
+
+	if (h2c->bdp_bytes >= (uint32_t)h2c->rx_win / 3 * 2 &&
+	    !(h2c->flags & (H2_CF_DEM_SALLOC | H2_CF_DEM_SFULL)) &&
+	    h2c->rx_win < h2_settings_max_window_size) {
+		uint64_t win = (uint64_t)h2c->bdp_bytes * 2;
+
+		if (win > h2_settings_max_window_size)
+			win = h2_settings_max_window_size;
+		if (win > h2c->rx_win) {
+			h2c->rx_win = win;
+			h2c->flags |= H2_CF_RXWIN_UPDATE;
+		}
+	}
+	h2c->bdp_bytes = 0;
 	return 1;
 }
 
@@ -2380,6 +2527,102 @@ static int h2c_ack_ping(struct h2c *h2c)
 	return ret;
 }
 
+/* try to send a PING frame used to estimate the bandwidth-delay product, and
+ * starts the measurement. Returns > 0 on success or zero on missing room or
+ * failure. It may return an error in h2c.
+ */
+static int h2c_send_bdp_ping(struct h2c *h2c)
+{
+	struct buffer *res;
+	char str[17];
+	int ret = 0;
+
+	TRACE_ENTER(H2_EV_TX_FRAME|H2_EV_TX_PING, h2c->conn);
+
+	memcpy(str,
+	       "\x00\x00\x08"     /* length : 8 */
+	       "\x06" "\x00"      /* type   : 6, flags : none */
+	       "\x00\x00\x00\x00" /* stream ID */, 9);
+	memcpy(str + 9, H2_BDP_PING_PAYLOAD, 8);
+
+	res = br_tail(h2c->mbuf);
+ retry:
+	if (!h2_get_buf(h2c, res)) {
+		h2c->flags |= H2_CF_MUX_MALLOC;
+		h2c->flags |= H2_CF_DEM_MROOM;
+		goto out;
+	}
+
+	ret = b_istput(res, ist2(str, 17));
+	if (unlikely(ret <= 0)) {
+		if (!ret) {
+			if ((res = br_tail_add(h2c->mbuf)) != NULL)
+				goto retry;
+			h2c->flags |= H2_CF_MUX_MFULL;
+			h2c->flags |= H2_CF_DEM_MROOM;
+		}
+		else {
+			h2c_error(h2c, H2_ERR_INTERNAL_ERROR);
+			ret = 0;
+		}
+		goto out;
+	}
+
+	h2c->flags = (h2c->flags & ~H2_CF_BDP_PING) | H2_CF_BDP_WAIT;
+	h2c->bdp_bytes = 0;
+ out:
+	TRACE_LEAVE(H2_EV_TX_FRAME|H2_EV_TX_PING, h2c->conn);
+	return ret;
+}
+
+/* try to send a SETTINGS frame advertising the auto-tuned initial window size
+ * for streams. Returns > 0 on success or zero on missing room or failure. It
+ * may return an error in h2c.
+ */
+static int h2c_send_rxwin_settings(struct h2c *h2c)
+{
+	struct buffer *res;
+	char str[15];
+	int ret = 0;
+
+	TRACE_ENTER(H2_EV_TX_FRAME|H2_EV_TX_SETTINGS, h2c->conn);
+
+	memcpy(str,
+	       "\x00\x00\x06"     /* length : 6 (one setting) */
+	       "\x04" "\x00"      /* type   : 4 (settings), flags : none */
+	       "\x00\x00\x00\x00" /* stream ID */
+	       "\x00\x04"         /* initial_window_size */, 11);
+	write_n32(str + 11, h2c->rx_win);
+
+	res = br_tail(h2c->mbuf);
+ retry:
+	if (!h2_get_buf(h2c, res)) {
+		h2c->flags |= H2_CF_MUX_MALLOC;
+		h2c->flags |= H2_CF_DEM_MROOM;
+		goto out;
+	}
+
+	ret = b_istput(res, ist2(str, 15));
+	if (unlikely(ret <= 0)) {
+		if (!ret) {
+			if ((res = br_tail_add(h2c->mbuf)) != NULL)
+				goto retry;
+			h2c->flags |= H2_CF_MUX_MFULL;
+			h2c->flags |= H2_CF_DEM_MROOM;
+		}
+		else {
+			h2c_error(h2c, H2_ERR_INTERNAL_ERROR);
+			ret = 0;
+		}
+		goto out;
+	}
+
+	h2c->flags &= ~H2_CF_RXWIN_UPDATE;
+ out:
+	TRACE_LEAVE(H2_EV_TX_FRAME|H2_EV_TX_SETTINGS, h2c->conn);
+	return ret;
+}
+
 /* processes a WINDOW_UPDATE frame whose payload is <payload> for <plen> bytes.
  * Returns > 0 on success or zero on missing data. It may return an error in
  * h2c or h2s. The caller must have already verified frame length and stream ID
@@ -2427,7 +2670,7 @@ static int h2c_handle_window_update(struct h2c *h2c, struct h2s *h2s)
 			LIST_DEL_INIT(&h2s->list);
 			if ((h2s->subs && h2s->subs->events & SUB_RETRY_SEND) ||
 			    h2s->flags & (H2_SF_WANT_SHUTR|H2_SF_WANT_SHUTW))
-				LIST_APPEND(&h2c->send_list, &h2s->list);
+				h2s_queue_send(h2s, &h2c->send_list);
 		}
 	}
 	else {
@@ -2518,6 +2761,48 @@ static int h2c_handle_priority(struct h2c *h2c)
 	return 1;
 }
 
+/* processes a PRIORITY_UPDATE frame and applies the new priority to the
+ * designated stream if it exists. Returns > 0 on success or zero on missing
+ * data. It may return an error in h2c. Described in RFC9218#7.1.
+ */
+static int h2c_handle_priority_update(struct h2c *h2c)
+{
+	struct h2s *h2s;
+	int32_t sid;
+
+	TRACE_ENTER(H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+
+	/* process full frame only */
+	if (b_data(&h2c->dbuf) < h2c->dfl) {
+		TRACE_DEVEL("leaving on missing data", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+		h2c->flags |= H2_CF_DEM_SHORT_READ;
+		return 0;
+	}
+
+	if (h2c->dsi != 0 || h2c->dfl < 4) {
+		TRACE_ERROR("invalid PRIORITY_UPDATE frame", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+		h2c_error(h2c, h2c->dsi ? H2_ERR_PROTOCOL_ERROR : H2_ERR_FRAME_SIZE_ERROR);
+		HA_ATOMIC_INC(&h2c->px_counters->conn_proto_err);
+		TRACE_DEVEL("leaving on error", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+		return 0;
+	}
+
+	/* only clients may send it, the frame is ignored on the backend side.
+	 * Updates for streams not opened yet or already closed are ignored.
+	 */
+	sid = h2_get_n32(&h2c->dbuf, 0) & 0x7FFFFFFF;
+	h2s = h2c_st_by_id(h2c, sid);
+	if (!(h2c->flags & H2_CF_IS_BACK) && sid && h2s->id == sid &&
+	    h2s->st != H2_SS_CLOSED && h2c->dfl - 4 <= trash.size) {
+		trash.data = h2c->dfl - 4;
+		h2_get_buf_bytes(trash.area, trash.data, &h2c->dbuf, 4);
+		http_parse_priority(ist2(trash.area, trash.data), &h2s->urgency, &h2s->incremental);
+	}
+
+	TRACE_LEAVE(H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn);
+	return 1;
+}
+
 /* processes an RST_STREAM frame, and sets the 32-bit error code on the stream.
  * Returns > 0 on success or zero on missing data. The caller must have already
  * verified frame length and stream ID validity. Described in RFC7540#6.4.
@@ -2564,6 +2849,7 @@ static struct h2s *h2c_frt_handle_headers(struct h2c *h2c, struct h2s *h2s)
 	struct buffer rxbuf = BUF_NULL;
 	unsigned long long body_len = 0;
 	uint32_t flags = 0;
+	uint8_t urgency, incremental;
 	int error;
 
 	TRACE_ENTER(H2_EV_RX_FRAME|H2_EV_RX_HDR, h2c->conn, h2s);
@@ -2658,6 +2944,9 @@ static struct h2s *h2c_frt_handle_headers(struct h2c *h2c, struct h2s *h2s)
 	 * Xfer the rxbuf to the stream. On success, the new stream owns the
 	 * rxbuf. On error, it is released here.
 	 */
+	/* the request is passed to the stream with the buffer */
+	http_get_priority(htxbuf(&rxbuf), &urgency, &incremental);
+
 	h2s = h2c_frt_stream_new(h2c, h2c->dsi, &rxbuf, flags);
 	if (!h2s) {
 		h2s = (struct h2s*)h2_refused_stream;
@@ -2667,6 +2956,8 @@ static struct h2s *h2c_frt_handle_headers(struct h2c *h2c, struct h2s *h2s)
 	h2s->st = H2_SS_OPEN;
 	h2s->flags |= flags;
 	h2s->body_len = body_len;
+	h2s->urgency = urgency;
+	h2s->incremental = incremental;
 
  done:
 	if (h2c->dff & H2_F_HEADERS_END_STREAM)
@@ -3376,6 +3667,13 @@ static void h2_process_demux(struct h2c *h2c)
 			}
 			break;
 
+		case H2_FT_PRIORITY_UPDATE:
+			if (h2c->st0 == H2_CS_FRAME_P) {
+				TRACE_PROTO("receiving H2 PRIORITY_UPDATE frame", H2_EV_RX_FRAME|H2_EV_RX_PRIO, h2c->conn, h2s);
+				ret = h2c_handle_priority_update(h2c);
+			}
+			break;
+
 		case H2_FT_RST_STREAM:
 			if (h2c->st0 == H2_CS_FRAME_P) {
 				TRACE_PROTO("receiving H2 RST_STREAM frame", H2_EV_RX_FRAME|H2_EV_RX_RST|H2_EV_RX_EOI, h2c->conn, h2s);
@@ -3551,6 +3849,17 @@ static int h2_process_mux(struct h2c *h2c)
 	    h2c_send_conn_wu(h2c) < 0)
 		goto fail;
 
+	/* then the receive window auto-tuning frames */
+	if ((h2c->flags & H2_CF_RXWIN_UPDATE) &&
+	    !(h2c->flags & (H2_CF_MUX_MFULL | H2_CF_MUX_MALLOC)) &&
+	    h2c_send_rxwin_settings(h2c) < 0)
+		goto fail;
+
+	if ((h2c->flags & H2_CF_BDP_PING) &&
+	    !(h2c->flags & (H2_CF_MUX_MFULL | H2_CF_MUX_MALLOC)) &&
+	    h2c_send_bdp_ping(h2c) < 0)
+		goto fail;
+
 	/* First we always process the flow control list because the streams
 	 * waiting there were already elected for immediate emission but were
 	 * blocked just on this.
@@ -3657,6 +3966,52 @@ static int h2_recv(struct h2c *h2c)
 	return !!ret || (h2c->flags & (H2_CF_RCVD_SHUT|H2_CF_ERROR));
 }
 
+/* Sends the contents of all the buffers of the mbuf ring of <h2c> with a
+ * single call to the transport layer's snd_iov() method, which must exist,
+ * so that a burst of frames spread over several buffers does not require one
+ * system call per buffer. <flags> are CO_SFL_* flags. The buffers are left
+ * unmodified, the caller is responsible for removing the returned number of
+ * bytes from them, in the ring's order.
+ */
+static size_t h2_send_iov(struct h2c *h2c, int flags)
+{
+	struct connection *conn = h2c->conn;
+	struct iovec iov[2 * H2C_MBUF_CNT];
+	const char *blk1, *blk2;
+	size_t len1, len2, ret;
+	unsigned int idx = br_head_idx(h2c->mbuf);
+	int cnt = 0;
+
+	while (1) {
+		struct buffer *buf = &h2c->mbuf[idx];
+
+		if (!b_size(buf))
+			break;
+
+		switch (b_getblk_nc(buf, &blk1, &len1, &blk2, &len2, 0, b_data(buf))) {
+		case 2:
+			iov[cnt].iov_base = (void *)blk1;
+			iov[cnt++].iov_len = len1;
+			blk1 = blk2;
+			len1 = len2;
+			__fallthrough;
+		case 1:
+			iov[cnt].iov_base = (void *)blk1;
+			iov[cnt++].iov_len = len1;
+		}
+
+		if (idx == br_tail_idx(h2c->mbuf))
+			break;
+		if (++idx >= br_size(h2c->mbuf))
+			idx = 1;
+	}
+
+	ret = conn->xprt->snd_iov(conn, conn->xprt_ctx, iov, cnt, flags);
+	if (ret)
+		TRACE_DATA("sent data", H2_EV_H2C_SEND, h2c->conn, 0, 0, (void*)(long)ret);
+	return ret;
+}
+
 /* Try to send data if possible.
  * The function returns 1 if data have been sent, otherwise zero.
  */
@@ -3720,7 +4075,31 @@ static int h2_send(struct h2c *h2c)
 		if (h2c->flags & (H2_CF_MUX_MFULL | H2_CF_DEM_MROOM))
 			flags |= CO_SFL_MSG_MORE;
 
-		for (buf = br_head(h2c->mbuf); b_size(buf); buf = br_del_head(h2c->mbuf)) {
+		if (conn->xprt->snd_iov && br_head_idx(h2c->mbuf) != br_tail_idx(h2c->mbuf)) {
+			/* several buffers are pending, send them all at once
+			 * and release those which were completely sent.
+			 */
+			size_t ret = h2_send_iov(h2c, flags);
+
+			if (!ret)
+				done = 1;
+			else
+				sent = 1;
+
+			for (buf = br_head(h2c->mbuf); b_size(buf); buf = br_del_head(h2c->mbuf)) {
+				size_t len = MIN(ret, b_data(buf));
+
+				b_del(buf, len);
+				ret -= len;
+				if (b_data(buf)) {
+					done = 1;
+					break;
+				}
+				b_free(buf);
+				released++;
+			}
+		}
+		else for (buf = br_head(h2c->mbuf); b_size(buf); buf = br_del_head(h2c->mbuf)) {
 			if (b_data(buf)) {
 				int ret = conn->xprt->snd_buf(conn, conn->xprt_ctx, buf, b_data(buf), flags);
 				if (!ret) {
@@ -3896,7 +4275,8 @@ static int h2_process(struct h2c *h2c)
 			if (!(h2c->flags & (H2_CF_GOAWAY_SENT|H2_CF_GOAWAY_FAILED))) {
 				if (h2c->last_sid < 0)
 					h2c->last_sid = (1U << 31) - 1;
-				h2c_send_goaway_error(h2c, NULL);
+				if (h2c_send_goaway_error(h2c, NULL) > 0)
+					_HA_ATOMIC_INC(&soft_stop_idle_closed);
 			}
 		}
 	}
@@ -4157,6 +4537,30 @@ static int h2_ctl(struct connection *conn, enum mux_ctl_type mux_ctl, void *outp
 		return ret;
 	case MUX_EXIT_STATUS:
 		return MUX_ES_UNKNOWN;
+	case MUX_BUF_INFO: {
+		struct mux_buf_info *info = output;
+		int i;
+
+		/* per-stream rx buffers are not counted, they only exist
+		 * while streams are active.
+		 */
+		info->idle   = !h2c->nb_streams;
+		info->rxbufs = !!b_size(&h2c->dbuf);
+		info->txbufs = 0;
+		info->size   = b_size(&h2c->dbuf);
+		/* walk the mbuf ring from head to tail, its root is not a buffer */
+		for (i = br_head_idx(h2c->mbuf); ; ) {
+			if (b_size(&h2c->mbuf[i])) {
+				info->txbufs++;
+				info->size += b_size(&h2c->mbuf[i]);
+			}
+			if (i == br_tail_idx(h2c->mbuf))
+				break;
+			if (++i >= br_size(h2c->mbuf))
+				i = 1;
+		}
+		return 0;
+	}
 	default:
 		return -1;
 	}
@@ -4289,7 +4693,7 @@ static void h2_detach(struct sedesc *sd)
 				else if (!h2c->conn->hash_node->node.node.leaf_p &&
 					 h2_avail_streams(h2c->conn) > 0 && objt_server(h2c->conn->target) &&
 					 !LIST_INLIST(&h2c->conn->session_list)) {
-					eb64_insert(&__objt_server(h2c->conn->target)->per_thr[tid].avail_conns,
+					eb64_insert(srv_avail_conns(__objt_server(h2c->conn->target)),
 					            &h2c->conn->hash_node->node);
 				}
 			}
@@ -4372,9 +4776,9 @@ static void h2_do_shutr(struct h2s *h2s)
 	h2s->flags |= H2_SF_WANT_SHUTR;
 	if (!LIST_INLIST(&h2s->list)) {
 		if (h2s->flags & H2_SF_BLK_MFCTL)
-			LIST_APPEND(&h2c->fctl_list, &h2s->list);
+			h2s_queue_send(h2s, &h2c->fctl_list);
 		else if (h2s->flags & (H2_SF_BLK_MBUSY|H2_SF_BLK_MROOM))
-			LIST_APPEND(&h2c->send_list, &h2s->list);
+			h2s_queue_send(h2s, &h2c->send_list);
 	}
 	TRACE_LEAVE(H2_EV_STRM_SHUT, h2c->conn, h2s);
 	return;
@@ -4456,9 +4860,9 @@ static void h2_do_shutw(struct h2s *h2s)
 	h2s->flags |= H2_SF_WANT_SHUTW;
 	if (!LIST_INLIST(&h2s->list)) {
 		if (h2s->flags & H2_SF_BLK_MFCTL)
-			LIST_APPEND(&h2c->fctl_list, &h2s->list);
+			h2s_queue_send(h2s, &h2c->fctl_list);
 		else if (h2s->flags & (H2_SF_BLK_MBUSY|H2_SF_BLK_MROOM))
-			LIST_APPEND(&h2c->send_list, &h2s->list);
+			h2s_queue_send(h2s, &h2c->send_list);
 	}
 	TRACE_LEAVE(H2_EV_STRM_SHUT, h2c->conn, h2s);
 	return;
@@ -4892,14 +5296,61 @@ static int h2_frt_transfer_data(struct h2s *h2s)
 	if (flen > block)
 		flen = block;
 
-	sent = htx_add_data(htx, ist2(b_head(&h2c->dbuf), flen));
-	TRACE_DATA("move some data to h2s rxbuf", H2_EV_RX_FRAME|H2_EV_RX_DATA, h2c->conn, h2s, 0, (void *)(long)sent);
+	/* very often with large files we'll face the following situation :
+	 *   - htx is empty and points to <scbuf>
+	 *   - dbuf->head == sizeof(struct htx), as pre-aligned by h2_recv()
+	 *   - the data following the payload in dbuf, if any, are shorter
+	 *     than the payload
+	 *   => we can swap the buffers and place an htx header into the
+	 *      target buffer instead, so that the payload is never copied.
+	 *      Only the following data are copied into the new demux buffer,
+	 *      aligned so that the next payload lands where the HTX data will
+	 *      start. flen was already limited to the HTX free data space.
+	 */
+	if (htx_is_empty(htx) && b_head_ofs(&h2c->dbuf) == sizeof(struct htx) &&
+	    b_data(&h2c->dbuf) - flen < flen) {
+		struct buffer raw = h2c->dbuf;
+		uint32_t htx_flags = htx->flags;
+		struct htx_blk *blk;
+
+		h2c->dbuf.area = scbuf->area;
+		h2c->dbuf.data = b_data(&raw) - flen;
+		h2c->dbuf.head = sizeof(struct htx);
+		if (flen == h2c->dfl - h2c->dpl && !h2c->dpl)
+			h2c->dbuf.head -= 9; /* a frame header follows */
+		b_getblk(&raw, b_head(&h2c->dbuf), b_data(&h2c->dbuf), flen);
+
+		scbuf->area = raw.area;
+		htx = (struct htx *)scbuf->area;
+		htx->size = scbuf->size - sizeof(*htx);
+		htx_reset(htx);
+		htx->flags = htx_flags;
+		b_set_data(scbuf, b_size(scbuf));
+
+		blk = htx_add_blk(htx, HTX_BLK_DATA, flen);
+		blk->info += flen;
+		sent = flen;
+		TRACE_DATA("move some data to h2s rxbuf (zero-copy)", H2_EV_RX_FRAME|H2_EV_RX_DATA, h2c->conn, h2s, 0, (void *)(long)sent);
+	}
+	else {
+		sent = htx_add_data(htx, ist2(b_head(&h2c->dbuf), flen));
+		TRACE_DATA("move some data to h2s rxbuf", H2_EV_RX_FRAME|H2_EV_RX_DATA, h2c->conn, h2s, 0, (void *)(long)sent);
+		b_del(&h2c->dbuf, sent);
+	}
 
-	b_del(&h2c->dbuf, sent);
 	h2c->dfl    -= sent;
 	h2c->rcvd_c += sent;
 	h2c->rcvd_s += sent;  // warning, this can also affect the closed streams!
 
+	/* receive window auto-tuning: measure what is received during one
+	 * round trip, delimited by a PING.
+	 */
+	if (h2c->rx_win < h2_settings_max_window_size) {
+		h2c->bdp_bytes += sent;
+		if (!(h2c->flags & H2_CF_BDP_WAIT))
+			h2c->flags |= H2_CF_BDP_PING;
+	}
+
 	if (h2s->flags & H2_SF_DATA_CLEN) {
 		h2s->body_len -= sent;
 		htx->extra = h2s->body_len;
@@ -4954,6 +5405,81 @@ static int h2_frt_transfer_data(struct h2s *h2s)
 	return 0;
 }
 
+/* Takes a snapshot of the encoder dynamic table of connection <h2c> before a
+ * header block is encoded, so that the table can be restored if the block
+ * cannot be committed. The snapshot is returned, or NULL if there is no table
+ * or if it could not be allocated, in which case the table must not be used
+ * for this block.
+ */
+static struct hpack_dht *h2c_edht_save(struct h2c *h2c)
+{
+	struct hpack_dht *snap;
+
+	if (!h2c->edht)
+		return NULL;
+
+	snap = hpack_dht_alloc();
+	if (!snap) {
+		/* the static encoder still makes the peer insert entries */
+		h2c->flags |= H2_CF_EDHT_RESET;
+		return NULL;
+	}
+
+	/* the size may be lower than the table's head if the peer disabled it */
+	memcpy(snap, h2c->edht, MAX(h2c->edht->size, sizeof(*snap)));
+	return snap;
+}
+
+/* Restores the encoder dynamic table of connection <h2c> from snapshot <snap>
+ * if not NULL.
+ */
+static inline void h2c_edht_restore(struct h2c *h2c, const struct hpack_dht *snap)
+{
+	if (snap)
+		memcpy(h2c->edht, snap, MAX(snap->size, sizeof(*snap)));
+}
+
+/* Emits at the beginning of a header block the dynamic table size updates
+ * needed to flush the peer's table and set it to the size of the encoder's
+ * table <edht>, if H2_CF_EDHT_RESET is set (RFC7541#4.2 and #6.3). The local
+ * table is flushed as well. Returns 0 if the buffer is full, otherwise
+ * non-zero.
+ */
+static int h2c_edht_flush(struct h2c *h2c, struct hpack_dht *edht, struct buffer *out)
+{
+	if (!(h2c->flags & H2_CF_EDHT_RESET))
+		return 1;
+
+	if (b_room(out) < 5)
+		return 0;
+
+	hpack_dht_init(edht, edht->size);
+	out->area[out->data++] = 0x20; // HPACK DTSU 0 bytes
+	out->data = hpack_encode_int(out->area, out->data, 0x20, 5, edht->size);
+	return 1;
+}
+
+/* Encodes header <n>:<v> into <out> for connection <h2c>, using the encoder
+ * dynamic table <*edht> if not NULL. If this table cannot be updated, it is
+ * abandoned for the rest of the block (<*edht> is reset) and it will be
+ * flushed on the next one. Returns non-zero on success, 0 if the buffer is full.
+ */
+static inline int h2c_encode_header(struct h2c *h2c, struct buffer *out, struct hpack_dht **edht,
+                                    const struct ist n, const struct ist v)
+{
+	int ret;
+
+	if (*edht) {
+		ret = hpack_encode_header_dht(out, *edht, n, v);
+		if (ret >= 0)
+			return ret;
+		TRACE_DEVEL("failed to update the encoder table", H2_EV_TX_FRAME|H2_EV_TX_HDR, h2c->conn);
+		h2c->flags |= H2_CF_EDHT_RESET;
+		*edht = NULL;
+	}
+	return hpack_encode_header(out, n, v);
+}
+
 /* Try to send a HEADERS frame matching HTX response present in HTX message
  * <htx> for the H2 stream <h2s>. Returns the number of bytes sent. The caller
  * must check the stream's status to detect any error which might have happened
@@ -4968,6 +5494,7 @@ static size_t h2s_frt_make_resp_headers(struct h2s *h2s, struct htx *htx)
 	struct http_hdr list[global.tune.max_http_hdr];
 	struct h2c *h2c = h2s->h2c;
 	struct htx_blk *blk;
+	struct hpack_dht *edht, *snap = NULL;
 	struct buffer outbuf;
 	struct buffer *mbuf;
 	struct htx_sl *sl;
@@ -5042,13 +5569,15 @@ static size_t h2s_frt_make_resp_headers(struct h2s *h2s, struct htx *htx)
 	/* marker for end of headers */
 	list[hdr].n = ist("");
 
+	snap = h2c_edht_save(h2c);
 	mbuf = br_tail(h2c->mbuf);
  retry:
 	if (!h2_get_buf(h2c, mbuf)) {
 		h2c->flags |= H2_CF_MUX_MALLOC;
 		h2s->flags |= H2_SF_BLK_MROOM;
 		TRACE_STATE("waiting for room in output buffer", H2_EV_TX_FRAME|H2_EV_TX_HDR|H2_EV_H2S_BLK, h2c->conn, h2s);
-		return 0;
+		ret = 0;
+		goto end;
 	}
 
 	chunk_reset(&outbuf);
@@ -5069,7 +5598,13 @@ static size_t h2s_frt_make_resp_headers(struct h2s *h2s, struct htx *htx)
 	write_n32(outbuf.area + 5, h2s->id); // 4 bytes
 	outbuf.data = 9;
 
-	if ((h2c->flags & (H2_CF_SHTS_UPDATED|H2_CF_DTSU_EMITTED)) == H2_CF_SHTS_UPDATED) {
+	/* the encoder table, if any, is only used if it could be saved */
+	edht = snap ? h2c->edht : NULL;
+	if (edht) {
+		if (!h2c_edht_flush(h2c, edht, &outbuf))
+			goto encode_failed;
+	}
+	else if ((h2c->flags & (H2_CF_SHTS_UPDATED|H2_CF_DTSU_EMITTED)) == H2_CF_SHTS_UPDATED) {
 		/* SETTINGS_HEADER_TABLE_SIZE changed, we must send an HPACK
 		 * dynamic table size update so that some clients are not
 		 * confused. In practice we only need to send the DTSU when the
@@ -5089,12 +5624,22 @@ static size_t h2s_frt_make_resp_headers(struct h2s *h2s, struct htx *htx)
 		 */
 	}
 
-	/* encode status, which necessarily is the first one */
-	if (!hpack_encode_int_status(&outbuf, h2s->status)) {
-		if (b_space_wraps(mbuf))
-			goto realign_again;
-		goto full;
+	/* encode status, which necessarily is the first one. The static
+	 * encoder makes the peer index non-standard ones, so when the dynamic
+	 * table is used it must know about them.
+	 */
+	if (edht) {
+		char status[3] = {
+			'0' + h2s->status / 100,
+			'0' + h2s->status / 10 % 10,
+			'0' + h2s->status % 10,
+		};
+
+		if (!h2c_encode_header(h2c, &outbuf, &edht, ist(":status"), ist2(status, 3)))
+			goto encode_failed;
 	}
+	else if (!hpack_encode_int_status(&outbuf, h2s->status))
+		goto encode_failed;
 
 	/* encode all headers, stop at empty name */
 	for (hdr = 0; hdr < sizeof(list)/sizeof(list[0]); hdr++) {
@@ -5113,24 +5658,16 @@ static size_t h2s_frt_make_resp_headers(struct h2s *h2s, struct htx *htx)
 		if (isteq(list[hdr].n, ist("")))
 			break; // end
 
-		if (!hpack_encode_header(&outbuf, list[hdr].n, list[hdr].v)) {
-			/* output full */
-			if (b_space_wraps(mbuf))
-				goto realign_again;
-			goto full;
-		}
+		if (!h2c_encode_header(h2c, &outbuf, &edht, list[hdr].n, list[hdr].v))
+			goto encode_failed;
 	}
 
 	/* update the frame's size */
 	h2_set_frame_size(outbuf.area, outbuf.data - 9);
 
 	if (outbuf.data > h2c->mfs + 9) {
-		if (!h2_fragment_headers(&outbuf, h2c->mfs)) {
-			/* output full */
-			if (b_space_wraps(mbuf))
-				goto realign_again;
-			goto full;
-		}
+		if (!h2_fragment_headers(&outbuf, h2c->mfs))
+			goto encode_failed;
 	}
 
 	TRACE_USER("sent H2 response ", H2_EV_TX_FRAME|H2_EV_TX_HDR, h2c->conn, h2s, htx);
@@ -5179,6 +5716,10 @@ static size_t h2s_frt_make_resp_headers(struct h2s *h2s, struct htx *htx)
 		h2c->flags &= ~H2_CF_SHTS_UPDATED;
 	}
 
+	/* the peer's table will be in sync with ours */
+	if (edht)
+		h2c->flags &= ~H2_CF_EDHT_RESET;
+
 	if (es_now) {
 		h2s->flags |= H2_SF_ES_SENT;
 		TRACE_PROTO("setting ES on HEADERS frame", H2_EV_TX_FRAME|H2_EV_TX_HDR, h2c->conn, h2s, htx);
@@ -5190,8 +5731,15 @@ static size_t h2s_frt_make_resp_headers(struct h2s *h2s, struct htx *htx)
 
 	/* OK we could properly deliver the response */
  end:
+	if (snap)
+		hpack_dht_free(snap);
 	TRACE_LEAVE(H2_EV_TX_FRAME|H2_EV_TX_HDR, h2c->conn, h2s);
 	return ret;
+ encode_failed:
+	/* output full, the encoder table must be restored before retrying */
+	h2c_edht_restore(h2c, snap);
+	if (b_space_wraps(mbuf))
+		goto realign_again;
  full:
 	if ((mbuf = br_tail_add(h2c->mbuf)) != NULL)
 		goto retry;
@@ -5990,6 +6538,7 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	struct http_hdr list[global.tune.max_http_hdr];
 	struct h2c *h2c = h2s->h2c;
 	struct htx_blk *blk;
+	struct hpack_dht *edht, *snap = NULL;
 	struct buffer outbuf;
 	struct buffer *mbuf;
 	enum htx_blk_type type;
@@ -6028,6 +6577,7 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	/* marker for end of trailers */
 	list[hdr].n = ist("");
 
+	snap = h2c_edht_save(h2c);
 	mbuf = br_tail(h2c->mbuf);
  retry:
 	if (!h2_get_buf(h2c, mbuf)) {
@@ -6055,6 +6605,11 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	write_n32(outbuf.area + 5, h2s->id); // 4 bytes
 	outbuf.data = 9;
 
+	/* the encoder table, if any, is only used if it could be saved */
+	edht = snap ? h2c->edht : NULL;
+	if (edht && !h2c_edht_flush(h2c, edht, &outbuf))
+		goto encode_failed;
+
 	/* encode all headers */
 	for (idx = 0; idx < hdr; idx++) {
 		/* these ones do not exist in H2 or must not appear in
@@ -6074,12 +6629,8 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 		if (*(list[idx].n.ptr) == ':')
 			continue;
 
-		if (!hpack_encode_header(&outbuf, list[idx].n, list[idx].v)) {
-			/* output full */
-			if (b_space_wraps(mbuf))
-				goto realign_again;
-			goto full;
-		}
+		if (!h2c_encode_header(h2c, &outbuf, &edht, list[idx].n, list[idx].v))
+			goto encode_failed;
 	}
 
 	if (outbuf.data == 9) {
@@ -6097,12 +6648,8 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	h2_set_frame_size(outbuf.area, outbuf.data - 9);
 
 	if (outbuf.data > h2c->mfs + 9) {
-		if (!h2_fragment_headers(&outbuf, h2c->mfs)) {
-			/* output full */
-			if (b_space_wraps(mbuf))
-				goto realign_again;
-			goto full;
-		}
+		if (!h2_fragment_headers(&outbuf, h2c->mfs))
+			goto encode_failed;
 	}
 
 	/* commit the H2 response */
@@ -6110,6 +6657,10 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	b_add(mbuf, outbuf.data);
 	h2s->flags |= H2_SF_ES_SENT;
 
+	/* the peer's table will be in sync with ours */
+	if (edht)
+		h2c->flags &= ~H2_CF_EDHT_RESET;
+
 	if (h2s->st == H2_SS_OPEN)
 		h2s->st = H2_SS_HLOC;
 	else
@@ -6130,8 +6681,15 @@ static size_t h2s_make_trailers(struct h2s *h2s, struct htx *htx)
 	}
 
  end:
+	if (snap)
+		hpack_dht_free(snap);
 	TRACE_LEAVE(H2_EV_TX_FRAME|H2_EV_TX_HDR, h2c->conn, h2s);
 	return ret;
+ encode_failed:
+	/* output full, the encoder table must be restored before retrying */
+	h2c_edht_restore(h2c, snap);
+	if (b_space_wraps(mbuf))
+		goto realign_again;
  full:
 	if ((mbuf = br_tail_add(h2c->mbuf)) != NULL)
 		goto retry;
@@ -6175,9 +6733,9 @@ static int h2_subscribe(struct stconn *sc, int event_type, struct wait_event *es
 		if (!(h2s->flags & H2_SF_BLK_SFCTL) &&
 		    !LIST_INLIST(&h2s->list)) {
 			if (h2s->flags & H2_SF_BLK_MFCTL)
-				LIST_APPEND(&h2c->fctl_list, &h2s->list);
+				h2s_queue_send(h2s, &h2c->fctl_list);
 			else
-				LIST_APPEND(&h2c->send_list, &h2s->list);
+				h2s_queue_send(h2s, &h2c->send_list);
 		}
 	}
 	TRACE_LEAVE(H2_EV_STRM_SEND|H2_EV_STRM_RECV, h2c->conn, h2s);
@@ -6325,11 +6883,10 @@ static size_t h2_snd_buf(struct stconn *sc, struct buffer *buf, size_t count, in
 	TRACE_ENTER(H2_EV_H2S_SEND|H2_EV_STRM_SEND, h2s->h2c->conn, h2s);
 
 	/* If we were not just woken because we wanted to send but couldn't,
-	 * and there's somebody else that is waiting to send, do nothing,
-	 * we will subscribe later and be put at the end of the list
+	 * and there's somebody at least as urgent that is waiting to send, do
+	 * nothing, we will subscribe later and be queued after them.
 	 */
-	if (!(h2s->flags & H2_SF_NOTIFIED) &&
-	    (!LIST_ISEMPTY(&h2s->h2c->send_list) || !LIST_ISEMPTY(&h2s->h2c->fctl_list))) {
+	if (!(h2s->flags & H2_SF_NOTIFIED) && h2s_others_waiting(h2s)) {
 		TRACE_DEVEL("other streams already waiting, going to the queue and leaving", H2_EV_H2S_SEND|H2_EV_H2S_BLK, h2s->h2c->conn, h2s);
 		return 0;
 	}
@@ -6570,9 +7127,9 @@ static int h2_dump_h2c_info(struct buffer *msg, struct h2c *h2c, const char *pfx
 	hmbuf = br_head(h2c->mbuf);
 	tmbuf = br_tail(h2c->mbuf);
 	chunk_appendf(msg, " h2c.st0=%s .err=%d .maxid=%d .lastid=%d .flg=0x%04x"
-		      " .nbst=%u .nbsc=%u",
+		      " .nbst=%u .nbsc=%u .rxwin=%d",
 		      h2c_st_to_str(h2c->st0), h2c->errcode, h2c->max_id, h2c->last_sid, h2c->flags,
-		      h2c->nb_streams, h2c->nb_sc);
+		      h2c->nb_streams, h2c->nb_sc, h2c->rx_win);
 
 	if (pfx)
 		chunk_appendf(msg, "\n%s", pfx);
@@ -6729,6 +7286,22 @@ static int h2_parse_header_table_size(char **args, int section_type, struct prox
 	return 0;
 }
 
+/* config parser for global "tune.h2.encoder-table-size" */
+static int h2_parse_encoder_table_size(char **args, int section_type, struct proxy *curpx,
+                                       const struct proxy *defpx, const char *file, int line,
+                                       char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	h2_settings_encoder_table_size = atoi(args[1]);
+	if (h2_settings_encoder_table_size > 65536) {
+		memprintf(err, "'%s' expects a numeric value between 0 and 65536.", args[0]);
+		return -1;
+	}
+	return 0;
+}
+
 /* config parser for global "tune.h2.initial-window-size" */
 static int h2_parse_initial_window_size(char **args, int section_type, struct proxy *curpx,
                                         const struct proxy *defpx, const char *file, int line,
@@ -6745,6 +7318,22 @@ static int h2_parse_initial_window_size(char **args, int section_type, struct pr
 	return 0;
 }
 
+/* config parser for global "tune.h2.max-window-size" */
+static int h2_parse_max_window_size(char **args, int section_type, struct proxy *curpx,
+                                    const struct proxy *defpx, const char *file, int line,
+                                    char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	h2_settings_max_window_size = atoi(args[1]);
+	if (h2_settings_max_window_size < 0 || h2_settings_max_window_size > (1 << 30)) {
+		memprintf(err, "'%s' expects a numeric value between 0 and 1073741824.", args[0]);
+		return -1;
+	}
+	return 0;
+}
+
 /* config parser for global "tune.h2.max-concurrent-streams" */
 static int h2_parse_max_concurrent_streams(char **args, int section_type, struct proxy *curpx,
                                            const struct proxy *defpx, const char *file, int line,
@@ -6813,10 +7402,12 @@ INITCALL1(STG_REGISTER, register_mux_proto, &mux_proto_h2);
 
 /* config keyword parsers */
 static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.h2.encoder-table-size",     h2_parse_encoder_table_size     },
 	{ CFG_GLOBAL, "tune.h2.header-table-size",      h2_parse_header_table_size      },
 	{ CFG_GLOBAL, "tune.h2.initial-window-size",    h2_parse_initial_window_size    },
 	{ CFG_GLOBAL, "tune.h2.max-concurrent-streams", h2_parse_max_concurrent_streams },
 	{ CFG_GLOBAL, "tune.h2.max-frame-size",         h2_parse_max_frame_size         },
+	{ CFG_GLOBAL, "tune.h2.max-window-size",        h2_parse_max_window_size        },
 	{ 0, NULL, NULL }
 }};
 
@@ -6828,7 +7419,7 @@ INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
 static int init_h2()
 {
 	pool_head_hpack_tbl = create_pool("hpack_tbl",
-	                                  h2_settings_header_table_size,
+	                                  MAX(h2_settings_header_table_size, h2_settings_encoder_table_size),
 	                                  MEM_F_SHARED|MEM_F_EXACT);
 	if (!pool_head_hpack_tbl) {
 		ha_alert("failed to allocate hpack_tbl memory pool\n");
@@ -622,7 +622,7 @@ static int mux_pt_snd_pipe(struct stconn *sc, struct pipe *pipe)
 
 	TRACE_ENTER(PT_EV_TX_DATA, conn, sc, 0, (size_t[]){pipe->data});
 
-	ret = conn->xprt->snd_pipe(conn, conn->xprt_ctx, pipe);
+	ret = conn->xprt->snd_pipe(conn, conn->xprt_ctx, pipe, pipe->data);
 
 	if (conn->flags & CO_FL_ERROR) {
 		se_fl_set_error(ctx->sd);
@@ -5,6 +5,8 @@
 #include <haproxy/api.h>
 #include <haproxy/connection.h>
 #include <haproxy/dynbuf.h>
+#include <haproxy/http-t.h>
+#include <haproxy/htx.h>
 #include <haproxy/list.h>
 #include <haproxy/ncbuf.h>
 #include <haproxy/pool.h>
@@ -61,6 +63,12 @@ static struct qcs *qcs_new(struct qcc *qcc, uint64_t id, enum qcs_type type)
 	LIST_INIT(&qcs->el_opening);
 	qcs->start = TICK_ETERNITY;
 
+	/* request streams are updated by the app layer from the request,
+	 * unidirectional ones (e.g. h3 control and QPACK) go first.
+	 */
+	qcs->urgency = quic_stream_is_uni(id) ? 0 : HTTP_PRIO_URGENCY_DEF;
+	qcs->incremental = 0;
+
 	/* Allocate transport layer stream descriptor. Only needed for TX. */
 	if (!quic_stream_is_uni(id) || !quic_stream_is_remote(qcc, id)) {
 		struct quic_conn *qc = qcc->conn->handle.qc;
@@ -393,13 +401,42 @@ static struct ncbuf *qc_get_ncbuf(struct qcs *qcs, struct ncbuf *ncbuf)
 		b_alloc(&buf);
 		BUG_ON(b_is_null(&buf));
 
-		*ncbuf = ncb_make(buf.area, buf.size, 0);
-		ncb_init(ncbuf, 0);
+		/* The head is placed after the room needed for an HTX header,
+		 * so that an in-order payload may be turned into an HTX
+		 * message in place (see qcs_xfer_rxbuf()).
+		 */
+		*ncbuf = ncb_make(buf.area, buf.size, sizeof(struct htx));
+		ncb_init(ncbuf, sizeof(struct htx));
 	}
 
 	return ncbuf;
 }
 
+/* Hands the Rx buffer of <qcs> over to the application layer by storing it
+ * into <to>, whose previous buffer, if any, must be empty and is released.
+ * This is only possible if there is no out-of-order data in the Rx buffer.
+ * The data are left untouched at their position; they must still be reported
+ * as consumed by the decode_qcs callback, the Rx buffer being then considered
+ * as empty. Returns 1 on success or 0 if the buffer cannot be transferred.
+ */
+int qcs_xfer_rxbuf(struct qcs *qcs, struct buffer *to)
+{
+	struct ncbuf *ncbuf = &qcs->rx.ncbuf;
+
+	if (ncb_is_null(ncbuf) || b_data(to) ||
+	    ncb_total_data(ncbuf) != ncb_data(ncbuf, 0))
+		return 0;
+
+	if (!b_is_null(to)) {
+		b_free(to);
+		offer_buffers(NULL, 1);
+	}
+
+	*to = b_make(ncbuf->area, ncbuf->size, 0, 0);
+	*ncbuf = NCBUF_NULL;
+	return 1;
+}
+
 /* Notify an eventual subscriber on <qcs> or else wakeup up the stconn layer if
  * initialized.
  */
@@ -683,18 +720,21 @@ static void qcs_consume(struct qcs *qcs, uint64_t bytes)
 
 	TRACE_ENTER(QMUX_EV_QCS_RECV, qcc->conn, qcs);
 
-	ret = ncb_advance(buf, bytes);
-	if (ret) {
-		ABORT_NOW(); /* should not happens because removal only in data */
-	}
+	/* the buffer may have been handed over by qcs_xfer_rxbuf() */
+	if (!ncb_is_null(buf)) {
+		ret = ncb_advance(buf, bytes);
+		if (ret) {
+			ABORT_NOW(); /* should not happens because removal only in data */
+		}
 
-	if (ncb_is_empty(buf))
-		qc_free_ncbuf(qcs, buf);
+		if (ncb_is_empty(buf))
+			qc_free_ncbuf(qcs, buf);
+	}
 
 	qcs->rx.offset += bytes;
 	if (qcs->rx.msd - qcs->rx.offset < qcs->rx.msd_init / 2) {
 		TRACE_DATA("increase stream credit via MAX_STREAM_DATA", QMUX_EV_QCS_RECV, qcc->conn, qcs);
-		frm = pool_zalloc(pool_head_quic_frame);
+		frm = qc_frm_alloc(qcc->conn->handle.qc);
 		BUG_ON(!frm); /* TODO handle this properly */
 
 		qcs->rx.msd = qcs->rx.offset + qcs->rx.msd_init;
@@ -711,7 +751,7 @@ static void qcs_consume(struct qcs *qcs, uint64_t bytes)
 	qcc->lfctl.offsets_consume += bytes;
 	if (qcc->lfctl.md - qcc->lfctl.offsets_consume < qcc->lfctl.md_init / 2) {
 		TRACE_DATA("increase conn credit via MAX_DATA", QMUX_EV_QCS_RECV, qcc->conn, qcs);
-		frm = pool_zalloc(pool_head_quic_frame);
+		frm = qc_frm_alloc(qcc->conn->handle.qc);
 		BUG_ON(!frm); /* TODO handle this properly */
 
 		qcc->lfctl.md = qcc->lfctl.offsets_consume + qcc->lfctl.md_init;
@@ -1135,7 +1175,7 @@ static int qcc_release_remote_stream(struct qcc *qcc, uint64_t id)
 		++qcc->lfctl.cl_bidi_r;
 		if (qcc->lfctl.cl_bidi_r > qcc->lfctl.ms_bidi_init / 2) {
 			TRACE_DATA("increase max stream limit with MAX_STREAMS_BIDI", QMUX_EV_QCC_SEND, qcc->conn);
-			frm = pool_zalloc(pool_head_quic_frame);
+			frm = qc_frm_alloc(qcc->conn->handle.qc);
 			BUG_ON(!frm); /* TODO handle this properly */
 
 			LIST_INIT(&frm->reflist);
@@ -1277,7 +1317,7 @@ static int qcs_build_stream_frm(struct qcs *qcs, struct buffer *out, char fin,
 	BUG_ON(qcc->tx.sent_offsets + total > qcc->rfctl.md);
 
 	TRACE_PROTO("sending STREAM frame", QMUX_EV_QCS_SEND, qcc->conn, qcs);
-	frm = pool_zalloc(pool_head_quic_frame);
+	frm = qc_frm_alloc(qcc->conn->handle.qc);
 	if (!frm) {
 		TRACE_ERROR("frame alloc failure", QMUX_EV_QCS_SEND, qcc->conn, qcs);
 		goto err;
@@ -1439,7 +1479,7 @@ static int qcs_send_reset(struct qcs *qcs)
 
 	TRACE_ENTER(QMUX_EV_QCS_SEND, qcs->qcc->conn, qcs);
 
-	frm = pool_zalloc(pool_head_quic_frame);
+	frm = qc_frm_alloc(qcs->qcc->conn->handle.qc);
 	if (!frm) {
 		TRACE_LEAVE(QMUX_EV_QCS_SEND, qcs->qcc->conn, qcs);
 		return 1;
@@ -1453,7 +1493,7 @@ static int qcs_send_reset(struct qcs *qcs)
 
 	LIST_APPEND(&frms, &frm->list);
 	if (qc_send_frames(qcs->qcc, &frms)) {
-		pool_free(pool_head_quic_frame, frm);
+		qc_frm_free(qcs->qcc->conn->handle.qc, frm);
 		TRACE_DEVEL("cannot send RESET_STREAM", QMUX_EV_QCS_SEND, qcs->qcc->conn, qcs);
 		return 1;
 	}
@@ -1509,6 +1549,15 @@ static int _qc_send_qcs(struct qcs *qcs, struct list *frms)
 		BUG_ON_HOT(qcs->tx.offset > qcs->tx.msd);
 		qcc->tx.offsets += xfer;
 		BUG_ON_HOT(qcc->tx.offsets > qcc->rfctl.md);
+
+		/* Release the intermediary buffer once drained so that streams
+		 * waiting for more data from the upper layer do not each pin a
+		 * buffer. It will be allocated again on the next snd_buf.
+		 */
+		if (!b_data(buf)) {
+			b_free(buf);
+			offer_buffers(NULL, 1);
+		}
 	}
 
 	/* out buffer cannot be emptied if qcs offsets differ. */
@@ -1527,48 +1576,19 @@ static int _qc_send_qcs(struct qcs *qcs, struct list *frms)
 	return xfer;
 }
 
-/* Proceed to sending. Loop through all available streams for the <qcc>
- * instance and try to send as much as possible.
+/* Loops through all streams of <qcc> with urgency <urg> and constructs their
+ * STREAM frames into <frms> if data are available. If <levels> is not NULL,
+ * the urgency of every other stream is reported in it as a bit field. Returns
+ * the sum of the amounts of data prepared.
  *
- * Returns the total of bytes sent to the transport layer.
+ * TODO optimize the loop to favor streams which are not too heavy.
  */
-static int qc_send(struct qcc *qcc)
+static int qc_send_urgency(struct qcc *qcc, struct list *frms, int urg, uint *levels)
 {
-	struct list frms = LIST_HEAD_INIT(frms);
 	struct eb64_node *node;
-	struct qcs *qcs, *qcs_tmp;
-	int total = 0, tmp_total = 0;
-
-	TRACE_ENTER(QMUX_EV_QCC_SEND, qcc->conn);
-
-	if (qcc->conn->flags & CO_FL_SOCK_WR_SH || qcc->flags & QC_CF_CC_EMIT) {
-		qcc->conn->flags |= CO_FL_ERROR;
-		TRACE_DEVEL("connection on error", QMUX_EV_QCC_SEND, qcc->conn);
-		goto err;
-	}
-
-	if (!LIST_ISEMPTY(&qcc->lfctl.frms)) {
-		if (qc_send_frames(qcc, &qcc->lfctl.frms)) {
-			TRACE_DEVEL("flow-control frames rejected by transport, aborting send", QMUX_EV_QCC_SEND, qcc->conn);
-			goto out;
-		}
-	}
-
-	if (qcc->flags & QC_CF_BLK_MFCTL)
-		return 0;
-
-	if (!(qcc->flags & QC_CF_APP_FINAL) && !eb_is_empty(&qcc->streams_by_id) &&
-	    qcc->app_ops->finalize) {
-		/* Finalize the application layer before sending any stream.
-		 * For h3 this consists in preparing the control stream data (SETTINGS h3).
-		 */
-		qcc->app_ops->finalize(qcc->ctx);
-		qcc->flags |= QC_CF_APP_FINAL;
-	}
+	struct qcs *qcs;
+	int total = 0;
 
-	/* loop through all streams, construct STREAM frames if data available.
-	 * TODO optimize the loop to favor streams which are not too heavy.
-	 */
 	node = eb64_first(&qcc->streams_by_id);
 	while (node) {
 		int ret;
@@ -1582,6 +1602,13 @@ static int qc_send(struct qcc *qcc)
 			continue;
 		}
 
+		if (qcs->urgency != urg) {
+			if (levels)
+				*levels |= 1U << qcs->urgency;
+			node = eb64_next(node);
+			continue;
+		}
+
 		if (qcs->flags & QC_SF_TO_RESET) {
 			qcs_send_reset(qcs);
 			node = eb64_next(node);
@@ -1603,11 +1630,64 @@ static int qc_send(struct qcc *qcc)
 			continue;
 		}
 
-		ret = _qc_send_qcs(qcs, &frms);
+		ret = _qc_send_qcs(qcs, frms);
 		total += ret;
 		node = eb64_next(node);
 	}
 
+	return total;
+}
+
+/* Proceed to sending. Loop through all available streams for the <qcc>
+ * instance and try to send as much as possible.
+ *
+ * Returns the total of bytes sent to the transport layer.
+ */
+static int qc_send(struct qcc *qcc)
+{
+	struct list frms = LIST_HEAD_INIT(frms);
+	struct qcs *qcs, *qcs_tmp;
+	int total = 0, tmp_total = 0;
+	uint levels = 0;
+	int urg;
+
+	TRACE_ENTER(QMUX_EV_QCC_SEND, qcc->conn);
+
+	if (qcc->conn->flags & CO_FL_SOCK_WR_SH || qcc->flags & QC_CF_CC_EMIT) {
+		qcc->conn->flags |= CO_FL_ERROR;
+		TRACE_DEVEL("connection on error", QMUX_EV_QCC_SEND, qcc->conn);
+		goto err;
+	}
+
+	if (!LIST_ISEMPTY(&qcc->lfctl.frms)) {
+		if (qc_send_frames(qcc, &qcc->lfctl.frms)) {
+			TRACE_DEVEL("flow-control frames rejected by transport, aborting send", QMUX_EV_QCC_SEND, qcc->conn);
+			goto out;
+		}
+	}
+
+	if (qcc->flags & QC_CF_BLK_MFCTL)
+		return 0;
+
+	if (!(qcc->flags & QC_CF_APP_FINAL) && !eb_is_empty(&qcc->streams_by_id) &&
+	    qcc->app_ops->finalize) {
+		/* Finalize the application layer before sending any stream.
+		 * For h3 this consists in preparing the control stream data (SETTINGS h3).
+		 */
+		qcc->app_ops->finalize(qcc->ctx);
+		qcc->flags |= QC_CF_APP_FINAL;
+	}
+
+	/* construct STREAM frames for the streams with data available, by
+	 * RFC9218 urgency so that the most urgent ones are emitted first. The
+	 * first pass also reports which other urgency levels are in use.
+	 */
+	total += qc_send_urgency(qcc, &frms, 0, &levels);
+	for (urg = 1; urg <= HTTP_PRIO_URGENCY_MAX; urg++) {
+		if (levels & (1U << urg))
+			total += qc_send_urgency(qcc, &frms, urg, NULL);
+	}
+
 	if (qc_send_frames(qcc, &frms)) {
 		/* data rejected by transport layer, do not retry. */
 		goto out;
@@ -1635,7 +1715,7 @@ static int qc_send(struct qcc *qcc)
 		struct quic_frame *frm, *frm2;
 		list_for_each_entry_safe(frm, frm2, &frms, list) {
 			LIST_DELETE(&frm->list);
-			pool_free(pool_head_quic_frame, frm);
+			qc_frm_free(qcc->conn->handle.qc, frm);
 		}
 	}
 
@@ -1,6 +1,8 @@
 #define _GNU_SOURCE
 
+#include <pthread.h>
 #include <sched.h>
+#include <signal.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -17,6 +19,7 @@
 #include <haproxy/hash.h>
 #include <haproxy/namespace.h>
 #include <haproxy/signal.h>
+#include <haproxy/thread.h>
 
 /* Opens the namespace <ns_name> and returns the FD or -1 in case of error
  * (check errno).
@@ -90,6 +93,14 @@ struct netns_entry* netns_store_insert(const char *ns_name)
 	if (!entry)
 		goto out;
 	entry->fd = fd;
+#if defined(USE_THREAD) && NETNS_SOCK_POOL_SIZE > 0
+	entry->pool = calloc(1, sizeof(*entry->pool));
+	if (entry->pool) {
+		HA_SPIN_INIT(&entry->pool->lock);
+		pthread_mutex_init(&entry->pool->mtx, NULL);
+		pthread_cond_init(&entry->pool->cond, NULL);
+	}
+#endif
 	entry->node.key = strdup(ns_name);
 	entry->name_len = strlen(ns_name);
 	ebis_insert(&namespace_tree_root, &entry->node);
@@ -108,13 +119,153 @@ const struct netns_entry* netns_store_lookup(const char *ns_name, size_t ns_name
 		return NULL;
 }
 
+#if defined(USE_THREAD) && NETNS_SOCK_POOL_SIZE > 0
+
+/* Body of the helper thread which keeps the socket pool of namespace <arg>
+ * filled. It enters the namespace once for all, so that the sockets it creates
+ * belong to it, then sleeps until the workers report a shortage. Sockets are
+ * created with the same flags as the ones from socket() so that the caller
+ * does not need to care where they come from.
+ */
+static void *netns_pool_helper(void *arg)
+{
+	struct netns_entry *ns = arg;
+	struct netns_sock_pool *pool = ns->pool;
+	static const int domains[2] = { AF_INET, AF_INET6 };
+	int fds[NETNS_SOCK_POOL_SIZE];
+	int idx, nb, fd;
+
+	if (setns(ns->fd, CLONE_NEWNET) == -1) {
+		HA_ATOMIC_STORE(&pool->state, 2);
+		return NULL;
+	}
+
+	while (1) {
+		pthread_mutex_lock(&pool->mtx);
+		while (!HA_ATOMIC_LOAD(&pool->wakeup))
+			pthread_cond_wait(&pool->cond, &pool->mtx);
+		pthread_mutex_unlock(&pool->mtx);
+		HA_ATOMIC_STORE(&pool->wakeup, 0);
+
+		for (idx = 0; idx < 2; idx++) {
+			if (!(HA_ATOMIC_LOAD(&pool->want) & (1U << idx)))
+				continue;
+
+			/* create the missing sockets out of the lock */
+			nb = NETNS_SOCK_POOL_SIZE - HA_ATOMIC_LOAD(&pool->count[idx]);
+			for (fd = 0; fd < nb; fd++) {
+				fds[fd] = socket(domains[idx], SOCK_STREAM, 0);
+				if (fds[fd] < 0)
+					break;
+				if (fds[fd] >= global.maxsock) {
+					close(fds[fd]);
+					break;
+				}
+			}
+			nb = fd;
+
+			HA_SPIN_LOCK(NETNS_LOCK, &pool->lock);
+			while (nb && pool->count[idx] < NETNS_SOCK_POOL_SIZE)
+				pool->fds[idx][pool->count[idx]++] = fds[--nb];
+			HA_SPIN_UNLOCK(NETNS_LOCK, &pool->lock);
+
+			while (nb)
+				close(fds[--nb]);
+		}
+	}
+	return NULL;
+}
+
+/* Asks the helper thread of namespace <ns> to refill its pool, starting it
+ * first if needed.
+ */
+static void netns_pool_wake(struct netns_entry *ns)
+{
+	struct netns_sock_pool *pool = ns->pool;
+	uint state = 0;
+
+	if (HA_ATOMIC_XCHG(&pool->wakeup, 1))
+		return;
+
+	if (!HA_ATOMIC_LOAD(&pool->state) && HA_ATOMIC_CAS(&pool->state, &state, 1)) {
+		sigset_t all, old;
+		pthread_t thr;
+
+		/* the helper must never receive any signal */
+		sigfillset(&all);
+		pthread_sigmask(SIG_SETMASK, &all, &old);
+		if (pthread_create(&thr, NULL, netns_pool_helper, ns) == 0)
+			pthread_detach(thr);
+		else
+			HA_ATOMIC_STORE(&pool->state, 2);
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+	}
+
+	pthread_mutex_lock(&pool->mtx);
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->mtx);
+}
+
+/* Tries to retrieve a socket created in advance in namespace <ns>. Only TCP
+ * sockets for IPv4 and IPv6 are pooled, which covers outgoing connections to
+ * servers. The first request for a family only enables its pool. Returns the
+ * FD or -1 if none is available, in which case the caller must create the
+ * socket itself.
+ */
+static int netns_pool_get(const struct netns_entry *ns, int domain, int type, int protocol)
+{
+	struct netns_sock_pool *pool = ns->pool;
+	int idx, fd = -1, left = 0;
+
+	/* threads do not survive the fork, wait for the process to be ready */
+	if (!pool || (global.mode & MODE_STARTING) || type != SOCK_STREAM || protocol != 0)
+		return -1;
+
+	if (domain == AF_INET)
+		idx = 0;
+	else if (domain == AF_INET6)
+		idx = 1;
+	else
+		return -1;
+
+	if (HA_ATOMIC_LOAD(&pool->state) == 2)
+		return -1;
+
+	if (!(HA_ATOMIC_LOAD(&pool->want) & (1U << idx)))
+		HA_ATOMIC_OR(&pool->want, 1U << idx);
+
+	if (HA_ATOMIC_LOAD(&pool->count[idx])) {
+		HA_SPIN_LOCK(NETNS_LOCK, &pool->lock);
+		if (pool->count[idx])
+			fd = pool->fds[idx][--pool->count[idx]];
+		left = pool->count[idx];
+		HA_SPIN_UNLOCK(NETNS_LOCK, &pool->lock);
+	}
+
+	if (left < NETNS_SOCK_POOL_SIZE / 2 + 1)
+		netns_pool_wake((struct netns_entry *)ns);
+	return fd;
+}
+
+#endif /* USE_THREAD && NETNS_SOCK_POOL_SIZE */
+
 /* Opens a socket in the namespace described by <ns> with the parameters <domain>,
  * <type> and <protocol> and returns the FD or -1 in case of error (check errno).
+ * Outgoing TCP sockets are preferably taken from the namespace's pool to save
+ * the two namespace switches.
  */
 int my_socketat(const struct netns_entry *ns, int domain, int type, int protocol)
 {
 	int sock;
 
+#if defined(USE_THREAD) && NETNS_SOCK_POOL_SIZE > 0
+	if (default_namespace >= 0 && ns) {
+		sock = netns_pool_get(ns, domain, type, protocol);
+		if (sock >= 0)
+			return sock;
+	}
+#endif
+
 	if (default_namespace >= 0 && ns && setns(ns->fd, CLONE_NEWNET) == -1)
 		return -1;
 
@@ -0,0 +1,260 @@
+/*
+ * Compiled map files management.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <haproxy/api.h>
+#include <haproxy/patmap.h>
+#include <haproxy/tools.h>
+
+
+/* Returns non-zero if file <file> starts with the magic of a compiled map,
+ * otherwise zero, including when it cannot be read.
+ */
+int patmap_is_compiled(const char *file)
+{
+	char magic[8];
+	int fd, ret;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	ret = read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+	      memcmp(magic, PATMAP_MAGIC, sizeof(magic)) == 0;
+	close(fd);
+	return ret;
+}
+
+/* Maps compiled map file <file> and checks it. The entries array is entirely
+ * verified so that a lookup may never access anything out of the mapping,
+ * but the strings area is not read, so that opening a huge file remains
+ * instantaneous. Returns the new map, or NULL with an error message in <err>
+ * on failure.
+ */
+struct patmap *patmap_open(const char *file, char **err)
+{
+	const struct patmap_hdr *hdr;
+	struct patmap *map = NULL;
+	struct stat st;
+	void *area = MAP_FAILED;
+	uint64_t str_size, idx;
+	size_t ent_size;
+	int fd;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		memprintf(err, "failed to open compiled map <%s> : %s", file, strerror(errno));
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		memprintf(err, "failed to stat compiled map <%s> : %s", file, strerror(errno));
+		goto fail;
+	}
+
+	if (st.st_size < sizeof(*hdr) + 1) {
+		memprintf(err, "compiled map <%s> is truncated", file);
+		goto fail;
+	}
+
+	area = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (area == MAP_FAILED) {
+		memprintf(err, "failed to map compiled map <%s> : %s", file, strerror(errno));
+		goto fail;
+	}
+
+	hdr = area;
+	if (memcmp(hdr->magic, PATMAP_MAGIC, sizeof(hdr->magic)) != 0) {
+		memprintf(err, "<%s> is not a compiled map", file);
+		goto fail;
+	}
+
+	if (hdr->endian != PATMAP_ENDIAN) {
+		memprintf(err, "compiled map <%s> was built for another architecture", file);
+		goto fail;
+	}
+
+	if (hdr->type == PATMAP_T_STR)
+		ent_size = sizeof(struct patmap_str);
+	else if (hdr->type == PATMAP_T_IPV4)
+		ent_size = sizeof(struct patmap_ip4);
+	else {
+		memprintf(err, "compiled map <%s> has unsupported type %u", file, hdr->type);
+		goto fail;
+	}
+
+	if (hdr->size != st.st_size ||
+	    hdr->ent_ofs < sizeof(*hdr) || (hdr->ent_ofs & 7) ||
+	    hdr->count > (hdr->size - hdr->ent_ofs) / ent_size ||
+	    hdr->str_ofs < hdr->ent_ofs + hdr->count * ent_size ||
+	    hdr->str_ofs >= hdr->size ||
+	    ((const char *)area)[hdr->size - 1] != 0) {
+		memprintf(err, "compiled map <%s> is corrupted", file);
+		goto fail;
+	}
+
+	map = calloc(1, sizeof(*map));
+	if (!map) {
+		memprintf(err, "out of memory");
+		goto fail;
+	}
+
+	map->area  = area;
+	map->size  = st.st_size;
+	map->type  = hdr->type;
+	map->count = hdr->count;
+	map->ent   = (const char *)area + hdr->ent_ofs;
+	map->str   = (const char *)area + hdr->str_ofs;
+	str_size   = hdr->size - hdr->str_ofs;
+
+	/* all offsets must remain inside the strings area, and parents must
+	 * designate earlier entries so that the prefix walk always ends.
+	 */
+	for (idx = 0; idx < map->count; idx++) {
+		if (map->type == PATMAP_T_STR) {
+			const struct patmap_str *ent = (const struct patmap_str *)map->ent + idx;
+
+			if (ent->key_ofs >= str_size || ent->key_len > str_size - ent->key_ofs ||
+			    ent->val_ofs >= str_size || ent->val_len > str_size - ent->val_ofs ||
+			    (ent->parent != PATMAP_NONE && ent->parent >= idx))
+				break;
+		}
+		else {
+			const struct patmap_ip4 *ent = (const struct patmap_ip4 *)map->ent + idx;
+
+			if (ent->from > ent->to ||
+			    (idx && ent->from <= ent[-1].to) ||
+			    ent->val_ofs >= str_size || ent->val_len > str_size - ent->val_ofs)
+				break;
+		}
+	}
+
+	if (idx < map->count) {
+		memprintf(err, "compiled map <%s> is corrupted at entry %llu", file, (ullong)idx);
+		goto fail;
+	}
+
+	/* lookups are random, read-ahead would only waste memory */
+	madvise(area, st.st_size, MADV_RANDOM);
+	close(fd);
+	return map;
+
+ fail:
+	free(map);
+	if (area != MAP_FAILED)
+		munmap(area, st.st_size);
+	close(fd);
+	return NULL;
+}
+
+/* Unmaps and releases compiled map <map>. Nothing is done if it is NULL. */
+void patmap_close(struct patmap *map)
+{
+	if (!map)
+		return;
+	munmap(map->area, map->size);
+	free(map);
+}
+
+/* compares the key of entry <ent> to <key> of length <len>, and returns <0,
+ * 0 or >0 depending on whether the entry's key sorts before, equals or sorts
+ * after <key>.
+ */
+static inline int patmap_cmp_str(const struct patmap *map, const struct patmap_str *ent,
+                                 const char *key, size_t len)
+{
+	int ret;
+
+	ret = memcmp(map->str + ent->key_ofs, key, MIN(ent->key_len, len));
+	if (ret)
+		return ret;
+	return (ent->key_len > len) - (ent->key_len < len);
+}
+
+/* Looks up key <key> of length <len> in string map <map>. Returns the index
+ * of the matching entry or PATMAP_NONE.
+ */
+uint64_t patmap_lookup_str(const struct patmap *map, const char *key, size_t len)
+{
+	const struct patmap_str *ent = map->ent;
+	uint64_t lo = 0, hi = map->count;
+
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+		int ret = patmap_cmp_str(map, &ent[mid], key, len);
+
+		if (!ret)
+			return mid;
+		if (ret < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return PATMAP_NONE;
+}
+
+/* Looks up the longest key of string map <map> which is a prefix of <key> of
+ * length <len>. Any such key sorts between the last entry not sorting after
+ * <key> and <key> itself, so it is a prefix of this entry and is reached by
+ * walking up its parents. Returns the index of the matching entry or
+ * PATMAP_NONE.
+ */
+uint64_t patmap_lookup_beg(const struct patmap *map, const char *key, size_t len)
+{
+	const struct patmap_str *ent = map->ent;
+	uint64_t lo = 0, hi = map->count;
+	uint64_t idx;
+
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+
+		if (patmap_cmp_str(map, &ent[mid], key, len) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (!lo)
+		return PATMAP_NONE;
+
+	for (idx = lo - 1; idx != PATMAP_NONE; idx = ent[idx].parent) {
+		if (ent[idx].key_len <= len &&
+		    memcmp(map->str + ent[idx].key_ofs, key, ent[idx].key_len) == 0)
+			return idx;
+	}
+	return PATMAP_NONE;
+}
+
+/* Looks up IPv4 address <addr> (host byte order) in IPv4 map <map>. Returns
+ * the index of the range containing it or PATMAP_NONE.
+ */
+uint64_t patmap_lookup_ip4(const struct patmap *map, uint32_t addr)
+{
+	const struct patmap_ip4 *ent = map->ent;
+	uint64_t lo = 0, hi = map->count;
+
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+
+		if (addr < ent[mid].from)
+			hi = mid;
+		else if (addr > ent[mid].to)
+			lo = mid + 1;
+		else
+			return mid;
+	}
+	return PATMAP_NONE;
+}
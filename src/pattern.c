@@ -14,16 +14,26 @@
 #include <stdio.h>
 #include <errno.h>
 
+#ifdef USE_HYPERSCAN
+#include <hs/hs.h>
+#endif
+
 #include <import/ebsttree.h>
 #include <import/lru.h>
 
+#include <haproxy/activity.h>
 #include <haproxy/api.h>
+#include <haproxy/cfgparse.h>
+#include <haproxy/errors.h>
 #include <haproxy/global.h>
 #include <haproxy/log.h>
 #include <haproxy/net_helper.h>
+#include <haproxy/patmap.h>
 #include <haproxy/pattern.h>
 #include <haproxy/regex.h>
 #include <haproxy/sample.h>
+#include <haproxy/task.h>
+#include <haproxy/thread.h>
 #include <haproxy/tools.h>
 #include <haproxy/xxhash.h>
 
@@ -138,9 +148,186 @@ static THREAD_LOCAL struct sample_data static_sample_data;
 /* This is the root of the list of all pattern_ref avalaibles. */
 struct list pattern_reference = LIST_HEAD_INIT(pattern_reference);
 
+/* Incremented each time a pattern is added to a reference flagged
+ * PAT_REF_WATCH, or when a new generation of it is committed, so that users
+ * having indexed the contents of such references (e.g. switching rules) know
+ * that their index may not be trusted anymore. Deletions are not reported,
+ * so such users must always confirm a match.
+ */
+unsigned int pat_ref_watch_gen = 0;
+
 static THREAD_LOCAL struct lru64_head *pat_lru_tree;
 static unsigned long long pat_lru_seed __read_mostly;
 
+/* a "tune.pattern.ref-cache-size" setting, applied once all references exist */
+struct pat_ref_cache_cfg {
+	struct list list;
+	char *reference;  /* reference name, or #<unique_id> */
+	int size;         /* number of entries, 0 for none */
+	char *file;       /* where it was declared */
+	int line;
+};
+
+static struct list pat_ref_cache_cfgs = LIST_HEAD_INIT(pat_ref_cache_cfgs);
+
+/* Returns the entry of the pattern cache holding the result of matching the
+ * string or binary sample <smp> against expression <expr>, or NULL if there
+ * is no cache for this expression. The result is valid if the entry's domain
+ * is set, otherwise it must be computed and committed using lru64_commit().
+ * The cache is the one dedicated to the expression's reference if any, or the
+ * shared one. The expression's cache statistics are updated.
+ */
+static struct lru64 *pat_lru_get(const struct sample *smp, struct pattern_expr *expr)
+{
+	struct lru64_head *head = pat_lru_tree;
+	struct lru64 *lru;
+	int usage;
+
+	if (expr->ref->cache_size >= 0)
+		head = expr->ref->cache_size ? expr->ref->lru[tid] : NULL;
+
+	if (!head)
+		return NULL;
+
+	usage = head->cache_usage;
+	lru = lru64_get(XXH3(smp->data.u.str.area, smp->data.u.str.data, pat_lru_seed ^ (long)expr),
+	                head, expr, expr->ref->revision);
+
+	_HA_ATOMIC_INC(&expr->cache_lookups);
+	if (lru && lru->domain)
+		_HA_ATOMIC_INC(&expr->cache_hits);
+	else if (lru && head->cache_usage <= usage)
+		_HA_ATOMIC_INC(&expr->cache_evictions);
+	return lru;
+}
+
+/* Sample values replaced by "set map" are not protected by the expressions'
+ * lock anymore: the new value is atomically published in place of the old
+ * one, which may still be read by lookups running on other threads. Lookups
+ * never keep references to the patterns' data once they return (see
+ * pattern_exec_match()), so a replaced object may be released once all other
+ * threads have been seen either completing the polling loop iteration they
+ * were in when it was unlinked, or waiting in the poller. Retired objects are
+ * first queued into pat_retired_new. The reclaim task moves them to
+ * pat_retired_old and takes a snapshot of the threads' loop counters, then
+ * frees them once all threads have moved past this snapshot.
+ */
+struct pat_retired {
+	struct pat_retired *next;
+	void *ptr;
+};
+
+static struct pat_retired *pat_retired_new;
+static struct pat_retired *pat_retired_old;
+static unsigned int pat_retired_loops[MAX_THREADS];
+static struct task *pat_reclaim_task;
+__decl_thread(static HA_SPINLOCK_T pat_retired_lock);
+
+/* frees the objects of the list of retired objects starting at <ret> */
+static void pat_retired_free(struct pat_retired *ret)
+{
+	struct pat_retired *next;
+
+	for (; ret; ret = next) {
+		next = ret->next;
+		free(ret->ptr);
+		free(ret);
+	}
+}
+
+/* Queues the list of retired objects from <first> to <last> for release. They
+ * are freed immediately if no other thread may be reading them.
+ */
+static void pat_retire(struct pat_retired *first, struct pat_retired *last)
+{
+	if (!first)
+		return;
+
+	if (global.nbthread == 1 || !pat_reclaim_task) {
+		pat_retired_free(first);
+		return;
+	}
+
+	HA_SPIN_LOCK(PATREF_LOCK, &pat_retired_lock);
+	last->next = pat_retired_new;
+	pat_retired_new = first;
+	HA_SPIN_UNLOCK(PATREF_LOCK, &pat_retired_lock);
+	task_wakeup(pat_reclaim_task, TASK_WOKEN_OTHER);
+}
+
+/* Returns non-zero if all threads but the current one have moved past the
+ * snapshot of their loop counters stored in pat_retired_loops[]. Must be
+ * called with pat_retired_lock held.
+ */
+static int pat_retired_grace_over(void)
+{
+	int thr;
+
+	for (thr = 0; thr < global.nbthread; thr++) {
+		if (thr == tid)
+			continue;
+		if (HA_ATOMIC_LOAD(&activity[thr].loops) != pat_retired_loops[thr])
+			continue;
+		if (HA_ATOMIC_LOAD(&ha_tgroup_ctx[ha_thread_info[thr].tgid - 1].threads_harmless) &
+		    ha_thread_info[thr].ltid_bit)
+			continue;
+		return 0;
+	}
+	return 1;
+}
+
+/* Releases the retired objects whose grace period is over, and starts a new
+ * grace period for the ones retired since. The task reschedules itself as
+ * long as there are retired objects left.
+ */
+static struct task *pat_reclaim(struct task *t, void *context, unsigned int state)
+{
+	struct pat_retired *done = NULL;
+	int thr, more;
+
+	HA_SPIN_LOCK(PATREF_LOCK, &pat_retired_lock);
+	if (pat_retired_old && pat_retired_grace_over()) {
+		done = pat_retired_old;
+		pat_retired_old = NULL;
+	}
+
+	if (!pat_retired_old && pat_retired_new) {
+		pat_retired_old = pat_retired_new;
+		pat_retired_new = NULL;
+		for (thr = 0; thr < global.nbthread; thr++)
+			pat_retired_loops[thr] = HA_ATOMIC_LOAD(&activity[thr].loops);
+	}
+	more = pat_retired_old != NULL;
+	HA_SPIN_UNLOCK(PATREF_LOCK, &pat_retired_lock);
+
+	pat_retired_free(done);
+	t->expire = more ? tick_add(now_ms, MS_TO_TICKS(PAT_RECLAIM_DELAY)) : TICK_ETERNITY;
+	return t;
+}
+
+static int pat_reclaim_init(void)
+{
+	pat_reclaim_task = task_new_anywhere();
+	if (!pat_reclaim_task) {
+		ha_alert("Failed to allocate the pattern reclaim task.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+	pat_reclaim_task->process = pat_reclaim;
+	return ERR_NONE;
+}
+
+static void pat_reclaim_deinit(void)
+{
+	pat_retired_free(pat_retired_old);
+	pat_retired_free(pat_retired_new);
+	pat_retired_old = pat_retired_new = NULL;
+	task_destroy(pat_reclaim_task);
+	pat_reclaim_task = NULL;
+}
+
+REGISTER_POST_CHECK(pat_reclaim_init);
+REGISTER_POST_DEINIT(pat_reclaim_deinit);
+
 /*
  *
  * The following functions are not exported and are used by internals process
@@ -491,16 +678,9 @@ struct pattern *pat_match_str(struct sample *smp, struct pattern_expr *expr, int
 	}
 
 	/* look in the list */
-	if (pat_lru_tree) {
-		unsigned long long seed = pat_lru_seed ^ (long)expr;
-
-		lru = lru64_get(XXH3(smp->data.u.str.area, smp->data.u.str.data, seed),
-				pat_lru_tree, expr, expr->ref->revision);
-		if (lru && lru->domain) {
-			ret = lru->data;
-			return ret;
-		}
-	}
+	lru = pat_lru_get(smp, expr);
+	if (lru && lru->domain)
+		return lru->data;
 
 
 	list_for_each_entry(lst, &expr->patterns, list) {
@@ -534,16 +714,9 @@ struct pattern *pat_match_bin(struct sample *smp, struct pattern_expr *expr, int
 	struct pattern *ret = NULL;
 	struct lru64 *lru = NULL;
 
-	if (pat_lru_tree) {
-		unsigned long long seed = pat_lru_seed ^ (long)expr;
-
-		lru = lru64_get(XXH3(smp->data.u.str.area, smp->data.u.str.data, seed),
-				pat_lru_tree, expr, expr->ref->revision);
-		if (lru && lru->domain) {
-			ret = lru->data;
-			return ret;
-		}
-	}
+	lru = pat_lru_get(smp, expr);
+	if (lru && lru->domain)
+		return lru->data;
 
 	list_for_each_entry(lst, &expr->patterns, list) {
 		pattern = &lst->pat;
@@ -593,6 +766,280 @@ struct pattern *pat_match_regm(struct sample *smp, struct pattern_expr *expr, in
 	return ret;
 }
 
+#ifdef USE_HYPERSCAN
+/* Hyperscan database built from the regex patterns of an expression, so that
+ * the "reg" match method scans the sample only once whatever the number of
+ * patterns. Patterns are identified by their rank in the expression's list.
+ * Those that Hyperscan does not support (back-references, look-arounds...)
+ * are left to the regex library and only evaluated when they rank before the
+ * first match reported by the scan. As for the automatons, all generations
+ * are present and are checked at match time.
+ */
+struct pat_hs {
+	hs_database_t *db;       /* NULL if no pattern is supported */
+	struct pattern **pats;   /* all patterns, indexed by their rank */
+	unsigned int *slow;      /* ranks of the unsupported patterns, ascending */
+	unsigned int nb_pats;
+	unsigned int nb_slow;
+};
+
+/* matching context passed to pat_hs_on_match() */
+struct pat_hs_ctx {
+	const struct pat_hs *hs;
+	const struct pattern_expr *expr;
+	unsigned int best;       /* lowest rank matched so far, or ~0 */
+};
+
+/* The scratch space needed by a scan depends on the database, so a prototype
+ * is grown for each new database, and each thread clones it whenever its own
+ * one is older. Both the prototype and its generation number are protected
+ * by <pat_hs_lock>.
+ */
+static hs_scratch_t *pat_hs_proto;
+static unsigned int pat_hs_proto_gen;
+__decl_thread(static HA_SPINLOCK_T pat_hs_lock);
+static THREAD_LOCAL hs_scratch_t *pat_hs_scratch;
+static THREAD_LOCAL unsigned int pat_hs_scratch_gen;
+
+/* Releases database <hs>. Nothing is done if it is NULL. */
+static void pat_hs_free(struct pat_hs *hs)
+{
+	if (!hs)
+		return;
+	hs_free_database(hs->db);
+	free(hs->pats);
+	free(hs->slow);
+	free(hs);
+}
+
+/* Builds a Hyperscan database from the patterns of expression <expr>, which
+ * must be at least read-locked. The patterns are compiled again from their
+ * reference's text with the same case sensitivity as by regex_comp(). Returns
+ * NULL if memory is missing or if the library fails for another reason than
+ * an unsupported pattern.
+ */
+static struct pat_hs *pat_hs_build(struct pattern_expr *expr)
+{
+	struct pattern_list *lst;
+	struct pat_hs *hs;
+	hs_compile_error_t *cerr;
+	hs_expr_info_t *info;
+	const char **exprs = NULL;
+	unsigned int *flags = NULL, *ids = NULL;
+	char *unsupported = NULL;
+	unsigned int hsflags, i, nb;
+	hs_error_t ret;
+
+	hs = calloc(1, sizeof(*hs));
+	if (!hs)
+		return NULL;
+
+	list_for_each_entry(lst, &expr->patterns, list)
+		hs->nb_pats++;
+
+	hs->pats    = calloc(hs->nb_pats + 1, sizeof(*hs->pats));
+	hs->slow    = calloc(hs->nb_pats + 1, sizeof(*hs->slow));
+	exprs       = calloc(hs->nb_pats + 1, sizeof(*exprs));
+	flags       = calloc(hs->nb_pats + 1, sizeof(*flags));
+	ids         = calloc(hs->nb_pats + 1, sizeof(*ids));
+	unsupported = calloc(hs->nb_pats + 1, sizeof(*unsupported));
+	if (!hs->pats || !hs->slow || !exprs || !flags || !ids || !unsupported)
+		goto fail;
+
+	/* a regex may match anywhere in the sample, possibly an empty string */
+	hsflags = HS_FLAG_SINGLEMATCH | HS_FLAG_ALLOWEMPTY;
+	if (expr->mflags & PAT_MF_IGNORE_CASE)
+		hsflags |= HS_FLAG_CASELESS;
+
+	i = 0;
+	list_for_each_entry(lst, &expr->patterns, list) {
+		hs->pats[i] = &lst->pat;
+		if (hs_expression_info(lst->pat.ref->pattern, hsflags, &info, &cerr) == HS_SUCCESS)
+			free(info);
+		else {
+			hs_free_compile_error(cerr);
+			unsupported[i] = 1;
+		}
+		i++;
+	}
+
+	/* a few patterns are only rejected when compiling the whole database,
+	 * in which case they are removed one at a time.
+	 */
+	while (1) {
+		nb = 0;
+		for (i = 0; i < hs->nb_pats; i++) {
+			if (unsupported[i])
+				continue;
+			exprs[nb] = hs->pats[i]->ref->pattern;
+			flags[nb] = hsflags;
+			ids[nb]   = i;
+			nb++;
+		}
+
+		if (!nb)
+			break;
+
+		if (hs_compile_multi(exprs, flags, ids, nb, HS_MODE_BLOCK, NULL, &hs->db, &cerr) == HS_SUCCESS)
+			break;
+
+		i = cerr->expression;
+		hs_free_compile_error(cerr);
+		if ((int)i < 0)
+			goto fail;
+		unsupported[ids[i]] = 1;
+	}
+
+	for (i = 0; i < hs->nb_pats; i++) {
+		if (unsupported[i])
+			hs->slow[hs->nb_slow++] = i;
+	}
+
+	if (hs->db) {
+		HA_SPIN_LOCK(PATEXP_LOCK, &pat_hs_lock);
+		ret = hs_alloc_scratch(hs->db, &pat_hs_proto);
+		if (ret == HS_SUCCESS)
+			pat_hs_proto_gen++;
+		HA_SPIN_UNLOCK(PATEXP_LOCK, &pat_hs_lock);
+		if (ret != HS_SUCCESS)
+			goto fail;
+	}
+
+	free(exprs);
+	free(flags);
+	free(ids);
+	free(unsupported);
+	return hs;
+
+ fail:
+	free(exprs);
+	free(flags);
+	free(ids);
+	free(unsupported);
+	pat_hs_free(hs);
+	return NULL;
+}
+
+/* Returns the database of expression <expr>, building it if needed, with the
+ * same rules as pat_acm_get(). NULL means that the list of patterns must be
+ * walked instead.
+ */
+static struct pat_hs *pat_hs_get(struct pattern_expr *expr)
+{
+	struct pat_hs *hs = HA_ATOMIC_LOAD(&expr->hs);
+
+	if (likely(hs) || HA_ATOMIC_XCHG(&expr->acm_busy, 1))
+		return hs;
+
+	/* it may have been built in the mean time */
+	hs = HA_ATOMIC_LOAD(&expr->hs);
+	if (!hs) {
+		hs = pat_hs_build(expr);
+		HA_ATOMIC_STORE(&expr->hs, hs);
+	}
+	HA_ATOMIC_STORE(&expr->acm_busy, 0);
+	return hs;
+}
+
+/* Returns the current thread's scratch space, first replacing it with a clone
+ * of the prototype if a database was built since it was last updated. Returns
+ * NULL if it cannot be used with the latest databases.
+ */
+static hs_scratch_t *pat_hs_get_scratch(void)
+{
+	hs_scratch_t *scratch = NULL;
+
+	if (likely(pat_hs_scratch_gen == HA_ATOMIC_LOAD(&pat_hs_proto_gen)))
+		return pat_hs_scratch;
+
+	HA_SPIN_LOCK(PATEXP_LOCK, &pat_hs_lock);
+	if (hs_clone_scratch(pat_hs_proto, &scratch) == HS_SUCCESS) {
+		hs_free_scratch(pat_hs_scratch);
+		pat_hs_scratch = scratch;
+		pat_hs_scratch_gen = pat_hs_proto_gen;
+	}
+	HA_SPIN_UNLOCK(PATEXP_LOCK, &pat_hs_lock);
+	return scratch;
+}
+
+/* Called by hs_scan() for each pattern matching the sample. Patterns may be
+ * reported in any order, so the lowest rank of the current generation is
+ * kept, and the scan is stopped once the first pattern is found.
+ */
+static int pat_hs_on_match(unsigned int id, unsigned long long from, unsigned long long to,
+                           unsigned int flags, void *context)
+{
+	struct pat_hs_ctx *ctx = context;
+
+	if (id < ctx->best && ctx->hs->pats[id]->ref->gen_id == ctx->expr->ref->curr_gen)
+		ctx->best = id;
+	return ctx->best == 0;
+}
+
+/* Looks up the sample <smp> in the database of expression <expr>. Returns 0
+ * if the database cannot be used, otherwise non-zero with the first matching
+ * pattern or NULL in <ret>.
+ */
+static int pat_hs_match(struct sample *smp, struct pattern_expr *expr, struct pattern **ret)
+{
+	struct pat_hs_ctx ctx;
+	struct pattern *pattern;
+	hs_scratch_t *scratch;
+	struct pat_hs *hs;
+	hs_error_t err;
+	unsigned int i;
+
+	hs = pat_hs_get(expr);
+	if (!hs)
+		return 0;
+
+	ctx.hs   = hs;
+	ctx.expr = expr;
+	ctx.best = ~0U;
+
+	if (hs->db) {
+		scratch = pat_hs_get_scratch();
+		if (!scratch)
+			return 0;
+
+		err = hs_scan(hs->db, smp->data.u.str.area, smp->data.u.str.data, 0,
+		              scratch, pat_hs_on_match, &ctx);
+		if (err != HS_SUCCESS && err != HS_SCAN_TERMINATED)
+			return 0;
+	}
+
+	for (i = 0; i < hs->nb_slow && hs->slow[i] < ctx.best; i++) {
+		pattern = hs->pats[hs->slow[i]];
+
+		if (pattern->ref->gen_id != expr->ref->curr_gen)
+			continue;
+
+		if (regex_exec2(pattern->ptr.reg, smp->data.u.str.area, smp->data.u.str.data)) {
+			ctx.best = hs->slow[i];
+			break;
+		}
+	}
+
+	*ret = (ctx.best != ~0U) ? hs->pats[ctx.best] : NULL;
+	return 1;
+}
+
+static void pat_hs_free_per_thread()
+{
+	hs_free_scratch(pat_hs_scratch);
+	pat_hs_scratch = NULL;
+}
+
+static void pat_hs_deinit()
+{
+	hs_free_scratch(pat_hs_proto);
+	pat_hs_proto = NULL;
+}
+
+REGISTER_PER_THREAD_FREE(pat_hs_free_per_thread);
+REGISTER_POST_DEINIT(pat_hs_deinit);
+#endif /* USE_HYPERSCAN */
+
 /* Executes a regex. It temporarily changes the data to add a trailing zero,
  * and restores the previous character when leaving.
  */
@@ -603,17 +1050,13 @@ struct pattern *pat_match_reg(struct sample *smp, struct pattern_expr *expr, int
 	struct pattern *ret = NULL;
 	struct lru64 *lru = NULL;
 
-	if (pat_lru_tree) {
-		unsigned long long seed = pat_lru_seed ^ (long)expr;
-
-		lru = lru64_get(XXH3(smp->data.u.str.area, smp->data.u.str.data, seed),
-				pat_lru_tree, expr, expr->ref->revision);
-		if (lru && lru->domain) {
-			ret = lru->data;
-			return ret;
-		}
-	}
+	lru = pat_lru_get(smp, expr);
+	if (lru && lru->domain)
+		return lru->data;
 
+#ifdef USE_HYPERSCAN
+	if (!pat_hs_match(smp, expr, &ret))
+#endif
 	list_for_each_entry(lst, &expr->patterns, list) {
 		pattern = &lst->pat;
 
@@ -686,16 +1129,9 @@ struct pattern *pat_match_beg(struct sample *smp, struct pattern_expr *expr, int
 	}
 
 	/* look in the list */
-	if (pat_lru_tree) {
-		unsigned long long seed = pat_lru_seed ^ (long)expr;
-
-		lru = lru64_get(XXH3(smp->data.u.str.area, smp->data.u.str.data, seed),
-				pat_lru_tree, expr, expr->ref->revision);
-		if (lru && lru->domain) {
-			ret = lru->data;
-			return ret;
-		}
-	}
+	lru = pat_lru_get(smp, expr);
+	if (lru && lru->domain)
+		return lru->data;
 
 	list_for_each_entry(lst, &expr->patterns, list) {
 		pattern = &lst->pat;
@@ -721,24 +1157,328 @@ struct pattern *pat_match_beg(struct sample *smp, struct pattern_expr *expr, int
 	return ret;
 }
 
+/* Releases automaton <acm>. Nothing is done if it is NULL. */
+static void pat_acm_free(struct pat_acm *acm)
+{
+	if (!acm)
+		return;
+	free(acm->nodes);
+	free(acm->edges);
+	free(acm->pats);
+	free(acm);
+}
+
+/* returned by pat_ip4_build() when the tree is too small to need a table */
+static struct pat_ip4 pat_ip4_none;
+
+/* Releases IPv4 table <ip4>. Nothing is done if it is NULL. */
+static void pat_ip4_free(struct pat_ip4 *ip4)
+{
+	if (!ip4 || ip4 == &pat_ip4_none)
+		return;
+	free(ip4->tbl);
+	free(ip4->pats);
+	free(ip4->free_idx);
+	free(ip4);
+}
+
+/* Releases the automatons of expression <expr> after its list of patterns
+ * was modified. The expression must be write-locked, which guarantees that
+ * no lookup is using them.
+ */
+static void pat_acm_drop(struct pattern_expr *expr)
+{
+	int kind;
+
+	for (kind = 0; kind < PAT_ACM_KINDS; kind++) {
+		pat_acm_free(expr->acm[kind]);
+		expr->acm[kind] = NULL;
+	}
+#ifdef USE_HYPERSCAN
+	pat_hs_free(expr->hs);
+	expr->hs = NULL;
+#endif
+	pat_ip4_free(expr->ip4);
+	expr->ip4 = NULL;
+}
+
+/* Returns the node reached from node <node> of automaton <acm> with byte <c>,
+ * or 0 if there is none.
+ */
+static inline unsigned int pat_acm_next(const struct pat_acm *acm, unsigned int node, unsigned char c)
+{
+	const struct pat_acm_edge *edges = acm->edges;
+	unsigned int lo, hi;
+
+	if (!node)
+		return acm->root[c];
+
+	lo = acm->nodes[node].edge;
+	hi = lo + acm->nodes[node].nb_edges;
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (edges[mid].c < c)
+			lo = mid + 1;
+		else if (edges[mid].c > c)
+			hi = mid;
+		else
+			return edges[mid].node;
+	}
+	return 0;
+}
+
+/* Looks for the first pattern of the current generation ending on node <node>
+ * of automaton <acm> for expression <expr>. If its rank is lower than <*best>,
+ * it is stored into <*ret> and its rank into <*best>.
+ */
+static inline void pat_acm_check_node(const struct pat_acm *acm, const struct pattern_expr *expr,
+                                      unsigned int node, unsigned int *best, struct pattern **ret)
+{
+	const struct pat_acm_pat *p   = acm->pats + acm->nodes[node].pat;
+	const struct pat_acm_pat *end = p + acm->nodes[node].nb_pats;
+
+	for (; p < end && p->rank < *best; p++) {
+		if (p->pat->ref->gen_id != expr->ref->curr_gen)
+			continue;
+		*best = p->rank;
+		*ret = p->pat;
+		break;
+	}
+}
+
+/* Builds an automaton of kind <kind> from the patterns of expression <expr>,
+ * which must be at least read-locked. For PAT_ACM_SUB, this is an Aho-Corasick
+ * automaton, and for PAT_ACM_END, a trie of the reversed patterns. Returns
+ * NULL if memory is missing.
+ */
+static struct pat_acm *pat_acm_build(struct pattern_expr *expr, enum pat_acm_kind kind)
+{
+	struct tmp_node {
+		struct pat_acm_edge *edges;
+		unsigned int nb_edges;
+	} *tmp = NULL, *new_tmp;
+	int icase = expr->mflags & PAT_MF_IGNORE_CASE;
+	unsigned int nb_pats = 0, nb_nodes = 1, nb_edges = 0, alloc = 64;
+	unsigned int *term = NULL, *queue = NULL;
+	struct pattern_list *lst;
+	struct pat_acm *acm;
+	unsigned int i, j;
+
+	acm = calloc(1, sizeof(*acm));
+	if (!acm)
+		return NULL;
+
+	list_for_each_entry(lst, &expr->patterns, list)
+		nb_pats++;
+
+	acm->pats = calloc(nb_pats + 1, sizeof(*acm->pats));
+	term = calloc(nb_pats + 1, sizeof(*term));
+	tmp = calloc(alloc, sizeof(*tmp));
+	if (!acm->pats || !term || !tmp)
+		goto fail;
+
+	/* build the trie, remembering the node each pattern ends on */
+	nb_pats = 0;
+	list_for_each_entry(lst, &expr->patterns, list) {
+		const struct pattern *pat = &lst->pat;
+		unsigned int node = 0;
+
+		for (i = 0; i < pat->len; i++) {
+			unsigned char c = pat->ptr.str[kind == PAT_ACM_END ? pat->len - 1 - i : i];
+			struct tmp_node *n = &tmp[node];
+			unsigned int lo = 0, hi = n->nb_edges;
+			struct pat_acm_edge *edges;
+
+			if (icase)
+				c = tolower(c);
+
+			while (lo < hi) {
+				unsigned int mid = (lo + hi) / 2;
+
+				if (n->edges[mid].c < c)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+
+			if (lo < n->nb_edges && n->edges[lo].c == c) {
+				node = n->edges[lo].node;
+				continue;
+			}
+
+			/* the byte is unknown, insert a new node there */
+			if (nb_nodes == alloc) {
+				new_tmp = realloc(tmp, 2 * alloc * sizeof(*tmp));
+				if (!new_tmp)
+					goto fail;
+				memset(new_tmp + alloc, 0, alloc * sizeof(*tmp));
+				tmp = new_tmp;
+				alloc *= 2;
+				n = &tmp[node];
+			}
+
+			edges = realloc(n->edges, (n->nb_edges + 1) * sizeof(*edges));
+			if (!edges)
+				goto fail;
+			memmove(edges + lo + 1, edges + lo, (n->nb_edges - lo) * sizeof(*edges));
+			edges[lo].c = c;
+			edges[lo].node = nb_nodes;
+			n->edges = edges;
+			n->nb_edges++;
+			nb_edges++;
+			node = nb_nodes++;
+		}
+		acm->pats[nb_pats].pat = &lst->pat;
+		acm->pats[nb_pats].rank = nb_pats;
+		term[nb_pats++] = node;
+	}
+
+	acm->nodes = calloc(nb_nodes, sizeof(*acm->nodes));
+	acm->edges = calloc(nb_edges + 1, sizeof(*acm->edges));
+	queue = calloc(nb_nodes, sizeof(*queue));
+	if (!acm->nodes || !acm->edges || !queue)
+		goto fail;
+	acm->nb_nodes = nb_nodes;
+
+	/* flatten the edges */
+	for (i = j = 0; i < nb_nodes; i++) {
+		acm->nodes[i].edge = j;
+		acm->nodes[i].nb_edges = tmp[i].nb_edges;
+		if (tmp[i].nb_edges)
+			memcpy(acm->edges + j, tmp[i].edges, tmp[i].nb_edges * sizeof(*acm->edges));
+		j += tmp[i].nb_edges;
+	}
+
+	for (i = 0; i < acm->nodes[0].nb_edges; i++)
+		acm->root[acm->edges[i].c] = acm->edges[i].node;
+
+	/* group the patterns by node, keeping them in list order. The queue
+	 * is used to count them first.
+	 */
+	for (i = 0; i < nb_pats; i++)
+		queue[term[i]]++;
+
+	for (i = j = 0; i < nb_nodes; i++) {
+		acm->nodes[i].pat = j;
+		j += queue[i];
+		queue[i] = acm->nodes[i].pat;
+	}
+
+	{
+		struct pat_acm_pat *sorted = calloc(nb_pats + 1, sizeof(*sorted));
+
+		if (!sorted)
+			goto fail;
+		for (i = 0; i < nb_pats; i++) {
+			sorted[queue[term[i]]++] = acm->pats[i];
+			acm->nodes[term[i]].nb_pats++;
+		}
+		free(acm->pats);
+		acm->pats = sorted;
+	}
+
+	/* compute the failure and dictionary links in breadth-first order
+	 * so that shorter nodes are always complete first.
+	 */
+	if (kind == PAT_ACM_SUB) {
+		unsigned int head = 0, tail = 0;
+
+		for (i = 0; i < acm->nodes[0].nb_edges; i++)
+			queue[tail++] = acm->edges[i].node;
+
+		while (head < tail) {
+			unsigned int u = queue[head++];
+			const struct pat_acm_node *un = &acm->nodes[u];
+
+			for (i = un->edge; i < un->edge + un->nb_edges; i++) {
+				unsigned int v = acm->edges[i].node;
+				unsigned char c = acm->edges[i].c;
+				unsigned int f = un->fail, w;
+
+				while (!(w = pat_acm_next(acm, f, c)) && f)
+					f = acm->nodes[f].fail;
+
+				acm->nodes[v].fail = w;
+				acm->nodes[v].dict = acm->nodes[w].nb_pats ? w : acm->nodes[w].dict;
+				queue[tail++] = v;
+			}
+		}
+	}
+
+	for (i = 0; i < nb_nodes; i++)
+		free(tmp[i].edges);
+	free(tmp);
+	free(term);
+	free(queue);
+	return acm;
+
+ fail:
+	if (tmp) {
+		for (i = 0; i < nb_nodes; i++)
+			free(tmp[i].edges);
+	}
+	free(tmp);
+	free(term);
+	free(queue);
+	pat_acm_free(acm);
+	return NULL;
+}
+
+/* Returns the automaton of kind <kind> for expression <expr>, which must be
+ * at least read-locked, building it if needed. Writers drop the automatons
+ * when modifying the list of patterns, so readers may safely use them. Only
+ * one thread builds an automaton at a time, the other ones getting NULL, in
+ * which case they must walk the list of patterns instead.
+ */
+static struct pat_acm *pat_acm_get(struct pattern_expr *expr, enum pat_acm_kind kind)
+{
+	struct pat_acm *acm = HA_ATOMIC_LOAD(&expr->acm[kind]);
+
+	if (likely(acm) || HA_ATOMIC_XCHG(&expr->acm_busy, 1))
+		return acm;
+
+	/* it may have been built in the mean time */
+	acm = HA_ATOMIC_LOAD(&expr->acm[kind]);
+	if (!acm) {
+		acm = pat_acm_build(expr, kind);
+		HA_ATOMIC_STORE(&expr->acm[kind], acm);
+	}
+	HA_ATOMIC_STORE(&expr->acm_busy, 0);
+	return acm;
+}
+
 /* Checks that the pattern matches the end of the tested string. */
 struct pattern *pat_match_end(struct sample *smp, struct pattern_expr *expr, int fill)
 {
 	int icase;
+	struct pat_acm *acm;
 	struct pattern_list *lst;
 	struct pattern *pattern;
 	struct pattern *ret = NULL;
 	struct lru64 *lru = NULL;
 
-	if (pat_lru_tree) {
-		unsigned long long seed = pat_lru_seed ^ (long)expr;
+	lru = pat_lru_get(smp, expr);
+	if (lru && lru->domain)
+		return lru->data;
+
+	icase = expr->mflags & PAT_MF_IGNORE_CASE;
+	acm = pat_acm_get(expr, PAT_ACM_END);
+	if (acm) {
+		unsigned int best = ~0U, node = 0;
+		size_t len = smp->data.u.str.data;
+
+		/* walk the reversed trie from the end of the string */
+		pat_acm_check_node(acm, expr, 0, &best, &ret);
+		while (len && best) {
+			unsigned char c = smp->data.u.str.area[--len];
 
-		lru = lru64_get(XXH3(smp->data.u.str.area, smp->data.u.str.data, seed),
-				pat_lru_tree, expr, expr->ref->revision);
-		if (lru && lru->domain) {
-			ret = lru->data;
-			return ret;
+			node = pat_acm_next(acm, node, icase ? tolower(c) : c);
+			if (!node)
+				break;
+			pat_acm_check_node(acm, expr, node, &best, &ret);
 		}
+		goto leave;
 	}
 
 	list_for_each_entry(lst, &expr->patterns, list) {
@@ -750,7 +1490,6 @@ struct pattern *pat_match_end(struct sample *smp, struct pattern_expr *expr, int
 		if (pattern->len > smp->data.u.str.data)
 			continue;
 
-		icase = expr->mflags & PAT_MF_IGNORE_CASE;
 		if ((icase && strncasecmp(pattern->ptr.str, smp->data.u.str.area + smp->data.u.str.data - pattern->len, pattern->len) != 0) ||
 		    (!icase && strncmp(pattern->ptr.str, smp->data.u.str.area + smp->data.u.str.data - pattern->len, pattern->len) != 0))
 			continue;
@@ -759,34 +1498,51 @@ struct pattern *pat_match_end(struct sample *smp, struct pattern_expr *expr, int
 		break;
 	}
 
+ leave:
 	if (lru)
 		lru64_commit(lru, ret, expr, expr->ref->revision, NULL);
 
 	return ret;
 }
 
-/* Checks that the pattern is included inside the tested string.
- * NB: Suboptimal, should be rewritten using a Boyer-Moore method.
+/* Checks that the pattern is included inside the tested string. An
+ * Aho-Corasick automaton is used when available, reporting the same pattern
+ * as the list walk, which is the first matching one in the list.
  */
 struct pattern *pat_match_sub(struct sample *smp, struct pattern_expr *expr, int fill)
 {
 	int icase;
 	char *end;
 	char *c;
+	struct pat_acm *acm;
 	struct pattern_list *lst;
 	struct pattern *pattern;
 	struct pattern *ret = NULL;
 	struct lru64 *lru = NULL;
 
-	if (pat_lru_tree) {
-		unsigned long long seed = pat_lru_seed ^ (long)expr;
+	lru = pat_lru_get(smp, expr);
+	if (lru && lru->domain)
+		return lru->data;
+
+	icase = expr->mflags & PAT_MF_IGNORE_CASE;
+	acm = pat_acm_get(expr, PAT_ACM_SUB);
+	if (acm) {
+		unsigned int best = ~0U, node = 0, next, n;
 
-		lru = lru64_get(XXH3(smp->data.u.str.area, smp->data.u.str.data, seed),
-				pat_lru_tree, expr, expr->ref->revision);
-		if (lru && lru->domain) {
-			ret = lru->data;
-			return ret;
+		/* a pattern of lower rank may still be found until the end */
+		pat_acm_check_node(acm, expr, 0, &best, &ret);
+		end = smp->data.u.str.area + smp->data.u.str.data;
+		for (c = smp->data.u.str.area; c < end && best; c++) {
+			unsigned char ch = icase ? tolower((unsigned char)*c) : (unsigned char)*c;
+
+			while (!(next = pat_acm_next(acm, node, ch)) && node)
+				node = acm->nodes[node].fail;
+			node = next;
+
+			for (n = node; n; n = acm->nodes[n].dict)
+				pat_acm_check_node(acm, expr, n, &best, &ret);
 		}
+		goto leave;
 	}
 
 	list_for_each_entry(lst, &expr->patterns, list) {
@@ -799,7 +1555,6 @@ struct pattern *pat_match_sub(struct sample *smp, struct pattern_expr *expr, int
 			continue;
 
 		end = smp->data.u.str.area + smp->data.u.str.data - pattern->len;
-		icase = expr->mflags & PAT_MF_IGNORE_CASE;
 		if (icase) {
 			for (c = smp->data.u.str.area; c <= end; c++) {
 				if (tolower((unsigned char)*c) != tolower((unsigned char)*pattern->ptr.str))
@@ -962,6 +1717,324 @@ struct pattern *pat_match_len(struct sample *smp, struct pattern_expr *expr, int
 	return NULL;
 }
 
+/* The IPv4 nodes of the tree are allocated with 4 extra bytes after their key,
+ * holding their index in the table's <pats> when the expression has a table.
+ */
+static inline uint32_t pat_ip4_idx(const struct pattern_tree *elt)
+{
+	return read_u32(elt->node.key + 4);
+}
+
+static inline void pat_ip4_set_idx(struct pattern_tree *elt, uint32_t idx)
+{
+	write_u32(elt->node.key + 4, idx);
+}
+
+/* Returns the offset of the chunk designated by entry <slot> of table <ip4>,
+ * creating it if needed with all of its entries set to the slot's former
+ * value. Returns 0 on memory allocation failure.
+ */
+static uint32_t pat_ip4_chunk(struct pat_ip4 *ip4, uint32_t slot)
+{
+	uint32_t *tbl, val = ip4->tbl[slot];
+	uint32_t ofs;
+	int i;
+
+	if (val & PAT_IP4_CHUNK)
+		return val & ~PAT_IP4_CHUNK;
+
+	if (ip4->nb_ent + 256 > ip4->ent_alloc) {
+		if (ip4->ent_alloc >= PAT_IP4_CHUNK / 2)
+			return 0;
+		tbl = realloc(ip4->tbl, ip4->ent_alloc * 2 * sizeof(*tbl));
+		if (!tbl)
+			return 0;
+		ip4->tbl = tbl;
+		ip4->ent_alloc *= 2;
+	}
+
+	ofs = ip4->nb_ent;
+	ip4->nb_ent += 256;
+	for (i = 0; i < 256; i++)
+		ip4->tbl[ofs + i] = val;
+	ip4->tbl[slot] = PAT_IP4_CHUNK | ofs;
+	return ofs;
+}
+
+/* Sets <first> and <last> to the entries of table <ip4> at the level of the
+ * network of tree node <elt>, creating the chunks leading there if needed.
+ * Returns 0 on memory allocation failure.
+ */
+static int pat_ip4_range(struct pat_ip4 *ip4, const struct pattern_tree *elt,
+                         uint32_t *first, uint32_t *last)
+{
+	unsigned int pfx = elt->node.node.pfx;
+	uint32_t addr = ntohl(read_u32(elt->node.key));
+	uint32_t ofs;
+
+	addr &= pfx ? ~0U << (32 - pfx) : 0;
+	if (pfx <= 16) {
+		*first = addr >> 16;
+		*last  = *first + (1U << (16 - pfx)) - 1;
+		return 1;
+	}
+
+	ofs = pat_ip4_chunk(ip4, addr >> 16);
+	if (!ofs)
+		return 0;
+
+	if (pfx <= 24) {
+		*first = ofs + ((addr >> 8) & 0xff);
+		*last  = *first + (1U << (24 - pfx)) - 1;
+		return 1;
+	}
+
+	ofs = pat_ip4_chunk(ip4, ofs + ((addr >> 8) & 0xff));
+	if (!ofs)
+		return 0;
+
+	*first = ofs + (addr & 0xff);
+	*last  = *first + (1U << (32 - pfx)) - 1;
+	return 1;
+}
+
+/* Sets to <to> the entries <first> to <last> of table <ip4>, as well as all
+ * those of the chunks they lead to, which designate <from>. If <from> is 0,
+ * the entries designating no network or a network shorter than <pfx> are
+ * set instead, since a longer network is more specific and an identical one
+ * comes first in the tree.
+ */
+static void pat_ip4_replace(struct pat_ip4 *ip4, uint32_t first, uint32_t last,
+                            uint32_t from, uint32_t to, unsigned int pfx)
+{
+	uint32_t v;
+
+	for (; first <= last; first++) {
+		v = ip4->tbl[first];
+		if (v & PAT_IP4_CHUNK) {
+			v &= ~PAT_IP4_CHUNK;
+			pat_ip4_replace(ip4, v, v + 255, from, to, pfx);
+		}
+		else if (from ? v == from : !v || ip4->pats[v - 1]->node.node.pfx < pfx)
+			ip4->tbl[first] = to;
+	}
+}
+
+/* a network of the tree and its index in the table's <pats> */
+struct pat_ip4_net {
+	const struct pattern_tree *elt;
+	uint32_t idx;
+};
+
+/* used to sort the networks by increasing prefix length, so that longer ones
+ * overwrite the shorter ones they are part of when filling the table. Among
+ * identical networks, the first one in the tree must win, so it comes last.
+ */
+static int pat_ip4_cmp(const void *a, const void *b)
+{
+	const struct pat_ip4_net *na = a;
+	const struct pat_ip4_net *nb = b;
+
+	if (na->elt->node.node.pfx != nb->elt->node.node.pfx)
+		return na->elt->node.node.pfx < nb->elt->node.node.pfx ? -1 : 1;
+	return (na->idx < nb->idx) - (na->idx > nb->idx);
+}
+
+/* Builds the IPv4 table of expression <expr> from its IPv4 tree, which must be
+ * at least read-locked. Returns &pat_ip4_none if the tree is too small to need
+ * one, or NULL on memory allocation failure.
+ */
+static struct pat_ip4 *pat_ip4_build(struct pattern_expr *expr)
+{
+	struct pat_ip4_net *sorted = NULL;
+	struct ebmb_node *node;
+	struct pat_ip4 *ip4;
+	uint32_t first, last;
+	unsigned int nb = 0;
+	unsigned int i;
+
+	for (node = ebmb_first(&expr->pattern_tree); node; node = ebmb_next(node))
+		nb++;
+
+	if (nb < PAT_IP4_TAB_MIN)
+		return &pat_ip4_none;
+
+	ip4 = calloc(1, sizeof(*ip4));
+	if (!ip4)
+		return NULL;
+
+	ip4->pats_alloc = nb + nb / 4;
+	ip4->ent_alloc = 65536 + 64 * 256;
+	ip4->pats = calloc(ip4->pats_alloc, sizeof(*ip4->pats));
+	ip4->free_idx = calloc(ip4->pats_alloc, sizeof(*ip4->free_idx));
+	ip4->tbl = calloc(ip4->ent_alloc, sizeof(*ip4->tbl));
+	sorted = calloc(nb, sizeof(*sorted));
+	if (!ip4->pats || !ip4->free_idx || !ip4->tbl || !sorted)
+		goto fail;
+
+	/* the networks keep their position in the tree as index, which is
+	 * also the order in which the tree returns duplicates.
+	 */
+	ip4->nb_ent = 65536;
+	for (node = ebmb_first(&expr->pattern_tree); node; node = ebmb_next(node)) {
+		ip4->pats[ip4->nb_pats] = ebmb_entry(node, struct pattern_tree, node);
+		pat_ip4_set_idx(ip4->pats[ip4->nb_pats], ip4->nb_pats);
+		sorted[ip4->nb_pats].elt = ip4->pats[ip4->nb_pats];
+		sorted[ip4->nb_pats].idx = ip4->nb_pats;
+		ip4->nb_pats++;
+	}
+	qsort(sorted, nb, sizeof(*sorted), pat_ip4_cmp);
+
+	for (i = 0; i < nb; i++) {
+		if (!pat_ip4_range(ip4, sorted[i].elt, &first, &last))
+			goto fail;
+		for (; first <= last; first++)
+			ip4->tbl[first] = sorted[i].idx + 1;
+	}
+	free(sorted);
+	return ip4;
+
+ fail:
+	free(sorted);
+	pat_ip4_free(ip4);
+	return NULL;
+}
+
+/* Drops the IPv4 table of expression <expr>, which must be write-locked,
+ * after it failed to be updated. It will be built again by the next lookup.
+ */
+static void pat_ip4_drop(struct pattern_expr *expr)
+{
+	pat_ip4_free(expr->ip4);
+	HA_ATOMIC_STORE(&expr->ip4, NULL);
+}
+
+/* Adds IPv4 tree node <elt>, just inserted into expression <expr>, to the
+ * expression's table if it has one. Only the entries covered by the new
+ * network are updated, so that loading large datasets at run time does not
+ * require to rebuild the table. The expression must be write-locked.
+ */
+static void pat_ip4_insert(struct pattern_expr *expr, struct pattern_tree *elt)
+{
+	struct pat_ip4 *ip4 = expr->ip4;
+	struct pattern_tree **pats;
+	uint32_t *free_idx;
+	uint32_t idx, first, last;
+
+	if (!ip4)
+		return;
+
+	if (ip4 == &pat_ip4_none) {
+		/* the tree may have grown enough */
+		HA_ATOMIC_STORE(&expr->ip4, NULL);
+		return;
+	}
+
+	if (ip4->nb_free)
+		idx = ip4->free_idx[--ip4->nb_free];
+	else {
+		if (ip4->nb_pats == ip4->pats_alloc) {
+			pats = realloc(ip4->pats, ip4->pats_alloc * 2 * sizeof(*pats));
+			if (!pats)
+				goto fail;
+			ip4->pats = pats;
+
+			free_idx = realloc(ip4->free_idx, ip4->pats_alloc * 2 * sizeof(*free_idx));
+			if (!free_idx)
+				goto fail;
+			ip4->free_idx = free_idx;
+			ip4->pats_alloc *= 2;
+		}
+		idx = ip4->nb_pats++;
+	}
+
+	ip4->pats[idx] = elt;
+	pat_ip4_set_idx(elt, idx);
+	if (!pat_ip4_range(ip4, elt, &first, &last))
+		goto fail;
+	pat_ip4_replace(ip4, first, last, 0, idx + 1, elt->node.node.pfx);
+	return;
+
+ fail:
+	pat_ip4_drop(expr);
+}
+
+/* Removes IPv4 tree node <elt>, just deleted from the tree of expression
+ * <expr>, from the expression's table if it is part of it. The entries which
+ * designated it now designate the longest remaining network containing it.
+ * The expression must be write-locked.
+ */
+static void pat_ip4_delete(struct pattern_expr *expr, struct pattern_tree *elt)
+{
+	struct pat_ip4 *ip4 = expr->ip4;
+	struct ebmb_node *node;
+	uint32_t idx, first, last, repl = 0;
+
+	if (!ip4 || ip4 == &pat_ip4_none || elt->node.node.pfx > 32)
+		return;
+
+	idx = pat_ip4_idx(elt);
+	if (idx >= ip4->nb_pats || ip4->pats[idx] != elt)
+		return;
+
+	node = ebmb_lookup_longest(&expr->pattern_tree, elt->node.key);
+	while (node && node->node.pfx > elt->node.node.pfx)
+		node = ebmb_lookup_shorter(node);
+	if (node)
+		repl = pat_ip4_idx(ebmb_entry(node, struct pattern_tree, node)) + 1;
+
+	if (!pat_ip4_range(ip4, elt, &first, &last)) {
+		pat_ip4_drop(expr);
+		return;
+	}
+	pat_ip4_replace(ip4, first, last, idx + 1, repl, 0);
+	ip4->pats[idx] = NULL;
+	ip4->free_idx[ip4->nb_free++] = idx;
+}
+
+/* Returns the IPv4 table of expression <expr>, which must be at least
+ * read-locked, building it if needed, exactly like pat_acm_get(). NULL is
+ * returned when there is none, in which case the tree must be used.
+ */
+static struct pat_ip4 *pat_ip4_get(struct pattern_expr *expr)
+{
+	struct pat_ip4 *ip4 = HA_ATOMIC_LOAD(&expr->ip4);
+
+	if (likely(ip4) || eb_is_empty(&expr->pattern_tree) || HA_ATOMIC_XCHG(&expr->acm_busy, 1))
+		return ip4 == &pat_ip4_none ? NULL : ip4;
+
+	/* it may have been built in the mean time */
+	ip4 = HA_ATOMIC_LOAD(&expr->ip4);
+	if (!ip4) {
+		ip4 = pat_ip4_build(expr);
+		HA_ATOMIC_STORE(&expr->ip4, ip4);
+	}
+	HA_ATOMIC_STORE(&expr->acm_busy, 0);
+	return ip4 == &pat_ip4_none ? NULL : ip4;
+}
+
+/* Same as ebmb_lookup_longest() on the IPv4 tree of expression <expr> for
+ * address <addr> (network byte order), but using the expression's table when
+ * it has one. The node returned is always part of the tree.
+ */
+static inline struct ebmb_node *pat_ip4_lookup_longest(struct pattern_expr *expr, const void *addr)
+{
+	struct pat_ip4 *ip4 = pat_ip4_get(expr);
+	uint32_t a, v;
+
+	if (!ip4)
+		return ebmb_lookup_longest(&expr->pattern_tree, addr);
+
+	a = ntohl(read_u32(addr));
+	v = ip4->tbl[a >> 16];
+	if (v & PAT_IP4_CHUNK) {
+		v = ip4->tbl[(v & ~PAT_IP4_CHUNK) + ((a >> 8) & 0xff)];
+		if (v & PAT_IP4_CHUNK)
+			v = ip4->tbl[(v & ~PAT_IP4_CHUNK) + (a & 0xff)];
+	}
+	return v ? &ip4->pats[v - 1]->node : NULL;
+}
+
 struct pattern *pat_match_ip(struct sample *smp, struct pattern_expr *expr, int fill)
 {
 	unsigned int v4; /* in network byte order */
@@ -978,7 +2051,7 @@ struct pattern *pat_match_ip(struct sample *smp, struct pattern_expr *expr, int
 		 * the longest match method.
 		 */
 		s = &smp->data.u.ipv4;
-		node = ebmb_lookup_longest(&expr->pattern_tree, &s->s_addr);
+		node = pat_ip4_lookup_longest(expr, &s->s_addr);
 		while (node) {
 			elt = ebmb_entry(node, struct pattern_tree, node);
 			if (elt->ref->gen_id != expr->ref->curr_gen) {
@@ -1065,7 +2138,7 @@ struct pattern *pat_match_ip(struct sample *smp, struct pattern_expr *expr, int
 			/* Lookup an IPv4 address in the expression's pattern tree using the longest
 			 * match method.
 			 */
-			node = ebmb_lookup_longest(&expr->pattern_tree, &v4);
+			node = pat_ip4_lookup_longest(expr, &v4);
 			while (node) {
 				elt = ebmb_entry(node, struct pattern_tree, node);
 				if (elt->ref->gen_id != expr->ref->curr_gen) {
@@ -1176,6 +2249,7 @@ void pat_prune_gen(struct pattern_expr *expr)
 	free_pattern_tree(&expr->pattern_tree);
 	free_pattern_tree(&expr->pattern_tree_2);
 	LIST_INIT(&expr->patterns);
+	pat_acm_drop(expr);
 	expr->ref->revision = rdtsc();
 	expr->ref->entry_cnt = 0;
 }
@@ -1267,8 +2341,11 @@ int pat_idx_list_str(struct pattern_expr *expr, struct pattern *pat, char **err)
 	memcpy(patl->pat.ptr.ptr, pat->ptr.ptr, pat->len);
 	patl->pat.ptr.str[patl->pat.len] = '\0';
 
-	/* chain pattern in the expression */
+	/* chain pattern in the expression, its automatons are rebuilt upon
+	 * next lookup.
+	 */
 	LIST_APPEND(&expr->patterns, &patl->list);
+	pat_acm_drop(expr);
 	/* and from the reference */
 	patl->from_ref = pat->ref->list_head;
 	pat->ref->list_head = &patl->from_ref;
@@ -1303,6 +2380,7 @@ int pat_idx_list_reg_cap(struct pattern_expr *expr, struct pattern *pat, int cap
 
 	/* chain pattern in the expression */
 	LIST_APPEND(&expr->patterns, &patl->list);
+	pat_acm_drop(expr);
 	/* and from the reference */
 	patl->from_ref = pat->ref->list_head;
 	pat->ref->list_head = &patl->from_ref;
@@ -1339,8 +2417,8 @@ int pat_idx_tree_ip(struct pattern_expr *expr, struct pattern *pat, char **err)
 		if (mask + (mask & -mask) == 0) {
 			mask = mask ? 33 - flsnz(mask & -mask) : 0; /* equals cidr value */
 
-			/* node memory allocation */
-			node = calloc(1, sizeof(*node) + 4);
+			/* node memory allocation, see pat_ip4_idx() */
+			node = calloc(1, sizeof(*node) + 8);
 			if (!node) {
 				memprintf(err, "out of memory while loading pattern");
 				return 0;
@@ -1358,6 +2436,7 @@ int pat_idx_tree_ip(struct pattern_expr *expr, struct pattern *pat, char **err)
 			ebmb_insert_prefix(&expr->pattern_tree, &node->node, 4);
 			node->from_ref = pat->ref->tree_head;
 			pat->ref->tree_head = &node->from_ref;
+			pat_ip4_insert(expr, node);
 			expr->ref->revision = rdtsc();
 			expr->ref->entry_cnt++;
 
@@ -1493,6 +2572,7 @@ int pat_idx_tree_pfx(struct pattern_expr *expr, struct pattern *pat, char **err)
  */
 void pat_delete_gen(struct pat_ref *ref, struct pat_ref_elt *elt)
 {
+	struct pattern_expr *expr;
 	struct pattern_tree *tree;
 	struct pattern_list *pat;
 	void **node;
@@ -1504,6 +2584,8 @@ void pat_delete_gen(struct pat_ref *ref, struct pat_ref_elt *elt)
 		BUG_ON(tree->ref != elt);
 
 		ebmb_delete(&tree->node);
+		list_for_each_entry(expr, &ref->pat, list)
+			pat_ip4_delete(expr, tree);
 		free(tree->data);
 		free(tree);
 	}
@@ -1524,6 +2606,12 @@ void pat_delete_gen(struct pat_ref *ref, struct pat_ref_elt *elt)
 		free(pat);
 	}
 
+	/* the automatons may reference the deleted patterns */
+	if (elt->list_head) {
+		list_for_each_entry(expr, &ref->pat, list)
+			pat_acm_drop(expr);
+	}
+
 	/* update revision number to refresh the cache */
 	ref->revision = rdtsc();
 	ref->entry_cnt--;
@@ -1686,53 +2774,85 @@ struct pat_ref_elt *pat_ref_find_elt(struct pat_ref *ref, const char *key)
 
 /* This function modifies the sample of pat_ref_elt <elt> in all expressions
  * found under <ref> to become <value>. It is assumed that the caller has
- * already verified that <elt> belongs to <ref>.
+ * already verified that <elt> belongs to <ref>, and holds the reference's
+ * lock. The expressions are not locked: the new values are all prepared
+ * first, then each one is atomically published in place of the old one, and
+ * the old ones are retired until no lookup may be using them anymore.
  */
 static inline int pat_ref_set_elt(struct pat_ref *ref, struct pat_ref_elt *elt,
                                   const char *value, char **err)
 {
 	struct pattern_expr *expr;
 	struct sample_data **data;
+	struct sample_data *old;
+	struct pat_retired *first = NULL, *last = NULL, *ret;
 	char *sample;
-	struct sample_data test;
 
-	/* Try all needed converters. */
+	sample = strdup(value);
+	if (!sample)
+		goto oom;
+
+	/* Parse the value for all expressions first, the retired entries
+	 * carry the new values until they are published.
+	 */
 	list_for_each_entry(expr, &ref->pat, list) {
 		if (!expr->pat_head->parse_smp)
 			continue;
 
-		if (!expr->pat_head->parse_smp(value, &test)) {
+		ret = calloc(1, sizeof(*ret));
+		if (!ret)
+			goto oom;
+		ret->ptr = malloc(sizeof(struct sample_data));
+		if (last)
+			last->next = ret;
+		else
+			first = ret;
+		last = ret;
+		if (!ret->ptr)
+			goto oom;
+
+		if (!expr->pat_head->parse_smp(sample, ret->ptr)) {
 			memprintf(err, "unable to parse '%s'", value);
-			return 0;
+			goto fail;
 		}
 	}
 
-	/* Modify pattern from reference. */
-	sample = strdup(value);
-	if (!sample) {
-		memprintf(err, "out of memory error");
-		return 0;
-	}
-	/* Load sample in each reference. All the conversions are tested
-	 * below, normally these calls don't fail.
-	 */
+	/* one more for the old sample */
+	ret = calloc(1, sizeof(*ret));
+	if (!ret)
+		goto oom;
+	if (last)
+		last->next = ret;
+	else
+		first = ret;
+	last = ret;
+
+	/* Publish the new values, nothing may fail anymore */
+	ret = first;
 	list_for_each_entry(expr, &ref->pat, list) {
 		if (!expr->pat_head->parse_smp)
 			continue;
 
-		HA_RWLOCK_WRLOCK(PATEXP_LOCK, &expr->lock);
 		data = pattern_find_smp(expr, elt);
-		if (data && *data && !expr->pat_head->parse_smp(sample, *data))
-			*data = NULL;
-		HA_RWLOCK_WRUNLOCK(PATEXP_LOCK, &expr->lock);
+		if (data && *data) {
+			old = *data;
+			HA_ATOMIC_STORE(data, (struct sample_data *)ret->ptr);
+			ret->ptr = old;
+		}
+		ret = ret->next;
 	}
 
-	/* free old sample only when all exprs are updated */
-	free(elt->sample);
-	elt->sample = sample;
-
-
+	ret->ptr = elt->sample;
+	HA_ATOMIC_STORE(&elt->sample, sample);
+	pat_retire(first, last);
 	return 1;
+
+ oom:
+	memprintf(err, "out of memory error");
+ fail:
+	pat_retired_free(first);
+	free(sample);
+	return 0;
 }
 
 /* This function modifies the sample of pat_ref_elt <refelt> in all expressions
@@ -1830,6 +2950,7 @@ struct pat_ref *pat_ref_new(const char *reference, const char *display, unsigned
 	ref->unique_id = -1;
 	ref->revision = 0;
 	ref->entry_cnt = 0;
+	ref->cache_size = -1;
 
 	LIST_INIT(&ref->head);
 	LIST_INIT(&ref->pat);
@@ -1867,6 +2988,7 @@ struct pat_ref *pat_ref_newid(int unique_id, const char *display, unsigned int f
 	ref->curr_gen = 0;
 	ref->next_gen = 0;
 	ref->unique_id = unique_id;
+	ref->cache_size = -1;
 	LIST_INIT(&ref->head);
 	LIST_INIT(&ref->pat);
 	HA_SPIN_INIT(&ref->lock);
@@ -1962,6 +3084,8 @@ int pat_ref_push(struct pat_ref_elt *elt, struct pattern_expr *expr,
 	}
 	HA_RWLOCK_WRUNLOCK(PATEXP_LOCK, &expr->lock);
 
+	if (expr->ref->flags & PAT_REF_WATCH)
+		HA_ATOMIC_INC(&pat_ref_watch_gen);
 	return 1;
 }
 
@@ -2378,8 +3502,11 @@ int pattern_read_from_file(struct pattern_head *head, unsigned int refflags,
 	struct pat_ref *ref;
 	struct pattern_expr *expr;
 	struct pat_ref_elt *elt;
+	struct startup_prof prof;
 	int reuse = 0;
 
+	startup_prof_start(&prof);
+
 	/* Lookup for the existing reference. */
 	ref = pat_ref_lookup(filename);
 
@@ -2395,7 +3522,19 @@ int pattern_read_from_file(struct pattern_head *head, unsigned int refflags,
 			return 0;
 		}
 
-		if (load_smp) {
+		if (patmap_is_compiled(filename)) {
+			/* compiled maps are never loaded, only mapped */
+			if (!load_smp) {
+				memprintf(err, "compiled map <%s> may only be used by map converters", filename);
+				return 0;
+			}
+			ref->flags |= PAT_REF_SMP;
+			ref->mmap = patmap_open(filename, err);
+			if (!ref->mmap)
+				return 0;
+			ref->entry_cnt = ref->mmap->count;
+		}
+		else if (load_smp) {
 			ref->flags |= PAT_REF_SMP;
 			if (!pat_ref_read_from_file_smp(ref, filename, err))
 				return 0;
@@ -2446,6 +3585,25 @@ int pattern_read_from_file(struct pattern_head *head, unsigned int refflags,
 		ref->flags |= refflags;
 	}
 
+	/* Compiled maps are directly looked up by pattern_exec_match(), which
+	 * only knows how to perform exact and prefix matches on strings, and
+	 * IP matches on IPv4 ranges.
+	 */
+	if (ref->mmap) {
+		if (ref->mmap->type == PATMAP_T_STR &&
+		    ((head->match != pat_match_str && head->match != pat_match_beg) ||
+		     (patflags & PAT_MF_IGNORE_CASE))) {
+			memprintf(err, "compiled map <%s> of type '%s' only supports case-sensitive 'str' and 'beg' matches",
+			          filename, patmap_type_name(ref->mmap->type));
+			return 0;
+		}
+		if (ref->mmap->type == PATMAP_T_IPV4 && head->match != pat_match_ip) {
+			memprintf(err, "compiled map <%s> of type '%s' only supports 'ip' matches",
+			          filename, patmap_type_name(ref->mmap->type));
+			return 0;
+		}
+	}
+
 	/* Now, we can loading patterns from the reference. */
 
 	/* Lookup for existing reference in the head. If the reference
@@ -2476,6 +3634,101 @@ int pattern_read_from_file(struct pattern_head *head, unsigned int refflags,
 		}
 	}
 
+	startup_prof_report(&prof, 0, "%s file '%s' used at [%s:%d]",
+	                    refflags & PAT_REF_MAP ? "map" : "acl", filename, file, line);
+	return 1;
+}
+
+/* This function looks up sample <smp>, already converted to the type expected
+ * by <head>, in the compiled map of reference <ref>. No lock is needed since
+ * a replaced map is only released once all threads were met in isolation. If
+ * <fill> is set, the returned static pattern describes the matching entry:
+ * for a string map, <type> is SMP_T_STR and the key is in <ptr.str> and
+ * <len>; for an IPv4 map, <type> is SMP_T_IPV4 and the matching range is in
+ * <val.range> (host byte order). Its data are the entry's value parsed by the
+ * head's parse_smp() function. A value which cannot be parsed
+ * is reported as a mismatch. Returns NULL if the sample doesn't match.
+ */
+struct pattern *pat_ref_match_mmap(struct pat_ref *ref, struct pattern_head *head,
+                                   struct sample *smp, int fill)
+{
+	const struct patmap *map = HA_ATOMIC_LOAD(&ref->mmap);
+	uint64_t idx = PATMAP_NONE;
+
+	if (map->type == PATMAP_T_STR) {
+		if (head->match == pat_match_str)
+			idx = patmap_lookup_str(map, smp->data.u.str.area, smp->data.u.str.data);
+		else if (head->match == pat_match_beg)
+			idx = patmap_lookup_beg(map, smp->data.u.str.area, smp->data.u.str.data);
+	}
+	else if (map->type == PATMAP_T_IPV4) {
+		if (smp->data.type == SMP_T_IPV4)
+			idx = patmap_lookup_ip4(map, ntohl(smp->data.u.ipv4.s_addr));
+		else if (smp->data.type == SMP_T_IPV6 &&
+		         IN6_IS_ADDR_V4MAPPED(&smp->data.u.ipv6))
+			idx = patmap_lookup_ip4(map, read_n32(&smp->data.u.ipv6.s6_addr[12]));
+	}
+
+	if (idx == PATMAP_NONE)
+		return NULL;
+
+	if (!fill)
+		return &static_pattern;
+
+	memset(&static_pattern, 0, sizeof(static_pattern));
+	if (map->type == PATMAP_T_STR) {
+		const struct patmap_str *ent = (const struct patmap_str *)map->ent + idx;
+
+		static_pattern.type = SMP_T_STR;
+		static_pattern.ptr.str = (char *)map->str + ent->key_ofs;
+		static_pattern.len = ent->key_len;
+	}
+	else {
+		const struct patmap_ip4 *ent = (const struct patmap_ip4 *)map->ent + idx;
+
+		static_pattern.type = SMP_T_IPV4;
+		static_pattern.val.range.min = ent->from;
+		static_pattern.val.range.max = ent->to;
+	}
+
+	if (head->parse_smp) {
+		if (!head->parse_smp(patmap_value(map, idx), &static_sample_data))
+			return NULL;
+		static_pattern.data = &static_sample_data;
+	}
+	return &static_pattern;
+}
+
+/* Replaces the compiled map of reference <ref> with the current contents of
+ * its file, which must still be a compiled map of the same type. Lookups
+ * running on other threads may still use the previous map until they see
+ * the new pointer, so the previous map is only released after all threads
+ * were met in isolation. Returns non-zero on success, otherwise zero with an
+ * error message in <err>.
+ */
+int pat_ref_reload_mmap(struct pat_ref *ref, char **err)
+{
+	struct patmap *map, *old;
+
+	map = patmap_open(ref->reference, err);
+	if (!map)
+		return 0;
+
+	if (map->type != ref->mmap->type) {
+		memprintf(err, "compiled map <%s> changed from type '%s' to '%s'",
+		          ref->reference, patmap_type_name(ref->mmap->type),
+		          patmap_type_name(map->type));
+		patmap_close(map);
+		return 0;
+	}
+
+	old = HA_ATOMIC_XCHG(&ref->mmap, map);
+	HA_ATOMIC_STORE(&ref->entry_cnt, map->count);
+	HA_ATOMIC_INC(&ref->revision);
+
+	thread_isolate();
+	thread_release();
+	patmap_close(old);
 	return 1;
 }
 
@@ -2506,6 +3759,13 @@ struct pattern *pattern_exec_match(struct pattern_head *head, struct sample *smp
 		return NULL;
 
 	list_for_each_entry(list, &head->head, list) {
+		if (list->expr->ref && list->expr->ref->mmap) {
+			pat = pat_ref_match_mmap(list->expr->ref, head, smp, fill);
+			if (pat)
+				return pat;
+			continue;
+		}
+
 		HA_RWLOCK_RDLOCK(PATEXP_LOCK, &list->expr->lock);
 		pat = head->match(smp, list->expr, fill);
 		if (pat) {
@@ -2570,30 +3830,49 @@ void pattern_prune(struct pattern_head *head)
 	}
 }
 
+/* Returns the root of the tree holding attached node <node>. */
+static struct eb_root *pat_tree_root(struct ebmb_node *node)
+{
+	eb_troot_t *t = node->node.leaf_p;
+	struct eb_root *root;
+
+	while (1) {
+		root = eb_clrtag(t);
+		/* only a tree's root has no right branch */
+		if (!eb_clrtag(root->b[EB_RGHT]))
+			return root;
+		t = eb_root_to_node(root)->node_p;
+	}
+}
+
 /* This function searches occurrences of pattern reference element <ref> in
  * expression <expr> and returns a pointer to a pointer of the sample storage.
- * If <ref> is not found, NULL is returned.
+ * If <ref> is not found, NULL is returned. Tree nodes derived from <ref> are
+ * attributed to their expression by walking up to their tree's root, and list
+ * entries are only searched for in the expression's list when the reference
+ * feeds multiple expressions. The caller must hold the reference's lock.
  */
 struct sample_data **pattern_find_smp(struct pattern_expr *expr, struct pat_ref_elt *ref)
 {
-	struct ebmb_node *node;
 	struct pattern_tree *elt;
 	struct pattern_list *pat;
+	struct eb_root *root;
+	void **node;
 
-	for (node = ebmb_first(&expr->pattern_tree);
-	     node;
-	     node = ebmb_next(node)) {
-		elt = container_of(node, struct pattern_tree, node);
-		if (elt->ref == ref)
+	for (node = ref->tree_head; node; node = *node) {
+		elt = container_of(node, struct pattern_tree, from_ref);
+		root = pat_tree_root(&elt->node);
+		if (root == &expr->pattern_tree || root == &expr->pattern_tree_2)
 			return &elt->data;
 	}
 
-	for (node = ebmb_first(&expr->pattern_tree_2);
-	     node;
-	     node = ebmb_next(node)) {
-		elt = container_of(node, struct pattern_tree, node);
-		if (elt->ref == ref)
-			return &elt->data;
+	if (!ref->list_head)
+		return NULL;
+
+	if (expr->ref && LIST_NEXT(&expr->ref->pat, struct pattern_expr *, list) == expr &&
+	    LIST_PREV(&expr->ref->pat, struct pattern_expr *, list) == expr) {
+		pat = container_of(ref->list_head, struct pattern_list, from_ref);
+		return &pat->pat.data;
 	}
 
 	list_for_each_entry(pat, &expr->patterns, list)
@@ -2618,6 +3897,45 @@ static int cmp_pat_ref(const void *_a, const void *_b)
 	return 0;
 }
 
+/* Applies the "tune.pattern.ref-cache-size" settings to their references once
+ * these ones have their unique ids. Returns ERR_* flags.
+ */
+static int pat_ref_apply_cache_cfgs(void)
+{
+	struct pat_ref_cache_cfg *cfg, *back;
+	struct pat_ref *ref;
+	int err_code = 0;
+
+	list_for_each_entry_safe(cfg, back, &pat_ref_cache_cfgs, list) {
+		if (*cfg->reference == '#')
+			ref = pat_ref_lookupid(atoi(cfg->reference + 1));
+		else
+			ref = pat_ref_lookup(cfg->reference);
+
+		if (!ref) {
+			ha_warning("parsing [%s:%d] : 'tune.pattern.ref-cache-size' : no pattern reference '%s' is used, ignoring.\n",
+			           cfg->file, cfg->line, cfg->reference);
+			err_code |= ERR_WARN;
+		}
+		else {
+			ref->cache_size = cfg->size;
+			if (ref->cache_size && !ref->lru) {
+				ref->lru = calloc(global.nbthread, sizeof(*ref->lru));
+				if (!ref->lru) {
+					ha_alert("Out of memory error.\n");
+					err_code |= ERR_ALERT | ERR_FATAL;
+				}
+			}
+		}
+
+		LIST_DELETE(&cfg->list);
+		free(cfg->reference);
+		free(cfg->file);
+		free(cfg);
+	}
+	return err_code;
+}
+
 /* This function finalizes the configuration parsing. It sets all the
  * automatic ids.
  */
@@ -2639,9 +3957,8 @@ int pattern_finalize_config(void)
 			unassigned_pos++;
 	}
 
-	if (len == 0) {
-		return 0;
-	}
+	if (len == 0)
+		return pat_ref_apply_cache_cfgs();
 
 	arr = calloc(len, sizeof(*arr));
 	if (arr == NULL) {
@@ -2682,11 +3999,39 @@ int pattern_finalize_config(void)
 	LIST_DELETE(&pr);
 
 	free(arr);
-	return 0;
+
+	/* build the automatons now instead of upon first lookup */
+	list_for_each_entry(ref, &pattern_reference, list) {
+		struct pattern_expr *expr;
+
+		list_for_each_entry(expr, &ref->pat, list) {
+			if (expr->pat_head->match == pat_match_sub)
+				pat_acm_get(expr, PAT_ACM_SUB);
+			else if (expr->pat_head->match == pat_match_end)
+				pat_acm_get(expr, PAT_ACM_END);
+#ifdef USE_HYPERSCAN
+			else if (expr->pat_head->match == pat_match_reg)
+				pat_hs_get(expr);
+#endif
+			else if (expr->pat_head->match == pat_match_ip)
+				pat_ip4_get(expr);
+		}
+	}
+	return pat_ref_apply_cache_cfgs();
 }
 
 static int pattern_per_thread_lru_alloc()
 {
+	struct pat_ref *ref;
+
+	list_for_each_entry(ref, &pattern_reference, list) {
+		if (ref->cache_size <= 0)
+			continue;
+		ref->lru[tid] = lru64_new(ref->cache_size);
+		if (!ref->lru[tid])
+			return 0;
+	}
+
 	if (!global.tune.pattern_cache)
 		return 1;
 	pat_lru_tree = lru64_new(global.tune.pattern_cache);
@@ -2695,8 +4040,61 @@ static int pattern_per_thread_lru_alloc()
 
 static void pattern_per_thread_lru_free()
 {
+	struct pat_ref *ref;
+
+	list_for_each_entry(ref, &pattern_reference, list) {
+		if (ref->cache_size > 0 && ref->lru[tid]) {
+			lru64_destroy(ref->lru[tid]);
+			ref->lru[tid] = NULL;
+		}
+	}
 	lru64_destroy(pat_lru_tree);
 }
 
+/* parse the "tune.pattern.ref-cache-size" global keyword */
+static int pattern_parse_ref_cache_size(char **args, int section_type, struct proxy *curpx,
+                                        const struct proxy *defpx, const char *file, int line,
+                                        char **err)
+{
+	struct pat_ref_cache_cfg *cfg;
+	char *end;
+	long size;
+
+	if (too_many_args(2, args, err, NULL))
+		return -1;
+
+	if (!*args[1] || !*args[2]) {
+		memprintf(err, "'%s' expects a pattern reference and a number of entries.", args[0]);
+		return -1;
+	}
+
+	size = strtol(args[2], &end, 10);
+	if (*end || size < 0 || size > INT_MAX) {
+		memprintf(err, "'%s' expects a positive number of entries, or zero to disable the cache.", args[0]);
+		return -1;
+	}
+
+	cfg = calloc(1, sizeof(*cfg));
+	if (!cfg || !(cfg->reference = strdup(args[1])) || !(cfg->file = strdup(file))) {
+		if (cfg)
+			free(cfg->reference);
+		free(cfg);
+		memprintf(err, "out of memory.");
+		return -1;
+	}
+
+	cfg->size = size;
+	cfg->line = line;
+	LIST_APPEND(&pat_ref_cache_cfgs, &cfg->list);
+	return 0;
+}
+
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.pattern.ref-cache-size", pattern_parse_ref_cache_size },
+	{ 0, NULL, NULL }
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
+
 REGISTER_PER_THREAD_ALLOC(pattern_per_thread_lru_alloc);
 REGISTER_PER_THREAD_FREE(pattern_per_thread_lru_free);
@@ -108,6 +108,7 @@
 
 /* default maximum of updates sent at once */
 #define PEER_DEF_MAX_UPDATES_AT_ONCE      200
+#define PEER_DEF_LOCAL_RESYNC_BATCH       0 /* no limit but the buffer room */
 
 /* flags for "show peers" */
 #define PEERS_SHOW_F_DICT           0x00000001 /* also show the contents of the dictionary */
@@ -307,6 +308,8 @@ enum {
 static size_t proto_len = sizeof(PEER_SESSION_PROTO_NAME) - 1;
 struct peers *cfg_peers = NULL;
 static int peers_max_updates_at_once = PEER_DEF_MAX_UPDATES_AT_ONCE;
+static int peers_local_resync_batch = PEER_DEF_LOCAL_RESYNC_BATCH;
+static unsigned int peers_update_delay = 0; /* ms between two pushes of local updates, 0=none */
 static void peer_session_forceshutdown(struct peer *peer);
 
 static struct ebpt_node *dcache_tx_insert(struct dcache *dc,
@@ -716,6 +719,9 @@ static int peer_prepare_updatemsg(char *msg, size_t size, struct peer_prep_param
 
 		data_ptr = stktable_data_ptr(st->table, ts, data_type);
 		if (data_ptr) {
+			/* summed counters only carry our own share */
+			int summed = stktable_is_summed(st->table, data_type);
+
 			/* in case of array all elements use
 			 * the same std_type and they are linearly
 			 * encoded.
@@ -740,6 +746,8 @@ static int peer_prepare_updatemsg(char *msg, size_t size, struct peer_prep_param
 
 					do {
 						data = stktable_data_cast(data_ptr, std_t_uint);
+						if (summed)
+							data = stktable_sum_local_share(st->table, ts, data_type, idx, data);
 						intencode(data, &cursor);
 
 						data_ptr = stktable_data_ptr_idx(st->table, ts, data_type, ++idx);
@@ -751,6 +759,8 @@ static int peer_prepare_updatemsg(char *msg, size_t size, struct peer_prep_param
 
 					do {
 						data = stktable_data_cast(data_ptr, std_t_ull);
+						if (summed)
+							data = stktable_sum_local_share(st->table, ts, data_type, idx, data);
 						intencode(data, &cursor);
 
 						data_ptr = stktable_data_ptr_idx(st->table, ts, data_type, ++idx);
@@ -789,6 +799,8 @@ static int peer_prepare_updatemsg(char *msg, size_t size, struct peer_prep_param
 					unsigned int data;
 
 					data = stktable_data_cast(data_ptr, std_t_uint);
+					if (summed)
+						data = stktable_sum_local_share(st->table, ts, data_type, 0, data);
 					intencode(data, &cursor);
 					break;
 				}
@@ -796,6 +808,8 @@ static int peer_prepare_updatemsg(char *msg, size_t size, struct peer_prep_param
 					unsigned long long data;
 
 					data = stktable_data_cast(data_ptr, std_t_ull);
+					if (summed)
+						data = stktable_sum_local_share(st->table, ts, data_type, 0, data);
 					intencode(data, &cursor);
 					break;
 				}
@@ -1503,7 +1517,7 @@ static inline struct stksess *peer_teach_process_stksess_lookup(struct shared_ta
 		return NULL;
 	}
 
-	return eb32_entry(eb, struct stksess, upd);
+	return stksess_from_upd(st->table, eb);
 }
 
 /*
@@ -1523,7 +1537,7 @@ static inline struct stksess *peer_teach_stage1_stksess_lookup(struct shared_tab
 		return NULL;
 	}
 
-	return eb32_entry(eb, struct stksess, upd);
+	return stksess_from_upd(st->table, eb);
 }
 
 /*
@@ -1540,7 +1554,7 @@ static inline struct stksess *peer_teach_stage2_stksess_lookup(struct shared_tab
 		return NULL;
 	}
 
-	return eb32_entry(eb, struct stksess, upd);
+	return stksess_from_upd(st->table, eb);
 }
 
 /*
@@ -1551,6 +1565,12 @@ static inline struct stksess *peer_teach_stage2_stksess_lookup(struct shared_tab
  *
  * This function temporary unlock/lock <st> when it sends stick-table updates or
  * when decrementing its refcount in case of any error when it sends this updates.
+ * When it locks <st> itself (teach stages), it only takes the read lock since
+ * only the per-peer <st> fields are modified, so that a full resync does not
+ * block the traffic threads updating the table. The number of updates sent at
+ * once is bounded by tune.peers.max-updates-at-once, except when teaching a
+ * full resync to the local peer (new process on reload), which is only bounded
+ * by tune.peers.local-resync-batch and the buffer room.
  *
  * Return 0 if any message could not be built modifying the appcxt st0 to PEER_SESS_ST_END value.
  * Returns -1 if there was not enough room left to send the message,
@@ -1565,6 +1585,7 @@ static inline int peer_send_teachmsgs(struct appctx *appctx, struct peer *p,
 {
 	int ret, new_pushed, use_timed;
 	int updates_sent = 0;
+	int max_updates = peers_max_updates_at_once;
 
 	ret = 1;
 	use_timed = 0;
@@ -1576,14 +1597,17 @@ static inline int peer_send_teachmsgs(struct appctx *appctx, struct peer *p,
 		p->last_local_table = st;
 	}
 
-	if (peer_stksess_lookup != peer_teach_process_stksess_lookup)
+	if (peer_stksess_lookup != peer_teach_process_stksess_lookup) {
 		use_timed = !(p->flags & PEER_F_DWNGRD);
+		if (p->local)
+			max_updates = peers_local_resync_batch;
+	}
 
 	/* We force new pushed to 1 to force identifier in update message */
 	new_pushed = 1;
 
 	if (!locked)
-		HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &st->table->lock);
+		HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &st->table->lock);
 
 	while (1) {
 		struct stksess *ts;
@@ -1596,7 +1620,7 @@ static inline int peer_send_teachmsgs(struct appctx *appctx, struct peer *p,
 			break;
 		}
 
-		updateid = ts->upd.key;
+		updateid = stksess_upd(st->table, ts)->key;
 		if (p->srv->shard && ts->shard != p->srv->shard) {
 			/* Skip this entry */
 			st->last_pushed = updateid;
@@ -1604,18 +1628,25 @@ static inline int peer_send_teachmsgs(struct appctx *appctx, struct peer *p,
 			continue;
 		}
 
-		ts->ref_cnt++;
-		HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &st->table->lock);
+		HA_ATOMIC_INC(&ts->ref_cnt);
+		if (locked)
+			HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &st->table->lock);
+		else
+			HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &st->table->lock);
 
 		ret = peer_send_updatemsg(st, appctx, ts, updateid, new_pushed, use_timed);
-		if (ret <= 0) {
+
+		if (locked)
 			HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &st->table->lock);
-			ts->ref_cnt--;
+		else
+			HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &st->table->lock);
+
+		if (ret <= 0) {
+			HA_ATOMIC_DEC(&ts->ref_cnt);
 			break;
 		}
 
-		HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &st->table->lock);
-		ts->ref_cnt--;
+		HA_ATOMIC_DEC(&ts->ref_cnt);
 		st->last_pushed = updateid;
 
 		if (peer_stksess_lookup == peer_teach_process_stksess_lookup &&
@@ -1626,7 +1657,7 @@ static inline int peer_send_teachmsgs(struct appctx *appctx, struct peer *p,
 		new_pushed = 0;
 
 		updates_sent++;
-		if (updates_sent >= peers_max_updates_at_once) {
+		if (max_updates && updates_sent >= max_updates) {
 			/* pretend we're full so that we get back ASAP */
 			struct stconn *sc = appctx_sc(appctx);
 
@@ -1638,7 +1669,7 @@ static inline int peer_send_teachmsgs(struct appctx *appctx, struct peer *p,
 
  out:
 	if (!locked)
-		HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &st->table->lock);
+		HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &st->table->lock);
 	return ret;
 }
 
@@ -1712,6 +1743,8 @@ static int peer_treat_updatemsg(struct appctx *appctx, struct peer *p, int updt,
 	unsigned int data_type;
 	size_t keylen;
 	void *data_ptr;
+	/* share slot of summed counters, the old process teaches us our own */
+	int slot = p->local ? -1 : p->idx;
 
 	TRACE_ENTER(PEERS_EV_UPDTMSG, NULL, p);
 	/* Here we have data message */
@@ -1822,12 +1855,13 @@ static int peer_treat_updatemsg(struct appctx *appctx, struct peer *p, int updt,
 	for (data_type = 0 ; data_type < STKTABLE_DATA_TYPES ; data_type++) {
 		uint64_t decoded_int;
 		unsigned int idx;
-		int ignore;
+		int ignore, summed;
 
 		if (!((1ULL << data_type) & st->remote_data))
 			continue;
 
 		ignore = stktable_data_types[data_type].is_local;
+		summed = stktable_is_summed(st->table, data_type);
 
 		if (stktable_data_types[data_type].is_array) {
 			/* in case of array all elements
@@ -1859,7 +1893,11 @@ static int peer_treat_updatemsg(struct appctx *appctx, struct peer *p, int updt,
 					}
 
 					data_ptr = stktable_data_ptr_idx(st->table, ts, data_type, idx);
-					if (data_ptr && !ignore)
+					if (data_ptr && !ignore && summed)
+						stktable_data_cast(data_ptr, std_t_uint) =
+							stktable_sum_update(st->table, ts, data_type, idx, slot,
+							                    stktable_data_cast(data_ptr, std_t_uint), decoded_int);
+					else if (data_ptr && !ignore)
 						stktable_data_cast(data_ptr, std_t_uint) = decoded_int;
 				}
 				break;
@@ -1872,7 +1910,11 @@ static int peer_treat_updatemsg(struct appctx *appctx, struct peer *p, int updt,
 					}
 
 					data_ptr = stktable_data_ptr_idx(st->table, ts, data_type, idx);
-					if (data_ptr && !ignore)
+					if (data_ptr && !ignore && summed)
+						stktable_data_cast(data_ptr, std_t_ull) =
+							stktable_sum_update(st->table, ts, data_type, idx, slot,
+							                    stktable_data_cast(data_ptr, std_t_ull), decoded_int);
+					else if (data_ptr && !ignore)
 						stktable_data_cast(data_ptr, std_t_ull) = decoded_int;
 				}
 				break;
@@ -1932,13 +1974,23 @@ static int peer_treat_updatemsg(struct appctx *appctx, struct peer *p, int updt,
 
 		case STD_T_UINT:
 			data_ptr = stktable_data_ptr(st->table, ts, data_type);
-			if (data_ptr && !ignore)
+			if (data_ptr && !ignore && summed)
+				stktable_data_cast(data_ptr, std_t_uint) =
+					stktable_sum_update(st->table, ts, data_type, 0, slot,
+					                    stktable_data_cast(data_ptr, std_t_uint), decoded_int);
+			else if (data_ptr && !ignore)
 				stktable_data_cast(data_ptr, std_t_uint) = decoded_int;
 			break;
 
 		case STD_T_ULL:
 			data_ptr = stktable_data_ptr(st->table, ts, data_type);
-			if (data_ptr && !ignore)
+			if (data_ptr && !ignore && data_type == STKTABLE_DT_GCRA)
+				stktable_gcra_merge(data_ptr, decoded_int);
+			else if (data_ptr && !ignore && summed)
+				stktable_data_cast(data_ptr, std_t_ull) =
+					stktable_sum_update(st->table, ts, data_type, 0, slot,
+					                    stktable_data_cast(data_ptr, std_t_ull), decoded_int);
+			else if (data_ptr && !ignore)
 				stktable_data_cast(data_ptr, std_t_ull) = decoded_int;
 			break;
 
@@ -2604,6 +2656,12 @@ static inline int peer_send_msgs(struct appctx *appctx,
 		struct shared_table *st;
 		struct shared_table *last_local_table;
 		int updates_sent = 0;
+		/* with tune.peers.update-delay, local updates are only pushed
+		 * once the delay since the end of the previous push has expired,
+		 * so that entries updated in between are sent only once.
+		 */
+		int may_push = !tick_isset(peer->next_push) || tick_is_expired(peer->next_push, now_ms);
+		int pushed = 0;
 
 		last_local_table = peer->last_local_table;
 		if (!last_local_table)
@@ -2625,9 +2683,10 @@ static inline int peer_send_msgs(struct appctx *appctx,
 
 			if (!(peer->flags & PEER_F_TEACH_PROCESS)) {
 				HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &st->table->lock);
-				if (!(peer->flags & PEER_F_LEARN_ASSIGN) &&
+				if (!(peer->flags & PEER_F_LEARN_ASSIGN) && may_push &&
 					(st->last_pushed != st->table->localupdate)) {
 
+					pushed = 1;
 					repl = peer_send_teach_process_msgs(appctx, peer, st);
 					if (repl <= 0) {
 						HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &st->table->lock);
@@ -2663,6 +2722,10 @@ static inline int peer_send_msgs(struct appctx *appctx,
 				return -1;
 			}
 		}
+
+		/* all pending updates were pushed, start a new delay */
+		if (pushed && peers_update_delay)
+			peer->next_push = tick_add(now_ms, MS_TO_TICKS(peers_update_delay));
 	}
 
 	if ((peer->flags & PEER_F_TEACH_PROCESS) && !(peer->flags & PEER_F_TEACH_FINISHED)) {
@@ -2800,6 +2863,7 @@ static inline void init_accepted_peer(struct peer *peer, struct peers *peers)
 	struct shared_table *st;
 
 	peer->heartbeat = tick_add(now_ms, MS_TO_TICKS(PEER_HEARTBEAT_TIMEOUT));
+	peer->next_push = TICK_ETERNITY;
 	/* Register status code */
 	peer->statuscode = PEER_SESS_SC_SUCCESSCODE;
 	peer->last_hdshk = now_ms;
@@ -2865,6 +2929,7 @@ static inline void init_connected_peer(struct peer *peer, struct peers *peers)
 	struct shared_table *st;
 
 	peer->heartbeat = tick_add(now_ms, MS_TO_TICKS(PEER_HEARTBEAT_TIMEOUT));
+	peer->next_push = TICK_ETERNITY;
 	/* Init cursors */
 	for (st = peer->tables; st ; st = st->next) {
 		st->last_get = st->last_acked = 0;
@@ -3409,7 +3474,14 @@ struct task *process_peer_sync(struct task * task, void *context, unsigned int s
 								 * come back to send heartbeat messages or to reconnect.
 								 */
 								task->expire = tick_first(ps->reconnect, ps->heartbeat);
-								appctx_wakeup(ps->appctx);
+
+								/* Updates are being coalesced, come back
+								 * when the peer may push them.
+								 */
+								if (tick_isset(ps->next_push) && !tick_is_expired(ps->next_push, now_ms))
+									task->expire = tick_first(task->expire, ps->next_push);
+								else
+									appctx_wakeup(ps->appctx);
 								break;
 							}
 						}
@@ -3742,6 +3814,15 @@ int peers_alloc_dcache(struct peers *peers)
 	return 1;
 }
 
+/*
+ * Returns non-zero once the tables of <peers> were resynchronized from the old
+ * local process and from the remote peers, or when this is not needed anymore.
+ */
+int peers_resync_done(const struct peers *peers)
+{
+	return (peers->flags & PEERS_RESYNC_STATEMASK) == PEERS_RESYNC_FINISHED;
+}
+
 /*
  * Function used to register a table for sync on a group of peers
  * Returns 0 in case of success.
@@ -4095,9 +4176,73 @@ static int cfg_parse_max_updt_at_once(char **args, int section_type, struct prox
 	return 0;
 }
 
+/* config parser for global "tune.peers.local-resync-batch" */
+static int cfg_parse_local_resync_batch(char **args, int section_type, struct proxy *curpx,
+                                        const struct proxy *defpx, const char *file, int line,
+                                        char **err)
+{
+	int arg = -1;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (*(args[1]) != 0)
+		arg = atoi(args[1]);
+
+	if (arg < 0) {
+		memprintf(err, "'%s' expects a positive integer argument or 0 for no limit.", args[0]);
+		return -1;
+	}
+
+	peers_local_resync_batch = arg;
+	return 0;
+}
+
+/* config parser for global "tune.peers.update-delay" */
+static int cfg_parse_update_delay(char **args, int section_type, struct proxy *curpx,
+                                  const struct proxy *defpx, const char *file, int line,
+                                  char **err)
+{
+	const char *res;
+	unsigned int delay;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (*(args[1]) == 0) {
+		memprintf(err, "'%s' expects a delay argument.", args[0]);
+		return -1;
+	}
+
+	res = parse_time_err(args[1], &delay, TIME_UNIT_MS);
+	if (res == PARSE_TIME_OVER) {
+		memprintf(err, "timer overflow in argument '%s' to '%s'.", args[1], args[0]);
+		return -1;
+	}
+	else if (res == PARSE_TIME_UNDER) {
+		memprintf(err, "timer underflow in argument '%s' to '%s'.", args[1], args[0]);
+		return -1;
+	}
+	else if (res) {
+		memprintf(err, "unexpected character '%c' in argument to '%s'.", *res, args[0]);
+		return -1;
+	}
+
+	/* updates also serve as heartbeats, they must not be delayed more */
+	if (delay >= PEER_HEARTBEAT_TIMEOUT) {
+		memprintf(err, "'%s' must be lower than %d ms.", args[0], PEER_HEARTBEAT_TIMEOUT);
+		return -1;
+	}
+
+	peers_update_delay = delay;
+	return 0;
+}
+
 /* config keyword parsers */
 static struct cfg_kw_list cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "tune.peers.max-updates-at-once",  cfg_parse_max_updt_at_once },
+	{ CFG_GLOBAL, "tune.peers.local-resync-batch",   cfg_parse_local_resync_batch },
+	{ CFG_GLOBAL, "tune.peers.update-delay",         cfg_parse_update_delay },
 	{ 0, NULL, NULL }
 }};
 
@@ -13,9 +13,10 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#include <haproxy/activity.h>
 #include <haproxy/api.h>
 #include <haproxy/global.h>
-#include <haproxy/pipe-t.h>
+#include <haproxy/pipe.h>
 #include <haproxy/pool.h>
 #include <haproxy/thread.h>
 
@@ -32,6 +33,8 @@ static THREAD_LOCAL struct pipe *local_pipes = NULL;
 int pipes_used = 0;             /* # of pipes in use (2 fds each) */
 int pipes_free = 0;             /* # of pipes unused */
 
+static int pipes_grow_limit = -1; /* lowered when the system refuses to grow pipes */
+
 /* return a pre-allocated empty pipe. Try to allocate one if there isn't any
  * left. NULL is returned if a pipe could not be allocated.
  */
@@ -58,6 +61,7 @@ struct pipe *get_pipe()
 		if (ret) {
 			HA_ATOMIC_DEC(&pipes_free);
 			HA_ATOMIC_INC(&pipes_used);
+			activity[tid].pipe_shared++;
 			goto out;
 		}
 	}
@@ -73,14 +77,23 @@ struct pipe *get_pipe()
 	if (pipe(pipefd) < 0)
 		goto fail;
 
+	ret->size = 0;
 #ifdef F_SETPIPE_SZ
 	if (global.tune.pipesize)
-		fcntl(pipefd[0], F_SETPIPE_SZ, global.tune.pipesize);
+		ret->size = fcntl(pipefd[0], F_SETPIPE_SZ, global.tune.pipesize);
+#endif
+#ifdef F_GETPIPE_SZ
+	if (ret->size <= 0)
+		ret->size = fcntl(pipefd[0], F_GETPIPE_SZ);
 #endif
+	if (ret->size < 0)
+		ret->size = 0;
+
 	ret->data = 0;
 	ret->prod = pipefd[1];
 	ret->cons = pipefd[0];
 	ret->next = NULL;
+	activity[tid].pipe_new++;
  out:
 	return ret;
  fail:
@@ -112,7 +125,8 @@ void put_pipe(struct pipe *p)
 		return;
 	}
 
-	if (likely(local_pipes_free * global.nbthread < global.maxpipes - pipes_used)) {
+	if (likely(local_pipes_free < MAX_LOCAL_PIPES &&
+		   local_pipes_free * global.nbthread < global.maxpipes - pipes_used)) {
 		p->next = local_pipes;
 		local_pipes = p;
 		local_pipes_free++;
@@ -128,6 +142,37 @@ void put_pipe(struct pipe *p)
 	HA_ATOMIC_DEC(&pipes_used);
 }
 
+/* doubles the size of pipe <p> within the limit of tune.pipesize.max. Returns
+ * non-zero if the pipe was grown. If the system refuses (e.g. above
+ * /proc/sys/fs/pipe-max-size or the user's pipe quota), the limit is lowered
+ * to the current size so that we don't retry on each call.
+ */
+int pipe_grow(struct pipe *p)
+{
+#ifdef F_SETPIPE_SZ
+	int limit = HA_ATOMIC_LOAD(&pipes_grow_limit);
+	int size;
+
+	if (limit < 0)
+		limit = global.tune.pipesize_max;
+
+	if (!p->size || p->size >= limit)
+		return 0;
+
+	size = (p->size <= limit / 2) ? p->size * 2 : limit;
+	size = fcntl(p->prod, F_SETPIPE_SZ, size);
+	if (size <= p->size) {
+		HA_ATOMIC_STORE(&pipes_grow_limit, p->size);
+		return 0;
+	}
+	p->size = size;
+	activity[tid].pipe_grow++;
+	return 1;
+#else
+	return 0;
+#endif
+}
+
 /*
  * Local variables:
  *  c-indent-level: 8
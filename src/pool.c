@@ -21,6 +21,7 @@
 #include <haproxy/cli.h>
 #include <haproxy/errors.h>
 #include <haproxy/global.h>
+#include <haproxy/init.h>
 #include <haproxy/list.h>
 #include <haproxy/pool.h>
 #include <haproxy/sc_strm.h>
@@ -79,6 +80,7 @@ static const struct {
 	{ POOL_DBG_CALLER,     "caller",     "no-caller",    "save caller information in cache" },
 	{ POOL_DBG_TAG,        "tag",        "no-tag",       "add tag at end of allocated objects" },
 	{ POOL_DBG_POISON,     "poison",     "no-poison",    "poison newly allocated objects" },
+	{ POOL_DBG_PROFILE,    "profile",    "no-profile",   "sample allocations per call site" },
 	{ 0 /* end */ }
 };
 
@@ -98,9 +100,35 @@ struct show_pools_ctx {
 	char *prefix;  /* if non-null, match this prefix name for the pool */
 	int by_what; /* 0=no sort, 1=by name, 2=by item size, 3=by total alloc */
 	int maxcnt;  /* 0=no limit, other=max number of output entries */
+	int profile; /* non-zero to dump the allocations profile instead */
 };
 
+/* Pools profiling: when POOL_DBG_PROFILE is set, one allocation out of
+ * <pool_prof_rate> is accounted in a bin per call site and pool. The extra
+ * last bin collects the call sites which could not get their own one.
+ */
+#define POOL_PROF_BITS     10
+#define POOL_PROF_BUCKETS  (1 << POOL_PROF_BITS)
+
+struct pool_prof_bin {
+	const void *caller;      /* allocation call site */
+	struct pool_head *pool;  /* pool the objects are taken from */
+	ulong allocs;            /* number of sampled allocations */
+	ulong frees;             /* number of sampled allocations released */
+};
+
+static struct pool_prof_bin pool_prof_bins[POOL_PROF_BUCKETS + 1];
+static uint pool_prof_rate __read_mostly = 64;
+static THREAD_LOCAL uint pool_prof_countdown;
+
 static int mem_fail_rate __read_mostly = 0;
+
+/* names of the pools whose objects are carved from huge-page slabs, and number
+ * of slabs to map and pre-fault for each of them at boot.
+ */
+static char **pool_hugepage_names = NULL;
+static int pool_hugepage_nb_names = 0;
+static int pool_hugepage_prefault = 0;
 static int using_default_allocator __read_mostly = 1;
 static int disable_trim __read_mostly = 0;
 static int(*my_mallctl)(const char *, void *, size_t *, void *, size_t) = NULL;
@@ -226,6 +254,188 @@ static int mem_should_fail(const struct pool_head *pool)
 	return ret;
 }
 
+/* room reserved at the beginning of each slab for its header (keeps the
+ * objects aligned on cache lines).
+ */
+#define POOL_SLAB_HDR_SIZE 64
+
+/* returns the distance between two consecutive objects of pool <pool> in slabs */
+static inline size_t pool_slab_stride(const struct pool_head *pool)
+{
+	return (pool->alloc_sz + 15) & -(size_t)16;
+}
+
+/* Maps a new slab for pool <pool>, whose slabs lock must be held unless they
+ * are not visible to other threads yet. Explicit huge pages are tried first,
+ * and when not available, transparent huge pages are requested on a regular
+ * mapping aligned on the slab size. The slab is pre-faulted when <prefault> is
+ * set. Returns non-zero on success, 0 on failure.
+ */
+static int pool_map_slab(struct pool_head *pool, int prefault)
+{
+	struct pool_slabs *slabs = pool->slabs;
+	struct pool_slab *slab;
+	char *area = MAP_FAILED;
+	int huge = 1;
+
+#ifdef MAP_HUGETLB
+	area = mmap(NULL, POOL_SLAB_SIZE, PROT_READ | PROT_WRITE,
+	            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (prefault ? MAP_POPULATE : 0), -1, 0);
+#endif
+	if (area == MAP_FAILED) {
+		char *base;
+		size_t head;
+
+		/* twice the size is mapped so that the slab can be aligned */
+		huge = 0;
+		base = mmap(NULL, 2 * POOL_SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED)
+			return 0;
+
+		area = (char *)(((size_t)base + POOL_SLAB_SIZE - 1) & -POOL_SLAB_SIZE);
+		head = area - base;
+		if (head)
+			munmap(base, head);
+		munmap(area + POOL_SLAB_SIZE, POOL_SLAB_SIZE - head);
+#ifdef MADV_HUGEPAGE
+		madvise(area, POOL_SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+		/* touching the pages after madvise() faults them as huge pages */
+		if (prefault)
+			memset(area, 0, POOL_SLAB_SIZE);
+	}
+
+	slab = (struct pool_slab *)area;
+	slab->next = slabs->slabs;
+	slabs->slabs = slab;
+	slabs->cur = area + POOL_SLAB_HDR_SIZE;
+	slabs->end = area + POOL_SLAB_SIZE;
+	slabs->nb_slabs++;
+	slabs->nb_huge += huge;
+	return 1;
+}
+
+/* Returns an object of pool <pool> taken from its slabs, either a previously
+ * released one or a new one carved from the last slab, which may require to
+ * map a new slab. Returns NULL if no memory is available.
+ */
+static void *pool_get_from_slabs(struct pool_head *pool)
+{
+	struct pool_slabs *slabs = pool->slabs;
+	size_t stride = pool_slab_stride(pool);
+	void *ptr = NULL;
+
+	HA_SPIN_LOCK(POOL_SLAB_LOCK, &slabs->lock);
+	if (slabs->free_list) {
+		ptr = slabs->free_list;
+		slabs->free_list = slabs->free_list->next;
+	}
+	else if (slabs->end - slabs->cur >= stride || pool_map_slab(pool, 0)) {
+		ptr = slabs->cur;
+		slabs->cur += stride;
+	}
+	HA_SPIN_UNLOCK(POOL_SLAB_LOCK, &slabs->lock);
+	return ptr;
+}
+
+/* Releases object <ptr> of pool <pool> to its slabs for later reuse */
+static void pool_put_to_slabs(struct pool_head *pool, void *ptr)
+{
+	struct pool_slabs *slabs = pool->slabs;
+	struct pool_item *item = ptr;
+
+	HA_SPIN_LOCK(POOL_SLAB_LOCK, &slabs->lock);
+	item->next = slabs->free_list;
+	slabs->free_list = item;
+	HA_SPIN_UNLOCK(POOL_SLAB_LOCK, &slabs->lock);
+}
+
+/* Unmaps all the slabs of pool <pool>, which must not have any object in use
+ * anymore, and releases its slabs descriptor.
+ */
+static void pool_unmap_slabs(struct pool_head *pool)
+{
+	struct pool_slab *slab, *next;
+
+	if (!pool->slabs)
+		return;
+
+	for (slab = pool->slabs->slabs; slab; slab = next) {
+		next = slab->next;
+		munmap(slab, POOL_SLAB_SIZE);
+	}
+	HA_SPIN_DESTROY(&pool->slabs->lock);
+	ha_free(&pool->slabs);
+}
+
+/* Returns non-zero if pool <pool> is called <name>, which is compared within
+ * the limit of the pool names length.
+ */
+static int pool_name_matches(const struct pool_head *pool, const char *name)
+{
+	size_t len = strlen(name);
+
+	if (len >= sizeof(pool->name))
+		len = sizeof(pool->name) - 1;
+	return strncmp(pool->name, name, len) == 0 && !pool->name[len];
+}
+
+/* Returns non-zero if pool <pool> was configured to use huge-page slabs */
+static int pool_hugepage_match(const struct pool_head *pool)
+{
+	int i;
+
+	for (i = 0; i < pool_hugepage_nb_names; i++) {
+		if (pool_name_matches(pool, pool_hugepage_names[i]))
+			return 1;
+	}
+	return 0;
+}
+
+/* Makes pool <pool> carve its objects from huge-page slabs, and maps the
+ * number of pre-faulted slabs configured with "tune.pool-hugepages-prefault".
+ * This is only possible as long as no object was allocated from this pool.
+ * Returns non-zero on success, otherwise 0 after having emitted a warning.
+ */
+static int pool_enable_hugepages(struct pool_head *pool)
+{
+	int i;
+
+	if (pool->slabs)
+		return 1;
+
+#ifdef DEBUG_UAF
+	ha_warning("Pool '%s': huge-page slabs are not supported with DEBUG_UAF, ignoring.\n", pool->name);
+	return 0;
+#endif
+	if (pool->allocated) {
+		ha_warning("Pool '%s': cannot use huge-page slabs after objects were allocated, ignoring.\n", pool->name);
+		return 0;
+	}
+
+	if (pool_slab_stride(pool) > POOL_SLAB_SIZE - POOL_SLAB_HDR_SIZE) {
+		ha_warning("Pool '%s': objects of %u bytes do not fit in huge-page slabs, ignoring.\n",
+		           pool->name, pool->alloc_sz);
+		return 0;
+	}
+
+	pool->slabs = calloc(1, sizeof(*pool->slabs));
+	if (!pool->slabs) {
+		ha_warning("Pool '%s': out of memory while enabling huge-page slabs, ignoring.\n", pool->name);
+		return 0;
+	}
+
+	HA_SPIN_INIT(&pool->slabs->lock);
+	for (i = 0; i < pool_hugepage_prefault; i++) {
+		if (!pool_map_slab(pool, 1)) {
+			ha_warning("Pool '%s': could only map %d pre-faulted huge-page slabs out of %d.\n",
+			           pool->name, i, pool_hugepage_prefault);
+			break;
+		}
+	}
+	return 1;
+}
+
 /* Try to find an existing shared pool with the same characteristics and
  * returns it, otherwise creates this one. NULL is returned if no memory
  * is available for a new creation. Two flags are supported :
@@ -234,7 +444,7 @@ static int mem_should_fail(const struct pool_head *pool)
  */
 struct pool_head *create_pool(char *name, unsigned int size, unsigned int flags)
 {
-	unsigned int extra_mark, extra_caller, extra;
+	unsigned int extra_mark, extra_prof, extra_caller, extra;
 	struct pool_head *pool;
 	struct pool_head *entry;
 	struct list *start;
@@ -252,8 +462,9 @@ struct pool_head *create_pool(char *name, unsigned int size, unsigned int flags)
 	 */
 
 	extra_mark = (pool_debugging & POOL_DBG_TAG) ? POOL_EXTRA_MARK : 0;
+	extra_prof = (pool_debugging & POOL_DBG_PROFILE) ? POOL_EXTRA_PROF : 0;
 	extra_caller = (pool_debugging & POOL_DBG_CALLER) ? POOL_EXTRA_CALLER : 0;
-	extra = extra_mark + extra_caller;
+	extra = extra_mark + extra_prof + extra_caller;
 
 	if (!(flags & MEM_F_EXACT)) {
 		align = 4 * sizeof(void *); // 2 lists = 4 pointers min
@@ -325,17 +536,22 @@ struct pool_head *create_pool(char *name, unsigned int size, unsigned int flags)
 		}
 	}
 	pool->users++;
+
+	/* pools created once the configuration was parsed, such as "buffer" */
+	if (pool_hugepage_nb_names && pool_hugepage_match(pool))
+		pool_enable_hugepages(pool);
 	return pool;
 }
 
 /* Tries to allocate an object for the pool <pool> using the system's allocator
  * and directly returns it. The pool's allocated counter is checked and updated,
- * but no other checks are performed.
+ * but no other checks are performed. Pools using huge-page slabs take their
+ * objects there instead.
  */
 void *pool_get_from_os(struct pool_head *pool)
 {
 	if (!pool->limit || pool->allocated < pool->limit) {
-		void *ptr = pool_alloc_area(pool->alloc_sz);
+		void *ptr = pool->slabs ? pool_get_from_slabs(pool) : pool_alloc_area(pool->alloc_sz);
 		if (ptr) {
 			_HA_ATOMIC_INC(&pool->allocated);
 			return ptr;
@@ -348,7 +564,8 @@ void *pool_get_from_os(struct pool_head *pool)
 }
 
 /* Releases a pool item back to the operating system and atomically updates
- * the allocation counter.
+ * the allocation counter. Objects carved from huge-page slabs are released to
+ * the slabs instead.
  */
 void pool_put_to_os(struct pool_head *pool, void *ptr)
 {
@@ -360,10 +577,78 @@ void pool_put_to_os(struct pool_head *pool, void *ptr)
 	*(uint32_t *)ptr = 0xDEADADD4;
 #endif /* DEBUG_UAF */
 
-	pool_free_area(ptr, pool->alloc_sz);
+	if (pool->slabs)
+		pool_put_to_slabs(pool, ptr);
+	else
+		pool_free_area(ptr, pool->alloc_sz);
 	_HA_ATOMIC_DEC(&pool->allocated);
 }
 
+/* returns the location of the profiling tag of object <ptr> from pool <pool> */
+static inline ulong *pool_prof_tag(const struct pool_head *pool, void *ptr)
+{
+	return (ulong *)((char *)ptr + pool->size + ((pool_debugging & POOL_DBG_TAG) ? POOL_EXTRA_MARK : 0));
+}
+
+/* Returns the profiling bin for allocations from pool <pool> by <caller>. Up to
+ * 16 consecutive entries are tested before falling back to the extra last one.
+ */
+static struct pool_prof_bin *pool_prof_get_bin(const void *caller, struct pool_head *pool)
+{
+	int retries = 16;
+	const void *old;
+	unsigned int bin;
+
+	bin = ptr2_hash(caller, pool, POOL_PROF_BITS);
+	for (; pool_prof_bins[bin].caller != caller || pool_prof_bins[bin].pool != pool;
+	     bin = (bin + 1) & (POOL_PROF_BUCKETS - 1)) {
+		if (!--retries) {
+			bin = POOL_PROF_BUCKETS;
+			break;
+		}
+
+		old = NULL;
+		if (!pool_prof_bins[bin].caller &&
+		    HA_ATOMIC_CAS(&pool_prof_bins[bin].caller, &old, caller)) {
+			HA_ATOMIC_STORE(&pool_prof_bins[bin].pool, pool);
+			break;
+		}
+	}
+	return &pool_prof_bins[bin];
+}
+
+/* Accounts the allocation of object <ptr> from pool <pool> by <caller> if it
+ * is sampled, and tags the object with the bin it was accounted in, or 0.
+ */
+static void pool_prof_alloc(struct pool_head *pool, void *ptr, const void *caller)
+{
+	ulong *tag = pool_prof_tag(pool, ptr);
+	struct pool_prof_bin *bin;
+
+	if (pool_prof_countdown) {
+		pool_prof_countdown--;
+		*tag = 0;
+		return;
+	}
+
+	pool_prof_countdown = pool_prof_rate - 1;
+	bin = pool_prof_get_bin(caller, pool);
+	_HA_ATOMIC_INC(&bin->allocs);
+	*tag = bin - pool_prof_bins + 1;
+}
+
+/* Accounts the release of object <ptr> from pool <pool> in the bin it was
+ * tagged with, if any, and resets its tag.
+ */
+static void pool_prof_free(struct pool_head *pool, void *ptr)
+{
+	ulong *tag = pool_prof_tag(pool, ptr);
+
+	if (*tag && *tag <= POOL_PROF_BUCKETS + 1)
+		_HA_ATOMIC_INC(&pool_prof_bins[*tag - 1].frees);
+	*tag = 0;
+}
+
 /* Tries to allocate an object for the pool <pool> using the system's allocator
  * and directly returns it. The pool's counters are updated but the object is
  * never cached, so this is usable with and without local or shared caches.
@@ -382,6 +667,10 @@ void *pool_alloc_nocache(struct pool_head *pool)
 	/* keep track of where the element was allocated from */
 	POOL_DEBUG_SET_MARK(pool, ptr);
 	POOL_DEBUG_TRACE_CALLER(pool, (struct pool_cache_item *)ptr, NULL);
+
+	/* not sampled unless it comes from pool_alloc() */
+	if (unlikely(pool_debugging & POOL_DBG_PROFILE))
+		*pool_prof_tag(pool, ptr) = 0;
 	return ptr;
 }
 
@@ -391,6 +680,9 @@ void *pool_alloc_nocache(struct pool_head *pool)
  */
 void pool_free_nocache(struct pool_head *pool, void *ptr)
 {
+	if (unlikely(pool_debugging & POOL_DBG_PROFILE))
+		pool_prof_free(pool, ptr);
+
 	_HA_ATOMIC_DEC(&pool->used);
 	swrate_add(&pool->needed_avg, POOL_AVG_SAMPLES, pool->used);
 	pool_put_to_os(pool, ptr);
@@ -576,42 +868,66 @@ void pool_put_to_cache(struct pool_head *pool, void *ptr, const void *caller)
 	}
 }
 
-/* Tries to refill the local cache <pch> from the shared one for pool <pool>.
- * This is only used when pools are in use and shared pools are enabled. No
- * malloc() is attempted, and poisonning is never performed. The purpose is to
- * get the fastest possible refilling so that the caller can easily check if
- * the cache has enough objects for its use. Must not be used when pools are
- * disabled.
+/* Detaches the first cluster of objects from the shared free list <shared>,
+ * and returns it, or NULL if the list is empty.
  */
-void pool_refill_local_from_shared(struct pool_head *pool, struct pool_cache_head *pch)
+static struct pool_item *pool_get_from_shared_list(struct pool_shared *shared)
 {
-	struct pool_cache_item *item;
-	struct pool_item *ret, *down;
-	uint count;
-
-	BUG_ON(pool_debugging & POOL_DBG_NO_CACHE);
+	struct pool_item *ret;
 
 	/* we'll need to reference the first element to figure the next one. We
 	 * must temporarily lock it so that nobody allocates then releases it,
 	 * or the dereference could fail.
 	 */
-	ret = _HA_ATOMIC_LOAD(&pool->free_list);
+	ret = _HA_ATOMIC_LOAD(&shared->free_list);
 	do {
 		while (unlikely(ret == POOL_BUSY)) {
 			__ha_cpu_relax();
-			ret = _HA_ATOMIC_LOAD(&pool->free_list);
+			ret = _HA_ATOMIC_LOAD(&shared->free_list);
 		}
 		if (ret == NULL)
-			return;
-	} while (unlikely((ret = _HA_ATOMIC_XCHG(&pool->free_list, POOL_BUSY)) == POOL_BUSY));
+			return NULL;
+	} while (unlikely((ret = _HA_ATOMIC_XCHG(&shared->free_list, POOL_BUSY)) == POOL_BUSY));
 
 	if (unlikely(ret == NULL)) {
-		HA_ATOMIC_STORE(&pool->free_list, NULL);
-		return;
+		HA_ATOMIC_STORE(&shared->free_list, NULL);
+		return NULL;
 	}
 
 	/* this releases the lock */
-	HA_ATOMIC_STORE(&pool->free_list, ret->next);
+	HA_ATOMIC_STORE(&shared->free_list, ret->next);
+	return ret;
+}
+
+/* Tries to refill the local cache <pch> from the shared one for pool <pool>.
+ * This is only used when pools are in use and shared pools are enabled. No
+ * malloc() is attempted, and poisonning is never performed. The purpose is to
+ * get the fastest possible refilling so that the caller can easily check if
+ * the cache has enough objects for its use. The current thread group's list
+ * is used first, and the other groups' ones are only looked up when it is
+ * empty, so that objects remain on the NUMA node which released them as long
+ * as possible. Must not be used when pools are disabled.
+ */
+void pool_refill_local_from_shared(struct pool_head *pool, struct pool_cache_head *pch)
+{
+	struct pool_cache_item *item;
+	struct pool_item *ret, *down;
+	struct pool_shared *shared;
+	uint count, grp;
+
+	BUG_ON(pool_debugging & POOL_DBG_NO_CACHE);
+
+	shared = &pool->shared[tgid - 1];
+	ret = pool_get_from_shared_list(shared);
+	for (grp = 1; !ret && grp < global.nbtgroups; grp++) {
+		shared = &pool->shared[(tgid - 1 + grp) % global.nbtgroups];
+		ret = pool_get_from_shared_list(shared);
+		if (ret)
+			_HA_ATOMIC_INC(&pool->shared[tgid - 1].remote);
+	}
+
+	if (!ret)
+		return;
 
 	/* now store the retrieved object(s) into the local cache */
 	count = 0;
@@ -625,6 +941,7 @@ void pool_refill_local_from_shared(struct pool_head *pool, struct pool_cache_hea
 		if (unlikely(pool_debugging & POOL_DBG_INTEGRITY))
 			pool_fill_pattern(pch, item, pool->size);
 	}
+	HA_ATOMIC_SUB(&shared->count, count);
 	HA_ATOMIC_ADD(&pool->used, count);
 	pch->count += count;
 	pool_cache_count += count;
@@ -638,18 +955,20 @@ void pool_refill_local_from_shared(struct pool_head *pool, struct pool_cache_hea
  */
 void pool_put_to_shared_cache(struct pool_head *pool, struct pool_item *item, uint count)
 {
+	struct pool_shared *shared = &pool->shared[tgid - 1];
 	struct pool_item *free_list;
 
 	_HA_ATOMIC_SUB(&pool->used, count);
-	free_list = _HA_ATOMIC_LOAD(&pool->free_list);
+	_HA_ATOMIC_ADD(&shared->count, count);
+	free_list = _HA_ATOMIC_LOAD(&shared->free_list);
 	do {
 		while (unlikely(free_list == POOL_BUSY)) {
 			__ha_cpu_relax();
-			free_list = _HA_ATOMIC_LOAD(&pool->free_list);
+			free_list = _HA_ATOMIC_LOAD(&shared->free_list);
 		}
 		_HA_ATOMIC_STORE(&item->next, free_list);
 		__ha_barrier_atomic_store();
-	} while (!_HA_ATOMIC_CAS(&pool->free_list, &free_list, item));
+	} while (!_HA_ATOMIC_CAS(&shared->free_list, &free_list, item));
 	__ha_barrier_atomic_store();
 	swrate_add(&pool->needed_avg, POOL_AVG_SAMPLES, pool->used);
 }
@@ -660,32 +979,45 @@ void pool_put_to_shared_cache(struct pool_head *pool, struct pool_item *item, ui
 void pool_flush(struct pool_head *pool)
 {
 	struct pool_item *next, *temp, *down;
+	struct pool_shared *shared;
+	uint grp, count;
 
 	if (!pool || (pool_debugging & (POOL_DBG_NO_CACHE|POOL_DBG_NO_GLOBAL)))
 		return;
 
-	/* The loop below atomically detaches the head of the free list and
-	 * replaces it with a NULL. Then the list can be released.
-	 */
-	next = pool->free_list;
-	do {
-		while (unlikely(next == POOL_BUSY)) {
-			__ha_cpu_relax();
-			next = _HA_ATOMIC_LOAD(&pool->free_list);
-		}
+	for (grp = 0; grp < MAX_TGROUPS; grp++) {
+		shared = &pool->shared[grp];
+
+		/* The loop below atomically detaches the head of the free list
+		 * and replaces it with a NULL. Then the list can be released.
+		 */
+		next = _HA_ATOMIC_LOAD(&shared->free_list);
+		do {
+			while (unlikely(next == POOL_BUSY)) {
+				__ha_cpu_relax();
+				next = _HA_ATOMIC_LOAD(&shared->free_list);
+			}
+			if (next == NULL)
+				break;
+		} while (unlikely((next = _HA_ATOMIC_XCHG(&shared->free_list, POOL_BUSY)) == POOL_BUSY));
+
 		if (next == NULL)
-			return;
-	} while (unlikely((next = _HA_ATOMIC_XCHG(&pool->free_list, POOL_BUSY)) == POOL_BUSY));
-	_HA_ATOMIC_STORE(&pool->free_list, NULL);
-	__ha_barrier_atomic_store();
+			continue;
 
-	while (next) {
-		temp = next;
-		next = temp->next;
-		for (; temp; temp = down) {
-			down = temp->down;
-			pool_put_to_os(pool, temp);
+		_HA_ATOMIC_STORE(&shared->free_list, NULL);
+		__ha_barrier_atomic_store();
+
+		count = 0;
+		while (next) {
+			temp = next;
+			next = temp->next;
+			for (; temp; temp = down) {
+				down = temp->down;
+				pool_put_to_os(pool, temp);
+				count++;
+			}
 		}
+		_HA_ATOMIC_SUB(&shared->count, count);
 	}
 	/* here, we should have pool->allocated == pool->used */
 }
@@ -705,14 +1037,20 @@ void pool_gc(struct pool_head *pool_ctx)
 
 	list_for_each_entry(entry, &pools, list) {
 		struct pool_item *temp, *down;
-
-		while (entry->free_list &&
-		       (int)(entry->allocated - entry->used) > (int)entry->minavail) {
-			temp = entry->free_list;
-			entry->free_list = temp->next;
-			for (; temp; temp = down) {
-				down = temp->down;
-				pool_put_to_os(entry, temp);
+		uint grp;
+
+		for (grp = 0; grp < MAX_TGROUPS; grp++) {
+			struct pool_shared *shared = &entry->shared[grp];
+
+			while (shared->free_list &&
+			       (int)(entry->allocated - entry->used) > (int)entry->minavail) {
+				temp = shared->free_list;
+				shared->free_list = temp->next;
+				for (; temp; temp = down) {
+					down = temp->down;
+					pool_put_to_os(entry, temp);
+					shared->count--;
+				}
 			}
 		}
 	}
@@ -755,6 +1093,9 @@ void *__pool_alloc(struct pool_head *pool, unsigned int flags)
 			_HA_ATOMIC_STORE(&bin->info, pool);
 		}
 #endif
+		if (unlikely(pool_debugging & POOL_DBG_PROFILE))
+			pool_prof_alloc(pool, p, caller);
+
 		if (unlikely(flags & POOL_F_MUST_ZERO))
 			memset(p, 0, pool->size);
 		else if (unlikely(!(flags & POOL_F_NO_POISON) && (pool_debugging & POOL_DBG_POISON)))
@@ -786,6 +1127,9 @@ void __pool_free(struct pool_head *pool, void *ptr)
 	}
 #endif
 
+	if (unlikely(pool_debugging & POOL_DBG_PROFILE))
+		pool_prof_free(pool, ptr);
+
 	if (unlikely(pool_debugging & POOL_DBG_NO_CACHE)) {
 		pool_free_nocache(pool, ptr);
 		return;
@@ -865,6 +1209,7 @@ void *pool_destroy(struct pool_head *pool)
 		if (!pool->users) {
 			LIST_DELETE(&pool->list);
 			/* note that if used == 0, the cache is empty */
+			pool_unmap_slabs(pool);
 			free(pool->base_addr);
 		}
 	}
@@ -995,6 +1340,26 @@ void dump_pools_to_trash(int by_what, int max, const char *pfx)
 		              pool_info[i].entry->users, pool_info[i].entry,
 		              (pool_info[i].entry->flags & MEM_F_SHARED) ? " [SHARED]" : "");
 
+		if (pool_info[i].entry->slabs) {
+			/* replace the LF with the slabs details */
+			trash.data--;
+			chunk_appendf(&trash, " [SLABS %u (%u huge)]\n",
+			              pool_info[i].entry->slabs->nb_slabs,
+			              pool_info[i].entry->slabs->nb_huge);
+		}
+
+		/* report how the shared objects are spread over the groups */
+		if (global.nbtgroups > 1 && !(pool_debugging & (POOL_DBG_NO_CACHE|POOL_DBG_NO_GLOBAL))) {
+			int grp;
+
+			chunk_appendf(&trash, "      shared per group (free, remote refills) :");
+			for (grp = 0; grp < global.nbtgroups; grp++)
+				chunk_appendf(&trash, " %d:(%u, %u)", grp + 1,
+				              pool_info[i].entry->shared[grp].count,
+				              pool_info[i].entry->shared[grp].remote);
+			chunk_appendf(&trash, "\n");
+		}
+
 		cached_bytes += pool_info[i].cached_items * (ulong)pool_info[i].entry->size;
 		allocated    += pool_info[i].alloc_items  * (ulong)pool_info[i].entry->size;
 		used         += pool_info[i].used_items   * (ulong)pool_info[i].entry->size;
@@ -1007,6 +1372,77 @@ void dump_pools_to_trash(int by_what, int max, const char *pfx)
 		      );
 }
 
+/* used by qsort in "show pools profile" to sort by estimated outstanding bytes */
+static int cmp_dump_pool_prof(const void *a, const void *b)
+{
+	const struct pool_prof_bin *l = (const struct pool_prof_bin *)a;
+	const struct pool_prof_bin *r = (const struct pool_prof_bin *)b;
+	ullong lb = (ullong)(long)(l->allocs - l->frees) * (l->pool ? l->pool->size : 0);
+	ullong rb = (ullong)(long)(r->allocs - r->frees) * (r->pool ? r->pool->size : 0);
+
+	if (lb > rb)
+		return -1;
+	else if (lb < rb)
+		return 1;
+	else
+		return 0;
+}
+
+/* This function dumps into the trash buffer the pool allocation call sites
+ * holding the largest estimated amount of outstanding memory, which is the
+ * number of sampled objects not yet released, multiplied by the sampling rate
+ * and the object size. It may limit the number of output lines if <max> is
+ * non-zero, and limit only to pools whose names start with <pfx> if non-null.
+ */
+static void dump_pool_profile_to_trash(int max, const char *pfx)
+{
+	struct pool_prof_bin tmp_bins[POOL_PROF_BUCKETS + 1];
+	struct pool_prof_bin *bin;
+	int i, nbins;
+	long objs;
+
+	if (!(pool_debugging & POOL_DBG_PROFILE)) {
+		chunk_printf(&trash, "Pools profiling is disabled, it must be enabled at boot with -dMprofile.\n");
+		return;
+	}
+
+	for (i = nbins = 0; i < POOL_PROF_BUCKETS + 1; i++) {
+		bin = &pool_prof_bins[i];
+		if (!HA_ATOMIC_LOAD(&bin->allocs))
+			continue;
+		if (pfx && (!bin->pool || strncmp(bin->pool->name, pfx, strlen(pfx)) != 0))
+			continue;
+		tmp_bins[nbins].caller = HA_ATOMIC_LOAD(&bin->caller);
+		tmp_bins[nbins].pool   = HA_ATOMIC_LOAD(&bin->pool);
+		tmp_bins[nbins].frees  = HA_ATOMIC_LOAD(&bin->frees);
+		tmp_bins[nbins].allocs = HA_ATOMIC_LOAD(&bin->allocs);
+		nbins++;
+	}
+
+	qsort(tmp_bins, nbins, sizeof(tmp_bins[0]), cmp_dump_pool_prof);
+
+	chunk_printf(&trash, "Dumping pools allocations profile (1 out of %u sampled)", pool_prof_rate);
+	if (max && nbins > max)
+		chunk_appendf(&trash, " (limited to the first %u entries)", max);
+	chunk_appendf(&trash, ":\n     est_bytes    est_objs    sampled pool        caller\n");
+
+	for (i = 0; i < nbins && (!max || i < max); i++) {
+		bin = &tmp_bins[i];
+		objs = bin->allocs - bin->frees;
+		if (objs < 0)
+			objs = 0;
+		chunk_appendf(&trash, "%14llu %11llu %10lu %-11s ",
+		              (ullong)objs * pool_prof_rate * (bin->pool ? bin->pool->size : 0),
+		              (ullong)objs * pool_prof_rate, bin->allocs,
+		              bin->pool ? bin->pool->name : "-");
+		if (bin->caller)
+			resolve_sym_name(&trash, NULL, bin->caller);
+		else
+			chunk_appendf(&trash, "other");
+		chunk_appendf(&trash, "\n");
+	}
+}
+
 /* Dump statistics on pools usage. */
 void dump_pools(void)
 {
@@ -1146,11 +1582,14 @@ static int cli_parse_show_pools(char **args, char *payload, struct appctx *appct
 			ctx->prefix = strdup(args[arg+1]); // only pools starting with this
 			arg++;
 		}
+		else if (strcmp(args[arg], "profile") == 0) {
+			ctx->profile = 1; // dump the allocations profile
+		}
 		else if (isdigit((unsigned char)*args[arg])) {
 			ctx->maxcnt = atoi(args[arg]); // number of entries to dump
 		}
 		else
-			return cli_err(appctx, "Expects either 'byname', 'bysize', 'byusage', 'match <pfx>', or a max number of output lines.\n");
+			return cli_err(appctx, "Expects either 'byname', 'bysize', 'byusage', 'profile', 'match <pfx>', or a max number of output lines.\n");
 	}
 	return 0;
 }
@@ -1171,7 +1610,10 @@ static int cli_io_handler_dump_pools(struct appctx *appctx)
 {
 	struct show_pools_ctx *ctx = appctx->svcctx;
 
-	dump_pools_to_trash(ctx->by_what, ctx->maxcnt, ctx->prefix);
+	if (ctx->profile)
+		dump_pool_profile_to_trash(ctx->maxcnt, ctx->prefix);
+	else
+		dump_pools_to_trash(ctx->by_what, ctx->maxcnt, ctx->prefix);
 	if (applet_putchk(appctx, &trash) == -1)
 		return 0;
 	return 1;
@@ -1218,7 +1660,7 @@ INITCALL0(STG_REGISTER, pools_register_build_options);
 
 /* register cli keywords */
 static struct cli_kw_list cli_kws = {{ },{
-	{ { "show", "pools",  NULL }, "show pools [by*] [match <pfx>] [nb]     : report information about the memory pools usage", cli_parse_show_pools, cli_io_handler_dump_pools, cli_release_show_pools },
+	{ { "show", "pools",  NULL }, "show pools [by*|profile] [match <pfx>] [nb] : report information about the memory pools usage", cli_parse_show_pools, cli_io_handler_dump_pools, cli_release_show_pools },
 	{{},}
 }};
 
@@ -1251,9 +1693,107 @@ static int mem_parse_global_no_mem_trim(char **args, int section_type, struct pr
 	return 0;
 }
 
+/* config parser for global "tune.pool-profile-rate" */
+static int mem_parse_global_profile_rate(char **args, int section_type, struct proxy *curpx,
+                                         const struct proxy *defpx, const char *file, int line,
+                                         char **err)
+{
+	int rate;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+	rate = atoi(args[1]);
+	if (rate < 1 || rate > 1000000) {
+		memprintf(err, "'%s' expects a sampling rate between 1 and 1000000.", args[0]);
+		return -1;
+	}
+	pool_prof_rate = rate;
+	return 0;
+}
+
+/* config parser for global "tune.pool-hugepages" */
+static int mem_parse_global_hugepages(char **args, int section_type, struct proxy *curpx,
+                                      const struct proxy *defpx, const char *file, int line,
+                                      char **err)
+{
+	char **names;
+	int arg;
+
+	if (!*args[1]) {
+		memprintf(err, "'%s' expects at least one pool name.", args[0]);
+		return -1;
+	}
+
+	for (arg = 1; *args[arg]; arg++) {
+		names = realloc(pool_hugepage_names, (pool_hugepage_nb_names + 1) * sizeof(*names));
+		if (!names || !(names[pool_hugepage_nb_names] = strdup(args[arg]))) {
+			if (names)
+				pool_hugepage_names = names;
+			memprintf(err, "'%s': out of memory.", args[0]);
+			return -1;
+		}
+		pool_hugepage_names = names;
+		pool_hugepage_nb_names++;
+	}
+	return 0;
+}
+
+/* config parser for global "tune.pool-hugepages-prefault" */
+static int mem_parse_global_hugepages_prefault(char **args, int section_type, struct proxy *curpx,
+                                               const struct proxy *defpx, const char *file, int line,
+                                               char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+	pool_hugepage_prefault = atoi(args[1]);
+	if (pool_hugepage_prefault < 0 || pool_hugepage_prefault > 65536) {
+		memprintf(err, "'%s' expects a number of slabs between 0 and 65536.", args[0]);
+		return -1;
+	}
+	return 0;
+}
+
+/* switches the pools configured with "tune.pool-hugepages" which were created
+ * before the configuration was parsed to their slabs. The other ones are
+ * switched upon creation.
+ */
+static int pool_apply_hugepages(void)
+{
+	struct pool_head *entry;
+	int i, found;
+
+	for (i = 0; i < pool_hugepage_nb_names; i++) {
+		found = 0;
+		list_for_each_entry(entry, &pools, list) {
+			if (pool_name_matches(entry, pool_hugepage_names[i])) {
+				pool_enable_hugepages(entry);
+				found = 1;
+			}
+		}
+		if (!found)
+			ha_warning("'tune.pool-hugepages': no pool named '%s' was found, it may have "
+			           "been merged with another pool of the same size (see '-dMno-merge').\n",
+			           pool_hugepage_names[i]);
+	}
+	return ERR_NONE;
+}
+REGISTER_POST_CHECK(pool_apply_hugepages);
+
+/* releases the pool names configured with "tune.pool-hugepages" */
+static void pool_free_hugepage_names(void)
+{
+	while (pool_hugepage_nb_names)
+		free(pool_hugepage_names[--pool_hugepage_nb_names]);
+	ha_free(&pool_hugepage_names);
+}
+REGISTER_POST_DEINIT(pool_free_hugepage_names);
+
 /* register global config keywords */
 static struct cfg_kw_list mem_cfg_kws = {ILH, {
 	{ CFG_GLOBAL, "tune.fail-alloc", mem_parse_global_fail_alloc },
+	{ CFG_GLOBAL, "tune.pool-hugepages", mem_parse_global_hugepages },
+	{ CFG_GLOBAL, "tune.pool-hugepages-prefault", mem_parse_global_hugepages_prefault },
+	{ CFG_GLOBAL, "tune.pool-profile-rate", mem_parse_global_profile_rate },
 	{ CFG_GLOBAL, "no-memory-trimming", mem_parse_global_no_mem_trim },
 	{ 0, NULL, NULL }
 }};
@@ -24,6 +24,10 @@
 #include <netinet/udp.h>
 #include <netinet/in.h>
 
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif
+
 #include <import/ebtree-t.h>
 
 #include <haproxy/api.h>
@@ -613,6 +617,66 @@ static int quic_test_sock_per_conn_support(struct listener *l)
 	return ret;
 }
 
+#if defined(SO_ATTACH_REUSEPORT_CBPF)
+/* Attaches to the socket of listener <l> a classic BPF program selecting,
+ * among the sockets of its SO_REUSEPORT group, the one of the thread encoded
+ * in the DCID of each received datagram (see quic_get_cid_tid()), so that it
+ * does not have to be redispatched to this thread. This is only possible when
+ * each listener of the bind line is bound to a single thread, as done with
+ * "shards by-thread", since the sockets were added to the group in the order
+ * of their listeners. The datagrams whose DCID does not designate one of these
+ * threads, typically the first ones of a connection, are hashed by the kernel
+ * as usual. Returns 0 on success or if the program does not apply, -1 on
+ * error.
+ */
+static int quic_attach_steering_prog(struct listener *l)
+{
+	struct sock_filter *code;
+	struct sock_fprog prog;
+	struct listener *li;
+	int nb = 0, i = 0, ret;
+
+	list_for_each_entry(li, &l->bind_conf->listeners, by_bind) {
+		if (my_popcountl(li->rx.bind_thread) != 1)
+			return 0;
+		nb++;
+	}
+
+	code = calloc(7 + 2 * nb, sizeof(*code));
+	if (!code)
+		return -1;
+
+	/* the DCID follows the first byte of short header packets, and the
+	 * version and DCID length of long header ones. The thread ID is in the
+	 * 12 lower bits of its first 16 bits (see quic_pin_cid_to_tid()).
+	 */
+	code[i++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0);
+	code[i++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x80, 0, 2);
+	code[i++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6);
+	code[i++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JA, 1, 0, 0);
+	code[i++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 1);
+	code[i++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 4095);
+
+	/* then return the index of the socket of this thread, if any */
+	nb = 0;
+	list_for_each_entry(li, &l->bind_conf->listeners, by_bind) {
+		uint thr = ha_tgroup_info[li->rx.bind_tgroup - 1].base + my_ffsl(li->rx.bind_thread) - 1;
+
+		code[i++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, thr, 0, 1);
+		code[i++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, nb++);
+	}
+
+	/* out of range: the kernel falls back to the hash */
+	code[i++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+
+	prog.len = i;
+	prog.filter = code;
+	ret = setsockopt(l->rx.fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+	free(code);
+	return ret < 0 ? -1 : 0;
+}
+#endif
+
 /* This function tries to bind a QUIC4/6 listener. It may return a warning or
  * an error message in <errmsg> if the message is at most <errlen> bytes long
  * (including '\0'). Note that <errmsg> may be NULL if <errlen> is also zero.
@@ -674,6 +738,18 @@ static int quic_bind_listener(struct listener *listener, char *errmsg, int errle
 			global.tune.options &= ~GTUNE_QUIC_SOCK_PER_CONN;
 	}
 
+	if (global.tune.options & GTUNE_QUIC_SOCK_STEERING) {
+#if defined(SO_ATTACH_REUSEPORT_CBPF)
+		if (quic_attach_steering_prog(listener) < 0) {
+			msg = "cannot attach the socket steering program";
+			err |= ERR_WARN;
+		}
+#else
+		msg = "socket steering is not supported on this platform";
+		err |= ERR_WARN;
+#endif
+	}
+
 	listener_set_state(listener, LI_LISTEN);
 
  udp_return:
@@ -30,6 +30,7 @@
 #include <haproxy/errors.h>
 #include <haproxy/fd.h>
 #include <haproxy/global.h>
+#include <haproxy/hash.h>
 #include <haproxy/list.h>
 #include <haproxy/listener.h>
 #include <haproxy/log.h>
@@ -43,6 +44,9 @@
 #include <haproxy/tools.h>
 
 
+/* number of failed attempts to allocate a source port from a server's range */
+unsigned int tcp_sport_exhausted = 0;
+
 static int tcp_bind_listener(struct listener *listener, char *errmsg, int errlen);
 static int tcp_suspend_receiver(struct receiver *rx);
 static int tcp_resume_receiver(struct receiver *rx);
@@ -227,6 +231,34 @@ int tcp_bind_socket(int fd, int flags, struct sockaddr_storage *local, struct so
 	return 0;
 }
 
+/* Returns the source port range to use for a connection from <src> to <dst>.
+ * When "dst-lanes" is used, destinations are spread over several independent
+ * copies of the range. A given destination always uses the same copy, so that
+ * the same port may be used simultaneously towards different destinations
+ * without ever colliding on a same address/port tuple.
+ */
+static inline struct port_range *tcp_sport_range(const struct conn_src *src,
+                                                 const struct sockaddr_storage *dst)
+{
+	unsigned int hash;
+
+	if (src->nb_sport_lanes <= 1 || !dst)
+		return src->sport_range;
+
+	switch (dst->ss_family) {
+	case AF_INET:
+		hash = hash_crc32((const char *)&((const struct sockaddr_in *)dst)->sin_addr, 4);
+		break;
+	case AF_INET6:
+		hash = hash_crc32((const char *)&((const struct sockaddr_in6 *)dst)->sin6_addr, 16);
+		break;
+	default:
+		return src->sport_range;
+	}
+	hash = full_hash(hash ^ get_host_port(dst));
+	return src->sport_lanes[hash % src->nb_sport_lanes];
+}
+
 /*
  * This function initiates a TCP connection establishment to the target assigned
  * to connection <conn> using (si->{target,dst}). A source address may be
@@ -408,6 +440,7 @@ int tcp_connect_server(struct connection *conn, int flags)
 
 		if (src->sport_range) {
 			int attempts = 10; /* should be more than enough to find a spare port */
+			struct port_range *range = tcp_sport_range(src, conn->dst);
 			struct sockaddr_storage sa;
 
 			ret = 1;
@@ -424,13 +457,14 @@ int tcp_connect_server(struct connection *conn, int flags)
 					break;
 				attempts--;
 
-				fdinfo[fd].local_port = port_range_alloc_port(src->sport_range);
+				fdinfo[fd].local_port = port_range_alloc_port(range);
 				if (!fdinfo[fd].local_port) {
+					_HA_ATOMIC_INC(&tcp_sport_exhausted);
 					conn->err_code = CO_ER_PORT_RANGE;
 					break;
 				}
 
-				fdinfo[fd].port_range = src->sport_range;
+				fdinfo[fd].port_range = range;
 				set_host_port(&sa, fdinfo[fd].local_port);
 
 				ret = tcp_bind_socket(fd, flags, &sa, conn->src);
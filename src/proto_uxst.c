@@ -227,7 +227,13 @@ static int uxst_connect_server(struct connection *conn, int flags)
 		return SF_ERR_INTERNAL;
 	}
 
-	if ((fd = conn->handle.fd = socket(PF_UNIX, SOCK_STREAM, 0)) == -1) {
+#if defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+	/* save the fcntl() calls by creating the socket with its final flags */
+	fd = conn->handle.fd = socket(PF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | (master == 1 ? SOCK_CLOEXEC : 0), 0);
+#else
+	fd = conn->handle.fd = socket(PF_UNIX, SOCK_STREAM, 0);
+#endif
+	if (fd == -1) {
 		qfprintf(stderr, "Cannot get a server socket.\n");
 
 		if (errno == ENFILE) {
@@ -270,6 +276,7 @@ static int uxst_connect_server(struct connection *conn, int flags)
 		return SF_ERR_PRXCOND; /* it is a configuration limit */
 	}
 
+#if !defined(SOCK_NONBLOCK) || !defined(SOCK_CLOEXEC)
 	if (fd_set_nonblock(fd) == -1) {
 		qfprintf(stderr,"Cannot set client socket to non blocking mode.\n");
 		close(fd);
@@ -285,6 +292,7 @@ static int uxst_connect_server(struct connection *conn, int flags)
 		conn->flags |= CO_FL_ERROR;
 		return SF_ERR_INTERNAL;
 	}
+#endif
 
 	if (global.tune.server_sndbuf)
                 setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &global.tune.server_sndbuf, sizeof(global.tune.server_sndbuf));
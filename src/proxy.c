@@ -10,6 +10,7 @@
  *
  */
 
+#include <ctype.h>
 #include <unistd.h>
 #include <string.h>
 #include <sys/types.h>
@@ -18,6 +19,8 @@
 
 #include <import/eb32tree.h>
 #include <import/ebistree.h>
+#include <import/ebsttree.h>
+#include <import/lru.h>
 
 #include <haproxy/acl.h>
 #include <haproxy/api.h>
@@ -34,6 +37,7 @@
 #include <haproxy/listener.h>
 #include <haproxy/log.h>
 #include <haproxy/obj_type-t.h>
+#include <haproxy/pattern.h>
 #include <haproxy/peers.h>
 #include <haproxy/pool.h>
 #include <haproxy/protocol.h>
@@ -41,6 +45,7 @@
 #include <haproxy/proxy.h>
 #include <haproxy/sc_strm.h>
 #include <haproxy/quic_tp.h>
+#include <haproxy/sample.h>
 #include <haproxy/server-t.h>
 #include <haproxy/signal.h>
 #include <haproxy/stats-t.h>
@@ -50,6 +55,7 @@
 #include <haproxy/tcpcheck.h>
 #include <haproxy/time.h>
 #include <haproxy/tools.h>
+#include <haproxy/xxhash.h>
 
 
 int listeners;	/* # of proxy listeners, set by cfgparse */
@@ -58,6 +64,9 @@ struct eb_root used_proxy_id = EB_ROOT;	/* list of proxy IDs in use */
 struct eb_root proxy_by_name = EB_ROOT; /* tree of proxies sorted by name */
 struct eb_root defproxy_by_name = EB_ROOT; /* tree of default proxies sorted by name (dups possible) */
 unsigned int error_snapshot_id = 0;     /* global ID assigned to each error then incremented */
+unsigned int soft_stop_date = 0;        /* date (in seconds) of the beginning of the soft-stop, if any */
+unsigned int soft_stop_idle_closed = 0; /* front connections closed or sent a GOAWAY because of the soft-stop */
+unsigned int soft_stop_kal_closed = 0;  /* HTTP/1 transactions switched to close because of the soft-stop */
 
 /* CLI context used during "show servers {state|conn}" */
 struct show_srv_ctx {
@@ -125,6 +134,7 @@ const struct cfg_opt cfg_opts2[] =
 	{"h1-case-adjust-bogus-client",   PR_O2_H1_ADJ_BUGCLI, PR_CAP_FE, 0, 0 },
 	{"h1-case-adjust-bogus-server",   PR_O2_H1_ADJ_BUGSRV, PR_CAP_BE, 0, 0 },
 	{"disable-h2-upgrade",            PR_O2_NO_H2_UPGRADE, PR_CAP_FE, 0, PR_MODE_HTTP },
+	{ "http-coalesce",                PR_O2_COALESCE,  PR_CAP_BE, 0, PR_MODE_HTTP },
 	{ NULL, 0, 0, 0 }
 };
 
@@ -187,6 +197,12 @@ void free_proxy(struct proxy *p)
 	free(p->conf.uif_file);
 	if ((p->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_MAP)
 		free(p->lbprm.map.srv);
+	else if ((p->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_RDVARR)
+		free(p->lbprm.rdv.area);
+	else if ((p->lbprm.algo & BE_LB_LKUP) == BE_LB_LKUP_MGTBL) {
+		free(p->lbprm.maglev.table);
+		free(p->lbprm.maglev.work);
+	}
 
 	if (p->conf.logformat_sd_string != default_rfc5424_sd_log_format)
 		free(p->conf.logformat_sd_string);
@@ -201,6 +217,8 @@ void free_proxy(struct proxy *p)
 		free(cond);
 	}
 
+	counters_shards_free(&p->fe_counters.shards);
+	counters_shards_free(&p->be_counters.shards);
 	EXTRA_COUNTERS_FREE(p->extra_counters_fe);
 	EXTRA_COUNTERS_FREE(p->extra_counters_be);
 
@@ -230,6 +248,7 @@ void free_proxy(struct proxy *p)
 			prune_acl_cond(rule->cond);
 			free(rule->cond);
 		}
+		switching_run_free(rule->run);
 		free(rule->file);
 		free(rule);
 	}
@@ -326,6 +345,8 @@ void free_proxy(struct proxy *p)
 		LIST_DELETE(&l->by_bind);
 		free(l->name);
 		free(l->per_thr);
+		if (l->counters)
+			counters_shards_free(&l->counters->shards);
 		free(l->counters);
 
 		EXTRA_COUNTERS_FREE(l->extra_counters);
@@ -354,8 +375,7 @@ void free_proxy(struct proxy *p)
 
 	pool_destroy(p->req_cap_pool);
 	pool_destroy(p->rsp_cap_pool);
-	if (p->table)
-		pool_destroy(p->table->pool);
+	stktable_deinit(p->table);
 
 	HA_RWLOCK_DESTROY(&p->lbprm.lock);
 	HA_RWLOCK_DESTROY(&p->lock);
@@ -455,17 +475,20 @@ const char *proxy_find_best_option(const char *word, const char **extra)
 }
 
 /*
- * This function scans the list of backends and servers to retrieve the first
- * backend and the first server with the given names, and sets them in both
- * parameters. It returns zero if either is not found, or non-zero and sets
- * the ones it did not found to NULL. If a NULL pointer is passed for the
- * backend, only the pointer to the server will be updated.
+ * This function looks up the backend and the first server with the given
+ * names, and sets them in both parameters. It returns zero if either is not
+ * found, or non-zero and sets the ones it did not found to NULL. If a NULL
+ * pointer is passed for the backend, only the pointer to the server will be
+ * updated. Servers are looked up in the backend's id and name trees, so this
+ * may only be used once the configuration is fully parsed.
  */
 int get_backend_server(const char *bk_name, const char *sv_name,
 		       struct proxy **bk, struct server **sv)
 {
 	struct proxy *p;
-	struct server *s;
+	struct server *s = NULL;
+	struct eb32_node *id_node;
+	struct ebpt_node *name_node;
 	int sid;
 
 	*sv = NULL;
@@ -480,10 +503,16 @@ int get_backend_server(const char *bk_name, const char *sv_name,
 	if (!p)
 		return 0;
 
-	for (s = p->srv; s; s = s->next)
-		if ((sid >= 0 && s->puid == sid) ||
-		    (sid < 0 && strcmp(s->id, sv_name) == 0))
-			break;
+	if (sid >= 0) {
+		id_node = eb32_lookup(&p->conf.used_server_id, sid);
+		if (id_node)
+			s = container_of(id_node, struct server, conf.id);
+	}
+	else {
+		name_node = ebis_lookup(&p->conf.used_server_name, sv_name);
+		if (name_node)
+			s = container_of(name_node, struct server, conf.name);
+	}
 	*sv = s;
 	if (!s)
 		return 0;
@@ -543,6 +572,10 @@ static int proxy_parse_timeout(char **args, int section, struct proxy *proxy,
 		tv = &proxy->timeout.connect;
 		td = &defpx->timeout.connect;
 		cap = PR_CAP_BE;
+	} else if (strcmp(args[0], "connect-retry") == 0) {
+		tv = &proxy->timeout.connretry;
+		td = &defpx->timeout.connretry;
+		cap = PR_CAP_BE;
 	} else if (strcmp(args[0], "check") == 0) {
 		tv = &proxy->timeout.check;
 		td = &defpx->timeout.check;
@@ -574,7 +607,7 @@ static int proxy_parse_timeout(char **args, int section, struct proxy *proxy,
 		return -1;
 	} else {
 		memprintf(err,
-		          "'timeout' supports 'client', 'server', 'connect', 'check', "
+		          "'timeout' supports 'client', 'server', 'connect', 'connect-retry', 'check', "
 		          "'queue', 'http-keep-alive', 'http-request', 'tunnel', 'tarpit', "
 			  "'client-fin' and 'server-fin' (got '%s')",
 		          args[0]);
@@ -1121,6 +1154,67 @@ struct proxy *proxy_find_by_name(const char *name, int cap, int table)
 	return NULL;
 }
 
+/* Per-thread cache of the backends looked up by name at run time. Proxies are
+ * never released at run time so the cached pointers remain valid, and a hit is
+ * always confirmed by comparing the names to rule out hash collisions.
+ */
+static THREAD_LOCAL struct lru64_head *proxy_be_name_lru;
+
+/* Same as proxy_be_by_name() but first looks the name up in the calling
+ * thread's cache, which is filled with the backends found. It is meant to be
+ * used at run time when backend names are built for each request, such as in
+ * dynamic "use_backend" rules, where it saves the walk down the large names
+ * tree of configurations with many backends.
+ */
+struct proxy *proxy_be_by_name_cached(const char *name)
+{
+	struct lru64_head *head = proxy_be_name_lru;
+	unsigned long long key;
+	struct proxy *px;
+	struct lru64 *lru;
+
+	if (!head || *name == '#')
+		return proxy_be_by_name(name);
+
+	key = XXH3(name, strlen(name), 0);
+	lru = lru64_lookup(key, head, head, 0);
+	if (lru) {
+		px = lru->data;
+		if (strcmp(px->id, name) == 0)
+			return px;
+		/* hash collision, leave the cached entry in place */
+		return proxy_be_by_name(name);
+	}
+
+	/* only existing backends are cached so that unknown names cannot
+	 * evict them.
+	 */
+	px = proxy_be_by_name(name);
+	if (px)
+		lru64_commit(lru64_get(key, head, head, 0), px, head, 0, NULL);
+	return px;
+}
+
+static int proxy_alloc_be_name_cache()
+{
+	if (PROXY_BE_NAME_CACHE_SIZE) {
+		proxy_be_name_lru = lru64_new(PROXY_BE_NAME_CACHE_SIZE);
+		if (!proxy_be_name_lru)
+			return 0;
+	}
+	return 1;
+}
+
+static void proxy_free_be_name_cache()
+{
+	if (proxy_be_name_lru)
+		lru64_destroy(proxy_be_name_lru);
+	proxy_be_name_lru = NULL;
+}
+
+REGISTER_PER_THREAD_ALLOC(proxy_alloc_be_name_cache);
+REGISTER_PER_THREAD_FREE(proxy_free_be_name_cache);
+
 /* Finds the best match for a proxy with capabilities <cap>, name <name> and id
  * <id>. At most one of <id> or <name> may be different provided that <cap> is
  * valid. Either <id> or <name> may be left unspecified (0). The purpose is to
@@ -1280,6 +1374,30 @@ struct server *findserver(const struct proxy *px, const char *name) {
 	return target;
 }
 
+/* Same as findserver() but looks the server up in the proxy's server names
+ * tree instead of walking the whole list. This tree is only filled once the
+ * configuration is fully parsed, so this is meant for run time lookups.
+ */
+struct server *findserver_indexed(const struct proxy *px, const char *name)
+{
+	struct ebpt_node *node;
+
+	if (!px)
+		return NULL;
+
+	node = ebis_lookup((struct eb_root *)&px->conf.used_server_name, name);
+	if (!node)
+		return NULL;
+
+	if (ebpt_next_dup(node)) {
+		ha_alert("Refusing to use duplicated server '%s' found in proxy: %s!\n",
+			 name, px->id);
+		return NULL;
+	}
+
+	return container_of(node, struct server, conf.name);
+}
+
 /* This function checks that the designated proxy has no http directives
  * enabled. It will output a warning if there are, and will fix some of them.
  * It returns the number of fatal errors encountered. This should be called
@@ -1382,6 +1500,12 @@ void init_new_proxy(struct proxy *p)
 	p->extra_counters_fe = NULL;
 	p->extra_counters_be = NULL;
 
+	/* all the proxies are created before the number of threads is known,
+	 * their counters' shards are only queued here.
+	 */
+	counters_shards_init(&p->fe_counters.shards);
+	counters_shards_init(&p->be_counters.shards);
+
 	HA_RWLOCK_INIT(&p->lock);
 }
 
@@ -1521,6 +1645,8 @@ void proxy_free_defaults(struct proxy *defproxy)
 	free_email_alert(defproxy);
 	proxy_release_conf_errors(defproxy);
 	deinit_proxy_tcpcheck(defproxy);
+	counters_shards_free(&defproxy->fe_counters.shards);
+	counters_shards_free(&defproxy->be_counters.shards);
 
 	/* FIXME: we cannot free uri_auth because it might already be used by
 	 * another proxy (legacy code for stats URI ...). Refcount anyone ?
@@ -1796,6 +1922,7 @@ static int proxy_defproxy_cpy(struct proxy *curproxy, const struct proxy *defpro
 
 	if (curproxy->cap & PR_CAP_BE) {
 		curproxy->timeout.connect = defproxy->timeout.connect;
+		curproxy->timeout.connretry = defproxy->timeout.connretry;
 		curproxy->timeout.server = defproxy->timeout.server;
 		curproxy->timeout.serverfin = defproxy->timeout.serverfin;
 		curproxy->timeout.check = defproxy->timeout.check;
@@ -1858,6 +1985,7 @@ static int proxy_defproxy_cpy(struct proxy *curproxy, const struct proxy *defpro
 		}
 		curproxy->comp->algos = defproxy->comp->algos;
 		curproxy->comp->types = defproxy->comp->types;
+		curproxy->comp->cache_size = defproxy->comp->cache_size;
 	}
 
 	if (defproxy->check_path)
@@ -1958,11 +2086,11 @@ void proxy_cond_disable(struct proxy *p)
 	 */
 	if (p->mode == PR_MODE_TCP || p->mode == PR_MODE_HTTP || p->mode == PR_MODE_SYSLOG)
 		ha_warning("Proxy %s stopped (cumulated conns: FE: %lld, BE: %lld).\n",
-			   p->id, p->fe_counters.cum_conn, p->be_counters.cum_conn);
+			   p->id, COUNTERS_GET(&p->fe_counters, cum_conn), COUNTERS_GET(&p->be_counters, cum_conn));
 
 	if (p->mode == PR_MODE_TCP || p->mode == PR_MODE_HTTP)
 		send_log(p, LOG_WARNING, "Proxy %s stopped (cumulated conns: FE: %lld, BE: %lld).\n",
-			 p->id, p->fe_counters.cum_conn, p->be_counters.cum_conn);
+			 p->id, COUNTERS_GET(&p->fe_counters, cum_conn), COUNTERS_GET(&p->be_counters, cum_conn));
 
 	if (p->table && p->table->size && p->table->sync_task)
 		task_wakeup(p->table->sync_task, TASK_WOKEN_MSG);
@@ -2249,6 +2377,7 @@ void soft_stop(void)
 	struct task *task;
 
 	stopping = 1;
+	soft_stop_date = date.tv_sec;
 
 	if (tick_isset(global.grace_delay)) {
 		task = task_new_anywhere();
@@ -2550,6 +2679,213 @@ void proxy_capture_error(struct proxy *proxy, int is_back,
 	ha_free(&es);
 }
 
+/* Returns the ACL expression of switching rule <rule> if its condition is a
+ * single exact string match which may be indexed in a switching_run, with
+ * <icase> set to non-zero if the patterns are case-insensitive, otherwise
+ * NULL.
+ */
+static struct acl_expr *switching_rule_index_expr(const struct switching_rule *rule, int *icase)
+{
+	const struct acl_term_suite *suite;
+	const struct acl_term *term;
+	struct pattern_expr_list *list;
+	struct acl_expr *expr;
+
+	if (!rule->cond || rule->cond->pol != ACL_COND_IF || LIST_ISEMPTY(&rule->cond->suites))
+		return NULL;
+
+	suite = LIST_NEXT(&rule->cond->suites, struct acl_term_suite *, list);
+	if (suite->list.n != &rule->cond->suites || LIST_ISEMPTY(&suite->terms))
+		return NULL;
+
+	term = LIST_NEXT(&suite->terms, struct acl_term *, list);
+	if (term->list.n != &suite->terms || term->neg || LIST_ISEMPTY(&term->acl->expr))
+		return NULL;
+
+	expr = LIST_NEXT(&term->acl->expr, struct acl_expr *, list);
+	if (expr->list.n != &term->acl->expr || !expr->smp->cache_key ||
+	    expr->pat.match != pat_match_str || LIST_ISEMPTY(&expr->pat.head))
+		return NULL;
+
+	/* all patterns must be read from memory with the same case sensitivity */
+	*icase = -1;
+	list_for_each_entry(list, &expr->pat.head, list) {
+		if (!list->expr->ref || list->expr->ref->mmap)
+			return NULL;
+		if (*icase >= 0 && *icase != !!(list->expr->mflags & PAT_MF_IGNORE_CASE))
+			return NULL;
+		*icase = !!(list->expr->mflags & PAT_MF_IGNORE_CASE);
+	}
+	return expr;
+}
+
+/* Indexes the patterns of the run of switching rules from <first> to <last>
+ * all matching the same expression, and attaches the index to <first>. A
+ * pattern present in multiple rules only designates the first one. Returns
+ * non-zero on success or zero on memory allocation failure.
+ */
+static int switching_run_build(struct switching_rule *first, struct switching_rule *last)
+{
+	struct switching_rule *rule = first;
+	struct pattern_expr_list *list;
+	struct switching_key *key;
+	struct switching_run *run;
+	struct pat_ref_elt *elt;
+	struct acl_expr *expr;
+	struct pat_ref *ref;
+	unsigned int rank;
+	size_t len, i;
+
+	run = calloc(1, sizeof(*run));
+	if (!run)
+		return 0;
+
+	run->keys = EB_ROOT_UNIQUE;
+	run->expr = switching_rule_index_expr(first, &run->icase)->smp;
+	run->last = last;
+	run->gen  = pat_ref_watch_gen;
+	first->run = run;
+
+	for (rank = 0; ; rank++) {
+		expr = switching_rule_index_expr(rule, &run->icase);
+		list_for_each_entry(list, &expr->pat.head, list) {
+			ref = list->expr->ref;
+			ref->flags |= PAT_REF_WATCH;
+			list_for_each_entry(elt, &ref->head, list) {
+				if (elt->gen_id != ref->curr_gen)
+					continue;
+
+				len = strlen(elt->pattern);
+				key = malloc(sizeof(*key) + len + 1);
+				if (!key)
+					return 0;
+
+				key->rule = rule;
+				key->rank = rank;
+				for (i = 0; i <= len; i++)
+					key->node.key[i] = run->icase ? tolower((uchar)elt->pattern[i]) : elt->pattern[i];
+
+				if (ebst_insert(&run->keys, &key->node) != &key->node)
+					free(key);
+			}
+		}
+
+		if (rule == last)
+			break;
+		rule = LIST_NEXT(&rule->list, struct switching_rule *, list);
+	}
+	return 1;
+}
+
+/* Releases the index of switching rules run <run>, which may be NULL. */
+void switching_run_free(struct switching_run *run)
+{
+	struct ebmb_node *node, *next;
+
+	if (!run)
+		return;
+
+	for (node = ebmb_first(&run->keys); node; node = next) {
+		next = ebmb_next(node);
+		ebmb_delete(node);
+		free(ebmb_entry(node, struct switching_key, node));
+	}
+	free(run);
+}
+
+/* Indexes all runs of at least MIN_SWITCHING_RUN consecutive switching rules
+ * of proxy <px> which test the same sample expression for exact string
+ * matches. Returns non-zero on success or zero on memory allocation failure.
+ */
+int proxy_index_switching_rules(struct proxy *px)
+{
+	struct switching_rule *rule, *first = NULL, *last = NULL;
+	struct acl_expr *expr, *first_expr = NULL;
+	int icase, first_icase = 0;
+	int count = 0;
+
+	list_for_each_entry(rule, &px->switching_rules, list) {
+		expr = switching_rule_index_expr(rule, &icase);
+		if (expr && first && expr->smp->cache_key == first_expr->smp->cache_key &&
+		    icase == first_icase) {
+			last = rule;
+			count++;
+			continue;
+		}
+
+		if (count >= MIN_SWITCHING_RUN && !switching_run_build(first, last))
+			return 0;
+
+		first = expr ? rule : NULL;
+		first_expr = expr;
+		first_icase = icase;
+		last = rule;
+		count = 1;
+	}
+
+	if (count >= MIN_SWITCHING_RUN && !switching_run_build(first, last))
+		return 0;
+	return 1;
+}
+
+/* Looks up the first rule of the run of switching rules starting at <first>
+ * whose condition matches for stream <s> on frontend <px>. Returns non-zero
+ * with this rule in <match>, or NULL there if none matches. Returns zero if
+ * the index cannot be trusted, in which case the rules must be evaluated one
+ * at a time.
+ */
+int switching_run_match(struct switching_rule *first, struct proxy *px, struct session *sess,
+                        struct stream *s, struct switching_rule **match)
+{
+	const unsigned int opt = SMP_OPT_DIR_REQ | SMP_OPT_FINAL;
+	struct switching_run *run = first->run;
+	struct switching_key *key, *best = NULL;
+	struct ebmb_node *node;
+	struct buffer *trash;
+	struct sample smp;
+	size_t i;
+
+	if (run->gen != HA_ATOMIC_LOAD(&pat_ref_watch_gen))
+		return 0;
+
+	/* same as the ACLs: any of the sample's values may match */
+	memset(&smp, 0, sizeof(smp));
+	while (sample_process_cached(px, sess, s, opt | SMP_OPT_ITERATE, run->expr, &smp)) {
+		if (sample_convert(&smp, SMP_T_STR)) {
+			trash = get_trash_chunk();
+			if (smp.data.u.str.data >= trash->size)
+				return 0;
+
+			for (i = 0; i < smp.data.u.str.data; i++)
+				trash->area[i] = run->icase ? tolower((uchar)smp.data.u.str.area[i]) : smp.data.u.str.area[i];
+			trash->area[i] = 0;
+
+			node = ebst_lookup(&run->keys, trash->area);
+			if (node) {
+				key = ebmb_entry(node, struct switching_key, node);
+				if (!best || key->rank < best->rank)
+					best = key;
+			}
+		}
+
+		if (!(smp.flags & SMP_F_NOT_LAST) || (best && !best->rank))
+			break;
+	}
+
+	*match = NULL;
+	if (!best)
+		return 1;
+
+	/* the pattern may have been deleted since, or the sample may contain
+	 * a zero, so the rule must really match.
+	 */
+	if (!acl_pass(acl_exec_cond(best->rule->cond, px, sess, s, opt)))
+		return 0;
+
+	*match = best->rule;
+	return 1;
+}
+
 /* Configure all proxies which lack a maxconn setting to use the global one by
  * default. This avoids the common mistake consisting in setting maxconn only
  * in the global section and discovering the hard way that it doesn't propagate
@@ -2739,13 +3075,60 @@ static void dump_server_addr(const struct sockaddr_storage *addr, char *addr_str
 	}
 }
 
+/* Fills <out> with the server state line of server <srv> from backend <px>, in
+ * the last known server state file format, including the trailing LF. Names
+ * and addresses are anonymized using <anon_key> if not zero. The line contains
+ * all the parameters which may change during HAProxy runtime, and which can be
+ * used at next startup to recover the same level of server state.
+ */
+void proxy_fill_server_state(struct buffer *out, struct proxy *px, struct server *srv, uint32_t anon_key)
+{
+	char srv_addr[INET6_ADDRSTRLEN + 1];
+	char srv_agent_addr[INET6_ADDRSTRLEN + 1];
+	char srv_check_addr[INET6_ADDRSTRLEN + 1];
+	time_t srv_time_since_last_change;
+	int bk_f_forced_id, srv_f_forced_id;
+	char *srvrecord;
+
+	dump_server_addr(&srv->addr, srv_addr);
+	dump_server_addr(&srv->check.addr, srv_check_addr);
+	dump_server_addr(&srv->agent.addr, srv_agent_addr);
+
+	srv_time_since_last_change = now.tv_sec - srv->last_change;
+	bk_f_forced_id = px->options & PR_O_FORCED_ID ? 1 : 0;
+	srv_f_forced_id = srv->flags & SRV_F_FORCED_ID ? 1 : 0;
+
+	srvrecord = NULL;
+	if (srv->srvrq && srv->srvrq->name)
+		srvrecord = srv->srvrq->name;
+
+	chunk_printf(out,
+	             "%d %s "
+	             "%d %s %s "
+	             "%d %d %d %d %ld "
+	             "%d %d %d %d %d "
+	             "%d %d %s %u "
+	             "%s %d %d "
+	             "%s %s %d"
+	             "\n",
+	             px->uuid, HA_ANON_STR(anon_key, px->id),
+	             srv->puid, HA_ANON_STR(anon_key, srv->id),
+	             hash_ipanon(anon_key, srv_addr, 0),
+	             srv->cur_state, srv->cur_admin, srv->uweight, srv->iweight,
+	             (long int)srv_time_since_last_change,
+	             srv->check.status, srv->check.result, srv->check.health,
+	             srv->check.state & 0x0F, srv->agent.state & 0x1F,
+	             bk_f_forced_id, srv_f_forced_id,
+	             srv->hostname ? HA_ANON_STR(anon_key, srv->hostname) : "-", srv->svc_port,
+	             srvrecord ? srvrecord : "-", srv->use_ssl, srv->check.port,
+	             srv_check_addr, srv_agent_addr, srv->agent.port);
+}
+
 /* dumps server state information for all the servers found in backend cli.p0.
- * These information are all the parameters which may change during HAProxy runtime.
- * By default, we only export to the last known server state file format. These
- * information can be used at next startup to recover same level of server
- * state. It takes its context from show_srv_ctx, with the proxy pointer from
- * ->px, the proxy's id ->only_pxid, the server's pointer from ->sv, and the
- * choice of what to dump from ->show_conn.
+ * By default, we only export to the last known server state file format (see
+ * proxy_fill_server_state()). It takes its context from show_srv_ctx, with the
+ * proxy pointer from ->px, the proxy's id ->only_pxid, the server's pointer
+ * from ->sv, and the choice of what to dump from ->show_conn.
  */
 static int dump_servers_state(struct stconn *sc)
 {
@@ -2754,11 +3137,6 @@ static int dump_servers_state(struct stconn *sc)
 	struct proxy *px = ctx->px;
 	struct server *srv;
 	char srv_addr[INET6_ADDRSTRLEN + 1];
-	char srv_agent_addr[INET6_ADDRSTRLEN + 1];
-	char srv_check_addr[INET6_ADDRSTRLEN + 1];
-	time_t srv_time_since_last_change;
-	int bk_f_forced_id, srv_f_forced_id;
-	char *srvrecord;
 
 	if (!ctx->sv)
 		ctx->sv = px->srv;
@@ -2766,44 +3144,14 @@ static int dump_servers_state(struct stconn *sc)
 	for (; ctx->sv != NULL; ctx->sv = srv->next) {
 		srv = ctx->sv;
 
-		dump_server_addr(&srv->addr, srv_addr);
-		dump_server_addr(&srv->check.addr, srv_check_addr);
-		dump_server_addr(&srv->agent.addr, srv_agent_addr);
-
-		srv_time_since_last_change = now.tv_sec - srv->last_change;
-		bk_f_forced_id = px->options & PR_O_FORCED_ID ? 1 : 0;
-		srv_f_forced_id = srv->flags & SRV_F_FORCED_ID ? 1 : 0;
-
-		srvrecord = NULL;
-		if (srv->srvrq && srv->srvrq->name)
-			srvrecord = srv->srvrq->name;
-
 		if (ctx->show_conn == 0) {
 			/* show servers state */
-			chunk_printf(&trash,
-			             "%d %s "
-			             "%d %s %s "
-			             "%d %d %d %d %ld "
-			             "%d %d %d %d %d "
-			             "%d %d %s %u "
-				     "%s %d %d "
-				     "%s %s %d"
-			             "\n",
-			             px->uuid, HA_ANON_CLI(px->id),
-			             srv->puid, HA_ANON_CLI(srv->id),
-				     hash_ipanon(appctx->cli_anon_key, srv_addr, 0),
-			             srv->cur_state, srv->cur_admin, srv->uweight, srv->iweight,
-				     (long int)srv_time_since_last_change,
-			             srv->check.status, srv->check.result, srv->check.health,
-				     srv->check.state & 0x0F, srv->agent.state & 0x1F,
-			             bk_f_forced_id, srv_f_forced_id,
-				     srv->hostname ? HA_ANON_CLI(srv->hostname) : "-", srv->svc_port,
-			             srvrecord ? srvrecord : "-", srv->use_ssl, srv->check.port,
-				     srv_check_addr, srv_agent_addr, srv->agent.port);
+			proxy_fill_server_state(&trash, px, srv, appctx->cli_anon_key);
 		} else {
 			/* show servers conn */
 			int thr;
 
+			dump_server_addr(&srv->addr, srv_addr);
 			chunk_printf(&trash,
 			             "%s/%s %d/%d %s %u - %u %u %u %u %u %u %d %u",
 			             HA_ANON_CLI(px->id), HA_ANON_CLI(srv->id),
@@ -93,15 +93,246 @@ static uint64_t qpack_get_varint(const unsigned char **buf, uint64_t *len_in, in
 	return 0;
 }
 
-/* Decode an encoder stream.
+/* Encodes <val> with an <n>-bit prefix and the <code> bits merged into the
+ * first byte, at the tail of <out>. Returns 1 on success, 0 if there is not
+ * enough room in <out>.
+ */
+static int qpack_put_varint(struct buffer *out, uint64_t val, int n, unsigned char code)
+{
+	uint64_t max = (1ULL << n) - 1;
+	char tmp[10];
+	size_t len = 0;
+
+	if (val < max) {
+		tmp[len++] = code | val;
+	}
+	else {
+		tmp[len++] = code | max;
+		for (val -= max; val >= 128; val >>= 7)
+			tmp[len++] = val | 128;
+		tmp[len++] = val;
+	}
+
+	if (b_room(out) < len)
+		return 0;
+
+	b_putblk(out, tmp, len);
+	return 1;
+}
+
+/* Reads from <raw> a string literal whose length is encoded with an <n>-bit
+ * prefix, the huffman flag being the bit just above. Huffman-encoded strings
+ * are decoded into <tmp>. <str> points to the result.
  *
- * Returns 0 on success else non-zero.
+ * Returns 1 on success, 0 if the input is truncated, in which case <raw> and
+ * <len> are left in an undefined state, or a negative QPACK_ERR_* on error.
  */
-int qpack_decode_enc(struct buffer *buf, int fin, void *ctx)
+static int qpack_get_str(const unsigned char **raw, uint64_t *len, int n,
+                         struct buffer *tmp, struct ist *str)
 {
-	struct qcs *qcs = ctx;
-	size_t len;
+	unsigned int h;
+	uint64_t slen;
+
+	if (!*len)
+		return 0;
+
+	h = **raw & (1 << n);
+	slen = qpack_get_varint(raw, len, n);
+	if (*len == (uint64_t)-1 || *len < slen)
+		return 0;
+
+	if (h) {
+		char *trash;
+		int nlen;
+
+		trash = chunk_newstr(tmp);
+		if (!trash)
+			return -QPACK_ERR_TOO_LARGE;
+
+		nlen = huff_dec(*raw, slen, trash, tmp->size - tmp->data);
+		if (nlen == (uint32_t)-1)
+			return -QPACK_ERR_HUFFMAN;
+
+		b_add(tmp, nlen);
+		*str = ist2(trash, nlen);
+	}
+	else {
+		*str = ist2(*raw, slen);
+	}
+
+	*raw += slen;
+	*len -= slen;
+	return 1;
+}
+
+/* Copies <str> into <tmp> and makes it point there. This is required before
+ * inserting a string which points to the dynamic table itself. Returns 1 on
+ * success, 0 if <tmp> is full.
+ */
+static int qpack_copy_str(struct buffer *tmp, struct ist *str)
+{
+	char *trash;
+
+	trash = chunk_newstr(tmp);
+	if (!trash || !chunk_memcat(tmp, istptr(*str), istlen(*str)))
+		return 0;
+
+	*str = ist2(trash, istlen(*str));
+	return 1;
+}
+
+/* Returns the dynamic table entry of <dec> with absolute index <abs>, or NULL
+ * if it does not exist (not inserted yet or already evicted).
+ */
+static const struct qpack_dte *qpack_dec_get_dte(const struct qpack_dec *dec, uint64_t abs)
+{
+	if (!dec->dht || abs >= dec->ic || dec->ic - 1 - abs >= dec->dht->used)
+		return NULL;
+
+	return qpack_get_dte(dec->dht, dec->ic - 1 - abs);
+}
+
+/* Inserts <name>:<value> into the dynamic table of <dec>. Returns 0 on success
+ * or a negative value if the entry does not fit.
+ */
+static int qpack_dec_insert(struct qpack_dec *dec, struct ist name, struct ist value)
+{
+	if (!dec->dht || qpack_dht_insert(dec->dht, name, value) < 0)
+		return -1;
+
+	dec->ic++;
+	return 0;
+}
+
+/* Decodes one encoder instruction from <raw> for the decoder context <dec>,
+ * using <tmp> as a temporary storage.
+ *
+ * Returns 1 on success after having updated <raw> and <len>, 0 if the
+ * instruction is truncated, or a negative value on error.
+ */
+static int qpack_decode_enc_inst(struct qpack_dec *dec, const unsigned char **raw,
+                                 uint64_t *len, struct buffer *tmp)
+{
+	const unsigned char *p = *raw;
+	uint64_t l = *len;
+	const struct qpack_dte *dte;
+	struct ist name, value;
+	uint64_t index;
 	unsigned char inst;
+	int ret;
+
+	chunk_reset(tmp);
+	inst = *p;
+	if (inst & QPACK_ENC_INST_IWNR_BIT) {
+		/* Insert With Name Reference */
+		index = qpack_get_varint(&p, &l, 6);
+		if (l == (uint64_t)-1)
+			return 0;
+
+		if (inst & 0x40) {
+			if (index >= QPACK_SHT_SIZE)
+				return -1;
+			name = qpack_sht[index].n;
+		}
+		else {
+			if (!dec->dht || index >= dec->dht->used)
+				return -1;
+			dte = qpack_get_dte(dec->dht, index);
+			name = qpack_get_name(dec->dht, dte);
+			if (!qpack_copy_str(tmp, &name))
+				return -1;
+		}
+
+		ret = qpack_get_str(&p, &l, 7, tmp, &value);
+		if (ret <= 0)
+			return ret;
+
+		qpack_debug_printf(stderr, "[QPACK-DEC-ENC] insert with name ref t=%d index=%llu\n",
+		                   !!(inst & 0x40), (unsigned long long)index);
+		if (qpack_dec_insert(dec, name, value) < 0)
+			return -1;
+	}
+	else if (inst & QPACK_ENC_INST_IWLN_BIT) {
+		/* Insert With Literal Name */
+		ret = qpack_get_str(&p, &l, 5, tmp, &name);
+		if (ret <= 0)
+			return ret;
+
+		ret = qpack_get_str(&p, &l, 7, tmp, &value);
+		if (ret <= 0)
+			return ret;
+
+		qpack_debug_printf(stderr, "[QPACK-DEC-ENC] insert with literal name\n");
+		if (qpack_dec_insert(dec, name, value) < 0)
+			return -1;
+	}
+	else if (inst & QPACK_ENC_INST_SDTC_BIT) {
+		/* Set Dynamic Table Capacity */
+		uint64_t capacity;
+
+		capacity = qpack_get_varint(&p, &l, 5);
+		if (l == (uint64_t)-1)
+			return 0;
+
+		qpack_debug_printf(stderr, "[QPACK-DEC-ENC] set capacity=%llu\n", (unsigned long long)capacity);
+
+		/* RFC9204 4.3.1. Set Dynamic Table Capacity
+		 *
+		 * The decoder MUST treat a new dynamic table capacity value that
+		 * exceeds this limit as a connection error of type
+		 * QPACK_ENCODER_STREAM_ERROR.
+		 */
+		if (capacity > dec->max_cap)
+			return -1;
+
+		if (!dec->dht && capacity) {
+			dec->dht = qpack_dht_alloc();
+			if (!dec->dht)
+				return -1;
+			qpack_dht_init(dec->dht, capacity);
+		}
+		else if (dec->dht && qpack_dht_set_capacity(dec->dht, capacity) < 0)
+			return -1;
+	}
+	else {
+		/* Duplicate */
+		index = qpack_get_varint(&p, &l, 5);
+		if (l == (uint64_t)-1)
+			return 0;
+
+		if (!dec->dht || index >= dec->dht->used)
+			return -1;
+
+		dte = qpack_get_dte(dec->dht, index);
+		name = qpack_get_name(dec->dht, dte);
+		value = qpack_get_value(dec->dht, dte);
+		if (!qpack_copy_str(tmp, &name) || !qpack_copy_str(tmp, &value))
+			return -1;
+
+		qpack_debug_printf(stderr, "[QPACK-DEC-ENC] duplicate index=%llu\n", (unsigned long long)index);
+		if (qpack_dec_insert(dec, name, value) < 0)
+			return -1;
+	}
+
+	*raw = p;
+	*len = l;
+	return 1;
+}
+
+/* Decode an encoder stream <buf> into the dynamic table of <dec>. Only the
+ * complete instructions are consumed, the remaining ones will be parsed once
+ * complete.
+ *
+ * Returns the number of bytes consumed or a negative error, in which case a
+ * connection error is reported.
+ */
+int qpack_decode_enc(struct buffer *buf, int fin, void *ctx, struct qpack_dec *dec)
+{
+	struct qcs *qcs = ctx;
+	struct buffer *tmp = get_trash_chunk();
+	const unsigned char *raw, *start;
+	uint64_t len;
+	int ret;
 
 	/* RFC 9204 4.2. Encoder and Decoder Streams
 	 *
@@ -115,7 +346,8 @@ int qpack_decode_enc(struct buffer *buf, int fin, void *ctx)
 		return -1;
 	}
 
-	len = b_data(buf);
+	len = b_contig_data(buf, 0);
+	start = raw = (const unsigned char *)b_head(buf);
 	qpack_debug_hexdump(stderr, "[QPACK-DEC-ENC] ", b_head(buf), 0, len);
 
 	if (!len) {
@@ -123,31 +355,32 @@ int qpack_decode_enc(struct buffer *buf, int fin, void *ctx)
 		return 0;
 	}
 
-	inst = (unsigned char)*b_head(buf) & QPACK_ENC_INST_BITMASK;
-	if (inst == QPACK_ENC_INST_DUP) {
-		/* Duplicate */
-	}
-	else if (inst & QPACK_ENC_INST_IWNR_BIT) {
-		/* Insert With Name Reference */
-	}
-	else if (inst & QPACK_ENC_INST_IWLN_BIT) {
-		/* Insert with literal name */
-	}
-	else if (inst & QPACK_ENC_INST_SDTC_BIT) {
-		/* Set dynamic table capacity */
+	while (len) {
+		ret = qpack_decode_enc_inst(dec, &raw, &len, tmp);
+		if (!ret)
+			break;
+
+		if (ret < 0) {
+			qcc_emit_cc_app(qcs->qcc, QPACK_ENCODER_STREAM_ERROR, 1);
+			return -1;
+		}
 	}
 
-	return 0;
+	return raw - start;
 }
 
-/* Decode an decoder stream.
+/* Decode an decoder stream. This endpoint never inserts entries into the
+ * encoder's dynamic table, so only Stream Cancellation instructions are
+ * legitimate, and are simply ignored.
  *
- * Returns 0 on success else non-zero.
+ * Returns the number of bytes consumed or a negative error, in which case a
+ * connection error is reported.
  */
 int qpack_decode_dec(struct buffer *buf, int fin, void *ctx)
 {
 	struct qcs *qcs = ctx;
-	size_t len;
+	const unsigned char *raw, *start;
+	uint64_t len;
 	unsigned char inst;
 
 	/* RFC 9204 4.2. Encoder and Decoder Streams
@@ -162,7 +395,8 @@ int qpack_decode_dec(struct buffer *buf, int fin, void *ctx)
 		return -1;
 	}
 
-	len = b_data(buf);
+	len = b_contig_data(buf, 0);
+	start = raw = (const unsigned char *)b_head(buf);
 	qpack_debug_hexdump(stderr, "[QPACK-DEC-DEC] ", b_head(buf), 0, len);
 
 	if (!len) {
@@ -170,18 +404,88 @@ int qpack_decode_dec(struct buffer *buf, int fin, void *ctx)
 		return 0;
 	}
 
-	inst = (unsigned char)*b_head(buf) & QPACK_DEC_INST_BITMASK;
-	if (inst == QPACK_DEC_INST_ICINC) {
-		/* Insert count increment */
-	}
-	else if (inst & QPACK_DEC_INST_SACK) {
-		/* Section Acknowledgment */
-	}
-	else if (inst & QPACK_DEC_INST_SCCL) {
-		/* Stream cancellation */
+	while (len) {
+		const unsigned char *p = raw;
+		uint64_t l = len;
+
+		inst = *p;
+		if (inst & QPACK_DEC_INST_SACK) {
+			/* Section Acknowledgment
+			 *
+			 * RFC 9204 4.4.1. Section Acknowledgment
+			 *
+			 * If an encoder receives a Section Acknowledgment instruction
+			 * referring to a stream on which every encoded field section
+			 * with a non-zero Required Insert Count has already been
+			 * acknowledged, this MUST be treated as a connection error of
+			 * type QPACK_DECODER_STREAM_ERROR.
+			 */
+			goto err;
+		}
+		else if (inst & QPACK_DEC_INST_SCCL) {
+			/* Stream cancellation */
+			qpack_get_varint(&p, &l, 6);
+		}
+		else {
+			/* Insert count increment
+			 *
+			 * RFC 9204 4.4.3. Insert Count Increment
+			 *
+			 * An encoder that receives an Increment field equal to zero,
+			 * or one that increases the Known Received Count beyond what
+			 * the encoder has sent, MUST treat this as a connection error
+			 * of type QPACK_DECODER_STREAM_ERROR.
+			 */
+			goto err;
+		}
+
+		if (l == (uint64_t)-1)
+			break;
+
+		raw = p;
+		len = l;
 	}
 
-	return 0;
+	return raw - start;
+
+ err:
+	qcc_emit_cc_app(qcs->qcc, QPACK_DECODER_STREAM_ERROR, 1);
+	return -1;
+}
+
+/* Encodes into <out> the Insert Count Increment instruction acknowledging the
+ * entries inserted into the dynamic table of <dec> since the last call, if
+ * any. Returns 1 on success or if there was nothing to do, 0 if there is not
+ * enough room in <out>.
+ */
+int qpack_dec_encode_ici(struct qpack_dec *dec, struct buffer *out)
+{
+	if (dec->ic == dec->krc)
+		return 1;
+
+	if (!qpack_put_varint(out, dec->ic - dec->krc, 6, QPACK_DEC_INST_ICINC))
+		return 0;
+
+	dec->krc = dec->ic;
+	return 1;
+}
+
+/* Encodes into <out> the Section Acknowledgment instruction for stream <id>,
+ * whose field section had a Required Insert Count of <ric>. Returns 1 on
+ * success or if the section did not reference the dynamic table, 0 if there
+ * is not enough room in <out>.
+ */
+int qpack_dec_encode_sack(struct qpack_dec *dec, struct buffer *out, uint64_t id, uint64_t ric)
+{
+	if (!ric)
+		return 1;
+
+	if (!qpack_put_varint(out, id, 7, QPACK_DEC_INST_SACK))
+		return 0;
+
+	if (ric > dec->krc)
+		dec->krc = ric;
+	return 1;
 }
 
 /* Decode a field section prefix made of <enc_ric> and <db> two varints.
@@ -203,19 +507,54 @@ static int qpack_decode_fs_pfx(uint64_t *enc_ric, uint64_t *db, int *sign_bit,
 	return 0;
 }
 
+/* Decodes the Required Insert Count of a field section from its encoded value
+ * <enc_ric> (RFC9204 4.5.1.1) for decoder <dec>. Returns 0 on success after
+ * having set <ric>, or a negative value if the encoded value is invalid.
+ */
+static int qpack_decode_ric(const struct qpack_dec *dec, uint64_t enc_ric, uint64_t *ric)
+{
+	uint64_t max_entries, full_range, max_value, max_wrapped;
+
+	*ric = 0;
+	if (!enc_ric)
+		return 0;
+
+	max_entries = dec->max_cap / 32;
+	full_range = 2 * max_entries;
+	if (enc_ric > full_range)
+		return -1;
+
+	max_value = dec->ic + max_entries;
+	max_wrapped = (max_value / full_range) * full_range;
+	*ric = max_wrapped + enc_ric - 1;
+
+	if (*ric > max_value) {
+		if (*ric <= full_range)
+			return -1;
+		*ric -= full_range;
+	}
+
+	return *ric ? 0 : -1;
+}
+
 /* Decode a field section from the <raw> buffer of <len> bytes. Each parsed
  * header is inserted into <list> of <list_size> entries max and uses <tmp> as
  * a storage for some elements pointing into it. An end marker is inserted at
- * the end of the list with empty strings as name/value.
+ * the end of the list with empty strings as name/value. The references to the
+ * dynamic table are resolved using decoder context <dec>, and the Required
+ * Insert Count of the section is stored into <ric> so that the caller may
+ * acknowledge the section.
  *
  * Returns the number of headers inserted into list excluding the end marker.
  * In case of error, a negative code QPACK_ERR_* is returned.
  */
 int qpack_decode_fs(const unsigned char *raw, uint64_t len, struct buffer *tmp,
-                    struct http_hdr *list, int list_size)
+                    struct http_hdr *list, int list_size,
+                    struct qpack_dec *dec, uint64_t *ric)
 {
+	const struct qpack_dte *dte;
 	struct ist name, value;
-	uint64_t enc_ric, db;
+	uint64_t enc_ric, db, base, index;
 	int s;
 	unsigned int efl_type;
 	int ret;
@@ -230,9 +569,31 @@ int qpack_decode_fs(const unsigned char *raw, uint64_t len, struct buffer *tmp,
 		goto out;
 	}
 
+	/* RFC9204 2.1.2. Blocked Streams
+	 *
+	 * If the decoder encounters more blocked streams than it promised to
+	 * support, it MUST treat this as a connection error of type
+	 * QPACK_DECOMPRESSION_FAILED.
+	 *
+	 * No blocked stream is permitted, so the section must only reference
+	 * entries which were already received.
+	 */
+	if (qpack_decode_ric(dec, enc_ric, ric) < 0 || *ric > dec->ic) {
+		qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
+		return -QPACK_DECOMPRESSION_FAILED;
+	}
+
+	if (!s)
+		base = *ric + db;
+	else if (db < *ric)
+		base = *ric - db - 1;
+	else
+		return -QPACK_DECOMPRESSION_FAILED;
+
 	chunk_reset(tmp);
-	qpack_debug_printf(stderr, "enc_ric: %llu db: %llu s=%d\n", 
-	                   (unsigned long long)enc_ric, (unsigned long long)db, !!s);
+	qpack_debug_printf(stderr, "enc_ric: %llu ric: %llu db: %llu s=%d base=%llu\n",
+	                   (unsigned long long)enc_ric, (unsigned long long)*ric,
+	                   (unsigned long long)db, !!s, (unsigned long long)base);
 	/* Decode field lines */
 	while (len) {
 		if (hdr_idx >= list_size) {
@@ -245,61 +606,44 @@ int qpack_decode_fs(const unsigned char *raw, uint64_t len, struct buffer *tmp,
 		efl_type = *raw & QPACK_EFL_BITMASK;
 		qpack_debug_printf(stderr, "efl_type=0x%02x\n", efl_type);
 
-		if (efl_type == QPACK_LFL_WPBNM) {
-			/* Literal field line with post-base name reference
-			 * TODO adjust this when dynamic table support is implemented.
-			 */
-#if 0
-			uint64_t index __maybe_unused, length;
-			unsigned int n __maybe_unused, h __maybe_unused;
+		/* RFC9204 2.2.3 Invalid References
+		 *
+		 * If the decoder encounters a reference in a field line representation
+		 * to a dynamic table entry that has already been evicted or that has an
+		 * absolute index greater than or equal to the declared Required Insert
+		 * Count (Section 4.5.1), it MUST treat this as a connection error of
+		 * type QPACK_DECOMPRESSION_FAILED.
+		 */
+		if (efl_type & QPACK_IFL_BIT) {
+			/* Indexed field line */
+			unsigned int static_tbl;
 
-			qpack_debug_printf(stderr, "literal field line with post-base name reference:");
-			n = *raw & 0x08;
-			index = qpack_get_varint(&raw, &len, 3);
+			qpack_debug_printf(stderr, "indexed field line:");
+			static_tbl = efl_type & 0x40;
+			index = qpack_get_varint(&raw, &len, 6);
 			if (len == (uint64_t)-1) {
 				qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
 				ret = -QPACK_ERR_TRUNCATED;
 				goto out;
 			}
 
-			qpack_debug_printf(stderr, " n=%d index=%llu", !!n, (unsigned long long)index);
-			h = *raw & 0x80;
-			length = qpack_get_varint(&raw, &len, 7);
-			if (len == (uint64_t)-1) {
-				qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-				ret = -QPACK_ERR_TRUNCATED;
-				goto out;
+			qpack_debug_printf(stderr,  " t=%d index=%llu", !!static_tbl, (unsigned long long)index);
+			if (static_tbl) {
+				if (index >= QPACK_SHT_SIZE)
+					return -QPACK_DECOMPRESSION_FAILED;
+				name = qpack_sht[index].n;
+				value = qpack_sht[index].v;
 			}
-
-			qpack_debug_printf(stderr, " h=%d length=%llu", !!h, (unsigned long long)length);
-
-			if (len < length) {
-				qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-				ret = -QPACK_ERR_TRUNCATED;
-				goto out;
+			else {
+				if (index >= base || base - 1 - index >= *ric ||
+				    !(dte = qpack_dec_get_dte(dec, base - 1 - index)))
+					return -QPACK_DECOMPRESSION_FAILED;
+				name = qpack_get_name(dec->dht, dte);
+				value = qpack_get_value(dec->dht, dte);
 			}
-
-			raw += length;
-			len -= length;
-#endif
-
-			/* RFC9204 2.2.3 Invalid References
-			 *
-			 * If the decoder encounters a reference in a field line representation
-			 * to a dynamic table entry that has already been evicted or that has an
-			 * absolute index greater than or equal to the declared Required Insert
-			 * Count (Section 4.5.1), it MUST treat this as a connection error of
-			 * type QPACK_DECOMPRESSION_FAILED.
-			 */
-			return -QPACK_DECOMPRESSION_FAILED;
 		}
 		else if (efl_type == QPACK_IFL_WPBI) {
-			/* Indexed field line with post-base index
-			 * TODO adjust this when dynamic table support is implemented.
-			 */
-#if 0
-			uint64_t index __maybe_unused;
-
+			/* Indexed field line with post-base index */
 			qpack_debug_printf(stderr, "indexed field line with post-base index:");
 			index = qpack_get_varint(&raw, &len, 4);
 			if (len == (uint64_t)-1) {
@@ -309,233 +653,80 @@ int qpack_decode_fs(const unsigned char *raw, uint64_t len, struct buffer *tmp,
 			}
 
 			qpack_debug_printf(stderr, " index=%llu", (unsigned long long)index);
-#endif
-
-			/* RFC9204 2.2.3 Invalid References
-			 *
-			 * If the decoder encounters a reference in a field line representation
-			 * to a dynamic table entry that has already been evicted or that has an
-			 * absolute index greater than or equal to the declared Required Insert
-			 * Count (Section 4.5.1), it MUST treat this as a connection error of
-			 * type QPACK_DECOMPRESSION_FAILED.
-			 */
-			return -QPACK_DECOMPRESSION_FAILED;
+			if (base + index >= *ric || !(dte = qpack_dec_get_dte(dec, base + index)))
+				return -QPACK_DECOMPRESSION_FAILED;
+			name = qpack_get_name(dec->dht, dte);
+			value = qpack_get_value(dec->dht, dte);
 		}
-		else if (efl_type & QPACK_IFL_BIT) {
-			/* Indexed field line */
-			uint64_t index;
+		else if (efl_type & QPACK_LFL_WNR_BIT || efl_type == QPACK_LFL_WPBNM) {
+			/* Literal field line with name reference, or with
+			 * post-base name reference.
+			 */
 			unsigned int static_tbl;
 
-			qpack_debug_printf(stderr, "indexed field line:");
-			static_tbl = efl_type & 0x40;
-			index = qpack_get_varint(&raw, &len, 6);
-			if (len == (uint64_t)-1) {
-				qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-				ret = -QPACK_ERR_TRUNCATED;
-				goto out;
-			}
-
-			if (static_tbl) {
-				name = qpack_sht[index].n;
-				value = qpack_sht[index].v;
+			if (efl_type & QPACK_LFL_WNR_BIT) {
+				qpack_debug_printf(stderr, "Literal field line with name reference:");
+				static_tbl = efl_type & 0x10;
+				index = qpack_get_varint(&raw, &len, 4);
 			}
 			else {
-				/* RFC9204 2.2.3 Invalid References
-				 *
-				 * If the decoder encounters a reference in a field line representation
-				 * to a dynamic table entry that has already been evicted or that has an
-				 * absolute index greater than or equal to the declared Required Insert
-				 * Count (Section 4.5.1), it MUST treat this as a connection error of
-				 * type QPACK_DECOMPRESSION_FAILED.
-				 *
-				 * TODO adjust this when dynamic table support is implemented.
-				 */
-				return -QPACK_DECOMPRESSION_FAILED;
+				qpack_debug_printf(stderr, "Literal field line with post-base name reference:");
+				static_tbl = 0;
+				index = qpack_get_varint(&raw, &len, 3);
 			}
 
-			qpack_debug_printf(stderr,  " t=%d index=%llu", !!static_tbl, (unsigned long long)index);
-		}
-		else if (efl_type & QPACK_LFL_WNR_BIT) {
-			/* Literal field line with name reference */
-			uint64_t index, length;
-			unsigned int static_tbl, n __maybe_unused, h;
-
-			qpack_debug_printf(stderr, "Literal field line with name reference:");
-			n = efl_type & 0x20;
-			static_tbl = efl_type & 0x10;
-			index = qpack_get_varint(&raw, &len, 4);
 			if (len == (uint64_t)-1) {
 				qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
 				ret = -QPACK_ERR_TRUNCATED;
 				goto out;
 			}
 
+			qpack_debug_printf(stderr, " t=%d index=%llu", !!static_tbl, (unsigned long long)index);
 			if (static_tbl) {
+				if (index >= QPACK_SHT_SIZE)
+					return -QPACK_DECOMPRESSION_FAILED;
 				name = qpack_sht[index].n;
 			}
 			else {
-				/* RFC9204 2.2.3 Invalid References
-				 *
-				 * If the decoder encounters a reference in a field line representation
-				 * to a dynamic table entry that has already been evicted or that has an
-				 * absolute index greater than or equal to the declared Required Insert
-				 * Count (Section 4.5.1), it MUST treat this as a connection error of
-				 * type QPACK_DECOMPRESSION_FAILED.
-				 *
-				 * TODO adjust this when dynamic table support is implemented.
-				 */
-				return -QPACK_DECOMPRESSION_FAILED;
-			}
-
-			qpack_debug_printf(stderr, " n=%d t=%d index=%llu", !!n, !!static_tbl, (unsigned long long)index);
-			h = *raw & 0x80;
-			length = qpack_get_varint(&raw, &len, 7);
-			if (len == (uint64_t)-1) {
-				qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-				ret = -QPACK_ERR_TRUNCATED;
-				goto out;
-			}
-
-			qpack_debug_printf(stderr, " h=%d length=%llu", !!h, (unsigned long long)length);
-			if (h) {
-				char *trash;
-				int nlen;
-
-				trash = chunk_newstr(tmp);
-				if (!trash) {
-					qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-					ret = -QPACK_DECOMPRESSION_FAILED;
-					goto out;
+				if (efl_type & QPACK_LFL_WNR_BIT) {
+					if (index >= base)
+						return -QPACK_DECOMPRESSION_FAILED;
+					index = base - 1 - index;
 				}
-				nlen = huff_dec(raw, length, trash, tmp->size - tmp->data);
-				if (nlen == (uint32_t)-1) {
-					qpack_debug_printf(stderr, " can't decode huffman.\n");
-					ret = -QPACK_ERR_HUFFMAN;
-					goto out;
+				else {
+					index = base + index;
 				}
 
-				qpack_debug_printf(stderr, " [name huff %d->%d '%s']", (int)length, (int)nlen, trash);
-				/* makes an ist from tmp storage */
-				b_add(tmp, nlen);
-				value = ist2(trash, nlen);
-			}
-			else {
-				value = ist2(raw, length);
+				if (index >= *ric || !(dte = qpack_dec_get_dte(dec, index)))
+					return -QPACK_DECOMPRESSION_FAILED;
+				name = qpack_get_name(dec->dht, dte);
 			}
 
-			if (len < length) {
+			ret = qpack_get_str(&raw, &len, 7, tmp, &value);
+			if (ret <= 0) {
 				qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-				ret = -QPACK_ERR_TRUNCATED;
+				ret = ret ? ret : -QPACK_ERR_TRUNCATED;
 				goto out;
 			}
-
-			raw += length;
-			len -= length;
 		}
 		else if (efl_type & QPACK_LFL_WLN_BIT) {
 			/* Literal field line with literal name */
-			unsigned int n __maybe_unused, hname, hvalue;
-			uint64_t name_len, value_len;
-
 			qpack_debug_printf(stderr, "Literal field line with literal name:");
-			n = *raw & 0x10;
-			hname = *raw & 0x08;
-			name_len = qpack_get_varint(&raw, &len, 3);
-			if (len == (uint64_t)-1) {
-				qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-				ret = -QPACK_ERR_TRUNCATED;
-				goto out;
-			}
-
-			qpack_debug_printf(stderr, " n=%d hname=%d name_len=%llu", !!n, !!hname, (unsigned long long)name_len);
-			/* Name string */
-
-			if (len < name_len) {
-				qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-				ret = -QPACK_ERR_TRUNCATED;
-				goto out;
-			}
-
-			if (hname) {
-				char *trash;
-				int nlen;
-
-				trash = chunk_newstr(tmp);
-				if (!trash) {
-					qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-					ret = -QPACK_DECOMPRESSION_FAILED;
-					goto out;
-				}
-				nlen = huff_dec(raw, name_len, trash, tmp->size - tmp->data);
-				if (nlen == (uint32_t)-1) {
-					qpack_debug_printf(stderr, " can't decode huffman.\n");
-					ret = -QPACK_ERR_HUFFMAN;
-					goto out;
-				}
-
-				qpack_debug_printf(stderr, " [name huff %d->%d '%s']", (int)name_len, (int)nlen, trash);
-				/* makes an ist from tmp storage */
-				b_add(tmp, nlen);
-				name = ist2(trash, nlen);
-			}
-			else {
-				name = ist2(raw, name_len);
-			}
-
-			raw += name_len;
-			len -= name_len;
-
-			hvalue = *raw & 0x80;
-			value_len = qpack_get_varint(&raw, &len, 7);
-			if (len == (uint64_t)-1) {
+			ret = qpack_get_str(&raw, &len, 3, tmp, &name);
+			if (ret > 0)
+				ret = qpack_get_str(&raw, &len, 7, tmp, &value);
+			if (ret <= 0) {
 				qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-				ret = -QPACK_ERR_TRUNCATED;
+				ret = ret ? ret : -QPACK_ERR_TRUNCATED;
 				goto out;
 			}
-
-			qpack_debug_printf(stderr, " hvalue=%d value_len=%llu", !!hvalue, (unsigned long long)value_len);
-
-			if (len < value_len) {
-				qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-				ret = -QPACK_ERR_TRUNCATED;
-				goto out;
-			}
-
-			if (hvalue) {
-				char *trash;
-				int nlen;
-
-				trash = chunk_newstr(tmp);
-				if (!trash) {
-					qpack_debug_printf(stderr, "##ERR@%d\n", __LINE__);
-					ret = -QPACK_DECOMPRESSION_FAILED;
-					goto out;
-				}
-				nlen = huff_dec(raw, value_len, trash, tmp->size - tmp->data);
-				if (nlen == (uint32_t)-1) {
-					qpack_debug_printf(stderr, " can't decode huffman.\n");
-					ret = -QPACK_ERR_HUFFMAN;
-					goto out;
-				}
-
-				qpack_debug_printf(stderr, " [name huff %d->%d '%s']", (int)value_len, (int)nlen, trash);
-				/* makes an ist from tmp storage */
-				b_add(tmp, nlen);
-				value = ist2(trash, nlen);
-			}
-			else {
-				value = ist2(raw, value_len);
-			}
-
-			raw += value_len;
-			len -= value_len;
 		}
 
 		list[hdr_idx].n = name;
 		list[hdr_idx].v = value;
 		++hdr_idx;
 
-		qpack_debug_printf(stderr, "\n");
+		qpack_debug_printf(stderr, " [%.*s: %.*s]\n", (int)name.len, name.ptr, (int)value.len, value.ptr);
 	}
 
 	if (hdr_idx >= list_size) {
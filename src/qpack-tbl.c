@@ -152,8 +152,8 @@ void qpack_dht_dump(FILE *out, const struct qpack_dht *dht)
 	unsigned int slot;
 	char name[4096], value[4096];
 
-	for (i = QPACK_SHT_SIZE; i < QPACK_SHT_SIZE + dht->used; i++) {
-		slot = (qpack_get_dte(dht, i - QPACK_SHT_SIZE + 1) - dht->dte);
+	for (i = 0; i < dht->used; i++) {
+		slot = (qpack_get_dte(dht, i) - dht->dte);
 		fprintf(out, "idx=%u slot=%u name=<%s> value=<%s> addr=%u-%u\n",
 			i, slot,
 			istpad(name, qpack_idx_to_name(dht, i)).ptr,
@@ -212,6 +212,8 @@ static struct qpack_dht *qpack_dht_defrag(struct qpack_dht *dht)
 	if (!alt_dht)
 		return NULL;
 
+	/* the table may be smaller than the pool's objects */
+	alt_dht->size = dht->size;
 	alt_dht->total = dht->total;
 	alt_dht->used = dht->used;
 	alt_dht->wrap = dht->used;
@@ -281,8 +283,39 @@ int __qpack_dht_make_room(struct qpack_dht *dht, unsigned int needed)
 	return needed + 32 <= dht->size;
 }
 
+/* Sets the capacity of table <dht> to <capacity> bytes, evicting the oldest
+ * entries which do not fit anymore. The capacity must not be larger than the
+ * table's pool objects. Returns 0 on success or a negative value if the table
+ * could not be realigned.
+ */
+int qpack_dht_set_capacity(struct qpack_dht *dht, uint32_t capacity)
+{
+	unsigned int tail;
+
+	while (dht->used && dht->used * 32 + dht->total > capacity) {
+		tail = qpack_dht_get_tail(dht);
+		dht->total -= dht->dte[tail].nlen + dht->dte[tail].vlen;
+		if (tail == dht->front)
+			dht->front = dht->head;
+		dht->used--;
+	}
+
+	if (!dht->used) {
+		dht->front = dht->head = 0;
+		dht->size = capacity;
+		return 0;
+	}
+
+	/* the remaining entries must be moved within the new size */
+	if (dht->head + 1U >= dht->used)
+		dht->wrap = dht->head + 1;
+	dht->size = capacity;
+	return qpack_dht_defrag(dht) ? 0 : -1;
+}
+
 /* tries to insert a new header <name>:<value> in front of the current head. A
- * negative value is returned on error.
+ * negative value is returned on error, including when the entry is larger
+ * than the table.
  */
 int qpack_dht_insert(struct qpack_dht *dht, struct ist name, struct ist value)
 {
@@ -294,7 +327,7 @@ int qpack_dht_insert(struct qpack_dht *dht, struct ist name, struct ist value)
 	uint32_t headroom, tailroom;
 
 	if (!qpack_dht_make_room(dht, name.len + value.len))
-		return 0;
+		return -1;
 
 	/* Now there is enough room in the table, that's guaranteed by the
 	 * protocol, but not necessarily where we need it.
@@ -394,6 +427,8 @@ int qpack_dht_insert(struct qpack_dht *dht, struct ist name, struct ist value)
 	else {
 		/* need to defragment the table before inserting upfront */
 		dht = qpack_dht_defrag(dht);
+		if (!dht)
+			return -1;
 		wrap = dht->wrap + 1;
 		head = dht->head + 1;
 		dht->dte[head].addr = dht->dte[dht->front].addr - (name.len + value.len);
@@ -31,15 +31,28 @@
  *     assigned server when the pendconn is picked.
  *
  * Threads complicate the design a little bit but rules remain simple :
- *   - the server's queue lock must be held at least when manipulating the
- *     server's queue, which is when adding a pendconn to the queue and when
- *     removing a pendconn from the queue. It protects the queue's integrity.
+ *   - each queue is split in one part per thread group, each with its own
+ *     tree and lock. A pendconn is always queued into the part of the thread
+ *     group of its stream (p->tgrp), so that queuing streams only compete
+ *     with the threads of their group.
  *
- *   - the proxy's queue lock must be held at least when manipulating the
- *     proxy's queue, which is when adding a pendconn to the queue and when
- *     removing a pendconn from the queue. It protects the queue's integrity.
+ *   - the lock of a queue's part must be held at least when manipulating
+ *     this part, which is when adding a pendconn to the queue and when
+ *     removing a pendconn from the queue. It protects the part's integrity.
+ *     Below, "the queue's lock" designates the lock of the part the pendconn
+ *     belongs to.
  *
- *   - both locks are compatible and may be held at the same time.
+ *   - when looking for the next pendconn to serve, all the parts of a queue
+ *     are visited in ascending order, and only the lock of the part holding
+ *     the best candidate so far remains held. So parts of the same queue are
+ *     always locked in the same order.
+ *
+ *   - the server's and the proxy's locks are compatible and may be held at
+ *     the same time, the server's one always being taken first.
+ *
+ *   - the queue's own lock (q->lock) is not used to manipulate the trees, it
+ *     only serializes the threads dequeuing entries from a server in
+ *     process_srv_queue().
  *
  *   - a pendconn_add() is only performed by the stream which will own the
  *     pendconn ; the pendconn is allocated at this moment and returned ; it is
@@ -72,17 +85,19 @@ s *     queue's lock.
 #include <import/eb32tree.h>
 #include <haproxy/api.h>
 #include <haproxy/backend.h>
+#include <haproxy/global.h>
 #include <haproxy/http_rules.h>
 #include <haproxy/pool.h>
 #include <haproxy/queue.h>
 #include <haproxy/sample.h>
-#include <haproxy/server-t.h>
+#include <haproxy/server.h>
 #include <haproxy/stream.h>
 #include <haproxy/task.h>
 #include <haproxy/tcp_rules.h>
 #include <haproxy/thread.h>
 #include <haproxy/time.h>
 #include <haproxy/tools.h>
+#include <haproxy/usdt.h>
 
 
 #define NOW_OFFSET_BOUNDARY()          ((now_ms - (TIMER_LOOK_BACK >> 12)) & 0xfffff)
@@ -93,6 +108,24 @@ s *     queue's lock.
 
 DECLARE_POOL(pool_head_pendconn, "pendconn", sizeof(struct pendconn));
 
+/* Reports a QUEUE_HIGH event when the queue of server <srv> just went from
+ * <prev> to <curr> entries and crossed the tune.events.queue-threshold value
+ * upwards, or a QUEUE_LOW event when it crossed it downwards. Nothing is done
+ * when the threshold is not set.
+ */
+static inline void srv_queue_evt_check(struct server *srv, uint prev, uint curr)
+{
+	uint thr = global.tune.srv_queue_evt;
+
+	if (likely(!thr))
+		return;
+
+	if (prev < thr && curr >= thr)
+		srv_event_hdl_publish(EVENT_HDL_SUB_SERVER_QUEUE_HIGH, srv);
+	else if (prev >= thr && curr < thr)
+		srv_event_hdl_publish(EVENT_HDL_SUB_SERVER_QUEUE_LOW, srv);
+}
+
 /* returns the effective dynamic maxconn for a server, considering the minconn
  * and the proxy's usage relative to its dynamic connections limit. It is
  * expected that 0 < s->minconn <= s->maxconn when this is called. If the
@@ -155,7 +188,7 @@ static void __pendconn_unlink_prx(struct pendconn *p)
  */
 static inline void pendconn_queue_lock(struct pendconn *p)
 {
-	HA_SPIN_LOCK(QUEUE_LOCK, &p->queue->lock);
+	HA_SPIN_LOCK(QUEUE_LOCK, &p->tgrp->lock);
 }
 
 /* Unlocks the queue the pendconn element belongs to. This relies on both p->px
@@ -164,7 +197,7 @@ static inline void pendconn_queue_lock(struct pendconn *p)
  */
 static inline void pendconn_queue_unlock(struct pendconn *p)
 {
-	HA_SPIN_UNLOCK(QUEUE_LOCK, &p->queue->lock);
+	HA_SPIN_UNLOCK(QUEUE_LOCK, &p->tgrp->lock);
 }
 
 /* Removes the pendconn from the server/proxy queue. At this stage, the
@@ -184,7 +217,7 @@ void pendconn_unlink(struct pendconn *p)
 	int done = 0;
 
 	oldidx = _HA_ATOMIC_LOAD(&p->queue->idx);
-	HA_SPIN_LOCK(QUEUE_LOCK, &q->lock);
+	pendconn_queue_lock(p);
 	HA_SPIN_LOCK(QUEUE_LOCK, &p->del_lock);
 
 	if (p->node.node.leaf_p) {
@@ -193,7 +226,7 @@ void pendconn_unlink(struct pendconn *p)
 	}
 
 	HA_SPIN_UNLOCK(QUEUE_LOCK, &p->del_lock);
-	HA_SPIN_UNLOCK(QUEUE_LOCK, &q->lock);
+	pendconn_queue_unlock(p);
 
 	if (done) {
 		oldidx -= p->queue_idx;
@@ -202,7 +235,13 @@ void pendconn_unlink(struct pendconn *p)
 		else
 			p->strm->logs.prx_queue_pos += oldidx;
 
-		_HA_ATOMIC_DEC(&q->length);
+		if (sv) {
+			uint len = _HA_ATOMIC_SUB_FETCH(&q->length, 1);
+
+			srv_queue_evt_check(sv, len + 1, len);
+		}
+		else
+			_HA_ATOMIC_DEC(&q->length);
 		_HA_ATOMIC_DEC(&px->totpend);
 	}
 }
@@ -234,6 +273,60 @@ static struct pendconn *pendconn_first(struct eb_root *pendconns)
 	return eb32_entry(node2, struct pendconn, node);
 }
 
+/* Returns non-zero if pendconn <a> must be served before pendconn <b>. Classes
+ * are compared first, then the time offsets, which may wrap.
+ */
+static inline int pendconn_before(const struct pendconn *a, const struct pendconn *b)
+{
+	u32 akey, bkey;
+
+	if (KEY_CLASS(a->node.key) != KEY_CLASS(b->node.key))
+		return KEY_CLASS(a->node.key) < KEY_CLASS(b->node.key);
+
+	akey = KEY_OFFSET(a->node.key);
+	bkey = KEY_OFFSET(b->node.key);
+
+	if (akey < NOW_OFFSET_BOUNDARY())
+		akey += 0x100000; // key in the future
+
+	if (bkey < NOW_OFFSET_BOUNDARY())
+		bkey += 0x100000; // key in the future
+
+	return akey <= bkey;
+}
+
+/* Retrieve the first pendconn to serve among all the thread groups parts of
+ * queue <q>. The parts are visited in ascending order, and only the lock of
+ * the part holding the best candidate is kept. On success, the pendconn is
+ * returned with the lock of its part (p->tgrp) held, and it is up to the
+ * caller to release it. NULL is returned with no lock held if the queue is
+ * empty. Empty parts are skipped without being locked, so an entry being
+ * added concurrently may be missed, just like when checking q->length.
+ */
+static struct pendconn *queue_first(struct queue *q)
+{
+	struct pendconn *p = NULL, *cand;
+	int grp;
+
+	for (grp = 0; grp < global.nbtgroups; grp++) {
+		struct queue_tgrp *qg = &q->tgrp[grp];
+
+		if (eb_is_empty(&qg->head))
+			continue;
+
+		HA_SPIN_LOCK(QUEUE_LOCK, &qg->lock);
+		cand = pendconn_first(&qg->head);
+		if (cand && (!p || pendconn_before(cand, p))) {
+			if (p)
+				HA_SPIN_UNLOCK(QUEUE_LOCK, &p->tgrp->lock);
+			p = cand;
+		}
+		else
+			HA_SPIN_UNLOCK(QUEUE_LOCK, &qg->lock);
+	}
+	return p;
+}
+
 /* Process the next pending connection from either a server or a proxy, and
  * returns a strictly positive value on success (see below). If no pending
  * connection is found, 0 is returned.  Note that neither <srv> nor <px> may be
@@ -249,8 +342,9 @@ static struct pendconn *pendconn_first(struct eb_root *pendconns)
  *
  * The proxy's queue will be consulted only if px_ok is non-zero.
  *
- * This function must only be called if the server queue is locked _AND_ the
- * proxy queue is not. Today it is only called by process_srv_queue.
+ * This function must only be called with the server queue's dequeuing lock
+ * held, and none of the parts of the server and proxy queues locked. Today it
+ * is only called by process_srv_queue.
  * When a pending connection is dequeued, this function returns 1 if a pendconn
  * is dequeued, otherwise 0.
  */
@@ -258,22 +352,18 @@ static int pendconn_process_next_strm(struct server *srv, struct proxy *px, int
 {
 	struct pendconn *p = NULL;
 	struct pendconn *pp = NULL;
-	u32 pkey, ppkey;
+	uint len;
 
+	/* the locks of the parts of the queues only remain held as long as
+	 * <p> and <pp> are in them.
+	 */
 	p = NULL;
 	if (srv->queue.length)
-		p = pendconn_first(&srv->queue.head);
+		p = queue_first(&srv->queue);
 
 	pp = NULL;
-	if (px_ok && px->queue.length) {
-		/* the lock only remains held as long as the pp is
-		 * in the proxy's queue.
-		 */
-		HA_SPIN_LOCK(QUEUE_LOCK,  &px->queue.lock);
-		pp = pendconn_first(&px->queue.head);
-		if (!pp)
-			HA_SPIN_UNLOCK(QUEUE_LOCK,  &px->queue.lock);
-	}
+	if (px_ok && px->queue.length)
+		pp = queue_first(&px->queue);
 
 	if (!p && !pp)
 		return 0;
@@ -284,23 +374,11 @@ static int pendconn_process_next_strm(struct server *srv, struct proxy *px, int
 
 	/* p != NULL && pp != NULL*/
 
-	if (KEY_CLASS(p->node.key) < KEY_CLASS(pp->node.key))
+	if (pendconn_before(p, pp))
 		goto use_p;
 
-	if (KEY_CLASS(pp->node.key) < KEY_CLASS(p->node.key))
-		goto use_pp;
-
-	pkey  = KEY_OFFSET(p->node.key);
-	ppkey = KEY_OFFSET(pp->node.key);
-
-	if (pkey < NOW_OFFSET_BOUNDARY())
-		pkey += 0x100000; // key in the future
-
-	if (ppkey < NOW_OFFSET_BOUNDARY())
-		ppkey += 0x100000; // key in the future
-
-	if (pkey <= ppkey)
-		goto use_p;
+	/* we don't need the server's part lock anymore */
+	HA_SPIN_UNLOCK(QUEUE_LOCK, &p->tgrp->lock);
 
  use_pp:
 	/* we'd like to release the proxy lock ASAP to let other threads
@@ -311,7 +389,7 @@ static int pendconn_process_next_strm(struct server *srv, struct proxy *px, int
 
 	/* now the element won't go, we can release the proxy */
 	__pendconn_unlink_prx(pp);
-	HA_SPIN_UNLOCK(QUEUE_LOCK, &px->queue.lock);
+	HA_SPIN_UNLOCK(QUEUE_LOCK, &pp->tgrp->lock);
 
 	pp->strm_flags |= SF_ASSIGNED;
 	pp->target = srv;
@@ -332,7 +410,7 @@ static int pendconn_process_next_strm(struct server *srv, struct proxy *px, int
  use_p:
 	/* we don't need the px queue lock anymore, we have the server's lock */
 	if (pp)
-		HA_SPIN_UNLOCK(QUEUE_LOCK, &px->queue.lock);
+		HA_SPIN_UNLOCK(QUEUE_LOCK, &pp->tgrp->lock);
 
 	p->strm_flags |= SF_ASSIGNED;
 	p->target = srv;
@@ -345,8 +423,10 @@ static int pendconn_process_next_strm(struct server *srv, struct proxy *px, int
 	 */
 	task_wakeup(p->strm->task, TASK_WOKEN_RES);
 	__pendconn_unlink_srv(p);
+	HA_SPIN_UNLOCK(QUEUE_LOCK, &p->tgrp->lock);
 
-	_HA_ATOMIC_DEC(&srv->queue.length);
+	len = _HA_ATOMIC_SUB_FETCH(&srv->queue.length, 1);
+	srv_queue_evt_check(srv, len + 1, len);
 	_HA_ATOMIC_INC(&srv->queue.idx);
 	return 1;
 }
@@ -461,6 +541,7 @@ struct pendconn *pendconn_add(struct stream *strm)
 	}
 
 	p->queue = q;
+	p->tgrp  = &q->tgrp[tgid - 1];
 	p->queue_idx  = _HA_ATOMIC_LOAD(&q->idx) - 1; // for logging only
 	new_max = _HA_ATOMIC_ADD_FETCH(&q->length, 1);
 	old_max = _HA_ATOMIC_LOAD(max_ptr);
@@ -470,48 +551,60 @@ struct pendconn *pendconn_add(struct stream *strm)
 	}
 	__ha_barrier_atomic_store();
 
-	HA_SPIN_LOCK(QUEUE_LOCK, &q->lock);
-	eb32_insert(&q->head, &p->node);
-	HA_SPIN_UNLOCK(QUEUE_LOCK, &q->lock);
+	HA_SPIN_LOCK(QUEUE_LOCK, &p->tgrp->lock);
+	eb32_insert(&p->tgrp->head, &p->node);
+	HA_SPIN_UNLOCK(QUEUE_LOCK, &p->tgrp->lock);
+
+	if (srv)
+		srv_queue_evt_check(srv, new_max - 1, new_max);
 
 	_HA_ATOMIC_INC(&px->totpend);
+	HA_USDT(queue_enter, strm, px, srv, new_max, p->node.key);
 	return p;
 }
 
 /* Redistribute pending connections when a server goes down. The number of
- * connections redistributed is returned. It will take the server queue lock
- * and does not use nor depend on other locks.
+ * connections redistributed is returned. It will take the locks of the parts
+ * of the server queue one at a time and does not use nor depend on other
+ * locks.
  */
 int pendconn_redistribute(struct server *s)
 {
 	struct pendconn *p;
 	struct eb32_node *node, *nodeb;
 	int xferred = 0;
+	int grp;
 
 	/* The REDISP option was specified. We will ignore cookie and force to
 	 * balance or use the dispatcher. */
 	if ((s->proxy->options & (PR_O_REDISP|PR_O_PERSIST)) != PR_O_REDISP)
 		return 0;
 
-	HA_SPIN_LOCK(QUEUE_LOCK, &s->queue.lock);
-	for (node = eb32_first(&s->queue.head); node; node = nodeb) {
-		nodeb =	eb32_next(node);
+	for (grp = 0; grp < global.nbtgroups; grp++) {
+		struct queue_tgrp *qg = &s->queue.tgrp[grp];
 
-		p = eb32_entry(node, struct pendconn, node);
-		if (p->strm_flags & SF_FORCE_PRST)
-			continue;
+		HA_SPIN_LOCK(QUEUE_LOCK, &qg->lock);
+		for (node = eb32_first(&qg->head); node; node = nodeb) {
+			nodeb =	eb32_next(node);
 
-		/* it's left to the dispatcher to choose a server */
-		__pendconn_unlink_srv(p);
-		p->strm_flags &= ~(SF_DIRECT | SF_ASSIGNED);
+			p = eb32_entry(node, struct pendconn, node);
+			if (p->strm_flags & SF_FORCE_PRST)
+				continue;
 
-		task_wakeup(p->strm->task, TASK_WOKEN_RES);
-		xferred++;
+			/* it's left to the dispatcher to choose a server */
+			__pendconn_unlink_srv(p);
+			p->strm_flags &= ~(SF_DIRECT | SF_ASSIGNED);
+
+			task_wakeup(p->strm->task, TASK_WOKEN_RES);
+			xferred++;
+		}
+		HA_SPIN_UNLOCK(QUEUE_LOCK, &qg->lock);
 	}
-	HA_SPIN_UNLOCK(QUEUE_LOCK, &s->queue.lock);
 
 	if (xferred) {
-		_HA_ATOMIC_SUB(&s->queue.length, xferred);
+		uint len = _HA_ATOMIC_SUB_FETCH(&s->queue.length, xferred);
+
+		srv_queue_evt_check(s, len + xferred, len);
 		_HA_ATOMIC_SUB(&s->proxy->totpend, xferred);
 	}
 	return xferred;
@@ -520,8 +613,8 @@ int pendconn_redistribute(struct server *s)
 /* Check for pending connections at the backend, and assign some of them to
  * the server coming up. The server's weight is checked before being assigned
  * connections it may not be able to handle. The total number of transferred
- * connections is returned. It will take the proxy's queue lock and will not
- * use nor depend on other locks.
+ * connections is returned. It will take the locks of the parts of the proxy's
+ * queue and will not use nor depend on other locks.
  */
 int pendconn_grab_from_px(struct server *s)
 {
@@ -540,19 +633,19 @@ int pendconn_grab_from_px(struct server *s)
 	     ((s != s->proxy->lbprm.fbck) && !(s->proxy->options & PR_O_USE_ALL_BK))))
 		return 0;
 
-	HA_SPIN_LOCK(QUEUE_LOCK, &s->proxy->queue.lock);
 	maxconn = srv_dynamic_maxconn(s);
-	while ((p = pendconn_first(&s->proxy->queue.head))) {
-		if (s->maxconn && s->served + xferred >= maxconn)
+	while (!s->maxconn || s->served + xferred < maxconn) {
+		p = queue_first(&s->proxy->queue);
+		if (!p)
 			break;
 
 		__pendconn_unlink_prx(p);
 		p->target = s;
 
 		task_wakeup(p->strm->task, TASK_WOKEN_RES);
+		HA_SPIN_UNLOCK(QUEUE_LOCK, &p->tgrp->lock);
 		xferred++;
 	}
-	HA_SPIN_UNLOCK(QUEUE_LOCK, &s->proxy->queue.lock);
 	if (xferred) {
 		_HA_ATOMIC_SUB(&s->proxy->queue.length, xferred);
 		_HA_ATOMIC_SUB(&s->proxy->totpend, xferred);
@@ -616,6 +709,7 @@ int pendconn_dequeue(struct stream *strm)
 		strm->flags |= SF_ASSIGNED;
 	}
 
+	HA_USDT(queue_leave, strm, strm->be, p->target, p->queue_idx);
 	strm->pend_pos = NULL;
 	pool_free(pool_head_pendconn, p);
 	return 0;
@@ -0,0 +1,459 @@
+/*
+ * BBR congestion control algorithm.
+ *
+ * This file contains definitions for QUIC congestion control.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, version 2.1
+ * exclusively.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* This is a model-based algorithm: instead of reacting to losses, it measures
+ * the maximum delivery rate (bottleneck bandwidth) over the last rounds and
+ * the minimum RTT over the last seconds, and sizes the congestion window
+ * after their product (the BDP). It is largely inspired from BBR as
+ * described in draft-cardwell-iccrg-bbr-congestion-control, with a few
+ * changes:
+ *   - there is no pacing in the QUIC stack, so the pacing gain of each
+ *     phase is applied to the congestion window on top of the cwnd gain ;
+ *   - as in BBRv2, an excessive loss rate terminates the startup phase and
+ *     the probing for bandwidth, and limits the amount of data in flight
+ *     (inflight_hi), which is progressively relaxed on each new probe ;
+ *   - times are in milliseconds, like anywhere else in the QUIC stack.
+ */
+
+#include <haproxy/api-t.h>
+#include <haproxy/buf.h>
+#include <haproxy/chunk.h>
+#include <haproxy/quic_cc.h>
+#include <haproxy/quic_conn-t.h>
+#include <haproxy/ticks.h>
+#include <haproxy/tools.h>
+#include <haproxy/trace.h>
+
+#define TRACE_SOURCE    &trace_quic
+
+/* gains are expressed in 1/256 */
+#define BBR_UNIT                 256
+#define BBR_HIGH_GAIN            739  /* 2/ln(2) ~= 2.885 */
+#define BBR_CWND_GAIN            512  /* 2 */
+
+#define BBR_BW_FILTER_ROUNDS      10  /* max bandwidth window */
+#define BBR_MIN_RTT_WIN        10000  /* min RTT window (ms) */
+#define BBR_PROBE_RTT_TIME       200  /* min time in PROBE_RTT (ms) */
+#define BBR_FULL_BW_ROUNDS         3  /* rounds without growth to leave STARTUP */
+#define BBR_LOSS_THRESH           50  /* max tolerated loss rate per round: 1/50 (2%) */
+#define BBR_CYCLE_LEN              8
+
+enum bbr_mode {
+	BBR_ST_STARTUP,    /* exponential growth to find the bandwidth */
+	BBR_ST_DRAIN,      /* drain the queue created during STARTUP */
+	BBR_ST_PROBE_BW,   /* steady state, cycling over the gains below */
+	BBR_ST_PROBE_RTT,  /* drain the queue to measure the min RTT again */
+};
+
+/* cwnd gains of the PROBE_BW cycle: BBR_CWND_GAIN x {1.25, 0.75, 1, 1, ...} */
+static const uint16_t bbr_cycle_gain[BBR_CYCLE_LEN] = {
+	640, 384, 512, 512, 512, 512, 512, 512,
+};
+
+/* one maximum bandwidth sample (bytes/ms) and its round */
+struct bbr_bw {
+	uint32_t bw;
+	uint32_t round;
+};
+
+/* BBR state, which must fit into struct quic_cc's <priv> */
+struct bbr {
+	uint64_t next_round_delivered; /* delivered count marking the end of the round */
+	uint64_t round_lost;           /* bytes lost since the beginning of the round */
+	uint64_t round_start_delivered;/* delivered count at the beginning of the round */
+	uint64_t prior_cwnd;           /* cwnd to restore after PROBE_RTT */
+	uint64_t inflight_hi;          /* max bytes in flight after excessive losses, 0 if none */
+	struct bbr_bw bw[3];           /* best, 2nd best and 3rd best max bandwidth of the window */
+	uint32_t full_bw;              /* reference bandwidth to detect the end of STARTUP */
+	uint32_t min_rtt;              /* min RTT (ms) over BBR_MIN_RTT_WIN */
+	uint32_t min_rtt_stamp;        /* date of the <min_rtt> measure */
+	uint32_t round_count;          /* number of rounds on this path */
+	uint32_t cycle_stamp;          /* start of the current PROBE_BW phase */
+	uint32_t probe_rtt_done_stamp; /* end of PROBE_RTT, 0 if not yet set */
+	uint8_t mode;                  /* enum bbr_mode */
+	uint8_t full_bw_cnt;           /* rounds without significant bandwidth growth */
+	uint8_t cycle_idx;             /* current phase of the PROBE_BW cycle */
+	uint8_t flags;                 /* BBR_F_* */
+};
+
+#define BBR_F_FULL_BW       0x01  /* the pipe was filled at least once */
+#define BBR_F_ROUND_START   0x02  /* the current ACK started a new round */
+#define BBR_F_PROBE_RTT_RND 0x04  /* a full round was spent in PROBE_RTT */
+#define BBR_F_LOSS_RND      0x08  /* the loss rate was exceeded in this round */
+
+static inline const char *bbr_mode_str(uint8_t mode)
+{
+	switch (mode) {
+	case BBR_ST_STARTUP:   return "startup";
+	case BBR_ST_DRAIN:     return "drain";
+	case BBR_ST_PROBE_BW:  return "probe_bw";
+	case BBR_ST_PROBE_RTT: return "probe_rtt";
+	default:               return "unknown";
+	}
+}
+
+static int quic_cc_bbr_init(struct quic_cc *cc)
+{
+	struct bbr *bbr = quic_cc_priv(cc);
+
+	BUG_ON(sizeof(*bbr) > sizeof(cc->priv));
+	memset(bbr, 0, sizeof(*bbr));
+	bbr->mode = BBR_ST_STARTUP;
+	bbr->min_rtt = ~0U;
+	bbr->min_rtt_stamp = now_ms;
+	return 1;
+}
+
+/* Returns the current max bandwidth estimate in bytes/ms */
+static inline uint32_t bbr_max_bw(const struct bbr *bbr)
+{
+	return bbr->bw[0].bw;
+}
+
+/* Updates the windowed max filter of <bbr> with <bw> measured during the
+ * current round. This is the Kathleen Nichols' algorithm also used in the
+ * Linux kernel (lib/win_minmax.c), which keeps the three best values over
+ * the window in a constant space.
+ */
+static void bbr_update_max_bw(struct bbr *bbr, uint32_t bw)
+{
+	struct bbr_bw val = { .bw = bw, .round = bbr->round_count };
+	uint32_t dt;
+
+	if (bw >= bbr->bw[0].bw || bbr->round_count - bbr->bw[2].round >= BBR_BW_FILTER_ROUNDS) {
+		/* new max or nothing left in the window */
+		bbr->bw[0] = bbr->bw[1] = bbr->bw[2] = val;
+		return;
+	}
+
+	if (bw >= bbr->bw[1].bw)
+		bbr->bw[1] = bbr->bw[2] = val;
+	else if (bw >= bbr->bw[2].bw)
+		bbr->bw[2] = val;
+
+	/* expire the best ones which are out of the window, and make sure
+	 * the 2nd and 3rd choices are spread over the window.
+	 */
+	dt = bbr->round_count - bbr->bw[0].round;
+	if (dt >= BBR_BW_FILTER_ROUNDS) {
+		bbr->bw[0] = bbr->bw[1];
+		bbr->bw[1] = bbr->bw[2];
+		bbr->bw[2] = val;
+		if (bbr->round_count - bbr->bw[0].round >= BBR_BW_FILTER_ROUNDS) {
+			bbr->bw[0] = bbr->bw[1];
+			bbr->bw[1] = bbr->bw[2];
+		}
+	}
+	else if (bbr->bw[1].round == bbr->bw[0].round && dt >= BBR_BW_FILTER_ROUNDS / 4) {
+		bbr->bw[1] = bbr->bw[2] = val;
+	}
+	else if (bbr->bw[2].round == bbr->bw[1].round && dt >= BBR_BW_FILTER_ROUNDS / 2) {
+		bbr->bw[2] = val;
+	}
+}
+
+/* Returns the estimated BDP of <path> multiplied by <gain>/BBR_UNIT, or 0 if
+ * it is not known yet.
+ */
+static inline uint64_t bbr_bdp(const struct bbr *bbr, uint32_t gain)
+{
+	uint32_t rtt;
+
+	if (!bbr_max_bw(bbr) || bbr->min_rtt == ~0U)
+		return 0;
+
+	/* the RTT may be lower than the timer granularity */
+	rtt = QUIC_MAX(bbr->min_rtt, 1U);
+	return (uint64_t)bbr_max_bw(bbr) * rtt * gain / BBR_UNIT;
+}
+
+/* Returns the cwnd to use in PROBE_RTT for <path> */
+static inline uint64_t bbr_probe_rtt_cwnd(const struct quic_path *path)
+{
+	return QUIC_MAX((uint64_t)(4 * path->mtu), path->min_cwnd);
+}
+
+/* Enters mode PROBE_BW with a random phase, except the draining one so that
+ * the queue is not emptied twice in a row.
+ */
+static void bbr_enter_probe_bw(struct bbr *bbr)
+{
+	bbr->mode = BBR_ST_PROBE_BW;
+	bbr->cycle_idx = (2 + statistical_prng_range(BBR_CYCLE_LEN - 1)) % BBR_CYCLE_LEN;
+	bbr->cycle_stamp = now_ms;
+}
+
+/* Advances to the next phase of the PROBE_BW cycle if needed. Each phase lasts
+ * about one min RTT, except for the draining one which is left as soon as
+ * the excess data are drained.
+ */
+static void bbr_update_cycle(struct bbr *bbr, const struct quic_path *path)
+{
+	int next = tick_is_expired(tick_add(bbr->cycle_stamp, QUIC_MAX(bbr->min_rtt, 1U)), now_ms);
+
+	if (bbr->cycle_idx == 1 && path->in_flight <= bbr_bdp(bbr, BBR_UNIT))
+		next = 1;
+
+	if (!next)
+		return;
+
+	bbr->cycle_idx = (bbr->cycle_idx + 1) % BBR_CYCLE_LEN;
+	bbr->cycle_stamp = now_ms;
+	if (!bbr->cycle_idx && bbr->inflight_hi) {
+		/* probing again, let's relax the limit found on losses */
+		bbr->inflight_hi += bbr->inflight_hi / 4;
+	}
+}
+
+/* Checks whether the bandwidth stopped growing during STARTUP, which means
+ * that the pipe is full. It is done once per round.
+ */
+static void bbr_check_full_bw(struct bbr *bbr)
+{
+	if ((bbr->flags & BBR_F_FULL_BW) || !(bbr->flags & BBR_F_ROUND_START))
+		return;
+
+	if ((uint64_t)bbr_max_bw(bbr) * BBR_UNIT >= (uint64_t)bbr->full_bw * (BBR_UNIT * 5 / 4)) {
+		/* still growing by at least 25% */
+		bbr->full_bw = bbr_max_bw(bbr);
+		bbr->full_bw_cnt = 0;
+		return;
+	}
+
+	if (++bbr->full_bw_cnt >= BBR_FULL_BW_ROUNDS)
+		bbr->flags |= BBR_F_FULL_BW;
+}
+
+/* Handles the transitions from STARTUP to DRAIN then to PROBE_BW */
+static void bbr_check_drain(struct bbr *bbr, const struct quic_path *path)
+{
+	if (bbr->mode == BBR_ST_STARTUP && (bbr->flags & BBR_F_FULL_BW))
+		bbr->mode = BBR_ST_DRAIN;
+
+	if (bbr->mode == BBR_ST_DRAIN && path->in_flight <= bbr_bdp(bbr, BBR_UNIT))
+		bbr_enter_probe_bw(bbr);
+}
+
+/* Enters PROBE_RTT when the min RTT was not refreshed for BBR_MIN_RTT_WIN,
+ * and leaves it once the cwnd was kept low enough for at least one round and
+ * BBR_PROBE_RTT_TIME. <expired> indicates the min RTT is out of date.
+ */
+static void bbr_update_probe_rtt(struct bbr *bbr, struct quic_path *path, int expired)
+{
+	if (bbr->mode != BBR_ST_PROBE_RTT) {
+		if (!expired)
+			return;
+
+		bbr->mode = BBR_ST_PROBE_RTT;
+		bbr->prior_cwnd = path->cwnd;
+		bbr->probe_rtt_done_stamp = 0;
+		return;
+	}
+
+	if (!bbr->probe_rtt_done_stamp) {
+		if (path->in_flight > bbr_probe_rtt_cwnd(path))
+			return;
+
+		bbr->probe_rtt_done_stamp = tick_add(now_ms, BBR_PROBE_RTT_TIME);
+		bbr->flags &= ~BBR_F_PROBE_RTT_RND;
+		bbr->next_round_delivered = path->loss.delivered;
+		return;
+	}
+
+	if (bbr->flags & BBR_F_ROUND_START)
+		bbr->flags |= BBR_F_PROBE_RTT_RND;
+
+	if (!(bbr->flags & BBR_F_PROBE_RTT_RND) || !tick_is_expired(bbr->probe_rtt_done_stamp, now_ms))
+		return;
+
+	bbr->min_rtt_stamp = now_ms;
+	path->cwnd = QUIC_MAX(path->cwnd, bbr->prior_cwnd);
+	if (bbr->flags & BBR_F_FULL_BW)
+		bbr_enter_probe_bw(bbr);
+	else
+		bbr->mode = BBR_ST_STARTUP;
+}
+
+/* Updates the cwnd of <path> after <acked> bytes were acknowledged */
+static void bbr_set_cwnd(struct bbr *bbr, struct quic_path *path, uint64_t acked)
+{
+	uint64_t target;
+	uint32_t gain;
+
+	switch (bbr->mode) {
+	case BBR_ST_STARTUP:
+		gain = BBR_HIGH_GAIN;
+		break;
+	case BBR_ST_DRAIN:
+		gain = BBR_UNIT;
+		break;
+	case BBR_ST_PROBE_BW:
+		gain = bbr_cycle_gain[bbr->cycle_idx];
+		break;
+	default:
+		gain = BBR_CWND_GAIN;
+		break;
+	}
+
+	/* a few extra datagrams absorb delayed ACKs */
+	target = bbr_bdp(bbr, gain);
+	if (target)
+		target += 3 * path->mtu;
+	if (bbr->inflight_hi && target > bbr->inflight_hi)
+		target = bbr->inflight_hi;
+
+	if (bbr->flags & BBR_F_FULL_BW)
+		path->cwnd = QUIC_MIN(path->cwnd + acked, target);
+	else if (path->cwnd < target || !target)
+		path->cwnd += acked;
+
+	path->cwnd = QUIC_MAX(path->cwnd, path->min_cwnd);
+	if (bbr->mode == BBR_ST_PROBE_RTT)
+		path->cwnd = QUIC_MIN(path->cwnd, bbr_probe_rtt_cwnd(path));
+}
+
+static void quic_cc_bbr_ack(struct quic_cc *cc, struct quic_cc_event *ev)
+{
+	struct quic_path *path = container_of(cc, struct quic_path, cc);
+	struct bbr *bbr = quic_cc_priv(cc);
+	uint32_t rtt = now_ms - ev->ack.time_sent;
+	int expired;
+
+	if (!ev->ack.acked)
+		return;
+
+	/* min RTT filter */
+	expired = tick_is_expired(tick_add(bbr->min_rtt_stamp, BBR_MIN_RTT_WIN), now_ms);
+	if (rtt <= bbr->min_rtt || expired) {
+		bbr->min_rtt = rtt;
+		bbr->min_rtt_stamp = now_ms;
+	}
+
+	/* a round ends when a packet sent after its beginning is acknowledged */
+	bbr->flags &= ~BBR_F_ROUND_START;
+	if (path->loss.delivered - ev->ack.delivered >= bbr->next_round_delivered) {
+		bbr->next_round_delivered = path->loss.delivered;
+		bbr->round_start_delivered = path->loss.delivered;
+		bbr->round_lost = 0;
+		bbr->round_count++;
+		bbr->flags |= BBR_F_ROUND_START;
+		bbr->flags &= ~BBR_F_LOSS_RND;
+	}
+
+	/* max bandwidth filter, samples shorter than the min RTT are
+	 * unreliable because of ACK compression.
+	 */
+	if (ev->ack.interval && ev->ack.interval >= bbr->min_rtt)
+		bbr_update_max_bw(bbr, ev->ack.delivered / ev->ack.interval);
+
+	bbr_check_full_bw(bbr);
+	bbr_check_drain(bbr, path);
+	if (bbr->mode == BBR_ST_PROBE_BW)
+		bbr_update_cycle(bbr, path);
+	bbr_update_probe_rtt(bbr, path, expired);
+	bbr_set_cwnd(bbr, path, ev->ack.acked);
+}
+
+/* Losses are not considered as a congestion signal as long as they remain
+ * below BBR_LOSS_THRESH per round. Above, the current estimate is considered
+ * excessive: STARTUP is left, the current bandwidth probe is stopped and the
+ * data in flight are limited.
+ */
+static void quic_cc_bbr_loss(struct quic_cc *cc, struct quic_cc_event *ev)
+{
+	struct quic_path *path = container_of(cc, struct quic_path, cc);
+	struct bbr *bbr = quic_cc_priv(cc);
+	uint64_t delivered;
+
+	bbr->round_lost += ev->loss.lost;
+	if (bbr->flags & BBR_F_LOSS_RND)
+		return;
+
+	delivered = path->loss.delivered - bbr->round_start_delivered;
+	if (bbr->round_lost < 2 * path->mtu ||
+	    bbr->round_lost * BBR_LOSS_THRESH <= delivered + bbr->round_lost)
+		return;
+
+	/* only react once per round */
+	bbr->flags |= BBR_F_LOSS_RND;
+	bbr->inflight_hi = QUIC_MAX(bbr_bdp(bbr, BBR_UNIT), path->cwnd * 7 / 10);
+	bbr->inflight_hi = QUIC_MAX(bbr->inflight_hi, path->min_cwnd);
+	path->cwnd = QUIC_MIN(path->cwnd, bbr->inflight_hi);
+
+	if (bbr->mode == BBR_ST_STARTUP) {
+		bbr->flags |= BBR_F_FULL_BW;
+		bbr->mode = BBR_ST_DRAIN;
+	}
+	else if (bbr->mode == BBR_ST_PROBE_BW && bbr->cycle_idx == 0) {
+		bbr->cycle_idx = 1;
+		bbr->cycle_stamp = now_ms;
+	}
+}
+
+static void quic_cc_bbr_event(struct quic_cc *cc, struct quic_cc_event *ev)
+{
+	TRACE_ENTER(QUIC_EV_CONN_CC, cc->qc, ev);
+	switch (ev->type) {
+	case QUIC_CC_EVT_ACK:
+		quic_cc_bbr_ack(cc, ev);
+		break;
+	case QUIC_CC_EVT_LOSS:
+		quic_cc_bbr_loss(cc, ev);
+		break;
+	case QUIC_CC_EVT_ECN_CE:
+		/* TODO */
+		break;
+	}
+	TRACE_LEAVE(QUIC_EV_CONN_CC, cc->qc, NULL, cc);
+}
+
+/* Persistent congestion: the model is kept but the cwnd restarts from the
+ * minimum and will grow back to the target on the next ACKs.
+ */
+static void quic_cc_bbr_slow_start(struct quic_cc *cc)
+{
+	struct quic_path *path = container_of(cc, struct quic_path, cc);
+	struct bbr *bbr = quic_cc_priv(cc);
+
+	bbr->prior_cwnd = QUIC_MAX(bbr->prior_cwnd, path->cwnd);
+	path->cwnd = path->min_cwnd;
+}
+
+static void quic_cc_bbr_state_trace(struct buffer *buf, const struct quic_cc *cc)
+{
+	struct quic_path *path = container_of(cc, struct quic_path, cc);
+	struct bbr *bbr = quic_cc_priv(cc);
+
+	chunk_appendf(buf, " state=%s cwnd=%llu bw=%u min_rtt=%d bdp=%llu rounds=%u"
+	              " full_bw=%u%s cycle=%u inflight_hi=%llu",
+	              bbr_mode_str(bbr->mode), (unsigned long long)path->cwnd,
+	              bbr_max_bw(bbr), bbr->min_rtt == ~0U ? -1 : (int)bbr->min_rtt,
+	              (unsigned long long)bbr_bdp(bbr, BBR_UNIT), bbr->round_count,
+	              bbr->full_bw, (bbr->flags & BBR_F_FULL_BW) ? "(reached)" : "",
+	              bbr->cycle_idx, (unsigned long long)bbr->inflight_hi);
+}
+
+struct quic_cc_algo quic_cc_algo_bbr = {
+	.type        = QUIC_CC_ALGO_TP_BBR,
+	.init        = quic_cc_bbr_init,
+	.event       = quic_cc_bbr_event,
+	.slow_start  = quic_cc_bbr_slow_start,
+	.state_trace = quic_cc_bbr_state_trace,
+};
@@ -27,6 +27,7 @@
 
 #include <import/ebmbtree.h>
 
+#include <haproxy/applet.h>
 #include <haproxy/buf-t.h>
 #include <haproxy/compat.h>
 #include <haproxy/api.h>
@@ -34,6 +35,7 @@
 #include <haproxy/tools.h>
 #include <haproxy/ticks.h>
 
+#include <haproxy/cli.h>
 #include <haproxy/connection.h>
 #include <haproxy/fd.h>
 #include <haproxy/freq_ctr.h>
@@ -56,9 +58,12 @@
 #include <haproxy/cbuf.h>
 #include <haproxy/proto_quic.h>
 #include <haproxy/quic_tls.h>
+#include <haproxy/sc_strm.h>
 #include <haproxy/ssl_sock.h>
+#include <haproxy/stconn.h>
 #include <haproxy/task.h>
 #include <haproxy/trace.h>
+#include <haproxy/xxhash.h>
 
 /* list of supported QUIC versions by this implementation */
 const struct quic_version quic_versions[] = {
@@ -215,6 +220,16 @@ DECLARE_STATIC_POOL(pool_head_quic_cstream, "quic_cstream", sizeof(struct quic_c
 DECLARE_POOL(pool_head_quic_frame, "quic_frame", sizeof(struct quic_frame));
 DECLARE_STATIC_POOL(pool_head_quic_arng, "quic_arng", sizeof(struct quic_arng_node));
 
+/* Rate of Initial packets without token opening new connections, used by
+ * "tune.quic.retry-rate".
+ */
+static struct freq_ctr quic_initial_per_sec;
+
+/* Incremented by each "show quic" so that it stops on connections created
+ * after it started.
+ */
+static unsigned int qc_epoch = 0;
+
 static struct quic_tx_packet *qc_build_pkt(unsigned char **pos, const unsigned char *buf_end,
                                            struct quic_enc_level *qel, struct quic_tls_ctx *ctx,
                                            struct list *frms, struct quic_conn *qc,
@@ -226,6 +241,7 @@ static void qc_idle_timer_rearm(struct quic_conn *qc, int read);
 static int qc_conn_alloc_ssl_ctx(struct quic_conn *qc);
 static int quic_conn_init_timer(struct quic_conn *qc);
 static int quic_conn_init_idle_timer_task(struct quic_conn *qc);
+static void quic_arngs_set_enc_sz(struct quic_conn *qc, struct quic_arngs *arngs);
 
 /* Only for debug purpose */
 struct enc_debug_info {
@@ -606,10 +622,11 @@ static void quic_trace(enum trace_level level, uint64_t mask, const struct trace
 		if (mask & QUIC_EV_CONN_SPPKTS) {
 			const struct quic_tx_packet *pkt = a2;
 
-			chunk_appendf(&trace_buf, " cwnd=%llu ppif=%llu pif=%llu",
+			chunk_appendf(&trace_buf, " cwnd=%llu ppif=%llu pif=%llu pacing=%llu",
 			             (unsigned long long)qc->path->cwnd,
 			             (unsigned long long)qc->path->prep_in_flight,
-			             (unsigned long long)qc->path->in_flight);
+			             (unsigned long long)qc->path->in_flight,
+			             (unsigned long long)qc->path->pacer.rate);
 			if (pkt) {
 				const struct quic_frame *frm;
 				chunk_appendf(&trace_buf, " pn=%lu(%s) iflen=%llu",
@@ -956,7 +973,7 @@ int ha_quic_set_encryption_secrets(SSL *ssl, enum ssl_encryption_level_t level,
 		goto leave;
 	}
 
-	if (!quic_tls_dec_aes_ctx_init(&rx->hp_ctx, rx->hp, rx->hp_key)) {
+	if (!quic_tls_enc_aes_ctx_init(&rx->hp_ctx, rx->hp, rx->hp_key)) {
 		TRACE_ERROR("could not initial RX TLS cipher context for HP", QUIC_EV_CONN_RWSEC, qc);
 		goto leave;
 	}
@@ -1122,7 +1139,7 @@ static int quic_crypto_data_cpy(struct quic_conn *qc, struct quic_enc_level *qel
 			found->crypto.len += cf_len;
 		}
 		else {
-			frm = pool_zalloc(pool_head_quic_frame);
+			frm = qc_frm_alloc(qc);
 			if (!frm) {
 				TRACE_ERROR("Could not allocate quic frame", QUIC_EV_CONN_ADDDATA, qc);
 				goto leave;
@@ -1346,29 +1363,22 @@ static int qc_do_rm_hp(struct quic_conn *qc,
 	int ret, i, pnlen;
 	uint64_t packet_number;
 	uint32_t truncated_pn = 0;
-	unsigned char mask[5] = {0};
+	unsigned char mask[QUIC_TLS_HP_MASK_LEN];
 	unsigned char *sample;
-	EVP_CIPHER_CTX *cctx = NULL;
 
 	TRACE_ENTER(QUIC_EV_CONN_RMHP, qc);
 
 	ret = 0;
 
 	/* Check there is enough data in this packet. */
-	if (pkt->len - (pn - byte0) < QUIC_PACKET_PN_MAXLEN + sizeof mask) {
+	if (pkt->len - (pn - byte0) < QUIC_PACKET_PN_MAXLEN + QUIC_TLS_HP_SAMPLE_LEN) {
 		TRACE_PROTO("too short packet", QUIC_EV_CONN_RMHP, qc, pkt);
 		goto leave;
 	}
 
-	cctx = EVP_CIPHER_CTX_new();
-	if (!cctx) {
-		TRACE_ERROR("memory allocation failed", QUIC_EV_CONN_RMHP, qc, pkt);
-		goto leave;
-	}
-
 	sample = pn + QUIC_PACKET_PN_MAXLEN;
 
-	if (!quic_tls_aes_decrypt(mask, sample, sizeof mask, tls_ctx->rx.hp_ctx)) {
+	if (!quic_tls_hp_mask(mask, sample, tls_ctx->rx.hp_ctx)) {
 		TRACE_ERROR("HP removing failed", QUIC_EV_CONN_RMHP, qc, pkt);
 		goto leave;
 	}
@@ -1387,8 +1397,6 @@ static int qc_do_rm_hp(struct quic_conn *qc,
 
 	ret = 1;
  leave:
-	if (cctx)
-		EVP_CIPHER_CTX_free(cctx);
 	TRACE_LEAVE(QUIC_EV_CONN_RMHP, qc);
 	return ret;
 }
@@ -1575,7 +1583,7 @@ void qc_release_frm(struct quic_conn *qc, struct quic_frame *frm)
 			            QUIC_EV_CONN_PRSAFRM, qc, f);
 			LIST_DELETE(&f->ref);
 			LIST_DELETE(&f->list);
-			pool_free(pool_head_quic_frame, f);
+			qc_frm_free(qc, f);
 		}
 	}
 	LIST_DELETE(&frm->list);
@@ -1583,7 +1591,7 @@ void qc_release_frm(struct quic_conn *qc, struct quic_frame *frm)
 	quic_tx_packet_refdec(frm->pkt);
 	TRACE_DEVEL("freeing frame from packet",
 	            QUIC_EV_CONN_PRSAFRM, qc, frm, &pn);
-	pool_free(pool_head_quic_frame, frm);
+	qc_frm_free(qc, frm);
 
 	TRACE_LEAVE(QUIC_EV_CONN_PRSAFRM, qc);
 }
@@ -1812,7 +1820,7 @@ static inline void qc_requeue_nacked_pkt_tx_frms(struct quic_conn *qc,
 				TRACE_DEVEL("released stream", QUIC_EV_CONN_PRSAFRM, qc, frm);
 				TRACE_DEVEL("freeing frame from packet", QUIC_EV_CONN_PRSAFRM,
 				            qc, frm, &pn);
-				pool_free(pool_head_quic_frame, frm);
+				qc_frm_free(qc, frm);
 				continue;
 			}
 
@@ -1821,7 +1829,7 @@ static inline void qc_requeue_nacked_pkt_tx_frms(struct quic_conn *qc,
 			if (strm_frm->offset.key + strm_frm->len <= stream_desc->ack_offset) {
 				TRACE_DEVEL("ignored frame in already acked range",
 				            QUIC_EV_CONN_PRSAFRM, qc, frm);
-				pool_free(pool_head_quic_frame, frm);
+				qc_frm_free(qc, frm);
 				continue;
 			}
 			else if (strm_frm->offset.key < stream_desc->ack_offset) {
@@ -1842,7 +1850,7 @@ static inline void qc_requeue_nacked_pkt_tx_frms(struct quic_conn *qc,
 				    qc, frm, &pn);
 			if (frm->origin)
 				LIST_DELETE(&frm->ref);
-			pool_free(pool_head_quic_frame, frm);
+			qc_frm_free(qc, frm);
 			continue;
 		}
 
@@ -1850,7 +1858,7 @@ static inline void qc_requeue_nacked_pkt_tx_frms(struct quic_conn *qc,
 			TRACE_DEVEL("already acked frame", QUIC_EV_CONN_PRSAFRM, qc, frm);
 			TRACE_DEVEL("freeing frame from packet", QUIC_EV_CONN_PRSAFRM,
 			            qc, frm, &pn);
-			pool_free(pool_head_quic_frame, frm);
+			qc_frm_free(qc, frm);
 		}
 		else {
 			if (QUIC_FT_STREAM_8 <= frm->type && frm->type <= QUIC_FT_STREAM_F) {
@@ -1885,7 +1893,7 @@ static inline void free_quic_tx_packet(struct quic_conn *qc,
 
 	list_for_each_entry_safe(frm, frmbak, &pkt->frms, list) {
 		LIST_DELETE(&frm->list);
-		pool_free(pool_head_quic_frame, frm);
+		qc_frm_free(qc, frm);
 	}
 	pool_free(pool_head_quic_tx_packet, pkt);
 
@@ -1948,6 +1956,8 @@ static void qc_treat_ack_of_ack(struct quic_conn *qc,
 		ar = next_ar;
 	}
 
+	/* the encoded size is updated incrementally on reception */
+	quic_arngs_set_enc_sz(qc, arngs);
 	TRACE_LEAVE(QUIC_EV_CONN_PRSAFRM, qc);
 }
 
@@ -1977,6 +1987,7 @@ static inline void qc_treat_newly_acked_pkts(struct quic_conn *qc,
 			qc_treat_ack_of_ack(qc, pkt->pktns, pkt->largest_acked_pn);
 		ev.ack.acked = pkt->in_flight_len;
 		ev.ack.time_sent = pkt->time_sent;
+		quic_loss_pkt_acked(&qc->path->loss, pkt, &ev);
 		quic_cc_event(&qc->path->cc, &ev);
 		LIST_DELETE(&pkt->list);
 		eb64_delete(&pkt->pn_node);
@@ -1997,7 +2008,7 @@ static inline void qc_release_pktns_frms(struct quic_conn *qc,
 
 	list_for_each_entry_safe(frm, frmbak, &pktns->tx.frms, list) {
 		LIST_DELETE(&frm->list);
-		pool_free(pool_head_quic_frame, frm);
+		qc_frm_free(qc, frm);
 	}
 
 	TRACE_LEAVE(QUIC_EV_CONN_PHPKTS, qc);
@@ -2016,6 +2027,7 @@ static inline void qc_release_lost_pkts(struct quic_conn *qc,
                                         uint64_t now_us)
 {
 	struct quic_tx_packet *pkt, *tmp, *oldest_lost, *newest_lost;
+	uint64_t lost = 0;
 
 	TRACE_ENTER(QUIC_EV_CONN_PRSAFRM, qc);
 
@@ -2026,6 +2038,7 @@ static inline void qc_release_lost_pkts(struct quic_conn *qc,
 	list_for_each_entry_safe(pkt, tmp, pkts, list) {
 		struct list tmp = LIST_HEAD_INIT(tmp);
 
+		lost += pkt->in_flight_len;
 		pkt->pktns->tx.in_flight -= pkt->in_flight_len;
 		qc->path->prep_in_flight -= pkt->in_flight_len;
 		qc->path->in_flight -= pkt->in_flight_len;
@@ -2050,6 +2063,7 @@ static inline void qc_release_lost_pkts(struct quic_conn *qc,
 
 		ev.type = QUIC_CC_EVT_LOSS;
 		ev.loss.time_sent = newest_lost->time_sent;
+		ev.loss.lost = lost;
 
 		quic_cc_event(&qc->path->cc, &ev);
 	}
@@ -2433,7 +2447,7 @@ static void qc_dup_pkt_frms(struct quic_conn *qc,
 			break;
 		}
 
-		dup_frm = pool_alloc(pool_head_quic_frame);
+		dup_frm = qc_frm_alloc(qc);
 		if (!dup_frm) {
 			TRACE_ERROR("could not duplicate frame", QUIC_EV_CONN_PRSAFRM, qc, frm);
 			break;
@@ -2615,7 +2629,7 @@ static int qc_stop_sending_frm_enqueue(struct quic_conn *qc, uint64_t id)
 	 */
 	app_error_code = H3_REQUEST_REJECTED;
 	// fixme: zalloc
-	frm = pool_zalloc(pool_head_quic_frame);
+	frm = qc_frm_alloc(qc);
 	if (!frm) {
 		TRACE_ERROR("failed to allocate quic_frame", QUIC_EV_CONN_PRSHPKT, qc);
 		goto out;
@@ -3033,6 +3047,39 @@ static int qc_may_build_pkt(struct quic_conn *qc, struct list *frms,
 	return 1;
 }
 
+/* Schedules the pacing task of <qc> to retry the emissions as soon as the
+ * pacing allows it.
+ */
+static void qc_pacing_arm(struct quic_conn *qc)
+{
+	int expire = quic_pacing_next(qc->path);
+
+	if (!task_in_wq(qc->pacing_task) || tick_is_lt(expire, qc->pacing_task->expire)) {
+		qc->pacing_task->expire = expire;
+		task_queue(qc->pacing_task);
+	}
+	HA_ATOMIC_INC(&qc->prx_counters->tx_pacing_delayed);
+}
+
+/* The task retrying the emissions delayed by the pacing. The connection
+ * tasklet is woken up for its own frames, as well as the MUX if it is waiting
+ * for sending.
+ */
+static struct task *qc_pacing_task(struct task *t, void *ctx, unsigned int state)
+{
+	struct quic_conn *qc = ctx;
+
+	t->expire = TICK_ETERNITY;
+	tasklet_wakeup(qc->wait_event.tasklet);
+	if (qc->subs && qc->subs->events & SUB_RETRY_SEND) {
+		tasklet_wakeup(qc->subs->tasklet);
+		qc->subs->events &= ~SUB_RETRY_SEND;
+		if (!qc->subs->events)
+			qc->subs = NULL;
+	}
+	return t;
+}
+
 /* Prepare as much as possible QUIC packets for sending from prebuilt frames
  * <frms>. Each packet is stored in a distinct datagram written to <buf>.
  *
@@ -3073,6 +3120,16 @@ static int qc_prep_app_pkts(struct quic_conn *qc, struct buffer *buf,
 		if (!qc_may_build_pkt(qc, frms, qel, cc, probe, 0))
 			break;
 
+		/* Only the data are paced, neither the probes nor the ACKs nor
+		 * the CONNECTION_CLOSE.
+		 */
+		if (qc->pacing_task && !cc && !probe && !LIST_ISEMPTY(frms) &&
+		    !quic_pacing_may_send(qc->path)) {
+			TRACE_DEVEL("delayed by pacing", QUIC_EV_CONN_PHPKTS, qc);
+			qc_pacing_arm(qc);
+			break;
+		}
+
 		/* Leave room for the datagram header */
 		pos += dg_headlen;
 		if (!quic_peer_validated_addr(qc) && qc_is_listener(qc)) {
@@ -3105,6 +3162,9 @@ static int qc_prep_app_pkts(struct quic_conn *qc, struct buffer *buf,
 		if (qc->flags & QUIC_FL_CONN_RETRANS_OLD_DATA)
 			pkt->flags |= QUIC_FL_TX_PACKET_PROBE_WITH_OLD_DATA;
 
+		if (pkt->in_flight_len)
+			quic_pacing_sent(qc->path, pkt->len);
+
 		total += pkt->len;
 
 		/* Write datagram header. */
@@ -3325,24 +3385,35 @@ int qc_send_ppkts(struct buffer *buf, struct ssl_sock_ctx *ctx)
 	qc = ctx->qc;
 	TRACE_ENTER(QUIC_EV_CONN_SPPKTS, qc);
 	while (b_contig_data(buf, 0)) {
+		struct iovec dgrams[QUIC_MAX_MMSG_DGRAMS];
+		struct quic_tx_packet *first_pkts[QUIC_MAX_MMSG_DGRAMS];
 		unsigned char *pos;
-		struct buffer tmpbuf = { };
 		struct quic_tx_packet *first_pkt, *pkt, *next_pkt;
 		uint16_t dglen;
 		size_t headlen = sizeof dglen + sizeof first_pkt;
+		size_t contig, ofs;
 		unsigned int time_sent;
+		int count, i;
 
-		pos = (unsigned char *)b_head(buf);
-		dglen = read_u16(pos);
-		BUG_ON_HOT(!dglen); /* this should not happen */
-
-		pos += sizeof dglen;
-		first_pkt = read_ptr(pos);
-		pos += sizeof first_pkt;
-		tmpbuf.area = (char *)pos;
-		tmpbuf.size = tmpbuf.data = dglen;
-
-		TRACE_DATA("send dgram", QUIC_EV_CONN_SPPKTS, qc);
+		/* Collect as many contiguous datagrams as possible to emit
+		 * them with a single syscall.
+		 */
+		contig = b_contig_data(buf, 0);
+		for (count = 0, ofs = 0;
+		     count < QUIC_MAX_MMSG_DGRAMS && ofs < contig; count++) {
+			pos = (unsigned char *)b_head(buf) + ofs;
+			dglen = read_u16(pos);
+			BUG_ON_HOT(!dglen); /* this should not happen */
+
+			pos += sizeof dglen;
+			first_pkts[count] = read_ptr(pos);
+			pos += sizeof first_pkt;
+			dgrams[count].iov_base = pos;
+			dgrams[count].iov_len  = dglen;
+			ofs += dglen + headlen;
+		}
+
+		TRACE_DATA("send dgrams", QUIC_EV_CONN_SPPKTS, qc);
 		/* If sendto is on error just skip the call to it for the rest
 		 * of the loop but continue to purge the buffer. Data will be
 		 * transmitted when QUIC packets are detected as lost on our
@@ -3354,52 +3425,58 @@ int qc_send_ppkts(struct buffer *buf, struct ssl_sock_ctx *ctx)
 		 * quic-conn fd management.
 		 */
 		if (!skip_sendto) {
-			if (qc_snd_buf(qc, &tmpbuf, tmpbuf.data, 0)) {
+			if (qc_snd_dgrams(qc, dgrams, count) != count) {
 				skip_sendto = 1;
 				TRACE_ERROR("sendto error, simulate sending for the rest of data", QUIC_EV_CONN_SPPKTS, qc);
 			}
 		}
 
-		b_del(buf, dglen + headlen);
-		qc->tx.bytes += tmpbuf.data;
 		time_sent = now_ms;
-
-		for (pkt = first_pkt; pkt; pkt = next_pkt) {
-			pkt->time_sent = time_sent;
-			if (pkt->flags & QUIC_FL_TX_PACKET_ACK_ELICITING) {
-				pkt->pktns->tx.time_of_last_eliciting = time_sent;
-				qc->path->ifae_pkts++;
-				if (qc->flags & QUIC_FL_CONN_IDLE_TIMER_RESTARTED_AFTER_READ)
-					qc_idle_timer_rearm(qc, 0);
-			}
-			if (!(qc->flags & QUIC_FL_CONN_CLOSING) &&
-			    (pkt->flags & QUIC_FL_TX_PACKET_CC)) {
-				qc->flags |= QUIC_FL_CONN_CLOSING;
-				qc_notify_close(qc);
-
-				/* RFC 9000 10.2. Immediate Close:
-				 * The closing and draining connection states exist to ensure
-				 * that connections close cleanly and that delayed or reordered
-				 * packets are properly discarded. These states SHOULD persist
-				 * for at least three times the current PTO interval...
-				 *
-				 * Rearm the idle timeout only one time when entering closing
-				 * state.
-				 */
-				qc_idle_timer_do_rearm(qc);
-				if (qc->timer_task) {
-					task_destroy(qc->timer_task);
-					qc->timer_task = NULL;
+		for (i = 0; i < count; i++) {
+			dglen = dgrams[i].iov_len;
+			first_pkt = first_pkts[i];
+			b_del(buf, dglen + headlen);
+			qc->tx.bytes += dglen;
+
+			for (pkt = first_pkt; pkt; pkt = next_pkt) {
+				pkt->time_sent = time_sent;
+				if (pkt->flags & QUIC_FL_TX_PACKET_ACK_ELICITING) {
+					pkt->pktns->tx.time_of_last_eliciting = time_sent;
+					qc->path->ifae_pkts++;
+					if (qc->flags & QUIC_FL_CONN_IDLE_TIMER_RESTARTED_AFTER_READ)
+						qc_idle_timer_rearm(qc, 0);
+				}
+				if (!(qc->flags & QUIC_FL_CONN_CLOSING) &&
+				    (pkt->flags & QUIC_FL_TX_PACKET_CC)) {
+					qc->flags |= QUIC_FL_CONN_CLOSING;
+					qc_notify_close(qc);
+
+					/* RFC 9000 10.2. Immediate Close:
+					 * The closing and draining connection states exist to ensure
+					 * that connections close cleanly and that delayed or reordered
+					 * packets are properly discarded. These states SHOULD persist
+					 * for at least three times the current PTO interval...
+					 *
+					 * Rearm the idle timeout only one time when entering closing
+					 * state.
+					 */
+					qc_idle_timer_do_rearm(qc);
+					if (qc->timer_task) {
+						task_destroy(qc->timer_task);
+						qc->timer_task = NULL;
+					}
 				}
+				if (pkt->in_flight_len)
+					quic_loss_pkt_sent(&qc->path->loss, pkt, qc->path->in_flight);
+				qc->path->in_flight += pkt->in_flight_len;
+				pkt->pktns->tx.in_flight += pkt->in_flight_len;
+				if (pkt->in_flight_len)
+					qc_set_timer(qc);
+				TRACE_DATA("sent pkt", QUIC_EV_CONN_SPPKTS, qc, pkt);
+				next_pkt = pkt->next;
+				quic_tx_packet_refinc(pkt);
+				eb64_insert(&pkt->pktns->tx.pkts, &pkt->pn_node);
 			}
-			qc->path->in_flight += pkt->in_flight_len;
-			pkt->pktns->tx.in_flight += pkt->in_flight_len;
-			if (pkt->in_flight_len)
-				qc_set_timer(qc);
-			TRACE_DATA("sent pkt", QUIC_EV_CONN_SPPKTS, qc, pkt);
-			next_pkt = pkt->next;
-			quic_tx_packet_refinc(pkt);
-			eb64_insert(&pkt->pktns->tx.pkts, &pkt->pn_node);
 		}
 	}
 
@@ -3533,7 +3610,7 @@ static int quic_build_post_handshake_frames(struct quic_conn *qc)
 	qel = &qc->els[QUIC_TLS_ENC_LEVEL_APP];
 	/* Only servers must send a HANDSHAKE_DONE frame. */
 	if (qc_is_listener(qc)) {
-		frm = pool_zalloc(pool_head_quic_frame);
+		frm = qc_frm_alloc(qc);
 		if (!frm) {
 			TRACE_ERROR("frame allocation error", QUIC_EV_CONN_IO_CB, qc);
 			goto leave;
@@ -3554,7 +3631,7 @@ static int quic_build_post_handshake_frames(struct quic_conn *qc)
 	for (i = first; i < max; i++) {
 		struct quic_connection_id *cid;
 
-		frm = pool_zalloc(pool_head_quic_frame);
+		frm = qc_frm_alloc(qc);
 		if (!frm) {
 			TRACE_ERROR("frame allocation error", QUIC_EV_CONN_IO_CB, qc);
 			goto err;
@@ -3563,7 +3640,7 @@ static int quic_build_post_handshake_frames(struct quic_conn *qc)
 		LIST_INIT(&frm->reflist);
 		cid = new_quic_cid(&qc->cids, qc, i);
 		if (!cid) {
-			pool_free(pool_head_quic_frame, frm);
+			qc_frm_free(qc, frm);
 			TRACE_ERROR("CID allocation error", QUIC_EV_CONN_IO_CB, qc);
 			goto err;
 		}
@@ -3586,7 +3663,7 @@ static int quic_build_post_handshake_frames(struct quic_conn *qc)
  err:
 	/* free the frames */
 	list_for_each_entry_safe(frm, frmbak, &frm_list, list)
-		pool_free(pool_head_quic_frame, frm);
+		qc_frm_free(qc, frm);
 
 	node = eb64_lookup_ge(&qc->cids, first);
 	while (node) {
@@ -3768,7 +3845,26 @@ int quic_update_ack_ranges_list(struct quic_conn *qc,
 	TRACE_ENTER(QUIC_EV_CONN_RXPKT, qc);
 
 	new = NULL;
-	if (eb_is_empty(&arngs->root)) {
+	le = eb64_last(&arngs->root);
+	if (le) {
+		struct quic_arng_node *last =
+			eb64_entry(le, struct quic_arng_node, first);
+
+		/* Fast path for in-order packets which only extend the last
+		 * range: only the encoded sizes of the largest packet number
+		 * and of the first range length may change.
+		 */
+		if (ar->first == last->last + 1) {
+			arngs->enc_sz -= quic_int_getsize(last->last) +
+				quic_int_getsize(last->last - last->first.key);
+			last->last = ar->last;
+			arngs->enc_sz += quic_int_getsize(last->last) +
+				quic_int_getsize(last->last - last->first.key);
+			ret = 1;
+			goto out;
+		}
+	}
+	else {
 		new_node = quic_insert_new_range(qc, arngs, ar);
 		if (new_node)
 			ret = 1;
@@ -3831,6 +3927,7 @@ int quic_update_ack_ranges_list(struct quic_conn *qc,
 	ret = 1;
  leave:
 	quic_arngs_set_enc_sz(qc, arngs);
+ out:
 	TRACE_LEAVE(QUIC_EV_CONN_RXPKT, qc);
 	return ret;
 }
@@ -4299,6 +4396,33 @@ static void qc_dgrams_retransmit(struct quic_conn *qc)
 	TRACE_LEAVE(QUIC_EV_CONN_TXPKT, qc);
 }
 
+/* Returns non-zero if the ACK required by <qel> 1-RTT encryption level of <qc>
+ * may be delayed because it would be the only frame to send and less than
+ * tune.quic.frontend.ack-threshold ack-eliciting packets were received since
+ * the last one. The delay starts with the first delayed ACK and lasts at most
+ * tune.quic.frontend.max-ack-delay, the timer task being scheduled to send it.
+ */
+static int qc_may_delay_ack(struct quic_conn *qc, struct quic_enc_level *qel)
+{
+	struct quic_pktns *pktns = qel->pktns;
+
+	if (!global.tune.quic_frontend_max_ack_delay || !qc->timer_task ||
+	    (qc->flags & (QUIC_FL_CONN_IMMEDIATE_CLOSE|QUIC_FL_CONN_RETRANS_NEEDED)) ||
+	    !(pktns->flags & QUIC_FL_PKTNS_ACK_REQUIRED) ||
+	    (pktns->flags & QUIC_FL_PKTNS_PROBE_NEEDED) || pktns->tx.pto_probe ||
+	    !LIST_ISEMPTY(&pktns->tx.frms) ||
+	    pktns->rx.nb_aepkts_since_last_ack >= global.tune.quic_frontend_ack_threshold)
+		return 0;
+
+	if (!tick_isset(qc->ack_timer))
+		qc->ack_timer = tick_add(now_ms, MS_TO_TICKS(global.tune.quic_frontend_max_ack_delay));
+	else if (tick_is_expired(qc->ack_timer, now_ms))
+		return 0;
+
+	task_schedule(qc->timer_task, qc->ack_timer);
+	return 1;
+}
+
 /* QUIC connection packet handler task (post handshake) */
 struct task *quic_conn_app_io_cb(struct task *t, void *context, unsigned int state)
 {
@@ -4334,6 +4458,11 @@ struct task *quic_conn_app_io_cb(struct task *t, void *context, unsigned int sta
 		goto out;
 	}
 
+	if (qc_may_delay_ack(qc, qel)) {
+		TRACE_STATE("ACK delayed", QUIC_EV_CONN_IO_CB, qc);
+		goto out;
+	}
+
 	/* XXX TODO: how to limit the list frames to send */
 	if (!qc_send_app_pkts(qc, &qel->pktns->tx.frms)) {
 		TRACE_DEVEL("qc_send_app_pkts() failed", QUIC_EV_CONN_IO_CB, qc);
@@ -4646,6 +4775,16 @@ struct task *qc_process_timer(struct task *task, void *ctx, unsigned int state)
 	            NULL, NULL, &qc->path->ifae_pkts);
 	task->expire = TICK_ETERNITY;
 	pktns = quic_loss_pktns(qc);
+
+	if (tick_isset(qc->ack_timer) && tick_is_expired(qc->ack_timer, now_ms)) {
+		/* the delayed ACK must be sent */
+		tasklet_wakeup(qc->wait_event.tasklet);
+		if (!tick_isset(qc->timer) || !tick_is_expired(qc->timer, now_ms)) {
+			task->expire = qc->timer;
+			goto out;
+		}
+	}
+
 	if (tick_isset(pktns->tx.loss_time)) {
 		struct list lost_pkts = LIST_HEAD_INIT(lost_pkts);
 
@@ -4784,6 +4923,11 @@ static struct quic_conn *qc_new_conn(const struct quic_version *qv, int ipv4,
 		goto err;
 	}
 
+	LIST_INIT(&qc->frm_cache);
+	LIST_APPEND(&th_ctx->quic_conns, &qc->el_th_ctx);
+	LIST_INIT(&qc->back_refs);
+	qc->qc_epoch = HA_ATOMIC_LOAD(&qc_epoch);
+
 	buf_area = pool_alloc(pool_head_quic_conn_rxbuf);
 	if (!buf_area) {
 		TRACE_ERROR("Could not allocate a new RX buffer", QUIC_EV_CONN_INIT, qc);
@@ -4953,12 +5097,27 @@ void quic_conn_release(struct quic_conn *qc)
 	struct eb64_node *node;
 	struct quic_tls_ctx *app_tls_ctx;
 	struct quic_rx_packet *pkt, *pktback;
+	struct bref *bref, *back;
 
 	TRACE_ENTER(QUIC_EV_CONN_CLOSE, qc);
 
 	/* We must not free the quic-conn if the MUX is still allocated. */
 	BUG_ON(qc->mux_state == QC_MUX_READY);
 
+	/* Move the "show quic" watchers to the next connection. This is safe
+	 * because only our thread's list is touched, and the watchers only
+	 * touch their node under thread isolation.
+	 */
+	list_for_each_entry_safe(bref, back, &qc->back_refs, users) {
+		LIST_DEL_INIT(&bref->users);
+		if (qc->el_th_ctx.n != &th_ctx->quic_conns)
+			LIST_APPEND(&LIST_ELEM(qc->el_th_ctx.n, struct quic_conn *, el_th_ctx)->back_refs,
+			            &bref->users);
+		bref->ref = qc->el_th_ctx.n;
+		__ha_barrier_store();
+	}
+	LIST_DELETE(&qc->el_th_ctx);
+
 	/* Close quic-conn socket fd. */
 	qc_release_fd(qc, 0);
 
@@ -4998,6 +5157,11 @@ void quic_conn_release(struct quic_conn *qc)
 		qc->timer_task = NULL;
 	}
 
+	if (qc->pacing_task) {
+		task_destroy(qc->pacing_task);
+		qc->pacing_task = NULL;
+	}
+
 	tasklet_free(qc->wait_event.tasklet);
 
 	/* remove the connection from receiver cids trees */
@@ -5027,6 +5191,7 @@ void quic_conn_release(struct quic_conn *qc)
 		quic_free_arngs(qc, &qc->pktns[i].rx.arngs);
 	}
 
+	qc_frm_cache_purge(qc);
 	pool_free(pool_head_quic_conn_rxbuf, qc->rx.buf.area);
 	pool_free(pool_head_quic_conn, qc);
 	TRACE_PROTO("QUIC conn. freed", QUIC_EV_CONN_FREED, qc);
@@ -5050,9 +5215,21 @@ static int quic_conn_init_timer(struct quic_conn *qc)
 	}
 
 	qc->timer = TICK_ETERNITY;
+	qc->ack_timer = TICK_ETERNITY;
 	qc->timer_task->process = qc_process_timer;
 	qc->timer_task->context = qc;
 
+	if (!(global.tune.options & GTUNE_QUIC_NO_PACING)) {
+		qc->pacing_task = task_new_on(qc->tid);
+		if (!qc->pacing_task) {
+			TRACE_ERROR("pacing task allocation failed", QUIC_EV_CONN_NEW, qc);
+			goto leave;
+		}
+
+		qc->pacing_task->process = qc_pacing_task;
+		qc->pacing_task->context = qc;
+	}
+
 	ret = 1;
  leave:
 	TRACE_LEAVE(QUIC_EV_CONN_NEW, qc);
@@ -5518,6 +5695,24 @@ static int quic_generate_retry_token_aad(unsigned char *aad,
 	return p - aad;
 }
 
+/* QUIC server only function.
+ * Compute the keyed hash appended to Retry tokens over <aad> and the first
+ * <len> bytes of <token>. The key is derived from the cluster secret and from
+ * <period>, the QUIC_RETRY_DURATION_MS time slot, so that it rotates. This is
+ * not a MAC, only a cheap way to drop forged tokens before running the costly
+ * HKDF and AEAD token validation.
+ */
+static uint64_t quic_retry_token_cookie(const unsigned char *aad, size_t aadlen,
+                                        const unsigned char *token, size_t len,
+                                        uint32_t period)
+{
+	uint64_t seed;
+
+	seed = XXH64(global.cluster_secret, strlen(global.cluster_secret), period);
+	seed = XXH64(aad, aadlen, seed);
+	return XXH64(token, len, seed);
+}
+
 /* QUIC server only function.
  * Generate the token to be used in Retry packets. The token is written to
  * <buf> with <len> as length. <odcid> is the original destination connection
@@ -5551,7 +5746,7 @@ static int quic_generate_retry_token(unsigned char *buf, size_t len,
 	 * length, the format token byte. It is followed by an AEAD TAG, and finally
 	 * the random bytes used to derive the secret to encrypt the token.
 	 */
-	if (1 + dcid->len + 1 + QUIC_TLS_TAG_LEN + sizeof salt > len)
+	if (1 + dcid->len + 1 + QUIC_TLS_TAG_LEN + sizeof salt + QUIC_RETRY_TOKEN_COOKIELEN > len)
 		goto err;
 
 	aadlen = quic_generate_retry_token_aad(aad, version, dcid, addr);
@@ -5590,6 +5785,9 @@ static int quic_generate_retry_token(unsigned char *buf, size_t len,
 	p += QUIC_TLS_TAG_LEN;
 	memcpy(p, salt, sizeof salt);
 	p += sizeof salt;
+	write_u64(p, quic_retry_token_cookie(aad, aadlen, buf, p - buf,
+	                                     timestamp / QUIC_RETRY_DURATION_MS));
+	p += QUIC_RETRY_TOKEN_COOKIELEN;
 	EVP_CIPHER_CTX_free(ctx);
 
 	ret = p - buf;
@@ -5625,7 +5823,7 @@ static int quic_retry_token_check(struct quic_rx_packet *pkt,
 	struct quic_counters *prx_counters;
 	int ret = 0;
 	unsigned char *token = pkt->token;
-	const uint64_t tokenlen = pkt->token_len;
+	uint64_t tokenlen = pkt->token_len;
 	unsigned char buf[128];
 	unsigned char aad[sizeof(uint32_t) + sizeof(in_port_t) +
 	                  sizeof(struct in6_addr) + QUIC_CID_MAXLEN];
@@ -5639,6 +5837,8 @@ static int quic_retry_token_check(struct quic_rx_packet *pkt,
 	const EVP_CIPHER *aead = EVP_aes_128_gcm();
 	const struct quic_version *qv = qc ? qc->original_version :
 	                                     pkt->version;
+	uint32_t period = (uint32_t)now_ms / QUIC_RETRY_DURATION_MS;
+	uint64_t cookie;
 
 	TRACE_ENTER(QUIC_EV_CONN_LPKT, qc);
 
@@ -5659,7 +5859,26 @@ static int quic_retry_token_check(struct quic_rx_packet *pkt,
 		goto err;
 	}
 
+	if (tokenlen < 1 + QUIC_TLS_TAG_LEN + QUIC_RETRY_TOKEN_SALTLEN + QUIC_RETRY_TOKEN_COOKIELEN) {
+		TRACE_ERROR("too short token", QUIC_EV_CONN_LPKT, qc);
+		goto err;
+	}
+
 	aadlen = quic_generate_retry_token_aad(aad, qv->num, &pkt->scid, &dgram->saddr);
+
+	/* Check the keyed hash first so that forged tokens, which are the
+	 * common case during Initial floods, are dropped without deriving
+	 * any secret. The token may have been generated during the previous
+	 * period.
+	 */
+	tokenlen -= QUIC_RETRY_TOKEN_COOKIELEN;
+	cookie = read_u64(token + tokenlen);
+	if (cookie != quic_retry_token_cookie(aad, aadlen, token, tokenlen, period) &&
+	    cookie != quic_retry_token_cookie(aad, aadlen, token, tokenlen, period - 1)) {
+		TRACE_ERROR("Invalid retry token cookie", QUIC_EV_CONN_LPKT, qc);
+		goto err;
+	}
+
 	salt = token + tokenlen - QUIC_RETRY_TOKEN_SALTLEN;
 	if (!quic_tls_derive_retry_token_secret(EVP_sha256(), key, sizeof key, iv, sizeof iv,
 	                                        salt, QUIC_RETRY_TOKEN_SALTLEN, sec, seclen)) {
@@ -6040,7 +6259,9 @@ static struct quic_conn *quic_rx_pkt_retrieve_conn(struct quic_rx_packet *pkt,
 			int ipv4;
 
 			if (global.cluster_secret && !pkt->token_len && !(l->bind_conf->options & BC_O_QUIC_FORCE_RETRY) &&
-			    HA_ATOMIC_LOAD(&prx_counters->half_open_conn) >= global.tune.quic_retry_threshold) {
+			    (HA_ATOMIC_LOAD(&prx_counters->half_open_conn) >= global.tune.quic_retry_threshold ||
+			     (global.tune.quic_retry_rate &&
+			      update_freq_ctr(&quic_initial_per_sec, 1) > global.tune.quic_retry_rate))) {
 				TRACE_PROTO("Initial without token, sending retry",
 				            QUIC_EV_CONN_LPKT, NULL, NULL, NULL, pkt->version);
 				if (send_retry(l->rx.fd, &dgram->saddr, pkt, pkt->version)) {
@@ -6572,15 +6793,15 @@ static int quic_apply_header_protection(struct quic_conn *qc, unsigned char *buf
 
 {
 	int i, ret = 0;
-	/* We need an IV of at least 5 bytes: one byte for bytes #0
+	/* We need a mask of 5 bytes: one byte for bytes #0
 	 * and at most 4 bytes for the packet number
 	 */
-	unsigned char mask[5] = {0};
+	unsigned char mask[QUIC_TLS_HP_MASK_LEN];
 	EVP_CIPHER_CTX *aes_ctx = tls_ctx->tx.hp_ctx;
 
 	TRACE_ENTER(QUIC_EV_CONN_TXPKT, qc);
 
-	if (!quic_tls_aes_encrypt(mask, pn + QUIC_PACKET_PN_MAXLEN, sizeof mask, aes_ctx)) {
+	if (!quic_tls_hp_mask(mask, pn + QUIC_PACKET_PN_MAXLEN, aes_ctx)) {
 		TRACE_ERROR("could not apply header protection", QUIC_EV_CONN_TXPKT, qc);
 		goto out;
 	}
@@ -6700,7 +6921,7 @@ static inline int qc_build_frms(struct list *outlist, struct list *inlist,
 			else {
 				struct quic_frame *new_cf;
 
-				new_cf = pool_zalloc(pool_head_quic_frame);
+				new_cf = qc_frm_alloc(qc);
 				if (!new_cf) {
 					TRACE_ERROR("No memory for new crypto frame", QUIC_EV_CONN_BCFRMS, qc);
 					continue;
@@ -6739,7 +6960,7 @@ static inline int qc_build_frms(struct list *outlist, struct list *inlist,
 				if (!node) {
 					TRACE_DEVEL("released stream", QUIC_EV_CONN_PRSAFRM, qc, cf);
 					LIST_DELETE(&cf->list);
-					pool_free(pool_head_quic_frame, cf);
+					qc_frm_free(qc, cf);
 					continue;
 				}
 
@@ -6748,7 +6969,7 @@ static inline int qc_build_frms(struct list *outlist, struct list *inlist,
 					TRACE_DEVEL("ignored frame frame in already acked range",
 					            QUIC_EV_CONN_PRSAFRM, qc, cf);
 					LIST_DELETE(&cf->list);
-					pool_free(pool_head_quic_frame, cf);
+					qc_frm_free(qc, cf);
 					continue;
 				}
 				else if (strm->offset.key < stream_desc->ack_offset) {
@@ -6810,7 +7031,7 @@ static inline int qc_build_frms(struct list *outlist, struct list *inlist,
 				struct quic_frame *new_cf;
 				struct buffer cf_buf;
 
-				new_cf = pool_zalloc(pool_head_quic_frame);
+				new_cf = qc_frm_alloc(qc);
 				if (!new_cf) {
 					TRACE_ERROR("No memory for new STREAM frame", QUIC_EV_CONN_BCFRMS, qc);
 					continue;
@@ -7010,7 +7231,7 @@ static int qc_do_build_pkt(unsigned char *pos, const unsigned char *end,
 	nb_aepkts_since_last_ack = qel->pktns->rx.nb_aepkts_since_last_ack;
 	must_ack = !qel->pktns->tx.pto_probe &&
 		(force_ack || ((qel->pktns->flags & QUIC_FL_PKTNS_ACK_REQUIRED) &&
-		 (LIST_ISEMPTY(frms) || nb_aepkts_since_last_ack >= QUIC_MAX_RX_AEPKTS_SINCE_LAST_ACK)));
+		 (LIST_ISEMPTY(frms) || nb_aepkts_since_last_ack >= global.tune.quic_frontend_ack_threshold)));
 	if (must_ack) {
 	    struct quic_arngs *arngs = &qel->pktns->rx.arngs;
 	    BUG_ON(eb_is_empty(&qel->pktns->rx.arngs.root));
@@ -7195,6 +7416,8 @@ static inline void quic_tx_packet_init(struct quic_tx_packet *pkt, int type)
 	pkt->pn_node.key = (uint64_t)-1;
 	LIST_INIT(&pkt->frms);
 	pkt->time_sent = TICK_ETERNITY;
+	pkt->delivered = 0;
+	pkt->delivered_time = pkt->first_sent_time = 0;
 	pkt->next = NULL;
 	pkt->prev = NULL;
 	pkt->largest_acked_pn = -1;
@@ -7291,6 +7514,7 @@ static struct quic_tx_packet *qc_build_pkt(unsigned char **pos,
 	if (pkt->flags & QUIC_FL_TX_PACKET_ACK) {
 		qel->pktns->flags &= ~QUIC_FL_PKTNS_ACK_REQUIRED;
 		qel->pktns->rx.nb_aepkts_since_last_ack = 0;
+		qc->ack_timer = TICK_ETERNITY;
 	}
 
 	pkt->pktns = qel->pktns;
@@ -7531,6 +7755,167 @@ void qc_notify_close(struct quic_conn *qc)
 	TRACE_LEAVE(QUIC_EV_CONN_CLOSE, qc);
 }
 
+/* appctx context used by "show quic" command */
+struct show_quic_ctx {
+	unsigned int epoch;
+	struct bref bref; /* back-reference to the quic-conn being dumped */
+	unsigned int thr;
+};
+
+static int cli_parse_show_quic(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	struct show_quic_ctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+
+	if (!cli_has_level(appctx, ACCESS_LVL_OPER))
+		return 1;
+
+	ctx->epoch = _HA_ATOMIC_FETCH_ADD(&qc_epoch, 1);
+	ctx->thr = 0;
+	LIST_INIT(&ctx->bref.users);
+
+	return 0;
+}
+
+/* Append to the trash the memory held by <qc>, with buffers sizes in bytes,
+ * for the "show quic" command run by <appctx>. Must be called under thread
+ * isolation.
+ */
+static void dump_quic_mem(struct appctx *appctx, struct quic_conn *qc)
+{
+	char pn[INET6_ADDRSTRLEN];
+	struct eb64_node *node;
+	size_t strm_bufs, qcs_bufs = 0;
+	int nb_qcs = 0;
+
+	if (qc->mux_state == QC_MUX_READY) {
+		for (node = eb64_first(&qc->qcc->streams_by_id); node; node = eb64_next(node)) {
+			struct qcs *qcs = eb64_entry(node, struct qcs, by_id);
+
+			qcs_bufs += b_size(&qcs->tx.buf) + b_size(&qcs->rx.app_buf);
+			if (!ncb_is_null(&qcs->rx.ncbuf))
+				qcs_bufs += qcs->rx.ncbuf.size;
+			++nb_qcs;
+		}
+	}
+	strm_bufs = (size_t)qc->stream_buf_count * global.tune.bufsize;
+
+	chunk_appendf(&trash, "%p: thr=%d", qc, qc->tid);
+	switch (addr_to_str(&qc->peer_addr, pn, sizeof(pn))) {
+	case AF_INET:
+	case AF_INET6:
+		chunk_appendf(&trash, " src=%s:%d", HA_ANON_CLI(pn), get_host_port(&qc->peer_addr));
+		break;
+	}
+	chunk_appendf(&trash, " fe=%s st=%d qcs=%d",
+	              qc->li ? HA_ANON_CLI(qc->li->bind_conf->frontend->id) : "<none>",
+	              qc->state, nb_qcs);
+	chunk_appendf(&trash, " mem=%lu [conn=%lu rxbuf=%lu txbuf=%lu strmbufs=%d/%u(%lu) qcsbufs=%lu frmcache=%u]\n",
+	              (ulong)(sizeof(*qc) + b_size(&qc->rx.buf) + b_size(&qc->tx.buf) + strm_bufs + qcs_bufs),
+	              (ulong)sizeof(*qc), (ulong)b_size(&qc->rx.buf), (ulong)b_size(&qc->tx.buf),
+	              qc->stream_buf_count, global.tune.quic_streams_buf, (ulong)strm_bufs,
+	              (ulong)qcs_bufs, qc->frm_cache_cnt);
+}
+
+static int cli_io_handler_dump_quic(struct appctx *appctx)
+{
+	struct show_quic_ctx *ctx = appctx->svcctx;
+	struct stconn *sc = appctx_sc(appctx);
+	struct quic_conn *qc;
+
+	thread_isolate();
+
+	if (ctx->thr >= global.nbthread)
+		goto done;
+
+	if (unlikely(sc_ic(sc)->flags & (CF_WRITE_ERROR|CF_SHUTW))) {
+		/* If we're forced to shut down, we might have to remove our
+		 * reference to the last quic-conn being dumped.
+		 */
+		if (!LIST_ISEMPTY(&ctx->bref.users)) {
+			LIST_DELETE(&ctx->bref.users);
+			LIST_INIT(&ctx->bref.users);
+		}
+		goto done;
+	}
+
+	chunk_reset(&trash);
+
+	if (!LIST_ISEMPTY(&ctx->bref.users)) {
+		/* Remove show quic ctx from previous quic_conn instance. */
+		LIST_DELETE(&ctx->bref.users);
+		LIST_INIT(&ctx->bref.users);
+	}
+	else if (!ctx->bref.ref) {
+		/* First invocation. */
+		ctx->bref.ref = ha_thread_ctx[ctx->thr].quic_conns.n;
+	}
+
+	while (1) {
+		int done = 0;
+
+		if (ctx->bref.ref == &ha_thread_ctx[ctx->thr].quic_conns) {
+			done = 1;
+		}
+		else {
+			qc = LIST_ELEM(ctx->bref.ref, struct quic_conn *, el_th_ctx);
+			if ((int)(qc->qc_epoch - ctx->epoch) > 0)
+				done = 1;
+		}
+
+		if (done) {
+			++ctx->thr;
+			if (ctx->thr >= global.nbthread)
+				break;
+			ctx->bref.ref = ha_thread_ctx[ctx->thr].quic_conns.n;
+			continue;
+		}
+
+		dump_quic_mem(appctx, qc);
+		if (applet_putchk(appctx, &trash) == -1) {
+			/* Register show quic ctx to quic_conn instance. */
+			LIST_APPEND(&qc->back_refs, &ctx->bref.users);
+			goto full;
+		}
+
+		ctx->bref.ref = qc->el_th_ctx.n;
+	}
+
+ done:
+	thread_release();
+	return 1;
+ full:
+	thread_release();
+	return 0;
+}
+
+static void cli_release_show_quic(struct appctx *appctx)
+{
+	struct show_quic_ctx *ctx = appctx->svcctx;
+
+	if (ctx->thr < global.nbthread) {
+		thread_isolate();
+		if (!LIST_ISEMPTY(&ctx->bref.users))
+			LIST_DELETE(&ctx->bref.users);
+		thread_release();
+	}
+}
+
+static struct cli_kw_list cli_kws = {{ }, {
+	{ { "show", "quic", NULL }, "show quic                               : display quic connections memory usage", cli_parse_show_quic, cli_io_handler_dump_quic, cli_release_show_quic },
+	{{},}
+}};
+
+INITCALL1(STG_REGISTER, cli_register_kw, &cli_kws);
+
+static void init_quic()
+{
+	int thr;
+
+	for (thr = 0; thr < MAX_THREADS; thr++)
+		LIST_INIT(&ha_thread_ctx[thr].quic_conns);
+}
+INITCALL0(STG_INIT, init_quic);
+
 /*
  * Local variables:
  *  c-indent-level: 8
@@ -203,3 +203,54 @@ void qc_packet_loss_lookup(struct quic_pktns *pktns, struct quic_conn *qc,
 	TRACE_LEAVE(QUIC_EV_CONN_PKTLOSS, qc, pktns, lost_pkts);
 }
 
+
+/* Delivery rate sampling, inspired from draft-cheng-iccrg-delivery-rate-estimation.
+ * Each packet remembers how many bytes had been acknowledged on the path when
+ * it was sent, and when. When it is acknowledged, the difference with the
+ * path's current count gives the amount of data delivered meanwhile. The
+ * sampling interval is the largest one of the send and the ACK intervals, so
+ * that ACK compression cannot inflate the rate.
+ */
+
+/* Records into <pkt> the delivery state of the path of <ql> loss information
+ * before it is sent, with <in_flight> the amount of bytes in flight on this
+ * path. Only packets counted in flight make sense here.
+ */
+void quic_loss_pkt_sent(struct quic_loss *ql, struct quic_tx_packet *pkt,
+                        uint64_t in_flight)
+{
+	/* a new flight starts, the idle period must not count in the
+	 * intervals.
+	 */
+	if (!in_flight)
+		ql->first_sent_time = ql->delivered_time = pkt->time_sent;
+
+	pkt->delivered = ql->delivered;
+	pkt->delivered_time = ql->delivered_time;
+	pkt->first_sent_time = ql->first_sent_time;
+}
+
+/* Updates the delivery state of the path of <ql> loss information upon
+ * acknowledgement of <pkt> and fills the delivery rate sample of <ev> ACK
+ * event.
+ */
+void quic_loss_pkt_acked(struct quic_loss *ql, struct quic_tx_packet *pkt,
+                         struct quic_cc_event *ev)
+{
+	unsigned int send_elapsed, ack_elapsed;
+
+	ev->ack.delivered = 0;
+	ev->ack.interval = 0;
+	if (!pkt->in_flight_len)
+		return;
+
+	ql->delivered += pkt->in_flight_len;
+	ql->delivered_time = now_ms;
+	if (tick_is_lt(ql->first_sent_time, pkt->time_sent))
+		ql->first_sent_time = pkt->time_sent;
+
+	send_elapsed = pkt->time_sent - pkt->first_sent_time;
+	ack_elapsed = ql->delivered_time - pkt->delivered_time;
+	ev->ack.delivered = ql->delivered - pkt->delivered;
+	ev->ack.interval = QUIC_MAX(send_elapsed, ack_elapsed);
+}
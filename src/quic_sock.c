@@ -168,25 +168,60 @@ struct connection *quic_sock_accept_conn(struct listener *l, int *status)
 	return NULL;
 }
 
-/* QUIC datagrams handler task. */
+/* QUIC datagrams handler task. Datagrams are dequeued by batches of up to
+ * QUIC_DGRAM_BATCH, and the connection IDs of a batch are looked up all at
+ * once first so that the tree walks and the connections accesses overlap.
+ * The parsing then finds everything hot in the caches.
+ */
 struct task *quic_lstnr_dghdlr(struct task *t, void *ctx, unsigned int state)
 {
 	struct quic_dghdlr *dghdlr = ctx;
+	struct quic_dgram *dgrams[QUIC_DGRAM_BATCH];
+	const void *keys[QUIC_DGRAM_BATCH];
+	unsigned int lens[QUIC_DGRAM_BATCH];
+	struct ebmb_node *nodes[QUIC_DGRAM_BATCH];
 	struct quic_dgram *dgram;
 	int max_dgrams = global.tune.maxpollevents;
+	int nb, i;
 
 	TRACE_ENTER(QUIC_EV_CONN_LPKT);
 
-	while ((dgram = MT_LIST_POP(&dghdlr->dgrams, typeof(dgram), handler_list))) {
-		if (quic_dgram_parse(dgram, NULL, dgram->owner)) {
-			/* TODO should we requeue the datagram ? */
+	while (1) {
+		for (nb = 0; nb < QUIC_DGRAM_BATCH && nb < max_dgrams; nb++) {
+			dgram = MT_LIST_POP(&dghdlr->dgrams, typeof(dgram), handler_list);
+			if (!dgram)
+				break;
+			dgrams[nb] = dgram;
+			keys[nb] = dgram->dcid;
+			lens[nb] = dgram->dcid_len;
+		}
+
+		if (!nb)
 			break;
+
+		if (nb > 1 && ebmb_lookup_multi(&dghdlr->cids, keys, lens, nodes, nb)) {
+			for (i = 0; i < nb; i++) {
+				if (nodes[i])
+					__builtin_prefetch(ebmb_entry(nodes[i], struct quic_connection_id, node)->qc);
+			}
 		}
 
-		if (--max_dgrams <= 0)
+		for (i = 0; i < nb; i++) {
+			if (quic_dgram_parse(dgrams[i], NULL, dgrams[i]->owner)) {
+				/* TODO should we requeue the datagram ? */
+				/* put the remaining ones back in their original order */
+				while (--nb > i)
+					MT_LIST_INSERT(&dghdlr->dgrams, &dgrams[nb]->handler_list);
+				goto leave;
+			}
+		}
+
+		max_dgrams -= nb;
+		if (max_dgrams <= 0)
 			goto stop_here;
 	}
 
+ leave:
 	TRACE_LEAVE(QUIC_EV_CONN_LPKT);
 	return t;
 
@@ -200,8 +235,11 @@ struct task *quic_lstnr_dghdlr(struct task *t, void *ctx, unsigned int state)
 }
 
 /* Retrieve the DCID from the datagram found in <buf> and deliver it to the
- * correct datagram handler.
- * Return 1 if a correct datagram could be found, 0 if not.
+ * correct datagram handler. The handler is not woken up, this is left to the
+ * caller so that it may be done once for a batch of datagrams (see
+ * quic_dghdlr_wakeup()).
+ * Return the thread ID of the datagram handler if a correct datagram could be
+ * found, -1 if not.
  */
 static int quic_lstnr_dgram_dispatch(unsigned char *buf, size_t len, void *owner,
                                      struct sockaddr_storage *saddr,
@@ -237,14 +275,29 @@ static int quic_lstnr_dgram_dispatch(unsigned char *buf, size_t len, void *owner
 	LIST_APPEND(dgrams, &dgram->recv_list);
 	MT_LIST_APPEND(&quic_dghdlrs[cid_tid].dgrams, &dgram->handler_list);
 
-	/* typically quic_lstnr_dghdlr() */
-	tasklet_wakeup(quic_dghdlrs[cid_tid].task);
-
-	return 1;
+	return cid_tid;
 
  err:
 	pool_free(pool_head_quic_dgram, new_dgram);
-	return 0;
+	return -1;
+}
+
+/* Wakes up the datagram handlers of the <nb> threads whose IDs are in <tids>.
+ * The same thread may appear multiple times, it is only woken up once, which
+ * saves an atomic operation on a remote thread's tasklet for each datagram
+ * after the first one.
+ */
+static void quic_dghdlr_wakeup(const int *tids, int nb)
+{
+	int i, j;
+
+	for (i = 0; i < nb; i++) {
+		for (j = 0; j < i && tids[j] != tids[i]; j++)
+			;
+		if (j == i)
+			/* typically quic_lstnr_dghdlr() */
+			tasklet_wakeup(quic_dghdlrs[tids[i]].task);
+	}
 }
 
 /* This function is responsible to remove unused datagram attached in front of
@@ -279,63 +332,32 @@ static struct quic_dgram *quic_rxbuf_purge_dgrams(struct quic_receiver_buf *buf)
 	return prev;
 }
 
-/* Receive data from datagram socket <fd>. Data are placed in <out> buffer of
- * length <len>.
- *
- * Datagram addresses will be returned via the next arguments. <from> will be
- * the peer address and <to> the reception one. Note that <to> can only be
- * retrieved if the socket supports IP_PKTINFO or affiliated options. If not,
- * <to> will be set as AF_UNSPEC. The caller must specify <to_port> to ensure
- * that <to> address is completely filled.
- *
- * Returns value from recvmsg syscall.
+/* Ancillary data which may be used to retrieve the reception address of a
+ * datagram.
  */
-static ssize_t quic_recv(int fd, void *out, size_t len,
-                         struct sockaddr *from, socklen_t from_len,
-                         struct sockaddr *to, socklen_t to_len,
-                         uint16_t dst_port)
-{
-	union pktinfo {
+union pktinfo {
 #ifdef IP_PKTINFO
-		struct in_pktinfo in;
+	struct in_pktinfo in;
 #else /* !IP_PKTINFO */
-		struct in_addr addr;
+	struct in_addr addr;
 #endif
 #ifdef IPV6_RECVPKTINFO
-		struct in6_pktinfo in6;
+	struct in6_pktinfo in6;
 #endif
-	};
-	char cdata[CMSG_SPACE(sizeof(union pktinfo))];
-	struct msghdr msg;
-	struct iovec vec;
-	struct cmsghdr *cmsg;
-	ssize_t ret;
+};
 
-	vec.iov_base = out;
-	vec.iov_len  = len;
-
-	memset(&msg, 0, sizeof(msg));
-	msg.msg_name    = from;
-	msg.msg_namelen = from_len;
-	msg.msg_iov     = &vec;
-	msg.msg_iovlen  = 1;
-	msg.msg_control = &cdata;
-	msg.msg_controllen = sizeof(cdata);
-
-	clear_addr((struct sockaddr_storage *)to);
-
-	do {
-		ret = recvmsg(fd, &msg, 0);
-	} while (ret < 0 && errno == EINTR);
-
-	/* TODO handle errno. On EAGAIN/EWOULDBLOCK use fd_cant_recv() if
-	 * using dedicated connection socket.
-	 */
-
-	if (ret < 0)
-		goto end;
+/* Retrieve the reception address of a datagram from the ancillary data of
+ * <msg> as filled by recvmsg() and store it into <to> of length <to_len>. Note
+ * that <to> can only be retrieved if the socket supports IP_PKTINFO or
+ * affiliated options. If not, <to> is left untouched. The caller must specify
+ * <dst_port> to ensure that <to> address is completely filled.
+ */
+static void quic_recv_get_dst(struct msghdr *msg, struct sockaddr *to, socklen_t to_len,
+                              uint16_t dst_port)
+{
+	struct cmsghdr *cmsg;
 
-	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
 		switch (cmsg->cmsg_level) {
 		case IPPROTO_IP:
 #if defined(IP_PKTINFO)
@@ -379,27 +401,138 @@ static ssize_t quic_recv(int fd, void *out, size_t len,
 			break;
 		}
 	}
+}
+
+/* Receive data from datagram socket <fd>. Data are placed in <out> buffer of
+ * length <len>.
+ *
+ * Datagram addresses will be returned via the next arguments. <from> will be
+ * the peer address and <to> the reception one. Note that <to> can only be
+ * retrieved if the socket supports IP_PKTINFO or affiliated options. If not,
+ * <to> will be set as AF_UNSPEC. The caller must specify <to_port> to ensure
+ * that <to> address is completely filled.
+ *
+ * Returns value from recvmsg syscall.
+ */
+static inline ssize_t quic_recv(int fd, void *out, size_t len,
+                                struct sockaddr *from, socklen_t from_len,
+                                struct sockaddr *to, socklen_t to_len,
+                                uint16_t dst_port)
+{
+	char cdata[CMSG_SPACE(sizeof(union pktinfo))];
+	struct msghdr msg;
+	struct iovec vec;
+	ssize_t ret;
+
+	vec.iov_base = out;
+	vec.iov_len  = len;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name    = from;
+	msg.msg_namelen = from_len;
+	msg.msg_iov     = &vec;
+	msg.msg_iovlen  = 1;
+	msg.msg_control = &cdata;
+	msg.msg_controllen = sizeof(cdata);
+
+	clear_addr((struct sockaddr_storage *)to);
+
+	do {
+		ret = recvmsg(fd, &msg, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	/* TODO handle errno. On EAGAIN/EWOULDBLOCK use fd_cant_recv() if
+	 * using dedicated connection socket.
+	 */
+
+	if (ret >= 0)
+		quic_recv_get_dst(&msg, to, to_len, dst_port);
+
+	return ret;
+}
+
+/* Receive up to <count> datagrams from datagram socket <fd>, using a single
+ * recvmmsg() syscall when supported. Datagram <i> is placed at <out> + <i> *
+ * <len> and its length is stored into <lens>[i], so <out> must be able to
+ * hold <count> * <len> bytes. <count> must not be greater than
+ * QUIC_MAX_MMSG_DGRAMS. The addresses of datagram <i> are returned into
+ * <from>[i] and <to>[i] the same way as quic_recv() does.
+ *
+ * Returns the number of datagrams received, or a negative value on error,
+ * including when no datagram is available.
+ */
+static int quic_recv_dgrams(int fd, unsigned char *out, size_t len, int count,
+                            size_t *lens, struct sockaddr_storage *from,
+                            struct sockaddr_storage *to, uint16_t dst_port)
+{
+#ifdef HA_HAVE_MMSG
+	char cdata[QUIC_MAX_MMSG_DGRAMS][CMSG_SPACE(sizeof(union pktinfo))];
+	struct mmsghdr msgs[QUIC_MAX_MMSG_DGRAMS];
+	struct iovec vecs[QUIC_MAX_MMSG_DGRAMS];
+	int i, ret;
+
+	BUG_ON(count > QUIC_MAX_MMSG_DGRAMS);
+
+	memset(msgs, 0, count * sizeof(*msgs));
+	for (i = 0; i < count; i++) {
+		vecs[i].iov_base = out + i * len;
+		vecs[i].iov_len  = len;
+
+		msgs[i].msg_hdr.msg_name    = &from[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+		msgs[i].msg_hdr.msg_iov     = &vecs[i];
+		msgs[i].msg_hdr.msg_iovlen  = 1;
+		msgs[i].msg_hdr.msg_control = cdata[i];
+		msgs[i].msg_hdr.msg_controllen = sizeof(cdata[i]);
+	}
+
+	do {
+		ret = recvmmsg(fd, msgs, count, 0, NULL);
+	} while (ret < 0 && errno == EINTR);
+
+	for (i = 0; i < ret; i++) {
+		lens[i] = msgs[i].msg_len;
+		clear_addr(&to[i]);
+		quic_recv_get_dst(&msgs[i].msg_hdr, (struct sockaddr *)&to[i], sizeof(to[i]), dst_port);
+	}
 
- end:
 	return ret;
+#else
+	ssize_t ret;
+
+	ret = quic_recv(fd, out, len,
+	                (struct sockaddr *)&from[0], sizeof(from[0]),
+	                (struct sockaddr *)&to[0], sizeof(to[0]),
+	                dst_port);
+	if (ret < 0)
+		return -1;
+
+	lens[0] = ret;
+	return 1;
+#endif
 }
 
 /* Function called on a read event from a listening socket. It tries
- * to handle as many connections as possible.
+ * to handle as many connections as possible. Datagrams are received by
+ * batches of up to QUIC_MAX_MMSG_DGRAMS when the platform supports it, then
+ * dispatched one at a time to their respective datagram handlers.
  */
 void quic_lstnr_sock_fd_iocb(int fd)
 {
-	ssize_t ret;
+	int ret;
 	struct quic_receiver_buf *rxbuf;
 	struct buffer *buf;
 	struct listener *l = objt_listener(fdtab[fd].owner);
 	struct quic_transport_params *params;
-	/* Source address */
-	struct sockaddr_storage saddr = {0}, daddr = {0};
+	struct quic_counters *prx_counters;
+	/* Source and destination addresses */
+	struct sockaddr_storage saddr[QUIC_MAX_MMSG_DGRAMS], daddr[QUIC_MAX_MMSG_DGRAMS];
+	size_t dgram_len[QUIC_MAX_MMSG_DGRAMS];
+	int dgram_tid[QUIC_MAX_MMSG_DGRAMS];
 	size_t max_sz, cspace;
 	struct quic_dgram *new_dgram;
 	unsigned char *dgram_buf;
-	int max_dgrams;
+	int max_dgrams, batch, i, nb_tid;
 
 	BUG_ON(!l);
 
@@ -415,6 +548,7 @@ void quic_lstnr_sock_fd_iocb(int fd)
 		goto out;
 
 	buf = &rxbuf->buf;
+	prx_counters = EXTRA_COUNTERS_GET(l->bind_conf->frontend->extra_counters_fe, &quic_stats_module);
 
 	max_dgrams = global.tune.maxpollevents;
  start:
@@ -428,8 +562,6 @@ void quic_lstnr_sock_fd_iocb(int fd)
 	max_sz = params->max_udp_payload_size;
 	cspace = b_contig_space(buf);
 	if (cspace < max_sz) {
-		struct proxy *px = l->bind_conf->frontend;
-		struct quic_counters *prx_counters = EXTRA_COUNTERS_GET(px->extra_counters_fe, &quic_stats_module);
 		struct quic_dgram *dgram;
 
 		/* Do no mark <buf> as full, and do not try to consume it
@@ -457,28 +589,56 @@ void quic_lstnr_sock_fd_iocb(int fd)
 
 		/* Consume the remaining space */
 		b_add(buf, cspace);
-		if (b_contig_space(buf) < max_sz) {
+		cspace = b_contig_space(buf);
+		if (cspace < max_sz) {
 			HA_ATOMIC_INC(&prx_counters->rxbuf_full);
 			goto out;
 		}
 	}
 
+	/* receive as many datagrams as the contiguous space permits, each of
+	 * them being placed at a multiple of <max_sz> from the buffer's tail.
+	 */
+	batch = MIN(cspace / max_sz, max_dgrams);
+	batch = MIN(batch, QUIC_MAX_MMSG_DGRAMS);
+
 	dgram_buf = (unsigned char *)b_tail(buf);
-	ret = quic_recv(fd, dgram_buf, max_sz,
-	                (struct sockaddr *)&saddr, sizeof(saddr),
-	                (struct sockaddr *)&daddr, sizeof(daddr),
-	                get_net_port(&l->rx.addr));
+	ret = quic_recv_dgrams(fd, dgram_buf, max_sz, batch, dgram_len,
+	                       saddr, daddr, get_net_port(&l->rx.addr));
 	if (ret <= 0)
 		goto out;
 
-	b_add(buf, ret);
-	if (!quic_lstnr_dgram_dispatch(dgram_buf, ret, l, &saddr, &daddr,
-	                               new_dgram, &rxbuf->dgram_list)) {
-		/* If wrong, consume this datagram */
-		b_sub(buf, ret);
+	HA_ATOMIC_INC(&prx_counters->rx_syscalls);
+	HA_ATOMIC_ADD(&prx_counters->rx_dgrams, ret);
+
+	for (i = nb_tid = 0; i < ret; i++) {
+		unsigned char *pos = (unsigned char *)b_tail(buf);
+		int cid_tid;
+
+		/* pack the datagrams received in a same batch right after
+		 * each other. The destination never overlaps a datagram which
+		 * was not yet moved since the tail is always behind it.
+		 */
+		if (pos != dgram_buf + i * max_sz)
+			memmove(pos, dgram_buf + i * max_sz, dgram_len[i]);
+
+		b_add(buf, dgram_len[i]);
+		cid_tid = quic_lstnr_dgram_dispatch(pos, dgram_len[i], l, &saddr[i], &daddr[i],
+		                                    new_dgram, &rxbuf->dgram_list);
+		if (cid_tid < 0) {
+			/* If wrong, consume this datagram */
+			b_sub(buf, dgram_len[i]);
+		}
+		else
+			dgram_tid[nb_tid++] = cid_tid;
+		new_dgram = NULL;
 	}
-	new_dgram = NULL;
-	if (--max_dgrams > 0)
+
+	quic_dghdlr_wakeup(dgram_tid, nb_tid);
+
+	max_dgrams -= ret;
+	/* a short batch indicates that the socket was drained */
+	if (ret == batch && max_dgrams > 0)
 		goto start;
  out:
 	pool_free(pool_head_quic_dgram, new_dgram);
@@ -498,80 +658,178 @@ static void quic_conn_sock_fd_iocb(int fd)
 	TRACE_LEAVE(QUIC_EV_CONN_RCV, qc);
 }
 
-/* Send a datagram stored into <buf> buffer with <sz> as size.
- * The caller must ensure there is at least <sz> bytes in this buffer.
+/* Accounts the error reported in errno by a send syscall on <qc> socket. */
+static void qc_snd_err(struct quic_conn *qc)
+{
+	struct proxy *prx = qc->li->bind_conf->frontend;
+	struct quic_counters *prx_counters =
+	  EXTRA_COUNTERS_GET(prx->extra_counters_fe,
+	                     &quic_stats_module);
+
+	/* TODO adjust errno for UDP context. */
+	if (errno == EAGAIN || errno == EWOULDBLOCK ||
+	    errno == ENOTCONN || errno == EINPROGRESS || errno == EBADF) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			HA_ATOMIC_INC(&prx_counters->socket_full);
+		else
+			HA_ATOMIC_INC(&prx_counters->sendto_err);
+	}
+	else if (errno) {
+		/* TODO unlisted errno : handle it explicitly.
+		 * ECONNRESET may be encounter on quic-conn socket.
+		 */
+		HA_ATOMIC_INC(&prx_counters->sendto_err_unknown);
+	}
+}
+
+/* Send the <count> datagrams described by <dgrams> array to <qc> peer, with a
+ * single sendmmsg() syscall when the platform supports it. <count> must not be
+ * greater than QUIC_MAX_MMSG_DGRAMS.
  *
- * Returns 0 on success else non-zero.
+ * Returns the number of datagrams which were completely sent. The datagrams
+ * after the first one which could not be sent are not sent either.
  *
- * TODO standardize this function for a generic UDP sendto wrapper. This can be
- * done by removing the <qc> arg and replace it with address/port.
+ * Note that UDP segmentation offload (UDP_SEGMENT) is not used because the
+ * datagrams are not contiguous in the TX buffer, they are interleaved with
+ * their metadata.
  */
-int qc_snd_buf(struct quic_conn *qc, const struct buffer *buf, size_t sz,
-               int flags)
+int qc_snd_dgrams(struct quic_conn *qc, struct iovec *dgrams, int count)
 {
-	ssize_t ret;
+	struct proxy *prx = qc->li->bind_conf->frontend;
+	struct quic_counters *prx_counters =
+	  EXTRA_COUNTERS_GET(prx->extra_counters_fe,
+	                     &quic_stats_module);
+	size_t total = 0;
+	int sent = 0;
+	int syscalls = 0;
+	int ret;
 
-	do {
-		if (qc_test_fd(qc)) {
-			ret = send(qc->fd, b_peek(buf, b_head_ofs(buf)), sz,
-			           MSG_DONTWAIT | MSG_NOSIGNAL);
-		}
-		else {
-			ret = sendto(qc->li->rx.fd, b_peek(buf, b_head_ofs(buf)), sz,
-			             MSG_DONTWAIT|MSG_NOSIGNAL,
-			             (struct sockaddr *)&qc->peer_addr,
-			             get_addr_len(&qc->peer_addr));
-		}
-	} while (ret < 0 && errno == EINTR);
+	BUG_ON(count > QUIC_MAX_MMSG_DGRAMS);
+
+#ifdef HA_HAVE_MMSG
+	{
+		struct mmsghdr msgs[QUIC_MAX_MMSG_DGRAMS];
+		int fd, i;
 
-	if (ret < 0 || ret != sz) {
-		struct proxy *prx = qc->li->bind_conf->frontend;
-		struct quic_counters *prx_counters =
-		  EXTRA_COUNTERS_GET(prx->extra_counters_fe,
-		                     &quic_stats_module);
-
-		/* TODO adjust errno for UDP context. */
-		if (errno == EAGAIN || errno == EWOULDBLOCK ||
-		    errno == ENOTCONN || errno == EINPROGRESS || errno == EBADF) {
-			if (errno == EAGAIN || errno == EWOULDBLOCK)
-				HA_ATOMIC_INC(&prx_counters->socket_full);
-			else
-				HA_ATOMIC_INC(&prx_counters->sendto_err);
+		memset(msgs, 0, count * sizeof(*msgs));
+		for (i = 0; i < count; i++) {
+			if (!qc_test_fd(qc)) {
+				msgs[i].msg_hdr.msg_name    = &qc->peer_addr;
+				msgs[i].msg_hdr.msg_namelen = get_addr_len(&qc->peer_addr);
+			}
+			msgs[i].msg_hdr.msg_iov    = &dgrams[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
 		}
-		else if (errno) {
-			/* TODO unlisted errno : handle it explicitly.
-			 * ECONNRESET may be encounter on quic-conn socket.
-			 */
-			HA_ATOMIC_INC(&prx_counters->sendto_err_unknown);
+
+		fd = qc_test_fd(qc) ? qc->fd : qc->li->rx.fd;
+		while (sent < count) {
+			do {
+				ret = sendmmsg(fd, msgs + sent, count - sent,
+				               MSG_DONTWAIT | MSG_NOSIGNAL);
+			} while (ret < 0 && errno == EINTR);
+
+			if (ret <= 0)
+				break;
+
+			syscalls++;
+			for (i = sent; i < sent + ret; i++) {
+				if (msgs[i].msg_len != dgrams[i].iov_len)
+					break;
+				total += msgs[i].msg_len;
+			}
+
+			if (i < sent + ret) {
+				/* truncated datagram */
+				sent = i;
+				errno = 0;
+				ret = -1;
+				break;
+			}
+			sent += ret;
 		}
+	}
+#else
+	while (sent < count) {
+		do {
+			if (qc_test_fd(qc)) {
+				ret = send(qc->fd, dgrams[sent].iov_base, dgrams[sent].iov_len,
+				           MSG_DONTWAIT | MSG_NOSIGNAL);
+			}
+			else {
+				ret = sendto(qc->li->rx.fd, dgrams[sent].iov_base, dgrams[sent].iov_len,
+				             MSG_DONTWAIT|MSG_NOSIGNAL,
+				             (struct sockaddr *)&qc->peer_addr,
+				             get_addr_len(&qc->peer_addr));
+			}
+		} while (ret < 0 && errno == EINTR);
+
+		syscalls++;
+		if (ret < 0 || ret != dgrams[sent].iov_len)
+			break;
+
+		total += ret;
+		sent++;
+	}
+#endif
 
-		return 1;
+	if (syscalls) {
+		HA_ATOMIC_ADD(&prx_counters->tx_syscalls, syscalls);
+		HA_ATOMIC_ADD(&prx_counters->tx_dgrams, sent);
 	}
 
+	if (sent < count)
+		qc_snd_err(qc);
+
 	/* we count the total bytes sent, and the send rate for 32-byte blocks.
 	 * The reason for the latter is that freq_ctr are limited to 4GB and
 	 * that it's not enough per second.
 	 */
-	_HA_ATOMIC_ADD(&global.out_bytes, ret);
-	update_freq_ctr(&global.out_32bps, (ret + 16) / 32);
+	if (total) {
+		_HA_ATOMIC_ADD(&global.out_bytes, total);
+		update_freq_ctr(&global.out_32bps, (total + 16) / 32);
+	}
 
-	return 0;
+	return sent;
 }
 
-/* Receive datagram on <qc> FD-owned socket.
+/* Send a datagram stored into <buf> buffer with <sz> as size.
+ * The caller must ensure there is at least <sz> bytes in this buffer.
+ *
+ * Returns 0 on success else non-zero.
  *
- * Returns the total number of bytes read or a negative value on error.
+ * TODO standardize this function for a generic UDP sendto wrapper. This can be
+ * done by removing the <qc> arg and replace it with address/port.
+ */
+int qc_snd_buf(struct quic_conn *qc, const struct buffer *buf, size_t sz,
+               int flags)
+{
+	struct iovec vec;
+
+	vec.iov_base = b_peek(buf, b_head_ofs(buf));
+	vec.iov_len  = sz;
+
+	return qc_snd_dgrams(qc, &vec, 1) != 1;
+}
+
+/* Receive datagram on <qc> FD-owned socket. Datagrams are received by batches
+ * of up to QUIC_MAX_MMSG_DGRAMS when the platform supports it.
+ *
+ * Returns the number of datagrams of the last batch or a negative value on
+ * error.
  */
 int qc_rcv_buf(struct quic_conn *qc)
 {
-	struct sockaddr_storage saddr = {0}, daddr = {0};
+	struct sockaddr_storage saddr[QUIC_MAX_MMSG_DGRAMS], daddr[QUIC_MAX_MMSG_DGRAMS];
+	size_t dgram_len[QUIC_MAX_MMSG_DGRAMS];
 	struct quic_transport_params *params;
+	struct quic_counters *prx_counters;
 	struct quic_dgram *new_dgram = NULL;
 	struct buffer buf = BUF_NULL;
 	size_t max_sz;
 	unsigned char *dgram_buf;
 	struct listener *l;
-	ssize_t ret = 0;
+	int batch, i;
+	int ret = 0;
 
 	/* Do not call this if quic-conn FD is uninitialized. */
 	BUG_ON(qc->fd < 0);
@@ -581,6 +839,7 @@ int qc_rcv_buf(struct quic_conn *qc)
 
 	params = &l->bind_conf->quic_params;
 	max_sz = params->max_udp_payload_size;
+	prx_counters = EXTRA_COUNTERS_GET(l->bind_conf->frontend->extra_counters_fe, &quic_stats_module);
 
 	do {
 		if (!b_alloc(&buf))
@@ -589,81 +848,97 @@ int qc_rcv_buf(struct quic_conn *qc)
 		b_reset(&buf);
 		BUG_ON(b_contig_space(&buf) < max_sz);
 
-		/* Allocate datagram on first loop or after requeuing. */
-		if (!new_dgram && !(new_dgram = pool_alloc(pool_head_quic_dgram)))
-			break; /* TODO subscribe for memory again available. */
-
-		dgram_buf = (unsigned char *)b_tail(&buf);
-		ret = quic_recv(qc->fd, dgram_buf, max_sz,
-		                (struct sockaddr *)&saddr, sizeof(saddr),
-		                (struct sockaddr *)&daddr, sizeof(daddr),
-		                get_net_port(&qc->local_addr));
+		batch = MIN(b_contig_space(&buf) / max_sz, QUIC_MAX_MMSG_DGRAMS);
+		ret = quic_recv_dgrams(qc->fd, (unsigned char *)b_tail(&buf), max_sz, batch,
+		                       dgram_len, saddr, daddr, get_net_port(&qc->local_addr));
 		if (ret <= 0) {
 			/* Subscribe FD for future reception. */
 			fd_want_recv(qc->fd);
 			break;
 		}
 
-		b_add(&buf, ret);
+		HA_ATOMIC_INC(&prx_counters->rx_syscalls);
+		HA_ATOMIC_ADD(&prx_counters->rx_dgrams, ret);
 
-		new_dgram->buf = dgram_buf;
-		new_dgram->len = ret;
-		new_dgram->dcid_len = 0;
-		new_dgram->dcid = NULL;
-		new_dgram->saddr = saddr;
-		new_dgram->daddr = daddr;
-		new_dgram->qc = NULL;  /* set later via quic_dgram_parse() */
+		/* Datagrams are parsed in place, one after the other, before
+		 * the buffer is reused for the next batch.
+		 */
+		for (i = 0; i < ret; i++) {
+			/* Allocate datagram on first loop or after requeuing. */
+			if (!new_dgram && !(new_dgram = pool_alloc(pool_head_quic_dgram)))
+				break; /* TODO subscribe for memory again available. */
+
+			dgram_buf = (unsigned char *)b_tail(&buf) + i * max_sz;
+
+			new_dgram->buf = dgram_buf;
+			new_dgram->len = dgram_len[i];
+			new_dgram->dcid_len = 0;
+			new_dgram->dcid = NULL;
+			new_dgram->saddr = saddr[i];
+			new_dgram->daddr = daddr[i];
+			new_dgram->qc = NULL;  /* set later via quic_dgram_parse() */
+
+			TRACE_DEVEL("read datagram", QUIC_EV_CONN_RCV, qc, new_dgram);
+
+			if (!quic_get_dgram_dcid(new_dgram->buf,
+			                         new_dgram->buf + new_dgram->len,
+			                         &new_dgram->dcid, &new_dgram->dcid_len)) {
+				continue;
+			}
 
-		TRACE_DEVEL("read datagram", QUIC_EV_CONN_RCV, qc, new_dgram);
+			if (!qc_check_dcid(qc, new_dgram->dcid, new_dgram->dcid_len)) {
+				/* Datagram received by error on the connection FD, dispatch it
+				 * to its associated quic-conn.
+				 *
+				 * TODO count redispatch datagrams.
+				 */
+				struct quic_receiver_buf *rxbuf;
+				struct quic_dgram *tmp_dgram;
+				unsigned char *rxbuf_tail;
+				int cid_tid;
 
-		if (!quic_get_dgram_dcid(new_dgram->buf,
-		                         new_dgram->buf + new_dgram->len,
-		                         &new_dgram->dcid, &new_dgram->dcid_len)) {
-			continue;
-		}
+				TRACE_STATE("datagram for other connection on quic-conn socket, requeue it", QUIC_EV_CONN_RCV, qc);
 
-		if (!qc_check_dcid(qc, new_dgram->dcid, new_dgram->dcid_len)) {
-			/* Datagram received by error on the connection FD, dispatch it
-			 * to its associated quic-conn.
-			 *
-			 * TODO count redispatch datagrams.
-			 */
-			struct quic_receiver_buf *rxbuf;
-			struct quic_dgram *tmp_dgram;
-			unsigned char *rxbuf_tail;
+				rxbuf = MT_LIST_POP(&l->rx.rxbuf_list, typeof(rxbuf), rxbuf_el);
 
-			TRACE_STATE("datagram for other connection on quic-conn socket, requeue it", QUIC_EV_CONN_RCV, qc);
+				tmp_dgram = quic_rxbuf_purge_dgrams(rxbuf);
+				pool_free(pool_head_quic_dgram, tmp_dgram);
 
-			rxbuf = MT_LIST_POP(&l->rx.rxbuf_list, typeof(rxbuf), rxbuf_el);
+				if (b_contig_space(&rxbuf->buf) < new_dgram->len) {
+					/* TODO count lost datagrams */
+					MT_LIST_APPEND(&l->rx.rxbuf_list, &rxbuf->rxbuf_el);
+					continue;
+				}
 
-			tmp_dgram = quic_rxbuf_purge_dgrams(rxbuf);
-			pool_free(pool_head_quic_dgram, tmp_dgram);
+				rxbuf_tail = (unsigned char *)b_tail(&rxbuf->buf);
+				__b_putblk(&rxbuf->buf, (char *)dgram_buf, new_dgram->len);
+				cid_tid = quic_lstnr_dgram_dispatch(rxbuf_tail, new_dgram->len, l, &qc->peer_addr, &daddr[i],
+				                                    new_dgram, &rxbuf->dgram_list);
+				if (cid_tid < 0) {
+					/* TODO count lost datagrams. */
+					b_sub(&rxbuf->buf, dgram_len[i]);
+				}
+				else
+					quic_dghdlr_wakeup(&cid_tid, 1);
+				/* datagram must not be freed as it was either
+				 * requeued or already released on error.
+				 */
+				new_dgram = NULL;
 
-			if (b_contig_space(&rxbuf->buf) < new_dgram->len) {
-				/* TODO count lost datagrams */
 				MT_LIST_APPEND(&l->rx.rxbuf_list, &rxbuf->rxbuf_el);
 				continue;
 			}
 
-			rxbuf_tail = (unsigned char *)b_tail(&rxbuf->buf);
-			__b_putblk(&rxbuf->buf, (char *)dgram_buf, new_dgram->len);
-			if (!quic_lstnr_dgram_dispatch(rxbuf_tail, ret, l, &qc->peer_addr, &daddr,
-			                               new_dgram, &rxbuf->dgram_list)) {
-				/* TODO count lost datagrams. */
-				b_sub(&buf, ret);
-			}
-			else {
-				/* datagram must not be freed as it was requeued. */
-				new_dgram = NULL;
-			}
-
-			MT_LIST_APPEND(&l->rx.rxbuf_list, &rxbuf->rxbuf_el);
-			continue;
+			quic_dgram_parse(new_dgram, qc, qc->li);
+			/* A datagram must always be consumed after quic_parse_dgram(). */
+			BUG_ON(new_dgram->buf);
 		}
 
-		quic_dgram_parse(new_dgram, qc, qc->li);
-		/* A datagram must always be consumed after quic_parse_dgram(). */
-		BUG_ON(new_dgram->buf);
+		/* a short batch indicates that the socket was drained */
+		if (ret < batch) {
+			fd_want_recv(qc->fd);
+			break;
+		}
 	} while (ret > 0);
 
 	pool_free(pool_head_quic_dgram, new_dgram);
@@ -33,6 +33,16 @@ static struct name_desc quic_stats[] = {
 	                                  .desc = "Total number of handshake failures" },
 	[QUIC_ST_STATELESS_RESET_SENT] = { .name = "quic_stless_rst_sent",
 	                                  .desc = "Total number of stateless reset packet sent" },
+	[QUIC_ST_RX_SYSCALLS]         = { .name = "quic_rx_syscalls",
+	                                  .desc = "Total number of syscalls used to receive datagrams" },
+	[QUIC_ST_RX_DGRAMS]           = { .name = "quic_rx_dgrams",
+	                                  .desc = "Total number of received datagrams" },
+	[QUIC_ST_TX_SYSCALLS]         = { .name = "quic_tx_syscalls",
+	                                  .desc = "Total number of syscalls used to send datagrams" },
+	[QUIC_ST_TX_DGRAMS]           = { .name = "quic_tx_dgrams",
+	                                  .desc = "Total number of sent datagrams" },
+	[QUIC_ST_TX_PACING_DELAYED]   = { .name = "quic_tx_pacing_delayed",
+	                                  .desc = "Total number of emissions delayed by the pacing" },
 	/* Special events of interest */
 	[QUIC_ST_CONN_MIGRATION_DONE] = { .name = "quic_conn_migration_done",
 	                                  .desc = "Total number of connection migration proceeded" },
@@ -107,6 +117,11 @@ static void quic_fill_stats(void *data, struct field *stats)
 	stats[QUIC_ST_HALF_OPEN_CONN]    = mkf_u64(FN_GAUGE, counters->half_open_conn);
 	stats[QUIC_ST_HDSHK_FAIL]        = mkf_u64(FN_COUNTER, counters->hdshk_fail);
 	stats[QUIC_ST_STATELESS_RESET_SENT] = mkf_u64(FN_COUNTER, counters->stateless_reset_sent);
+	stats[QUIC_ST_RX_SYSCALLS]       = mkf_u64(FN_COUNTER, counters->rx_syscalls);
+	stats[QUIC_ST_RX_DGRAMS]         = mkf_u64(FN_COUNTER, counters->rx_dgrams);
+	stats[QUIC_ST_TX_SYSCALLS]       = mkf_u64(FN_COUNTER, counters->tx_syscalls);
+	stats[QUIC_ST_TX_DGRAMS]         = mkf_u64(FN_COUNTER, counters->tx_dgrams);
+	stats[QUIC_ST_TX_PACING_DELAYED] = mkf_u64(FN_COUNTER, counters->tx_pacing_delayed);
 	/* Special events of interest */
 	stats[QUIC_ST_CONN_MIGRATION_DONE] = mkf_u64(FN_COUNTER, counters->conn_migration_done);
 	/* Transport errors */
@@ -374,6 +374,10 @@ int quic_tls_enc_aes_ctx_init(EVP_CIPHER_CTX **aes_ctx,
 	if (!EVP_EncryptInit_ex(ctx, aes, NULL, key, NULL))
 		goto err;
 
+	/* header protection encrypts exactly one block with AES-ECB */
+	if (EVP_CIPHER_mode(aes) == EVP_CIPH_ECB_MODE)
+		EVP_CIPHER_CTX_set_padding(ctx, 0);
+
 	*aes_ctx = ctx;
 	return 1;
 
@@ -401,6 +405,33 @@ int quic_tls_aes_encrypt(unsigned char *out,
 	return 1;
 }
 
+/* Compute the QUIC_TLS_HP_MASK_LEN bytes of header protection <mask> from the
+ * QUIC_TLS_HP_SAMPLE_LEN bytes of <sample> with <ctx> as header protection
+ * cipher context initialized for encryption, for both directions. With AES,
+ * the mask is the ECB encryption of the sample (RFC 9001 5.4.3), which needs a
+ * single call without re-initializing the context. With ChaCha20, the sample
+ * is the counter and nonce to encrypt zeroes with (RFC 9001 5.4.4).
+ * Return 1 if succeeded, 0 if not.
+ */
+int quic_tls_hp_mask(unsigned char *mask, const unsigned char *sample,
+                     EVP_CIPHER_CTX *ctx)
+{
+	unsigned char block[QUIC_TLS_HP_SAMPLE_LEN];
+	int ret = 0;
+
+	if (EVP_CIPHER_CTX_mode(ctx) == EVP_CIPH_ECB_MODE) {
+		if (!EVP_EncryptUpdate(ctx, block, &ret, sample, sizeof(block)) ||
+		    ret != sizeof(block))
+			return 0;
+
+		memcpy(mask, block, QUIC_TLS_HP_MASK_LEN);
+		return 1;
+	}
+
+	memset(mask, 0, QUIC_TLS_HP_MASK_LEN);
+	return quic_tls_aes_encrypt(mask, sample, QUIC_TLS_HP_MASK_LEN, ctx);
+}
+
 /* Initialize <*aes_ctx> AES cipher context with <key> as key for decryption */
 int quic_tls_dec_aes_ctx_init(EVP_CIPHER_CTX **aes_ctx,
                               const EVP_CIPHER *aes, unsigned char *key)
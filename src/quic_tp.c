@@ -73,6 +73,10 @@ void quic_transport_params_init(struct quic_transport_params *p, int server)
 	if (server)
 		p->with_stateless_reset_token  = 1;
 
+	/* delayed ACKs may last up to tune.quic.frontend.max-ack-delay */
+	if (server && global.tune.quic_frontend_max_ack_delay)
+		p->max_ack_delay = global.tune.quic_frontend_max_ack_delay;
+
 	p->active_connection_id_limit          = 8;
 
 	p->retry_source_connection_id.len = 0;
@@ -21,6 +21,7 @@
 #include <sys/types.h>
 #include <netinet/tcp.h>
 
+#include <haproxy/activity.h>
 #include <haproxy/api.h>
 #include <haproxy/buf.h>
 #include <haproxy/connection.h>
@@ -29,16 +30,12 @@
 #include <haproxy/freq_ctr.h>
 #include <haproxy/global.h>
 #include <haproxy/pipe.h>
+#include <haproxy/sock.h>
 #include <haproxy/tools.h>
 
 
 #if defined(USE_LINUX_SPLICE)
 
-/* A pipe contains 16 segments max, and it's common to see segments of 1448 bytes
- * because of timestamps. Use this as a hint for not looping on splice().
- */
-#define SPLICE_FULL_HINT	16*1448
-
 /* how many data we attempt to splice at once when the buffer is configured for
  * infinite forwarding */
 #define MAX_SPLICE_AT_ONCE	(1<<30)
@@ -89,6 +86,7 @@ int raw_sock_to_pipe(struct connection *conn, void *xprt_ctx, struct pipe *pipe,
 
 		ret = splice(conn->handle.fd, NULL, pipe->prod, NULL, count,
 			     SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+		activity[tid].splice_calls++;
 
 		if (ret <= 0) {
 			if (ret == 0)
@@ -105,7 +103,10 @@ int raw_sock_to_pipe(struct connection *conn, void *xprt_ctx, struct pipe *pipe,
 				 * empty the pipe.
 				 */
 				if (pipe->data) {
-					/* always stop reading until the pipe is flushed */
+					/* always stop reading until the pipe is flushed,
+					 * and let it grow for next time if allowed.
+					 */
+					pipe_grow(pipe);
 					conn->flags |= CO_FL_WAIT_ROOM;
 					break;
 				}
@@ -134,7 +135,17 @@ int raw_sock_to_pipe(struct connection *conn, void *xprt_ctx, struct pipe *pipe,
 		pipe->data += ret;
 		count -= ret;
 
-		if (pipe->data >= SPLICE_FULL_HINT || ret >= global.tune.recv_enough) {
+		if (pipe->data >= pipe_full_hint(pipe)) {
+			/* The pipe is almost full, let's stop before being
+			 * asked to poll, and let it grow for next time if
+			 * allowed.
+			 */
+			pipe_grow(pipe);
+			conn->flags |= CO_FL_WAIT_ROOM;
+			break;
+		}
+
+		if (ret >= global.tune.recv_enough) {
 			/* We've read enough of it for this time, let's stop before
 			 * being asked to poll.
 			 */
@@ -164,9 +175,10 @@ int raw_sock_to_pipe(struct connection *conn, void *xprt_ctx, struct pipe *pipe,
 	goto leave;
 }
 
-/* Send as many bytes as possible from the pipe to the connection's socket.
+/* Send as many bytes as possible from the pipe to the connection's socket,
+ * within the limit of <count> bytes.
  */
-int raw_sock_from_pipe(struct connection *conn, void *xprt_ctx, struct pipe *pipe)
+int raw_sock_from_pipe(struct connection *conn, void *xprt_ctx, struct pipe *pipe, unsigned int count)
 {
 	int ret, done;
 
@@ -185,10 +197,14 @@ int raw_sock_from_pipe(struct connection *conn, void *xprt_ctx, struct pipe *pip
 		return 0;
 	}
 
+	if (count > pipe->data)
+		count = pipe->data;
+
 	done = 0;
-	while (pipe->data) {
-		ret = splice(pipe->cons, NULL, conn->handle.fd, NULL, pipe->data,
+	while (count) {
+		ret = splice(pipe->cons, NULL, conn->handle.fd, NULL, count,
 			     SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+		activity[tid].splice_calls++;
 
 		if (ret <= 0) {
 			if (ret == 0 || errno == EAGAIN || errno == EWOULDBLOCK) {
@@ -204,6 +220,7 @@ int raw_sock_from_pipe(struct connection *conn, void *xprt_ctx, struct pipe *pip
 		}
 
 		done += ret;
+		count -= ret;
 		pipe->data -= ret;
 	}
 	if (unlikely(conn->flags & CO_FL_WAIT_L4_CONN) && done) {
@@ -335,22 +352,24 @@ static size_t raw_sock_to_buf(struct connection *conn, void *xprt_ctx, struct bu
 }
 
 
-/* Send up to <count> pending bytes from buffer <buf> to connection <conn>'s
- * socket. <flags> may contain some CO_SFL_* flags to hint the system about
- * other pending data for example, but this flag is ignored at the moment.
- * Only one call to send() is performed, unless the buffer wraps, in which case
- * a second call may be performed. The connection's flags are updated with
- * whatever special event is detected (error, empty). The caller is responsible
- * for taking care of those events and avoiding the call if inappropriate. The
- * function does not call the connection's polling update function, so the caller
- * is responsible for this. It's up to the caller to update the buffer's contents
- * based on the return value.
+/* Send the <iovcnt> memory areas described by <iov> to connection <conn>'s
+ * socket using a single call to sendmsg(). <flags> may contain some CO_SFL_*
+ * flags to hint the system about other pending data. This allows an upper
+ * layer to send data which are not contiguous, such as a wrapping buffer or
+ * several buffers, without having to copy them first. The connection's flags
+ * are updated with whatever special event is detected (error, empty). The
+ * caller is responsible for taking care of those events and avoiding the call
+ * if inappropriate. The function does not call the connection's polling update
+ * function, so the caller is responsible for this. It returns the number of
+ * bytes sent, which are taken from the areas in their order.
  */
-static size_t raw_sock_from_buf(struct connection *conn, void *xprt_ctx, const struct buffer *buf, size_t count, int flags)
+static size_t raw_sock_from_iov(struct connection *conn, void *xprt_ctx, const struct iovec *iov, int iovcnt, int flags)
 {
+	struct msghdr msg = { };
 	ssize_t ret;
-	size_t try, done;
+	size_t count, done;
 	int send_flag;
+	int i;
 
 	if (!conn_ctrl_ready(conn))
 		return 0;
@@ -360,6 +379,10 @@ static size_t raw_sock_from_buf(struct connection *conn, void *xprt_ctx, const s
 	if (!fd_send_ready(conn->handle.fd))
 		return 0;
 
+	/* MSG_ZEROCOPY completions are reported as errors */
+	if (unlikely(conn->zc) && (fdtab[conn->handle.fd].state & FD_POLL_ERR))
+		sock_zc_drain(conn);
+
 	if (unlikely(fdtab[conn->handle.fd].state & FD_POLL_ERR)) {
 		/* an error was reported on the FD, we can't send anymore */
 		conn->flags |= CO_FL_ERROR | CO_FL_SOCK_WR_SH | CO_FL_SOCK_RD_SH;
@@ -374,44 +397,60 @@ static size_t raw_sock_from_buf(struct connection *conn, void *xprt_ctx, const s
 		return 0;
 	}
 
+	for (count = i = 0; i < iovcnt; i++)
+		count += iov[i].iov_len;
+
 	done = 0;
-	/* send the largest possible block. For this we perform only one call
-	 * to send() unless the buffer wraps and we exactly fill the first hunk,
-	 * in which case we accept to do it once again.
-	 */
-	while (count) {
-		try = b_contig_data(buf, done);
-		if (try > count)
-			try = count;
+	if (!count)
+		goto leave;
+
+	msg.msg_iov = (struct iovec *)iov;
+	msg.msg_iovlen = iovcnt;
 
-		send_flag = MSG_DONTWAIT | MSG_NOSIGNAL;
-		if (try < count || flags & CO_SFL_MSG_MORE)
-			send_flag |= MSG_MORE;
+	send_flag = MSG_DONTWAIT | MSG_NOSIGNAL;
+	if (flags & CO_SFL_MSG_MORE)
+		send_flag |= MSG_MORE;
 
-		ret = send(conn->handle.fd, b_peek(buf, done), try, send_flag);
+#ifdef HA_HAVE_MSG_ZEROCOPY
+	if (flags & CO_SFL_ZEROCOPY)
+		send_flag |= MSG_ZEROCOPY;
+#endif
+
+	while (1) {
+		ret = sendmsg(conn->handle.fd, &msg, send_flag);
 
 		if (ret > 0) {
-			count -= ret;
-			done += ret;
+			done = ret;
+#ifdef HA_HAVE_MSG_ZEROCOPY
+			/* each successful zero-copy send gets a sequence number */
+			if (send_flag & MSG_ZEROCOPY)
+				conn->zc->next_id++;
+#endif
 
 			/* if the system buffer is full, don't insist */
-			if (ret < try) {
+			if (done < count)
 				fd_cant_send(conn->handle.fd);
-				break;
-			}
-			if (!count)
+			else
 				fd_stop_send(conn->handle.fd);
+			break;
 		}
 		else if (ret == 0 || errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOTCONN || errno == EINPROGRESS) {
 			/* nothing written, we need to poll for write first */
 			fd_cant_send(conn->handle.fd);
 			break;
 		}
+#ifdef HA_HAVE_MSG_ZEROCOPY
+		else if (errno == ENOBUFS && (send_flag & MSG_ZEROCOPY)) {
+			/* locked memory limit reached, copy instead */
+			send_flag &= ~MSG_ZEROCOPY;
+		}
+#endif
 		else if (errno != EINTR) {
 			conn->flags |= CO_FL_ERROR | CO_FL_SOCK_RD_SH | CO_FL_SOCK_WR_SH;
 			break;
 		}
 	}
+
 	if (unlikely(conn->flags & CO_FL_WAIT_L4_CONN) && done) {
 		conn->flags &= ~CO_FL_WAIT_L4_CONN;
 	}
@@ -424,9 +463,36 @@ static size_t raw_sock_from_buf(struct connection *conn, void *xprt_ctx, const s
 		_HA_ATOMIC_ADD(&global.out_bytes, done);
 		update_freq_ctr(&global.out_32bps, (done + 16) / 32);
 	}
+  leave:
 	return done;
 }
 
+/* Send up to <count> pending bytes from buffer <buf> to connection <conn>'s
+ * socket. <flags> may contain some CO_SFL_* flags to hint the system about
+ * other pending data. Only one system call is performed, even if the buffer
+ * wraps, in which case both parts are passed at once to sendmsg(). The
+ * connection's flags are updated with whatever special event is detected
+ * (error, empty). The caller is responsible for taking care of those events
+ * and avoiding the call if inappropriate. The function does not call the
+ * connection's polling update function, so the caller is responsible for this.
+ * It's up to the caller to update the buffer's contents based on the return
+ * value.
+ */
+static size_t raw_sock_from_buf(struct connection *conn, void *xprt_ctx, const struct buffer *buf, size_t count, int flags)
+{
+	struct iovec iov[2];
+	const char *blk1 = NULL, *blk2 = NULL;
+	size_t len1 = 0, len2 = 0;
+	int nblk;
+
+	nblk = b_getblk_nc(buf, &blk1, &len1, &blk2, &len2, 0, MIN(count, b_data(buf)));
+	iov[0].iov_base = (void *)blk1;
+	iov[0].iov_len  = len1;
+	iov[1].iov_base = (void *)blk2;
+	iov[1].iov_len  = len2;
+	return raw_sock_from_iov(conn, xprt_ctx, iov, nblk, flags);
+}
+
 /* Called from the upper layer, to subscribe <es> to events <event_type>. The
  * event subscriber <es> is not allowed to change from a previous call as long
  * as at least one event is still subscribed. The <event_type> must only be a
@@ -466,6 +532,7 @@ static int raw_sock_remove_xprt(struct connection *conn, void *xprt_ctx, void *t
 /* transport-layer operations for RAW sockets */
 static struct xprt_ops raw_sock = {
 	.snd_buf  = raw_sock_from_buf,
+	.snd_iov  = raw_sock_from_iov,
 	.rcv_buf  = raw_sock_to_buf,
 	.subscribe = raw_sock_subscribe,
 	.unsubscribe = raw_sock_unsubscribe,
@@ -14,15 +14,27 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef USE_HYPERSCAN
+#include <hs/hs.h>
+#endif
+
 #include <haproxy/api.h>
 #include <haproxy/errors.h>
 #include <haproxy/global.h>
+#include <haproxy/init.h>
 #include <haproxy/regex.h>
 #include <haproxy/tools.h>
 
 /* regex trash buffer used by various regex tests */
 THREAD_LOCAL regmatch_t pmatch[MAX_MATCH];  /* rm_so, rm_eo for regular expressions */
 
+#ifdef USE_PCRE2
+/* match data reused by all the matches performed by the thread, which saves
+ * an allocation and a release per match.
+ */
+THREAD_LOCAL pcre2_match_data *regex_match_data = NULL;
+#endif
+
 int exp_replace(char *dst, unsigned int dst_size, char *src, const char *str, const regmatch_t *matches)
 {
 	char *old_dst = dst;
@@ -169,11 +181,11 @@ int regex_exec_match(const struct my_regex *preg, const char *subject,
 	 * space in the matches array.
 	 */
 #ifdef USE_PCRE2
-	pm = pcre2_match_data_create_from_pattern(preg->reg, NULL);
+	pm = regex_get_match_data(preg);
 	ret = preg->mfn(preg->reg, (PCRE2_SPTR)subject, (PCRE2_SIZE)strlen(subject), 0, options, pm, NULL);
 
 	if (ret < 0) {
-		pcre2_match_data_free(pm);
+		regex_release_match_data(pm);
 		return 0;
 	}
 
@@ -200,7 +212,7 @@ int regex_exec_match(const struct my_regex *preg, const char *subject,
 		pmatch[i].rm_eo = -1;
 	}
 #ifdef USE_PCRE2
-	pcre2_match_data_free(pm);
+	regex_release_match_data(pm);
 #endif
 	return 1;
 #else
@@ -262,11 +274,11 @@ int regex_exec_match2(const struct my_regex *preg, char *subject, int length,
 	 * space in the matches array.
 	 */
 #ifdef USE_PCRE2
-	pm = pcre2_match_data_create_from_pattern(preg->reg, NULL);
+	pm = regex_get_match_data(preg);
 	ret = preg->mfn(preg->reg, (PCRE2_SPTR)subject, (PCRE2_SIZE)length, 0, options, pm, NULL);
 
 	if (ret < 0) {
-		pcre2_match_data_free(pm);
+		regex_release_match_data(pm);
 		return 0;
 	}
 
@@ -292,7 +304,7 @@ int regex_exec_match2(const struct my_regex *preg, char *subject, int length,
 		pmatch[i].rm_eo = -1;
 	}
 #ifdef USE_PCRE2
-	pcre2_match_data_free(pm);
+	regex_release_match_data(pm);
 #endif
 	return 1;
 #else
@@ -365,6 +377,9 @@ struct my_regex *regex_comp(const char *str, int cs, int cap, char **err)
 		goto out_fail_alloc;
 	}
 
+	if (pcre2_pattern_info(regex->reg, PCRE2_INFO_CAPTURECOUNT, &regex->nb_caps) != 0)
+		regex->nb_caps = MAX_MATCH;
+
 	regex->mfn = &pcre2_match;
 #if defined(USE_PCRE2_JIT)
 	jit = pcre2_jit_compile(regex->reg, PCRE2_JIT_COMPLETE);
@@ -403,6 +418,25 @@ struct my_regex *regex_comp(const char *str, int cs, int cap, char **err)
 	return NULL;
 }
 
+#ifdef USE_PCRE2
+/* allocates the thread's match data. Returns 0 on failure. */
+static int regex_alloc_match_data(void)
+{
+	regex_match_data = pcre2_match_data_create(MAX_MATCH, NULL);
+	return regex_match_data != NULL;
+}
+
+/* releases the thread's match data */
+static void regex_free_match_data(void)
+{
+	pcre2_match_data_free(regex_match_data);
+	regex_match_data = NULL;
+}
+
+REGISTER_PER_THREAD_ALLOC(regex_alloc_match_data);
+REGISTER_PER_THREAD_FREE(regex_free_match_data);
+#endif
+
 static void regex_register_build_options(void)
 {
 	char *ptr = NULL;
@@ -445,6 +479,9 @@ static void regex_register_build_options(void)
 
 #if !defined(USE_PCRE) && !defined(USE_PCRE2)
 	memprintf(&ptr, "Built without PCRE or PCRE2 support (using libc's regex instead)");
+#endif
+#ifdef USE_HYPERSCAN
+	memprintf(&ptr, "%s\nBuilt with Hyperscan version : %s", ptr, hs_version());
 #endif
 	hap_register_build_opts(ptr, 1);
 }
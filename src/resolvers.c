@@ -279,7 +279,43 @@ static inline uint16_t resolv_rnd16(void)
 
 static inline int resolv_resolution_timeout(struct resolv_resolution *res)
 {
-	return res->resolvers->timeout.resolve;
+	return res->refresh ? res->refresh : res->resolvers->timeout.resolve;
+}
+
+/* Sets the delay before the next resolution of <res> to <delay> ms. A random
+ * part of up to <resolve_jitter> percent of it is added so that resolutions
+ * which were started together, such as those of a server-template, do not
+ * keep on sending their queries at the same time.
+ */
+static void resolv_set_refresh(struct resolv_resolution *res, int delay)
+{
+	int jitter = res->resolvers->resolve_jitter;
+
+	if (jitter && delay > 0)
+		delay += statistical_prng_range((unsigned long long)delay * jitter / 100 + 1);
+	res->refresh = delay;
+}
+
+/* Returns the smallest TTL in ms among the answer records of <res> which were
+ * part of the last response, or -1 if there is none.
+ */
+static int resolv_response_min_ttl(struct resolv_resolution *res)
+{
+	struct resolv_answer_item *item;
+	struct eb32_node *eb;
+	int ttl = -1;
+
+	for (eb = eb32_first(&res->response.answer_tree); eb; eb = eb32_next(eb)) {
+		item = eb32_entry(eb, typeof(*item), link);
+		if (item->last_seen != now_ms || item->ttl < 0)
+			continue;
+		if (ttl < 0 || item->ttl < ttl)
+			ttl = item->ttl;
+	}
+
+	if (ttl < 0)
+		return -1;
+	return (ttl > INT_MAX / 1000) ? INT_MAX : ttl * 1000;
 }
 
 /* Updates a resolvers' task timeout for next wake up and queue it */
@@ -291,11 +327,11 @@ static void resolv_update_resolvers_timeout(struct resolvers *resolvers)
 	if (!LIST_ISEMPTY(&resolvers->resolutions.curr)) {
 		res  = LIST_NEXT(&resolvers->resolutions.curr, struct resolv_resolution *, list);
 		next = tick_add(now_ms, resolvers->timeout.resolve);
-		next = MIN(next, tick_add(res->last_query, resolvers->timeout.retry));
+		next = tick_first(next, tick_add(res->last_query, resolvers->timeout.retry));
 	}
 
 	list_for_each_entry(res, &resolvers->resolutions.wait, list)
-		next = MIN(next, tick_add(res->last_resolution, resolv_resolution_timeout(res)));
+		next = tick_first(next, tick_add(res->last_resolution, resolv_resolution_timeout(res)));
 
 	resolvers->t->expire = next;
 	task_queue(resolvers->t);
@@ -488,6 +524,7 @@ static void resolv_reset_resolution(struct resolv_resolution *resolution)
 	resolution->nb_queries      = 0;
 	resolution->nb_responses    = 0;
 	resolution->query_type      = resolution->prefered_query_type;
+	resolv_set_refresh(resolution, resolution->resolvers->timeout.resolve);
 
 	/* clean up query id */
 	eb32_delete(&resolution->qid);
@@ -1267,6 +1304,7 @@ static int resolv_validate_dns_response(unsigned char *resp, unsigned char *bufe
 
 		if (found == 1) {
 			tmp_record->last_seen = now_ms;
+			tmp_record->ttl = answer_record->ttl;
 			pool_free(resolv_answer_item_pool, answer_record);
 			answer_record = NULL;
 		}
@@ -2299,6 +2337,19 @@ static int resolv_process_responses(struct dns_nameserver *ns)
 		}
 
 		resolv_reset_resolution(res);
+
+		/* With resolve_ttl, the answer is kept as long as its TTL, but
+		 * no less than <timeout.resolve>, nor more than <hold.valid>
+		 * once the jitter is added so that it remains usable.
+		 */
+		if (resolvers->resolve_ttl) {
+			int ttl = resolv_response_min_ttl(res);
+			int max = (long long)resolvers->hold.valid * 100 / (100 + resolvers->resolve_jitter);
+
+			if (ttl > resolvers->timeout.resolve)
+				resolv_set_refresh(res, MIN(ttl, MAX(max, resolvers->timeout.resolve)));
+		}
+
 		LIST_DEL_INIT(&res->list);
 		LIST_APPEND(&resolvers->resolutions.wait, &res->list);
 		continue;
@@ -3618,6 +3669,30 @@ int cfg_parse_resolvers(const char *file, int linenum, char **args, int kwm)
 		}
 		curr_resolvers->resolve_retries = atoi(args[1]);
 	}
+	else if (strcmp(args[0], "resolve_jitter") == 0) {
+		int i;
+
+		if (!*args[1]) {
+			ha_alert("parsing [%s:%d] : '%s' expects <percent> as argument.\n",
+				 file, linenum, args[0]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+
+		i = atoi(args[1]);
+		if (i < 0 || i > 100) {
+			ha_alert("parsing [%s:%d] : '%s' must be between 0 and 100 inclusive (was %s).\n",
+				 file, linenum, args[0], args[1]);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto out;
+		}
+		curr_resolvers->resolve_jitter = i;
+	}
+	else if (strcmp(args[0], "resolve_ttl") == 0) {
+		if (alertif_too_many_args(0, file, linenum, args, &err_code))
+			goto out;
+		curr_resolvers->resolve_ttl = 1;
+	}
 	else if (strcmp(args[0], "timeout") == 0) {
 		if (!*args[1]) {
 			ha_alert("parsing [%s:%d] : '%s' expects 'retry' or 'resolve' and <time> as arguments.\n",
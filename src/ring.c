@@ -42,6 +42,7 @@ void ring_init(struct ring *ring, void *area, size_t size)
 	HA_RWLOCK_INIT(&ring->lock);
 	LIST_INIT(&ring->waiters);
 	ring->readers_count = 0;
+	ring->queue = NULL;
 	ring->ofs = 0;
 	ring->buf = b_make(area, size, 0, 0);
 	/* write the initial RC byte */
@@ -114,6 +115,7 @@ struct ring *ring_cast_from_area(void *area)
 	HA_RWLOCK_INIT(&ring->lock);
 	LIST_INIT(&ring->waiters);
 	ring->readers_count = 0;
+	ring->queue = NULL;
 
 	return ring;
 }
@@ -169,28 +171,25 @@ void ring_free(struct ring *ring)
  * to ring <ring>. The message is sent atomically. It may be truncated to
  * <maxlen> bytes if <maxlen> is non-null. There is no distinction between the
  * two lists, it's just a convenience to help the caller prepend some prefixes
- * when necessary. It takes the ring's write lock to make sure no other thread
- * will touch the buffer during the update. Returns the number of bytes sent,
- * or <=0 on failure.
+ * when necessary. The caller must hold the ring's write lock and is
+ * responsible for waking up the readers. Returns the number of bytes sent, or
+ * <=0 on failure.
  */
-ssize_t ring_write(struct ring *ring, size_t maxlen, const struct ist pfx[], size_t npfx, const struct ist msg[], size_t nmsg)
+static ssize_t ring_write_locked(struct ring *ring, size_t maxlen, const struct ist pfx[], size_t npfx, const struct ist msg[], size_t nmsg)
 {
 	struct buffer *buf = &ring->buf;
-	struct appctx *appctx;
 	size_t totlen = 0;
 	size_t lenlen;
 	uint64_t dellen;
 	int dellenlen;
-	ssize_t sent = 0;
 	int i;
 
 	/* we have to find some room to add our message (the buffer is
 	 * never empty and at least contains the previous counter) and
 	 * to update both the buffer contents and heads at the same
-	 * time (it's doable using atomic ops but not worth the
-	 * trouble, let's just lock). For this we first need to know
-	 * the total message's length. We cannot measure it while
-	 * copying due to the varint encoding of the length.
+	 * time. For this we first need to know the total message's
+	 * length. We cannot measure it while copying due to the varint
+	 * encoding of the length.
 	 */
 	for (i = 0; i < npfx; i++)
 		totlen += pfx[i].len;
@@ -202,9 +201,8 @@ ssize_t ring_write(struct ring *ring, size_t maxlen, const struct ist pfx[], siz
 
 	lenlen = varint_bytes(totlen);
 
-	HA_RWLOCK_WRLOCK(LOGSRV_LOCK, &ring->lock);
 	if (lenlen + totlen + 1 + 1 > b_size(buf))
-		goto done_buf;
+		return 0;
 
 	while (b_room(buf) < lenlen + totlen + 1) {
 		/* we need to delete the oldest message (from the end),
@@ -215,10 +213,10 @@ ssize_t ring_write(struct ring *ring, size_t maxlen, const struct ist pfx[], siz
 		 * payload (0 bytes min).
 		 */
 		if (*b_head(buf))
-			goto done_buf;
+			return 0;
 		dellenlen = b_peek_varint(buf, 1, &dellen);
 		if (!dellenlen)
-			goto done_buf;
+			return 0;
 		BUG_ON(b_data(buf) < 1 + dellenlen + dellen);
 
 		b_del(buf, 1 + dellenlen + dellen);
@@ -250,15 +248,69 @@ ssize_t ring_write(struct ring *ring, size_t maxlen, const struct ist pfx[], siz
 	}
 
 	*b_tail(buf) = 0; buf->data++; // new read counter
-	sent = lenlen + totlen + 1;
+	return lenlen + totlen + 1;
+}
 
-	/* notify potential readers */
-	list_for_each_entry(appctx, &ring->waiters, wait_entry)
-		appctx_wakeup(appctx);
+/* Same as ring_write_locked() except that the ring must not be locked. The
+ * message is queued and the first writer getting the lock writes all queued
+ * messages in their arrival order, then wakes the readers up once. The other
+ * writers only wait for their message to be written, which avoids serializing
+ * them on the lock. Returns the number of bytes sent, or <=0 on failure.
+ */
+ssize_t ring_write(struct ring *ring, size_t maxlen, const struct ist pfx[], size_t npfx, const struct ist msg[], size_t nmsg)
+{
+	struct ring_wait_cell cell, *next, *prev, *curr;
+	struct appctx *appctx;
+	int written;
 
- done_buf:
-	HA_RWLOCK_WRUNLOCK(LOGSRV_LOCK, &ring->lock);
-	return sent;
+	cell.pfx    = pfx;
+	cell.npfx   = npfx;
+	cell.msg    = msg;
+	cell.nmsg   = nmsg;
+	cell.maxlen = maxlen;
+	cell.sent   = 0;
+	cell.done   = 0;
+
+	next = HA_ATOMIC_LOAD(&ring->queue);
+	do {
+		cell.next = next;
+	} while (!HA_ATOMIC_CAS(&ring->queue, &next, &cell));
+
+	while (!HA_ATOMIC_LOAD(&cell.done)) {
+		if (HA_RWLOCK_TRYWRLOCK(LOGSRV_LOCK, &ring->lock) != 0) {
+			ha_thread_relax();
+			continue;
+		}
+
+		/* we're the leader: grab the whole queue, which contains at
+		 * least our own cell, and reverse it to get the arrival order.
+		 */
+		curr = HA_ATOMIC_XCHG(&ring->queue, NULL);
+		for (prev = NULL; curr; curr = next) {
+			next = curr->next;
+			curr->next = prev;
+			prev = curr;
+		}
+
+		written = 0;
+		for (curr = prev; curr; curr = next) {
+			/* the cell may vanish as soon as it's marked done */
+			next = curr->next;
+			curr->sent = ring_write_locked(ring, curr->maxlen, curr->pfx, curr->npfx, curr->msg, curr->nmsg);
+			if (curr->sent > 0)
+				written = 1;
+			HA_ATOMIC_STORE(&curr->done, 1);
+		}
+
+		/* notify potential readers */
+		if (written) {
+			list_for_each_entry(appctx, &ring->waiters, wait_entry)
+				appctx_wakeup(appctx);
+		}
+
+		HA_RWLOCK_WRUNLOCK(LOGSRV_LOCK, &ring->lock);
+	}
+	return cell.sent;
 }
 
 /* Tries to attach appctx <appctx> as a new reader on ring <ring>. This is
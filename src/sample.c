@@ -19,6 +19,7 @@
 #include <import/mjson.h>
 #include <import/sha1.h>
 
+#include <haproxy/activity.h>
 #include <haproxy/api.h>
 #include <haproxy/arg.h>
 #include <haproxy/auth.h>
@@ -62,6 +63,9 @@ const char *smp_to_type[SMP_TYPES] = {
 /* static sample used in sample_process() when <p> is NULL */
 static THREAD_LOCAL struct sample temp_smp;
 
+/* per-stream cache of sample expression results, see sample_process_cached() */
+struct pool_head *pool_head_smp_cache __read_mostly = NULL;
+
 /* list head of all known sample fetch keywords */
 static struct sample_fetch_kw_list sample_fetches = {
 	.list = LIST_HEAD_INIT(sample_fetches.list)
@@ -1000,6 +1004,9 @@ sample_cast_fct sample_casts[SMP_TYPES][SMP_TYPES] = {
  * (which may be the final '\0') on success. If it is nul, the expression
  * must be properly terminated by a '\0' otherwise an error is reported.
  */
+static void smp_expr_fold(struct sample_expr *expr);
+static void smp_expr_fuse(struct sample_expr *expr);
+
 struct sample_expr *sample_parse_expr(char **str, int *idx, const char *file, int line, char **err_msg, struct arg_list *al, char **endptr)
 {
 	const char *begw; /* beginning of word */
@@ -1011,6 +1018,7 @@ struct sample_expr *sample_parse_expr(char **str, int *idx, const char *file, in
 	unsigned long prev_type;
 	char *fkw = NULL;
 	char *ckw = NULL;
+	struct list *al_last = al ? al->list.p : NULL;
 	int err_arg;
 
 	begw = str[*idx];
@@ -1186,6 +1194,11 @@ struct sample_expr *sample_parse_expr(char **str, int *idx, const char *file, in
 		*endptr = (char *)endt;
 	}
 
+	/* expressions having args to resolve later cannot be folded */
+	if (!al || al->list.p == al_last)
+		smp_expr_fold(expr);
+	smp_expr_fuse(expr);
+
  out:
 	free(fkw);
 	free(ckw);
@@ -1197,6 +1210,24 @@ struct sample_expr *sample_parse_expr(char **str, int *idx, const char *file, in
 	goto out;
 }
 
+/* Applies converter expression <conv_expr> to sample <smp> like
+ * sample_process() does, and accounts the call and the CPU time it took in
+ * conv_activity[] for "show profiling". Returns the converter's result.
+ */
+static int sample_process_conv_prof(const struct sample_conv_expr *conv_expr, struct sample *smp)
+{
+	struct sched_activity *act;
+	uint64_t start;
+	int ret;
+
+	start = now_mono_time();
+	ret = conv_expr->conv->process(conv_expr->arg_p, smp, conv_expr->conv->private);
+	act = sched_activity_entry(conv_activity, conv_expr->conv, NULL);
+	HA_ATOMIC_INC(&act->calls);
+	HA_ATOMIC_ADD(&act->cpu_time, now_mono_time() - start);
+	return ret;
+}
+
 /*
  * Process a fetch + format conversion of defined by the sample expression <expr>
  * on request or response considering the <opt> parameter.
@@ -1252,7 +1283,11 @@ struct sample *sample_process(struct proxy *px, struct session *sess,
 
 		/* OK cast succeeded */
 
-		if (!conv_expr->conv->process(conv_expr->arg_p, p, conv_expr->conv->private))
+		if (unlikely(th_ctx->flags & TH_FL_TASK_PROFILING)) {
+			if (!sample_process_conv_prof(conv_expr, p))
+				return NULL;
+		}
+		else if (!conv_expr->conv->process(conv_expr->arg_p, p, conv_expr->conv->private))
 			return NULL;
 	}
 	return p;
@@ -1623,6 +1658,545 @@ void release_sample_expr(struct sample_expr *expr)
 	free(expr);
 }
 
+/* Returns non-zero if converter <conv> may have side effects or depend on
+ * anything else than its input and its arguments, in which case expressions
+ * making use of it may neither be folded nor cached.
+ */
+static int smp_conv_is_impure(const struct sample_conv *conv)
+{
+	static const char *const impure[] = {
+		"capture-req", "capture-res", "debug", "set-var", "unset-var", NULL
+	};
+	int i;
+
+	if (strncmp(conv->kw, "lua.", 4) == 0)
+		return 1;
+
+	for (i = 0; impure[i]; i++) {
+		if (strcmp(conv->kw, impure[i]) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+/* Returns non-zero if all arguments of list <args> are plain constants which
+ * do not need to be resolved after the parsing.
+ */
+static int smp_args_are_const(const struct arg *args)
+{
+	for (; args->type != ARGT_STOP; args++) {
+		if (args->unresolved)
+			return 0;
+
+		switch (args->type) {
+		case ARGT_SINT:
+		case ARGT_STR:
+		case ARGT_IPV4:
+		case ARGT_MSK4:
+		case ARGT_IPV6:
+		case ARGT_MSK6:
+			break;
+		default:
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* folded expressions rely on one of these, depending on their output type */
+static struct sample_fetch smp_folded_fetch[SMP_TYPES];
+
+/* Returns the result of a folded expression. The value is in args[0] and the
+ * type in args[1].
+ */
+static int smp_fetch_folded(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	smp->flags = SMP_F_CONST;
+	smp->data.type = args[1].data.sint;
+
+	switch (args[0].type) {
+	case ARGT_STR:
+		smp->data.u.str = args[0].data.str;
+		break;
+	case ARGT_IPV4:
+		smp->data.u.ipv4 = args[0].data.ipv4;
+		break;
+	case ARGT_IPV6:
+		smp->data.u.ipv6 = args[0].data.ipv6;
+		break;
+	default:
+		smp->data.u.sint = args[0].data.sint;
+		break;
+	}
+	return 1;
+}
+
+/* If expression <expr> is made of a constant fetch followed by converters
+ * which only depend on their input and constant arguments, it is evaluated
+ * once for all and replaced with its result. Any failure leaves the
+ * expression untouched, since it will then fail the same way at run time.
+ */
+static void smp_expr_fold(struct sample_expr *expr)
+{
+	struct sample_conv_expr *conv_expr, *conv_exprb;
+	struct sample_fetch *fetch;
+	struct sample smp;
+	struct arg *args;
+
+	if (expr->fetch->use != SMP_USE_CONST || LIST_ISEMPTY(&expr->conv_exprs) ||
+	    !smp_args_are_const(expr->arg_p))
+		return;
+
+	list_for_each_entry(conv_expr, &expr->conv_exprs, list) {
+		if (smp_conv_is_impure(conv_expr->conv) || !smp_args_are_const(conv_expr->arg_p))
+			return;
+	}
+
+	memset(&smp, 0, sizeof(smp));
+	if (!sample_process(NULL, NULL, NULL, SMP_OPT_DIR_REQ | SMP_OPT_FINAL, expr, &smp) ||
+	    (smp.flags & (SMP_F_NOT_LAST | SMP_F_MAY_CHANGE | SMP_F_VOL_TEST)))
+		return;
+
+	args = calloc(3, sizeof(*args));
+	if (!args)
+		return;
+
+	switch (smp.data.type) {
+	case SMP_T_BOOL:
+	case SMP_T_SINT:
+		args[0].type = ARGT_SINT;
+		args[0].data.sint = smp.data.u.sint;
+		break;
+	case SMP_T_IPV4:
+		args[0].type = ARGT_IPV4;
+		args[0].data.ipv4 = smp.data.u.ipv4;
+		break;
+	case SMP_T_IPV6:
+		args[0].type = ARGT_IPV6;
+		args[0].data.ipv6 = smp.data.u.ipv6;
+		break;
+	case SMP_T_STR:
+	case SMP_T_BIN:
+		args[0].type = ARGT_STR;
+		if (chunk_dup(&args[0].data.str, &smp.data.u.str))
+			break;
+		__fallthrough;
+	default:
+		free(args);
+		return;
+	}
+
+	args[1].type = ARGT_SINT;
+	args[1].data.sint = smp.data.type;
+	args[2].type = ARGT_STOP;
+
+	fetch = &smp_folded_fetch[smp.data.type];
+	if (!fetch->process) {
+		fetch->kw       = "const";
+		fetch->process  = smp_fetch_folded;
+		fetch->out_type = smp.data.type;
+		fetch->use      = SMP_USE_CONST;
+		fetch->val      = expr->fetch->val;
+	}
+
+	list_for_each_entry_safe(conv_expr, conv_exprb, &expr->conv_exprs, list) {
+		LIST_DELETE(&conv_expr->list);
+		release_sample_arg(conv_expr->arg_p);
+		free(conv_expr);
+	}
+	release_sample_arg(expr->arg_p);
+	expr->fetch = fetch;
+	expr->arg_p = args;
+}
+
+/* Fused converters replace some common sequences of two converters with a
+ * single one producing the same result without intermediate copy. Their
+ * arguments are those of the second converter.
+ */
+static inline int smp_fused_lower_hash(const struct arg *arg_p, struct sample *smp, unsigned int hash)
+{
+	smp->data.u.sint = hash;
+	if (arg_p->data.sint)
+		smp->data.u.sint = full_hash(smp->data.u.sint);
+	smp->data.type = SMP_T_SINT;
+	return 1;
+}
+
+static int smp_fused_lower_crc32(const struct arg *arg_p, struct sample *smp, void *private)
+{
+	return smp_fused_lower_hash(arg_p, smp, hash_crc32_lower(smp->data.u.str.area, smp->data.u.str.data));
+}
+
+static int smp_fused_lower_crc32c(const struct arg *arg_p, struct sample *smp, void *private)
+{
+	return smp_fused_lower_hash(arg_p, smp, hash_crc32c_lower(smp->data.u.str.area, smp->data.u.str.data));
+}
+
+static int smp_fused_lower_djb2(const struct arg *arg_p, struct sample *smp, void *private)
+{
+	return smp_fused_lower_hash(arg_p, smp, hash_djb2_lower(smp->data.u.str.area, smp->data.u.str.data));
+}
+
+static int smp_fused_lower_sdbm(const struct arg *arg_p, struct sample *smp, void *private)
+{
+	return smp_fused_lower_hash(arg_p, smp, hash_sdbm_lower(smp->data.u.str.area, smp->data.u.str.data));
+}
+
+static int smp_fused_lower_wt6(const struct arg *arg_p, struct sample *smp, void *private)
+{
+	return smp_fused_lower_hash(arg_p, smp, hash_wt6_lower(smp->data.u.str.area, smp->data.u.str.data));
+}
+
+/* Implements "url_dec,field(<index>,<delimiters>[,<count>])" for a positive
+ * index. The input is decoded directly into the output buffer, where only the
+ * selected field is kept. The end of the input is still decoded so that the
+ * same errors as with url_dec are reported. <in_form> is url_dec's argument.
+ */
+static inline int smp_fused_url_dec_field_gen(const struct arg *arg_p, struct sample *smp, int in_form)
+{
+	const char *in = smp->data.u.str.area;
+	const char *stop = in + smp->data.u.str.data;
+	const struct buffer *delim = &arg_p[1].data.str;
+	int count = (arg_p[2].type == ARGT_SINT) ? arg_p[2].data.sint : 1;
+	struct buffer *out = get_trash_chunk();
+	int field = 1, found = 0;
+	char c;
+
+	while (in < stop && *in) {
+		c = *in;
+		if (c == '+') {
+			if (in_form)
+				c = ' ';
+		}
+		else if (c == '%') {
+			if (stop - in < 3 || !ishex(in[1]) || !ishex(in[2]))
+				return 0;
+			c = (hex2i(in[1]) << 4) + hex2i(in[2]);
+			in += 2;
+		}
+		else if (c == '?')
+			in_form = 1;
+		in++;
+
+		if (found)
+			continue;
+
+		if (memchr(delim->area, c, delim->data)) {
+			if (field != arg_p[0].data.sint) {
+				field++;
+				continue;
+			}
+			if (count == 1) {
+				found = 1;
+				continue;
+			}
+			if (count > 1)
+				count--;
+		}
+
+		if (field == arg_p[0].data.sint) {
+			if (out->data >= out->size)
+				return 0;
+			out->area[out->data++] = c;
+		}
+	}
+
+	/* Field not found */
+	if (field != arg_p[0].data.sint)
+		return 0;
+
+	smp->data.u.str = *out;
+	smp->flags &= ~SMP_F_CONST;
+	return 1;
+}
+
+static int smp_fused_url_dec_field(const struct arg *arg_p, struct sample *smp, void *private)
+{
+	return smp_fused_url_dec_field_gen(arg_p, smp, 0);
+}
+
+static int smp_fused_url_dec_form_field(const struct arg *arg_p, struct sample *smp, void *private)
+{
+	return smp_fused_url_dec_field_gen(arg_p, smp, 1);
+}
+
+/* fused converters, with the names of the converters they replace */
+static struct smp_fused_conv {
+	const char *first;
+	const char *second;
+	struct sample_conv conv;
+} smp_fused_convs[] = {
+	{ "lower",   "crc32",  { "lower,crc32",      smp_fused_lower_crc32,        ARG1(0,SINT),          NULL, SMP_T_STR, SMP_T_SINT } },
+	{ "lower",   "crc32c", { "lower,crc32c",     smp_fused_lower_crc32c,       ARG1(0,SINT),          NULL, SMP_T_STR, SMP_T_SINT } },
+	{ "lower",   "djb2",   { "lower,djb2",       smp_fused_lower_djb2,         ARG1(0,SINT),          NULL, SMP_T_STR, SMP_T_SINT } },
+	{ "lower",   "sdbm",   { "lower,sdbm",       smp_fused_lower_sdbm,         ARG1(0,SINT),          NULL, SMP_T_STR, SMP_T_SINT } },
+	{ "lower",   "wt6",    { "lower,wt6",        smp_fused_lower_wt6,          ARG1(0,SINT),          NULL, SMP_T_STR, SMP_T_SINT } },
+	{ "url_dec", "field",  { "url_dec,field",    smp_fused_url_dec_field,      ARG3(2,SINT,STR,SINT), NULL, SMP_T_STR, SMP_T_STR  } },
+	{ "url_dec", "field",  { "url_dec(1),field", smp_fused_url_dec_form_field, ARG3(2,SINT,STR,SINT), NULL, SMP_T_STR, SMP_T_STR  } },
+	{ NULL, NULL }
+};
+
+/* Returns the fused converter replacing converter expression <first> followed
+ * by <second>, or NULL if there is none.
+ */
+static struct sample_conv *smp_fused_conv(const struct sample_conv_expr *first,
+                                          const struct sample_conv_expr *second)
+{
+	struct smp_fused_conv *fused;
+	int in_form;
+
+	if (sample_casts[first->conv->out_type][second->conv->in_type] != c_none ||
+	    !smp_args_are_const(first->arg_p))
+		return NULL;
+
+	for (fused = smp_fused_convs; fused->first; fused++) {
+		if (strcmp(first->conv->kw, fused->first) != 0 ||
+		    strcmp(second->conv->kw, fused->second) != 0)
+			continue;
+
+		if (fused->conv.process == smp_fused_url_dec_field ||
+		    fused->conv.process == smp_fused_url_dec_form_field) {
+			in_form = first->arg_p[0].type == ARGT_SINT && first->arg_p[0].data.sint;
+			if (in_form != (fused->conv.process == smp_fused_url_dec_form_field) ||
+			    second->arg_p[0].data.sint <= 0)
+				continue;
+		}
+		return &fused->conv;
+	}
+	return NULL;
+}
+
+/* Replaces the sequences of converters of expression <expr> which have a
+ * fused equivalent with this one.
+ */
+static void smp_expr_fuse(struct sample_expr *expr)
+{
+	struct sample_conv_expr *first, *second;
+	struct sample_conv *conv;
+
+	for (first = LIST_NEXT(&expr->conv_exprs, struct sample_conv_expr *, list);
+	     &first->list != &expr->conv_exprs && first->list.n != &expr->conv_exprs;
+	     first = LIST_NEXT(&first->list, struct sample_conv_expr *, list)) {
+		second = LIST_NEXT(&first->list, struct sample_conv_expr *, list);
+		conv = smp_fused_conv(first, second);
+		if (!conv)
+			continue;
+
+		LIST_DELETE(&first->list);
+		release_sample_arg(first->arg_p);
+		free(first);
+		second->conv = conv;
+		first = second;
+	}
+}
+
+/* Computes the cache key of expression <expr>, whose unresolved arguments are
+ * attached to <al>, so that identical expressions of the same proxy share the
+ * same key and may reuse each other's results from the stream's sample cache
+ * (see sample_process_cached()). Only expressions whose fetch depends on
+ * the connection, the frontend or the HTTP messages' headers, and whose
+ * converters have no side effect nor read any variable may be cached, the
+ * other ones keep a null key.
+ */
+void smp_expr_set_cache_key(struct sample_expr *expr, const struct arg_list *al)
+{
+	const unsigned int cacheable = SMP_USE_CONST | SMP_USE_LISTN | SMP_USE_FTEND |
+	                               SMP_USE_L4CLI | SMP_USE_L5CLI |
+	                               SMP_USE_HRQHV | SMP_USE_HRQHP |
+	                               SMP_USE_HRSHV | SMP_USE_HRSHP;
+	struct sample_conv_expr *conv_expr;
+	const struct arg *arg;
+	uint64_t key;
+
+	expr->cache_key = 0;
+	if (!al || (expr->fetch->use & ~cacheable))
+		return;
+
+	key = XXH3(&al, sizeof(al), 0);
+	key = XXH3(&expr->fetch, sizeof(expr->fetch), key);
+	for (arg = expr->arg_p; arg->type != ARGT_STOP; arg++) {
+		if (arg->type == ARGT_VAR)
+			return;
+		key = XXH3(arg, offsetof(struct arg, data), key);
+		if (arg->type == ARGT_STR || arg->unresolved)
+			key = XXH3(arg->data.str.area, arg->data.str.data, key);
+		else
+			key = XXH3(&arg->data, sizeof(arg->data), key);
+	}
+
+	list_for_each_entry(conv_expr, &expr->conv_exprs, list) {
+		if (smp_conv_is_impure(conv_expr->conv))
+			return;
+
+		key = XXH3(&conv_expr->conv, sizeof(conv_expr->conv), key);
+		for (arg = conv_expr->arg_p; arg->type != ARGT_STOP; arg++) {
+			if (arg->type == ARGT_VAR)
+				return;
+			key = XXH3(arg, offsetof(struct arg, data), key);
+			if (arg->type == ARGT_STR || arg->unresolved)
+				key = XXH3(arg->data.str.area, arg->data.str.data, key);
+			else
+				key = XXH3(&arg->data, sizeof(arg->data), key);
+		}
+	}
+	expr->cache_key = key ? key : 1;
+}
+
+/* When the sample cache needs to look past the first value of a multi-valued
+ * expression, the next value is kept here until it is requested by the next
+ * call for the same sample and expression, or the end of the list if there is
+ * none.
+ */
+static THREAD_LOCAL struct {
+	const struct sample_expr *expr;           /* expression it belongs to, or NULL */
+	const struct sample *smp;                 /* sample it will be returned in */
+	int found;                                /* 0 if there is no next value */
+	unsigned int flags;                       /* SMP_F_* of the next value or failure */
+	struct sample_data data;                  /* the next value, strings in <buf> */
+	struct buffer *buf;                       /* per-thread storage for strings */
+} smp_cache_next;
+
+/* Copies the string or binary contents of <data>, if any, into buffer <buf>
+ * of size <size> and points <dst> to it. Returns 0 if it does not fit.
+ */
+static int smp_cache_copy_data(struct sample_data *dst, const struct sample_data *data,
+                               char *buf, size_t size)
+{
+	const struct buffer *src;
+	struct buffer *to;
+
+	*dst = *data;
+	if (data->type == SMP_T_STR || data->type == SMP_T_BIN) {
+		src = &data->u.str;
+		to  = &dst->u.str;
+	}
+	else if (data->type == SMP_T_METH && data->u.meth.meth == HTTP_METH_OTHER) {
+		src = &data->u.meth.str;
+		to  = &dst->u.meth.str;
+	}
+	else
+		return 1;
+
+	if (src->data > size)
+		return 0;
+	memcpy(buf, src->area, src->data);
+	*to = b_make(buf, size, 0, src->data);
+	return 1;
+}
+
+/* Same as sample_process(), except that when the stream's sample cache is
+ * enabled and expression <expr> is cacheable, the result is first looked up
+ * in the cache, and stored there if it is stable and single-valued. Since
+ * multi-valued fetches only learn that they returned their last value upon
+ * the next call, this call is performed immediately, and its result is kept
+ * for the caller's next call. A result found in the cache is always returned
+ * as a constant. Note that <p> may not be NULL.
+ */
+struct sample *sample_process_cached(struct proxy *px, struct session *sess,
+                                     struct stream *strm, unsigned int opt,
+                                     struct sample_expr *expr, struct sample *p)
+{
+	struct smp_cache_slot *slot;
+	struct smp_cache *cache;
+	unsigned int flags;
+
+	if (!strm || !expr->cache_key || !pool_head_smp_cache || !smp_cache_next.buf)
+		return sample_process(px, sess, strm, opt, expr, p);
+
+	if (p->flags & SMP_F_NOT_LAST) {
+		/* next value of a multi-valued sample */
+		if (smp_cache_next.expr != expr || smp_cache_next.smp != p)
+			return sample_process(px, sess, strm, opt, expr, p);
+
+		smp_cache_next.expr = NULL;
+		p->flags = smp_cache_next.flags;
+		if (!smp_cache_next.found)
+			return NULL;
+		p->data = smp_cache_next.data;
+		return p;
+	}
+
+	if (smp_cache_next.smp == p)
+		smp_cache_next.expr = NULL;
+
+	cache = strm->smp_cache;
+	if (!cache) {
+		cache = strm->smp_cache = pool_zalloc(pool_head_smp_cache);
+		if (!cache)
+			return sample_process(px, sess, strm, opt, expr, p);
+		cache->epoch = 1;
+	}
+
+	slot = &cache->slot[expr->cache_key % global.tune.sample_cache];
+	if (slot->key == expr->cache_key && slot->epoch == cache->epoch && slot->opt == opt) {
+		smp_set_owner(p, px, sess, strm, opt);
+		p->flags = slot->flags;
+		p->data = slot->data;
+		return p;
+	}
+
+	if (!sample_process(px, sess, strm, opt, expr, p))
+		return NULL;
+
+	if ((p->flags & (SMP_F_MAY_CHANGE | SMP_F_VOL_TEST)) ||
+	    !smp_cache_copy_data(&slot->data, &p->data, slot->area, sizeof(slot->area))) {
+		slot->key = 0;
+		return p;
+	}
+
+	/* from now on the first value only lives in the slot */
+	p->data = slot->data;
+	flags = p->flags | SMP_F_CONST;
+	slot->key = 0;
+
+	if (flags & SMP_F_NOT_LAST) {
+		/* check whether it was the last one */
+		if (sample_process(px, sess, strm, opt, expr, p)) {
+			/* multi-valued, not cacheable */
+			smp_cache_next.found = smp_cache_copy_data(&smp_cache_next.data, &p->data,
+			                                           smp_cache_next.buf->area,
+			                                           smp_cache_next.buf->size);
+		}
+		else
+			smp_cache_next.found = 0;
+
+		if (smp_cache_next.found || (p->flags & SMP_F_MAY_CHANGE)) {
+			smp_cache_next.expr  = expr;
+			smp_cache_next.smp   = p;
+			smp_cache_next.flags = p->flags;
+			p->data  = slot->data;
+			p->flags = flags;
+			return p;
+		}
+		flags &= ~SMP_F_NOT_LAST;
+	}
+
+	slot->key   = expr->cache_key;
+	slot->epoch = cache->epoch;
+	slot->opt   = opt;
+	slot->flags = flags;
+	p->data  = slot->data;
+	p->flags = flags;
+	return p;
+}
+
+static int smp_cache_alloc_per_thread()
+{
+	if (!global.tune.sample_cache)
+		return 1;
+	smp_cache_next.buf = alloc_trash_chunk();
+	return !!smp_cache_next.buf;
+}
+
+static void smp_cache_free_per_thread()
+{
+	free_trash_chunk(smp_cache_next.buf);
+	smp_cache_next.buf = NULL;
+}
+
+REGISTER_PER_THREAD_ALLOC(smp_cache_alloc_per_thread);
+REGISTER_PER_THREAD_FREE(smp_cache_free_per_thread);
+
 /*****************************************************************/
 /*    Sample format convert functions                            */
 /*    These functions set the data type on return.               */
@@ -2650,8 +3224,7 @@ static int sample_conv_regsub(const struct arg *arg_p, struct sample *smp, void
 	struct my_regex *reg = arg_p[0].data.reg;
 	regmatch_t pmatch[MAX_MATCH];
 	struct buffer *trash = get_trash_chunk();
-	struct buffer *output;
-	int flag, max;
+	int flag, max, len;
 	int found;
 
 	start = smp->data.u.str.area;
@@ -2683,23 +3256,14 @@ static int sample_conv_regsub(const struct arg *arg_p, struct sample *smp, void
 		if (!found)
 			break;
 
-		output = alloc_trash_chunk();
-		if (!output)
+		/* append the replacement for the matching part directly to the
+		 * output, or stop there if it doesn't fit.
+		 */
+		len = exp_replace(trash->area + trash->data, trash->size - trash->data,
+		                  start, arg_p[1].data.str.area, pmatch);
+		if (len < 0)
 			break;
-
-		output->data = exp_replace(output->area, output->size, start, arg_p[1].data.str.area, pmatch);
-
-		/* replace the matching part */
-		max = output->size - output->data;
-		if (max) {
-			if (max > output->data)
-				max = output->data;
-			memcpy(trash->area + trash->data,
-			       output->area, max);
-			trash->data += max;
-		}
-
-		free_trash_chunk(output);
+		trash->data += len;
 
 		/* stop here if we're done with this string */
 		if (start >= end)
@@ -3339,10 +3903,6 @@ static int sample_conv_iif(const struct arg *arg_p, struct sample *smp, void *pr
 	return 1;
 }
 
-#define GRPC_MSG_COMPRESS_FLAG_SZ 1 /* 1 byte */
-#define GRPC_MSG_LENGTH_SZ        4 /* 4 bytes */
-#define GRPC_MSG_HEADER_SZ        (GRPC_MSG_COMPRESS_FLAG_SZ + GRPC_MSG_LENGTH_SZ)
-
 /*
  * Extract the field value of an input binary sample. Takes a mandatory argument:
  * the protocol buffers field identifier (dotted notation) internally represented
@@ -4116,6 +4676,15 @@ smp_fetch_stopping(const struct arg *args, struct sample *smp, const char *kw, v
 	return 1;
 }
 
+/* returns true if the process is overloaded (see "tune.overload.*") */
+static int
+smp_fetch_overloaded(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	smp->data.type = SMP_T_BOOL;
+	smp->data.u.sint = process_overloaded();
+	return 1;
+}
+
 /* returns the number of calls of the current stream's process_stream() */
 static int
 smp_fetch_cpu_calls(const struct arg *args, struct sample *smp, const char *kw, void *private)
@@ -4176,6 +4745,66 @@ smp_fetch_lat_ns_tot(const struct arg *args, struct sample *smp, const char *kw,
 	return 1;
 }
 
+/* returns the total number of nanoseconds spent waiting for a buffer */
+static int
+smp_fetch_bufwait_ns_tot(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	if (!smp->strm)
+		return 0;
+
+	smp->data.type = SMP_T_SINT;
+	smp->data.u.sint = smp->strm->bufwait_time;
+	return 1;
+}
+
+/* returns the total number of nanoseconds spent in filters callbacks */
+static int
+smp_fetch_flt_ns_tot(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	if (!smp->strm)
+		return 0;
+
+	smp->data.type = SMP_T_SINT;
+	smp->data.u.sint = smp->strm->flt_time;
+	return 1;
+}
+
+/* returns the total number of nanoseconds spent in Lua actions, sample fetches and converters */
+static int
+smp_fetch_lua_ns_tot(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	if (!smp->strm)
+		return 0;
+
+	smp->data.type = SMP_T_SINT;
+	smp->data.u.sint = smp->strm->lua_time;
+	return 1;
+}
+
+/* returns the total number of nanoseconds spent in the request analysers */
+static int
+smp_fetch_req_ana_ns_tot(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	if (!smp->strm)
+		return 0;
+
+	smp->data.type = SMP_T_SINT;
+	smp->data.u.sint = smp->strm->req_ana_time;
+	return 1;
+}
+
+/* returns the total number of nanoseconds spent in the response analysers */
+static int
+smp_fetch_res_ana_ns_tot(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	if (!smp->strm)
+		return 0;
+
+	smp->data.type = SMP_T_SINT;
+	smp->data.u.sint = smp->strm->res_ana_time;
+	return 1;
+}
+
 static int smp_fetch_const_str(const struct arg *args, struct sample *smp, const char *kw, void *private)
 {
 	smp->flags |= SMP_F_CONST;
@@ -4346,6 +4975,7 @@ static struct sample_fetch_kw_list smp_kws = {ILH, {
 	{ "proc",         smp_fetch_proc,  0,            NULL, SMP_T_SINT, SMP_USE_CONST },
 	{ "thread",       smp_fetch_thread,  0,          NULL, SMP_T_SINT, SMP_USE_CONST },
 	{ "rand",         smp_fetch_rand,  ARG1(0,SINT), NULL, SMP_T_SINT, SMP_USE_CONST },
+	{ "overloaded",   smp_fetch_overloaded, 0,       NULL, SMP_T_BOOL, SMP_USE_INTRN },
 	{ "stopping",     smp_fetch_stopping, 0,         NULL, SMP_T_BOOL, SMP_USE_INTRN },
 	{ "uuid",         smp_fetch_uuid,  ARG1(0, SINT),      smp_check_uuid, SMP_T_STR, SMP_USE_CONST },
 
@@ -4355,6 +4985,12 @@ static struct sample_fetch_kw_list smp_kws = {ILH, {
 	{ "lat_ns_avg",   smp_fetch_lat_ns_avg, 0,       NULL, SMP_T_SINT, SMP_USE_INTRN },
 	{ "lat_ns_tot",   smp_fetch_lat_ns_tot, 0,       NULL, SMP_T_SINT, SMP_USE_INTRN },
 
+	{ "bufwait_ns_tot", smp_fetch_bufwait_ns_tot, 0, NULL, SMP_T_SINT, SMP_USE_INTRN },
+	{ "flt_ns_tot",     smp_fetch_flt_ns_tot,     0, NULL, SMP_T_SINT, SMP_USE_INTRN },
+	{ "lua_ns_tot",     smp_fetch_lua_ns_tot,     0, NULL, SMP_T_SINT, SMP_USE_INTRN },
+	{ "req_ana_ns_tot", smp_fetch_req_ana_ns_tot, 0, NULL, SMP_T_SINT, SMP_USE_INTRN },
+	{ "res_ana_ns_tot", smp_fetch_res_ana_ns_tot, 0, NULL, SMP_T_SINT, SMP_USE_INTRN },
+
 	{ "str",  smp_fetch_const_str,  ARG1(1,STR),  NULL                , SMP_T_STR,  SMP_USE_CONST },
 	{ "bool", smp_fetch_const_bool, ARG1(1,STR),  smp_check_const_bool, SMP_T_BOOL, SMP_USE_CONST },
 	{ "int",  smp_fetch_const_int,  ARG1(1,SINT), NULL                , SMP_T_SINT, SMP_USE_CONST },
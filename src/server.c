@@ -15,7 +15,10 @@
 #include <netinet/tcp.h>
 #include <ctype.h>
 #include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
 
+#include <import/ebistree.h>
 #include <import/ebmbtree.h>
 
 #include <haproxy/api.h>
@@ -25,8 +28,9 @@
 #include <haproxy/check.h>
 #include <haproxy/cli.h>
 #include <haproxy/connection.h>
-#include <haproxy/dict-t.h>
+#include <haproxy/dict.h>
 #include <haproxy/errors.h>
+#include <haproxy/event_hdl.h>
 #include <haproxy/global.h>
 #include <haproxy/log.h>
 #include <haproxy/mailers.h>
@@ -39,6 +43,7 @@
 #include <haproxy/sample.h>
 #include <haproxy/sc_strm.h>
 #include <haproxy/server.h>
+#include <haproxy/sink.h>
 #include <haproxy/stats.h>
 #include <haproxy/stconn.h>
 #include <haproxy/stream.h>
@@ -73,10 +78,9 @@ struct task *idle_conn_task __read_mostly = NULL;
 struct list servers_list = LIST_HEAD_INIT(servers_list);
 
 /* The server names dictionary */
-struct dict server_key_dict = {
-	.name = "server keys",
-	.values = EB_ROOT_UNIQUE,
-};
+struct dict server_key_dict;
+
+INITCALL2(STG_REGISTER, dict_init, &server_key_dict, "server keys");
 
 int srv_downtime(const struct server *s)
 {
@@ -506,6 +510,67 @@ static int srv_parse_error_limit(char **args, int *cur_arg,
 	return 0;
 }
 
+/* Parse the "error-rate" server keyword */
+static int srv_parse_error_rate(char **args, int *cur_arg,
+                                struct proxy *curproxy, struct server *newsrv, char **err)
+{
+	char *end;
+	long rate;
+
+	if (!*args[*cur_arg + 1]) {
+		memprintf(err, "'%s' expects a percentage as argument.",
+		          args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	rate = strtol(args[*cur_arg + 1], &end, 10);
+	if (*end == '%')
+		end++;
+
+	if (*end || rate < 1 || rate > 100) {
+		memprintf(err, "'%s' expects a percentage between 1 and 100, got '%s'.",
+		          args[*cur_arg], args[*cur_arg + 1]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	newsrv->error_rate = rate;
+	return 0;
+}
+
+/* Parse the "passive-inter" server keyword */
+static int srv_parse_passive_inter(char **args, int *cur_arg,
+                                   struct proxy *curproxy, struct server *newsrv, char **err)
+{
+	const char *res;
+	unsigned int delay;
+
+	if (!*args[*cur_arg + 1]) {
+		memprintf(err, "'%s' expects a delay as argument.",
+		          args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	res = parse_time_err(args[*cur_arg + 1], &delay, TIME_UNIT_MS);
+	if (res == PARSE_TIME_OVER) {
+		memprintf(err, "timer overflow in argument '%s' to '%s' (maximum value is 2147483647 ms or ~24.8 days)",
+		          args[*cur_arg+1], args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+	else if (res == PARSE_TIME_UNDER) {
+		memprintf(err, "timer underflow in argument '%s' to '%s' (minimum non-null value is 1 ms)",
+		          args[*cur_arg+1], args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+	else if (res) {
+		memprintf(err, "unexpected character '%c' in argument to '%s'.",
+		          *res, args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	newsrv->passive_inter = delay;
+	return 0;
+}
+
 /* Parse the "ws" keyword */
 static int srv_parse_ws(char **args, int *cur_arg,
                         struct proxy *curproxy, struct server *newsrv, char **err)
@@ -639,6 +704,24 @@ static int srv_parse_max_reuse(char **args, int *cur_arg, struct proxy *curproxy
 	return 0;
 }
 
+static int srv_parse_max_pipeline(char **args, int *cur_arg, struct proxy *curproxy, struct server *newsrv, char **err)
+{
+	char *arg;
+
+	arg = args[*cur_arg + 1];
+	if (!*arg) {
+		memprintf(err, "'%s' expects <value> as argument.\n", args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+	newsrv->max_pipeline = atoi(arg);
+	if (newsrv->max_pipeline < 1) {
+		memprintf(err, "'%s' expects a strictly positive value.\n", args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	return 0;
+}
+
 static int srv_parse_pool_purge_delay(char **args, int *cur_arg, struct proxy *curproxy, struct server *newsrv, char **err)
 {
 	const char *res;
@@ -704,6 +787,25 @@ static int srv_parse_pool_max_conn(char **args, int *cur_arg, struct proxy *curp
 	return 0;
 }
 
+static int srv_parse_pool_min_conn(char **args, int *cur_arg, struct proxy *curproxy, struct server *newsrv, char **err)
+{
+	char *arg;
+
+	arg = args[*cur_arg + 1];
+	if (!*arg) {
+		memprintf(err, "'%s' expects <value> as argument.\n", args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	if ((int)atoi(arg) < 0) {
+		memprintf(err, "'%s' must be >= 0", args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	newsrv->pool_min_conn = atoi(arg);
+	return 0;
+}
+
 /* parse the "id" server keyword */
 static int srv_parse_id(char **args, int *cur_arg, struct proxy *curproxy, struct server *newsrv, char **err)
 {
@@ -848,6 +950,11 @@ static int srv_parse_proto(char **args, int *cur_arg,
 		return ERR_ALERT | ERR_FATAL;
 	}
 	proto = ist(args[*cur_arg + 1]);
+	if (isteq(proto, ist("quic")) || isteq(proto, ist("h3"))) {
+		memprintf(err, "'%s' : QUIC and HTTP/3 are only supported on the frontend side, "
+		          "servers must use a TCP-based protocol such as 'h2'", args[*cur_arg]);
+		return ERR_ALERT | ERR_FATAL;
+	}
 	newsrv->mux_proto = get_mux_proto(proto);
 	if (!newsrv->mux_proto) {
 		memprintf(err, "'%s' :  unknown MUX protocol '%s'", args[*cur_arg], args[*cur_arg+1]);
@@ -1156,12 +1263,30 @@ static int srv_parse_slowstart(char **args, int *cur_arg,
 	return 0;
 }
 
+/* Allocates a new port range covering ports <low> to <high> included. Returns
+ * NULL on allocation failure.
+ */
+static struct port_range *srv_alloc_sport_range(int low, int high)
+{
+	struct port_range *range;
+	int i;
+
+	range = port_range_alloc_range(high - low + 1);
+	if (!range)
+		return NULL;
+
+	for (i = 0; i < range->size; i++)
+		range->ports[i] = low + i;
+	return range;
+}
+
 /* Parse the "source" server keyword */
 static int srv_parse_source(char **args, int *cur_arg,
                             struct proxy *curproxy, struct server *newsrv, char **err)
 {
 	char *errmsg;
 	int port_low, port_high;
+	int nb_lanes = 0;
 	struct sockaddr_storage *sk;
 
 	errmsg = NULL;
@@ -1184,18 +1309,6 @@ static int srv_parse_source(char **args, int *cur_arg,
 	newsrv->conn_src.opts |= CO_SRC_BIND;
 	newsrv->conn_src.source_addr = *sk;
 
-	if (port_low != port_high) {
-		int i;
-
-		newsrv->conn_src.sport_range = port_range_alloc_range(port_high - port_low + 1);
-		if (!newsrv->conn_src.sport_range) {
-			ha_alert("Server '%s': Out of memory (sport_range)\n", args[0]);
-			goto err;
-		}
-		for (i = 0; i < newsrv->conn_src.sport_range->size; i++)
-			newsrv->conn_src.sport_range->ports[i] = port_low + i;
-	}
-
 	*cur_arg += 2;
 	while (*(args[*cur_arg])) {
 		if (strcmp(args[*cur_arg], "usesrc") == 0) {  /* address to use outside */
@@ -1298,10 +1411,54 @@ static int srv_parse_source(char **args, int *cur_arg,
 			*cur_arg += 2;
 			continue;
 		}
+
+		if (strcmp(args[*cur_arg], "dst-lanes") == 0) { /* spread destinations over multiple port ranges */
+			char *error;
+
+			nb_lanes = strtol(args[*cur_arg + 1], &error, 10);
+			if (!*args[*cur_arg + 1] || *error || nb_lanes < 1 || nb_lanes > 256) {
+				ha_alert("'%s' : '%s' expects an integer between 1 and 256.\n", args[0], args[*cur_arg]);
+				goto err;
+			}
+			*cur_arg += 2;
+			continue;
+		}
 		/* this keyword in not an option of "source" */
 		break;
 	} /* while */
 
+	if (nb_lanes > 1 && port_low == port_high) {
+		ha_alert("'%s' : 'dst-lanes' requires a source port range.\n", args[0]);
+		goto err;
+	}
+
+	if (port_low != port_high) {
+		int i;
+
+		newsrv->conn_src.sport_range = srv_alloc_sport_range(port_low, port_high);
+		if (!newsrv->conn_src.sport_range) {
+			ha_alert("Server '%s': Out of memory (sport_range)\n", args[0]);
+			goto err;
+		}
+
+		if (nb_lanes > 1) {
+			newsrv->conn_src.sport_lanes = calloc(nb_lanes, sizeof(*newsrv->conn_src.sport_lanes));
+			if (!newsrv->conn_src.sport_lanes) {
+				ha_alert("Server '%s': Out of memory (sport_lanes)\n", args[0]);
+				goto err;
+			}
+			newsrv->conn_src.sport_lanes[0] = newsrv->conn_src.sport_range;
+			for (i = 1; i < nb_lanes; i++) {
+				newsrv->conn_src.sport_lanes[i] = srv_alloc_sport_range(port_low, port_high);
+				if (!newsrv->conn_src.sport_lanes[i]) {
+					ha_alert("Server '%s': Out of memory (sport_lanes)\n", args[0]);
+					goto err;
+				}
+			}
+			newsrv->conn_src.nb_sport_lanes = nb_lanes;
+		}
+	}
+
 	return 0;
 
  err:
@@ -1769,12 +1926,14 @@ static struct srv_kw_list srv_kws = { "ALL", { }, {
 	{ "disabled",            srv_parse_disabled,            0,  1,  1 }, /* Start the server in 'disabled' state */
 	{ "enabled",             srv_parse_enabled,             0,  1,  1 }, /* Start the server in 'enabled' state */
 	{ "error-limit",         srv_parse_error_limit,         1,  1,  1 }, /* Configure the consecutive count of check failures to consider a server on error */
+	{ "error-rate",          srv_parse_error_rate,          1,  1,  1 }, /* Configure the ratio of observed errors to consider a server on error */
 	{ "ws",                  srv_parse_ws,                  1,  1,  1 }, /* websocket protocol */
 	{ "id",                  srv_parse_id,                  1,  0,  1 }, /* set id# of server */
 	{ "init-addr",           srv_parse_init_addr,           1,  1,  0 }, /* */
 	{ "log-proto",           srv_parse_log_proto,           1,  1,  0 }, /* Set the protocol for event messages, only relevant in a ring section */
 	{ "maxconn",             srv_parse_maxconn,             1,  1,  1 }, /* Set the max number of concurrent connection */
 	{ "maxqueue",            srv_parse_maxqueue,            1,  1,  1 }, /* Set the max number of connection to put in queue */
+	{ "max-pipeline",        srv_parse_max_pipeline,        1,  1,  0 }, /* Set the max number of outstanding HTTP/1 requests on a connection */
 	{ "max-reuse",           srv_parse_max_reuse,           1,  1,  0 }, /* Set the max number of requests on a connection, -1 means unlimited */
 	{ "minconn",             srv_parse_minconn,             1,  1,  1 }, /* Enable a dynamic maxconn limit */
 	{ "namespace",           srv_parse_namespace,           1,  1,  0 }, /* Namespace the server socket belongs to (if supported) */
@@ -1787,8 +1946,10 @@ static struct srv_kw_list srv_kws = { "ALL", { }, {
 	{ "on-error",            srv_parse_on_error,            1,  1,  1 }, /* Configure the action on check failure */
 	{ "on-marked-down",      srv_parse_on_marked_down,      1,  1,  1 }, /* Configure the action when a server is marked down */
 	{ "on-marked-up",        srv_parse_on_marked_up,        1,  1,  1 }, /* Configure the action when a server is marked up */
+	{ "passive-inter",       srv_parse_passive_inter,       1,  1,  1 }, /* Set the max delay between active checks while observed traffic is healthy */
 	{ "pool-low-conn",       srv_parse_pool_low_conn,       1,  1,  1 }, /* Set the min number of orphan idle connecbefore being allowed to pick from other threads */
 	{ "pool-max-conn",       srv_parse_pool_max_conn,       1,  1,  1 }, /* Set the max number of orphan idle connections, -1 means unlimited */
+	{ "pool-min-conn",       srv_parse_pool_min_conn,       1,  1,  0 }, /* Set the number of idle connections to keep established per thread group */
 	{ "pool-purge-delay",    srv_parse_pool_purge_delay,    1,  1,  1 }, /* Set the time before we destroy orphan idle connections, defaults to 1s */
 	{ "proto",               srv_parse_proto,               1,  1,  1 }, /* Set the proto to use for all outgoing connections */
 	{ "proxy-v2-options",    srv_parse_proxy_v2_options,    1,  1,  1 }, /* options for send-proxy-v2 */
@@ -1944,6 +2105,8 @@ const char *server_parse_maxconn_change_request(struct server *sv,
 		sv->maxconn = v;
 	}
 
+	srv_event_hdl_publish(EVENT_HDL_SUB_SERVER_MAXCONN, sv);
+
 	if (may_dequeue_tasks(sv, sv->proxy))
 		process_srv_queue(sv);
 
@@ -2009,22 +2172,43 @@ static void display_parser_err(const char *file, int linenum, char **args, int c
 		ha_alert("%s%s%s%s.\n", msg, quote, token, quote);
 }
 
+static struct port_range *srv_sport_range_dup(const struct port_range *src)
+{
+	struct port_range *range;
+	int i;
+
+	/* <size> includes the extra slot used to tell full from empty */
+	range = port_range_alloc_range(src->size - 1);
+	if (range) {
+		for (i = 0; i < src->size - 1; i++)
+			range->ports[i] = src->ports[i];
+	}
+	return range;
+}
+
 static void srv_conn_src_sport_range_cpy(struct server *srv, const struct server *src)
 {
-	int range_sz;
+	int i;
 
-	range_sz = src->conn_src.sport_range->size;
-	if (range_sz > 0) {
-		srv->conn_src.sport_range = port_range_alloc_range(range_sz);
-		if (srv->conn_src.sport_range != NULL) {
-			int i;
+	srv->conn_src.sport_range = srv_sport_range_dup(src->conn_src.sport_range);
+	if (!srv->conn_src.sport_range || src->conn_src.nb_sport_lanes <= 1)
+		return;
 
-			for (i = 0; i < range_sz; i++) {
-				srv->conn_src.sport_range->ports[i] =
-					src->conn_src.sport_range->ports[i];
-			}
+	srv->conn_src.sport_lanes = calloc(src->conn_src.nb_sport_lanes, sizeof(*srv->conn_src.sport_lanes));
+	if (!srv->conn_src.sport_lanes)
+		return;
+
+	srv->conn_src.sport_lanes[0] = srv->conn_src.sport_range;
+	for (i = 1; i < src->conn_src.nb_sport_lanes; i++) {
+		srv->conn_src.sport_lanes[i] = srv_sport_range_dup(src->conn_src.sport_lanes[i]);
+		if (!srv->conn_src.sport_lanes[i]) {
+			while (--i > 0)
+				free(srv->conn_src.sport_lanes[i]);
+			ha_free(&srv->conn_src.sport_lanes);
+			return;
 		}
 	}
+	srv->conn_src.nb_sport_lanes = src->conn_src.nb_sport_lanes;
 }
 
 /*
@@ -2241,6 +2425,8 @@ void srv_settings_cpy(struct server *srv, const struct server *src, int srv_tmpl
 	if (src->trackit != NULL)
 		srv->trackit = strdup(src->trackit);
 	srv->consecutive_errors_limit = src->consecutive_errors_limit;
+	srv->error_rate               = src->error_rate;
+	srv->passive_inter            = src->passive_inter;
 	srv->uweight = srv->iweight   = src->iweight;
 
 	srv->check.send_proxy         = src->check.send_proxy;
@@ -2284,7 +2470,9 @@ void srv_settings_cpy(struct server *srv, const struct server *src, int srv_tmpl
 	srv->pool_purge_delay = src->pool_purge_delay;
 	srv->low_idle_conns = src->low_idle_conns;
 	srv->max_idle_conns = src->max_idle_conns;
+	srv->pool_min_conn = src->pool_min_conn;
 	srv->max_reuse = src->max_reuse;
+	srv->max_pipeline = src->max_pipeline;
 
 	if (srv_tmpl)
 		srv->srvrq = src->srvrq;
@@ -2304,6 +2492,11 @@ struct server *new_server(struct proxy *proxy)
 	if (!srv)
 		return NULL;
 
+	if (!counters_shards_init(&srv->counters.shards)) {
+		free(srv);
+		return NULL;
+	}
+
 	srv_take(srv);
 
 	srv->obj_type = OBJ_TYPE_SERVER;
@@ -2312,6 +2505,7 @@ struct server *new_server(struct proxy *proxy)
 	LIST_APPEND(&servers_list, &srv->global_list);
 	LIST_INIT(&srv->srv_rec_item);
 	LIST_INIT(&srv->ip_rec_item);
+	MT_LIST_INIT(&srv->lb_pending);
 
 	srv->next_state = SRV_ST_RUNNING; /* early server setup */
 	srv->last_change = now.tv_sec;
@@ -2383,6 +2577,10 @@ struct server *srv_drop(struct server *srv)
 	free(srv->per_thr);
 	free(srv->per_tgrp);
 	free(srv->curr_idle_thr);
+	if (srv->coalesce && !--srv->coalesce->refcount) {
+		free(srv->coalesce->avail_conns);
+		free(srv->coalesce);
+	}
 	free(srv->resolvers_id);
 	free(srv->addr_node.key);
 	free(srv->lb_nodes);
@@ -2395,6 +2593,7 @@ struct server *srv_drop(struct server *srv)
 
 	LIST_DELETE(&srv->global_list);
 
+	counters_shards_free(&srv->counters.shards);
 	EXTRA_COUNTERS_FREE(srv->extra_counters);
 
 	ha_free(&srv);
@@ -2532,6 +2731,7 @@ static int _srv_parse_tmpl_init(struct server *srv, struct proxy *px)
 		free_check(&newsrv->agent);
 		free_check(&newsrv->check);
 		LIST_DELETE(&newsrv->global_list);
+		counters_shards_free(&newsrv->counters.shards);
 	}
 	free(newsrv);
 	return i - srv->tmpl_info.nb_low;
@@ -3812,8 +4012,178 @@ struct server *snr_check_ip_callback(struct server *srv, void *ip, unsigned char
  * success otherwise a non-zero error code. In case of error, *err_code, if
  * not NULL, is filled up.
  */
+#if defined(USE_THREAD) && defined(USE_GETADDRINFO)
+
+/* A host name resolved at boot by srv_prefetch_libc_addrs() */
+struct srv_libc_addr {
+	struct ebpt_node node;          /* indexed by host name */
+	struct sockaddr_storage addr;   /* requested family on input, address on output */
+	int resolved;                   /* non-zero if <addr> is valid */
+};
+
+static struct srv_libc_addr *srv_libc_addrs;
+static unsigned int srv_libc_addrs_nb;
+static unsigned int srv_libc_addrs_next;
+static struct eb_root srv_libc_addrs_tree = EB_ROOT_UNIQUE;
+
+/* Resolves the pending host names of srv_libc_addrs[] using getaddrinfo(),
+ * which is thread-safe, until none is left.
+ */
+static void *srv_libc_addrs_worker(void *arg)
+{
+	struct srv_libc_addr *entry;
+	struct addrinfo hints, *result;
+	unsigned int idx;
+
+	while ((idx = HA_ATOMIC_FETCH_ADD(&srv_libc_addrs_next, 1)) < srv_libc_addrs_nb) {
+		entry = &srv_libc_addrs[idx];
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = entry->addr.ss_family ? entry->addr.ss_family : AF_UNSPEC;
+		hints.ai_socktype = SOCK_DGRAM;
+
+		result = NULL;
+		if (getaddrinfo(entry->node.key, NULL, &hints, &result) != 0 || !result)
+			continue;
+
+		if ((result->ai_family == AF_INET || result->ai_family == AF_INET6) &&
+		    (!entry->addr.ss_family || entry->addr.ss_family == result->ai_family)) {
+			memcpy(&entry->addr, result->ai_addr, result->ai_addrlen);
+			entry->resolved = 1;
+		}
+		freeaddrinfo(result);
+	}
+	return NULL;
+}
+
+/* Resolves in parallel, using as many short-lived threads as configured for
+ * the process, the host names of all servers which may be resolved by the
+ * libc at boot, so that srv_set_addr_via_libc() finds them in a cache instead
+ * of waiting for each of them in turn. Names which cannot be resolved this way
+ * are left to the regular method so that the outcome is unchanged. Nothing is
+ * done when a single thread is configured or when getaddrinfo() is disabled.
+ */
+static void srv_prefetch_libc_addrs(void)
+{
+	struct sockaddr_storage sa;
+	struct proxy *px;
+	struct server *srv;
+	pthread_t *workers;
+	unsigned int nb = 0;
+	int i, nbw;
+
+	if (global.nbthread <= 1 || !(global.tune.options & GTUNE_USE_GAI))
+		return;
+
+	for (px = proxies_list; px; px = px->next) {
+		if (!(px->cap & PR_CAP_BE) || (px->flags & (PR_FL_DISABLED|PR_FL_STOPPED)))
+			continue;
+		for (srv = px->srv; srv; srv = srv->next)
+			nb += !!srv->hostname;
+	}
+
+	if (nb < 2)
+		return;
+
+	srv_libc_addrs = calloc(nb, sizeof(*srv_libc_addrs));
+	if (!srv_libc_addrs)
+		return;
+
+	for (px = proxies_list; px; px = px->next) {
+		if (!(px->cap & PR_CAP_BE) || (px->flags & (PR_FL_DISABLED|PR_FL_STOPPED)))
+			continue;
+
+		for (srv = px->srv; srv; srv = srv->next) {
+			struct srv_libc_addr *entry;
+
+			if (!srv->hostname || ebis_lookup(&srv_libc_addrs_tree, srv->hostname))
+				continue;
+
+			/* literal addresses and invalid names are not worth it */
+			memset(&sa, 0, sizeof(sa));
+			sa.ss_family = srv->addr.ss_family;
+			if (str2ip2(srv->hostname, &sa, 0) ||
+			    !resolv_hostname_validation(srv->hostname, NULL))
+				continue;
+
+			entry = &srv_libc_addrs[srv_libc_addrs_nb++];
+			entry->node.key = srv->hostname;
+			entry->addr.ss_family = srv->addr.ss_family;
+			ebis_insert(&srv_libc_addrs_tree, &entry->node);
+		}
+	}
+
+	nbw = MIN(global.nbthread, srv_libc_addrs_nb);
+	workers = calloc(nbw, sizeof(*workers));
+	if (nbw < 2 || !workers) {
+		/* not worth it, or let the regular method do its job */
+		free(workers);
+		return;
+	}
+
+	for (i = 0; i < nbw; i++) {
+		if (pthread_create(&workers[i], NULL, srv_libc_addrs_worker, NULL) != 0)
+			break;
+	}
+
+	/* the current thread participates as well, and finishes the job if
+	 * some threads could not be created.
+	 */
+	srv_libc_addrs_worker(NULL);
+
+	while (i-- > 0)
+		pthread_join(workers[i], NULL);
+	free(workers);
+}
+
+/* Releases everything allocated by srv_prefetch_libc_addrs() */
+static void srv_release_libc_addrs(void)
+{
+	ha_free(&srv_libc_addrs);
+	srv_libc_addrs_tree = EB_ROOT_UNIQUE;
+	srv_libc_addrs_nb = srv_libc_addrs_next = 0;
+}
+
+/* Sets <srv>'s address from the boot time cache if it was resolved there.
+ * Returns 0 on success, otherwise non-zero.
+ */
+static int srv_set_addr_from_prefetch(struct server *srv)
+{
+	struct srv_libc_addr *entry;
+	struct ebpt_node *node;
+	int port;
+
+	if (!srv_libc_addrs)
+		return 1;
+
+	node = ebis_lookup(&srv_libc_addrs_tree, srv->hostname);
+	if (!node)
+		return 1;
+
+	entry = container_of(node, struct srv_libc_addr, node);
+	if (!entry->resolved ||
+	    (srv->addr.ss_family && srv->addr.ss_family != entry->addr.ss_family))
+		return 1;
+
+	port = get_host_port(&srv->addr);
+	srv->addr = entry->addr;
+	set_host_port(&srv->addr, port);
+	return 0;
+}
+
+#else
+
+static inline void srv_prefetch_libc_addrs(void) { }
+static inline void srv_release_libc_addrs(void) { }
+static inline int srv_set_addr_from_prefetch(struct server *srv) { return 1; }
+
+#endif /* USE_THREAD && USE_GETADDRINFO */
+
 int srv_set_addr_via_libc(struct server *srv, int *err_code)
 {
+	if (srv_set_addr_from_prefetch(srv) == 0)
+		return 0;
+
 	if (str2ip2(srv->hostname, &srv->addr, 1) == NULL) {
 		if (err_code)
 			*err_code |= ERR_WARN;
@@ -3998,6 +4368,8 @@ int srv_init_addr(void)
 	struct proxy *curproxy;
 	int return_code = 0;
 
+	srv_prefetch_libc_addrs();
+
 	curproxy = proxies_list;
 	while (curproxy) {
 		struct server *srv;
@@ -4017,6 +4389,7 @@ int srv_init_addr(void)
 		curproxy = curproxy->next;
 	}
 
+	srv_release_libc_addrs();
 	return return_code;
 }
 
@@ -4562,6 +4935,7 @@ static int srv_alloc_lb(struct server *sv, struct proxy *be)
 	sv->lb_nodes_now = 0;
 
 	if (((be->lbprm.algo & (BE_LB_KIND | BE_LB_PARM)) == (BE_LB_KIND_RR | BE_LB_RR_RANDOM)) ||
+	    ((be->lbprm.algo & (BE_LB_KIND | BE_LB_PARM)) == (BE_LB_KIND_CB | BE_LB_CB_EWMA)) ||
 	    ((be->lbprm.algo & (BE_LB_KIND | BE_LB_HASH_TYPE)) == (BE_LB_KIND_HI | BE_LB_HASH_CONS))) {
 		sv->lb_nodes = calloc(sv->lb_nodes_tot, sizeof(*sv->lb_nodes));
 
@@ -4665,70 +5039,75 @@ int srv_init_per_thr(struct server *srv)
 	return 0;
 }
 
-/* Parse a "add server" command
- * Returns 0 if the server has been successfully initialized, 1 on failure.
+/* Creates the group of servers sharing their multiplexed connections for the
+ * servers created from the same "server-template" line as <srv>, which must
+ * be the template itself, if its backend has "option http-coalesce". Servers
+ * from a same template share all their settings, which is what makes their
+ * connections to a same address interchangeable. Returns 0 on success, -1 on
+ * allocation failure.
  */
-static int cli_parse_add_server(char **args, char *payload, struct appctx *appctx, void *private)
+int srv_init_coalesce(struct server *srv)
+{
+	struct srv_coalesce *grp;
+	struct server *other;
+	int i;
+
+	if (!(srv->proxy->options2 & PR_O2_COALESCE) || !srv->tmpl_info.prefix ||
+	    srv->tmpl_info.nb_high <= srv->tmpl_info.nb_low || (srv->flags & SRV_F_DYNAMIC))
+		return 0;
+
+	grp = calloc(1, sizeof(*grp));
+	if (!grp)
+		return -1;
+
+	grp->avail_conns = calloc(global.nbthread, sizeof(*grp->avail_conns));
+	if (!grp->avail_conns) {
+		free(grp);
+		return -1;
+	}
+
+	for (i = 0; i < global.nbthread; i++)
+		grp->avail_conns[i] = EB_ROOT;
+
+	for (other = srv->proxy->srv; other; other = other->next) {
+		if (other != srv && (other->tmpl_info.prefix || (other->flags & SRV_F_DYNAMIC) ||
+		                     other->conf.line != srv->conf.line ||
+		                     strcmp(other->conf.file, srv->conf.file) != 0))
+			continue;
+		other->coalesce = grp;
+		grp->refcount++;
+	}
+	return 0;
+}
+
+/* Creates server <args[1]> in backend <be> from the "server" line <args>, and
+ * appends it to the backend's servers list after server <last> if not NULL,
+ * otherwise after the last one. The server is created disabled. Must be called
+ * under thread isolation, since parsing handlers were designed to run only at
+ * the starting stage on single-thread mode. Errors are reported as user
+ * messages. Returns the new server, or NULL on failure.
+ */
+static struct server *srv_cli_create(struct proxy *be, char **args, struct server *last)
 {
-	struct proxy *be;
 	struct server *srv;
-	char *be_name, *sv_name;
 	int errcode, argc;
 	int next_id;
 	const int parse_flags = SRV_PARSE_DYNAMIC|SRV_PARSE_PARSE_ADDR;
 
-	usermsgs_clr("CLI");
-
-	if (!cli_has_level(appctx, ACCESS_LVL_ADMIN))
-		return 1;
+	errcode = _srv_parse_init(&srv, args, &argc, be, parse_flags);
+	if (errcode)
+		goto out;
 
-	++args;
+	while (*args[argc]) {
+		errcode = _srv_parse_kw(srv, args, &argc, be, parse_flags);
 
-	sv_name = be_name = args[1];
-	/* split backend/server arg */
-	while (*sv_name && *(++sv_name)) {
-		if (*sv_name == '/') {
-			*sv_name = '\0';
-			++sv_name;
-			break;
-		}
+		if (errcode)
+			goto out;
 	}
 
-	if (!*sv_name)
-		return cli_err(appctx, "Require 'backend/server'.");
-
-	be = proxy_be_by_name(be_name);
-	if (!be)
-		return cli_err(appctx, "No such backend.");
-
-	if (!(be->lbprm.algo & BE_LB_PROP_DYN)) {
-		cli_err(appctx, "Backend must use a dynamic load balancing to support dynamic servers.");
-		return 1;
-	}
-
-	/* At this point, some operations might not be thread-safe anymore. This
-	 * might be the case for parsing handlers which were designed to run
-	 * only at the starting stage on single-thread mode.
-	 *
-	 * Activate thread isolation to ensure thread-safety.
-	 */
-	thread_isolate();
-
-	args[1] = sv_name;
-	errcode = _srv_parse_init(&srv, args, &argc, be, parse_flags);
-	if (errcode)
-		goto out;
-
-	while (*args[argc]) {
-		errcode = _srv_parse_kw(srv, args, &argc, be, parse_flags);
-
-		if (errcode)
-			goto out;
-	}
-
-	errcode = _srv_parse_finalize(args, argc, srv, be, parse_flags);
-	if (errcode)
-		goto out;
+	errcode = _srv_parse_finalize(args, argc, srv, be, parse_flags);
+	if (errcode)
+		goto out;
 
 	/* A dynamic server does not currently support resolution.
 	 *
@@ -4808,27 +5187,22 @@ static int cli_parse_add_server(char **args, char *payload, struct appctx *appct
 	 * operation is not thread-safe so this is executed under thread
 	 * isolation.
 	 *
-	 * If a server with the same name is found, reject the new one.
+	 * If a server with the same name is found, reject the new one. The
+	 * names tree is used for this so that adding servers to a backend
+	 * which already has many of them remains cheap.
 	 */
+	if (ebis_lookup(&be->conf.used_server_name, srv->id)) {
+		ha_alert("Already exists a server with the same name in backend.\n");
+		goto out;
+	}
 
 	/* TODO use a double-linked list for px->srv */
 	if (be->srv) {
-		struct server *next = be->srv;
-
-		while (1) {
-			/* check for duplicate server */
-			if (strcmp(srv->id, next->id) == 0) {
-				ha_alert("Already exists a server with the same name in backend.\n");
-				goto out;
-			}
-
-			if (!next->next)
-				break;
-
-			next = next->next;
-		}
-
-		next->next = srv;
+		if (!last)
+			last = be->srv;
+		while (last->next)
+			last = last->next;
+		last->next = srv;
 	}
 	else {
 		srv->next = be->srv;
@@ -4854,26 +5228,7 @@ static int cli_parse_add_server(char **args, char *payload, struct appctx *appct
 	if (srv->addr_node.key)
 		ebis_insert(&be->used_server_addr, &srv->addr_node);
 
-	thread_release();
-
-	/* Start the check task. The server must be fully initialized.
-	 *
-	 * <srvpos> and <nbcheck> parameters are set to 1 as there should be no
-	 * need to randomly spread the task interval for dynamic servers.
-	 */
-	if (srv->check.state & CHK_ST_CONFIGURED) {
-		if (!start_check_task(&srv->check, 0, 1, 1))
-			ha_alert("System might be unstable, consider to execute a reload");
-	}
-	if (srv->agent.state & CHK_ST_CONFIGURED) {
-		if (!start_check_task(&srv->agent, 0, 1, 1))
-			ha_alert("System might be unstable, consider to execute a reload");
-	}
-
-	ha_notice("New server registered.\n");
-	cli_umsg(appctx, LOG_INFO);
-
-	return 0;
+	return srv;
 
 out:
 	if (srv) {
@@ -4891,34 +5246,73 @@ static int cli_parse_add_server(char **args, char *payload, struct appctx *appct
 		}
 		else {
 			struct server *prev;
-			for (prev = be->srv; prev && prev->next != srv; prev = prev->next)
+			for (prev = last ? last : be->srv; prev && prev->next != srv; prev = prev->next)
 				;
 			if (prev)
 				prev->next = srv->next;
 		}
 
+		srv_drop(srv);
 	}
+	return NULL;
+}
 
-	thread_release();
+/* Starts dynamic server <srv> created by srv_cli_create(), out of thread
+ * isolation. The server must be fully initialized.
+ */
+static void srv_cli_start(struct server *srv)
+{
+	/* Start the check task.
+	 *
+	 * <srvpos> and <nbcheck> parameters are set to 1 as there should be no
+	 * need to randomly spread the task interval for dynamic servers.
+	 */
+	if (srv->check.state & CHK_ST_CONFIGURED) {
+		if (!start_check_task(&srv->check, 0, 1, 1))
+			ha_alert("System might be unstable, consider to execute a reload");
+	}
+	if (srv->agent.state & CHK_ST_CONFIGURED) {
+		if (!start_check_task(&srv->agent, 0, 1, 1))
+			ha_alert("System might be unstable, consider to execute a reload");
+	}
 
-	if (!usermsgs_empty())
-		cli_umsgerr(appctx);
+	srv_event_hdl_publish(EVENT_HDL_SUB_SERVER_ADD, srv);
+}
 
-	if (srv)
-		srv_drop(srv);
+/* Removes from backend <be> the dynamic server <srv> created by
+ * srv_cli_create() and not started yet, and releases it. The server must
+ * already be detached from the backend's servers list. Must be called under
+ * thread isolation.
+ */
+static void srv_cli_cancel(struct proxy *be, struct server *srv)
+{
+	if (srv->track)
+		release_server_track(srv);
 
-	return 1;
+	if (srv->check.state & CHK_ST_CONFIGURED)
+		free_check(&srv->check);
+	if (srv->agent.state & CHK_ST_CONFIGURED)
+		free_check(&srv->agent);
+
+	eb32_delete(&srv->conf.id);
+	ebpt_delete(&srv->conf.name);
+	if (srv->addr_node.key)
+		ebpt_delete(&srv->addr_node);
+
+	srv_drop(srv);
 }
 
-/* Parse a "del server" command
+/* Parse a "add server" command
  * Returns 0 if the server has been successfully initialized, 1 on failure.
  */
-static int cli_parse_delete_server(char **args, char *payload, struct appctx *appctx, void *private)
+static int cli_parse_add_server(char **args, char *payload, struct appctx *appctx, void *private)
 {
 	struct proxy *be;
 	struct server *srv;
 	char *be_name, *sv_name;
 
+	usermsgs_clr("CLI");
+
 	if (!cli_has_level(appctx, ACCESS_LVL_ADMIN))
 		return 1;
 
@@ -4937,38 +5331,172 @@ static int cli_parse_delete_server(char **args, char *payload, struct appctx *ap
 	if (!*sv_name)
 		return cli_err(appctx, "Require 'backend/server'.");
 
-	/* The proxy servers list is currently not protected by a lock so this
-	 * requires thread isolation. In addition, any place referencing the
-	 * server about to be deleted would be unsafe after our operation, so
-	 * we must be certain to be alone so that no other thread has even
-	 * started to grab a temporary reference to this server.
-	 */
-	thread_isolate_full();
+	be = proxy_be_by_name(be_name);
+	if (!be)
+		return cli_err(appctx, "No such backend.");
 
-	get_backend_server(be_name, sv_name, &be, &srv);
-	if (!be) {
-		cli_err(appctx, "No such backend.");
-		goto out;
+	if (!(be->lbprm.algo & BE_LB_PROP_DYN)) {
+		cli_err(appctx, "Backend must use a dynamic load balancing to support dynamic servers.");
+		return 1;
 	}
 
+	/* At this point, some operations might not be thread-safe anymore. This
+	 * might be the case for parsing handlers which were designed to run
+	 * only at the starting stage on single-thread mode.
+	 *
+	 * Activate thread isolation to ensure thread-safety.
+	 */
+	thread_isolate();
+
+	args[1] = sv_name;
+	srv = srv_cli_create(be, args, NULL);
+
+	thread_release();
+
 	if (!srv) {
-		cli_err(appctx, "No such server.");
-		goto out;
+		if (!usermsgs_empty())
+			cli_umsgerr(appctx);
+		return 1;
 	}
 
-	if (srv->flags & SRV_F_NON_PURGEABLE) {
-		cli_err(appctx, "This server cannot be removed at runtime due to other configuration elements pointing to it.");
-		goto out;
+	srv_cli_start(srv);
+
+	ha_notice("New server registered.\n");
+	cli_umsg(appctx, LOG_INFO);
+
+	return 0;
+}
+
+/* Parse a "add servers <backend>" command, whose payload contains one server
+ * per line, made of its name followed by its arguments, as for "add server".
+ * All servers are created during a single thread isolation period. If any of
+ * them cannot be created, all the failures are reported and none of the
+ * servers is kept. Returns 0 if all servers were created, 1 otherwise.
+ */
+static int cli_parse_add_servers(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	char *line_args[MAX_LINE_ARGS + 2];
+	struct server **added = NULL;
+	struct server *srv, *tail, *last;
+	struct proxy *be;
+	char *line, *next, *cur, *msg = NULL;
+	int nb_lines = 0, nb_added = 0, nb_failed = 0;
+	int arg, i;
+
+	usermsgs_clr("CLI");
+
+	if (!cli_has_level(appctx, ACCESS_LVL_ADMIN))
+		return 1;
+
+	if (!*args[2])
+		return cli_err(appctx, "Require a backend name.");
+
+	be = proxy_be_by_name(args[2]);
+	if (!be)
+		return cli_err(appctx, "No such backend.");
+
+	if (!(be->lbprm.algo & BE_LB_PROP_DYN))
+		return cli_err(appctx, "Backend must use a dynamic load balancing to support dynamic servers.");
+
+	if (!payload || !*payload)
+		return cli_err(appctx, "Require the list of servers as a payload.");
+
+	for (cur = payload; *cur; cur++)
+		nb_lines += *cur == '\n';
+	added = calloc(nb_lines + 1, sizeof(*added));
+	if (!added)
+		return cli_err(appctx, "Out of memory.");
+
+	thread_isolate();
+
+	/* the new servers are appended after the current last one so that they
+	 * can all be detached at once in case of failure.
+	 */
+	for (tail = be->srv; tail && tail->next; tail = tail->next)
+		;
+	last = tail;
+
+	for (line = payload; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = 0;
+
+		/* split the line on blanks, the first word being the name */
+		line_args[0] = "server";
+		for (arg = 1, cur = line; ; arg++) {
+			while (*cur == ' ' || *cur == '\t' || *cur == '\r')
+				*cur++ = 0;
+			if (!*cur || arg > MAX_LINE_ARGS)
+				break;
+			line_args[arg] = cur;
+			while (*cur && *cur != ' ' && *cur != '\t' && *cur != '\r')
+				cur++;
+		}
+		if (arg == 1)
+			continue; /* empty line */
+		for (i = arg; i < MAX_LINE_ARGS + 2; i++)
+			line_args[i] = "";
+
+		if (*cur) {
+			ha_alert("Server '%s' not added: too many words on the line.\n", line_args[1]);
+			nb_failed++;
+			continue;
+		}
+
+		srv = srv_cli_create(be, line_args, last);
+		if (!srv) {
+			ha_alert("Server '%s' not added.\n", line_args[1]);
+			nb_failed++;
+			continue;
+		}
+		added[nb_added++] = last = srv;
 	}
 
+	/* the messages must not refer to servers which may be released */
+	reset_usermsgs_ctx();
+
+	if (nb_failed) {
+		if (tail)
+			tail->next = NULL;
+		else
+			be->srv = NULL;
+		for (i = 0; i < nb_added; i++)
+			srv_cli_cancel(be, added[i]);
+	}
+
+	thread_release();
+
+	if (nb_failed) {
+		free(added);
+		ha_alert("%d servers failed, no server added.\n", nb_failed);
+		cli_umsgerr(appctx);
+		return 1;
+	}
+
+	for (i = 0; i < nb_added; i++)
+		srv_cli_start(added[i]);
+	free(added);
+
+	usermsgs_clr("CLI");
+	return cli_dynmsg(appctx, LOG_INFO, memprintf(&msg, "%d servers added.\n", nb_added));
+}
+
+/* Unlinks dynamic server <srv> from backend <be> and from all the structures
+ * referencing it. Must be called under full thread isolation, and the caller
+ * is responsible for dropping the server once isolation is released. Returns
+ * NULL on success, otherwise the reason why the server cannot be removed.
+ */
+static const char *srv_cli_delete(struct proxy *be, struct server *srv)
+{
+	if (srv->flags & SRV_F_NON_PURGEABLE)
+		return "This server cannot be removed at runtime due to other configuration elements pointing to it.";
+
 	/* Only servers in maintenance can be deleted. This ensures that the
 	 * server is not present anymore in the lb structures (through
 	 * lbprm.set_server_status_down).
 	 */
-	if (!(srv->cur_admin & SRV_ADMF_MAINT)) {
-		cli_err(appctx, "Only servers in maintenance mode can be deleted.");
-		goto out;
-	}
+	if (!(srv->cur_admin & SRV_ADMF_MAINT))
+		return "Only servers in maintenance mode can be deleted.";
 
 	/* Ensure that there is no active/idle/pending connection on the server.
 	 *
@@ -4976,10 +5504,8 @@ static int cli_parse_delete_server(char **args, char *payload, struct appctx *ap
 	 * cleanup function should be implemented to be used here.
 	 */
 	if (srv->cur_sess || srv->curr_idle_conns ||
-	    !eb_is_empty(&srv->queue.head)) {
-		cli_err(appctx, "Server still has connections attached to it, cannot remove it.");
-		goto out;
-	}
+	    srv->queue.length)
+		return "Server still has connections attached to it, cannot remove it.";
 
 	/* remove srv from tracking list */
 	if (srv->track)
@@ -4996,8 +5522,7 @@ static int cli_parse_delete_server(char **args, char *payload, struct appctx *ap
 	 * requires thread_isolate/release.
 	 */
 
-	/* be->srv cannot be empty since we have already found the server with
-	 * get_backend_server */
+	/* be->srv cannot be empty since the server was found in this backend */
 	BUG_ON(!be->srv);
 	if (be->srv == srv) {
 		be->srv = srv->next;
@@ -5005,8 +5530,8 @@ static int cli_parse_delete_server(char **args, char *payload, struct appctx *ap
 	else {
 		struct server *next;
 		for (next = be->srv; srv != next->next; next = next->next) {
-			/* srv cannot be not found since we have already found
-			 * it with get_backend_server */
+			/* srv cannot be not found since it was found in this
+			 * backend's trees */
 			BUG_ON(!next);
 		}
 
@@ -5022,6 +5547,66 @@ static int cli_parse_delete_server(char **args, char *payload, struct appctx *ap
 	/* remove srv from idle_node tree for idle conn cleanup */
 	eb32_delete(&srv->idle_node);
 
+	/* remove srv from the list of servers to reposition in the LB tree */
+	MT_LIST_DELETE(&srv->lb_pending);
+
+	srv_event_hdl_publish(EVENT_HDL_SUB_SERVER_DEL, srv);
+	return NULL;
+}
+
+/* Parse a "del server" command
+ * Returns 0 if the server has been successfully initialized, 1 on failure.
+ */
+static int cli_parse_delete_server(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	struct proxy *be;
+	struct server *srv;
+	char *be_name, *sv_name;
+	const char *err;
+
+	if (!cli_has_level(appctx, ACCESS_LVL_ADMIN))
+		return 1;
+
+	++args;
+
+	sv_name = be_name = args[1];
+	/* split backend/server arg */
+	while (*sv_name && *(++sv_name)) {
+		if (*sv_name == '/') {
+			*sv_name = '\0';
+			++sv_name;
+			break;
+		}
+	}
+
+	if (!*sv_name)
+		return cli_err(appctx, "Require 'backend/server'.");
+
+	/* The proxy servers list is currently not protected by a lock so this
+	 * requires thread isolation. In addition, any place referencing the
+	 * server about to be deleted would be unsafe after our operation, so
+	 * we must be certain to be alone so that no other thread has even
+	 * started to grab a temporary reference to this server.
+	 */
+	thread_isolate_full();
+
+	get_backend_server(be_name, sv_name, &be, &srv);
+	if (!be) {
+		cli_err(appctx, "No such backend.");
+		goto out;
+	}
+
+	if (!srv) {
+		cli_err(appctx, "No such server.");
+		goto out;
+	}
+
+	err = srv_cli_delete(be, srv);
+	if (err) {
+		cli_err(appctx, err);
+		goto out;
+	}
+
 	thread_release();
 
 	ha_notice("Server deleted.\n");
@@ -5037,6 +5622,93 @@ static int cli_parse_delete_server(char **args, char *payload, struct appctx *ap
 	return 1;
 }
 
+/* Parse a "del servers <backend>" command, whose payload contains the names
+ * of the servers to remove, separated by blanks or line feeds. All servers are
+ * removed during a single full thread isolation period. The servers which
+ * cannot be removed are reported and do not prevent the other ones from being
+ * removed. Returns 0 if all servers were removed, 1 otherwise.
+ */
+static int cli_parse_delete_servers(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	struct server **deleted = NULL;
+	struct server *srv;
+	struct proxy *be;
+	const char *err;
+	char *name, *cur, *msg = NULL;
+	int nb_words = 1, nb_deleted = 0, nb_failed = 0;
+	int i;
+
+	if (!cli_has_level(appctx, ACCESS_LVL_ADMIN))
+		return 1;
+
+	if (!*args[2])
+		return cli_err(appctx, "Require a backend name.");
+
+	if (!payload || !*payload)
+		return cli_err(appctx, "Require the list of servers as a payload.");
+
+	for (cur = payload; *cur; cur++)
+		nb_words += isspace((unsigned char)*cur);
+	deleted = calloc(nb_words, sizeof(*deleted));
+	if (!deleted)
+		return cli_err(appctx, "Out of memory.");
+
+	/* see cli_parse_delete_server() for the reason of full isolation */
+	thread_isolate_full();
+
+	be = proxy_be_by_name(args[2]);
+	if (!be) {
+		thread_release();
+		free(deleted);
+		return cli_err(appctx, "No such backend.");
+	}
+
+	for (cur = payload; *cur; ) {
+		while (isspace((unsigned char)*cur))
+			*cur++ = 0;
+		if (!*cur)
+			break;
+		name = cur;
+		while (*cur && !isspace((unsigned char)*cur))
+			cur++;
+		if (*cur)
+			*cur++ = 0;
+
+		get_backend_server(args[2], name, NULL, &srv);
+		if (!srv) {
+			memprintf(&msg, "%sServer '%s' not deleted: No such server.\n", msg ? msg : "", name);
+			nb_failed++;
+			continue;
+		}
+
+		err = srv_cli_delete(be, srv);
+		if (err) {
+			memprintf(&msg, "%sServer '%s' not deleted: %s\n", msg ? msg : "", name, err);
+			nb_failed++;
+			continue;
+		}
+		deleted[nb_deleted++] = srv;
+	}
+
+	thread_release();
+
+	for (i = 0; i < nb_deleted; i++)
+		srv_drop(deleted[i]);
+	free(deleted);
+
+	if (nb_deleted)
+		ha_notice("%d servers deleted.\n", nb_deleted);
+
+	memprintf(&msg, "%s%d servers deleted", msg ? msg : "", nb_deleted);
+	if (nb_failed) {
+		memprintf(&msg, "%s, %d failed.\n", msg, nb_failed);
+		return cli_dynerr(appctx, msg);
+	}
+
+	memprintf(&msg, "%s.\n", msg);
+	return cli_dynmsg(appctx, LOG_INFO, msg);
+}
+
 /* register cli keywords */
 static struct cli_kw_list cli_kws = {{ },{
 	{ { "disable", "agent",  NULL },         "disable agent                           : disable agent checks",                                        cli_parse_disable_agent, NULL },
@@ -5050,7 +5722,9 @@ static struct cli_kw_list cli_kws = {{ },{
 	{ { "get", "weight", NULL },             "get weight <bk>/<srv>                   : report a server's current weight",                            cli_parse_get_weight },
 	{ { "set", "weight", NULL },             "set weight <bk>/<srv>  (DEPRECATED)     : change a server's weight (use 'set server' instead)",         cli_parse_set_weight },
 	{ { "add", "server", NULL },             "add server <bk>/<srv>                   : create a new server",                                         cli_parse_add_server, NULL },
+	{ { "add", "servers", NULL },            "add servers <bk>                        : create new servers listed in the payload",                    cli_parse_add_servers, NULL },
 	{ { "del", "server", NULL },             "del server <bk>/<srv>                   : remove a dynamically added server",                           cli_parse_delete_server, NULL },
+	{ { "del", "servers", NULL },            "del servers <bk>                        : remove dynamically added servers listed in the payload",     cli_parse_delete_servers, NULL },
 	{{},}
 }};
 
@@ -5163,6 +5837,8 @@ static void srv_update_status(struct server *s)
 	struct proxy *px = s->proxy;
 	int prev_srv_count = s->proxy->srv_bck + s->proxy->srv_act;
 	int srv_was_stopping = (s->cur_state == SRV_ST_STOPPING) || (s->cur_admin & SRV_ADMF_DRAIN);
+	int srv_was_up = (s->cur_state != SRV_ST_STOPPED) && !(s->cur_admin & SRV_ADMF_MAINT);
+	unsigned int prev_eweight = s->cur_eweight;
 	int log_level;
 	struct buffer *tmptrash = NULL;
 
@@ -5691,6 +6367,11 @@ static void srv_update_status(struct server *s)
 
 	/* Re-set log strings to empty */
 	*s->adm_st_chg_cause = 0;
+
+	if (srv_was_up != ((s->cur_state != SRV_ST_STOPPED) && !(s->cur_admin & SRV_ADMF_MAINT)))
+		srv_event_hdl_publish(srv_was_up ? EVENT_HDL_SUB_SERVER_DOWN : EVENT_HDL_SUB_SERVER_UP, s);
+	else if (s->cur_eweight != prev_eweight)
+		srv_event_hdl_publish(EVENT_HDL_SUB_SERVER_WEIGHT, s);
 }
 
 struct task *srv_cleanup_toremove_conns(struct task *task, void *context, unsigned int state)
@@ -5821,6 +6502,56 @@ struct connection *srv_lookup_conn_next(struct connection *conn)
 	return next_conn;
 }
 
+/* Unconditionally inserts connection <conn> into the idle (or safe if <is_safe>
+ * is set) list of server <srv> for the current thread, provided that the
+ * server's max idle connections count is not reached. Returns 1 on success, or
+ * 0 if the connection was not inserted.
+ */
+static int _srv_add_to_idle_list(struct server *srv, struct connection *conn, int is_safe)
+{
+	int retadd;
+
+	retadd = _HA_ATOMIC_ADD_FETCH(&srv->curr_idle_conns, 1);
+	if (retadd > srv->max_idle_conns) {
+		_HA_ATOMIC_DEC(&srv->curr_idle_conns);
+		return 0;
+	}
+	_HA_ATOMIC_DEC(&srv->curr_used_conns);
+
+	HA_SPIN_LOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
+	conn_delete_from_tree(&conn->hash_node->node);
+
+	if (is_safe) {
+		conn->flags = (conn->flags & ~CO_FL_LIST_MASK) | CO_FL_SAFE_LIST;
+		eb64_insert(&srv->per_thr[tid].safe_conns, &conn->hash_node->node);
+		_HA_ATOMIC_INC(&srv->curr_safe_nb);
+	} else {
+		conn->flags = (conn->flags & ~CO_FL_LIST_MASK) | CO_FL_IDLE_LIST;
+		eb64_insert(&srv->per_thr[tid].idle_conns, &conn->hash_node->node);
+		_HA_ATOMIC_INC(&srv->curr_idle_nb);
+	}
+	HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
+	_HA_ATOMIC_INC(&srv->curr_idle_thr[tid]);
+
+	__ha_barrier_full();
+	if ((volatile void *)srv->idle_node.node.leaf_p == NULL) {
+		HA_SPIN_LOCK(OTHER_LOCK, &idle_conn_srv_lock);
+		if ((volatile void *)srv->idle_node.node.leaf_p == NULL) {
+			srv->idle_node.key = tick_add(srv->pool_purge_delay,
+			                              now_ms);
+			eb32_insert(&idle_conn_srv, &srv->idle_node);
+			if (!task_in_wq(idle_conn_task) && !
+			    task_in_rq(idle_conn_task)) {
+				task_schedule(idle_conn_task,
+				              srv->idle_node.key);
+			}
+
+		}
+		HA_SPIN_UNLOCK(OTHER_LOCK, &idle_conn_srv_lock);
+	}
+	return 1;
+}
+
 /* This adds an idle connection to the server's list if the connection is
  * reusable, not held by any owner anymore, but still has available streams.
  */
@@ -5831,6 +6562,9 @@ int srv_add_to_idle_list(struct server *srv, struct connection *conn, int is_saf
 	 * idle+current conns is lower than what was observed before
 	 * last purge, or if we already don't have idle conns for the
 	 * current thread and we don't exceed last count by global.nbthread.
+	 * Servers with "pool-min-conn" may also keep as many connections as
+	 * currently used on top of this minimum, since the pool is refilled
+	 * as soon as a connection is picked from it.
 	 */
 	if (!(conn->flags & CO_FL_PRIVATE) &&
 	    srv && srv->pool_purge_delay > 0 &&
@@ -5839,52 +6573,13 @@ int srv_add_to_idle_list(struct server *srv, struct connection *conn, int is_saf
 	    (srv->max_idle_conns == -1 || srv->max_idle_conns > srv->curr_idle_conns) &&
 	    ((eb_is_empty(&srv->per_thr[tid].safe_conns) &&
 	      (is_safe || eb_is_empty(&srv->per_thr[tid].idle_conns))) ||
+	     (srv->pool_min_conn &&
+	      srv->curr_idle_conns < srv->pool_min_conn * global.nbtgroups + srv->curr_used_conns) ||
 	     (ha_used_fds < global.tune.pool_low_count &&
 	      (srv->curr_used_conns + srv->curr_idle_conns <=
 	       MAX(srv->curr_used_conns, srv->est_need_conns) + srv->low_idle_conns))) &&
-	    !conn->mux->used_streams(conn) && conn->mux->avail_streams(conn)) {
-		int retadd;
-
-		retadd = _HA_ATOMIC_ADD_FETCH(&srv->curr_idle_conns, 1);
-		if (retadd > srv->max_idle_conns) {
-			_HA_ATOMIC_DEC(&srv->curr_idle_conns);
-			return 0;
-		}
-		_HA_ATOMIC_DEC(&srv->curr_used_conns);
-
-		HA_SPIN_LOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
-		conn_delete_from_tree(&conn->hash_node->node);
-
-		if (is_safe) {
-			conn->flags = (conn->flags & ~CO_FL_LIST_MASK) | CO_FL_SAFE_LIST;
-			eb64_insert(&srv->per_thr[tid].safe_conns, &conn->hash_node->node);
-			_HA_ATOMIC_INC(&srv->curr_safe_nb);
-		} else {
-			conn->flags = (conn->flags & ~CO_FL_LIST_MASK) | CO_FL_IDLE_LIST;
-			eb64_insert(&srv->per_thr[tid].idle_conns, &conn->hash_node->node);
-			_HA_ATOMIC_INC(&srv->curr_idle_nb);
-		}
-		HA_SPIN_UNLOCK(IDLE_CONNS_LOCK, &idle_conns[tid].idle_conns_lock);
-		_HA_ATOMIC_INC(&srv->curr_idle_thr[tid]);
-
-		__ha_barrier_full();
-		if ((volatile void *)srv->idle_node.node.leaf_p == NULL) {
-			HA_SPIN_LOCK(OTHER_LOCK, &idle_conn_srv_lock);
-			if ((volatile void *)srv->idle_node.node.leaf_p == NULL) {
-				srv->idle_node.key = tick_add(srv->pool_purge_delay,
-				                              now_ms);
-				eb32_insert(&idle_conn_srv, &srv->idle_node);
-				if (!task_in_wq(idle_conn_task) && !
-				    task_in_rq(idle_conn_task)) {
-					task_schedule(idle_conn_task,
-					              srv->idle_node.key);
-				}
-
-			}
-			HA_SPIN_UNLOCK(OTHER_LOCK, &idle_conn_srv_lock);
-		}
-		return 1;
-	}
+	    !conn->mux->used_streams(conn) && conn->mux->avail_streams(conn))
+		return _srv_add_to_idle_list(srv, conn, is_safe);
 	return 0;
 }
 
@@ -5937,6 +6632,11 @@ struct task *srv_cleanup_idle_conns(struct task *task, void *context, unsigned i
 
 		HA_ATOMIC_STORE(&srv->max_used_conns, srv->curr_used_conns);
 
+		/* never purge below the "pool-min-conn" setting */
+		if (srv->pool_min_conn &&
+		    exceed_conns > curr_idle - (int)(srv->pool_min_conn * global.nbtgroups))
+			exceed_conns = curr_idle - srv->pool_min_conn * global.nbtgroups;
+
 		if (exceed_conns <= 0)
 			goto remove;
 
@@ -5982,6 +6682,146 @@ struct task *srv_cleanup_idle_conns(struct task *task, void *context, unsigned i
 	return task;
 }
 
+/* Establishes a new connection to server <srv> from the current thread
+ * without any stream, and adds it to the thread's idle list so that it is
+ * ready to be picked by the next stream. The connection is only meant to be
+ * reused by streams whose connection parameters depend on nothing but the
+ * server, which is guaranteed by srv_check_pool_min_conn(). Returns 1 if the
+ * connection was established (or is in progress), otherwise 0.
+ */
+static int srv_prewarm_conn(struct server *srv)
+{
+	struct conn_hash_params hash_params;
+	struct connection *conn;
+
+	conn = conn_new(&srv->obj_type);
+	if (!conn)
+		return 0;
+
+	if (!sockaddr_alloc(&conn->dst, &srv->addr, sizeof(srv->addr)))
+		goto fail;
+	set_host_port(conn->dst, srv->svc_port);
+
+	if (conn_prepare(conn, protocol_lookup(conn->dst->ss_family, PROTO_TYPE_STREAM, 0), srv->xprt) ||
+	    !conn->ctrl || !conn->ctrl->connect)
+		goto fail;
+
+	memset(&hash_params, 0, sizeof(hash_params));
+	hash_params.target = &srv->obj_type;
+	if (srv->coalesce) {
+		hash_params.target = srv->coalesce;
+		hash_params.dst_addr = conn->dst;
+	}
+	conn->hash_node->node.key = conn_calculate_hash(&hash_params);
+
+	if (conn->ctrl->connect(conn, 0) != SF_ERR_NONE)
+		goto fail;
+
+	_HA_ATOMIC_INC(&srv->counters.connect);
+
+	if (conn_xprt_start(conn) < 0 ||
+	    conn_install_mux_be(conn, NULL, NULL, NULL) < 0)
+		goto fail_close;
+
+	if (!_srv_add_to_idle_list(srv, conn, 0)) {
+		conn->mux->destroy(conn->ctx);
+		return 0;
+	}
+	return 1;
+
+ fail_close:
+	conn_full_close(conn);
+ fail:
+	conn_free(conn);
+	return 0;
+}
+
+/* Per-thread task which keeps established the "pool-min-conn" connections of
+ * all servers which are up. The setting applies per thread group and is
+ * evenly spread over the group's threads. It runs every second, and is woken
+ * up when a connection is picked from the idle list of its thread.
+ */
+struct task *srv_prewarm_idle_conns(struct task *task, void *context, unsigned int state)
+{
+	struct proxy *px;
+	struct server *srv;
+	unsigned int want;
+
+	if (stopping) {
+		task->expire = TICK_ETERNITY;
+		return task;
+	}
+
+	for (px = proxies_list; px; px = px->next) {
+		if (px->flags & (PR_FL_DISABLED|PR_FL_STOPPED))
+			continue;
+
+		for (srv = px->srv; srv; srv = srv->next) {
+			if (!srv->pool_min_conn || !srv->curr_idle_thr ||
+			    srv->cur_state == SRV_ST_STOPPED ||
+			    (srv->cur_admin & SRV_ADMF_MAINT) ||
+			    !is_addr(&srv->addr))
+				continue;
+
+			want = srv->pool_min_conn / tg->count +
+			       (ti->ltid < srv->pool_min_conn % tg->count);
+
+			while (srv->curr_idle_thr[tid] < want &&
+			       ha_used_fds < global.tune.pool_high_count &&
+			       srv->curr_idle_conns < srv->max_idle_conns) {
+				if (!srv_prewarm_conn(srv))
+					break;
+			}
+		}
+	}
+
+	task->expire = tick_add(now_ms, MS_TO_TICKS(1000));
+	return task;
+}
+
+/* Checks that server <srv> may use the "pool-min-conn" setting, which
+ * requires connections which only depend on the server itself, and that a
+ * mux can be installed before any stream is attached. If this is not the case,
+ * the setting is disabled and a warning is emitted. Returns ERR_WARN in this
+ * case, otherwise ERR_NONE.
+ */
+int srv_check_pool_min_conn(struct server *srv)
+{
+	const char *reason = NULL;
+
+	if (!srv->pool_min_conn)
+		return ERR_NONE;
+
+	if (srv->proxy->mode != PR_MODE_HTTP)
+		reason = "the proxy is not in HTTP mode";
+	else if ((srv->proxy->options & PR_O_REUSE_MASK) == PR_O_REUSE_NEVR)
+		reason = "'http-reuse never' is set";
+	else if (!srv->max_idle_conns || !srv->pool_purge_delay)
+		reason = "idle connections are disabled";
+	else if (srv->pp_opts || (srv->flags & SRV_F_SOCKS4_PROXY))
+		reason = "a proxy protocol is used";
+	else if (srv->flags & SRV_F_MAPPORTS)
+		reason = "the port depends on the client's";
+	else if ((srv->conn_src.opts | srv->proxy->conn_src.opts) & CO_SRC_BIND)
+		reason = "a source address is set";
+	else if (srv->mux_proto && isteq(srv->mux_proto->token, ist("fcgi")))
+		reason = "the FastCGI protocol is used";
+#ifdef USE_OPENSSL
+	else if (srv->ssl_ctx.sni)
+		reason = "the SNI depends on the request";
+	else if (srv->use_ssl == 1 && (srv->ssl_ctx.alpn_str || srv->ssl_ctx.npn_str) && !srv->mux_proto)
+		reason = "the protocol is negotiated with ALPN/NPN, please set 'proto'";
+#endif
+
+	if (!reason)
+		return ERR_NONE;
+
+	ha_warning("parsing [%s:%d] : 'pool-min-conn' ignored for server '%s/%s' because %s.\n",
+	           srv->conf.file, srv->conf.line, srv->proxy->id, srv->id, reason);
+	srv->pool_min_conn = 0;
+	return ERR_WARN;
+}
+
 /* Close remaining idle connections. This functions is designed to be run on
  * process shutdown. This guarantees a proper socket shutdown to avoid
  * TIME_WAIT state. For a quick operation, only ctrl is closed, xprt stack is
@@ -6014,11 +6854,113 @@ static void srv_close_idle_conns(struct server *srv)
 				ebmb_delete(node);
 			}
 		}
+
+		/* the group's tree is shared, only close our own connections */
+		if (srv->coalesce) {
+			struct eb64_node *node, *next;
+
+			for (node = eb64_first(&srv->coalesce->avail_conns[i]); node; node = next) {
+				struct conn_hash_node *conn_hash_node = eb64_entry(node, struct conn_hash_node, node);
+				struct connection *conn = conn_hash_node->conn;
+
+				next = eb64_next(node);
+				if (conn->target != &srv->obj_type)
+					continue;
+				if (conn->ctrl->ctrl_close)
+					conn->ctrl->ctrl_close(conn);
+				eb64_delete(node);
+			}
+		}
 	}
 }
 
 REGISTER_SERVER_DEINIT(srv_close_idle_conns);
 
+/* Publishes event <event> about server <srv> to the global subscribers. It
+ * may be called with the server's lock held.
+ */
+void srv_event_hdl_publish(struct event_hdl_sub_type event, struct server *srv)
+{
+	struct event_hdl_cb_data_server cb_data;
+
+	strlcpy2(cb_data.safe.name, srv->id, sizeof(cb_data.safe.name));
+	strlcpy2(cb_data.safe.proxy_name, srv->proxy->id, sizeof(cb_data.safe.proxy_name));
+	cb_data.safe.puid       = srv->puid;
+	cb_data.safe.proxy_uuid = srv->proxy->uuid;
+	cb_data.safe.state      = srv->cur_state;
+	cb_data.safe.admin      = srv->cur_admin;
+	cb_data.safe.eweight    = srv->cur_eweight;
+	cb_data.safe.uweight    = srv->uweight;
+	cb_data.safe.maxconn    = srv->maxconn;
+	cb_data.safe.queue      = srv->queue.length;
+	cb_data.unsafe.ptr      = srv;
+
+	event_hdl_publish(NULL, event, EVENT_HDL_CB_DATA(&cb_data));
+}
+
+/* the "servers" ring where server events are reported, if any */
+static struct sink *srv_events_sink;
+
+/* Synchronous handler reporting server events to the "servers" ring as one
+ * line per event, prefixed with the date by the ring's format.
+ */
+static void srv_events_to_ring(const struct event_hdl_cb *cb, void *private)
+{
+	const struct event_hdl_cb_data_server *data = cb->e_data;
+	static const char *state_str[] = {
+		[SRV_ST_STOPPED]  = "DOWN",
+		[SRV_ST_STARTING] = "STARTING",
+		[SRV_ST_RUNNING]  = "UP",
+		[SRV_ST_STOPPING] = "NOLB",
+	};
+	char line[256];
+	struct ist msg;
+	int len;
+
+	/* the caller may be using the trash, so use a local buffer */
+	len = snprintf(line, sizeof(line),
+	               "%s %s/%s id=%d/%u state=%s%s%s weight=%u/%u maxconn=%u queue=%u",
+	               event_hdl_sub_type_to_string(cb->e_type),
+	               data->safe.proxy_name, data->safe.name,
+	               data->safe.proxy_uuid, data->safe.puid,
+	               state_str[data->safe.state],
+	               (data->safe.admin & SRV_ADMF_MAINT) ? ",MAINT" : "",
+	               (data->safe.admin & SRV_ADMF_DRAIN) ? ",DRAIN" : "",
+	               data->safe.eweight, data->safe.uweight,
+	               data->safe.maxconn, data->safe.queue);
+	if (len < 0)
+		return;
+
+	msg = ist2(line, MIN(len, sizeof(line) - 1));
+	sink_write(srv_events_sink, &msg, 1, LOG_NOTICE, 0, NULL);
+}
+
+/* Subscribes the "servers" ring to the server events. This ring is created
+ * unless a ring section with this name was declared in the configuration, in
+ * which case its size and format are kept, and it may also forward the events
+ * to a remote log server.
+ */
+static int srv_events_init(void)
+{
+	srv_events_sink = sink_find("servers");
+	if (!srv_events_sink)
+		srv_events_sink = sink_new_buf("servers", "server events", LOG_FORMAT_TIMED, 65536);
+
+	if (!srv_events_sink || srv_events_sink->type != SINK_TYPE_BUFFER) {
+		ha_warning("Unable to create the 'servers' ring, server events will not be reported.\n");
+		srv_events_sink = NULL;
+		return ERR_NONE;
+	}
+
+	if (!event_hdl_subscribe(NULL, EVENT_HDL_SUB_SERVER, EVENT_HDL_SYNC(srv_events_to_ring, NULL, NULL))) {
+		ha_alert("Failed to subscribe the 'servers' ring to server events.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+	return ERR_NONE;
+}
+
+REGISTER_POST_CHECK(srv_events_init);
+
 /* config parser for global "tune.idle-pool.shared", accepts "on" or "off" */
 static int cfg_parse_idle_pool_shared(char **args, int section_type, struct proxy *curpx,
                                       const struct proxy *defpx, const char *file, int line,
@@ -6063,8 +7005,26 @@ static int cfg_parse_pool_fd_ratio(char **args, int section_type, struct proxy *
 	return 0;
 }
 
+/* config parser for global "tune.events.queue-threshold" */
+static int cfg_parse_events_queue_thr(char **args, int section_type, struct proxy *curpx,
+                                      const struct proxy *defpx, const char *file, int line,
+                                      char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (*(args[1]) == 0 || atoi(args[1]) < 0) {
+		memprintf(err, "'%s' expects a positive integer argument.", args[0]);
+		return -1;
+	}
+
+	global.tune.srv_queue_evt = atoi(args[1]);
+	return 0;
+}
+
 /* config keyword parsers */
 static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.events.queue-threshold", cfg_parse_events_queue_thr },
 	{ CFG_GLOBAL, "tune.idle-pool.shared",       cfg_parse_idle_pool_shared },
 	{ CFG_GLOBAL, "tune.pool-high-fd-ratio",     cfg_parse_pool_fd_ratio },
 	{ CFG_GLOBAL, "tune.pool-low-fd-ratio",      cfg_parse_pool_fd_ratio },
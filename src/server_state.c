@@ -11,6 +11,10 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <import/eb64tree.h>
 #include <import/ebistree.h>
@@ -19,9 +23,11 @@
 #include <haproxy/backend.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/check.h>
+#include <haproxy/cli.h>
 #include <haproxy/errors.h>
 #include <haproxy/global.h>
 #include <haproxy/log.h>
+#include <haproxy/net_helper.h>
 #include <haproxy/port_range.h>
 #include <haproxy/proxy.h>
 #include <haproxy/resolvers.h>
@@ -492,6 +498,15 @@ static void srv_state_srv_update(struct server *srv, int version, char **params)
 	free_trash_chunk(msg);
 }
 
+/* Returns the key of the state of server <srv_name> from backend <be_name>,
+ * used to index the states of the text and binary server-state files.
+ */
+static inline uint64_t srv_state_key(const char *be_name, const char *srv_name)
+{
+	chunk_printf(&trash, "%s %s", be_name, srv_name);
+	return XXH3(trash.area, trash.data, 0);
+}
+
 /*
  * Loop on the proxy's servers and try to load its state from <st_tree> using
  * srv_state_srv_update(). The proxy name and the server name are concatenated
@@ -505,8 +520,7 @@ static void srv_state_px_update(const struct proxy *px, int vsn, struct eb_root
 	unsigned long key;
 
 	for (srv = px->srv; srv; srv = srv->next) {
-		chunk_printf(&trash, "%s %s", px->id, srv->id);
-		key = XXH3(trash.area, trash.data, 0);
+		key = srv_state_key(px->id, srv->id);
 		node = eb64_lookup(st_tree, key);
 		if (!node)
 			continue; /* next server */
@@ -520,6 +534,314 @@ static void srv_state_px_update(const struct proxy *px, int vsn, struct eb_root
 	}
 }
 
+/* Releases binary server-state file <bin> mapped by srv_state_bin_open(). */
+static void srv_state_bin_close(struct server_state_bin *bin)
+{
+	if (bin->area)
+		munmap(bin->area, bin->size);
+	bin->area = NULL;
+}
+
+/* Checks the whole index of binary server-state file <bin> so that a truncated
+ * or corrupted file is rejected at once instead of being partially applied.
+ * The keys must be sorted and each entry must reference a valid number of
+ * zero-terminated fields within the states area. Returns 1 if the index is
+ * valid, otherwise 0.
+ */
+static int srv_state_bin_check(const struct server_state_bin *bin)
+{
+	const char *idx = bin->area + SRV_STATE_BIN_HDR_LEN;
+	const char *end = bin->area + bin->size;
+	size_t start = SRV_STATE_BIN_HDR_LEN + (size_t)bin->count * SRV_STATE_BIN_IDX_LEN;
+	uint64_t key, prev = 0;
+	unsigned int i, ofs, nbf;
+	const char *cur;
+
+	for (i = 0; i < bin->count; i++, idx += SRV_STATE_BIN_IDX_LEN) {
+		key = my_ntohll(read_u64(idx));
+		ofs = ntohl(read_u32(idx + 8));
+		nbf = ntohl(read_u32(idx + 12));
+		if (key < prev || ofs < start || ofs >= bin->size ||
+		    nbf < SRV_STATE_FILE_MIN_FIELDS_VERSION_1 || nbf > SRV_STATE_FILE_MAX_FIELDS_VERSION_1)
+			return 0;
+		prev = key;
+
+		for (cur = bin->area + ofs; nbf; nbf--) {
+			cur = memchr(cur, 0, end - cur);
+			if (!cur)
+				return 0;
+			cur++;
+		}
+	}
+	return 1;
+}
+
+/* Maps the binary server-state file <file> into <bin>. Returns 1 on success, 0
+ * if the file is not a binary server-state file, in which case it must be
+ * parsed as a text one, or -1 on error, in which case a warning was emitted.
+ * On success, the caller must release the file using srv_state_bin_close().
+ */
+static int srv_state_bin_open(const char *file, struct server_state_bin *bin)
+{
+	char magic[sizeof(SRV_STATE_BIN_MAGIC) - 1];
+	struct stat st;
+	int fd;
+
+	bin->area = NULL;
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return 0; /* reported by the text loader */
+
+	if (read(fd, magic, sizeof(magic)) != sizeof(magic) ||
+	    memcmp(magic, SRV_STATE_BIN_MAGIC, sizeof(magic)) != 0) {
+		close(fd);
+		return 0;
+	}
+
+	if (fstat(fd, &st) < 0 || st.st_size < SRV_STATE_BIN_HDR_LEN) {
+		close(fd);
+		goto corrupted;
+	}
+
+	/* the fields are parsed in place and may be modified */
+	bin->area = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (bin->area == MAP_FAILED) {
+		bin->area = NULL;
+		ha_warning("config: Can't map server state file '%s': %s.\n", file, strerror(errno));
+		return -1;
+	}
+
+	bin->size = st.st_size;
+	bin->vsn = ntohl(read_u32(bin->area + 8));
+	bin->count = ntohl(read_u32(bin->area + 12));
+	if (bin->vsn < SRV_STATE_FILE_VERSION_MIN || bin->vsn > SRV_STATE_FILE_VERSION_MAX) {
+		ha_warning("config: Unsupported version %d in server state file '%s'.\n", bin->vsn, file);
+		srv_state_bin_close(bin);
+		return -1;
+	}
+
+	if (bin->count > (bin->size - SRV_STATE_BIN_HDR_LEN) / SRV_STATE_BIN_IDX_LEN ||
+	    !srv_state_bin_check(bin)) {
+		srv_state_bin_close(bin);
+		goto corrupted;
+	}
+	return 1;
+
+ corrupted:
+	ha_warning("config: corrupted server state file '%s'.\n", file);
+	return -1;
+}
+
+/* Looks up in binary server-state file <bin> the state of server <srv_name>
+ * from backend <be_name>, using a binary search in the file's index. On
+ * success, <params> is filled with the state's fields and 1 is returned,
+ * otherwise 0 is returned.
+ */
+static int srv_state_bin_lookup(const struct server_state_bin *bin, const char *be_name,
+                                const char *srv_name, char **params)
+{
+	const char *idx = bin->area + SRV_STATE_BIN_HDR_LEN;
+	uint64_t key = srv_state_key(be_name, srv_name);
+	unsigned int lo = 0, hi = bin->count, mid;
+	unsigned int ofs, nbf, arg;
+	char *cur, *end;
+
+	/* find the first entry of the index with this key */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (my_ntohll(read_u64(idx + mid * SRV_STATE_BIN_IDX_LEN)) < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* then check the names of all entries with this key */
+	for (; lo < bin->count; lo++) {
+		if (my_ntohll(read_u64(idx + lo * SRV_STATE_BIN_IDX_LEN)) != key)
+			break;
+
+		ofs = ntohl(read_u32(idx + lo * SRV_STATE_BIN_IDX_LEN + 8));
+		nbf = ntohl(read_u32(idx + lo * SRV_STATE_BIN_IDX_LEN + 12));
+		if (ofs >= bin->size ||
+		    nbf < SRV_STATE_FILE_MIN_FIELDS_VERSION_1 || nbf > SRV_STATE_FILE_MAX_FIELDS_VERSION_1)
+			continue;
+
+		memset(params, 0, SRV_STATE_FILE_MAX_FIELDS * sizeof(*params));
+		cur = bin->area + ofs;
+		end = bin->area + bin->size;
+		for (arg = 0; arg < nbf && cur; arg++) {
+			params[arg] = cur;
+			cur = memchr(cur, 0, end - cur);
+			if (cur)
+				cur++;
+		}
+
+		if (cur && strcmp(params[1], be_name) == 0 && strcmp(params[3], srv_name) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Loop on the proxy's servers and try to load their state from binary
+ * server-state file <bin> using srv_state_srv_update(). States are looked up
+ * by backend and server names.
+ */
+static void srv_state_px_update_bin(const struct proxy *px, const struct server_state_bin *bin)
+{
+	char *params[SRV_STATE_FILE_MAX_FIELDS];
+	struct server *srv;
+
+	for (srv = px->srv; srv; srv = srv->next) {
+		if (srv_state_bin_lookup(bin, px->id, srv->id, params))
+			srv_state_srv_update(srv, bin->vsn, params + 4);
+	}
+}
+
+/* qsort() callback ordering the entries of a binary server-state index by key.
+ * Keys are stored in network byte order, so they may be compared as strings.
+ */
+static int srv_state_bin_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, 8);
+}
+
+/* Saves the state of all the servers of all the backends to binary
+ * server-state file <file>. The file is first written under a temporary name
+ * then renamed. Returns the number of saved states, or -1 on error, with <err>
+ * filled.
+ */
+static int srv_state_save_bin(const char *file, char **err)
+{
+	struct buffer *line = get_trash_chunk();
+	struct proxy *px;
+	struct server *srv;
+	char *idx = NULL, *area = NULL, *tmp = NULL;
+	char hdr[SRV_STATE_BIN_HDR_LEN];
+	size_t len = 0, size = 0, ofs;
+	unsigned int count = 0, nbf, i;
+	FILE *f = NULL;
+	int ret = -1;
+
+	for (px = proxies_list; px; px = px->next) {
+		if ((px->cap & PR_CAP_BE) && !(px->cap & PR_CAP_INT)) {
+			for (srv = px->srv; srv; srv = srv->next)
+				count++;
+		}
+	}
+
+	idx = calloc(count ? count : 1, SRV_STATE_BIN_IDX_LEN);
+	if (!idx)
+		goto alloc_err;
+
+	i = 0;
+	for (px = proxies_list; px; px = px->next) {
+		if (!(px->cap & PR_CAP_BE) || (px->cap & PR_CAP_INT))
+			continue;
+
+		for (srv = px->srv; srv && i < count; srv = srv->next, i++) {
+			proxy_fill_server_state(line, px, srv, 0);
+
+			if (len + line->data > size) {
+				char *new_area;
+
+				size = (size + line->data) * 2;
+				new_area = realloc(area, size);
+				if (!new_area)
+					goto alloc_err;
+				area = new_area;
+			}
+
+			/* the fields become zero-terminated strings, the line
+			 * feed included.
+			 */
+			nbf = 0;
+			ofs = len;
+			for (line->data = 0; line->area[line->data] != '\n'; line->data++) {
+				area[len++] = line->area[line->data] == ' ' ? 0 : line->area[line->data];
+				nbf += line->area[line->data] == ' ';
+			}
+			area[len++] = 0;
+			nbf++;
+
+			ofs += SRV_STATE_BIN_HDR_LEN + (size_t)count * SRV_STATE_BIN_IDX_LEN;
+			if (ofs > UINT_MAX) {
+				memprintf(err, "Too many servers to save their state.\n");
+				goto out;
+			}
+
+			write_u64(idx + i * SRV_STATE_BIN_IDX_LEN, my_htonll(srv_state_key(px->id, srv->id)));
+			write_u32(idx + i * SRV_STATE_BIN_IDX_LEN + 8, htonl(ofs));
+			write_u32(idx + i * SRV_STATE_BIN_IDX_LEN + 12, htonl(nbf));
+		}
+	}
+	count = i;
+	qsort(idx, count, SRV_STATE_BIN_IDX_LEN, srv_state_bin_cmp);
+
+	memcpy(hdr, SRV_STATE_BIN_MAGIC, strlen(SRV_STATE_BIN_MAGIC));
+	write_u32(hdr + 8, htonl(SRV_STATE_FILE_VERSION));
+	write_u32(hdr + 12, htonl(count));
+
+	if (!memprintf(&tmp, "%s.%d.tmp", file, (int)getpid()))
+		goto alloc_err;
+
+	f = fopen(tmp, "w");
+	if (!f) {
+		memprintf(err, "Can't create file '%s': %s.\n", tmp, strerror(errno));
+		goto out;
+	}
+
+	fwrite(hdr, sizeof(hdr), 1, f);
+	fwrite(idx, SRV_STATE_BIN_IDX_LEN, count, f);
+	if (len)
+		fwrite(area, len, 1, f);
+	if (ferror(f) | fclose(f)) {
+		f = NULL;
+		memprintf(err, "Can't write file '%s': %s.\n", tmp, strerror(errno));
+		unlink(tmp);
+		goto out;
+	}
+	f = NULL;
+
+	if (rename(tmp, file) < 0) {
+		memprintf(err, "Can't rename '%s' to '%s': %s.\n", tmp, file, strerror(errno));
+		unlink(tmp);
+		goto out;
+	}
+	ret = count;
+	goto out;
+
+ alloc_err:
+	memprintf(err, "Out of memory.\n");
+ out:
+	if (f)
+		fclose(f);
+	free(tmp);
+	free(area);
+	free(idx);
+	return ret;
+}
+
+/* Parses "save servers state <file>" */
+static int cli_parse_save_servers_state(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	char *err = NULL;
+	int ret;
+
+	if (!cli_has_level(appctx, ACCESS_LVL_ADMIN))
+		return 1;
+
+	if (!*args[3])
+		return cli_err(appctx, "Missing file name.\n");
+
+	ret = srv_state_save_bin(args[3], &err);
+	if (ret < 0)
+		return cli_dynerr(appctx, err);
+
+	return cli_dynmsg(appctx, LOG_INFO, memprintf(&err, "Saved the state of %d servers.\n", ret));
+}
+
 /*
  * read next line from file <f> and return the server state version if one found.
  * If no version is found, then 0 is returned
@@ -712,8 +1034,7 @@ static int srv_state_parse_and_store_line(char *line, int vsn, struct eb_root *s
 	 *   if <px> is defined:  be_name == px->id
 	 *   otherwise: be_name == params[1]
 	 */
-	chunk_printf(&trash, "%s %s", (px ? px->id : st_line->params[1]), st_line->params[3]);
-	st_line->node.key = XXH3(trash.area, trash.data, 0);
+	st_line->node.key = srv_state_key((px ? px->id : st_line->params[1]), st_line->params[3]);
 	if (eb64_insert(st_tree, &st_line->node) != &st_line->node) {
 		/* this is a duplicate key, probably a hand-crafted file, drop it! */
 		goto skip_line;
@@ -777,6 +1098,7 @@ void apply_server_state(void)
 {
 	/* tree where global state_file is loaded */
 	struct eb_root global_state_tree = EB_ROOT_UNIQUE;
+	struct server_state_bin global_bin = { }, local_bin;
 	struct proxy *curproxy;
 	struct server_state_line *st_line;
 	struct eb64_node *node, *next_node;
@@ -794,6 +1116,10 @@ void apply_server_state(void)
 		goto no_globalfile;
 	}
 
+	/* A binary file is directly mapped, there is nothing to load */
+	if (srv_state_bin_open(file, &global_bin) != 0)
+		goto no_globalfile;
+
 	/* Load global server state in a tree */
 	errno = 0;
 	f = fopen(file, "r");
@@ -846,7 +1172,9 @@ void apply_server_state(void)
 			 * Backend name can't be wrong since it's used as a key to retrieve the server state
 			 * line from the tree.
 			 */
-			if (global_vsn)
+			if (global_bin.area)
+				srv_state_px_update_bin(curproxy, &global_bin);
+			else if (global_vsn)
 				srv_state_px_update(curproxy, global_vsn, &global_state_tree);
 			continue; /* next proxy */
 		}
@@ -862,6 +1190,16 @@ void apply_server_state(void)
 			continue; /* next proxy */
 		}
 
+		/* A binary file is directly looked up */
+		len = srv_state_bin_open(file, &local_bin);
+		if (len != 0) {
+			if (len > 0) {
+				srv_state_px_update_bin(curproxy, &local_bin);
+				srv_state_bin_close(&local_bin);
+			}
+			continue; /* next proxy */
+		}
+
 		/* Load local server state in a tree */
 		errno = 0;
 		f = fopen(file, "r");
@@ -919,6 +1257,8 @@ void apply_server_state(void)
 		fclose(f);
 	}
 
+	srv_state_bin_close(&global_bin);
+
 	node = eb64_first(&global_state_tree);
         while (node) {
                 st_line = eb64_entry(node, typeof(*st_line), node);
@@ -929,3 +1269,11 @@ void apply_server_state(void)
                 node = next_node;
         }
 }
+
+/* register cli keywords */
+static struct cli_kw_list cli_kws = {{ },{
+	{ { "save", "servers", "state", NULL }, "save servers state <file>               : save all servers' state to a binary server-state file", cli_parse_save_servers_state, NULL },
+	{{},}
+}};
+
+INITCALL1(STG_REGISTER, cli_register_kw, &cli_kws);
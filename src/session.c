@@ -11,6 +11,7 @@
  */
 
 #include <haproxy/api.h>
+#include <haproxy/cfgparse.h>
 #include <haproxy/connection.h>
 #include <haproxy/global.h>
 #include <haproxy/http.h>
@@ -21,25 +22,37 @@
 #include <haproxy/session.h>
 #include <haproxy/tcp_rules.h>
 #include <haproxy/tools.h>
+#include <haproxy/usdt.h>
 #include <haproxy/vars.h>
 
 
 DECLARE_POOL(pool_head_session, "session", sizeof(struct session));
 DECLARE_POOL(pool_head_sess_srv_list, "session server list",
 		sizeof(struct sess_srv_list));
+DECLARE_POOL(pool_head_sess_conn_slab, "sess_conn", sizeof(struct sess_conn_slab));
 
 int conn_complete_session(struct connection *conn);
 
 /* Create a a new session and assign it to frontend <fe>, listener <li>,
  * origin <origin>, set the current date and clear the stick counters pointers.
- * Returns the session upon success or NULL. The session may be released using
- * session_free(). Note: <li> may be NULL.
+ * If <origin> is a connection allocated in a sess_conn_slab, the session from
+ * the slab is used. Returns the session upon success or NULL. The session may
+ * be released using session_free(). Note: <li> may be NULL.
  */
 struct session *session_new(struct proxy *fe, struct listener *li, enum obj_type *origin)
 {
+	struct connection *conn = objt_conn(origin);
+	struct sess_conn_slab *slab;
 	struct session *sess;
 
-	sess = pool_alloc(pool_head_session);
+	if (conn && (conn->flags & CO_FL_SESS_SLAB)) {
+		slab = container_of(conn, struct sess_conn_slab, conn);
+		HA_ATOMIC_INC(&slab->users);
+		sess = &slab->sess;
+	}
+	else
+		sess = pool_alloc(pool_head_session);
+
 	if (sess) {
 		sess->listener = li;
 		sess->fe = fe;
@@ -55,7 +68,7 @@ struct session *session_new(struct proxy *fe, struct listener *li, enum obj_type
 		_HA_ATOMIC_INC(&jobs);
 		LIST_INIT(&sess->srv_list);
 		sess->idle_conns = 0;
-		sess->flags = SESS_FL_NONE;
+		sess->flags = (conn && (conn->flags & CO_FL_SESS_SLAB)) ? SESS_FL_CONN_SLAB : SESS_FL_NONE;
 		sess->src = NULL;
 		sess->dst = NULL;
 	}
@@ -94,7 +107,10 @@ void session_free(struct session *sess)
 	}
 	sockaddr_free(&sess->src);
 	sockaddr_free(&sess->dst);
-	pool_free(pool_head_session, sess);
+	if (sess->flags & SESS_FL_CONN_SLAB)
+		sess_conn_slab_release(container_of(sess, struct sess_conn_slab, sess));
+	else
+		pool_free(pool_head_session, sess);
 	_HA_ATOMIC_DEC(&jobs);
 }
 
@@ -151,6 +167,8 @@ int session_accept_fd(struct connection *cli_conn)
 
 	ret = -1; /* assume unrecoverable error by default */
 
+	HA_USDT(conn_accept, cli_conn, l, p, cfd);
+
 	cli_conn->proxy_netns = l->rx.settings->netns;
 
 	if (conn_prepare(cli_conn, l->rx.proto, l->bind_conf->xprt) < 0)
@@ -443,6 +461,32 @@ int conn_complete_session(struct connection *conn)
 	return -1;
 }
 
+/* config parser for global "tune.session.combined-alloc", accepts "on" or "off" */
+static int cfg_parse_tune_sess_conn_slab(char **args, int section_type, struct proxy *curpx,
+                                         const struct proxy *defpx, const char *file, int line,
+                                         char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0)
+		global.tune.options |= GTUNE_SESS_CONN_SLAB;
+	else if (strcmp(args[1], "off") == 0)
+		global.tune.options &= ~GTUNE_SESS_CONN_SLAB;
+	else {
+		memprintf(err, "'%s' expects either 'on' or 'off' but got '%s'.", args[0], args[1]);
+		return -1;
+	}
+	return 0;
+}
+
+static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.session.combined-alloc", cfg_parse_tune_sess_conn_slab },
+	{ /* END */ },
+}};
+
+INITCALL1(STG_REGISTER, cfg_register_keywords, &cfg_kws);
+
 /*
  * Local variables:
  *  c-indent-level: 8
@@ -68,6 +68,24 @@ static inline void put_be32(void *ptr, uint32_t value)
 
 #endif
 
+/* x86_64 CPUs supporting the SHA extensions and ARMv8 CPUs supporting the
+ * crypto extensions have dedicated instructions to perform 4 SHA1 rounds at
+ * once and to compute the message schedule, which process a block about 3 to
+ * 5 times faster than the portable code. On x86_64 the code is built when the
+ * compiler supports per-function target attributes and is enabled at boot time
+ * only when the CPU supports it. On ARMv8 it is only used when the compiler
+ * already targets the crypto extensions.
+ */
+#if defined(__x86_64__) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define SHA1_HAVE_SHANI
+#include <cpuid.h>
+#include <immintrin.h>
+static int sha1_use_shani;
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+#define SHA1_HAVE_ARMCE
+#include <arm_neon.h>
+#endif
+
 #if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
 
 /*
@@ -140,6 +158,7 @@ static inline void put_be32(void *ptr, uint32_t value)
 #define T_40_59(t, A, B, C, D, E) SHA_ROUND(t, SHA_MIX, ((B&C)+(D&(B^C))) , 0x8f1bbcdc, A, B, C, D, E )
 #define T_60_79(t, A, B, C, D, E) SHA_ROUND(t, SHA_MIX, (B^C^D) ,  0xca62c1d6, A, B, C, D, E )
 
+#if !defined(SHA1_HAVE_ARMCE)
 static void blk_SHA1_Block(blk_SHA_CTX *ctx, const void *block)
 {
 	unsigned int A,B,C,D,E;
@@ -247,6 +266,377 @@ static void blk_SHA1_Block(blk_SHA_CTX *ctx, const void *block)
 	ctx->H[3] += D;
 	ctx->H[4] += E;
 }
+#endif /* !SHA1_HAVE_ARMCE */
+
+#if defined(SHA1_HAVE_SHANI)
+/* Processes <blocks> consecutive 64-byte blocks from <data> using the x86 SHA
+ * extensions. The 5 words of the state are kept in two registers, ABCD in the
+ * first one and E in the upper word of the second one. The CPU must support
+ * the SHA, SSSE3 and SSE4.1 instructions, which is checked at boot time.
+ */
+__attribute__((target("sha,ssse3,sse4.1")))
+static void blk_SHA1_Blocks_shani(blk_SHA_CTX *ctx, const unsigned char *data, unsigned long blocks)
+{
+	const __m128i MASK = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i ABCD, ABCD_SAVE, E0, E0_SAVE, E1;
+	__m128i MSG0, MSG1, MSG2, MSG3;
+
+	ABCD = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)ctx->H), 0x1B);
+	E0 = _mm_set_epi32(ctx->H[4], 0, 0, 0);
+
+	while (blocks--) {
+		ABCD_SAVE = ABCD;
+		E0_SAVE = E0;
+
+		/* rounds 0-3 */
+		MSG0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 0)), MASK);
+		E0 = _mm_add_epi32(E0, MSG0);
+		E1 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+
+		/* rounds 4-7 */
+		MSG1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), MASK);
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+		MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+
+		/* rounds 8-11 */
+		MSG2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), MASK);
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+		MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+		MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+		/* rounds 12-15 */
+		MSG3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), MASK);
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+		MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+		MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+		/* rounds 16-19 */
+		E0 = _mm_sha1nexte_epu32(E0, MSG0);
+		E1 = ABCD;
+		MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+		MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+		MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+		/* rounds 20-23 */
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+		MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+		MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+		/* rounds 24-27 */
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 1);
+		MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+		MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+		/* rounds 28-31 */
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+		MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+		MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+		/* rounds 32-35 */
+		E0 = _mm_sha1nexte_epu32(E0, MSG0);
+		E1 = ABCD;
+		MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 1);
+		MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+		MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+		/* rounds 36-39 */
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+		MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+		MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+		/* rounds 40-43 */
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+		MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+		MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+		/* rounds 44-47 */
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 2);
+		MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+		MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+		/* rounds 48-51 */
+		E0 = _mm_sha1nexte_epu32(E0, MSG0);
+		E1 = ABCD;
+		MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+		MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+		MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+		/* rounds 52-55 */
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 2);
+		MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+		MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+		/* rounds 56-59 */
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+		MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+		MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+		/* rounds 60-63 */
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+		MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+		MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+		/* rounds 64-67 */
+		E0 = _mm_sha1nexte_epu32(E0, MSG0);
+		E1 = ABCD;
+		MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 3);
+		MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+		MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+		/* rounds 68-71 */
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+		MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+		/* rounds 72-75 */
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 3);
+
+		/* rounds 76-79 */
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+
+		E0 = _mm_sha1nexte_epu32(E0, E0_SAVE);
+		ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+		data += 64;
+	}
+
+	_mm_storeu_si128((__m128i *)ctx->H, _mm_shuffle_epi32(ABCD, 0x1B));
+	ctx->H[4] = _mm_extract_epi32(E0, 3);
+}
+#endif /* SHA1_HAVE_SHANI */
+
+#if defined(SHA1_HAVE_ARMCE)
+/* Processes <blocks> consecutive 64-byte blocks from <data> using the ARMv8
+ * crypto extensions. The round constants are added to the message words two
+ * steps ahead so that the additions are hidden behind the rounds.
+ */
+static void blk_SHA1_Blocks_ce(blk_SHA_CTX *ctx, const unsigned char *data, unsigned long blocks)
+{
+	static const uint32_t K[4] = { 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6 };
+	uint32x4_t ABCD, ABCD_SAVE, TMP0, TMP1;
+	uint32x4_t MSG0, MSG1, MSG2, MSG3;
+	uint32_t E0, E0_SAVE, E1;
+
+	ABCD = vld1q_u32(ctx->H);
+	E0 = ctx->H[4];
+
+	while (blocks--) {
+		ABCD_SAVE = ABCD;
+		E0_SAVE = E0;
+
+		MSG0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data +  0)));
+		MSG1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16)));
+		MSG2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 32)));
+		MSG3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 48)));
+
+		TMP0 = vaddq_u32(MSG0, vdupq_n_u32(K[0]));
+		TMP1 = vaddq_u32(MSG1, vdupq_n_u32(K[0]));
+
+		/* rounds 0-3 */
+		E1 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1cq_u32(ABCD, E0, TMP0);
+		TMP0 = vaddq_u32(MSG2, vdupq_n_u32(K[0]));
+		MSG0 = vsha1su0q_u32(MSG0, MSG1, MSG2);
+
+		/* rounds 4-7 */
+		E0 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1cq_u32(ABCD, E1, TMP1);
+		TMP1 = vaddq_u32(MSG3, vdupq_n_u32(K[0]));
+		MSG0 = vsha1su1q_u32(MSG0, MSG3);
+		MSG1 = vsha1su0q_u32(MSG1, MSG2, MSG3);
+
+		/* rounds 8-11 */
+		E1 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1cq_u32(ABCD, E0, TMP0);
+		TMP0 = vaddq_u32(MSG0, vdupq_n_u32(K[0]));
+		MSG1 = vsha1su1q_u32(MSG1, MSG0);
+		MSG2 = vsha1su0q_u32(MSG2, MSG3, MSG0);
+
+		/* rounds 12-15 */
+		E0 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1cq_u32(ABCD, E1, TMP1);
+		TMP1 = vaddq_u32(MSG1, vdupq_n_u32(K[1]));
+		MSG2 = vsha1su1q_u32(MSG2, MSG1);
+		MSG3 = vsha1su0q_u32(MSG3, MSG0, MSG1);
+
+		/* rounds 16-19 */
+		E1 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1cq_u32(ABCD, E0, TMP0);
+		TMP0 = vaddq_u32(MSG2, vdupq_n_u32(K[1]));
+		MSG3 = vsha1su1q_u32(MSG3, MSG2);
+		MSG0 = vsha1su0q_u32(MSG0, MSG1, MSG2);
+
+		/* rounds 20-23 */
+		E0 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1pq_u32(ABCD, E1, TMP1);
+		TMP1 = vaddq_u32(MSG3, vdupq_n_u32(K[1]));
+		MSG0 = vsha1su1q_u32(MSG0, MSG3);
+		MSG1 = vsha1su0q_u32(MSG1, MSG2, MSG3);
+
+		/* rounds 24-27 */
+		E1 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1pq_u32(ABCD, E0, TMP0);
+		TMP0 = vaddq_u32(MSG0, vdupq_n_u32(K[1]));
+		MSG1 = vsha1su1q_u32(MSG1, MSG0);
+		MSG2 = vsha1su0q_u32(MSG2, MSG3, MSG0);
+
+		/* rounds 28-31 */
+		E0 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1pq_u32(ABCD, E1, TMP1);
+		TMP1 = vaddq_u32(MSG1, vdupq_n_u32(K[1]));
+		MSG2 = vsha1su1q_u32(MSG2, MSG1);
+		MSG3 = vsha1su0q_u32(MSG3, MSG0, MSG1);
+
+		/* rounds 32-35 */
+		E1 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1pq_u32(ABCD, E0, TMP0);
+		TMP0 = vaddq_u32(MSG2, vdupq_n_u32(K[2]));
+		MSG3 = vsha1su1q_u32(MSG3, MSG2);
+		MSG0 = vsha1su0q_u32(MSG0, MSG1, MSG2);
+
+		/* rounds 36-39 */
+		E0 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1pq_u32(ABCD, E1, TMP1);
+		TMP1 = vaddq_u32(MSG3, vdupq_n_u32(K[2]));
+		MSG0 = vsha1su1q_u32(MSG0, MSG3);
+		MSG1 = vsha1su0q_u32(MSG1, MSG2, MSG3);
+
+		/* rounds 40-43 */
+		E1 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1mq_u32(ABCD, E0, TMP0);
+		TMP0 = vaddq_u32(MSG0, vdupq_n_u32(K[2]));
+		MSG1 = vsha1su1q_u32(MSG1, MSG0);
+		MSG2 = vsha1su0q_u32(MSG2, MSG3, MSG0);
+
+		/* rounds 44-47 */
+		E0 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1mq_u32(ABCD, E1, TMP1);
+		TMP1 = vaddq_u32(MSG1, vdupq_n_u32(K[2]));
+		MSG2 = vsha1su1q_u32(MSG2, MSG1);
+		MSG3 = vsha1su0q_u32(MSG3, MSG0, MSG1);
+
+		/* rounds 48-51 */
+		E1 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1mq_u32(ABCD, E0, TMP0);
+		TMP0 = vaddq_u32(MSG2, vdupq_n_u32(K[2]));
+		MSG3 = vsha1su1q_u32(MSG3, MSG2);
+		MSG0 = vsha1su0q_u32(MSG0, MSG1, MSG2);
+
+		/* rounds 52-55 */
+		E0 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1mq_u32(ABCD, E1, TMP1);
+		TMP1 = vaddq_u32(MSG3, vdupq_n_u32(K[3]));
+		MSG0 = vsha1su1q_u32(MSG0, MSG3);
+		MSG1 = vsha1su0q_u32(MSG1, MSG2, MSG3);
+
+		/* rounds 56-59 */
+		E1 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1mq_u32(ABCD, E0, TMP0);
+		TMP0 = vaddq_u32(MSG0, vdupq_n_u32(K[3]));
+		MSG1 = vsha1su1q_u32(MSG1, MSG0);
+		MSG2 = vsha1su0q_u32(MSG2, MSG3, MSG0);
+
+		/* rounds 60-63 */
+		E0 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1pq_u32(ABCD, E1, TMP1);
+		TMP1 = vaddq_u32(MSG1, vdupq_n_u32(K[3]));
+		MSG2 = vsha1su1q_u32(MSG2, MSG1);
+		MSG3 = vsha1su0q_u32(MSG3, MSG0, MSG1);
+
+		/* rounds 64-67 */
+		E1 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1pq_u32(ABCD, E0, TMP0);
+		TMP0 = vaddq_u32(MSG2, vdupq_n_u32(K[3]));
+		MSG3 = vsha1su1q_u32(MSG3, MSG2);
+
+		/* rounds 68-71 */
+		E0 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1pq_u32(ABCD, E1, TMP1);
+		TMP1 = vaddq_u32(MSG3, vdupq_n_u32(K[3]));
+
+		/* rounds 72-75 */
+		E1 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1pq_u32(ABCD, E0, TMP0);
+
+		/* rounds 76-79 */
+		E0 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		ABCD = vsha1pq_u32(ABCD, E1, TMP1);
+
+		E0 += E0_SAVE;
+		ABCD = vaddq_u32(ABCD_SAVE, ABCD);
+		data += 64;
+	}
+
+	vst1q_u32(ctx->H, ABCD);
+	ctx->H[4] = E0;
+}
+#endif /* SHA1_HAVE_ARMCE */
+
+/* Processes <blocks> consecutive 64-byte blocks from <data> using the fastest
+ * implementation available on this machine.
+ */
+static void blk_SHA1_Blocks(blk_SHA_CTX *ctx, const void *data, unsigned long blocks)
+{
+#if defined(SHA1_HAVE_ARMCE)
+	blk_SHA1_Blocks_ce(ctx, data, blocks);
+#else
+#if defined(SHA1_HAVE_SHANI)
+	if (sha1_use_shani) {
+		blk_SHA1_Blocks_shani(ctx, data, blocks);
+		return;
+	}
+#endif
+	while (blocks--) {
+		blk_SHA1_Block(ctx, data);
+		data = ((const char *)data + 64);
+	}
+#endif
+}
 
 void blk_SHA1_Init(blk_SHA_CTX *ctx)
 {
@@ -277,12 +667,12 @@ void blk_SHA1_Update(blk_SHA_CTX *ctx, const void *data, unsigned long len)
 		data = ((const char *)data + left);
 		if (lenW)
 			return;
-		blk_SHA1_Block(ctx, ctx->W);
+		blk_SHA1_Blocks(ctx, ctx->W, 1);
 	}
-	while (len >= 64) {
-		blk_SHA1_Block(ctx, data);
-		data = ((const char *)data + 64);
-		len -= 64;
+	if (len >= 64) {
+		blk_SHA1_Blocks(ctx, data, len / 64);
+		data = ((const char *)data + (len & ~63UL));
+		len &= 63;
 	}
 	if (len)
 		memcpy(ctx->W, data, len);
@@ -306,3 +696,22 @@ void blk_SHA1_Final(unsigned char hashout[20], blk_SHA_CTX *ctx)
 	for (i = 0; i < 5; i++)
 		put_be32(hashout + i * 4, ctx->H[i]);
 }
+
+#if defined(SHA1_HAVE_SHANI)
+__attribute__((constructor))
+static void __sha1_initialize(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	/* SHA is reported in leaf 7 EBX bit 29, SSSE3 and SSE4.1 in leaf 1 ECX
+	 * bits 9 and 19.
+	 */
+	if (__get_cpuid_max(0, NULL) < 7)
+		return;
+	__cpuid(1, eax, ebx, ecx, edx);
+	if ((ecx & ((1U << 9) | (1U << 19))) != ((1U << 9) | (1U << 19)))
+		return;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	sha1_use_shani = !!(ebx & (1U << 29));
+}
+#endif
@@ -12,6 +12,7 @@
  */
 
 #include <sys/mman.h>
+#include <unistd.h>
 #include <arpa/inet.h>
 #include <import/ebmbtree.h>
 #include <haproxy/list.h>
@@ -89,7 +90,7 @@ struct shared_block *shctx_row_reserve_hot(struct shared_context *shctx,
 
 			/* release callback */
 			if (first_len && shctx->free_block)
-				shctx->free_block(next, block);
+				shctx->free_block(shctx, next, block);
 
 			block->block_count = 1;
 			block->len = 0;
@@ -291,35 +292,62 @@ int shctx_row_data_get(struct shared_context *shctx, struct shared_block *first,
 	return len;
 }
 
+/* Returns the size of the memory area needed by a shared context of
+ * <maxblocks> blocks of <blocksize> bytes, with <extra> bytes reserved for
+ * the caller after the context structure.
+ */
+size_t shctx_area_size(int maxblocks, int blocksize, int extra)
+{
+	/* make sure to align the records on a pointer size */
+	blocksize = (blocksize + sizeof(void *) - 1) & -sizeof(void *);
+	extra     = (extra     + sizeof(void *) - 1) & -sizeof(void *);
+
+	return sizeof(struct shared_context) + extra + ((size_t)maxblocks * (sizeof(struct shared_block) + blocksize));
+}
+
 /* Allocate shared memory context.
  * <maxblocks> is maximum blocks.
  * If <maxblocks> is set to less or equal to 0, ssl cache is disabled.
+ * If <fd> is positive, the context is stored in this file, which is resized
+ * to the size of the area, and it is always shared.
  * Returns: -1 on alloc failure, <maxblocks> if it performs context alloc,
  * and 0 if cache is already allocated.
  */
 int shctx_init(struct shared_context **orig_shctx, int maxblocks, int blocksize,
-               unsigned int maxobjsz, int extra, int shared)
+               unsigned int maxobjsz, int extra, int shared, int fd)
 {
 	int i;
 	struct shared_context *shctx;
 	int ret;
 	void *cur;
 	int maptype = MAP_PRIVATE;
+	size_t size;
 
 	if (maxblocks <= 0)
 		return 0;
 
+	size = shctx_area_size(maxblocks, blocksize, extra);
+
 	/* make sure to align the records on a pointer size */
 	blocksize = (blocksize + sizeof(void *) - 1) & -sizeof(void *);
 	extra     = (extra     + sizeof(void *) - 1) & -sizeof(void *);
 
-	if (shared) {
+	if (shared || fd >= 0) {
 		maptype = MAP_SHARED;
 		use_shared_mem = 1;
 	}
 
-	shctx = (struct shared_context *)mmap(NULL, sizeof(struct shared_context) + extra + (maxblocks * (sizeof(struct shared_block) + blocksize)),
-	                                      PROT_READ | PROT_WRITE, maptype | MAP_ANON, -1, 0);
+	if (fd >= 0) {
+		if (ftruncate(fd, size) < 0) {
+			shctx = NULL;
+			ret = SHCTX_E_ALLOC_CACHE;
+			goto err;
+		}
+		shctx = (struct shared_context *)mmap(NULL, size, PROT_READ | PROT_WRITE, maptype, fd, 0);
+	}
+	else
+		shctx = (struct shared_context *)mmap(NULL, size, PROT_READ | PROT_WRITE, maptype | MAP_ANON, -1, 0);
+
 	if (!shctx || shctx == MAP_FAILED) {
 		shctx = NULL;
 		ret = SHCTX_E_ALLOC_CACHE;
@@ -352,4 +380,3 @@ int shctx_init(struct shared_context **orig_shctx, int maxblocks, int blocksize,
 	*orig_shctx = shctx;
 	return ret;
 }
-
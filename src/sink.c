@@ -23,10 +23,14 @@
 #include <fcntl.h>
 
 #include <import/ist.h>
+#ifdef USE_SLZ
+#include <import/slz.h>
+#endif
 #include <haproxy/api.h>
 #include <haproxy/applet.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/cli.h>
+#include <haproxy/clock.h>
 #include <haproxy/errors.h>
 #include <haproxy/list.h>
 #include <haproxy/log.h>
@@ -36,6 +40,7 @@
 #include <haproxy/signal.h>
 #include <haproxy/sink.h>
 #include <haproxy/stconn.h>
+#include <haproxy/task.h>
 #include <haproxy/time.h>
 #include <haproxy/tools.h>
 
@@ -180,11 +185,13 @@ struct sink *sink_new_buf(const char *name, const char *desc, enum log_fmt fmt,
 	if (sink->fmt == LOG_FORMAT_RAW)
 		goto send;
 
-	pfx = build_log_header(sink->fmt, level, facility, metadata, &npfx);
+	pfx = build_log_header(sink->fmt, level, facility, metadata, msg, nmsg, &npfx);
 
 send:
 	if (sink->type == SINK_TYPE_FD) {
-		return fd_write_frag_line(sink->ctx.fd, sink->maxlen, pfx, npfx, msg, nmsg, 1);
+		/* CBOR records are self-delimited, no LF is added after them */
+		return fd_write_frag_line(sink->ctx.fd, sink->maxlen, pfx, npfx, msg, nmsg,
+		                          sink->fmt != LOG_FORMAT_CBOR);
 	}
 	else if (sink->type == SINK_TYPE_BUFFER) {
 		return ring_write(sink->ctx.ring, sink->maxlen, pfx, npfx, msg, nmsg);
@@ -256,6 +263,10 @@ static int cli_parse_show_events(char **args, char *payload, struct appctx *appc
 				      sink->type == SINK_TYPE_FD ? "fd" :
 				      sink->type == SINK_TYPE_BUFFER ? "buffer" : "?",
 				      sink->ctx.dropped, sink->desc);
+			if (sink->archive)
+				chunk_appendf(&trash, "    %-10s   archive=%s, %llu bytes, %llu gaps\n",
+					      "", sink->archive->file, (ullong)sink->archive->size,
+					      (ullong)sink->archive->lost);
 		}
 
 		trash.area[trash.data] = 0;
@@ -757,6 +768,220 @@ int sink_init_forward(struct sink *sink)
 	return 1;
 }
 
+#ifdef USE_SLZ
+
+/* (Re-)opens the archive file and its index in append mode. Returns non-zero
+ * on success, otherwise zero with errno set and both files closed.
+ */
+static int sink_archive_open(struct sink_archive *arch)
+{
+	arch->fd = open(arch->file, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+	if (arch->fd < 0)
+		goto fail;
+
+	arch->idx_fd = open(arch->idx, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+	if (arch->idx_fd < 0)
+		goto fail;
+
+	arch->size = lseek(arch->fd, 0, SEEK_END);
+	return 1;
+ fail:
+	if (arch->fd >= 0)
+		close(arch->fd);
+	arch->fd = arch->idx_fd = -1;
+	return 0;
+}
+
+/* Renames the archive and its index to the same names suffixed with ".1",
+ * replacing any previous ones, and starts new files. Errors are ignored, the
+ * archive stays closed if it cannot be reopened.
+ */
+static void sink_archive_rotate(struct sink_archive *arch)
+{
+	char *old = NULL;
+
+	close(arch->fd);
+	close(arch->idx_fd);
+
+	memprintf(&old, "%s.1", arch->file);
+	if (old)
+		rename(arch->file, old);
+	ha_free(&old);
+
+	memprintf(&old, "%s.1", arch->idx);
+	if (old)
+		rename(arch->idx, old);
+	ha_free(&old);
+
+	sink_archive_open(arch);
+}
+
+/* Collects the events of <sink>'s ring which were not archived yet, up to
+ * RING_ARCHIVE_SEG_SIZE bytes, and appends them as one compressed segment to
+ * the archive. The ring is only read-locked while copying the events, and no
+ * reader reference is kept on it, so that archiving never blocks writers:
+ * events overwritten before being archived are only counted. Returns the
+ * number of archived events, 0 if there was nothing to archive.
+ */
+static int sink_archive_segment(struct sink *sink)
+{
+	struct sink_archive *arch = sink->archive;
+	struct ring *ring = sink->ctx.ring;
+	struct buffer *buf = &ring->buf;
+	struct slz_stream strm;
+	uint64_t msg_len;
+	size_t len, cnt, ofs;
+	size_t raw_len = 0;
+	long out_len;
+	ssize_t ret;
+	int nb = 0;
+
+	HA_RWLOCK_RDLOCK(LOGSRV_LOCK, &ring->lock);
+
+	if (arch->ofs == ~0)
+		arch->ofs = ring->ofs;
+	else if (arch->ofs < ring->ofs) {
+		/* the writer already recycled some events, note the gap */
+		arch->lost++;
+		arch->ofs = ring->ofs;
+	}
+
+	/* ofs always points to the counter byte preceding the next event */
+	ofs = arch->ofs - ring->ofs;
+	while (ofs + 1 < b_data(buf)) {
+		cnt = 1;
+		len = b_peek_varint(buf, ofs + cnt, &msg_len);
+		if (!len)
+			break;
+		cnt += len;
+
+		if (unlikely(msg_len + 1 > RING_ARCHIVE_SEG_SIZE)) {
+			/* too large a message to ever fit, let's skip it */
+			ofs += cnt + msg_len;
+			continue;
+		}
+
+		if (raw_len + msg_len + 1 > RING_ARCHIVE_SEG_SIZE)
+			break;
+
+		raw_len += b_getblk(buf, arch->raw + raw_len, msg_len, ofs + cnt);
+		arch->raw[raw_len++] = '\n';
+		ofs += cnt + msg_len;
+		nb++;
+	}
+	arch->ofs = ofs + ring->ofs;
+
+	HA_RWLOCK_RDUNLOCK(LOGSRV_LOCK, &ring->lock);
+
+	if (!nb || arch->fd < 0)
+		return nb;
+
+	slz_rfc1952_init(&strm, 1);
+	out_len = slz_rfc1952_encode(&strm, (unsigned char *)arch->out, (unsigned char *)arch->raw, raw_len, 0);
+	out_len += slz_rfc1952_finish(&strm, (unsigned char *)arch->out + out_len);
+
+	/* a single write per segment so that a concurrent process appending
+	 * to the same file (e.g. during a reload) cannot interleave with us.
+	 */
+	do {
+		ret = write(arch->fd, arch->out, out_len);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret != out_len)
+		return nb;
+
+	arch->size = lseek(arch->fd, 0, SEEK_CUR);
+	chunk_printf(&trash, "%lld %llu %llu %d\n",
+	             (long long)date.tv_sec, (ullong)(arch->size - out_len), (ullong)raw_len, nb);
+	ret = write(arch->idx_fd, trash.area, trash.data);
+
+	if (arch->max_size && arch->size >= arch->max_size)
+		sink_archive_rotate(arch);
+	return nb;
+}
+
+/* Periodic task archiving the contents of ring <context>. At most 16 segments
+ * are archived per call, then it yields if more remain.
+ */
+static struct task *process_sink_archive(struct task *task, void *context, unsigned int state)
+{
+	struct sink *sink = context;
+	int budget = 16;
+
+	while (budget-- && sink_archive_segment(sink) > 0)
+		;
+
+	if (budget < 0)
+		task_wakeup(task, TASK_WOKEN_OTHER);
+	task->expire = tick_add(now_ms, MS_TO_TICKS(RING_ARCHIVE_INTERVAL));
+	return task;
+}
+
+/* Allocates the archive for <sink> to file <file> and opens it. Returns
+ * non-zero on success, otherwise zero with <err> filled.
+ */
+static int sink_archive_init(struct sink *sink, const char *file, uint64_t max_size, char **err)
+{
+	struct sink_archive *arch;
+
+	arch = calloc(1, sizeof(*arch));
+	if (!arch)
+		goto oom;
+
+	sink->archive = arch;
+	arch->ofs = ~0;
+	arch->fd = arch->idx_fd = -1;
+	arch->max_size = max_size;
+	arch->file = strdup(file);
+	memprintf(&arch->idx, "%s.idx", file);
+	arch->raw = malloc(RING_ARCHIVE_SEG_SIZE);
+	/* slz may slightly expand incompressible data */
+	arch->out = malloc(RING_ARCHIVE_SEG_SIZE + RING_ARCHIVE_SEG_SIZE / 4 + 1024);
+	arch->task = task_new_anywhere();
+	if (!arch->file || !arch->idx || !arch->raw || !arch->out || !arch->task)
+		goto oom;
+
+	if (!sink_archive_open(arch)) {
+		memprintf(err, "cannot open archive '%s' : %s", file, strerror(errno));
+		return 0;
+	}
+
+	arch->task->process = process_sink_archive;
+	arch->task->context = sink;
+	task_wakeup(arch->task, TASK_WOKEN_INIT);
+	return 1;
+ oom:
+	memprintf(err, "out of memory");
+	return 0;
+}
+
+/* Archives whatever remains in <sink>'s ring and releases its archive. */
+static void sink_archive_deinit(struct sink *sink)
+{
+	struct sink_archive *arch = sink->archive;
+
+	if (!arch)
+		return;
+
+	if (arch->raw && arch->out && arch->task) {
+		while (sink_archive_segment(sink) > 0)
+			;
+	}
+
+	if (arch->fd >= 0)
+		close(arch->fd);
+	if (arch->idx_fd >= 0)
+		close(arch->idx_fd);
+	task_destroy(arch->task);
+	free(arch->file);
+	free(arch->idx);
+	free(arch->raw);
+	free(arch->out);
+	ha_free(&sink->archive);
+}
+
+#endif /* USE_SLZ */
+
 /* This tries to rotate a file-backed ring, but only if it contains contents.
  * This way empty rings will not cause backups to be overwritten and it's safe
  * to reload multiple times. That's only best effort, failures are silently
@@ -953,6 +1178,60 @@ int cfg_parse_ring(const char *file, int linenum, char **args, int kwm)
 		ring_free(cfg_sink->ctx.ring);
 		cfg_sink->ctx.ring = ring_make_from_area(area, size);
 	}
+	else if (strcmp(args[0], "archive") == 0) {
+#ifdef USE_SLZ
+		char *errmsg = NULL;
+#endif
+		uint max_size = 0;
+
+		if (!cfg_sink || (cfg_sink->type != SINK_TYPE_BUFFER)) {
+			ha_alert("parsing [%s:%d] : 'archive' only usable with existing rings.\n", file, linenum);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto err;
+		}
+
+		if (!*args[1]) {
+			ha_alert("parsing [%s:%d] : 'archive' expects a file name.\n", file, linenum);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto err;
+		}
+
+		if (cfg_sink->archive) {
+			ha_alert("parsing [%s:%d] : 'archive' already specified for ring '%s' (was '%s').\n", file, linenum, cfg_sink->name, cfg_sink->archive->file);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto err;
+		}
+
+		if (*args[2]) {
+			const char *res;
+
+			if (strcmp(args[2], "max-size") != 0 || !*args[3]) {
+				ha_alert("parsing [%s:%d] : 'archive' only supports 'max-size <size>' after the file name.\n", file, linenum);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto err;
+			}
+
+			res = parse_size_err(args[3], &max_size);
+			if (res) {
+				ha_alert("parsing [%s:%d] : unexpected character '%c' in 'max-size' for 'archive'.\n", file, linenum, *res);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto err;
+			}
+		}
+
+#ifdef USE_SLZ
+		if (!sink_archive_init(cfg_sink, args[1], max_size, &errmsg)) {
+			ha_alert("parsing [%s:%d] : ring '%s': %s.\n", file, linenum, cfg_sink->name, errmsg);
+			ha_free(&errmsg);
+			err_code |= ERR_ALERT | ERR_FATAL;
+			goto err;
+		}
+#else
+		ha_alert("parsing [%s:%d] : 'archive' requires a build with USE_SLZ.\n", file, linenum);
+		err_code |= ERR_ALERT | ERR_FATAL;
+		goto err;
+#endif
+	}
 	else if (strcmp(args[0],"server") == 0) {
 		if (!cfg_sink || (cfg_sink->type != SINK_TYPE_BUFFER)) {
 			ha_alert("parsing [%s:%d] : unable to create server '%s'.\n", file, linenum, args[1]);
@@ -1185,6 +1464,8 @@ struct sink *sink_new_from_logsrv(struct logsrv *logsrv)
 		if (p->conf.file)
 			free(p->conf.file);
 
+		counters_shards_free(&p->fe_counters.shards);
+		counters_shards_free(&p->be_counters.shards);
 		free(p);
 	}
 
@@ -1195,6 +1476,7 @@ struct sink *sink_new_from_logsrv(struct logsrv *logsrv)
 			free((void *)srv->conf.file);
 		if (srv->per_thr)
 		       free(srv->per_thr);
+		counters_shards_free(&srv->counters.shards);
 		free(srv);
 	}
 
@@ -1393,6 +1675,9 @@ static void sink_deinit()
 
 	list_for_each_entry_safe(sink, sb, &sink_list, sink_list) {
 		if (sink->type == SINK_TYPE_BUFFER) {
+#ifdef USE_SLZ
+			sink_archive_deinit(sink);
+#endif
 			if (sink->store)
 				munmap(sink->ctx.ring->buf.area, sink->ctx.ring->buf.size);
 			else
@@ -869,6 +869,17 @@ A gzip file consists of a series of "members" ...
         crc32 size32
 */
 
+/* x86_64 CPUs supporting PCLMULQDQ may use carry-less multiplications to
+ * compute the CRC32. The code is built for it when the compiler supports
+ * per-function target attributes, and is enabled at boot time only when the
+ * CPU supports it.
+ */
+#if defined(__x86_64__) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define SLZ_HAVE_CLMUL
+#include <immintrin.h>
+static int slz_use_clmul;
+#endif
+
 static const unsigned char gzip_hdr[] = { 0x1F, 0x8B,   // ID1, ID2
                                           0x08, 0x00,   // Deflate, flags (none)
                                           0x00, 0x00, 0x00, 0x00, // mtime: none
@@ -935,10 +946,8 @@ uint32_t slz_crc32_by4(uint32_t crc, const unsigned char *buf, int len)
 		crc = ~crc;
 #  if defined(__ARM_ARCH_ISA_A64)
 	// 64 bit mode
-		__asm__ volatile("crc32w %w0,%w0,%w1" : "+r"(crc) : "r"(*(uint32_t*)(buf)));
-		__asm__ volatile("crc32w %w0,%w0,%w1" : "+r"(crc) : "r"(*(uint32_t*)(buf + 4)));
-		__asm__ volatile("crc32w %w0,%w0,%w1" : "+r"(crc) : "r"(*(uint32_t*)(buf + 8)));
-		__asm__ volatile("crc32w %w0,%w0,%w1" : "+r"(crc) : "r"(*(uint32_t*)(buf + 12)));
+		__asm__ volatile("crc32x %w0,%w0,%x1" : "+r"(crc) : "r"(*(uint64_t*)(buf)));
+		__asm__ volatile("crc32x %w0,%w0,%x1" : "+r"(crc) : "r"(*(uint64_t*)(buf + 8)));
 #  else
 	// 32 bit mode (e.g. armv7 compiler building for armv8
 		__asm__ volatile("crc32w %0,%0,%1" : "+r"(crc) : "r"(*(uint32_t*)(buf)));
@@ -1002,10 +1011,110 @@ uint32_t slz_crc32_by4(uint32_t crc, const unsigned char *buf, int len)
 	return crc;
 }
 
+#if defined(SLZ_HAVE_CLMUL)
+/* This version computes the crc32 of <buf> over <len> bytes using carry-less
+ * multiplications (PCLMULQDQ) to fold 64 bytes at a time into four 128-bit
+ * accumulators, which are then folded down to 128 then 64 bits and finally
+ * reduced to 32 bits using a Barrett reduction. This is the method described
+ * in Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+ * Instruction" paper, using its bit-reflected constants for the gzip
+ * polynomial. <len> must be at least 64 and a multiple of 16. The CPU must
+ * support the PCLMULQDQ instruction, which is checked at boot time.
+ */
+__attribute__((target("pclmul,sse2")))
+static uint32_t slz_crc32_clmul(uint32_t crc, const unsigned char *buf, long len)
+{
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596ULL, 0x0154442bd4ULL);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eULL, 0x01751997d0ULL);
+	const __m128i k5k0 = _mm_set_epi64x(0x0000000000ULL, 0x0163cd6124ULL);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641ULL, 0x01db710641ULL);
+	const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+	/* the CRC is kept inverted in the registers */
+	x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(~crc));
+	buf += 64;
+	len -= 64;
+
+	/* fold 4x128 bits in parallel */
+	while (len >= 64) {
+		x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+		buf += 64;
+		len -= 64;
+	}
+
+	/* fold the 4 accumulators into a single 128-bit one */
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	/* fold the remaining 16-byte blocks */
+	while (len >= 16) {
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)buf)), x5);
+		buf += 16;
+		len -= 16;
+	}
+
+	/* fold 128 bits to 64 bits */
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask);
+	x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* Barrett reduction to 32 bits */
+	x2 = _mm_and_si128(x1, mask);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+	x2 = _mm_and_si128(x2, mask);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return ~(uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+#endif
+
 /* uses the most suitable crc32 function to update crc on <buf, len> */
 static inline uint32_t update_crc(uint32_t crc, const void *buf, int len)
 {
-	return slz_crc32_by4(crc, buf, len);
+	const unsigned char *ptr = buf;
+
+#if defined(SLZ_HAVE_CLMUL)
+	if (slz_use_clmul && len >= 64) {
+		crc = slz_crc32_clmul(crc, ptr, len & -16);
+		ptr += len & -16;
+		len &= 15;
+	}
+#endif
+	return slz_crc32_by4(crc, ptr, len);
 }
 
 /* Sends the gzip header for stream <strm> into buffer <buf>. When it's done,
@@ -1340,4 +1449,8 @@ static void __slz_initialize(void)
 	__slz_make_crc_table();
 #endif
 	__slz_prepare_dist_table();
+#if defined(SLZ_HAVE_CLMUL)
+	__builtin_cpu_init();
+	slz_use_clmul = !!__builtin_cpu_supports("pclmul");
+#endif
 }
@@ -24,15 +24,21 @@
 
 #include <net/if.h>
 
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+
 #include <haproxy/api.h>
 #include <haproxy/activity.h>
 #include <haproxy/connection.h>
+#include <haproxy/dynbuf.h>
 #include <haproxy/listener.h>
 #include <haproxy/log.h>
 #include <haproxy/namespace.h>
 #include <haproxy/proto_sockpair.h>
 #include <haproxy/sock.h>
 #include <haproxy/sock_inet.h>
+#include <haproxy/ticks.h>
 #include <haproxy/tools.h>
 
 #define SOCK_XFER_OPT_FOREIGN 0x000000001
@@ -713,6 +719,10 @@ void sock_conn_ctrl_init(struct connection *conn)
 void sock_conn_ctrl_close(struct connection *conn)
 {
 	BUG_ON(conn->flags & CO_FL_FDLESS);
+	if (unlikely(conn->zc)) {
+		sock_zc_drain(conn);
+		sock_zc_release(conn);
+	}
 	fd_delete(conn->handle.fd);
 	conn->handle.fd = DEAD_FD_MAGIC;
 }
@@ -824,6 +834,10 @@ void sock_conn_iocb(int fd)
 		return;
 	}
 
+	/* MSG_ZEROCOPY completions are reported as errors */
+	if (unlikely(conn->zc) && (fdtab[fd].state & FD_POLL_ERR))
+		sock_zc_drain(conn);
+
 	flags = conn->flags & ~CO_FL_ERROR; /* ensure to call the wake handler upon error */
 
 	if (unlikely(conn->flags & CO_FL_WAIT_L4_CONN) &&
@@ -992,6 +1006,233 @@ void sock_ignore_events(struct connection *conn, int event_type)
 		fd_stop_send(conn->handle.fd);
 }
 
+#ifdef HA_HAVE_MSG_ZEROCOPY
+
+DECLARE_STATIC_POOL(pool_head_sock_zc, "sock_zc", sizeof(struct sock_zc));
+DECLARE_STATIC_POOL(pool_head_sock_zc_area, "sock_zc_area", sizeof(struct sock_zc_area));
+
+/* areas still in use by the kernel after their socket was closed, oldest first */
+static THREAD_LOCAL struct list sock_zc_orphans = { NULL, NULL };
+
+/* Releases zero-copy area <zca> and its buffer. It must not be attached. */
+static void sock_zc_free_area(struct sock_zc_area *zca)
+{
+	pool_free(pool_head_buffer, zca->area);
+	pool_free(pool_head_sock_zc_area, zca);
+	offer_buffers(NULL, 1);
+}
+
+/* Prepares the next send on connection <conn> to use MSG_ZEROCOPY, enabling it
+ * on the socket first if needed. A spare buffer area is reserved to replace
+ * the one which will be passed to the kernel. It returns non-zero if the
+ * caller may pass CO_SFL_ZEROCOPY to the send, in which case it must call
+ * sock_zc_commit() instead of consuming the buffer's data itself. Otherwise
+ * zero is returned, either because zero-copy is not usable on this socket, or
+ * because of a memory shortage.
+ */
+int sock_zc_prepare(struct connection *conn)
+{
+	struct sock_zc *zc = conn->zc;
+	struct sock_zc_area *zca;
+	int one = 1;
+
+	if (!conn_ctrl_ready(conn) || (conn->flags & CO_FL_FDLESS))
+		return 0;
+
+	/* only TCP sockets support it, don't waste a pool entry and a syscall */
+	if (conn->ctrl->fam->sock_family != AF_INET &&
+	    conn->ctrl->fam->sock_family != AF_INET6)
+		return 0;
+
+	if (!zc) {
+		zc = pool_alloc(pool_head_sock_zc);
+		if (!zc)
+			return 0;
+		LIST_INIT(&zc->areas);
+		zc->prep = NULL;
+		zc->next_id = zc->prep_id = 0;
+		zc->flags = 0;
+		if (setsockopt(conn->handle.fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == -1)
+			zc->flags |= SOCK_ZC_F_DISABLED;
+		conn->zc = zc;
+	}
+
+	/* the socket is not necessarily polled, so completions are also
+	 * collected before each send, which bounds the number of areas kept.
+	 */
+	if (!LIST_ISEMPTY(&zc->areas))
+		sock_zc_drain(conn);
+
+	if (zc->flags & (SOCK_ZC_F_COPIED | SOCK_ZC_F_DISABLED))
+		return 0;
+
+	BUG_ON(zc->prep);
+
+	zca = pool_alloc(pool_head_sock_zc_area);
+	if (!zca)
+		return 0;
+
+	zca->area = pool_alloc(pool_head_buffer);
+	if (!zca->area) {
+		pool_free(pool_head_sock_zc_area, zca);
+		return 0;
+	}
+
+	zc->prep = zca;
+	zc->prep_id = zc->next_id;
+	return 1;
+}
+
+/* Consumes <sent> bytes from buffer <buf> after a send on connection <conn>
+ * that was prepared by sock_zc_prepare(). If the kernel took a reference to
+ * the buffer's area, this area is kept aside until its completion is reported
+ * and the remaining data are moved to the spare area which replaces it in
+ * <buf>. Otherwise the spare area is released.
+ */
+void sock_zc_commit(struct connection *conn, struct buffer *buf, size_t sent)
+{
+	struct sock_zc *zc = conn->zc;
+	struct sock_zc_area *zca = zc->prep;
+	size_t left;
+	char *area;
+
+	zc->prep = NULL;
+	if (zc->next_id == zc->prep_id) {
+		b_del(buf, sent);
+		pool_free(pool_head_buffer, zca->area);
+		pool_free(pool_head_sock_zc_area, zca);
+		return;
+	}
+
+	left = b_data(buf) - sent;
+	area = buf->area;
+	b_getblk(buf, zca->area, left, sent);
+	buf->area = zca->area;
+	buf->head = 0;
+	buf->data = left;
+
+	zca->area = area;
+	zca->id = zc->next_id - 1;
+	LIST_APPEND(&zc->areas, &zca->list);
+}
+
+/* Reads the MSG_ZEROCOPY completions from the error queue of connection
+ * <conn>'s socket and releases the areas they cover. Since these completions
+ * are reported by the poller as errors, FD_POLL_ERR is cleared if no real
+ * error is pending on the socket.
+ */
+void sock_zc_drain(struct connection *conn)
+{
+	struct sock_zc *zc = conn->zc;
+	struct sock_zc_area *zca, *back;
+	struct sock_extended_err *serr;
+	struct cmsghdr *cm;
+	struct msghdr msg;
+	char control[128];
+	int fd = conn->handle.fd;
+	socklen_t len;
+	int err;
+
+	while (1) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+			    !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+				continue;
+
+			serr = (struct sock_extended_err *)CMSG_DATA(cm);
+			if (serr->ee_errno || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+
+			/* the kernel had to copy the data, zero-copy is useless */
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				zc->flags |= SOCK_ZC_F_COPIED;
+
+			/* send calls ee_info to ee_data are completed */
+			list_for_each_entry_safe(zca, back, &zc->areas, list) {
+				if ((int32_t)(zca->id - serr->ee_info) < 0 ||
+				    (int32_t)(serr->ee_data - zca->id) < 0)
+					continue;
+				LIST_DELETE(&zca->list);
+				sock_zc_free_area(zca);
+			}
+		}
+	}
+
+	len = sizeof(err);
+	if ((fdtab[fd].state & FD_POLL_ERR) &&
+	    getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && !err)
+		HA_ATOMIC_AND(&fdtab[fd].state, ~FD_POLL_ERR);
+}
+
+/* Releases the MSG_ZEROCOPY context of connection <conn>. Areas whose
+ * completion was not reported yet may still be in use by the kernel, so they
+ * are only released SOCK_ZC_ORPHAN_DELAY milliseconds later.
+ */
+void sock_zc_release(struct connection *conn)
+{
+	struct sock_zc *zc = conn->zc;
+	struct sock_zc_area *zca, *back;
+
+	if (!zc)
+		return;
+
+	if (unlikely(!sock_zc_orphans.n))
+		LIST_INIT(&sock_zc_orphans);
+
+	if (zc->prep) {
+		pool_free(pool_head_buffer, zc->prep->area);
+		pool_free(pool_head_sock_zc_area, zc->prep);
+	}
+
+	list_for_each_entry_safe(zca, back, &zc->areas, list) {
+		LIST_DELETE(&zca->list);
+		zca->exp = tick_add(now_ms, SOCK_ZC_ORPHAN_DELAY);
+		LIST_APPEND(&sock_zc_orphans, &zca->list);
+	}
+
+	list_for_each_entry_safe(zca, back, &sock_zc_orphans, list) {
+		if (!tick_is_expired(zca->exp, now_ms))
+			break;
+		LIST_DELETE(&zca->list);
+		sock_zc_free_area(zca);
+	}
+
+	pool_free(pool_head_sock_zc, zc);
+	conn->zc = NULL;
+}
+
+#else /* HA_HAVE_MSG_ZEROCOPY */
+
+int sock_zc_prepare(struct connection *conn)
+{
+	return 0;
+}
+
+void sock_zc_commit(struct connection *conn, struct buffer *buf, size_t sent)
+{
+	b_del(buf, sent);
+}
+
+void sock_zc_drain(struct connection *conn)
+{
+}
+
+void sock_zc_release(struct connection *conn)
+{
+}
+
+#endif /* HA_HAVE_MSG_ZEROCOPY */
+
 /*
  * Local variables:
  *  c-indent-level: 8
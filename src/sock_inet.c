@@ -338,6 +338,14 @@ int sock_inet_bind_receiver(struct receiver *rx, char **errmsg)
 		setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
 #endif
 
+#ifdef SO_INCOMING_CPU
+	/* Linux prefers the reuseport socket advertising the CPU which
+	 * processes the incoming connection. It must be set before listen().
+	 */
+	if (!ext && (rx->settings->options & RX_O_INCOMING_CPU) && rx->incoming_cpu >= 0)
+		setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &rx->incoming_cpu, sizeof(rx->incoming_cpu));
+#endif
+
 	if (!ext && (rx->settings->options & RX_O_FOREIGN)) {
 		switch (addr_inet.ss_family) {
 		case AF_INET:
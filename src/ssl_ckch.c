@@ -948,6 +948,9 @@ struct ckch_store *ckchs_lookup(char *path)
 struct ckch_store *ckchs_load_cert_file(char *path, char **err)
 {
 	struct ckch_store *ckchs;
+	struct startup_prof prof;
+
+	startup_prof_start(&prof);
 
 	ckchs = ckch_store_new(path);
 	if (!ckchs) {
@@ -961,6 +964,7 @@ struct ckch_store *ckchs_load_cert_file(char *path, char **err)
 	/* insert into the ckchs tree */
 	memcpy(ckchs->path, path, strlen(path) + 1);
 	ebst_insert(&ckchs_tree, &ckchs->node);
+	startup_prof_report(&prof, 0, "certificate file '%s'", path);
 	return ckchs;
 
 end:
@@ -969,6 +973,43 @@ struct ckch_store *ckchs_load_cert_file(char *path, char **err)
 	return NULL;
 }
 
+/*
+ * This function allocates a ckch_store whose files will only be loaded when
+ * the first instance is built from it, and inserts it into the ckchs tree.
+ */
+struct ckch_store *ckchs_new_lazy(char *path, char **err)
+{
+	struct ckch_store *ckchs;
+
+	ckchs = ckch_store_new(path);
+	if (!ckchs) {
+		memprintf(err, "%sunable to allocate memory.\n", err && *err ? *err : "");
+		return NULL;
+	}
+
+	ckchs->lazy = 1;
+	ebst_insert(&ckchs_tree, &ckchs->node);
+	return ckchs;
+}
+
+/*
+ * Loads the files of the lazy ckch_store <store> if this was not done yet.
+ * At runtime, the caller must hold the ckch_lock.
+ *
+ * Returns a set of ERR_* flags possibly with an error in <err>.
+ */
+int ckch_store_load_lazy(struct ckch_store *store, char **err)
+{
+	if (!store->lazy || store->data->cert)
+		return 0;
+
+	if (ssl_sock_load_files_into_ckch(store->path, store->data, err)) {
+		ssl_sock_free_cert_key_and_chain_contents(store->data);
+		return ERR_ALERT | ERR_FATAL;
+	}
+	return 0;
+}
+
 
 /********************  ckch_inst functions ******************************/
 
@@ -982,6 +1023,9 @@ void ckch_inst_free(struct ckch_inst *inst)
 	if (inst == NULL)
 		return;
 
+	if (inst->lazy_loaded)
+		ssl_sock_lazy_forget(inst);
+
 	list_for_each_entry_safe(sni, sni_s, &inst->sni_ctx, by_ckch_inst) {
 		SSL_CTX_free(sni->ctx);
 		LIST_DELETE(&sni->by_ckch_inst);
@@ -1998,6 +2042,23 @@ static void cli_release_commit_cert(struct appctx *appctx)
 }
 
 
+/*
+ * Returns the SSL_CTX of an instance of <ckchs> built for <bind_conf> and
+ * <ssl_conf>, or NULL if there is none.
+ */
+static SSL_CTX *ckch_store_find_ctx(struct ckch_store *ckchs, struct bind_conf *bind_conf,
+                                    struct ssl_bind_conf *ssl_conf)
+{
+	struct ckch_inst *inst;
+
+	list_for_each_entry(inst, &ckchs->ckch_inst, by_ckchs) {
+		if (inst->ctx && !inst->is_server_instance &&
+		    inst->bind_conf == bind_conf && inst->ssl_conf == ssl_conf)
+			return inst->ctx;
+	}
+	return NULL;
+}
+
 /*
  * Rebuild a new instance 'new_inst' based on an old instance 'ckchi' and a
  * specific ckch_store.
@@ -2010,6 +2071,7 @@ int ckch_inst_rebuild(struct ckch_store *ckch_store, struct ckch_inst *ckchi,
 	int errcode = 0;
 	struct sni_ctx *sc0, *sc0s;
 	char **sni_filter = NULL;
+	SSL_CTX *shared_ctx = NULL;
 	int fcount = 0;
 
 	if (ckchi->crtlist_entry) {
@@ -2017,10 +2079,19 @@ int ckch_inst_rebuild(struct ckch_store *ckch_store, struct ckch_inst *ckchi,
 		fcount = ckchi->crtlist_entry->fcount;
 	}
 
+	/* When rebuilding for another store (certificate update), all the
+	 * instances of this store are new ones. Those built for the same bind
+	 * line with the same options, typically many crt-list lines referencing
+	 * the same wildcard certificate, share a single SSL_CTX instead of
+	 * building and preparing one each.
+	 */
+	if (ckch_store != ckchi->ckch_store && !ckchi->is_server_instance)
+		shared_ctx = ckch_store_find_ctx(ckch_store, ckchi->bind_conf, ckchi->ssl_conf);
+
 	if (ckchi->is_server_instance)
 		errcode |= ckch_inst_new_load_srv_store(ckch_store->path, ckch_store, new_inst, err);
 	else
-		errcode |= ckch_inst_new_load_store(ckch_store->path, ckch_store, ckchi->bind_conf, ckchi->ssl_conf, sni_filter, fcount, new_inst, err);
+		errcode |= ckch_inst_new_load_store_ctx(ckch_store->path, ckch_store, ckchi->bind_conf, ckchi->ssl_conf, sni_filter, fcount, shared_ctx, new_inst, err);
 
 	if (errcode & ERR_CODE)
 		return 1;
@@ -2041,6 +2112,12 @@ int ckch_inst_rebuild(struct ckch_store *ckch_store, struct ckch_inst *ckchi,
 	/* create the link to the crtlist_entry */
 	(*new_inst)->crtlist_entry = ckchi->crtlist_entry;
 
+	if (shared_ctx) {
+		/* already prepared, only the CA file link is per instance */
+		ckch_inst_add_cafile_link(*new_inst, ckchi->bind_conf, ckchi->ssl_conf, NULL);
+		return 0;
+	}
+
 	/* we need to initialize the SSL_CTX generated */
 	/* this iterate on the newly generated SNIs in the new instance to prepare their SSL_CTX */
 	list_for_each_entry_safe(sc0, sc0s, &(*new_inst)->sni_ctx, by_ckch_inst) {
@@ -2077,6 +2154,7 @@ static void __ssl_sock_load_new_ckch_instance(struct ckch_inst *ckchi)
 			ha_free(&ckchi->server->ssl_ctx.reused_sess[i].sni);
 			ha_free(&ckchi->server->ssl_ctx.reused_sess[i].ptr);
 		}
+		ckchi->server->ssl_ctx.last_sess_tid = 0;
 		HA_RWLOCK_WRUNLOCK(SSL_SERVER_LOCK, &ckchi->server->ssl_ctx.lock);
 
 	} else {
@@ -2086,6 +2164,24 @@ static void __ssl_sock_load_new_ckch_instance(struct ckch_inst *ckchi)
 	}
 }
 
+/*
+ * Makes <bind_conf>'s SNI lock the one held, as recorded in <locked>, after
+ * releasing the previously held one. <bind_conf> may be NULL to release it.
+ * The instances of a store being mostly grouped by bind_conf, this allows to
+ * replace many of them without taking the lock once per instance.
+ */
+static void ckch_switch_sni_lock(struct bind_conf **locked, struct bind_conf *bind_conf)
+{
+	if (*locked == bind_conf)
+		return;
+
+	if (*locked)
+		HA_RWLOCK_WRUNLOCK(SNI_LOCK, &(*locked)->sni_lock);
+	if (bind_conf)
+		HA_RWLOCK_WRLOCK(SNI_LOCK, &bind_conf->sni_lock);
+	*locked = bind_conf;
+}
+
 /*
  * Delete a ckch instance that was replaced after a CLI command.
  */
@@ -2122,6 +2218,7 @@ void ckch_store_replace(struct ckch_store *old_ckchs, struct ckch_store *new_ckc
 {
 	struct crtlist_entry *entry;
 	struct ckch_inst *ckchi, *ckchis;
+	struct bind_conf *locked = NULL;
 
 	LIST_SPLICE(&new_ckchs->crtlist_entry, &old_ckchs->crtlist_entry);
 	list_for_each_entry(entry, &new_ckchs->crtlist_entry, by_ckch_store) {
@@ -2137,12 +2234,20 @@ void ckch_store_replace(struct ckch_store *old_ckchs, struct ckch_store *new_ckc
 	}
 	/* First, we insert every new SNIs in the trees, also replace the default_ctx */
 	list_for_each_entry_safe(ckchi, ckchis, &new_ckchs->ckch_inst, by_ckchs) {
-		__ssl_sock_load_new_ckch_instance(ckchi);
+		if (ckchi->is_server_instance) {
+			ckch_switch_sni_lock(&locked, NULL);
+			__ssl_sock_load_new_ckch_instance(ckchi);
+			continue;
+		}
+		ckch_switch_sni_lock(&locked, ckchi->bind_conf);
+		ssl_sock_load_cert_sni(ckchi, ckchi->bind_conf);
 	}
 	/* delete the old sni_ctx, the old ckch_insts and the ckch_store */
 	list_for_each_entry_safe(ckchi, ckchis, &old_ckchs->ckch_inst, by_ckchs) {
-		__ckch_inst_free_locked(ckchi);
+		ckch_switch_sni_lock(&locked, ckchi->is_server_instance ? NULL : ckchi->bind_conf);
+		ckch_inst_free(ckchi);
 	}
+	ckch_switch_sni_lock(&locked, NULL);
 
 	ckch_store_free(old_ckchs);
 	ebst_insert(&ckchs_tree, &new_ckchs->node);
@@ -2425,6 +2530,11 @@ static int cli_parse_set_cert(char **args, char *payload, struct appctx *appctx,
 		goto end;
 	}
 
+	/* the files of a lazy certificate may not have been loaded yet */
+	errcode |= ckch_store_load_lazy(old_ckchs, &err);
+	if (errcode & ERR_CODE)
+		goto end;
+
 	/* duplicate the ckch store */
 	new_ckchs = ckchs_dup(old_ckchs);
 	if (!new_ckchs) {
@@ -2593,7 +2703,8 @@ static int cli_parse_del_cert(char **args, char *payload, struct appctx *appctx,
 		memprintf(&err, "certificate '%s' doesn't exist!\n", filename);
 		goto error;
 	}
-	if (!LIST_ISEMPTY(&store->ckch_inst)) {
+	/* a lazy store may be referenced by crt-list entries without instance */
+	if (!LIST_ISEMPTY(&store->ckch_inst) || !LIST_ISEMPTY(&store->crtlist_entry)) {
 		memprintf(&err, "certificate '%s' in use, can't be deleted!\n", filename);
 		goto error;
 	}
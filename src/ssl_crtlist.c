@@ -211,6 +211,24 @@ void crtlist_entry_free(struct crtlist_entry *entry)
 	}
 	free(entry);
 }
+/*
+ * Returns non-zero if the certificate of <entry> may be loaded on demand, which
+ * requires "tune.ssl.lazy-load" and at least one positive SNI filter.
+ */
+int crtlist_entry_is_lazy(const struct crtlist_entry *entry)
+{
+	int i;
+
+	if (!global_ssl.lazy_load)
+		return 0;
+
+	for (i = 0; i < entry->fcount; i++) {
+		if (*entry->filters[i] != '!' && strcmp(entry->filters[i], "*") != 0)
+			return 1;
+	}
+	return 0;
+}
+
 /*
  * Duplicate a crt_list entry and its content (ssl_conf, filters/fcount)
  * Return a pointer to the new entry
@@ -555,7 +573,11 @@ int crtlist_parse_file(char *file, struct bind_conf *bind_conf, struct proxy *cu
 			if (stat(crt_path, &buf) == 0) {
 				found++;
 
-				ckchs = ckchs_load_cert_file(crt_path, err);
+				/* the first line may become the default certificate */
+				if (!LIST_ISEMPTY(&newlist->ord_entries) && crtlist_entry_is_lazy(entry))
+					ckchs = ckchs_new_lazy(crt_path, err);
+				else
+					ckchs = ckchs_load_cert_file(crt_path, err);
 				if (ckchs == NULL) {
 					cfgerr |= ERR_ALERT | ERR_FATAL;
 					goto error;
@@ -1288,7 +1310,7 @@ static int cli_parse_add_crtlist(char **args, char *payload, struct appctx *appc
 		memprintf(&err, "certificate '%s' does not exist!", cert_path);
 		goto error;
 	}
-	if (store->data == NULL || store->data->cert == NULL) {
+	if (store->data == NULL || (store->data->cert == NULL && !store->lazy)) {
 		memprintf(&err, "certificate '%s' is empty!", cert_path);
 		goto error;
 	}
@@ -1383,7 +1405,7 @@ static int cli_parse_del_crtlist(char **args, char *payload, struct appctx *appc
 		memprintf(&err, "certificate '%s' does not exist!", cert_path);
 		goto error;
 	}
-	if (store->data == NULL || store->data->cert == NULL) {
+	if (store->data == NULL || (store->data->cert == NULL && !store->lazy)) {
 		memprintf(&err, "certificate '%s' is empty!", cert_path);
 		goto error;
 	}
@@ -0,0 +1,375 @@
+/*
+ * Offloading of the SSL private key operations to crypto threads.
+ *
+ * When "tune.ssl.offload-threads" is set, the private keys of the bind lines
+ * are given RSA and EC_KEY methods which, when called from one of OpenSSL's
+ * async jobs, queue the operation for a pool of crypto threads and pause the
+ * job. The handshake is then resumed by the regular async fd machinery of
+ * ssl_sock.c once the crypto thread signals the completion on a pipe. This
+ * way the network threads never wait for an RSA or ECDSA signature.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+/* RSA_METHOD and EC_KEY_METHOD are deprecated since OpenSSL 3.0 but remain
+ * the only way to intercept the private key operations without a provider.
+ */
+#ifndef OPENSSL_SUPPRESS_DEPRECATED
+#define OPENSSL_SUPPRESS_DEPRECATED
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <haproxy/api.h>
+#include <haproxy/errors.h>
+#include <haproxy/global.h>
+#include <haproxy/list.h>
+#include <haproxy/openssl-compat.h>
+#include <haproxy/ssl_offload.h>
+#include <haproxy/ssl_sock.h>
+#include <haproxy/thread.h>
+
+#ifdef HAVE_SSL_OFFLOAD
+
+#include <openssl/ec.h>
+#include <openssl/rsa.h>
+
+enum ssl_offload_type {
+	SSL_OFFLOAD_RSA_PRIV_ENC = 0,
+	SSL_OFFLOAD_RSA_PRIV_DEC,
+	SSL_OFFLOAD_ECDSA_SIGN,
+};
+
+/* A private key operation queued for the crypto threads. It lives on the
+ * stack of the paused async job, which is not freed before the completion is
+ * signaled on <fd>.
+ */
+struct ssl_offload_op {
+	struct list list;            /* attach point to the queue */
+	enum ssl_offload_type type;
+	union {
+		struct {
+			int flen;
+			const unsigned char *from;
+			unsigned char *to;
+			RSA *rsa;
+			int padding;
+		} rsa;
+		struct {
+			int type;
+			const unsigned char *dgst;
+			int dlen;
+			unsigned char *sig;
+			unsigned int *siglen;
+			const BIGNUM *kinv;
+			const BIGNUM *r;
+			EC_KEY *eckey;
+		} ec;
+	};
+	int ret;                     /* result of the operation */
+	int fd;                      /* write side of the completion pipe */
+	int done;                    /* set once <ret> is valid */
+};
+
+/* key of the completion pipe in the async wait contexts */
+static const char ssl_offload_fd_key[] = "haproxy-offload";
+
+static RSA_METHOD *ssl_offload_rsa_meth = NULL;
+static EC_KEY_METHOD *ssl_offload_ec_meth = NULL;
+
+static struct list ssl_offload_queue = LIST_HEAD_INIT(ssl_offload_queue);
+static pthread_mutex_t ssl_offload_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ssl_offload_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t *ssl_offload_threads = NULL;
+static int ssl_offload_nbthreads = 0; /* number of started crypto threads */
+static int ssl_offload_stopping = 0;
+
+/* Runs the operation <op> with OpenSSL's default methods */
+static void ssl_offload_process(struct ssl_offload_op *op)
+{
+	switch (op->type) {
+	case SSL_OFFLOAD_RSA_PRIV_ENC:
+		op->ret = RSA_meth_get_priv_enc(RSA_PKCS1_OpenSSL())(op->rsa.flen, op->rsa.from, op->rsa.to,
+		                                                    op->rsa.rsa, op->rsa.padding);
+		break;
+	case SSL_OFFLOAD_RSA_PRIV_DEC:
+		op->ret = RSA_meth_get_priv_dec(RSA_PKCS1_OpenSSL())(op->rsa.flen, op->rsa.from, op->rsa.to,
+		                                                    op->rsa.rsa, op->rsa.padding);
+		break;
+	case SSL_OFFLOAD_ECDSA_SIGN: {
+		int (*sign)(int, const unsigned char *, int, unsigned char *, unsigned int *,
+		            const BIGNUM *, const BIGNUM *, EC_KEY *);
+
+		EC_KEY_METHOD_get_sign(EC_KEY_OpenSSL(), &sign, NULL, NULL);
+		op->ret = sign(op->ec.type, op->ec.dgst, op->ec.dlen, op->ec.sig, op->ec.siglen,
+		               op->ec.kinv, op->ec.r, op->ec.eckey);
+		break;
+	}
+	}
+}
+
+/* Main loop of the crypto threads. Up to SSL_OFFLOAD_BATCH operations are
+ * dequeued at once to limit the contention on the queue under load.
+ */
+static void *ssl_offload_thread(void *arg)
+{
+	struct ssl_offload_op *batch[SSL_OFFLOAD_BATCH];
+	int nb, i;
+
+	pthread_mutex_lock(&ssl_offload_lock);
+	while (1) {
+		while (LIST_ISEMPTY(&ssl_offload_queue) && !ssl_offload_stopping)
+			pthread_cond_wait(&ssl_offload_cond, &ssl_offload_lock);
+
+		if (LIST_ISEMPTY(&ssl_offload_queue))
+			break;
+
+		for (nb = 0; nb < SSL_OFFLOAD_BATCH && !LIST_ISEMPTY(&ssl_offload_queue); nb++) {
+			batch[nb] = LIST_NEXT(&ssl_offload_queue, struct ssl_offload_op *, list);
+			LIST_DELETE(&batch[nb]->list);
+		}
+		pthread_mutex_unlock(&ssl_offload_lock);
+
+		for (i = 0; i < nb; i++)
+			ssl_offload_process(batch[i]);
+
+		for (i = 0; i < nb; i++) {
+			/* <op> may vanish as soon as it is marked done */
+			int fd = batch[i]->fd;
+			char c = 0;
+
+			HA_ATOMIC_STORE(&batch[i]->done, 1);
+			while (write(fd, &c, 1) < 0 && errno == EINTR)
+				;
+		}
+		pthread_mutex_lock(&ssl_offload_lock);
+	}
+	pthread_mutex_unlock(&ssl_offload_lock);
+	return NULL;
+}
+
+/* Releases the completion pipe of an async wait context */
+static void ssl_offload_fd_cleanup(ASYNC_WAIT_CTX *ctx, const void *key, OSSL_ASYNC_FD fd, void *custom)
+{
+	close(fd);
+	close((int)(long)custom);
+}
+
+/* Queues <op> for the crypto threads and pauses the current async job until
+ * it completes. The operation is directly run when called outside of an async
+ * job, or if no completion pipe may be set up. Returns the operation's result.
+ */
+static int ssl_offload_run(struct ssl_offload_op *op)
+{
+	ASYNC_JOB *job = ASYNC_get_current_job();
+	ASYNC_WAIT_CTX *waitctx;
+	OSSL_ASYNC_FD rfd;
+	void *custom;
+	char buf[16];
+
+	if (!job || !ssl_offload_nbthreads)
+		goto direct;
+
+	waitctx = ASYNC_get_wait_ctx(job);
+	if (!ASYNC_WAIT_CTX_get_fd(waitctx, ssl_offload_fd_key, &rfd, &custom)) {
+		int fds[2];
+
+		if (pipe(fds) < 0)
+			goto direct;
+		fcntl(fds[0], F_SETFL, O_NONBLOCK);
+		fcntl(fds[1], F_SETFL, O_NONBLOCK);
+		if (!ASYNC_WAIT_CTX_set_wait_fd(waitctx, ssl_offload_fd_key, fds[0],
+		                                (void *)(long)fds[1], ssl_offload_fd_cleanup)) {
+			close(fds[0]);
+			close(fds[1]);
+			goto direct;
+		}
+		rfd = fds[0];
+		custom = (void *)(long)fds[1];
+	}
+
+	op->fd = (int)(long)custom;
+	op->done = 0;
+
+	pthread_mutex_lock(&ssl_offload_lock);
+	LIST_APPEND(&ssl_offload_queue, &op->list);
+	pthread_cond_signal(&ssl_offload_cond);
+	pthread_mutex_unlock(&ssl_offload_lock);
+
+	/* the job may be resumed by other events on the connection */
+	do {
+		ASYNC_pause_job();
+	} while (!HA_ATOMIC_LOAD(&op->done));
+
+	while (read(rfd, buf, sizeof(buf)) > 0)
+		;
+	return op->ret;
+
+ direct:
+	ssl_offload_process(op);
+	return op->ret;
+}
+
+static int ssl_offload_rsa_priv_enc(int flen, const unsigned char *from, unsigned char *to, RSA *rsa, int padding)
+{
+	struct ssl_offload_op op = {
+		.type = SSL_OFFLOAD_RSA_PRIV_ENC,
+		.rsa = { .flen = flen, .from = from, .to = to, .rsa = rsa, .padding = padding },
+	};
+
+	return ssl_offload_run(&op);
+}
+
+static int ssl_offload_rsa_priv_dec(int flen, const unsigned char *from, unsigned char *to, RSA *rsa, int padding)
+{
+	struct ssl_offload_op op = {
+		.type = SSL_OFFLOAD_RSA_PRIV_DEC,
+		.rsa = { .flen = flen, .from = from, .to = to, .rsa = rsa, .padding = padding },
+	};
+
+	return ssl_offload_run(&op);
+}
+
+static int ssl_offload_ecdsa_sign(int type, const unsigned char *dgst, int dlen, unsigned char *sig,
+                                  unsigned int *siglen, const BIGNUM *kinv, const BIGNUM *r, EC_KEY *eckey)
+{
+	struct ssl_offload_op op = {
+		.type = SSL_OFFLOAD_ECDSA_SIGN,
+		.ec = { .type = type, .dgst = dgst, .dlen = dlen, .sig = sig, .siglen = siglen,
+		        .kinv = kinv, .r = r, .eckey = eckey },
+	};
+
+	return ssl_offload_run(&op);
+}
+
+/* Returns a new key equivalent to <pkey> whose private operations are
+ * offloaded to the crypto threads, or <pkey> itself if its type is not
+ * supported. The caller must free the returned key if it differs from <pkey>.
+ * NULL is returned on memory allocation failure.
+ */
+EVP_PKEY *ssl_offload_get_key(EVP_PKEY *pkey)
+{
+	EVP_PKEY *ret = NULL;
+	RSA *rsa;
+	EC_KEY *ec;
+
+	switch (EVP_PKEY_base_id(pkey)) {
+	case EVP_PKEY_RSA:
+		if (!ssl_offload_rsa_meth) {
+			ssl_offload_rsa_meth = RSA_meth_dup(RSA_PKCS1_OpenSSL());
+			if (!ssl_offload_rsa_meth ||
+			    !RSA_meth_set1_name(ssl_offload_rsa_meth, "haproxy offload") ||
+			    !RSA_meth_set_priv_enc(ssl_offload_rsa_meth, ssl_offload_rsa_priv_enc) ||
+			    !RSA_meth_set_priv_dec(ssl_offload_rsa_meth, ssl_offload_rsa_priv_dec))
+				return NULL;
+		}
+
+		rsa = RSAPrivateKey_dup(EVP_PKEY_get0_RSA(pkey));
+		if (!rsa)
+			return NULL;
+		if (!RSA_set_method(rsa, ssl_offload_rsa_meth) ||
+		    !(ret = EVP_PKEY_new()) || !EVP_PKEY_assign_RSA(ret, rsa)) {
+			EVP_PKEY_free(ret);
+			RSA_free(rsa);
+			return NULL;
+		}
+		return ret;
+
+	case EVP_PKEY_EC:
+		if (!ssl_offload_ec_meth) {
+			int (*sign_setup)(EC_KEY *, BN_CTX *, BIGNUM **, BIGNUM **);
+			ECDSA_SIG *(*sign_sig)(const unsigned char *, int, const BIGNUM *, const BIGNUM *, EC_KEY *);
+
+			ssl_offload_ec_meth = EC_KEY_METHOD_new(EC_KEY_OpenSSL());
+			if (!ssl_offload_ec_meth)
+				return NULL;
+			EC_KEY_METHOD_get_sign(EC_KEY_OpenSSL(), NULL, &sign_setup, &sign_sig);
+			EC_KEY_METHOD_set_sign(ssl_offload_ec_meth, ssl_offload_ecdsa_sign, sign_setup, sign_sig);
+		}
+
+		ec = EC_KEY_dup(EVP_PKEY_get0_EC_KEY(pkey));
+		if (!ec)
+			return NULL;
+		if (!EC_KEY_set_method(ec, ssl_offload_ec_meth) ||
+		    !(ret = EVP_PKEY_new()) || !EVP_PKEY_assign_EC_KEY(ret, ec)) {
+			EVP_PKEY_free(ret);
+			EC_KEY_free(ec);
+			return NULL;
+		}
+		return ret;
+
+	default:
+		return pkey;
+	}
+}
+
+/* Accounts for the completion pipe that each connection may hold, like the
+ * fds of the async engines. Returns 0 on success.
+ */
+static int ssl_offload_check(void)
+{
+	if (global_ssl.offload_threads)
+		global.ssl_used_async_engines += 2;
+	return ERR_NONE;
+}
+
+/* Starts the crypto threads from the first thread, once the process runs in
+ * its final state. Returns 0 on error, otherwise 1.
+ */
+static int ssl_offload_start_threads(void)
+{
+	int i, err;
+
+	if (tid != 0 || !global_ssl.offload_threads)
+		return 1;
+
+	ssl_offload_threads = calloc(global_ssl.offload_threads, sizeof(*ssl_offload_threads));
+	if (!ssl_offload_threads) {
+		ha_alert("SSL offload: out of memory.\n");
+		return 0;
+	}
+
+	for (i = 0; i < global_ssl.offload_threads; i++) {
+		err = pthread_create(&ssl_offload_threads[i], NULL, ssl_offload_thread, NULL);
+		if (err) {
+			ha_alert("SSL offload: unable to create crypto thread: %s.\n", strerror(err));
+			return 0;
+		}
+		HA_ATOMIC_INC(&ssl_offload_nbthreads);
+	}
+	return 1;
+}
+
+/* Stops the crypto threads and releases the methods */
+static void ssl_offload_deinit(void)
+{
+	int i;
+
+	pthread_mutex_lock(&ssl_offload_lock);
+	ssl_offload_stopping = 1;
+	pthread_cond_broadcast(&ssl_offload_cond);
+	pthread_mutex_unlock(&ssl_offload_lock);
+
+	for (i = 0; i < ssl_offload_nbthreads; i++)
+		pthread_join(ssl_offload_threads[i], NULL);
+	ha_free(&ssl_offload_threads);
+	ssl_offload_nbthreads = 0;
+
+	if (ssl_offload_rsa_meth)
+		RSA_meth_free(ssl_offload_rsa_meth);
+	if (ssl_offload_ec_meth)
+		EC_KEY_METHOD_free(ssl_offload_ec_meth);
+}
+
+REGISTER_POST_CHECK(ssl_offload_check);
+REGISTER_PER_THREAD_INIT(ssl_offload_start_threads);
+REGISTER_POST_DEINIT(ssl_offload_deinit);
+
+#endif /* HAVE_SSL_OFFLOAD */
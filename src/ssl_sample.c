@@ -91,6 +91,41 @@ static int smp_check_secure_memcmp(struct arg *args, struct sample_conv *conv,
 }
 #endif // HAVE_secure_memcmp()
 
+/* per-thread digest context reused by the digest converters, which saves an
+ * allocation and a release for each computed digest.
+ */
+static THREAD_LOCAL EVP_MD_CTX *smp_mdctx;
+
+/* Computes the <evp> digest of <len> bytes from <data> into <md>, whose size
+ * is passed in <md_len> and which is updated with the digest length. Returns
+ * non-zero on success, otherwise zero.
+ */
+static int smp_compute_digest(const EVP_MD *evp, const char *data, size_t len,
+                              unsigned char *md, unsigned int *md_len)
+{
+	if (unlikely(!smp_mdctx))
+		return 0;
+
+	return EVP_DigestInit_ex(smp_mdctx, evp, NULL) &&
+	       EVP_DigestUpdate(smp_mdctx, data, len) &&
+	       EVP_DigestFinal_ex(smp_mdctx, md, md_len);
+}
+
+static int alloc_smp_mdctx(void)
+{
+	smp_mdctx = EVP_MD_CTX_new();
+	return !!smp_mdctx;
+}
+
+static void free_smp_mdctx(void)
+{
+	EVP_MD_CTX_free(smp_mdctx);
+	smp_mdctx = NULL;
+}
+
+REGISTER_PER_THREAD_ALLOC(alloc_smp_mdctx);
+REGISTER_PER_THREAD_FREE(free_smp_mdctx);
+
 static int smp_check_sha2(struct arg *args, struct sample_conv *conv,
                           const char *file, int line, char **err)
 {
@@ -118,9 +153,8 @@ static int sample_conv_sha2(const struct arg *arg_p, struct sample *smp, void *p
 {
 	struct buffer *trash = get_trash_chunk();
 	int bits = 256;
-	EVP_MD_CTX *mdctx;
 	const EVP_MD *evp = NULL;
-	unsigned int digest_length = 0;
+	unsigned int digest_length = trash->size;
 	if (arg_p->data.sint)
 		bits = arg_p->data.sint;
 
@@ -141,16 +175,11 @@ static int sample_conv_sha2(const struct arg *arg_p, struct sample *smp, void *p
 		return 0;
 	}
 
-	mdctx = EVP_MD_CTX_new();
-	if (!mdctx)
+	if (!smp_compute_digest(evp, smp->data.u.str.area, smp->data.u.str.data,
+	                        (unsigned char*)trash->area, &digest_length))
 		return 0;
-	EVP_DigestInit_ex(mdctx, evp, NULL);
-	EVP_DigestUpdate(mdctx, smp->data.u.str.area, smp->data.u.str.data);
-	EVP_DigestFinal_ex(mdctx, (unsigned char*)trash->area, &digest_length);
 	trash->data = digest_length;
 
-	EVP_MD_CTX_free(mdctx);
-
 	smp->data.u.str = *trash;
 	smp->data.type = SMP_T_BIN;
 	smp->flags &= ~SMP_F_CONST;
@@ -359,16 +388,24 @@ static int sample_conv_aes_gcm_dec(const struct arg *arg_p, struct sample *smp,
 }
 #endif
 
+/* Resolves the digest name in <args[0]> once for all and replaces it with a
+ * pointer to the EVP_MD, so that the converters do not have to look it up for
+ * each call.
+ */
 static int check_crypto_digest(struct arg *args, struct sample_conv *conv,
 						  const char *file, int line, char **err)
 {
 	const EVP_MD *evp = EVP_get_digestbyname(args[0].data.str.area);
 
-	if (evp)
-		return 1;
+	if (!evp) {
+		memprintf(err, "algorithm must be a valid OpenSSL message digest name.");
+		return 0;
+	}
 
-	memprintf(err, "algorithm must be a valid OpenSSL message digest name.");
-	return 0;
+	chunk_destroy(&args[0].data.str);
+	args[0].type = ARGT_PTR;
+	args[0].data.ptr = (void *)evp;
+	return 1;
 }
 
 static int sample_conv_crypto_digest(const struct arg *args, struct sample *smp, void *private)
@@ -376,21 +413,11 @@ static int sample_conv_crypto_digest(const struct arg *args, struct sample *smp,
 	struct buffer *trash = get_trash_chunk();
 	unsigned char *md = (unsigned char*) trash->area;
 	unsigned int md_len = trash->size;
-	EVP_MD_CTX *ctx = EVP_MD_CTX_new();
-	const EVP_MD *evp = EVP_get_digestbyname(args[0].data.str.area);
+	const EVP_MD *evp = args[0].data.ptr;
 
-	if (!ctx)
+	if (!smp_compute_digest(evp, smp->data.u.str.area, smp->data.u.str.data, md, &md_len))
 		return 0;
 
-	if (!EVP_DigestInit_ex(ctx, evp, NULL) ||
-	    !EVP_DigestUpdate(ctx, smp->data.u.str.area, smp->data.u.str.data) ||
-	    !EVP_DigestFinal_ex(ctx, md, &md_len)) {
-		EVP_MD_CTX_free(ctx);
-		return 0;
-	}
-
-	EVP_MD_CTX_free(ctx);
-
 	trash->data = md_len;
 	smp->data.u.str = *trash;
 	smp->data.type = SMP_T_BIN;
@@ -436,7 +463,7 @@ static int sample_conv_crypto_hmac(const struct arg *args, struct sample *smp, v
 	struct buffer *trash = NULL, *key_trash = NULL;
 	unsigned char *md;
 	unsigned int md_len;
-	const EVP_MD *evp = EVP_get_digestbyname(args[0].data.str.area);
+	const EVP_MD *evp = args[0].data.ptr;
 	int dec_size;
 
 	smp_set_owner(&key, smp->px, smp->sess, smp->strm, smp->opt);
@@ -57,10 +57,12 @@
 #include <haproxy/freq_ctr.h>
 #include <haproxy/frontend.h>
 #include <haproxy/global.h>
+#include <haproxy/http_client.h>
 #include <haproxy/http_rules.h>
 #include <haproxy/log.h>
 #include <haproxy/openssl-compat.h>
 #include <haproxy/pattern-t.h>
+#include <haproxy/peers.h>
 #include <haproxy/proto_tcp.h>
 #include <haproxy/proxy.h>
 #include <haproxy/sample.h>
@@ -71,19 +73,41 @@
 #include <haproxy/shctx.h>
 #include <haproxy/ssl_ckch.h>
 #include <haproxy/ssl_crtlist.h>
+#include <haproxy/ssl_offload.h>
 #include <haproxy/ssl_sock.h>
 #include <haproxy/ssl_utils.h>
 #include <haproxy/stats.h>
 #include <haproxy/stconn.h>
+#include <haproxy/stick_table.h>
 #include <haproxy/stream-t.h>
 #include <haproxy/task.h>
 #include <haproxy/ticks.h>
 #include <haproxy/time.h>
 #include <haproxy/tools.h>
+#include <haproxy/usdt.h>
 #include <haproxy/vars.h>
 #include <haproxy/xxhash.h>
 #include <haproxy/istbuf.h>
 
+#ifdef HAVE_SSL_KTLS
+#include <linux/tls.h>
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+/* These BIO controls are internal to OpenSSL but are sent to the BIO by the
+ * record layer when SSL_OP_ENABLE_KTLS is set.
+ */
+#define HA_BIO_CTRL_SET_KTLS                   72
+#define HA_BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG  74
+#define HA_BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG     75
+#endif
+
 
 /* ***** READ THIS before adding code here! *****
  *
@@ -126,6 +150,10 @@ struct global_ssl global_ssl = {
 #endif
 	.hard_max_record = 0,
 	.default_dh_param = SSL_DEFAULT_DH_PARAM,
+	.ticket_keys_rotation = 3600,
+	.ocsp_update = 0,
+	.ocsp_update_min_delay = OCSP_UPDATE_MIN_DELAY,
+	.ocsp_update_max_delay = OCSP_UPDATE_MAX_DELAY,
 	.ctx_cache = DEFAULT_SSL_CTX_CACHE,
 	.capture_buffer_size = 0,
 	.extra_files = SSL_GF_ALL,
@@ -146,6 +174,8 @@ enum {
 	SSL_ST_SESS,
 	SSL_ST_REUSED_SESS,
 	SSL_ST_FAILED_HANDSHAKE,
+	SSL_ST_KTLS_SESS,
+	SSL_ST_KTLS_FALLBACK,
 
 	SSL_ST_STATS_COUNT /* must be the last member of the enum */
 };
@@ -157,12 +187,18 @@ static struct name_desc ssl_stats[] = {
 	                              .desc = "Total number of ssl sessions reused" },
 	[SSL_ST_FAILED_HANDSHAKE] = { .name = "ssl_failed_handshake",
 	                              .desc = "Total number of failed handshake" },
+	[SSL_ST_KTLS_SESS]        = { .name = "ssl_ktls_sess",
+	                              .desc = "Total number of ssl sessions with kernel TLS offload" },
+	[SSL_ST_KTLS_FALLBACK]    = { .name = "ssl_ktls_fallback",
+	                              .desc = "Total number of ssl sessions for which kernel TLS offload could not be used" },
 };
 
 static struct ssl_counters {
 	long long sess;
 	long long reused_sess;
 	long long failed_handshake;
+	long long ktls_sess;
+	long long ktls_fallback;
 } ssl_counters;
 
 static void ssl_fill_stats(void *data, struct field *stats)
@@ -172,6 +208,8 @@ static void ssl_fill_stats(void *data, struct field *stats)
 	stats[SSL_ST_SESS]             = mkf_u64(FN_COUNTER, counters->sess);
 	stats[SSL_ST_REUSED_SESS]      = mkf_u64(FN_COUNTER, counters->reused_sess);
 	stats[SSL_ST_FAILED_HANDSHAKE] = mkf_u64(FN_COUNTER, counters->failed_handshake);
+	stats[SSL_ST_KTLS_SESS]        = mkf_u64(FN_COUNTER, counters->ktls_sess);
+	stats[SSL_ST_KTLS_FALLBACK]    = mkf_u64(FN_COUNTER, counters->ktls_fallback);
 }
 
 static struct stats_module ssl_stats_module = {
@@ -204,6 +242,107 @@ struct show_keys_ctx {
 struct task *ssl_sock_io_cb(struct task *, void *, unsigned int);
 static int ssl_sock_handshake(struct connection *conn, unsigned int flag);
 
+#ifdef HAVE_SSL_KTLS
+/* Sends the <num> bytes from <buf> as a single record of type
+ * <ctx->ktls_rec_type> over the kTLS socket of <ctx>. Such records (alerts,
+ * handshake messages) must be tagged using a control message, they cannot be
+ * sent through the regular transport layer. Returns the number of bytes sent,
+ * or -1 on error, possibly with the BIO retry flag set.
+ */
+static int ha_ssl_ktls_send_ctrl_msg(BIO *h, struct ssl_sock_ctx *ctx, const char *buf, int num)
+{
+	char cbuf[CMSG_SPACE(sizeof(unsigned char))];
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	int ret;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_TLS;
+	cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+	*((unsigned char *)CMSG_DATA(cmsg)) = ctx->ktls_rec_type;
+	iov.iov_base = (void *)buf;
+	iov.iov_len = num;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	do {
+		ret = sendmsg(ctx->conn->handle.fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret >= 0)
+		return num;
+
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOTCONN) {
+		fd_cant_send(ctx->conn->handle.fd);
+		BIO_set_retry_write(h);
+	}
+	else {
+		BIO_clear_retry_flags(h);
+		ctx->conn->flags |= CO_FL_ERROR | CO_FL_SOCK_RD_SH | CO_FL_SOCK_WR_SH;
+	}
+	return -1;
+}
+
+/* Hands the TLS transmission keys provided by OpenSSL in <crypto_info> to the
+ * kernel for <ctx>'s socket. Only the transmission side is offloaded, the
+ * reception would require the BIO to rebuild the records headers. Returns 1
+ * on success, 0 if the kernel refused the offload, in which case OpenSSL keeps
+ * encrypting the records itself.
+ */
+static int ha_ssl_ktls_start(struct ssl_sock_ctx *ctx, long is_tx, const struct tls_crypto_info *crypto_info)
+{
+	struct connection *conn = ctx->conn;
+	socklen_t len;
+
+	if (!is_tx || (conn->flags & (CO_FL_FDLESS | CO_FL_SSL_KTLS_TX)) ||
+	    !conn_ctrl_ready(conn) || ctx->xprt != xprt_get(XPRT_RAW))
+		return 0;
+
+	switch (crypto_info->cipher_type) {
+#ifdef TLS_CIPHER_AES_GCM_128
+	case TLS_CIPHER_AES_GCM_128:
+		len = sizeof(struct tls12_crypto_info_aes_gcm_128);
+		break;
+#endif
+#ifdef TLS_CIPHER_AES_GCM_256
+	case TLS_CIPHER_AES_GCM_256:
+		len = sizeof(struct tls12_crypto_info_aes_gcm_256);
+		break;
+#endif
+#ifdef TLS_CIPHER_AES_CCM_128
+	case TLS_CIPHER_AES_CCM_128:
+		len = sizeof(struct tls12_crypto_info_aes_ccm_128);
+		break;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	case TLS_CIPHER_CHACHA20_POLY1305:
+		len = sizeof(struct tls12_crypto_info_chacha20_poly1305);
+		break;
+#endif
+	default:
+		return 0;
+	}
+
+	/* the upper layer protocol may already be installed if the keys are
+	 * renewed, in which case the second call fails with EEXIST.
+	 */
+	if (setsockopt(conn->handle.fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0 &&
+	    errno != EEXIST)
+		return 0;
+
+	if (setsockopt(conn->handle.fd, SOL_TLS, TLS_TX, crypto_info, len) < 0)
+		return 0;
+
+	conn->flags |= CO_FL_SSL_KTLS_TX;
+	return 1;
+}
+#endif /* HAVE_SSL_KTLS */
+
 /* Methods to implement OpenSSL BIO */
 static int ha_ssl_write(BIO *h, const char *buf, int num)
 {
@@ -212,6 +351,10 @@ static int ha_ssl_write(BIO *h, const char *buf, int num)
 	int ret;
 
 	ctx = BIO_get_data(h);
+#ifdef HAVE_SSL_KTLS
+	if (ctx->ktls_rec_type)
+		return ha_ssl_ktls_send_ctrl_msg(h, ctx, buf, num);
+#endif
 	tmpbuf.size = num;
 	tmpbuf.area = (void *)(uintptr_t)buf;
 	tmpbuf.data = num;
@@ -260,12 +403,29 @@ static int ha_ssl_read(BIO *h, char *buf, int size)
 
 static long ha_ssl_ctrl(BIO *h, int cmd, long arg1, void *arg2)
 {
+#ifdef HAVE_SSL_KTLS
+	struct ssl_sock_ctx *ctx = BIO_get_data(h);
+#endif
 	int ret = 0;
 	switch (cmd) {
 	case BIO_CTRL_DUP:
 	case BIO_CTRL_FLUSH:
 		ret = 1;
 		break;
+#ifdef HAVE_SSL_KTLS
+	case HA_BIO_CTRL_SET_KTLS:
+		ret = ha_ssl_ktls_start(ctx, arg1, arg2);
+		break;
+	case BIO_CTRL_GET_KTLS_SEND:
+		ret = !!(ctx->conn->flags & CO_FL_SSL_KTLS_TX);
+		break;
+	case HA_BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG:
+		ctx->ktls_rec_type = arg1;
+		break;
+	case HA_BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG:
+		ctx->ktls_rec_type = 0;
+		break;
+#endif
 	}
 	return ret;
 }
@@ -538,6 +698,7 @@ const char *SSL_SOCK_KEYTYPE_NAMES[] = {
 };
 
 static struct shared_context *ssl_shctx = NULL; /* ssl shared session cache */
+static struct stktable *ssl_sess_table = NULL; /* stick-table replicating the session cache */
 static struct eb_root *sh_ssl_sess_tree; /* ssl shared session tree */
 
 /* Dedicated callback functions for heartbeat and clienthello.
@@ -953,9 +1114,13 @@ struct certificate_ocsp {
 	struct ebmb_node key;
 	unsigned char key_data[OCSP_MAX_CERTID_ASN1_LENGTH];
 	unsigned int key_length;
-	struct buffer response;
+	struct buffer response;       /* protected by <lock>, only swapped */
 	int refcount;
-	long expire;
+	long expire;                  /* protected by <lock> */
+	__decl_thread(HA_RWLOCK_T lock);
+	char *uri;                    /* OCSP responder URI when auto-updated */
+	struct eb64_node next_update; /* date of the next update, in ocsp_update_tree */
+	unsigned int update_failures; /* consecutive failed updates */
 };
 
 struct ocsp_cbk_arg {
@@ -974,6 +1139,8 @@ struct ocsp_cbk_arg {
 };
 
 static struct eb_root cert_ocsp_tree = EB_ROOT_UNIQUE;
+/* protects the certificate_ocsp trees at run time */
+__decl_thread(static HA_SPINLOCK_T ocsp_tree_lock);
 
 /* This function starts to check if the OCSP response (in DER format) contained
  * in chunk 'ocsp_response' is valid (else exits on error).
@@ -1003,6 +1170,10 @@ static int ssl_sock_load_ocsp_response(struct buffer *ocsp_response,
 	unsigned char *p = (unsigned char *) ocsp_response->area;
 	int rc , count_sr;
 	ASN1_GENERALIZEDTIME *revtime, *thisupd, *nextupd = NULL;
+	struct buffer new_resp = BUF_NULL;
+	struct buffer old_resp;
+	long expire;
+	int locked = 0;
 	int reason;
 	int ret = 1;
 #ifdef HAVE_ASN1_TIME_TO_TM
@@ -1084,6 +1255,10 @@ static int ssl_sock_load_ocsp_response(struct buffer *ocsp_response,
 		p = key;
 		memset(key, 0, OCSP_MAX_CERTID_ASN1_LENGTH);
 		i2d_OCSP_CERTID(id, &p);
+
+		/* the entry must not vanish before its response is swapped */
+		HA_SPIN_LOCK(OCSP_LOCK, &ocsp_tree_lock);
+		locked = 1;
 		ocsp = (struct certificate_ocsp *)ebmb_lookup(&cert_ocsp_tree, key, OCSP_MAX_CERTID_ASN1_LENGTH);
 		if (!ocsp) {
 			memprintf(err, "OCSP single response: Certificate ID does not match any certificate or issuer");
@@ -1091,29 +1266,41 @@ static int ssl_sock_load_ocsp_response(struct buffer *ocsp_response,
 		}
 	}
 
-	/* According to comments on "chunk_dup", the
-	   previous chunk buffer will be freed */
-	if (!chunk_dup(&ocsp->response, ocsp_response)) {
-		memprintf(err, "OCSP response: Memory allocation error");
-		goto out;
-	}
-
 #ifdef HAVE_ASN1_TIME_TO_TM
 	if (ASN1_TIME_to_tm(nextupd, &nextupd_tm) == 0) {
 		memprintf(err, "OCSP single response: Invalid \"Next Update\" time");
 		goto out;
 	}
-	ocsp->expire = my_timegm(&nextupd_tm) - OCSP_MAX_RESPONSE_TIME_SKEW;
+	expire = my_timegm(&nextupd_tm) - OCSP_MAX_RESPONSE_TIME_SKEW;
 #else
-	ocsp->expire = asn1_generalizedtime_to_epoch(nextupd) - OCSP_MAX_RESPONSE_TIME_SKEW;
-	if (ocsp->expire < 0) {
+	expire = asn1_generalizedtime_to_epoch(nextupd) - OCSP_MAX_RESPONSE_TIME_SKEW;
+	if (expire < 0) {
 		memprintf(err, "OCSP single response: Invalid \"Next Update\" time");
 		goto out;
 	}
 #endif
 
+	if (!chunk_dup(&new_resp, ocsp_response)) {
+		memprintf(err, "OCSP response: Memory allocation error");
+		goto out;
+	}
+
+	/* the new response was entirely prepared aside, handshakes only have
+	 * to wait for the buffers to be exchanged, and the old one is released
+	 * once nobody may use it anymore.
+	 */
+	HA_RWLOCK_WRLOCK(OCSP_LOCK, &ocsp->lock);
+	old_resp = ocsp->response;
+	ocsp->response = new_resp;
+	ocsp->expire = expire;
+	HA_RWLOCK_WRUNLOCK(OCSP_LOCK, &ocsp->lock);
+	chunk_destroy(&old_resp);
+
 	ret = 0;
 out:
+	if (locked)
+		HA_SPIN_UNLOCK(OCSP_LOCK, &ocsp_tree_lock);
+
 	ERR_clear_error();
 
 	if (bs)
@@ -1310,16 +1497,189 @@ int ssl_sock_update_tlskey(char *filename, struct buffer *tlskey, char **err)
 	return 0;
 }
 
+/* Rebuilds the ring of ticket keys of <ref> from its stick-table. The most
+ * recent keys, ordered by creation date then by value so that all the nodes
+ * agree, fill the ring with the newest one last. As for the keys loaded from
+ * a file, the penultimate one is used for encryption, which leaves the time
+ * to the newest one to reach all the peers before being used. Returns the
+ * creation date of the newest key, or 0 if the table is empty.
+ */
+static unsigned int tlskeys_table_load(struct tls_keys_ref *ref)
+{
+	struct stktable *t = ref->table;
+	union tls_sess_key keys[TLS_TICKETS_NO];
+	unsigned int dates[TLS_TICKETS_NO];
+	size_t len = t->key_size;
+	struct stksess *ts;
+	struct ebmb_node *eb;
+	int shard, nb = 0, i;
+
+	for (shard = 0; shard < t->nb_shards; shard++) {
+		HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &t->shards[shard].lock);
+		for (eb = ebmb_first(&t->shards[shard].keys); eb; eb = ebmb_next(eb)) {
+			unsigned int d;
+			void *ptr;
+
+			ts = ebmb_entry(eb, struct stksess, key);
+			ptr = __stktable_data_ptr(t, ts, STKTABLE_DT_GPT0);
+			HA_RWLOCK_RDLOCK(STK_SESS_LOCK, &ts->lock);
+			d = stktable_data_cast(ptr, std_t_uint);
+			HA_RWLOCK_RDUNLOCK(STK_SESS_LOCK, &ts->lock);
+
+			/* insertion sort of the TLS_TICKETS_NO newest keys */
+			for (i = nb; i > 0; i--) {
+				if (dates[i - 1] < d ||
+				    (dates[i - 1] == d && memcmp(keys[i - 1].name, ts->key.key, len) < 0))
+					break;
+			}
+
+			if (nb == TLS_TICKETS_NO) {
+				if (!i)
+					continue;
+				/* drop the oldest one */
+				memmove(keys, keys + 1, (i - 1) * sizeof(*keys));
+				memmove(dates, dates + 1, (i - 1) * sizeof(*dates));
+				i--;
+			}
+			else {
+				memmove(keys + i + 1, keys + i, (nb - i) * sizeof(*keys));
+				memmove(dates + i + 1, dates + i, (nb - i) * sizeof(*dates));
+				nb++;
+			}
+			memcpy(keys[i].name, ts->key.key, len);
+			dates[i] = d;
+		}
+		HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &t->shards[shard].lock);
+	}
+
+	if (!nb)
+		return 0;
+
+	/* the missing keys are replaced by copies of the newest one */
+	for (i = nb; i < TLS_TICKETS_NO; i++)
+		keys[i] = keys[nb - 1];
+
+	i = nb < 2 ? 0 : nb - 2;
+	HA_RWLOCK_WRLOCK(TLSKEYS_REF_LOCK, &ref->lock);
+	if (ref->tls_ticket_enc_index != i || memcmp(ref->tlskeys, keys, sizeof(keys)) != 0) {
+		memcpy(ref->tlskeys, keys, sizeof(keys));
+		ref->tls_ticket_enc_index = i;
+	}
+	HA_RWLOCK_WRUNLOCK(TLSKEYS_REF_LOCK, &ref->lock);
+
+	return dates[nb - 1];
+}
+
+/* Generates a new ticket key for <ref> and inserts it into its stick-table
+ * with the current date, from where it will be pushed to the peers. Returns
+ * 0 on success or -1 on failure.
+ */
+static int tlskeys_table_add(struct tls_keys_ref *ref)
+{
+	struct stktable *t = ref->table;
+	union tls_sess_key key;
+	struct stktable_key skey;
+	struct stksess *ts;
+	void *ptr;
+
+	if (RAND_bytes(key.name, t->key_size) != 1)
+		return -1;
+
+	skey.key = key.name;
+	skey.key_len = t->key_size;
+	ts = stktable_get_entry(t, &skey);
+	if (!ts)
+		return -1;
+
+	HA_RWLOCK_WRLOCK(STK_SESS_LOCK, &ts->lock);
+	ptr = __stktable_data_ptr(t, ts, STKTABLE_DT_GPT0);
+	stktable_data_cast(ptr, std_t_uint) = date.tv_sec;
+	HA_RWLOCK_WRUNLOCK(STK_SESS_LOCK, &ts->lock);
+	stktable_touch_local(t, ts, 1);
+	return 0;
+}
+
+/* Task loading the ticket keys shared through the stick-table of the
+ * tls_keys_ref <context> once per second. A new key is generated once the
+ * newest one is older than the rotation period, or if there is none. The
+ * generation is delayed until the table was synchronized with the peers, so
+ * that a restarting node does not rotate the keys of the whole cluster.
+ */
+static struct task *tlskeys_table_task(struct task *task, void *context, unsigned int state)
+{
+	struct tls_keys_ref *ref = context;
+	struct peers *peers = ref->table->peers.p;
+	unsigned int newest;
+
+	newest = tlskeys_table_load(ref);
+	if ((!peers || peers_resync_done(peers)) &&
+	    (!newest || (unsigned int)date.tv_sec - newest >= global_ssl.ticket_keys_rotation)) {
+		if (tlskeys_table_add(ref) == 0)
+			tlskeys_table_load(ref);
+	}
+
+	task->expire = tick_add(now_ms, MS_TO_TICKS(1000));
+	return task;
+}
+
+/* Resolves the stick-table of tls_keys_ref <ref>, fills its ring with local
+ * random keys until the shared ones are known, and starts its rotation task.
+ * Returns 0 on success otherwise ERR_*.
+ */
+static int tlskeys_table_init(struct tls_keys_ref *ref)
+{
+	struct stktable *t;
+	int i;
+
+	t = stktable_find_by_name(ref->table_name);
+	if (!t) {
+		ha_alert("TLS ticket keys: stick-table '%s' not found.\n", ref->table_name);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	if (t->type != SMP_T_BIN ||
+	    (t->key_size != sizeof(struct tls_sess_key_128) && t->key_size != sizeof(struct tls_sess_key_256)) ||
+	    !t->data_ofs[STKTABLE_DT_GPT0]) {
+		ha_alert("TLS ticket keys: stick-table '%s' must be of type 'binary' with a length of %d or %d and store 'gpt0'.\n",
+		         ref->table_name, (int)sizeof(struct tls_sess_key_128), (int)sizeof(struct tls_sess_key_256));
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	ref->table = t;
+	ref->key_size_bits = t->key_size == sizeof(struct tls_sess_key_128) ? 128 : 256;
+	for (i = 0; i < TLS_TICKETS_NO; i++) {
+		if (RAND_bytes(ref->tlskeys[i].name, t->key_size) != 1) {
+			ha_alert("TLS ticket keys: unable to generate random keys.\n");
+			return ERR_ALERT | ERR_FATAL;
+		}
+	}
+
+	ref->task = task_new_anywhere();
+	if (!ref->task) {
+		ha_alert("TLS ticket keys: out of memory.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+	ref->task->process = tlskeys_table_task;
+	ref->task->context = ref;
+	task_wakeup(ref->task, TASK_WOKEN_INIT);
+	return ERR_NONE;
+}
+
 /* This function finalize the configuration parsing. Its set all the
  * automatic ids. It's called just after the basic checks. It returns
  * 0 on success otherwise ERR_*.
  */
 static int tlskeys_finalize_config(void)
 {
-	int i = 0;
+	int i = 0, err;
 	struct tls_keys_ref *ref, *ref2, *ref3;
 	struct list tkr = LIST_HEAD_INIT(tkr);
 
+	list_for_each_entry(ref, &tlskeys_reference, list) {
+		if (ref->table_name && (err = tlskeys_table_init(ref)) != ERR_NONE)
+			return err;
+	}
+
 	list_for_each_entry(ref, &tlskeys_reference, list) {
 		if (ref->unique_id == -1) {
 			/* Look for the first free id. */
@@ -1419,20 +1779,31 @@ int ssl_sock_ocsp_stapling_cbk(SSL *ssl, void *arg)
 
 	}
 
-	if (!ocsp ||
-	    !ocsp->response.area ||
+	if (!ocsp)
+		return SSL_TLSEXT_ERR_NOACK;
+
+	/* the response may be replaced at any time by an update, which only
+	 * holds the write lock for the time needed to swap the buffers.
+	 */
+	HA_RWLOCK_RDLOCK(OCSP_LOCK, &ocsp->lock);
+	if (!ocsp->response.area ||
 	    !ocsp->response.data ||
 	    (ocsp->expire < now.tv_sec))
-		return SSL_TLSEXT_ERR_NOACK;
+		goto noack;
 
 	ssl_buf = OPENSSL_malloc(ocsp->response.data);
 	if (!ssl_buf)
-		return SSL_TLSEXT_ERR_NOACK;
+		goto noack;
 
 	memcpy(ssl_buf, ocsp->response.area, ocsp->response.data);
 	SSL_set_tlsext_status_ocsp_resp(ssl, (unsigned char*)ssl_buf, ocsp->response.data);
+	HA_RWLOCK_RDUNLOCK(OCSP_LOCK, &ocsp->lock);
 
 	return SSL_TLSEXT_ERR_OK;
+
+ noack:
+	HA_RWLOCK_RDUNLOCK(OCSP_LOCK, &ocsp->lock);
+	return SSL_TLSEXT_ERR_NOACK;
 }
 
 #endif
@@ -1440,9 +1811,23 @@ int ssl_sock_ocsp_stapling_cbk(SSL *ssl, void *arg)
 #if ((defined SSL_CTRL_SET_TLSEXT_STATUS_REQ_CB && !defined OPENSSL_NO_OCSP) && !defined OPENSSL_IS_BORINGSSL)
 
 
+/* entries to update automatically, ordered by date of next update */
+static struct eb_root ocsp_update_tree = EB_ROOT;
+static struct task *ocsp_update_task = NULL;
+
+/* an OCSP response being fetched by the automatic update */
+struct ocsp_update_slot {
+	struct httpclient *hc;        /* NULL when the slot is free */
+	struct buffer *rsp;           /* response body received so far */
+	unsigned char key[OCSP_MAX_CERTID_ASN1_LENGTH]; /* entry being updated */
+	unsigned int key_length;
+};
+
+static struct ocsp_update_slot ocsp_update_slots[OCSP_UPDATE_MAX_INFLIGHT];
+
 /*
  * Decrease the refcount of the struct ocsp_response and frees it if it's not
- * used anymore. Also removes it from the tree if free'd.
+ * used anymore. Also removes it from the trees if free'd.
  */
 static void ssl_sock_free_ocsp(struct certificate_ocsp *ocsp)
 {
@@ -1451,12 +1836,270 @@ static void ssl_sock_free_ocsp(struct certificate_ocsp *ocsp)
 
 	ocsp->refcount--;
 	if (ocsp->refcount <= 0) {
+		HA_SPIN_LOCK(OCSP_LOCK, &ocsp_tree_lock);
 		ebmb_delete(&ocsp->key);
+		eb64_delete(&ocsp->next_update);
+		HA_SPIN_UNLOCK(OCSP_LOCK, &ocsp_tree_lock);
 		chunk_destroy(&ocsp->response);
+		free(ocsp->uri);
 		free(ocsp);
 	}
 }
 
+/* Returns a copy of the first OCSP responder URI found in the Authority
+ * Information Access extension of <cert>, or NULL if there is none.
+ */
+static char *ssl_ocsp_get_uri(X509 *cert)
+{
+	STACK_OF(OPENSSL_STRING) *uris;
+	char *uri = NULL;
+
+	uris = X509_get1_ocsp(cert);
+	if (uris && sk_OPENSSL_STRING_num(uris) > 0)
+		uri = strdup(sk_OPENSSL_STRING_value(uris, 0));
+	X509_email_free(uris);
+	return uri;
+}
+
+/* Queues <ocsp> into the update tree unless it is already there or is not
+ * auto-updated. The next update happens after half of the remaining validity
+ * of the current response, bounded by the configured min and max delays, or
+ * after the min delay following a failure. Up to 1/8 of this delay is randomly
+ * removed so that certificates loaded together do not keep being refreshed
+ * together. When <loading> is set and the entry has no valid response yet, it
+ * is updated immediately. Must be called with ocsp_tree_lock held.
+ */
+static void ssl_ocsp_update_schedule(struct certificate_ocsp *ocsp, int loading, int failed)
+{
+	long delay;
+
+	if (!ocsp->uri || ocsp->next_update.node.leaf_p)
+		return;
+
+	HA_RWLOCK_RDLOCK(OCSP_LOCK, &ocsp->lock);
+	if (failed)
+		delay = global_ssl.ocsp_update_min_delay;
+	else if (!ocsp->response.data || ocsp->expire <= now.tv_sec)
+		delay = loading ? 0 : global_ssl.ocsp_update_min_delay;
+	else
+		delay = (ocsp->expire - now.tv_sec) / 2;
+	HA_RWLOCK_RDUNLOCK(OCSP_LOCK, &ocsp->lock);
+
+	if (delay) {
+		if (delay < global_ssl.ocsp_update_min_delay)
+			delay = global_ssl.ocsp_update_min_delay;
+		if (delay > global_ssl.ocsp_update_max_delay)
+			delay = global_ssl.ocsp_update_max_delay;
+		delay -= statistical_prng_range(delay / 8 + 1);
+	}
+
+	ocsp->next_update.key = now.tv_sec + delay;
+	eb64_insert(&ocsp_update_tree, &ocsp->next_update);
+
+	if (ocsp_update_task)
+		task_wakeup(ocsp_update_task, TASK_WOKEN_MSG);
+}
+
+/* httpclient callback, the update task collects the response */
+static void ssl_ocsp_update_hc_cb(struct httpclient *hc)
+{
+	task_wakeup(ocsp_update_task, TASK_WOKEN_MSG);
+}
+
+/* Starts fetching from responder <uri> the response of the entry whose key is
+ * in <slot>. Returns 1 on success, otherwise 0 and the slot is left free.
+ */
+static int ssl_ocsp_update_start(struct ocsp_update_slot *slot, const char *uri)
+{
+	struct http_hdr hdrs[] = {
+		{ .n = IST("Content-Type"), .v = IST("application/ocsp-request") },
+		{ .n = IST("Content-Length"), .v = IST_NULL },
+		{ .n = IST_NULL, .v = IST_NULL }
+	};
+	const unsigned char *p = slot->key;
+	OCSP_REQUEST *req = NULL;
+	OCSP_CERTID *cid;
+	unsigned char *der = NULL;
+	int der_len;
+	int ret = 0;
+
+	cid = d2i_OCSP_CERTID(NULL, &p, slot->key_length);
+	if (!cid)
+		goto out;
+
+	req = OCSP_REQUEST_new();
+	if (!req || !OCSP_request_add0_id(req, cid)) {
+		OCSP_CERTID_free(cid);
+		goto out;
+	}
+
+	der_len = i2d_OCSP_REQUEST(req, &der);
+	if (der_len <= 0)
+		goto out;
+
+	/* many responders do not support chunked requests */
+	hdrs[1].v = ist(ultoa(der_len));
+
+	slot->rsp = alloc_trash_chunk();
+	slot->hc = httpclient_new(slot, HTTP_METH_POST, ist(uri));
+	if (!slot->rsp || !slot->hc)
+		goto out;
+
+	slot->hc->ops.res_payload = ssl_ocsp_update_hc_cb;
+	slot->hc->ops.res_end = ssl_ocsp_update_hc_cb;
+	httpclient_set_timeout(slot->hc, OCSP_UPDATE_TIMEOUT);
+
+	if (httpclient_req_gen(slot->hc, slot->hc->req.url, HTTP_METH_POST, hdrs, ist2(der, der_len)) != ERR_NONE)
+		goto out;
+
+	if (!httpclient_start(slot->hc))
+		goto out;
+
+	ret = 1;
+ out:
+	if (!ret) {
+		httpclient_destroy(slot->hc);
+		slot->hc = NULL;
+		if (slot->rsp)
+			free_trash_chunk(slot->rsp);
+		slot->rsp = NULL;
+	}
+	OPENSSL_free(der);
+	OCSP_REQUEST_free(req);
+	ERR_clear_error();
+	return ret;
+}
+
+/* Applies the response received in <slot> unless <failed> is set or it is not
+ * valid, schedules the next update of the entry and releases the slot.
+ */
+static void ssl_ocsp_update_finish(struct ocsp_update_slot *slot, int failed)
+{
+	struct certificate_ocsp *ocsp;
+	const unsigned char *p = slot->key;
+	OCSP_CERTID *cid = NULL;
+	char *err = NULL;
+
+	if (!failed && slot->hc && slot->hc->res.status == 200 && b_data(slot->rsp)) {
+		cid = d2i_OCSP_CERTID(NULL, &p, slot->key_length);
+		failed = !cid || ssl_sock_load_ocsp_response(slot->rsp, NULL, cid, &err);
+	}
+	else
+		failed = 1;
+
+	HA_SPIN_LOCK(OCSP_LOCK, &ocsp_tree_lock);
+	ocsp = (struct certificate_ocsp *)ebmb_lookup(&cert_ocsp_tree, slot->key, OCSP_MAX_CERTID_ASN1_LENGTH);
+	if (ocsp) {
+		ocsp->update_failures = failed ? ocsp->update_failures + 1 : 0;
+		ssl_ocsp_update_schedule(ocsp, 0, failed);
+	}
+	HA_SPIN_UNLOCK(OCSP_LOCK, &ocsp_tree_lock);
+
+	if (slot->hc)
+		httpclient_stop_and_destroy(slot->hc);
+	slot->hc = NULL;
+	if (slot->rsp)
+		free_trash_chunk(slot->rsp);
+	slot->rsp = NULL;
+	if (cid)
+		OCSP_CERTID_free(cid);
+	free(err);
+}
+
+/* Task in charge of the automatic update of the OCSP responses. It collects
+ * the responses received, then starts fetching those which are due, up to
+ * OCSP_UPDATE_MAX_INFLIGHT at once. Traffic is never blocked: the responses
+ * are parsed and validated here, and only the final buffer swap is performed
+ * under the entry's lock.
+ */
+static struct task *ssl_ocsp_update_process(struct task *task, void *context, unsigned int state)
+{
+	struct certificate_ocsp *ocsp;
+	struct ocsp_update_slot *slot;
+	struct eb64_node *node;
+	int free_slots = 0;
+	char *uri;
+	int i;
+
+	for (i = 0; i < OCSP_UPDATE_MAX_INFLIGHT; i++) {
+		slot = &ocsp_update_slots[i];
+		if (!slot->hc)
+			continue;
+
+		if (httpclient_data(slot->hc))
+			httpclient_res_xfer(slot->hc, slot->rsp);
+
+		if (httpclient_data(slot->hc) && !b_room(slot->rsp)) {
+			/* larger than a buffer, cannot be an OCSP response */
+			ssl_ocsp_update_finish(slot, 1);
+		}
+		else if (httpclient_ended(slot->hc) && !httpclient_data(slot->hc))
+			ssl_ocsp_update_finish(slot, 0);
+	}
+
+	for (i = 0; i < OCSP_UPDATE_MAX_INFLIGHT; i++) {
+		slot = &ocsp_update_slots[i];
+		if (slot->hc)
+			continue;
+
+		HA_SPIN_LOCK(OCSP_LOCK, &ocsp_tree_lock);
+		node = eb64_first(&ocsp_update_tree);
+		if (!node || node->key > now.tv_sec) {
+			HA_SPIN_UNLOCK(OCSP_LOCK, &ocsp_tree_lock);
+			free_slots++;
+			continue;
+		}
+		eb64_delete(node);
+		ocsp = eb64_entry(node, struct certificate_ocsp, next_update);
+		memcpy(slot->key, ocsp->key_data, sizeof(slot->key));
+		slot->key_length = ocsp->key_length;
+		uri = strdup(ocsp->uri);
+		HA_SPIN_UNLOCK(OCSP_LOCK, &ocsp_tree_lock);
+
+		if (!uri || !ssl_ocsp_update_start(slot, uri)) {
+			ssl_ocsp_update_finish(slot, 1);
+			free_slots++;
+		}
+		free(uri);
+	}
+
+	/* when all slots are busy, the end of a fetch will wake us up */
+	task->expire = TICK_ETERNITY;
+	if (free_slots) {
+		HA_SPIN_LOCK(OCSP_LOCK, &ocsp_tree_lock);
+		node = eb64_first(&ocsp_update_tree);
+		if (node)
+			task->expire = tick_add(now_ms, node->key > now.tv_sec ?
+			                        MS_TO_TICKS((node->key - now.tv_sec) * 1000) : 0);
+		HA_SPIN_UNLOCK(OCSP_LOCK, &ocsp_tree_lock);
+	}
+	return task;
+}
+
+/* creates the OCSP update task once the configuration is loaded */
+static int ssl_ocsp_update_init(void)
+{
+	if (!global_ssl.ocsp_update)
+		return ERR_NONE;
+
+	if (global_ssl.ocsp_update_min_delay > global_ssl.ocsp_update_max_delay) {
+		ha_alert("tune.ssl.ocsp-update.mindelay cannot be larger than tune.ssl.ocsp-update.maxdelay.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	ocsp_update_task = task_new_here();
+	if (!ocsp_update_task) {
+		ha_alert("Failed to allocate the OCSP update task.\n");
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	ocsp_update_task->process = ssl_ocsp_update_process;
+	task_wakeup(ocsp_update_task, TASK_WOKEN_INIT);
+	return ERR_NONE;
+}
+
+REGISTER_POST_CHECK(ssl_ocsp_update_init);
+
 
 /*
  * This function enables the handling of OCSP status extension on 'ctx' if a
@@ -1479,6 +2122,7 @@ static int ssl_sock_load_ocsp(SSL_CTX *ctx, const struct ckch_data *data, STACK_
 	int i, ret = -1;
 	struct certificate_ocsp *ocsp = NULL, *iocsp;
 	char *warn = NULL;
+	char *uri = NULL;
 	unsigned char *p;
 #ifndef USE_OPENSSL_WOLFSSL
 	void (*callback) (void);
@@ -1491,6 +2135,14 @@ static int ssl_sock_load_ocsp(SSL_CTX *ctx, const struct ckch_data *data, STACK_
 	if (!x)
 		goto out;
 
+	if (global_ssl.ocsp_update) {
+		uri = ssl_ocsp_get_uri(x);
+		if (!uri && !data->ocsp_response) {
+			ret = 1;
+			goto out;
+		}
+	}
+
 	issuer = data->ocsp_issuer;
 	/* take issuer from chain over ocsp_issuer, is what is done historicaly */
 	if (chain) {
@@ -1503,8 +2155,12 @@ static int ssl_sock_load_ocsp(SSL_CTX *ctx, const struct ckch_data *data, STACK_
 			}
 		}
 	}
-	if (!issuer)
+	if (!issuer) {
+		/* not an error when only here for the automatic update */
+		if (!data->ocsp_response)
+			ret = 1;
 		goto out;
+	}
 
 	cid = OCSP_cert_to_id(0, x, issuer);
 	if (!cid)
@@ -1521,7 +2177,10 @@ static int ssl_sock_load_ocsp(SSL_CTX *ctx, const struct ckch_data *data, STACK_
 	p = ocsp->key_data;
 	ocsp->key_length = i2d_OCSP_CERTID(cid, &p);
 
+	HA_RWLOCK_INIT(&ocsp->lock);
+	HA_SPIN_LOCK(OCSP_LOCK, &ocsp_tree_lock);
 	iocsp = (struct certificate_ocsp *)ebmb_insert(&cert_ocsp_tree, &ocsp->key, OCSP_MAX_CERTID_ASN1_LENGTH);
+	HA_SPIN_UNLOCK(OCSP_LOCK, &ocsp_tree_lock);
 	if (iocsp == ocsp)
 		ocsp = NULL;
 
@@ -1588,12 +2247,24 @@ static int ssl_sock_load_ocsp(SSL_CTX *ctx, const struct ckch_data *data, STACK_
 	ret = 0;
 
 	warn = NULL;
-	if (ssl_sock_load_ocsp_response(data->ocsp_response, iocsp, cid, &warn)) {
+	if (data->ocsp_response && ssl_sock_load_ocsp_response(data->ocsp_response, iocsp, cid, &warn)) {
 		memprintf(&warn, "Loading: %s. Content will be ignored", warn ? warn : "failure");
 		ha_warning("%s.\n", warn);
 	}
 
+	if (uri) {
+		HA_SPIN_LOCK(OCSP_LOCK, &ocsp_tree_lock);
+		if (!iocsp->uri) {
+			iocsp->uri = uri;
+			uri = NULL;
+		}
+		ssl_ocsp_update_schedule(iocsp, 1, 0);
+		HA_SPIN_UNLOCK(OCSP_LOCK, &ocsp_tree_lock);
+	}
+
 out:
+	free(uri);
+
 	if (cid)
 		OCSP_CERTID_free(cid);
 
@@ -2625,6 +3296,65 @@ int ssl_sock_switchctx_err_cbk(SSL *ssl, int *al, void *priv)
 	return SSL_TLSEXT_ERR_NOACK;
 }
 
+#ifndef OPENSSL_IS_BORINGSSL
+/* Checks whether the ClientHello carried by <ssl> attempts 0-RTT with a PSK
+ * binder that was already seen in the 0-RTT anti-replay stick-table of <s>,
+ * and records it otherwise. The binder is an HMAC over the ClientHello, so it
+ * uniquely identifies it (RFC8446 section 8.2). Returns non-zero if the early
+ * data must be rejected, otherwise 0. The handshake itself is never refused,
+ * a replayed ClientHello simply falls back to 1-RTT.
+ */
+static int ssl_sock_early_data_replayed(SSL *ssl, struct bind_conf *s)
+{
+	struct stktable *t = s->early_data_table;
+	struct stktable_key key;
+	struct stksess *ts;
+	struct buffer *trash;
+	const uint8_t *data, *end;
+	size_t len, blen;
+
+	if (!SSL_client_hello_get0_ext(ssl, TLSEXT_TYPE_early_data, &data, &len))
+		return 0;
+
+	if (!SSL_client_hello_get0_ext(ssl, TLSEXT_TYPE_psk, &data, &len))
+		return 0;
+
+	/* skip the identities then extract the first binder, which is the
+	 * only one usable for early data.
+	 */
+	end = data + len;
+	if (end - data < 2)
+		return 0;
+	blen = (*data++) << 8;
+	blen |= *data++;
+	if (end - data < blen + 3)
+		return 0;
+	data += blen + 2;
+	blen = *data++;
+	if (!blen || end - data < blen)
+		return 0;
+
+	trash = get_trash_chunk();
+	if (t->key_size > trash->size)
+		return 1;
+	memset(trash->area, 0, t->key_size);
+	memcpy(trash->area, data, MIN(blen, t->key_size));
+	key.key = trash->area;
+	key.key_len = t->key_size;
+
+	ts = stktable_lookup_key(t, &key);
+	if (ts) {
+		HA_ATOMIC_DEC(&ts->ref_cnt);
+		return 1;
+	}
+
+	ts = stktable_get_entry(t, &key);
+	if (ts)
+		stktable_touch_local(t, ts, 1);
+	return 0;
+}
+#endif
+
 #ifdef OPENSSL_IS_BORINGSSL
 int ssl_sock_switchctx_cbk(const struct ssl_early_callback_ctx *ctx)
 {
@@ -2646,6 +3376,7 @@ int ssl_sock_switchctx_cbk(SSL *ssl, int *al, void *arg)
 	const uint8_t *servername;
 	size_t servername_len;
 	struct ebmb_node *node, *n, *node_ecdsa = NULL, *node_rsa = NULL, *node_anonymous = NULL;
+	int lazy_found = 0, lazy_tried = 0;
 	int allow_early = 0;
 	int i;
 
@@ -2805,6 +3536,10 @@ int ssl_sock_switchctx_cbk(SSL *ssl, int *al, void *arg)
 		}
 	}
 
+lookup:
+	/* the trash may have been used by ssl_sock_lazy_load() */
+	wildp = NULL;
+	node_ecdsa = node_rsa = node_anonymous = NULL;
 	for (i = 0; i < trash.size && i < servername_len; i++) {
 		trash.area[i] = tolower(servername[i]);
 		if (!wildp && (trash.area[i] == '.'))
@@ -2844,6 +3579,13 @@ int ssl_sock_switchctx_cbk(SSL *ssl, int *al, void *arg)
 						continue;
 				}
 
+				if (!container_of(n, struct sni_ctx, name)->ctx) {
+					/* lazy crt-list entry, not loaded yet */
+					if (!container_of(n, struct sni_ctx, name)->ckch_inst->lazy_failed)
+						lazy_found = 1;
+					continue;
+				}
+
 				switch(container_of(n, struct sni_ctx, name)->kinfo.sig) {
 				case TLSEXT_signature_ecdsa:
 					if (!node_ecdsa)
@@ -2861,6 +3603,15 @@ int ssl_sock_switchctx_cbk(SSL *ssl, int *al, void *arg)
 			}
 		}
 	}
+	if (lazy_found && !lazy_tried) {
+		/* build the matching entries, then lookup again */
+		HA_RWLOCK_RDUNLOCK(SNI_LOCK, &s->sni_lock);
+		ssl_sock_lazy_load(s, trash.area, wildp);
+		lazy_tried = 1;
+		lazy_found = 0;
+		goto lookup;
+	}
+
 	/* Once the certificates are found, select them depending on what is
 	 * supported in the client and by key_signature priority order: EDSA >
 	 * RSA > DSA */
@@ -2879,6 +3630,8 @@ int ssl_sock_switchctx_cbk(SSL *ssl, int *al, void *arg)
 		/* switch ctx */
 		struct ssl_bind_conf *conf = container_of(node, struct sni_ctx, name)->conf;
 		ssl_sock_switchctx_set(ssl, container_of(node, struct sni_ctx, name)->ctx);
+		if (container_of(node, struct sni_ctx, name)->ckch_inst->lazy_loaded)
+			ssl_sock_lazy_touch(container_of(node, struct sni_ctx, name)->ckch_inst);
 		if (conf) {
 			methodVersions[conf->ssl_methods.min].ssl_set_version(ssl, SET_MIN);
 			methodVersions[conf->ssl_methods.max].ssl_set_version(ssl, SET_MAX);
@@ -2937,6 +3690,9 @@ int ssl_sock_switchctx_cbk(SSL *ssl, int *al, void *arg)
 	if (allow_early)
 		SSL_set_early_data_enabled(ssl, 1);
 #else
+	if (allow_early && s->early_data_table &&
+	    ssl_sock_early_data_replayed(ssl, s))
+		allow_early = 0;
 	if (!allow_early)
 		SSL_set_max_early_data(ssl, 0);
 #endif
@@ -3465,7 +4221,8 @@ static int ckch_inst_add_cert_sni(SSL_CTX *ctx, struct ckch_inst *ckch_inst,
 		if (!sc)
 			return -1;
 		memcpy(sc->name.key, trash.area, len + 1);
-		SSL_CTX_up_ref(ctx);
+		if (ctx) /* NULL for the placeholder of a lazy crt-list entry */
+			SSL_CTX_up_ref(ctx);
 		sc->ctx = ctx;
 		sc->conf = conf;
 		sc->kinfo = kinfo;
@@ -3505,7 +4262,7 @@ void ssl_sock_load_cert_sni(struct ckch_inst *ckch_inst, struct bind_conf *bind_
 
 		for (; node; node = ebmb_next_dup(node)) {
 			sc1 = ebmb_entry(node, struct sni_ctx, name);
-			if (sc1->ctx == sc0->ctx && sc1->conf == sc0->conf
+			if (sc0->ctx && sc1->ctx == sc0->ctx && sc1->conf == sc0->conf
 			    && sc1->neg == sc0->neg && sc1->wild == sc0->wild) {
 				/* it's a duplicate, we should remove and free it */
 				LIST_DELETE(&sc0->by_ckch_inst);
@@ -3734,12 +4491,22 @@ static int ssl_sock_put_ckch_into_ctx(const char *path, const struct ckch_data *
 {
 	int errcode = 0;
 	STACK_OF(X509) *find_chain = NULL;
+	EVP_PKEY *pkey;
+	int ret;
 
 	ERR_clear_error();
 
-	if (SSL_CTX_use_PrivateKey(ctx, data->key) <= 0) {
-		int ret;
+	pkey = data->key;
+#ifdef HAVE_SSL_OFFLOAD
+	/* use a copy of the key whose operations are offloaded */
+	if (global_ssl.offload_threads)
+		pkey = ssl_offload_get_key(data->key);
+#endif
+	ret = pkey ? SSL_CTX_use_PrivateKey(ctx, pkey) : 0;
+	if (pkey != data->key)
+		EVP_PKEY_free(pkey);
 
+	if (ret <= 0) {
 		ret = ERR_get_error();
 		memprintf(err, "%sunable to load SSL private key into SSL Context '%s': %s.\n",
 				err && *err ? *err : "", path, ERR_reason_error_string(ret));
@@ -3780,7 +4547,7 @@ static int ssl_sock_put_ckch_into_ctx(const char *path, const struct ckch_data *
 
 #if ((defined SSL_CTRL_SET_TLSEXT_STATUS_REQ_CB && !defined OPENSSL_NO_OCSP) || defined OPENSSL_IS_BORINGSSL)
 	/* Load OCSP Info into context */
-	if (data->ocsp_response) {
+	if (data->ocsp_response || global_ssl.ocsp_update) {
 		if (ssl_sock_load_ocsp(ctx, data, find_chain) < 0) {
 			memprintf(err, "%s '%s.ocsp' is present and activates OCSP but it is impossible to compute the OCSP certificate ID (maybe the issuer could not be found)'.\n",
 			          err && *err ? *err : "", path);
@@ -3843,7 +4610,19 @@ static int ssl_sock_put_srv_ckch_into_ctx(const char *path, const struct ckch_da
 int ckch_inst_new_load_store(const char *path, struct ckch_store *ckchs, struct bind_conf *bind_conf,
                                     struct ssl_bind_conf *ssl_conf, char **sni_filter, int fcount, struct ckch_inst **ckchi, char **err)
 {
-	SSL_CTX *ctx;
+	return ckch_inst_new_load_store_ctx(path, ckchs, bind_conf, ssl_conf, sni_filter, fcount, NULL, ckchi, err);
+}
+
+/*
+ * Same as ckch_inst_new_load_store() but if <ctx> is not NULL, the instance
+ * uses this SSL_CTX instead of building a new one. It must have been built
+ * from the same ckch_store and already prepared for the same bind_conf and
+ * ssl_conf, so the caller has nothing left to prepare.
+ */
+int ckch_inst_new_load_store_ctx(const char *path, struct ckch_store *ckchs, struct bind_conf *bind_conf,
+                                 struct ssl_bind_conf *ssl_conf, char **sni_filter, int fcount, SSL_CTX *ctx,
+                                 struct ckch_inst **ckchi, char **err)
+{
 	int i;
 	int order = 0;
 	X509_NAME *xname;
@@ -3862,19 +4641,29 @@ int ckch_inst_new_load_store(const char *path, struct ckch_store *ckchs, struct
 	if (!ckchs || !ckchs->data)
 		return ERR_FATAL;
 
+	errcode |= ckch_store_load_lazy(ckchs, err);
+	if (errcode & ERR_CODE)
+		return errcode;
+
 	data = ckchs->data;
 
-	ctx = SSL_CTX_new(SSLv23_server_method());
-	if (!ctx) {
-		memprintf(err, "%sunable to allocate SSL context for cert '%s'.\n",
-		          err && *err ? *err : "", path);
-		errcode |= ERR_ALERT | ERR_FATAL;
-		goto error;
+	if (ctx) {
+		/* released below like a newly allocated one */
+		SSL_CTX_up_ref(ctx);
 	}
+	else {
+		ctx = SSL_CTX_new(SSLv23_server_method());
+		if (!ctx) {
+			memprintf(err, "%sunable to allocate SSL context for cert '%s'.\n",
+			          err && *err ? *err : "", path);
+			errcode |= ERR_ALERT | ERR_FATAL;
+			goto error;
+		}
 
-	errcode |= ssl_sock_put_ckch_into_ctx(path, data, ctx, err);
-	if (errcode & ERR_CODE)
-		goto error;
+		errcode |= ssl_sock_put_ckch_into_ctx(path, data, ctx, err);
+		if (errcode & ERR_CODE)
+			goto error;
+	}
 
 	ckch_inst = ckch_inst_new();
 	if (!ckch_inst) {
@@ -4023,6 +4812,10 @@ int ckch_inst_new_load_srv_store(const char *path, struct ckch_store *ckchs,
 	if (!ckchs || !ckchs->data)
 		return ERR_FATAL;
 
+	errcode |= ckch_store_load_lazy(ckchs, err);
+	if (errcode & ERR_CODE)
+		return errcode;
+
 	data = ckchs->data;
 
 	ctx = SSL_CTX_new(SSLv23_client_method());
@@ -4105,6 +4898,251 @@ static int ssl_sock_load_srv_ckchs(const char *path, struct ckch_store *ckchs,
 	return errcode;
 }
 
+#ifdef HAVE_SSL_CLIENT_HELLO_CB
+/* LRU of the instances built on demand from the lazy crt-list entries, and
+ * the last instance it evicted. The ssl_lazy_lock is always taken last.
+ */
+static struct lru64_head *ssl_lazy_lru = NULL;
+static struct ckch_inst *ssl_lazy_evicted = NULL;
+static unsigned int ssl_lazy_loading = 0; /* set while holding the ckch_lock to load */
+__decl_spinlock(ssl_lazy_lock);
+#endif
+
+/*
+ * Allocates the placeholder instance of the lazy crt-list <entry> for
+ * <bind_conf>. Its SNIs are built from the filters of the entry but have no
+ * SSL_CTX, which will only be built by ssl_sock_lazy_load() once a ClientHello
+ * matches one of them. The caller is responsible for inserting the SNIs.
+ *
+ * Returns NULL upon memory allocation error.
+ */
+static struct ckch_inst *ckch_inst_new_lazy(struct crtlist_entry *entry, struct bind_conf *bind_conf)
+{
+	struct pkey_info kinfo = { .sig = TLSEXT_signature_anonymous, .bits = 0 };
+	struct ckch_inst *inst;
+	int fcount = entry->fcount;
+	int order = 0;
+
+	inst = ckch_inst_new();
+	if (!inst)
+		return NULL;
+
+	while (fcount--) {
+		order = ckch_inst_add_cert_sni(NULL, inst, bind_conf, entry->ssl_conf, kinfo, entry->filters[fcount], order);
+		if (order < 0) {
+			ckch_inst_free(inst);
+			return NULL;
+		}
+	}
+
+	inst->bind_conf = bind_conf;
+	inst->ssl_conf = entry->ssl_conf;
+	inst->crtlist_entry = entry;
+	LIST_APPEND(&entry->ckch_inst, &inst->by_crtlist_entry);
+	return inst;
+}
+
+#ifdef HAVE_SSL_CLIENT_HELLO_CB
+
+/* LRU callback only recording the evicted instance, it is released once the
+ * ssl_lazy_lock is dropped.
+ */
+static void ssl_sock_lazy_evict(void *data)
+{
+	ssl_lazy_evicted = data;
+}
+
+/*
+ * Replaces the instance <inst> built on demand by a new placeholder, and
+ * releases the files of its store once it has no instance anymore. <inst>
+ * must have been removed from the LRU. Must be called under the ckch_lock.
+ */
+static void ssl_sock_lazy_unload(struct ckch_inst *inst)
+{
+	struct bind_conf *bind_conf = inst->bind_conf;
+	struct ckch_store *store = inst->ckch_store;
+	struct ckch_inst *lazy;
+
+	inst->lazy_loaded = 0;
+	lazy = ckch_inst_new_lazy(inst->crtlist_entry, bind_conf);
+	if (!lazy)
+		return; /* keep it loaded */
+
+	HA_RWLOCK_WRLOCK(SNI_LOCK, &bind_conf->sni_lock);
+	ssl_sock_load_cert_sni(lazy, bind_conf);
+	ckch_inst_free(inst);
+	HA_RWLOCK_WRUNLOCK(SNI_LOCK, &bind_conf->sni_lock);
+
+	if (store->lazy && LIST_ISEMPTY(&store->ckch_inst))
+		ssl_sock_free_cert_key_and_chain_contents(store->data);
+}
+
+/*
+ * Replaces the placeholder <lazy> by a real instance built from its crt-list
+ * entry, then registers this instance in the LRU, which may evict the least
+ * recently used one. On error, the placeholder is marked as failed so that it
+ * is not tried anymore. Must be called under the ckch_lock.
+ */
+static void ssl_sock_lazy_load_inst(struct ckch_inst *lazy)
+{
+	struct crtlist_entry *entry = lazy->crtlist_entry;
+	struct bind_conf *bind_conf = lazy->bind_conf;
+	struct ckch_store *store = entry->node.key;
+	struct ckch_inst *inst = NULL, *evicted;
+	struct sni_ctx *sni;
+	struct lru64 *lru;
+	char *err = NULL;
+	int errcode;
+
+	errcode = ckch_inst_new_load_store(store->path, store, bind_conf, entry->ssl_conf,
+	                                   entry->filters, entry->fcount, &inst, &err);
+	if (!(errcode & ERR_CODE)) {
+		/* only the first SSL_CTX is initialized, it's shared by the other sni_ctx */
+		list_for_each_entry(sni, &inst->sni_ctx, by_ckch_inst) {
+			if (!sni->order)
+				errcode |= ssl_sock_prep_ctx_and_inst(bind_conf, entry->ssl_conf, sni->ctx, inst, &err);
+		}
+	}
+
+	if (errcode & ERR_CODE) {
+		send_log(NULL, LOG_WARNING, "Failed to load certificate '%s' on demand: %s",
+		         store->path, err ? err : "unknown error.\n");
+		ckch_inst_free(inst);
+		HA_RWLOCK_WRLOCK(SNI_LOCK, &bind_conf->sni_lock);
+		lazy->lazy_failed = 1;
+		HA_RWLOCK_WRUNLOCK(SNI_LOCK, &bind_conf->sni_lock);
+		ha_free(&err);
+		return;
+	}
+	ha_free(&err);
+
+	inst->lazy_loaded = 1;
+	inst->crtlist_entry = entry;
+	LIST_APPEND(&store->ckch_inst, &inst->by_ckchs);
+	LIST_APPEND(&entry->ckch_inst, &inst->by_crtlist_entry);
+
+	HA_RWLOCK_WRLOCK(SNI_LOCK, &bind_conf->sni_lock);
+	ssl_sock_load_cert_sni(inst, bind_conf);
+	ckch_inst_free(lazy);
+	HA_RWLOCK_WRUNLOCK(SNI_LOCK, &bind_conf->sni_lock);
+
+	HA_SPIN_LOCK(SSL_LAZY_LOCK, &ssl_lazy_lock);
+	if (!ssl_lazy_lru)
+		ssl_lazy_lru = lru64_new(global_ssl.lazy_load);
+	if (ssl_lazy_lru) {
+		lru = lru64_get((uintptr_t)inst, ssl_lazy_lru, inst, 0);
+		if (lru)
+			lru64_commit(lru, inst, inst, 0, ssl_sock_lazy_evict);
+	}
+	evicted = ssl_lazy_evicted;
+	ssl_lazy_evicted = NULL;
+	HA_SPIN_UNLOCK(SSL_LAZY_LOCK, &ssl_lazy_lock);
+
+	if (evicted)
+		ssl_sock_lazy_unload(evicted);
+}
+
+/*
+ * Builds the instances of the lazy crt-list entries of <bind_conf> matching
+ * the lowercase server name <name> or the wildcard part <wildp> of it. This is
+ * called from the ClientHello callback with no lock held. Nothing is done if
+ * the certificates are being manipulated from the CLI, the handshake will then
+ * use the certificates already loaded. <name> may be the trash, it is not used
+ * anymore once the instances start to be built.
+ */
+void ssl_sock_lazy_load(struct bind_conf *bind_conf, const char *name, const char *wildp)
+{
+	struct ckch_inst *lazy[SSL_LAZY_BATCH];
+	struct sni_ctx *sni, *neg;
+	struct ebmb_node *n;
+	int count = 0;
+	int i, j;
+
+	while (HA_SPIN_TRYLOCK(CKCH_LOCK, &ckch_lock)) {
+		/* only wait for another thread loading certificates, the CLI
+		 * may keep the lock for a long time.
+		 */
+		if (!HA_ATOMIC_LOAD(&ssl_lazy_loading))
+			return;
+		ha_thread_relax();
+	}
+	HA_ATOMIC_STORE(&ssl_lazy_loading, 1);
+
+	/* placeholders are only freed under the ckch_lock, collect them
+	 * first since building the instances needs the SNI write lock.
+	 */
+	HA_RWLOCK_RDLOCK(SNI_LOCK, &bind_conf->sni_lock);
+	for (i = 0; i < 2; i++) {
+		if (i == 0)
+			n = ebst_lookup(&bind_conf->sni_ctx, name);
+		else if (wildp)
+			n = ebst_lookup(&bind_conf->sni_w_ctx, wildp);
+		else
+			break;
+
+		for (; n && count < SSL_LAZY_BATCH; n = ebmb_next_dup(n)) {
+			sni = container_of(n, struct sni_ctx, name);
+			if (sni->ctx || sni->neg || sni->ckch_inst->lazy_failed)
+				continue;
+
+			if (i == 1) {
+				int skip = 0;
+
+				/* look for an exclusion on the same crt-list line */
+				list_for_each_entry(neg, &sni->ckch_inst->sni_ctx, by_ckch_inst) {
+					if (neg->neg && strcmp((const char *)neg->name.key, name) == 0) {
+						skip = 1;
+						break;
+					}
+				}
+				if (skip)
+					continue;
+			}
+
+			for (j = 0; j < count && lazy[j] != sni->ckch_inst; j++)
+				;
+			if (j == count)
+				lazy[count++] = sni->ckch_inst;
+		}
+	}
+	HA_RWLOCK_RDUNLOCK(SNI_LOCK, &bind_conf->sni_lock);
+
+	for (i = 0; i < count; i++)
+		ssl_sock_lazy_load_inst(lazy[i]);
+
+	HA_ATOMIC_STORE(&ssl_lazy_loading, 0);
+	HA_SPIN_UNLOCK(CKCH_LOCK, &ckch_lock);
+}
+
+/* Marks the instance <inst> built on demand as recently used. */
+void ssl_sock_lazy_touch(struct ckch_inst *inst)
+{
+	HA_SPIN_LOCK(SSL_LAZY_LOCK, &ssl_lazy_lock);
+	if (ssl_lazy_lru)
+		lru64_lookup((uintptr_t)inst, ssl_lazy_lru, inst, 0);
+	HA_SPIN_UNLOCK(SSL_LAZY_LOCK, &ssl_lazy_lock);
+}
+
+#endif /* HAVE_SSL_CLIENT_HELLO_CB */
+
+/* Removes the instance <inst> built on demand from the LRU, it is about to be
+ * freed.
+ */
+void ssl_sock_lazy_forget(struct ckch_inst *inst)
+{
+#ifdef HAVE_SSL_CLIENT_HELLO_CB
+	struct lru64 *lru;
+
+	HA_SPIN_LOCK(SSL_LAZY_LOCK, &ssl_lazy_lock);
+	if (ssl_lazy_lru) {
+		lru = lru64_lookup((uintptr_t)inst, ssl_lazy_lru, inst, 0);
+		if (lru)
+			lru->data = NULL;
+	}
+	HA_SPIN_UNLOCK(SSL_LAZY_LOCK, &ssl_lazy_lock);
+#endif
+}
+
 
 
 
@@ -4180,6 +5218,19 @@ int ssl_sock_load_cert_list_file(char *file, int dir, struct bind_conf *bind_con
 		struct ckch_inst *ckch_inst = NULL;
 
 		store = entry->node.key;
+		if (store->lazy && !store->data->cert && crtlist_entry_is_lazy(entry) &&
+		    entry != LIST_ELEM(crtlist->ord_entries.n, struct crtlist_entry *, by_crtlist)) {
+			/* only index the SNIs, see ssl_sock_lazy_load() */
+			ckch_inst = ckch_inst_new_lazy(entry, bind_conf);
+			if (!ckch_inst) {
+				memprintf(err, "error processing line %d in file '%s' : out of memory.", entry->linenum, file);
+				cfgerr |= ERR_FATAL | ERR_ALERT;
+				goto error;
+			}
+			ssl_sock_load_cert_sni(ckch_inst, bind_conf);
+			continue;
+		}
+
 		cfgerr |= ssl_sock_load_ckchs(store->path, store, bind_conf, entry->ssl_conf, entry->filters, entry->fcount, &ckch_inst, err);
 		if (cfgerr & ERR_CODE) {
 			memprintf(err, "error processing line %d in file '%s' : %s", entry->linenum, file, *err);
@@ -4447,6 +5498,10 @@ ssl_sock_initial_ctx(struct bind_conf *bind_conf)
 		options |= SSL_OP_NO_TICKET;
 	if (bind_conf->ssl_options & BC_SSL_O_PREF_CLIE_CIPH)
 		options &= ~SSL_OP_CIPHER_SERVER_PREFERENCE;
+#ifdef HAVE_SSL_KTLS
+	if (bind_conf->ssl_options & BC_SSL_O_KTLS)
+		options |= SSL_OP_ENABLE_KTLS;
+#endif
 
 #ifdef SSL_OP_NO_RENEGOTIATION
 	options |= SSL_OP_NO_RENEGOTIATION;
@@ -4482,7 +5537,7 @@ ssl_sock_initial_ctx(struct bind_conf *bind_conf)
 }
 
 
-static inline void sh_ssl_sess_free_blocks(struct shared_block *first, struct shared_block *block)
+static inline void sh_ssl_sess_free_blocks(struct shared_context *shctx, struct shared_block *first, struct shared_block *block)
 {
 	if (first == block) {
 		struct sh_ssl_sess_hdr *sh_ssl_sess = (struct sh_ssl_sess_hdr *)first->data;
@@ -4545,6 +5600,51 @@ static int sh_ssl_sess_store(unsigned char *s_id, unsigned char *data, int data_
 	return 1;
 }
 
+/* Tries to use the most recent session stored by another thread for server
+ * <s> on <ssl>, when the current thread has none. The session is only used if
+ * its lifetime is not over yet. Its SNI is copied into the current thread's
+ * slot so that ssl_sock_set_servername() validates it like a local one. Must
+ * be called with the server's ssl_ctx lock held for reading.
+ */
+static void ssl_sock_import_shared_sess(struct server *s, SSL *ssl)
+{
+	SSL_SESSION *sess = NULL;
+	const unsigned char *ptr;
+	unsigned int thr;
+	char *sni = NULL;
+
+	thr = HA_ATOMIC_LOAD(&s->ssl_ctx.last_sess_tid);
+	if (!thr || thr - 1 == tid)
+		return;
+	thr--;
+
+	HA_RWLOCK_RDLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.reused_sess[thr].sess_lock);
+	if (s->ssl_ctx.reused_sess[thr].ptr) {
+		ptr = s->ssl_ctx.reused_sess[thr].ptr;
+		sess = d2i_SSL_SESSION(NULL, &ptr, s->ssl_ctx.reused_sess[thr].size);
+		if (sess && s->ssl_ctx.reused_sess[thr].sni)
+			sni = strdup(s->ssl_ctx.reused_sess[thr].sni);
+	}
+	HA_RWLOCK_RDUNLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.reused_sess[thr].sess_lock);
+
+	if (!sess)
+		return;
+
+	if ((long)SSL_SESSION_get_time(sess) + (long)SSL_SESSION_get_timeout(sess) <= (long)date.tv_sec ||
+	    !SSL_set_session(ssl, sess)) {
+		SSL_SESSION_free(sess);
+		free(sni);
+		return;
+	}
+	SSL_SESSION_free(sess);
+
+	/* our slot is empty and only written by us */
+	HA_RWLOCK_WRLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.reused_sess[tid].sess_lock);
+	free(s->ssl_ctx.reused_sess[tid].sni);
+	s->ssl_ctx.reused_sess[tid].sni = sni;
+	HA_RWLOCK_WRUNLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.reused_sess[tid].sess_lock);
+}
+
 /* SSL callback used when a new session is created while connecting to a server */
 static int ssl_sess_new_srv_cb(SSL *ssl, SSL_SESSION *sess)
 {
@@ -4565,6 +5665,9 @@ static int ssl_sess_new_srv_cb(SSL *ssl, SSL_SESSION *sess)
 		len = i2d_SSL_SESSION(sess, NULL);
 		sni = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
 		HA_RWLOCK_RDLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.lock);
+		/* other threads may be reading our slot when sharing is enabled */
+		if (s->ssl_ctx.options & SRV_SSL_O_SHARE_SESS)
+			HA_RWLOCK_WRLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.reused_sess[tid].sess_lock);
 		if (s->ssl_ctx.reused_sess[tid].ptr && s->ssl_ctx.reused_sess[tid].allocated_size >= len) {
 			ptr = s->ssl_ctx.reused_sess[tid].ptr;
 		} else {
@@ -4588,6 +5691,12 @@ static int ssl_sess_new_srv_cb(SSL *ssl, SSL_SESSION *sess)
 			/* if there wasn't an old sni but there is a new one */
 			s->ssl_ctx.reused_sess[tid].sni = strdup(sni);
 		}
+
+		if (s->ssl_ctx.options & SRV_SSL_O_SHARE_SESS) {
+			HA_RWLOCK_WRUNLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.reused_sess[tid].sess_lock);
+			if (s->ssl_ctx.reused_sess[tid].ptr && HA_ATOMIC_LOAD(&s->ssl_ctx.last_sess_tid) != tid + 1)
+				HA_ATOMIC_STORE(&s->ssl_ctx.last_sess_tid, tid + 1);
+		}
 		HA_RWLOCK_RDUNLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.lock);
 	} else {
 		HA_RWLOCK_RDLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.lock);
@@ -4599,6 +5708,83 @@ static int ssl_sess_new_srv_cb(SSL *ssl, SSL_SESSION *sess)
 }
 
 
+/* Pushes the <data_len> bytes of the ASN1 encoded session <data> of id <s_id>
+ * into the session cache stick-table, from where the peers replicate it. The
+ * first gpt element holds the length and the next ones the data, 4 bytes per
+ * element. Sessions too large for the table are only stored locally.
+ */
+static void sh_ssl_sess_table_store(const unsigned char *s_id, const unsigned char *data, int data_len)
+{
+	struct stktable *t = ssl_sess_table;
+	struct stktable_key key;
+	struct stksess *ts;
+	unsigned int v;
+	void *ptr;
+	int i, j;
+
+	if (data_len > (t->data_nbelem[STKTABLE_DT_GPT] - 1) * 4)
+		return;
+
+	key.key = (void *)s_id;
+	key.key_len = SSL_MAX_SSL_SESSION_ID_LENGTH;
+	ts = stktable_get_entry(t, &key);
+	if (!ts)
+		return;
+
+	HA_RWLOCK_WRLOCK(STK_SESS_LOCK, &ts->lock);
+	for (i = 0; i * 4 < data_len + 4; i++) {
+		if (!i)
+			v = data_len;
+		else {
+			for (v = j = 0; j < 4 && (i - 1) * 4 + j < data_len; j++)
+				v |= (unsigned int)data[(i - 1) * 4 + j] << (8 * j);
+		}
+		ptr = stktable_data_ptr_idx(t, ts, STKTABLE_DT_GPT, i);
+		if (ptr)
+			stktable_data_cast(ptr, std_t_uint) = v;
+	}
+	HA_RWLOCK_WRUNLOCK(STK_SESS_LOCK, &ts->lock);
+	stktable_touch_local(t, ts, 1);
+}
+
+/* Looks up the session of id <s_id> in the session cache stick-table and
+ * copies its ASN1 encoding into <data> which must be able to receive
+ * SHSESS_MAX_DATA_LEN bytes. Returns the encoded length, or 0 if not found.
+ */
+static int sh_ssl_sess_table_lookup(const unsigned char *s_id, unsigned char *data)
+{
+	struct stktable *t = ssl_sess_table;
+	struct stktable_key key;
+	struct stksess *ts;
+	unsigned int v;
+	void *ptr;
+	int data_len = 0;
+	int i, j;
+
+	key.key = (void *)s_id;
+	key.key_len = SSL_MAX_SSL_SESSION_ID_LENGTH;
+	ts = stktable_lookup_key(t, &key);
+	if (!ts)
+		return 0;
+
+	HA_RWLOCK_RDLOCK(STK_SESS_LOCK, &ts->lock);
+	ptr = stktable_data_ptr_idx(t, ts, STKTABLE_DT_GPT, 0);
+	if (ptr)
+		data_len = stktable_data_cast(ptr, std_t_uint);
+	if (data_len > (t->data_nbelem[STKTABLE_DT_GPT] - 1) * 4 || data_len > SHSESS_MAX_DATA_LEN)
+		data_len = 0;
+
+	for (i = 1; (i - 1) * 4 < data_len; i++) {
+		ptr = stktable_data_ptr_idx(t, ts, STKTABLE_DT_GPT, i);
+		v = ptr ? stktable_data_cast(ptr, std_t_uint) : 0;
+		for (j = 0; j < 4 && (i - 1) * 4 + j < data_len; j++)
+			data[(i - 1) * 4 + j] = v >> (8 * j);
+	}
+	HA_RWLOCK_RDUNLOCK(STK_SESS_LOCK, &ts->lock);
+	HA_ATOMIC_DEC(&ts->ref_cnt);
+	return data_len;
+}
+
 /* SSL callback used on new session creation */
 int sh_ssl_sess_new_cb(SSL *ssl, SSL_SESSION *sess)
 {
@@ -4647,6 +5833,9 @@ int sh_ssl_sess_new_cb(SSL *ssl, SSL_SESSION *sess)
 	/* store to cache */
 	sh_ssl_sess_store(encid, encsess, data_len);
 	shctx_unlock(ssl_shctx);
+
+	if (ssl_sess_table)
+		sh_ssl_sess_table_store(encid, encsess, data_len);
 err:
 	/* reset original length values */
 	SSL_SESSION_set1_id(sess, encid, sid_length);
@@ -4663,6 +5852,7 @@ SSL_SESSION *sh_ssl_sess_get_cb(SSL *ssl, __OPENSSL_110_CONST__ unsigned char *k
 	unsigned char tmpkey[SSL_MAX_SSL_SESSION_ID_LENGTH];
 	SSL_SESSION *sess;
 	struct shared_block *first;
+	int data_len;
 
 	_HA_ATOMIC_INC(&global.shctx_lookups);
 
@@ -4682,22 +5872,31 @@ SSL_SESSION *sh_ssl_sess_get_cb(SSL *ssl, __OPENSSL_110_CONST__ unsigned char *k
 	/* lookup for session */
 	sh_ssl_sess = sh_ssl_sess_tree_lookup(key);
 	if (!sh_ssl_sess) {
-		/* no session found: unlock cache and exit */
+		/* no session found: unlock cache and try the shared table */
 		shctx_unlock(ssl_shctx);
-		_HA_ATOMIC_INC(&global.shctx_misses);
-		return NULL;
-	}
+		if (!ssl_sess_table || !(data_len = sh_ssl_sess_table_lookup(key, data))) {
+			_HA_ATOMIC_INC(&global.shctx_misses);
+			return NULL;
+		}
 
-	/* sh_ssl_sess (shared_block->data) is at the end of shared_block */
-	first = sh_ssl_sess_first_block(sh_ssl_sess);
+		/* keep a local copy for the next lookups */
+		shctx_lock(ssl_shctx);
+		sh_ssl_sess_store((unsigned char *)key, data, data_len);
+		shctx_unlock(ssl_shctx);
+	}
+	else {
+		/* sh_ssl_sess (shared_block->data) is at the end of shared_block */
+		first = sh_ssl_sess_first_block(sh_ssl_sess);
+		data_len = first->len - sizeof(struct sh_ssl_sess_hdr);
 
-	shctx_row_data_get(ssl_shctx, first, data, sizeof(struct sh_ssl_sess_hdr), first->len-sizeof(struct sh_ssl_sess_hdr));
+		shctx_row_data_get(ssl_shctx, first, data, sizeof(struct sh_ssl_sess_hdr), data_len);
 
-	shctx_unlock(ssl_shctx);
+		shctx_unlock(ssl_shctx);
+	}
 
 	/* decode ASN1 session */
 	p = data;
-	sess = d2i_SSL_SESSION(NULL, (const unsigned char **)&p, first->len-sizeof(struct sh_ssl_sess_hdr));
+	sess = d2i_SSL_SESSION(NULL, (const unsigned char **)&p, data_len);
 	/* Reset session id and session id contenxt */
 	if (sess) {
 		SSL_SESSION_set1_id(sess, key, key_len);
@@ -4738,6 +5937,36 @@ void sh_ssl_sess_remove_cb(SSL_CTX *ctx, SSL_SESSION *sess)
 	shctx_unlock(ssl_shctx);
 }
 
+/* Resolves the stick-table set by "tune.ssl.cache-table" and checks that it
+ * is able to hold the sessions. Returns 0 on success otherwise ERR_*.
+ */
+static int ssl_sess_table_init(void)
+{
+	struct stktable *t;
+
+	if (!global_ssl.cache_table)
+		return ERR_NONE;
+
+	t = stktable_find_by_name(global_ssl.cache_table);
+	if (!t) {
+		ha_alert("SSL session cache: stick-table '%s' not found.\n", global_ssl.cache_table);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	if (t->type != SMP_T_BIN || t->key_size != SSL_MAX_SSL_SESSION_ID_LENGTH ||
+	    !t->data_ofs[STKTABLE_DT_GPT] || t->data_nbelem[STKTABLE_DT_GPT] < 2) {
+		ha_alert("SSL session cache: stick-table '%s' must be of type 'binary' with a length of %d and store an array of at least 2 'gpt'.\n",
+		         global_ssl.cache_table, SSL_MAX_SSL_SESSION_ID_LENGTH);
+		return ERR_ALERT | ERR_FATAL;
+	}
+
+	if (!global.tune.sslcachesize)
+		ha_warning("SSL session cache: 'tune.ssl.cache-table' is ignored when 'tune.ssl.cachesize' is 0.\n");
+	else
+		ssl_sess_table = t;
+	return ERR_NONE;
+}
+
 /* Set session cache mode to server and disable openssl internal cache.
  * Set shared cache callbacks on an ssl context.
  * Shared context MUST be firstly initialized */
@@ -5234,11 +6463,15 @@ int ssl_sock_prepare_srv_ctx(struct server *srv)
 
 	/* Initiate SSL context for current server */
 	if (!srv->ssl_ctx.reused_sess) {
+		int i;
+
 		if ((srv->ssl_ctx.reused_sess = calloc(1, global.nbthread*sizeof(*srv->ssl_ctx.reused_sess))) == NULL) {
 			ha_alert("out of memory.\n");
 			cfgerr++;
 			return cfgerr;
 		}
+		for (i = 0; i < global.nbthread; i++)
+			HA_RWLOCK_INIT(&srv->ssl_ctx.reused_sess[i].sess_lock);
 	}
 	if (srv->use_ssl == 1)
 		srv->xprt = &ssl_sock;
@@ -5362,6 +6595,10 @@ static int ssl_sock_prepare_srv_ssl_ctx(const struct server *srv, SSL_CTX *ctx)
 
 	if (srv->ssl_ctx.options & SRV_SSL_O_NO_TLS_TICKETS)
 		options |= SSL_OP_NO_TICKET;
+#ifdef HAVE_SSL_KTLS
+	if (srv->ssl_ctx.options & SRV_SSL_O_KTLS)
+		options |= SSL_OP_ENABLE_KTLS;
+#endif
 	SSL_CTX_set_options(ctx, options);
 
 #ifdef SSL_MODE_ASYNC
@@ -5517,9 +6754,9 @@ int ssl_sock_prepare_all_ctx(struct bind_conf *bind_conf)
 	node = ebmb_first(&bind_conf->sni_ctx);
 	while (node) {
 		sni = ebmb_entry(node, struct sni_ctx, name);
-		if (!sni->order && sni->ctx != bind_conf->default_ctx) {
+		if (sni->ctx && !sni->order && sni->ctx != bind_conf->default_ctx) {
 			/* only initialize the CTX on its first occurrence and
-			   if it is not the default_ctx */
+			   if it is not the default_ctx (lazy entries have none yet) */
 			errcode |= ssl_sock_prep_ctx_and_inst(bind_conf, sni->conf, sni->ctx, sni->ckch_inst, &errmsg);
 		}
 		node = ebmb_next(node);
@@ -5528,9 +6765,9 @@ int ssl_sock_prepare_all_ctx(struct bind_conf *bind_conf)
 	node = ebmb_first(&bind_conf->sni_w_ctx);
 	while (node) {
 		sni = ebmb_entry(node, struct sni_ctx, name);
-		if (!sni->order && sni->ctx != bind_conf->default_ctx) {
+		if (sni->ctx && !sni->order && sni->ctx != bind_conf->default_ctx) {
 			/* only initialize the CTX on its first occurrence and
-			   if it is not the default_ctx */
+			   if it is not the default_ctx (lazy entries have none yet) */
 			errcode |= ssl_sock_prep_ctx_and_inst(bind_conf, sni->conf, sni->ctx, sni->ckch_inst, &errmsg);
 		}
 		node = ebmb_next(node);
@@ -5578,7 +6815,7 @@ int ssl_sock_prepare_bind_conf(struct bind_conf *bind_conf)
 	if (!ssl_shctx && global.tune.sslcachesize) {
 		alloc_ctx = shctx_init(&ssl_shctx, global.tune.sslcachesize,
 		                       sizeof(struct sh_ssl_sess_hdr) + SHSESS_BLOCK_MIN_SIZE, -1,
-		                       sizeof(*sh_ssl_sess_tree), (global.nbthread > 1));
+		                       sizeof(*sh_ssl_sess_tree), (global.nbthread > 1), -1);
 		if (alloc_ctx <= 0) {
 			if (alloc_ctx == SHCTX_E_INIT_LOCK)
 				ha_alert("Unable to initialize the lock for the shared SSL session cache. You can retry using the global statement 'tune.ssl.force-private-cache' but it could increase CPU usage due to renegotiations if nbproc > 1.\n");
@@ -5599,6 +6836,32 @@ int ssl_sock_prepare_bind_conf(struct bind_conf *bind_conf)
 	/* initialize CA variables if the certificates generation is enabled */
 	err += ssl_sock_load_ca(bind_conf);
 
+	if (bind_conf->early_data_table_name) {
+		struct stktable *t = stktable_find_by_name(bind_conf->early_data_table_name);
+
+		if (!t) {
+			ha_alert("Proxy '%s': unable to find stick-table '%s' for '0rtt-anti-replay' on bind '%s' at [%s:%d].\n",
+				 px->id, bind_conf->early_data_table_name, bind_conf->arg, bind_conf->file, bind_conf->line);
+			err++;
+		}
+		else if (t->type != SMP_T_BIN) {
+			ha_alert("Proxy '%s': stick-table '%s' used by '0rtt-anti-replay' on bind '%s' at [%s:%d] must be of type 'binary'.\n",
+				 px->id, bind_conf->early_data_table_name, bind_conf->arg, bind_conf->file, bind_conf->line);
+			err++;
+		}
+		else {
+#ifdef OPENSSL_IS_BORINGSSL
+			ha_warning("Proxy '%s': '0rtt-anti-replay' is not supported with this SSL library and is ignored on bind '%s' at [%s:%d].\n",
+				   px->id, bind_conf->arg, bind_conf->file, bind_conf->line);
+#else
+			bind_conf->early_data_table = t;
+#endif
+			if (!bind_conf->ssl_conf.early_data)
+				ha_warning("Proxy '%s': '0rtt-anti-replay' has no effect without 'allow-0rtt' on bind '%s' at [%s:%d].\n",
+					   px->id, bind_conf->arg, bind_conf->file, bind_conf->line);
+		}
+	}
+
 	return -err;
 }
 
@@ -5687,6 +6950,10 @@ void ssl_sock_deinit()
 {
 	crtlist_deinit(); /* must be free'd before the ckchs */
 	ckch_deinit();
+#ifdef HAVE_SSL_CLIENT_HELLO_CB
+	lru64_destroy(ssl_lazy_lru);
+	ssl_lazy_lru = NULL;
+#endif
 }
 REGISTER_POST_DEINIT(ssl_sock_deinit);
 
@@ -5698,7 +6965,11 @@ void ssl_sock_destroy_bind_conf(struct bind_conf *bind_conf)
 	ssl_sock_free_ssl_conf(&bind_conf->ssl_conf);
 	free(bind_conf->ca_sign_file);
 	free(bind_conf->ca_sign_pass);
+	ha_free(&bind_conf->early_data_table_name);
+	bind_conf->early_data_table = NULL;
 	if (bind_conf->keys_ref && !--bind_conf->keys_ref->refcount) {
+		task_destroy(bind_conf->keys_ref->task);
+		free(bind_conf->keys_ref->table_name);
 		free(bind_conf->keys_ref->filename);
 		free(bind_conf->keys_ref->tlskeys);
 		LIST_DELETE(&bind_conf->keys_ref->list);
@@ -5890,6 +7161,7 @@ static int ssl_sock_init(struct connection *conn, void **xprt_ctx)
 	ctx->wait_event.tasklet->state  |= TASK_HEAVY; // assign it to the bulk queue during handshake
 	ctx->wait_event.events = 0;
 	ctx->sent_early_data = 0;
+	ctx->ktls_rec_type = 0;
 	ctx->early_buf = BUF_NULL;
 	ctx->conn = conn;
 	ctx->subs = NULL;
@@ -5930,6 +7202,8 @@ static int ssl_sock_init(struct connection *conn, void **xprt_ctx)
 				SSL_SESSION_free(sess);
 			}
 		}
+		else if (__objt_server(conn->target)->ssl_ctx.options & SRV_SSL_O_SHARE_SESS)
+			ssl_sock_import_shared_sess(__objt_server(conn->target), ctx->ssl);
 		HA_RWLOCK_RDUNLOCK(SSL_SERVER_LOCK, &(__objt_server(conn->target)->ssl_ctx.lock));
 
 		/* leave init state and start handshake */
@@ -6304,6 +7578,22 @@ static int ssl_sock_handshake(struct connection *conn, unsigned int flag)
 		HA_ATOMIC_INC(&counters_px->reused_sess);
 	}
 
+#ifdef HAVE_SSL_KTLS
+	if (counters && (SSL_get_options(ctx->ssl) & SSL_OP_ENABLE_KTLS)) {
+		if (conn->flags & CO_FL_SSL_KTLS_TX) {
+			HA_ATOMIC_INC(&counters->ktls_sess);
+			HA_ATOMIC_INC(&counters_px->ktls_sess);
+		}
+		else {
+			HA_ATOMIC_INC(&counters->ktls_fallback);
+			HA_ATOMIC_INC(&counters_px->ktls_fallback);
+		}
+	}
+#endif
+
+	HA_USDT(ssl_handshake_done, conn, ctx->ssl, !!objt_server(conn->target),
+	        !!SSL_session_reused(ctx->ssl));
+
 	/* The connection is now established at both layers, it's time to leave */
 	conn->flags &= ~(flag | CO_FL_WAIT_L4_CONN | CO_FL_WAIT_L6_CONN);
 	return 1;
@@ -6321,8 +7611,18 @@ static int ssl_sock_handshake(struct connection *conn, unsigned int flag)
 		 * another thread */
 
 		HA_RWLOCK_RDLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.lock);
-		if (s->ssl_ctx.reused_sess[tid].ptr)
-			ha_free(&s->ssl_ctx.reused_sess[tid].ptr);
+		if (s->ssl_ctx.reused_sess[tid].ptr) {
+			if (s->ssl_ctx.options & SRV_SSL_O_SHARE_SESS) {
+				unsigned int thr = tid + 1;
+
+				HA_RWLOCK_WRLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.reused_sess[tid].sess_lock);
+				ha_free(&s->ssl_ctx.reused_sess[tid].ptr);
+				HA_RWLOCK_WRUNLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.reused_sess[tid].sess_lock);
+				HA_ATOMIC_CAS(&s->ssl_ctx.last_sess_tid, &thr, 0);
+			}
+			else
+				ha_free(&s->ssl_ctx.reused_sess[tid].ptr);
+		}
 		HA_RWLOCK_RDUNLOCK(SSL_SERVER_LOCK, &s->ssl_ctx.lock);
 	}
 
@@ -7694,6 +8994,11 @@ static int cli_io_handler_show_ocspresponse(struct appctx *appctx)
 		}
 		chunk_appendf(trash, "\n");
 
+		if (ocsp->uri) {
+			chunk_appendf(trash, "OCSP responder : %s\n", ocsp->uri);
+			chunk_appendf(trash, "Update failures : %u\n", ocsp->update_failures);
+		}
+
 		p = ocsp->key_data;
 
 		/* Decode the certificate ID (serialized into the key). */
@@ -7908,12 +9213,16 @@ int ssl_ocsp_response_print(struct buffer *ocsp_response, struct buffer *out)
 int ssl_get_ocspresponse_detail(unsigned char *ocsp_certid, struct buffer *out)
 {
 	struct certificate_ocsp *ocsp;
+	int ret;
 
 	ocsp = (struct certificate_ocsp *)ebmb_lookup(&cert_ocsp_tree, ocsp_certid, OCSP_MAX_CERTID_ASN1_LENGTH);
 	if (!ocsp)
 		return -1;
 
-	return ssl_ocsp_response_print(&ocsp->response, out);
+	HA_RWLOCK_RDLOCK(OCSP_LOCK, &ocsp->lock);
+	ret = ssl_ocsp_response_print(&ocsp->response, out);
+	HA_RWLOCK_RDUNLOCK(OCSP_LOCK, &ocsp->lock);
+	return ret;
 }
 
 
@@ -7924,11 +9233,15 @@ static int cli_io_handler_show_ocspresponse_detail(struct appctx *appctx)
 {
 	struct buffer *trash = alloc_trash_chunk();
 	struct certificate_ocsp *ocsp = appctx->svcctx;
+	int ret;
 
 	if (trash == NULL)
 		return 1;
 
-	if (ssl_ocsp_response_print(&ocsp->response, trash)) {
+	HA_RWLOCK_RDLOCK(OCSP_LOCK, &ocsp->lock);
+	ret = ssl_ocsp_response_print(&ocsp->response, trash);
+	HA_RWLOCK_RDUNLOCK(OCSP_LOCK, &ocsp->lock);
+	if (ret) {
 		free_trash_chunk(trash);
 		return 1;
 	}
@@ -7966,6 +9279,20 @@ static struct cli_kw_list cli_kws = {{ },{
 
 INITCALL1(STG_REGISTER, cli_register_kw, &cli_kws);
 
+#ifdef HAVE_SSL_KTLS
+/* Send data from a pipe to an SSL connection whose records are encrypted by
+ * the kernel: the cleartext is directly spliced to the socket. This must only
+ * be called when CO_FL_SSL_KTLS_TX is set (see conn_xprt_can_snd_pipe()).
+ */
+static int ssl_sock_from_pipe(struct connection *conn, void *xprt_ctx, struct pipe *pipe, unsigned int count)
+{
+	struct ssl_sock_ctx *ctx = xprt_ctx;
+
+	BUG_ON(!(conn->flags & CO_FL_SSL_KTLS_TX));
+	return ctx->xprt->snd_pipe(conn, ctx->xprt_ctx, pipe, count);
+}
+#endif
+
 /* transport-layer operations for SSL sockets */
 struct xprt_ops ssl_sock = {
 	.snd_buf  = ssl_sock_from_buf,
@@ -7975,7 +9302,11 @@ struct xprt_ops ssl_sock = {
 	.remove_xprt = ssl_remove_xprt,
 	.add_xprt = ssl_add_xprt,
 	.rcv_pipe = NULL,
+#ifdef HAVE_SSL_KTLS
+	.snd_pipe = ssl_sock_from_pipe,
+#else
 	.snd_pipe = NULL,
+#endif
 	.shutr    = NULL,
 	.shutw    = ssl_sock_shutw,
 	.close    = ssl_sock_close,
@@ -8160,6 +9491,7 @@ static void __ssl_sock_init(void)
 #if (defined SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB && TLS_TICKETS_NO > 0)
 	hap_register_post_check(tlskeys_finalize_config);
 #endif
+	hap_register_post_check(ssl_sess_table_init);
 
 	global.ssl_session_max_cost   = SSL_SESSION_MAX_COST;
 	global.ssl_handshake_max_cost = SSL_HANDSHAKE_MAX_COST;
@@ -8332,6 +9664,7 @@ static void __ssl_sock_deinit(void)
         CRYPTO_cleanup_all_ex_data();
 #endif
 	BIO_meth_free(ha_meth);
+	ha_free(&global_ssl.cache_table);
 }
 REGISTER_POST_DEINIT(__ssl_sock_deinit);
 
@@ -31,6 +31,7 @@
 #include <haproxy/cfgparse.h>
 #include <haproxy/channel.h>
 #include <haproxy/check.h>
+#include <haproxy/counters.h>
 #include <haproxy/cli.h>
 #include <haproxy/clock.h>
 #include <haproxy/compression.h>
@@ -51,6 +52,7 @@
 #include <haproxy/pattern-t.h>
 #include <haproxy/pipe.h>
 #include <haproxy/pool.h>
+#include <haproxy/proto_tcp.h>
 #include <haproxy/proxy.h>
 #include <haproxy/resolvers.h>
 #include <haproxy/sc_strm.h>
@@ -156,6 +158,12 @@ const struct name_desc info_fields[INF_TOTAL_FIELDS] = {
 	[INF_CUM_LOG_MSGS]                   = { .name = "CumRecvLogs",                 .desc = "Total number of log messages received by log-forwarding listeners on this worker process since started" },
 	[INF_BUILD_INFO]                     = { .name = "Build info",                  .desc = "Build info" },
 	[INF_TAINTED]                        = { .name = "Tainted",                     .desc = "Experimental features used" },
+	[INF_LOG_BATCHES]                    = { .name = "LogBatches",                  .desc = "Total number of sendmmsg() calls used to send batched log datagrams on this worker process since started" },
+	[INF_LOG_BATCHED_DGRAMS]             = { .name = "LogBatchedDgrams",            .desc = "Total number of log datagrams sent in batches on this worker process since started" },
+	[INF_SRC_PORT_EXHAUSTED]             = { .name = "SrcPortExhausted",            .desc = "Total number of outgoing connections which failed to find a free source port in their server's range on this worker process since started" },
+	[INF_SOFT_STOP_DURATION]             = { .name = "SoftStopDuration",            .desc = "Number of seconds since the current worker process started to stop (0 if not stopping)" },
+	[INF_SOFT_STOP_IDLE_CLOSED]          = { .name = "SoftStopIdleClosed",          .desc = "Total number of frontend connections actively closed (HTTP/1 idle connections) or asked to close (HTTP/2 GOAWAY) because of the soft-stop" },
+	[INF_SOFT_STOP_KAL_CLOSED]           = { .name = "SoftStopKalClosed",           .desc = "Total number of frontend HTTP/1 keep-alive transactions switched to close mode because of the soft-stop" },
 };
 
 const struct name_desc stat_fields[ST_F_TOTAL_FIELDS] = {
@@ -260,6 +268,7 @@ const struct name_desc stat_fields[ST_F_TOTAL_FIELDS] = {
 	[ST_F_NEED_CONN_EST]                 = { .name = "need_conn_est",               .desc = "Estimated needed number of connections"},
 	[ST_F_UWEIGHT]                       = { .name = "uweight",                     .desc = "Server's user weight, or sum of active servers' user weights for a backend" },
 	[ST_F_AGG_SRV_CHECK_STATUS]          = { .name = "agg_server_check_status",     .desc = "Backend's aggregated gauge of servers' state check status" },
+	[ST_F_HTX_DEFRAG]                    = { .name = "htx_defrag",                  .desc = "Total number of HTTP message defragmentations caused by the http rules of this frontend/backend since the worker process started" },
 };
 
 /* one line of info */
@@ -348,18 +357,20 @@ static const char *stats_scope_ptr(struct appctx *appctx, struct stconn *sc)
  * NOTE: Some tools happen to rely on the field position instead of its name,
  *       so please only append new fields at the end, never in the middle.
  */
-static void stats_dump_csv_header(enum stats_domain domain)
+static void stats_dump_csv_header(enum stats_domain domain,
+                                  const unsigned short *fields, int nb_fields)
 {
-	int field;
+	int field, i;
 
 	chunk_appendf(&trash, "# ");
 	if (stat_f[domain]) {
-		for (field = 0; field < stat_count[domain]; ++field) {
+		for (i = 0; i < (fields ? nb_fields : stat_count[domain]); ++i) {
+			field = fields ? fields[i] : i;
 			chunk_appendf(&trash, "%s,", stat_f[domain][field].name);
 
 			/* print special delimiter on proxy stats to mark end of
 			   static fields */
-			if (domain == STATS_DOMAIN_PROXY && field + 1 == ST_F_TOTAL_FIELDS)
+			if (!fields && domain == STATS_DOMAIN_PROXY && field + 1 == ST_F_TOTAL_FIELDS)
 				chunk_appendf(&trash, "-,");
 		}
 	}
@@ -574,23 +585,27 @@ int stats_emit_json_field_tags(struct buffer *out, const struct field *f)
 	return !(old_len == out->data);
 }
 
-/* Dump all fields from <stats> into <out> using CSV format */
+/* Dump all fields from <stats> into <out> using CSV format. If <fields> is not
+ * NULL, only its <nb_fields> fields are dumped, in this order.
+ */
 static int stats_dump_fields_csv(struct buffer *out,
                                  const struct field *stats, size_t stats_count,
                                  unsigned int flags,
-                                 enum stats_domain domain)
+                                 enum stats_domain domain,
+                                 const unsigned short *fields, int nb_fields)
 {
-	int field;
+	int field, i;
 
-	for (field = 0; field < stats_count; ++field) {
-		if (!stats_emit_raw_data_field(out, &stats[field]))
+	for (i = 0; i < (fields ? nb_fields : stats_count); ++i) {
+		field = fields ? fields[i] : i;
+		if (field < stats_count && !stats_emit_raw_data_field(out, &stats[field]))
 			return 0;
 		if (!chunk_strcat(out, ","))
 			return 0;
 
 		/* print special delimiter on proxy stats to mark end of
 		   static fields */
-		if (domain == STATS_DOMAIN_PROXY && field + 1 == ST_F_TOTAL_FIELDS) {
+		if (!fields && domain == STATS_DOMAIN_PROXY && field + 1 == ST_F_TOTAL_FIELDS) {
 			if (!chunk_strcat(out, "-,"))
 				return 0;
 		}
@@ -600,17 +615,22 @@ static int stats_dump_fields_csv(struct buffer *out,
 	return 1;
 }
 
-/* Dump all fields from <stats> into <out> using a typed "field:desc:type:value" format */
+/* Dump all fields from <stats> into <out> using a typed "field:desc:type:value"
+ * format. If <fields> is not NULL, only its <nb_fields> fields are dumped, in
+ * this order.
+ */
 static int stats_dump_fields_typed(struct buffer *out,
                                    const struct field *stats,
                                    size_t stats_count,
                                    unsigned int flags,
-                                   enum stats_domain domain)
+                                   enum stats_domain domain,
+                                   const unsigned short *fields, int nb_fields)
 {
-	int field;
+	int field, i;
 
-	for (field = 0; field < stats_count; ++field) {
-		if (!stats[field].type)
+	for (i = 0; i < (fields ? nb_fields : stats_count); ++i) {
+		field = fields ? fields[i] : i;
+		if (field >= stats_count || !stats[field].type)
 			continue;
 
 		switch (domain) {
@@ -741,13 +761,17 @@ static void stats_print_rslv_field_json(struct buffer *out,
 }
 
 
-/* Dump all fields from <stats> into <out> using a typed "field:desc:type:value" format */
+/* Dump all fields from <stats> into <out> using a typed "field:desc:type:value"
+ * format. If <fields> is not NULL, only its <nb_fields> fields are dumped, in
+ * this order.
+ */
 static int stats_dump_fields_json(struct buffer *out,
                                   const struct field *stats, size_t stats_count,
                                   unsigned int flags,
-                                  enum stats_domain domain)
+                                  enum stats_domain domain,
+                                  const unsigned short *fields, int nb_fields)
 {
-	int field;
+	int field, i;
 	int started = 0;
 
 	if ((flags & STAT_STARTED) && !chunk_strcat(out, ","))
@@ -755,10 +779,11 @@ static int stats_dump_fields_json(struct buffer *out,
 	if (!chunk_strcat(out, "["))
 		return 0;
 
-	for (field = 0; field < stats_count; field++) {
+	for (i = 0; i < (fields ? nb_fields : stats_count); i++) {
 		int old_len;
 
-		if (!stats[field].type)
+		field = fields ? fields[i] : i;
+		if (field >= stats_count || !stats[field].type)
 			continue;
 
 		if (started && !chunk_strcat(out, ","))
@@ -1625,11 +1650,14 @@ int stats_dump_one_line(const struct field *stats, size_t stats_count,
 	if (ctx->flags & STAT_FMT_HTML)
 		ret = stats_dump_fields_html(&trash, stats, ctx->flags);
 	else if (ctx->flags & STAT_FMT_TYPED)
-		ret = stats_dump_fields_typed(&trash, stats, stats_count, ctx->flags, ctx->domain);
+		ret = stats_dump_fields_typed(&trash, stats, stats_count, ctx->flags, ctx->domain,
+		                              ctx->fields, ctx->nb_fields);
 	else if (ctx->flags & STAT_FMT_JSON)
-		ret = stats_dump_fields_json(&trash, stats, stats_count, ctx->flags, ctx->domain);
+		ret = stats_dump_fields_json(&trash, stats, stats_count, ctx->flags, ctx->domain,
+		                             ctx->fields, ctx->nb_fields);
 	else
-		ret = stats_dump_fields_csv(&trash, stats, stats_count, ctx->flags, ctx->domain);
+		ret = stats_dump_fields_csv(&trash, stats, stats_count, ctx->flags, ctx->domain,
+		                            ctx->fields, ctx->nb_fields);
 
 	if (ret)
 		ctx->flags |= STAT_STARTED;
@@ -1637,6 +1665,58 @@ int stats_dump_one_line(const struct field *stats, size_t stats_count,
 	return ret;
 }
 
+/* The fields which are always filled when a projection is requested, because
+ * the typed and JSON formats use them to designate the object.
+ */
+static const enum stat_field stats_proj_id_fields[] = {
+	ST_F_PID, ST_F_IID, ST_F_SID, ST_F_TYPE,
+};
+
+/* Returns the <idx>th field to fill for the projection of <ctx>, or -1 once
+ * they were all returned. The fields identifying the object come first, then
+ * those of the projection.
+ */
+static int stats_proj_field(const struct show_stat_ctx *ctx, int idx)
+{
+	const int nb_id = sizeof(stats_proj_id_fields) / sizeof(*stats_proj_id_fields);
+
+	if (idx < nb_id)
+		return stats_proj_id_fields[idx];
+	if (idx < nb_id + ctx->nb_fields)
+		return ctx->fields[idx - nb_id];
+	return -1;
+}
+
+/* Resets in <stats> the fields which will be filled for the projection of
+ * <ctx>, as a cheaper alternative to clearing the whole array.
+ */
+static void stats_proj_reset(const struct show_stat_ctx *ctx, struct field *stats)
+{
+	int i;
+
+	for (i = 0; i < sizeof(stats_proj_id_fields) / sizeof(*stats_proj_id_fields); i++)
+		stats[stats_proj_id_fields[i]] = (struct field){ };
+	for (i = 0; i < ctx->nb_fields; i++)
+		stats[ctx->fields[i]] = (struct field){ };
+}
+
+/* Returns non-zero if any of the <count> fields starting at <first> must be
+ * dumped for <ctx>, which is always the case without projection.
+ */
+static int stats_proj_wants(const struct show_stat_ctx *ctx, int first, int count)
+{
+	int i;
+
+	if (!ctx->fields)
+		return 1;
+
+	for (i = 0; i < ctx->nb_fields; i++) {
+		if (ctx->fields[i] >= first && ctx->fields[i] < first + count)
+			return 1;
+	}
+	return 0;
+}
+
 /* Fill <stats> with the frontend statistics. <stats> is preallocated array of
  * length <len>. If <selected_field> is != NULL, only fill this one. The length
  * of the array must be at least ST_F_TOTAL_FIELDS. If this length is less than
@@ -1674,13 +1754,13 @@ int stats_fill_fe_stats(struct proxy *px, struct field *stats, int len,
 				metric = mkf_u32(FO_CONFIG|FN_LIMIT, px->maxconn);
 				break;
 			case ST_F_STOT:
-				metric = mkf_u64(FN_COUNTER, px->fe_counters.cum_sess);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->fe_counters, cum_sess));
 				break;
 			case ST_F_BIN:
-				metric = mkf_u64(FN_COUNTER, px->fe_counters.bytes_in);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->fe_counters, bytes_in));
 				break;
 			case ST_F_BOUT:
-				metric = mkf_u64(FN_COUNTER, px->fe_counters.bytes_out);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->fe_counters, bytes_out));
 				break;
 			case ST_F_DREQ:
 				metric = mkf_u64(FN_COUNTER, px->fe_counters.denied_req);
@@ -1738,27 +1818,27 @@ int stats_fill_fe_stats(struct proxy *px, struct field *stats, int len,
 				break;
 			case ST_F_HRSP_1XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->fe_counters.p.http.rsp[1]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->fe_counters, rsp[1]));
 				break;
 			case ST_F_HRSP_2XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->fe_counters.p.http.rsp[2]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->fe_counters, rsp[2]));
 				break;
 			case ST_F_HRSP_3XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->fe_counters.p.http.rsp[3]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->fe_counters, rsp[3]));
 				break;
 			case ST_F_HRSP_4XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->fe_counters.p.http.rsp[4]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->fe_counters, rsp[4]));
 				break;
 			case ST_F_HRSP_5XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->fe_counters.p.http.rsp[5]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->fe_counters, rsp[5]));
 				break;
 			case ST_F_HRSP_OTHER:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->fe_counters.p.http.rsp[0]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->fe_counters, rsp[0]));
 				break;
 			case ST_F_INTERCEPTED:
 				if (px->mode == PR_MODE_HTTP)
@@ -1772,6 +1852,10 @@ int stats_fill_fe_stats(struct proxy *px, struct field *stats, int len,
 				if (px->mode == PR_MODE_HTTP)
 					metric = mkf_u64(FN_COUNTER, px->fe_counters.p.http.cache_hits);
 				break;
+			case ST_F_HTX_DEFRAG:
+				if (px->mode == PR_MODE_HTTP)
+					metric = mkf_u64(FN_COUNTER, px->fe_counters.p.http.htx_defrags);
+				break;
 			case ST_F_REQ_RATE:
 				metric = mkf_u32(FN_RATE, read_freq_ctr(&px->fe_req_per_sec));
 				break;
@@ -1779,7 +1863,7 @@ int stats_fill_fe_stats(struct proxy *px, struct field *stats, int len,
 				metric = mkf_u32(FN_MAX, px->fe_counters.p.http.rps_max);
 				break;
 			case ST_F_REQ_TOT:
-				metric = mkf_u64(FN_COUNTER, px->fe_counters.p.http.cum_req);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->fe_counters, cum_req));
 				break;
 			case ST_F_COMP_IN:
 				metric = mkf_u64(FN_COUNTER, px->fe_counters.comp_in);
@@ -1800,7 +1884,7 @@ int stats_fill_fe_stats(struct proxy *px, struct field *stats, int len,
 				metric = mkf_u32(FN_MAX, px->fe_counters.cps_max);
 				break;
 			case ST_F_CONN_TOT:
-				metric = mkf_u64(FN_COUNTER, px->fe_counters.cum_conn);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->fe_counters, cum_conn));
 				break;
 			default:
 				/* not used for frontends. If a specific metric
@@ -1835,15 +1919,28 @@ static int stats_dump_fe_stats(struct stconn *sc, struct proxy *px)
 	if ((ctx->flags & STAT_BOUND) && !(ctx->type & (1 << STATS_TYPE_FE)))
 		return 0;
 
-	memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
+	if (ctx->fields) {
+		enum stat_field field;
+		int i;
 
-	if (!stats_fill_fe_stats(px, stats, ST_F_TOTAL_FIELDS, NULL))
-		return 0;
+		/* only fill the requested fields, unsupported ones are left empty */
+		stats_proj_reset(ctx, stats);
+		for (i = 0; (field = stats_proj_field(ctx, i)) != -1; i++) {
+			if (field < ST_F_TOTAL_FIELDS)
+				stats_fill_fe_stats(px, stats, ST_F_TOTAL_FIELDS, &field);
+		}
+	}
+	else {
+		memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
+		if (!stats_fill_fe_stats(px, stats, ST_F_TOTAL_FIELDS, NULL))
+			return 0;
+	}
 
 	list_for_each_entry(mod, &stats_module_list[STATS_DOMAIN_PROXY], list) {
 		void *counters;
 
-		if (!(stats_px_get_cap(mod->domain_flags) & STATS_PX_CAP_FE)) {
+		if (!(stats_px_get_cap(mod->domain_flags) & STATS_PX_CAP_FE) ||
+		    !stats_proj_wants(ctx, stats_count, mod->stats_count)) {
 			stats_count += mod->stats_count;
 			continue;
 		}
@@ -1899,13 +1996,13 @@ int stats_fill_li_stats(struct proxy *px, struct listener *l, int flags,
 				metric = mkf_u32(FO_CONFIG|FN_LIMIT, l->maxconn);
 				break;
 			case ST_F_STOT:
-				metric = mkf_u64(FN_COUNTER, l->counters->cum_conn);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(l->counters, cum_conn));
 				break;
 			case ST_F_BIN:
-				metric = mkf_u64(FN_COUNTER, l->counters->bytes_in);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(l->counters, bytes_in));
 				break;
 			case ST_F_BOUT:
-				metric = mkf_u64(FN_COUNTER, l->counters->bytes_out);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(l->counters, bytes_out));
 				break;
 			case ST_F_DREQ:
 				metric = mkf_u64(FN_COUNTER, l->counters->denied_req);
@@ -1997,16 +2094,28 @@ static int stats_dump_li_stats(struct stconn *sc, struct proxy *px, struct liste
 	struct stats_module *mod;
 	size_t stats_count = ST_F_TOTAL_FIELDS;
 
-	memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
+	if (ctx->fields) {
+		enum stat_field field;
+		int i;
 
-	if (!stats_fill_li_stats(px, l, ctx->flags, stats,
-				 ST_F_TOTAL_FIELDS, NULL))
-		return 0;
+		stats_proj_reset(ctx, stats);
+		for (i = 0; (field = stats_proj_field(ctx, i)) != -1; i++) {
+			if (field < ST_F_TOTAL_FIELDS)
+				stats_fill_li_stats(px, l, ctx->flags, stats, ST_F_TOTAL_FIELDS, &field);
+		}
+	}
+	else {
+		memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
+		if (!stats_fill_li_stats(px, l, ctx->flags, stats,
+					 ST_F_TOTAL_FIELDS, NULL))
+			return 0;
+	}
 
 	list_for_each_entry(mod, &stats_module_list[STATS_DOMAIN_PROXY], list) {
 		void *counters;
 
-		if (!(stats_px_get_cap(mod->domain_flags) & STATS_PX_CAP_LI)) {
+		if (!(stats_px_get_cap(mod->domain_flags) & STATS_PX_CAP_LI) ||
+		    !stats_proj_wants(ctx, stats_count, mod->stats_count)) {
 			stats_count += mod->stats_count;
 			continue;
 		}
@@ -2138,7 +2247,7 @@ int stats_fill_sv_stats(struct proxy *px, struct server *sv, int flags,
 	if (selected_field == NULL || *selected_field == ST_F_QTIME ||
 	    *selected_field == ST_F_CTIME || *selected_field == ST_F_RTIME ||
 	    *selected_field == ST_F_TTIME) {
-		srv_samples_counter = (px->mode == PR_MODE_HTTP) ? sv->counters.p.http.cum_req : sv->counters.cum_lbconn;
+		srv_samples_counter = (px->mode == PR_MODE_HTTP) ? COUNTERS_GET(&sv->counters, cum_req) : sv->counters.cum_lbconn;
 		if (srv_samples_counter < TIME_STATS_SAMPLES && srv_samples_counter > 0)
 			srv_samples_window = srv_samples_counter;
 	}
@@ -2180,13 +2289,13 @@ int stats_fill_sv_stats(struct proxy *px, struct server *sv, int flags,
 					metric = mkf_u32(FO_CONFIG|FN_LIMIT, sv->max_idle_conns);
 				break;
 			case ST_F_STOT:
-				metric = mkf_u64(FN_COUNTER, sv->counters.cum_sess);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&sv->counters, cum_sess));
 				break;
 			case ST_F_BIN:
-				metric = mkf_u64(FN_COUNTER, sv->counters.bytes_in);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&sv->counters, bytes_in));
 				break;
 			case ST_F_BOUT:
-				metric = mkf_u64(FN_COUNTER, sv->counters.bytes_out);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&sv->counters, bytes_out));
 				break;
 			case ST_F_DRESP:
 				metric = mkf_u64(FN_COUNTER, sv->counters.denied_resp);
@@ -2391,31 +2500,31 @@ int stats_fill_sv_stats(struct proxy *px, struct server *sv, int flags,
 				break;
 			case ST_F_REQ_TOT:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, sv->counters.p.http.cum_req);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&sv->counters, cum_req));
 				break;
 			case ST_F_HRSP_1XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, sv->counters.p.http.rsp[1]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&sv->counters, rsp[1]));
 				break;
 			case ST_F_HRSP_2XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, sv->counters.p.http.rsp[2]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&sv->counters, rsp[2]));
 				break;
 			case ST_F_HRSP_3XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, sv->counters.p.http.rsp[3]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&sv->counters, rsp[3]));
 				break;
 			case ST_F_HRSP_4XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, sv->counters.p.http.rsp[4]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&sv->counters, rsp[4]));
 				break;
 			case ST_F_HRSP_5XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, sv->counters.p.http.rsp[5]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&sv->counters, rsp[5]));
 				break;
 			case ST_F_HRSP_OTHER:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, sv->counters.p.http.rsp[0]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&sv->counters, rsp[0]));
 				break;
 			case ST_F_HANAFAIL:
 				if (ref->observe)
@@ -2509,11 +2618,22 @@ static int stats_dump_sv_stats(struct stconn *sc, struct proxy *px, struct serve
 	struct field *stats = stat_l[STATS_DOMAIN_PROXY];
 	size_t stats_count = ST_F_TOTAL_FIELDS;
 
-	memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
+	if (ctx->fields) {
+		enum stat_field field;
+		int i;
 
-	if (!stats_fill_sv_stats(px, sv, ctx->flags, stats,
-				 ST_F_TOTAL_FIELDS, NULL))
-		return 0;
+		stats_proj_reset(ctx, stats);
+		for (i = 0; (field = stats_proj_field(ctx, i)) != -1; i++) {
+			if (field < ST_F_TOTAL_FIELDS)
+				stats_fill_sv_stats(px, sv, ctx->flags, stats, ST_F_TOTAL_FIELDS, &field);
+		}
+	}
+	else {
+		memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
+		if (!stats_fill_sv_stats(px, sv, ctx->flags, stats,
+					 ST_F_TOTAL_FIELDS, NULL))
+			return 0;
+	}
 
 	list_for_each_entry(mod, &stats_module_list[STATS_DOMAIN_PROXY], list) {
 		void *counters;
@@ -2521,7 +2641,8 @@ static int stats_dump_sv_stats(struct stconn *sc, struct proxy *px, struct serve
 		if (stats_get_domain(mod->domain_flags) != STATS_DOMAIN_PROXY)
 			continue;
 
-		if (!(stats_px_get_cap(mod->domain_flags) & STATS_PX_CAP_SRV)) {
+		if (!(stats_px_get_cap(mod->domain_flags) & STATS_PX_CAP_SRV) ||
+		    !stats_proj_wants(ctx, stats_count, mod->stats_count)) {
 			stats_count += mod->stats_count;
 			continue;
 		}
@@ -2594,7 +2715,7 @@ int stats_fill_be_stats(struct proxy *px, int flags, struct field *stats, int le
 	if (selected_field == NULL || *selected_field == ST_F_QTIME ||
 	    *selected_field == ST_F_CTIME || *selected_field == ST_F_RTIME ||
 	    *selected_field == ST_F_TTIME) {
-		be_samples_counter = (px->mode == PR_MODE_HTTP) ? px->be_counters.p.http.cum_req : px->be_counters.cum_lbconn;
+		be_samples_counter = (px->mode == PR_MODE_HTTP) ? COUNTERS_GET(&px->be_counters, cum_req) : px->be_counters.cum_lbconn;
 		if (be_samples_counter < TIME_STATS_SAMPLES && be_samples_counter > 0)
 			be_samples_window = be_samples_counter;
 	}
@@ -2628,13 +2749,13 @@ int stats_fill_be_stats(struct proxy *px, int flags, struct field *stats, int le
 				metric = mkf_u32(FO_CONFIG|FN_LIMIT, px->fullconn);
 				break;
 			case ST_F_STOT:
-				metric = mkf_u64(FN_COUNTER, px->be_counters.cum_conn);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->be_counters, cum_conn));
 				break;
 			case ST_F_BIN:
-				metric = mkf_u64(FN_COUNTER, px->be_counters.bytes_in);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->be_counters, bytes_in));
 				break;
 			case ST_F_BOUT:
-				metric = mkf_u64(FN_COUNTER, px->be_counters.bytes_out);
+				metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->be_counters, bytes_out));
 				break;
 			case ST_F_DREQ:
 				metric = mkf_u64(FN_COUNTER, px->be_counters.denied_req);
@@ -2729,31 +2850,31 @@ int stats_fill_be_stats(struct proxy *px, int flags, struct field *stats, int le
 				break;
 			case ST_F_REQ_TOT:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->be_counters.p.http.cum_req);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->be_counters, cum_req));
 				break;
 			case ST_F_HRSP_1XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->be_counters.p.http.rsp[1]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->be_counters, rsp[1]));
 				break;
 			case ST_F_HRSP_2XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->be_counters.p.http.rsp[2]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->be_counters, rsp[2]));
 				break;
 			case ST_F_HRSP_3XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->be_counters.p.http.rsp[3]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->be_counters, rsp[3]));
 				break;
 			case ST_F_HRSP_4XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->be_counters.p.http.rsp[4]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->be_counters, rsp[4]));
 				break;
 			case ST_F_HRSP_5XX:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->be_counters.p.http.rsp[5]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->be_counters, rsp[5]));
 				break;
 			case ST_F_HRSP_OTHER:
 				if (px->mode == PR_MODE_HTTP)
-					metric = mkf_u64(FN_COUNTER, px->be_counters.p.http.rsp[0]);
+					metric = mkf_u64(FN_COUNTER, COUNTERS_GET(&px->be_counters, rsp[0]));
 				break;
 			case ST_F_CACHE_LOOKUPS:
 				if (px->mode == PR_MODE_HTTP)
@@ -2763,6 +2884,10 @@ int stats_fill_be_stats(struct proxy *px, int flags, struct field *stats, int le
 				if (px->mode == PR_MODE_HTTP)
 					metric = mkf_u64(FN_COUNTER, px->be_counters.p.http.cache_hits);
 				break;
+			case ST_F_HTX_DEFRAG:
+				if (px->mode == PR_MODE_HTTP)
+					metric = mkf_u64(FN_COUNTER, px->be_counters.p.http.htx_defrags);
+				break;
 			case ST_F_CLI_ABRT:
 				metric = mkf_u64(FN_COUNTER, px->be_counters.cli_aborts);
 				break;
@@ -2841,10 +2966,21 @@ static int stats_dump_be_stats(struct stconn *sc, struct proxy *px)
 	if ((ctx->flags & STAT_BOUND) && !(ctx->type & (1 << STATS_TYPE_BE)))
 		return 0;
 
-	memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
+	if (ctx->fields) {
+		enum stat_field field;
+		int i;
 
-	if (!stats_fill_be_stats(px, ctx->flags, stats, ST_F_TOTAL_FIELDS, NULL))
-		return 0;
+		stats_proj_reset(ctx, stats);
+		for (i = 0; (field = stats_proj_field(ctx, i)) != -1; i++) {
+			if (field < ST_F_TOTAL_FIELDS)
+				stats_fill_be_stats(px, ctx->flags, stats, ST_F_TOTAL_FIELDS, &field);
+		}
+	}
+	else {
+		memset(stats, 0, sizeof(struct field) * stat_count[STATS_DOMAIN_PROXY]);
+		if (!stats_fill_be_stats(px, ctx->flags, stats, ST_F_TOTAL_FIELDS, NULL))
+			return 0;
+	}
 
 	list_for_each_entry(mod, &stats_module_list[STATS_DOMAIN_PROXY], list) {
 		struct extra_counters *counters;
@@ -2852,7 +2988,8 @@ static int stats_dump_be_stats(struct stconn *sc, struct proxy *px)
 		if (stats_get_domain(mod->domain_flags) != STATS_DOMAIN_PROXY)
 			continue;
 
-		if (!(stats_px_get_cap(mod->domain_flags) & STATS_PX_CAP_BE)) {
+		if (!(stats_px_get_cap(mod->domain_flags) & STATS_PX_CAP_BE) ||
+		    !stats_proj_wants(ctx, stats_count, mod->stats_count)) {
 			stats_count += mod->stats_count;
 			continue;
 		}
@@ -3754,7 +3891,7 @@ static int stats_dump_stat_to_buffer(struct stconn *sc, struct htx *htx,
 		else if (ctx->flags & STAT_FMT_JSON)
 			stats_dump_json_header();
 		else if (!(ctx->flags & STAT_FMT_TYPED))
-			stats_dump_csv_header(ctx->domain);
+			stats_dump_csv_header(ctx->domain, ctx->fields, ctx->nb_fields);
 
 		if (!stats_putchk(rep, htx, &trash))
 			goto full;
@@ -4550,6 +4687,13 @@ int stats_fill_info(struct field *info, int len, uint flags)
 	info[INF_TAINTED]                        = mkf_str(FO_STATUS, chunk_newstr(out));
 	chunk_appendf(out, "%#x", get_tainted());
 
+	info[INF_LOG_BATCHES]                    = mkf_u32(FN_COUNTER, log_batches);
+	info[INF_LOG_BATCHED_DGRAMS]             = mkf_u64(FN_COUNTER, log_batched_dgrams);
+	info[INF_SRC_PORT_EXHAUSTED]             = mkf_u32(FN_COUNTER, tcp_sport_exhausted);
+	info[INF_SOFT_STOP_DURATION]             = mkf_u32(FN_DURATION, stopping ? date.tv_sec - soft_stop_date : 0);
+	info[INF_SOFT_STOP_IDLE_CLOSED]          = mkf_u32(FN_COUNTER, soft_stop_idle_closed);
+	info[INF_SOFT_STOP_KAL_CLOSED]           = mkf_u32(FN_COUNTER, soft_stop_kal_closed);
+
 	return 1;
 }
 
@@ -4825,8 +4969,8 @@ static int cli_parse_clear_counters(char **args, char *payload, struct appctx *a
 
 	for (px = proxies_list; px; px = px->next) {
 		if (clrall) {
-			memset(&px->be_counters, 0, sizeof(px->be_counters));
-			memset(&px->fe_counters, 0, sizeof(px->fe_counters));
+			COUNTERS_CLEAR(&px->be_counters);
+			COUNTERS_CLEAR(&px->fe_counters);
 		}
 		else {
 			px->be_counters.conn_max = 0;
@@ -4847,7 +4991,7 @@ static int cli_parse_clear_counters(char **args, char *payload, struct appctx *a
 
 		for (sv = px->srv; sv; sv = sv->next)
 			if (clrall)
-				memset(&sv->counters, 0, sizeof(sv->counters));
+				COUNTERS_CLEAR(&sv->counters);
 			else {
 				sv->counters.cur_sess_max = 0;
 				sv->counters.nbpend_max = 0;
@@ -4861,7 +5005,7 @@ static int cli_parse_clear_counters(char **args, char *payload, struct appctx *a
 		list_for_each_entry(li, &px->conf.listeners, by_fe)
 			if (li->counters) {
 				if (clrall)
-					memset(li->counters, 0, sizeof(*li->counters));
+					COUNTERS_CLEAR(li->counters);
 				else
 					li->counters->conn_max = 0;
 			}
@@ -4945,9 +5089,63 @@ static int cli_parse_show_info(char **args, char *payload, struct appctx *appctx
 }
 
 
+/* Parses the comma-separated list of field names <list> of the statistics
+ * domain of <ctx> and sets the projection of <ctx> accordingly. Returns 0 on
+ * success, or -1 with an error message in <err> and no projection, since the
+ * release callback is not called when the parsing fails.
+ */
+static int stats_parse_proj(struct show_stat_ctx *ctx, const char *list, char **err)
+{
+	const char *p, *end;
+	unsigned short *fields;
+	int nb, field;
+
+	for (nb = 1, p = list; *p; p++)
+		nb += *p == ',';
+
+	fields = realloc(ctx->fields, nb * sizeof(*fields));
+	if (!fields) {
+		memprintf(err, "out of memory.\n");
+		return -1;
+	}
+	ctx->fields = fields;
+	ctx->nb_fields = 0;
+
+	for (p = list; *p; p = *end ? end + 1 : end) {
+		end = strchr(p, ',');
+		if (!end)
+			end = p + strlen(p);
+		if (end == p)
+			continue;
+
+		for (field = 0; field < stat_count[ctx->domain]; field++) {
+			if (strncmp(stat_f[ctx->domain][field].name, p, end - p) == 0 &&
+			    !stat_f[ctx->domain][field].name[end - p])
+				break;
+		}
+
+		if (field == stat_count[ctx->domain]) {
+			memprintf(err, "unknown field '%.*s'.\n", (int)(end - p), p);
+			goto fail;
+		}
+		ctx->fields[ctx->nb_fields++] = field;
+	}
+
+	if (!ctx->nb_fields) {
+		memprintf(err, "no field specified.\n");
+		goto fail;
+	}
+	return 0;
+ fail:
+	ha_free(&ctx->fields);
+	ctx->nb_fields = 0;
+	return -1;
+}
+
 static int cli_parse_show_stat(char **args, char *payload, struct appctx *appctx, void *private)
 {
 	struct show_stat_ctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+	char *msg = NULL;
 	int arg = 2;
 
 	ctx->scope_str = 0;
@@ -5002,12 +5200,27 @@ static int cli_parse_show_stat(char **args, char *payload, struct appctx *appctx
 			ctx->flags |= STAT_HIDE_MAINT;
 		else if (strcmp(args[arg], "up") == 0)
 			ctx->flags |= STAT_HIDE_DOWN;
+		else if (strcmp(args[arg], "fields") == 0) {
+			if (!*args[arg+1])
+				return cli_err(appctx, "'fields' expects a comma-separated list of field names.\n");
+			if (stats_parse_proj(ctx, args[arg+1], &msg) < 0)
+				return cli_dynerr(appctx, msg);
+			arg++;
+		}
 		arg++;
 	}
 
 	return 0;
 }
 
+/* release the "show stat" context */
+static void cli_release_show_stat(struct appctx *appctx)
+{
+	struct show_stat_ctx *ctx = appctx->svcctx;
+
+	ha_free(&ctx->fields);
+}
+
 static int cli_io_handler_dump_info(struct appctx *appctx)
 {
 	return stats_dump_info_to_buffer(appctx_sc(appctx));
@@ -5264,7 +5477,7 @@ REGISTER_PER_THREAD_FREE(free_trash_counters);
 static struct cli_kw_list cli_kws = {{ },{
 	{ { "clear", "counters",  NULL },      "clear counters [all]                    : clear max statistics counters (or all counters)", cli_parse_clear_counters, NULL, NULL },
 	{ { "show", "info",  NULL },           "show info [desc|json|typed|float]*      : report information about the running process",    cli_parse_show_info, cli_io_handler_dump_info, NULL },
-	{ { "show", "stat",  NULL },           "show stat [desc|json|no-maint|typed|up]*: report counters for each proxy and server",       cli_parse_show_stat, cli_io_handler_dump_stat, NULL },
+	{ { "show", "stat",  NULL },           "show stat [desc|json|no-maint|typed|up|fields <f,...>]*: report counters for each proxy and server", cli_parse_show_stat, cli_io_handler_dump_stat, cli_release_show_stat },
 	{ { "show", "schema",  "json", NULL }, "show schema json                        : report schema used for stats",                    NULL, cli_io_handler_dump_json_schema, NULL },
 	{{},}
 }};
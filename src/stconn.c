@@ -14,6 +14,7 @@
 #include <haproxy/applet.h>
 #include <haproxy/connection.h>
 #include <haproxy/check.h>
+#include <haproxy/clock.h>
 #include <haproxy/http_ana.h>
 #include <haproxy/pipe.h>
 #include <haproxy/pool.h>
@@ -1402,8 +1403,12 @@ static int sc_conn_recv(struct stconn *sc)
 	}
 
 	/* now we'll need a input buffer for the stream */
-	if (!sc_alloc_ibuf(sc, &(__sc_strm(sc)->buffer_wait)))
+	if (!sc_alloc_ibuf(sc, &(__sc_strm(sc)->buffer_wait))) {
+		/* the time spent waiting is accounted by stream_buf_available() */
+		if (!__sc_strm(sc)->bufwait_date)
+			__sc_strm(sc)->bufwait_date = (uint32_t)now_mono_time() | 1;
 		goto end_recv;
+	}
 
 	/* For an HTX stream, if the buffer is stuck (no output data with some
 	 * input data) and if the HTX message is fragmented or if its free space
@@ -1667,7 +1672,7 @@ static int sc_conn_send(struct stconn *sc)
 	if (!conn->mux)
 		return 0;
 
-	if (oc->pipe && conn->xprt->snd_pipe && conn->mux->snd_pipe) {
+	if (oc->pipe && conn_xprt_can_snd_pipe(conn) && conn->mux->snd_pipe) {
 		ret = conn->mux->snd_pipe(sc, oc->pipe);
 		if (ret > 0)
 			did_send = 1;
@@ -13,6 +13,10 @@
 
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <import/ebmbtree.h>
 #include <import/ebsttree.h>
@@ -23,6 +27,7 @@
 #include <haproxy/arg.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/cli.h>
+#include <haproxy/clock.h>
 #include <haproxy/dict.h>
 #include <haproxy/errors.h>
 #include <haproxy/global.h>
@@ -88,13 +93,13 @@ struct stktable *stktable_find_by_name(const char *name)
 void __stksess_free(struct stktable *t, struct stksess *ts)
 {
 	HA_ATOMIC_DEC(&t->current);
-	pool_free(t->pool, (void *)ts - round_ptr_size(t->data_size));
+	pool_free(t->pool, (void *)ts - t->pfx_size);
 }
 
 /*
  * Free an allocated sticky session <ts>, and decrease sticky sessions counter
- * in table <t>.
- * This function locks the table
+ * in table <t>. The entry must not be present in the table anymore, so no
+ * lock is needed.
  */
 void stksess_free(struct stktable *t, struct stksess *ts)
 {
@@ -104,21 +109,45 @@ void stksess_free(struct stktable *t, struct stksess *ts)
 		dict_entry_unref(&server_key_dict, stktable_data_cast(data, std_t_dict));
 		stktable_data_cast(data, std_t_dict) = NULL;
 	}
-	HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &t->lock);
 	__stksess_free(t, ts);
-	HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &t->lock);
+}
+
+/* Detaches entry <ts> from the updates tree of table <t> if it is attached
+ * there. This tree is walked by the peers under the table's lock, and they
+ * may grab a reference on the entry while doing so, so the reference count
+ * has to be checked again under this lock. The caller must hold the entry's
+ * shard lock in write mode. Returns non-zero if the entry may be released,
+ * or zero if it got referenced in the mean time and must be kept.
+ */
+static int __stksess_unlink_upd(struct stktable *t, struct stksess *ts)
+{
+	int ret = 1;
+
+	if (!t->upd_ofs || !stksess_upd(t, ts)->node.leaf_p)
+		return ret;
+
+	HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &t->lock);
+	if (HA_ATOMIC_LOAD(&ts->ref_cnt))
+		ret = 0;
+	else
+		eb32_delete(stksess_upd(t, ts));
+	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &t->lock);
+	return ret;
 }
 
 /*
- * Kill an stksess (only if its ref_cnt is zero).
+ * Kill an stksess (only if its ref_cnt is zero). The caller must hold the
+ * entry's shard lock in write mode.
  */
 int __stksess_kill(struct stktable *t, struct stksess *ts)
 {
-	if (ts->ref_cnt)
+	if (HA_ATOMIC_LOAD(&ts->ref_cnt))
 		return 0;
 
-	eb32_delete(&ts->exp);
-	eb32_delete(&ts->upd);
+	if (!__stksess_unlink_upd(t, ts))
+		return 0;
+
+	eb32_delete(stksess_exp(t, ts));
 	ebmb_delete(&ts->key);
 	__stksess_free(t, ts);
 	return 1;
@@ -127,21 +156,60 @@ int __stksess_kill(struct stktable *t, struct stksess *ts)
 /*
  * Decrease the refcount if decrefcnt is not 0.
  * and try to kill the stksess
- * This function locks the table
+ * This function locks the entry's shard
  */
 int stksess_kill(struct stktable *t, struct stksess *ts, int decrefcnt)
 {
+	struct stktable_shard *shard = stksess_shard(t, ts);
 	int ret;
 
-	HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &t->lock);
+	HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
 	if (decrefcnt)
-		ts->ref_cnt--;
+		HA_ATOMIC_DEC(&ts->ref_cnt);
 	ret = __stksess_kill(t, ts);
-	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &t->lock);
+	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
 
 	return ret;
 }
 
+/* Returns the index of the shard of table <t> holding key <key> of length
+ * <len>. The length must be the one of the key as stored in the table, which
+ * for strings means without the trailing zero. The key is hashed using the
+ * same function and seed as the ones used for the peers shards.
+ */
+static inline unsigned int stktable_calc_shard_num(const struct stktable *t, const void *key, size_t len)
+{
+	if (t->nb_shards <= 1)
+		return 0;
+
+	return XXH64(key, len, t->hash_seed) % t->nb_shards;
+}
+
+/* returns the length of key <key> once stored into table <t> */
+static inline size_t stktable_key_len(const struct stktable *t, const struct stktable_key *key)
+{
+	if (t->type == SMP_T_STR)
+		return strnlen(key->key, MIN(key->key_len, t->key_size - 1));
+	return t->key_size;
+}
+
+/* returns the index of the shard of table <t> which holds key <key> */
+static inline unsigned int stktable_key_shard_num(const struct stktable *t, const struct stktable_key *key)
+{
+	return stktable_calc_shard_num(t, key->key, stktable_key_len(t, key));
+}
+
+/* returns the index of the shard of table <t> which holds the key of <ts> */
+static inline unsigned int stksess_key_shard_num(const struct stktable *t, const struct stksess *ts)
+{
+	size_t len = t->key_size;
+
+	if (t->type == SMP_T_STR)
+		len = strlen((const char *)ts->key.key);
+
+	return stktable_calc_shard_num(t, ts->key.key, len);
+}
+
 /*
  * Initialize or update the key in the sticky session <ts> present in table <t>
  * from the value present in <key>.
@@ -173,7 +241,8 @@ int stktable_get_key_shard(struct stktable *t, const void *key, size_t len)
 
 /*
  * Set the shard for <key> key of <ts> sticky session attached to <t> stick table.
- * Use zero for stick-table without peers synchronisation.
+ * Use zero for stick-table without peers synchronisation. The table shard the
+ * entry belongs to is set as well.
  */
 static void stksess_setkey_shard(struct stktable *t, struct stksess *ts,
                                  struct stktable_key *key)
@@ -186,6 +255,7 @@ static void stksess_setkey_shard(struct stktable *t, struct stksess *ts,
 		keylen = t->key_size;
 
 	ts->shard = stktable_get_key_shard(t, key->key, keylen);
+	ts->tbl_shard = stksess_key_shard_num(t, ts);
 }
 
 /*
@@ -197,29 +267,32 @@ static struct stksess *__stksess_init(struct stktable *t, struct stksess * ts)
 	memset((void *)ts - t->data_size, 0, t->data_size);
 	ts->ref_cnt = 0;
 	ts->shard = 0;
+	ts->tbl_shard = 0;
 	ts->key.node.leaf_p = NULL;
-	ts->exp.node.leaf_p = NULL;
-	ts->upd.node.leaf_p = NULL;
+	stksess_exp(t, ts)->node.leaf_p = NULL;
+	if (t->upd_ofs)
+		stksess_upd(t, ts)->node.leaf_p = NULL;
 	ts->expire = tick_add(now_ms, MS_TO_TICKS(t->expire));
 	HA_RWLOCK_INIT(&ts->lock);
 	return ts;
 }
 
 /*
- * Trash oldest <to_batch> sticky sessions from table <t>
+ * Trash oldest <to_batch> sticky sessions from shard <shard> of table <t>.
  * Returns number of trashed sticky sessions. It may actually trash less
  * than expected if finding these requires too long a search time (e.g.
- * most of them have ts->ref_cnt>0).
+ * most of them have ts->ref_cnt>0). The caller must hold the shard's lock
+ * in write mode.
  */
-int __stktable_trash_oldest(struct stktable *t, int to_batch)
+static int __stktable_trash_oldest(struct stktable *t, struct stktable_shard *shard, int to_batch)
 {
 	struct stksess *ts;
-	struct eb32_node *eb;
+	struct eb32_node *eb, *exp;
 	int max_search = to_batch * 2; // no more than 50% misses
 	int batched = 0;
 	int looped = 0;
 
-	eb = eb32_lookup_ge(&t->exps, now_ms - TIMER_LOOK_BACK);
+	eb = eb32_lookup_ge(&shard->exps, now_ms - TIMER_LOOK_BACK);
 
 	while (batched < to_batch) {
 
@@ -232,7 +305,7 @@ int __stktable_trash_oldest(struct stktable *t, int to_batch)
 			if (looped)
 				break;
 			looped = 1;
-			eb = eb32_first(&t->exps);
+			eb = eb32_first(&shard->exps);
 			if (likely(!eb))
 				break;
 		}
@@ -241,31 +314,36 @@ int __stktable_trash_oldest(struct stktable *t, int to_batch)
 			break;
 
 		/* timer looks expired, detach it from the queue */
-		ts = eb32_entry(eb, struct stksess, exp);
+		exp = eb;
+		ts = stksess_from_exp(t, exp);
 		eb = eb32_next(eb);
 
 		/* don't delete an entry which is currently referenced */
-		if (ts->ref_cnt)
+		if (HA_ATOMIC_LOAD(&ts->ref_cnt))
 			continue;
 
-		eb32_delete(&ts->exp);
+		eb32_delete(exp);
 
-		if (ts->expire != ts->exp.key) {
+		if (ts->expire != exp->key) {
 			if (!tick_isset(ts->expire))
 				continue;
 
-			ts->exp.key = ts->expire;
-			eb32_insert(&t->exps, &ts->exp);
+			exp->key = ts->expire;
+			eb32_insert(&shard->exps, exp);
 
-			if (!eb || eb->key > ts->exp.key)
-				eb = &ts->exp;
+			if (!eb || eb->key > exp->key)
+				eb = exp;
 
 			continue;
 		}
 
-		/* session expired, trash it */
+		/* session expired, trash it unless a peer just grabbed it */
+		if (!__stksess_unlink_upd(t, ts)) {
+			eb32_insert(&shard->exps, exp);
+			continue;
+		}
+
 		ebmb_delete(&ts->key);
-		eb32_delete(&ts->upd);
 		__stksess_free(t, ts);
 		batched++;
 	}
@@ -276,15 +354,22 @@ int __stktable_trash_oldest(struct stktable *t, int to_batch)
 /*
  * Trash oldest <to_batch> sticky sessions from table <t>
  * Returns number of trashed sticky sessions.
- * This function locks the table
+ * This function locks the table's shards one at a time, starting from a
+ * random one so that the purge does not always hit the same shards first.
  */
 int stktable_trash_oldest(struct stktable *t, int to_batch)
 {
-	int ret;
-
-	HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &t->lock);
-	ret = __stktable_trash_oldest(t, to_batch);
-	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &t->lock);
+	struct stktable_shard *shard;
+	unsigned int idx, start;
+	int ret = 0;
+
+	start = (t->nb_shards > 1) ? statistical_prng_range(t->nb_shards) : 0;
+	for (idx = 0; idx < t->nb_shards && ret < to_batch; idx++) {
+		shard = &t->shards[(start + idx) % t->nb_shards];
+		HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
+		ret += __stktable_trash_oldest(t, shard, to_batch - ret);
+		HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
+	}
 
 	return ret;
 }
@@ -313,7 +398,7 @@ struct stksess *stksess_new(struct stktable *t, struct stktable_key *key)
 
 	ts = pool_alloc(t->pool);
 	if (ts) {
-		ts = (void *)ts + round_ptr_size(t->data_size);
+		ts = (void *)ts + t->pfx_size;
 		__stksess_init(t, ts);
 		if (key) {
 			stksess_setkey(t, ts, key);
@@ -325,17 +410,19 @@ struct stksess *stksess_new(struct stktable *t, struct stktable_key *key)
 }
 
 /*
- * Looks in table <t> for a sticky session matching key <key>.
+ * Looks in shard <shard> of table <t> for a sticky session matching key <key>.
  * Returns pointer on requested sticky session or NULL if none was found.
+ * The caller must hold the shard's lock.
  */
-struct stksess *__stktable_lookup_key(struct stktable *t, struct stktable_key *key)
+static struct stksess *__stktable_lookup_key(struct stktable *t, struct stktable_shard *shard,
+                                             struct stktable_key *key)
 {
 	struct ebmb_node *eb;
 
 	if (t->type == SMP_T_STR)
-		eb = ebst_lookup_len(&t->keys, key->key, key->key_len+1 < t->key_size ? key->key_len : t->key_size-1);
+		eb = ebst_lookup_len(&shard->keys, key->key, key->key_len+1 < t->key_size ? key->key_len : t->key_size-1);
 	else
-		eb = ebmb_lookup(&t->keys, key->key, t->key_size);
+		eb = ebmb_lookup(&shard->keys, key->key, t->key_size);
 
 	if (unlikely(!eb)) {
 		/* no session found */
@@ -349,33 +436,36 @@ struct stksess *__stktable_lookup_key(struct stktable *t, struct stktable_key *k
  * Looks in table <t> for a sticky session matching key <key>.
  * Returns pointer on requested sticky session or NULL if none was found.
  * The refcount of the found entry is increased and this function
- * is protected using the table lock
+ * is protected using the lock of the shard holding the key.
  */
 struct stksess *stktable_lookup_key(struct stktable *t, struct stktable_key *key)
 {
+	struct stktable_shard *shard = &t->shards[stktable_key_shard_num(t, key)];
 	struct stksess *ts;
 
-	HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &t->lock);
-	ts = __stktable_lookup_key(t, key);
+	HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &shard->lock);
+	ts = __stktable_lookup_key(t, shard, key);
 	if (ts)
 		HA_ATOMIC_INC(&ts->ref_cnt);
-	HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &t->lock);
+	HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &shard->lock);
 
 	return ts;
 }
 
 /*
- * Looks in table <t> for a sticky session with same key as <ts>.
- * Returns pointer on requested sticky session or NULL if none was found.
+ * Looks in shard <shard> of table <t> for a sticky session with same key as
+ * <ts>. Returns pointer on requested sticky session or NULL if none was found.
+ * The caller must hold the shard's lock.
  */
-struct stksess *__stktable_lookup(struct stktable *t, struct stksess *ts)
+static struct stksess *__stktable_lookup(struct stktable *t, struct stktable_shard *shard,
+                                         struct stksess *ts)
 {
 	struct ebmb_node *eb;
 
 	if (t->type == SMP_T_STR)
-		eb = ebst_lookup(&(t->keys), (char *)ts->key.key);
+		eb = ebst_lookup(&(shard->keys), (char *)ts->key.key);
 	else
-		eb = ebmb_lookup(&(t->keys), ts->key.key, t->key_size);
+		eb = ebmb_lookup(&(shard->keys), ts->key.key, t->key_size);
 
 	if (unlikely(!eb))
 		return NULL;
@@ -387,17 +477,18 @@ struct stksess *__stktable_lookup(struct stktable *t, struct stksess *ts)
  * Looks in table <t> for a sticky session with same key as <ts>.
  * Returns pointer on requested sticky session or NULL if none was found.
  * The refcount of the found entry is increased and this function
- * is protected using the table lock
+ * is protected using the lock of the shard holding the key.
  */
 struct stksess *stktable_lookup(struct stktable *t, struct stksess *ts)
 {
+	struct stktable_shard *shard = &t->shards[stksess_key_shard_num(t, ts)];
 	struct stksess *lts;
 
-	HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &t->lock);
-	lts = __stktable_lookup(t, ts);
+	HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &shard->lock);
+	lts = __stktable_lookup(t, shard, ts);
 	if (lts)
 		HA_ATOMIC_INC(&lts->ref_cnt);
-	HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &t->lock);
+	HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &shard->lock);
 
 	return lts;
 }
@@ -420,8 +511,10 @@ void stktable_touch_with_exp(struct stktable *t, struct stksess *ts, int local,
 		stktable_requeue_exp(t, ts);
 	}
 
-	/* If sync is enabled */
+	/* If sync is enabled (the table then has an update node) */
 	if (t->sync_task) {
+		struct eb32_node *upd = stksess_upd(t, ts);
+
 		if (local) {
 			/* If this entry is not in the tree
 			 * or not scheduled for at least one peer.
@@ -429,16 +522,16 @@ void stktable_touch_with_exp(struct stktable *t, struct stksess *ts, int local,
 			if (!locked++)
 				HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &t->lock);
 
-			if (!ts->upd.node.leaf_p
-			    || (int)(t->commitupdate - ts->upd.key) >= 0
-			    || (int)(ts->upd.key - t->localupdate) >= 0) {
-				ts->upd.key = ++t->update;
+			if (!upd->node.leaf_p
+			    || (int)(t->commitupdate - upd->key) >= 0
+			    || (int)(upd->key - t->localupdate) >= 0) {
+				upd->key = ++t->update;
 				t->localupdate = t->update;
-				eb32_delete(&ts->upd);
-				eb = eb32_insert(&t->updates, &ts->upd);
-				if (eb != &ts->upd)  {
+				eb32_delete(upd);
+				eb = eb32_insert(&t->updates, upd);
+				if (eb != upd)  {
 					eb32_delete(eb);
-					eb32_insert(&t->updates, &ts->upd);
+					eb32_insert(&t->updates, upd);
 				}
 			}
 			task_wakeup(t->sync_task, TASK_WOKEN_MSG);
@@ -448,26 +541,19 @@ void stktable_touch_with_exp(struct stktable *t, struct stksess *ts, int local,
 			if (!locked++)
 				HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &t->lock);
 
-			if (!ts->upd.node.leaf_p) {
-				ts->upd.key= (++t->update)+(2147483648U);
-				eb = eb32_insert(&t->updates, &ts->upd);
-				if (eb != &ts->upd) {
+			if (!upd->node.leaf_p) {
+				upd->key= (++t->update)+(2147483648U);
+				eb = eb32_insert(&t->updates, upd);
+				if (eb != upd) {
 					eb32_delete(eb);
-					eb32_insert(&t->updates, &ts->upd);
+					eb32_insert(&t->updates, upd);
 				}
 			}
 		}
 	}
 
-	if (decrefcnt) {
-		if (locked)
-			ts->ref_cnt--;
-		else {
-			HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &t->lock);
-			HA_ATOMIC_DEC(&ts->ref_cnt);
-			HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &t->lock);
-		}
-	}
+	if (decrefcnt)
+		HA_ATOMIC_DEC(&ts->ref_cnt);
 
 	if (locked)
 		HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &t->lock);
@@ -497,49 +583,66 @@ void stktable_touch_local(struct stktable *t, struct stksess *ts, int decrefcnt)
 	stktable_touch_with_exp(t, ts, 1, expire, decrefcnt);
 }
 /* Just decrease the ref_cnt of the current session. Does nothing if <ts> is NULL.
- * Note that we still need to take the read lock because a number of other places
- * (including in Lua and peers) update the ref_cnt non-atomically under the write
- * lock.
+ * The ref_cnt is always updated atomically and an entry is only killed when it
+ * drops to zero under its shard's write lock, so no lock is needed here.
  */
 static void stktable_release(struct stktable *t, struct stksess *ts)
 {
 	if (!ts)
 		return;
-	HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &t->lock);
 	HA_ATOMIC_DEC(&ts->ref_cnt);
-	HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &t->lock);
 }
 
 /* Insert new sticky session <ts> in the table. It is assumed that it does not
- * yet exist (the caller must check this). The table's timeout is updated if it
- * is set. <ts> is returned if properly inserted, otherwise the one already
- * present if any.
+ * yet exist (the caller must check this). The entry's shard must already be
+ * known and its lock held in write mode by the caller. The table's timeout is
+ * updated if it is set. <ts> is returned if properly inserted, otherwise the
+ * one already present if any.
  */
 struct stksess *__stktable_store(struct stktable *t, struct stksess *ts)
 {
+	struct stktable_shard *shard = stksess_shard(t, ts);
 	struct ebmb_node *eb;
 
-	eb = ebmb_insert(&t->keys, &ts->key, t->key_size);
+	eb = ebmb_insert(&shard->keys, &ts->key, t->key_size);
 	if (likely(eb == &ts->key)) {
-		ts->exp.key = ts->expire;
-		eb32_insert(&t->exps, &ts->exp);
+		struct eb32_node *exp = stksess_exp(t, ts);
+
+		exp->key = ts->expire;
+		eb32_insert(&shard->exps, exp);
 	}
 	return ebmb_entry(eb, struct stksess, key); // most commonly this is <ts>
 }
 
+/* Returns the tolerance, in ticks, on the wakeup date of the expiration task
+ * of table <t>. The task may run up to that late after the first entry
+ * expires, which lets it purge more entries at once and saves requeuing it
+ * each time an entry is added slightly before the current wakeup date. It is
+ * 1/64 of the table's expiration delay, bounded to one second.
+ */
+static inline int stktable_exp_tolerance(const struct stktable *t)
+{
+	return MIN(MS_TO_TICKS(t->expire) >> 6, MS_TO_TICKS(1000));
+}
+
 /* requeues the table's expiration task to take the recently added <ts> into
- * account. This is performed atomically and doesn't require any lock.
+ * account. This is performed atomically and doesn't require any lock. Nothing
+ * is done when the task is already due to run within the table's expiration
+ * tolerance after <ts> expires, which is by far the most common case.
  */
 void stktable_requeue_exp(struct stktable *t, const struct stksess *ts)
 {
 	int old_exp, new_exp;
 	int expire = ts->expire;
 
-	if (!t->expire)
+	if (!t->expire || !tick_isset(expire))
 		return;
 
-	/* set the task's expire to the newest expiration date. */
+	/* set the task's expire to the newest expiration date, plus the
+	 * tolerance so that neighbouring entries are purged together.
+	 */
 	old_exp = HA_ATOMIC_LOAD(&t->exp_task->expire);
+	expire = tick_add(expire, stktable_exp_tolerance(t));
 	new_exp = tick_first(expire, old_exp);
 
 	/* let's not go further if we're already up to date */
@@ -559,22 +662,116 @@ void stktable_requeue_exp(struct stktable *t, const struct stksess *ts)
 	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &t->lock);
 }
 
+/* Starts a new period in sketch <sk> if the current one is over. The rows of
+ * the previous period are cleared and become the current ones, and both sets
+ * are cleared if more than one period elapsed. Only one thread does this, the
+ * other ones may still update the old rows meanwhile, which only affects the
+ * estimates marginally.
+ */
+static void stktable_sketch_rotate(struct stktable_sketch *sk)
+{
+	size_t rows = STKTABLE_SKETCH_DEPTH * (size_t)sk->width;
+	unsigned int date, next;
+
+	if (!tick_is_expired(tick_add(HA_ATOMIC_LOAD(&sk->date), MS_TO_TICKS(sk->period)), now_ms))
+		return;
+
+	if (HA_SPIN_TRYLOCK(STK_TABLE_LOCK, &sk->lock) != 0)
+		return;
+
+	date = sk->date;
+	if (tick_is_expired(tick_add(date, MS_TO_TICKS(sk->period)), now_ms)) {
+		next = sk->curr ^ 1;
+		if (tick_is_expired(tick_add(date, MS_TO_TICKS(2 * sk->period)), now_ms)) {
+			memset(sk->cnt + sk->curr * rows, 0, rows * sizeof(*sk->cnt));
+			date = tick_add(now_ms, 0);
+		}
+		else
+			date = tick_add(date, MS_TO_TICKS(sk->period));
+
+		memset(sk->cnt + next * rows, 0, rows * sizeof(*sk->cnt));
+		HA_ATOMIC_STORE(&sk->curr, next);
+		HA_ATOMIC_STORE(&sk->date, date);
+	}
+	HA_SPIN_UNLOCK(STK_TABLE_LOCK, &sk->lock);
+}
+
+/* Accounts <inc> events for key <key> in the sketch of table <t>, which must
+ * be enabled, and returns the estimated number of events for this key over
+ * the last period, including these ones. As with any count-min sketch, the
+ * estimate may be over-evaluated but never under-evaluated. With a null <inc>
+ * the sketch is only consulted. No lock is needed.
+ */
+unsigned int stktable_sketch_update(struct stktable *t, struct stktable_key *key, unsigned int inc)
+{
+	struct stktable_sketch *sk = &t->sketch;
+	size_t rows = STKTABLE_SKETCH_DEPTH * (size_t)sk->width;
+	unsigned long long est = ~0U, cnt;
+	unsigned int *curr, *prev;
+	unsigned int elapsed, remain, row, pos, idx;
+	uint64_t hash;
+
+	stktable_sketch_rotate(sk);
+
+	idx = HA_ATOMIC_LOAD(&sk->curr);
+	curr = sk->cnt + idx * rows;
+	prev = sk->cnt + (idx ^ 1) * rows;
+
+	/* the previous period's counts are weighted by the part of it which
+	 * is still covered by a sliding period ending now, like freq_ctr.
+	 */
+	elapsed = TICKS_TO_MS(now_ms - HA_ATOMIC_LOAD(&sk->date));
+	remain = (elapsed < sk->period) ? sk->period - elapsed : 0;
+
+	/* the rows' positions are derived from two halves of the same hash.
+	 * The seed differs from the shards' one so that all the keys of a
+	 * shard do not end up in the same columns.
+	 */
+	hash = XXH64(key->key, stktable_key_len(t, key), ~t->hash_seed);
+
+	for (row = 0; row < STKTABLE_SKETCH_DEPTH; row++) {
+		pos = row * sk->width + (((uint32_t)hash + row * ((uint32_t)(hash >> 32) | 1)) & (sk->width - 1));
+		cnt = inc ? HA_ATOMIC_ADD_FETCH(&curr[pos], inc) : HA_ATOMIC_LOAD(&curr[pos]);
+		cnt += (unsigned long long)HA_ATOMIC_LOAD(&prev[pos]) * remain / sk->period;
+		if (cnt < est)
+			est = cnt;
+	}
+	return est;
+}
+
 /* Returns a valid or initialized stksess for the specified stktable_key in the
  * specified table, or NULL if the key was NULL, or if no entry was found nor
- * could be created. The entry's expiration is updated. This function locks the
- * table, and the refcount of the entry is increased.
+ * could be created. When the table has a sketch, a missing entry is only
+ * created once the key's estimated number of events over the sketch's period
+ * reaches the promotion threshold. The entry's expiration is updated. This
+ * function locks the shard holding the key, and the refcount of the entry is
+ * increased.
  */
 struct stksess *stktable_get_entry(struct stktable *table, struct stktable_key *key)
 {
+	struct stktable_shard *shard;
 	struct stksess *ts, *ts2;
+	unsigned int shard_num;
 
 	if (!key)
 		return NULL;
 
-	ts = stktable_lookup_key(table, key);
+	shard_num = stktable_key_shard_num(table, key);
+	shard = &table->shards[shard_num];
+
+	HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &shard->lock);
+	ts = __stktable_lookup_key(table, shard, key);
+	if (ts)
+		HA_ATOMIC_INC(&ts->ref_cnt);
+	HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &shard->lock);
 	if (ts)
 		return ts;
 
+	/* keys not seen often enough are only accounted in the sketch */
+	if (table->sketch.cnt &&
+	    stktable_sketch_update(table, key, 1) < table->sketch.promote)
+		return NULL;
+
 	/* No such entry exists, let's try to create a new one. this doesn't
 	 * require locking yet.
 	 */
@@ -591,7 +788,7 @@ struct stksess *stktable_get_entry(struct stktable *table, struct stktable_key *
 	 * one we find.
 	 */
 
-	HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &table->lock);
+	HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
 
 	ts2 = __stktable_store(table, ts);
 	if (unlikely(ts2 != ts)) {
@@ -603,136 +800,909 @@ struct stksess *stktable_get_entry(struct stktable *table, struct stktable_key *
 	}
 
 	HA_ATOMIC_INC(&ts->ref_cnt);
-	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &table->lock);
+	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
 
 	stktable_requeue_exp(table, ts);
 	return ts;
 }
 
 /* Lookup for an entry with the same key and store the submitted
- * stksess if not found. This function locks the table either shared or
- * exclusively, and the refcount of the entry is increased.
+ * stksess if not found. This function locks the shard holding the key
+ * either shared or exclusively, and the refcount of the entry is increased.
  */
 struct stksess *stktable_set_entry(struct stktable *table, struct stksess *nts)
 {
+	struct stktable_shard *shard;
 	struct stksess *ts;
 
-	HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &table->lock);
-	ts = __stktable_lookup(table, nts);
+	nts->tbl_shard = stksess_key_shard_num(table, nts);
+	shard = stksess_shard(table, nts);
+
+	HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &shard->lock);
+	ts = __stktable_lookup(table, shard, nts);
 	if (ts) {
 		HA_ATOMIC_INC(&ts->ref_cnt);
-		HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &table->lock);
+		HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &shard->lock);
 		return ts;
 	}
-	ts = nts;
-
-	/* let's increment it before switching to exclusive */
-	HA_ATOMIC_INC(&ts->ref_cnt);
 
-	if (HA_RWLOCK_TRYRDTOSK(STK_TABLE_LOCK, &table->lock) != 0) {
+	if (HA_RWLOCK_TRYRDTOSK(STK_TABLE_LOCK, &shard->lock) != 0) {
 		/* upgrade to seek lock failed, let's drop and take */
-		HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &table->lock);
-		HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &table->lock);
+		HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &shard->lock);
+		HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
 	}
 	else
-		HA_RWLOCK_SKTOWR(STK_TABLE_LOCK, &table->lock);
+		HA_RWLOCK_SKTOWR(STK_TABLE_LOCK, &shard->lock);
 
-	/* now we're write-locked */
-
-	__stktable_store(table, ts);
-	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &table->lock);
+	/* now we're write-locked. The lock may have been released in the mean
+	 * time, so another entry might have been inserted and we must switch
+	 * to it in this case.
+	 */
+	ts = __stktable_store(table, nts);
+	HA_ATOMIC_INC(&ts->ref_cnt);
+	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
 
 	stktable_requeue_exp(table, ts);
 	return ts;
 }
 
 /*
- * Task processing function to trash expired sticky sessions. A pointer to the
- * task itself is returned since it never dies.
+ * Task processing function to trash expired sticky sessions. The table's
+ * shards are visited one at a time, each under its own lock. This lock is
+ * released every STKTABLE_EXPIRE_BATCH entries so that other threads do not
+ * wait too long for it, and the task yields after visiting
+ * STKTABLE_EXPIRE_BUDGET entries. A pointer to the task itself is returned
+ * since it never dies.
  */
 struct task *process_table_expire(struct task *task, void *context, unsigned int state)
 {
 	struct stktable *t = context;
+	struct stktable_shard *shard;
 	struct stksess *ts;
-	struct eb32_node *eb;
-	int looped = 0;
-	int exp_next;
+	struct eb32_node *eb, *exp;
+	unsigned int shard_num;
+	int exp_next = TICK_ETERNITY;
+	int budget = STKTABLE_EXPIRE_BUDGET;
+	int looped, batch;
+	int yield = 0;
+
+	for (shard_num = 0; shard_num < t->nb_shards && !yield; shard_num++) {
+		shard = &t->shards[shard_num];
+		looped = 0;
+		batch = 0;
+
+		HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
+		eb = eb32_lookup_ge(&shard->exps, now_ms - TIMER_LOOK_BACK);
+
+		while (1) {
+			if (unlikely(!eb)) {
+				/* we might have reached the end of the tree, typically because
+				 * <now_ms> is in the first half and we're first scanning the last
+				 * half. Let's loop back to the beginning of the tree now if we
+				 * have not yet visited it.
+				 */
+				if (looped)
+					break;
+				looped = 1;
+				eb = eb32_first(&shard->exps);
+				if (likely(!eb))
+					break;
+			}
 
-	HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &t->lock);
-	eb = eb32_lookup_ge(&t->exps, now_ms - TIMER_LOOK_BACK);
+			if (likely(tick_is_lt(now_ms, eb->key))) {
+				/* timer not expired yet, revisit it later */
+				exp_next = tick_first(exp_next, eb->key);
+				break;
+			}
 
-	while (1) {
-		if (unlikely(!eb)) {
-			/* we might have reached the end of the tree, typically because
-			 * <now_ms> is in the first half and we're first scanning the last
-			 * half. Let's loop back to the beginning of the tree now if we
-			 * have not yet visited it.
-			 */
-			if (looped)
+			if (unlikely(batch >= STKTABLE_EXPIRE_BATCH)) {
+				/* let other threads access the shard for a while,
+				 * then resume from the current node's key since the
+				 * node itself may vanish in the mean time. Only
+				 * entries leaving this position are counted so that
+				 * this always makes progress.
+				 */
+				unsigned int key = eb->key;
+
+				budget -= batch;
+				batch = 0;
+				if (budget <= 0) {
+					/* too many entries for this round */
+					yield = 1;
+					break;
+				}
+				HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
+				HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
+				eb = eb32_lookup_ge(&shard->exps, key);
+				continue;
+			}
+
+			/* timer looks expired, detach it from the queue */
+			exp = eb;
+			ts = stksess_from_exp(t, exp);
+			eb = eb32_next(eb);
+
+			/* don't delete an entry which is currently referenced */
+			if (HA_ATOMIC_LOAD(&ts->ref_cnt))
+				continue;
+
+			eb32_delete(exp);
+
+			if (!tick_is_expired(ts->expire, now_ms)) {
+				batch++;
+				if (!tick_isset(ts->expire))
+					continue;
+
+				exp->key = ts->expire;
+				eb32_insert(&shard->exps, exp);
+
+				if (!eb || eb->key > exp->key)
+					eb = exp;
+				continue;
+			}
+
+			/* session expired, trash it unless a peer just grabbed it */
+			if (!__stksess_unlink_upd(t, ts)) {
+				eb32_insert(&shard->exps, exp);
+				continue;
+			}
+
+			ebmb_delete(&ts->key);
+			__stksess_free(t, ts);
+			batch++;
+		}
+
+		HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
+	}
+
+	if (yield) {
+		/* the budget was exhausted, other tasks must be given a chance
+		 * to run before we process the remaining entries.
+		 */
+		task->expire = TICK_ETERNITY;
+		task_wakeup(task, TASK_WOKEN_OTHER);
+		return task;
+	}
+
+	/* delay the next run a little bit so that entries expiring close to
+	 * each other are purged at once.
+	 */
+	if (tick_isset(exp_next))
+		exp_next = tick_add(exp_next, stktable_exp_tolerance(t));
+	task->expire = exp_next;
+	return task;
+}
+
+/* Reserves in the entries of table <t> the room needed to store the share of
+ * each peer of its peers section in every element of the counters stored in
+ * the table, so that these counters can be summed across the peers. Must be
+ * called before the table's pool is created.
+ */
+static void stktable_alloc_sum_shares(struct stktable *t)
+{
+	unsigned int nb_elem = 0;
+	int type;
+
+	for (type = 0; type < STKTABLE_DATA_TYPES; type++) {
+		if (!t->data_ofs[type] || !stktable_data_types[type].is_counter)
+			continue;
+		t->sum_idx[type] = nb_elem;
+		nb_elem += t->data_nbelem[type];
+	}
+
+	if (!nb_elem)
+		return;
+
+	/* the shares are placed first and aligned since the data area ends on ts */
+	t->sum_slots = t->peers.p->count;
+	t->data_size = round_ptr_size(t->data_size + nb_elem * t->sum_slots * sizeof(unsigned long long));
+	t->sum_ofs   = -t->data_size;
+}
+
+/* Returns the sum of the shares of all peers in element <idx> of counter <type>
+ * of entry <ts>. The slot of the local peer is never used so it remains zero.
+ * The entry's lock must be held.
+ */
+static unsigned long long stktable_sum_remote_shares(struct stktable *t, struct stksess *ts,
+                                                     int type, unsigned int idx)
+{
+	unsigned long long *share = (unsigned long long *)((void *)ts + t->sum_ofs) +
+	                            (t->sum_idx[type] + idx) * t->sum_slots;
+	unsigned long long sum = 0;
+	int slot;
+
+	for (slot = 0; slot < t->sum_slots; slot++)
+		sum += share[slot];
+	return sum;
+}
+
+/* Returns the local share of element <idx> of counter <type> of entry <ts>
+ * whose current value is <value>, which is the part of this value which was
+ * not learned from the peers. This is what is sent to the peers for summed
+ * counters. It is zero if the counter was reset below the peers' shares. The
+ * entry's lock must be held.
+ */
+unsigned long long stktable_sum_local_share(struct stktable *t, struct stksess *ts,
+                                            int type, unsigned int idx, unsigned long long value)
+{
+	unsigned long long remote = stktable_sum_remote_shares(t, ts, type, idx);
+
+	return value > remote ? value - remote : 0;
+}
+
+/* Records <share> as the share of the peer at slot <slot> in element <idx> of
+ * counter <type> of entry <ts> whose current value is <value>, and returns the
+ * new value of this element, which is the local share plus the peers' ones. A
+ * negative <slot> designates the local share itself, which is what an old
+ * process teaches on reload. The entry's lock must be held in write mode.
+ */
+unsigned long long stktable_sum_update(struct stktable *t, struct stksess *ts, int type,
+                                       unsigned int idx, int slot, unsigned long long value,
+                                       unsigned long long share)
+{
+	unsigned long long *shares = (unsigned long long *)((void *)ts + t->sum_ofs) +
+	                             (t->sum_idx[type] + idx) * t->sum_slots;
+	unsigned long long local;
+
+	if (slot < 0)
+		return share + stktable_sum_remote_shares(t, ts, type, idx);
+
+	local = stktable_sum_local_share(t, ts, type, idx, value);
+	shares[slot] = share;
+	return local + stktable_sum_remote_shares(t, ts, type, idx);
+}
+
+/* The "gcra" data type implements a token bucket of <cnt> tokens refilled at
+ * the rate of <cnt> tokens per <period>, using the Generic Cell Rate Algorithm.
+ * Only the theoretical arrival time (TAT) of the next token is stored, in
+ * microseconds of wall-clock time so that it is meaningful to the peers. A TAT
+ * in the past means that the bucket is full, and each token moves it forward by
+ * the emission interval (period/cnt). A token may be taken as long as the TAT
+ * does not go further than one period in the future. Since a single 64-bit
+ * value is involved, it is updated using atomic operations only, without
+ * taking the entry's lock.
+ */
+static inline unsigned long long stktable_gcra_now()
+{
+	return (unsigned long long)date.tv_sec * 1000000 + date.tv_usec;
+}
+
+/* Returns the emission interval of the gcra data type of table <t> in
+ * microseconds. It is never zero.
+ */
+static inline unsigned long long stktable_gcra_interval(const struct stktable *t)
+{
+	unsigned long long interval;
+
+	interval = (unsigned long long)t->data_arg[STKTABLE_DT_GCRA].rate.period * 1000 /
+	           t->data_arg[STKTABLE_DT_GCRA].rate.cnt;
+	return interval ? interval : 1;
+}
+
+/* Returns the number of tokens currently available in the gcra value pointed
+ * to by <ptr> for table <t>.
+ */
+unsigned int stktable_gcra_tokens(const struct stktable *t, void *ptr)
+{
+	unsigned long long window = (unsigned long long)t->data_arg[STKTABLE_DT_GCRA].rate.period * 1000;
+	unsigned long long now = stktable_gcra_now();
+	unsigned long long tat = HA_ATOMIC_LOAD(&stktable_data_cast(ptr, std_t_ull));
+
+	if (tat <= now)
+		return t->data_arg[STKTABLE_DT_GCRA].rate.cnt;
+	if (tat - now >= window)
+		return 0;
+	return MIN((window - (tat - now)) / stktable_gcra_interval(t),
+	           t->data_arg[STKTABLE_DT_GCRA].rate.cnt);
+}
+
+/* Tries to take <cost> tokens from the gcra value pointed to by <ptr> for table
+ * <t>. Returns non-zero if they were taken, otherwise zero, in which case the
+ * bucket is left untouched.
+ */
+int stktable_gcra_take(const struct stktable *t, void *ptr, unsigned int cost)
+{
+	unsigned long long window = (unsigned long long)t->data_arg[STKTABLE_DT_GCRA].rate.period * 1000;
+	unsigned long long now = stktable_gcra_now();
+	unsigned long long *tat = &stktable_data_cast(ptr, std_t_ull);
+	unsigned long long old, new;
+
+	old = HA_ATOMIC_LOAD(tat);
+	do {
+		new = MAX(old, now) + cost * stktable_gcra_interval(t);
+		if (new - now > window)
+			return 0;
+	} while (!HA_ATOMIC_CAS(tat, &old, new));
+	return 1;
+}
+
+/* Sets the gcra value pointed to by <ptr> for table <t> so that <tokens> tokens
+ * are available. It is used to set the value from the CLI.
+ */
+void stktable_gcra_set(const struct stktable *t, void *ptr, unsigned int tokens)
+{
+	unsigned long long window = (unsigned long long)t->data_arg[STKTABLE_DT_GCRA].rate.period * 1000;
+
+	tokens = MIN(tokens, t->data_arg[STKTABLE_DT_GCRA].rate.cnt);
+	HA_ATOMIC_STORE(&stktable_data_cast(ptr, std_t_ull),
+	                stktable_gcra_now() + window - tokens * stktable_gcra_interval(t));
+}
+
+/* Merges the TAT <tat> learned from a peer into the gcra value pointed to by
+ * <ptr>. The most advanced one is kept, so that tokens taken on any node are
+ * accounted everywhere without the need to sum anything.
+ */
+void stktable_gcra_merge(void *ptr, unsigned long long tat)
+{
+	unsigned long long *cur = &stktable_data_cast(ptr, std_t_ull);
+	unsigned long long old = HA_ATOMIC_LOAD(cur);
+
+	while (old < tat && !HA_ATOMIC_CAS(cur, &old, tat))
+		__ha_cpu_relax();
+}
+
+/* Magic string starting the stick-table snapshot files. The last character is
+ * the version of the format.
+ */
+#define STKTABLE_SNAPSHOT_MAGIC "HASTKSN1"
+
+/* Returns the current wall-clock date in milliseconds, used to age the entries
+ * of a snapshot when it is loaded.
+ */
+static inline unsigned long long stktable_snapshot_date()
+{
+	return (unsigned long long)date.tv_sec * 1000 + date.tv_usec / 1000;
+}
+
+/* Encodes at <out> the header of a snapshot of table <t>: the magic string,
+ * the table's type and key size, the date of the snapshot and the list of the
+ * stored data types with their standard type and number of elements. Values
+ * are encoded as in the peers protocol. Returns the header's length. <out> is
+ * assumed to be large enough (a trash chunk is).
+ */
+static size_t stktable_snapshot_header(const struct stktable *t, char *out)
+{
+	char *cur = out;
+	int type, nb = 0;
+
+	memcpy(cur, STKTABLE_SNAPSHOT_MAGIC, strlen(STKTABLE_SNAPSHOT_MAGIC));
+	cur += strlen(STKTABLE_SNAPSHOT_MAGIC);
+	intencode(t->type, &cur);
+	intencode(t->key_size, &cur);
+	intencode(stktable_snapshot_date(), &cur);
+
+	for (type = 0; type < STKTABLE_DATA_TYPES; type++)
+		nb += !!t->data_ofs[type];
+	intencode(nb, &cur);
+
+	for (type = 0; type < STKTABLE_DATA_TYPES; type++) {
+		if (!t->data_ofs[type])
+			continue;
+		intencode(type, &cur);
+		intencode(stktable_data_types[type].std_type, &cur);
+		intencode(t->data_nbelem[type], &cur);
+	}
+	return cur - out;
+}
+
+/* Encodes at <out> a snapshot record for entry <ts> of table <t>, made of the
+ * entry's remaining lifetime in milliseconds plus one (zero if it does not
+ * expire), its key and the elements of its data types in order, using the
+ * per-type encoding of the peers protocol. Summed counters only carry the local
+ * share, like over the peers protocol. Returns the record's length, or zero if
+ * it does not fit in <size> bytes.
+ */
+static size_t stktable_snapshot_entry(struct stktable *t, struct stksess *ts, char *out, size_t size)
+{
+	char *cur = out;
+	char *end = out + size;
+	unsigned int data_type, idx, nb;
+	void *data_ptr;
+
+	/* room for the largest element, three varints */
+	if (size < 32)
+		return 0;
+	end -= 30;
+
+	if (!t->expire || !tick_isset(ts->expire))
+		intencode(0, &cur);
+	else
+		intencode((uint64_t)tick_remain(now_ms, ts->expire) + 1, &cur);
+
+	if (t->type == SMP_T_STR) {
+		size_t len = strlen((char *)ts->key.key);
+
+		if (len + 10 > end - cur)
+			return 0;
+		intencode(len, &cur);
+		memcpy(cur, ts->key.key, len);
+		cur += len;
+	}
+	else if (t->type == SMP_T_SINT) {
+		write_u32(cur, htonl(read_u32(ts->key.key)));
+		cur += sizeof(uint32_t);
+	}
+	else {
+		if (t->key_size > end - cur)
+			return 0;
+		memcpy(cur, ts->key.key, t->key_size);
+		cur += t->key_size;
+	}
+
+	HA_RWLOCK_RDLOCK(STK_SESS_LOCK, &ts->lock);
+	for (data_type = 0; data_type < STKTABLE_DATA_TYPES; data_type++) {
+		if (!t->data_ofs[data_type])
+			continue;
+
+		nb = stktable_data_types[data_type].is_array ? t->data_nbelem[data_type] : 1;
+		for (idx = 0; idx < nb; idx++) {
+			data_ptr = stktable_data_types[data_type].is_array ?
+				stktable_data_ptr_idx(t, ts, data_type, idx) :
+				stktable_data_ptr(t, ts, data_type);
+
+			if (cur > end)
+				goto full;
+
+			switch (stktable_data_types[data_type].std_type) {
+			case STD_T_SINT:
+				intencode(stktable_data_cast(data_ptr, std_t_sint), &cur);
 				break;
-			looped = 1;
-			eb = eb32_first(&t->exps);
-			if (likely(!eb))
+			case STD_T_UINT: {
+				unsigned int data = stktable_data_cast(data_ptr, std_t_uint);
+
+				if (stktable_is_summed(t, data_type))
+					data = stktable_sum_local_share(t, ts, data_type, idx, data);
+				intencode(data, &cur);
+				break;
+			}
+			case STD_T_ULL: {
+				unsigned long long data = stktable_data_cast(data_ptr, std_t_ull);
+
+				if (stktable_is_summed(t, data_type))
+					data = stktable_sum_local_share(t, ts, data_type, idx, data);
+				intencode(data, &cur);
+				break;
+			}
+			case STD_T_FRQP: {
+				struct freq_ctr *frqp = &stktable_data_cast(data_ptr, std_t_frqp);
+
+				intencode((unsigned int)(now_ms - frqp->curr_tick), &cur);
+				intencode(frqp->curr_ctr, &cur);
+				intencode(frqp->prev_ctr, &cur);
 				break;
+			}
+			case STD_T_DICT: {
+				struct dict_entry *de = stktable_data_cast(data_ptr, std_t_dict);
+
+				if (!de) {
+					intencode(0, &cur);
+					break;
+				}
+				if (de->len + 10 > end - cur)
+					goto full;
+				intencode(de->len, &cur);
+				memcpy(cur, de->value.key, de->len);
+				cur += de->len;
+				break;
+			}
+			}
 		}
+	}
+	HA_RWLOCK_RDUNLOCK(STK_SESS_LOCK, &ts->lock);
+	return cur - out;
 
-		if (likely(tick_is_lt(now_ms, eb->key))) {
-			/* timer not expired yet, revisit it later */
-			exp_next = eb->key;
-			goto out_unlock;
+ full:
+	HA_RWLOCK_RDUNLOCK(STK_SESS_LOCK, &ts->lock);
+	return 0;
+}
+
+/* Writes up to <budget> entries of table <t> to its snapshot, starting a new
+ * one if none is in progress. The shards are visited one at a time under their
+ * read lock, which is released every STKTABLE_EXPIRE_BATCH entries. The last
+ * written entry is then referenced so that the walk may be resumed from it.
+ * Once all entries are written, the temporary file is renamed to the snapshot
+ * file. Must be called with the snapshot's lock held. Returns 1 once the
+ * snapshot is complete or was aborted on error, or 0 if the budget was
+ * exhausted before.
+ */
+static int stktable_snapshot_step(struct stktable *t, int budget)
+{
+	struct buffer *buf = get_trash_chunk();
+	struct stktable_shard *shard;
+	struct ebmb_node *eb;
+	struct stksess *ts;
+	size_t len;
+	int batch;
+
+	if (!t->snap.f) {
+		if (!t->snap.tmp && !memprintf(&t->snap.tmp, "%s.%d.tmp", t->snap.file, (int)getpid()))
+			return 1;
+
+		t->snap.f = fopen(t->snap.tmp, "w");
+		if (!t->snap.f) {
+			send_log(NULL, LOG_WARNING, "stick-table '%s': cannot create snapshot file '%s' (%s).\n",
+			         t->id, t->snap.tmp, strerror(errno));
+			return 1;
 		}
+		t->snap.shard = 0;
+		t->snap.count = 0;
+		t->snap.update = HA_ATOMIC_LOAD(&t->update);
+		len = stktable_snapshot_header(t, buf->area);
+		fwrite(buf->area, len, 1, t->snap.f);
+	}
 
-		/* timer looks expired, detach it from the queue */
-		ts = eb32_entry(eb, struct stksess, exp);
-		eb = eb32_next(eb);
+	while (t->snap.shard < t->nb_shards) {
+		shard = &t->shards[t->snap.shard];
+		batch = 0;
 
-		/* don't delete an entry which is currently referenced */
-		if (ts->ref_cnt)
+		HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &shard->lock);
+		if (t->snap.pos) {
+			eb = ebmb_next(&t->snap.pos->key);
+			HA_ATOMIC_DEC(&t->snap.pos->ref_cnt);
+			t->snap.pos = NULL;
+		}
+		else
+			eb = ebmb_first(&shard->keys);
+
+		for (; eb; eb = ebmb_next(eb)) {
+			ts = ebmb_entry(eb, struct stksess, key);
+			if (t->expire && tick_is_expired(ts->expire, now_ms))
+				continue;
+
+			/* one byte for the record's tag */
+			len = stktable_snapshot_entry(t, ts, buf->area + 1, buf->size - 1);
+			if (len) {
+				buf->area[0] = 1;
+				fwrite(buf->area, len + 1, 1, t->snap.f);
+				t->snap.count++;
+			}
+
+			if (++batch >= STKTABLE_EXPIRE_BATCH && ebmb_next(eb)) {
+				/* keep our position and let other threads
+				 * access the shard for a while.
+				 */
+				HA_ATOMIC_INC(&ts->ref_cnt);
+				t->snap.pos = ts;
+				break;
+			}
+		}
+		HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &shard->lock);
+
+		if (!t->snap.pos)
+			t->snap.shard++;
+
+		budget -= batch;
+		if (budget <= 0 && t->snap.shard < t->nb_shards)
+			return 0;
+	}
+
+	/* a zero tag ends a complete snapshot */
+	fputc(0, t->snap.f);
+	if (ferror(t->snap.f) | fclose(t->snap.f)) {
+		send_log(NULL, LOG_WARNING, "stick-table '%s': failed to write snapshot file '%s' (%s).\n",
+		         t->id, t->snap.tmp, strerror(errno));
+		unlink(t->snap.tmp);
+	}
+	else if (rename(t->snap.tmp, t->snap.file) < 0) {
+		send_log(NULL, LOG_WARNING, "stick-table '%s': failed to rename '%s' to '%s' (%s).\n",
+		         t->id, t->snap.tmp, t->snap.file, strerror(errno));
+		unlink(t->snap.tmp);
+	}
+	t->snap.f = NULL;
+	t->snap.done = 1;
+	return 1;
+}
+
+/* Task writing the snapshots of table <context> every snapshot period. When
+ * the table is synchronized with peers, a snapshot is skipped if the table
+ * was not updated since the previous one. Only the workers write snapshots.
+ */
+static struct task *stktable_snapshot_task(struct task *task, void *context, unsigned int state)
+{
+	struct stktable *t = context;
+	int done;
+
+	if (master) {
+		/* the master's entries are those of the last load */
+		task->expire = TICK_ETERNITY;
+		return task;
+	}
+
+	if (!t->snap.f && t->snap.done && t->sync_task &&
+	    HA_ATOMIC_LOAD(&t->update) == t->snap.update) {
+		task->expire = tick_add(now_ms, MS_TO_TICKS(t->snap.period));
+		return task;
+	}
+
+	HA_SPIN_LOCK(STK_TABLE_LOCK, &t->snap.lock);
+	done = stktable_snapshot_step(t, STKTABLE_SNAPSHOT_BUDGET);
+	HA_SPIN_UNLOCK(STK_TABLE_LOCK, &t->snap.lock);
+
+	if (!done) {
+		/* let other tasks run before writing the next entries */
+		task->expire = TICK_ETERNITY;
+		task_wakeup(task, TASK_WOKEN_OTHER);
+		return task;
+	}
+	task->expire = tick_add(now_ms, MS_TO_TICKS(t->snap.period));
+	return task;
+}
+
+/* Writes a last complete snapshot of each table having one when a worker
+ * stops, so that the next start finds the most recent entries.
+ */
+static void stktable_snapshot_deinit()
+{
+	struct stktable *t;
+
+	if (tid != 0 || master)
+		return;
+
+	for (t = stktables_list; t; t = t->next) {
+		if (!t->snap.task)
 			continue;
+		HA_SPIN_LOCK(STK_TABLE_LOCK, &t->snap.lock);
+		stktable_snapshot_step(t, INT_MAX);
+		HA_SPIN_UNLOCK(STK_TABLE_LOCK, &t->snap.lock);
+	}
+}
 
-		eb32_delete(&ts->exp);
+REGISTER_PER_THREAD_DEINIT(stktable_snapshot_deinit);
 
-		if (!tick_is_expired(ts->expire, now_ms)) {
-			if (!tick_isset(ts->expire))
+/* Loads the entries of the snapshot file of table <t>, if any, into the table.
+ * It is called once the table is initialized, before the listeners are bound.
+ * The time elapsed since the snapshot was written is deduced from the
+ * lifetime of the entries and added to the age of their frequency counters.
+ * Entries are only loaded as long as the table is not full. A missing,
+ * incompatible or damaged file is only reported with a warning, the entries
+ * decoded before a damaged part being kept.
+ */
+static void stktable_snapshot_load(struct stktable *t)
+{
+	unsigned long long elapsed, when;
+	struct stktable_key key;
+	struct stksess *ts, *ts2;
+	struct stktable_shard *shard;
+	struct stat st;
+	char *map, *cur, *end;
+	unsigned int loaded = 0;
+	unsigned int data_type, idx, nb;
+	uint64_t exp, val;
+	uint32_t sint_key;
+	void *data_ptr;
+	int fd;
+
+	fd = open(t->snap.file, O_RDONLY);
+	if (fd < 0) {
+		if (errno != ENOENT)
+			ha_warning("stick-table '%s': cannot open snapshot file '%s' (%s).\n",
+			           t->id, t->snap.file, strerror(errno));
+		return;
+	}
+
+	if (fstat(fd, &st) < 0 || !st.st_size) {
+		close(fd);
+		return;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		ha_warning("stick-table '%s': cannot map snapshot file '%s' (%s).\n",
+		           t->id, t->snap.file, strerror(errno));
+		return;
+	}
+
+	cur = map;
+	end = map + st.st_size;
+	if (st.st_size < strlen(STKTABLE_SNAPSHOT_MAGIC) ||
+	    memcmp(cur, STKTABLE_SNAPSHOT_MAGIC, strlen(STKTABLE_SNAPSHOT_MAGIC)) != 0)
+		goto incompatible;
+	cur += strlen(STKTABLE_SNAPSHOT_MAGIC);
+
+	if (intdecode(&cur, end) != t->type || intdecode(&cur, end) != t->key_size)
+		goto incompatible;
+
+	when = intdecode(&cur, end);
+	elapsed = stktable_snapshot_date() - when;
+	if (when > stktable_snapshot_date())
+		elapsed = 0;
+
+	nb = 0;
+	for (data_type = 0; data_type < STKTABLE_DATA_TYPES; data_type++)
+		nb += !!t->data_ofs[data_type];
+	if (intdecode(&cur, end) != nb)
+		goto incompatible;
+
+	while (nb--) {
+		data_type = intdecode(&cur, end);
+		if (!cur || data_type >= STKTABLE_DATA_TYPES || !t->data_ofs[data_type] ||
+		    intdecode(&cur, end) != stktable_data_types[data_type].std_type ||
+		    intdecode(&cur, end) != t->data_nbelem[data_type])
+			goto incompatible;
+	}
+
+	while (cur && cur < end && *cur) {
+		cur++;
+		if (HA_ATOMIC_LOAD(&t->current) >= t->size) {
+			ha_warning("stick-table '%s': table full after loading %u entries from snapshot file '%s'.\n",
+			           t->id, loaded, t->snap.file);
+			goto out;
+		}
+
+		exp = intdecode(&cur, end);
+		if (!cur)
+			goto damaged;
+
+		if (t->type == SMP_T_STR) {
+			key.key_len = intdecode(&cur, end);
+			if (!cur || key.key_len > end - cur)
+				goto damaged;
+			key.key = cur;
+			cur += key.key_len;
+		}
+		else if (t->type == SMP_T_SINT) {
+			if (end - cur < sizeof(uint32_t))
+				goto damaged;
+			sint_key = ntohl(read_u32(cur));
+			key.key = &sint_key;
+			key.key_len = sizeof(uint32_t);
+			cur += sizeof(uint32_t);
+		}
+		else {
+			if (end - cur < t->key_size)
+				goto damaged;
+			key.key = cur;
+			key.key_len = t->key_size;
+			cur += t->key_size;
+		}
+
+		ts = stksess_new(t, &key);
+		if (!ts)
+			goto out;
+
+		for (data_type = 0; data_type < STKTABLE_DATA_TYPES; data_type++) {
+			if (!t->data_ofs[data_type])
 				continue;
 
-			ts->exp.key = ts->expire;
-			eb32_insert(&t->exps, &ts->exp);
+			nb = stktable_data_types[data_type].is_array ? t->data_nbelem[data_type] : 1;
+			for (idx = 0; idx < nb; idx++) {
+				data_ptr = stktable_data_types[data_type].is_array ?
+					stktable_data_ptr_idx(t, ts, data_type, idx) :
+					stktable_data_ptr(t, ts, data_type);
 
-			if (!eb || eb->key > ts->exp.key)
-				eb = &ts->exp;
-			continue;
+				val = intdecode(&cur, end);
+				switch (stktable_data_types[data_type].std_type) {
+				case STD_T_SINT:
+					stktable_data_cast(data_ptr, std_t_sint) = val;
+					break;
+				case STD_T_UINT:
+					stktable_data_cast(data_ptr, std_t_uint) = val;
+					break;
+				case STD_T_ULL:
+					stktable_data_cast(data_ptr, std_t_ull) = val;
+					break;
+				case STD_T_FRQP: {
+					struct freq_ctr *frqp = &stktable_data_cast(data_ptr, std_t_frqp);
+
+					/* the age is bounded to keep the tick in the past */
+					val = MIN(val + elapsed, (uint64_t)INT_MAX);
+					frqp->curr_tick = tick_add(now_ms, -(int)val) & ~0x1;
+					frqp->curr_ctr = intdecode(&cur, end);
+					frqp->prev_ctr = intdecode(&cur, end);
+					break;
+				}
+				case STD_T_DICT: {
+					struct buffer *chunk = get_trash_chunk();
+
+					if (!val)
+						break;
+					if (!cur || val > end - cur || val + 1 >= chunk->size) {
+						cur = NULL;
+						break;
+					}
+					chunk_memcpy(chunk, cur, val);
+					chunk->area[chunk->data] = '\0';
+					cur += val;
+					stktable_data_cast(data_ptr, std_t_dict) = dict_insert(&server_key_dict, chunk->area);
+					break;
+				}
+				}
+			}
 		}
 
-		/* session expired, trash it */
-		ebmb_delete(&ts->key);
-		eb32_delete(&ts->upd);
-		__stksess_free(t, ts);
+		if (!cur) {
+			stksess_free(t, ts);
+			goto damaged;
+		}
+
+		if (t->expire && exp) {
+			/* skip entries which expired in the mean time */
+			if (exp - 1 <= elapsed) {
+				stksess_free(t, ts);
+				continue;
+			}
+			exp = MIN(exp - 1 - elapsed, (uint64_t)t->expire);
+			ts->expire = tick_add(now_ms, MS_TO_TICKS(exp));
+		}
+
+		shard = stksess_shard(t, ts);
+		HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
+		ts2 = __stktable_store(t, ts);
+		HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
+		if (ts2 != ts)
+			stksess_free(t, ts);
+		else
+			loaded++;
 	}
 
-	/* We have found no task to expire in any tree */
-	exp_next = TICK_ETERNITY;
+	if (!cur || cur >= end)
+		goto damaged;
+	goto out;
 
-out_unlock:
-	task->expire = exp_next;
-	HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &t->lock);
-	return task;
+ incompatible:
+	ha_warning("stick-table '%s': ignoring snapshot file '%s' which does not match the table's definition.\n",
+	           t->id, t->snap.file);
+	goto out;
+
+ damaged:
+	ha_warning("stick-table '%s': snapshot file '%s' is truncated or damaged, only %u entries were loaded.\n",
+	           t->id, t->snap.file, loaded);
+ out:
+	if (loaded && t->exp_task)
+		task_wakeup(t->exp_task, TASK_WOKEN_INIT);
+	munmap(map, st.st_size);
 }
 
 /* Perform minimal stick table intializations, report 0 in case of error, 1 if OK. */
 int stktable_init(struct stktable *t)
 {
 	int peers_retval = 0;
+	unsigned int shard;
 
 	t->hash_seed = XXH64(t->id, t->idlen, 0);
 
 	if (t->size) {
-		t->keys = EB_ROOT_UNIQUE;
-		memset(&t->exps, 0, sizeof(t->exps));
+		if (!t->nb_shards)
+			t->nb_shards = 1;
+
+		t->shards = calloc(t->nb_shards, sizeof(*t->shards));
+		if (!t->shards)
+			return 0;
+
+		for (shard = 0; shard < t->nb_shards; shard++) {
+			t->shards[shard].keys = EB_ROOT_UNIQUE;
+			memset(&t->shards[shard].exps, 0, sizeof(t->shards[shard].exps));
+			HA_RWLOCK_INIT(&t->shards[shard].lock);
+		}
+
 		t->updates = EB_ROOT_UNIQUE;
 		HA_RWLOCK_INIT(&t->lock);
 
-		t->pool = create_pool("sticktables", sizeof(struct stksess) + round_ptr_size(t->data_size) + t->key_size, MEM_F_SHARED);
+		if (t->sum_counters && t->peers.p)
+			stktable_alloc_sum_shares(t);
+
+		/* the expiration and update nodes are placed before the data */
+		t->pfx_size = round_ptr_size(t->data_size) + sizeof(struct eb32_node);
+		t->exp_ofs = -t->pfx_size;
+		if (t->peers.p) {
+			t->pfx_size += sizeof(struct eb32_node);
+			t->upd_ofs = -t->pfx_size;
+		}
+
+		t->pool = create_pool("sticktables", t->pfx_size + sizeof(struct stksess) + t->key_size, MEM_F_SHARED);
+
+		if (t->sketch.width) {
+			t->sketch.cnt = calloc(2 * STKTABLE_SKETCH_DEPTH * (size_t)t->sketch.width, sizeof(*t->sketch.cnt));
+			if (!t->sketch.cnt)
+				return 0;
+			if (!t->sketch.promote)
+				t->sketch.promote = 2;
+			if (!t->sketch.period)
+				t->sketch.period = 10000;
+			t->sketch.date = tick_add(now_ms, 0);
+			HA_SPIN_INIT(&t->sketch.lock);
+		}
 
 		if ( t->expire ) {
 			t->exp_task = task_new_anywhere();
@@ -741,6 +1711,21 @@ int stktable_init(struct stktable *t)
 			t->exp_task->process = process_table_expire;
 			t->exp_task->context = (void *)t;
 		}
+
+		if (t->snap.file && t->pool && !(global.mode & MODE_CHECK)) {
+			if (!t->snap.period)
+				t->snap.period = STKTABLE_SNAPSHOT_PERIOD;
+			HA_SPIN_INIT(&t->snap.lock);
+			stktable_snapshot_load(t);
+
+			t->snap.task = task_new_anywhere();
+			if (!t->snap.task)
+				return 0;
+			t->snap.task->process = stktable_snapshot_task;
+			t->snap.task->context = (void *)t;
+			t->snap.task->expire = tick_add(now_ms, MS_TO_TICKS(t->snap.period));
+			task_queue(t->snap.task);
+		}
 		if (t->peers.p && t->peers.p->peers_fe && !(t->peers.p->peers_fe->flags & (PR_FL_DISABLED|PR_FL_STOPPED))) {
 			peers_retval = peers_register_table(t->peers.p, t);
 		}
@@ -750,6 +1735,19 @@ int stktable_init(struct stktable *t)
 	return 1;
 }
 
+/* Releases the resources allocated by stktable_init() for table <t>. */
+void stktable_deinit(struct stktable *t)
+{
+	if (!t)
+		return;
+
+	pool_destroy(t->pool);
+	ha_free(&t->shards);
+	ha_free(&t->sketch.cnt);
+	ha_free(&t->snap.file);
+	ha_free(&t->snap.tmp);
+}
+
 /*
  * Configuration keywords of known table types
  */
@@ -843,6 +1841,18 @@ int stktable_alloc_data_type(struct stktable *t, int type, const char *sa, const
 		if (sa)
 			return PE_ARG_INVC; /* invalid char */
 		break;
+	case ARG_T_RATE:
+		if (!sa || !sa2)
+			return PE_ARG_MISSING;
+		t->data_arg[type].rate.cnt = atoi(sa);
+		if ((int)t->data_arg[type].rate.cnt <= 0)
+			return PE_ARG_VALUE_OOR;
+		sa2 = parse_time_err(sa2, &t->data_arg[type].rate.period, TIME_UNIT_MS);
+		if (sa2)
+			return PE_ARG_INVC; /* invalid char */
+		if (!t->data_arg[type].rate.period)
+			return PE_ARG_VALUE_OOR;
+		break;
 	}
 
 	t->data_size      += t->data_nbelem[type] * stktable_type_size(stktable_data_types[type].std_type);
@@ -898,16 +1908,107 @@ int parse_stick_table(const char *file, int linenum, char **args,
 				err_code |= ERR_ALERT | ERR_FATAL;
 				goto out;
 			}
-			if ((err = parse_size_err(args[idx], &t->size))) {
+			if ((err = parse_size_err(args[idx], &t->size))) {
+				ha_alert("parsing [%s:%d] : %s: unexpected character '%c' in argument of '%s'.\n",
+					 file, linenum, args[0], *err, args[idx-1]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			idx++;
+		}
+		/* This argument does not exit in "peers" section. */
+		else if (!peers && strcmp(args[idx], "peers") == 0) {
+			idx++;
+			if (!*(args[idx])) {
+				ha_alert("parsing [%s:%d] : %s: missing argument after '%s'.\n",
+					 file, linenum, args[0], args[idx-1]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			t->peers.name = strdup(args[idx++]);
+		}
+		else if (strcmp(args[idx], "expire") == 0) {
+			idx++;
+			if (!*(args[idx])) {
+				ha_alert("parsing [%s:%d] : %s: missing argument after '%s'.\n",
+					 file, linenum, args[0], args[idx-1]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			err = parse_time_err(args[idx], &val, TIME_UNIT_MS);
+			if (err == PARSE_TIME_OVER) {
+				ha_alert("parsing [%s:%d]: %s: timer overflow in argument <%s> to <%s>, maximum value is 2147483647 ms (~24.8 days).\n",
+					 file, linenum, args[0], args[idx], args[idx-1]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			else if (err == PARSE_TIME_UNDER) {
+				ha_alert("parsing [%s:%d]: %s: timer underflow in argument <%s> to <%s>, minimum non-null value is 1 ms.\n",
+					 file, linenum, args[0], args[idx], args[idx-1]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			else if (err) {
+				ha_alert("parsing [%s:%d] : %s: unexpected character '%c' in argument of '%s'.\n",
+					 file, linenum, args[0], *err, args[idx-1]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			t->expire = val;
+			idx++;
+		}
+		else if (strcmp(args[idx], "nopurge") == 0) {
+			t->nopurge = 1;
+			idx++;
+		}
+		else if (strcmp(args[idx], "sum-counters") == 0) {
+			t->sum_counters = 1;
+			idx++;
+		}
+		else if (strcmp(args[idx], "shards") == 0) {
+			idx++;
+			if (!*(args[idx])) {
+				ha_alert("parsing [%s:%d] : %s: missing argument after '%s'.\n",
+					 file, linenum, args[0], args[idx-1]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			val = strtoul(args[idx], (char **)&err, 10);
+			if (*err || val < 1 || val > STKTABLE_MAX_SHARDS) {
+				ha_alert("parsing [%s:%d] : %s: '%s' expects an integer between 1 and %d (got '%s').\n",
+					 file, linenum, args[0], args[idx-1], STKTABLE_MAX_SHARDS, args[idx]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			t->nb_shards = val;
+			idx++;
+		}
+		else if (strcmp(args[idx], "sketch") == 0) {
+			idx++;
+			if (!*(args[idx])) {
+				ha_alert("parsing [%s:%d] : %s: missing argument after '%s'.\n",
+					 file, linenum, args[0], args[idx-1]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			if ((err = parse_size_err(args[idx], &val))) {
 				ha_alert("parsing [%s:%d] : %s: unexpected character '%c' in argument of '%s'.\n",
 					 file, linenum, args[0], *err, args[idx-1]);
 				err_code |= ERR_ALERT | ERR_FATAL;
 				goto out;
 			}
+			if (val < 1 || val > STKTABLE_SKETCH_MAX_WIDTH) {
+				ha_alert("parsing [%s:%d] : %s: '%s' expects a size between 1 and %u (got '%s').\n",
+					 file, linenum, args[0], args[idx-1], STKTABLE_SKETCH_MAX_WIDTH, args[idx]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			/* rounded up to the next power of two */
+			for (t->sketch.width = 1; t->sketch.width < val; t->sketch.width <<= 1)
+				;
 			idx++;
 		}
-		/* This argument does not exit in "peers" section. */
-		else if (!peers && strcmp(args[idx], "peers") == 0) {
+		else if (strcmp(args[idx], "sketch-promote") == 0) {
 			idx++;
 			if (!*(args[idx])) {
 				ha_alert("parsing [%s:%d] : %s: missing argument after '%s'.\n",
@@ -915,9 +2016,17 @@ int parse_stick_table(const char *file, int linenum, char **args,
 				err_code |= ERR_ALERT | ERR_FATAL;
 				goto out;
 			}
-			t->peers.name = strdup(args[idx++]);
+			val = strtoul(args[idx], (char **)&err, 10);
+			if (*err || val < 1 || val > INT_MAX) {
+				ha_alert("parsing [%s:%d] : %s: '%s' expects a positive integer (got '%s').\n",
+					 file, linenum, args[0], args[idx-1], args[idx]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			t->sketch.promote = val;
+			idx++;
 		}
-		else if (strcmp(args[idx], "expire") == 0) {
+		else if (strcmp(args[idx], "sketch-period") == 0) {
 			idx++;
 			if (!*(args[idx])) {
 				ha_alert("parsing [%s:%d] : %s: missing argument after '%s'.\n",
@@ -926,15 +2035,45 @@ int parse_stick_table(const char *file, int linenum, char **args,
 				goto out;
 			}
 			err = parse_time_err(args[idx], &val, TIME_UNIT_MS);
-			if (err == PARSE_TIME_OVER) {
-				ha_alert("parsing [%s:%d]: %s: timer overflow in argument <%s> to <%s>, maximum value is 2147483647 ms (~24.8 days).\n",
-					 file, linenum, args[0], args[idx], args[idx-1]);
+			if (err == PARSE_TIME_OVER || err == PARSE_TIME_UNDER || (!err && (!val || val > INT_MAX / 2))) {
+				ha_alert("parsing [%s:%d]: %s: '%s' expects a non-null delay of at most 12 days (got '%s').\n",
+					 file, linenum, args[0], args[idx-1], args[idx]);
 				err_code |= ERR_ALERT | ERR_FATAL;
 				goto out;
 			}
-			else if (err == PARSE_TIME_UNDER) {
-				ha_alert("parsing [%s:%d]: %s: timer underflow in argument <%s> to <%s>, minimum non-null value is 1 ms.\n",
-					 file, linenum, args[0], args[idx], args[idx-1]);
+			else if (err) {
+				ha_alert("parsing [%s:%d] : %s: unexpected character '%c' in argument of '%s'.\n",
+					 file, linenum, args[0], *err, args[idx-1]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			t->sketch.period = val;
+			idx++;
+		}
+		else if (strcmp(args[idx], "snapshot") == 0) {
+			idx++;
+			if (!*(args[idx])) {
+				ha_alert("parsing [%s:%d] : %s: missing file name after '%s'.\n",
+					 file, linenum, args[0], args[idx-1]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			free(t->snap.file);
+			t->snap.file = strdup(args[idx]);
+			idx++;
+		}
+		else if (strcmp(args[idx], "snapshot-period") == 0) {
+			idx++;
+			if (!*(args[idx])) {
+				ha_alert("parsing [%s:%d] : %s: missing argument after '%s'.\n",
+					 file, linenum, args[0], args[idx-1]);
+				err_code |= ERR_ALERT | ERR_FATAL;
+				goto out;
+			}
+			err = parse_time_err(args[idx], &val, TIME_UNIT_MS);
+			if (err == PARSE_TIME_OVER || err == PARSE_TIME_UNDER || (!err && (!val || val > INT_MAX / 2))) {
+				ha_alert("parsing [%s:%d]: %s: '%s' expects a non-null delay of at most 12 days (got '%s').\n",
+					 file, linenum, args[0], args[idx-1], args[idx]);
 				err_code |= ERR_ALERT | ERR_FATAL;
 				goto out;
 			}
@@ -944,11 +2083,7 @@ int parse_stick_table(const char *file, int linenum, char **args,
 				err_code |= ERR_ALERT | ERR_FATAL;
 				goto out;
 			}
-			t->expire = val;
-			idx++;
-		}
-		else if (strcmp(args[idx], "nopurge") == 0) {
-			t->nopurge = 1;
+			t->snap.period = val;
 			idx++;
 		}
 		else if (strcmp(args[idx], "type") == 0) {
@@ -1024,8 +2159,12 @@ int parse_stick_table(const char *file, int linenum, char **args,
 					err_code |= ERR_ALERT | ERR_FATAL;
 					goto out;
 				case PE_ARG_VALUE_OOR:
-					ha_alert("parsing [%s:%d] : %s: array size is out of allowed range (1-%d) for store option '%s'.\n",
-						 file, linenum, args[0], STKTABLE_MAX_DT_ARRAY_SIZE, cw);
+					if (!stktable_data_types[type].is_array)
+						ha_alert("parsing [%s:%d] : %s: argument out of range for store option '%s'.\n",
+							 file, linenum, args[0], cw);
+					else
+						ha_alert("parsing [%s:%d] : %s: array size is out of allowed range (1-%d) for store option '%s'.\n",
+							 file, linenum, args[0], STKTABLE_MAX_DT_ARRAY_SIZE, cw);
 					err_code |= ERR_ALERT | ERR_FATAL;
 					goto out;
 
@@ -1097,6 +2236,27 @@ int parse_stick_table(const char *file, int linenum, char **args,
 		goto out;
 	}
 
+	if (t->sum_counters && !t->peers.p && !t->peers.name) {
+		ha_alert("parsing [%s:%d] : %s: 'sum-counters' requires 'peers'.\n",
+			 file, linenum, args[0]);
+		err_code |= ERR_ALERT | ERR_FATAL;
+		goto out;
+	}
+
+	if (t->snap.period && !t->snap.file) {
+		ha_alert("parsing [%s:%d] : %s: 'snapshot-period' requires 'snapshot'.\n",
+			 file, linenum, args[0]);
+		err_code |= ERR_ALERT | ERR_FATAL;
+		goto out;
+	}
+
+	if ((t->sketch.promote || t->sketch.period) && !t->sketch.width) {
+		ha_alert("parsing [%s:%d] : %s: 'sketch-promote' and 'sketch-period' require 'sketch'.\n",
+			 file, linenum, args[0]);
+		err_code |= ERR_ALERT | ERR_FATAL;
+		goto out;
+	}
+
  out:
 	return err_code;
 }
@@ -1229,29 +2389,30 @@ int stktable_compatible_sample(struct sample_expr *expr, unsigned long table_typ
 struct stktable_data_type stktable_data_types[STKTABLE_DATA_TYPES] = {
 	[STKTABLE_DT_SERVER_ID]     = { .name = "server_id",      .std_type = STD_T_SINT  },
 	[STKTABLE_DT_GPT0]          = { .name = "gpt0",           .std_type = STD_T_UINT  },
-	[STKTABLE_DT_GPC0]          = { .name = "gpc0",           .std_type = STD_T_UINT  },
+	[STKTABLE_DT_GPC0]          = { .name = "gpc0",           .std_type = STD_T_UINT, .is_counter = 1 },
 	[STKTABLE_DT_GPC0_RATE]     = { .name = "gpc0_rate",      .std_type = STD_T_FRQP, .arg_type = ARG_T_DELAY  },
-	[STKTABLE_DT_CONN_CNT]      = { .name = "conn_cnt",       .std_type = STD_T_UINT  },
+	[STKTABLE_DT_CONN_CNT]      = { .name = "conn_cnt",       .std_type = STD_T_UINT, .is_counter = 1 },
 	[STKTABLE_DT_CONN_RATE]     = { .name = "conn_rate",      .std_type = STD_T_FRQP, .arg_type = ARG_T_DELAY  },
 	[STKTABLE_DT_CONN_CUR]      = { .name = "conn_cur",       .std_type = STD_T_UINT, .is_local = 1 },
-	[STKTABLE_DT_SESS_CNT]      = { .name = "sess_cnt",       .std_type = STD_T_UINT  },
+	[STKTABLE_DT_SESS_CNT]      = { .name = "sess_cnt",       .std_type = STD_T_UINT, .is_counter = 1 },
 	[STKTABLE_DT_SESS_RATE]     = { .name = "sess_rate",      .std_type = STD_T_FRQP, .arg_type = ARG_T_DELAY  },
-	[STKTABLE_DT_HTTP_REQ_CNT]  = { .name = "http_req_cnt",   .std_type = STD_T_UINT  },
+	[STKTABLE_DT_HTTP_REQ_CNT]  = { .name = "http_req_cnt",   .std_type = STD_T_UINT, .is_counter = 1 },
 	[STKTABLE_DT_HTTP_REQ_RATE] = { .name = "http_req_rate",  .std_type = STD_T_FRQP, .arg_type = ARG_T_DELAY  },
-	[STKTABLE_DT_HTTP_ERR_CNT]  = { .name = "http_err_cnt",   .std_type = STD_T_UINT  },
+	[STKTABLE_DT_HTTP_ERR_CNT]  = { .name = "http_err_cnt",   .std_type = STD_T_UINT, .is_counter = 1 },
 	[STKTABLE_DT_HTTP_ERR_RATE] = { .name = "http_err_rate",  .std_type = STD_T_FRQP, .arg_type = ARG_T_DELAY  },
-	[STKTABLE_DT_BYTES_IN_CNT]  = { .name = "bytes_in_cnt",   .std_type = STD_T_ULL   },
+	[STKTABLE_DT_BYTES_IN_CNT]  = { .name = "bytes_in_cnt",   .std_type = STD_T_ULL,  .is_counter = 1 },
 	[STKTABLE_DT_BYTES_IN_RATE] = { .name = "bytes_in_rate",  .std_type = STD_T_FRQP, .arg_type = ARG_T_DELAY },
-	[STKTABLE_DT_BYTES_OUT_CNT] = { .name = "bytes_out_cnt",  .std_type = STD_T_ULL   },
+	[STKTABLE_DT_BYTES_OUT_CNT] = { .name = "bytes_out_cnt",  .std_type = STD_T_ULL,  .is_counter = 1 },
 	[STKTABLE_DT_BYTES_OUT_RATE]= { .name = "bytes_out_rate", .std_type = STD_T_FRQP, .arg_type = ARG_T_DELAY },
-	[STKTABLE_DT_GPC1]          = { .name = "gpc1",           .std_type = STD_T_UINT  },
+	[STKTABLE_DT_GPC1]          = { .name = "gpc1",           .std_type = STD_T_UINT, .is_counter = 1 },
 	[STKTABLE_DT_GPC1_RATE]     = { .name = "gpc1_rate",      .std_type = STD_T_FRQP, .arg_type = ARG_T_DELAY  },
 	[STKTABLE_DT_SERVER_KEY]    = { .name = "server_key",     .std_type = STD_T_DICT  },
-	[STKTABLE_DT_HTTP_FAIL_CNT] = { .name = "http_fail_cnt",  .std_type = STD_T_UINT  },
+	[STKTABLE_DT_HTTP_FAIL_CNT] = { .name = "http_fail_cnt",  .std_type = STD_T_UINT, .is_counter = 1 },
 	[STKTABLE_DT_HTTP_FAIL_RATE]= { .name = "http_fail_rate", .std_type = STD_T_FRQP, .arg_type = ARG_T_DELAY  },
 	[STKTABLE_DT_GPT]           = { .name = "gpt",            .std_type = STD_T_UINT, .is_array = 1 },
-	[STKTABLE_DT_GPC]           = { .name = "gpc",            .std_type = STD_T_UINT, .is_array = 1 },
+	[STKTABLE_DT_GPC]           = { .name = "gpc",            .std_type = STD_T_UINT, .is_array = 1, .is_counter = 1 },
 	[STKTABLE_DT_GPC_RATE]      = { .name = "gpc_rate",       .std_type = STD_T_FRQP, .is_array = 1, .arg_type = ARG_T_DELAY },
+	[STKTABLE_DT_GCRA]          = { .name = "gcra",           .std_type = STD_T_ULL,  .arg_type = ARG_T_RATE },
 };
 
 /* Registers stick-table extra data type with index <idx>, name <name>, type
@@ -2137,6 +3298,30 @@ static int sample_conv_table_http_req_rate(const struct arg *arg_p, struct sampl
 	return !!ptr;
 }
 
+/* Casts sample <smp> to the type of the table specified in arg(0), and returns
+ * the number of events estimated for this key by the table's sketch over the
+ * sketch's period, whether the key is stored in the table or not. The sketch
+ * is not updated. If the table has no sketch, <not found> is returned.
+ */
+static int sample_conv_table_sketch_rate(const struct arg *arg_p, struct sample *smp, void *private)
+{
+	struct stktable *t;
+	struct stktable_key *key;
+
+	t = arg_p[0].data.t;
+	if (!t->sketch.cnt)
+		return 0;
+
+	key = smp_to_stkey(smp, t);
+	if (!key)
+		return 0;
+
+	smp->flags = SMP_F_VOL_TEST;
+	smp->data.type = SMP_T_SINT;
+	smp->data.u.sint = stktable_sketch_update(t, key, 0);
+	return 1;
+}
+
 /* Casts sample <smp> to the type of the table specified in arg(0), and looks
  * it up into this table. Returns the volume of datareceived from clients in kbytes
  * if the key is present in the table, otherwise zero, so that comparisons can
@@ -2351,6 +3536,45 @@ static int sample_conv_table_trackers(const struct arg *arg_p, struct sample *sm
 	return 1;
 }
 
+/* Casts sample <smp> to the type of the table specified in arg(0), and looks
+ * it up into this table. Returns the number of tokens available in the gcra
+ * token bucket for the key if the key is present in the table, otherwise the
+ * bucket's size, so that comparisons can be easily performed. If the inspected
+ * parameter is not stored in the table, <not found> is returned.
+ */
+static int sample_conv_table_tokens(const struct arg *arg_p, struct sample *smp, void *private)
+{
+	struct stktable *t;
+	struct stktable_key *key;
+	struct stksess *ts;
+	void *ptr;
+
+	t = arg_p[0].data.t;
+
+	key = smp_to_stkey(smp, t);
+	if (!key)
+		return 0;
+
+	if (!t->data_ofs[STKTABLE_DT_GCRA])
+		return 0; /* parameter not stored */
+
+	ts = stktable_lookup_key(t, key);
+
+	smp->flags = SMP_F_VOL_TEST;
+	smp->data.type = SMP_T_SINT;
+	smp->data.u.sint = t->data_arg[STKTABLE_DT_GCRA].rate.cnt;
+
+	if (!ts) /* key not present */
+		return 1;
+
+	ptr = stktable_data_ptr(t, ts, STKTABLE_DT_GCRA);
+	if (ptr)
+		smp->data.u.sint = stktable_gcra_tokens(t, ptr);
+
+	stktable_release(t, ts);
+	return !!ptr;
+}
+
 /* This function increments the gpc counter at index 'rule->arg.gpc.idx' of the
  * array on the tracksc counter of index 'rule->arg.gpc.sc' stored into the
  * <stream> or directly in the session <sess> if <stream> is set to NULL
@@ -2586,6 +3810,71 @@ static enum act_parse_ret parse_inc_gpc(const char **args, int *arg, struct prox
 	return ACT_RET_PRS_OK;
 }
 
+/* This function takes a token from the gcra token bucket of the tracksc
+ * counter of index 'rule->arg.gpc.sc' stored into the <stream> or directly in
+ * the session <sess> if <stream> is set to NULL. Nothing is done if the bucket
+ * is empty.
+ *
+ * This function always returns ACT_RET_CONT and parameter flags is unused.
+ */
+static enum act_return action_take_token(struct act_rule *rule, struct proxy *px,
+                                         struct session *sess, struct stream *s, int flags)
+{
+	struct stksess *ts;
+	struct stkctr *stkctr;
+	void *ptr;
+
+	/* Extract the stksess, return OK if no stksess available. */
+	if (s)
+		stkctr = &s->stkctr[rule->arg.gpc.sc];
+	else
+		stkctr = &sess->stkctr[rule->arg.gpc.sc];
+
+	ts = stkctr_entry(stkctr);
+	if (!ts)
+		return ACT_RET_CONT;
+
+	ptr = stktable_data_ptr(stkctr->table, ts, STKTABLE_DT_GCRA);
+	if (ptr && stktable_gcra_take(stkctr->table, ptr, 1)) {
+		/* If data was modified, we need to touch to re-schedule sync */
+		stktable_touch_local(stkctr->table, ts, 0);
+	}
+	return ACT_RET_CONT;
+}
+
+/* This function is a parser for the "sc-take-token(<track ID>)" action. It
+ * returns ACT_RET_PRS_ERR if fails and <err> is filled with an error message.
+ * Otherwise it returns ACT_RET_PRS_OK.
+ */
+static enum act_parse_ret parse_take_token(const char **args, int *arg, struct proxy *px,
+                                           struct act_rule *rule, char **err)
+{
+	const char *cmd_name = args[*arg-1];
+	char *error;
+
+	cmd_name += strlen("sc-take-token");
+	if (*cmd_name != '(') {
+		memprintf(err, "invalid stick table track ID. Expects %s(<Track ID>)", args[*arg-1]);
+		return ACT_RET_PRS_ERR;
+	}
+	cmd_name++; /* jump the '(' */
+	rule->arg.gpc.sc = strtol(cmd_name, &error, 10); /* Convert stick table id. */
+	if (*error != ')' || error[1]) {
+		memprintf(err, "invalid stick table track ID. Expects sc-take-token(<Track ID>)");
+		return ACT_RET_PRS_ERR;
+	}
+
+	if (rule->arg.gpc.sc >= MAX_SESS_STKCTR) {
+		memprintf(err, "invalid stick table track ID. The max allowed ID is %d",
+		          MAX_SESS_STKCTR-1);
+		return ACT_RET_PRS_ERR;
+	}
+
+	rule->action_ptr = action_take_token;
+	rule->action = ACT_CUSTOM;
+	return ACT_RET_PRS_OK;
+}
+
 /* This function sets the gpt at index 'rule->arg.gpt.idx' of the array on the
  * tracksc counter of index 'rule->arg.gpt.sc' stored into the <stream> or
  * directly in the session <sess> if <stream> is set to NULL. This gpt is
@@ -4383,6 +5672,71 @@ smp_fetch_sc_trackers(const struct arg *args, struct sample *smp, const char *kw
 }
 
 
+/* set <smp> to the number of tokens available in the gcra token bucket of the
+ * stream's tracked frontend counters. Supports being called as "sc_tokens"
+ * only.
+ */
+static int
+smp_fetch_sc_tokens(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	struct stkctr tmpstkctr;
+	struct stkctr *stkctr;
+	void *ptr;
+
+	stkctr = smp_fetch_sc_stkctr(smp->sess, smp->strm, args, kw, &tmpstkctr);
+	if (!stkctr)
+		return 0;
+
+	smp->flags = SMP_F_VOL_TEST;
+	smp->data.type = SMP_T_SINT;
+	smp->data.u.sint = 0;
+
+	if (!stkctr_entry(stkctr))
+		return 1;
+
+	ptr = stktable_data_ptr(stkctr->table, stkctr_entry(stkctr), STKTABLE_DT_GCRA);
+	if (ptr)
+		smp->data.u.sint = stktable_gcra_tokens(stkctr->table, ptr);
+
+	if (stkctr == &tmpstkctr)
+		stktable_release(stkctr->table, stkctr_entry(stkctr));
+	return !!ptr;
+}
+
+/* Takes one token from the gcra token bucket of the stream's tracked frontend
+ * counters and sets <smp> to 1 if it was taken, or 0 if the bucket was empty
+ * or the counter is not tracked. Supports being called as "sc_take_token"
+ * only.
+ */
+static int
+smp_fetch_sc_take_token(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	struct stkctr tmpstkctr;
+	struct stkctr *stkctr;
+	void *ptr;
+
+	stkctr = smp_fetch_sc_stkctr(smp->sess, smp->strm, args, kw, &tmpstkctr);
+	if (!stkctr)
+		return 0;
+
+	smp->flags = SMP_F_VOL_TEST;
+	smp->data.type = SMP_T_BOOL;
+	smp->data.u.sint = 0;
+
+	if (!stkctr_entry(stkctr))
+		return 1;
+
+	ptr = stktable_data_ptr(stkctr->table, stkctr_entry(stkctr), STKTABLE_DT_GCRA);
+	if (ptr && stktable_gcra_take(stkctr->table, ptr, 1)) {
+		smp->data.u.sint = 1;
+		/* If data was modified, we need to touch to re-schedule sync */
+		stktable_touch_local(stkctr->table, stkctr_entry(stkctr), (stkctr == &tmpstkctr) ? 1 : 0);
+	}
+	else if (stkctr == &tmpstkctr)
+		stktable_release(stkctr->table, stkctr_entry(stkctr));
+	return !!ptr;
+}
+
 /* The functions below are used to manipulate table contents from the CLI.
  * There are 3 main actions, "clear", "set" and "show". The code is shared
  * between all actions, and the action is encoded in the void *private in
@@ -4510,10 +5864,19 @@ static int table_dump_entry_to_buffer(struct buffer *msg,
 		}
 		if (stktable_data_types[dt].arg_type == ARG_T_DELAY)
 			chunk_appendf(msg, " %s(%u)=", stktable_data_types[dt].name, t->data_arg[dt].u);
+		else if (stktable_data_types[dt].arg_type == ARG_T_RATE)
+			chunk_appendf(msg, " %s(%u,%u)=", stktable_data_types[dt].name,
+			              t->data_arg[dt].rate.cnt, t->data_arg[dt].rate.period);
 		else
 			chunk_appendf(msg, " %s=", stktable_data_types[dt].name);
 
 		ptr = stktable_data_ptr(t, entry, dt);
+		if (dt == STKTABLE_DT_GCRA) {
+			/* report the available tokens, not the internal date */
+			chunk_appendf(msg, "%u", stktable_gcra_tokens(t, ptr));
+			continue;
+		}
+
 		switch (stktable_data_types[dt].std_type) {
 		case STD_T_SINT:
 			chunk_appendf(msg, "%d", stktable_data_cast(ptr, std_t_sint));
@@ -4550,6 +5913,7 @@ struct show_table_ctx {
 	void *target;                               /* table we want to dump, or NULL for all */
 	struct stktable *t;                         /* table being currently dumped (first if NULL) */
 	struct stksess *entry;                      /* last entry we were trying to dump (or first if NULL) */
+	unsigned int shard;                         /* table shard being currently dumped */
 	long long value[STKTABLE_FILTER_LEN];       /* value to compare against */
 	signed char data_type[STKTABLE_FILTER_LEN]; /* type of data to compare, or -1 if none */
 	signed char data_op[STKTABLE_FILTER_LEN];   /* operator (STD_OP_*) when data_type set */
@@ -4696,6 +6060,12 @@ static int table_process_entry_per_key(struct appctx *appctx, char **args)
 
 			ptr = stktable_data_ptr(t, ts, data_type);
 
+			if (data_type == STKTABLE_DT_GCRA) {
+				/* the value is the number of available tokens */
+				stktable_gcra_set(t, ptr, value);
+				continue;
+			}
+
 			switch (stktable_data_types[data_type].std_type) {
 			case STD_T_SINT:
 				stktable_data_cast(ptr, std_t_sint) = value;
@@ -4827,9 +6197,11 @@ static int cli_io_handler_table(struct appctx *appctx)
 	struct show_table_ctx *ctx = appctx->svcctx;
 	struct stconn *sc = appctx_sc(appctx);
 	struct stream *s = __sc_strm(sc);
+	struct stktable_shard *shard;
 	struct ebmb_node *eb;
 	int skip_entry;
 	int show = ctx->action == STK_CLI_ACT_SHOW;
+	int budget = CLI_DUMP_BATCH;
 
 	/*
 	 * We have 3 possible states in ctx->state :
@@ -4869,22 +6241,35 @@ static int cli_io_handler_table(struct appctx *appctx)
 				if (ctx->target &&
 				    (strm_li(s)->bind_conf->level & ACCESS_LVL_MASK) >= ACCESS_LVL_OPER) {
 					/* dump entries only if table explicitly requested */
-					HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &ctx->t->lock);
-					eb = ebmb_first(&ctx->t->keys);
-					if (eb) {
-						ctx->entry = ebmb_entry(eb, struct stksess, key);
-						ctx->entry->ref_cnt++;
-						ctx->state = STATE_DUMP;
-						HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &ctx->t->lock);
-						break;
+					for (ctx->shard = 0; ctx->shard < ctx->t->nb_shards; ctx->shard++) {
+						shard = &ctx->t->shards[ctx->shard];
+						HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &shard->lock);
+						eb = ebmb_first(&shard->keys);
+						if (eb) {
+							ctx->entry = ebmb_entry(eb, struct stksess, key);
+							HA_ATOMIC_INC(&ctx->entry->ref_cnt);
+							ctx->state = STATE_DUMP;
+						}
+						HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &shard->lock);
+						if (eb)
+							break;
 					}
-					HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &ctx->t->lock);
+					if (ctx->state == STATE_DUMP)
+						break;
 				}
 			}
 			ctx->t = ctx->t->next;
 			break;
 
 		case STATE_DUMP:
+			if (budget-- <= 0) {
+				/* let other tasks run, we still hold a
+				 * reference on the next entry.
+				 */
+				applet_have_more_data(appctx);
+				return 0;
+			}
+
 			skip_entry = 0;
 
 			HA_RWLOCK_RDLOCK(STK_SESS_LOCK, &ctx->entry->lock);
@@ -4905,6 +6290,9 @@ static int cli_io_handler_table(struct appctx *appctx)
 								ctx->entry,
 								dt);
 
+					if (!ptr)
+						continue;
+
 					data = 0;
 					switch (stktable_data_types[dt].std_type) {
 					case STD_T_SINT:
@@ -4922,6 +6310,10 @@ static int cli_io_handler_table(struct appctx *appctx)
 						break;
 					}
 
+					/* the available tokens are compared, not the internal date */
+					if (dt == STKTABLE_DT_GCRA)
+						data = stktable_gcra_tokens(ctx->t, ptr);
+
 					op = ctx->data_op[i];
 					value = ctx->value[i];
 
@@ -4946,8 +6338,9 @@ static int cli_io_handler_table(struct appctx *appctx)
 
 			HA_RWLOCK_RDUNLOCK(STK_SESS_LOCK, &ctx->entry->lock);
 
-			HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &ctx->t->lock);
-			ctx->entry->ref_cnt--;
+			shard = &ctx->t->shards[ctx->shard];
+			HA_RWLOCK_WRLOCK(STK_TABLE_LOCK, &shard->lock);
+			HA_ATOMIC_DEC(&ctx->entry->ref_cnt);
 
 			eb = ebmb_next(&ctx->entry->key);
 			if (eb) {
@@ -4957,8 +6350,8 @@ static int cli_io_handler_table(struct appctx *appctx)
 					__stksess_kill_if_expired(ctx->t, old);
 				else if (!skip_entry && !ctx->entry->ref_cnt)
 					__stksess_kill(ctx->t, old);
-				ctx->entry->ref_cnt++;
-				HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &ctx->t->lock);
+				HA_ATOMIC_INC(&ctx->entry->ref_cnt);
+				HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
 				break;
 			}
 
@@ -4968,7 +6361,24 @@ static int cli_io_handler_table(struct appctx *appctx)
 			else if (!skip_entry && !ctx->entry->ref_cnt)
 				__stksess_kill(ctx->t, ctx->entry);
 
-			HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &ctx->t->lock);
+			HA_RWLOCK_WRUNLOCK(STK_TABLE_LOCK, &shard->lock);
+
+			/* this shard is finished, look for the first entry of the next ones */
+			while (++ctx->shard < ctx->t->nb_shards) {
+				shard = &ctx->t->shards[ctx->shard];
+				HA_RWLOCK_RDLOCK(STK_TABLE_LOCK, &shard->lock);
+				eb = ebmb_first(&shard->keys);
+				if (eb) {
+					ctx->entry = ebmb_entry(eb, struct stksess, key);
+					HA_ATOMIC_INC(&ctx->entry->ref_cnt);
+				}
+				HA_RWLOCK_RDUNLOCK(STK_TABLE_LOCK, &shard->lock);
+				if (eb)
+					break;
+			}
+
+			if (ctx->shard < ctx->t->nb_shards)
+				break;
 
 			ctx->t = ctx->t->next;
 			ctx->state = STATE_NEXT;
@@ -5017,6 +6427,7 @@ static struct action_kw_list tcp_conn_kws = { { }, {
 	{ "sc-inc-gpc1", parse_inc_gpc,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt",  parse_set_gpt,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt0", parse_set_gpt,  KWF_MATCH_PREFIX },
+	{ "sc-take-token", parse_take_token, KWF_MATCH_PREFIX },
 	{ /* END */ }
 }};
 
@@ -5028,6 +6439,7 @@ static struct action_kw_list tcp_sess_kws = { { }, {
 	{ "sc-inc-gpc1", parse_inc_gpc,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt",  parse_set_gpt,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt0", parse_set_gpt,  KWF_MATCH_PREFIX },
+	{ "sc-take-token", parse_take_token, KWF_MATCH_PREFIX },
 	{ /* END */ }
 }};
 
@@ -5039,6 +6451,7 @@ static struct action_kw_list tcp_req_kws = { { }, {
 	{ "sc-inc-gpc1", parse_inc_gpc,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt",  parse_set_gpt,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt0", parse_set_gpt,  KWF_MATCH_PREFIX },
+	{ "sc-take-token", parse_take_token, KWF_MATCH_PREFIX },
 	{ /* END */ }
 }};
 
@@ -5050,6 +6463,7 @@ static struct action_kw_list tcp_res_kws = { { }, {
 	{ "sc-inc-gpc1", parse_inc_gpc,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt",  parse_set_gpt,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt0", parse_set_gpt,  KWF_MATCH_PREFIX },
+	{ "sc-take-token", parse_take_token, KWF_MATCH_PREFIX },
 	{ /* END */ }
 }};
 
@@ -5061,6 +6475,7 @@ static struct action_kw_list http_req_kws = { { }, {
 	{ "sc-inc-gpc1", parse_inc_gpc,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt",  parse_set_gpt,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt0", parse_set_gpt,  KWF_MATCH_PREFIX },
+	{ "sc-take-token", parse_take_token, KWF_MATCH_PREFIX },
 	{ /* END */ }
 }};
 
@@ -5072,6 +6487,7 @@ static struct action_kw_list http_res_kws = { { }, {
 	{ "sc-inc-gpc1", parse_inc_gpc,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt",  parse_set_gpt,  KWF_MATCH_PREFIX },
 	{ "sc-set-gpt0", parse_set_gpt,  KWF_MATCH_PREFIX },
+	{ "sc-take-token", parse_take_token, KWF_MATCH_PREFIX },
 	{ /* END */ }
 }};
 
@@ -5110,6 +6526,8 @@ static struct sample_fetch_kw_list smp_fetch_keywords = {ILH, {
 	{ "sc_kbytes_out",      smp_fetch_sc_kbytes_out,     ARG2(1,SINT,TAB), NULL, SMP_T_SINT, SMP_USE_L4CLI, },
 	{ "sc_sess_cnt",        smp_fetch_sc_sess_cnt,       ARG2(1,SINT,TAB), NULL, SMP_T_SINT, SMP_USE_INTRN, },
 	{ "sc_sess_rate",       smp_fetch_sc_sess_rate,      ARG2(1,SINT,TAB), NULL, SMP_T_SINT, SMP_USE_INTRN, },
+	{ "sc_take_token",      smp_fetch_sc_take_token,     ARG2(1,SINT,TAB), NULL, SMP_T_BOOL, SMP_USE_INTRN, },
+	{ "sc_tokens",          smp_fetch_sc_tokens,         ARG2(1,SINT,TAB), NULL, SMP_T_SINT, SMP_USE_INTRN, },
 	{ "sc_tracked",         smp_fetch_sc_tracked,        ARG2(1,SINT,TAB), NULL, SMP_T_BOOL, SMP_USE_INTRN, },
 	{ "sc_trackers",        smp_fetch_sc_trackers,       ARG2(1,SINT,TAB), NULL, SMP_T_SINT, SMP_USE_INTRN, },
 	{ "sc0_bytes_in_rate",  smp_fetch_sc_bytes_in_rate,  ARG1(0,TAB),      NULL, SMP_T_SINT, SMP_USE_INTRN, },
@@ -5257,6 +6675,8 @@ static struct sample_conv_kw_list sample_conv_kws = {ILH, {
 	{ "table_server_id",      sample_conv_table_server_id,      ARG1(1,TAB),  NULL, SMP_T_ANY,  SMP_T_SINT  },
 	{ "table_sess_cnt",       sample_conv_table_sess_cnt,       ARG1(1,TAB),  NULL, SMP_T_ANY,  SMP_T_SINT  },
 	{ "table_sess_rate",      sample_conv_table_sess_rate,      ARG1(1,TAB),  NULL, SMP_T_ANY,  SMP_T_SINT  },
+	{ "table_sketch_rate",    sample_conv_table_sketch_rate,    ARG1(1,TAB),  NULL, SMP_T_ANY,  SMP_T_SINT  },
+	{ "table_tokens",         sample_conv_table_tokens,         ARG1(1,TAB),  NULL, SMP_T_ANY,  SMP_T_SINT  },
 	{ "table_trackers",       sample_conv_table_trackers,       ARG1(1,TAB),  NULL, SMP_T_ANY,  SMP_T_SINT  },
 	{ /* END */ },
 }};
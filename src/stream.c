@@ -25,6 +25,7 @@
 #include <haproxy/capture.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/channel.h>
+#include <haproxy/counters.h>
 #include <haproxy/check.h>
 #include <haproxy/cli.h>
 #include <haproxy/connection.h>
@@ -59,11 +60,13 @@
 #include <haproxy/thread.h>
 #include <haproxy/tools.h>
 #include <haproxy/trace.h>
+#include <haproxy/usdt.h>
 #include <haproxy/vars.h>
 
 
 DECLARE_POOL(pool_head_stream, "stream", sizeof(struct stream));
 DECLARE_POOL(pool_head_uniqueid, "uniqueid", UNIQUEID_LEN);
+DECLARE_STATIC_POOL(pool_head_stream_store, "strm_store", STREAM_MAX_STORE * sizeof(struct stream_store));
 
 /* incremented by each "show sess" to fix a delimiter between streams */
 unsigned stream_epoch = 0;
@@ -323,6 +326,11 @@ int stream_buf_available(void *arg)
 	else
 		return 0;
 
+	if (s->bufwait_date) {
+		s->bufwait_time += (uint32_t)((uint32_t)now_mono_time() - s->bufwait_date);
+		s->bufwait_date = 0;
+	}
+
 	task_wakeup(s->task, TASK_WOKEN_RES);
 	return 1;
 
@@ -384,6 +392,7 @@ struct stream *stream_new(struct session *sess, struct stconn *sc, struct buffer
 	 */
 	s->current_rule_list = NULL;
 	s->current_rule = NULL;
+	s->smp_cache = NULL;
 	s->rules_exp = TICK_ETERNITY;
 	s->last_rule_file = NULL;
 	s->last_rule_line = 0;
@@ -409,9 +418,14 @@ struct stream *stream_new(struct session *sess, struct stconn *sc, struct buffer
 	s->buffer_wait.wakeup_cb = stream_buf_available;
 
 	s->lat_time = s->cpu_time = 0;
+	s->req_ana_time = s->res_ana_time = s->flt_time = s->lua_time = 0;
+	s->bufwait_time = 0;
+	s->bufwait_date = 0;
 	s->call_rate.curr_tick = s->call_rate.curr_ctr = s->call_rate.prev_ctr = 0;
 	s->pcli_next_pid = 0;
 	s->pcli_flags = 0;
+	s->pcli_fanout_pos = 0;
+	s->pcli_fanout_cmd = IST_NULL;
 	s->unique_id = IST_NULL;
 
 	if ((t = task_new_here()) == NULL)
@@ -491,6 +505,7 @@ struct stream *stream_new(struct session *sess, struct stconn *sc, struct buffer
 	s->priority_offset = 0;
 
 	/* init store persistence */
+	s->store = NULL;
 	s->store_count = 0;
 
 	channel_init(&s->req);
@@ -569,6 +584,7 @@ struct stream *stream_new(struct session *sess, struct stconn *sc, struct buffer
 	 * stream is fully initialized before calling task_wakeup. So
 	 * the caller must handle the task_wakeup
 	 */
+	HA_USDT(stream_start, s, sess, sess->fe, s->uniq_id);
 	DBG_TRACE_LEAVE(STRM_EV_STRM_NEW, s);
 	task_wakeup(s->task, TASK_WOKEN_INIT);
 	return s;
@@ -598,6 +614,7 @@ void stream_free(struct stream *s)
 	int i;
 
 	DBG_TRACE_POINT(STRM_EV_STRM_FREE, s);
+	HA_USDT(stream_end, s, fe, s->be, objt_server(s->target), s->uniq_id, s->flags);
 
 	/* detach the stream from its own task before even releasing it so
 	 * that walking over a task list never exhibits a dying stream.
@@ -664,6 +681,8 @@ void stream_free(struct stream *s)
 		stksess_free(s->store[i].table, s->store[i].ts);
 		s->store[i].ts = NULL;
 	}
+	pool_free(pool_head_stream_store, s->store);
+	s->store = NULL;
 
 	if (s->resolv_ctx.requester) {
 		__decl_thread(struct resolvers *resolvers = s->resolv_ctx.parent->arg.resolv.resolvers);
@@ -695,9 +714,9 @@ void stream_free(struct stream *s)
 	}
 
 	/* Cleanup all variable contexts. */
-	if (!LIST_ISEMPTY(&s->vars_txn.head))
+	if (!eb_is_empty(&s->vars_txn.name_root))
 		vars_prune(&s->vars_txn, s->sess, s);
-	if (!LIST_ISEMPTY(&s->vars_reqres.head))
+	if (!eb_is_empty(&s->vars_reqres.name_root))
 		vars_prune(&s->vars_reqres, s->sess, s);
 
 	stream_store_counters(s);
@@ -720,6 +739,8 @@ void stream_free(struct stream *s)
 	sc_destroy(s->scb);
 	sc_destroy(s->scf);
 
+	pool_free(pool_head_smp_cache, s->smp_cache);
+	ha_free(&s->pcli_fanout_cmd.ptr);
 	pool_free(pool_head_stream, s);
 
 	/* We may want to free the maximum amount of pools if the proxy is stopping */
@@ -788,14 +809,14 @@ void stream_process_counters(struct stream *s)
 	bytes = s->req.total - s->logs.bytes_in;
 	s->logs.bytes_in = s->req.total;
 	if (bytes) {
-		_HA_ATOMIC_ADD(&sess->fe->fe_counters.bytes_in, bytes);
-		_HA_ATOMIC_ADD(&s->be->be_counters.bytes_in,    bytes);
+		COUNTERS_ADD(&sess->fe->fe_counters, bytes_in, bytes);
+		COUNTERS_ADD(&s->be->be_counters, bytes_in, bytes);
 
 		if (objt_server(s->target))
-			_HA_ATOMIC_ADD(&__objt_server(s->target)->counters.bytes_in, bytes);
+			COUNTERS_ADD(&__objt_server(s->target)->counters, bytes_in, bytes);
 
 		if (sess->listener && sess->listener->counters)
-			_HA_ATOMIC_ADD(&sess->listener->counters->bytes_in, bytes);
+			COUNTERS_ADD(sess->listener->counters, bytes_in, bytes);
 
 		for (i = 0; i < MAX_SESS_STKCTR; i++) {
 			if (!stkctr_inc_bytes_in_ctr(&s->stkctr[i], bytes))
@@ -806,14 +827,14 @@ void stream_process_counters(struct stream *s)
 	bytes = s->res.total - s->logs.bytes_out;
 	s->logs.bytes_out = s->res.total;
 	if (bytes) {
-		_HA_ATOMIC_ADD(&sess->fe->fe_counters.bytes_out, bytes);
-		_HA_ATOMIC_ADD(&s->be->be_counters.bytes_out,    bytes);
+		COUNTERS_ADD(&sess->fe->fe_counters, bytes_out, bytes);
+		COUNTERS_ADD(&s->be->be_counters, bytes_out, bytes);
 
 		if (objt_server(s->target))
-			_HA_ATOMIC_ADD(&__objt_server(s->target)->counters.bytes_out, bytes);
+			COUNTERS_ADD(&__objt_server(s->target)->counters, bytes_out, bytes);
 
 		if (sess->listener && sess->listener->counters)
-			_HA_ATOMIC_ADD(&sess->listener->counters->bytes_out, bytes);
+			COUNTERS_ADD(sess->listener->counters, bytes_out, bytes);
 
 		for (i = 0; i < MAX_SESS_STKCTR; i++) {
 			if (!stkctr_inc_bytes_out_ctr(&s->stkctr[i], bytes))
@@ -912,6 +933,13 @@ static void back_establish(struct stream *s)
 		health_adjust(__objt_server(s->target), HANA_STATUS_L4_OK);
 
 	if (!IS_HTX_STRM(s)) { /* let's allow immediate data connection in this case */
+		/* the server address is now known by the connection and a TCP
+		 * stream will not connect again, so the copy may go away. This
+		 * matters with many long-lived idle connections.
+		 */
+		if (conn && conn->dst)
+			sockaddr_free(&s->scb->dst);
+
 		/* if the user wants to log as soon as possible, without counting
 		 * bytes from the server, then this is the right moment. */
 		if (!LIST_ISEMPTY(&strm_fe(s)->logformat) && !(s->logs.logwait & LW_BYTES)) {
@@ -1049,9 +1077,18 @@ static int process_switching_rules(struct stream *s, struct channel *req, int an
 		struct switching_rule *rule;
 
 		list_for_each_entry(rule, &fe->switching_rules, list) {
+			struct switching_rule *match;
 			int ret = 1;
 
-			if (rule->cond) {
+			if (rule->run && switching_run_match(rule, fe, sess, s, &match)) {
+				if (!match) {
+					/* none of the rules of this run matches */
+					rule = rule->run->last;
+					continue;
+				}
+				rule = match;
+			}
+			else if (rule->cond) {
 				ret = acl_exec_cond(rule->cond, fe, sess, s, SMP_OPT_DIR_REQ|SMP_OPT_FINAL);
 				ret = acl_pass(ret);
 				if (rule->cond->pol == ACL_COND_UNLESS)
@@ -1073,7 +1110,7 @@ static int process_switching_rules(struct stream *s, struct channel *req, int an
 						goto sw_failed;
 
 					if (build_logline(s, tmp->area, tmp->size, &rule->be.expr))
-						backend = proxy_be_by_name(tmp->area);
+						backend = proxy_be_by_name_cached(tmp->area);
 
 					free_trash_chunk(tmp);
 					tmp = NULL;
@@ -1192,7 +1229,7 @@ static int process_server_rules(struct stream *s, struct channel *req, int an_bi
 					if (!build_logline(s, tmp->area, tmp->size, &rule->expr))
 						break;
 
-					srv = findserver(s->be, tmp->area);
+					srv = findserver_indexed(s->be, tmp->area);
 					if (!srv)
 						break;
 				}
@@ -1272,6 +1309,28 @@ static inline void sticking_rule_find_target(struct stream *s,
 	}
 }
 
+/* Prepares a new stickiness entry for <key> in table <t> to be stored once the
+ * response is processed. The store array is only allocated on first use so
+ * that streams without store rules do not pay for it. Entries beyond
+ * STREAM_MAX_STORE and allocation failures are silently ignored.
+ */
+static void stream_add_store(struct stream *s, struct stktable *t, struct stktable_key *key)
+{
+	struct stksess *ts;
+
+	if (s->store_count >= STREAM_MAX_STORE)
+		return;
+
+	if (!s->store && (s->store = pool_alloc(pool_head_stream_store)) == NULL)
+		return;
+
+	ts = stksess_new(t, key);
+	if (ts) {
+		s->store[s->store_count].table = t;
+		s->store[s->store_count++].ts = ts;
+	}
+}
+
 /* This stream analyser works on a request. It applies all sticking rules on
  * it then returns 1. The data must already be present in the buffer otherwise
  * they won't match. It always returns 1.
@@ -1329,15 +1388,7 @@ static int process_sticking_rules(struct stream *s, struct channel *req, int an_
 				}
 			}
 			if (rule->flags & STK_IS_STORE) {
-				if (s->store_count < (sizeof(s->store) / sizeof(s->store[0]))) {
-					struct stksess *ts;
-
-					ts = stksess_new(rule->table.t, key);
-					if (ts) {
-						s->store[s->store_count].table = rule->table.t;
-						s->store[s->store_count++].ts = ts;
-					}
-				}
+				stream_add_store(s, rule->table.t, key);
 			}
 		}
 	}
@@ -1400,15 +1451,7 @@ static int process_store_rules(struct stream *s, struct channel *rep, int an_bit
 			if (!key)
 				continue;
 
-			if (s->store_count < (sizeof(s->store) / sizeof(s->store[0]))) {
-				struct stksess *ts;
-
-				ts = stksess_new(rule->table.t, key);
-				if (ts) {
-					s->store[s->store_count].table = rule->table.t;
-					s->store[s->store_count++].ts = ts;
-				}
-			}
+			stream_add_store(s, rule->table.t, key);
 		}
 	}
 
@@ -1457,6 +1500,8 @@ static int process_store_rules(struct stream *s, struct channel *rep, int an_bit
 		stktable_touch_local(t, ts, 1);
 	}
 	s->store_count = 0; /* everything is stored */
+	pool_free(pool_head_stream_store, s->store);
+	s->store = NULL;
 
 	rep->analysers &= ~an_bit;
 	rep->analyse_exp = TICK_ETERNITY;
@@ -1633,6 +1678,7 @@ void stream_update_timings(struct task *t, uint64_t lat, uint64_t cpu)
 #define FLT_ANALYZE(strm, chn, fun, list, back, flag, ...)			\
 	{									\
 		if ((list) & (flag)) {						\
+			stream_smp_cache_flush(strm);				\
 			if (HAS_FILTERS(strm)) {			        \
 				if (!flt_pre_analyze((strm), (chn), (flag)))    \
 					break;				        \
@@ -1653,6 +1699,7 @@ void stream_update_timings(struct task *t, uint64_t lat, uint64_t cpu)
 #define ANALYZE(strm, chn, fun, list, back, flag, ...)			\
 	{								\
 		if ((list) & (flag)) {					\
+			stream_smp_cache_flush(strm);			\
 			if (!fun((strm), (chn), (flag), ##__VA_ARGS__))	\
 				break;					\
 			UPDATE_ANALYSERS((chn)->analysers, (list),	\
@@ -1954,6 +2001,7 @@ struct task *process_stream(struct task *t, void *context, unsigned int state)
 			int max_loops = global.tune.maxpollevents;
 			unsigned int ana_list;
 			unsigned int ana_back;
+			uint32_t ana_start;
 
 			/* it's up to the analysers to stop new connections,
 			 * disable reading or closing. Note: if an analyser
@@ -1999,6 +2047,7 @@ struct task *process_stream(struct task *t, void *context, unsigned int state)
 			 * analyser and must immediately loop again.
 			 */
 
+			ana_start = stream_timing_start();
 			ana_list = ana_back = req->analysers;
 			while (ana_list && max_loops--) {
 				/* Warning! ensure that analysers are always placed in ascending order! */
@@ -2023,6 +2072,7 @@ struct task *process_stream(struct task *t, void *context, unsigned int state)
 				ANALYZE    (s, req, flt_end_analyze,            ana_list, ana_back, AN_REQ_FLT_END);
 				break;
 			}
+			stream_timing_stop(&s->req_ana_time, ana_start);
 		}
 
 		rq_prod_last = scf->state;
@@ -2055,6 +2105,7 @@ struct task *process_stream(struct task *t, void *context, unsigned int state)
 			int max_loops = global.tune.maxpollevents;
 			unsigned int ana_list;
 			unsigned int ana_back;
+			uint32_t ana_start;
 
 			/* it's up to the analysers to stop disable reading or
 			 * closing. Note: if an analyser disables any of these
@@ -2076,6 +2127,7 @@ struct task *process_stream(struct task *t, void *context, unsigned int state)
 			 * are added in the middle.
 			 */
 
+			ana_start = stream_timing_start();
 			ana_list = ana_back = res->analysers;
 			while (ana_list && max_loops--) {
 				/* Warning! ensure that analysers are always placed in ascending order! */
@@ -2092,6 +2144,7 @@ struct task *process_stream(struct task *t, void *context, unsigned int state)
 				ANALYZE    (s, res, flt_end_analyze,            ana_list, ana_back, AN_RES_FLT_END);
 				break;
 			}
+			stream_timing_stop(&s->res_ana_time, ana_start);
 		}
 
 		rp_cons_last = scf->state;
@@ -2268,7 +2321,7 @@ struct task *process_stream(struct task *t, void *context, unsigned int state)
 	    (global.tune.options & GTUNE_USE_SPLICE) &&
 	    (sc_conn(scf) && __sc_conn(scf)->xprt && __sc_conn(scf)->xprt->rcv_pipe &&
 	     __sc_conn(scf)->mux && __sc_conn(scf)->mux->rcv_pipe) &&
-	    (sc_conn(scb) && __sc_conn(scb)->xprt && __sc_conn(scb)->xprt->snd_pipe &&
+	    (sc_conn(scb) && conn_xprt_can_snd_pipe(__sc_conn(scb)) &&
 	     __sc_conn(scb)->mux && __sc_conn(scb)->mux->snd_pipe) &&
 	    (pipes_used < global.maxpipes) &&
 	    (((sess->fe->options2|s->be->options2) & PR_O2_SPLIC_REQ) ||
@@ -2314,7 +2367,7 @@ struct task *process_stream(struct task *t, void *context, unsigned int state)
 	if (sc_state_in(scb->state, SC_SB_REQ|SC_SB_QUE|SC_SB_TAR|SC_SB_ASS)) {
 		/* prune the request variables and swap to the response variables. */
 		if (s->vars_reqres.scope != SCOPE_RES) {
-			if (!LIST_ISEMPTY(&s->vars_reqres.head))
+			if (!eb_is_empty(&s->vars_reqres.name_root))
 				vars_prune(&s->vars_reqres, s->sess, s);
 			vars_init_head(&s->vars_reqres, SCOPE_RES);
 		}
@@ -2460,7 +2513,7 @@ struct task *process_stream(struct task *t, void *context, unsigned int state)
 	if (!(res->flags & (CF_KERN_SPLICING|CF_SHUTR)) &&
 	    res->to_forward &&
 	    (global.tune.options & GTUNE_USE_SPLICE) &&
-	    (sc_conn(scf) && __sc_conn(scf)->xprt && __sc_conn(scf)->xprt->snd_pipe &&
+	    (sc_conn(scf) && conn_xprt_can_snd_pipe(__sc_conn(scf)) &&
 	     __sc_conn(scf)->mux && __sc_conn(scf)->mux->snd_pipe) &&
 	    (sc_conn(scb) && __sc_conn(scb)->xprt && __sc_conn(scb)->xprt->rcv_pipe &&
 	     __sc_conn(scb)->mux && __sc_conn(scb)->mux->rcv_pipe) &&
@@ -2604,12 +2657,12 @@ struct task *process_stream(struct task *t, void *context, unsigned int state)
 				n = 0;
 
 			if (sess->fe->mode == PR_MODE_HTTP) {
-				_HA_ATOMIC_INC(&sess->fe->fe_counters.p.http.rsp[n]);
+				COUNTERS_INC(&sess->fe->fe_counters, rsp[n]);
 			}
 			if ((s->flags & SF_BE_ASSIGNED) &&
 			    (s->be->mode == PR_MODE_HTTP)) {
-				_HA_ATOMIC_INC(&s->be->be_counters.p.http.rsp[n]);
-				_HA_ATOMIC_INC(&s->be->be_counters.p.http.cum_req);
+				COUNTERS_INC(&s->be->be_counters, rsp[n]);
+				COUNTERS_INC(&s->be->be_counters, cum_req);
 			}
 		}
 
@@ -2666,19 +2719,25 @@ void stream_update_time_stats(struct stream *s)
 
 	srv = objt_server(s->target);
 	if (srv) {
-		samples_window = (((s->be->mode == PR_MODE_HTTP) ?
-			srv->counters.p.http.cum_req : srv->counters.cum_lbconn) > TIME_STATS_SAMPLES) ? TIME_STATS_SAMPLES : 0;
+		samples_window = ((s->be->mode == PR_MODE_HTTP) ?
+				  COUNTERS_ABOVE(&srv->counters, cum_req, TIME_STATS_SAMPLES) :
+				  srv->counters.cum_lbconn > TIME_STATS_SAMPLES) ? TIME_STATS_SAMPLES : 0;
 		swrate_add_dynamic(&srv->counters.q_time, samples_window, t_queue);
 		swrate_add_dynamic(&srv->counters.c_time, samples_window, t_connect);
 		swrate_add_dynamic(&srv->counters.d_time, samples_window, t_data);
 		swrate_add_dynamic(&srv->counters.t_time, samples_window, t_close);
+		if ((s->be->lbprm.algo & BE_LB_ALGO) == BE_LB_ALGO_EWMA) {
+			swrate_add_peak(&srv->lb_ewma, LB_EWMA_SAMPLES, t_connect + t_data);
+			HA_ATOMIC_STORE(&srv->lb_ewma_date, now_ms);
+		}
 		HA_ATOMIC_UPDATE_MAX(&srv->counters.qtime_max, t_queue);
 		HA_ATOMIC_UPDATE_MAX(&srv->counters.ctime_max, t_connect);
 		HA_ATOMIC_UPDATE_MAX(&srv->counters.dtime_max, t_data);
 		HA_ATOMIC_UPDATE_MAX(&srv->counters.ttime_max, t_close);
 	}
-	samples_window = (((s->be->mode == PR_MODE_HTTP) ?
-		s->be->be_counters.p.http.cum_req : s->be->be_counters.cum_lbconn) > TIME_STATS_SAMPLES) ? TIME_STATS_SAMPLES : 0;
+	samples_window = ((s->be->mode == PR_MODE_HTTP) ?
+			  COUNTERS_ABOVE(&s->be->be_counters, cum_req, TIME_STATS_SAMPLES) :
+			  s->be->be_counters.cum_lbconn > TIME_STATS_SAMPLES) ? TIME_STATS_SAMPLES : 0;
 	swrate_add_dynamic(&s->be->be_counters.q_time, samples_window, t_queue);
 	swrate_add_dynamic(&s->be->be_counters.c_time, samples_window, t_connect);
 	swrate_add_dynamic(&s->be->be_counters.d_time, samples_window, t_data);
@@ -3372,6 +3431,13 @@ static int stats_dump_full_strm_to_buffer(struct stconn *sc, struct stream *strm
 			     " age=%s)\n",
 			     human_time(now.tv_sec - strm->logs.accept_date.tv_sec, 1));
 
+		chunk_appendf(&trash,
+			     "  timings (ns): cpu=%llu lat=%llu req_ana=%llu res_ana=%llu flt=%llu lua=%llu bufwait=%llu\n",
+			     (ullong)strm->cpu_time, (ullong)strm->lat_time,
+			     (ullong)strm->req_ana_time, (ullong)strm->res_ana_time,
+			     (ullong)strm->flt_time, (ullong)strm->lua_time,
+			     (ullong)strm->bufwait_time);
+
 		if (strm->txn)
 			chunk_appendf(&trash,
 			      "  txn=%p flags=0x%x meth=%d status=%d req.st=%s rsp.st=%s req.f=0x%02x rsp.f=0x%02x\n",
@@ -3609,6 +3675,7 @@ static int cli_io_handler_dump_sess(struct appctx *appctx)
 	struct show_sess_ctx *ctx = appctx->svcctx;
 	struct stconn *sc = appctx_sc(appctx);
 	struct connection *conn;
+	int budget = CLI_DUMP_BATCH;
 
 	thread_isolate();
 
@@ -3662,6 +3729,15 @@ static int cli_io_handler_dump_sess(struct appctx *appctx)
 			continue;
 		}
 
+		if (budget-- <= 0) {
+			/* leave the isolation and let other threads run,
+			 * we'll continue from this stream.
+			 */
+			LIST_APPEND(&curr_strm->back_refs, &ctx->bref.users);
+			applet_have_more_data(appctx);
+			goto full;
+		}
+
 		if (ctx->target) {
 			if (ctx->target != (void *)-1 && ctx->target != curr_strm)
 				goto next_sess;
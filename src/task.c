@@ -18,6 +18,7 @@
 #include <haproxy/activity.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/clock.h>
+#include <haproxy/errors.h>
 #include <haproxy/fd.h>
 #include <haproxy/list.h>
 #include <haproxy/pool.h>
@@ -224,6 +225,26 @@ void __task_wakeup(struct task *t)
 
 		t->rq.key = _HA_ATOMIC_ADD_FETCH(&ha_thread_ctx[thr].rqueue_ticks, 1);
 		__ha_barrier_store();
+	}
+	else if ((global.tune.options & GTUNE_SCHED_WORK_STEAL) && t->tid < 0 && !t->nice &&
+	         tg->count > 1 && th_ctx->rq_total >= global.tune.runqueue_depth) {
+		ulong idle;
+
+		/* this unbound task is woken up while the thread already has
+		 * more than a full round of work. It is placed into the steal
+		 * list, where an idle thread of the group may pick it before
+		 * us, and one of them is woken up for this.
+		 */
+		_HA_ATOMIC_INC(&th_ctx->rq_total);
+		if (_HA_ATOMIC_LOAD(&th_ctx->flags) & TH_FL_TASK_PROFILING)
+			t->wake_date = now_mono_time();
+
+		MT_LIST_APPEND(&th_ctx->steal_list, list_to_mt_list(&((struct tasklet *)t)->list));
+
+		idle = _HA_ATOMIC_LOAD(&tg_ctx->threads_idle) & tg->threads_enabled & ~ti->ltid_bit;
+		if (idle)
+			wake_thread(tg->base + my_ffsl(idle) - 1);
+		return;
 	} else
 #endif
 	{
@@ -257,6 +278,204 @@ void __task_wakeup(struct task *t)
 	return;
 }
 
+/* Returns the index of the slot of timer wheel <tw> where a task expiring at
+ * <key> must be queued. Dates which are already reached go to the slot being
+ * processed.
+ */
+static inline unsigned int task_wheel_slot(const struct timer_wheel *tw, unsigned int key)
+{
+	unsigned int clock = tw->clock;
+	unsigned int level, shift;
+
+	if ((int)(key - clock) <= 0)
+		return clock & (TW_L0_SLOTS - 1);
+
+	if (key - clock < TW_L0_SLOTS)
+		return key & (TW_L0_SLOTS - 1);
+
+	for (level = 1, shift = TW_L0_BITS; level < TW_LEVELS - 1; level++, shift += TW_LN_BITS) {
+		/* number of slots of this level between the clock and the key */
+		if ((((key >> shift) - (clock >> shift)) & (~0U >> shift)) <= TW_LN_SLOTS)
+			break;
+	}
+	return TW_L0_SLOTS + (level - 1) * TW_LN_SLOTS + ((key >> shift) & (TW_LN_SLOTS - 1));
+}
+
+/* Queues task <t> into timer wheel <tw> at the date in its wq.key. It must not
+ * be in any wait queue.
+ */
+static void __task_wheel_queue(struct timer_wheel *tw, struct task *t)
+{
+	unsigned int idx = task_wheel_slot(tw, t->wq.key);
+
+	LIST_APPEND(&tw->slot[idx], task_wheel_link(t));
+	tw->map[idx / 64] |= 1ULL << (idx % 64);
+	t->wq.node.leaf_p = TASK_IN_WHEEL;
+	tw->count++;
+}
+
+/* Redistributes the tasks of the upper levels slots of timer wheel <tw> which
+ * start at the wheel's clock into the lower levels, starting from the highest
+ * one. Tasks whose expiration date was disabled are left unqueued.
+ */
+static void task_wheel_cascade(struct timer_wheel *tw)
+{
+	unsigned int level, shift, idx;
+	struct list *slot, tmp;
+	struct task *t;
+
+	for (level = TW_LEVELS - 1; level > 0; level--) {
+		shift = TW_L0_BITS + (level - 1) * TW_LN_BITS;
+		if (tw->clock & ((1U << shift) - 1))
+			continue;
+
+		idx = TW_L0_SLOTS + (level - 1) * TW_LN_SLOTS + ((tw->clock >> shift) & (TW_LN_SLOTS - 1));
+		slot = &tw->slot[idx];
+		if (LIST_ISEMPTY(slot))
+			continue;
+
+		/* detach the slot's tasks first, as some of them may have been
+		 * left there for a later date which uses the same slot again.
+		 */
+		tmp.n = slot->n;
+		tmp.p = slot->p;
+		tmp.n->p = tmp.p->n = &tmp;
+		LIST_INIT(slot);
+		tw->map[idx / 64] &= ~(1ULL << (idx % 64));
+
+		while (!LIST_ISEMPTY(&tmp)) {
+			t = task_from_wheel_link(tmp.n);
+			LIST_DELETE(tmp.n);
+			t->wq.node.leaf_p = NULL;
+			tw->count--;
+			if (tick_isset(t->expire)) {
+				t->wq.key = t->expire;
+				__task_wheel_queue(tw, t);
+			}
+		}
+	}
+}
+
+/* Moves the clock of timer wheel <tw>, whose level 0 was entirely processed,
+ * to the next date where something needs to be done, without going past the
+ * current date.
+ */
+static void task_wheel_skip(struct timer_wheel *tw)
+{
+	unsigned int level, shift, next;
+
+	if (tw->map[0] | tw->map[1] | tw->map[2] | tw->map[3])
+		return;
+
+	for (level = 1, shift = TW_L0_BITS; level < TW_LEVELS; level++, shift += TW_LN_BITS) {
+		if (!tw->map[TW_L0_SLOTS / 64 + level - 1])
+			continue;
+
+		/* next start of a slot of this level */
+		next = (tw->clock + (1U << shift) - 1) & ~((1U << shift) - 1);
+		if ((int)(next - now_ms) > 0)
+			next = now_ms + 1;
+		if (next != tw->clock) {
+			tw->clock = next;
+			tw->cascaded = 0;
+		}
+		return;
+	}
+}
+
+/* Wakes up the expired tasks of timer wheel <tw>, and advances its clock up to
+ * the current date, with at most <*budget> tasks processed. <*budget> is
+ * updated.
+ */
+static void task_wheel_expire(struct timer_wheel *tw, int *budget)
+{
+	struct list *slot;
+	struct task *t;
+
+	while ((int)(tw->clock - now_ms) <= 0) {
+		if (!tw->count) {
+			tw->clock = now_ms + 1;
+			tw->cascaded = 0;
+			break;
+		}
+
+		if (!tw->cascaded) {
+			task_wheel_cascade(tw);
+			tw->cascaded = 1;
+		}
+
+		slot = &tw->slot[tw->clock & (TW_L0_SLOTS - 1)];
+		while (!LIST_ISEMPTY(slot)) {
+			if ((*budget)-- <= 0)
+				return;
+
+			t = task_from_wheel_link(slot->n);
+			__task_wheel_unlink(tw, t);
+			if (tick_is_expired(t->expire, now_ms))
+				task_wakeup(t, TASK_WOKEN_TIMER);
+			else if (tick_isset(t->expire)) {
+				/* it was left there for a later date */
+				t->wq.key = t->expire;
+				__task_wheel_queue(tw, t);
+			}
+		}
+
+		tw->clock++;
+		tw->cascaded = 0;
+		task_wheel_skip(tw);
+	}
+}
+
+/* Returns the distance from bit <start> to the next bit set in bitmap <map>
+ * made of <words> 64-bit words, wrapping at its end, or -1 if none is set.
+ */
+static int task_wheel_next_bit(const uint64_t *map, unsigned int words, unsigned int start)
+{
+	unsigned int bits = words * 64;
+	unsigned int dist, bit;
+	uint64_t w;
+
+	for (dist = 0; dist < bits; dist += 64 - bit % 64) {
+		bit = (start + dist) % bits;
+		w = map[bit / 64] >> (bit % 64);
+		if (w)
+			return dist + my_ffsl(w) - 1;
+	}
+	return -1;
+}
+
+/* Returns the date of the next event of timer wheel <tw>, which is either the
+ * expiration date of a level 0 slot, or the start of an upper level slot to
+ * be redistributed, or TICK_ETERNITY if the wheel is empty.
+ */
+static int task_wheel_next(const struct timer_wheel *tw)
+{
+	unsigned int level, shift, first;
+	int ret = TICK_ETERNITY;
+	int dist;
+
+	if (!tw->count)
+		return ret;
+
+	dist = task_wheel_next_bit(tw->map, TW_L0_SLOTS / 64, tw->clock & (TW_L0_SLOTS - 1));
+	if (dist >= 0)
+		ret = tick_add(tw->clock, dist);
+
+	for (level = 1, shift = TW_L0_BITS; level < TW_LEVELS; level++, shift += TW_LN_BITS) {
+		if (!tw->map[TW_L0_SLOTS / 64 + level - 1])
+			continue;
+
+		/* the current slot was already redistributed unless the clock
+		 * is at its start and this was not done yet.
+		 */
+		first = (tw->cascaded || (tw->clock & ((1U << shift) - 1))) ? 1 : 0;
+		dist = task_wheel_next_bit(&tw->map[TW_L0_SLOTS / 64 + level - 1], 1,
+		                           ((tw->clock >> shift) + first) & (TW_LN_SLOTS - 1));
+		ret = tick_first(ret, tick_add(((tw->clock >> shift) + first + dist) << shift, 0));
+	}
+	return ret;
+}
+
 /*
  * __task_queue()
  *
@@ -295,9 +514,64 @@ void __task_queue(struct task *task, struct eb_root *wq)
 		return;
 #endif
 
+	if (wq == &th_ctx->timers && th_ctx->wheel) {
+		__task_wheel_queue(th_ctx->wheel, task);
+		return;
+	}
+
 	eb32_insert(wq, &task->wq);
 }
 
+/* Tries to steal tasks from the steal list of another thread of the current
+ * group, starting with the one following the current thread, and takes up to
+ * half of this thread's run queue, within the limit of tune.runqueue-depth.
+ * The stolen tasks are appended to the current thread's TL_NORMAL list.
+ * Returns the number of tasks stolen.
+ */
+static int task_steal(void)
+{
+	struct thread_ctx *victim;
+	struct tasklet *tl;
+	uint ltid, budget;
+	int stolen = 0, seen = 0;
+
+	for (ltid = (ti->ltid + 1) % tg->count; ltid != ti->ltid; ltid = (ltid + 1) % tg->count) {
+		victim = &ha_thread_ctx[tg->base + ltid];
+		if (MT_LIST_ISEMPTY(&victim->steal_list))
+			continue;
+
+		seen = 1;
+
+		budget = (_HA_ATOMIC_LOAD(&victim->rq_total) + 1) / 2;
+		if (budget > global.tune.runqueue_depth)
+			budget = global.tune.runqueue_depth;
+
+		while (stolen < budget &&
+		       (tl = MT_LIST_POP(&victim->steal_list, struct tasklet *, list)) != NULL) {
+			_HA_ATOMIC_DEC(&victim->rq_total);
+			_HA_ATOMIC_INC(&th_ctx->rq_total);
+			LIST_APPEND(&th_ctx->tasklets[TL_NORMAL], &tl->list);
+			stolen++;
+		}
+
+		if (stolen)
+			break;
+	}
+
+	if (!stolen) {
+		/* the owners were faster */
+		if (seen)
+			activity[tid].steal_miss++;
+		return 0;
+	}
+
+	th_ctx->tl_class_mask |= 1 << TL_NORMAL;
+	_HA_ATOMIC_ADD(&th_ctx->tasks_in_list, stolen);
+	activity[tid].steal_tasks += stolen;
+	activity[tid].tasksw += stolen;
+	return stolen;
+}
+
 /*
  * Extract all expired timers from the timer queue, and wakes up all
  * associated tasks.
@@ -364,6 +638,9 @@ void wake_expired_tasks()
 		}
 	}
 
+	if (tt->wheel)
+		task_wheel_expire(tt->wheel, &max_processed);
+
 #ifdef USE_THREAD
 	if (eb_is_empty(&tg_ctx->timers))
 		goto leave;
@@ -484,6 +761,9 @@ int next_timer_expiry()
 	if (eb)
 		ret = eb->key;
 
+	if (tt->wheel)
+		ret = tick_first(ret, task_wheel_next(tt->wheel));
+
 #ifdef USE_THREAD
 	if (!eb_is_empty(&tg_ctx->timers)) {
 		HA_RWLOCK_RDLOCK(TASK_WQ_LOCK, &wq_lock);
@@ -515,6 +795,7 @@ unsigned int run_tasks_from_lists(unsigned int budgets[])
 	unsigned int done = 0;
 	unsigned int queue;
 	unsigned int state;
+	uint64_t heavy_start;
 	void *ctx;
 
 	for (queue = 0; queue < TL_CLASSES;) {
@@ -578,11 +859,17 @@ unsigned int run_tasks_from_lists(unsigned int budgets[])
 			HA_ATOMIC_ADD(&profile_entry->lat_time, lat);
 			HA_ATOMIC_INC(&profile_entry->calls);
 		}
+		th_ctx->current_fct = process;
 		__ha_barrier_store();
 
 		th_ctx->current = t;
 		_HA_ATOMIC_AND(&th_ctx->flags, ~TH_FL_STUCK); // this thread is still running
 
+		/* heavy tasklets are timed to respect tune.sched.heavy-share */
+		heavy_start = 0;
+		if (queue == TL_HEAVY && global.tune.sched_heavy_share)
+			heavy_start = now_mono_time();
+
 		_HA_ATOMIC_DEC(&th_ctx->rq_total);
 		LIST_DEL_INIT(&((struct tasklet *)t)->list);
 		__ha_barrier_store();
@@ -663,9 +950,21 @@ unsigned int run_tasks_from_lists(unsigned int budgets[])
 		th_ctx->current = NULL;
 		__ha_barrier_store();
 
+		if (heavy_start) {
+			/* other classes will have their share of time first */
+			uint64_t now_ns = now_mono_time();
+			uint share = global.tune.sched_heavy_share;
+
+			th_ctx->heavy_next = now_ns + (now_ns - heavy_start) * (100 - share) / share;
+		}
+
 		/* stats are only registered for non-zero wake dates */
-		if (unlikely(th_ctx->sched_wake_date))
-			HA_ATOMIC_ADD(&profile_entry->cpu_time, (uint32_t)(now_mono_time() - th_ctx->sched_call_date));
+		if (unlikely(th_ctx->sched_wake_date)) {
+			uint32_t cpu = (uint32_t)now_mono_time() - th_ctx->sched_call_date;
+
+			HA_ATOMIC_ADD(&profile_entry->cpu_time, cpu);
+			sched_hist_add(profile_entry, cpu, th_ctx->sched_call_date - th_ctx->sched_wake_date);
+		}
 		done++;
 	}
 	th_ctx->current_queue = -1;
@@ -691,6 +990,7 @@ void process_runnable_tasks()
 	struct thread_ctx * const tt = th_ctx;
 	struct eb32_node *lrq; // next local run queue entry
 	struct eb32_node *grq; // next global run queue entry
+	struct tasklet *tl;
 	struct task *t;
 	const unsigned int default_weights[TL_CLASSES] = {
 		[TL_URGENT] = 64, // ~50% of CPU bandwidth for I/O
@@ -710,11 +1010,16 @@ void process_runnable_tasks()
 	_HA_ATOMIC_AND(&th_ctx->flags, ~TH_FL_STUCK); // this thread is still running
 
 	if (!thread_has_tasks()) {
-		activity[tid].empty_rq++;
-		return;
+		/* idle threads may help the busy ones of their group */
+		if (!(global.tune.options & GTUNE_SCHED_WORK_STEAL) || tg->count < 2 || !task_steal()) {
+			activity[tid].empty_rq++;
+			return;
+		}
 	}
 
 	max_processed = global.tune.runqueue_depth;
+	if (tt->rq_budget)
+		max_processed = tt->rq_budget;
 
 	if (likely(tg_ctx->niced_tasks))
 		max_processed = (max_processed + 3) / 4;
@@ -736,7 +1041,8 @@ void process_runnable_tasks()
 
 	/* normal tasklets list gets a default weight of ~37% */
 	if ((tt->tl_class_mask & (1 << TL_NORMAL)) ||
-	    !eb_is_empty(&th_ctx->rqueue) || !eb_is_empty(&th_ctx->rqueue_shared))
+	    !eb_is_empty(&th_ctx->rqueue) || !eb_is_empty(&th_ctx->rqueue_shared) ||
+	    !MT_LIST_ISEMPTY(&th_ctx->steal_list))
 		max[TL_NORMAL] = default_weights[TL_NORMAL];
 
 	/* bulk tasklets list gets a default weight of ~13% */
@@ -745,10 +1051,15 @@ void process_runnable_tasks()
 
 	/* heavy tasks are processed only once and never refilled in a
 	 * call round. That budget is not lost either as we don't reset
-	 * it unless consumed.
+	 * it unless consumed. With tune.sched.heavy-share, they also wait
+	 * for the other classes to get their share of time, unless there
+	 * is nothing else to do.
 	 */
 	if (!heavy_queued) {
-		if ((tt->tl_class_mask & (1 << TL_HEAVY)))
+		if ((tt->tl_class_mask & (1 << TL_HEAVY)) &&
+		    (!global.tune.sched_heavy_share ||
+		     !(max[TL_URGENT] | max[TL_NORMAL] | max[TL_BULK]) ||
+		     (int64_t)(now_mono_time() - tt->heavy_next) >= 0))
 			max[TL_HEAVY] = default_weights[TL_HEAVY];
 		else
 			max[TL_HEAVY] = 0;
@@ -782,6 +1093,16 @@ void process_runnable_tasks()
 	/* Note: the grq lock is always held when grq is not null */
 	lpicked = gpicked = 0;
 	budget = max[TL_NORMAL] - tt->tasks_in_list;
+
+	/* tasks from our steal list were woken up when the run queue was
+	 * already full, they may use up to half of the budget.
+	 */
+	while (lpicked < (budget + 1) / 2 &&
+	       (tl = MT_LIST_POP(&tt->steal_list, struct tasklet *, list)) != NULL) {
+		LIST_APPEND(&tt->tasklets[TL_NORMAL], &tl->list);
+		lpicked++;
+	}
+
 	while (lpicked + gpicked < budget) {
 		if (!eb_is_empty(&th_ctx->rqueue_shared) && !grq) {
 #ifdef USE_THREAD
@@ -868,15 +1189,49 @@ void process_runnable_tasks()
 		activity[tid].long_rq++;
 }
 
+/* Adjusts the current thread's run queue budget after a loop which took
+ * <run_time> microseconds outside of the poller, so that loops remain below
+ * tune.sched.max-loop-latency. The budget is reduced by a quarter when the
+ * loop was too long or when the poller returned as many events as it could,
+ * indicating that more I/O is pending. It grows by an eighth when the loop was
+ * shorter than half of the target while tasks are left to be processed. It
+ * remains between 4 and 4 times tune.runqueue-depth.
+ */
+void sched_update_budget(uint32_t run_time)
+{
+	uint target = global.tune.sched_max_loop_lat;
+	uint depth = global.tune.runqueue_depth;
+	uint budget = th_ctx->rq_budget;
+
+	if (!target)
+		return;
+
+	if (!budget)
+		budget = depth;
+
+	if (run_time > target || th_ctx->poll_events >= global.tune.maxpollevents)
+		budget -= budget / 4;
+	else if (run_time < target / 2 && thread_has_tasks())
+		budget += budget / 8 + 1;
+
+	if (budget > depth * 4)
+		budget = depth * 4;
+	if (budget < 4)
+		budget = 4;
+	th_ctx->rq_budget = budget;
+}
+
 /*
  * Delete every tasks before running the master polling loop
  */
 void mworker_cleantasks()
 {
+	struct tasklet *tl;
 	struct task *t;
 	int i;
 	struct eb32_node *tmp_wq = NULL;
 	struct eb32_node *tmp_rq = NULL;
+	int q;
 
 #ifdef USE_THREAD
 	/* cleanup the global run queue */
@@ -896,6 +1251,9 @@ void mworker_cleantasks()
 #endif
 	/* clean the per thread run queue */
 	for (i = 0; i < global.nbthread; i++) {
+		while ((tl = MT_LIST_POP(&ha_thread_ctx[i].steal_list, struct tasklet *, list)) != NULL)
+			task_destroy((struct task *)tl);
+
 		tmp_rq = eb32_first(&ha_thread_ctx[i].rqueue);
 		while (tmp_rq) {
 			t = eb32_entry(tmp_rq, struct task, rq);
@@ -909,6 +1267,11 @@ void mworker_cleantasks()
 			tmp_wq = eb32_next(tmp_wq);
 			task_destroy(t);
 		}
+		/* cleanup the per thread timer wheel */
+		for (q = 0; ha_thread_ctx[i].wheel && q < TW_SLOTS; q++) {
+			while (!LIST_ISEMPTY(&ha_thread_ctx[i].wheel->slot[q]))
+				task_destroy(task_from_wheel_link(ha_thread_ctx[i].wheel->slot[q].n));
+		}
 	}
 }
 
@@ -924,9 +1287,58 @@ static void init_task()
 		for (q = 0; q < TL_CLASSES; q++)
 			LIST_INIT(&ha_thread_ctx[i].tasklets[q]);
 		MT_LIST_INIT(&ha_thread_ctx[i].shared_tasklet_list);
+		MT_LIST_INIT(&ha_thread_ctx[i].steal_list);
+	}
+}
+
+/* allocates the timer wheel of the current thread when enabled */
+static int alloc_timer_wheel()
+{
+	struct timer_wheel *tw;
+	int i;
+
+	if (!(global.tune.options & GTUNE_SCHED_TIMER_WHEEL))
+		return 1;
+
+	tw = calloc(1, sizeof(*tw));
+	if (!tw) {
+		ha_alert("Failed to allocate the timer wheel for thread %u.\n", tid + 1);
+		return 0;
+	}
+
+	for (i = 0; i < TW_SLOTS; i++)
+		LIST_INIT(&tw->slot[i]);
+	tw->clock = now_ms;
+	th_ctx->wheel = tw;
+	return 1;
+}
+
+/* releases the timer wheel of the current thread. Tasks still there are moved
+ * to the thread's timers tree so that they may still be unlinked later.
+ */
+static void free_timer_wheel()
+{
+	struct timer_wheel *tw = th_ctx->wheel;
+	struct task *t;
+	int i;
+
+	if (!tw)
+		return;
+
+	for (i = 0; i < TW_SLOTS; i++) {
+		while (!LIST_ISEMPTY(&tw->slot[i])) {
+			t = task_from_wheel_link(tw->slot[i].n);
+			__task_wheel_unlink(tw, t);
+			eb32_insert(&th_ctx->timers, &t->wq);
+		}
 	}
+	th_ctx->wheel = NULL;
+	free(tw);
 }
 
+REGISTER_PER_THREAD_ALLOC(alloc_timer_wheel);
+REGISTER_PER_THREAD_FREE(free_timer_wheel);
+
 /* config parser for global "tune.sched.low-latency", accepts "on" or "off" */
 static int cfg_parse_tune_sched_low_latency(char **args, int section_type, struct proxy *curpx,
                                       const struct proxy *defpx, const char *file, int line,
@@ -946,9 +1358,102 @@ static int cfg_parse_tune_sched_low_latency(char **args, int section_type, struc
 	return 0;
 }
 
+/* config parser for global "tune.sched.timer-wheel", accepts "on" or "off" */
+static int cfg_parse_tune_sched_timer_wheel(char **args, int section_type, struct proxy *curpx,
+                                      const struct proxy *defpx, const char *file, int line,
+                                      char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0)
+		global.tune.options |= GTUNE_SCHED_TIMER_WHEEL;
+	else if (strcmp(args[1], "off") == 0)
+		global.tune.options &= ~GTUNE_SCHED_TIMER_WHEEL;
+	else {
+		memprintf(err, "'%s' expects either 'on' or 'off' but got '%s'.", args[0], args[1]);
+		return -1;
+	}
+	return 0;
+}
+
+/* config parser for global "tune.sched.work-stealing", accepts "on" or "off" */
+static int cfg_parse_tune_sched_work_stealing(char **args, int section_type, struct proxy *curpx,
+                                      const struct proxy *defpx, const char *file, int line,
+                                      char **err)
+{
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (strcmp(args[1], "on") == 0)
+		global.tune.options |= GTUNE_SCHED_WORK_STEAL;
+	else if (strcmp(args[1], "off") == 0)
+		global.tune.options &= ~GTUNE_SCHED_WORK_STEAL;
+	else {
+		memprintf(err, "'%s' expects either 'on' or 'off' but got '%s'.", args[0], args[1]);
+		return -1;
+	}
+	return 0;
+}
+
+/* config parser for global "tune.sched.heavy-share", accepts a percentage */
+static int cfg_parse_tune_sched_heavy_share(char **args, int section_type, struct proxy *curpx,
+                                      const struct proxy *defpx, const char *file, int line,
+                                      char **err)
+{
+	char *stop;
+	long share;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	share = strtol(args[1], &stop, 10);
+	if (!*args[1] || *stop || share < 1 || share > 100) {
+		memprintf(err, "'%s' expects a percentage between 1 and 100 but got '%s'.", args[0], args[1]);
+		return -1;
+	}
+
+	global.tune.sched_heavy_share = (share == 100) ? 0 : share;
+	return 0;
+}
+
+/* config parser for global "tune.sched.max-loop-latency", accepts a time */
+static int cfg_parse_tune_sched_max_loop_lat(char **args, int section_type, struct proxy *curpx,
+                                      const struct proxy *defpx, const char *file, int line,
+                                      char **err)
+{
+	const char *res;
+	uint lat;
+
+	if (too_many_args(1, args, err, NULL))
+		return -1;
+
+	if (!*args[1]) {
+		memprintf(err, "'%s' expects a time value, possibly in microseconds.", args[0]);
+		return -1;
+	}
+
+	res = parse_time_err(args[1], &lat, TIME_UNIT_US);
+	if (res == PARSE_TIME_OVER || res == PARSE_TIME_UNDER) {
+		memprintf(err, "timer out of range in argument '%s' to '%s'.", args[1], args[0]);
+		return -1;
+	}
+	else if (res) {
+		memprintf(err, "unexpected character '%c' in argument to '%s'.", *res, args[0]);
+		return -1;
+	}
+
+	global.tune.sched_max_loop_lat = lat;
+	return 0;
+}
+
 /* config keyword parsers */
 static struct cfg_kw_list cfg_kws = {ILH, {
+	{ CFG_GLOBAL, "tune.sched.heavy-share", cfg_parse_tune_sched_heavy_share },
 	{ CFG_GLOBAL, "tune.sched.low-latency", cfg_parse_tune_sched_low_latency },
+	{ CFG_GLOBAL, "tune.sched.max-loop-latency", cfg_parse_tune_sched_max_loop_lat },
+	{ CFG_GLOBAL, "tune.sched.timer-wheel", cfg_parse_tune_sched_timer_wheel },
+	{ CFG_GLOBAL, "tune.sched.work-stealing", cfg_parse_tune_sched_work_stealing },
 	{ 0, NULL, NULL }
 }};
 
@@ -157,6 +157,9 @@ int tcp_inspect_request(struct stream *s, struct channel *req, int an_bit)
 		if (ret) {
 			act_opts |= ACT_OPT_FIRST;
 resume_execution:
+			/* the action may change what cached samples rely on */
+			stream_smp_cache_flush(s);
+
 			/* Always call the action function if defined */
 			if (rule->action_ptr) {
 				switch (rule->action_ptr(rule, s->be, s->sess, s, act_opts)) {
@@ -340,6 +343,9 @@ int tcp_inspect_response(struct stream *s, struct channel *rep, int an_bit)
 		if (ret) {
 			act_opts |= ACT_OPT_FIRST;
 resume_execution:
+			/* the action may change what cached samples rely on */
+			stream_smp_cache_flush(s);
+
 			/* Always call the action function if defined */
 			if (rule->action_ptr) {
 				switch (rule->action_ptr(rule, s->be, s->sess, s, act_opts)) {
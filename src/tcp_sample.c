@@ -305,6 +305,28 @@ static int var_fc_counter(struct arg *args, char **err)
 	return 1;
 }
 
+#if defined(__linux__)
+/* The libc's struct tcp_info stops at tcpi_total_retrans while the kernel
+ * reports more fields after it. The layout is part of the kernel's ABI and
+ * fields are only ever appended. The kernel returns in <optlen> the size it
+ * filled, which tells whether a field is known by the running kernel.
+ */
+struct tcp_info_ext {
+	struct tcp_info info;
+	uint64_t tcpi_pacing_rate;
+	uint64_t tcpi_max_pacing_rate;
+	uint64_t tcpi_bytes_acked;
+	uint64_t tcpi_bytes_received;
+	uint32_t tcpi_segs_out;
+	uint32_t tcpi_segs_in;
+	uint32_t tcpi_notsent_bytes;
+	uint32_t tcpi_min_rtt;
+	uint32_t tcpi_data_segs_in;
+	uint32_t tcpi_data_segs_out;
+	uint64_t tcpi_delivery_rate;
+};
+#endif
+
 /* Returns some tcp_info data if it's available. "dir" must be set to 0 if
  * the client connection is required, otherwise it is set to 1. "val" represents
  * the required value.
@@ -314,7 +336,13 @@ static inline int get_tcp_info(const struct arg *args, struct sample *smp,
                                int dir, int val)
 {
 	struct connection *conn;
-	struct tcp_info info;
+#if defined(__linux__)
+	struct tcp_info_ext ext;
+	struct tcp_info *info = &ext.info;
+#else
+	struct tcp_info ti;
+	struct tcp_info *info = &ti;
+#endif
 	socklen_t optlen;
 
 	/* strm can be null. */
@@ -331,40 +359,56 @@ static inline int get_tcp_info(const struct arg *args, struct sample *smp,
 
 	/* The fd may not be available for the tcp_info struct, and the
 	  syscal can fail. */
-	optlen = sizeof(info);
+#if defined(__linux__)
+	optlen = sizeof(ext);
+#else
+	optlen = sizeof(ti);
+#endif
 	if ((conn->flags & CO_FL_FDLESS) ||
-	    getsockopt(conn->handle.fd, IPPROTO_TCP, TCP_INFO, &info, &optlen) == -1)
+	    getsockopt(conn->handle.fd, IPPROTO_TCP, TCP_INFO, info, &optlen) == -1)
 		return 0;
 
 	/* extract the value. */
 	smp->data.type = SMP_T_SINT;
 	switch (val) {
 #if defined(__APPLE__)
-	case 0:  smp->data.u.sint = info.tcpi_rttcur;         break;
-	case 1:  smp->data.u.sint = info.tcpi_rttvar;         break;
-	case 2:  smp->data.u.sint = info.tcpi_tfo_syn_data_acked; break;
-	case 4:  smp->data.u.sint = info.tcpi_tfo_syn_loss;   break;
-	case 5:  smp->data.u.sint = info.tcpi_rto;            break;
+	case 0:  smp->data.u.sint = info->tcpi_rttcur;        break;
+	case 1:  smp->data.u.sint = info->tcpi_rttvar;        break;
+	case 2:  smp->data.u.sint = info->tcpi_tfo_syn_data_acked; break;
+	case 4:  smp->data.u.sint = info->tcpi_tfo_syn_loss;  break;
+	case 5:  smp->data.u.sint = info->tcpi_rto;           break;
 #else
 	/* all other platforms supporting TCP_INFO have these ones */
-	case 0:  smp->data.u.sint = info.tcpi_rtt;            break;
-	case 1:  smp->data.u.sint = info.tcpi_rttvar;         break;
+	case 0:  smp->data.u.sint = info->tcpi_rtt;           break;
+	case 1:  smp->data.u.sint = info->tcpi_rttvar;        break;
 # if defined(__linux__)
 	/* these ones are common to all Linux versions */
-	case 2:  smp->data.u.sint = info.tcpi_unacked;        break;
-	case 3:  smp->data.u.sint = info.tcpi_sacked;         break;
-	case 4:  smp->data.u.sint = info.tcpi_lost;           break;
-	case 5:  smp->data.u.sint = info.tcpi_retrans;        break;
-	case 6:  smp->data.u.sint = info.tcpi_fackets;        break;
-	case 7:  smp->data.u.sint = info.tcpi_reordering;     break;
+	case 2:  smp->data.u.sint = info->tcpi_unacked;       break;
+	case 3:  smp->data.u.sint = info->tcpi_sacked;        break;
+	case 4:  smp->data.u.sint = info->tcpi_lost;          break;
+	case 5:  smp->data.u.sint = info->tcpi_retrans;       break;
+	case 6:  smp->data.u.sint = info->tcpi_fackets;       break;
+	case 7:  smp->data.u.sint = info->tcpi_reordering;    break;
+	case 8:  smp->data.u.sint = info->tcpi_snd_cwnd;      break;
+	case 9:
+		/* packets in flight as computed by the kernel, times the MSS */
+		smp->data.u.sint = ((int64_t)info->tcpi_unacked - info->tcpi_sacked -
+		                    info->tcpi_lost + info->tcpi_retrans) * info->tcpi_snd_mss;
+		break;
+	case 10:
+		/* only reported since Linux 4.9 */
+		if (optlen < offsetof(struct tcp_info_ext, tcpi_delivery_rate) + sizeof(ext.tcpi_delivery_rate))
+			return 0;
+		smp->data.u.sint = ext.tcpi_delivery_rate;
+		break;
 # elif defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
 	/* the ones are found on FreeBSD, NetBSD and OpenBSD featuring TCP_INFO */
-	case 2:  smp->data.u.sint = info.__tcpi_unacked;      break;
-	case 3:  smp->data.u.sint = info.__tcpi_sacked;       break;
-	case 4:  smp->data.u.sint = info.__tcpi_lost;         break;
-	case 5:  smp->data.u.sint = info.__tcpi_retrans;      break;
-	case 6:  smp->data.u.sint = info.__tcpi_fackets;      break;
-	case 7:  smp->data.u.sint = info.__tcpi_reordering;   break;
+	case 2:  smp->data.u.sint = info->__tcpi_unacked;     break;
+	case 3:  smp->data.u.sint = info->__tcpi_sacked;      break;
+	case 4:  smp->data.u.sint = info->__tcpi_lost;        break;
+	case 5:  smp->data.u.sint = info->__tcpi_retrans;     break;
+	case 6:  smp->data.u.sint = info->__tcpi_fackets;     break;
+	case 7:  smp->data.u.sint = info->__tcpi_reordering;  break;
 # endif
 #endif // apple
 	default: return 0;
@@ -466,6 +510,35 @@ smp_fetch_fc_reordering(const struct arg *args, struct sample *smp, const char *
 	return 1;
 }
 #endif
+
+#if defined(__linux__)
+/* get the congestion window in segments on a client connection */
+static int
+smp_fetch_fc_snd_cwnd(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	if (!get_tcp_info(args, smp, 0, 8))
+		return 0;
+	return 1;
+}
+
+/* get the amount of bytes in flight on a client connection */
+static int
+smp_fetch_fc_bytes_in_flight(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	if (!get_tcp_info(args, smp, 0, 9))
+		return 0;
+	return 1;
+}
+
+/* get the most recent delivery rate in bytes per second on a client connection */
+static int
+smp_fetch_fc_delivery_rate(const struct arg *args, struct sample *smp, const char *kw, void *private)
+{
+	if (!get_tcp_info(args, smp, 0, 10))
+		return 0;
+	return 1;
+}
+#endif
 #endif // TCP_INFO
 
 /* Note: must not be declared <const> as its list will be overwritten.
@@ -515,6 +588,11 @@ static struct sample_fetch_kw_list sample_fetch_keywords = {ILH, {
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
 	{ "fc_reordering",    smp_fetch_fc_reordering,    ARG1(0,STR), var_fc_counter, SMP_T_SINT, SMP_USE_L4CLI },
 #endif
+#if defined(__linux__)
+	{ "fc_bytes_in_flight", smp_fetch_fc_bytes_in_flight, 0,       NULL,           SMP_T_SINT, SMP_USE_L4CLI },
+	{ "fc_delivery_rate", smp_fetch_fc_delivery_rate, 0,           NULL,           SMP_T_SINT, SMP_USE_L4CLI },
+	{ "fc_snd_cwnd",      smp_fetch_fc_snd_cwnd,      0,           NULL,           SMP_T_SINT, SMP_USE_L4CLI },
+#endif
 #endif // TCP_INFO
 	{ /* END */ },
 }};
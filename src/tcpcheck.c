@@ -95,6 +95,7 @@ void free_tcpcheck_http_hdr(struct tcpcheck_http_hdr *hdr)
 		return;
 
 	free_tcpcheck_fmt(&hdr->value);
+	istfree(&hdr->cst);
 	istfree(&hdr->name);
 	free(hdr);
 }
@@ -1429,10 +1430,14 @@ enum tcpcheck_eval_ret tcpcheck_eval_send(struct check *check, struct tcpcheck_r
 
 			list_for_each_entry(hdr, &send->http.hdrs, list) {
 				chunk_reset(tmp);
-                                tmp->data = sess_build_logline(check->sess, NULL, b_orig(tmp), b_size(tmp), &hdr->value);
-				if (!b_data(tmp))
-					continue;
-				hdr_value = ist2(b_orig(tmp), b_data(tmp));
+				if (isttest(hdr->cst))
+					hdr_value = hdr->cst;
+				else {
+					tmp->data = sess_build_logline(check->sess, NULL, b_orig(tmp), b_size(tmp), &hdr->value);
+					if (!b_data(tmp))
+						continue;
+					hdr_value = ist2(b_orig(tmp), b_data(tmp));
+				}
 				if (!htx_add_header(htx, hdr->name, hdr_value))
 					goto error_htx;
 				if ((sl->flags & HTX_SL_F_HAS_AUTHORITY) && isteqi(hdr->name, ist("host"))) {
@@ -3654,6 +3659,172 @@ int tcpcheck_add_http_rule(struct tcpcheck_rule *chk, struct tcpcheck_rules *rul
 	return 1;
 }
 
+/* Renders log-format string <fmt> at boot if it only contains constant text,
+ * the same way sess_build_logline() would do it at run time. Returns 1 with
+ * the allocated zero-terminated string in <out> if so, 0 if the string depends on the check
+ * context or renders empty (the run time path then keeps reporting it), or -1
+ * on memory allocation failure.
+ */
+static int tcpcheck_render_const_fmt(struct list *fmt, struct ist *out)
+{
+	struct logformat_node *node;
+	int last_isspace = 1;
+
+	chunk_reset(&trash);
+	list_for_each_entry(node, fmt, list) {
+		if (node->options & LOG_OPT_CBOR)
+			return 0;
+		if (node->type == LOG_FMT_SEPARATOR) {
+			if (!last_isspace && !chunk_memcat(&trash, " ", 1))
+				return 0;
+			last_isspace = 1;
+		}
+		else if (node->type == LOG_FMT_TEXT) {
+			if (!chunk_memcat(&trash, node->arg, node->len))
+				return 0;
+			last_isspace = 0;
+		}
+		else
+			return 0;
+	}
+
+	/* sess_build_logline() keeps room for a trailing zero */
+	if (!b_data(&trash) || b_data(&trash) >= b_size(&trash) - 1)
+		return 0;
+
+	*out = ist2(my_strndup(b_orig(&trash), b_data(&trash)), b_data(&trash));
+	return isttest(*out) ? 1 : -1;
+}
+
+/* Precomputes the parts of send or expect rule <rule> whose log-format strings
+ * turn out to be constant, so that they are no longer rendered on each check
+ * run. Such strings are turned into their plain string counterpart, which is
+ * strictly equivalent. Rulesets being shared between all the servers and
+ * proxies using them, this is only done once per rule. Returns 0 on memory
+ * allocation failure, otherwise 1.
+ */
+static int tcpcheck_compile_rule(struct tcpcheck_rule *rule)
+{
+	struct tcpcheck_http_hdr *hdr;
+	struct ist cst;
+	int len, ret;
+
+	if (rule->action == TCPCHK_ACT_SEND) {
+		struct tcpcheck_send *send = &rule->send;
+
+		switch (send->type) {
+		case TCPCHK_SEND_STRING_LF:
+		case TCPCHK_SEND_BINARY_LF:
+			ret = tcpcheck_render_const_fmt(&send->fmt, &cst);
+			if (ret <= 0)
+				return ret == 0;
+			if (send->type == TCPCHK_SEND_BINARY_LF) {
+				char *bin = NULL;
+
+				if (parse_binary(istptr(cst), &bin, &len, NULL) == 0) {
+					/* reported at run time */
+					istfree(&cst);
+					return 1;
+				}
+				istfree(&cst);
+				cst = ist2(bin, len);
+			}
+			free_tcpcheck_fmt(&send->fmt);
+			send->data = cst;
+			send->type = ((send->type == TCPCHK_SEND_STRING_LF) ? TCPCHK_SEND_STRING : TCPCHK_SEND_BINARY);
+			break;
+
+		case TCPCHK_SEND_HTTP:
+			if (send->http.flags & TCPCHK_SND_HTTP_FL_URI_FMT) {
+				ret = tcpcheck_render_const_fmt(&send->http.uri_fmt, &cst);
+				if (ret < 0)
+					return 0;
+				if (ret) {
+					free_tcpcheck_fmt(&send->http.uri_fmt);
+					send->http.uri = cst;
+					send->http.flags &= ~TCPCHK_SND_HTTP_FL_URI_FMT;
+				}
+			}
+			if (send->http.flags & TCPCHK_SND_HTTP_FL_BODY_FMT) {
+				ret = tcpcheck_render_const_fmt(&send->http.body_fmt, &cst);
+				if (ret < 0)
+					return 0;
+				if (ret) {
+					free_tcpcheck_fmt(&send->http.body_fmt);
+					send->http.body = cst;
+					send->http.flags &= ~TCPCHK_SND_HTTP_FL_BODY_FMT;
+				}
+			}
+			list_for_each_entry(hdr, &send->http.hdrs, list) {
+				if (isttest(hdr->cst))
+					continue;
+				if (tcpcheck_render_const_fmt(&hdr->value, &hdr->cst) < 0)
+					return 0;
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+	else if (rule->action == TCPCHK_ACT_EXPECT) {
+		struct tcpcheck_expect *expect = &rule->expect;
+
+		switch (expect->type) {
+		case TCPCHK_EXPECT_STRING_LF:
+		case TCPCHK_EXPECT_BINARY_LF:
+		case TCPCHK_EXPECT_HTTP_BODY_LF:
+			ret = tcpcheck_render_const_fmt(&expect->fmt, &cst);
+			if (ret <= 0)
+				return ret == 0;
+			if (expect->type == TCPCHK_EXPECT_BINARY_LF) {
+				char *bin = NULL;
+
+				if (parse_binary(istptr(cst), &bin, &len, NULL) == 0) {
+					/* reported at run time */
+					istfree(&cst);
+					return 1;
+				}
+				istfree(&cst);
+				cst = ist2(bin, len);
+			}
+			free_tcpcheck_fmt(&expect->fmt);
+			expect->data = cst;
+			expect->type = ((expect->type == TCPCHK_EXPECT_STRING_LF) ? TCPCHK_EXPECT_STRING :
+					(expect->type == TCPCHK_EXPECT_BINARY_LF) ? TCPCHK_EXPECT_BINARY :
+					TCPCHK_EXPECT_HTTP_BODY);
+			break;
+
+		case TCPCHK_EXPECT_HTTP_HEADER:
+			if (expect->flags & TCPCHK_EXPT_FL_HTTP_HNAME_FMT) {
+				ret = tcpcheck_render_const_fmt(&expect->hdr.name_fmt, &cst);
+				if (ret < 0)
+					return 0;
+				if (ret) {
+					free_tcpcheck_fmt(&expect->hdr.name_fmt);
+					expect->hdr.name = cst;
+					expect->flags &= ~TCPCHK_EXPT_FL_HTTP_HNAME_FMT;
+				}
+			}
+			if (expect->flags & TCPCHK_EXPT_FL_HTTP_HVAL_FMT) {
+				ret = tcpcheck_render_const_fmt(&expect->hdr.value_fmt, &cst);
+				if (ret < 0)
+					return 0;
+				if (ret) {
+					free_tcpcheck_fmt(&expect->hdr.value_fmt);
+					expect->hdr.value = cst;
+					expect->flags &= ~TCPCHK_EXPT_FL_HTTP_HVAL_FMT;
+				}
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+	return 1;
+}
+
 /* Check tcp-check health-check configuration for the proxy <px>. */
 static int check_proxy_tcpcheck(struct proxy *px)
 {
@@ -3765,6 +3936,12 @@ static int check_proxy_tcpcheck(struct proxy *px)
 		case TCPCHK_ACT_EXPECT:
 			if (!chk->comment && comment)
 				chk->comment = strdup(comment);
+			if (!tcpcheck_compile_rule(chk)) {
+				ha_alert("proxy '%s': out of memory while preparing tcp-check rules.\n", px->id);
+				ret |= ERR_ALERT | ERR_FATAL;
+				ha_free(&comment);
+				goto out;
+			}
 			break;
 		}
 	}
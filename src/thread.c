@@ -429,9 +429,13 @@ static const char *lock_label(enum lock_label label)
 	case CKCH_LOCK:            return "CKCH";
 	case SNI_LOCK:             return "SNI";
 	case SSL_SERVER_LOCK:      return "SSL_SERVER";
+	case SSL_LAZY_LOCK:        return "SSL_LAZY";
+	case OCSP_LOCK:            return "OCSP";
 	case SFT_LOCK:             return "SFT";
 	case IDLE_CONNS_LOCK:      return "IDLE_CONNS";
 	case QUIC_LOCK:            return "QUIC";
+	case POOL_SLAB_LOCK:       return "POOL_SLAB";
+	case NETNS_LOCK:           return "NETNS";
 	case OTHER_LOCK:           return "OTHER";
 	case DEBUG1_LOCK:          return "DEBUG1";
 	case DEBUG2_LOCK:          return "DEBUG2";
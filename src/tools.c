@@ -2090,6 +2090,17 @@ int url_decode(char *string, int in_form)
 	in = string;
 	out = string;
 	while (*in) {
+		/* copy the run of characters which never change at once */
+		size_t run = strcspn(in, "%+?");
+
+		if (run) {
+			if (out != in)
+				memmove(out, in, run);
+			in += run;
+			out += run;
+			continue;
+		}
+
 		switch (*in) {
 		case '+' :
 			*out++ = in_form ? ' ' : *in;
@@ -20,18 +20,32 @@
 
 #include <import/ist.h>
 #include <haproxy/api.h>
+#include <haproxy/applet.h>
 #include <haproxy/buf.h>
 #include <haproxy/cfgparse.h>
 #include <haproxy/cli.h>
+#include <haproxy/clock.h>
 #include <haproxy/errors.h>
+#include <haproxy/global.h>
 #include <haproxy/istbuf.h>
 #include <haproxy/list.h>
 #include <haproxy/log.h>
 #include <haproxy/sink.h>
+#include <haproxy/tools.h>
 #include <haproxy/trace.h>
 
 struct list trace_sources = LIST_HEAD_INIT(trace_sources);
 THREAD_LOCAL struct buffer trace_buf = { };
+struct trace_flight trace_flights[MAX_THREADS] = { };
+
+/* CLI context for "show trace flight" */
+struct show_trace_flight_ctx {
+	int thr;             /* thread being dumped */
+	int last;            /* last thread to dump */
+	int started;         /* non-zero once <pos> and <end> are set for <thr> */
+	ullong pos;          /* next record to dump */
+	ullong end;          /* end of the records to dump */
+};
 
 /* allocates the trace buffers. Returns 0 in case of failure. It is safe to
  * call to call this function multiple times if the size changes.
@@ -45,6 +59,7 @@ static int alloc_trace_buffers_per_thread()
 static void free_trace_buffers_per_thread()
 {
 	chunk_destroy(&trace_buf);
+	ha_free(&trace_flights[tid].recs);
 }
 
 REGISTER_PER_THREAD_ALLOC(alloc_trace_buffers_per_thread);
@@ -70,6 +85,104 @@ static inline const void *trace_pick_arg(uint32_t arg_def, const void *a1, const
 	return NULL;
 }
 
+/* Stores the event into the calling thread's flight recorder, which is
+ * allocated on first use. Nothing is formatted here, the message is only
+ * copied, possibly truncated.
+ */
+static void trace_flight_record(enum trace_level level, uint64_t mask, const struct trace_source *src,
+                                const struct ist where, const char *func,
+                                const void *a1, const void *a2, const void *a3, const void *a4,
+                                const struct ist msg)
+{
+	struct trace_flight *fl = &trace_flights[tid];
+	struct trace_rec *rec;
+
+	if (unlikely(!fl->recs)) {
+		fl->recs = calloc(TRACE_FLIGHT_RECORDS, sizeof(*fl->recs));
+		if (!fl->recs)
+			return;
+	}
+
+	rec = &fl->recs[fl->next % TRACE_FLIGHT_RECORDS];
+	rec->date    = (ullong)date.tv_sec * 1000000 + date.tv_usec;
+	rec->src     = src;
+	rec->where   = where.ptr + (where.len > 13 ? where.len - 13 : 0);
+	rec->func    = func;
+	rec->mask    = mask;
+	rec->args[0] = a1;
+	rec->args[1] = a2;
+	rec->args[2] = a3;
+	rec->args[3] = a4;
+	rec->level   = level;
+	rec->msg_len = MIN(msg.len, sizeof(rec->msg));
+	memcpy(rec->msg, msg.ptr, rec->msg_len);
+	HA_ATOMIC_STORE(&fl->next, fl->next + 1);
+}
+
+/* Appends to <buf> the text form of record <rec> from thread <thr>. The
+ * record's contents are not trusted beyond the static strings it points to.
+ */
+static void trace_flight_format(struct buffer *buf, int thr, const struct trace_rec *rec)
+{
+	const struct trace_event *ev;
+	struct tm tm;
+	int first = 1;
+
+	get_localtime(rec->date / 1000000, &tm);
+	chunk_appendf(buf, "%04d-%02d-%02d %02d:%02d:%02d.%06u [%02d|%s|%u|%s] ",
+		      tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+		      tm.tm_hour, tm.tm_min, tm.tm_sec, (uint)(rec->date % 1000000),
+		      thr + 1, rec->src->name.ptr, rec->level, rec->where);
+
+	if (rec->func)
+		chunk_appendf(buf, "%s(): ", rec->func);
+
+	chunk_appendf(buf, "%.*s ev=", MIN(rec->msg_len, TRACE_REC_MSG_LEN), rec->msg);
+	for (ev = rec->src->known_events; ev && ev->mask; ev++) {
+		if ((rec->mask & ev->mask) == ev->mask) {
+			chunk_appendf(buf, "%s%s", first ? "" : ",", ev->name);
+			first = 0;
+		}
+	}
+	if (first)
+		chunk_appendf(buf, "%#llx", (ullong)rec->mask);
+
+	chunk_appendf(buf, " args=%p,%p,%p,%p\n",
+		      rec->args[0], rec->args[1], rec->args[2], rec->args[3]);
+}
+
+/* Writes the contents of all threads' flight recorders to file descriptor
+ * <fd>, oldest events first, one thread after the other. This is meant to be
+ * used when dying, so it uses the trash and doesn't care about other users.
+ */
+void trace_flight_dump_to_fd(int fd)
+{
+	struct trace_flight *fl;
+	struct trace_rec rec;
+	ullong pos, end;
+	int thr;
+
+	for (thr = 0; thr < global.nbthread; thr++) {
+		fl = &trace_flights[thr];
+		if (!fl->recs)
+			continue;
+
+		end = HA_ATOMIC_LOAD(&fl->next);
+		pos = (end > TRACE_FLIGHT_RECORDS) ? end - TRACE_FLIGHT_RECORDS : 0;
+
+		chunk_printf(&trash, "Trace flight recorder for thread %d (%llu events, last %llu):\n",
+			     thr + 1, end, end - pos);
+		DISGUISE(write(fd, trash.area, trash.data));
+
+		for (; pos < end; pos++) {
+			rec = fl->recs[pos % TRACE_FLIGHT_RECORDS];
+			chunk_reset(&trash);
+			trace_flight_format(&trash, thr, &rec);
+			DISGUISE(write(fd, trash.area, trash.data));
+		}
+	}
+}
+
 /* write a message for the given trace source */
 void __trace(enum trace_level level, uint64_t mask, struct trace_source *src,
              const struct ist where, const char *func,
@@ -202,6 +315,13 @@ void __trace(enum trace_level level, uint64_t mask, struct trace_source *src,
 	if ((src->report_events & mask) == 0 || level > src->level)
 		goto end;
 
+	if (src->flight)
+		trace_flight_record(level, mask, src, where, func, a1, a2, a3, a4, msg);
+
+	/* nothing needs to be formatted if there's nowhere to send it */
+	if (!src->sink)
+		goto end;
+
 	/* log the logging location truncated to 10 chars from the right so that
 	 * the line number and the end of the file name are there.
 	 */
@@ -251,8 +371,7 @@ void __trace(enum trace_level level, uint64_t mask, struct trace_source *src,
 		line[words++] = msg;
 	}
 
-	if (src->sink)
-		sink_write(src->sink, line, words, 0, 0, NULL);
+	sink_write(src->sink, line, words, 0, 0, NULL);
 
  end:
 	/* check if we need to stop the trace now */
@@ -276,6 +395,7 @@ void trace_register_source(struct trace_source *source)
 	source->level = TRACE_LEVEL_USER;
 	source->verbosity = 1;
 	source->sink = NULL;
+	source->flight = 0;
 	source->state = TRACE_STATE_STOPPED;
 	source->lockon_ptr = NULL;
 	LIST_APPEND(&trace_sources, &source->source_link);
@@ -349,6 +469,7 @@ static int trace_parse_statement(char **args, const char **msg)
 		*msg =  "Supported commands:\n"
 			"  event     : list/enable/disable source-specific event reporting\n"
 			//"  filter    : list/enable/disable generic filters\n"
+			"  flight    : list/set recording into the flight recorder\n"
 			"  level     : list/set trace reporting level\n"
 			"  lock      : automatic lock on thread/connection/stream/...\n"
 			"  pause     : pause and automatically restart after a specific event\n"
@@ -457,6 +578,29 @@ static int trace_parse_statement(char **args, const char **msg)
 
 		HA_ATOMIC_STORE(&src->sink, sink);
 	}
+	else if (strcmp(args[2], "flight") == 0) {
+		const char *name = args[3];
+
+		if (!*name) {
+			chunk_printf(&trash, "Flight recorder states for source %s (*=current):\n", src->name.ptr);
+			chunk_appendf(&trash, "  %c off        : events are not recorded\n",
+				      src->flight ? ' ' : '*');
+			chunk_appendf(&trash, "  %c on         : events are also kept in the per-thread flight recorder\n",
+				      src->flight ? '*' : ' ');
+			trash.area[trash.data] = 0;
+			*msg = trash.area;
+			return LOG_WARNING;
+		}
+
+		if (strcmp(name, "on") == 0)
+			HA_ATOMIC_STORE(&src->flight, 1);
+		else if (strcmp(name, "off") == 0)
+			HA_ATOMIC_STORE(&src->flight, 0);
+		else {
+			*msg = "Expects 'on' or 'off'";
+			return LOG_ERR;
+		}
+	}
 	else if (strcmp(args[2], "level") == 0) {
 		const char *name = args[3];
 
@@ -754,6 +898,7 @@ static int cli_parse_show_trace(char **args, char *payload, struct appctx *appct
 	chunk_printf(&trash, "Trace status for %s:\n", src->name.ptr);
 	chunk_appendf(&trash, "  - sink: %s [%u dropped]\n",
 		      sink ? sink->name : "none", sink ? sink->ctx.dropped : 0);
+	chunk_appendf(&trash, "  - flight recorder: %s\n", src->flight ? "on" : "off");
 
 	chunk_appendf(&trash, "  - event name   :     report    start    stop    pause\n");
 	for (i = 0; src->known_events && src->known_events[i].mask; i++) {
@@ -769,8 +914,73 @@ static int cli_parse_show_trace(char **args, char *payload, struct appctx *appct
 	return cli_msg(appctx, LOG_WARNING, trash.area);
 }
 
+/* parse a "show trace flight" command. Returns 1 if a message is returned,
+ * otherwise zero.
+ */
+static int cli_parse_show_trace_flight(char **args, char *payload, struct appctx *appctx, void *private)
+{
+	struct show_trace_flight_ctx *ctx = applet_reserve_svcctx(appctx, sizeof(*ctx));
+
+	if (!cli_has_level(appctx, ACCESS_LVL_OPER))
+		return 1;
+
+	ctx->thr = 0;
+	ctx->last = global.nbthread - 1;
+
+	if (*args[3]) {
+		ctx->thr = atoi(args[3]) - 1;
+		if (ctx->thr < 0 || ctx->thr >= global.nbthread)
+			return cli_err(appctx, "Thread ID number must be between 1 and nbthread.\n");
+		ctx->last = ctx->thr;
+	}
+	return 0;
+}
+
+/* dumps the flight recorders of the threads selected in the context, oldest
+ * events first. Returns 0 if the output buffer is full and it needs to be
+ * called again, otherwise non-zero.
+ */
+static int cli_io_handler_show_trace_flight(struct appctx *appctx)
+{
+	struct show_trace_flight_ctx *ctx = appctx->svcctx;
+	struct trace_flight *fl;
+	struct trace_rec rec;
+	ullong next;
+
+	for (; ctx->thr <= ctx->last; ctx->thr++, ctx->started = 0) {
+		fl = &trace_flights[ctx->thr];
+		if (!fl->recs)
+			continue;
+
+		if (!ctx->started) {
+			/* only dump what was recorded before the dump started */
+			ctx->end = HA_ATOMIC_LOAD(&fl->next);
+			ctx->pos = (ctx->end > TRACE_FLIGHT_RECORDS) ? ctx->end - TRACE_FLIGHT_RECORDS : 0;
+			ctx->started = 1;
+		}
+
+		for (; ctx->pos < ctx->end; ctx->pos++) {
+			/* skip records overwritten while we were waiting for room */
+			next = HA_ATOMIC_LOAD(&fl->next);
+			if (next - ctx->pos > TRACE_FLIGHT_RECORDS - 1) {
+				ctx->pos = next - TRACE_FLIGHT_RECORDS + 1;
+				if (ctx->pos >= ctx->end)
+					break;
+			}
+
+			rec = fl->recs[ctx->pos % TRACE_FLIGHT_RECORDS];
+			chunk_reset(&trash);
+			trace_flight_format(&trash, ctx->thr, &rec);
+			if (applet_putchk(appctx, &trash) == -1)
+				return 0;
+		}
+	}
+	return 1;
+}
+
 static struct cli_kw_list cli_kws = {{ },{
 	{ { "trace", NULL },         "trace [<module>|0] [cmd [args...]]      : manage live tracing (empty to list, 0 to stop all)", cli_parse_trace, NULL, NULL },
+	{ { "show", "trace", "flight", NULL }, "show trace flight [<thr>]               : dump the per-thread trace flight recorders", cli_parse_show_trace_flight, cli_io_handler_show_trace_flight, NULL },
 	{ { "show", "trace", NULL }, "show trace [<module>]                   : show live tracing state",                            cli_parse_show_trace, NULL, NULL },
 	{{},}
 }};
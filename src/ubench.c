@@ -0,0 +1,784 @@
+/*
+ * Micro-benchmarks of core data structures.
+ *
+ * Copyright (C) 2026 HAProxy Technologies
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ *
+ * These are started with "-dB<name>[,...]" once the configuration is parsed
+ * and the process is initialized, then the process exits. Each benchmark
+ * runs rounds of operations, and the best of several samples is reported in
+ * CPU cycles (TSC) and nanoseconds per operation. Benchmarks flagged with
+ * UBENCH_F_MT run on all configured threads in parallel and report the cost
+ * per operation as seen by each thread, which exposes contention.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef USE_THREAD
+#include <pthread.h>
+#endif
+
+#include <import/eb32tree.h>
+#include <import/eb64tree.h>
+#include <import/ebmbtree.h>
+#include <import/ebsttree.h>
+#include <import/ist.h>
+
+#include <haproxy/api.h>
+#include <haproxy/buf.h>
+#include <haproxy/clock.h>
+#include <haproxy/global.h>
+#include <haproxy/hpack-dec.h>
+#include <haproxy/hpack-enc.h>
+#include <haproxy/hpack-tbl.h>
+#include <haproxy/htx.h>
+#include <haproxy/http-hdr-t.h>
+#include <haproxy/list.h>
+#include <haproxy/net_helper.h>
+#include <haproxy/pool.h>
+#include <haproxy/ring.h>
+#include <haproxy/thread.h>
+#include <haproxy/tools.h>
+#include <haproxy/ubench.h>
+
+#ifdef USE_QUIC
+#include <haproxy/qpack-enc.h>
+#endif
+
+/* all registered micro-benchmarks */
+static struct list ubench_lists = LIST_HEAD_INIT(ubench_lists);
+
+/* number of samples taken per benchmark, and minimum duration of a sample */
+#define UBENCH_SAMPLES      5
+#define UBENCH_SAMPLE_NS    20000000ULL
+
+/* registers list <ubl> of micro-benchmarks */
+void ubench_register(struct ubench_list *ubl)
+{
+	LIST_APPEND(&ubench_lists, &ubl->list);
+}
+
+/* sink for results that must not be optimized away */
+static volatile uint64_t ub_sink;
+
+/* deterministic xorshift generator so that all runs use the same data */
+static uint32_t ub_rnd_state = 2463534242U;
+
+static inline uint32_t ub_rnd32()
+{
+	uint32_t x = ub_rnd_state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return ub_rnd_state = x;
+}
+
+/************************ ebtree ************************/
+
+#define UB_EB_KEYS   65536
+#define UB_MB_LEN    16                /* binary key length (IPv6-like) */
+#define UB_ST_LEN    32                /* string key storage */
+#define UB_MB_STRIDE (sizeof(struct ebmb_node) + UB_ST_LEN)
+
+static struct eb32_node *ub_eb32;
+static struct eb64_node *ub_eb64;
+static char *ub_ebmb;                  /* UB_EB_KEYS nodes of UB_MB_STRIDE bytes */
+static char *ub_ebst;                  /* UB_EB_KEYS nodes of UB_MB_STRIDE bytes */
+static struct eb_root ub_eb_root;
+
+static inline struct ebmb_node *ub_mb_node(char *base, unsigned int i)
+{
+	return (struct ebmb_node *)(base + (size_t)i * UB_MB_STRIDE);
+}
+
+static int ub_eb_alloc()
+{
+	unsigned int i, j;
+
+	ub_eb32 = calloc(UB_EB_KEYS, sizeof(*ub_eb32));
+	ub_eb64 = calloc(UB_EB_KEYS, sizeof(*ub_eb64));
+	ub_ebmb = calloc(UB_EB_KEYS, UB_MB_STRIDE);
+	ub_ebst = calloc(UB_EB_KEYS, UB_MB_STRIDE);
+	if (!ub_eb32 || !ub_eb64 || !ub_ebmb || !ub_ebst)
+		return 0;
+
+	ub_rnd_state = 2463534242U;
+	for (i = 0; i < UB_EB_KEYS; i++) {
+		ub_eb32[i].key = ub_rnd32();
+		ub_eb64[i].key = ((uint64_t)ub_rnd32() << 32) + ub_rnd32();
+		for (j = 0; j < UB_MB_LEN; j += 4)
+			write_u32(ub_mb_node(ub_ebmb, i)->key + j, ub_rnd32());
+		snprintf((char *)ub_mb_node(ub_ebst, i)->key, UB_ST_LEN, "/static/img/%08x.png", ub_rnd32());
+	}
+	ub_eb_root = EB_ROOT;
+	return 1;
+}
+
+static void ub_eb_free()
+{
+	ha_free(&ub_eb32);
+	ha_free(&ub_eb64);
+	ha_free(&ub_ebmb);
+	ha_free(&ub_ebst);
+}
+
+static uint64_t ub_eb32_insert()
+{
+	unsigned int i;
+
+	ub_eb_root = EB_ROOT;
+	for (i = 0; i < UB_EB_KEYS; i++)
+		eb32_insert(&ub_eb_root, &ub_eb32[i]);
+	return UB_EB_KEYS;
+}
+
+static int ub_eb32_lookup_init()
+{
+	if (!ub_eb_alloc())
+		return 0;
+	ub_eb32_insert();
+	return 1;
+}
+
+static uint64_t ub_eb32_lookup()
+{
+	uint64_t found = 0;
+	unsigned int i;
+
+	for (i = 0; i < UB_EB_KEYS; i++)
+		found += !!eb32_lookup(&ub_eb_root, ub_eb32[(i * 7919) & (UB_EB_KEYS - 1)].key);
+	ub_sink += found;
+	return UB_EB_KEYS;
+}
+
+static uint64_t ub_eb64_insert()
+{
+	unsigned int i;
+
+	ub_eb_root = EB_ROOT;
+	for (i = 0; i < UB_EB_KEYS; i++)
+		eb64_insert(&ub_eb_root, &ub_eb64[i]);
+	return UB_EB_KEYS;
+}
+
+static int ub_eb64_lookup_init()
+{
+	if (!ub_eb_alloc())
+		return 0;
+	ub_eb64_insert();
+	return 1;
+}
+
+static uint64_t ub_eb64_lookup()
+{
+	uint64_t found = 0;
+	unsigned int i;
+
+	for (i = 0; i < UB_EB_KEYS; i++)
+		found += !!eb64_lookup(&ub_eb_root, ub_eb64[(i * 7919) & (UB_EB_KEYS - 1)].key);
+	ub_sink += found;
+	return UB_EB_KEYS;
+}
+
+static uint64_t ub_ebmb_insert()
+{
+	unsigned int i;
+
+	ub_eb_root = EB_ROOT;
+	for (i = 0; i < UB_EB_KEYS; i++)
+		ebmb_insert(&ub_eb_root, ub_mb_node(ub_ebmb, i), UB_MB_LEN);
+	return UB_EB_KEYS;
+}
+
+static int ub_ebmb_lookup_init()
+{
+	if (!ub_eb_alloc())
+		return 0;
+	ub_ebmb_insert();
+	return 1;
+}
+
+static uint64_t ub_ebmb_lookup()
+{
+	uint64_t found = 0;
+	unsigned int i;
+
+	for (i = 0; i < UB_EB_KEYS; i++)
+		found += !!ebmb_lookup(&ub_eb_root, ub_mb_node(ub_ebmb, (i * 7919) & (UB_EB_KEYS - 1))->key, UB_MB_LEN);
+	ub_sink += found;
+	return UB_EB_KEYS;
+}
+
+static uint64_t ub_ebst_insert()
+{
+	unsigned int i;
+
+	ub_eb_root = EB_ROOT;
+	for (i = 0; i < UB_EB_KEYS; i++)
+		ebst_insert(&ub_eb_root, ub_mb_node(ub_ebst, i));
+	return UB_EB_KEYS;
+}
+
+static int ub_ebst_lookup_init()
+{
+	if (!ub_eb_alloc())
+		return 0;
+	ub_ebst_insert();
+	return 1;
+}
+
+static uint64_t ub_ebst_lookup()
+{
+	uint64_t found = 0;
+	unsigned int i;
+
+	for (i = 0; i < UB_EB_KEYS; i++)
+		found += !!ebst_lookup(&ub_eb_root, (const char *)ub_mb_node(ub_ebst, (i * 7919) & (UB_EB_KEYS - 1))->key);
+	ub_sink += found;
+	return UB_EB_KEYS;
+}
+
+/************************ HTX ************************/
+
+#define UB_HTX_MSGS  1000
+
+static struct buffer ub_htx_buf[3];
+
+static const struct ist ub_hdr_names[] = {
+	IST("host"), IST("user-agent"), IST("accept"), IST("accept-language"),
+	IST("accept-encoding"), IST("referer"), IST("cookie"), IST("x-forwarded-for"),
+	IST("cache-control"), IST("x-request-id"),
+};
+
+static const struct ist ub_hdr_values[] = {
+	IST("www.example.com"), IST("Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0"),
+	IST("text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8"), IST("en-US,en;q=0.5"),
+	IST("gzip, deflate, br"), IST("https://www.example.com/index.html"),
+	IST("session=3f1b2c4d5e6f7a8b9c0d1e2f3a4b5c6d; lang=en"), IST("192.168.1.10"),
+	IST("no-cache"), IST("5e0f7c9a-3b2d-4e1f-8a6b-0c9d2e3f4a5b"),
+};
+
+static char ub_htx_payload[1024];
+
+static int ub_htx_init()
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		char *area = malloc(global.tune.bufsize);
+
+		if (!area)
+			return 0;
+		ub_htx_buf[i] = b_make(area, global.tune.bufsize, 0, 0);
+		htx_reset(htx_from_buf(&ub_htx_buf[i]));
+	}
+	memset(ub_htx_payload, 'x', sizeof(ub_htx_payload));
+	return 1;
+}
+
+static void ub_htx_deinit()
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+		ha_free(&ub_htx_buf[i].area);
+}
+
+/* fills <htx> with a request made of a start line, <nbhdr> headers and a 1kB
+ * payload. Returns 0 on failure.
+ */
+static int ub_htx_fill(struct htx *htx, int nbhdr)
+{
+	int i;
+
+	if (!htx_add_stline(htx, HTX_BLK_REQ_SL, HTX_SL_F_VER_11|HTX_SL_F_HAS_SCHM,
+	                    ist("POST"), ist("/api/v1/objects?id=123456"), ist("HTTP/1.1")))
+		return 0;
+	for (i = 0; i < nbhdr; i++) {
+		if (!htx_add_header(htx, ub_hdr_names[i % 10], ub_hdr_values[i % 10]))
+			return 0;
+	}
+	if (!htx_add_endof(htx, HTX_BLK_EOH))
+		return 0;
+	if (!htx_add_data_atonce(htx, ist2(ub_htx_payload, sizeof(ub_htx_payload))))
+		return 0;
+	htx->flags |= HTX_FL_EOM;
+	return 1;
+}
+
+static uint64_t ub_htx_add()
+{
+	struct htx *htx = htxbuf(&ub_htx_buf[0]);
+	int i;
+
+	for (i = 0; i < UB_HTX_MSGS; i++) {
+		htx_reset(htx);
+		if (!ub_htx_fill(htx, 10))
+			return 0;
+	}
+	return UB_HTX_MSGS;
+}
+
+/* buffer 2 holds a fragmented message (every other header removed), which is
+ * copied to buffer 0 and defragmented there.
+ */
+static int ub_htx_defrag_init()
+{
+	struct htx *htx;
+	struct htx_blk *blk;
+	int i = 0;
+
+	if (!ub_htx_init())
+		return 0;
+	htx = htxbuf(&ub_htx_buf[2]);
+	if (!ub_htx_fill(htx, 40))
+		return 0;
+	for (blk = htx_get_first_blk(htx); blk; i++) {
+		if (htx_get_blk_type(blk) == HTX_BLK_HDR && (i & 1))
+			blk = htx_remove_blk(htx, blk);
+		else
+			blk = htx_get_next_blk(htx, blk);
+	}
+	return 1;
+}
+
+static uint64_t ub_htx_defrag()
+{
+	int i;
+
+	for (i = 0; i < UB_HTX_MSGS; i++) {
+		memcpy(ub_htx_buf[0].area, ub_htx_buf[2].area, ub_htx_buf[2].size);
+		htx_defrag(htxbuf(&ub_htx_buf[0]), NULL, 0);
+	}
+	return UB_HTX_MSGS;
+}
+
+static int ub_htx_xfer_init()
+{
+	return ub_htx_init() && ub_htx_fill(htxbuf(&ub_htx_buf[0]), 10);
+}
+
+/* moves the whole message back and forth between buffers 0 and 1 */
+static uint64_t ub_htx_xfer()
+{
+	struct htx *a = htxbuf(&ub_htx_buf[0]);
+	struct htx *b = htxbuf(&ub_htx_buf[1]);
+	int i;
+
+	for (i = 0; i < UB_HTX_MSGS; i++) {
+		struct htx *src = (i & 1) ? b : a;
+		struct htx *dst = (i & 1) ? a : b;
+
+		if (!htx_xfer_blks(dst, src, htx_used_space(src), HTX_BLK_UNUSED).ret || !htx_is_empty(src))
+			return 0;
+		dst->flags |= src->flags & HTX_FL_EOM;
+		src->flags &= ~HTX_FL_EOM;
+	}
+	return UB_HTX_MSGS;
+}
+
+/************************ pools ************************/
+
+#define UB_POOL_SMALL 64               /* fits in the local cache */
+#define UB_POOL_LARGE 4096             /* overflows the local cache */
+
+static struct pool_head *ub_pool;
+static void **ub_pool_objs[MAX_THREADS];
+
+static int ub_pool_init()
+{
+	int thr;
+
+	ub_pool = create_pool("ubench", 256, MEM_F_SHARED);
+	if (!ub_pool)
+		return 0;
+	for (thr = 0; thr < global.nbthread; thr++) {
+		ub_pool_objs[thr] = calloc(UB_POOL_LARGE, sizeof(void *));
+		if (!ub_pool_objs[thr])
+			return 0;
+	}
+	return 1;
+}
+
+static void ub_pool_deinit()
+{
+	int thr;
+
+	for (thr = 0; thr < global.nbthread; thr++)
+		ha_free(&ub_pool_objs[thr]);
+	pool_flush(ub_pool);
+	ub_pool = pool_destroy(ub_pool);
+}
+
+/* threads are created for each sample, their cache must not survive them */
+static void ub_pool_thread_deinit()
+{
+	if (!(pool_debugging & POOL_DBG_NO_CACHE))
+		pool_evict_from_local_cache(ub_pool, 1);
+}
+
+/* allocates <count> objects then releases them all */
+static inline uint64_t ub_pool_burst(int count)
+{
+	void **objs = ub_pool_objs[tid];
+	int i;
+
+	for (i = 0; i < count; i++)
+		objs[i] = pool_alloc(ub_pool);
+	for (i = 0; i < count; i++)
+		pool_free(ub_pool, objs[i]);
+	return count;
+}
+
+static uint64_t ub_pool_small()
+{
+	uint64_t ops = 0;
+	int i;
+
+	for (i = 0; i < 64; i++)
+		ops += ub_pool_burst(UB_POOL_SMALL);
+	return ops;
+}
+
+static uint64_t ub_pool_large()
+{
+	return ub_pool_burst(UB_POOL_LARGE);
+}
+
+/************************ rings ************************/
+
+#define UB_RING_MSGS 1000
+
+static struct ring *ub_ring;
+
+static int ub_ring_init()
+{
+	ub_ring = ring_new(1048576);
+	return !!ub_ring;
+}
+
+static void ub_ring_deinit()
+{
+	ring_free(ub_ring);
+	ub_ring = NULL;
+}
+
+static uint64_t ub_ring_write()
+{
+	static const struct ist pfx[] = { IST("<134>1 2026-10-15T00:00:00.000000+00:00 host haproxy 1234 - - ") };
+	static const struct ist msg[] = { IST("127.0.0.1:41234 [15/Oct/2026:00:00:00.000] fe be/srv1 0/0/0/1/1 200 1234 - - ---- 1/1/0/0/0 0/0 \"GET / HTTP/1.1\"") };
+	int i;
+
+	for (i = 0; i < UB_RING_MSGS; i++)
+		ring_write(ub_ring, ~0, pfx, 1, msg, 1);
+	return UB_RING_MSGS;
+}
+
+/************************ HPACK / QPACK ************************/
+
+#define UB_HPACK_BLKS 1000
+
+static struct buffer ub_hpack_out;
+static struct buffer ub_hpack_tmp;
+static struct hpack_dht *ub_hpack_dht;
+
+static const struct ist ub_rsp_names[] = {
+	IST("date"), IST("server"), IST("content-type"), IST("content-length"),
+	IST("cache-control"), IST("last-modified"), IST("etag"), IST("vary"),
+	IST("set-cookie"), IST("x-frame-options"),
+};
+
+static const struct ist ub_rsp_values[] = {
+	IST("Thu, 15 Oct 2026 00:00:00 GMT"), IST("haproxy"), IST("text/html; charset=utf-8"),
+	IST("12345"), IST("max-age=3600, public"), IST("Wed, 14 Oct 2026 12:34:56 GMT"),
+	IST("\"5f8e157-3039\""), IST("accept-encoding"), IST("session=3f1b2c4d5e6f; path=/; HttpOnly"),
+	IST("SAMEORIGIN"),
+};
+
+static int ub_hpack_init()
+{
+	ub_hpack_out = b_make(malloc(global.tune.bufsize), global.tune.bufsize, 0, 0);
+	ub_hpack_tmp = b_make(malloc(global.tune.bufsize), global.tune.bufsize, 0, 0);
+	return ub_hpack_out.area && ub_hpack_tmp.area;
+}
+
+static void ub_hpack_deinit()
+{
+	ha_free(&ub_hpack_out.area);
+	ha_free(&ub_hpack_tmp.area);
+	if (ub_hpack_dht) {
+		hpack_dht_free(ub_hpack_dht);
+		ub_hpack_dht = NULL;
+	}
+}
+
+/* encodes the response headers into ub_hpack_out. Returns 0 on failure. */
+static int ub_hpack_encode_one()
+{
+	int i;
+
+	b_reset(&ub_hpack_out);
+	for (i = 0; i < 10; i++) {
+		if (!hpack_encode_header(&ub_hpack_out, ub_rsp_names[i], ub_rsp_values[i]))
+			return 0;
+	}
+	return 1;
+}
+
+static uint64_t ub_hpack_encode()
+{
+	int i;
+
+	for (i = 0; i < UB_HPACK_BLKS; i++) {
+		if (!ub_hpack_encode_one())
+			return 0;
+	}
+	return UB_HPACK_BLKS;
+}
+
+static int ub_hpack_decode_init()
+{
+	if (!ub_hpack_init() || !ub_hpack_encode_one())
+		return 0;
+	ub_hpack_dht = hpack_dht_alloc();
+	return !!ub_hpack_dht;
+}
+
+static uint64_t ub_hpack_decode()
+{
+	struct http_hdr list[32];
+	int i, ret;
+
+	for (i = 0; i < UB_HPACK_BLKS; i++) {
+		b_reset(&ub_hpack_tmp);
+		ret = hpack_decode_frame(ub_hpack_dht, (const uint8_t *)b_head(&ub_hpack_out),
+		                         b_data(&ub_hpack_out), list, sizeof(list) / sizeof(list[0]),
+		                         &ub_hpack_tmp);
+		if (ret < 0)
+			return 0;
+		ub_sink += ret;
+	}
+	return UB_HPACK_BLKS;
+}
+
+#ifdef USE_QUIC
+static uint64_t ub_qpack_encode()
+{
+	int i, j;
+
+	for (i = 0; i < UB_HPACK_BLKS; i++) {
+		b_reset(&ub_hpack_out);
+		if (qpack_encode_field_section_line(&ub_hpack_out) ||
+		    qpack_encode_int_status(&ub_hpack_out, 200))
+			return 0;
+		for (j = 0; j < 10; j++) {
+			if (qpack_encode_header(&ub_hpack_out, ub_rsp_names[j], ub_rsp_values[j]))
+				return 0;
+		}
+	}
+	return UB_HPACK_BLKS;
+}
+#endif
+
+/************************ runner ************************/
+
+/* result of one sample */
+struct ub_sample {
+	uint64_t ops;
+	uint64_t cycles;
+	uint64_t ns;
+};
+
+#ifdef USE_THREAD
+static pthread_barrier_t ub_barrier;
+static const struct ubench *ub_cur;
+static unsigned int ub_rounds;
+static uint64_t ub_thr_ops[MAX_THREADS];
+
+/* runs ub_rounds rounds of ub_cur on the thread passed in <arg> */
+static void *ub_thread(void *arg)
+{
+	const struct thread_info *thr = arg;
+	uint64_t ops = 0;
+	unsigned int r;
+
+	ha_set_thread(thr);
+	pthread_barrier_wait(&ub_barrier);
+	for (r = 0; r < ub_rounds; r++)
+		ops += ub_cur->run();
+	ub_thr_ops[tid] = ops;
+	pthread_barrier_wait(&ub_barrier);
+	if (ub_cur->thread_deinit)
+		ub_cur->thread_deinit();
+	return NULL;
+}
+#endif
+
+/* takes one sample of <ub> made of <rounds> rounds, on <nbthr> threads. */
+static void ub_sample(const struct ubench *ub, unsigned int rounds, int nbthr, struct ub_sample *s)
+{
+	uint64_t c0, t0;
+	unsigned int r;
+	int thr;
+
+	s->ops = 0;
+#ifdef USE_THREAD
+	if (nbthr > 1) {
+		pthread_t threads[MAX_THREADS];
+
+		ub_cur = ub;
+		ub_rounds = rounds;
+		pthread_barrier_init(&ub_barrier, NULL, nbthr);
+		for (thr = 1; thr < nbthr; thr++)
+			pthread_create(&threads[thr], NULL, ub_thread, (void *)&ha_thread_info[thr]);
+
+		pthread_barrier_wait(&ub_barrier);
+		t0 = now_mono_time();
+		c0 = rdtsc();
+		for (r = 0; r < rounds; r++)
+			s->ops += ub->run();
+		pthread_barrier_wait(&ub_barrier);
+		s->cycles = rdtsc() - c0;
+		s->ns = now_mono_time() - t0;
+
+		for (thr = 1; thr < nbthr; thr++) {
+			pthread_join(threads[thr], NULL);
+			s->ops += ub_thr_ops[thr];
+		}
+		pthread_barrier_destroy(&ub_barrier);
+		return;
+	}
+#endif
+	t0 = now_mono_time();
+	c0 = rdtsc();
+	for (r = 0; r < rounds; r++)
+		s->ops += ub->run();
+	s->cycles = rdtsc() - c0;
+	s->ns = now_mono_time() - t0;
+}
+
+/* runs benchmark <ub> and reports the best sample on stdout. Returns 0 on
+ * failure.
+ */
+static int ub_run_one(const struct ubench *ub)
+{
+	struct ub_sample s, best = { };
+	unsigned int rounds = 1;
+	int nbthr = (ub->flags & UBENCH_F_MT) ? global.nbthread : 1;
+	int i;
+
+	if (ub->init && !ub->init()) {
+		printf("%-16s  failed to initialize\n", ub->name);
+		return 0;
+	}
+
+	/* warm up and calibrate the number of rounds per sample on one thread */
+	while (1) {
+		ub_sample(ub, rounds, 1, &s);
+		if (!s.ops) {
+			printf("%-16s  failed to run\n", ub->name);
+			goto end;
+		}
+		if (s.ns >= UBENCH_SAMPLE_NS || rounds >= 1U << 30)
+			break;
+		rounds = (s.ns < UBENCH_SAMPLE_NS / 16) ? rounds * 16 : rounds * 2;
+	}
+
+	/* keep the fastest sample, which is the least disturbed one. For
+	 * multi-thread samples, ops are per thread so that the cost per op
+	 * reflects what each thread experiences.
+	 */
+	for (i = 0; i < UBENCH_SAMPLES; i++) {
+		ub_sample(ub, rounds, nbthr, &s);
+		s.ops /= nbthr;
+		if (!best.ops || s.cycles * best.ops < best.cycles * s.ops)
+			best = s;
+	}
+
+	printf("%-16s %3d %12llu %10.1f %10.2f %10.2f  %s\n", ub->name, nbthr,
+	       (ullong)best.ops, (double)best.cycles / best.ops, (double)best.ns / best.ops,
+	       (double)best.ops * nbthr * 1000.0 / best.ns, ub->desc);
+  end:
+	if (ub->deinit)
+		ub->deinit();
+	return !!s.ops;
+}
+
+/* runs the micro-benchmarks whose names appear in the comma-delimited list
+ * <names>, or all of them for "all". "help" lists them. Returns the number of
+ * failures.
+ */
+int ubench_run(char *names)
+{
+	struct ubench_list *ubl;
+	const struct ubench *ub;
+	int header = 0, err = 0;
+	char *end;
+
+	for (; names && *names; names = end) {
+		int found = 0;
+
+		end = strchr(names, ',');
+		if (end)
+			*(end++) = 0;
+
+		if (strcmp(names, "help") == 0) {
+			printf("# List of available micro-benchmarks (use 'all' to run them all):\n");
+			list_for_each_entry(ubl, &ubench_lists, list)
+				for (ub = ubl->ub; ub->name; ub++)
+					printf("%-16s %s%s\n", ub->name, ub->desc,
+					       (ub->flags & UBENCH_F_MT) ? " (all threads)" : "");
+			continue;
+		}
+
+		list_for_each_entry(ubl, &ubench_lists, list) {
+			for (ub = ubl->ub; ub->name; ub++) {
+				if (strcmp(names, "all") != 0 && strcmp(names, ub->name) != 0)
+					continue;
+				if (!header++)
+					printf("# name           thr          ops  cycles/op      ns/op     Mops/s  operation\n");
+				fflush(stdout);
+				err += !ub_run_one(ub);
+				found = 1;
+			}
+		}
+
+		if (!found) {
+			printf("unknown micro-benchmark '%s', use 'help' for the list.\n", names);
+			err++;
+		}
+	}
+	return err;
+}
+
+static struct ubench_list ub_core = { ILH, {
+	{ "eb32-insert",  "insert one random key into a 64k-entry eb32 tree",      ub_eb_alloc,         ub_eb32_insert,  ub_eb_free,      0 },
+	{ "eb32-lookup",  "lookup one key in a 64k-entry eb32 tree",               ub_eb32_lookup_init, ub_eb32_lookup,  ub_eb_free,      0 },
+	{ "eb64-insert",  "insert one random key into a 64k-entry eb64 tree",      ub_eb_alloc,         ub_eb64_insert,  ub_eb_free,      0 },
+	{ "eb64-lookup",  "lookup one key in a 64k-entry eb64 tree",               ub_eb64_lookup_init, ub_eb64_lookup,  ub_eb_free,      0 },
+	{ "ebmb-insert",  "insert one 16-byte key into a 64k-entry ebmb tree",     ub_eb_alloc,         ub_ebmb_insert,  ub_eb_free,      0 },
+	{ "ebmb-lookup",  "lookup one 16-byte key in a 64k-entry ebmb tree",       ub_ebmb_lookup_init, ub_ebmb_lookup,  ub_eb_free,      0 },
+	{ "ebst-insert",  "insert one string into a 64k-entry ebst tree",          ub_eb_alloc,         ub_ebst_insert,  ub_eb_free,      0 },
+	{ "ebst-lookup",  "lookup one string in a 64k-entry ebst tree",            ub_ebst_lookup_init, ub_ebst_lookup,  ub_eb_free,      0 },
+	{ "htx-add",      "build a request with 10 headers and 1kB of data",       ub_htx_init,         ub_htx_add,      ub_htx_deinit,   0 },
+	{ "htx-defrag",   "copy then defragment a 40-header request",              ub_htx_defrag_init,  ub_htx_defrag,   ub_htx_deinit,   0 },
+	{ "htx-xfer",     "transfer a request with 10 headers and 1kB of data",    ub_htx_xfer_init,    ub_htx_xfer,     ub_htx_deinit,   0 },
+	{ "pool-cached",  "alloc+free of a 256-byte object in bursts of 64",       ub_pool_init,        ub_pool_small,   ub_pool_deinit,  UBENCH_F_MT, ub_pool_thread_deinit },
+	{ "pool-shared",  "alloc+free of a 256-byte object in bursts of 4096",     ub_pool_init,        ub_pool_large,   ub_pool_deinit,  UBENCH_F_MT, ub_pool_thread_deinit },
+	{ "ring-write",   "write one 200-byte log message into a 1MB ring",        ub_ring_init,        ub_ring_write,   ub_ring_deinit,  UBENCH_F_MT },
+	{ "hpack-encode", "encode a block of 10 response headers",                 ub_hpack_init,       ub_hpack_encode, ub_hpack_deinit, 0 },
+	{ "hpack-decode", "decode a block of 10 response headers",                 ub_hpack_decode_init, ub_hpack_decode, ub_hpack_deinit, 0 },
+#ifdef USE_QUIC
+	{ "qpack-encode", "encode a block of 10 response headers",                 ub_hpack_init,       ub_qpack_encode, ub_hpack_deinit, 0 },
+#endif
+	{ NULL },
+}};
+
+INITCALL1(STG_REGISTER, ubench_register, &ub_core);
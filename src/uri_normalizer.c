@@ -18,6 +18,42 @@
 #include <haproxy/tools.h>
 #include <haproxy/uri_normalizer.h>
 
+/* Appends to <output> the characters of <scanner> preceding the first
+ * occurrence of <c>, which are known not to need any change, and advances
+ * <scanner> past them. The search relies on memchr() which processes many bytes
+ * at once, so that the callers only have to run their state machine around the
+ * characters they care about. <output> must be large enough.
+ */
+static inline void uri_normalizer_copy_run(struct ist *output, struct ist *scanner, char c)
+{
+	const char *found = memchr(istptr(*scanner), c, istlen(*scanner));
+	size_t run = found ? found - istptr(*scanner) : istlen(*scanner);
+
+	memcpy(istend(*output), istptr(*scanner), run);
+	*output = ist2(istptr(*output), istlen(*output) + run);
+	*scanner = istadv(*scanner, run);
+}
+
+/* Returns non-zero if <path> contains a `/.` sequence followed by a slash or
+ * by the end of the path when <dotdot> is zero, or a `/..` sequence when it is
+ * not. The dots are looked up using memchr(), they are much less common than
+ * slashes in paths.
+ */
+static int uri_normalizer_has_dot_segment(const struct ist path, int dotdot)
+{
+	const char *end = istend(path);
+	const char *p = istptr(path);
+
+	while ((p = memchr(p, '.', end - p)) != NULL) {
+		if (p > istptr(path) && p[-1] == '/') {
+			if (dotdot ? (p + 1 < end && p[1] == '.') : (p + 1 == end || p[1] == '/'))
+				return 1;
+		}
+		p++;
+	}
+	return 0;
+}
+
 /* Encodes '#' as '%23'. */
 enum uri_normalizer_err uri_normalizer_fragment_encode(const struct ist input, struct ist *dst)
 {
@@ -89,6 +125,7 @@ static int is_unreserved_character(unsigned char c)
 enum uri_normalizer_err uri_normalizer_percent_decode_unreserved(const struct ist input, int strict, struct ist *dst)
 {
 	enum uri_normalizer_err err;
+	char current;
 
 	const size_t size = istclear(dst);
 	struct ist output = *dst;
@@ -102,7 +139,11 @@ enum uri_normalizer_err uri_normalizer_percent_decode_unreserved(const struct is
 	}
 
 	while (istlen(scanner)) {
-		const char current = istshift(&scanner);
+		uri_normalizer_copy_run(&output, &scanner, '%');
+		if (!istlen(scanner))
+			break;
+
+		current = istshift(&scanner);
 
 		if (current == '%') {
 			if (istlen(scanner) >= 2) {
@@ -158,6 +199,7 @@ enum uri_normalizer_err uri_normalizer_percent_decode_unreserved(const struct is
 enum uri_normalizer_err uri_normalizer_percent_upper(const struct ist input, int strict, struct ist *dst)
 {
 	enum uri_normalizer_err err;
+	char current;
 
 	const size_t size = istclear(dst);
 	struct ist output = *dst;
@@ -171,7 +213,11 @@ enum uri_normalizer_err uri_normalizer_percent_upper(const struct ist input, int
 	}
 
 	while (istlen(scanner)) {
-		const char current = istshift(&scanner);
+		uri_normalizer_copy_run(&output, &scanner, '%');
+		if (!istlen(scanner))
+			break;
+
+		current = istshift(&scanner);
 
 		if (current == '%') {
 			if (istlen(scanner) >= 2) {
@@ -221,6 +267,13 @@ enum uri_normalizer_err uri_normalizer_path_dot(const struct ist path, struct is
 		goto fail;
 	}
 
+	/* Most paths have no `.` segment at all and are copied as-is. */
+	if (!isteq(path, ist(".")) && !istmatch(path, ist("./")) &&
+	    !uri_normalizer_has_dot_segment(path, 0)) {
+		istcat(&newpath, path, size);
+		scanner = IST_NULL;
+	}
+
 	while (istlen(scanner) > 0) {
 		const struct ist segment = istsplit(&scanner, '/');
 
@@ -270,6 +323,13 @@ enum uri_normalizer_err uri_normalizer_path_dotdot(const struct ist path, int fu
 		goto fail;
 	}
 
+	/* Most paths have no `/..` at all and are copied as-is. */
+	if (!uri_normalizer_has_dot_segment(path, 1)) {
+		head -= istlen(path);
+		memcpy(head, istptr(path), istlen(path));
+		offset = -1;
+	}
+
 	/* Handle `/..` at the end of the path without a trailing slash. */
 	if (offset >= 2 && istmatch(istadv(path, offset - 2), ist("/.."))) {
 		up++;
@@ -339,6 +399,7 @@ enum uri_normalizer_err uri_normalizer_path_dotdot(const struct ist path, int fu
 enum uri_normalizer_err uri_normalizer_path_merge_slashes(const struct ist path, struct ist *dst)
 {
 	enum uri_normalizer_err err;
+	char current;
 
 	const size_t size = istclear(dst);
 	struct ist newpath = *dst;
@@ -352,7 +413,11 @@ enum uri_normalizer_err uri_normalizer_path_merge_slashes(const struct ist path,
 	}
 
 	while (istlen(scanner) > 0) {
-		const char current = istshift(&scanner);
+		uri_normalizer_copy_run(&newpath, &scanner, '/');
+		if (!istlen(scanner))
+			break;
+
+		current = istshift(&scanner);
 
 		if (current == '/') {
 			while (istlen(scanner) > 0 && *istptr(scanner) == '/')
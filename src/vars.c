@@ -178,7 +178,7 @@ unsigned int var_clear(struct var *var, int force)
 	var->data.type = SMP_T_ANY;
 
 	if (!(var->flags & VF_PERMANENT) || force) {
-		LIST_DELETE(&var->l);
+		eb64_delete(&var->node);
 		pool_free(var_pool, var);
 		size += sizeof(struct var);
 	}
@@ -190,12 +190,13 @@ unsigned int var_clear(struct var *var, int force)
  */
 void vars_prune(struct vars *vars, struct session *sess, struct stream *strm)
 {
-	struct var *var, *tmp;
+	struct eb64_node *node, *next;
 	unsigned int size = 0;
 
 	vars_wrlock(vars);
-	list_for_each_entry_safe(var, tmp, &vars->head, l) {
-		size += var_clear(var, 1);
+	for (node = eb64_first(&vars->name_root); node; node = next) {
+		next = eb64_next(node);
+		size += var_clear(container_of(node, struct var, node), 1);
 	}
 	vars_wrunlock(vars);
 	var_accounting_diff(vars, sess, strm, -size);
@@ -206,12 +207,13 @@ void vars_prune(struct vars *vars, struct session *sess, struct stream *strm)
  */
 void vars_prune_per_sess(struct vars *vars)
 {
-	struct var *var, *tmp;
+	struct eb64_node *node, *next;
 	unsigned int size = 0;
 
 	vars_wrlock(vars);
-	list_for_each_entry_safe(var, tmp, &vars->head, l) {
-		size += var_clear(var, 1);
+	for (node = eb64_first(&vars->name_root); node; node = next) {
+		next = eb64_next(node);
+		size += var_clear(container_of(node, struct var, node), 1);
 	}
 	vars_wrunlock(vars);
 
@@ -221,10 +223,10 @@ void vars_prune_per_sess(struct vars *vars)
 		_HA_ATOMIC_SUB(&proc_vars.size, size);
 }
 
-/* This function initializes a variables list head */
+/* This function initializes a variables tree head */
 void vars_init_head(struct vars *vars, enum vars_scope scope)
 {
-	LIST_INIT(&vars->head);
+	vars->name_root = EB_ROOT_UNIQUE;
 	vars->scope = scope;
 	vars->size = 0;
 	HA_RWLOCK_INIT(&vars->rwlock);
@@ -294,19 +296,16 @@ static int vars_hash_name(const char *name, int len, enum vars_scope *scope,
 	return 1;
 }
 
-/* This function returns the variable from the given list that matches
- * <name_hash> or returns NULL if not found. It's only a linked list since it
- * is not expected to have many variables per scope (a few tens at best).
- * The caller is responsible for ensuring that <vars> is properly locked.
+/* This function returns the variable from the given tree that matches
+ * <name_hash> or returns NULL if not found. The caller is responsible for
+ * ensuring that <vars> is properly locked.
  */
 static struct var *var_get(struct vars *vars, uint64_t name_hash)
 {
-	struct var *var;
+	struct eb64_node *node;
 
-	list_for_each_entry(var, &vars->head, l)
-		if (var->name_hash == name_hash)
-			return var;
-	return NULL;
+	node = eb64_lookup(&vars->name_root, name_hash);
+	return node ? container_of(node, struct var, node) : NULL;
 }
 
 /* Returns 0 if fails, else returns 1. */
@@ -399,8 +398,8 @@ static int var_set(uint64_t name_hash, enum vars_scope scope, struct sample *smp
 		var = pool_alloc(var_pool);
 		if (!var)
 			goto unlock;
-		LIST_APPEND(&vars->head, &var->l);
-		var->name_hash = name_hash;
+		var->node.key = name_hash;
+		eb64_insert(&vars->name_root, &var->node);
 		var->flags = flags & VF_PERMANENT;
 		var->data.type = SMP_T_ANY;
 	}
@@ -649,6 +648,15 @@ int vars_set_by_name(const char *name, size_t len, struct sample *smp)
 	return var_set(hash, scope, smp, 0);
 }
 
+/* This function stores a sample in the variable described by <var_desc>,
+ * typically resolved at configuration time by vars_check_arg().
+ * Returns zero on failure and non-zero otherwise.
+ */
+int vars_set_by_desc(const struct var_desc *var_desc, struct sample *smp)
+{
+	return var_set(var_desc->name_hash, var_desc->scope, smp, 0);
+}
+
 /* This function unsets a variable if it was already defined.
  * Returns zero on failure and non-zero otherwise.
  */
@@ -34,11 +34,13 @@
 #endif
 
 static timer_t per_thread_wd_timer[MAX_THREADS];
+static ullong per_thread_wd_check[MAX_THREADS]; /* CPU time of the last lockup check */
 
 /* Setup (or ping) the watchdog timer for thread <thr>. Returns non-zero on
- * success, zero on failure. It interrupts once per second of CPU time. It
- * happens that timers based on the CPU time are not automatically re-armed
- * so we only use the value and leave the interval unset.
+ * success, zero on failure. It interrupts once per second of CPU time, or
+ * once per slow loop threshold when it is set and shorter. It happens that
+ * timers based on the CPU time are not automatically re-armed so we only use
+ * the value and leave the interval unset.
  */
 int wdt_ping(int thr)
 {
@@ -46,6 +48,10 @@ int wdt_ping(int thr)
 
 	its.it_value.tv_sec    = 1; its.it_value.tv_nsec    = 0;
 	its.it_interval.tv_sec = 0; its.it_interval.tv_nsec = 0;
+	if (slow_loop_threshold && slow_loop_threshold < 1000) {
+		its.it_value.tv_sec  = 0;
+		its.it_value.tv_nsec = slow_loop_threshold * 1000000UL;
+	}
 	return timer_settime(per_thread_wd_timer[thr], 0, &its, NULL) == 0;
 }
 
@@ -77,10 +83,35 @@ void wdt_handler(int sig, siginfo_t *si, void *arg)
 		p = ha_thread_ctx[thr].prev_cpu_time;
 		n = now_cpu_time_thread(thr);
 
-		/* not yet reached the deadline of 1 sec,
-		 * or p wasn't initialized yet
+		if (!p)
+			goto update_and_leave;
+
+		/* The current loop has been running for longer than the slow
+		 * loop threshold: have the thread record what it's doing. It
+		 * must be done by the thread itself to get its call trace.
+		 */
+		if (slow_loop_threshold && n - p >= slow_loop_threshold * 1000000ULL &&
+		    !((_HA_ATOMIC_LOAD(&ha_thread_ctx[thr].flags) & TH_FL_SLEEPING) &&
+		      (_HA_ATOMIC_LOAD(&ha_tgroup_ctx[tgrp-1].threads_harmless) & thr_bit))) {
+#ifdef USE_THREAD
+			if (thr != tid) {
+				_HA_ATOMIC_OR(&ha_thread_ctx[thr].flags, TH_FL_SLOW_LOOP);
+				ha_tkill(thr, sig);
+			}
+			else
+#endif
+				ha_record_slow_loop();
+		}
+
+		/* the lockup detection below only runs once per second of CPU
+		 * time, even when woken up more often for slow loops.
 		 */
-		if (!p || n - p < 1000000000UL)
+		if (n - per_thread_wd_check[thr] < 1000000000UL)
+			goto update_and_leave;
+		per_thread_wd_check[thr] = n;
+
+		/* not yet reached the deadline of 1 sec */
+		if (n - p < 1000000000UL)
 			goto update_and_leave;
 
 		if ((_HA_ATOMIC_LOAD(&th_ctx->flags) & TH_FL_SLEEPING) &&
@@ -114,14 +145,28 @@ void wdt_handler(int sig, siginfo_t *si, void *arg)
 #if defined(USE_THREAD) && defined(SI_TKILL) /* Linux uses this */
 
 	case SI_TKILL:
-		/* we got a pthread_kill, stop on it */
+		/* we got a pthread_kill, either from ourselves to record a
+		 * slow loop, or to stop on it.
+		 */
+		if (_HA_ATOMIC_LOAD(&th_ctx->flags) & TH_FL_SLOW_LOOP) {
+			_HA_ATOMIC_AND(&th_ctx->flags, ~TH_FL_SLOW_LOOP);
+			ha_record_slow_loop();
+			return;
+		}
 		thr = tid;
 		break;
 
 #elif defined(USE_THREAD) && defined(SI_LWP) /* FreeBSD uses this */
 
 	case SI_LWP:
-		/* we got a pthread_kill, stop on it */
+		/* we got a pthread_kill, either from ourselves to record a
+		 * slow loop, or to stop on it.
+		 */
+		if (_HA_ATOMIC_LOAD(&th_ctx->flags) & TH_FL_SLOW_LOOP) {
+			_HA_ATOMIC_AND(&th_ctx->flags, ~TH_FL_SLOW_LOOP);
+			ha_record_slow_loop();
+			return;
+		}
 		thr = tid;
 		break;
 
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""
+Measures the latency of map lookups while the map is updated over the CLI.
+
+  ./tests/exp/map-update-latency.py [haproxy] [entries] [seconds]
+
+A haproxy process is started on a temporary configuration looking up a
+header in a map of <entries> entries (100000 by default). A number of
+clients then send requests over keep-alive connections, first alone, then
+while another client continuously replaces values with "set map" and adds
+and removes entries with "add map" and "del map". The latency percentiles
+and request rates of both runs are reported, together with the rate of
+updates. Rebuilding haproxy between two runs allows to compare the impact
+of a change on contended lookups.
+"""
+
+import http.client, os, random, socket, subprocess, sys, tempfile, threading, time
+
+HAPROXY = sys.argv[1] if len(sys.argv) > 1 else "./haproxy"
+ENTRIES = int(sys.argv[2]) if len(sys.argv) > 2 else 100000
+DURATION = float(sys.argv[3]) if len(sys.argv) > 3 else 5.0
+CLIENTS = 4
+PORT = 18900
+
+CONFIG = """
+global
+  nbthread 4
+  stats socket {dir}/cli.sock level admin
+
+defaults
+  mode http
+  timeout client 10s
+  timeout server 10s
+  timeout connect 10s
+
+frontend bench
+  bind 127.0.0.1:{port}
+  http-request return status 200 content-type text/plain lf-string "%[req.hdr(key),map_str({dir}/bench.map,none)]"
+"""
+
+def cli(path, cmds):
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(path)
+    s.sendall(("; ".join(cmds) + "\n").encode())
+    while s.recv(65536):
+        pass
+    s.close()
+
+def client(stop, lat):
+    conn = http.client.HTTPConnection("127.0.0.1", PORT)
+    while not stop.is_set():
+        key = "key%d" % random.randrange(ENTRIES)
+        start = time.perf_counter()
+        conn.request("GET", "/", headers={"key": key})
+        conn.getresponse().read()
+        lat.append(time.perf_counter() - start)
+    conn.close()
+
+def updater(stop, path, count):
+    n = 0
+    while not stop.is_set():
+        cmds = []
+        for i in range(16):
+            key = "key%d" % random.randrange(ENTRIES)
+            cmds.append("set map %s/bench.map %s val%d" % (tmp, key, n + i))
+        cmds.append("add map %s/bench.map extra%d val" % (tmp, n))
+        cmds.append("del map %s/bench.map extra%d" % (tmp, n))
+        cli(path, cmds)
+        n += 16
+        count[0] += len(cmds)
+
+def run(updates):
+    stop = threading.Event()
+    lats = [[] for i in range(CLIENTS)]
+    count = [0]
+    threads = [threading.Thread(target=client, args=(stop, l)) for l in lats]
+    if updates:
+        threads.append(threading.Thread(target=updater, args=(stop, tmp + "/cli.sock", count)))
+    for t in threads:
+        t.start()
+    time.sleep(DURATION)
+    stop.set()
+    for t in threads:
+        t.join()
+
+    lat = sorted(sum(lats, []))
+    pct = lambda p: lat[min(len(lat) - 1, int(len(lat) * p))] * 1e6
+    print("%-16s req/s=%-8d p50=%-7.0f p99=%-7.0f p99.9=%-7.0f max=%-7.0f (us) updates/s=%d" %
+          ("with updates:" if updates else "lookups only:", len(lat) / DURATION,
+           pct(0.5), pct(0.99), pct(0.999), lat[-1] * 1e6, count[0] / DURATION))
+
+tmp = tempfile.mkdtemp(prefix="map-bench.")
+with open(tmp + "/bench.map", "w") as f:
+    for i in range(ENTRIES):
+        f.write("key%d val%d\n" % (i, i))
+with open(tmp + "/bench.cfg", "w") as f:
+    f.write(CONFIG.format(dir=tmp, port=PORT))
+
+proc = subprocess.Popen([HAPROXY, "-db", "-f", tmp + "/bench.cfg"])
+try:
+    for i in range(100):
+        if os.path.exists(tmp + "/cli.sock"):
+            break
+        time.sleep(0.1)
+    time.sleep(0.5)
+    run(False)
+    run(True)
+finally:
+    proc.terminate()
+    proc.wait()